@@ -59,6 +59,9 @@ namespace epee
     //! Append `src` as hex to `out`.
     static void buffer(std::ostream& out, const span<const std::uint8_t> src);
 
+    //! Write `src` as hex to `out`. \return False if `out` is not exactly twice the length.
+    static bool buffer(span<char> out, const span<const std::uint8_t> src) noexcept;
+
     //! Append `< + src + >` as hex to `out`.
     static void formatted(std::ostream& out, const span<const std::uint8_t> src);
 
@@ -68,4 +71,10 @@ namespace epee
     //! Write `src` bytes as hex to `out`. `out` must be twice the length
     static void buffer_unchecked(char* out, const span<const std::uint8_t> src) noexcept;
   };
+
+  struct from_hex
+  {
+    //! Write the bytes of hex `src`, either case, to `out`. \return False if `src` is not hex or not twice the length of `out`.
+    static bool to_buffer(span<std::uint8_t> out, const span<const char> src) noexcept;
+  };
 }
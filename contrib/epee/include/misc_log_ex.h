@@ -30,6 +30,7 @@
 
 #ifdef __cplusplus
 
+#include <cstdint>
 #include <string>
 
 #include "easylogging++.h"
@@ -127,7 +128,8 @@
 #endif
 
 std::string mlog_get_default_log_path(const char *default_filename);
-void mlog_configure(const std::string &filename_base, bool console, const std::size_t max_log_file_size = MAX_LOG_FILE_SIZE, const std::size_t max_log_files = MAX_LOG_FILES);
+void mlog_configure(const std::string &filename_base, bool console, const std::size_t max_log_file_size = MAX_LOG_FILE_SIZE, const std::size_t max_log_files = MAX_LOG_FILES, bool async = false);
+std::uint64_t mlog_get_async_dropped();
 void mlog_set_categories(const char *categories);
 std::string mlog_get_categories();
 void mlog_set_log_level(int level);
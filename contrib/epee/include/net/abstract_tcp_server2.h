@@ -60,6 +60,10 @@
 #define ANTD_DEFAULT_LOG_CATEGORY "net"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_COUNT 16 // queued slices written by one async_write
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES (64 * 1024)
+#define ABSTRACT_SERVER_READ_MIN_BYTES 8192 // receive buffer size when idle or on small messages
+#define ABSTRACT_SERVER_READ_MAX_BYTES (256 * 1024) // largest single async_read_some
 
 namespace epee
 {
@@ -117,7 +121,12 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
-    virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
+    virtual bool do_send_shared(const std::vector<shared_buffer>& buffers, traffic_class cls = traffic_class::priority); ///< queues the buffers without copying them
+    bool do_send_buffer(const shared_buffer& buffer, traffic_class cls); ///< splits into chunks for the throttle and queues them
+    bool do_send_chunk(const send_slice& slice); ///< will send (or queue) a part of data
+    void start_write(); ///< writes the front of the send queue, m_send_que_lock must be held
+    void start_write_throttled(); ///< ditto, once the throttle allows the front slice's class
+    void start_read();
     virtual bool send_done();
     virtual bool close();
     virtual bool call_run_once_service_io();
@@ -125,6 +134,8 @@ namespace net_utils
     virtual boost::asio::io_service& get_io_service();
     virtual bool add_ref();
     virtual bool release();
+    virtual void expect_recv(size_t cb);
+    virtual size_t send_queue_bytes();
     //------------------------------------------------------
     boost::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
@@ -143,9 +154,9 @@ namespace net_utils
     /// host connection count tracking
     unsigned int host_count(const std::string &host, int delta = 0);
 
-    /// Buffer for incoming data.
-    boost::array<char, 8192> buffer_;
-    //boost::array<char, 1024> buffer_;
+    /// Buffer for incoming data, resized between reads by update_read_size
+    std::vector<char> buffer_;
+    void update_read_size(size_t bytes_transferred);
 
     t_connection_context context;
     i_connection_filter* &m_pfilter;
@@ -169,8 +180,13 @@ namespace net_utils
     boost::mutex m_throttle_speed_out_mutex;
 
     boost::asio::deadline_timer m_timer;
+    boost::asio::deadline_timer m_send_throttle_timer;
+    boost::asio::deadline_timer m_receive_throttle_timer;
+    bool m_send_que_throttled; // waiting on m_send_throttle_timer to write the queue, guarded by m_send_que_lock
     bool m_local;
     bool m_ready_to_close;
+    size_t m_read_size; ///< size of the next read
+    size_t m_expected_recv; ///< bytes the protocol handler still needs for the current message
     std::string m_host;
 
 	public:
@@ -83,8 +83,13 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		m_throttle_speed_in("speed_in", "throttle_speed_in"),
 		m_throttle_speed_out("speed_out", "throttle_speed_out"),
 		m_timer(io_service),
+		m_send_throttle_timer(io_service),
+		m_receive_throttle_timer(io_service),
+		m_send_que_throttled(false),
 		m_local(false),
-		m_ready_to_close(false)
+		m_ready_to_close(false),
+		m_read_size(ABSTRACT_SERVER_READ_MIN_BYTES),
+		m_expected_recv(0)
   {
     MDEBUG("test, connection constructor set m_connection_type="<<m_connection_type);
   }
@@ -185,11 +190,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     reset_timer(get_default_timeout(), false);
 
-    socket_.async_read_some(boost::asio::buffer(buffer_),
-      strand_.wrap(
-        boost::bind(&connection<t_protocol_handler>::handle_read, self,
-          boost::asio::placeholders::error,
-          boost::asio::placeholders::bytes_transferred)));
+    start_read();
 #if !defined(_WIN32) || !defined(__i686)
 	// not supported before Windows7, too lazy for runtime check
 	// Just exclude for 32bit windows builds
@@ -318,38 +319,18 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			context.m_current_speed_down = m_throttle_speed_in.get_current_speed();
 			context.m_max_speed_down = std::max(context.m_max_speed_down, context.m_current_speed_down);
 		}
-    
-    {
-			CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_in );
-			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred);
-		}
 
-		double delay=0; // will be calculated - how much we should sleep to obey speed limit etc
-
-
-		if (speed_limit_is_enabled()) {
-			do // keep sleeping if we should sleep
-			{
-				{ //_scope_dbg1("CRITICAL_REGION_LOCAL");
-					CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in );
-					delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred );
-				}
-				
-				delay *= 0.5;
-				if (delay > 0) {
-					long int ms = (long int)(delay * 100);
-					reset_timer(boost::posix_time::milliseconds(ms + 1), true);
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
-				}
-			} while(delay > 0);
-		} // any form of sleeping
-		
+		if (speed_limit_is_enabled())
+			handle_received(bytes_transferred);
+
       //_info("[sock " << socket_.native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
       context.m_last_recv = time(NULL);
       context.m_recv_cnt += bytes_transferred;
       m_ready_to_close = false;
+      m_expected_recv = 0;
       bool recv_res = m_protocol_handler.handle_recv(buffer_.data(), bytes_transferred);
+      update_read_size(bytes_transferred);
       if(!recv_res)
       {  
         //_info("[sock " << socket_.native_handle() << "] protocol_want_close");
@@ -366,11 +347,20 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       }else
       {
         reset_timer(get_timeout_from_bytes_read(bytes_transferred), false);
-        socket_.async_read_some(boost::asio::buffer(buffer_),
-          strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
-              boost::asio::placeholders::error,
-              boost::asio::placeholders::bytes_transferred)));
+        // over the download limit, leave the data in the socket until the buckets refill
+        const double wait = speed_limit_is_enabled() ? get_receive_wait_time() : 0;
+        if (wait > 0)
+        {
+          MTRACE("Throttling read for " << (long)(wait * 1000) << " ms");
+          auto self = connection<t_protocol_handler>::shared_from_this();
+          m_receive_throttle_timer.expires_from_now(boost::posix_time::microseconds((int64_t)(wait * 1000000)));
+          m_receive_throttle_timer.async_wait(strand_.wrap([this, self](const boost::system::error_code& ec) {
+            if (!ec && !m_was_shutdown)
+              start_read();
+          }));
+        }
+        else
+          start_read();
         //_info("[sock " << socket_.native_handle() << "]Async read requested.");
       }
     }else
@@ -397,13 +387,50 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::expect_recv(size_t cb)
+  {
+    // called from handle_recv, so on the strand that owns the read buffer
+    m_expected_recv = cb;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::update_read_size(size_t bytes_transferred)
+  {
+    // grow while reads fill the buffer, shrink back once traffic is small again
+    size_t size = m_read_size;
+    if (bytes_transferred >= size)
+      size *= 2;
+    else if (bytes_transferred < size / 4)
+      size /= 2;
+    // the handler knows how much of a large message is still in flight
+    size = std::max(size, m_expected_recv);
+    m_read_size = std::min<size_t>(std::max<size_t>(size, ABSTRACT_SERVER_READ_MIN_BYTES), ABSTRACT_SERVER_READ_MAX_BYTES);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_read()
+  {
+    if (buffer_.size() != m_read_size)
+    {
+      buffer_.resize(m_read_size);
+      if (buffer_.capacity() > 2 * m_read_size)
+        buffer_.shrink_to_fit();
+    }
+    socket_.async_read_some(boost::asio::buffer(buffer_),
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
+          boost::asio::placeholders::error,
+          boost::asio::placeholders::bytes_transferred)));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool connection<t_protocol_handler>::call_run_once_service_io()
   {
     TRY_ENTRY();
     if(!m_is_multithreaded)
     {
       //single thread model, we can wait in blocked call
-      size_t cnt = socket_.get_io_service().run_one();
+      size_t cnt = get_io_service().run_one();
       if(!cnt)//service is going to quit
         return false;
     }else
@@ -413,7 +440,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       //if no handlers were called
       //TODO: Maybe we need to have have critical section + event + callback to upper protocol to
       //ask it inside(!) critical region if we still able to go in event wait...
-      size_t cnt = socket_.get_io_service().poll_one();     
+      size_t cnt = get_io_service().poll_one();     
       if(!cnt)
         misc_utils::sleep_no_w(1);
     }
@@ -421,6 +448,16 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     return true;
     CATCH_ENTRY_L0("connection<t_protocol_handler>::call_run_once_service_io", false);
   }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  size_t connection<t_protocol_handler>::send_queue_bytes()
+  {
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    size_t bytes = 0;
+    for (const send_slice& slice: m_send_que)
+      bytes += slice.size;
+    return bytes;
+  }
   //---------------------------------------------------------------------------------
     template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb) {
@@ -430,8 +467,36 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     auto self = safe_shared_from_this();
     if (!self) return false;
     if (m_was_shutdown) return false;
-		// TODO avoid copy
 
+    // one copy, the chunks then refer into it
+    return do_send_buffer(std::make_shared<const std::string>((const char*)ptr, cb), traffic_class::priority);
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+	} // do_send()
+  //---------------------------------------------------------------------------------
+    template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_shared(const std::vector<shared_buffer>& buffers, traffic_class cls) {
+    TRY_ENTRY();
+
+    auto self = safe_shared_from_this();
+    if (!self) return false;
+    if (m_was_shutdown) return false;
+
+    // keep the parts of one message together in the queue
+    epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock);
+    for (const shared_buffer& buffer: buffers)
+    {
+      CHECK_AND_ASSERT_MES(buffer, false, "Null send buffer");
+      if (!do_send_buffer(buffer, cls))
+        return false;
+    }
+    return true;
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_shared", false);
+	} // do_send_shared()
+  //---------------------------------------------------------------------------------
+    template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_buffer(const shared_buffer& buffer, traffic_class cls) {
 		const double factor = 32; // TODO config
 		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
 		const t_safe chunksize_good = (t_safe)( 1024 * std::max(1.0,factor) );
@@ -441,72 +506,42 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         CHECK_AND_ASSERT_MES(! (chunksize_max<0), false, "Negative chunksize_max" ); // make sure it is unsigned before removin sign with cast:
         long long unsigned int chunksize_max_unsigned = static_cast<long long unsigned int>( chunksize_max ) ;
 
+        const size_t cb = buffer->size();
         if (allow_split && (cb > chunksize_max_unsigned)) {
 			{ // LOCK: chunking
     		epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical *** 
 
-				MDEBUG("do_send() will SPLIT into small chunks, from packet="<<cb<<" B for ptr="<<ptr);
-				t_safe all = cb; // all bytes to send 
-				t_safe pos = 0; // current sending position
-				// 01234567890 
-				// ^^^^        (pos=0, len=4)     ;   pos:=pos+len, pos=4
-				//     ^^^^    (pos=4, len=4)     ;   pos:=pos+len, pos=8
-				//         ^^^ (pos=8, len=4)    ;   
-
-				// const size_t bufsize = chunksize_good; // TODO safecast
-				// char* buf = new char[ bufsize ];
-
-				bool all_ok = true;
-				while (pos < all) {
-					t_safe lenall = all-pos; // length from here to end
-					t_safe len = std::min( chunksize_good , lenall); // take a smaller part
-					CHECK_AND_ASSERT_MES(len<=chunksize_good, false, "len too large");
-					// pos=8; len=4; all=10;	len=3;
-
-                    CHECK_AND_ASSERT_MES(! (len<0), false, "negative len"); // check before we cast away sign:
-                    unsigned long long int len_unsigned = static_cast<long long int>( len );
-                    CHECK_AND_ASSERT_MES(len>0, false, "len not strictly positive"); // (redundant)
-                    CHECK_AND_ASSERT_MES(len_unsigned < std::numeric_limits<size_t>::max(), false, "Invalid len_unsigned");   // yeap we want strong < then max size, to be sure
-					
-					void *chunk_start = ((char*)ptr) + pos;
-					MDEBUG("chunk_start="<<chunk_start<<" ptr="<<ptr<<" pos="<<pos);
-					CHECK_AND_ASSERT_MES(chunk_start >= ptr, false, "Pointer wraparound"); // not wrapped around address?
-					//std::memcpy( (void*)buf, chunk_start, len);
-
-					MDEBUG("part of " << lenall << ": pos="<<pos << " len="<<len);
-
-					bool ok = do_send_chunk(chunk_start, len); // <====== ***
-
-					all_ok = all_ok && ok;
-					if (!all_ok) {
-						MDEBUG("do_send() DONE ***FAILED*** from packet="<<cb<<" B for ptr="<<ptr);
+				MDEBUG("do_send() will SPLIT into small chunks, from packet="<<cb<<" B for ptr="<<(const void*)buffer->data());
+				// the chunks are slices of the same buffer, nothing is copied
+				size_t pos = 0; // current sending position
+				while (pos < cb) {
+					const size_t len = std::min<size_t>(chunksize_good, cb - pos); // take a smaller part
+					MDEBUG("part of " << cb - pos << ": pos="<<pos << " len="<<len);
+
+					if (!do_send_chunk(send_slice{buffer, pos, len, cls})) { // <====== ***
+						MDEBUG("do_send() DONE ***FAILED*** from packet="<<cb<<" B");
 						MDEBUG("do_send() SEND was aborted in middle of big package - this is mostly harmless "
 							<< " (e.g. peer closed connection) but if it causes trouble tell us at #monero-dev. " << cb);
 						return false; // partial failure in sending
 					}
-					pos = pos+len;
-					CHECK_AND_ASSERT_MES(pos >0, false, "pos <= 0");
-
-					// (in catch block, or uniq pointer) delete buf;
+					pos += len;
 				} // each chunk
 
-				MDEBUG("do_send() DONE SPLIT from packet="<<cb<<" B for ptr="<<ptr);
+				MDEBUG("do_send() DONE SPLIT from packet="<<cb<<" B");
 
                 MDEBUG("do_send() m_connection_type = " << m_connection_type);
 
-				return all_ok; // done - e.g. queued - all the chunks of current do_send call
+				return true; // done - e.g. queued - all the chunks of current do_send call
 			} // LOCK: chunking
 		} // a big block (to be chunked) - all chunks
 		else { // small block
-			return do_send_chunk(ptr,cb); // just send as 1 big chunk
+			return do_send_chunk(send_slice{buffer, 0, cb, cls}); // just send as 1 big chunk
 		}
-
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-	} // do_send()
+	} // do_send_buffer()
 
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
+  bool connection<t_protocol_handler>::do_send_chunk(const send_slice& slice)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -515,6 +550,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     if(m_was_shutdown)
       return false;
+    const size_t cb = slice.size;
     {
 		CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
 		m_throttle_speed_out.handle_trafic_exact(cb);
@@ -528,7 +564,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     //some data should be wrote to stream
     //request complete
     
-    // No sleeping here; sleeping is done once and for all in "handle_write"
+    // No sleeping here; the throttle delays the writes in "start_write_throttled"
 
     m_send_que_lock.lock(); // *** critical ***
     epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){m_send_que_lock.unlock();});
@@ -558,16 +594,14 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         }
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
+    m_send_que.push_back(slice);
     
-    if(m_send_que.size() > 1)
+    if(m_send_que_in_flight || m_send_que_throttled)
     { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = cb;
-        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
+        MDEBUG("do_send_chunk() NOW just queues: packet="<<cb<<" B, is added to queue-size="<<m_send_que.size());
         //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
       
-      LOG_TRACE_CC(context, "[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
+      LOG_TRACE_CC(context, "[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size);
     }
     else
     { // no active operation
@@ -578,21 +612,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
             return false;
         }
 
-        auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
+        MDEBUG("do_send_chunk() NOW SENSD: packet="<<cb<<" B");
         if (speed_limit_is_enabled())
-			do_send_handler_write( ptr , size_now ); // (((H)))
+			do_send_handler_write( slice.data() , cb ); // (((H)))
 
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
         reset_timer(get_default_timeout(), false);
-        boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 //strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 //)
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
+        start_write_throttled();
     }
     
     //do_send_handler_stop( ptr , cb ); // empty function
@@ -603,6 +628,52 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   } // do_send_chunk
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write()
+  {
+    // gather a few queued slices into one write, typically a levin header and its body
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t bytes = 0;
+    for (const send_slice& slice: m_send_que)
+    {
+      if (!buffers.empty() && (buffers.size() >= ABSTRACT_SERVER_SEND_GATHER_MAX_COUNT || bytes + slice.size > ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES))
+        break;
+      buffers.push_back(boost::asio::buffer(slice.data(), slice.size));
+      bytes += slice.size;
+    }
+    m_send_que_in_flight = buffers.size();
+    boost::asio::async_write(socket_, buffers,
+                             //strand_.wrap(
+                             boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
+                             //)
+                             );
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write_throttled()
+  {
+    // the buckets were charged for what we wrote, wait until they allow the
+    // next write; the io threads carry on with other connections meanwhile
+    const double wait = speed_limit_is_enabled() ? get_send_wait_time(m_send_que.front().cls) : 0;
+    if (wait <= 0)
+    {
+      start_write();
+      return;
+    }
+
+    MTRACE("Throttling write for " << (long)(wait * 1000) << " ms");
+    m_send_que_throttled = true;
+    auto self = connection<t_protocol_handler>::shared_from_this();
+    m_send_throttle_timer.expires_from_now(boost::posix_time::microseconds((int64_t)(wait * 1000000)));
+    m_send_throttle_timer.async_wait([this, self](const boost::system::error_code& ec) {
+      CRITICAL_REGION_LOCAL(m_send_que_lock);
+      m_send_que_throttled = false;
+      if (ec || m_was_shutdown || m_send_que.empty())
+        return;
+      start_write_throttled();
+    });
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_default_timeout()
   {
     unsigned count;
@@ -676,6 +747,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_was_shutdown = true;
     // Initiate graceful connection closure.
     m_timer.cancel();
+    m_send_throttle_timer.cancel();
+    m_receive_throttle_timer.cancel();
     boost::system::error_code ignored_ec;
     socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     if (!m_host.empty())
@@ -740,11 +813,6 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
     logger_handle_net_write(cb);
 
-                // The single sleeping that is needed for correctly handling "out" speed throttling
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
-
     bool do_shutdown = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
     if(m_send_que.empty())
@@ -753,7 +821,14 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    // the slices stay referenced until written, then drop their share of the buffer
+    CHECK_AND_ASSERT_MES(m_send_que_in_flight <= m_send_que.size(), void(), "Unexpected queue size");
+    for (; m_send_que_in_flight; --m_send_que_in_flight)
+    {
+      if (speed_limit_is_enabled())
+        handle_sent(m_send_que.front().size, m_send_que.front().cls);
+      m_send_que.pop_front();
+    }
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -764,17 +839,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     {
       //have more data to send
 		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
-		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
+		MDEBUG("handle_write() NOW SENDS: packet="<<m_send_que.front().size<<" B" <<", from  queue size="<<m_send_que.size());
 		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) , 
-        // strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-				// )
-        );
-      //_dbg3("(normal)" << size_now);
+			do_send_handler_write_from_queue(e, m_send_que.front().size , m_send_que.size()); // (((H)))
+		start_write_throttled();
     }
     CRITICAL_REGION_END();
 
@@ -859,6 +927,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_address = address;
     m_address_v6 = address_v6;
 
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    MDEBUG("Using io_uring for sockets on port " << port);
+#endif
+
     {
       // Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
       boost::asio::ip::tcp::resolver resolver(io_service_);
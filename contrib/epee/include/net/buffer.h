@@ -48,6 +48,8 @@ public:
   buffer(size_t reserve = 0): offset(0) { storage.reserve(reserve); }
 
   void append(const void *data, size_t sz);
+  // makes room for sz bytes in total past the current offset, so appending up to that point does not reallocate
+  void reserve(size_t sz);
   void erase(size_t sz) { NET_BUFFER_LOG("erasing " << sz << "/" << size()); CHECK_AND_ASSERT_THROW_MES(offset + sz <= storage.size(), "erase: sz too large"); offset += sz; if (offset == storage.size()) { storage.resize(0); offset = 0; } }
   epee::span<const uint8_t> span(size_t sz) const { CHECK_AND_ASSERT_THROW_MES(sz <= size(), "span is too large"); return epee::span<const uint8_t>(storage.data() + offset, sz); }
   // carve must keep the data in scope till next call, other API calls (such as append, erase) can invalidate the carved buffer
@@ -71,6 +71,17 @@ class connection_basic_pimpl; // PIMPL for this class
   
   std::string to_string(t_connection_type type);
 
+  /// A part of a shared buffer waiting in a connection's send queue
+  struct send_slice
+  {
+    shared_buffer buffer;
+    size_t offset;
+    size_t size;
+    traffic_class cls;
+
+    const char* data() const { return buffer->data() + offset; }
+  };
+
 class connection_basic { // not-templated base class for rapid developmet of some code parts
 	public:
 		std::unique_ptr< connection_basic_pimpl > mI; // my Implementation
@@ -79,7 +90,8 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::list<send_slice> m_send_que;
+    size_t m_send_que_in_flight = 0; // slices at the front of m_send_que being written now
     volatile bool m_is_multithreaded;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
@@ -106,15 +118,19 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static void set_rate_down_limit(uint64_t limit);
 		static uint64_t get_rate_up_limit();
 		static uint64_t get_rate_down_limit();
+		static void set_connection_rate_up_limit(uint64_t limit); ///< per connection, 0 for none
+		static void set_connection_rate_down_limit(uint64_t limit); ///< ditto
 
 		// config misc
 		static void set_tos_flag(int tos); // ToS / QoS flag
 		static int get_tos_flag();
 
-		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		// token buckets: count the traffic, then wait as long as they say before the next read or write
+		void handle_sent(size_t packet_size, traffic_class cls);
+		void handle_received(size_t packet_size);
+		double get_send_wait_time(traffic_class cls); ///< seconds
+		double get_receive_wait_time(); ///< seconds
 		static void save_limit_to_file(int limit); ///< for dr-monero
-		static double get_sleep_time(size_t cb);
 		
 		static void set_save_graph(bool save_graph);
 };
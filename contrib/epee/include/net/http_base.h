@@ -30,6 +30,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -194,6 +195,10 @@ namespace net_utils
 			http_header_info    m_header_info;
 			int                 m_http_ver_hi;// OUT paramter only
 			int                 m_http_ver_lo;// OUT paramter only
+			// When set (server side only), m_body is ignored and the body is
+			// sent with chunked transfer encoding: each call fills the next
+			// piece, an empty piece ends the body, false aborts the connection.
+			std::function<bool(std::string&)> m_body_producer;
 
 			void clear()
 			{
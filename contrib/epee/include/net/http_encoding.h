@@ -0,0 +1,102 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+
+namespace epee
+{
+namespace net_utils
+{
+namespace http
+{
+  enum class content_coding : uint8_t
+  {
+    identity,
+    gzip,
+    zstd,
+  };
+
+  //! bodies smaller than this are sent as they are
+  static constexpr size_t HTTP_ENCODE_MIN_BODY_SIZE = 1024;
+
+  //! \return the Content-Encoding token for `coding`
+  const char* content_coding_name(content_coding coding);
+
+  //! \return true if this build can produce `coding`
+  bool content_coding_supported(content_coding coding);
+
+  /*!
+    \brief picks the best coding this build supports from an Accept-Encoding value
+
+    zstd is preferred over gzip at equal q-values; identity is returned when
+    nothing supported is acceptable.
+  */
+  content_coding negotiate_content_coding(const std::string& accept_encoding);
+
+  //! \return false if `coding` is unsupported or compression failed
+  bool encode_body(content_coding coding, const std::string& body, std::string& encoded);
+
+  /*!
+    \brief bounded LRU of recently encoded response bodies
+
+    Responses served from the RPC response caches are byte identical between
+    requests, so each one is only compressed once per coding.  Entries keep
+    the plain body to rule out hash collisions.  Servers opt in through
+    http_server_config::m_cache_encoded_bodies, so wallet responses are
+    never kept.
+  */
+  class encoded_body_cache
+  {
+  public:
+    explicit encoded_body_cache(size_t max_bytes = 16 * 1024 * 1024): m_max_bytes(max_bytes), m_bytes(0) {}
+
+    //! \return false if the body could not be encoded
+    bool get_or_encode(content_coding coding, const std::string& body, std::string& encoded);
+
+  private:
+    struct entry
+    {
+      content_coding coding;
+      size_t hash;
+      std::string body;
+      std::string encoded;
+    };
+
+    std::mutex m_mutex;
+    std::list<entry> m_entries; // most recently used first
+    const size_t m_max_bytes;
+    size_t m_bytes;
+  };
+}
+}
+}
@@ -36,6 +36,7 @@
 #include "to_nonconst_iterator.h"
 #include "http_auth.h"
 #include "http_base.h"
+#include "http_encoding.h"
 
 #undef ANTD_DEFAULT_LOG_CATEGORY
 #define ANTD_DEFAULT_LOG_CATEGORY "net.http"
@@ -57,6 +58,9 @@ namespace net_utils
 			std::vector<std::string> m_access_control_origins;
 			boost::optional<login> m_user;
 			critical_section m_lock;
+			// off by default: a wallet's responses must not outlive the request
+			bool m_cache_encoded_bodies = false;
+			encoded_body_cache m_encoded_bodies;
 		};
 
 		/************************************************************************/
@@ -125,6 +129,8 @@ namespace net_utils
 			bool slash_to_back_slash(std::string& str);
 			std::string get_file_mime_tipe(const std::string& path);
 			std::string get_response_header(const http_response_info& response);
+			void encode_response_body(const http::http_request_info& query_info, http_response_info& response);
+			bool send_chunked_body(http_response_info& response);
 
 			//major function 
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
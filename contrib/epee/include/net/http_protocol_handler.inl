@@ -25,6 +25,7 @@
 // 
 
 
+#include <chrono>
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
 #include "http_protocol_handler.h"
@@ -40,6 +41,8 @@
 #define HTTP_MAX_URI_LEN		 9000 
 #define HTTP_MAX_HEADER_LEN		 100000
 #define HTTP_MAX_STARTING_NEWLINES       8
+#define HTTP_CHUNKED_BODY_MAX_QUEUED     (256 * 1024)
+#define HTTP_CHUNKED_BODY_SEND_TIMEOUT   std::chrono::seconds(30)
 
 namespace epee
 {
@@ -584,12 +587,38 @@ namespace net_utils
 			response.m_response_comment = "OK";
 		}
 
+		if (response.m_body_producer && (query_info.m_http_method == http::http_method_head || query_info.m_http_ver_hi < 1 ||
+				(query_info.m_http_ver_hi == 1 && query_info.m_http_ver_lo < 1)))
+		{
+			// HTTP/1.0 has no chunked encoding, and HEAD needs the full length
+			std::string piece;
+			do
+			{
+				piece.clear();
+				if (!response.m_body_producer(piece))
+				{
+					response.m_body_producer = nullptr;
+					response.m_body.clear();
+					response.m_response_code = 500;
+					response.m_response_comment = "Internal Server Error";
+					break;
+				}
+				response.m_body += piece;
+			} while (!piece.empty());
+			response.m_body_producer = nullptr;
+		}
+
+		if (query_info.m_http_method != http::http_method_head && query_info.m_http_method != http::http_method_options && !response.m_body_producer)
+			encode_response_body(query_info, response);
+
 		std::string response_data = get_response_header(response);
 		//LOG_PRINT_L0("HTTP_SEND: << \r\n" << response_data + response.m_body);
 
     LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
 		
 		m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
+		if (response.m_body_producer)
+			return send_chunked_body(response);
 		if ((response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options))
 			m_psnd_hndlr->do_send((void*)response.m_body.data(), response.m_body.size());
 		m_psnd_hndlr->send_done();
@@ -626,14 +655,103 @@ namespace net_utils
 		return true;
 	}
 	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_chunked_body(http_response_info& response)
+	{
+		std::string piece;
+		char size_line[24];
+		while (true)
+		{
+			// only produce the next piece once most of the previous ones are
+			// written, so a slow reader does not get the whole body queued
+			const auto deadline = std::chrono::steady_clock::now() + HTTP_CHUNKED_BODY_SEND_TIMEOUT;
+			while (m_psnd_hndlr->send_queue_bytes() > HTTP_CHUNKED_BODY_MAX_QUEUED)
+			{
+				if (std::chrono::steady_clock::now() > deadline || !m_psnd_hndlr->call_run_once_service_io())
+				{
+					MDEBUG("Peer is not reading the chunked HTTP body, closing connection");
+					m_want_close = true;
+					m_state = http_state_connection_close;
+					m_psnd_hndlr->close();
+					return false;
+				}
+			}
+			piece.clear();
+			if (!response.m_body_producer(piece))
+			{
+				// the status line is gone already, all we can do is cut the body short
+				MERROR("Failed to produce chunked HTTP body, closing connection");
+				m_want_close = true;
+				m_state = http_state_connection_close;
+				m_psnd_hndlr->close();
+				return false;
+			}
+			const int len = snprintf(size_line, sizeof(size_line), "%zx\r\n", piece.size());
+			if (piece.empty())
+			{
+				static const char last[] = "0\r\n\r\n";
+				m_psnd_hndlr->do_send((void*)last, sizeof(last) - 1);
+				break;
+			}
+			piece += "\r\n";
+			if (!m_psnd_hndlr->do_send((void*)size_line, len) || !m_psnd_hndlr->do_send((void*)piece.data(), piece.size()))
+			{
+				MDEBUG("Peer went away during chunked HTTP body");
+				m_want_close = true;
+				m_state = http_state_connection_close;
+				return false;
+			}
+		}
+		m_psnd_hndlr->send_done();
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::encode_response_body(const http::http_request_info& query_info, http_response_info& response)
+	{
+		if (response.m_response_code != 200 || response.m_body.size() < HTTP_ENCODE_MIN_BODY_SIZE)
+			return;
+		for (const auto& field: response.m_additional_fields)
+			if (!string_tools::compare_no_case(field.first, "Content-Encoding"))
+				return;
+
+		const std::string* accept_encoding = nullptr;
+		for (const auto& field: query_info.m_header_info.m_etc_fields)
+		{
+			if (!string_tools::compare_no_case(field.first, "Accept-Encoding"))
+			{
+				accept_encoding = &field.second;
+				break;
+			}
+		}
+		if (!accept_encoding)
+			return;
+		const content_coding coding = negotiate_content_coding(*accept_encoding);
+		if (coding == content_coding::identity)
+			return;
+
+		std::string encoded;
+		const bool encoded_ok = m_config.m_cache_encoded_bodies
+			? m_config.m_encoded_bodies.get_or_encode(coding, response.m_body, encoded)
+			: encode_body(coding, response.m_body, encoded);
+		if (!encoded_ok || encoded.size() >= response.m_body.size())
+			return;
+		MDEBUG("HTTP body " << response.m_body.size() << " -> " << encoded.size() << " bytes " << content_coding_name(coding));
+		response.m_body.swap(encoded);
+		response.m_additional_fields.push_back(std::make_pair("Content-Encoding", content_coding_name(coding)));
+		response.m_additional_fields.push_back(std::make_pair("Vary", "Accept-Encoding"));
+	}
+	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	std::string simple_http_connection_handler<t_connection_context>::get_response_header(const http_response_info& response)
 	{
 		std::string buf = "HTTP/1.1 ";
 		buf += boost::lexical_cast<std::string>(response.m_response_code) + " " + response.m_response_comment + "\r\n" +
-			"Server: Epee-based\r\n"
-			"Content-Length: ";
-		buf += boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
+			"Server: Epee-based\r\n";
+		if (response.m_body_producer)
+			buf += "Transfer-Encoding: chunked\r\n";
+		else
+			buf += "Content-Length: " + boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
 
 		if(!response.m_mime_tipe.empty())
 		{
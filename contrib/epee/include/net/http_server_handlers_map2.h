@@ -26,6 +26,10 @@
 
 
 #pragma once 
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
 #include "http_base.h"
 #include "jsonrpc_structs.h"
 #include "storages/portable_storage.h"
@@ -117,19 +121,176 @@
 #define END_URI_MAP2() return handled;}
 
 
+namespace epee
+{
+  namespace json_rpc
+  {
+    //! max requests in one JSON-RPC batch array
+    static constexpr size_t MAX_BATCH_REQUESTS = 1000;
+
+    inline void store_error(std::string& body, int64_t code, const std::string& message)
+    {
+      error_response rsp = AUTO_VAL_INIT(rsp);
+      rsp.jsonrpc = "2.0";
+      rsp.error.code = code;
+      rsp.error.message = message;
+      epee::serialization::store_t_to_json(rsp, body);
+    }
+
+    //! true if the body is a JSON array, i.e. a JSON-RPC 2.0 batch
+    inline bool is_batch(const std::string& body)
+    {
+      for (char c: body)
+      {
+        if (c == '[')
+          return true;
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+          return false;
+      }
+      return false;
+    }
+
+    /**
+     * @brief splits a top level JSON array into the text of its elements
+     *
+     * Only tracks nesting and strings, each element is parsed on its own later.
+     */
+    inline bool split_batch(const std::string& body, std::vector<std::string>& items)
+    {
+      size_t i = body.find('[');
+      if (i == std::string::npos)
+        return false;
+      ++i;
+      int depth = 0;
+      bool in_string = false, escaped = false;
+      size_t item_start = i;
+      for (; i < body.size(); ++i)
+      {
+        const char c = body[i];
+        if (in_string)
+        {
+          if (escaped)
+            escaped = false;
+          else if (c == '\\')
+            escaped = true;
+          else if (c == '"')
+            in_string = false;
+          continue;
+        }
+        if (c == '"')
+          in_string = true;
+        else if (c == '{' || c == '[')
+          ++depth;
+        else if ((c == '}' || c == ']') && depth > 0)
+          --depth;
+        else if (depth == 0 && (c == ',' || c == ']'))
+        {
+          const size_t b = body.find_first_not_of(" \t\r\n", item_start);
+          const bool empty = b == std::string::npos || b >= i;
+          if (!empty)
+          {
+            const size_t e = body.find_last_not_of(" \t\r\n", i - 1);
+            items.emplace_back(body, b, e - b + 1);
+          }
+          else if (c == ',' || !items.empty())
+            return false;
+          if (c == ']')
+            return body.find_first_not_of(" \t\r\n", i + 1) == std::string::npos;
+          item_start = i + 1;
+        }
+      }
+      return false;
+    }
+
+    //! runs a batch's jobs one after another, in order
+    inline void run_batch_sequential(const std::vector<std::string>& methods, std::vector<std::function<void()>>& jobs)
+    {
+      for (auto& job: jobs)
+        job();
+    }
+
+    /**
+     * @brief handles a JSON-RPC 2.0 batch: one dispatch per element, answers in order
+     *
+     * The runner is given the method names and one job per element and must
+     * run all of them; it may run independent ones concurrently.
+     */
+    template<class t_dispatch, class t_runner>
+    bool handle_batch(const std::string& body, epee::net_utils::http::http_response_info& response_info, const t_dispatch& dispatch, const t_runner& runner)
+    {
+      std::vector<std::string> items;
+      if (!split_batch(body, items))
+      {
+        store_error(response_info.m_body, -32700, "Parse error");
+        return true;
+      }
+      if (items.empty() || items.size() > MAX_BATCH_REQUESTS)
+      {
+        store_error(response_info.m_body, -32600, "Invalid Request");
+        return true;
+      }
+
+      std::vector<epee::serialization::portable_storage> requests(items.size());
+      std::vector<epee::net_utils::http::http_response_info> responses(items.size());
+      std::vector<std::string> methods(items.size());
+      std::vector<std::function<void()>> jobs(items.size());
+      for (size_t i = 0; i < items.size(); ++i)
+      {
+        if (!requests[i].load_from_json(items[i]))
+        {
+          store_error(responses[i].m_body, -32700, "Parse error");
+          jobs[i] = []{};
+          continue;
+        }
+        requests[i].get_value("method", methods[i], nullptr);
+        epee::serialization::portable_storage& ps = requests[i];
+        epee::net_utils::http::http_response_info& rsp = responses[i];
+        jobs[i] = [&dispatch, &ps, &rsp]() {
+          try
+          {
+            dispatch(ps, rsp);
+          }
+          catch (const std::exception& e)
+          {
+            MERROR("Exception in batched JSON-RPC call: " << e.what());
+            store_error(rsp.m_body, -32603, "Internal error");
+          }
+        };
+      }
+
+      runner(methods, jobs);
+
+      size_t size = 2;
+      for (const auto& rsp: responses)
+        size += rsp.m_body.size() + 1;
+      response_info.m_body.clear();
+      response_info.m_body.reserve(size);
+      response_info.m_body += '[';
+      for (size_t i = 0; i < responses.size(); ++i)
+      {
+        if (i)
+          response_info.m_body += ',';
+        if (responses[i].m_body.empty())
+          store_error(responses[i].m_body, -32603, "Internal error");
+        response_info.m_body += responses[i].m_body;
+      }
+      response_info.m_body += ']';
+      response_info.m_mime_tipe = "application/json";
+      response_info.m_header_info.m_content_type = " application/json";
+      return true;
+    }
+  }
+}
+
+// The method chain is a lambda run once per request object, so that a
+// JSON-RPC 2.0 batch array can dispatch each of its elements in turn.
 #define BEGIN_JSON_RPC_MAP(uri)    else if(query_info.m_URI == uri) \
     { \
-    uint64_t ticks = epee::misc_utils::get_tick_count(); \
-    epee::serialization::portable_storage ps; \
-    if(!ps.load_from_json(query_info.m_body)) \
+    auto json_rpc_dispatch = [&](epee::serialization::portable_storage& ps, epee::net_utils::http::http_response_info& response_info) -> bool \
     { \
-       boost::value_initialized<epee::json_rpc::error_response> rsp; \
-       static_cast<epee::json_rpc::error_response&>(rsp).jsonrpc = "2.0"; \
-       static_cast<epee::json_rpc::error_response&>(rsp).error.code = -32700; \
-       static_cast<epee::json_rpc::error_response&>(rsp).error.message = "Parse error"; \
-       epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
-       return true; \
-    } \
+    bool handled = false; \
+    (void)handled; \
+    uint64_t ticks = epee::misc_utils::get_tick_count(); \
     epee::serialization::storage_entry id_; \
     id_ = epee::serialization::storage_entry(std::string()); \
     ps.get_value("id", id_, nullptr); \
@@ -229,7 +390,10 @@
   return true;\
 }
 
-#define END_JSON_RPC_MAP() \
+#define END_JSON_RPC_MAP() END_JSON_RPC_MAP_BATCH(epee::json_rpc::run_batch_sequential)
+
+// batch_runner(methods, jobs) must run every job; see epee::json_rpc::handle_batch
+#define END_JSON_RPC_MAP_BATCH(batch_runner) \
   epee::json_rpc::error_response rsp; \
   rsp.id = id_; \
   rsp.jsonrpc = "2.0"; \
@@ -237,6 +401,18 @@
   rsp.error.message = "Method not found"; \
   epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
   return true; \
+    }; \
+  handled = true; \
+  if(epee::json_rpc::is_batch(query_info.m_body)) \
+    return epee::json_rpc::handle_batch(query_info.m_body, response_info, json_rpc_dispatch, \
+      [&](const std::vector<std::string>& methods, std::vector<std::function<void()>>& jobs) { batch_runner(methods, jobs); }); \
+  epee::serialization::portable_storage ps; \
+  if(!ps.load_from_json(query_info.m_body)) \
+  { \
+    epee::json_rpc::store_error(response_info.m_body, -32700, "Parse error"); \
+    return true; \
+  } \
+  return json_rpc_dispatch(ps, response_info); \
 }
 
 
@@ -32,6 +32,7 @@
 #include <boost/smart_ptr/make_shared.hpp>
 
 #include <atomic>
+#include <vector>
 
 #include "levin_base.h"
 #include "buffer.h"
@@ -55,6 +56,25 @@ namespace epee
 namespace levin
 {
 
+/*! Builds a notification as a header buffer and a body buffer, so it can be
+    queued on any number of connections without copying it again */
+inline std::vector<net_utils::shared_buffer> make_notify_message(int command, const epee::span<const uint8_t> in_buff)
+{
+  bucket_head2 head = {0};
+  head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
+  head.m_have_to_return_data = false;
+  head.m_cb = SWAP64LE(in_buff.size());
+
+  head.m_command = SWAP32LE(command);
+  head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
+  head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
+
+  return {
+    std::make_shared<const std::string>(reinterpret_cast<const char*>(&head), sizeof(head)),
+    std::make_shared<const std::string>(reinterpret_cast<const char*>(in_buff.data()), in_buff.size())
+  };
+}
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
@@ -91,6 +111,7 @@ public:
   int invoke_async(int command, const epee::span<const uint8_t> in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const epee::span<const uint8_t> in_buff, boost::uuids::uuid connection_id);
+  int notify(const std::vector<net_utils::shared_buffer> &message, boost::uuids::uuid connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -393,6 +414,7 @@ public:
         if(m_cache_in_buffer.size() < m_current_head.m_cb)
         {
           is_continue = false;
+          m_pservice_endpoint->expect_recv(m_current_head.m_cb - m_cache_in_buffer.size());
           if(cb >= MIN_BYTES_WANTED)
           {
             CRITICAL_REGION_LOCAL(m_invoke_response_handlers_lock);
@@ -535,6 +557,8 @@ public:
               << ", connection will be closed.");
             return false;
           }
+          // the body length is known now, so the rest of the message lands in place without reallocating
+          m_cache_in_buffer.reserve(m_current_head.m_cb);
         }
         break;
       default:
@@ -702,6 +726,12 @@ public:
   }
 
   int notify(int command, const epee::span<const uint8_t> in_buff)
+  {
+    return notify(make_notify_message(command, in_buff));
+  }
+  //------------------------------------------------------------------------------------------
+  // message as made by make_notify_message, shared with other connections
+  int notify(const std::vector<net_utils::shared_buffer> &message)
   {
     misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
                           boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -714,32 +744,22 @@ public:
     if(m_deletion_initiated)
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-    bucket_head2 head = {0};
-    head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
-    head.m_have_to_return_data = false;
-    head.m_cb = SWAP64LE(in_buff.size());
+    CHECK_AND_ASSERT_MES(!message.empty() && message.front()->size() == sizeof(bucket_head2), -1, "Invalid notify message");
+    bucket_head2 head;
+    memcpy(&head, message.front()->data(), sizeof(head));
 
-    head.m_command = SWAP32LE(command);
-    head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
-    head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-    {
-      LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
-      return -1;
-    }
-
-    if(!m_pservice_endpoint->do_send(in_buff.data(), in_buff.size()))
+    if(!m_pservice_endpoint->do_send_shared(message, net_utils::get_command_traffic_class(SWAP32LE(head.m_command))))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
       return -1;
     }
     CRITICAL_REGION_END();
-    LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [len=" << head.m_cb <<
-      ", f=" << head.m_flags << 
+    LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [len=" << SWAP64LE(head.m_cb) <<
+      ", f=" << SWAP32LE(head.m_flags) <<
       ", r?=" << head.m_have_to_return_data <<
-      ", cmd = " << head.m_command << 
-      ", ver=" << head.m_protocol_version);
+      ", cmd = " << SWAP32LE(head.m_command) <<
+      ", ver=" << SWAP32LE(head.m_protocol_version));
 
     return 1;
   }
@@ -852,11 +872,26 @@ int async_protocol_handler_config<t_connection_context>::invoke_async(int comman
 template<class t_connection_context> template<class callback_t>
 bool async_protocol_handler_config<t_connection_context>::foreach_connection(const callback_t &cb)
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
+  // Pin every live connection and run the callbacks on that snapshot, so the
+  // registry lock is only held while copying pointers, not across callbacks.
+  std::vector<async_protocol_handler<t_connection_context>*> conns;
+  CRITICAL_REGION_BEGIN(m_connects_lock);
+  conns.reserve(m_connects.size());
   for(auto& c: m_connects)
   {
-    async_protocol_handler<t_connection_context>* aph = c.second;
-    if(!cb(aph->get_context_ref()))
+    if(c.second->start_outer_call())
+      conns.push_back(c.second);
+  }
+  CRITICAL_REGION_END();
+
+  // the pins are released even if a callback throws
+  misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler([&conns]() {
+    for(auto* c: conns)
+      c->finish_outer_call();
+  });
+  for(auto* c: conns)
+  {
+    if(!cb(c->get_context_ref()))
       return false;
   }
   return true;
@@ -865,13 +900,13 @@ bool async_protocol_handler_config<t_connection_context>::foreach_connection(con
 template<class t_connection_context> template<class callback_t>
 bool async_protocol_handler_config<t_connection_context>::for_connection(const boost::uuids::uuid &connection_id, const callback_t &cb)
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
-  async_protocol_handler<t_connection_context>* aph = find_connection(connection_id);
-  if (!aph)
-    return false;
-  if(!cb(aph->get_context_ref()))
+  async_protocol_handler<t_connection_context>* aph;
+  if(LEVIN_OK != find_and_lock_connection(connection_id, aph))
     return false;
-  return true;
+  misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler([aph]() {
+    aph->finish_outer_call();
+  });
+  return cb(aph->get_context_ref());
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
@@ -899,6 +934,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(const std::vector<net_utils::shared_buffer> &message, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(message) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
@@ -31,8 +31,11 @@
 
 #include <boost/uuid/uuid.hpp>
 #include <boost/asio/io_service.hpp>
+#include <memory>
+#include <string>
 #include <typeinfo>
 #include <type_traits>
+#include <vector>
 #include "serialization/keyvalue_serialization.h"
 #include "misc_log_ex.h"
 
@@ -350,12 +353,35 @@ namespace net_utils
 
 	};
 
+  //! immutable refcounted send buffer, queued as is on every connection it goes to
+  typedef std::shared_ptr<const std::string> shared_buffer;
+
+  //! class of outgoing traffic for the throttle: gossip only gets a share of
+  //! the upload limit while other traffic wants it, priority gets the rest
+  enum class traffic_class : uint8_t
+  {
+    priority = 0, // block relay, sync responses and anything not registered
+    gossip
+  };
+
+  //! registers the class of a levin command, done once before connecting
+  void set_command_traffic_class(int command, traffic_class cls);
+  traffic_class get_command_traffic_class(int command);
+
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //! sends the buffers in order; endpoints able to keep a reference instead of a copy override this
+    virtual bool do_send_shared(const std::vector<shared_buffer>& buffers, traffic_class cls = traffic_class::priority)
+    {
+      for (const shared_buffer& buffer: buffers)
+        if (!do_send(buffer->data(), buffer->size()))
+          return false;
+      return true;
+    }
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
@@ -364,6 +390,10 @@ namespace net_utils
     //protect from deletion connection object(with protocol instance) during external call "invoke"
     virtual bool add_ref()=0;
     virtual bool release()=0;
+    //! hint from the protocol handler that at least cb more bytes are needed to complete the current message
+    virtual void expect_recv(size_t cb) {}
+    //! bytes handed to do_send that are not written out yet, 0 if the endpoint does not queue
+    virtual size_t send_queue_bytes() { return 0; }
   protected:
     virtual ~i_service_endpoint() noexcept(false) {}
 	};
@@ -102,16 +102,54 @@ class network_throttle : public i_network_throttle {
 };
 
 /***
- * The complete set of traffic throttle for one typical connection
+@brief Token bucket, refilled at the target speed up to a burst; O(1) per packet
 */
-struct network_throttle_bw {
+class token_bucket {
 	public:
-		network_throttle m_in; ///< for incomming traffic (this we can not controll directly as it depends of what others send to us - usually)
-		network_throttle m_inreq; ///< for requesting incomming traffic (this is exact usually)
-		network_throttle m_out; ///< for outgoing traffic that we just sent (this is exact usually)
+		token_bucket();
+		void set_rate(network_speed_bps rate, network_time_seconds burst, network_time_seconds now); ///< a rate of 0 lets everything through
+		network_speed_bps get_rate() const { return m_rate; }
 
+		void consume(size_t bytes, network_time_seconds now); ///< traffic already sent or received, may leave the bucket in debt
+		network_time_seconds get_wait_time(network_time_seconds now) const; ///< until the bucket is out of debt
+		double get_tokens(network_time_seconds now) const; ///< bytes available now, negative when in debt
+		double get_burst() const { return m_burst; }
+
+	private:
+		void refill(network_time_seconds now);
+
+		network_speed_bps m_rate;
+		double m_burst; // bytes
+		double m_tokens; // bytes
+		network_time_seconds m_last_refill;
+};
+
+/***
+@brief Hierarchical token buckets for one direction: global, per traffic class and per connection
+
+Gossip has its own bucket at a share of the global rate, and may borrow beyond
+it only while the global bucket has spare tokens, so it never holds up block
+relay and sync responses for long. Each connection may be capped on its own.
+*/
+class traffic_shaper {
 	public:
-		network_throttle_bw(const std::string &name1);
+		traffic_shaper();
+		void set_target_speed(network_speed_kbps target);
+		network_speed_kbps get_target_speed() const;
+		void set_connection_speed(network_speed_kbps target); ///< 0 for no per connection cap
+		network_speed_kbps get_connection_speed() const;
+
+		network_time_seconds get_wait_time(token_bucket &connection, traffic_class cls); ///< before sending or receiving more
+		void consume(token_bucket &connection, traffic_class cls, size_t bytes);
+
+		static network_time_seconds get_time_seconds(); ///< monotonic
+
+	private:
+		void update_connection(token_bucket &connection, network_time_seconds now) const;
+
+		token_bucket m_global;
+		token_bucket m_gossip;
+		network_speed_bps m_connection_speed;
 };
 
 
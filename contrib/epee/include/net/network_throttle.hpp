@@ -86,6 +86,7 @@ typedef double network_time_seconds;
 typedef double network_MB;
 
 class i_network_throttle;
+class traffic_shaper;
 
 /***
 @brief All information about given throttle - speed calculations
@@ -100,28 +101,25 @@ typedef calculate_times_struct calculate_times_struct;
 
 
 /*** 
-@brief Access to simple throttles, with singlton to access global network limits
+@brief Access to the global traffic shapers, which hold the node wide network limits
 */
 class network_throttle_manager {
-	// provides global (singleton) in/inreq/out throttle access
+	// provides global (singleton) in/out shaper access
 
 	// [[note1]] see also http://www.nuonsoft.com/blog/2012/10/21/implementing-a-thread-safe-singleton-with-c11/
-	// [[note2]] _inreq is the requested in traffic - we anticipate we will get in-bound traffic soon as result of what we do (e.g. that we sent network downloads requests)
 	
 	//protected:
 	public: // XXX
 
     static boost::mutex m_lock_get_global_throttle_in;
-    static boost::mutex m_lock_get_global_throttle_inreq;
     static boost::mutex m_lock_get_global_throttle_out;
 
 		friend class connection_basic; // FRIEND - to directly access global throttle-s. !! REMEMBER TO USE LOCKS!
 		friend class connection_basic_pimpl; // ditto
 
 	public:
-		static i_network_throttle & get_global_throttle_in(); ///< singleton ; for friend class ; caller MUST use proper locks! like m_lock_get_global_throttle_in
-		static i_network_throttle & get_global_throttle_inreq(); ///< ditto ; use lock ... use m_lock_get_global_throttle_inreq obviously
-		static i_network_throttle & get_global_throttle_out(); ///< ditto ; use lock ... use m_lock_get_global_throttle_out obviously
+		static traffic_shaper & get_global_throttle_in(); ///< singleton ; for friend class ; caller MUST use proper locks! like m_lock_get_global_throttle_in
+		static traffic_shaper & get_global_throttle_out(); ///< ditto ; use lock ... use m_lock_get_global_throttle_out obviously
 };
 
 
@@ -30,6 +30,7 @@
 #include <list>
 #include <vector>
 #include <deque>
+#include <cstring>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/contains_fwd.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
@@ -204,6 +205,33 @@ serialize(Archive &ar, boost::multiprecision::uint128_t &d)
       return res;
     }
     //--------------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type, class t_alloc, class t_storage>
+    static bool serialize_stl_container_pod_val_as_blob(const std::vector<t_pod_type, t_alloc>& container, t_storage& stg, typename t_storage::hsection hparent_section, const char* pname)
+    {
+      if(!container.size()) return true;
+      std::string mb(reinterpret_cast<const char*>(container.data()), sizeof(t_pod_type)*container.size());
+      return stg.set_value(pname, mb, hparent_section);
+    }
+    //--------------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type, class t_alloc, class t_storage>
+    static bool unserialize_stl_container_pod_val_as_blob(std::vector<t_pod_type, t_alloc>& container, t_storage& stg, typename t_storage::hsection hparent_section, const char* pname)
+    {
+      container.clear();
+      std::string buff;
+      bool res = stg.get_value(pname, buff, hparent_section);
+      if(res)
+      {
+        size_t loaded_size = buff.size();
+        CHECK_AND_ASSERT_MES(!(loaded_size%sizeof(t_pod_type)), 
+          false, 
+          "size in blob " << loaded_size << " not have not zero modulo for sizeof(value_type) = " << sizeof(t_pod_type) << ", type " << typeid(t_pod_type).name());
+        container.resize(loaded_size/sizeof(t_pod_type));
+        if(loaded_size)
+          memcpy(container.data(), buff.data(), loaded_size);
+      }
+      return res;
+    }
+    //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
     static bool serialize_stl_container_t_obj  (const stl_container& container, t_storage& stg, typename t_storage::hsection hparent_section, const char* pname)
     {
@@ -0,0 +1,213 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#pragma once
+
+#include <deque>
+#include <sstream>
+#include <string>
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_json.h"
+#include "parserse_base_utils.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Write-only storage for KV_SERIALIZE maps that emits JSON as it goes, */
+    /* with no intermediate portable_storage tree. The layout matches       */
+    /* portable_storage::dump_as_json, but entries come out in the order    */
+    /* they are serialized rather than sorted by name.                      */
+    /************************************************************************/
+    class json_writer
+    {
+      struct frame
+      {
+        bool is_array;
+        bool has_entries;
+        size_t indent;
+      };
+
+    public:
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      json_writer(std::string& out, size_t indent = 0, bool insert_newlines = true)
+        : m_out(out), m_newline(insert_newlines ? "\r\n" : "")
+      {
+        m_out.clear();
+        m_out += '{';
+        m_out += m_newline;
+        m_frames.push_back(frame{false, false, indent});
+      }
+
+      //! closes every open section and array, the output is complete after this
+      void finish()
+      {
+        while (!m_frames.empty())
+          close_back();
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false)
+      {
+        CHECK_AND_ASSERT_MES(create_if_notexist, nullptr, "json_writer can only create sections");
+        frame* parent = begin_entry(section_name, hparent_section);
+        return push_section(parent->indent + 1);
+      }
+
+      template<class t_value>
+      bool set_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+      {
+        frame* parent = begin_entry(value_name, hparent_section);
+        write_value(target, parent->indent + 1);
+        return true;
+      }
+
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+      {
+        frame* parent = begin_entry(value_name, hparent_section);
+        harray array = push_array(parent->indent + 1);
+        write_value(target, array->indent);
+        return array;
+      }
+
+      template<class t_value>
+      bool insert_next_value(harray hval_array, const t_value& target)
+      {
+        close_to(hval_array);
+        m_out += ',';
+        write_value(target, hval_array->indent);
+        return true;
+      }
+
+      harray insert_first_section(const std::string& pSectionName, hsection& hinserted_childsection, hsection hparent_section)
+      {
+        frame* parent = begin_entry(pSectionName, hparent_section);
+        harray array = push_array(parent->indent + 1);
+        hinserted_childsection = push_section(array->indent);
+        return array;
+      }
+
+      bool insert_next_section(harray hSecArray, hsection& hinserted_childsection)
+      {
+        close_to(hSecArray);
+        m_out += ',';
+        hinserted_childsection = push_section(hSecArray->indent);
+        return true;
+      }
+
+    private:
+      frame* resolve(hsection h) { return h ? h : &m_frames.front(); }
+
+      //! the previous sibling and everything below it is complete once the parent is written to again
+      void close_to(frame* target)
+      {
+        while (m_frames.size() > 1 && &m_frames.back() != target)
+          close_back();
+      }
+
+      void close_back()
+      {
+        const frame& f = m_frames.back();
+        if (f.is_array)
+        {
+          m_out += ']';
+        }
+        else
+        {
+          if (f.has_entries)
+            m_out += m_newline;
+          m_out.append(f.indent * 2, ' ');
+          m_out += '}';
+        }
+        m_frames.pop_back();
+      }
+
+      frame* begin_entry(const std::string& name, hsection hparent_section)
+      {
+        frame* parent = resolve(hparent_section);
+        close_to(parent);
+        if (parent->has_entries)
+        {
+          m_out += ',';
+          m_out += m_newline;
+        }
+        parent->has_entries = true;
+        m_out.append((parent->indent + 1) * 2, ' ');
+        m_out += '"';
+        m_out += misc_utils::parse::transform_to_escape_sequence(name);
+        m_out += "\": ";
+        return parent;
+      }
+
+      frame* push_section(size_t indent)
+      {
+        m_out += '{';
+        m_out += m_newline;
+        m_frames.push_back(frame{false, false, indent});
+        return &m_frames.back();
+      }
+
+      frame* push_array(size_t indent)
+      {
+        m_out += '[';
+        m_frames.push_back(frame{true, true, indent});
+        return &m_frames.back();
+      }
+
+      void write_value(const std::string& v, size_t) { m_out += '"'; m_out += misc_utils::parse::transform_to_escape_sequence(v); m_out += '"'; }
+      void write_value(bool v, size_t) { m_out += v ? "true" : "false"; }
+      void write_value(int8_t v, size_t) { m_out += std::to_string(static_cast<int32_t>(v)); }
+      void write_value(uint8_t v, size_t) { m_out += std::to_string(static_cast<int32_t>(v)); }
+      void write_value(int16_t v, size_t) { m_out += std::to_string(v); }
+      void write_value(uint16_t v, size_t) { m_out += std::to_string(v); }
+      void write_value(int32_t v, size_t) { m_out += std::to_string(v); }
+      void write_value(uint32_t v, size_t) { m_out += std::to_string(v); }
+      void write_value(int64_t v, size_t) { m_out += std::to_string(v); }
+      void write_value(uint64_t v, size_t) { m_out += std::to_string(v); }
+      void write_value(double v, size_t)
+      {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", v); // as an ostream's default formatting
+        m_out += buf;
+      }
+      void write_value(const storage_entry& v, size_t indent)
+      {
+        std::stringstream ss;
+        dump_as_json(ss, v, indent, !m_newline.empty());
+        m_out += ss.str();
+      }
+
+      std::string& m_out;
+      const std::string m_newline;
+      std::deque<frame> m_frames; //!< open sections/arrays, the root first; a deque so handles stay valid
+    };
+  }
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+#pragma once
+
+#include <string>
+#include "int-util.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_bin.h"
+#include "portable_storage_template_helper.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /**
+     * @brief writes a portable storage binary document a piece at a time
+     *
+     * For responses too large to build as one object.  The format prefixes
+     * sections and arrays with their entry counts, so the caller states them
+     * before writing the entries; the bytes produced by successive writers
+     * on the same or different buffers simply concatenate.
+     */
+    class bin_stream_writer
+    {
+    public:
+      explicit bin_stream_writer(std::string& out): m_out(out) {}
+
+      //! storage header plus the root section's entry count
+      void begin(size_t root_entries)
+      {
+        const uint32_t sig_a = SWAP32LE(PORTABLE_STORAGE_SIGNATUREA);
+        const uint32_t sig_b = SWAP32LE(PORTABLE_STORAGE_SIGNATUREB);
+        const uint8_t ver = PORTABLE_STORAGE_FORMAT_VER;
+        write((const char*)&sig_a, sizeof(sig_a));
+        write((const char*)&sig_b, sizeof(sig_b));
+        write((const char*)&ver, sizeof(ver));
+        pack_varint(*this, root_entries);
+      }
+
+      void value(const std::string& key, uint64_t v) { pod(key, SERIALIZE_TYPE_UINT64, v); }
+      void value(const std::string& key, bool v) { pod(key, SERIALIZE_TYPE_BOOL, v); }
+      void value(const std::string& key, const std::string& v)
+      {
+        name(key, SERIALIZE_TYPE_STRING);
+        put_string(*this, v);
+      }
+
+      //! starts an array of `count` objects, follow with exactly `count` object() calls
+      void begin_object_array(const std::string& key, size_t count)
+      {
+        name(key, SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY);
+        pack_varint(*this, count);
+      }
+
+      //! one element of an object array, laid out as KV_SERIALIZE would
+      template<class t_struct>
+      bool object(const t_struct& obj)
+      {
+        std::string blob;
+        if (!store_t_to_binary(obj, blob) || blob.size() < HEADER_SIZE)
+          return false;
+        // a stored struct is the header followed by the root section, which
+        // is bytewise what an embedded object looks like
+        m_out.append(blob, HEADER_SIZE, std::string::npos);
+        return true;
+      }
+
+      // stream interface for pack_varint/put_string
+      void write(const char* data, size_t size) { m_out.append(data, size); }
+
+    private:
+      static constexpr size_t HEADER_SIZE = sizeof(uint32_t) * 2 + sizeof(uint8_t);
+
+      void name(const std::string& key, uint8_t type)
+      {
+        CHECK_AND_ASSERT_THROW_MES(key.size() < 256, "storage_entry_name is too long: " << key);
+        const uint8_t len = static_cast<uint8_t>(key.size());
+        write((const char*)&len, 1);
+        write(key.data(), key.size());
+        write((const char*)&type, 1);
+      }
+
+      template<class t_pod>
+      void pod(const std::string& key, uint8_t type, const t_pod& v)
+      {
+        name(key, type);
+        write((const char*)&v, sizeof(v));
+      }
+
+      std::string& m_out;
+    };
+  }
+}
@@ -0,0 +1,495 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "misc_log_ex.h"
+#include "span.h"
+#include "portable_storage.h"
+#include "portable_storage_base.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Read-only storage over a binary portable_storage blob.               */
+    /* load_from_binary walks the blob once and only records where each    */
+    /* value is; nothing is copied until the KV_SERIALIZE map asks for a    */
+    /* value, which is then converted straight from the buffer into the     */
+    /* struct field. The buffer must outlive the view.                      */
+    /************************************************************************/
+    class portable_storage_bin_view
+    {
+      struct view_value
+      {
+        uint8_t type;         //!< SERIALIZE_TYPE_*, with SERIALIZE_FLAG_ARRAY for arrays
+        const uint8_t* data;  //!< scalars, strings and arrays of fixed size values
+        size_t size;          //!< string length or array element count
+        size_t first;         //!< object: index in m_sections; other arrays: first element in m_values
+      };
+      struct view_entry
+      {
+        const char* name;
+        size_t name_len;
+        view_value value;
+      };
+      struct view_section
+      {
+        size_t first;         //!< first entry in m_entries
+        size_t count;
+      };
+      struct view_array
+      {
+        const view_value* value;
+        size_t pos;
+      };
+
+    public:
+      typedef view_section* hsection;
+      typedef view_array* harray;
+      typedef storage_entry meta_entry;
+
+      bool load_from_binary(const epee::span<const uint8_t> source);
+      bool load_from_binary(const std::string& source) { return load_from_binary(epee::strspan<uint8_t>(source)); }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target);
+      harray get_first_section(const std::string& pSectionName, hsection& h_child_section, hsection hparent_section);
+      bool get_next_section(harray hSecArray, hsection& h_child_section);
+
+    private:
+      static size_t fixed_size(uint8_t type);
+      void need(size_t count) const;
+      size_t read_varint();
+      uint8_t read_uint8();
+      void parse_section(size_t index);
+      void parse_value(uint8_t type, view_value& value);
+      void parse_array(uint8_t type, view_value& value);
+
+      const view_entry* find(const std::string& name, hsection hparent_section) const;
+      view_value element(const view_value& array, size_t pos) const;
+      template<class t_value>
+      static void read_value(const view_value& value, t_value& target);
+      static void read_string(const view_value& value, std::string& target) { target.assign((const char*)value.data, value.size); }
+      template<class t_value>
+      static void read_string(const view_value& value, t_value& target) { convert_t(std::string((const char*)value.data, value.size), target); }
+      storage_entry materialize(const view_value& value) const;
+      template<class t_value>
+      array_entry materialize_array(const view_value& value) const;
+
+      const uint8_t* m_ptr = nullptr;
+      size_t m_count = 0;
+      size_t m_depth = 0;
+      std::vector<view_entry> m_entries;
+      std::vector<view_section> m_sections; //!< the root section first
+      std::vector<view_value> m_values;     //!< elements of arrays of strings or objects
+      std::deque<view_array> m_arrays;      //!< iteration state handed out as harray
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_bin_view::load_from_binary(const epee::span<const uint8_t> source)
+    {
+      m_entries.clear();
+      m_sections.clear();
+      m_values.clear();
+      m_arrays.clear();
+      m_depth = 0;
+      // same layout as portable_storage::storage_block_header
+      const size_t header_size = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+      if(source.size() < header_size)
+      {
+        LOG_ERROR("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << header_size);
+        return false;
+      }
+      uint32_t signature_a, signature_b;
+      memcpy(&signature_a, source.data(), sizeof(signature_a));
+      memcpy(&signature_b, source.data() + sizeof(signature_a), sizeof(signature_b));
+      const uint8_t ver = source.data()[2 * sizeof(uint32_t)];
+      if(signature_a != SWAP32LE(PORTABLE_STORAGE_SIGNATUREA) ||
+        signature_b != SWAP32LE(PORTABLE_STORAGE_SIGNATUREB)
+        )
+      {
+        LOG_ERROR("portable_storage: wrong binary format - signature mismatch");
+        return false;
+      }
+      if(ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage: wrong binary format - unknown format ver = " << ver);
+        return false;
+      }
+      TRY_ENTRY();
+      m_ptr = source.data() + header_size;
+      m_count = source.size() - header_size;
+      m_sections.push_back(view_section{0, 0});
+      parse_section(0);
+      return true;
+      CATCH_ENTRY("portable_storage_bin_view::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_bin_view::fixed_size(uint8_t type)
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  return sizeof(int64_t);
+      case SERIALIZE_TYPE_INT32:  return sizeof(int32_t);
+      case SERIALIZE_TYPE_INT16:  return sizeof(int16_t);
+      case SERIALIZE_TYPE_INT8:   return sizeof(int8_t);
+      case SERIALIZE_TYPE_UINT64: return sizeof(uint64_t);
+      case SERIALIZE_TYPE_UINT32: return sizeof(uint32_t);
+      case SERIALIZE_TYPE_UINT16: return sizeof(uint16_t);
+      case SERIALIZE_TYPE_UINT8:  return sizeof(uint8_t);
+      case SERIALIZE_TYPE_DUOBLE: return sizeof(double);
+      case SERIALIZE_TYPE_BOOL:   return sizeof(bool);
+      default:                    return 0;
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_bin_view::need(size_t count) const
+    {
+      CHECK_AND_ASSERT_THROW_MES(m_count >= count, " attempt to read " << count << " bytes from buffer with " << m_count << " bytes remained");
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    uint8_t portable_storage_bin_view::read_uint8()
+    {
+      need(1);
+      const uint8_t v = *m_ptr;
+      ++m_ptr;
+      --m_count;
+      return v;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_bin_view::read_varint()
+    {
+      need(1);
+      uint64_t v = 0;
+      size_t bytes;
+      switch(*m_ptr & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE:  bytes = 1; break;
+      case PORTABLE_RAW_SIZE_MARK_WORD:  bytes = 2; break;
+      case PORTABLE_RAW_SIZE_MARK_DWORD: bytes = 4; break;
+      default:                           bytes = 8; break;
+      }
+      need(bytes);
+      memcpy(&v, m_ptr, bytes);
+      m_ptr += bytes;
+      m_count -= bytes;
+      return SWAP64LE(v) >> 2;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_bin_view::parse_section(size_t index)
+    {
+      CHECK_AND_ASSERT_THROW_MES(++m_depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      const size_t count = read_varint();
+      // each entry takes at least a name length and a type byte
+      CHECK_AND_ASSERT_THROW_MES(count <= m_count / 2, "section entry count " << count << " goes out of remain storage len " << m_count);
+      const size_t first = m_entries.size();
+      m_entries.resize(first + count);
+      m_sections[index] = view_section{first, count};
+      for (size_t i = 0; i < count; ++i)
+      {
+        const uint8_t name_len = read_uint8();
+        need(name_len);
+        m_entries[first + i].name = (const char*)m_ptr;
+        m_entries[first + i].name_len = name_len;
+        m_ptr += name_len;
+        m_count -= name_len;
+        // parsing may grow m_entries, so fill a copy
+        view_value value;
+        parse_value(read_uint8(), value);
+        m_entries[first + i].value = value;
+      }
+      --m_depth;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_bin_view::parse_value(uint8_t type, view_value& value)
+    {
+      if(type & SERIALIZE_FLAG_ARRAY)
+        return parse_array(type & ~SERIALIZE_FLAG_ARRAY, value);
+
+      value = view_value{type, m_ptr, 0, 0};
+      const size_t size = fixed_size(type);
+      if(size)
+      {
+        need(size);
+        m_ptr += size;
+        m_count -= size;
+        return;
+      }
+      switch(type)
+      {
+      case SERIALIZE_TYPE_STRING:
+      {
+        const size_t len = read_varint();
+        CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+        CHECK_AND_ASSERT_THROW_MES(m_count >= len, "string len count value " << len << " goes out of remain storage len " << m_count);
+        value.data = m_ptr;
+        value.size = len;
+        m_ptr += len;
+        m_count -= len;
+        return;
+      }
+      case SERIALIZE_TYPE_OBJECT:
+        value.first = m_sections.size();
+        m_sections.push_back(view_section{0, 0});
+        parse_section(value.first);
+        return;
+      case SERIALIZE_TYPE_ARRAY:
+      {
+        const uint8_t ent_type = read_uint8();
+        CHECK_AND_ASSERT_THROW_MES(ent_type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+        return parse_array(ent_type & ~SERIALIZE_FLAG_ARRAY, value);
+      }
+      default:
+        CHECK_AND_ASSERT_THROW_MES(false, "unknown entry_type code = " << (unsigned)type);
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_bin_view::parse_array(uint8_t type, view_value& value)
+    {
+      CHECK_AND_ASSERT_THROW_MES(++m_depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      CHECK_AND_ASSERT_THROW_MES(type != SERIALIZE_TYPE_ARRAY, "Reading array entry is not supported");
+      CHECK_AND_ASSERT_THROW_MES(type == SERIALIZE_TYPE_STRING || type == SERIALIZE_TYPE_OBJECT || fixed_size(type), "unknown entry_type code = " << (unsigned)type);
+      const size_t count = read_varint();
+      value = view_value{(uint8_t)(type | SERIALIZE_FLAG_ARRAY), m_ptr, count, 0};
+      const size_t size = fixed_size(type);
+      if(size)
+      {
+        CHECK_AND_ASSERT_THROW_MES(count <= m_count / size, "array size " << count << " goes out of remain storage len " << m_count);
+        value.data = m_ptr;
+        m_ptr += count * size;
+        m_count -= count * size;
+      }
+      else
+      {
+        // each string or object takes at least one byte
+        CHECK_AND_ASSERT_THROW_MES(count <= m_count, "array size " << count << " goes out of remain storage len " << m_count);
+        value.first = m_values.size();
+        m_values.resize(value.first + count);
+        for (size_t i = 0; i < count; ++i)
+        {
+          view_value element;
+          parse_value(type, element);
+          m_values[value.first + i] = element;
+        }
+      }
+      --m_depth;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_storage_bin_view::view_entry* portable_storage_bin_view::find(const std::string& name, hsection hparent_section) const
+    {
+      const view_section& section = hparent_section ? *hparent_section : m_sections.front();
+      for (size_t i = section.first; i < section.first + section.count; ++i)
+      {
+        const view_entry& entry = m_entries[i];
+        if (entry.name_len == name.size() && memcmp(entry.name, name.data(), entry.name_len) == 0)
+          return &entry;
+      }
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_bin_view::view_value portable_storage_bin_view::element(const view_value& array, size_t pos) const
+    {
+      const uint8_t type = array.type & ~SERIALIZE_FLAG_ARRAY;
+      const size_t size = fixed_size(type);
+      if (size)
+        return view_value{type, array.data + pos * size, 0, 0};
+      return m_values[array.first + pos];
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_bin_view::read_value(const view_value& value, t_value& target)
+    {
+#define EPEE_BIN_VIEW_CONVERT(code, type) case code: { type v; memcpy(&v, value.data, sizeof(v)); convert_t(v, target); return; }
+      switch(value.type)
+      {
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_INT64, int64_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_INT32, int32_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_INT16, int16_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_INT8, int8_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_UINT64, uint64_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_UINT32, uint32_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_UINT16, uint16_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_UINT8, uint8_t)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_DUOBLE, double)
+      EPEE_BIN_VIEW_CONVERT(SERIALIZE_TYPE_BOOL, bool)
+      case SERIALIZE_TYPE_STRING: read_string(value, target); return;
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from entry type " << (unsigned)value.type << " to type " << typeid(target).name());
+      }
+#undef EPEE_BIN_VIEW_CONVERT
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_bin_view::hsection portable_storage_bin_view::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      CHECK_AND_ASSERT_MES(!create_if_notexist, nullptr, "portable_storage_bin_view is read only");
+      const view_entry* entry = find(section_name, hparent_section);
+      if (!entry || entry->value.type != SERIALIZE_TYPE_OBJECT)
+        return nullptr;
+      return &m_sections[entry->value.first];
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_bin_view::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const view_entry* entry = find(value_name, hparent_section);
+      if (!entry)
+        return false;
+      read_value(entry->value, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_bin_view::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const view_entry* entry = find(value_name, hparent_section);
+      if (!entry)
+        return false;
+      val = materialize(entry->value);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_bin_view::harray portable_storage_bin_view::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const view_entry* entry = find(value_name, hparent_section);
+      if (!entry || !(entry->value.type & SERIALIZE_FLAG_ARRAY) || !entry->value.size)
+        return nullptr;
+      read_value(element(entry->value, 0), target);
+      m_arrays.push_back(view_array{&entry->value, 1});
+      return &m_arrays.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_bin_view::get_next_value(harray hval_array, t_value& target)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      CHECK_AND_ASSERT(hval_array, false);
+      if (hval_array->pos >= hval_array->value->size)
+        return false;
+      read_value(element(*hval_array->value, hval_array->pos++), target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_bin_view::harray portable_storage_bin_view::get_first_section(const std::string& sec_name, hsection& h_child_section, hsection hparent_section)
+    {
+      const view_entry* entry = find(sec_name, hparent_section);
+      if (!entry || entry->value.type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !entry->value.size)
+        return nullptr;
+      h_child_section = &m_sections[m_values[entry->value.first].first];
+      m_arrays.push_back(view_array{&entry->value, 1});
+      return &m_arrays.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_bin_view::get_next_section(harray hSecArray, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hSecArray, false);
+      if (hSecArray->pos >= hSecArray->value->size)
+        return false;
+      h_child_section = &m_sections[m_values[hSecArray->value->first + hSecArray->pos++].first];
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    array_entry portable_storage_bin_view::materialize_array(const view_value& value) const
+    {
+      array_entry_t<t_value> a;
+      a.reserve(value.size);
+      for (size_t i = 0; i < value.size; ++i)
+      {
+        t_value v;
+        read_value(element(value, i), v);
+        a.m_array.push_back(std::move(v));
+      }
+      return array_entry(std::move(a));
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    storage_entry portable_storage_bin_view::materialize(const view_value& value) const
+    {
+#define EPEE_BIN_VIEW_MATERIALIZE(code, type) \
+      case code: { type v; read_value(value, v); return storage_entry(v); } \
+      case code | SERIALIZE_FLAG_ARRAY: return storage_entry(materialize_array<type>(value));
+      switch(value.type)
+      {
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_INT64, int64_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_INT32, int32_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_INT16, int16_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_INT8, int8_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_UINT64, uint64_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_UINT32, uint32_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_UINT16, uint16_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_UINT8, uint8_t)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_DUOBLE, double)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_BOOL, bool)
+      EPEE_BIN_VIEW_MATERIALIZE(SERIALIZE_TYPE_STRING, std::string)
+      case SERIALIZE_TYPE_OBJECT:
+      {
+        section s;
+        const view_section& vs = m_sections[value.first];
+        for (size_t i = vs.first; i < vs.first + vs.count; ++i)
+          s.m_entries.insert(std::make_pair(std::string(m_entries[i].name, m_entries[i].name_len), materialize(m_entries[i].value)));
+        return storage_entry(std::move(s));
+      }
+      case SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY:
+      {
+        array_entry_t<section> a;
+        a.reserve(value.size);
+        for (size_t i = 0; i < value.size; ++i)
+          a.m_array.push_back(boost::get<section>(materialize(m_values[value.first + i])));
+        return storage_entry(array_entry(std::move(a)));
+      }
+      default:
+        ASSERT_MES_AND_THROW("unknown entry_type code = " << (unsigned)value.type);
+      }
+#undef EPEE_BIN_VIEW_MATERIALIZE
+    }
+  }
+}
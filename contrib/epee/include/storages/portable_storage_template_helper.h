@@ -30,6 +30,8 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "json_writer.h"
+#include "portable_storage_bin_view.h"
 #include "file_io_utils.h"
 
 namespace epee
@@ -61,9 +63,9 @@ namespace epee
     template<class t_struct>
     bool store_t_to_json(t_struct& str_in, std::string& json_buff, size_t indent = 0, bool insert_newlines = true)
     {
-      portable_storage ps;
-      str_in.store(ps);
-      ps.dump_as_json(json_buff, indent, insert_newlines);
+      json_writer writer(json_buff, indent, insert_newlines);
+      str_in.store(writer);
+      writer.finish();
       return true;
     }
     //-----------------------------------------------------------------------------------------------------------
@@ -86,7 +88,7 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const epee::span<const uint8_t> binary_buff)
     {
-      portable_storage ps;
+      portable_storage_bin_view ps;
       bool rs = ps.load_from_binary(binary_buff);
       if(!rs)
         return false;
@@ -26,6 +26,7 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <string.h>
 #include "net/buffer.h"
 
@@ -37,6 +38,18 @@ namespace epee
 namespace net_utils
 {
 
+void buffer::reserve(size_t sz)
+{
+  if (storage.capacity() - offset >= sz)
+    return;
+  NET_BUFFER_LOG("reserving " << sz << " from " << size());
+  std::vector<uint8_t> new_storage;
+  new_storage.reserve(std::max(sz, size()));
+  new_storage.insert(new_storage.end(), storage.begin() + offset, storage.end());
+  offset = 0;
+  std::swap(storage, new_storage);
+}
+
 void buffer::append(const void *data, size_t sz)
 {
   const size_t capacity = storage.capacity();
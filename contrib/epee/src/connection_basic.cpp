@@ -80,8 +80,8 @@ class connection_basic_pimpl {
 
 		static int m_default_tos;
 
-		network_throttle_bw m_throttle; // per-perr
-    critical_section m_throttle_lock;
+		token_bucket m_bucket_in; // per-peer, guarded by the lock of the global shaper in
+		token_bucket m_bucket_out; // ditto, out
 
 		int m_peer_number; // e.g. for debug/stats
 };
@@ -103,7 +103,7 @@ namespace net_utils
 // connection_basic_pimpl
 // ================================================================================================
 	
-connection_basic_pimpl::connection_basic_pimpl(const std::string &name) : m_throttle(name) { }
+connection_basic_pimpl::connection_basic_pimpl(const std::string &name) { }
 
 // ================================================================================================
 // connection_basic
@@ -151,14 +151,19 @@ void connection_basic::set_rate_down_limit(uint64_t limit) {
 	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
 		network_throttle_manager::get_global_throttle_in().set_target_speed(limit);
 	}
-
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_inreq );
-		network_throttle_manager::get_global_throttle_inreq().set_target_speed(limit);
-	}
     save_limit_to_file(limit);
 }
 
+void connection_basic::set_connection_rate_up_limit(uint64_t limit) {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
+	network_throttle_manager::get_global_throttle_out().set_connection_speed(limit);
+}
+
+void connection_basic::set_connection_rate_down_limit(uint64_t limit) {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
+	network_throttle_manager::get_global_throttle_in().set_connection_speed(limit);
+}
+
 uint64_t connection_basic::get_rate_up_limit() {
     uint64_t limit;
     {
@@ -188,44 +193,34 @@ int connection_basic::get_tos_flag() {
 	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
-	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) { 
-			_dbg2("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{ 
-			CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size );
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			MTRACE("Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-		}
-	} while(delay > 0);
-
-// XXX LATER XXX
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size ); // increase counter - global
-	}
+void connection_basic::handle_sent(size_t packet_size, traffic_class cls) {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
+	network_throttle_manager::get_global_throttle_out().consume(mI->m_bucket_out, cls, packet_size);
+}
+
+void connection_basic::handle_received(size_t packet_size) {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
+	network_throttle_manager::get_global_throttle_in().consume(mI->m_bucket_in, traffic_class::priority, packet_size);
+}
 
+double connection_basic::get_send_wait_time(traffic_class cls) {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
+	return network_throttle_manager::get_global_throttle_out().get_wait_time(mI->m_bucket_out, cls);
+}
+
+double connection_basic::get_receive_wait_time() {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
+	return network_throttle_manager::get_global_throttle_in().get_wait_time(mI->m_bucket_in, traffic_class::priority);
 }
 
 void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
-        // No sleeping here; sleeping is done once and for all in connection<t_protocol_handler>::handle_write
-	MTRACE("handler_write (direct) - before ASIO write, for packet="<<cb<<" B (after sleep)");
+        // No sleeping here; the throttle delays writes in connection<t_protocol_handler>::start_write_throttled
+	MTRACE("handler_write (direct) - before ASIO write, for packet="<<cb<<" B");
 }
 
 void connection_basic::do_send_handler_write_from_queue( const boost::system::error_code& e, size_t cb, int q_len ) {
-        // No sleeping here; sleeping is done once and for all in connection<t_protocol_handler>::handle_write
-	MTRACE("handler_write (after write, from queue="<<q_len<<") - before ASIO write, for packet="<<cb<<" B (after sleep)");
+        // No sleeping here; the throttle delays writes in connection<t_protocol_handler>::start_write_throttled
+	MTRACE("handler_write (after write, from queue="<<q_len<<") - before ASIO write, for packet="<<cb<<" B");
 }
 
 void connection_basic::logger_handle_net_read(size_t size) { // network data read
@@ -234,12 +229,6 @@ void connection_basic::logger_handle_net_read(size_t size) { // network data rea
 void connection_basic::logger_handle_net_write(size_t size) {
 }
 
-double connection_basic::get_sleep_time(size_t cb) {
-	CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_out);
-    auto t = network_throttle_manager::get_global_throttle_out().get_sleep_time(cb);
-    return t;
-}
-
 void connection_basic::set_save_graph(bool save_graph) {
 }
 
@@ -28,27 +28,158 @@
 
 #include "hex.h"
 
-#include <iterator>
+#include <algorithm>
 #include <limits>
 #include <ostream>
 #include <stdexcept>
 
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#elif defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
 namespace epee
 {
   namespace
   {
-    template<typename T>
-    void write_hex(T&& out, const span<const std::uint8_t> src)
+    static constexpr const char hex[] = u8"0123456789abcdef";
+    static_assert(sizeof(hex) == 17, "bad string size");
+
+    static const constexpr unsigned char isx[256] =
+    {
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0,    1,    2,    3,    4,    5,    6,    7,    8,    9, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff,   10,   11,   12,   13,   14,   15, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff,   10,   11,   12,   13,   14,   15, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    };
+
+    // bytes per vector step; SSE2 is always there on x86_64 and NEON on
+    // aarch64, so neither needs a runtime check
+    constexpr std::size_t hex_block = 16;
+
+    //! Write `src` as hex to `out`, 16 bytes at a time where possible.
+    void write_hex(char* out, const std::uint8_t* src, std::size_t size) noexcept
+    {
+#if defined(__SSE2__)
+      const __m128i low_nibble = _mm_set1_epi8(0x0f);
+      const __m128i nine = _mm_set1_epi8(9);
+      const __m128i zero_char = _mm_set1_epi8('0');
+      const __m128i letter_gap = _mm_set1_epi8('a' - '0' - 10);
+      const auto to_chars = [&](const __m128i nibbles) {
+        const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, nine), letter_gap);
+        return _mm_add_epi8(_mm_add_epi8(nibbles, zero_char), letters);
+      };
+      for (; size >= hex_block; size -= hex_block, src += hex_block, out += 2 * hex_block)
+      {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i high = to_chars(_mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble));
+        const __m128i low = to_chars(_mm_and_si128(bytes, low_nibble));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + hex_block), _mm_unpackhi_epi8(high, low));
+      }
+#elif defined(__aarch64__)
+      const uint8x16_t low_nibble = vdupq_n_u8(0x0f);
+      const uint8x16_t nine = vdupq_n_u8(9);
+      const uint8x16_t zero_char = vdupq_n_u8('0');
+      const uint8x16_t letter_gap = vdupq_n_u8('a' - '0' - 10);
+      const auto to_chars = [&](const uint8x16_t nibbles) {
+        const uint8x16_t letters = vandq_u8(vcgtq_u8(nibbles, nine), letter_gap);
+        return vaddq_u8(vaddq_u8(nibbles, zero_char), letters);
+      };
+      for (; size >= hex_block; size -= hex_block, src += hex_block, out += 2 * hex_block)
+      {
+        const uint8x16_t bytes = vld1q_u8(src);
+        uint8x16x2_t chars;
+        chars.val[0] = to_chars(vshrq_n_u8(bytes, 4));
+        chars.val[1] = to_chars(vandq_u8(bytes, low_nibble));
+        vst2q_u8(reinterpret_cast<std::uint8_t*>(out), chars);
+      }
+#endif
+      for (; size > 0; --size, ++src)
+      {
+        *out++ = hex[*src >> 4];
+        *out++ = hex[*src & 0x0F];
+      }
+    }
+
+    //! Read hex `src` into `out`, which is half its length, 16 bytes at a time where possible.
+    bool read_hex(std::uint8_t* out, const char* src, std::size_t size) noexcept
     {
-      static constexpr const char hex[] = u8"0123456789abcdef";
-      static_assert(sizeof(hex) == 17, "bad string size");
-      for (const std::uint8_t byte : src)
+#if defined(__SSE2__)
+      // there are no unsigned byte compares, so both sides are biased into signed range
+      const __m128i bias = _mm_set1_epi8(char(0x80));
+      const __m128i digits = _mm_set1_epi8(char(0x80 + 10));
+      const __m128i letters = _mm_set1_epi8(char(0x80 + 6));
+      const __m128i lower_case = _mm_set1_epi8(0x20);
+      const __m128i zero_char = _mm_set1_epi8('0');
+      const __m128i a_char = _mm_set1_epi8('a');
+      const __m128i ten = _mm_set1_epi8(10);
+      const __m128i low_byte = _mm_set1_epi16(0xff);
+      // 16 chars to 8 bytes, in the low half of each 16 bit lane
+      const auto to_bytes = [&](const __m128i chars, bool& valid) {
+        const __m128i digit = _mm_sub_epi8(chars, zero_char);
+        const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, lower_case), a_char);
+        const __m128i is_digit = _mm_cmplt_epi8(_mm_xor_si128(digit, bias), digits);
+        const __m128i is_letter = _mm_cmplt_epi8(_mm_xor_si128(letter, bias), letters);
+        valid = _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) == 0xffff;
+        const __m128i nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit), _mm_and_si128(is_letter, _mm_add_epi8(letter, ten)));
+        return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, low_byte), 4), _mm_srli_epi16(nibbles, 8));
+      };
+      for (; size >= 2 * hex_block; size -= 2 * hex_block, src += 2 * hex_block, out += hex_block)
+      {
+        bool valid_low, valid_high;
+        const __m128i low = to_bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), valid_low);
+        const __m128i high = to_bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + hex_block)), valid_high);
+        if (!valid_low || !valid_high)
+          return false;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(low, high));
+      }
+#elif defined(__aarch64__)
+      const uint8x16_t lower_case = vdupq_n_u8(0x20);
+      const uint8x16_t zero_char = vdupq_n_u8('0');
+      const uint8x16_t a_char = vdupq_n_u8('a');
+      const uint8x16_t ten = vdupq_n_u8(10);
+      const uint8x16_t six = vdupq_n_u8(6);
+      const auto to_nibbles = [&](const uint8x16_t chars, uint8x16_t& valid) {
+        const uint8x16_t digit = vsubq_u8(chars, zero_char);
+        const uint8x16_t letter = vsubq_u8(vorrq_u8(chars, lower_case), a_char);
+        const uint8x16_t is_digit = vcltq_u8(digit, ten);
+        valid = vandq_u8(valid, vorrq_u8(is_digit, vcltq_u8(letter, six)));
+        return vbslq_u8(is_digit, digit, vaddq_u8(letter, ten));
+      };
+      for (; size >= 2 * hex_block; size -= 2 * hex_block, src += 2 * hex_block, out += hex_block)
       {
-        *out = hex[byte >> 4];
-        ++out;
-        *out = hex[byte & 0x0F];
-        ++out;
+        const uint8x16x2_t chars = vld2q_u8(reinterpret_cast<const std::uint8_t*>(src));
+        uint8x16_t valid = vdupq_n_u8(0xff);
+        const uint8x16_t high = to_nibbles(chars.val[0], valid);
+        const uint8x16_t low = to_nibbles(chars.val[1], valid);
+        if (vminvq_u8(valid) != 0xff)
+          return false;
+        vst1q_u8(out, vorrq_u8(vshlq_n_u8(high, 4), low));
       }
+#endif
+      for (; size >= 2; size -= 2)
+      {
+        const unsigned char high = isx[(unsigned char)*src++];
+        const unsigned char low = isx[(unsigned char)*src++];
+        if (high == 0xff || low == 0xff)
+          return false;
+        *out++ = (high << 4) | low;
+      }
+      return true;
     }
   }
 
@@ -69,7 +200,22 @@ namespace epee
 
   void to_hex::buffer(std::ostream& out, const span<const std::uint8_t> src)
   {
-    write_hex(std::ostreambuf_iterator<char>{out}, src);
+    // converted through the stack so large blobs are written in a few calls
+    char chunk[512];
+    for (std::size_t offset = 0; offset < src.size(); offset += sizeof(chunk) / 2)
+    {
+      const std::size_t size = std::min(src.size() - offset, sizeof(chunk) / 2);
+      write_hex(chunk, src.data() + offset, size);
+      out.write(chunk, size * 2);
+    }
+  }
+
+  bool to_hex::buffer(span<char> out, const span<const std::uint8_t> src) noexcept
+  {
+    if (out.size() / 2 != src.size() || out.size() % 2)
+      return false;
+    buffer_unchecked(out.data(), src);
+    return true;
   }
 
   void to_hex::formatted(std::ostream& out, const span<const std::uint8_t> src)
@@ -81,6 +227,13 @@ namespace epee
 
   void to_hex::buffer_unchecked(char* out, const span<const std::uint8_t> src) noexcept
   {
-    return write_hex(out, src);
+    return write_hex(out, src.data(), src.size());
+  }
+
+  bool from_hex::to_buffer(span<std::uint8_t> out, const span<const char> src) noexcept
+  {
+    if (src.size() / 2 != out.size() || src.size() % 2)
+      return false;
+    return read_hex(out.data(), src.data(), src.size());
   }
 }
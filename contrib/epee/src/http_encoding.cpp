@@ -0,0 +1,228 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "net/http_encoding.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "misc_log_ex.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "net.http"
+
+namespace epee
+{
+namespace net_utils
+{
+namespace http
+{
+  namespace
+  {
+    std::string trim_lower(const std::string& s, size_t begin, size_t end)
+    {
+      while (begin < end && std::isspace(static_cast<unsigned char>(s[begin])))
+        ++begin;
+      while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1])))
+        --end;
+      std::string out = s.substr(begin, end - begin);
+      for (char& c: out)
+        c = std::tolower(static_cast<unsigned char>(c));
+      return out;
+    }
+
+#ifdef HAVE_ZLIB
+    bool gzip_body(const std::string& body, std::string& encoded)
+    {
+      z_stream zs{};
+      // 15 window bits, +16 for a gzip rather than zlib wrapper
+      if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+      encoded.resize(deflateBound(&zs, body.size()));
+      zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+      zs.avail_in = body.size();
+      zs.next_out = reinterpret_cast<Bytef*>(&encoded[0]);
+      zs.avail_out = encoded.size();
+      const int ret = deflate(&zs, Z_FINISH);
+      deflateEnd(&zs);
+      if (ret != Z_STREAM_END)
+      {
+        MERROR("Failed to gzip HTTP body: " << ret);
+        return false;
+      }
+      encoded.resize(zs.total_out);
+      return true;
+    }
+#endif
+
+#ifdef HAVE_ZSTD
+    bool zstd_body(const std::string& body, std::string& encoded)
+    {
+      encoded.resize(ZSTD_compressBound(body.size()));
+      ZSTD_CCtx* cctx = ZSTD_createCCtx();
+      if (!cctx)
+        return false;
+      const size_t size = ZSTD_compressCCtx(cctx, &encoded[0], encoded.size(), body.data(), body.size(), 3);
+      ZSTD_freeCCtx(cctx);
+      if (ZSTD_isError(size))
+      {
+        MERROR("Failed to zstd HTTP body: " << ZSTD_getErrorName(size));
+        return false;
+      }
+      encoded.resize(size);
+      return true;
+    }
+#endif
+  }
+
+  const char* content_coding_name(content_coding coding)
+  {
+    switch (coding)
+    {
+      case content_coding::gzip: return "gzip";
+      case content_coding::zstd: return "zstd";
+      default: return "identity";
+    }
+  }
+
+  bool content_coding_supported(content_coding coding)
+  {
+    switch (coding)
+    {
+      case content_coding::identity: return true;
+#ifdef HAVE_ZLIB
+      case content_coding::gzip: return true;
+#endif
+#ifdef HAVE_ZSTD
+      case content_coding::zstd: return true;
+#endif
+      default: return false;
+    }
+  }
+
+  content_coding negotiate_content_coding(const std::string& accept_encoding)
+  {
+    // q-values in thousandths, -1 when not mentioned
+    int q_gzip = -1, q_zstd = -1, q_any = -1;
+    size_t pos = 0;
+    while (pos <= accept_encoding.size())
+    {
+      size_t end = accept_encoding.find(',', pos);
+      if (end == std::string::npos)
+        end = accept_encoding.size();
+      const size_t semi = accept_encoding.find(';', pos);
+      const size_t name_end = semi < end ? semi : end;
+      const std::string name = trim_lower(accept_encoding, pos, name_end);
+      int q = 1000;
+      if (semi < end)
+      {
+        const std::string param = trim_lower(accept_encoding, semi + 1, end);
+        if (param.compare(0, 2, "q=") == 0)
+          q = static_cast<int>(std::strtod(param.c_str() + 2, nullptr) * 1000 + 0.5);
+      }
+      if (name == "gzip" || name == "x-gzip")
+        q_gzip = q;
+      else if (name == "zstd")
+        q_zstd = q;
+      else if (name == "*")
+        q_any = q;
+      pos = end + 1;
+    }
+    if (q_gzip < 0) q_gzip = q_any;
+    if (q_zstd < 0) q_zstd = q_any;
+
+    content_coding best = content_coding::identity;
+    int best_q = 0;
+    if (content_coding_supported(content_coding::zstd) && q_zstd > best_q)
+    {
+      best = content_coding::zstd;
+      best_q = q_zstd;
+    }
+    if (content_coding_supported(content_coding::gzip) && q_gzip > best_q)
+      best = content_coding::gzip;
+    return best;
+  }
+
+  bool encode_body(content_coding coding, const std::string& body, std::string& encoded)
+  {
+    switch (coding)
+    {
+#ifdef HAVE_ZLIB
+      case content_coding::gzip: return gzip_body(body, encoded);
+#endif
+#ifdef HAVE_ZSTD
+      case content_coding::zstd: return zstd_body(body, encoded);
+#endif
+      default: return false;
+    }
+  }
+
+  bool encoded_body_cache::get_or_encode(content_coding coding, const std::string& body, std::string& encoded)
+  {
+    const size_t hash = std::hash<std::string>()(body);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+      {
+        if (it->coding == coding && it->hash == hash && it->body == body)
+        {
+          m_entries.splice(m_entries.begin(), m_entries, it);
+          encoded = it->encoded;
+          return true;
+        }
+      }
+    }
+
+    if (!encode_body(coding, body, encoded))
+      return false;
+
+    const size_t size = body.size() + encoded.size();
+    if (size > m_max_bytes / 4)
+      return true; // too big to be worth keeping
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_front(entry{coding, hash, body, encoded});
+    m_bytes += size;
+    while (m_bytes > m_max_bytes && !m_entries.empty())
+    {
+      m_bytes -= m_entries.back().body.size() + m_entries.back().encoded.size();
+      m_entries.pop_back();
+    }
+    return true;
+  }
+}
+}
+}
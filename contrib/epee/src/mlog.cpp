@@ -36,9 +36,17 @@
 #endif
 
 #include <time.h>
+#include <algorithm>
 #include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include "string_tools.h"
 #include "misc_os_dependent.h"
 #include "misc_log_ex.h"
@@ -120,6 +128,330 @@ static const char *get_default_categories(int level)
   return categories;
 }
 
+static void rotate_log_files(const std::string &filename_base, const std::size_t max_log_files, const char *name)
+{
+  std::string rname = generate_log_filename(filename_base.c_str());
+  int ret = rename(name, rname.c_str());
+  if (ret < 0)
+  {
+    // can't log a failure, but don't do the file removal below
+    return;
+  }
+  if (max_log_files != 0)
+  {
+    std::vector<boost::filesystem::path> found_files;
+    const boost::filesystem::directory_iterator end_itr;
+    const boost::filesystem::path filename_base_path(filename_base);
+    const boost::filesystem::path parent_path = filename_base_path.has_parent_path() ? filename_base_path.parent_path() : ".";
+    for (boost::filesystem::directory_iterator iter(parent_path); iter != end_itr; ++iter)
+    {
+      const std::string filename = iter->path().string();
+      if (filename.size() >= filename_base.size() && std::memcmp(filename.data(), filename_base.data(), filename_base.size()) == 0)
+      {
+        found_files.push_back(iter->path());
+      }
+    }
+    if (found_files.size() >= max_log_files)
+    {
+      std::sort(found_files.begin(), found_files.end(), [](const boost::filesystem::path &a, const boost::filesystem::path &b) {
+        boost::system::error_code ec;
+        std::time_t ta = boost::filesystem::last_write_time(boost::filesystem::path(a), ec);
+        if (ec)
+        {
+          MERROR("Failed to get timestamp from " << a << ": " << ec);
+          ta = std::time(nullptr);
+        }
+        std::time_t tb = boost::filesystem::last_write_time(boost::filesystem::path(b), ec);
+        if (ec)
+        {
+          MERROR("Failed to get timestamp from " << b << ": " << ec);
+          tb = std::time(nullptr);
+        }
+        static_assert(std::is_integral<time_t>(), "bad time_t");
+        return ta < tb;
+      });
+      for (size_t i = 0; i <= found_files.size() - max_log_files; ++i)
+      {
+        try
+        {
+          boost::system::error_code ec;
+          boost::filesystem::remove(found_files[i], ec);
+          if (ec)
+          {
+            MERROR("Failed to remove " << found_files[i] << ": " << ec);
+          }
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to remove " << found_files[i] << ": " << e.what());
+        }
+      }
+    }
+  }
+}
+
+namespace
+{
+  // lines kept per logging thread before the writer falls behind and they get dropped
+  constexpr std::size_t ASYNC_LOG_RING_SIZE = 4096;
+
+  struct async_log_record
+  {
+    std::uint64_t sequence;
+    std::string line;
+  };
+
+  // filled by one logging thread, emptied by the log writer thread
+  class async_log_ring
+  {
+  public:
+    async_log_ring(): m_records(ASYNC_LOG_RING_SIZE), m_head(0), m_tail(0), m_dropped(0) {}
+
+    //! \return the number of queued lines, or 0 if the line was dropped
+    std::size_t push(std::uint64_t sequence, std::string &&line)
+    {
+      const std::size_t head = m_head.load(std::memory_order_relaxed);
+      const std::size_t tail = m_tail.load(std::memory_order_acquire);
+      if (head - tail == m_records.size())
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+      }
+      async_log_record &record = m_records[head % m_records.size()];
+      record.sequence = sequence;
+      record.line = std::move(line);
+      m_head.store(head + 1, std::memory_order_release);
+      return head + 1 - tail;
+    }
+
+    void drain(std::vector<async_log_record> &out)
+    {
+      const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+      const std::size_t head = m_head.load(std::memory_order_acquire);
+      for (std::size_t i = tail; i != head; ++i)
+      {
+        async_log_record &record = m_records[i % m_records.size()];
+        out.push_back({record.sequence, std::move(record.line)});
+      }
+      m_tail.store(head, std::memory_order_release);
+    }
+
+    bool empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed); }
+    std::uint64_t take_dropped() { return m_dropped.exchange(0, std::memory_order_relaxed); }
+
+  private:
+    std::vector<async_log_record> m_records;
+    std::atomic<std::size_t> m_head;
+    std::atomic<std::size_t> m_tail;
+    std::atomic<std::uint64_t> m_dropped;
+  };
+
+  // Writes the log file from its own thread. Lines are still formatted by the
+  // thread logging them, as easylogging expands the time and thread name then,
+  // but the write, flush and rotation happen here. Lines are ordered across
+  // threads by sequence within each pass of the writer.
+  class async_log_writer
+  {
+  public:
+    async_log_writer(): m_running(false), m_stop(false), m_sequence(0), m_dropped(0), m_max_file_size(0), m_max_files(0), m_file_size(0) {}
+
+    void start(const std::string &filename, std::size_t max_file_size, std::size_t max_files);
+    void stop();
+    bool running() const { return m_running.load(std::memory_order_acquire); }
+    std::uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    void push(std::string &&line, bool urgent)
+    {
+      if (!running())
+        return;
+      const std::uint64_t sequence = m_sequence.fetch_add(1, std::memory_order_relaxed);
+      const std::size_t queued = get_ring().push(sequence, std::move(line));
+      if (queued && (urgent || queued >= ASYNC_LOG_RING_SIZE / 2))
+        m_cond.notify_one();
+    }
+
+  private:
+    struct thread_ring
+    {
+      std::shared_ptr<async_log_ring> ring;
+      explicit thread_ring(async_log_writer &writer): ring(std::make_shared<async_log_ring>())
+      {
+        boost::lock_guard<boost::mutex> lock(writer.m_rings_mutex);
+        writer.m_rings.push_back(ring);
+      }
+    };
+
+    async_log_ring &get_ring()
+    {
+      static thread_local thread_ring local(*this);
+      return *local.ring;
+    }
+
+    void run();
+    void collect(std::vector<async_log_record> &batch, std::uint64_t &dropped);
+    void open_file();
+    void write(const std::string &line);
+
+    std::atomic<bool> m_running;
+    bool m_stop;
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    boost::thread m_thread;
+
+    std::atomic<std::uint64_t> m_sequence;
+    std::atomic<std::uint64_t> m_dropped;
+    boost::mutex m_rings_mutex;
+    // kept past their thread's exit until the writer has emptied them
+    std::vector<std::shared_ptr<async_log_ring>> m_rings;
+
+    // only used by the writer thread while running
+    std::string m_filename;
+    std::size_t m_max_file_size;
+    std::size_t m_max_files;
+    std::ofstream m_file;
+    std::size_t m_file_size;
+  };
+
+  async_log_writer &get_async_log_writer()
+  {
+    // never destroyed: threads may still log while static destructors run
+    static async_log_writer *writer = new async_log_writer();
+    return *writer;
+  }
+
+  class async_log_dispatch_callback : public el::LogDispatchCallback
+  {
+  protected:
+    void handle(const el::LogDispatchData *data) override
+    {
+      if (data->dispatchAction() != el::base::DispatchAction::NormalLog && data->dispatchAction() != el::base::DispatchAction::FileOnlyLog)
+        return;
+      const el::LogMessage *msg = data->logMessage();
+      el::Logger *logger = msg->logger();
+      const bool urgent = msg->level() == el::Level::Error || msg->level() == el::Level::Fatal;
+      async_log_writer &writer = get_async_log_writer();
+
+      // one file line per message line, as the default dispatch does
+      const std::string &text = msg->message();
+      if (text.find('\n') == std::string::npos)
+      {
+        writer.push(logger->logBuilder()->build(msg, true), urgent);
+        return;
+      }
+      std::string::size_type start = 0;
+      while (start < text.size())
+      {
+        std::string::size_type end = text.find('\n', start);
+        if (end == std::string::npos)
+          end = text.size();
+        const std::string line = text.substr(start, end - start);
+        el::LogMessage line_msg(msg->level(), msg->color(), msg->file(), msg->line(), msg->func(), msg->verboseLevel(), logger, &line);
+        writer.push(logger->logBuilder()->build(&line_msg, true), urgent);
+        start = end + 1;
+      }
+    }
+  };
+
+  void async_log_writer::start(const std::string &filename, std::size_t max_file_size, std::size_t max_files)
+  {
+    stop();
+    m_filename = filename;
+    m_max_file_size = max_file_size;
+    m_max_files = max_files;
+    open_file();
+    m_stop = false;
+    m_running.store(true, std::memory_order_release);
+    m_thread = boost::thread([this]() { run(); });
+    el::Helpers::installLogDispatchCallback<async_log_dispatch_callback>("AsyncLogDispatchCallback");
+
+    static std::once_flag stop_at_exit;
+    std::call_once(stop_at_exit, []() { std::atexit([]() { get_async_log_writer().stop(); }); });
+  }
+
+  void async_log_writer::stop()
+  {
+    if (!running())
+      return;
+    el::Helpers::uninstallLogDispatchCallback<async_log_dispatch_callback>("AsyncLogDispatchCallback");
+    m_running.store(false, std::memory_order_release);
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+    m_file.close();
+  }
+
+  void async_log_writer::collect(std::vector<async_log_record> &batch, std::uint64_t &dropped)
+  {
+    boost::lock_guard<boost::mutex> lock(m_rings_mutex);
+    for (auto it = m_rings.begin(); it != m_rings.end(); )
+    {
+      (*it)->drain(batch);
+      dropped += (*it)->take_dropped();
+      // the thread is gone once we hold the only reference, and it wrote nothing after the drain
+      if (it->use_count() == 1 && (*it)->empty())
+        it = m_rings.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  void async_log_writer::run()
+  {
+    std::vector<async_log_record> batch;
+    bool stopping = false;
+    while (!stopping)
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        if (!m_stop)
+          m_cond.wait_for(lock, boost::chrono::milliseconds(100));
+        stopping = m_stop;
+      }
+
+      batch.clear();
+      std::uint64_t dropped = 0;
+      collect(batch, dropped);
+      std::sort(batch.begin(), batch.end(), [](const async_log_record &a, const async_log_record &b) { return a.sequence < b.sequence; });
+      for (const async_log_record &record: batch)
+        write(record.line);
+      if (!batch.empty())
+        m_file.flush();
+
+      if (dropped)
+      {
+        m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+        if (!stopping)
+          MWARNING(dropped << " log lines were dropped, the log writer fell behind");
+      }
+    }
+  }
+
+  void async_log_writer::open_file()
+  {
+    m_file.close();
+    m_file.clear();
+    m_file.open(m_filename, std::ios::out | std::ios::app | std::ios::binary);
+    m_file_size = m_file.is_open() ? (std::size_t)m_file.tellp() : 0;
+  }
+
+  void async_log_writer::write(const std::string &line)
+  {
+    if (!m_file.is_open())
+      return;
+    m_file.write(line.data(), line.size());
+    m_file_size += line.size();
+    if (m_max_file_size && m_file_size >= m_max_file_size)
+    {
+      m_file.close();
+      rotate_log_files(m_filename, m_max_files, m_filename.c_str());
+      open_file();
+    }
+  }
+}
+
 #ifdef WIN32
 bool EnableVTMode()
 {
@@ -145,11 +477,15 @@ bool EnableVTMode()
 }
 #endif
 
-void mlog_configure(const std::string &filename_base, bool console, const std::size_t max_log_file_size, const std::size_t max_log_files)
+void mlog_configure(const std::string &filename_base, bool console, const std::size_t max_log_file_size, const std::size_t max_log_files, bool async)
 {
+  // the async writer owns the log file, easylogging only writes to the console then
+  const bool async_file = async && !filename_base.empty();
+  get_async_log_writer().stop();
+
   el::Configurations c;
   c.setGlobally(el::ConfigurationType::Filename, filename_base);
-  c.setGlobally(el::ConfigurationType::ToFile, "true");
+  c.setGlobally(el::ConfigurationType::ToFile, async_file ? "false" : "true");
   const char *log_format = getenv("MONERO_LOG_FORMAT");
   if (!log_format)
     log_format = MLOG_BASE_FORMAT;
@@ -164,65 +500,10 @@ void mlog_configure(const std::string &filename_base, bool console, const std::s
   el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
   el::Loggers::addFlag(el::LoggingFlag::StrictLogFileSizeCheck);
   el::Helpers::installPreRollOutCallback([filename_base, max_log_files](const char *name, size_t){
-    std::string rname = generate_log_filename(filename_base.c_str());
-    int ret = rename(name, rname.c_str());
-    if (ret < 0)
-    {
-      // can't log a failure, but don't do the file removal below
-      return;
-    }
-    if (max_log_files != 0)
-    {
-      std::vector<boost::filesystem::path> found_files;
-      const boost::filesystem::directory_iterator end_itr;
-      const boost::filesystem::path filename_base_path(filename_base);
-      const boost::filesystem::path parent_path = filename_base_path.has_parent_path() ? filename_base_path.parent_path() : ".";
-      for (boost::filesystem::directory_iterator iter(parent_path); iter != end_itr; ++iter)
-      {
-        const std::string filename = iter->path().string();
-        if (filename.size() >= filename_base.size() && std::memcmp(filename.data(), filename_base.data(), filename_base.size()) == 0)
-        {
-          found_files.push_back(iter->path());
-        }
-      }
-      if (found_files.size() >= max_log_files)
-      {
-        std::sort(found_files.begin(), found_files.end(), [](const boost::filesystem::path &a, const boost::filesystem::path &b) {
-          boost::system::error_code ec;
-          std::time_t ta = boost::filesystem::last_write_time(boost::filesystem::path(a), ec);
-          if (ec)
-          {
-            MERROR("Failed to get timestamp from " << a << ": " << ec);
-            ta = std::time(nullptr);
-          }
-          std::time_t tb = boost::filesystem::last_write_time(boost::filesystem::path(b), ec);
-          if (ec)
-          {
-            MERROR("Failed to get timestamp from " << b << ": " << ec);
-            tb = std::time(nullptr);
-          }
-          static_assert(std::is_integral<time_t>(), "bad time_t");
-          return ta < tb;
-        });
-        for (size_t i = 0; i <= found_files.size() - max_log_files; ++i)
-        {
-          try
-          {
-            boost::system::error_code ec;
-            boost::filesystem::remove(found_files[i], ec);
-            if (ec)
-            {
-              MERROR("Failed to remove " << found_files[i] << ": " << ec);
-            }
-          }
-          catch (const std::exception &e)
-          {
-            MERROR("Failed to remove " << found_files[i] << ": " << e.what());
-          }
-        }
-      }
-    }
+    rotate_log_files(filename_base, max_log_files, name);
   });
+  if (async_file)
+    get_async_log_writer().start(filename_base, max_log_file_size, max_log_files);
   mlog_set_common_prefix();
   const char *monero_log = getenv("MONERO_LOGS");
   if (!monero_log)
@@ -235,6 +516,11 @@ void mlog_configure(const std::string &filename_base, bool console, const std::s
 #endif
 }
 
+std::uint64_t mlog_get_async_dropped()
+{
+  return get_async_log_writer().dropped();
+}
+
 void mlog_set_categories(const char *categories)
 {
   std::string new_categories;
@@ -1,7 +1,10 @@
 
 #include "net/net_utils_base.h"
 
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <unordered_map>
 
 #include "string_tools.h"
 #include "net/local_ip.h"
@@ -96,6 +99,25 @@ namespace epee { namespace net_utils
 		return false;
 	}
 
+  namespace
+  {
+    boost::mutex command_traffic_class_lock;
+    std::unordered_map<int, traffic_class> command_traffic_class;
+  }
+
+  void set_command_traffic_class(int command, traffic_class cls)
+  {
+    boost::lock_guard<boost::mutex> lock(command_traffic_class_lock);
+    command_traffic_class[command] = cls;
+  }
+
+  traffic_class get_command_traffic_class(int command)
+  {
+    boost::lock_guard<boost::mutex> lock(command_traffic_class_lock);
+    const auto i = command_traffic_class.find(command);
+    return i == command_traffic_class.end() ? traffic_class::priority : i->second;
+  }
+
   std::string print_connection_context(const connection_context_base& ctx)
   {
     std::stringstream ss;
@@ -50,6 +50,7 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <limits>
 
 
 
@@ -63,43 +64,6 @@
 #undef ANTD_DEFAULT_LOG_CATEGORY
 #define ANTD_DEFAULT_LOG_CATEGORY "net.throttle"
 
-// ################################################################################################
-// ################################################################################################
-// the "header part". Not separeted out for .hpp because point of this modification is 
-// to rebuild just 1 translation unit while working on this code.
-// (But maybe common parts will be separated out later though - if needed)
-// ################################################################################################
-// ################################################################################################
-
-namespace epee
-{
-namespace net_utils
-{
-
-
-/* ============================================================================ */
-
-class connection_basic_pimpl {
-	public:
-		connection_basic_pimpl(const std::string &name);
-
-		static int m_default_tos;
-
-		network_throttle_bw m_throttle; // per-perr
-    critical_section m_throttle_lock;
-
-		void _packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?) could be used for different kinds of sleep e.g. direct/queue write
-};
-
-
-} // namespace
-} // namespace
-
-
-
-
-
-
 // ################################################################################################
 // ################################################################################################
 // The implementation part
@@ -352,6 +316,129 @@ double network_throttle::get_current_speed() const {
 	return bytes_transferred / ((m_history.size() - 1) * m_slot_size);
 }
 
+// ================================================================================================
+// token_bucket
+// ================================================================================================
+
+token_bucket::token_bucket()
+	: m_rate(0), m_burst(0), m_tokens(0), m_last_refill(0)
+{
+}
+
+void token_bucket::set_rate(network_speed_bps rate, network_time_seconds burst, network_time_seconds now)
+{
+	const bool was_unlimited = m_rate <= 0;
+	refill(now);
+	m_rate = std::max(rate, 0.0);
+	m_burst = m_rate * burst;
+	m_tokens = was_unlimited ? m_burst : std::min(m_tokens, m_burst); // a new limit starts full
+	m_last_refill = now;
+}
+
+void token_bucket::refill(network_time_seconds now)
+{
+	if (m_rate > 0 && now > m_last_refill)
+		m_tokens = std::min(m_burst, m_tokens + (now - m_last_refill) * m_rate);
+	m_last_refill = std::max(m_last_refill, now);
+}
+
+void token_bucket::consume(size_t bytes, network_time_seconds now)
+{
+	if (m_rate <= 0)
+		return;
+	refill(now);
+	m_tokens -= bytes;
+}
+
+double token_bucket::get_tokens(network_time_seconds now) const
+{
+	if (m_rate <= 0)
+		return std::numeric_limits<double>::max();
+	if (now <= m_last_refill)
+		return m_tokens;
+	return std::min(m_burst, m_tokens + (now - m_last_refill) * m_rate);
+}
+
+network_time_seconds token_bucket::get_wait_time(network_time_seconds now) const
+{
+	const double tokens = get_tokens(now);
+	return tokens >= 0 ? 0 : -tokens / m_rate;
+}
+
+// ================================================================================================
+// traffic_shaper
+// ================================================================================================
+
+static const network_time_seconds TRAFFIC_SHAPER_BURST = 1.0; // seconds of traffic a bucket may save up
+static const double TRAFFIC_SHAPER_GOSSIP_SHARE = 0.25; // of the global rate, gossip gets at least that much
+
+traffic_shaper::traffic_shaper()
+	: m_connection_speed(0)
+{
+	set_target_speed(16); // other defaults are probably defined in the command-line parsing code when this class is used e.g. as main global throttle
+}
+
+void traffic_shaper::set_target_speed(network_speed_kbps target)
+{
+	const network_time_seconds now = get_time_seconds();
+	m_global.set_rate(target * 1024, TRAFFIC_SHAPER_BURST, now);
+	m_gossip.set_rate(target * 1024 * TRAFFIC_SHAPER_GOSSIP_SHARE, TRAFFIC_SHAPER_BURST, now);
+	MINFO("Setting LIMIT: " << target << " kbps");
+}
+
+network_speed_kbps traffic_shaper::get_target_speed() const
+{
+	return m_global.get_rate() / 1024;
+}
+
+void traffic_shaper::set_connection_speed(network_speed_kbps target)
+{
+	m_connection_speed = std::max(target, 0.0) * 1024;
+	MINFO("Setting per connection LIMIT: " << target << " kbps");
+}
+
+network_speed_kbps traffic_shaper::get_connection_speed() const
+{
+	return m_connection_speed / 1024;
+}
+
+void traffic_shaper::update_connection(token_bucket &connection, network_time_seconds now) const
+{
+	if (connection.get_rate() != m_connection_speed)
+		connection.set_rate(m_connection_speed, TRAFFIC_SHAPER_BURST, now);
+}
+
+network_time_seconds traffic_shaper::get_wait_time(token_bucket &connection, traffic_class cls)
+{
+	const network_time_seconds now = get_time_seconds();
+	update_connection(connection, now);
+	network_time_seconds wait = std::max(m_global.get_wait_time(now), connection.get_wait_time(now));
+	if (cls == traffic_class::gossip && m_gossip.get_tokens(now) < 0)
+	{
+		// over its share, gossip may only borrow while the link is half idle
+		const double spare = m_global.get_tokens(now) - m_global.get_burst() / 2;
+		const network_time_seconds borrow_wait = spare >= 0 ? 0 : -spare / m_global.get_rate();
+		wait = std::max(wait, std::min(m_gossip.get_wait_time(now), borrow_wait));
+	}
+	return wait;
+}
+
+void traffic_shaper::consume(token_bucket &connection, traffic_class cls, size_t bytes)
+{
+	const network_time_seconds now = get_time_seconds();
+	update_connection(connection, now);
+	m_global.consume(bytes, now);
+	connection.consume(bytes, now);
+	if (cls == traffic_class::gossip && m_gossip.get_tokens(now) >= 0)
+		m_gossip.consume(bytes, now); // borrowed traffic is not charged to the share
+}
+
+network_time_seconds traffic_shaper::get_time_seconds()
+{
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return us / 1000000.;
+}
+
 } // namespace
 } // namespace
 
@@ -2332,8 +2332,35 @@ bool BlockchainBDB::get_full_node_data(std::string& data)
   return false;
 }
 
+void BlockchainBDB::add_full_node_data_delta(const std::string& data)
+{
+}
+
+void BlockchainBDB::get_full_node_data_deltas(std::vector<std::string>& deltas)
+{
+  deltas.clear();
+}
+
 void BlockchainBDB::clear_full_node_data()
 {
 }
 
+void BlockchainBDB::set_full_node_quorum_state(uint64_t height, const std::string& data)
+{
+}
+
+bool BlockchainBDB::get_full_node_quorum_state(uint64_t height, std::string& data)
+{
+  return false;
+}
+
+void BlockchainBDB::remove_full_node_quorum_states_from(uint64_t height)
+{
+}
+
+bool BlockchainBDB::get_articles(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, size_t limit, std::vector<article_index_t> &articles) const
+{
+  return false;
+}
+
 }  // namespace cryptonote
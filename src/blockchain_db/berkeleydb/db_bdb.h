@@ -412,7 +412,13 @@ private:
 
   virtual void set_full_node_data(const std::string& data);
   virtual bool get_full_node_data(std::string& data);
+  virtual void add_full_node_data_delta(const std::string& data);
+  virtual void get_full_node_data_deltas(std::vector<std::string>& deltas);
   virtual void clear_full_node_data();
+  virtual void set_full_node_quorum_state(uint64_t height, const std::string& data);
+  virtual bool get_full_node_quorum_state(uint64_t height, std::string& data);
+  virtual void remove_full_node_quorum_states_from(uint64_t height);
+  virtual bool get_articles(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, size_t limit, std::vector<article_index_t> &articles) const;
 
   bool m_run_checkpoint;
   std::unique_ptr<boost::thread> m_checkpoint_thread;
@@ -88,7 +88,7 @@ const command_line::arg_descriptor<std::string> arg_db_type = {
 };
 const command_line::arg_descriptor<std::string> arg_db_sync_mode = {
   "db-sync-mode"
-, "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[<nblocks_per_sync>[blocks]|<nbytes_per_sync>[bytes]]." 
+, "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[<nblocks_per_sync>[blocks]|<nbytes_per_sync>[bytes]|<max_seconds_between_syncs>seconds|auto]." 
 , "fast:async:250000000bytes"
 };
 const command_line::arg_descriptor<bool> arg_db_salvage  = {
@@ -96,6 +96,11 @@ const command_line::arg_descriptor<bool> arg_db_salvage  = {
 , "Try to salvage a blockchain database if it seems corrupted"
 , false
 };
+const command_line::arg_descriptor<bool> arg_db_compress  = {
+  "db-compress"
+, "Compress transaction data stored in the database (needs zstd support, cannot be turned off later)"
+, false
+};
 
 BlockchainDB *new_db(const std::string& db_type)
 {
@@ -113,6 +118,7 @@ void BlockchainDB::init_options(boost::program_options::options_description& des
   command_line::add_arg(desc, arg_db_type);
   command_line::add_arg(desc, arg_db_sync_mode);
   command_line::add_arg(desc, arg_db_salvage);
+  command_line::add_arg(desc, arg_db_compress);
 }
 
 void BlockchainDB::pop_block()
@@ -377,6 +383,42 @@ uint64_t BlockchainDB::get_output_unlock_time(const uint64_t amount, const uint6
   return odata.unlock_time;
 }
 
+std::vector<uint64_t> BlockchainDB::get_block_timestamps(uint64_t start_height, size_t count) const
+{
+  std::vector<uint64_t> res;
+  res.reserve(count);
+  for (uint64_t height = start_height; height < start_height + count; ++height)
+    res.push_back(get_block_timestamp(height));
+  return res;
+}
+
+std::vector<uint64_t> BlockchainDB::get_block_weights(uint64_t start_height, size_t count) const
+{
+  std::vector<uint64_t> res;
+  res.reserve(count);
+  for (uint64_t height = start_height; height < start_height + count; ++height)
+    res.push_back(get_block_weight(height));
+  return res;
+}
+
+std::vector<uint64_t> BlockchainDB::get_block_long_term_weights(uint64_t start_height, size_t count) const
+{
+  std::vector<uint64_t> res;
+  res.reserve(count);
+  for (uint64_t height = start_height; height < start_height + count; ++height)
+    res.push_back(get_block_long_term_weight(height));
+  return res;
+}
+
+std::vector<difficulty_type> BlockchainDB::get_block_cumulative_difficulties(uint64_t start_height, size_t count) const
+{
+  std::vector<difficulty_type> res;
+  res.reserve(count);
+  for (uint64_t height = start_height; height < start_height + count; ++height)
+    res.push_back(get_block_cumulative_difficulty(height));
+  return res;
+}
+
 transaction BlockchainDB::get_pruned_tx(const crypto::hash& h) const
 {
   transaction tx;
@@ -35,6 +35,7 @@
 #include <boost/program_options.hpp>
 #include "common/command_line.h"
 #include "crypto/hash.h"
+#include "span.h"
 #include "cryptonote_basic/blobdatatype.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/difficulty.h"
@@ -105,6 +106,7 @@ typedef std::pair<crypto::hash, uint64_t> tx_out_index;
 extern const command_line::arg_descriptor<std::string> arg_db_type;
 extern const command_line::arg_descriptor<std::string> arg_db_sync_mode;
 extern const command_line::arg_descriptor<bool, false> arg_db_salvage;
+extern const command_line::arg_descriptor<bool, false> arg_db_compress;
 
 #pragma pack(push, 1)
 
@@ -129,6 +131,22 @@ struct tx_data_t
 };
 #pragma pack(pop)
 
+/**
+ * @brief an entry of the index of articles published in chain transactions
+ *
+ * The hashes are cn_fast_hash of the article's content and publisher, see
+ * get_article_from_tx_extra.
+ */
+#pragma pack(push, 1)
+struct article_index_t
+{
+  crypto::hash txid;
+  uint64_t height;
+  crypto::hash content_hash;
+  crypto::hash publisher_hash;
+};
+#pragma pack(pop)
+
 /**
  * @brief a struct containing txpool per transaction metadata
  */
@@ -157,6 +175,9 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_COMPRESS 0x20
+// with DBF_RDONLY: another process writes to the DB while it is open here
+#define DBF_REPLICA  0x40
 
 /***********************************
  * Exception Definitions
@@ -774,6 +795,21 @@ public:
   virtual void block_txn_stop() = 0;
   virtual void block_txn_abort() = 0;
 
+  /**
+   * @brief starts a read txn for the calling thread, unless one is already active
+   *
+   * While it is active, every read on this thread shares one snapshot of
+   * the db instead of starting and stopping its own txn. See db_read_session.
+   *
+   * @return true if a txn was started, and so block_rtxn_stop() must be called
+   */
+  virtual bool block_rtxn_start() const { return false; }
+
+  /**
+   * @brief stops the read txn started by block_rtxn_start()
+   */
+  virtual void block_rtxn_stop() const {}
+
   virtual void set_hard_fork(HardFork* hf);
 
   // adds a block with the given metadata to the top of the blockchain, returns the new height
@@ -883,6 +919,22 @@ public:
    */
   virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t& height) const = 0;
 
+  /**
+   * @brief fetches a view of the block blob with the given height, without copying it
+   *
+   * The view points into the db's own storage and is only valid while the
+   * calling thread's read txn lasts, so this requires an active
+   * db_read_session (or write txn). Without one, or if the implementation
+   * has no such storage, no view is given and the caller should fall back
+   * to get_block_blob_from_height().
+   *
+   * @param height the height to look for
+   * @param blob return-by-reference the view of the block blob
+   *
+   * @return true if a view was given
+   */
+  virtual bool get_block_blob_view_from_height(uint64_t height, epee::span<const uint8_t> &blob) const { return false; }
+
   /**
    * @brief fetch a block by height
    *
@@ -1009,6 +1061,57 @@ public:
    */
   virtual uint64_t get_block_long_term_weight(const uint64_t& height) const = 0;
 
+  /**
+   * @brief fetch the timestamps of a range of blocks
+   *
+   * The default implementation calls get_block_timestamp for each height;
+   * a subclass may serve the range from a denser store.
+   *
+   * If any block in the range does not exist, BLOCK_DNE is thrown
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks
+   *
+   * @return the timestamps, in height order
+   */
+  virtual std::vector<uint64_t> get_block_timestamps(uint64_t start_height, size_t count) const;
+
+  /**
+   * @brief fetch the weights of a range of blocks
+   *
+   * See get_block_timestamps
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks
+   *
+   * @return the weights, in height order
+   */
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const;
+
+  /**
+   * @brief fetch the long term weights of a range of blocks
+   *
+   * See get_block_timestamps
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks
+   *
+   * @return the long term weights, in height order
+   */
+  virtual std::vector<uint64_t> get_block_long_term_weights(uint64_t start_height, size_t count) const;
+
+  /**
+   * @brief fetch the cumulative difficulties of a range of blocks
+   *
+   * See get_block_timestamps
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks
+   *
+   * @return the cumulative difficulties, in height order
+   */
+  virtual std::vector<difficulty_type> get_block_cumulative_difficulties(uint64_t start_height, size_t count) const;
+
   /**
    * @brief fetch a block's hash
    *
@@ -1503,6 +1606,26 @@ public:
    */
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) = 0;
 
+  /**
+   * @brief starts pruning the blockchain in place, a step at a time
+   *
+   * The pruning seed is set right away, so new transactions are handled as
+   * for a pruned blockchain. Existing ones are pruned by prune_step, which
+   * keeps its progress in the database so it carries on after a restart.
+   *
+   * @param pruning_seed the seed to use, 0 for default (highly recommended)
+   * @return success iff true
+   */
+  virtual bool start_incremental_pruning(uint32_t pruning_seed = 0) = 0;
+
+  /**
+   * @brief prunes the next transactions of an incremental pruning in a single write transaction
+   * @param max_records the maximum number of transactions to go through
+   * @param done set once there is nothing left to prune, or no incremental pruning in progress
+   * @return success iff true
+   */
+  virtual bool prune_step(size_t max_records, bool &done) = 0;
+
   /**
    * @brief prunes recent blockchain changes as needed, iff pruning is enabled
    * @return success iff true
@@ -1658,6 +1781,17 @@ public:
    */
   virtual bool is_read_only() const = 0;
 
+  /**
+   * @brief drop anything cached about blocks at or above a height
+   *
+   * Blocks popped through this instance already keep its caches in step;
+   * this is for a DB opened with DBF_REPLICA, which another process may
+   * have popped blocks from.
+   *
+   * @param height the first height that may have changed
+   */
+  virtual void invalidate_cache_from_height(uint64_t height) {}
+
   /**
    * @brief get disk space requirements
    *
@@ -1691,10 +1825,37 @@ public:
 
   virtual bool get_output_blacklist(std::vector<uint64_t> &blacklist) const = 0;
   virtual void add_output_blacklist(std::vector<uint64_t> const &blacklist) = 0;
+  // The fullnode list is persisted as a full checkpoint (set/get) followed by
+  // a journal of per-block deltas. Setting a new checkpoint drops the journal.
   virtual void set_full_node_data(const std::string& data)               = 0;
   virtual bool get_full_node_data(std::string& data)                     = 0;
+  virtual void add_full_node_data_delta(const std::string& data)         = 0;
+  virtual void get_full_node_data_deltas(std::vector<std::string>& deltas) = 0;
   virtual void clear_full_node_data()                                    = 0;
 
+  // Quorum states that are no longer needed for consensus, kept for RPC queries
+  virtual void set_full_node_quorum_state(uint64_t height, const std::string& data) = 0;
+  virtual bool get_full_node_quorum_state(uint64_t height, std::string& data)       = 0;
+  virtual void remove_full_node_quorum_states_from(uint64_t height)                 = 0;
+
+  /**
+   * @brief get a page of the articles published between two heights
+   *
+   * Articles are returned in chain order. When a publisher hash or a content
+   * hash is given, only the articles matching it are returned.
+   *
+   * @param start_height the first height to look at
+   * @param end_height the last height to look at
+   * @param publisher_hash if not null, only return articles by this publisher
+   * @param content_hash if not null, only return articles with this content
+   * @param offset the number of matching articles to skip
+   * @param limit the maximum number of articles to return
+   * @param articles return-by-reference the matching articles
+   *
+   * @return true if there are more matching articles past the returned page
+   */
+  virtual bool get_articles(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, size_t limit, std::vector<article_index_t> &articles) const = 0;
+
   /**
    * @brief set whether or not to automatically remove logs
    *
@@ -1710,6 +1871,66 @@ public:
 
 };  // class BlockchainDB
 
+/**
+ * @brief groups the db writes made during its lifetime into one batch txn
+ *
+ * Writers which go through LockedTXN-style guards join the batch instead of
+ * committing on their own, so everything is committed at once when the
+ * guard goes away. If a batch is already open, or the guard is not
+ * enabled, it does nothing and the writes commit as they otherwise would.
+ */
+class db_write_batch
+{
+public:
+  db_write_batch(BlockchainDB &db, bool enabled = true): m_db(db), m_active(enabled && db.batch_start()) {}
+  ~db_write_batch()
+  {
+    if (m_active)
+    {
+      try { m_db.batch_stop(); }
+      catch (const std::exception &e) { MERROR("db_write_batch failed to commit: " << e.what()); }
+    }
+  }
+
+  bool active() const { return m_active; }
+
+private:
+  db_write_batch(const db_write_batch&) = delete;
+  db_write_batch &operator=(const db_write_batch&) = delete;
+
+  BlockchainDB &m_db;
+  const bool m_active;
+};
+
+/**
+ * @brief pins one read snapshot of the db on the calling thread for its lifetime
+ *
+ * Handlers doing many lookups (e.g. building RPC responses) hold one of
+ * these so that all the lookups see a consistent view of the db, and so
+ * that each of them does not have to renew and reset its own read txn.
+ * Nested sessions, or sessions on a thread holding a write txn, are no-ops.
+ */
+class db_read_session
+{
+public:
+  explicit db_read_session(const BlockchainDB &db): m_db(db), m_active(db.block_rtxn_start()) {}
+  ~db_read_session()
+  {
+    if (m_active)
+    {
+      try { m_db.block_rtxn_stop(); }
+      catch (const std::exception &e) { MWARNING("db_read_session dtor filtering exception: " << e.what()); }
+    }
+  }
+
+private:
+  db_read_session(const db_read_session&) = delete;
+  db_read_session &operator=(const db_read_session&) = delete;
+
+  const BlockchainDB &m_db;
+  const bool m_active;
+};
+
 BlockchainDB *new_db(const std::string& db_type);
 
 }  // namespace cryptonote
@@ -0,0 +1,180 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <cstring>
+
+#include "misc_log_ex.h"
+#include "key_image_filter.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "blockchain.db"
+
+namespace
+{
+  const uint64_t KEY_IMAGE_FILTER_MAGIC = 0x66696b44544e41ULL; // "ANTDkif"
+  const uint32_t KEY_IMAGE_FILTER_VERSION = 1;
+
+  struct key_image_filter_header
+  {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    crypto::hash top_hash;
+    uint64_t n_key_images;
+    uint64_t n_blocks;
+    uint64_t count;
+  };
+
+  // key images are curve points, so their encoding is already well mixed;
+  // slice it rather than hashing it again
+  inline uint64_t key_image_word(const crypto::key_image &k_image, size_t n)
+  {
+    uint64_t w;
+    memcpy(&w, reinterpret_cast<const unsigned char*>(&k_image) + n * sizeof(w), sizeof(w));
+    return w;
+  }
+
+  // the i-th bit (of 512) to set in the key image's block, from 9 bit slices of words 1 and 2
+  inline uint64_t key_image_bit(const crypto::key_image &k_image, unsigned i)
+  {
+    return (key_image_word(k_image, 1 + i / 4) >> (9 * (i % 4))) & 511;
+  }
+}
+
+namespace cryptonote
+{
+  key_image_filter::key_image_filter(uint64_t expected_count) : m_n_blocks(1), m_count(0)
+  {
+    const uint64_t wanted_blocks = (std::max<uint64_t>(expected_count, 1 << 16) * BITS_PER_KEY + BLOCK_WORDS * 64 - 1) / (BLOCK_WORDS * 64);
+    while (m_n_blocks < wanted_blocks)
+      m_n_blocks <<= 1;
+    m_words.reset(new std::atomic<uint64_t>[m_n_blocks * BLOCK_WORDS]);
+    for (uint64_t i = 0; i < m_n_blocks * BLOCK_WORDS; ++i)
+      m_words[i].store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t key_image_filter::capacity() const
+  {
+    return m_n_blocks * BLOCK_WORDS * 64 / BITS_PER_KEY;
+  }
+
+  void key_image_filter::add(const crypto::key_image &k_image)
+  {
+    std::atomic<uint64_t> *block = &m_words[(key_image_word(k_image, 0) & (m_n_blocks - 1)) * BLOCK_WORDS];
+    for (unsigned i = 0; i < HASHES; ++i)
+    {
+      const uint64_t bit = key_image_bit(k_image, i);
+      block[bit >> 6].fetch_or(uint64_t(1) << (bit & 63), std::memory_order_relaxed);
+    }
+    m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool key_image_filter::may_contain(const crypto::key_image &k_image) const
+  {
+    const std::atomic<uint64_t> *block = &m_words[(key_image_word(k_image, 0) & (m_n_blocks - 1)) * BLOCK_WORDS];
+    for (unsigned i = 0; i < HASHES; ++i)
+    {
+      const uint64_t bit = key_image_bit(k_image, i);
+      if (!(block[bit >> 6].load(std::memory_order_relaxed) & (uint64_t(1) << (bit & 63))))
+        return false;
+    }
+    return true;
+  }
+
+  bool key_image_filter::store(const std::string &filename, const crypto::hash &top_hash, uint64_t n_key_images) const
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      MWARNING("Failed to open " << filename << " for writing");
+      return false;
+    }
+
+    key_image_filter_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = KEY_IMAGE_FILTER_MAGIC;
+    header.version = KEY_IMAGE_FILTER_VERSION;
+    header.top_hash = top_hash;
+    header.n_key_images = n_key_images;
+    header.n_blocks = m_n_blocks;
+    header.count = size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (uint64_t i = 0; i < m_n_blocks * BLOCK_WORDS && out; ++i)
+    {
+      const uint64_t w = m_words[i].load(std::memory_order_relaxed);
+      out.write(reinterpret_cast<const char*>(&w), sizeof(w));
+    }
+    if (!out)
+    {
+      MWARNING("Failed to write key image filter to " << filename);
+      return false;
+    }
+    return true;
+  }
+
+  std::shared_ptr<key_image_filter> key_image_filter::load(const std::string &filename, const crypto::hash &top_hash, uint64_t n_key_images)
+  {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+      return NULL;
+
+    key_image_filter_header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      return NULL;
+    if (header.magic != KEY_IMAGE_FILTER_MAGIC || header.version != KEY_IMAGE_FILTER_VERSION)
+    {
+      MINFO("Ignoring key image filter " << filename << " with unknown format");
+      return NULL;
+    }
+    if (header.top_hash != top_hash || header.n_key_images != n_key_images)
+    {
+      MINFO("Ignoring key image filter " << filename << ": it does not match the DB");
+      return NULL;
+    }
+    if (header.n_blocks == 0 || (header.n_blocks & (header.n_blocks - 1)) || header.n_blocks > (uint64_t(1) << 32))
+      return NULL;
+
+    std::shared_ptr<key_image_filter> filter(new key_image_filter());
+    filter->m_n_blocks = header.n_blocks;
+    filter->m_words.reset(new std::atomic<uint64_t>[header.n_blocks * BLOCK_WORDS]);
+    for (uint64_t i = 0; i < header.n_blocks * BLOCK_WORDS; ++i)
+    {
+      uint64_t w;
+      if (!in.read(reinterpret_cast<char*>(&w), sizeof(w)))
+      {
+        MINFO("Ignoring truncated key image filter " << filename);
+        return NULL;
+      }
+      filter->m_words[i].store(w, std::memory_order_relaxed);
+    }
+    filter->m_count.store(header.count, std::memory_order_relaxed);
+    return filter;
+  }
+}
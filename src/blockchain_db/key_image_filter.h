@@ -0,0 +1,99 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief in-memory blocked bloom filter of spent key images
+   *
+   * Sits in front of the spent key images table so that the common case of
+   * looking up a key image that has not been spent does not have to touch
+   * the DB.  A negative answer is definite; a positive one has to be
+   * confirmed against the DB.  Key images cannot be removed, so key images
+   * of popped blocks only cost false positives until the filter is rebuilt.
+   *
+   * add() and may_contain() may be called concurrently.
+   */
+  class key_image_filter
+  {
+  public:
+    /**
+     * @brief creates an empty filter sized for expected_count key images
+     */
+    explicit key_image_filter(uint64_t expected_count);
+
+    void add(const crypto::key_image &k_image);
+    bool may_contain(const crypto::key_image &k_image) const;
+
+    //! number of key images added since the filter was created
+    uint64_t size() const { return m_count.load(std::memory_order_relaxed); }
+    //! number of key images the filter was sized for; past that the false positive rate climbs
+    uint64_t capacity() const;
+
+    /**
+     * @brief writes the filter to a file, tagged with the DB state it matches
+     *
+     * @param filename the file to write
+     * @param top_hash the hash of the top block of the DB the filter was built from
+     * @param n_key_images the number of spent key images in that DB
+     *
+     * @return true on success
+     */
+    bool store(const std::string &filename, const crypto::hash &top_hash, uint64_t n_key_images) const;
+
+    /**
+     * @brief reads a filter written by store()
+     *
+     * @return the filter, or NULL if the file is missing, corrupt or was written
+     *         for a different top_hash/n_key_images
+     */
+    static std::shared_ptr<key_image_filter> load(const std::string &filename, const crypto::hash &top_hash, uint64_t n_key_images);
+
+  private:
+    key_image_filter() : m_n_blocks(0), m_count(0) {}
+
+    static constexpr uint64_t BLOCK_WORDS = 8; // 512 bit blocks, one cache line
+    static constexpr uint64_t BITS_PER_KEY = 16;
+    static constexpr unsigned HASHES = 8;
+
+    uint64_t m_n_blocks; // always a power of 2
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+    std::atomic<uint64_t> m_count;
+  };
+}
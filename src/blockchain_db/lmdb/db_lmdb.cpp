@@ -34,16 +34,23 @@
 #include <boost/circular_buffer.hpp>
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
+#include <thread>
+#include <unordered_map>
 
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "common/util.h"
 #include "common/pruning.h"
+#include "common/perf_timer.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
 #include "ringct/rctOps.h"
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #undef ANTD_DEFAULT_LOG_CATEGORY
 #define ANTD_DEFAULT_LOG_CATEGORY "blockchain.db.lmdb"
 
@@ -56,7 +63,7 @@ using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
 // Increase when the DB structure changes
-#define VERSION 5
+#define VERSION 6
 
 namespace
 {
@@ -71,6 +78,15 @@ struct pre_rct_output_data_t
 };
 #pragma pack(pop)
 
+#pragma pack(push, 1)
+// What the article_publishers and article_contents tables point back at
+struct mdb_article_ref
+{
+  uint64_t height;
+  crypto::hash txid;
+};
+#pragma pack(pop)
+
 template <typename T>
 inline void throw0(const T &e)
 {
@@ -161,6 +177,15 @@ int BlockchainLMDB::compare_hash32(const MDB_val *a, const MDB_val *b)
   return 0;
 }
 
+int BlockchainLMDB::compare_uint64_hash32(const MDB_val *a, const MDB_val *b)
+{
+  if (const int ret = compare_uint64(a, b))
+    return ret;
+  const MDB_val ha = { a->mv_size - sizeof(uint64_t), (char*)a->mv_data + sizeof(uint64_t) };
+  const MDB_val hb = { b->mv_size - sizeof(uint64_t), (char*)b->mv_data + sizeof(uint64_t) };
+  return compare_hash32(&ha, &hb);
+}
+
 int BlockchainLMDB::compare_string(const MDB_val *a, const MDB_val *b)
 {
   const char *va = (const char*) a->mv_data;
@@ -196,6 +221,10 @@ namespace
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
  *
+ * articles         block ID     [{txn hash, block ID, content hash, publisher hash}...]
+ * article_publishers publisher hash [{block ID, txn hash}...]
+ * article_contents content hash [{block ID, txn hash}...]
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -227,9 +256,29 @@ const char* const LMDB_TXPOOL_BLOB = "txpool_blob";
 const char* const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char* const LMDB_HF_VERSIONS = "hf_versions";
 const char* const LMDB_FULL_NODE_DATA = "full_node_data";
+const char* const LMDB_FULL_NODE_QUORUMS = "full_node_quorums";
+
+const char* const LMDB_ARTICLES = "articles";
+const char* const LMDB_ARTICLE_PUBLISHERS = "article_publishers";
+const char* const LMDB_ARTICLE_CONTENTS = "article_contents";
 
 const char* const LMDB_PROPERTIES = "properties";
 
+// Every named table above. Opening one more table than the env allows fails
+// with MDB_DBS_FULL and takes the whole db down with it, so the limit keeps
+// room for the tables the migrations open on top of these.
+const char* const LMDB_TABLES[] = {
+  LMDB_BLOCKS, LMDB_BLOCK_HEIGHTS, LMDB_BLOCK_INFO,
+  LMDB_TXS, LMDB_TXS_PRUNED, LMDB_TXS_PRUNABLE, LMDB_TXS_PRUNABLE_HASH, LMDB_TXS_PRUNABLE_TIP, LMDB_TX_INDICES, LMDB_TX_OUTPUTS,
+  LMDB_OUTPUT_TXS, LMDB_OUTPUT_AMOUNTS, LMDB_OUTPUT_BLACKLIST, LMDB_SPENT_KEYS,
+  LMDB_TXPOOL_META, LMDB_TXPOOL_BLOB,
+  LMDB_HF_STARTING_HEIGHTS, LMDB_HF_VERSIONS, LMDB_FULL_NODE_DATA, LMDB_FULL_NODE_QUORUMS,
+  LMDB_ARTICLES, LMDB_ARTICLE_PUBLISHERS, LMDB_ARTICLE_CONTENTS,
+  LMDB_PROPERTIES,
+};
+const unsigned int LMDB_MAX_DBS = 32;
+static_assert(sizeof(LMDB_TABLES) / sizeof(LMDB_TABLES[0]) + 4 <= LMDB_MAX_DBS, "LMDB_MAX_DBS leaves no room for the migrations, raise it");
+
 
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
@@ -246,6 +295,64 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
     throw0(cryptonote::DB_OPEN_FAILURE((lmdb_error(error_string + " : ", res) + std::string(" - you may want to start with --db-salvage")).c_str()));
 }
 
+// Codecs for the txs_pruned table. Compressed values are recognized by the zstd frame magic, which
+// a raw pruned tx blob cannot start with (it starts with the tx version varint), so a table may
+// hold a mix of raw values written before compression was enabled and compressed ones.
+enum : uint32_t
+{
+  TXS_PRUNED_CODEC_NONE = 0,
+  TXS_PRUNED_CODEC_ZSTD = 1,
+};
+
+const uint8_t zstd_frame_magic[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+#define TXS_PRUNED_ZSTD_LEVEL 3
+
+inline bool is_compressed_blob(const MDB_val &v)
+{
+  return v.mv_size >= sizeof(zstd_frame_magic) && memcmp(v.mv_data, zstd_frame_magic, sizeof(zstd_frame_magic)) == 0;
+}
+
+#ifdef HAVE_ZSTD
+bool compress_blob(const std::string &in, std::string &out)
+{
+  static thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+  if (!cctx)
+    return false;
+  out.resize(ZSTD_compressBound(in.size()));
+  const size_t res = ZSTD_compressCCtx(cctx.get(), &out[0], out.size(), in.data(), in.size(), TXS_PRUNED_ZSTD_LEVEL);
+  // keep the raw blob if it does not shrink, which is common for small txes
+  if (ZSTD_isError(res) || res >= in.size())
+    return false;
+  out.resize(res);
+  return true;
+}
+#endif
+
+// appends a txs_pruned value to bd, decompressing it if needed
+void append_pruned_blob(const MDB_val &v, cryptonote::blobdata &bd)
+{
+  if (!is_compressed_blob(v))
+  {
+    bd.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+    return;
+  }
+#ifdef HAVE_ZSTD
+  static thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  if (!dctx)
+    throw0(cryptonote::DB_ERROR("Failed to create zstd decompression context"));
+  const unsigned long long size = ZSTD_getFrameContentSize(v.mv_data, v.mv_size);
+  if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN || size == 0 || size > CRYPTONOTE_MAX_TX_SIZE)
+    throw0(cryptonote::DB_ERROR("Invalid compressed tx blob in the db"));
+  const size_t offset = bd.size();
+  bd.resize(offset + size);
+  const size_t res = ZSTD_decompressDCtx(dctx.get(), &bd[offset], size, v.mv_data, v.mv_size);
+  if (ZSTD_isError(res) || res != size)
+    throw0(cryptonote::DB_ERROR((std::string("Failed to decompress tx blob from the db: ") + (ZSTD_isError(res) ? ZSTD_getErrorName(res) : "size mismatch")).c_str()));
+#else
+  throw0(cryptonote::DB_ERROR("Found a compressed tx blob in the db, but this build has no zstd support"));
+#endif
+}
+
 
 }  // anonymous namespace
 
@@ -362,7 +469,8 @@ mdb_txn_safe::mdb_txn_safe(const bool check) : m_txn(NULL), m_tinfo(NULL), m_che
 {
   if (check)
   {
-    while (creation_gate.test_and_set());
+    while (creation_gate.test_and_set())
+      std::this_thread::yield();
     num_active_txns++;
     creation_gate.clear();
   }
@@ -411,6 +519,7 @@ void mdb_txn_safe::commit(std::string message)
     message = "Failed to commit a transaction to the db";
   }
 
+  PERF_TIMER(lmdb_txn_commit);
   if (auto result = mdb_txn_commit(m_txn))
   {
     m_txn = nullptr;
@@ -440,12 +549,14 @@ uint64_t mdb_txn_safe::num_active_tx() const
 
 void mdb_txn_safe::prevent_new_txns()
 {
-  while (creation_gate.test_and_set());
+  while (creation_gate.test_and_set())
+    std::this_thread::yield();
 }
 
 void mdb_txn_safe::wait_no_active_txns()
 {
-  while (num_active_txns > 0);
+  while (num_active_txns > 0)
+    std::this_thread::yield();
 }
 
 void mdb_txn_safe::allow_new_txns()
@@ -456,6 +567,7 @@ void mdb_txn_safe::allow_new_txns()
 void lmdb_resized(MDB_env *env)
 {
   mdb_txn_safe::prevent_new_txns();
+  PERF_TIMER_START(lmdb_resize_blocked);
 
   MGINFO("LMDB map resize detected.");
 
@@ -473,9 +585,10 @@ void lmdb_resized(MDB_env *env)
   mdb_env_info(env, &mei);
   uint64_t new_mapsize = mei.me_mapsize;
 
-  MGINFO("LMDB Mapsize increased." << "  Old: " << old / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
-
+  PERF_TIMER_STOP(lmdb_resize_blocked);
   mdb_txn_safe::allow_new_txns();
+
+  MGINFO("LMDB Mapsize increased." << "  Old: " << old / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
 }
 
 inline int lmdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **txn)
@@ -508,17 +621,18 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   CRITICAL_REGION_LOCAL(m_synchronization_lock);
-  const uint64_t add_size = 1LL << 30;
+  PERF_TIMER(lmdb_resize);
+  const uint64_t min_free_space = 1LL << 30;
 
   // check disk capacity
   try
   {
     boost::filesystem::path path(m_folder);
     boost::filesystem::space_info si = boost::filesystem::space(path);
-    if(si.available < add_size)
+    if(si.available < min_free_space)
     {
       MERROR("!! WARNING: Insufficient free space to extend database !!: " <<
-          (si.available >> 20L) << " MB available, " << (add_size >> 20L) << " MB needed");
+          (si.available >> 20L) << " MB available, " << (min_free_space >> 20L) << " MB needed");
       return;
     }
   }
@@ -536,19 +650,21 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
 
   mdb_env_stat(m_env, &mst);
 
-  // add 1Gb per resize, instead of doing a percentage increase
+  // add 1Gb per resize, instead of doing a percentage increase, or half the
+  // map when it is reserved ahead, so every resize buys a long time
+  uint64_t add_size = 1LL << 30;
+  if (RESERVED_MAPSIZE)
+    add_size = std::max<uint64_t>(add_size, mei.me_mapsize / 2);
   uint64_t new_mapsize = (double) mei.me_mapsize + add_size;
 
   // If given, use increase_size instead of above way of resizing.
   // This is currently used for increasing by an estimated size at start of new
   // batch txn.
   if (increase_size > 0)
-    new_mapsize = mei.me_mapsize + increase_size;
+    new_mapsize = mei.me_mapsize + (RESERVED_MAPSIZE ? std::max(increase_size, add_size) : increase_size);
 
   new_mapsize += (new_mapsize % mst.ms_psize);
 
-  mdb_txn_safe::prevent_new_txns();
-
   if (m_write_txn != nullptr)
   {
     if (m_batch_active)
@@ -561,15 +677,21 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     }
   }
 
+  // every other thread waits from here until the new map is in place
+  mdb_txn_safe::prevent_new_txns();
+  PERF_TIMER_START(lmdb_resize_blocked);
+
   mdb_txn_safe::wait_no_active_txns();
 
   int result = mdb_env_set_mapsize(m_env, new_mapsize);
+
+  PERF_TIMER_STOP(lmdb_resize_blocked);
+  mdb_txn_safe::allow_new_txns();
+
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to set new mapsize: ", result).c_str()));
 
   MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
-
-  mdb_txn_safe::allow_new_txns();
 }
 
 // threshold_size is used for batch transactions
@@ -795,6 +917,30 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block info to db transaction: ", result).c_str()));
 
+  {
+    boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+    block_columns &c = m_block_columns;
+    if (c.base <= m_height && c.end() >= m_height)
+    {
+      c.truncate(m_height);
+      c.timestamps.push_back(bi.bi_timestamp);
+      c.weights.push_back(bi.bi_weight);
+      c.long_term_weights.push_back(bi.bi_long_term_block_weight);
+      c.diff_lo.push_back(bi.bi_diff_lo);
+      c.diff_hi.push_back(bi.bi_diff_hi);
+      if (c.timestamps.size() > BLOCK_COLUMNS_MAX)
+      {
+        const size_t drop = c.timestamps.size() / 2;
+        c.timestamps.erase(c.timestamps.begin(), c.timestamps.begin() + drop);
+        c.weights.erase(c.weights.begin(), c.weights.begin() + drop);
+        c.long_term_weights.erase(c.long_term_weights.begin(), c.long_term_weights.begin() + drop);
+        c.diff_lo.erase(c.diff_lo.begin(), c.diff_lo.begin() + drop);
+        c.diff_hi.erase(c.diff_hi.begin(), c.diff_hi.begin() + drop);
+        c.base += drop;
+      }
+    }
+  }
+
   result = mdb_cursor_put(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
@@ -840,6 +986,70 @@ void BlockchainLMDB::remove_block()
 
   if ((result = mdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+  boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+  m_block_columns.truncate(m_height - 1);
+}
+
+static void add_article_index(MDB_cursor *c_articles, MDB_cursor *c_publishers, MDB_cursor *c_contents, const crypto::hash &txid, uint64_t height, const tx_extra_article_info &article)
+{
+  article_index_t ai;
+  ai.txid = txid;
+  ai.height = height;
+  crypto::cn_fast_hash(article.content.data(), article.content.size(), ai.content_hash);
+  crypto::cn_fast_hash(article.publisher.data(), article.publisher.size(), ai.publisher_hash);
+
+  MDB_val_set(k, height);
+  MDB_val_set(v, ai);
+  int result = mdb_cursor_put(c_articles, &k, &v, MDB_NODUPDATA);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add article to db transaction: ", result).c_str()));
+
+  mdb_article_ref ref;
+  ref.height = height;
+  ref.txid = txid;
+  MDB_val_set(vr, ref);
+  MDB_val_set(kp, ai.publisher_hash);
+  result = mdb_cursor_put(c_publishers, &kp, &vr, MDB_NODUPDATA);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add article publisher to db transaction: ", result).c_str()));
+  MDB_val_set(kc, ai.content_hash);
+  result = mdb_cursor_put(c_contents, &kc, &vr, MDB_NODUPDATA);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add article content to db transaction: ", result).c_str()));
+}
+
+static void remove_article_index(MDB_cursor *c_articles, MDB_cursor *c_publishers, MDB_cursor *c_contents, const crypto::hash &txid, uint64_t height, const tx_extra_article_info &article)
+{
+  article_index_t ai;
+  ai.txid = txid;
+  ai.height = height;
+  crypto::cn_fast_hash(article.content.data(), article.content.size(), ai.content_hash);
+  crypto::cn_fast_hash(article.publisher.data(), article.publisher.size(), ai.publisher_hash);
+
+  MDB_val_set(k, height);
+  MDB_val_set(v, ai);
+  int result = mdb_cursor_get(c_articles, &k, &v, MDB_GET_BOTH);
+  if (result)
+    throw1(DB_ERROR(lmdb_error("Failed to locate article for removal: ", result).c_str()));
+  if ((result = mdb_cursor_del(c_articles, 0)))
+    throw1(DB_ERROR(lmdb_error("Failed to add removal of article to db transaction: ", result).c_str()));
+
+  mdb_article_ref ref;
+  ref.height = height;
+  ref.txid = txid;
+  MDB_val_set(kp, ai.publisher_hash);
+  MDB_val_set(vp, ref);
+  if ((result = mdb_cursor_get(c_publishers, &kp, &vp, MDB_GET_BOTH)))
+    throw1(DB_ERROR(lmdb_error("Failed to locate article publisher for removal: ", result).c_str()));
+  if ((result = mdb_cursor_del(c_publishers, 0)))
+    throw1(DB_ERROR(lmdb_error("Failed to add removal of article publisher to db transaction: ", result).c_str()));
+  MDB_val_set(kc, ai.content_hash);
+  MDB_val_set(vc, ref);
+  if ((result = mdb_cursor_get(c_contents, &kc, &vc, MDB_GET_BOTH)))
+    throw1(DB_ERROR(lmdb_error("Failed to locate article content for removal: ", result).c_str()));
+  if ((result = mdb_cursor_del(c_contents, 0)))
+    throw1(DB_ERROR(lmdb_error("Failed to add removal of article content to db transaction: ", result).c_str()));
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const transaction& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash)
@@ -884,13 +1094,20 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   cryptonote::blobdata blob = tx_to_blob(tx);
   MDB_val_sized(blobval, blob);
 
-  std::stringstream ss;
-  binary_archive<true> ba(ss);
+  std::string pruned;
+  binary_archive<true> ba(pruned);
   bool r = const_cast<cryptonote::transaction&>(tx).serialize_base(ba);
   if (!r)
     throw0(DB_ERROR("Failed to serialize pruned tx"));
-  std::string pruned = ss.str();
   MDB_val_sized(pruned_blob, pruned);
+#ifdef HAVE_ZSTD
+  std::string compressed;
+  if (m_txs_pruned_codec == TXS_PRUNED_CODEC_ZSTD && compress_blob(pruned, compressed))
+  {
+    pruned_blob.mv_size = compressed.size();
+    pruned_blob.mv_data = (void*)compressed.data();
+  }
+#endif
   result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
@@ -919,6 +1136,15 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
       throw0(DB_ERROR(lmdb_error("Failed to add prunable tx prunable hash to db transaction: ", result).c_str()));
   }
 
+  tx_extra_article_info article;
+  if (get_article_from_tx_extra(tx.extra, article))
+  {
+    CURSOR(articles)
+    CURSOR(article_publishers)
+    CURSOR(article_contents)
+    add_article_index(m_cur_articles, m_cur_article_publishers, m_cur_article_contents, tx_hash, m_height, article);
+  }
+
   return tx_id;
 }
 
@@ -981,6 +1207,15 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
         throw1(DB_ERROR(lmdb_error("Failed to add removal of prunable hash tx to db transaction: ", result).c_str()));
   }
 
+  tx_extra_article_info article;
+  if (get_article_from_tx_extra(tx.extra, article))
+  {
+    CURSOR(articles)
+    CURSOR(article_publishers)
+    CURSOR(article_contents)
+    remove_article_index(m_cur_articles, m_cur_article_publishers, m_cur_article_contents, tx_hash, tip->data.block_id, article);
+  }
+
   remove_tx_outputs(tip->data.tx_id, tx);
 
   result = mdb_cursor_get(m_cur_tx_outputs, &val_tx_id, NULL, MDB_SET);
@@ -1219,6 +1454,11 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
     else
       throw1(DB_ERROR(lmdb_error("Error adding spent key image to db transaction: ", result).c_str()));
   }
+
+  // if the txn gets aborted the filter is left with a false positive, which is harmless
+  std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (filter)
+    filter->add(k_image);
 }
 
 void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
@@ -1268,6 +1508,9 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_batch_active = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_have_full_node_quorums = false;
+  m_replica = false;
+  m_txs_pruned_codec = TXS_PRUNED_CODEC_NONE;
 
   // reset may also need changing when initialize things here
 
@@ -1324,7 +1567,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   // set up lmdb environment
   if ((result = mdb_env_create(&m_env)))
     throw0(DB_ERROR(lmdb_error("Failed to create lmdb environment: ", result).c_str()));
-  if ((result = mdb_env_set_maxdbs(m_env, 20)))
+  if ((result = mdb_env_set_maxdbs(m_env, LMDB_MAX_DBS)))
     throw0(DB_ERROR(lmdb_error("Failed to set max number of dbs: ", result).c_str()));
 
   int threads = tools::get_max_concurrency();
@@ -1333,6 +1576,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     throw0(DB_ERROR(lmdb_error("Failed to set max number of readers: ", result).c_str()));
 
   size_t mapsize = DEFAULT_MAPSIZE;
+  if (!(db_flags & DBF_RDONLY) && mapsize < RESERVED_MAPSIZE)
+    mapsize = RESERVED_MAPSIZE;
 
   if (db_flags & DBF_FAST)
     mdb_flags |= MDB_NOSYNC;
@@ -1340,6 +1585,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     mdb_flags |= MDB_NOSYNC | MDB_WRITEMAP | MDB_MAPASYNC;
   if (db_flags & DBF_RDONLY)
     mdb_flags = MDB_RDONLY;
+  m_replica = (db_flags & DBF_RDONLY) && (db_flags & DBF_REPLICA);
   if (db_flags & DBF_SALVAGE)
     mdb_flags |= MDB_PREVSNAPSHOT;
 
@@ -1376,7 +1622,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   // open necessary databases, and set properties as needed
   // uses macros to avoid having to change things too many places
-  // also change blockchain_prune.cpp to match
+  // also change blockchain_prune.cpp and blockchain_snapshot.cpp to match
   lmdb_db_open(txn, LMDB_BLOCKS, MDB_INTEGERKEY | MDB_CREATE, m_blocks, "Failed to open db handle for m_blocks");
 
   lmdb_db_open(txn, LMDB_BLOCK_INFO, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_info, "Failed to open db handle for m_block_info");
@@ -1410,6 +1656,26 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   lmdb_db_open(txn, LMDB_FULL_NODE_DATA, MDB_INTEGERKEY | MDB_CREATE, m_full_node_data, "Failed to open db handle for m_full_node_data");
 
+  // Archive of quorum states that aged out of the fullnode list, only
+  // used to answer RPC queries so it's fine for it to be missing read-only.
+  if (!(mdb_flags & MDB_RDONLY))
+    lmdb_db_open(txn, LMDB_FULL_NODE_QUORUMS, MDB_INTEGERKEY | MDB_CREATE, m_full_node_quorums, "Failed to open db handle for m_full_node_quorums");
+  m_have_full_node_quorums = !(mdb_flags & MDB_RDONLY) || mdb_dbi_open(txn, LMDB_FULL_NODE_QUORUMS, MDB_INTEGERKEY, &m_full_node_quorums) == 0;
+
+  // New in version 6: an older DB opened read-only does not have these, but is refused below anyway
+  if (!(mdb_flags & MDB_RDONLY))
+  {
+    lmdb_db_open(txn, LMDB_ARTICLES, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_articles, "Failed to open db handle for m_articles");
+    lmdb_db_open(txn, LMDB_ARTICLE_PUBLISHERS, MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_article_publishers, "Failed to open db handle for m_article_publishers");
+    lmdb_db_open(txn, LMDB_ARTICLE_CONTENTS, MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_article_contents, "Failed to open db handle for m_article_contents");
+  }
+  else
+  {
+    mdb_dbi_open(txn, LMDB_ARTICLES, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, &m_articles);
+    mdb_dbi_open(txn, LMDB_ARTICLE_PUBLISHERS, MDB_DUPSORT | MDB_DUPFIXED, &m_article_publishers);
+    mdb_dbi_open(txn, LMDB_ARTICLE_CONTENTS, MDB_DUPSORT | MDB_DUPFIXED, &m_article_contents);
+  }
+
   lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
@@ -1423,6 +1689,9 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     mdb_set_dupsort(txn, m_txs_prunable_tip, compare_uint64);
   mdb_set_compare(txn, m_txs_prunable, compare_uint64);
   mdb_set_dupsort(txn, m_txs_prunable_hash, compare_uint64);
+  mdb_set_dupsort(txn, m_articles, compare_hash32);
+  mdb_set_dupsort(txn, m_article_publishers, compare_uint64_hash32);
+  mdb_set_dupsort(txn, m_article_contents, compare_uint64_hash32);
 
   mdb_set_compare(txn, m_txpool_meta, compare_hash32);
   mdb_set_compare(txn, m_txpool_blob, compare_hash32);
@@ -1442,6 +1711,42 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   LOG_PRINT_L2("Setting m_height to: " << db_stats.ms_entries);
   uint64_t m_height = db_stats.ms_entries;
 
+  // the codec is sticky: once enabled, new txs_pruned values keep being compressed
+  MDB_val_str(kc, "txs_pruned_codec");
+  MDB_val vc;
+  m_txs_pruned_codec = TXS_PRUNED_CODEC_NONE;
+  result = mdb_get(txn, m_properties, &kc, &vc);
+  if (result == MDB_SUCCESS && vc.mv_size == sizeof(uint32_t))
+    memcpy(&m_txs_pruned_codec, vc.mv_data, sizeof(uint32_t));
+  else if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to read txs_pruned codec: ", result).c_str()));
+  if (m_txs_pruned_codec == TXS_PRUNED_CODEC_NONE && (db_flags & DBF_COMPRESS) && !(mdb_flags & MDB_RDONLY))
+  {
+#ifdef HAVE_ZSTD
+    MDB_val_copy<uint32_t> codec(TXS_PRUNED_CODEC_ZSTD);
+    if ((result = mdb_put(txn, m_properties, &kc, &codec, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to write txs_pruned codec: ", result).c_str()));
+    m_txs_pruned_codec = TXS_PRUNED_CODEC_ZSTD;
+    MINFO("Compressing new tx blobs with zstd");
+#else
+    MWARNING("This build has no zstd support, the database will not be compressed");
+#endif
+  }
+#ifdef HAVE_ZSTD
+  const bool codec_supported = m_txs_pruned_codec <= TXS_PRUNED_CODEC_ZSTD;
+#else
+  const bool codec_supported = m_txs_pruned_codec == TXS_PRUNED_CODEC_NONE;
+#endif
+  if (!codec_supported)
+  {
+    txn.abort();
+    mdb_env_close(m_env);
+    m_open = false;
+    MFATAL("Existing lmdb database holds compressed data (codec " << m_txs_pruned_codec << ") this build cannot read.");
+    MFATAL("Please use a build with zstd support.");
+    return;
+  }
+
   bool compatible = true;
 
   MDB_val_str(k, "version");
@@ -1520,6 +1825,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   m_open = true;
   // from here, init should be finished
+
+  load_key_image_filter();
 }
 
 void BlockchainLMDB::close()
@@ -1531,7 +1838,9 @@ void BlockchainLMDB::close()
     batch_abort();
   }
   this->sync();
+  store_key_image_filter();
   m_tinfo.reset();
+  invalidate_block_columns();
 
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
@@ -1569,6 +1878,7 @@ void BlockchainLMDB::reset()
   if (auto result = lmdb_txn_begin(m_env, NULL, 0, txn))
     throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
 
+  invalidate_block_columns();
   if (auto result = mdb_drop(txn, m_blocks, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_blocks: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_block_info, 0))
@@ -1600,6 +1910,15 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_full_node_data, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_full_node_data: ", result).c_str()));
+  if (m_have_full_node_quorums)
+    if (auto result = mdb_drop(txn, m_full_node_quorums, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_full_node_quorums: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_articles, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_articles: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_article_publishers, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_article_publishers: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_article_contents, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_article_contents: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
 
@@ -1612,6 +1931,8 @@ void BlockchainLMDB::reset()
   txn.commit();
   m_cum_size = 0;
   m_cum_count = 0;
+
+  std::atomic_store(&m_key_image_filter, std::make_shared<key_image_filter>(0));
 }
 
 std::vector<std::string> BlockchainLMDB::get_filenames() const
@@ -1942,10 +2263,19 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
     throw0(DB_ERROR(lmdb_error("Failed to find transaction pruned data: ", ret).c_str()));
   if (v.mv_size == 0)
     throw0(DB_ERROR("Invalid transaction pruned data"));
+  if (is_compressed_blob(v))
+  {
+    cryptonote::blobdata bd;
+    append_pruned_blob(v, bd);
+    return cryptonote::is_v1_tx(bd);
+  }
   return cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
 }
 
-enum { prune_mode_prune, prune_mode_update, prune_mode_check };
+enum { prune_mode_prune, prune_mode_update, prune_mode_check, prune_mode_start };
+
+// next tx_indices entry an incremental pruning will look at, only present while one is in progress
+static const char *pruning_resume_property = "pruning_resume";
 
 bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
 {
@@ -1980,7 +2310,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
   if (result == MDB_NOTFOUND)
   {
     // not pruned yet
-    if (mode != prune_mode_prune)
+    if (mode != prune_mode_prune && mode != prune_mode_start)
     {
       txn.abort();
       TIME_MEASURE_FINISH(t);
@@ -2017,6 +2347,19 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     throw0(DB_ERROR(lmdb_error("Failed to retrieve or create pruning seed: ", result).c_str()));
   }
 
+  if (mode == prune_mode_start)
+  {
+    // prune_step goes through tx_indices from the first hash up
+    MDB_val_str(rk, pruning_resume_property);
+    MDB_val_copy<crypto::hash> rv(crypto::null_hash);
+    result = mdb_put(txn, m_properties, &rk, &rv, 0);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+    txn.commit();
+    MINFO("Pruning blockchain in the background, seed " << epee::string_tools::to_string_hex(pruning_seed));
+    return true;
+  }
+
   if (mode == prune_mode_check)
     MINFO("Checking blockchain pruning...");
   else
@@ -2186,6 +2529,132 @@ bool BlockchainLMDB::prune_blockchain(uint32_t pruning_seed)
   return prune_worker(prune_mode_prune, pruning_seed);
 }
 
+bool BlockchainLMDB::start_incremental_pruning(uint32_t pruning_seed)
+{
+  return prune_worker(prune_mode_start, pruning_seed);
+}
+
+bool BlockchainLMDB::prune_step(size_t max_records, bool &done)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  done = false;
+  // the next step will get its turn once the batch is over
+  if (m_batch_active)
+    return true;
+
+  mdb_txn_safe txn;
+  auto result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  MDB_val_str(rk, pruning_resume_property);
+  MDB_val v;
+  result = mdb_get(txn, m_properties, &rk, &v);
+  if (result == MDB_NOTFOUND)
+  {
+    txn.abort();
+    done = true;
+    return true;
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning progress: ", result).c_str()));
+  if (v.mv_size != sizeof(crypto::hash))
+    throw0(DB_ERROR("Failed to retrieve pruning progress: unexpected value size"));
+  crypto::hash resume;
+  memcpy(&resume, v.mv_data, sizeof(resume));
+
+  MDB_val_str(k, "pruning_seed");
+  result = mdb_get(txn, m_properties, &k, &v);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning seed: ", result).c_str()));
+  if (v.mv_size != sizeof(uint32_t))
+    throw0(DB_ERROR("Failed to retrieve pruning seed: unexpected value size"));
+  uint32_t pruning_seed;
+  memcpy(&pruning_seed, v.mv_data, sizeof(pruning_seed));
+
+  MDB_cursor *c_tx_indices, *c_txs_pruned, *c_txs_prunable, *c_txs_prunable_tip;
+  if ((result = mdb_cursor_open(txn, m_tx_indices, &c_tx_indices)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_txs_pruned, &c_txs_pruned)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_txs_prunable, &c_txs_prunable)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_txs_prunable_tip, &c_txs_prunable_tip)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_tip: ", result).c_str()));
+  const uint64_t blockchain_height = height();
+
+  // same as a full pruning, for the next max_records transactions by hash
+  size_t n_records = 0, n_pruned_records = 0;
+  uint64_t n_bytes = 0;
+  MDB_val_set(vr, resume);
+  int ret = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &vr, MDB_GET_BOTH_RANGE);
+  while (1)
+  {
+    if (ret == MDB_NOTFOUND)
+    {
+      done = true;
+      break;
+    }
+    if (ret)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
+    txindex ti;
+    memcpy(&ti, vr.mv_data, sizeof(ti));
+    if (n_records == max_records)
+    {
+      resume = ti.key;
+      break;
+    }
+    ++n_records;
+
+    const uint64_t block_height = ti.data.block_id;
+    MDB_val_set(kp, ti.data.tx_id);
+    if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS >= blockchain_height)
+    {
+      MDB_val_set(vp, block_height);
+      result = mdb_cursor_put(c_txs_prunable_tip, &kp, &vp, 0);
+      if (result && result != MDB_KEYEXIST)
+        throw0(DB_ERROR(lmdb_error("Error adding transaction prunable tip data: ", result).c_str()));
+    }
+    if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp))
+    {
+      result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+      if (result == 0)
+      {
+        ++n_pruned_records;
+        n_bytes += kp.mv_size + v.mv_size;
+        result = mdb_cursor_del(c_txs_prunable, 0);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
+      }
+    }
+    ret = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &vr, MDB_NEXT_DUP);
+  }
+
+  mdb_cursor_close(c_txs_prunable_tip);
+  mdb_cursor_close(c_txs_prunable);
+  mdb_cursor_close(c_txs_pruned);
+  mdb_cursor_close(c_tx_indices);
+
+  if (done)
+    result = mdb_del(txn, m_properties, &rk, NULL);
+  else
+  {
+    MDB_val_set(rv, resume);
+    result = mdb_put(txn, m_properties, &rk, &rv, 0);
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+  txn.commit();
+
+  MDEBUG("Pruning step: " << n_pruned_records << "/" << n_records << " records, " << n_bytes << " bytes pruned");
+  if (done)
+    MINFO("Background blockchain pruning finished");
+  return true;
+}
+
 bool BlockchainLMDB::update_pruning()
 {
   return prune_worker(prune_mode_update, 0);
@@ -2343,6 +2812,35 @@ cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t&
   return bd;
 }
 
+bool BlockchainLMDB::get_block_blob_view_from_height(uint64_t height, epee::span<const uint8_t> &blob) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  MDB_txn *m_txn;
+  mdb_txn_cursors *m_cursors;
+  if (block_rtxn_start(&m_txn, &m_cursors))
+  {
+    // nobody holds the txn open, the view would not outlive this call
+    block_rtxn_stop();
+    return false;
+  }
+  RCURSOR(blocks);
+
+  MDB_val_copy<uint64_t> key(height);
+  MDB_val result;
+  auto get_result = mdb_cursor_get(m_cur_blocks, &key, &result, MDB_SET);
+  if (get_result == MDB_NOTFOUND)
+  {
+    throw0(BLOCK_DNE(std::string("Attempt to get block from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block not in db").c_str()));
+  }
+  else if (get_result)
+    throw0(DB_ERROR("Error attempting to retrieve a block from the db"));
+
+  blob = {reinterpret_cast<const uint8_t*>(result.mv_data), result.mv_size};
+  return true;
+}
+
 uint64_t BlockchainLMDB::get_block_timestamp(const uint64_t& height) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -2525,6 +3023,11 @@ void BlockchainLMDB::correct_block_cumulative_difficulties(const uint64_t& start
     throw0(DB_ERROR("Incorrect new_cumulative_difficulties size"));
   }
 
+  {
+    boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+    m_block_columns.truncate(start_height);
+  }
+
   for (uint64_t height = start_height; height < bc_height; ++height)
   {
     MDB_val_set(key, height);
@@ -2546,48 +3049,186 @@ void BlockchainLMDB::correct_block_cumulative_difficulties(const uint64_t& start
   block_txn_stop();
 }
 
-uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& height) const
+bool BlockchainLMDB::load_block_columns(uint64_t start_height, uint64_t end_height) const
 {
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  check_open();
+  // anything past the height may have been left by an aborted txn
+  if (end_height <= start_height || end_height > height())
+    return false;
+
+  block_columns &c = m_block_columns;
+  if (start_height >= c.base && end_height <= c.end())
+    return true;
 
   TXN_PREFIX_RDONLY();
+  if (m_cursors != &m_wcursors)
+  {
+    // only fill from the latest snapshot with no write pending, which is
+    // what add_block and remove_block will be applied on top of
+    if (m_write_txn)
+      return false;
+    MDB_envinfo info;
+    mdb_env_info(m_env, &info);
+    if (mdb_txn_id(m_txn) != info.me_last_txnid)
+      return false;
+  }
   RCURSOR(block_info);
 
-  MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
-  if (get_result == MDB_NOTFOUND)
+  if (start_height < c.base || start_height > c.end())
   {
-    throw0(BLOCK_DNE(std::string("Attempt to get generated coins from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block size not in db").c_str()));
+    c = block_columns();
+    c.base = start_height;
+  }
+
+  uint64_t h = c.end();
+  MDB_val_set(v, h);
+  int result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  while (true)
+  {
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to get block info: ", result).c_str()));
+    const mdb_block_info *bi = (const mdb_block_info*)v.mv_data;
+    c.timestamps.push_back(bi->bi_timestamp);
+    c.weights.push_back(bi->bi_weight);
+    c.long_term_weights.push_back(bi->bi_long_term_block_weight);
+    c.diff_lo.push_back(bi->bi_diff_lo);
+    c.diff_hi.push_back(bi->bi_diff_hi);
+    if (++h == end_height)
+      break;
+    MDB_val k;
+    result = mdb_cursor_get(m_cur_block_info, &k, &v, MDB_NEXT_DUP);
   }
-  else if (get_result)
-    throw0(DB_ERROR("Error attempting to retrieve a total generated coins from the db"));
 
-  mdb_block_info *bi = (mdb_block_info *)result.mv_data;
-  uint64_t ret = bi->bi_coins;
   TXN_POSTFIX_RDONLY();
-  return ret;
+  return true;
 }
 
-uint64_t BlockchainLMDB::get_block_long_term_weight(const uint64_t& height) const
+void BlockchainLMDB::invalidate_block_columns()
+{
+  boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+  m_block_columns = block_columns();
+}
+
+void BlockchainLMDB::invalidate_cache_from_height(uint64_t height)
+{
+  boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+  m_block_columns.truncate(height);
+}
+
+std::vector<uint64_t> BlockchainLMDB::get_block_timestamps(uint64_t start_height, size_t count) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  TXN_PREFIX_RDONLY();
-  RCURSOR(block_info);
-
-  MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
-  if (get_result == MDB_NOTFOUND)
   {
-    throw0(BLOCK_DNE(std::string("Attempt to get block long term weight from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block info not in db").c_str()));
+    boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+    if (load_block_columns(start_height, start_height + count))
+    {
+      const auto begin = m_block_columns.timestamps.begin() + (start_height - m_block_columns.base);
+      return std::vector<uint64_t>(begin, begin + count);
+    }
   }
-  else if (get_result)
-    throw0(DB_ERROR("Error attempting to retrieve a long term block weight from the db"));
+  return BlockchainDB::get_block_timestamps(start_height, count);
+}
 
-  mdb_block_info *bi = (mdb_block_info *)result.mv_data;
-  uint64_t ret = bi->bi_long_term_block_weight;
+std::vector<uint64_t> BlockchainLMDB::get_block_weights(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+    if (load_block_columns(start_height, start_height + count))
+    {
+      const auto begin = m_block_columns.weights.begin() + (start_height - m_block_columns.base);
+      return std::vector<uint64_t>(begin, begin + count);
+    }
+  }
+  return BlockchainDB::get_block_weights(start_height, count);
+}
+
+std::vector<uint64_t> BlockchainLMDB::get_block_long_term_weights(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+    if (load_block_columns(start_height, start_height + count))
+    {
+      const auto begin = m_block_columns.long_term_weights.begin() + (start_height - m_block_columns.base);
+      return std::vector<uint64_t>(begin, begin + count);
+    }
+  }
+  return BlockchainDB::get_block_long_term_weights(start_height, count);
+}
+
+std::vector<difficulty_type> BlockchainLMDB::get_block_cumulative_difficulties(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_block_columns_lock);
+    if (load_block_columns(start_height, start_height + count))
+    {
+      std::vector<difficulty_type> res;
+      res.reserve(count);
+      const size_t offset = start_height - m_block_columns.base;
+      for (size_t i = offset; i < offset + count; ++i)
+      {
+        difficulty_type d = m_block_columns.diff_hi[i];
+        d <<= 64;
+        d |= m_block_columns.diff_lo[i];
+        res.push_back(d);
+      }
+      return res;
+    }
+  }
+  return BlockchainDB::get_block_cumulative_difficulties(start_height, count);
+}
+
+uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(block_info);
+
+  MDB_val_set(result, height);
+  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  if (get_result == MDB_NOTFOUND)
+  {
+    throw0(BLOCK_DNE(std::string("Attempt to get generated coins from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block size not in db").c_str()));
+  }
+  else if (get_result)
+    throw0(DB_ERROR("Error attempting to retrieve a total generated coins from the db"));
+
+  mdb_block_info *bi = (mdb_block_info *)result.mv_data;
+  uint64_t ret = bi->bi_coins;
+  TXN_POSTFIX_RDONLY();
+  return ret;
+}
+
+uint64_t BlockchainLMDB::get_block_long_term_weight(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(block_info);
+
+  MDB_val_set(result, height);
+  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  if (get_result == MDB_NOTFOUND)
+  {
+    throw0(BLOCK_DNE(std::string("Attempt to get block long term weight from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block info not in db").c_str()));
+  }
+  else if (get_result)
+    throw0(DB_ERROR("Error attempting to retrieve a long term block weight from the db"));
+
+  mdb_block_info *bi = (mdb_block_info *)result.mv_data;
+  uint64_t ret = bi->bi_long_term_block_weight;
   TXN_POSTFIX_RDONLY();
   return ret;
 }
@@ -2822,7 +3463,8 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
+  bd.clear();
+  append_pruned_blob(result0, bd);
   bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
 
   TXN_POSTFIX_RDONLY();
@@ -2853,7 +3495,8 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd.clear();
+  append_pruned_blob(result, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3116,6 +3759,10 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (filter && !filter->may_contain(img))
+    return false;
+
   bool ret;
 
   TXN_PREFIX_RDONLY();
@@ -3128,6 +3775,115 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   return ret;
 }
 
+uint64_t BlockchainLMDB::num_spent_keys() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+
+  MDB_stat db_stats;
+  if (auto result = mdb_stat(m_txn, m_spent_keys, &db_stats))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+  return db_stats.ms_entries;
+}
+
+std::string BlockchainLMDB::get_key_image_filter_filename() const
+{
+  boost::filesystem::path filename(m_folder);
+  filename /= "spent_keys.filter";
+  return filename.string();
+}
+
+void BlockchainLMDB::check_key_image_filter_capacity()
+{
+  // only called right after a commit: a filter rebuilt from inside a write
+  // txn would lose the key images of any blocks popped in it if it were
+  // later aborted
+  std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (filter && filter->size() > filter->capacity())
+    rebuild_key_image_filter();
+}
+
+void BlockchainLMDB::rebuild_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  // readers keep using the old filter, or the DB, until the new one is in place
+  const uint64_t n_key_images = num_spent_keys();
+  std::shared_ptr<key_image_filter> filter = std::make_shared<key_image_filter>(n_key_images * 2);
+  for_all_key_images([&filter](const crypto::key_image &k_image) {
+    filter->add(k_image);
+    return true;
+  });
+  std::atomic_store(&m_key_image_filter, filter);
+  MDEBUG("Rebuilt spent key image filter for " << n_key_images << " key images, capacity " << filter->capacity());
+}
+
+void BlockchainLMDB::load_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>());
+
+  // the writing process adds key images the filter would never see
+  if (m_replica)
+    return;
+
+  try
+  {
+    const uint64_t n_key_images = num_spent_keys();
+    const crypto::hash top_hash = height() ? top_block_hash() : crypto::null_hash;
+    const std::string filename = get_key_image_filter_filename();
+    std::shared_ptr<key_image_filter> filter = key_image_filter::load(filename, top_hash, n_key_images);
+    if (is_read_only())
+    {
+      // nothing can change under a read only DB, so the file stays valid; but
+      // don't spend the time building one for what is most likely a tool
+      std::atomic_store(&m_key_image_filter, filter);
+      return;
+    }
+    // the file is only trusted right after a clean close: drop it so that
+    // it can't be picked up again after a crash
+    boost::system::error_code ec;
+    boost::filesystem::remove(filename, ec);
+    if (filter)
+    {
+      std::atomic_store(&m_key_image_filter, filter);
+      MINFO("Loaded spent key image filter for " << n_key_images << " key images");
+      return;
+    }
+
+    MGINFO("Building spent key image filter, this may take a while...");
+    rebuild_key_image_filter();
+  }
+  catch (const std::exception &e)
+  {
+    // without a filter every lookup goes to the DB, which is slower but correct
+    MERROR("Failed to set up the spent key image filter: " << e.what());
+    std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>());
+  }
+}
+
+void BlockchainLMDB::store_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>());
+  if (!filter || is_read_only())
+    return;
+
+  try
+  {
+    filter->store(get_key_image_filter_filename(), height() ? top_block_hash() : crypto::null_hash, num_spent_keys());
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to store the spent key image filter: " << e.what());
+  }
+}
+
 bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3248,7 +4004,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
     transaction tx;
     blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    append_pruned_blob(v, bd);
     if (pruned)
     {
       if (!parse_and_validate_tx_base_from_blob(bd, tx))
@@ -3450,6 +4206,7 @@ void BlockchainLMDB::batch_stop()
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
     cleanup_batch();
+    check_key_image_filter_capacity();
   }
   catch (const std::exception &e)
   {
@@ -3479,6 +4236,7 @@ void BlockchainLMDB::batch_abort()
   m_write_batch_txn = nullptr;
   m_batch_active = false;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
+  invalidate_block_columns();
   LOG_PRINT_L3("batch transaction: aborted");
 }
 
@@ -3531,6 +4289,13 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
   return ret;
 }
 
+bool BlockchainLMDB::block_rtxn_start() const
+{
+  MDB_txn *mtxn;
+  mdb_txn_cursors *mcur;
+  return block_rtxn_start(&mtxn, &mcur);
+}
+
 void BlockchainLMDB::block_rtxn_stop() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3594,6 +4359,7 @@ void BlockchainLMDB::block_txn_stop()
       delete m_write_txn;
       m_write_txn = nullptr;
       memset(&m_wcursors, 0, sizeof(m_wcursors));
+      check_key_image_filter_capacity();
 	}
   }
   else if (m_tinfo->m_ti_rtxn)
@@ -3613,6 +4379,7 @@ void BlockchainLMDB::block_txn_abort()
       delete m_write_txn;
       m_write_txn = nullptr;
       memset(&m_wcursors, 0, sizeof(m_wcursors));
+      invalidate_block_columns();
     }
   }
   else if (m_tinfo->m_ti_rtxn)
@@ -3726,33 +4493,65 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
 
   RCURSOR(output_amounts);
 
+  // output_amounts is DUPFIXED, so the leaf page holding the last output
+  // looked up can be fetched whole. Ring members and get_outs requests are
+  // sorted, and the ones landing in that page are read without a seek.
+  MDB_val page = {0, NULL};
+  uint64_t page_amount = 0;
+
   for (size_t i = 0; i < offsets.size(); ++i)
   {
     const uint64_t amount = amounts.size() == 1 ? amounts[0] : amounts[i];
-    MDB_val_set(k, amount);
-    MDB_val_set(v, offsets[i]);
+    const size_t item_size = amount == 0 ? sizeof(outkey) : sizeof(pre_rct_outkey);
+    const void *item = NULL;
 
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
+    if (page.mv_data && page_amount == amount)
     {
-      if (allow_partial)
+      const char *items = (const char *)page.mv_data;
+      const uint64_t first = ((const outkey *)items)->amount_index;
+      if (offsets[i] >= first && offsets[i] - first < page.mv_size / item_size)
       {
-        MDEBUG("Partial result: " << outputs.size() << "/" << offsets.size());
-        break;
+        const char *p = items + (offsets[i] - first) * item_size;
+        if (((const outkey *)p)->amount_index == offsets[i])
+          item = p;
       }
-      throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + boost::lexical_cast<std::string>(amount) + ", index " + boost::lexical_cast<std::string>(offsets[i]) + ", count " + boost::lexical_cast<std::string>(get_num_outputs(amount)) + "), but key does not exist (current height " + boost::lexical_cast<std::string>(height()) + ")").c_str()));
     }
-    else if (get_result)
-      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
+
+    if (!item)
+    {
+      MDB_val_set(k, amount);
+      MDB_val_set(v, offsets[i]);
+
+      auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+      if (get_result == MDB_NOTFOUND)
+      {
+        if (allow_partial)
+        {
+          MDEBUG("Partial result: " << outputs.size() << "/" << offsets.size());
+          break;
+        }
+        throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + boost::lexical_cast<std::string>(amount) + ", index " + boost::lexical_cast<std::string>(offsets[i]) + ", count " + boost::lexical_cast<std::string>(get_num_outputs(amount)) + "), but key does not exist (current height " + boost::lexical_cast<std::string>(height()) + ")").c_str()));
+      }
+      else if (get_result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
+      item = v.mv_data;
+
+      // an amount with a single output has no dup page, page stays empty then
+      page.mv_size = 0;
+      page.mv_data = NULL;
+      if (mdb_cursor_get(m_cur_output_amounts, &k, &page, MDB_GET_MULTIPLE) || page.mv_size % item_size)
+        page.mv_data = NULL;
+      page_amount = amount;
+    }
 
     if (amount == 0)
     {
-      const outkey *okp = (const outkey *)v.mv_data;
+      const outkey *okp = (const outkey *)item;
       outputs.push_back(okp->data);
     }
     else
     {
-      const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
+      const pre_rct_outkey *okp = (const pre_rct_outkey *)item;
       outputs.resize(outputs.size() + 1);
       output_data_t &data = outputs.back();
       memcpy(&data, &okp->data, sizeof(pre_rct_output_data_t));
@@ -3858,35 +4657,49 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
   }
 
   if (unlocked || recent_cutoff > 0) {
+    // walk each amount's outputs backwards on the amount cursor itself: the
+    // output key carries the block height, so there is no need to go through
+    // the output and tx tables for every output, and block timestamps are
+    // looked up once per height across all amounts
     const uint64_t blockchain_height = height();
+    std::unordered_map<uint64_t, uint64_t> timestamps;
     for (std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>>::iterator i = histogram.begin(); i != histogram.end(); ++i) {
-      uint64_t amount = i->first;
       uint64_t num_elems = std::get<0>(i->second);
-      while (num_elems > 0) {
-        const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-        const uint64_t height = get_tx_block_height(toi.first);
-        if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
-          break;
-        --num_elems;
-      }
-      // modifying second does not invalidate the iterator
-      std::get<1>(i->second) = num_elems;
-
-      if (recent_cutoff > 0)
-      {
-        uint64_t recent = 0;
+      uint64_t recent = 0;
+      if (num_elems > 0) {
+        MDB_val_set(k, i->first);
+        int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
+        if (!ret)
+          ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_LAST_DUP);
+        bool scanning_recent = false;
         while (num_elems > 0) {
-          const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-          const uint64_t height = get_tx_block_height(toi.first);
-          const uint64_t ts = get_block_timestamp(height);
-          if (ts < recent_cutoff)
-            break;
-          --num_elems;
-          ++recent;
+          if (ret)
+            throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", ret).c_str()));
+          const uint64_t height = ((const outkey *)v.mv_data)->data.height;
+          if (!scanning_recent) {
+            if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height) {
+              // modifying second does not invalidate the iterator
+              std::get<1>(i->second) = num_elems;
+              if (recent_cutoff == 0)
+                break;
+              scanning_recent = true;
+            }
+          }
+          if (scanning_recent) {
+            std::unordered_map<uint64_t, uint64_t>::const_iterator ts = timestamps.find(height);
+            if (ts == timestamps.end())
+              ts = timestamps.emplace(height, get_block_timestamp(height)).first;
+            if (ts->second < recent_cutoff)
+              break;
+            ++recent;
+          }
+          if (--num_elems > 0)
+            ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_PREV_DUP);
         }
-        // modifying second does not invalidate the iterator
-        std::get<2>(i->second) = recent;
+        if (!scanning_recent)
+          std::get<1>(i->second) = 0;
       }
+      std::get<2>(i->second) = recent;
     }
   }
 
@@ -4750,12 +5563,11 @@ void BlockchainLMDB::migrate_1_2()
       transaction tx;
       if (!parse_and_validate_tx_from_blob(bd, tx))
         throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
-      std::stringstream ss;
-      binary_archive<true> ba(ss);
+      std::string pruned;
+      binary_archive<true> ba(pruned);
       bool r = tx.serialize_base(ba);
       if (!r)
         throw0(DB_ERROR("Failed to serialize pruned tx"));
-      std::string pruned = ss.str();
 
       if (pruned.size() > bd.size())
         throw0(DB_ERROR("Pruned tx is larger than raw tx"));
@@ -4985,7 +5797,7 @@ void BlockchainLMDB::migrate_3_4()
               if (ret == MDB_NOTFOUND) break;
               if (ret) throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
 
-              bd.append(reinterpret_cast<char*>(val.mv_data), val.mv_size);
+              append_pruned_blob(val, bd);
 
               ret = mdb_cursor_get(m_cur_txs_prunable, &key, &val, MDB_SET);
               if (ret) throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
@@ -5313,6 +6125,112 @@ void BlockchainLMDB::migrate_4_5()
   txn.commit();
 }
 
+void BlockchainLMDB::migrate_5_6()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 5 to 6 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("indexing articles:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_tx_indices, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_tx_indices: ", result).c_str()));
+    const uint64_t n_txes = db_stats.ms_entries;
+
+    // start over if a previous migration was interrupted
+    if ((result = mdb_drop(txn, m_articles, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_articles: ", result).c_str()));
+    if ((result = mdb_drop(txn, m_article_publishers, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_article_publishers: ", result).c_str()));
+    if ((result = mdb_drop(txn, m_article_contents, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_article_contents: ", result).c_str()));
+
+    MDB_cursor *c_tx_indices, *c_txs_pruned, *c_articles, *c_publishers, *c_contents;
+    crypto::hash last_txid = crypto::null_hash;
+    uint64_t n_articles = 0;
+    MDB_cursor_op op = MDB_FIRST;
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << n_txes << "  \r" << std::flush;
+          }
+          txn.commit();
+          result = mdb_txn_begin(m_env, NULL, 0, txn);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        }
+        if ((result = mdb_cursor_open(txn, m_tx_indices, &c_tx_indices)))
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
+        if ((result = mdb_cursor_open(txn, m_txs_pruned, &c_txs_pruned)))
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+        if ((result = mdb_cursor_open(txn, m_articles, &c_articles)))
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for articles: ", result).c_str()));
+        if ((result = mdb_cursor_open(txn, m_article_publishers, &c_publishers)))
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for article_publishers: ", result).c_str()));
+        if ((result = mdb_cursor_open(txn, m_article_contents, &c_contents)))
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for article_contents: ", result).c_str()));
+        if (i) {
+          // the cursors died with the previous txn, get back to where we were
+          MDB_val_set(pos, last_txid);
+          if ((result = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &pos, MDB_GET_BOTH)))
+            throw0(DB_ERROR(lmdb_error("Failed to find tx index: ", result).c_str()));
+        }
+      }
+      result = mdb_cursor_get(c_tx_indices, &k, &v, op);
+      op = MDB_NEXT;
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from tx_indices: ", result).c_str()));
+
+      const txindex ti = *(const txindex*)v.mv_data;
+      last_txid = ti.key;
+      MDB_val_set(val_tx_id, ti.data.tx_id);
+      if ((result = mdb_cursor_get(c_txs_pruned, &val_tx_id, &v, MDB_SET)))
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from txs_pruned: ", result).c_str()));
+      cryptonote::blobdata bd;
+      append_pruned_blob(v, bd);
+      transaction tx;
+      if (!parse_and_validate_tx_base_from_blob(bd, tx))
+        throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+      tx_extra_article_info article;
+      if (get_article_from_tx_extra(tx.extra, article))
+      {
+        add_article_index(c_articles, c_publishers, c_contents, ti.key, ti.data.block_id, article);
+        ++n_articles;
+      }
+      i++;
+    }
+    MINFO("Indexed " << n_articles << " articles");
+  } while(0);
+
+  uint32_t version = 6;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_str(vk, "version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
   switch(oldversion) {
@@ -5326,12 +6244,37 @@ void BlockchainLMDB::migrate(const uint32_t oldversion)
     migrate_3_4(); /* FALLTHRU */
   case 4:
     migrate_4_5(); /* FALLTHRU */
+  case 5:
+    migrate_5_6(); /* FALLTHRU */
   default:
     ;
   }
 }
 
 
+// NOTE: Key 1 of m_full_node_data holds the full checkpoint of the fullnode
+// list, the keys after it hold the per-block delta journal written on top of
+// that checkpoint, in the order they were appended.
+static const uint64_t FULL_NODE_DATA_CHECKPOINT_KEY = 1;
+
+// Delete every entry of an MDB_INTEGERKEY table with a key >= from_key
+static void delete_from_key(MDB_cursor *cursor, uint64_t from_key)
+{
+  MDB_val_set(k, from_key);
+  MDB_val v;
+
+  int result = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+  while (result == 0)
+  {
+    if ((result = mdb_cursor_del(cursor, 0)))
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of entry to db transaction: ", result).c_str()));
+    result = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+  }
+
+  if (result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Failed to enumerate entries to remove: ", result).c_str()));
+}
+
 void BlockchainLMDB::set_full_node_data(const std::string& data)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -5340,7 +6283,10 @@ void BlockchainLMDB::set_full_node_data(const std::string& data)
   mdb_txn_cursors *m_cursors = &m_wcursors;
   CURSOR(full_node_data);
 
-  const uint64_t key = 1;
+  // A new checkpoint supersedes the whole journal
+  delete_from_key(m_cur_full_node_data, FULL_NODE_DATA_CHECKPOINT_KEY + 1);
+
+  const uint64_t key = FULL_NODE_DATA_CHECKPOINT_KEY;
   MDB_val_set(k, key);
 
   MDB_val_copy<blobdata> blob(data);
@@ -5350,6 +6296,60 @@ void BlockchainLMDB::set_full_node_data(const std::string& data)
     throw0(DB_ERROR(lmdb_error("Failed to add fullnode data to db transaction: ", result).c_str()));
 }
 
+void BlockchainLMDB::add_full_node_data_delta(const std::string& data)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(full_node_data);
+
+  MDB_val k, v;
+  uint64_t key = FULL_NODE_DATA_CHECKPOINT_KEY + 1;
+  int result = mdb_cursor_get(m_cur_full_node_data, &k, &v, MDB_LAST);
+  if (result == 0)
+  {
+    uint64_t last_key;
+    memcpy(&last_key, k.mv_data, sizeof(last_key));
+    key = std::max(key, last_key + 1);
+  }
+  else if (result != MDB_NOTFOUND)
+  {
+    throw0(DB_ERROR(lmdb_error("Failed to get last fullnode data key: ", result).c_str()));
+  }
+
+  MDB_val_set(put_k, key);
+  MDB_val_copy<blobdata> blob(data);
+  result = mdb_cursor_put(m_cur_full_node_data, &put_k, &blob, MDB_APPEND);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add fullnode data delta to db transaction: ", result).c_str()));
+}
+
+void BlockchainLMDB::get_full_node_data_deltas(std::vector<std::string>& deltas)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+
+  RCURSOR(full_node_data);
+
+  deltas.clear();
+  const uint64_t key = FULL_NODE_DATA_CHECKPOINT_KEY + 1;
+  MDB_val_set(k, key);
+  MDB_val v;
+
+  int result = mdb_cursor_get(m_cur_full_node_data, &k, &v, MDB_SET_RANGE);
+  while (result == 0)
+  {
+    deltas.emplace_back(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+    result = mdb_cursor_get(m_cur_full_node_data, &k, &v, MDB_NEXT);
+  }
+
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to get fullnode data deltas", result).c_str()));
+}
+
 bool BlockchainLMDB::get_full_node_data(std::string& data)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -5359,12 +6359,12 @@ bool BlockchainLMDB::get_full_node_data(std::string& data)
 
   RCURSOR(full_node_data);
 
-  const uint64_t key = 1;
+  const uint64_t key = FULL_NODE_DATA_CHECKPOINT_KEY;
   MDB_val_set(k, key);
   MDB_val v;
 
   int result;
-  result = mdb_cursor_get(m_cur_full_node_data, &k, &v, MDB_FIRST);
+  result = mdb_cursor_get(m_cur_full_node_data, &k, &v, MDB_SET);
 
   if (result == MDB_NOTFOUND)
   {
@@ -5387,14 +6387,133 @@ void BlockchainLMDB::clear_full_node_data()
   mdb_txn_cursors *m_cursors = &m_wcursors;
   CURSOR(full_node_data);
 
-  const uint64_t key = 1;
-  MDB_val_set(k, key);
+  delete_from_key(m_cur_full_node_data, FULL_NODE_DATA_CHECKPOINT_KEY);
+}
 
-  int result;
-  if ((result = mdb_cursor_get(m_cur_full_node_data, &k, NULL, MDB_SET)))
+void BlockchainLMDB::set_full_node_quorum_state(uint64_t height, const std::string& data)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_have_full_node_quorums)
     return;
-  if ((result = mdb_cursor_del(m_cur_full_node_data, 0)))
-      throw1(DB_ERROR(lmdb_error("Failed to add removal of fullnode data to db transaction: ", result).c_str()));
+
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(full_node_quorums);
+
+  MDB_val_set(k, height);
+  MDB_val_copy<blobdata> blob(data);
+  if (int result = mdb_cursor_put(m_cur_full_node_quorums, &k, &blob, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to add fullnode quorum state to db transaction: ", result).c_str()));
+}
+
+bool BlockchainLMDB::get_full_node_quorum_state(uint64_t height, std::string& data)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_have_full_node_quorums)
+    return false;
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(full_node_quorums);
+
+  MDB_val_set(k, height);
+  MDB_val v;
+  int result = mdb_cursor_get(m_cur_full_node_quorums, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return false;
+  else if (result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to get fullnode quorum state", result).c_str()));
+
+  data.assign(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+  return true;
+}
+
+void BlockchainLMDB::remove_full_node_quorum_states_from(uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_have_full_node_quorums)
+    return;
+
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(full_node_quorums);
+
+  delete_from_key(m_cur_full_node_quorums, height);
+}
+
+bool BlockchainLMDB::get_articles(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, size_t limit, std::vector<article_index_t> &articles) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  articles.clear();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(articles);
+
+  bool more = false;
+  // returns false once the page is full
+  auto add_article = [&](const article_index_t &ai) {
+    if ((publisher_hash && ai.publisher_hash != *publisher_hash) || (content_hash && ai.content_hash != *content_hash))
+      return true;
+    if (offset)
+    {
+      --offset;
+      return true;
+    }
+    if (articles.size() >= limit)
+    {
+      more = true;
+      return false;
+    }
+    articles.push_back(ai);
+    return true;
+  };
+
+  int result;
+  if (publisher_hash || content_hash)
+  {
+    // walk the articles of that publisher (or with that content) from start_height up
+    RCURSOR(article_publishers);
+    RCURSOR(article_contents);
+    MDB_cursor *cur = publisher_hash ? m_cur_article_publishers : m_cur_article_contents;
+    crypto::hash key = publisher_hash ? *publisher_hash : *content_hash;
+    mdb_article_ref first;
+    first.height = start_height;
+    first.txid = crypto::null_hash;
+    MDB_val_set(k, key);
+    MDB_val_set(v, first);
+    for (result = mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH_RANGE); result == 0; result = mdb_cursor_get(cur, &k, &v, MDB_NEXT_DUP))
+    {
+      const mdb_article_ref ref = *(const mdb_article_ref*)v.mv_data;
+      if (ref.height > end_height)
+        break;
+      article_index_t ai;
+      ai.txid = ref.txid;
+      MDB_val_set(ka, ref.height);
+      MDB_val_set(va, ai);
+      if (int ret = mdb_cursor_get(m_cur_articles, &ka, &va, MDB_GET_BOTH))
+        throw0(DB_ERROR(lmdb_error("Failed to find indexed article: ", ret).c_str()));
+      if (!add_article(*(const article_index_t*)va.mv_data))
+        break;
+    }
+  }
+  else
+  {
+    MDB_val_set(k, start_height);
+    MDB_val v;
+    for (result = mdb_cursor_get(m_cur_articles, &k, &v, MDB_SET_RANGE); result == 0; result = mdb_cursor_get(m_cur_articles, &k, &v, MDB_NEXT))
+    {
+      const article_index_t &ai = *(const article_index_t*)v.mv_data;
+      if (ai.height > end_height || !add_article(ai))
+        break;
+    }
+  }
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate articles: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+
+  return more;
 }
 
 }  // namespace cryptonote
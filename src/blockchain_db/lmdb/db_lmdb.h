@@ -29,8 +29,10 @@
 #include <atomic>
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/key_image_filter.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/tss.hpp>
 
 #include <lmdb.h>
@@ -70,7 +72,13 @@ typedef struct mdb_txn_cursors
   MDB_cursor *m_txc_hf_versions;
 
   MDB_cursor *m_txc_full_node_data;
+  MDB_cursor *m_txc_full_node_quorums;
   MDB_cursor *m_txc_output_blacklist;
+
+  MDB_cursor *m_txc_articles;
+  MDB_cursor *m_txc_article_publishers;
+  MDB_cursor *m_txc_article_contents;
+
   MDB_cursor *m_txc_properties;
 } mdb_txn_cursors;
 
@@ -92,6 +100,10 @@ typedef struct mdb_txn_cursors
 #define m_cur_txpool_blob	m_cursors->m_txc_txpool_blob
 #define m_cur_hf_versions	m_cursors->m_txc_hf_versions
 #define m_cur_full_node_data	m_cursors->m_txc_full_node_data
+#define m_cur_full_node_quorums	m_cursors->m_txc_full_node_quorums
+#define m_cur_articles	m_cursors->m_txc_articles
+#define m_cur_article_publishers	m_cursors->m_txc_article_publishers
+#define m_cur_article_contents	m_cursors->m_txc_article_contents
 #define m_cur_properties	m_cursors->m_txc_properties
 
 typedef struct mdb_rflags
@@ -115,6 +127,10 @@ typedef struct mdb_rflags
   bool m_rf_txpool_blob;
   bool m_rf_hf_versions;
   bool m_rf_full_node_data;
+  bool m_rf_full_node_quorums;
+  bool m_rf_articles;
+  bool m_rf_article_publishers;
+  bool m_rf_article_contents;
   bool m_rf_properties;
 } mdb_rflags;
 
@@ -217,6 +233,8 @@ public:
 
   virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t& height) const;
 
+  virtual bool get_block_blob_view_from_height(uint64_t height, epee::span<const uint8_t> &blob) const;
+
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const;
 
   virtual uint64_t get_block_timestamp(const uint64_t& height) const;
@@ -235,6 +253,14 @@ public:
 
   virtual uint64_t get_block_long_term_weight(const uint64_t& height) const;
 
+  virtual std::vector<uint64_t> get_block_timestamps(uint64_t start_height, size_t count) const;
+
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const;
+
+  virtual std::vector<uint64_t> get_block_long_term_weights(uint64_t start_height, size_t count) const;
+
+  virtual std::vector<difficulty_type> get_block_cumulative_difficulties(uint64_t start_height, size_t count) const;
+
   virtual crypto::hash get_block_hash_from_height(const uint64_t& height) const;
 
   virtual std::vector<block> get_blocks_range(const uint64_t& h1, const uint64_t& h2) const;
@@ -289,6 +315,8 @@ public:
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid) const;
   virtual uint32_t get_blockchain_pruning_seed() const;
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
+  virtual bool start_incremental_pruning(uint32_t pruning_seed = 0);
+  virtual bool prune_step(size_t max_records, bool &done);
   virtual bool update_pruning();
   virtual bool check_pruning();
 
@@ -318,6 +346,7 @@ public:
   virtual void block_txn_stop();
   virtual void block_txn_abort();
   virtual bool block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) const;
+  virtual bool block_rtxn_start() const;
   virtual void block_rtxn_stop() const;
 
   virtual void pop_block(block& blk, std::vector<transaction>& txs);
@@ -344,6 +373,7 @@ public:
   static int compare_uint64(const MDB_val *a, const MDB_val *b);
   static int compare_hash32(const MDB_val *a, const MDB_val *b);
   static int compare_string(const MDB_val *a, const MDB_val *b);
+  static int compare_uint64_hash32(const MDB_val *a, const MDB_val *b);
 
 private:
   void do_resize(uint64_t size_increase=0);
@@ -389,6 +419,14 @@ private:
   virtual void remove_spent_key(const crypto::key_image& k_image);
 
   uint64_t num_outputs() const;
+  uint64_t num_spent_keys() const;
+
+  // spent key image filter
+  std::string get_key_image_filter_filename() const;
+  void rebuild_key_image_filter();
+  void check_key_image_filter_capacity();
+  void load_key_image_filter();
+  void store_key_image_filter();
 
   // Hard fork
   virtual void set_hard_fork_version(uint64_t height, uint8_t version);
@@ -398,10 +436,16 @@ private:
 
   inline void check_open() const;
 
+  // the caller must hold m_block_columns_lock
+  bool load_block_columns(uint64_t start_height, uint64_t end_height) const;
+  void invalidate_block_columns();
+
   bool prune_worker(int mode, uint32_t pruning_seed);
 
   virtual bool is_read_only() const;
 
+  virtual void invalidate_cache_from_height(uint64_t height);
+
   virtual uint64_t get_database_size() const;
 
   // fix up anything that may be wrong due to past bugs
@@ -425,12 +469,22 @@ private:
   // migrate from DB version 4 to 5
   void migrate_4_5();
 
+  // migrate from DB version 5 to 6
+  void migrate_5_6();
+
   void cleanup_batch();
 
 
   virtual void set_full_node_data(const std::string& data);
   virtual bool get_full_node_data(std::string& data);
+  virtual void add_full_node_data_delta(const std::string& data);
+  virtual void get_full_node_data_deltas(std::vector<std::string>& deltas);
   virtual void clear_full_node_data();
+  virtual void set_full_node_quorum_state(uint64_t height, const std::string& data);
+  virtual bool get_full_node_quorum_state(uint64_t height, std::string& data);
+  virtual void remove_full_node_quorum_states_from(uint64_t height);
+
+  virtual bool get_articles(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, size_t limit, std::vector<article_index_t> &articles) const;
 
 private:
   MDB_env* m_env;
@@ -452,6 +506,7 @@ private:
   MDB_dbi m_output_blacklist;
 
   MDB_dbi m_spent_keys;
+  std::shared_ptr<key_image_filter> m_key_image_filter; // swapped with std::atomic_store, NULL while there is none
 
   MDB_dbi m_txpool_meta;
   MDB_dbi m_txpool_blob;
@@ -460,9 +515,18 @@ private:
   MDB_dbi m_hf_versions;
 
   MDB_dbi m_full_node_data;
+  MDB_dbi m_full_node_quorums;
+  bool m_have_full_node_quorums; // not created when opening an older DB read-only
+  bool m_replica; // opened with DBF_REPLICA
+
+  MDB_dbi m_articles;
+  MDB_dbi m_article_publishers;
+  MDB_dbi m_article_contents;
 
   MDB_dbi m_properties;
 
+  uint32_t m_txs_pruned_codec; // codec new txs_pruned values are written with, from the "txs_pruned_codec" property
+
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
   std::string m_folder;
@@ -476,6 +540,33 @@ private:
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
 
+  // Dense per-height copies of the block_info fields that difficulty and
+  // weight windows scan, covering [base, base + size()). Extended from the
+  // db on demand and kept in step by add_block and remove_block; dropped
+  // when a write txn aborts, as it may then hold uncommitted values.
+  struct block_columns
+  {
+    uint64_t base = 0;
+    std::vector<uint64_t> timestamps;
+    std::vector<uint64_t> weights;
+    std::vector<uint64_t> long_term_weights;
+    std::vector<uint64_t> diff_lo;
+    std::vector<uint64_t> diff_hi;
+
+    uint64_t end() const { return base + timestamps.size(); }
+    void truncate(uint64_t height)
+    {
+      const size_t n = height > base ? height - base : 0;
+      timestamps.resize(n);
+      weights.resize(n);
+      long_term_weights.resize(n);
+      diff_lo.resize(n);
+      diff_hi.resize(n);
+    }
+  };
+  mutable block_columns m_block_columns;
+  mutable boost::mutex m_block_columns_lock;
+
 #if defined(__arm__)
   // force a value so it can compile with 32-bit ARM
   constexpr static uint64_t DEFAULT_MAPSIZE = 1LL << 31;
@@ -487,7 +578,19 @@ private:
 #endif
 #endif
 
+  // Resizing has to wait for every transaction of this process to finish,
+  // which stalls RPC and P2P. Where a map larger than the data only takes
+  // address space and a sparse file, it is reserved well ahead instead.
+#if !defined(_WIN32) && !defined(__arm__) && UINTPTR_MAX > 0xffffffff
+  constexpr static uint64_t RESERVED_MAPSIZE = 1ULL << 36;
+#else
+  constexpr static uint64_t RESERVED_MAPSIZE = 0;
+#endif
+
   constexpr static float RESIZE_PERCENT = 0.9f;
+
+  // about 40 bytes per block; the oldest half is dropped past this
+  constexpr static uint64_t BLOCK_COLUMNS_MAX = 1 << 18;
 };
 
 }  // namespace cryptonote
@@ -121,6 +121,8 @@ public:
   virtual void prune_outputs(uint64_t amount) override {}
   virtual uint32_t get_blockchain_pruning_seed() const override { return 0; }
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) override { return true; }
+  virtual bool start_incremental_pruning(uint32_t pruning_seed = 0) override { return true; }
+  virtual bool prune_step(size_t max_records, bool &done) override { done = true; return true; }
   virtual bool update_pruning() override { return true; }
   virtual bool check_pruning() override { return true; }
   virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const cryptonote::txpool_tx_meta_t&, const cryptonote::blobdata*)>, bool include_blob, bool include_unrelayed_txes) const override { return false; }
@@ -144,7 +146,13 @@ public:
   virtual void add_output_blacklist   (std::vector<uint64_t> const &blacklist)       override { }
   virtual void set_full_node_data  (const std::string& data)                      override { }
   virtual bool get_full_node_data  (std::string& data)                            override { return false; }
+  virtual void add_full_node_data_delta(const std::string& data)                  override { }
+  virtual void get_full_node_data_deltas(std::vector<std::string>& deltas)        override { deltas.clear(); }
   virtual void clear_full_node_data()                                             override { }
+  virtual void set_full_node_quorum_state(uint64_t height, const std::string& data) override { }
+  virtual bool get_full_node_quorum_state(uint64_t height, std::string& data)       override { return false; }
+  virtual void remove_full_node_quorum_states_from(uint64_t height)                 override { }
+  virtual bool get_articles(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, size_t limit, std::vector<cryptonote::article_index_t> &articles) const override { return false; }
 
   virtual cryptonote::transaction get_pruned_tx(const crypto::hash& h) const override { return {}; };
   virtual bool get_tx(const crypto::hash& h, cryptonote::transaction &tx) const override { return false; }
@@ -30,6 +30,7 @@
  #define __STDC_FORMAT_MACROS // NOTE(antd): Explicitly define the SCNu64 macro on Mingw
 #endif
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 #include <boost/filesystem.hpp>
@@ -43,6 +44,7 @@
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "blockchain_objects.h"
+#include "blockchain_scan.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/db_types.h"
 #include "version.h"
@@ -55,7 +57,7 @@ using namespace epee;
 using namespace cryptonote;
 
 static bool stop_requested = false;
-static uint64_t cached_txes = 0, cached_blocks = 0, cached_outputs = 0, total_txes = 0, total_blocks = 0, total_outputs = 0;
+static std::atomic<uint64_t> cached_txes(0), cached_blocks(0), cached_outputs(0), total_txes(0), total_blocks(0), total_outputs(0);
 static bool opt_cache_outputs = false, opt_cache_txes = false, opt_cache_blocks = false;
 
 struct ancestor
@@ -177,6 +179,28 @@ struct ancestry_state_t
 };
 BOOST_CLASS_VERSION(ancestry_state_t, 2)
 
+// cache entries added while the state is only read, applied when it can be written
+struct cache_updates_t
+{
+  std::unordered_map<ancestor, crypto::hash> outputs;
+  std::unordered_map<crypto::hash, ::tx_data_t> txes;
+  std::unordered_map<uint64_t, cryptonote::block> blocks;
+};
+
+static void apply_cache_updates(ancestry_state_t &state, cache_updates_t &updates)
+{
+  for (auto &i: updates.outputs)
+    state.output_cache.insert(std::move(i));
+  for (auto &i: updates.txes)
+    state.tx_cache.insert(std::move(i));
+  for (auto &i: updates.blocks)
+  {
+    if (state.block_cache.size() <= i.first)
+      state.block_cache.resize(i.first + 1);
+    state.block_cache[i.first] = std::move(i.second);
+  }
+}
+
 static void add_ancestor(std::unordered_map<ancestor, unsigned int> &ancestry, uint64_t amount, uint64_t offset)
 {
   std::pair<std::unordered_map<ancestor, unsigned int>::iterator, bool> p = ancestry.insert(std::make_pair(ancestor{amount, offset}, 1));
@@ -227,7 +251,7 @@ static std::unordered_set<ancestor> get_ancestry(const std::unordered_map<crypto
   return i->second;
 }
 
-static bool get_block_from_height(ancestry_state_t &state, BlockchainDB *db, uint64_t height, cryptonote::block &b)
+static bool get_block_from_height(const ancestry_state_t &state, cache_updates_t &updates, BlockchainDB *db, uint64_t height, cryptonote::block &b)
 {
   ++total_blocks;
   if (state.block_cache.size() > height && !state.block_cache[height].miner_tx.vin.empty())
@@ -236,6 +260,13 @@ static bool get_block_from_height(ancestry_state_t &state, BlockchainDB *db, uin
     b = state.block_cache[height];
     return true;
   }
+  std::unordered_map<uint64_t, cryptonote::block>::const_iterator i = updates.blocks.find(height);
+  if (i != updates.blocks.end())
+  {
+    ++cached_blocks;
+    b = i->second;
+    return true;
+  }
   cryptonote::blobdata bd = db->get_block_blob_from_height(height);
   if (!cryptonote::parse_and_validate_block_from_blob(bd, b))
   {
@@ -243,18 +274,15 @@ static bool get_block_from_height(ancestry_state_t &state, BlockchainDB *db, uin
     return false;
   }
   if (opt_cache_blocks)
-  {
-    state.block_cache.resize(height + 1);
-    state.block_cache[height] = b;
-  }
+    updates.blocks[height] = b;
   return true;
 }
 
-static bool get_transaction(ancestry_state_t &state, BlockchainDB *db, const crypto::hash &txid, ::tx_data_t &tx_data)
+static bool get_transaction(const ancestry_state_t &state, cache_updates_t &updates, BlockchainDB *db, const crypto::hash &txid, ::tx_data_t &tx_data)
 {
   std::unordered_map<crypto::hash, ::tx_data_t>::const_iterator i = state.tx_cache.find(txid);
   ++total_txes;
-  if (i != state.tx_cache.end())
+  if (i != state.tx_cache.end() || (i = updates.txes.find(txid)) != updates.txes.end())
   {
     ++cached_txes;
     tx_data = i->second;
@@ -275,15 +303,15 @@ static bool get_transaction(ancestry_state_t &state, BlockchainDB *db, const cry
   }
   tx_data = ::tx_data_t(tx);
   if (opt_cache_txes)
-    state.tx_cache.insert(std::make_pair(txid, tx_data));
+    updates.txes.insert(std::make_pair(txid, tx_data));
   return true;
 }
 
-static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t amount, uint64_t offset, crypto::hash &txid)
+static bool get_output_txid(const ancestry_state_t &state, cache_updates_t &updates, BlockchainDB *db, uint64_t amount, uint64_t offset, crypto::hash &txid)
 {
   ++total_outputs;
   std::unordered_map<ancestor, crypto::hash>::const_iterator i = state.output_cache.find({amount, offset});
-  if (i != state.output_cache.end())
+  if (i != state.output_cache.end() || (i = updates.outputs.find({amount, offset})) != updates.outputs.end())
   {
     ++cached_outputs;
     txid = i->second;
@@ -292,7 +320,7 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
 
   const output_data_t od = db->get_output_key(amount, offset, false);
   cryptonote::block b;
-  if (!get_block_from_height(state, db, od.height, b))
+  if (!get_block_from_height(state, updates, db, od.height, b))
     return false;
 
   for (size_t out = 0; out < b.miner_tx.vout.size(); ++out)
@@ -304,7 +332,7 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
       {
         txid = cryptonote::get_transaction_hash(b.miner_tx);
         if (opt_cache_outputs)
-          state.output_cache.insert(std::make_pair(ancestor{amount, offset}, txid));
+          updates.outputs.insert(std::make_pair(ancestor{amount, offset}, txid));
         return true;
       }
     }
@@ -317,7 +345,7 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
   for (const crypto::hash &block_txid: b.tx_hashes)
   {
     ::tx_data_t tx_data3;
-    if (!get_transaction(state, db, block_txid, tx_data3))
+    if (!get_transaction(state, updates, db, block_txid, tx_data3))
       return false;
 
     for (size_t out = 0; out < tx_data3.vout.size(); ++out)
@@ -326,7 +354,7 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
       {
         txid = block_txid;
         if (opt_cache_outputs)
-          state.output_cache.insert(std::make_pair(ancestor{amount, offset}, txid));
+          updates.outputs.insert(std::make_pair(ancestor{amount, offset}, txid));
         return true;
       }
     }
@@ -334,6 +362,98 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
   return false;
 }
 
+static bool get_transaction(ancestry_state_t &state, BlockchainDB *db, const crypto::hash &txid, ::tx_data_t &tx_data)
+{
+  cache_updates_t updates;
+  const bool r = get_transaction(state, updates, db, txid, tx_data);
+  apply_cache_updates(state, updates);
+  return r;
+}
+
+static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t amount, uint64_t offset, crypto::hash &txid)
+{
+  cache_updates_t updates;
+  const bool r = get_output_txid(state, updates, db, amount, offset, txid);
+  apply_cache_updates(state, updates);
+  return r;
+}
+
+// a block's txes and the txids which created their ring members, looked up
+// ahead of adding them to the ancestry
+struct refresh_tx_t
+{
+  crypto::hash txid;
+  ::tx_data_t tx_data;
+  std::vector<ancestor> inputs;
+  std::vector<crypto::hash> input_txids;
+};
+
+struct refresh_block_t
+{
+  uint64_t height;
+  std::vector<refresh_tx_t> txes;
+};
+
+struct refresh_range_t
+{
+  std::vector<refresh_block_t> blocks;
+  cache_updates_t updates;
+};
+
+static bool scan_refresh(const ancestry_state_t &state, BlockchainDB *db, uint64_t begin, uint64_t end, bool include_coinbase, refresh_range_t &range)
+{
+  range.blocks.reserve(end - begin);
+  for (uint64_t h = begin; h < end; ++h)
+  {
+    const cryptonote::blobdata bd = db->get_block_blob_from_height(h);
+    ++total_blocks;
+    cryptonote::block b;
+    if (!cryptonote::parse_and_validate_block_from_blob(bd, b))
+    {
+      LOG_PRINT_L0("Bad block from db");
+      return false;
+    }
+    range.blocks.push_back(refresh_block_t());
+    refresh_block_t &block = range.blocks.back();
+    block.height = h;
+    std::vector<crypto::hash> txids;
+    txids.reserve(1 + b.tx_hashes.size());
+    if (include_coinbase)
+      txids.push_back(cryptonote::get_transaction_hash(b.miner_tx));
+    for (const auto &txid: b.tx_hashes)
+      txids.push_back(txid);
+    if (opt_cache_blocks)
+      range.updates.blocks[h] = std::move(b);
+    block.txes.resize(txids.size());
+    for (size_t n = 0; n < txids.size(); ++n)
+    {
+      refresh_tx_t &tx = block.txes[n];
+      tx.txid = txids[n];
+      if (!get_transaction(state, range.updates, db, tx.txid, tx.tx_data))
+        return false;
+      if (tx.tx_data.coinbase)
+        continue;
+      for (size_t ring = 0; ring < tx.tx_data.vin.size(); ++ring)
+      {
+        const uint64_t amount = tx.tx_data.vin[ring].first;
+        for (uint64_t offset: tx.tx_data.vin[ring].second)
+        {
+          // find the tx which created this output
+          crypto::hash output_txid;
+          if (!get_output_txid(state, range.updates, db, amount, offset, output_txid))
+          {
+            LOG_PRINT_L0("Output originating transaction not found");
+            return false;
+          }
+          tx.inputs.push_back(ancestor{amount, offset});
+          tx.input_txids.push_back(output_txid);
+        }
+      }
+    }
+  }
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -518,96 +638,51 @@ int main(int argc, char* argv[])
   {
     MINFO("Starting from height " << state.height);
     state.block_cache.reserve(db_height);
-    for (uint64_t h = state.height; h < db_height; ++h)
+    // txes and their ring members' origins are looked up in parallel, a range
+    // of blocks at a time, then added to the ancestry in chain order
+    const auto scan = [&](uint64_t begin, uint64_t end, refresh_range_t &range)
     {
-      size_t block_ancestry_size = 0;
-      const cryptonote::blobdata bd = db->get_block_blob_from_height(h);
-      ++total_blocks;
-      cryptonote::block b;
-      if (!cryptonote::parse_and_validate_block_from_blob(bd, b))
-      {
-        LOG_PRINT_L0("Bad block from db");
-        return 1;
-      }
-      if (opt_cache_blocks)
-      {
-        state.block_cache.resize(h + 1);
-        state.block_cache[h] = b;
-      }
-      std::vector<crypto::hash> txids;
-      txids.reserve(1 + b.tx_hashes.size());
-      if (opt_include_coinbase)
-        txids.push_back(cryptonote::get_transaction_hash(b.miner_tx));
-      for (const auto &h: b.tx_hashes)
-        txids.push_back(h);
-      for (const crypto::hash &txid: txids)
+      return scan_refresh(state, db, begin, end, opt_include_coinbase, range);
+    };
+    const auto merge = [&](refresh_range_t &range)
+    {
+      apply_cache_updates(state, range.updates);
+      for (const refresh_block_t &block: range.blocks)
       {
-        printf("%lu/%lu               \r", (unsigned long)h, (unsigned long)db_height);
-        fflush(stdout);
-        ::tx_data_t tx_data;
-        std::unordered_map<crypto::hash, ::tx_data_t>::const_iterator i = state.tx_cache.find(txid);
-        ++total_txes;
-        if (i != state.tx_cache.end())
-        {
-          ++cached_txes;
-          tx_data = i->second;
-        }
-        else
+        size_t block_ancestry_size = 0;
+        for (const refresh_tx_t &tx: block.txes)
         {
-          cryptonote::blobdata bd;
-          if (!db->get_pruned_tx_blob(txid, bd))
+          printf("%lu/%lu               \r", (unsigned long)block.height, (unsigned long)db_height);
+          fflush(stdout);
+          if (tx.tx_data.coinbase)
           {
-            LOG_PRINT_L0("Failed to get txid " << txid << " from db");
-            return 1;
+            add_ancestry(state.ancestry, tx.txid, std::unordered_set<ancestor>());
           }
-          cryptonote::transaction tx;
-          if (!cryptonote::parse_and_validate_tx_base_from_blob(bd, tx))
+          else
           {
-            LOG_PRINT_L0("Bad tx: " << txid);
-            return 1;
-          }
-          tx_data = ::tx_data_t(tx);
-          if (opt_cache_txes)
-            state.tx_cache.insert(std::make_pair(txid, tx_data));
-        }
-        if (tx_data.coinbase)
-        {
-          add_ancestry(state.ancestry, txid, std::unordered_set<ancestor>());
-        }
-        else
-        {
-          for (size_t ring = 0; ring < tx_data.vin.size(); ++ring)
-          {
-            const uint64_t amount = tx_data.vin[ring].first;
-            const std::vector<uint64_t> &absolute_offsets = tx_data.vin[ring].second;
-            for (uint64_t offset: absolute_offsets)
+            for (size_t n = 0; n < tx.inputs.size(); ++n)
             {
-              add_ancestry(state.ancestry, txid, ancestor{amount, offset});
-              // find the tx which created this output
-              bool found = false;
-              crypto::hash output_txid;
-              if (!get_output_txid(state, db, amount, offset, output_txid))
-              {
-                LOG_PRINT_L0("Output originating transaction not found");
-                return 1;
-              }
-              add_ancestry(state.ancestry, txid, get_ancestry(state.ancestry, output_txid));
+              add_ancestry(state.ancestry, tx.txid, tx.inputs[n]);
+              add_ancestry(state.ancestry, tx.txid, get_ancestry(state.ancestry, tx.input_txids[n]));
             }
           }
+          const size_t ancestry_size = get_ancestry(state.ancestry, tx.txid).size();
+          block_ancestry_size += ancestry_size;
+          MINFO(tx.txid << ": " << ancestry_size);
         }
-        const size_t ancestry_size = get_ancestry(state.ancestry, txid).size();
-        block_ancestry_size += ancestry_size;
-        MINFO(txid << ": " << ancestry_size);
-      }
-      if (!txids.empty())
-      {
-        std::string stats_msg;
-        MINFO("Height " << h << ": " << (block_ancestry_size / txids.size()) << " average over " << txids.size() << stats_msg);
+        if (!block.txes.empty())
+        {
+          std::string stats_msg;
+          MINFO("Height " << block.height << ": " << (block_ancestry_size / block.txes.size()) << " average over " << block.txes.size() << stats_msg);
+        }
+        state.height = block.height;
+        if (stop_requested)
+          return false;
       }
-      state.height = h;
-      if (stop_requested)
-        break;
-    }
+      return true;
+    };
+    if (!parallel_scan<refresh_range_t>(state.height, db_height, 100, scan, merge))
+      return 1;
 
     LOG_PRINT_L0("Saving state data to " << state_file_path);
     std::ofstream state_data_out;
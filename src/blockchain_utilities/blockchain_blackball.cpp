@@ -38,6 +38,7 @@
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/command_line.h"
 #include "common/varint.h"
+#include "common/threadpool.h"
 #include "serialization/crypto.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_core/cryptonote_core.h"
@@ -395,11 +396,7 @@ static bool for_all_transactions(const std::string &filename, uint64_t &start_id
       continue;
 
     cryptonote::transaction_prefix tx;
-    blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
-    std::stringstream ss;
-    ss << bd;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::span<const uint8_t>(reinterpret_cast<const uint8_t*>(v.mv_data), v.mv_size));
     bool r = do_serialize(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
 
@@ -1004,6 +1001,46 @@ static std::vector<std::pair<uint64_t, uint64_t>> load_outputs(const std::string
   return outputs;
 }
 
+// Finds the outputs that the rings using scan_spent[begin, end) prove spent:
+// rings where every other member is already known to be spent. Runs in its
+// own read transaction, so several ranges can be scanned at once.
+static void find_chain_reaction_outputs(const std::vector<output_data> &scan_spent, size_t begin, size_t end, const bool &stop_requested,
+    std::vector<std::pair<output_data, size_t>> &found)
+{
+  MDB_txn *txn;
+  int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+  CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_txn_abort(txn);});
+  MDB_cursor *cur;
+  dbr = mdb_cursor_open(txn, dbi_spent, &cur);
+  CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
+  epee::misc_utils::auto_scope_leave_caller cur_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_cursor_close(cur);});
+
+  for (size_t n = begin; n < end && !stop_requested; ++n)
+  {
+    const output_data &od = scan_spent[n];
+    std::vector<crypto::key_image> key_images = get_key_images(txn, od);
+    for (const crypto::key_image &ki: key_images)
+    {
+      std::vector<uint64_t> relative_ring;
+      CHECK_AND_ASSERT_THROW_MES(get_relative_ring(txn, ki, relative_ring), "Relative ring not found");
+      std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_ring);
+      size_t known = 0;
+      uint64_t last_unknown = 0;
+      for (uint64_t out: absolute)
+      {
+        output_data new_od(od.amount, out);
+        if (is_output_spent(cur, new_od))
+          ++known;
+        else
+          last_unknown = out;
+      }
+      if (known == absolute.size() - 1)
+        found.push_back(std::make_pair(output_data(od.amount, last_unknown), absolute.size()));
+    }
+  }
+}
+
 static bool export_spent_outputs(MDB_cursor *cur, const std::string &filename)
 {
   FILE *f = fopen(filename.c_str(), "w");
@@ -1460,6 +1497,37 @@ int main(int argc, char* argv[])
   {
     LOG_PRINT_L0("Secondary pass on " << work_spent.size() << " spent outputs");
 
+    // Scan the rings against a snapshot of the spent set in parallel, then
+    // record the results in a single write transaction. Outputs proven spent
+    // by this pass are picked up by the next one, so the fixpoint is the same
+    // as when applying them one at a time.
+    std::vector<output_data> scan_spent = std::move(work_spent);
+    work_spent.clear();
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    const size_t n_chunks = std::min<size_t>(scan_spent.size(), 4 * tpool.get_max_concurrency());
+    const size_t chunk_size = (scan_spent.size() + n_chunks - 1) / n_chunks;
+    std::vector<std::vector<std::pair<output_data, size_t>>> found(n_chunks);
+    std::vector<std::exception_ptr> errors(n_chunks);
+    tools::threadpool::waiter waiter;
+    for (size_t c = 0; c < n_chunks; ++c)
+    {
+      const size_t begin = c * chunk_size, end = std::min(scan_spent.size(), begin + chunk_size);
+      tpool.submit(&waiter, [&scan_spent, &stop_requested, &found, &errors, c, begin, end]() {
+        try { find_chain_reaction_outputs(scan_spent, begin, end, stop_requested, found[c]); }
+        catch (...) { errors[c] = std::current_exception(); }
+      }, true);
+    }
+    waiter.wait(&tpool);
+    for (const std::exception_ptr &e: errors)
+      if (e)
+        std::rethrow_exception(e);
+
+    if (stop_requested)
+    {
+      MINFO("Stopping secondary passes. Secondary passes are not incremental, they will re-run fully.");
+      return 0;
+    }
+
     int dbr = resize_env(cache_dir.c_str());
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to resize LMDB database: " + std::string(mdb_strerror(dbr)));
 
@@ -1471,45 +1539,22 @@ int main(int argc, char* argv[])
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
 
     std::vector<std::pair<uint64_t, uint64_t>> blackballs;
-    std::vector<output_data> scan_spent = std::move(work_spent);
-    work_spent.clear();
-    for (const output_data &od: scan_spent)
+    for (const auto &chunk: found)
     {
-      std::vector<crypto::key_image> key_images = get_key_images(txn, od);
-      for (const crypto::key_image &ki: key_images)
+      for (const std::pair<output_data, size_t> &candidate: chunk)
       {
-        std::vector<uint64_t> relative_ring;
-        CHECK_AND_ASSERT_THROW_MES(get_relative_ring(txn, ki, relative_ring), "Relative ring not found");
-        std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_ring);
-        size_t known = 0;
-        uint64_t last_unknown = 0;
-        for (uint64_t out: absolute)
+        const output_data &od = candidate.first;
+        if (!add_spent_output(cur, od))
+          continue;
+        const std::pair<uint64_t, uint64_t> output = std::make_pair(od.amount, od.offset);
+        if (opt_verbose)
         {
-          output_data new_od(od.amount, out);
-          if (is_output_spent(cur, new_od))
-            ++known;
-          else
-            last_unknown = out;
+          MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a " <<
+              candidate.second << "-ring where all other outputs are known to be spent");
         }
-        if (known == absolute.size() - 1)
-        {
-          const std::pair<uint64_t, uint64_t> output = std::make_pair(od.amount, last_unknown);
-          if (opt_verbose)
-          {
-            MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a " <<
-                absolute.size() << "-ring where all other outputs are known to be spent");
-          }
-          blackballs.push_back(output);
-          if (add_spent_output(cur, output_data(od.amount, last_unknown)))
-            inc_stat(txn, od.amount ? "pre-rct-chain-reaction" : "rct-chain-reaction");
-          work_spent.push_back(output_data(od.amount, last_unknown));
-        }
-      }
-
-      if (stop_requested)
-      {
-        MINFO("Stopping secondary passes. Secondary passes are not incremental, they will re-run fully.");
-        return 0;
+        inc_stat(txn, od.amount ? "pre-rct-chain-reaction" : "rct-chain-reaction");
+        blackballs.push_back(output);
+        work_spent.push_back(od);
       }
     }
     if (!blackballs.empty())
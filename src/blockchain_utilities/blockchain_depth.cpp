@@ -32,6 +32,7 @@
 #include "common/varint.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "blockchain_objects.h"
+#include "blockchain_scan.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/db_types.h"
 #include "version.h"
@@ -43,6 +44,118 @@ namespace po = boost::program_options;
 using namespace epee;
 using namespace cryptonote;
 
+// adds the txids which created the outputs in txid's rings, coinbase is set
+// instead if txid is a coinbase transaction
+static bool get_parent_txids(BlockchainDB *db, const crypto::hash &txid, bool &coinbase, std::vector<crypto::hash> &new_txids)
+{
+  cryptonote::blobdata bd;
+  if (!db->get_pruned_tx_blob(txid, bd))
+  {
+    LOG_PRINT_L0("Failed to get txid " << txid << " from db");
+    return false;
+  }
+  cryptonote::transaction tx;
+  if (!cryptonote::parse_and_validate_tx_base_from_blob(bd, tx))
+  {
+    LOG_PRINT_L0("Bad tx: " << txid);
+    return false;
+  }
+  for (size_t ring = 0; ring < tx.vin.size(); ++ring)
+  {
+    if (tx.vin[ring].type() == typeid(cryptonote::txin_gen))
+    {
+      MDEBUG(txid << " is a coinbase transaction");
+      coinbase = true;
+      return true;
+    }
+    if (tx.vin[ring].type() == typeid(cryptonote::txin_to_key))
+    {
+      const cryptonote::txin_to_key &txin = boost::get<cryptonote::txin_to_key>(tx.vin[ring]);
+      const uint64_t amount = txin.amount;
+      auto absolute_offsets = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
+      for (uint64_t offset: absolute_offsets)
+      {
+        const output_data_t od = db->get_output_key(amount, offset);
+        const crypto::hash block_hash = db->get_block_hash_from_height(od.height);
+        bd = db->get_block_blob(block_hash);
+        cryptonote::block b;
+        if (!cryptonote::parse_and_validate_block_from_blob(bd, b))
+        {
+          LOG_PRINT_L0("Bad block from db");
+          return false;
+        }
+        // find the tx which created this output
+        bool found = false;
+        for (size_t out = 0; out < b.miner_tx.vout.size(); ++out)
+        {
+          if (b.miner_tx.vout[out].target.type() == typeid(cryptonote::txout_to_key))
+          {
+            const auto &txout = boost::get<cryptonote::txout_to_key>(b.miner_tx.vout[out].target);
+            if (txout.key == od.pubkey)
+            {
+              found = true;
+              new_txids.push_back(cryptonote::get_transaction_hash(b.miner_tx));
+              MDEBUG("adding txid: " << cryptonote::get_transaction_hash(b.miner_tx));
+              break;
+            }
+          }
+          else
+          {
+            LOG_PRINT_L0("Bad vout type in txid " << cryptonote::get_transaction_hash(b.miner_tx));
+            return false;
+          }
+        }
+        for (const crypto::hash &block_txid: b.tx_hashes)
+        {
+          if (found)
+            break;
+          if (!db->get_pruned_tx_blob(block_txid, bd))
+          {
+            LOG_PRINT_L0("Failed to get txid " << block_txid << " from db");
+            return false;
+          }
+          cryptonote::transaction tx2;
+          if (!cryptonote::parse_and_validate_tx_base_from_blob(bd, tx2))
+          {
+            LOG_PRINT_L0("Bad tx: " << block_txid);
+            return false;
+          }
+          for (size_t out = 0; out < tx2.vout.size(); ++out)
+          {
+            if (tx2.vout[out].target.type() == typeid(cryptonote::txout_to_key))
+            {
+              const auto &txout = boost::get<cryptonote::txout_to_key>(tx2.vout[out].target);
+              if (txout.key == od.pubkey)
+              {
+                found = true;
+                new_txids.push_back(block_txid);
+                MDEBUG("adding txid: " << block_txid);
+                break;
+              }
+            }
+            else
+            {
+              LOG_PRINT_L0("Bad vout type in txid " << block_txid);
+              return false;
+            }
+          }
+        }
+        if (!found)
+        {
+          LOG_PRINT_L0("Output originating transaction not found");
+          return false;
+        }
+      }
+    }
+    else
+    {
+      LOG_PRINT_L0("Bad vin type in txid " << txid);
+      return false;
+    }
+  }
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -205,121 +318,33 @@ int main(int argc, char* argv[])
     {
       LOG_PRINT_L0("Considering "<< txids.size() << " transaction(s) at depth " << depth);
       std::vector<crypto::hash> new_txids;
-      for (const crypto::hash &txid: txids)
+      // the txids at this depth are looked up in parallel, and their parents appended in order
+      struct parents_t
       {
-        cryptonote::blobdata bd;
-        if (!db->get_pruned_tx_blob(txid, bd))
-        {
-          LOG_PRINT_L0("Failed to get txid " << txid << " from db");
-          return 1;
-        }
-        cryptonote::transaction tx;
-        if (!cryptonote::parse_and_validate_tx_base_from_blob(bd, tx))
-        {
-          LOG_PRINT_L0("Bad tx: " << txid);
-          return 1;
-        }
-        for (size_t ring = 0; ring < tx.vin.size(); ++ring)
-        {
-          if (tx.vin[ring].type() == typeid(cryptonote::txin_gen))
-          {
-            MDEBUG(txid << " is a coinbase transaction");
-            coinbase = true;
-            goto done;
-          }
-          if (tx.vin[ring].type() == typeid(cryptonote::txin_to_key))
-          {
-            const cryptonote::txin_to_key &txin = boost::get<cryptonote::txin_to_key>(tx.vin[ring]);
-            const uint64_t amount = txin.amount;
-            auto absolute_offsets = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-            for (uint64_t offset: absolute_offsets)
-            {
-              const output_data_t od = db->get_output_key(amount, offset);
-              const crypto::hash block_hash = db->get_block_hash_from_height(od.height);
-              bd = db->get_block_blob(block_hash);
-              cryptonote::block b;
-              if (!cryptonote::parse_and_validate_block_from_blob(bd, b))
-              {
-                LOG_PRINT_L0("Bad block from db");
-                return 1;
-              }
-              // find the tx which created this output
-              bool found = false;
-              for (size_t out = 0; out < b.miner_tx.vout.size(); ++out)
-              {
-                if (b.miner_tx.vout[out].target.type() == typeid(cryptonote::txout_to_key))
-                {
-                  const auto &txout = boost::get<cryptonote::txout_to_key>(b.miner_tx.vout[out].target);
-                  if (txout.key == od.pubkey)
-                  {
-                    found = true;
-                    new_txids.push_back(cryptonote::get_transaction_hash(b.miner_tx));
-                    MDEBUG("adding txid: " << cryptonote::get_transaction_hash(b.miner_tx));
-                    break;
-                  }
-                }
-                else
-                {
-                  LOG_PRINT_L0("Bad vout type in txid " << cryptonote::get_transaction_hash(b.miner_tx));
-                  return 1;
-                }
-              }
-              for (const crypto::hash &block_txid: b.tx_hashes)
-              {
-                if (found)
-                  break;
-                if (!db->get_pruned_tx_blob(block_txid, bd))
-                {
-                  LOG_PRINT_L0("Failed to get txid " << block_txid << " from db");
-                  return 1;
-                }
-                cryptonote::transaction tx2;
-                if (!cryptonote::parse_and_validate_tx_base_from_blob(bd, tx2))
-                {
-                  LOG_PRINT_L0("Bad tx: " << block_txid);
-                  return 1;
-                }
-                for (size_t out = 0; out < tx2.vout.size(); ++out)
-                {
-                  if (tx2.vout[out].target.type() == typeid(cryptonote::txout_to_key))
-                  {
-                    const auto &txout = boost::get<cryptonote::txout_to_key>(tx2.vout[out].target);
-                    if (txout.key == od.pubkey)
-                    {
-                      found = true;
-                      new_txids.push_back(block_txid);
-                      MDEBUG("adding txid: " << block_txid);
-                      break;
-                    }
-                  }
-                  else
-                  {
-                    LOG_PRINT_L0("Bad vout type in txid " << block_txid);
-                    return 1;
-                  }
-                }
-              }
-              if (!found)
-              {
-                LOG_PRINT_L0("Output originating transaction not found");
-                return 1;
-              }
-            }
-          }
-          else
-          {
-            LOG_PRINT_L0("Bad vin type in txid " << txid);
-            return 1;
-          }
-        }
-      }
+        bool coinbase = false;
+        std::vector<crypto::hash> txids;
+      };
+      const auto scan = [&](uint64_t begin, uint64_t end, parents_t &parents)
+      {
+        for (uint64_t n = begin; n < end && !parents.coinbase; ++n)
+          if (!get_parent_txids(db, txids[n], parents.coinbase, parents.txids))
+            return false;
+        return true;
+      };
+      const auto merge = [&](parents_t &parents)
+      {
+        new_txids.insert(new_txids.end(), parents.txids.begin(), parents.txids.end());
+        coinbase = parents.coinbase;
+        return !coinbase;
+      };
+      if (!parallel_scan<parents_t>(0, txids.size(), 16, scan, merge))
+        return 1;
       if (!coinbase)
       {
         std::swap(txids, new_txids);
         ++depth;
       }
     }
-done:
     LOG_PRINT_L0("Min depth for txid " << start_txid << ": " << depth);
     depths.push_back(depth);
   }
@@ -55,6 +55,8 @@ int main(int argc, char* argv[])
   uint32_t log_level = 0;
   uint64_t block_stop = 0;
   bool blocks_dat = false;
+  bool indexed = false;
+  bool compress = false;
 
   tools::on_startup();
 
@@ -69,6 +71,8 @@ int main(int argc, char* argv[])
     "database", available_dbs.c_str(), default_db_type
   };
   const command_line::arg_descriptor<bool> arg_blocks_dat = {"blocksdat", "Output in blocks.dat format", blocks_dat};
+  const command_line::arg_descriptor<bool> arg_indexed = {"indexed", "Write a v2 bootstrap file with a block index, for random access and parallel import", indexed};
+  const command_line::arg_descriptor<bool> arg_compress = {"compress", "Compress the chunks of an indexed bootstrap file with zstd", compress};
 
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
@@ -79,6 +83,8 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_database);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
   command_line::add_arg(desc_cmd_sett, arg_blocks_dat);
+  command_line::add_arg(desc_cmd_sett, arg_indexed);
+  command_line::add_arg(desc_cmd_sett, arg_compress);
 
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -119,6 +125,13 @@ int main(int argc, char* argv[])
     return 1;
   }
   bool opt_blocks_dat = command_line::get_arg(vm, arg_blocks_dat);
+  bool opt_indexed = command_line::get_arg(vm, arg_indexed);
+  bool opt_compress = command_line::get_arg(vm, arg_compress);
+  if (opt_compress && !opt_indexed)
+  {
+    std::cerr << "--compress needs --indexed" << std::endl;
+    return 1;
+  }
 
   std::string m_config_folder;
 
@@ -182,7 +195,7 @@ int main(int argc, char* argv[])
   else
   {
     BootstrapFile bootstrap;
-    r = bootstrap.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop);
+    r = bootstrap.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop, opt_indexed, opt_compress);
   }
   CHECK_AND_ASSERT_MES(r, 1, "Failed to export blockchain raw data");
   LOG_PRINT_L0("Blockchain raw data exported OK");
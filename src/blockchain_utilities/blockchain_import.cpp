@@ -28,12 +28,17 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <algorithm>
+#include <deque>
 #include <fstream>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <unistd.h>
 #include "misc_log_ex.h"
 #include "bootstrap_file.h"
@@ -43,6 +48,7 @@
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
 #include "include_base_utils.h"
+#include "common/threadpool.h"
 #include "blockchain_db/db_types.h"
 #include "cryptonote_core/cryptonote_core.h"
 
@@ -167,37 +173,306 @@ int pop_blocks(cryptonote::core& core, int num_blocks)
   return num_blocks;
 }
 
-int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &blocks, bool force)
+// reads the chunk at height h of an indexed bootstrap file, same results as read_chunk
+int read_chunk(const BootstrapChunkReader &indexed, uint64_t h, std::string &chunk, uint64_t &bytes_read)
 {
-  if (blocks.empty())
-    return 0;
-  if (!force && blocks.size() < db_batch_size)
-    return 0;
+  if (h >= indexed.block_first() + indexed.block_count())
+  {
+    std::cout << refresh_string;
+    MINFO("End of file reached");
+    return 1;
+  }
+  if (!indexed.get_chunk(h, chunk))
+    return 2;
+  bytes_read += indexed.bytes(h, 1);
+  return 0;
+}
 
-  // wait till we can verify a full HOH without extra, for speed
-  uint64_t new_height = core.get_blockchain_storage().get_db().height() + blocks.size();
-  if (!force && new_height % HASH_OF_HASHES_STEP)
-    return 0;
+// reads the next chunk of the bootstrap file: returns 0 when a chunk was
+// read, 1 at the end of the file and 2 on errors
+int read_chunk(std::ifstream &import_file, std::string &chunk, uint64_t &bytes_read)
+{
+  uint32_t chunk_size;
+  char buffer1[sizeof(chunk_size)];
+  import_file.read(buffer1, sizeof(chunk_size));
+  // TODO: bootstrap.read_chunk();
+  if (! import_file) {
+    std::cout << refresh_string;
+    MINFO("End of file reached");
+    return 1;
+  }
+  bytes_read += sizeof(chunk_size);
 
-  std::vector<crypto::hash> hashes;
-  for (const auto &b: blocks)
+  if (! ::serialization::parse_binary(std::string(buffer1, sizeof(chunk_size)), chunk_size))
+  {
+    throw std::runtime_error("Error in deserialization of chunk size");
+  }
+  MDEBUG("chunk_size: " << chunk_size);
+
+  if (chunk_size > BUFFER_SIZE)
+  {
+    MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
+    throw std::runtime_error("Aborting: chunk size exceeds buffer size");
+  }
+  if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
   {
-    cryptonote::block block;
-    if (!parse_and_validate_block_from_blob(b.block, block))
+    MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
+  }
+  else if (chunk_size == 0) {
+    MFATAL("ERROR: chunk_size == 0");
+    return 2;
+  }
+  chunk.resize(chunk_size);
+  import_file.read(&chunk[0], chunk_size);
+  if (! import_file) {
+    if (import_file.eof())
     {
-      MERROR("Failed to parse block: "
-          << epee::string_tools::pod_to_hex(get_blob_hash(b.block)));
-      core.cleanup_handle_incoming_blocks();
+      std::cout << refresh_string;
+      MINFO("End of file reached - file was truncated");
       return 1;
     }
-    hashes.push_back(cryptonote::get_block_hash(block));
+    else
+    {
+      MFATAL("ERROR: unexpected end of file: bytes read before error: "
+          << import_file.gcount() << " of chunk_size " << chunk_size);
+      return 2;
+    }
+  }
+  bytes_read += chunk_size;
+  MDEBUG("Total bytes read: " << bytes_read);
+  return 0;
+}
+
+bool parse_chunk(const std::string &chunk, uint8_t major_version, bootstrap::block_package &bp)
+{
+  if (major_version == 0)
+  {
+    bootstrap::block_package_1 bp1;
+    if (!::serialization::parse_binary(chunk, bp1))
+      return false;
+    bp.block = std::move(bp1.block);
+    bp.txs = std::move(bp1.txs);
+    bp.block_weight = bp1.block_weight;
+    bp.cumulative_difficulty = bp1.cumulative_difficulty;
+    bp.coins_generated = bp1.coins_generated;
+    return true;
+  }
+  return ::serialization::parse_binary(chunk, bp);
+}
+
+// blocks read and decoded ahead of verification; a batch ends where the
+// hash of hashes check covers it without extra blocks
+struct import_batch
+{
+  uint64_t start_height;
+  uint64_t bytes;
+  std::vector<block_complete_entry> blocks;
+  std::vector<crypto::hash> hashes;
+};
+
+// Reads batches from the bootstrap file on its own thread and decodes them
+// on the threadpool, while the caller verifies and adds the previous ones.
+// With an indexed file the chunks are also fetched on the threadpool.
+class import_pipeline
+{
+public:
+  import_pipeline(std::ifstream &import_file, const BootstrapChunkReader *indexed, uint8_t major_version, uint64_t start_height, uint64_t block_stop):
+    import_file(import_file), indexed(indexed), major_version(major_version), start_height(start_height), block_stop(block_stop),
+    done(false), stopping(false), result(0)
+  {
+    reader = boost::thread(&import_pipeline::read_loop, this);
+  }
+
+  ~import_pipeline()
+  {
+    stop();
+  }
+
+  // gets the next batch, false once there are no more
+  bool next(import_batch &batch)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (ready.empty() && !done)
+      cv.wait(lock);
+    if (ready.empty())
+      return false;
+    batch = std::move(ready.front());
+    ready.pop_front();
+    cv.notify_all();
+    return true;
+  }
+
+  // 1 if the whole file (or up to block_stop) was read, 2 on read errors
+  int status()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return result;
+  }
+
+  void stop()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      stopping = true;
+      cv.notify_all();
+    }
+    if (reader.joinable())
+      reader.join();
   }
-  core.prevalidate_block_hashes(core.get_blockchain_storage().get_db().height(), hashes);
 
-  core.prepare_handle_incoming_blocks(blocks);
+private:
+  // batches decoded ahead of the one being verified
+  static constexpr size_t MAX_READY = 2;
 
-  for(const block_complete_entry& block_entry: blocks)
+  void read_loop()
   {
+    int ret = 0;
+    try
+    {
+      uint64_t h = start_height;
+      while (ret == 0)
+      {
+        import_batch batch;
+        batch.start_height = h;
+        batch.bytes = 0;
+        std::vector<std::string> chunks;
+        while (h <= block_stop)
+        {
+          if (indexed)
+          {
+            if (h >= indexed->block_first() + indexed->block_count())
+            {
+              std::cout << refresh_string;
+              MINFO("End of file reached");
+              ret = 1;
+              break;
+            }
+            // fetched by decode
+            chunks.emplace_back();
+          }
+          else
+          {
+            std::string chunk;
+            ret = read_chunk(import_file, chunk, batch.bytes);
+            if (ret)
+              break;
+            chunks.push_back(std::move(chunk));
+          }
+          ++h;
+          if (chunks.size() >= db_batch_size && h % HASH_OF_HASHES_STEP == 0)
+            break;
+        }
+        if (ret == 0 && h > block_stop)
+        {
+          std::cout << refresh_string;
+          MINFO("Specified block number reached - stopping.  block: " << h-1 << "  total blocks: " << h);
+          ret = 1;
+        }
+        // a partial batch is only added at the end of the file, never after an error
+        if (chunks.empty() || ret == 2)
+          break;
+        if (indexed)
+          batch.bytes = indexed->bytes(batch.start_height, chunks.size());
+        if (!decode(chunks, batch))
+        {
+          ret = 2;
+          break;
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (ready.size() >= MAX_READY && !stopping)
+          cv.wait(lock);
+        if (stopping)
+          break;
+        ready.push_back(std::move(batch));
+        cv.notify_all();
+      }
+    }
+    catch (const std::exception &e)
+    {
+      std::cout << refresh_string;
+      MFATAL("exception while reading from file: " << e.what());
+      ret = 2;
+    }
+    boost::unique_lock<boost::mutex> lock(mutex);
+    result = ret;
+    done = true;
+    cv.notify_all();
+  }
+
+  bool decode(const std::vector<std::string> &chunks, import_batch &batch)
+  {
+    batch.blocks.resize(chunks.size());
+    batch.hashes.resize(chunks.size());
+    std::unique_ptr<bool[]> ok(new bool[chunks.size()]());
+    tools::threadpool::getInstance().parallel_for(chunks.size(), [&](size_t n) {
+      bootstrap::block_package bp;
+      try
+      {
+        std::string fetched;
+        const std::string *chunk = &chunks[n];
+        if (indexed)
+        {
+          if (!indexed->get_chunk(batch.start_height + n, fetched))
+            return;
+          chunk = &fetched;
+        }
+        if (!parse_chunk(*chunk, major_version, bp))
+          return;
+      }
+      catch (const std::exception &e)
+      {
+        return;
+      }
+      block_complete_entry &entry = batch.blocks[n];
+      entry.block = cryptonote::block_to_blob(bp.block);
+      entry.txs.reserve(bp.txs.size());
+      for (const auto &tx: bp.txs)
+        entry.txs.push_back(cryptonote::tx_to_blob(tx));
+      batch.hashes[n] = cryptonote::get_block_hash(bp.block);
+      ok[n] = true;
+    }, true);
+    for (size_t n = 0; n < chunks.size(); ++n)
+    {
+      if (!ok[n])
+      {
+        std::cout << refresh_string;
+        MFATAL("Error in deserialization of chunk at height " << batch.start_height + n);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::ifstream &import_file;
+  const BootstrapChunkReader *indexed;
+  const uint8_t major_version;
+  const uint64_t start_height;
+  const uint64_t block_stop;
+
+  boost::mutex mutex;
+  boost::condition_variable cv;
+  std::deque<import_batch> ready;
+  bool done;
+  bool stopping;
+  int result;
+  boost::thread reader;
+};
+
+int add_blocks(cryptonote::core &core, const import_batch &batch, uint64_t block_stop)
+{
+  const uint64_t height = core.get_blockchain_storage().get_db().height();
+  if (batch.start_height != height)
+  {
+    MERROR("Batch starts at height " << batch.start_height << " but the blockchain is at height " << height);
+    return 1;
+  }
+  core.prevalidate_block_hashes(height, batch.hashes);
+
+  core.prepare_handle_incoming_blocks(batch.blocks);
+
+  for(size_t n = 0; n < batch.blocks.size(); ++n)
+  {
+    const block_complete_entry& block_entry = batch.blocks[n];
     // process transactions
     for(auto& tx_blob: block_entry.txs)
     {
@@ -232,11 +507,16 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
       return 1;
     }
 
+    if ((height + n) % 10 == 0)
+    {
+      std::cout << refresh_string << "block " << height + n
+        << " / " << block_stop
+        << "\r" << std::flush;
+    }
   } // each download block
   if (!core.cleanup_handle_incoming_blocks())
     return 1;
 
-  blocks.clear();
   return 0;
 }
 
@@ -261,9 +541,22 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 
   seek_height = start_height;
   BootstrapFile bootstrap;
+  BootstrapChunkReader indexed;
   std::streampos pos;
-  // BootstrapFile bootstrap(import_file_path);
-  uint64_t total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
+  uint64_t total_source_blocks;
+  // v2 files have an index, there is no need to scan them for the start height
+  const bool use_index = indexed.open(import_file_path);
+  if (use_index)
+  {
+    total_source_blocks = indexed.block_first() + indexed.block_count();
+    if (start_height < indexed.block_first())
+    {
+      MFATAL("bootstrap file starts at block " << indexed.block_first() << ", the blockchain is at height " << start_height);
+      return false;
+    }
+  }
+  else
+    total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
   MINFO("bootstrap file last block number: " << total_source_blocks-1 << " (zero-based height)  total blocks: " << total_source_blocks);
 
   if (total_source_blocks-1 <= start_height)
@@ -291,12 +584,10 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   bootstrap.seek_to_first_chunk(import_file, major_version, minor_version);
 
   std::string str1;
-  char buffer1[1024];
-  char buffer_block[BUFFER_SIZE];
   block b;
   transaction tx;
   int quit = 0;
-  uint64_t bytes_read;
+  uint64_t bytes_read = 0;
 
   // Note that a new blockchain will start with block number 0 (total blocks: 1)
   // due to genesis block being added at initialization.
@@ -316,9 +607,8 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   MINFO("Reading blockchain from bootstrap file...");
   std::cout << ENDL;
 
-  std::vector<block_complete_entry> blocks;
-
   // Skip to start_height before we start adding.
+  if (!use_index)
   {
     bool q2 = false;
     import_file.seekg(pos);
@@ -328,71 +618,64 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
       quit = 2;
       goto quitting;
     }
-    h = start_height;
   }
+  h = start_height;
 
   if (use_batch)
   {
     uint64_t bytes, h2;
     bool q2;
-    pos = import_file.tellg();
-    bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-    if (import_file.eof())
-      import_file.clear();
-    import_file.seekg(pos);
+    if (use_index)
+      bytes = indexed.bytes(h, db_batch_size);
+    else
+    {
+      pos = import_file.tellg();
+      bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+      if (import_file.eof())
+        import_file.clear();
+      import_file.seekg(pos);
+    }
     core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
   }
-  while (! quit)
+
+  if (opt_verify)
   {
-    uint32_t chunk_size;
-    import_file.read(buffer1, sizeof(chunk_size));
-    // TODO: bootstrap.read_chunk();
-    if (! import_file) {
+    // the next batches are read and decoded while one is being verified
+    import_pipeline pipeline(import_file, use_index ? &indexed : nullptr, major_version, h, block_stop);
+    import_batch batch;
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+    while (pipeline.next(batch))
+    {
+      if (add_blocks(core, batch, block_stop))
+        return 1;
+      num_imported += batch.blocks.size();
+      h = batch.start_height + batch.blocks.size();
+      bytes += batch.bytes;
+      const double seconds = std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
       std::cout << refresh_string;
-      MINFO("End of file reached");
-      quit = 1;
-      break;
+      MINFO("Imported up to block " << h-1 << " / " << block_stop << ": " << (uint64_t)(num_imported / seconds) << " blocks/s, "
+          << bytes / seconds / 1e6 << " MB/s");
     }
-    bytes_read += sizeof(chunk_size);
-
-    str1.assign(buffer1, sizeof(chunk_size));
-    if (! ::serialization::parse_binary(str1, chunk_size))
+    pipeline.stop();
+    if (!quit)
     {
-      throw std::runtime_error("Error in deserialization of chunk size");
+      quit = pipeline.status();
+      if (quit == 2)
+        return 2;
     }
-    MDEBUG("chunk_size: " << chunk_size);
+  }
 
-    if (chunk_size > BUFFER_SIZE)
-    {
-      MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
-      throw std::runtime_error("Aborting: chunk size exceeds buffer size");
-    }
-    if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
+  while (! quit)
+  {
+    int ret = use_index ? read_chunk(indexed, h, str1, bytes_read) : read_chunk(import_file, str1, bytes_read);
+    if (ret == 1)
     {
-      MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
-    }
-    else if (chunk_size == 0) {
-      MFATAL("ERROR: chunk_size == 0");
-      return 2;
-    }
-    import_file.read(buffer_block, chunk_size);
-    if (! import_file) {
-      if (import_file.eof())
-      {
-        std::cout << refresh_string;
-        MINFO("End of file reached - file was truncated");
-        quit = 1;
-        break;
-      }
-      else
-      {
-        MFATAL("ERROR: unexpected end of file: bytes read before error: "
-            << import_file.gcount() << " of chunk_size " << chunk_size);
-        return 2;
-      }
+      quit = 1;
+      break;
     }
-    bytes_read += chunk_size;
-    MDEBUG("Total bytes read: " << bytes_read);
+    if (ret)
+      return ret;
 
     if (h > block_stop)
     {
@@ -407,25 +690,8 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 
     try
     {
-      str1.assign(buffer_block, chunk_size);
       bootstrap::block_package bp;
-     bool res;
-      if (major_version == 0)
-      {
-        bootstrap::block_package_1 bp1;
-        res = ::serialization::parse_binary(str1, bp1);
-        if (res)
-        {
-          bp.block = std::move(bp1.block);
-          bp.txs = std::move(bp1.txs);
-          bp.block_weight = bp1.block_weight;
-          bp.cumulative_difficulty = bp1.cumulative_difficulty;
-          bp.coins_generated = bp1.coins_generated;
-        }
-      }
-      else
-        res = ::serialization::parse_binary(str1, bp);
-      if (!res)
+      if (!parse_chunk(str1, major_version, bp))
         throw std::runtime_error("Error in deserialization of chunk");
 
       int display_interval = 1000;
@@ -453,25 +719,6 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
             << "\r" << std::flush;
         }
 
-        if (opt_verify)
-        {
-          cryptonote::blobdata block;
-          cryptonote::block_to_blob(bp.block, block);
-          std::vector<cryptonote::blobdata> txs;
-          for (const auto &tx: bp.txs)
-          {
-            txs.push_back(cryptonote::blobdata());
-            cryptonote::tx_to_blob(tx, txs.back());
-          }
-          blocks.push_back({block, txs});
-          int ret = check_flush(core, blocks, false);
-          if (ret)
-          {
-            quit = 2; // make sure we don't commit partial block data
-            break;
-          }
-        }
-        else
         {
           std::vector<transaction> txs;
           std::vector<transaction> archived_txs;
@@ -524,9 +771,14 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
               // zero-based height
               std::cout << ENDL << "[- batch commit at height " << h-1 << " -]" << ENDL;
               core.get_blockchain_storage().get_db().batch_stop();
-              pos = import_file.tellg();
-              bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-              import_file.seekg(pos);
+              if (use_index)
+                bytes = indexed.bytes(h, db_batch_size);
+              else
+              {
+                pos = import_file.tellg();
+                bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+                import_file.seekg(pos);
+              }
               core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
               std::cout << ENDL;
               core.get_blockchain_storage().get_db().show_stats();
@@ -547,13 +799,6 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 quitting:
   import_file.close();
 
-  if (opt_verify)
-  {
-    int ret = check_flush(core, blocks, true);
-    if (ret)
-      return ret;
-  }
-
   if (use_batch)
   {
     if (quit > 1)
@@ -721,6 +966,12 @@ int main(int argc, char* argv[])
 
   if (command_line::has_arg(vm, arg_count_blocks))
   {
+    BootstrapChunkReader indexed;
+    if (indexed.open(import_file_path))
+    {
+      std::cout << "Number of blocks: " << indexed.block_first() + indexed.block_count() << ENDL;
+      return 0;
+    }
     BootstrapFile bootstrap;
     bootstrap.count_blocks(import_file_path);
     return 0;
@@ -636,6 +636,9 @@ int main(int argc, char* argv[])
   copy_table(env0, env1, "txpool_meta", 0, MDB_NODUPDATA, BlockchainLMDB::compare_hash32);
   copy_table(env0, env1, "txpool_blob", 0, MDB_NODUPDATA, BlockchainLMDB::compare_hash32);
   copy_table(env0, env1, "hf_versions", MDB_INTEGERKEY, MDB_APPEND);
+  copy_table(env0, env1, "articles", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_hash32);
+  copy_table(env0, env1, "article_publishers", MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_uint64_hash32);
+  copy_table(env0, env1, "article_contents", MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_uint64_hash32);
   copy_table(env0, env1, "properties", 0, 0, BlockchainLMDB::compare_string);
   if (already_pruned)
   {
@@ -123,6 +123,7 @@ int main(int argc, char* argv[])
   const command_line::arg_descriptor<bool> arg_verbose  = {"verbose", "Verbose output", false};
   const command_line::arg_descriptor<bool> arg_dry_run  = {"dry-run", "Do not actually prune", false};
   const command_line::arg_descriptor<std::string> arg_input = {"input", "Path to the known spent outputs file"};
+  const command_line::arg_descriptor<uint64_t> arg_batch_size  = {"batch-size", "Commit after pruning this many outputs, bounding memory use and the work lost if interrupted", 100000};
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
@@ -132,6 +133,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_verbose);
   command_line::add_arg(desc_cmd_sett, arg_dry_run);
   command_line::add_arg(desc_cmd_sett, arg_input);
+  command_line::add_arg(desc_cmd_sett, arg_batch_size);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
   po::options_description desc_options("Allowed options");
@@ -169,6 +171,12 @@ int main(int argc, char* argv[])
   network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
   bool opt_verbose = command_line::get_arg(vm, arg_verbose);
   bool opt_dry_run = command_line::get_arg(vm, arg_dry_run);
+  uint64_t opt_batch_size = command_line::get_arg(vm, arg_batch_size);
+  if (opt_batch_size == 0)
+  {
+    std::cerr << "--batch-size must be at least 1" << std::endl;
+    return 1;
+  }
 
   std::string db_type = command_line::get_arg(vm, arg_database);
   if (!cryptonote::blockchain_valid_db_type(db_type))
@@ -207,6 +215,11 @@ int main(int argc, char* argv[])
   CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
   LOG_PRINT_L0("Source blockchain storage initialized OK");
 
+  std::atomic<bool> stop_requested(false);
+  tools::signal_handler::install([&stop_requested](int type) {
+    stop_requested = true;
+  });
+
   std::map<uint64_t, uint64_t> known_spent_outputs;
   if (input.empty())
   {
@@ -238,8 +251,14 @@ int main(int argc, char* argv[])
 
         outputs[amount].first++;
       }
-      return true;
+      return !stop_requested;
     }, true);
+    if (stop_requested)
+    {
+      MINFO("Interrupted while scanning, nothing was pruned");
+      core_storage->deinit();
+      return 1;
+    }
 
     for (const auto &i: outputs)
     {
@@ -254,16 +273,20 @@ int main(int argc, char* argv[])
 
   LOG_PRINT_L0("Pruning known spent data...");
 
-  bool stop_requested = false;
-  tools::signal_handler::install([&stop_requested](int type) {
-    stop_requested = true;
-  });
-
+  // Pruning is committed every --batch-size outputs, so the write txn stays
+  // bounded. Pruned amounts have no outputs left and are skipped, so an
+  // interrupted run picks up where it stopped when started again.
   db->batch_start();
+  uint64_t num_pruned_in_batch = 0;
 
   size_t num_total_outputs = 0, num_prunable_outputs = 0, num_known_spent_outputs = 0, num_eligible_outputs = 0, num_eligible_known_spent_outputs = 0;
   for (auto i = known_spent_outputs.begin(); i != known_spent_outputs.end(); ++i)
   {
+    if (stop_requested)
+    {
+      MINFO("Interrupted, run again to prune the remaining amounts");
+      break;
+    }
     uint64_t num_outputs = db->get_num_outputs(i->first);
     num_total_outputs += num_outputs;
     num_known_spent_outputs += i->second;
@@ -277,6 +300,8 @@ int main(int argc, char* argv[])
     num_eligible_known_spent_outputs += i->second;
     if (opt_verbose)
       MINFO(i->first << ": " << i->second << "/" << num_outputs);
+    if (num_outputs == 0)
+      continue;
     if (num_outputs > i->second)
       continue;
     if (num_outputs && num_outputs < i->second)
@@ -287,7 +312,16 @@ int main(int argc, char* argv[])
     if (opt_verbose)
       MINFO("Pruning data for " << num_outputs << " outputs");
     if (!opt_dry_run)
+    {
       db->prune_outputs(i->first);
+      num_pruned_in_batch += num_outputs;
+      if (num_pruned_in_batch >= opt_batch_size)
+      {
+        db->batch_stop();
+        db->batch_start();
+        num_pruned_in_batch = 0;
+      }
+    }
     num_prunable_outputs += i->second;
   }
 
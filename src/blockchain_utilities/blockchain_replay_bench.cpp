@@ -0,0 +1,455 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include "misc_log_ex.h"
+#include "bootstrap_file.h"
+#include "bootstrap_serialization.h"
+#include "blocks/blocks.h"
+#include "common/command_line.h"
+#include "common/perf_timer.h"
+#include "common/threadpool.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "serialization/binary_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "version.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "bcutil"
+
+namespace po = boost::program_options;
+using namespace epee;
+using namespace cryptonote;
+
+// Replays an indexed bootstrap file into an empty database through the same
+// path synced blocks take, and reports how fast blocks were verified and
+// added, with the time spent in each stage taken from the PERF_TIMER totals.
+
+namespace
+{
+
+// reported stage, PERF_TIMER name
+const std::pair<const char*, const char*> stages[] = {
+  {"block", "handle_block_to_main_chain"},
+  {"pow", "block_pow"},
+  {"tx_checks", "block_tx_checks"},
+  {"db_add", "block_db_add"},
+  {"hooks", "block_added_hooks"},
+  {"tx_pool", "add_tx"},
+  {"commit", "lmdb_txn_commit"},
+};
+
+struct replay_batch
+{
+  uint64_t start_height;
+  uint64_t txs;
+  std::vector<block_complete_entry> blocks;
+  std::vector<crypto::hash> hashes;
+};
+
+// decodes [start_height, start_height + count) on the threadpool, before the
+// clock starts for them
+bool read_batch(const BootstrapChunkReader &indexed, uint64_t start_height, uint64_t count, replay_batch &batch)
+{
+  batch.start_height = start_height;
+  batch.txs = 0;
+  batch.blocks.clear();
+  batch.blocks.resize(count);
+  batch.hashes.resize(count);
+  std::unique_ptr<bool[]> ok(new bool[count]());
+  tools::threadpool::getInstance().parallel_for(count, [&](size_t n) {
+    bootstrap::block_package bp;
+    try
+    {
+      std::string chunk;
+      if (!indexed.get_chunk(start_height + n, chunk) || !::serialization::parse_binary(chunk, bp))
+        return;
+    }
+    catch (const std::exception &e)
+    {
+      return;
+    }
+    block_complete_entry &entry = batch.blocks[n];
+    entry.block = cryptonote::block_to_blob(bp.block);
+    entry.txs.reserve(bp.txs.size());
+    for (const auto &tx: bp.txs)
+      entry.txs.push_back(cryptonote::tx_to_blob(tx));
+    batch.hashes[n] = cryptonote::get_block_hash(bp.block);
+    ok[n] = true;
+  }, true);
+  for (size_t n = 0; n < count; ++n)
+  {
+    if (!ok[n])
+    {
+      MERROR("Error in deserialization of chunk at height " << start_height + n);
+      return false;
+    }
+    batch.txs += batch.blocks[n].txs.size();
+  }
+  return true;
+}
+
+// same as blockchain_import's add_blocks
+bool add_batch(cryptonote::core &core, const replay_batch &batch)
+{
+  const uint64_t height = core.get_blockchain_storage().get_db().height();
+  if (batch.start_height != height)
+  {
+    MERROR("Batch starts at height " << batch.start_height << " but the blockchain is at height " << height);
+    return false;
+  }
+  core.prevalidate_block_hashes(height, batch.hashes);
+
+  core.prepare_handle_incoming_blocks(batch.blocks);
+
+  for (size_t n = 0; n < batch.blocks.size(); ++n)
+  {
+    const block_complete_entry &block_entry = batch.blocks[n];
+    for (const auto &tx_blob: block_entry.txs)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      core.handle_incoming_tx(tx_blob, tvc, true, true, false);
+      if (tvc.m_verifivation_failed)
+      {
+        MERROR("transaction verification failed, tx_id = " << epee::string_tools::pod_to_hex(get_blob_hash(tx_blob)));
+        core.cleanup_handle_incoming_blocks();
+        return false;
+      }
+    }
+
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    core.handle_incoming_block(block_entry.block, bvc, false);
+    if (bvc.m_verifivation_failed || bvc.m_marked_as_orphaned)
+    {
+      MERROR("Block verification failed at height " << height + n << ", id = " << batch.hashes[n]);
+      core.cleanup_handle_incoming_blocks();
+      return false;
+    }
+  }
+  return core.cleanup_handle_incoming_blocks();
+}
+
+std::map<std::string, tools::perf_metric_total> get_timer_totals()
+{
+  std::map<std::string, tools::perf_metric_total> totals;
+  for (const auto &t: tools::get_perf_metric_totals())
+    totals[t.name] = t;
+  return totals;
+}
+
+std::string json_string(const std::string &s)
+{
+  std::string out = "\"";
+  for (char c: s)
+  {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    if ((unsigned char)c < 0x20)
+      continue;
+    out += c;
+  }
+  return out + "\"";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  uint32_t log_level = 0;
+
+  tools::on_startup();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+  const command_line::arg_descriptor<std::string> arg_input_file = {"input-file", "Indexed bootstrap file to replay", "", true};
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<std::string> arg_output_file  = {"output-file", "Write the JSON results to this file instead of stdout", ""};
+  const command_line::arg_descriptor<uint64_t> arg_block_stop  = {"block-stop", "Stop at block number", 0};
+  const command_line::arg_descriptor<uint64_t> arg_warmup_blocks  = {"warmup-blocks", "Replay this many blocks before measuring", 0};
+  const command_line::arg_descriptor<uint64_t> arg_batch_size  = {"batch-size", "Number of blocks added per span, as when syncing", 100};
+  const command_line::arg_descriptor<unsigned> arg_max_concurrency = {"max-concurrency", "Max number of threads to use for a parallel job", 0};
+  const command_line::arg_descriptor<bool> arg_use_block_hashes = {"use-block-hashes", "Skip verifying blocks covered by the compiled in block hashes, as the daemon does", false};
+  const command_line::arg_descriptor<bool> arg_keep_db = {"keep-db", "Do not delete the temporary database when done", false};
+
+  command_line::add_arg(desc_cmd_sett, arg_input_file);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_output_file);
+  command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_warmup_blocks);
+  command_line::add_arg(desc_cmd_sett, arg_batch_size);
+  command_line::add_arg(desc_cmd_sett, arg_max_concurrency);
+  command_line::add_arg(desc_cmd_sett, arg_use_block_hashes);
+  command_line::add_arg(desc_cmd_sett, arg_keep_db);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+  cryptonote::core::init_options(desc_options);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Antd '" << ANTD_RELEASE_NAME << "' (v" << ANTD_VERSION_FULL << ")" << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure(mlog_get_default_log_path("antd-blockchain-replay-bench.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
+
+  const std::string input_file = command_line::get_arg(vm, arg_input_file);
+  const uint64_t warmup_blocks = command_line::get_arg(vm, arg_warmup_blocks);
+  const uint64_t batch_size = command_line::get_arg(vm, arg_batch_size);
+  const bool use_block_hashes = command_line::get_arg(vm, arg_use_block_hashes);
+  if (!batch_size)
+  {
+    std::cerr << "Error: batch-size must be > 0" << ENDL;
+    return 1;
+  }
+
+  // must be set before the threadpool is first used
+  tools::set_max_concurrency(command_line::get_arg(vm, arg_max_concurrency));
+
+  BootstrapChunkReader indexed;
+  if (!indexed.open(input_file))
+  {
+    std::cerr << "Error: " << input_file << " is not an indexed bootstrap file, export it again with antd-blockchain-export" << ENDL;
+    return 1;
+  }
+  if (indexed.block_first() > 1)
+  {
+    std::cerr << "Error: the bootstrap file starts at block " << indexed.block_first() << ", it must start after the genesis block" << ENDL;
+    return 1;
+  }
+  uint64_t block_stop = indexed.block_first() + indexed.block_count() - 1;
+  if (!command_line::is_arg_defaulted(vm, arg_block_stop))
+    block_stop = std::min(block_stop, command_line::get_arg(vm, arg_block_stop));
+  if (block_stop <= warmup_blocks)
+  {
+    std::cerr << "Error: nothing left to measure after " << warmup_blocks << " warmup blocks" << ENDL;
+    return 1;
+  }
+
+  // replay into a fresh database unless one was given
+  boost::filesystem::path data_dir;
+  const bool temporary_db = command_line::is_arg_defaulted(vm, cryptonote::arg_data_dir);
+  if (temporary_db)
+  {
+    data_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("antd-replay-bench-%%%%-%%%%-%%%%");
+    vm.at(cryptonote::arg_data_dir.name).value() = data_dir.string();
+  }
+  else
+    data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+
+  MINFO("Replaying " << input_file << " up to block " << block_stop << " into " << data_dir.string());
+
+  std::ostringstream json;
+  int ret = 1;
+  {
+  cryptonote::cryptonote_protocol_stub pr;
+  cryptonote::core core(&pr);
+
+  try
+  {
+    core.disable_dns_checkpoints(true);
+#if defined(PER_BLOCK_CHECKPOINT)
+    const GetCheckpointsCallback& get_checkpoints = use_block_hashes ? blocks::GetCheckpointsData : nullptr;
+#else
+    const GetCheckpointsCallback& get_checkpoints = nullptr;
+#endif
+    if (!core.init(vm, nullptr, get_checkpoints))
+    {
+      std::cerr << "Failed to initialize core" << ENDL;
+      return 1;
+    }
+    core.get_blockchain_storage().get_db().set_batch_transactions(true);
+    if (core.get_blockchain_storage().get_current_blockchain_height() != 1)
+    {
+      std::cerr << "Error: the database at " << data_dir.string() << " is not empty" << ENDL;
+      core.deinit();
+      return 1;
+    }
+
+    std::map<std::string, tools::perf_metric_total> start_totals;
+    std::chrono::steady_clock::time_point start;
+    double seconds = 0;
+    uint64_t blocks = 0, txs = 0;
+    uint64_t h = 1;
+    bool measuring = false;
+    replay_batch batch;
+    ret = 0;
+    while (h <= block_stop)
+    {
+      if (!measuring && h > warmup_blocks)
+      {
+        measuring = true;
+        start_totals = get_timer_totals();
+      }
+      // spans end where a hash of hashes check covers them, like the import,
+      // and at the end of the warmup
+      uint64_t count = std::min(batch_size, block_stop + 1 - h);
+      if (use_block_hashes && h + count < block_stop + 1)
+        count = std::min(block_stop + 1, (h + count + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP * HASH_OF_HASHES_STEP) - h;
+      if (!measuring)
+        count = std::min(count, warmup_blocks + 1 - h);
+      if (!read_batch(indexed, h, count, batch))
+      {
+        ret = 1;
+        break;
+      }
+      const auto batch_start = std::chrono::steady_clock::now();
+      if (!add_batch(core, batch))
+      {
+        ret = 1;
+        break;
+      }
+      if (measuring)
+      {
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - batch_start).count();
+        blocks += count;
+        txs += batch.txs;
+      }
+      h += count;
+      std::cout << "\r                                    \rblock " << h - 1 << " / " << block_stop << std::flush;
+    }
+    std::cout << ENDL;
+
+    if (ret == 0)
+    {
+      std::map<std::string, tools::perf_metric_total> end_totals = get_timer_totals();
+      auto delta = [&](const std::string &name) {
+        tools::perf_metric_total d{name, 0, 0};
+        const auto e = end_totals.find(name);
+        if (e == end_totals.end())
+          return d;
+        d = e->second;
+        const auto s = start_totals.find(name);
+        if (s != start_totals.end())
+        {
+          d.count -= s->second.count;
+          d.total_ns -= s->second.total_ns;
+        }
+        return d;
+      };
+      seconds = std::max(seconds, 1e-9);
+
+      json << "{\n";
+      json << "  \"version\": " << json_string(ANTD_VERSION_FULL) << ",\n";
+      json << "  \"input_file\": " << json_string(input_file) << ",\n";
+      json << "  \"first_height\": " << warmup_blocks + 1 << ",\n";
+      json << "  \"last_height\": " << block_stop << ",\n";
+      json << "  \"max_concurrency\": " << tools::get_max_concurrency() << ",\n";
+      json << "  \"db_sync_mode\": " << json_string(command_line::get_arg(vm, cryptonote::arg_db_sync_mode)) << ",\n";
+      json << "  \"use_block_hashes\": " << (use_block_hashes ? "true" : "false") << ",\n";
+      json << "  \"blocks\": " << blocks << ",\n";
+      json << "  \"txs\": " << txs << ",\n";
+      json << "  \"seconds\": " << seconds << ",\n";
+      json << "  \"blocks_per_second\": " << blocks / seconds << ",\n";
+      json << "  \"txs_per_second\": " << txs / seconds << ",\n";
+      json << "  \"stages\": {";
+      const char *sep = "\n";
+      for (const auto &stage: stages)
+      {
+        const tools::perf_metric_total d = delta(stage.second);
+        json << sep << "    " << json_string(stage.first) << ": {\"timer\": " << json_string(stage.second)
+          << ", \"count\": " << d.count << ", \"seconds\": " << d.total_ns / 1e9
+          << ", \"share\": " << d.total_ns / 1e9 / seconds << "}";
+        sep = ",\n";
+      }
+      json << "\n  },\n";
+      json << "  \"timers\": {";
+      sep = "\n";
+      for (const auto &e: end_totals)
+      {
+        const tools::perf_metric_total d = delta(e.first);
+        if (d.count == 0)
+          continue;
+        json << sep << "    " << json_string(d.name) << ": {\"count\": " << d.count << ", \"seconds\": " << d.total_ns / 1e9 << "}";
+        sep = ",\n";
+      }
+      json << "\n  }\n";
+      json << "}\n";
+
+      MINFO("Replayed " << blocks << " blocks and " << txs << " txs in " << seconds << " s: "
+          << blocks / seconds << " blocks/s, " << txs / seconds << " txs/s");
+    }
+
+    core.deinit();
+  }
+  catch (const DB_ERROR& e)
+  {
+    std::cout << std::string("Error loading blockchain db: ") + e.what() + " -- shutting down now" << ENDL;
+    core.deinit();
+    ret = 1;
+  }
+  }
+
+  if (temporary_db && !command_line::get_arg(vm, arg_keep_db))
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(data_dir, ec);
+    if (ec)
+      MWARNING("Failed to remove " << data_dir.string() << ": " << ec.message());
+  }
+
+  if (ret)
+    return ret;
+
+  const std::string output_file = command_line::get_arg(vm, arg_output_file);
+  if (output_file.empty())
+    std::cout << json.str();
+  else if (!epee::file_io_utils::save_string_to_file(output_file, json.str()))
+  {
+    std::cerr << "Failed to write " << output_file << ENDL;
+    return 1;
+  }
+  return 0;
+
+  CATCH_ENTRY("Replay bench error", 1);
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "common/threadpool.h"
+#include "misc_log_ex.h"
+
+// Scans [start, stop) on the threadpool, range_size items at a time. Each
+// range is scanned into its own partial result by scan(begin, end, partial),
+// and the partials are handed to merge(partial) in order on the calling
+// thread. Ranges are scanned a window at a time and a window is merged before
+// the next one is scanned, so scan may read anything merge writes. Reading
+// from the db is fine from any thread, each one gets its own read txn.
+// scan returns false on errors, merge returns false to stop early; the
+// result is false only if a scan failed.
+template<typename T, typename Scan, typename Merge>
+bool parallel_scan(uint64_t start, uint64_t stop, uint64_t range_size, const Scan &scan, const Merge &merge)
+{
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  const uint64_t window_ranges = 4 * (uint64_t)tpool.get_max_concurrency();
+  range_size = std::max<uint64_t>(range_size, 1);
+  std::vector<T> partials;
+  for (uint64_t window = start; window < stop; )
+  {
+    const uint64_t ranges = std::min<uint64_t>(window_ranges, (stop - window + range_size - 1) / range_size);
+    partials.clear();
+    partials.resize(ranges);
+    std::unique_ptr<bool[]> ok(new bool[ranges]());
+    tpool.parallel_for(ranges, [&](size_t n) {
+      const uint64_t begin = window + n * range_size;
+      const uint64_t end = std::min(stop, begin + range_size);
+      try
+      {
+        ok[n] = scan(begin, end, partials[n]);
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Error scanning [" << begin << ", " << end << "): " << e.what());
+      }
+    }, true);
+    for (size_t n = 0; n < ranges; ++n)
+    {
+      if (!ok[n])
+        return false;
+      if (!merge(partials[n]))
+        return true;
+      partials[n] = T();
+    }
+    window = std::min(stop, window + ranges * range_size);
+  }
+  return true;
+}
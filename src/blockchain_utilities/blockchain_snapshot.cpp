@@ -0,0 +1,802 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <lmdb.h>
+#include <boost/algorithm/string.hpp>
+#include "common/command_line.h"
+#include "common/util.h"
+#include "checkpoints/checkpoints.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/blockchain.h"
+#include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "blockchain_db/db_types.h"
+#include "blockchain_objects.h"
+#include "int-util.h"
+#include "version.h"
+
+extern "C"
+{
+#include "crypto/keccak.h"
+}
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "bcutil"
+
+namespace po = boost::program_options;
+using namespace epee;
+using namespace cryptonote;
+
+// A snapshot is the database state at a given height, table by table:
+//
+//   magic, version, height, top block hash
+//   for each table: name, then (key, value) records, then end_of_table
+//   an empty name
+//   keccak of everything above
+//
+// All integers are little endian, sizes are 32 bit.
+
+static const char snapshot_magic[8] = {'A', 'N', 'T', 'D', 'S', 'N', 'A', 'P'};
+static const uint32_t snapshot_version = 1;
+static const uint32_t end_of_table = 0xffffffff;
+
+static std::string db_path;
+
+// default to fast:1
+static uint64_t records_per_sync = 128;
+static const size_t slack = 512 * 1024 * 1024;
+
+namespace
+{
+  struct snapshot_table
+  {
+    const char *name;
+    unsigned int flags;
+    unsigned int putflags;
+    int (*cmp)(const MDB_val*, const MDB_val*);
+    bool optional; // may be missing from a database only ever opened read-only
+  };
+
+  // same tables and flags as BlockchainLMDB::open; txs is unused, the txpool
+  // is local to a node and hf_starting_heights is dropped on open
+  const snapshot_table snapshot_tables[] = {
+    {"blocks", MDB_INTEGERKEY, MDB_APPEND, NULL, false},
+    {"block_info", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, MDB_APPENDDUP, BlockchainLMDB::compare_uint64, false},
+    {"block_heights", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_hash32, false},
+    {"txs_pruned", MDB_INTEGERKEY, MDB_APPEND, NULL, false},
+    {"txs_prunable", MDB_INTEGERKEY, MDB_APPEND, BlockchainLMDB::compare_uint64, false},
+    {"txs_prunable_hash", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, MDB_APPEND, BlockchainLMDB::compare_uint64, false},
+    {"txs_prunable_tip", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, MDB_NODUPDATA, BlockchainLMDB::compare_uint64, true},
+    {"tx_indices", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_hash32, false},
+    {"tx_outputs", MDB_INTEGERKEY, MDB_APPEND, NULL, false},
+    {"output_txs", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, MDB_APPENDDUP, BlockchainLMDB::compare_uint64, false},
+    {"output_amounts", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, MDB_APPENDDUP, BlockchainLMDB::compare_uint64, false},
+    {"output_blacklist", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_INTEGERDUP, MDB_APPENDDUP, BlockchainLMDB::compare_uint64, false},
+    {"spent_keys", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, MDB_NODUPDATA, BlockchainLMDB::compare_hash32, false},
+    {"hf_versions", MDB_INTEGERKEY, MDB_APPEND, NULL, false},
+    {"full_node_data", MDB_INTEGERKEY, MDB_APPEND, NULL, false},
+    {"full_node_quorums", MDB_INTEGERKEY, MDB_APPEND, NULL, true},
+    {"articles", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_hash32, true},
+    {"article_publishers", MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_uint64_hash32, true},
+    {"article_contents", MDB_DUPSORT | MDB_DUPFIXED, 0, BlockchainLMDB::compare_uint64_hash32, true},
+    {"properties", 0, 0, BlockchainLMDB::compare_string, false},
+  };
+
+  const snapshot_table *find_snapshot_table(const std::string &name)
+  {
+    for (const snapshot_table &table: snapshot_tables)
+      if (name == table.name)
+        return &table;
+    return NULL;
+  }
+
+  void set_compare(MDB_txn *txn, MDB_dbi dbi, const snapshot_table &table)
+  {
+    if (table.cmp)
+      ((table.flags & MDB_DUPSORT) ? mdb_set_dupsort : mdb_set_compare)(txn, dbi, table.cmp);
+  }
+
+  class snapshot_writer
+  {
+  public:
+    snapshot_writer(std::ostream &stream): m_stream(stream) { keccak_init(&m_ctx); }
+
+    void write(const void *data, size_t size)
+    {
+      keccak_update(&m_ctx, (const uint8_t*)data, size);
+      m_stream.write((const char*)data, size);
+      if (!m_stream)
+        throw std::runtime_error("Failed to write snapshot");
+    }
+    void write_u32(uint32_t v) { v = SWAP32LE(v); write(&v, sizeof(v)); }
+    void write_u64(uint64_t v) { v = SWAP64LE(v); write(&v, sizeof(v)); }
+    void write_string(const char *s) { const size_t len = strlen(s); write_u32(len); write(s, len); }
+
+    crypto::hash finish()
+    {
+      crypto::hash hash;
+      keccak_finish(&m_ctx, (uint8_t*)&hash);
+      m_stream.write((const char*)&hash, sizeof(hash));
+      if (!m_stream)
+        throw std::runtime_error("Failed to write snapshot");
+      return hash;
+    }
+
+  private:
+    std::ostream &m_stream;
+    KECCAK_CTX m_ctx;
+  };
+
+  class snapshot_reader
+  {
+  public:
+    snapshot_reader(std::istream &stream): m_stream(stream) { keccak_init(&m_ctx); }
+
+    void read(void *data, size_t size)
+    {
+      m_stream.read((char*)data, size);
+      if (!m_stream)
+        throw std::runtime_error("Failed to read snapshot: truncated file");
+      keccak_update(&m_ctx, (const uint8_t*)data, size);
+    }
+    uint32_t read_u32() { uint32_t v; read(&v, sizeof(v)); return SWAP32LE(v); }
+    uint64_t read_u64() { uint64_t v; read(&v, sizeof(v)); return SWAP64LE(v); }
+    void read_string(std::string &s, size_t len) { s.resize(len); if (len) read(&s[0], len); }
+
+    // checks the trailing hash against what was read so far
+    bool finish(crypto::hash &hash)
+    {
+      keccak_finish(&m_ctx, (uint8_t*)&hash);
+      crypto::hash expected;
+      m_stream.read((char*)&expected, sizeof(expected));
+      if (!m_stream)
+        throw std::runtime_error("Failed to read snapshot: truncated file");
+      return hash == expected;
+    }
+
+  private:
+    std::istream &m_stream;
+    KECCAK_CTX m_ctx;
+  };
+}
+
+static std::error_code replace_file(const boost::filesystem::path& replacement_name, const boost::filesystem::path& replaced_name)
+{
+  std::error_code ec = tools::replace_file(replacement_name.string(), replaced_name.string());
+  if (ec)
+    MERROR("Error renaming " << replacement_name << " to " << replaced_name << ": " << ec.message());
+  return ec;
+}
+
+static void open(MDB_env *&env, const boost::filesystem::path &path, uint64_t db_flags, bool readonly)
+{
+  int dbr;
+  int flags = 0;
+
+  if (db_flags & DBF_FAST)
+    flags |= MDB_NOSYNC;
+  if (db_flags & DBF_FASTEST)
+    flags |= MDB_NOSYNC | MDB_WRITEMAP | MDB_MAPASYNC;
+  if (readonly)
+    flags |= MDB_RDONLY;
+
+  dbr = mdb_env_create(&env);
+  if (dbr) throw std::runtime_error("Failed to create LDMB environment: " + std::string(mdb_strerror(dbr)));
+  dbr = mdb_env_set_maxdbs(env, 32);
+  if (dbr) throw std::runtime_error("Failed to set max env dbs: " + std::string(mdb_strerror(dbr)));
+  dbr = mdb_env_open(env, path.string().c_str(), flags, 0664);
+  if (dbr) throw std::runtime_error("Failed to open database file '"
+      + path.string() + "': " + std::string(mdb_strerror(dbr)));
+}
+
+static void close(MDB_env *env)
+{
+  mdb_env_close(env);
+}
+
+static void add_size(MDB_env *env, uint64_t bytes)
+{
+  try
+  {
+    boost::filesystem::path path(db_path);
+    boost::filesystem::space_info si = boost::filesystem::space(path);
+    if(si.available < bytes)
+    {
+      MERROR("!! WARNING: Insufficient free space to extend database !!: " <<
+          (si.available >> 20L) << " MB available, " << (bytes >> 20L) << " MB needed");
+      return;
+    }
+  }
+  catch(...)
+  {
+    // print something but proceed.
+    MWARNING("Unable to query free disk space.");
+  }
+
+  MDB_envinfo mei;
+  mdb_env_info(env, &mei);
+  MDB_stat mst;
+  mdb_env_stat(env, &mst);
+
+  uint64_t new_mapsize = (uint64_t)mei.me_mapsize + bytes;
+  new_mapsize += (new_mapsize % mst.ms_psize);
+
+  int result = mdb_env_set_mapsize(env, new_mapsize);
+  if (result)
+    throw std::runtime_error("Failed to set new mapsize to " + std::to_string(new_mapsize) + ": " + std::string(mdb_strerror(result)));
+
+  MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
+}
+
+static void check_resize(MDB_env *env, size_t bytes)
+{
+  MDB_envinfo mei;
+  MDB_stat mst;
+
+  mdb_env_info(env, &mei);
+  mdb_env_stat(env, &mst);
+
+  uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+  if (size_used + bytes + slack >= mei.me_mapsize)
+    add_size(env, size_used + bytes + 2 * slack - mei.me_mapsize);
+}
+
+static bool resize_point(size_t nrecords, MDB_env *env, MDB_txn **txn, size_t &bytes)
+{
+  if (nrecords % records_per_sync && bytes <= slack / 2)
+    return false;
+  int dbr = mdb_txn_commit(*txn);
+  if (dbr) throw std::runtime_error("Failed to commit txn: " + std::string(mdb_strerror(dbr)));
+  check_resize(env, bytes);
+  dbr = mdb_txn_begin(env, NULL, 0, txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  bytes = 0;
+  return true;
+}
+
+static void export_table(MDB_txn *txn, snapshot_writer &writer, const snapshot_table &table)
+{
+  MDB_dbi dbi;
+  MDB_cursor *cur;
+
+  MINFO("Exporting " << table.name);
+  writer.write_string(table.name);
+
+  int dbr = mdb_dbi_open(txn, table.name, table.flags, &dbi);
+  if (dbr == MDB_NOTFOUND && table.optional)
+  {
+    writer.write_u32(end_of_table);
+    return;
+  }
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  set_compare(txn, dbi, table);
+
+  dbr = mdb_cursor_open(txn, dbi, &cur);
+  if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+
+  MDB_val k;
+  MDB_val v;
+  MDB_cursor_op op = MDB_FIRST;
+  size_t nrecords = 0;
+  while (1)
+  {
+    int ret = mdb_cursor_get(cur, &k, &v, op);
+    op = MDB_NEXT;
+    if (ret == MDB_NOTFOUND)
+      break;
+    if (ret)
+      throw std::runtime_error("Failed to enumerate " + std::string(table.name) + " records: " + std::string(mdb_strerror(ret)));
+
+    writer.write_u32(k.mv_size);
+    writer.write(k.mv_data, k.mv_size);
+    writer.write_u32(v.mv_size);
+    writer.write(v.mv_data, v.mv_size);
+    ++nrecords;
+  }
+  writer.write_u32(end_of_table);
+
+  mdb_cursor_close(cur);
+  MDEBUG(nrecords << " records");
+}
+
+static void import_table(MDB_env *env, snapshot_reader &reader, const snapshot_table &table)
+{
+  MDB_dbi dbi;
+  MDB_txn *txn;
+  MDB_cursor *cur;
+  bool tx_active = false;
+  int dbr;
+
+  MINFO("Importing " << table.name);
+
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    if (tx_active) mdb_txn_abort(txn);
+  });
+
+  dbr = mdb_txn_begin(env, NULL, 0, &txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  tx_active = true;
+
+  dbr = mdb_dbi_open(txn, table.name, table.flags | MDB_CREATE, &dbi);
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  set_compare(txn, dbi, table);
+
+  dbr = mdb_drop(txn, dbi, 0);
+  if (dbr) throw std::runtime_error("Failed to empty " + std::string(table.name) + " LMDB table: " + std::string(mdb_strerror(dbr)));
+
+  dbr = mdb_cursor_open(txn, dbi, &cur);
+  if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+
+  std::string key, value;
+  size_t nrecords = 0, bytes = 0;
+  while (1)
+  {
+    const uint32_t key_size = reader.read_u32();
+    if (key_size == end_of_table)
+      break;
+    reader.read_string(key, key_size);
+    reader.read_string(value, reader.read_u32());
+
+    bytes += key.size() + value.size();
+    if (resize_point(++nrecords, env, &txn, bytes))
+    {
+      dbr = mdb_cursor_open(txn, dbi, &cur);
+      if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+    }
+
+    MDB_val k = {key.size(), (void*)key.data()};
+    MDB_val v = {value.size(), (void*)value.data()};
+    dbr = mdb_cursor_put(cur, &k, &v, table.putflags);
+    if (dbr)
+      throw std::runtime_error("Failed to write " + std::string(table.name) + " record: " + std::string(mdb_strerror(dbr)));
+  }
+
+  mdb_cursor_close(cur);
+  dbr = mdb_txn_commit(txn);
+  tx_active = false;
+  if (dbr) throw std::runtime_error("Failed to commit txn: " + std::string(mdb_strerror(dbr)));
+  mdb_dbi_close(env, dbi);
+  MDEBUG(nrecords << " records");
+}
+
+static bool get_top_block(MDB_txn *txn, uint64_t &height, crypto::hash &top_hash)
+{
+  MDB_dbi dbi;
+  MDB_cursor *cur;
+  int dbr = mdb_dbi_open(txn, "blocks", MDB_INTEGERKEY, &dbi);
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  dbr = mdb_cursor_open(txn, dbi, &cur);
+  if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+
+  MDB_val k, v;
+  dbr = mdb_cursor_get(cur, &k, &v, MDB_LAST);
+  if (dbr) throw std::runtime_error("Failed to read the top block: " + std::string(mdb_strerror(dbr)));
+  height = *(const uint64_t*)k.mv_data + 1;
+  block b;
+  const bool r = parse_and_validate_block_from_blob(blobdata((const char*)v.mv_data, v.mv_size), b);
+  mdb_cursor_close(cur);
+  if (!r)
+    return false;
+  top_hash = get_block_hash(b);
+  return true;
+}
+
+// a snapshot is only trusted if its top block is a compiled in checkpoint,
+// or if its hash was given by the user
+static bool check_snapshot_top(network_type net_type, uint64_t height, const crypto::hash &top_hash, bool &is_a_checkpoint)
+{
+  cryptonote::checkpoints checkpoints;
+  if (!checkpoints.init_default_checkpoints(net_type))
+    throw std::runtime_error("Failed to initialize checkpoints");
+  is_a_checkpoint = false;
+  if (!checkpoints.check_block(height - 1, top_hash, is_a_checkpoint))
+  {
+    MERROR("Top block " << top_hash << " at height " << height - 1 << " does not match the checkpoint at that height");
+    return false;
+  }
+  return true;
+}
+
+static bool parse_db_sync_mode(std::string db_sync_mode, uint64_t &db_flags)
+{
+  std::vector<std::string> options;
+  boost::trim(db_sync_mode);
+  boost::split(options, db_sync_mode, boost::is_any_of(" :"));
+
+  for(const auto &option : options)
+    MDEBUG("option: " << option);
+
+  // default to fast:async:1
+  uint64_t DEFAULT_FLAGS = DBF_FAST;
+
+  db_flags = 0;
+
+  if(options.size() == 0)
+  {
+    // default to fast:async:1
+    db_flags = DEFAULT_FLAGS;
+  }
+
+  bool safemode = false;
+  if(options.size() >= 1)
+  {
+    if(options[0] == "safe")
+    {
+      safemode = true;
+      db_flags = DBF_SAFE;
+    }
+    else if(options[0] == "fast")
+    {
+      db_flags = DBF_FAST;
+    }
+    else if(options[0] == "fastest")
+    {
+      db_flags = DBF_FASTEST;
+      records_per_sync = 1000; // default to fastest:async:1000
+    }
+    else
+      return false;
+  }
+
+  if(options.size() >= 2 && !safemode)
+  {
+    char *endptr;
+    uint64_t bps = strtoull(options[1].c_str(), &endptr, 0);
+    if (*endptr != '\0')
+      return false;
+    records_per_sync = bps;
+  }
+
+  return true;
+}
+
+static int export_snapshot(const boost::filesystem::path &path, const std::string &filename, network_type net_type)
+{
+  MINFO("Exporting snapshot of " << path << " to " << filename);
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file)
+  {
+    MERROR("Failed to open " << filename);
+    return 1;
+  }
+
+  MDB_env *env = NULL;
+  MDB_txn *txn = NULL;
+  open(env, path, 0, true);
+  epee::misc_utils::auto_scope_leave_caller env_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    if (txn) mdb_txn_abort(txn);
+    close(env);
+  });
+
+  // one read txn for every table, so the snapshot is consistent even if a daemon is adding blocks
+  int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+
+  uint64_t height;
+  crypto::hash top_hash;
+  if (!get_top_block(txn, height, top_hash))
+  {
+    MERROR("Failed to parse the top block");
+    return 1;
+  }
+  bool is_a_checkpoint;
+  if (!check_snapshot_top(net_type, height, top_hash, is_a_checkpoint))
+    return 1;
+  if (!is_a_checkpoint)
+    MWARNING("Height " << height - 1 << " is not a checkpoint, the snapshot can only be imported with --expected-hash");
+
+  snapshot_writer writer(file);
+  writer.write(snapshot_magic, sizeof(snapshot_magic));
+  writer.write_u32(snapshot_version);
+  writer.write_u64(height);
+  writer.write(&top_hash, sizeof(top_hash));
+  for (const snapshot_table &table: snapshot_tables)
+    export_table(txn, writer, table);
+  writer.write_u32(0);
+  const crypto::hash hash = writer.finish();
+  file.close();
+  if (!file)
+  {
+    MERROR("Failed to write " << filename);
+    return 1;
+  }
+
+  MINFO("Snapshot at height " << height << ", top block " << top_hash << ", snapshot hash " << hash);
+  return 0;
+}
+
+static int import_snapshot(const boost::filesystem::path &path, const std::string &filename, network_type net_type, uint64_t db_flags, const crypto::hash *expected_hash)
+{
+  MINFO("Importing snapshot " << filename << " into " << path);
+  std::ifstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    MERROR("Failed to open " << filename);
+    return 1;
+  }
+  snapshot_reader reader(file);
+
+  char magic[sizeof(snapshot_magic)];
+  reader.read(magic, sizeof(magic));
+  if (memcmp(magic, snapshot_magic, sizeof(magic)))
+  {
+    MERROR(filename << " is not a blockchain snapshot");
+    return 1;
+  }
+  const uint32_t version = reader.read_u32();
+  if (version != snapshot_version)
+  {
+    MERROR("Unsupported snapshot version " << version);
+    return 1;
+  }
+  const uint64_t height = reader.read_u64();
+  crypto::hash top_hash;
+  reader.read(&top_hash, sizeof(top_hash));
+  bool is_a_checkpoint;
+  if (height == 0 || !check_snapshot_top(net_type, height, top_hash, is_a_checkpoint))
+    return 1;
+  if (!is_a_checkpoint && !expected_hash)
+  {
+    MERROR("Height " << height - 1 << " is not a checkpoint, a snapshot there can only be checked against a hash given by --expected-hash");
+    return 1;
+  }
+
+  MDB_env *env = NULL;
+  open(env, path, db_flags, false);
+  epee::misc_utils::auto_scope_leave_caller env_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    close(env);
+  });
+
+  std::string name;
+  while (1)
+  {
+    const uint32_t name_size = reader.read_u32();
+    if (name_size == 0)
+      break;
+    reader.read_string(name, name_size);
+    const snapshot_table *table = find_snapshot_table(name);
+    if (!table)
+    {
+      MERROR("Unknown table in snapshot: " << name);
+      return 1;
+    }
+    import_table(env, reader, *table);
+  }
+
+  crypto::hash hash;
+  if (!reader.finish(hash))
+  {
+    MERROR("Snapshot hash mismatch, the file is corrupt");
+    return 1;
+  }
+  if (expected_hash && hash != *expected_hash)
+  {
+    MERROR("Snapshot hash " << hash << " does not match the expected " << *expected_hash);
+    return 1;
+  }
+
+  // the header is covered by the hash, but make sure the blocks agree with it
+  MDB_txn *txn;
+  int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  uint64_t db_height;
+  crypto::hash db_top_hash;
+  const bool r = get_top_block(txn, db_height, db_top_hash);
+  mdb_txn_abort(txn);
+  if (!r || db_height != height || db_top_hash != top_hash)
+  {
+    MERROR("Imported blocks do not match the snapshot header");
+    return 1;
+  }
+
+  MINFO("Snapshot at height " << height << ", top block " << top_hash << ", snapshot hash " << hash << " imported");
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  std::string default_db_type = "lmdb";
+
+  std::string available_dbs = cryptonote::blockchain_db_types(", ");
+  available_dbs = "available: " + available_dbs;
+
+  uint32_t log_level = 0;
+
+  tools::on_startup();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<std::string> arg_database = {
+    "database", available_dbs.c_str(), default_db_type
+  };
+  const command_line::arg_descriptor<std::string> arg_db_sync_mode = {
+    "db-sync-mode"
+  , "Specify sync option, using format [safe|fast|fastest]:[nrecords_per_sync]."
+  , "fast:1000"
+  };
+  const command_line::arg_descriptor<std::string> arg_export_file  = {"export-file", "Write a snapshot of the blockchain state to this file", ""};
+  const command_line::arg_descriptor<std::string> arg_import_file  = {"import-file", "Create the blockchain from this snapshot file", ""};
+  const command_line::arg_descriptor<std::string> arg_expected_hash  = {"expected-hash", "Only import a snapshot with this hash", ""};
+
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_stagenet_on);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_database);
+  command_line::add_arg(desc_cmd_sett, arg_db_sync_mode);
+  command_line::add_arg(desc_cmd_sett, arg_export_file);
+  command_line::add_arg(desc_cmd_sett, arg_import_file);
+  command_line::add_arg(desc_cmd_sett, arg_expected_hash);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    auto parser = po::command_line_parser(argc, argv).options(desc_options);
+    po::store(parser.run(), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Antd '" << ANTD_RELEASE_NAME << "' (v" << ANTD_VERSION_FULL << ")" << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure(mlog_get_default_log_path("antd-blockchain-snapshot.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
+
+  MINFO("Starting...");
+
+  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
+  bool opt_stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
+  network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
+  std::string data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+  while (boost::ends_with(data_dir, "/") || boost::ends_with(data_dir, "\\"))
+    data_dir.pop_back();
+
+  const std::string export_file = command_line::get_arg(vm, arg_export_file);
+  const std::string import_file = command_line::get_arg(vm, arg_import_file);
+  if (export_file.empty() == import_file.empty())
+  {
+    MERROR("Exactly one of --" << arg_export_file.name << " and --" << arg_import_file.name << " is needed");
+    return 1;
+  }
+
+  crypto::hash expected_hash;
+  const std::string expected_hash_str = command_line::get_arg(vm, arg_expected_hash);
+  if (!expected_hash_str.empty() && !epee::string_tools::hex_to_pod(expected_hash_str, expected_hash))
+  {
+    MERROR("Invalid snapshot hash: " << expected_hash_str);
+    return 1;
+  }
+
+  std::string db_type = command_line::get_arg(vm, arg_database);
+  if (!cryptonote::blockchain_valid_db_type(db_type))
+  {
+    MERROR("Invalid database type: " << db_type);
+    return 1;
+  }
+  if (db_type != "lmdb")
+  {
+    MERROR("Unsupported database type: " << db_type << ". Only lmdb is supported");
+    return 1;
+  }
+
+  std::string db_sync_mode = command_line::get_arg(vm, arg_db_sync_mode);
+  uint64_t db_flags = 0;
+  if (!parse_db_sync_mode(db_sync_mode, db_flags))
+  {
+    MERROR("Invalid db sync mode: " << db_sync_mode);
+    return 1;
+  }
+
+  std::unique_ptr<BlockchainDB> db(new_db(db_type));
+  if (!db)
+  {
+    MERROR("Attempted to use non-existent database type: " << db_type);
+    return 1;
+  }
+  const boost::filesystem::path path = boost::filesystem::path(data_dir) / db->get_db_name();
+
+  if (!export_file.empty())
+    return export_snapshot(path, export_file, net_type);
+
+  if (boost::filesystem::exists(path / CRYPTONOTE_BLOCKCHAINDATA_FILENAME))
+  {
+    MERROR("There is already a blockchain in " << path.string() << ", not overwriting it");
+    return 1;
+  }
+
+  // Let BlockchainDB create the tables with their usual flags in a scratch
+  // directory, then fill them from the snapshot and only move it in place
+  // once the whole snapshot checked out
+  const boost::filesystem::path snapshot_path = boost::filesystem::path(data_dir) / (db->get_db_name() + "-snapshot");
+  if (boost::filesystem::exists(snapshot_path))
+    boost::filesystem::remove_all(snapshot_path);
+  if (!boost::filesystem::create_directories(snapshot_path))
+  {
+    MERROR("Failed to create directory: " << snapshot_path.string());
+    return 1;
+  }
+  db_path = snapshot_path.string();
+  {
+    blockchain_objects_t *blockchain_objects = new blockchain_objects_t();
+    Blockchain *core_storage = &(blockchain_objects->m_blockchain);
+    BlockchainDB *new_db_ptr = db.release();
+    try
+    {
+      new_db_ptr->open(snapshot_path.string(), 0);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Error opening database: " << e.what());
+      return 1;
+    }
+    r = core_storage->init(new_db_ptr, net_type);
+    CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize snapshot blockchain storage");
+    core_storage->deinit();
+    delete blockchain_objects;
+  }
+
+  const int ret = import_snapshot(snapshot_path, import_file, net_type, db_flags, expected_hash_str.empty() ? NULL : &expected_hash);
+  if (ret)
+  {
+    MERROR("Snapshot import failed, partial database left in " << snapshot_path.string());
+    return ret;
+  }
+
+  // there is no blockchain in there, at most a lock file
+  boost::filesystem::remove_all(path);
+  if (replace_file(snapshot_path, path))
+  {
+    MERROR("Snapshot imported OK, but renaming failed");
+    return 1;
+  }
+
+  MINFO("Snapshot imported OK, the daemon will sync the rest of the blockchain from there");
+  return 0;
+
+  CATCH_ENTRY("Snapshot error", 1);
+}
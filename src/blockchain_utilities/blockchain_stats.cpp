@@ -32,6 +32,7 @@
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "blockchain_objects.h"
+#include "blockchain_scan.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/db_types.h"
 #include "version.h"
@@ -45,6 +46,64 @@ using namespace cryptonote;
 
 static bool stop_requested = false;
 
+struct tx_summary_t
+{
+  uint32_t ins;
+  uint32_t outs;
+  uint32_t ring;
+};
+
+struct block_summary_t
+{
+  uint64_t timestamp;
+  uint64_t bytes;
+  std::vector<tx_summary_t> txs;
+};
+
+static bool summarize_blocks(BlockchainDB *db, uint64_t begin, uint64_t end, bool do_ringsize, std::vector<block_summary_t> &blocks)
+{
+  blocks.reserve(end - begin);
+  for (uint64_t h = begin; h < end; ++h)
+  {
+    cryptonote::blobdata bd = db->get_block_blob_from_height(h);
+    cryptonote::block blk;
+    if (!cryptonote::parse_and_validate_block_from_blob(bd, blk))
+    {
+      LOG_PRINT_L0("Bad block from db");
+      return false;
+    }
+    blocks.push_back(block_summary_t());
+    block_summary_t &summary = blocks.back();
+    summary.timestamp = blk.timestamp;
+    summary.bytes = bd.size();
+    summary.txs.reserve(blk.tx_hashes.size());
+    for (const auto& tx_id : blk.tx_hashes)
+    {
+      if (tx_id == crypto::null_hash)
+      {
+        throw std::runtime_error("Aborting: tx == null_hash");
+      }
+      if (!db->get_tx_blob(tx_id, bd))
+      {
+        throw std::runtime_error("Aborting: tx not found");
+      }
+      // only the prefix is looked at
+      transaction_prefix tx;
+      if (!parse_and_validate_tx_prefix_from_blob(bd, tx))
+      {
+        LOG_PRINT_L0("Bad txn from db");
+        return false;
+      }
+      summary.bytes += bd.size();
+      tx_summary_t txs = {(uint32_t)tx.vin.size(), (uint32_t)tx.vout.size(), 0};
+      if (do_ringsize)
+        txs.ring = boost::get<cryptonote::txin_to_key>(tx.vin[0]).key_offsets.size();
+      summary.txs.push_back(txs);
+    }
+  }
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -221,112 +280,101 @@ plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, ''
   uint32_t txhr[24] = {0};
   unsigned int i;
 
-  for (uint64_t h = block_start; h < block_stop; ++h)
+  // blocks are fetched and parsed in parallel, the daily totals are added up in order
+  uint64_t h = block_start;
+  const auto merge = [&](const std::vector<block_summary_t> &blocks) -> bool
   {
-    cryptonote::blobdata bd = db->get_block_blob_from_height(h);
-    cryptonote::block blk;
-    if (!cryptonote::parse_and_validate_block_from_blob(bd, blk))
-    {
-      LOG_PRINT_L0("Bad block from db");
-      return 1;
-    }
-    time_t tt = blk.timestamp;
-    char timebuf[64];
-    epee::misc_utils::get_gmt_time(tt, currtm);
-    if (!prevtm.tm_year)
-      prevtm = currtm;
-    // catch change of day
-    if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
+    for (const block_summary_t &summary: blocks)
     {
-      // check for timestamp fudging around month ends
-      if (prevtm.tm_mday == 1 && currtm.tm_mday > 27)
-        goto skip;
-      strftime(timebuf, sizeof(timebuf), "%Y-%m-%d", &prevtm);
-      prevtm = currtm;
-      std::cout << timebuf << "\t" << currblks << "\t" << h << "\t" << currtxs << "\t" << prevtxs + currtxs << "\t" << currsz << "\t" << prevsz + currsz;
-      prevsz += currsz;
-      currsz = 0;
-      currblks = 0;
-      prevtxs += currtxs;
-      currtxs = 0;
-      if (!tottxs)
-        tottxs = 1;
-      if (do_inputs) {
-        std::cout << "\t" << (maxins ? minins : 0) << "\t" << maxins << "\t" << totins / tottxs;
-        minins = 10; maxins = 0; totins = 0;
-      }
-      if (do_outputs) {
-        std::cout << "\t" << (maxouts ? minouts : 0) << "\t" << maxouts << "\t" << totouts / tottxs;
-        minouts = 10; maxouts = 0; totouts = 0;
-      }
-      if (do_ringsize) {
-        std::cout << "\t" << (maxrings ? minrings : 0) << "\t" << maxrings << "\t" << totrings / tottxs;
-        minrings = 50; maxrings = 0; totrings = 0;
-      }
-      tottxs = 0;
-      if (do_hours) {
-        for (i=0; i<24; i++) {
-          std::cout << "\t" << txhr[i];
-          txhr[i] = 0;
+      time_t tt = summary.timestamp;
+      char timebuf[64];
+      epee::misc_utils::get_gmt_time(tt, currtm);
+      if (!prevtm.tm_year)
+        prevtm = currtm;
+      // catch change of day
+      if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
+      {
+        // check for timestamp fudging around month ends
+        if (prevtm.tm_mday == 1 && currtm.tm_mday > 27)
+          goto skip;
+        strftime(timebuf, sizeof(timebuf), "%Y-%m-%d", &prevtm);
+        prevtm = currtm;
+        std::cout << timebuf << "\t" << currblks << "\t" << h << "\t" << currtxs << "\t" << prevtxs + currtxs << "\t" << currsz << "\t" << prevsz + currsz;
+        prevsz += currsz;
+        currsz = 0;
+        currblks = 0;
+        prevtxs += currtxs;
+        currtxs = 0;
+        if (!tottxs)
+          tottxs = 1;
+        if (do_inputs) {
+          std::cout << "\t" << (maxins ? minins : 0) << "\t" << maxins << "\t" << totins / tottxs;
+          minins = 10; maxins = 0; totins = 0;
         }
+        if (do_outputs) {
+          std::cout << "\t" << (maxouts ? minouts : 0) << "\t" << maxouts << "\t" << totouts / tottxs;
+          minouts = 10; maxouts = 0; totouts = 0;
+        }
+        if (do_ringsize) {
+          std::cout << "\t" << (maxrings ? minrings : 0) << "\t" << maxrings << "\t" << totrings / tottxs;
+          minrings = 50; maxrings = 0; totrings = 0;
+        }
+        tottxs = 0;
+        if (do_hours) {
+          for (i=0; i<24; i++) {
+            std::cout << "\t" << txhr[i];
+            txhr[i] = 0;
+          }
+        }
+        std::cout << ENDL;
       }
-      std::cout << ENDL;
-    }
 skip:
-    currsz += bd.size();
-    for (const auto& tx_id : blk.tx_hashes)
-    {
-      if (tx_id == crypto::null_hash)
-      {
-        throw std::runtime_error("Aborting: tx == null_hash");
-      }
-      if (!db->get_tx_blob(tx_id, bd))
-      {
-        throw std::runtime_error("Aborting: tx not found");
-      }
-      transaction tx;
-      if (!parse_and_validate_tx_from_blob(bd, tx))
+      currsz += summary.bytes;
+      for (const tx_summary_t &tx: summary.txs)
       {
-        LOG_PRINT_L0("Bad txn from db");
-        return 1;
-      }
-      currsz += bd.size();
-      currtxs++;
-      if (do_hours)
-        txhr[currtm.tm_hour]++;
-      if (do_inputs) {
-        io = tx.vin.size();
-        if (io < minins)
-          minins = io;
-        else if (io > maxins)
-          maxins = io;
-        totins += io;
-      }
-      if (do_ringsize) {
-        const cryptonote::txin_to_key& tx_in_to_key
-                       = boost::get<cryptonote::txin_to_key>(tx.vin[0]);
-        io = tx_in_to_key.key_offsets.size();
-        if (io < minrings)
-          minrings = io;
-        else if (io > maxrings)
-          maxrings = io;
-        totrings += io;
-      }
-      if (do_outputs) {
-        io = tx.vout.size();
-        if (io < minouts)
-          minouts = io;
-        else if (io > maxouts)
-          maxouts = io;
-        totouts += io;
+        currtxs++;
+        if (do_hours)
+          txhr[currtm.tm_hour]++;
+        if (do_inputs) {
+          io = tx.ins;
+          if (io < minins)
+            minins = io;
+          else if (io > maxins)
+            maxins = io;
+          totins += io;
+        }
+        if (do_ringsize) {
+          io = tx.ring;
+          if (io < minrings)
+            minrings = io;
+          else if (io > maxrings)
+            maxrings = io;
+          totrings += io;
+        }
+        if (do_outputs) {
+          io = tx.outs;
+          if (io < minouts)
+            minouts = io;
+          else if (io > maxouts)
+            maxouts = io;
+          totouts += io;
+        }
+        tottxs++;
       }
-      tottxs++;
-    }
-    currblks++;
+      currblks++;
+      ++h;
 
-    if (stop_requested)
-      break;
-  }
+      if (stop_requested)
+        return false;
+    }
+    return true;
+  };
+  const auto scan = [&](uint64_t begin, uint64_t end, std::vector<block_summary_t> &blocks)
+  {
+    return summarize_blocks(db, begin, end, do_ringsize, blocks);
+  };
+  if (!parallel_scan<std::vector<block_summary_t>>(block_start, block_stop, 1000, scan, merge))
+    return 1;
 
   core_storage->deinit();
   return 0;
@@ -33,6 +33,7 @@
 #include "common/varint.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "blockchain_objects.h"
+#include "blockchain_scan.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/db_types.h"
 #include "version.h"
@@ -76,6 +77,71 @@ struct reference
   reference(uint64_t h, uint64_t rs, uint64_t p): height(h), ring_size(rs), position(p) {}
 };
 
+// outputs created and spent over a range of blocks, in chain order; the
+// created outputs' indices are only known once the previous ranges are merged
+struct usage_range_t
+{
+  struct created_t
+  {
+    uint64_t amount;
+    bool coinbase;
+    uint64_t height;
+  };
+  std::vector<created_t> created;
+  std::vector<std::pair<output_data, reference>> spent;
+};
+
+static bool scan_usage(BlockchainDB *db, uint64_t begin, uint64_t end, bool opt_rct_only, usage_range_t &range)
+{
+  for (uint64_t height = begin; height < end; ++height)
+  {
+    cryptonote::block b;
+    if (!cryptonote::parse_and_validate_block_from_blob(db->get_block_blob_from_height(height), b))
+    {
+      LOG_PRINT_L0("Bad block from db");
+      return false;
+    }
+    for (size_t n = 0; n <= b.tx_hashes.size(); ++n)
+    {
+      cryptonote::transaction tx;
+      if (n == 0)
+        tx = std::move(b.miner_tx);
+      else
+      {
+        cryptonote::blobdata bd;
+        if (!db->get_pruned_tx_blob(b.tx_hashes[n - 1], bd) || !cryptonote::parse_and_validate_tx_prefix_from_blob(bd, tx))
+        {
+          LOG_PRINT_L0("Bad tx from db: " << b.tx_hashes[n - 1]);
+          return false;
+        }
+      }
+      const bool coinbase = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
+
+      // create new outputs
+      for (const auto &out: tx.vout)
+      {
+        if (opt_rct_only && out.amount)
+          continue;
+        range.created.push_back({out.amount, coinbase, height});
+      }
+
+      for (const auto &in: tx.vin)
+      {
+        if (in.type() != typeid(txin_to_key))
+          continue;
+        const auto &txin = boost::get<txin_to_key>(in);
+        if (opt_rct_only && txin.amount != 0)
+          continue;
+
+        const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
+        for (size_t n = 0; n < txin.key_offsets.size(); ++n)
+          range.spent.emplace_back(output_data(txin.amount, absolute[n], coinbase, height), reference(height, txin.key_offsets.size(), n));
+      }
+    }
+  }
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -203,39 +269,25 @@ int main(int argc, char* argv[])
   std::unordered_map<uint64_t,uint64_t> indices;
 
   LOG_PRINT_L0("Reading blockchain from " << input);
-  core_storage->for_all_transactions([&](const crypto::hash &hash, const cryptonote::transaction &tx)->bool
+  const auto scan = [&](uint64_t begin, uint64_t end, usage_range_t &range)
   {
-    const bool coinbase = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
-    const uint64_t height = core_storage->get_db().get_tx_block_height(hash);
-
-    // create new outputs
-    for (const auto &out: tx.vout)
+    return scan_usage(db, begin, end, opt_rct_only, range);
+  };
+  const auto merge = [&](usage_range_t &range)
+  {
+    for (const auto &c: range.created)
     {
-      if (opt_rct_only && out.amount)
-        continue;
-      uint64_t index = indices[out.amount]++;
-      output_data od(out.amount, indices[out.amount], coinbase, height);
+      uint64_t index = indices[c.amount]++;
+      output_data od(c.amount, indices[c.amount], c.coinbase, c.height);
       auto itb = outputs.emplace(od, std::list<reference>());
-      itb.first->first.info(coinbase, height);
-    }
-
-    for (const auto &in: tx.vin)
-    {
-      if (in.type() != typeid(txin_to_key))
-        continue;
-      const auto &txin = boost::get<txin_to_key>(in);
-      if (opt_rct_only && txin.amount != 0)
-        continue;
-
-      const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-      for (size_t n = 0; n < txin.key_offsets.size(); ++n)
-      {
-        output_data od(txin.amount, absolute[n], coinbase, height);
-        outputs[od].push_back(reference(height, txin.key_offsets.size(), n));
-      }
+      itb.first->first.info(c.coinbase, c.height);
     }
+    for (auto &s: range.spent)
+      outputs[s.first].push_back(s.second);
     return true;
-  }, true);
+  };
+  if (!parallel_scan<usage_range_t>(0, db->height(), 1000, scan, merge))
+    return 1;
 
   std::unordered_map<uint64_t, uint64_t> counts;
   size_t total = 0;
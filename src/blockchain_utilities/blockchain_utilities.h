@@ -36,5 +36,9 @@
 #define BUFFER_SIZE 1000000
 #define CHUNK_SIZE_WARNING_THRESHOLD 500000
 #define NUM_BLOCKS_PER_CHUNK 1
+// set in a v2 chunk size when the chunk is zstd compressed
+#define CHUNK_COMPRESSED_FLAG 0x80000000
+// blocks per pool thread prepared ahead of the writer when exporting
+#define EXPORT_BLOCKS_PER_THREAD 64
 #define BLOCKCHAIN_RAW "blockchain.raw"
 
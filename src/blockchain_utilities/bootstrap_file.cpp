@@ -33,6 +33,13 @@
 #include "serialization/serialization_boost_multiprecision.h"
 #include "bootstrap_file.h"
 #include "serialization/serialization_boost_multiprecision.h"
+#include "int-util.h"
+#include "common/threadpool.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #undef ANTD_DEFAULT_LOG_CATEGORY
 #define ANTD_DEFAULT_LOG_CATEGORY "bcutil"
 
@@ -48,7 +55,64 @@ namespace
   const uint32_t blockchain_raw_magic = 0x28721586;
   const uint32_t header_size = 1024;
 
+  // echo Antd bootstrap index | sha1sum
+  const uint32_t blockchain_raw_index_magic = 0x0d682ef0;
+  // index offset and magic, little endian, at the very end of a v2 file
+  const size_t index_trailer_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+  const int chunk_zstd_level = 3;
+
   std::string refresh_string = "\r                                    \r";
+
+  void write_index_trailer(char *out, uint64_t index_pos)
+  {
+    const uint64_t pos = SWAP64LE(index_pos);
+    const uint32_t magic = SWAP32LE(blockchain_raw_index_magic);
+    memcpy(out, &pos, sizeof(pos));
+    memcpy(out + sizeof(pos), &magic, sizeof(magic));
+  }
+
+  // data_start is the first chunk's position, the end of chunks marker sits
+  // right before the index
+  bool parse_index(const char *trailer, const std::string &blob, uint64_t data_start, bootstrap::chunk_index &index, uint64_t &index_pos)
+  {
+    uint64_t pos;
+    uint32_t magic;
+    memcpy(&pos, trailer, sizeof(pos));
+    memcpy(&magic, trailer + sizeof(pos), sizeof(magic));
+    if (SWAP32LE(magic) != blockchain_raw_index_magic)
+      return false;
+    index_pos = SWAP64LE(pos);
+    if (index_pos < data_start + sizeof(uint32_t))
+      return false;
+    if (!::serialization::parse_binary(blob, index))
+      return false;
+    const uint64_t data_end = index_pos - sizeof(uint32_t);
+    uint64_t prev = 0;
+    for (uint64_t offset: index.offsets)
+    {
+      if (offset < data_start || offset < prev || offset + sizeof(uint32_t) > data_end)
+        return false;
+      prev = offset + sizeof(uint32_t);
+    }
+    return true;
+  }
+
+#ifdef HAVE_ZSTD
+  bool compress_chunk(const std::string &in, std::string &out)
+  {
+    static thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    if (!cctx)
+      return false;
+    out.resize(ZSTD_compressBound(in.size()));
+    const size_t res = ZSTD_compressCCtx(cctx.get(), &out[0], out.size(), in.data(), in.size(), chunk_zstd_level);
+    // keep the raw chunk if it does not shrink
+    if (ZSTD_isError(res) || res >= in.size())
+      return false;
+    out.resize(res);
+    return true;
+  }
+#endif
 }
 
 
@@ -89,10 +153,29 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
   }
   else
   {
-    num_blocks = count_blocks(file_path.string());
+    uint64_t index_pos;
+    if (read_index(file_path.string(), m_index, index_pos))
+    {
+      // new chunks go over the old end of chunks marker, close() writes the index back
+      m_indexed = true;
+      num_blocks = m_index.block_first + m_index.offsets.size();
+      boost::filesystem::resize_file(file_path, index_pos - sizeof(uint32_t));
+    }
+    else
+    {
+      if (m_indexed)
+        MWARNING("Appending to a v1 bootstrap file, it will not be indexed");
+      m_indexed = false;
+      num_blocks = count_blocks(file_path.string());
+    }
     MDEBUG("appending to existing file with height: " << num_blocks-1 << "  total blocks: " << num_blocks);
   }
   m_height = num_blocks;
+  if (do_initialize_file)
+  {
+    m_index.block_first = num_blocks;
+    m_index.offsets.clear();
+  }
 
   if (do_initialize_file)
     m_raw_data_file->open(file_path.string(), std::ios_base::binary | std::ios_base::out | std::ios::trunc);
@@ -102,10 +185,6 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
   if (m_raw_data_file->fail())
     return false;
 
-  m_output_stream = new boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>(m_buffer);
-  if (m_output_stream == nullptr)
-    return false;
-
   if (do_initialize_file)
     initialize_file();
 
@@ -125,7 +204,7 @@ bool BootstrapFile::initialize_file()
   *m_raw_data_file << blob;
 
   bootstrap::file_info bfi;
-  bfi.major_version = 1;
+  bfi.major_version = m_indexed ? 2 : 1;
   bfi.minor_version = 0;
   bfi.header_size = header_size;
 
@@ -169,19 +248,55 @@ bool BootstrapFile::initialize_file()
   return true;
 }
 
-void BootstrapFile::flush_chunk()
+void BootstrapFile::prepare_chunk(uint64_t height, prepared_chunk& chunk) const
 {
-  m_output_stream->flush();
+  BlockchainDB &db = m_blockchain_storage->get_db();
+  bootstrap::block_package bp;
+  bp.block = db.get_block_from_height(height);
+
+  // now add all regular transactions
+  bp.txs.reserve(bp.block.tx_hashes.size());
+  for (const auto& tx_id : bp.block.tx_hashes)
+  {
+    if (tx_id == crypto::null_hash)
+    {
+      throw std::runtime_error("Aborting: tx == null_hash");
+    }
+    bp.txs.push_back(db.get_tx(tx_id));
+  }
 
-  uint32_t chunk_size = m_buffer.size();
+  // These three attributes are currently necessary for a fast import that adds blocks without verification.
+  bp.block_weight = db.get_block_weight(height);
+  bp.cumulative_difficulty = db.get_block_cumulative_difficulty(height);
+  bp.coins_generated = db.get_block_already_generated_coins(height);
+
+  chunk.data = t_serializable_object_to_blob(bp);
+  chunk.raw_size = chunk.data.size();
+  chunk.stored_size = chunk.raw_size;
+#ifdef HAVE_ZSTD
+  std::string compressed;
+  if (m_indexed && m_compress && compress_chunk(chunk.data, compressed))
+  {
+    chunk.data = std::move(compressed);
+    chunk.stored_size = chunk.data.size() | CHUNK_COMPRESSED_FLAG;
+  }
+#endif
+}
+
+void BootstrapFile::write_chunk(const prepared_chunk& chunk)
+{
+  const uint32_t chunk_size = chunk.raw_size;
   // MTRACE("chunk_size " << chunk_size);
   if (chunk_size > BUFFER_SIZE)
   {
     MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
   }
 
+  if (m_indexed)
+    m_index.offsets.push_back(static_cast<uint64_t>(m_raw_data_file->tellp()));
+
   std::string blob;
-  if (! ::serialization::dump_binary(chunk_size, blob))
+  if (! ::serialization::dump_binary(chunk.stored_size, blob))
   {
     throw std::runtime_error("Error in serialization of chunk size");
   }
@@ -191,63 +306,17 @@ void BootstrapFile::flush_chunk()
   {
     m_max_chunk = chunk_size;
   }
+  const uint32_t data_size = chunk.data.size();
   long pos_before = m_raw_data_file->tellp();
-  std::copy(m_buffer.begin(), m_buffer.end(), std::ostreambuf_iterator<char>(*m_raw_data_file));
-  m_raw_data_file->flush();
+  m_raw_data_file->write(chunk.data.data(), data_size);
   long pos_after = m_raw_data_file->tellp();
   long num_chars_written = pos_after - pos_before;
-  if (static_cast<unsigned long>(num_chars_written) != chunk_size)
+  if (static_cast<unsigned long>(num_chars_written) != data_size)
   {
     MFATAL("Error writing chunk:  height: " << m_cur_height << "  chunk_size: " << chunk_size << "  num chars written: " << num_chars_written);
     throw std::runtime_error("Error writing chunk");
   }
-
-  m_buffer.clear();
-  delete m_output_stream;
-  m_output_stream = new boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>(m_buffer);
-  MDEBUG("flushed chunk:  chunk_size: " << chunk_size);
-}
-
-void BootstrapFile::write_block(block& block)
-{
-  bootstrap::block_package bp;
-  bp.block = block;
-
-  std::vector<transaction> txs;
-
-  uint64_t block_height = boost::get<txin_gen>(block.miner_tx.vin.front()).height;
-
-
-  // now add all regular transactions
-  for (const auto& tx_id : block.tx_hashes)
-  {
-    if (tx_id == crypto::null_hash)
-    {
-      throw std::runtime_error("Aborting: tx == null_hash");
-    }
-    transaction tx = m_blockchain_storage->get_db().get_tx(tx_id);
-
-    txs.push_back(tx);
-  }
-
-  // these non-coinbase txs will be serialized using this structure
-  bp.txs = txs;
-
-  // These three attributes are currently necessary for a fast import that adds blocks without verification.
-  bool include_extra_block_data = true;
-  if (include_extra_block_data)
-  {
-    size_t block_weight = m_blockchain_storage->get_db().get_block_weight(block_height);
-    difficulty_type cumulative_difficulty = m_blockchain_storage->get_db().get_block_cumulative_difficulty(block_height);
-    uint64_t coins_generated = m_blockchain_storage->get_db().get_block_already_generated_coins(block_height);
-
-    bp.block_weight = block_weight;
-    bp.cumulative_difficulty = cumulative_difficulty;
-    bp.coins_generated = coins_generated;
-  }
-
-  blobdata bd = t_serializable_object_to_blob(bp);
-  m_output_stream->write((const char*)bd.data(), bd.size());
+  MDEBUG("wrote chunk:  chunk_size: " << chunk_size << "  stored: " << data_size);
 }
 
 bool BootstrapFile::close()
@@ -255,19 +324,41 @@ bool BootstrapFile::close()
   if (m_raw_data_file->fail())
     return false;
 
+  if (m_indexed)
+  {
+    std::string blob;
+    const uint32_t end_marker = 0;
+    if (! ::serialization::dump_binary(end_marker, blob))
+      throw std::runtime_error("Error in serialization of end of chunks marker");
+    *m_raw_data_file << blob;
+    const uint64_t index_pos = m_raw_data_file->tellp();
+    *m_raw_data_file << t_serializable_object_to_blob(m_index);
+    char trailer[index_trailer_size];
+    write_index_trailer(trailer, index_pos);
+    m_raw_data_file->write(trailer, sizeof(trailer));
+    if (m_raw_data_file->fail())
+      return false;
+    MINFO("Wrote index of " << m_index.offsets.size() << " chunks");
+  }
+
   m_raw_data_file->flush();
-  delete m_output_stream;
   delete m_raw_data_file;
   return true;
 }
 
 
-bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_memory_pool* _tx_pool, boost::filesystem::path& output_file, uint64_t requested_block_stop)
+bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_memory_pool* _tx_pool, boost::filesystem::path& output_file, uint64_t requested_block_stop, bool indexed, bool compress)
 {
   uint64_t num_blocks_written = 0;
   m_max_chunk = 0;
   m_blockchain_storage = _blockchain_storage;
   m_tx_pool = _tx_pool;
+  m_indexed = indexed;
+  m_compress = compress;
+#ifndef HAVE_ZSTD
+  if (m_compress)
+    MWARNING("This build has no zstd support, chunks will be stored uncompressed");
+#endif
   uint64_t progress_interval = 100;
   MINFO("Storing blocks raw data...");
   if (!BootstrapFile::open_writer(output_file))
@@ -275,8 +366,6 @@ bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_mem
     MFATAL("failed to open raw file for write");
     return false;
   }
-  block b;
-
   // block_start, block_stop use 0-based height. m_height uses 1-based height. So to resume export
   // from last exported block, block_start doesn't need to add 1 here, as it's already at the next
   // height.
@@ -293,25 +382,43 @@ bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_mem
     block_stop = m_blockchain_storage->get_current_blockchain_height() - 1;
     MINFO("Using block height of source blockchain: " << block_stop);
   }
-  for (m_cur_height = block_start; m_cur_height <= block_stop; ++m_cur_height)
+  // Blocks are read, serialized and compressed a batch at a time on the
+  // threadpool, then written out in height order on this thread.
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const uint64_t batch_size = std::max(1u, tpool.get_max_concurrency()) * EXPORT_BLOCKS_PER_THREAD;
+  std::vector<prepared_chunk> chunks;
+  m_cur_height = block_start;
+  for (uint64_t batch_start = block_start; batch_start <= block_stop; batch_start += batch_size)
   {
-    // this method's height refers to 0-based height (genesis block = height 0)
-    crypto::hash hash = m_blockchain_storage->get_block_id_by_height(m_cur_height);
-    m_blockchain_storage->get_block_by_hash(hash, b);
-    write_block(b);
-    if (m_cur_height % NUM_BLOCKS_PER_CHUNK == 0) {
-      flush_chunk();
-      num_blocks_written += NUM_BLOCKS_PER_CHUNK;
-    }
-    if (m_cur_height % progress_interval == 0) {
-      std::cout << refresh_string;
-      std::cout << "block " << m_cur_height << "/" << block_stop << "\r" << std::flush;
+    const uint64_t count = std::min(batch_size, block_stop - batch_start + 1);
+    chunks.resize(count);
+    std::vector<std::string> errors(count);
+    const auto prepare = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        try { prepare_chunk(batch_start + i, chunks[i]); }
+        catch (const std::exception &e) { errors[i] = e.what(); return; }
+      }
+    };
+    tools::threadpool::waiter waiter;
+    tpool.submit_range(&waiter, count, EXPORT_BLOCKS_PER_THREAD / 4, prepare);
+    waiter.wait(&tpool);
+
+    for (uint64_t i = 0; i < count; ++i, ++m_cur_height)
+    {
+      if (!errors[i].empty())
+      {
+        MFATAL("Error exporting block " << m_cur_height << ": " << errors[i]);
+        throw std::runtime_error(errors[i]);
+      }
+      write_chunk(chunks[i]);
+      ++num_blocks_written;
+      if (m_cur_height % progress_interval == 0) {
+        std::cout << refresh_string;
+        std::cout << "block " << m_cur_height << "/" << block_stop << "\r" << std::flush;
+      }
     }
-  }
-  // NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
-  if (m_cur_height % NUM_BLOCKS_PER_CHUNK != 0)
-  {
-    flush_chunk();
+    m_raw_data_file->flush();
   }
   // print message for last block, which may not have been printed yet due to progress_interval
   std::cout << refresh_string;
@@ -506,3 +613,128 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path, std::s
   // one-based height.
   return h;
 }
+
+bool BootstrapFile::read_index(const std::string& file_path, bootstrap::chunk_index& index, uint64_t& index_pos)
+{
+  std::ifstream import_file;
+  import_file.open(file_path, std::ios_base::binary | std::ifstream::in);
+  if (import_file.fail())
+  {
+    MFATAL("import_file.open() fail");
+    throw std::runtime_error("Aborting");
+  }
+
+  uint8_t major_version, minor_version;
+  const uint64_t full_header_size = seek_to_first_chunk(import_file, major_version, minor_version);
+  if (major_version < 2)
+    return false;
+
+  import_file.seekg(0, std::ios_base::end);
+  const uint64_t file_size = import_file.tellg();
+  if (file_size < full_header_size + sizeof(uint32_t) + index_trailer_size)
+    throw std::runtime_error("Bootstrap file is too short to hold its index");
+  char trailer[index_trailer_size];
+  import_file.seekg(file_size - index_trailer_size);
+  import_file.read(trailer, sizeof(trailer));
+  if (!import_file)
+    throw std::runtime_error("Error reading bootstrap index trailer");
+
+  uint64_t pos;
+  memcpy(&pos, trailer, sizeof(pos));
+  pos = SWAP64LE(pos);
+  if (pos > file_size - index_trailer_size)
+    throw std::runtime_error("Bootstrap index offset is out of range, the file may be truncated");
+  std::string blob(file_size - index_trailer_size - pos, 0);
+  import_file.seekg(pos);
+  import_file.read(&blob[0], blob.size());
+  if (!import_file)
+    throw std::runtime_error("Error reading bootstrap index");
+  if (!parse_index(trailer, blob, full_header_size, index, index_pos))
+    throw std::runtime_error("Invalid bootstrap index, the file may be truncated");
+  MINFO("bootstrap index: " << index.offsets.size() << " chunks from height " << index.block_first);
+  return true;
+}
+
+bool BootstrapChunkReader::open(const std::string& file_path)
+{
+  BootstrapFile bootstrap;
+  uint64_t index_pos;
+  if (!bootstrap.read_index(file_path, m_index, index_pos))
+    return false;
+  try
+  {
+    m_file = boost::interprocess::file_mapping(file_path.c_str(), boost::interprocess::read_only);
+    m_region = boost::interprocess::mapped_region(m_file, boost::interprocess::read_only);
+  }
+  catch (const std::exception &e)
+  {
+    MFATAL("Failed to map bootstrap file " << file_path << ": " << e.what());
+    throw std::runtime_error("Aborting");
+  }
+  if (m_region.get_size() < index_pos)
+    throw std::runtime_error("Bootstrap file changed while opening it");
+  m_data_end = index_pos - sizeof(uint32_t);
+  return true;
+}
+
+uint64_t BootstrapChunkReader::bytes(uint64_t height, uint64_t count) const
+{
+  if (height < m_index.block_first || height - m_index.block_first >= m_index.offsets.size())
+    return 0;
+  const uint64_t first = height - m_index.block_first;
+  const uint64_t last = first + std::min<uint64_t>(count, m_index.offsets.size() - first);
+  const uint64_t end = last < m_index.offsets.size() ? m_index.offsets[last] : m_data_end;
+  return end - m_index.offsets[first];
+}
+
+bool BootstrapChunkReader::get_chunk(uint64_t height, std::string& chunk) const
+{
+  if (height < m_index.block_first || height - m_index.block_first >= m_index.offsets.size())
+  {
+    MERROR("Block " << height << " is not in the bootstrap file");
+    return false;
+  }
+  const uint64_t offset = m_index.offsets[height - m_index.block_first];
+  const char *data = static_cast<const char*>(m_region.get_address());
+  uint32_t chunk_size;
+  memcpy(&chunk_size, data + offset, sizeof(chunk_size));
+  chunk_size = SWAP32LE(chunk_size);
+  const bool compressed = chunk_size & CHUNK_COMPRESSED_FLAG;
+  chunk_size &= ~CHUNK_COMPRESSED_FLAG;
+  if (chunk_size == 0 || chunk_size > BUFFER_SIZE || chunk_size > m_data_end - offset - sizeof(chunk_size))
+  {
+    MERROR("Invalid chunk size " << chunk_size << " at height " << height << ", offset " << offset);
+    return false;
+  }
+  const char *payload = data + offset + sizeof(chunk_size);
+  if (!compressed)
+  {
+    chunk.assign(payload, chunk_size);
+    return true;
+  }
+#ifdef HAVE_ZSTD
+  static thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  if (!dctx)
+  {
+    MERROR("Failed to create zstd decompression context");
+    return false;
+  }
+  const unsigned long long size = ZSTD_getFrameContentSize(payload, chunk_size);
+  if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN || size == 0 || size > BUFFER_SIZE)
+  {
+    MERROR("Invalid compressed chunk at height " << height);
+    return false;
+  }
+  chunk.resize(size);
+  const size_t res = ZSTD_decompressDCtx(dctx.get(), &chunk[0], size, payload, chunk_size);
+  if (ZSTD_isError(res) || res != size)
+  {
+    MERROR("Failed to decompress chunk at height " << height << ": " << (ZSTD_isError(res) ? ZSTD_getErrorName(res) : "size mismatch"));
+    return false;
+  }
+  return true;
+#else
+  MERROR("Chunk at height " << height << " is compressed, but this build has no zstd support");
+  return false;
+#endif
+}
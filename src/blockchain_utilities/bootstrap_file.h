@@ -34,6 +34,8 @@
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_core/blockchain.h"
@@ -48,6 +50,7 @@
 #include "version.h"
 
 #include "blockchain_utilities.h"
+#include "bootstrap_serialization.h"
 
 
 using namespace cryptonote;
@@ -62,8 +65,13 @@ public:
   uint64_t count_blocks(const std::string& dir_path);
   uint64_t seek_to_first_chunk(std::ifstream& import_file, uint8_t &major_version, uint8_t &minor_version);
 
+  // returns false if the file has no index (v1), throws if a v2 index is unreadable
+  bool read_index(const std::string& file_path, bootstrap::chunk_index& index, uint64_t& index_pos);
+
+  // indexed writes a v2 file (only when creating it, appends keep the existing format),
+  // compress stores its chunks zstd compressed
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
-      boost::filesystem::path& output_file, uint64_t use_block_height=0);
+      boost::filesystem::path& output_file, uint64_t use_block_height=0, bool indexed=false, bool compress=false);
 
 protected:
 
@@ -72,19 +80,51 @@ protected:
   tx_memory_pool* m_tx_pool;
   typedef std::vector<char> buffer_type;
   std::ofstream * m_raw_data_file;
-  buffer_type m_buffer;
-  boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>* m_output_stream;
+
+  // a block's chunk as it goes into the file, built on the threadpool
+  struct prepared_chunk
+  {
+    std::string data; // compressed when stored_size has CHUNK_COMPRESSED_FLAG
+    uint32_t stored_size;
+    uint32_t raw_size;
+  };
 
   // open export file for write
   bool open_writer(const boost::filesystem::path& file_path);
   bool initialize_file();
   bool close();
-  void write_block(block& block);
-  void flush_chunk();
+  // only reads the db, so several heights may be prepared at once
+  void prepare_chunk(uint64_t height, prepared_chunk& chunk) const;
+  void write_chunk(const prepared_chunk& chunk);
 
 private:
 
   uint64_t m_height;
   uint64_t m_cur_height; // tracks current height during export
   uint32_t m_max_chunk;
+  bool m_indexed;
+  bool m_compress;
+  bootstrap::chunk_index m_index;
+};
+
+// Random access to the chunks of a v2 bootstrap file through a read only
+// mapping; get_chunk may be called from several threads at once
+class BootstrapChunkReader
+{
+public:
+  // returns false for a v1 file, throws if a v2 file can't be mapped or its index is broken
+  bool open(const std::string& file_path);
+
+  uint64_t block_first() const { return m_index.block_first; }
+  uint64_t block_count() const { return m_index.offsets.size(); }
+  // stored size of the chunks for [height, height + count)
+  uint64_t bytes(uint64_t height, uint64_t count) const;
+  // copies out, decompressing if needed, the chunk holding the block at height
+  bool get_chunk(uint64_t height, std::string& chunk) const;
+
+private:
+  boost::interprocess::file_mapping m_file;
+  boost::interprocess::mapped_region m_region;
+  bootstrap::chunk_index m_index;
+  uint64_t m_data_end; // position of the end of chunks marker
 };
@@ -66,6 +66,20 @@ namespace cryptonote
       END_SERIALIZE()
     };
 
+    // v2 files end their chunks with a zero chunk size, followed by this
+    // index and a fixed size trailer (index offset, trailer magic)
+    struct chunk_index
+    {
+      uint64_t block_first;
+      // file offset of each chunk's size field, one chunk per block
+      std::vector<uint64_t> offsets;
+
+      BEGIN_SERIALIZE_OBJECT()
+        VARINT_FIELD(block_first);
+        FIELD(offsets);
+      END_SERIALIZE()
+    };
+
     struct block_package
     {
       cryptonote::block block;
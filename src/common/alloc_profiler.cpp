@@ -0,0 +1,160 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "alloc_profiler.h"
+
+namespace tools
+{
+  namespace
+  {
+    const char *const scope_names[] = { "other", "block_validation", "tx_pool", "rpc", "p2p", "wallet_scan" };
+    static_assert(sizeof(scope_names) / sizeof(scope_names[0]) == (size_t)alloc_scope::count, "a scope has no name");
+
+    // operator new can not allocate, so the counters are shared atomics
+    // rather than per thread shards; this is only paid for in profiling builds
+    struct alloc_counters
+    {
+      std::atomic<uint64_t> allocations;
+      std::atomic<uint64_t> bytes;
+    };
+
+    // zero initialized before any dynamic initializer can allocate
+    alloc_counters counters[(size_t)alloc_scope::count];
+    thread_local alloc_scope current_scope = alloc_scope::other;
+
+    void record_alloc(size_t size)
+    {
+      alloc_counters &c = counters[(size_t)current_scope];
+      c.allocations.fetch_add(1, std::memory_order_relaxed);
+      c.bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+  }
+
+  const char *alloc_scope_name(alloc_scope scope)
+  {
+    return scope < alloc_scope::count ? scope_names[(size_t)scope] : "unknown";
+  }
+
+  bool is_alloc_profiling_enabled()
+  {
+#ifdef ALLOC_PROFILING
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  std::vector<alloc_scope_stats> get_alloc_stats()
+  {
+    std::vector<alloc_scope_stats> stats;
+    if (!is_alloc_profiling_enabled())
+      return stats;
+    stats.reserve((size_t)alloc_scope::count);
+    for (size_t n = 0; n < (size_t)alloc_scope::count; ++n)
+      stats.push_back({scope_names[n], counters[n].allocations.load(std::memory_order_relaxed), counters[n].bytes.load(std::memory_order_relaxed)});
+    return stats;
+  }
+
+  std::string get_alloc_metrics_prometheus(const std::string &prefix)
+  {
+    std::string out;
+    const std::vector<alloc_scope_stats> stats = get_alloc_stats();
+    if (stats.empty())
+      return out;
+    out += "# HELP " + prefix + "_allocations_total operator new calls per scope\n";
+    out += "# TYPE " + prefix + "_allocations_total counter\n";
+    for (const auto &s: stats)
+      out += prefix + "_allocations_total{scope=\"" + s.scope + "\"} " + std::to_string(s.allocations) + "\n";
+    out += "# HELP " + prefix + "_allocated_bytes_total bytes asked of operator new per scope\n";
+    out += "# TYPE " + prefix + "_allocated_bytes_total counter\n";
+    for (const auto &s: stats)
+      out += prefix + "_allocated_bytes_total{scope=\"" + s.scope + "\"} " + std::to_string(s.bytes) + "\n";
+    return out;
+  }
+
+  alloc_scope get_alloc_scope()
+  {
+    return current_scope;
+  }
+
+  alloc_scope_guard::alloc_scope_guard(alloc_scope scope): previous(current_scope)
+  {
+    current_scope = scope;
+  }
+
+  alloc_scope_guard::~alloc_scope_guard()
+  {
+    current_scope = previous;
+  }
+}
+
+#ifdef ALLOC_PROFILING
+void *operator new(std::size_t size)
+{
+  tools::record_alloc(size);
+  if (size == 0)
+    size = 1;
+  while (true)
+  {
+    void *ptr = std::malloc(size);
+    if (ptr)
+      return ptr;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+void *operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  try { return ::operator new(size); }
+  catch (...) { return nullptr; }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  try { return ::operator new(size); }
+  catch (...) { return nullptr; }
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
@@ -0,0 +1,96 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tools
+{
+
+//! subsystems allocations are attributed to, see ALLOC_SCOPE
+enum class alloc_scope: uint8_t
+{
+  other = 0,
+  block_validation,
+  tx_pool,
+  rpc,
+  p2p,
+  wallet_scan,
+  count
+};
+
+const char *alloc_scope_name(alloc_scope scope);
+
+struct alloc_scope_stats
+{
+  std::string scope;
+  uint64_t allocations;
+  uint64_t bytes;
+};
+
+//! true when built with ALLOC_PROFILING, the only build that counts anything
+bool is_alloc_profiling_enabled();
+
+/**
+ * @brief returns how many times operator new was called and for how many bytes, per scope
+ *
+ * An allocation counts toward the innermost ALLOC_SCOPE of the thread that
+ * made it, or toward "other" outside any scope.  Jobs handed to the thread
+ * pool keep the scope of the thread that submitted them.
+ */
+std::vector<alloc_scope_stats> get_alloc_stats();
+
+//! renders get_alloc_stats in the Prometheus text format, empty when not profiling
+std::string get_alloc_metrics_prometheus(const std::string &prefix = "antd");
+
+alloc_scope get_alloc_scope();
+
+//! attributes the calling thread's allocations to a scope while it lives
+class alloc_scope_guard
+{
+public:
+  explicit alloc_scope_guard(alloc_scope scope);
+  ~alloc_scope_guard();
+
+private:
+  alloc_scope_guard(const alloc_scope_guard&) = delete;
+  alloc_scope_guard &operator=(const alloc_scope_guard&) = delete;
+
+  alloc_scope previous;
+};
+
+#ifdef ALLOC_PROFILING
+#define ALLOC_SCOPE(name) tools::alloc_scope_guard alloc_scope_##name(tools::alloc_scope::name)
+#else
+#define ALLOC_SCOPE(name) do {} while(0)
+#endif
+
+}
@@ -0,0 +1,156 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace tools
+{
+
+//! Monotonic memory arena for short-lived containers.
+//!
+//! Allocations bump a pointer through a list of chunks and deallocation
+//! is a no-op; reset() drops everything at once. After a reset that
+//! needed several chunks, the next round gets a single chunk of their
+//! combined size, so a steady workload settles on one allocation.
+//! Not thread safe.
+class arena
+{
+public:
+  explicit arena(size_t chunk_size = 64 * 1024): head(NULL), cur(NULL), end(NULL), chunk_size(chunk_size), used(0) {}
+  ~arena() { release(); }
+  arena(const arena&) = delete;
+  arena &operator=(const arena&) = delete;
+
+  void *allocate(size_t size, size_t align)
+  {
+    if (size > SIZE_MAX - sizeof(chunk) - align)
+      throw std::bad_alloc();
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+    if (!cur || p > reinterpret_cast<uintptr_t>(end) || size > reinterpret_cast<uintptr_t>(end) - p)
+    {
+      add_chunk(size + align);
+      p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    cur = reinterpret_cast<char*>(p + size);
+    return reinterpret_cast<void*>(p);
+  }
+
+  //! Frees everything allocated so far; nothing allocated from the arena
+  //! may be used afterwards
+  void reset()
+  {
+    if (head && head->next)
+    {
+      const size_t total = used;
+      release();
+      add_chunk(total);
+    }
+    if (head)
+    {
+      cur = head->data();
+      end = cur + head->size;
+    }
+  }
+
+  //! Total size of the chunks currently held
+  size_t capacity() const { return used; }
+
+private:
+  struct chunk
+  {
+    chunk *next;
+    size_t size;
+    char *data() { return reinterpret_cast<char*>(this + 1); }
+  };
+
+  void add_chunk(size_t min_size)
+  {
+    const size_t size = min_size > chunk_size ? min_size : chunk_size;
+    chunk *c = static_cast<chunk*>(malloc(sizeof(chunk) + size));
+    if (!c)
+      throw std::bad_alloc();
+    c->next = head;
+    c->size = size;
+    head = c;
+    cur = c->data();
+    end = cur + size;
+    used += size;
+  }
+
+  void release()
+  {
+    while (head)
+    {
+      chunk *next = head->next;
+      free(head);
+      head = next;
+    }
+    cur = end = NULL;
+    used = 0;
+  }
+
+  chunk *head;
+  char *cur;
+  char *end;
+  const size_t chunk_size;
+  size_t used;
+};
+
+//! Standard allocator handing out memory from an arena, for containers
+//! that are dropped before the arena is reset
+template<typename T>
+class arena_allocator
+{
+public:
+  typedef T value_type;
+
+  explicit arena_allocator(arena &a): a(&a) {}
+  template<typename U> arena_allocator(const arena_allocator<U> &other): a(other.a) {}
+
+  T *allocate(size_t n)
+  {
+    if (n > SIZE_MAX / sizeof(T))
+      throw std::bad_alloc();
+    return static_cast<T*>(a->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, size_t) {}
+
+  template<typename U> bool operator==(const arena_allocator<U> &other) const { return a == other.a; }
+  template<typename U> bool operator!=(const arena_allocator<U> &other) const { return a != other.a; }
+
+private:
+  template<typename U> friend class arena_allocator;
+  arena *a;
+};
+
+}
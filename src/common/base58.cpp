@@ -31,6 +31,7 @@
 #include "base58.h"
 
 #include <assert.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -50,30 +51,31 @@ namespace tools
       const size_t full_block_size = sizeof(encoded_block_sizes) / sizeof(encoded_block_sizes[0]) - 1;
       const size_t full_encoded_block_size = encoded_block_sizes[full_block_size];
       const size_t addr_checksum_size = 4;
+      const uint64_t base_pow5 = UINT64_C(656356768); // 58^5
 
       struct reverse_alphabet
       {
         reverse_alphabet()
         {
-          m_data.resize(alphabet[alphabet_size - 1] - alphabet[0] + 1, -1);
+          for (size_t i = 0; i < sizeof(m_data); ++i)
+            m_data[i] = -1;
 
           for (size_t i = 0; i < alphabet_size; ++i)
           {
-            size_t idx = static_cast<size_t>(alphabet[i] - alphabet[0]);
+            size_t idx = static_cast<unsigned char>(alphabet[i]);
             m_data[idx] = static_cast<int8_t>(i);
           }
         }
 
         int operator()(char letter) const
         {
-          size_t idx = static_cast<size_t>(letter - alphabet[0]);
-          return idx < m_data.size() ? m_data[idx] : -1;
+          return m_data[static_cast<unsigned char>(letter)];
         }
 
         static reverse_alphabet instance;
 
       private:
-        std::vector<int8_t> m_data;
+        int8_t m_data[256];
       };
 
       reverse_alphabet reverse_alphabet::instance;
@@ -126,11 +128,24 @@ namespace tools
 
         uint64_t num = uint_8be_to_64(reinterpret_cast<const uint8_t*>(block), size);
         int i = static_cast<int>(encoded_block_sizes[size]) - 1;
-        while (0 < num)
+        // 58^5 fits in 32 bits: split off five digits at a time so the
+        // inner divisions are 32 bit
+        while (base_pow5 <= num)
         {
-          uint64_t remainder = num % alphabet_size;
-          num /= alphabet_size;
-          res[i] = alphabet[remainder];
+          uint32_t part = static_cast<uint32_t>(num % base_pow5);
+          num /= base_pow5;
+          for (int j = 0; j < 5; ++j)
+          {
+            res[i] = alphabet[part % alphabet_size];
+            part /= alphabet_size;
+            --i;
+          }
+        }
+        uint32_t part = static_cast<uint32_t>(num);
+        while (0 < part)
+        {
+          res[i] = alphabet[part % alphabet_size];
+          part /= alphabet_size;
           --i;
         }
       }
@@ -144,20 +159,25 @@ namespace tools
           return false; // Invalid block size
 
         uint64_t res_num = 0;
-        uint64_t order = 1;
-        for (size_t i = size - 1; i < size; --i)
+        for (size_t i = 0; i < size; ++i)
         {
           int digit = reverse_alphabet::instance(block[i]);
           if (digit < 0)
             return false; // Invalid symbol
 
-          uint64_t product_hi;
-          uint64_t tmp = res_num + mul128(order, digit, &product_hi);
-          if (tmp < res_num || 0 != product_hi)
-            return false; // Overflow
-
-          res_num = tmp;
-          order *= alphabet_size; // Never overflows, 58^10 < 2^64
+          if (i + 1 < full_encoded_block_size)
+          {
+            res_num = res_num * alphabet_size + digit; // Never overflows, 58^10 < 2^64
+          }
+          else
+          {
+            uint64_t product_hi;
+            uint64_t product_lo = mul128(res_num, alphabet_size, &product_hi);
+            uint64_t tmp = product_lo + digit;
+            if (tmp < product_lo || 0 != product_hi)
+              return false; // Overflow
+            res_num = tmp;
+          }
         }
 
         if (static_cast<size_t>(res_size) < full_block_size && (UINT64_C(1) << (8 * res_size)) <= res_num)
@@ -241,18 +261,14 @@ namespace tools
       if (!r) return false;
       if (addr_data.size() <= addr_checksum_size) return false;
 
-      std::string checksum(addr_checksum_size, '\0');
-      checksum = addr_data.substr(addr_data.size() - addr_checksum_size);
-
-      addr_data.resize(addr_data.size() - addr_checksum_size);
-      crypto::hash hash = crypto::cn_fast_hash(addr_data.data(), addr_data.size());
-      std::string expected_checksum(reinterpret_cast<const char*>(&hash), addr_checksum_size);
-      if (expected_checksum != checksum) return false;
+      const size_t payload_size = addr_data.size() - addr_checksum_size;
+      crypto::hash hash = crypto::cn_fast_hash(addr_data.data(), payload_size);
+      if (memcmp(&hash, addr_data.data() + payload_size, addr_checksum_size)) return false;
 
-      int read = tools::read_varint(addr_data.begin(), addr_data.end(), tag);
+      int read = tools::read_varint(addr_data.begin(), addr_data.begin() + payload_size, tag);
       if (read <= 0) return false;
 
-      data = addr_data.substr(read);
+      data.assign(addr_data, read, payload_size - read);
       return true;
     }
   }
@@ -34,6 +34,8 @@
 #include <stdlib.h>
 #include "include_base_utils.h"
 #include <random>
+#include <map>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -55,6 +57,11 @@ static const char *DEFAULT_DNS_PUBLIC_ADDR[] =
 
 static boost::mutex instance_lock;
 
+// answers are reused for their TTL, capped so a long TTL can't pin a stale update or alias record
+static const int DNS_CACHE_MAX_TTL = 3600;
+// load_txt_records_from_dns gives up on domains that have not answered by then
+static const boost::posix_time::seconds DNS_QUERY_DEADLINE(20);
+
 namespace
 {
 
@@ -220,6 +227,16 @@ typedef class scoped_ptr<ub_result,ub_resolve_free> ub_result_ptr;
 struct DNSResolverData
 {
   ub_ctx* m_ub_context;
+
+  struct cached_record
+  {
+    std::vector<std::string> records;
+    bool dnssec_available;
+    bool dnssec_valid;
+    time_t expiry;
+  };
+  boost::mutex m_cache_lock;
+  std::map<std::pair<std::string, int>, cached_record> m_cache;
 };
 
 // work around for bug https://www.nlnetlabs.nl/bugs-script/show_bug.cgi?id=515 needed for it to compile on e.g. Debian 7
@@ -298,6 +315,23 @@ std::vector<std::string> DNSResolver::get_record(const std::string& url, int rec
     return addresses;
   }
 
+  const std::pair<std::string, int> cache_key(url, record_type);
+  {
+    boost::lock_guard<boost::mutex> lock(m_data->m_cache_lock);
+    const auto i = m_data->m_cache.find(cache_key);
+    if (i != m_data->m_cache.end())
+    {
+      if (i->second.expiry > time(NULL))
+      {
+        MDEBUG("Using cached " << get_record_name(record_type) << " record for " << url);
+        dnssec_available = i->second.dnssec_available;
+        dnssec_valid = i->second.dnssec_valid;
+        return i->second.records;
+      }
+      m_data->m_cache.erase(i);
+    }
+  }
+
   // destructor takes care of cleanup
   ub_result_ptr result;
 
@@ -318,6 +352,14 @@ std::vector<std::string> DNSResolver::get_record(const std::string& url, int rec
         }
       }
     }
+
+    // failed lookups are not cached, they are retried on the next call
+    const int ttl = std::min(result->ttl, DNS_CACHE_MAX_TTL);
+    if (ttl > 0)
+    {
+      boost::lock_guard<boost::mutex> lock(m_data->m_cache_lock);
+      m_data->m_cache[cache_key] = {addresses, dnssec_available, dnssec_valid, time(NULL) + ttl};
+    }
   }
 
   return addresses;
@@ -488,25 +530,68 @@ bool load_txt_records_from_dns(std::vector<std::string> &good_records, const std
   // Prevent infinite recursion when distributing
   if (dns_urls.empty()) return false;
 
-  std::vector<std::vector<std::string> > records;
-  records.resize(dns_urls.size());
-
   std::random_device rd;
   std::mt19937 gen(rd());
   std::uniform_int_distribution<int> dis(0, dns_urls.size() - 1);
   size_t first_index = dis(gen);
 
-  // send all requests in parallel
-  std::vector<boost::thread> threads(dns_urls.size());
-  std::deque<bool> avail(dns_urls.size(), false), valid(dns_urls.size(), false);
+  // send all requests in parallel; the lookups share their results through a refcounted
+  // state so that queries still hanging at the deadline can be left behind safely
+  struct lookup_state
+  {
+    boost::mutex lock;
+    boost::condition_variable cond;
+    size_t pending;
+    std::vector<std::vector<std::string>> records;
+    std::deque<bool> avail, valid, done;
+  };
+  const auto state = std::make_shared<lookup_state>();
+  state->pending = dns_urls.size();
+  state->records.resize(dns_urls.size());
+  state->avail.resize(dns_urls.size(), false);
+  state->valid.resize(dns_urls.size(), false);
+  state->done.resize(dns_urls.size(), false);
   for (size_t n = 0; n < dns_urls.size(); ++n)
   {
-    threads[n] = boost::thread([n, dns_urls, &records, &avail, &valid](){
-      records[n] = tools::DNSResolver::instance().get_txt_record(dns_urls[n], avail[n], valid[n]); 
-    });
+    const std::string url = dns_urls[n];
+    boost::thread([n, state, url](){
+      bool avail = false, valid = false;
+      std::vector<std::string> records = tools::DNSResolver::instance().get_txt_record(url, avail, valid);
+      boost::lock_guard<boost::mutex> lock(state->lock);
+      state->records[n] = std::move(records);
+      state->avail[n] = avail;
+      state->valid[n] = valid;
+      state->done[n] = true;
+      --state->pending;
+      state->cond.notify_all();
+    }).detach();
+  }
+
+  std::vector<std::vector<std::string> > records;
+  std::deque<bool> avail, valid;
+  {
+    boost::unique_lock<boost::mutex> lock(state->lock);
+    const boost::system_time deadline = boost::get_system_time() + DNS_QUERY_DEADLINE;
+    while (state->pending > 0)
+    {
+      if (!state->cond.timed_wait(lock, deadline))
+      {
+        MWARNING(state->pending << " of " << dns_urls.size() << " DNS lookups did not answer in time, ignoring them");
+        break;
+      }
+    }
+    records = state->records;
+    avail = state->avail;
+    valid = state->valid;
+    for (size_t n = 0; n < dns_urls.size(); ++n)
+    {
+      if (!state->done[n])
+      {
+        records[n].clear();
+        avail[n] = valid[n] = false;
+      }
+    }
   }
-  for (size_t n = 0; n < dns_urls.size(); ++n)
-    threads[n].join();
 
   size_t cur_index = first_index;
   do
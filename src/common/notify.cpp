@@ -26,6 +26,7 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <stdarg.h>
 #include "misc_log_ex.h"
@@ -44,7 +45,10 @@ namespace tools
   - Improve tokenization to handle paths containing whitespaces, quotes, etc.
   - Windows unicode support (implies implementing unicode command line parsing code)
 */
-Notify::Notify(const char *spec)
+Notify::Notify(const char *spec, size_t max_pending):
+  m_max_pending(std::max<size_t>(max_pending, 1)),
+  m_dropped(0),
+  m_stop(false)
 {
   CHECK_AND_ASSERT_THROW_MES(spec, "Null spec");
 
@@ -56,6 +60,45 @@ Notify::Notify(const char *spec)
   CHECK_AND_ASSERT_THROW_MES(epee::file_io_utils::is_file_exist(filename), "File not found: " << filename);
 }
 
+Notify::~Notify()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stop = true;
+    if (!m_pending.empty())
+      MDEBUG("Dropping " << m_pending.size() << " pending notifications for " << filename);
+    m_pending.clear();
+  }
+  m_cond.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void Notify::run()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  while (true)
+  {
+    while (!m_stop && m_pending.empty())
+      m_cond.wait(lock);
+    if (m_stop)
+      return;
+
+    std::vector<std::string> margs = std::move(m_pending.front());
+    m_pending.pop_front();
+    const size_t dropped = m_dropped;
+    m_dropped = 0;
+
+    lock.unlock();
+    if (dropped)
+      MWARNING(dropped << " notifications for " << filename << " were dropped, the command is not keeping up");
+    const int ret = tools::spawn(filename.c_str(), margs, true);
+    if (ret != 0)
+      MDEBUG(filename << " exited with " << ret);
+    lock.lock();
+  }
+}
+
 static void replace(std::vector<std::string> &v, const char *tag, const char *s)
 {
   for (std::string &str: v)
@@ -77,7 +120,24 @@ int Notify::notify(const char *tag, const char *s, ...)
   }
   va_end(ap);
 
-  return tools::spawn(filename.c_str(), margs, false);
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_stop)
+      return -1;
+    for (const std::vector<std::string> &pending: m_pending)
+      if (pending == margs)
+        return 0;
+    if (m_pending.size() >= m_max_pending)
+    {
+      m_pending.pop_front();
+      ++m_dropped;
+    }
+    m_pending.push_back(std::move(margs));
+    if (!m_thread.joinable())
+      m_thread = boost::thread([this](){ run(); });
+  }
+  m_cond.notify_one();
+  return 0;
 }
 
 }
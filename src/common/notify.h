@@ -28,22 +28,44 @@
 
 #pragma once 
 
+#include <deque>
 #include <string>
 #include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 namespace tools
 {
 
+/*! \brief runs a user command on events, off the caller's thread
+ *
+ * notify() only queues the command line; one worker thread per Notify
+ * runs the commands in order and waits for each, so at most one child
+ * process is alive per hook. Identical pending events are merged, and
+ * once max_pending are queued the oldest is dropped.
+ */
 class Notify
 {
 public:
-  Notify(const char *spec);
+  Notify(const char *spec, size_t max_pending = 100);
+  ~Notify();
 
   int notify(const char *tag, const char *s, ...);
 
 private:
+  void run();
+
   std::string filename;
   std::vector<std::string> args;
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+  std::deque<std::vector<std::string>> m_pending;
+  size_t m_max_pending;
+  size_t m_dropped;
+  bool m_stop;
+  boost::thread m_thread;
 };
 
 }
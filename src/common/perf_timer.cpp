@@ -26,6 +26,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "misc_os_dependent.h"
 #include "perf_timer.h"
@@ -87,6 +91,431 @@ namespace tools
 
 namespace tools
 {
+  namespace
+  {
+    constexpr size_t MAX_PERF_METRICS = 1024;
+    // log-linear buckets: 4 per power of two of nanoseconds (<= 25% error),
+    // up to 2^40 ns (~18 minutes), longer times land in the last bucket
+    constexpr unsigned PERF_HISTO_SUB_BITS = 2;
+    constexpr unsigned PERF_HISTO_SUBS = 1 << PERF_HISTO_SUB_BITS;
+    constexpr unsigned PERF_HISTO_MAX_MAG = 40;
+    constexpr size_t PERF_HISTO_BUCKETS = PERF_HISTO_SUBS + (PERF_HISTO_MAX_MAG - PERF_HISTO_SUB_BITS + 1) * PERF_HISTO_SUBS;
+  }
+
+  size_t perf_histo_bucket(uint64_t ns)
+  {
+    if (ns < PERF_HISTO_SUBS)
+      return ns;
+    const unsigned mag = 63 - __builtin_clzll(ns);
+    if (mag > PERF_HISTO_MAX_MAG)
+      return PERF_HISTO_BUCKETS - 1;
+    return PERF_HISTO_SUBS + (mag - PERF_HISTO_SUB_BITS) * PERF_HISTO_SUBS + ((ns >> (mag - PERF_HISTO_SUB_BITS)) & (PERF_HISTO_SUBS - 1));
+  }
+
+  uint64_t perf_histo_bucket_end(size_t b)
+  {
+    if (b < PERF_HISTO_SUBS)
+      return b + 1;
+    const unsigned mag = (b - PERF_HISTO_SUBS) / PERF_HISTO_SUBS + PERF_HISTO_SUB_BITS;
+    const unsigned sub = (b - PERF_HISTO_SUBS) % PERF_HISTO_SUBS;
+    return (uint64_t)(PERF_HISTO_SUBS + sub + 1) << (mag - PERF_HISTO_SUB_BITS);
+  }
+
+  size_t perf_histo_bucket_count()
+  {
+    return PERF_HISTO_BUCKETS;
+  }
+
+  namespace
+  {
+    // written by its owning thread only, read concurrently when scraped
+    struct perf_histogram
+    {
+      std::atomic<uint64_t> buckets[PERF_HISTO_BUCKETS];
+      std::atomic<uint64_t> count;
+      std::atomic<uint64_t> sum_ns;
+
+      perf_histogram(): count(0), sum_ns(0) { for (auto &b: buckets) b.store(0, std::memory_order_relaxed); }
+
+      static void bump(std::atomic<uint64_t> &v, uint64_t n) { v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+      void add(uint64_t ns)
+      {
+        bump(buckets[perf_histo_bucket(ns)], 1);
+        bump(sum_ns, ns);
+        bump(count, 1);
+      }
+
+      void merge_into(std::vector<uint64_t> &b, uint64_t &c, uint64_t &sum) const
+      {
+        for (size_t i = 0; i < PERF_HISTO_BUCKETS; ++i)
+          b[i] += buckets[i].load(std::memory_order_relaxed);
+        c += count.load(std::memory_order_relaxed);
+        sum += sum_ns.load(std::memory_order_relaxed);
+      }
+    };
+
+    struct perf_shard
+    {
+      std::atomic<perf_histogram*> histograms[MAX_PERF_METRICS];
+      perf_shard() { for (auto &h: histograms) h.store(nullptr, std::memory_order_relaxed); }
+      ~perf_shard() { for (auto &h: histograms) delete h.load(std::memory_order_relaxed); }
+    };
+
+    struct perf_metric
+    {
+      std::string name;
+      std::atomic<int64_t> in_flight;
+      explicit perf_metric(const std::string &name): name(name), in_flight(0) {}
+    };
+
+    struct perf_registry
+    {
+      std::mutex mutex;
+      std::unordered_map<std::string, size_t> ids;
+      perf_metric *metrics[MAX_PERF_METRICS];
+      std::atomic<size_t> count{0};
+      std::vector<perf_shard*> live_shards;
+      // totals of threads that have exited, guarded by mutex
+      std::vector<std::vector<uint64_t>> retired_buckets;
+      std::vector<uint64_t> retired_count, retired_sum_ns;
+
+      perf_registry(): retired_buckets(MAX_PERF_METRICS), retired_count(MAX_PERF_METRICS, 0), retired_sum_ns(MAX_PERF_METRICS, 0) {}
+    };
+
+    perf_registry &get_perf_registry()
+    {
+      // never destroyed: timers may still run while static destructors do
+      static perf_registry *registry = new perf_registry();
+      return *registry;
+    }
+
+    struct perf_thread_shard
+    {
+      perf_shard *shard;
+      perf_thread_shard(): shard(new perf_shard())
+      {
+        perf_registry &r = get_perf_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live_shards.push_back(shard);
+      }
+      ~perf_thread_shard()
+      {
+        perf_registry &r = get_perf_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        const size_t count = r.count.load(std::memory_order_acquire);
+        for (size_t id = 0; id < count; ++id)
+        {
+          const perf_histogram *h = shard->histograms[id].load(std::memory_order_relaxed);
+          if (!h)
+            continue;
+          std::vector<uint64_t> &b = r.retired_buckets[id];
+          if (b.empty())
+            b.resize(PERF_HISTO_BUCKETS, 0);
+          h->merge_into(b, r.retired_count[id], r.retired_sum_ns[id]);
+        }
+        r.live_shards.erase(std::remove(r.live_shards.begin(), r.live_shards.end(), shard), r.live_shards.end());
+        delete shard;
+      }
+    };
+
+    void record_perf_metric(size_t id, uint64_t ns)
+    {
+      static thread_local perf_thread_shard local;
+      perf_histogram *h = local.shard->histograms[id].load(std::memory_order_relaxed);
+      if (!h)
+      {
+        h = new perf_histogram();
+        local.shard->histograms[id].store(h, std::memory_order_release);
+      }
+      h->add(ns);
+    }
+
+    // a trace event; times are ticks since the trace was started
+    struct perf_trace_event
+    {
+      size_t metric;
+      uint64_t start;
+      uint64_t duration;
+    };
+
+    struct perf_trace_buffer
+    {
+      // only contended while a trace is being dumped
+      std::mutex mutex;
+      unsigned tid;
+      uint64_t generation;
+      std::vector<perf_trace_event> events;
+      size_t written;
+      explicit perf_trace_buffer(unsigned tid): tid(tid), generation(0), written(0) {}
+    };
+
+    struct perf_tracer
+    {
+      std::mutex mutex;
+      std::atomic<bool> enabled{false};
+      // bumped on every start, buffers of an older generation are cleared before use
+      std::atomic<uint64_t> generation{0};
+      std::atomic<uint64_t> epoch{0};
+      std::atomic<size_t> capacity{0};
+      unsigned next_tid = 0;
+      // kept past their thread's exit, so a dump also shows threads that are gone
+      std::vector<std::shared_ptr<perf_trace_buffer>> buffers;
+    };
+
+    perf_tracer &get_perf_tracer()
+    {
+      static perf_tracer *tracer = new perf_tracer();
+      return *tracer;
+    }
+
+    struct perf_thread_trace
+    {
+      std::shared_ptr<perf_trace_buffer> buffer;
+      perf_thread_trace()
+      {
+        perf_tracer &t = get_perf_tracer();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        buffer = std::make_shared<perf_trace_buffer>(++t.next_tid);
+        t.buffers.push_back(buffer);
+      }
+    };
+
+    void record_perf_trace(size_t metric, uint64_t start, uint64_t end)
+    {
+      static thread_local perf_thread_trace local;
+      perf_tracer &t = get_perf_tracer();
+      perf_trace_buffer &b = *local.buffer;
+      const uint64_t generation = t.generation.load(std::memory_order_acquire);
+      const uint64_t epoch = t.epoch.load(std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(b.mutex);
+      if (b.generation != generation)
+      {
+        b.events.assign(t.capacity.load(std::memory_order_relaxed), perf_trace_event());
+        b.written = 0;
+        b.generation = generation;
+      }
+      // scopes that started before the trace did are not recorded
+      if (start < epoch || b.events.empty())
+        return;
+      b.events[b.written++ % b.events.size()] = {metric, start - epoch, end - start};
+    }
+
+    void write_json_string(std::string &out, const std::string &s)
+    {
+      out += '"';
+      for (char c: s)
+      {
+        if (c == '"' || c == '\\')
+          out += '\\';
+        if ((unsigned char)c >= 0x20)
+          out += c;
+      }
+      out += '"';
+    }
+
+    void write_microseconds(std::string &out, uint64_t ticks)
+    {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.3f", ticks_to_ns(ticks) / 1e3);
+      out += buf;
+    }
+
+    void write_seconds(std::string &out, uint64_t ns)
+    {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.9g", ns / 1e9);
+      out += buf;
+    }
+  }
+
+  size_t register_perf_metric(const char *name)
+  {
+    perf_registry &r = get_perf_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = r.ids.find(name);
+    if (it != r.ids.end())
+      return it->second;
+    const size_t id = r.count.load(std::memory_order_relaxed);
+    if (id >= MAX_PERF_METRICS)
+    {
+      MWARNING("Too many performance metrics, not recording " << name);
+      return NO_PERF_METRIC;
+    }
+    r.metrics[id] = new perf_metric(name);
+    r.ids.emplace(name, id);
+    r.count.store(id + 1, std::memory_order_release);
+    return id;
+  }
+
+  void record_perf_duration(size_t metric, uint64_t ns)
+  {
+    if (metric != NO_PERF_METRIC)
+      record_perf_metric(metric, ns);
+  }
+
+  std::string get_perf_metrics_prometheus(const std::string &prefix)
+  {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    const std::string histo = prefix + "_perf_timer_seconds";
+    const std::string in_flight = prefix + "_perf_timer_in_flight";
+    const std::string quantile = prefix + "_perf_timer_quantile_seconds";
+    std::string hist_out, in_flight_out, quantile_out;
+
+    perf_registry &r = get_perf_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    const size_t count = r.count.load(std::memory_order_acquire);
+    std::vector<uint64_t> buckets(PERF_HISTO_BUCKETS);
+    for (size_t id = 0; id < count; ++id)
+    {
+      const perf_metric &m = *r.metrics[id];
+      std::fill(buckets.begin(), buckets.end(), 0);
+      uint64_t n = 0, sum_ns = 0;
+      for (const perf_shard *shard: r.live_shards)
+        if (const perf_histogram *h = shard->histograms[id].load(std::memory_order_acquire))
+          h->merge_into(buckets, n, sum_ns);
+      if (!r.retired_buckets[id].empty())
+      {
+        for (size_t b = 0; b < PERF_HISTO_BUCKETS; ++b)
+          buckets[b] += r.retired_buckets[id][b];
+        n += r.retired_count[id];
+        sum_ns += r.retired_sum_ns[id];
+      }
+      const int64_t running = m.in_flight.load(std::memory_order_relaxed);
+      if (n == 0 && running == 0)
+        continue;
+
+      const std::string label = "timer=\"" + m.name + "\"";
+      in_flight_out += in_flight + "{" + label + "} " + std::to_string(running) + "\n";
+
+      // exported at powers of two from ~1us to ~69s, which bucket ends align with
+      uint64_t cumulative = 0;
+      size_t b = 0;
+      for (unsigned mag = 10; mag <= 36; ++mag)
+      {
+        const uint64_t le = (uint64_t)1 << mag;
+        for (; b < PERF_HISTO_BUCKETS && perf_histo_bucket_end(b) <= le; ++b)
+          cumulative += buckets[b];
+        hist_out += histo + "_bucket{" + label + ",le=\"";
+        write_seconds(hist_out, le);
+        hist_out += "\"} " + std::to_string(cumulative) + "\n";
+      }
+      hist_out += histo + "_bucket{" + label + ",le=\"+Inf\"} " + std::to_string(n) + "\n";
+      hist_out += histo + "_sum{" + label + "} ";
+      write_seconds(hist_out, sum_ns);
+      hist_out += "\n" + histo + "_count{" + label + "} " + std::to_string(n) + "\n";
+
+      if (n == 0)
+        continue;
+      for (double q: quantiles)
+      {
+        const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * n + 0.5));
+        uint64_t seen = 0;
+        size_t qb = 0;
+        for (; qb < PERF_HISTO_BUCKETS - 1; ++qb)
+          if ((seen += buckets[qb]) >= rank)
+            break;
+        char qs[16];
+        snprintf(qs, sizeof(qs), "%g", q);
+        quantile_out += quantile + "{" + label + ",quantile=\"" + qs + "\"} ";
+        write_seconds(quantile_out, perf_histo_bucket_end(qb));
+        quantile_out += "\n";
+      }
+    }
+
+    std::string out;
+    out += "# HELP " + histo + " Time spent in PERF_TIMER scopes\n# TYPE " + histo + " histogram\n" + hist_out;
+    out += "# HELP " + in_flight + " PERF_TIMER scopes currently running\n# TYPE " + in_flight + " gauge\n" + in_flight_out;
+    out += "# HELP " + quantile + " Upper bound of the PERF_TIMER latency quantile since start\n# TYPE " + quantile + " gauge\n" + quantile_out;
+    return out;
+  }
+
+  std::vector<perf_metric_total> get_perf_metric_totals()
+  {
+    perf_registry &r = get_perf_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    const size_t count = r.count.load(std::memory_order_acquire);
+    std::vector<perf_metric_total> totals;
+    totals.reserve(count);
+    for (size_t id = 0; id < count; ++id)
+    {
+      uint64_t n = r.retired_count[id], sum_ns = r.retired_sum_ns[id];
+      for (const perf_shard *shard: r.live_shards)
+      {
+        if (const perf_histogram *h = shard->histograms[id].load(std::memory_order_acquire))
+        {
+          n += h->count.load(std::memory_order_relaxed);
+          sum_ns += h->sum_ns.load(std::memory_order_relaxed);
+        }
+      }
+      totals.push_back({r.metrics[id]->name, n, sum_ns});
+    }
+    return totals;
+  }
+
+  void set_perf_trace(bool enabled, size_t events_per_thread)
+  {
+    perf_tracer &t = get_perf_tracer();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    if (enabled)
+    {
+      // buffers nobody else holds belong to threads that have exited
+      t.buffers.erase(std::remove_if(t.buffers.begin(), t.buffers.end(),
+          [](const std::shared_ptr<perf_trace_buffer> &b) { return b.use_count() == 1; }), t.buffers.end());
+      t.capacity.store(events_per_thread, std::memory_order_relaxed);
+      t.epoch.store(get_tick_count(), std::memory_order_relaxed);
+      t.generation.fetch_add(1, std::memory_order_release);
+    }
+    t.enabled.store(enabled, std::memory_order_release);
+  }
+
+  bool is_perf_trace_enabled()
+  {
+    return get_perf_tracer().enabled.load(std::memory_order_relaxed);
+  }
+
+  std::string get_perf_trace_json()
+  {
+    std::vector<std::string> names;
+    {
+      perf_registry &r = get_perf_registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      const size_t count = r.count.load(std::memory_order_acquire);
+      for (size_t id = 0; id < count; ++id)
+        names.push_back(r.metrics[id]->name);
+    }
+
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    perf_tracer &t = get_perf_tracer();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    const uint64_t generation = t.generation.load(std::memory_order_relaxed);
+    for (const auto &buffer: t.buffers)
+    {
+      perf_trace_buffer &b = *buffer;
+      std::lock_guard<std::mutex> buffer_lock(b.mutex);
+      if (b.generation != generation || b.written == 0)
+        continue;
+      const size_t n = std::min(b.written, b.events.size());
+      for (size_t i = b.written - n; i < b.written; ++i)
+      {
+        const perf_trace_event &e = b.events[i % b.events.size()];
+        if (e.metric >= names.size())
+          continue;
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"name\":";
+        write_json_string(out, names[e.metric]);
+        out += ",\"cat\":\"perf\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(b.tid) + ",\"ts\":";
+        write_microseconds(out, e.start);
+        out += ",\"dur\":";
+        write_microseconds(out, e.duration);
+        out += "}";
+      }
+    }
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out;
+  }
 
 el::Level performance_timer_log_level = el::Level::Info;
 
@@ -111,8 +540,14 @@ PerformanceTimer::PerformanceTimer(bool paused): started(true), paused(paused)
     ticks = get_tick_count();
 }
 
-LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l)
+LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l, size_t metric): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l), metric(metric), trace_start(0)
 {
+  if (metric != NO_PERF_METRIC)
+  {
+    get_perf_registry().metrics[metric]->in_flight.fetch_add(1, std::memory_order_relaxed);
+    if (is_perf_trace_enabled())
+      trace_start = get_tick_count();
+  }
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (!performance_timers)
   {
@@ -146,6 +581,13 @@ PerformanceTimer::~PerformanceTimer()
 LoggingPerformanceTimer::~LoggingPerformanceTimer()
 {
   pause();
+  if (metric != NO_PERF_METRIC)
+  {
+    record_perf_metric(metric, ticks_to_ns(ticks));
+    get_perf_registry().metrics[metric]->in_flight.fetch_sub(1, std::memory_order_relaxed);
+    if (trace_start && is_perf_trace_enabled())
+      record_perf_trace(metric, trace_start, get_tick_count());
+  }
   performance_timers->pop_back();
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (log)
@@ -32,6 +32,7 @@
 #include <string>
 #include <stdio.h>
 #include <memory>
+#include <vector>
 #include "misc_log_ex.h"
 
 namespace tools
@@ -45,6 +46,54 @@ uint64_t get_tick_count();
 uint64_t get_ticks_per_ns();
 uint64_t ticks_to_ns(uint64_t ticks);
 
+//! metric id of timers that only log
+static constexpr size_t NO_PERF_METRIC = (size_t)-1;
+
+/**
+ * @brief returns the metric id for a timer name, registering it if needed
+ *
+ * Every timer with a metric id feeds an always-on latency histogram and an
+ * in-flight gauge, whatever the log level.  Histograms are kept per thread
+ * and merged when scraped.  Returns NO_PERF_METRIC once the registry is full.
+ */
+size_t register_perf_metric(const char *name);
+
+//! records a duration for a metric id, as a timer scope ending does
+void record_perf_duration(size_t metric, uint64_t ns);
+
+//! log-linear histogram layout: the bucket a duration lands in, the
+//! exclusive upper bound of a bucket in ns, and the number of buckets
+size_t perf_histo_bucket(uint64_t ns);
+uint64_t perf_histo_bucket_end(size_t b);
+size_t perf_histo_bucket_count();
+
+//! renders all timer histograms, in-flight gauges and quantiles in the Prometheus text format
+std::string get_perf_metrics_prometheus(const std::string &prefix = "antd");
+
+struct perf_metric_total
+{
+  std::string name;
+  uint64_t count;
+  uint64_t total_ns;
+};
+
+//! returns how many times each registered timer ran and for how long in total, over all threads
+std::vector<perf_metric_total> get_perf_metric_totals();
+
+/**
+ * @brief starts or stops recording timer scopes for get_perf_trace_json
+ *
+ * While enabled, every timer with a metric id also records when it started
+ * and how long it ran into a ring buffer of its thread, which keeps the
+ * last events_per_thread scopes.  Starting drops anything recorded before,
+ * stopping keeps it for dumping.
+ */
+void set_perf_trace(bool enabled, size_t events_per_thread = 16384);
+bool is_perf_trace_enabled();
+
+//! renders the recorded scopes in the Chrome trace event JSON format, which Perfetto also reads
+std::string get_perf_trace_json();
+
 class PerformanceTimer
 {
 public:
@@ -65,7 +114,7 @@ protected:
 class LoggingPerformanceTimer: public PerformanceTimer
 {
 public:
-  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info);
+  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info, size_t metric = NO_PERF_METRIC);
   ~LoggingPerformanceTimer();
 
 private:
@@ -73,15 +122,19 @@ private:
   std::string cat;
   uint64_t unit;
   el::Level level;
+  size_t metric;
+  uint64_t trace_start;
 };
 
 void set_performance_timer_log_level(el::Level level);
 
-#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer pt_##name(#name, "perf." ANTD_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level)
-#define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer pt_##name(#name, "perf." ANTD_DEFAULT_LOG_CATEGORY, unit, l)
+// registers the timer name once per call site
+#define PERF_TIMER_METRIC(name) ([]() { static const size_t id = tools::register_perf_metric(#name); return id; }())
+#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer pt_##name(#name, "perf." ANTD_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level, PERF_TIMER_METRIC(name))
+#define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer pt_##name(#name, "perf." ANTD_DEFAULT_LOG_CATEGORY, unit, l, PERF_TIMER_METRIC(name))
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000000, l)
-#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> pt_##name(new tools::LoggingPerformanceTimer(#name, "perf." ANTD_DEFAULT_LOG_CATEGORY, unit, el::Level::Info))
+#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> pt_##name(new tools::LoggingPerformanceTimer(#name, "perf." ANTD_DEFAULT_LOG_CATEGORY, unit, el::Level::Info, PERF_TIMER_METRIC(name)))
 #define PERF_TIMER_START(name) PERF_TIMER_START_UNIT(name, 1000000)
 #define PERF_TIMER_STOP(name) do { pt_##name.reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) pt_##name->pause()
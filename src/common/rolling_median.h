@@ -0,0 +1,130 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <set>
+
+namespace tools
+{
+
+//! Median of the last N values inserted.
+//!
+//! Values are split between a lower and an upper multiset whose sizes
+//! differ by at most one, so inserting (and evicting the oldest value once
+//! full) is O(log N) and the median is read off their boundary. median()
+//! rounds like epee::misc_utils::median.
+template<typename T>
+class rolling_median
+{
+public:
+  explicit rolling_median(size_t capacity = 0): m_capacity(capacity) {}
+
+  //! Drops all values and sets the window size
+  void reset(size_t capacity)
+  {
+    clear();
+    m_capacity = capacity;
+  }
+
+  void clear()
+  {
+    m_values.clear();
+    m_low.clear();
+    m_high.clear();
+  }
+
+  //! Adds a value, evicting the oldest one if the window is full
+  void insert(const T &value)
+  {
+    if (m_capacity == 0)
+      return;
+    if (m_values.size() == m_capacity)
+    {
+      erase(m_values.front());
+      m_values.pop_front();
+    }
+    m_values.push_back(value);
+    if (m_low.empty() || !(*m_low.rbegin() < value))
+      m_low.insert(value);
+    else
+      m_high.insert(value);
+    rebalance();
+  }
+
+  //! Median of the values in the window, or T() if there are none
+  T median() const
+  {
+    if (m_values.empty())
+      return T();
+    if (m_low.size() > m_high.size())
+      return *m_low.rbegin();
+    return (*m_low.rbegin() + *m_high.begin()) / 2;
+  }
+
+  size_t size() const { return m_values.size(); }
+  size_t capacity() const { return m_capacity; }
+  bool full() const { return m_values.size() == m_capacity; }
+
+private:
+  void erase(const T &value)
+  {
+    // anything not above the lower half's maximum has a copy there
+    if (!(*m_low.rbegin() < value))
+      m_low.erase(m_low.find(value));
+    else
+      m_high.erase(m_high.find(value));
+    rebalance();
+  }
+
+  void rebalance()
+  {
+    while (m_low.size() > m_high.size() + 1)
+    {
+      const auto it = std::prev(m_low.end());
+      m_high.insert(*it);
+      m_low.erase(it);
+    }
+    while (m_high.size() > m_low.size())
+    {
+      const auto it = m_high.begin();
+      m_low.insert(*it);
+      m_high.erase(it);
+    }
+  }
+
+  size_t m_capacity;
+  std::deque<T> m_values; // in insertion order
+  std::multiset<T> m_low;
+  std::multiset<T> m_high;
+};
+
+}
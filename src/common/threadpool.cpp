@@ -27,16 +27,24 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "misc_log_ex.h"
 #include "common/threadpool.h"
+#include "common/alloc_profiler.h"
 
 #include "cryptonote_config.h"
 #include "common/util.h"
 
 static __thread int depth = 0;
 static __thread bool is_leaf = false;
+// set on pool workers, so their submits go to their own deque
+static __thread const tools::threadpool *worker_pool = NULL;
+static __thread size_t worker_index = 0;
+// waiter of the job running on this thread, parent of waiters made by it
+static __thread tools::threadpool::waiter *current_waiter = NULL;
+
+static std::atomic<uint64_t> next_waiter_id(1);
 
 namespace tools
 {
-threadpool::threadpool(unsigned int max_threads) {
+threadpool::threadpool(unsigned int max_threads) : pending(0), next_queue(0), sleeping(0), active(0), max(0), running(false) {
   start(max_threads);
 }
 
@@ -45,17 +53,16 @@ threadpool::~threadpool() {
 }
 
 void threadpool::stop() {
+  running = false;
   try
   {
     const boost::unique_lock<boost::mutex> lock(mutex);
-    running = false;
     has_work.notify_all();
   }
   catch (...)
   {
     // if the lock throws, we're just do it without a lock and hope,
     // since the alternative is terminate
-    running = false;
     has_work.notify_all();
   }
   for (size_t i = 0; i<threads.size(); i++) {
@@ -63,7 +70,12 @@ void threadpool::stop() {
     catch (...) { /* ignore */ }
   }
   threads.clear();
-  queue.clear();
+  for (auto &q: queues)
+  {
+    q->entries.clear();
+    q->size = 0;
+  }
+  pending = 0;
 }
 
 void threadpool::start(unsigned int max_threads) {
@@ -72,39 +84,153 @@ void threadpool::start(unsigned int max_threads) {
   boost::thread::attributes attrs;
   attrs.set_stack_size(THREAD_STACK_SIZE);
   max = max_threads ? max_threads : tools::get_max_concurrency();
-  size_t i = max ? max - 1 : 0;
+  // one deque per worker, plus one only fed from outside the pool
+  queues.clear();
+  for (size_t i = 0; i < std::max(max, 1u); ++i)
+    queues.emplace_back(new job_queue());
+  // the thread waiting on its jobs makes up the last one, but keep at least
+  // one worker so jobs nobody waits on, or waited on by another thread, run
+  size_t i = max > 1 ? max - 1 : 1;
   while(i--) {
-    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, false)));
+    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, i)));
   }
 }
 
 void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
   CHECK_AND_ASSERT_THROW_MES(!is_leaf, "A leaf routine is using a thread pool");
-  boost::unique_lock<boost::mutex> lock(mutex);
-  if (!leaf && ((active == max && !queue.empty()) || depth > 0)) {
+#ifdef ALLOC_PROFILING
+  // the job's allocations count toward the submitter's scope
+  const alloc_scope scope = get_alloc_scope();
+  if (scope != alloc_scope::other)
+  {
+    std::function<void()> job = std::move(f);
+    f = [scope, job]() { alloc_scope_guard guard(scope); job(); };
+  }
+#endif
+  if (!leaf && active == max && pending > 0) {
     // if all available threads are already running
     // and there's work waiting, just run in current thread
-    lock.unlock();
+    waiter *const outer = current_waiter;
+    current_waiter = obj;
     ++depth;
-    is_leaf = leaf;
     f();
     --depth;
-    is_leaf = false;
+    current_waiter = outer;
   } else {
     if (obj)
       obj->inc();
-    if (leaf)
-      queue.push_front({obj, f, leaf});
-    else
-      queue.push_back({obj, f, leaf});
+    push({obj, std::move(f), leaf});
+    if (obj)
+      obj->wake();
+  }
+}
+
+void threadpool::push(entry &&e) {
+  const size_t index = worker_pool == this ? worker_index : next_queue++ % queues.size();
+  job_queue &q = *queues[index];
+  {
+    const boost::unique_lock<boost::mutex> lock(q.mutex);
+    // counted before it's visible, so pending never undercounts
+    ++pending;
+    q.entries.push_back(std::move(e));
+    ++q.size;
+  }
+  if (sleeping > 0)
+  {
+    const boost::unique_lock<boost::mutex> lock(mutex);
     has_work.notify_one();
   }
 }
 
+bool threadpool::pop(entry &e, const waiter *subtree) {
+  if (pending == 0)
+    return false;
+  const bool own = worker_pool == this;
+  const size_t n = queues.size();
+  const size_t first = own ? worker_index : next_queue % n;
+  const auto wanted = [subtree](const entry &e) { return !subtree || (e.wo && e.wo->in_subtree_of(subtree)); };
+  for (size_t i = 0; i < n; ++i)
+  {
+    job_queue &q = *queues[(first + i) % n];
+    if (q.size == 0)
+      continue;
+    boost::unique_lock<boost::mutex> lock(q.mutex);
+    // a worker uses its own deque as a stack and steals from the other end of the rest
+    if (own && i == 0)
+    {
+      for (auto it = q.entries.end(); it != q.entries.begin(); )
+      {
+        --it;
+        if (wanted(*it))
+        {
+          e = std::move(*it);
+          q.entries.erase(it);
+          --q.size;
+          --pending;
+          return true;
+        }
+      }
+    }
+    else
+    {
+      for (auto it = q.entries.begin(); it != q.entries.end(); ++it)
+      {
+        if (wanted(*it))
+        {
+          e = std::move(*it);
+          q.entries.erase(it);
+          --q.size;
+          --pending;
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void threadpool::execute(entry &e) {
+  ++active;
+  waiter *const outer = current_waiter;
+  const bool outer_leaf = is_leaf;
+  current_waiter = e.wo;
+  ++depth;
+  is_leaf = e.leaf;
+  e.f();
+  --depth;
+  is_leaf = outer_leaf;
+  current_waiter = outer;
+
+  if (e.wo)
+    e.wo->dec();
+  --active;
+}
+
+bool threadpool::help(const waiter *w) {
+  entry e;
+  if (!pop(e, w))
+    return false;
+  execute(e);
+  return true;
+}
+
 unsigned int threadpool::get_max_concurrency() const {
   return max;
 }
 
+threadpool::waiter::waiter() : num(0), queued(0), waiting(false), id(next_waiter_id++), lineage_size(0)
+{
+  const waiter *parent = current_waiter;
+  if (parent)
+  {
+    // past MAX_LINEAGE levels only the innermost ancestors are kept
+    const unsigned skip = parent->lineage_size + 1 > MAX_LINEAGE ? parent->lineage_size + 1 - MAX_LINEAGE : 0;
+    for (unsigned i = skip; i < parent->lineage_size; ++i)
+      lineage[lineage_size++] = parent->lineage[i];
+    lineage[lineage_size++] = parent->id;
+  }
+}
+
 threadpool::waiter::~waiter()
 {
   try
@@ -124,12 +250,30 @@ threadpool::waiter::~waiter()
   }
 }
 
+bool threadpool::waiter::in_subtree_of(const waiter *w) const {
+  if (this == w)
+    return true;
+  for (unsigned i = 0; i < lineage_size; ++i)
+    if (lineage[i] == w->id)
+      return true;
+  return false;
+}
+
 void threadpool::waiter::wait(threadpool *tpool) {
-  if (tpool)
-    tpool->run(true);
   boost::unique_lock<boost::mutex> lock(mt);
-  while(num)
-    cv.wait(lock);
+  waiting = true;
+  while (num)
+  {
+    // run our own jobs and our children's rather than sleep on them, but
+    // nothing else, so a nested wait can't end up behind unrelated work
+    const unsigned seen = queued;
+    lock.unlock();
+    const bool ran = tpool && tpool->help(this);
+    lock.lock();
+    if (!ran && num && seen == queued)
+      cv.wait(lock);
+  }
+  waiting = false;
 }
 
 void threadpool::waiter::inc() {
@@ -144,32 +288,31 @@ void threadpool::waiter::dec() {
     cv.notify_all();
 }
 
-void threadpool::run(bool flush) {
-  boost::unique_lock<boost::mutex> lock(mutex);
+void threadpool::waiter::wake() {
+  if (!waiting)
+    return;
+  const boost::unique_lock<boost::mutex> lock(mt);
+  ++queued;
+  cv.notify_all();
+}
+
+void threadpool::run(size_t index) {
+  worker_pool = this;
+  worker_index = index;
   while (running) {
     entry e;
-    while(queue.empty() && running)
+    if (pop(e, NULL))
     {
-      if (flush)
-        return;
-      has_work.wait(lock);
+      execute(e);
+      continue;
     }
-    if (!running) break;
 
-    active++;
-    e = queue.front();
-    queue.pop_front();
-    lock.unlock();
-    ++depth;
-    is_leaf = e.leaf;
-    e.f();
-    --depth;
-    is_leaf = false;
-
-    if (e.wo)
-      e.wo->dec();
-    lock.lock();
-    active--;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    ++sleeping;
+    while (pending == 0 && running)
+      has_work.wait(lock);
+    --sleeping;
   }
+  worker_pool = NULL;
 }
 }
@@ -30,8 +30,12 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <stdexcept>
@@ -39,6 +43,11 @@
 namespace tools
 {
 //! A global thread pool
+//!
+//! Each worker owns a deque of jobs. It pushes and pops its own jobs at the
+//! back and steals from the front of the others' when it runs dry, so
+//! workers only contend on a deque when one of them is stealing. Jobs
+//! submitted from outside the pool are spread over the deques.
 class threadpool
 {
 public:
@@ -56,12 +65,28 @@ public:
     boost::mutex mt;
     boost::condition_variable cv;
     int num;
+    // bumped when a job is queued for a waiter that is waiting,
+    // so wait() goes back to help instead of sleeping
+    unsigned queued;
+    std::atomic<bool> waiting;
+    // ids of the waiters whose jobs were running when this one was made,
+    // innermost last; a job belongs to this waiter's subtree when its
+    // waiter is this one or has this one's id in its lineage
+    enum { MAX_LINEAGE = 8 };
+    uint64_t id;
+    uint64_t lineage[MAX_LINEAGE];
+    unsigned lineage_size;
+    void wake();
     public:
     void inc();
     void dec();
-    void wait(threadpool *tpool);  //! Wait for a set of tasks to finish.
-    waiter() : num(0){}
+    //! Wait for a set of tasks to finish, running queued jobs from this
+    //! waiter's subtree on the calling thread in the meantime.
+    void wait(threadpool *tpool);
+    bool in_subtree_of(const waiter *w) const;
+    waiter();
     ~waiter();
+    friend class threadpool;
   };
 
   // Submit a task to the pool. The waiter pointer may be
@@ -69,6 +94,47 @@ public:
   // task to finish.
   void submit(waiter *waiter, std::function<void()> f, bool leaf = false);
 
+  // Submit f(begin, end) over [0, count) in chunks of at least min_chunk
+  // items. f is called by reference, so it must outlive the wait.
+  template<typename F>
+  void submit_range(waiter *waiter, size_t count, size_t min_chunk, const F &f, bool leaf = false)
+  {
+    if (count == 0)
+      return;
+    // a few chunks per thread so stealing can even out uneven chunks
+    const size_t max_chunks = 4 * (size_t)get_max_concurrency();
+    size_t chunks = (count + (min_chunk ? min_chunk : 1) - 1) / (min_chunk ? min_chunk : 1);
+    if (chunks > max_chunks)
+      chunks = max_chunks;
+    if (chunks <= 1)
+    {
+      submit(waiter, [&f, count]() { f(0, count); }, leaf);
+      return;
+    }
+    const size_t chunk_size = (count + chunks - 1) / chunks;
+    for (size_t begin = 0; begin < count; begin += chunk_size)
+    {
+      const size_t end = std::min(count, begin + chunk_size);
+      submit(waiter, [&f, begin, end]() { f(begin, end); }, leaf);
+    }
+  }
+
+  // Run f(0) ... f(count - 1) on the pool and wait for all of them.
+  template<typename F>
+  void parallel_for(size_t count, const F &f, bool leaf = false, size_t min_chunk = 1)
+  {
+    if (count < 2)
+    {
+      for (size_t n = 0; n < count; ++n)
+        f(n);
+      return;
+    }
+    waiter waiter;
+    const auto range = [&f](size_t begin, size_t end) { for (size_t n = begin; n < end; ++n) f(n); };
+    submit_range(&waiter, count, min_chunk, range, leaf);
+    waiter.wait(this);
+  }
+
   unsigned int get_max_concurrency() const;
 
   ~threadpool();
@@ -82,14 +148,27 @@ public:
       std::function<void()> f;
       bool leaf;
     } entry;
-    std::deque<entry> queue;
+    struct job_queue {
+      boost::mutex mutex;
+      std::deque<entry> entries;
+      std::atomic<size_t> size; // lets stealers skip empty deques without locking
+      job_queue(): size(0) {}
+    };
+    std::vector<std::unique_ptr<job_queue>> queues;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> next_queue;
+    std::atomic<unsigned int> sleeping;
     boost::condition_variable has_work;
     boost::mutex mutex;
     std::vector<boost::thread> threads;
-    unsigned int active;
+    std::atomic<unsigned int> active;
     unsigned int max;
-    bool running;
-    void run(bool flush = false);
+    std::atomic<bool> running;
+    void push(entry &&e);
+    bool pop(entry &e, const waiter *subtree);
+    void execute(entry &e);
+    bool help(const waiter *w);
+    void run(size_t index);
 };
 
 }
@@ -83,9 +83,10 @@ namespace tools {
   template<typename T>
     std::string get_varint_data(const T& v)
     {
-      std::stringstream ss;
-      write_varint(std::ostreambuf_iterator<char>(ss), v);
-      return ss.str();
+      char bytes[(sizeof(T) * 8 + 6) / 7];
+      char *end = bytes;
+      write_varint(end, v);
+      return std::string(bytes, end);
     }
   /*! \brief reads in the varint that is pointed to by InputIt into write
    */ 
@@ -42,7 +42,59 @@ static const char sigma[] = "expand 32-byte k";
 
 DISABLE_GCC_AND_CLANG_WARNING(strict-aliasing)
 
-static void chacha(unsigned rounds, const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+#if defined(__GNUC__)
+typedef uint32_t chacha_x8_t __attribute__((vector_size(32)));
+
+#define ROTATE_X8(v,c) (((v) << (c)) | ((v) >> (32 - (c))))
+
+#define QUARTERROUND_X8(a,b,c,d) \
+  a += b; d = ROTATE_X8(d ^ a,16); \
+  c += d; b = ROTATE_X8(b ^ c,12); \
+  a += b; d = ROTATE_X8(d ^ a, 8); \
+  c += d; b = ROTATE_X8(b ^ c, 7);
+
+/*
+ * Eight consecutive blocks at once, lane k of every word being block k, for
+ * the bulk of long messages; the lanes map onto AVX2, SSE2 or NEON registers
+ * depending on the target.
+ */
+static void chacha_x8(unsigned rounds, const uint32_t j[16], const uint8_t* data, char* cipher) {
+  const chacha_x8_t lanes = {0, 1, 2, 3, 4, 5, 6, 7};
+  chacha_x8_t s[16], x[16];
+  uint32_t word;
+  int i, k;
+
+  for (i = 0; i < 16; ++i)
+    s[i] = (chacha_x8_t){j[i], j[i], j[i], j[i], j[i], j[i], j[i], j[i]};
+  s[12] += lanes;
+  /* the lanes whose counter wrapped carry into the next word, comparisons giving -1 */
+  s[13] -= (chacha_x8_t)(s[12] < lanes);
+
+  memcpy(x, s, sizeof(x));
+  for (i = rounds;i > 0;i -= 2) {
+    QUARTERROUND_X8(x[0], x[4], x[8],x[12])
+    QUARTERROUND_X8(x[1], x[5], x[9],x[13])
+    QUARTERROUND_X8(x[2], x[6],x[10],x[14])
+    QUARTERROUND_X8(x[3], x[7],x[11],x[15])
+    QUARTERROUND_X8(x[0], x[5],x[10],x[15])
+    QUARTERROUND_X8(x[1], x[6],x[11],x[12])
+    QUARTERROUND_X8(x[2], x[7], x[8],x[13])
+    QUARTERROUND_X8(x[3], x[4], x[9],x[14])
+  }
+  for (i = 0; i < 16; ++i)
+    x[i] += s[i];
+
+  for (k = 0; k < 8; ++k) {
+    for (i = 0; i < 16; ++i) {
+      memcpy(&word, data + k * 64 + i * 4, 4);
+      word = SWAP32LE(SWAP32LE(word) ^ x[i][k]);
+      memcpy(cipher + k * 64 + i * 4, &word, 4);
+    }
+  }
+}
+#endif
+
+static void chacha(unsigned rounds, const void* data, size_t length, const uint8_t* key, const uint8_t* iv, uint64_t counter, char* cipher) {
   uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
   uint32_t j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
   char* ctarget = 0;
@@ -63,11 +115,25 @@ static void chacha(unsigned rounds, const void* data, size_t length, const uint8
   j9  = U8TO32_LITTLE(key + 20);
   j10 = U8TO32_LITTLE(key + 24);
   j11 = U8TO32_LITTLE(key + 28);
-  j12 = 0;
-  j13 = 0;
+  j12 = U32V(counter);
+  j13 = U32V(counter >> 32);
   j14 = U8TO32_LITTLE(iv + 0);
   j15 = U8TO32_LITTLE(iv + 4);
 
+#if defined(__GNUC__)
+  while (length >= 512) {
+    const uint32_t j[16] = {j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15};
+    chacha_x8(rounds, j, (const uint8_t*)data, cipher);
+    j12 = PLUS(j12, 8);
+    if (j12 < 8)
+      j13 = PLUSONE(j13);
+    length -= 512;
+    cipher += 512;
+    data = (const uint8_t*)data + 512;
+  }
+  if (!length) return;
+#endif
+
   for (;;) {
     if (length < 64) {
       memcpy(tmp, data, length);
@@ -173,10 +239,15 @@ static void chacha(unsigned rounds, const void* data, size_t length, const uint8
 
 void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher)
 {
-  chacha(8, data, length, key, iv, cipher);
+  chacha(8, data, length, key, iv, 0, cipher);
 }
 
 void chacha20(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher)
 {
-  chacha(20, data, length, key, iv, cipher);
+  chacha(20, data, length, key, iv, 0, cipher);
+}
+
+void chacha20_from_block(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, uint64_t block, char* cipher)
+{
+  chacha(20, data, length, key, iv, block, cipher);
 }
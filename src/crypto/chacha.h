@@ -48,6 +48,8 @@ namespace crypto {
 #endif
     void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher);
     void chacha20(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher);
+    /* chacha20 of a message from its 64 byte block number block on, to handle it in pieces */
+    void chacha20_from_block(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, uint64_t block, char* cipher);
 #if defined(__cplusplus)
   }
 
@@ -70,6 +72,10 @@ namespace crypto {
     chacha20(data, length, key.data(), reinterpret_cast<const uint8_t*>(&iv), cipher);
   }
 
+  inline void chacha20_from_block(const void* data, std::size_t length, const chacha_key& key, const chacha_iv& iv, uint64_t block, char* cipher) {
+    chacha20_from_block(data, length, key.data(), reinterpret_cast<const uint8_t*>(&iv), block, cipher);
+  }
+
   inline void generate_chacha_key(const void *data, size_t size, chacha_key& key, uint64_t kdf_rounds) {
     static_assert(sizeof(chacha_key) <= sizeof(hash), "Size of hash must be at least that of chacha_key");
     epee::mlocked<tools::scrubbed_arr<char, HASH_SIZE>> pwd_hash;
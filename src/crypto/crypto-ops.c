@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "warnings.h"
@@ -66,6 +67,328 @@ uint64_t load_4(const unsigned char *in)
   return result;
 }
 
+#ifdef CRYPTO_OPS_FE64
+
+/*
+Radix 2^51 field arithmetic, after curve25519-donna-c64.
+
+An element is h[0]+2^51 h[1]+2^102 h[2]+2^153 h[3]+2^204 h[4]. Limbs are
+unsigned and only loosely reduced: fe_mul, fe_sq, fe_sub and fe_neg return
+limbs below 2^51+2^18, fe_add does not carry, and the FE_INIT constants are
+below 2^53. Multiplication accepts limbs up to 2^54 without overflowing the
+128-bit accumulators, which covers every sum the ge_* code feeds it.
+*/
+
+__extension__ typedef unsigned __int128 fe_uint128;
+
+static const uint64_t fe_mask51 = 0x7ffffffffffff;
+
+static uint64_t load_8(const unsigned char *in) {
+  uint64_t result;
+  result = load_4(in);
+  result |= load_4(in + 4) << 32;
+  return result;
+}
+
+static void store_8(unsigned char *out, uint64_t in) {
+  int i;
+  for (i = 0; i < 8; i++) {
+    out[i] = (unsigned char) (in >> (8 * i));
+  }
+}
+
+/* Carry a 64-bit limb vector so that every limb is below 2^51+2^18. */
+
+static void fe_carry(fe h, uint64_t h0, uint64_t h1, uint64_t h2, uint64_t h3, uint64_t h4) {
+  h1 += h0 >> 51; h0 &= fe_mask51;
+  h2 += h1 >> 51; h1 &= fe_mask51;
+  h3 += h2 >> 51; h2 &= fe_mask51;
+  h4 += h3 >> 51; h3 &= fe_mask51;
+  h0 += 19 * (h4 >> 51); h4 &= fe_mask51;
+  h1 += h0 >> 51; h0 &= fe_mask51;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/* Same, for the 128-bit column sums of a product. */
+
+static void fe_carry_wide(fe h, fe_uint128 t0, fe_uint128 t1, fe_uint128 t2, fe_uint128 t3, fe_uint128 t4) {
+  uint64_t h0, h1, h2, h3, h4;
+
+  t1 += (uint64_t) (t0 >> 51); h0 = (uint64_t) t0 & fe_mask51;
+  t2 += (uint64_t) (t1 >> 51); h1 = (uint64_t) t1 & fe_mask51;
+  t3 += (uint64_t) (t2 >> 51); h2 = (uint64_t) t2 & fe_mask51;
+  t4 += (uint64_t) (t3 >> 51); h3 = (uint64_t) t3 & fe_mask51;
+  t0 = h0 + (fe_uint128) (uint64_t) (t4 >> 51) * 19; h4 = (uint64_t) t4 & fe_mask51;
+  h1 += (uint64_t) (t0 >> 51); h0 = (uint64_t) t0 & fe_mask51;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+static void fe_0(fe h) {
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+static void fe_1(fe h) {
+  h[0] = 1;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+/*
+h = f + g
+Can overlap h with f or g.
+*/
+
+void fe_add(fe h, const fe f, const fe g) {
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+}
+
+/*
+Replace (f,g) with (g,g) if b == 1;
+replace (f,g) with (f,g) if b == 0.
+
+Preconditions: b in {0,1}.
+*/
+
+static void fe_cmov(fe f, const fe g, unsigned int b) {
+  uint64_t mask = (uint64_t) 0 - (uint64_t) b;
+  f[0] ^= (f[0] ^ g[0]) & mask;
+  f[1] ^= (f[1] ^ g[1]) & mask;
+  f[2] ^= (f[2] ^ g[2]) & mask;
+  f[3] ^= (f[3] ^ g[3]) & mask;
+  f[4] ^= (f[4] ^ g[4]) & mask;
+}
+
+static void fe_copy(fe h, const fe f) {
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+/*
+h = f * g
+Can overlap h with f or g.
+*/
+
+static void fe_mul(fe h, const fe f, const fe g) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+  uint64_t g0 = g[0];
+  uint64_t g1 = g[1];
+  uint64_t g2 = g[2];
+  uint64_t g3 = g[3];
+  uint64_t g4 = g[4];
+  uint64_t g1_19 = 19 * g1;
+  uint64_t g2_19 = 19 * g2;
+  uint64_t g3_19 = 19 * g3;
+  uint64_t g4_19 = 19 * g4;
+  fe_uint128 t0, t1, t2, t3, t4;
+
+  t0 = (fe_uint128) f0 * g0 + (fe_uint128) f1 * g4_19 + (fe_uint128) f2 * g3_19 + (fe_uint128) f3 * g2_19 + (fe_uint128) f4 * g1_19;
+  t1 = (fe_uint128) f0 * g1 + (fe_uint128) f1 * g0 + (fe_uint128) f2 * g4_19 + (fe_uint128) f3 * g3_19 + (fe_uint128) f4 * g2_19;
+  t2 = (fe_uint128) f0 * g2 + (fe_uint128) f1 * g1 + (fe_uint128) f2 * g0 + (fe_uint128) f3 * g4_19 + (fe_uint128) f4 * g3_19;
+  t3 = (fe_uint128) f0 * g3 + (fe_uint128) f1 * g2 + (fe_uint128) f2 * g1 + (fe_uint128) f3 * g0 + (fe_uint128) f4 * g4_19;
+  t4 = (fe_uint128) f0 * g4 + (fe_uint128) f1 * g3 + (fe_uint128) f2 * g2 + (fe_uint128) f3 * g1 + (fe_uint128) f4 * g0;
+
+  fe_carry_wide(h, t0, t1, t2, t3, t4);
+}
+
+/*
+h = -f
+*/
+
+static void fe_neg(fe h, const fe f) {
+  /* 16p, so that the result stays non-negative for any input limb below 2^55 */
+  fe_carry(h,
+    0x7ffffffffffed0 - f[0],
+    0x7ffffffffffff0 - f[1],
+    0x7ffffffffffff0 - f[2],
+    0x7ffffffffffff0 - f[3],
+    0x7ffffffffffff0 - f[4]);
+}
+
+/*
+h = f * f
+Can overlap h with f.
+*/
+
+static void fe_sq(fe h, const fe f) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+  uint64_t f0_2 = 2 * f0;
+  uint64_t f1_2 = 2 * f1;
+  uint64_t f1_38 = 38 * f1;
+  uint64_t f2_38 = 38 * f2;
+  uint64_t f3_19 = 19 * f3;
+  uint64_t f3_38 = 38 * f3;
+  uint64_t f4_19 = 19 * f4;
+  fe_uint128 t0, t1, t2, t3, t4;
+
+  t0 = (fe_uint128) f0 * f0 + (fe_uint128) f1_38 * f4 + (fe_uint128) f2_38 * f3;
+  t1 = (fe_uint128) f0_2 * f1 + (fe_uint128) f2_38 * f4 + (fe_uint128) f3_19 * f3;
+  t2 = (fe_uint128) f0_2 * f2 + (fe_uint128) f1 * f1 + (fe_uint128) f3_38 * f4;
+  t3 = (fe_uint128) f0_2 * f3 + (fe_uint128) f1_2 * f2 + (fe_uint128) f4_19 * f4;
+  t4 = (fe_uint128) f0_2 * f4 + (fe_uint128) f1_2 * f3 + (fe_uint128) f2 * f2;
+
+  fe_carry_wide(h, t0, t1, t2, t3, t4);
+}
+
+/*
+h = 2 * f * f
+Can overlap h with f.
+*/
+
+static void fe_sq2(fe h, const fe f) {
+  fe_sq(h, f);
+  h[0] += h[0];
+  h[1] += h[1];
+  h[2] += h[2];
+  h[3] += h[3];
+  h[4] += h[4];
+}
+
+/*
+h = f - g
+Can overlap h with f or g.
+*/
+
+static void fe_sub(fe h, const fe f, const fe g) {
+  fe_carry(h,
+    f[0] + 0x7ffffffffffed0 - g[0],
+    f[1] + 0x7ffffffffffff0 - g[1],
+    f[2] + 0x7ffffffffffff0 - g[2],
+    f[3] + 0x7ffffffffffff0 - g[3],
+    f[4] + 0x7ffffffffffff0 - g[4]);
+}
+
+/*
+Writes the unique representative in [0, p) as 32 little-endian bytes.
+*/
+
+void fe_tobytes(unsigned char *s, const fe h) {
+  uint64_t t0 = h[0];
+  uint64_t t1 = h[1];
+  uint64_t t2 = h[2];
+  uint64_t t3 = h[3];
+  uint64_t t4 = h[4];
+
+  /* After two carry passes the value is below 2^255 */
+  t1 += t0 >> 51; t0 &= fe_mask51;
+  t2 += t1 >> 51; t1 &= fe_mask51;
+  t3 += t2 >> 51; t2 &= fe_mask51;
+  t4 += t3 >> 51; t3 &= fe_mask51;
+  t0 += 19 * (t4 >> 51); t4 &= fe_mask51;
+
+  t1 += t0 >> 51; t0 &= fe_mask51;
+  t2 += t1 >> 51; t1 &= fe_mask51;
+  t3 += t2 >> 51; t2 &= fe_mask51;
+  t4 += t3 >> 51; t3 &= fe_mask51;
+  t0 += 19 * (t4 >> 51); t4 &= fe_mask51;
+
+  /* Offset by 19 so that values in [p, 2^255) wrap past 2^255 and get reduced */
+  t0 += 19;
+
+  t1 += t0 >> 51; t0 &= fe_mask51;
+  t2 += t1 >> 51; t1 &= fe_mask51;
+  t3 += t2 >> 51; t2 &= fe_mask51;
+  t4 += t3 >> 51; t3 &= fe_mask51;
+  t0 += 19 * (t4 >> 51); t4 &= fe_mask51;
+
+  /* Now in [19, 2^255) and offset by 19; add 2^255 - 19 and drop the 2^255 bit */
+  t0 += 0x8000000000000 - 19;
+  t1 += 0x8000000000000 - 1;
+  t2 += 0x8000000000000 - 1;
+  t3 += 0x8000000000000 - 1;
+  t4 += 0x8000000000000 - 1;
+
+  t1 += t0 >> 51; t0 &= fe_mask51;
+  t2 += t1 >> 51; t1 &= fe_mask51;
+  t3 += t2 >> 51; t2 &= fe_mask51;
+  t4 += t3 >> 51; t3 &= fe_mask51;
+  t4 &= fe_mask51;
+
+  store_8(s, t0 | (t1 << 51));
+  store_8(s + 8, (t1 >> 13) | (t2 << 38));
+  store_8(s + 16, (t2 >> 26) | (t3 << 25));
+  store_8(s + 24, (t3 >> 39) | (t4 << 12));
+}
+
+/*
+Loads the low 255 bits of s. Returns -1, leaving h unset, if they are not
+below p.
+*/
+
+static int fe_frombytes_vartime(fe h, const unsigned char *s) {
+  uint64_t x0 = load_8(s);
+  uint64_t x1 = load_8(s + 8);
+  uint64_t x2 = load_8(s + 16);
+  uint64_t x3 = load_8(s + 24);
+  uint64_t h0 = x0 & fe_mask51;
+  uint64_t h1 = ((x0 >> 51) | (x1 << 13)) & fe_mask51;
+  uint64_t h2 = ((x1 >> 38) | (x2 << 26)) & fe_mask51;
+  uint64_t h3 = ((x2 >> 25) | (x3 << 39)) & fe_mask51;
+  uint64_t h4 = (x3 >> 12) & fe_mask51;
+
+  /* Validate the number to be canonical */
+  if (h4 == fe_mask51 && h3 == fe_mask51 && h2 == fe_mask51 && h1 == fe_mask51 &&
+    h0 >= fe_mask51 - 18) {
+    return -1;
+  }
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+  return 0;
+}
+
+/*
+Loads all 256 bits of s, reducing the top bit as 2^255 = 19.
+*/
+
+static void fe_frombytes_full(fe h, const unsigned char *s) {
+  uint64_t x0 = load_8(s);
+  uint64_t x1 = load_8(s + 8);
+  uint64_t x2 = load_8(s + 16);
+  uint64_t x3 = load_8(s + 24);
+
+  h[0] = (x0 & fe_mask51) + 19 * (x3 >> 63);
+  h[1] = ((x0 >> 51) | (x1 << 13)) & fe_mask51;
+  h[2] = ((x1 >> 38) | (x2 << 26)) & fe_mask51;
+  h[3] = ((x2 >> 25) | (x3 << 39)) & fe_mask51;
+  h[4] = (x3 >> 12) & fe_mask51;
+}
+
+#else
+
 /* From fe_0.c */
 
 /*
@@ -254,6 +577,8 @@ static void fe_copy(fe h, const fe f) {
   h[9] = f9;
 }
 
+#endif
+
 /* From fe_invert.c */
 
 void fe_invert(fe out, const fe z) {
@@ -341,6 +666,8 @@ static int fe_isnonzero(const fe f) {
     s[27] | s[28] | s[29] | s[30] | s[31]) - 1) >> 8) + 1;
 }
 
+#ifndef CRYPTO_OPS_FE64
+
 /* From fe_mul.c */
 
 /*
@@ -1121,6 +1448,119 @@ void fe_tobytes(unsigned char *s, const fe h) {
   s[31] = h9 >> 18;
 }
 
+/* From fe_frombytes.c, modified */
+
+/*
+Loads the low 255 bits of s. Returns -1, leaving h unset, if they are not
+below p.
+*/
+
+static int fe_frombytes_vartime(fe h, const unsigned char *s) {
+  int64_t h0 = load_4(s);
+  int64_t h1 = load_3(s + 4) << 6;
+  int64_t h2 = load_3(s + 7) << 5;
+  int64_t h3 = load_3(s + 10) << 3;
+  int64_t h4 = load_3(s + 13) << 2;
+  int64_t h5 = load_4(s + 16);
+  int64_t h6 = load_3(s + 20) << 7;
+  int64_t h7 = load_3(s + 23) << 5;
+  int64_t h8 = load_3(s + 26) << 4;
+  int64_t h9 = (load_3(s + 29) & 8388607) << 2;
+  int64_t carry0;
+  int64_t carry1;
+  int64_t carry2;
+  int64_t carry3;
+  int64_t carry4;
+  int64_t carry5;
+  int64_t carry6;
+  int64_t carry7;
+  int64_t carry8;
+  int64_t carry9;
+
+  /* Validate the number to be canonical */
+  if (h9 == 33554428 && h8 == 268435440 && h7 == 536870880 && h6 == 2147483520 &&
+    h5 == 4294967295 && h4 == 67108860 && h3 == 134217720 && h2 == 536870880 &&
+    h1 == 1073741760 && h0 >= 4294967277) {
+    return -1;
+  }
+
+  carry9 = (h9 + (int64_t) (1<<24)) >> 25; h0 += carry9 * 19; h9 -= carry9 << 25;
+  carry1 = (h1 + (int64_t) (1<<24)) >> 25; h2 += carry1; h1 -= carry1 << 25;
+  carry3 = (h3 + (int64_t) (1<<24)) >> 25; h4 += carry3; h3 -= carry3 << 25;
+  carry5 = (h5 + (int64_t) (1<<24)) >> 25; h6 += carry5; h5 -= carry5 << 25;
+  carry7 = (h7 + (int64_t) (1<<24)) >> 25; h8 += carry7; h7 -= carry7 << 25;
+
+  carry0 = (h0 + (int64_t) (1<<25)) >> 26; h1 += carry0; h0 -= carry0 << 26;
+  carry2 = (h2 + (int64_t) (1<<25)) >> 26; h3 += carry2; h2 -= carry2 << 26;
+  carry4 = (h4 + (int64_t) (1<<25)) >> 26; h5 += carry4; h4 -= carry4 << 26;
+  carry6 = (h6 + (int64_t) (1<<25)) >> 26; h7 += carry6; h6 -= carry6 << 26;
+  carry8 = (h8 + (int64_t) (1<<25)) >> 26; h9 += carry8; h8 -= carry8 << 26;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+  h[5] = h5;
+  h[6] = h6;
+  h[7] = h7;
+  h[8] = h8;
+  h[9] = h9;
+  return 0;
+}
+
+/*
+Loads all 256 bits of s, reducing the top bit as 2^255 = 19.
+*/
+
+static void fe_frombytes_full(fe h, const unsigned char *s) {
+  int64_t h0 = load_4(s);
+  int64_t h1 = load_3(s + 4) << 6;
+  int64_t h2 = load_3(s + 7) << 5;
+  int64_t h3 = load_3(s + 10) << 3;
+  int64_t h4 = load_3(s + 13) << 2;
+  int64_t h5 = load_4(s + 16);
+  int64_t h6 = load_3(s + 20) << 7;
+  int64_t h7 = load_3(s + 23) << 5;
+  int64_t h8 = load_3(s + 26) << 4;
+  int64_t h9 = load_3(s + 29) << 2;
+  int64_t carry0;
+  int64_t carry1;
+  int64_t carry2;
+  int64_t carry3;
+  int64_t carry4;
+  int64_t carry5;
+  int64_t carry6;
+  int64_t carry7;
+  int64_t carry8;
+  int64_t carry9;
+
+  carry9 = (h9 + (int64_t) (1<<24)) >> 25; h0 += carry9 * 19; h9 -= carry9 << 25;
+  carry1 = (h1 + (int64_t) (1<<24)) >> 25; h2 += carry1; h1 -= carry1 << 25;
+  carry3 = (h3 + (int64_t) (1<<24)) >> 25; h4 += carry3; h3 -= carry3 << 25;
+  carry5 = (h5 + (int64_t) (1<<24)) >> 25; h6 += carry5; h5 -= carry5 << 25;
+  carry7 = (h7 + (int64_t) (1<<24)) >> 25; h8 += carry7; h7 -= carry7 << 25;
+
+  carry0 = (h0 + (int64_t) (1<<25)) >> 26; h1 += carry0; h0 -= carry0 << 26;
+  carry2 = (h2 + (int64_t) (1<<25)) >> 26; h3 += carry2; h2 -= carry2 << 26;
+  carry4 = (h4 + (int64_t) (1<<25)) >> 26; h5 += carry4; h4 -= carry4 << 26;
+  carry6 = (h6 + (int64_t) (1<<25)) >> 26; h7 += carry6; h6 -= carry6 << 26;
+  carry8 = (h8 + (int64_t) (1<<25)) >> 26; h9 += carry8; h8 -= carry8 << 26;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+  h[5] = h5;
+  h[6] = h6;
+  h[7] = h7;
+  h[8] = h8;
+  h[9] = h9;
+}
+
+#endif
+
 /* From ge_add.c */
 
 void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
@@ -1338,61 +1778,10 @@ int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
   fe vxx;
   fe check;
 
-  /* From fe_frombytes.c */
-
-  int64_t h0 = load_4(s);
-  int64_t h1 = load_3(s + 4) << 6;
-  int64_t h2 = load_3(s + 7) << 5;
-  int64_t h3 = load_3(s + 10) << 3;
-  int64_t h4 = load_3(s + 13) << 2;
-  int64_t h5 = load_4(s + 16);
-  int64_t h6 = load_3(s + 20) << 7;
-  int64_t h7 = load_3(s + 23) << 5;
-  int64_t h8 = load_3(s + 26) << 4;
-  int64_t h9 = (load_3(s + 29) & 8388607) << 2;
-  int64_t carry0;
-  int64_t carry1;
-  int64_t carry2;
-  int64_t carry3;
-  int64_t carry4;
-  int64_t carry5;
-  int64_t carry6;
-  int64_t carry7;
-  int64_t carry8;
-  int64_t carry9;
-
-  /* Validate the number to be canonical */
-  if (h9 == 33554428 && h8 == 268435440 && h7 == 536870880 && h6 == 2147483520 &&
-    h5 == 4294967295 && h4 == 67108860 && h3 == 134217720 && h2 == 536870880 &&
-    h1 == 1073741760 && h0 >= 4294967277) {
+  if (fe_frombytes_vartime(h->Y, s) != 0) {
     return -1;
   }
 
-  carry9 = (h9 + (int64_t) (1<<24)) >> 25; h0 += carry9 * 19; h9 -= carry9 << 25;
-  carry1 = (h1 + (int64_t) (1<<24)) >> 25; h2 += carry1; h1 -= carry1 << 25;
-  carry3 = (h3 + (int64_t) (1<<24)) >> 25; h4 += carry3; h3 -= carry3 << 25;
-  carry5 = (h5 + (int64_t) (1<<24)) >> 25; h6 += carry5; h5 -= carry5 << 25;
-  carry7 = (h7 + (int64_t) (1<<24)) >> 25; h8 += carry7; h7 -= carry7 << 25;
-
-  carry0 = (h0 + (int64_t) (1<<25)) >> 26; h1 += carry0; h0 -= carry0 << 26;
-  carry2 = (h2 + (int64_t) (1<<25)) >> 26; h3 += carry2; h2 -= carry2 << 26;
-  carry4 = (h4 + (int64_t) (1<<25)) >> 26; h5 += carry4; h4 -= carry4 << 26;
-  carry6 = (h6 + (int64_t) (1<<25)) >> 26; h7 += carry6; h6 -= carry6 << 26;
-  carry8 = (h8 + (int64_t) (1<<25)) >> 26; h9 += carry8; h8 -= carry8 << 26;
-
-  h->Y[0] = h0;
-  h->Y[1] = h1;
-  h->Y[2] = h2;
-  h->Y[3] = h3;
-  h->Y[4] = h4;
-  h->Y[5] = h5;
-  h->Y[6] = h6;
-  h->Y[7] = h7;
-  h->Y[8] = h8;
-  h->Y[9] = h9;
-
-  /* End fe_frombytes.c */
-
   fe_1(h->Z);
   fe_sq(u, h->Y);
   fe_mul(v, u, fe_d);
@@ -1608,20 +1997,20 @@ static void ge_precomp_cmov(ge_precomp *t, const ge_precomp *u, unsigned char b)
   fe_cmov(t->xy2d, u->xy2d, b);
 }
 
-static void select(ge_precomp *t, int pos, signed char b) {
+static void select(ge_precomp *t, const ge_precomp *row, signed char b) {
   ge_precomp minust;
   unsigned char bnegative = negative(b);
   unsigned char babs = b - (((-bnegative) & b) << 1);
 
   ge_precomp_0(t);
-  ge_precomp_cmov(t, &ge_base[pos][0], equal(babs, 1));
-  ge_precomp_cmov(t, &ge_base[pos][1], equal(babs, 2));
-  ge_precomp_cmov(t, &ge_base[pos][2], equal(babs, 3));
-  ge_precomp_cmov(t, &ge_base[pos][3], equal(babs, 4));
-  ge_precomp_cmov(t, &ge_base[pos][4], equal(babs, 5));
-  ge_precomp_cmov(t, &ge_base[pos][5], equal(babs, 6));
-  ge_precomp_cmov(t, &ge_base[pos][6], equal(babs, 7));
-  ge_precomp_cmov(t, &ge_base[pos][7], equal(babs, 8));
+  ge_precomp_cmov(t, &row[0], equal(babs, 1));
+  ge_precomp_cmov(t, &row[1], equal(babs, 2));
+  ge_precomp_cmov(t, &row[2], equal(babs, 3));
+  ge_precomp_cmov(t, &row[3], equal(babs, 4));
+  ge_precomp_cmov(t, &row[4], equal(babs, 5));
+  ge_precomp_cmov(t, &row[5], equal(babs, 6));
+  ge_precomp_cmov(t, &row[6], equal(babs, 7));
+  ge_precomp_cmov(t, &row[7], equal(babs, 8));
   fe_copy(minust.yplusx, t->yminusx);
   fe_copy(minust.yminusx, t->yplusx);
   fe_neg(minust.xy2d, t->xy2d);
@@ -1638,6 +2027,21 @@ Preconditions:
 */
 
 void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+  ge_scalarmult_base_precomp(h, a, ge_base);
+}
+
+/* New code */
+
+/*
+h = a * B
+where B is any point whose multiples are in table, as built by
+ge_precomp_table_init; ge_base is the table for the Ed25519 base point.
+
+Preconditions:
+  a[31] <= 127
+*/
+
+void ge_scalarmult_base_precomp(ge_p3 *h, const unsigned char *a, const ge_precomp table[32][8]) {
   signed char e[64];
   signed char carry;
   ge_p1p1 r;
@@ -1664,7 +2068,7 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
 
   ge_p3_0(h);
   for (i = 1; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+    select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 
@@ -1674,11 +2078,68 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
   ge_p2_dbl(&r, &s); ge_p1p1_to_p3(h, &r);
 
   for (i = 0; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+    select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 }
 
+/*
+table[i][j] = (j+1)*256^i*B, in the same affine form as ge_base.
+*/
+
+void ge_precomp_table_init(ge_precomp table[32][8], const ge_p3 *B) {
+  ge_p3 row[8];
+  ge_p3 p;
+  ge_cached c;
+  ge_p1p1 r;
+  ge_p2 s;
+  fe acc[8];
+  fe recip;
+  fe zinv;
+  fe x;
+  fe y;
+  int i, j;
+
+  p = *B;
+  for (i = 0; i < 32; ++i) {
+    /* row[j] = (j+1)*p */
+    row[0] = p;
+    ge_p3_to_cached(&c, &p);
+    for (j = 1; j < 8; ++j) {
+      ge_add(&r, &row[j - 1], &c);
+      ge_p1p1_to_p3(&row[j], &r);
+    }
+
+    /* one inversion for the whole row, as in ge_tobytes_batch */
+    fe_copy(acc[0], row[0].Z);
+    for (j = 1; j < 8; ++j) {
+      fe_mul(acc[j], acc[j - 1], row[j].Z);
+    }
+    fe_invert(recip, acc[7]);
+    for (j = 7; j >= 0; --j) {
+      if (j > 0) {
+        fe_mul(zinv, recip, acc[j - 1]);
+        fe_mul(recip, recip, row[j].Z);
+      } else {
+        fe_copy(zinv, recip);
+      }
+      fe_mul(x, row[j].X, zinv);
+      fe_mul(y, row[j].Y, zinv);
+      fe_add(table[i][j].yplusx, y, x);
+      fe_sub(table[i][j].yminusx, y, x);
+      fe_mul(table[i][j].xy2d, x, y);
+      fe_mul(table[i][j].xy2d, table[i][j].xy2d, fe_d2);
+    }
+
+    /* p = 256*p */
+    ge_p3_dbl(&r, &p); ge_p1p1_to_p2(&s, &r);
+    for (j = 1; j < 7; ++j) {
+      ge_p2_dbl(&r, &s); ge_p1p1_to_p2(&s, &r);
+    }
+    ge_p2_dbl(&r, &s); ge_p1p1_to_p3(&p, &r);
+  }
+}
+
 /* From ge_sub.c */
 
 /*
@@ -1714,6 +2175,49 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* New code */
+
+/*
+ge_tobytes on h[0..n-1], writing 32 * n bytes to s. The Z coordinates of
+each chunk are inverted together (Montgomery's trick), which costs three
+multiplications per point instead of one inversion per point. Every Z must be
+nonzero, as it is for any point produced by the ge_* functions.
+*/
+
+#define GE_TOBYTES_BATCH 64
+
+static void ge_tobytes_recip(unsigned char *s, const ge_p2 *h, const fe recip) {
+  fe x;
+  fe y;
+
+  fe_mul(x, h->X, recip);
+  fe_mul(y, h->Y, recip);
+  fe_tobytes(s, y);
+  s[31] ^= fe_isnegative(x) << 7;
+}
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, size_t n) {
+  fe acc[GE_TOBYTES_BATCH];
+  fe recip;
+  fe t;
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m) {
+    m = n - i < GE_TOBYTES_BATCH ? n - i : GE_TOBYTES_BATCH;
+    fe_copy(acc[0], h[i].Z);
+    for (j = 1; j < m; ++j) {
+      fe_mul(acc[j], acc[j - 1], h[i + j].Z);
+    }
+    fe_invert(recip, acc[m - 1]); /* 1 / (Z_0 ... Z_m-1) */
+    for (j = m - 1; j > 0; --j) {
+      fe_mul(t, recip, acc[j - 1]); /* 1 / Z_j */
+      fe_mul(recip, recip, h[i + j].Z); /* 1 / (Z_0 ... Z_j-1) */
+      ge_tobytes_recip(s + 32 * (i + j), &h[i + j], t);
+    }
+    ge_tobytes_recip(s + 32 * i, &h[i], recip);
+  }
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -2313,53 +2817,7 @@ void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
   fe u, v, w, x, y, z;
   unsigned char sign;
 
-  /* From fe_frombytes.c */
-
-  int64_t h0 = load_4(s);
-  int64_t h1 = load_3(s + 4) << 6;
-  int64_t h2 = load_3(s + 7) << 5;
-  int64_t h3 = load_3(s + 10) << 3;
-  int64_t h4 = load_3(s + 13) << 2;
-  int64_t h5 = load_4(s + 16);
-  int64_t h6 = load_3(s + 20) << 7;
-  int64_t h7 = load_3(s + 23) << 5;
-  int64_t h8 = load_3(s + 26) << 4;
-  int64_t h9 = load_3(s + 29) << 2;
-  int64_t carry0;
-  int64_t carry1;
-  int64_t carry2;
-  int64_t carry3;
-  int64_t carry4;
-  int64_t carry5;
-  int64_t carry6;
-  int64_t carry7;
-  int64_t carry8;
-  int64_t carry9;
-
-  carry9 = (h9 + (int64_t) (1<<24)) >> 25; h0 += carry9 * 19; h9 -= carry9 << 25;
-  carry1 = (h1 + (int64_t) (1<<24)) >> 25; h2 += carry1; h1 -= carry1 << 25;
-  carry3 = (h3 + (int64_t) (1<<24)) >> 25; h4 += carry3; h3 -= carry3 << 25;
-  carry5 = (h5 + (int64_t) (1<<24)) >> 25; h6 += carry5; h5 -= carry5 << 25;
-  carry7 = (h7 + (int64_t) (1<<24)) >> 25; h8 += carry7; h7 -= carry7 << 25;
-
-  carry0 = (h0 + (int64_t) (1<<25)) >> 26; h1 += carry0; h0 -= carry0 << 26;
-  carry2 = (h2 + (int64_t) (1<<25)) >> 26; h3 += carry2; h2 -= carry2 << 26;
-  carry4 = (h4 + (int64_t) (1<<25)) >> 26; h5 += carry4; h4 -= carry4 << 26;
-  carry6 = (h6 + (int64_t) (1<<25)) >> 26; h7 += carry6; h6 -= carry6 << 26;
-  carry8 = (h8 + (int64_t) (1<<25)) >> 26; h9 += carry8; h8 -= carry8 << 26;
-
-  u[0] = h0;
-  u[1] = h1;
-  u[2] = h2;
-  u[3] = h3;
-  u[4] = h4;
-  u[5] = h5;
-  u[6] = h6;
-  u[7] = h7;
-  u[8] = h8;
-  u[9] = h9;
-
-  /* End fe_frombytes.c */
+  fe_frombytes_full(u, s);
 
   fe_sq2(v, u); /* 2 * u^2 */
   fe_1(w);
@@ -3833,14 +4291,15 @@ int sc_isnonzero(const unsigned char *s) {
 }
 
 int ge_p3_is_point_at_infinity(const ge_p3 *p) {
-  // X = 0 and Y == Z
+  // X = 0, T = 0 and Y == Z; limbs are not unique, so compare encodings
+  unsigned char x[32], y[32], z[32], t[32];
+  unsigned char d = 0;
   int n;
-  for (n = 0; n < 10; ++n)
-  {
-    if (p->X[n] | p->T[n])
-      return 0;
-    if (p->Y[n] != p->Z[n])
-      return 0;
-  }
-  return 1;
+  fe_tobytes(x, p->X);
+  fe_tobytes(y, p->Y);
+  fe_tobytes(z, p->Z);
+  fe_tobytes(t, p->T);
+  for (n = 0; n < 32; ++n)
+    d |= x[n] | t[n] | (y[n] ^ z[n]);
+  return d == 0;
 }
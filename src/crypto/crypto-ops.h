@@ -32,8 +32,38 @@
 
 /* From fe.h */
 
+/*
+With 128-bit multiplies available, field elements are five unsigned limbs in
+radix 2^51 (as in curve25519-donna-c64) instead of ten signed ref10 limbs.
+FE_INIT takes a ref10 literal and folds it into whichever layout is in use;
+the folded limbs are offset by 2p so they stay non-negative.
+*/
+
+#if !defined(CRYPTO_OPS_NO_FE64) && defined(__SIZEOF_INT128__)
+
+#define CRYPTO_OPS_FE64 1
+#define FE_LIMBS 5
+
+typedef uint64_t fe[5];
+
+#define FE_FOLD_(lo, hi, bias) \
+  ((uint64_t) ((int64_t) (lo) + (int64_t) (hi) * ((int64_t) 1 << 26) + (int64_t) (bias)))
+#define FE_INIT(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9) { \
+  FE_FOLD_(a0, a1, 0xfffffffffffda), FE_FOLD_(a2, a3, 0xffffffffffffe), \
+  FE_FOLD_(a4, a5, 0xffffffffffffe), FE_FOLD_(a6, a7, 0xffffffffffffe), \
+  FE_FOLD_(a8, a9, 0xffffffffffffe) }
+
+#else
+
+#define FE_LIMBS 10
+
 typedef int32_t fe[10];
 
+#define FE_INIT(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9) \
+  {a0, a1, a2, a3, a4, a5, a6, a7, a8, a9}
+
+#endif
+
 /* From ge.h */
 
 typedef struct {
@@ -121,6 +151,7 @@ void ge_scalarmult_base(ge_p3 *, const unsigned char *);
 /* From ge_tobytes.c */
 
 void ge_tobytes(unsigned char *, const ge_p2 *);
+void ge_tobytes_batch(unsigned char *, const ge_p2 *, size_t);
 
 /* From sc_reduce.c */
 
@@ -135,6 +166,8 @@ void ge_double_scalarmult_precomp_vartime(ge_p2 *, const unsigned char *, const
 void ge_double_scalarmult_precomp_vartime2(ge_p2 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
 void ge_double_scalarmult_precomp_vartime2_p3(ge_p3 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
 void ge_mul8(ge_p1p1 *, const ge_p2 *);
+void ge_scalarmult_base_precomp(ge_p3 *, const unsigned char *, const ge_precomp [32][8]);
+void ge_precomp_table_init(ge_precomp [32][8], const ge_p3 *);
 extern const fe fe_ma2;
 extern const fe fe_ma;
 extern const fe fe_fffb1;
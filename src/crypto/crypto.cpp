@@ -29,11 +29,13 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <unistd.h>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/shared_ptr.hpp>
@@ -198,6 +200,41 @@ namespace crypto {
     return true;
   }
 
+  static std::atomic<batch_backend*> g_batch_backend(NULL);
+
+  void set_batch_backend(batch_backend *backend) {
+    g_batch_backend.store(backend, std::memory_order_release);
+  }
+
+  batch_backend *get_batch_backend() {
+    return g_batch_backend.load(std::memory_order_acquire);
+  }
+
+  void crypto_ops::generate_key_derivations(const public_key *keys1, std::size_t count, const secret_key &key2, key_derivation *derivations, bool *results) {
+    batch_backend *backend = get_batch_backend();
+    if (backend && count >= backend->min_batch() && backend->generate_key_derivations(keys1, count, key2, derivations, results))
+      return;
+    std::vector<ge_p2> points(count);
+    std::vector<key_derivation> out(count);
+    assert(sc_check(&key2) == 0);
+    for (std::size_t i = 0; i < count; ++i) {
+      ge_p3 point;
+      ge_p1p1 point3;
+      results[i] = ge_frombytes_vartime(&point, &keys1[i]) == 0;
+      if (!results[i]) {
+        ge_p3_to_p2(&points[i], &ge_p3_identity);
+        continue;
+      }
+      ge_scalarmult(&points[i], &unwrap(key2), &point);
+      ge_mul8(&point3, &points[i]);
+      ge_p1p1_to_p2(&points[i], &point3);
+    }
+    ge_tobytes_batch(reinterpret_cast<unsigned char*>(out.data()), points.data(), count);
+    for (std::size_t i = 0; i < count; ++i)
+      if (results[i])
+        derivations[i] = out[i];
+  }
+
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
@@ -257,6 +294,35 @@ namespace crypto {
     return true;
   }
 
+  void crypto_ops::derive_subaddress_public_keys(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *derived_keys, bool *results) {
+    batch_backend *backend = get_batch_backend();
+    if (backend && count >= backend->min_batch() && backend->derive_subaddress_public_keys(out_keys, derivations, output_indices, count, derived_keys, results))
+      return;
+    std::vector<ge_p2> points(count);
+    std::vector<public_key> out(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      ec_scalar scalar;
+      ge_p3 point1;
+      ge_p3 point2;
+      ge_cached point3;
+      ge_p1p1 point4;
+      results[i] = ge_frombytes_vartime(&point1, &out_keys[i]) == 0;
+      if (!results[i]) {
+        ge_p3_to_p2(&points[i], &ge_p3_identity);
+        continue;
+      }
+      derivation_to_scalar(derivations[i], output_indices[i], scalar);
+      ge_scalarmult_base(&point2, &scalar);
+      ge_p3_to_cached(&point3, &point2);
+      ge_sub(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&points[i], &point4);
+    }
+    ge_tobytes_batch(reinterpret_cast<unsigned char*>(out.data()), points.data(), count);
+    for (std::size_t i = 0; i < count; ++i)
+      if (results[i])
+        derived_keys[i] = out[i];
+  }
+
   struct s_comm {
     hash h;
     ec_point key;
@@ -118,6 +118,8 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static void generate_key_derivations(const public_key *, std::size_t, const secret_key &, key_derivation *, bool *);
+    friend void generate_key_derivations(const public_key *, std::size_t, const secret_key &, key_derivation *, bool *);
     static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
@@ -126,6 +128,8 @@ namespace crypto {
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static bool derive_subaddress_public_key(const public_key &, const key_derivation &, std::size_t, public_key &);
     friend bool derive_subaddress_public_key(const public_key &, const key_derivation &, std::size_t, public_key &);
+    static void derive_subaddress_public_keys(const public_key *, const key_derivation *, const std::size_t *, std::size_t, public_key *, bool *);
+    friend void derive_subaddress_public_keys(const public_key *, const key_derivation *, const std::size_t *, std::size_t, public_key *, bool *);
     static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
     friend void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
     static bool check_signature(const hash &, const public_key &, const signature &);
@@ -219,6 +223,12 @@ namespace crypto {
   inline bool generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
     return crypto_ops::generate_key_derivation(key1, key2, derivation);
   }
+  /* Batched generate_key_derivation with the same secret key: results[i] is what the single call
+   * would have returned for keys1[i], and derivations[i] is only written when it is true.
+   */
+  inline void generate_key_derivations(const public_key *keys1, std::size_t count, const secret_key &key2, key_derivation *derivations, bool *results) {
+    crypto_ops::generate_key_derivations(keys1, count, key2, derivations, results);
+  }
   inline bool derive_public_key(const key_derivation &derivation, std::size_t output_index,
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
@@ -233,6 +243,29 @@ namespace crypto {
   inline bool derive_subaddress_public_key(const public_key &out_key, const key_derivation &derivation, std::size_t output_index, public_key &result) {
     return crypto_ops::derive_subaddress_public_key(out_key, derivation, output_index, result);
   }
+  /* Batched derive_subaddress_public_key, with the same conventions as generate_key_derivations.
+   */
+  inline void derive_subaddress_public_keys(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *derived_keys, bool *results) {
+    crypto_ops::derive_subaddress_public_keys(out_keys, derivations, output_indices, count, derived_keys, results);
+  }
+
+  /* Optional accelerator (e.g. an OpenCL or CUDA build linked in by the application) for the
+   * two batched calls above. It is only handed batches of at least min_batch() entries, must
+   * produce bit-identical results to the CPU path (tests/crypto checks a registered backend
+   * against the test vectors), and may return false, before writing any output, to have a batch computed on the CPU.
+   */
+  class batch_backend {
+  public:
+    virtual ~batch_backend() {}
+    virtual const char *name() const = 0;
+    virtual std::size_t min_batch() const = 0;
+    virtual bool generate_key_derivations(const public_key *keys1, std::size_t count, const secret_key &key2, key_derivation *derivations, bool *results) = 0;
+    virtual bool derive_subaddress_public_keys(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *derived_keys, bool *results) = 0;
+  };
+  /* The backend is not owned; pass NULL to go back to the CPU path. It must outlive its use.
+   */
+  void set_batch_backend(batch_backend *backend);
+  batch_backend *get_batch_backend();
 
   /* Generation and checking of a standard signature.
    */
@@ -55,3 +55,7 @@ void cn_fast_hash(const void *data, size_t length, char *hash) {
   hash_process(&state, data, length);
   memcpy(hash, &state, HASH_SIZE);
 }
+
+void cn_fast_hash_many(const void *data, size_t length, size_t count, char *hashes) {
+  keccak_many(data, length, count, (uint8_t*)hashes);
+}
@@ -71,6 +71,11 @@ namespace crypto {
     return h;
   }
 
+  // hashes count consecutive inputs of length bytes each
+  inline void cn_fast_hash_many(const void *data, std::size_t length, std::size_t count, hash *hashes) {
+    cn_fast_hash_many(data, length, count, reinterpret_cast<char *>(hashes));
+  }
+
   inline void cn_slow_hash(const void *data, std::size_t length, hash &hash, int variant = 0, uint64_t height = 0) {
     cn_slow_hash(data, length, reinterpret_cast<char *>(&hash), variant, 0/*prehashed*/, height);
   }
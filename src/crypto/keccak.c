@@ -84,6 +84,70 @@ void keccakf(uint64_t st[25], int rounds)
     }
 }
 
+// update four interleaved states, st[i][k] being word i of state k;
+// the lanes map onto AVX2, SSE2 or NEON registers depending on the target
+
+#if defined(__GNUC__)
+typedef uint64_t keccak_x4_t __attribute__((vector_size(32)));
+#endif
+
+void keccakf_x4(uint64_t st[25][4], int rounds)
+{
+#if defined(__GNUC__)
+    int i, j, round;
+    keccak_x4_t s[25], t, bc[5];
+
+    memcpy(s, st, sizeof(s));
+
+    for (round = 0; round < rounds; round++) {
+
+        // Theta
+        for (i = 0; i < 5; i++)
+            bc[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
+
+        for (i = 0; i < 5; i++) {
+            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
+            for (j = 0; j < 25; j += 5)
+                s[j + i] ^= t;
+        }
+
+        // Rho Pi
+        t = s[1];
+        for (i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            bc[0] = s[j];
+            s[j] = ROTL64(t, keccakf_rotc[i]);
+            t = bc[0];
+        }
+
+        //  Chi
+        for (j = 0; j < 25; j += 5) {
+            for (i = 0; i < 5; i++)
+                bc[i] = s[j + i];
+            for (i = 0; i < 5; i++)
+                s[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        //  Iota
+        t = (keccak_x4_t){keccakf_rndc[round], keccakf_rndc[round], keccakf_rndc[round], keccakf_rndc[round]};
+        s[0] ^= t;
+    }
+
+    memcpy(st, s, sizeof(s));
+#else
+    uint64_t one[25];
+    int i, k;
+
+    for (k = 0; k < 4; k++) {
+        for (i = 0; i < 25; i++)
+            one[i] = st[i][k];
+        keccakf(one, rounds);
+        for (i = 0; i < 25; i++)
+            st[i][k] = one[i];
+    }
+#endif
+}
+
 // compute a keccak hash (md) of given byte length from "in"
 typedef uint64_t state_t[25];
 
@@ -138,6 +202,55 @@ void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md)
     keccak(in, inlen, md, sizeof(state_t));
 }
 
+// compute the 32 byte hashes of count consecutive inputs of inlen bytes each,
+// four at a time; md may alias in as long as inlen >= 32
+
+void keccak_many(const uint8_t *in, size_t inlen, size_t count, uint8_t *md)
+{
+    uint64_t st[25][4], w;
+    uint8_t temp[4][HASH_DATA_AREA];
+    size_t n, k, i, off, rest;
+    const size_t rsizw = HASH_DATA_AREA / 8;
+
+    for (n = 0; n + 4 <= count; n += 4, in += 4 * inlen, md += 4 * 32) {
+        memset(st, 0, sizeof(st));
+
+        for (off = 0; inlen - off >= HASH_DATA_AREA; off += HASH_DATA_AREA) {
+            for (k = 0; k < 4; k++) {
+                for (i = 0; i < rsizw; i++) {
+                    memcpy(&w, in + k * inlen + off + i * 8, 8);
+                    st[i][k] ^= swap64le(w);
+                }
+            }
+            keccakf_x4(st, KECCAK_ROUNDS);
+        }
+
+        // last block and padding
+        rest = inlen - off;
+        for (k = 0; k < 4; k++) {
+            memcpy(temp[k], in + k * inlen + off, rest);
+            temp[k][rest] = 1;
+            memset(temp[k] + rest + 1, 0, HASH_DATA_AREA - rest - 1);
+            temp[k][HASH_DATA_AREA - 1] |= 0x80;
+            for (i = 0; i < rsizw; i++) {
+                memcpy(&w, temp[k] + i * 8, 8);
+                st[i][k] ^= swap64le(w);
+            }
+        }
+        keccakf_x4(st, KECCAK_ROUNDS);
+
+        for (k = 0; k < 4; k++) {
+            for (i = 0; i < 4; i++) {
+                w = swap64le(st[i][k]);
+                memcpy(md + k * 32 + i * 8, &w, 8);
+            }
+        }
+    }
+
+    for (; n < count; n++, in += inlen, md += 32)
+        keccak(in, inlen, md, 32);
+}
+
 #define KECCAK_FINALIZED 0x80000000
 #define KECCAK_BLOCKLEN 136
 #define KECCAK_WORDS 17
@@ -32,6 +32,12 @@ void keccak(const uint8_t *in, size_t inlen, uint8_t *md, int mdlen);
 // update the state
 void keccakf(uint64_t st[25], int norounds);
 
+// update four interleaved states, st[i][k] being word i of state k
+void keccakf_x4(uint64_t st[25][4], int norounds);
+
+// compute 32-byte keccak hashes of count consecutive inputs of inlen bytes each
+void keccak_many(const uint8_t *in, size_t inlen, size_t count, uint8_t *md);
+
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
 
 void keccak_init(KECCAK_CTX * ctx);
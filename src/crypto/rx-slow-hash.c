@@ -35,6 +35,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 #include "randomx.h"
 #include "c_threads.h"
@@ -56,14 +59,41 @@ typedef struct rx_state {
   randomx_cache *rs_cache;
 } rx_state;
 
+/* with --mining-numa-datasets miners keep one full dataset per NUMA node so
+ * that hashing never reads remote memory; nodes past the last slot share the
+ * last dataset. Otherwise every miner uses node 0's */
+#define RX_MAX_NUMA_NODES	8
+
 static CTHR_MUTEX_TYPE rx_mutex = CTHR_MUTEX_INIT;
-static CTHR_MUTEX_TYPE rx_dataset_mutex = CTHR_MUTEX_INIT;
+static CTHR_MUTEX_TYPE rx_dataset_mutex[RX_MAX_NUMA_NODES] = {
+  CTHR_MUTEX_INIT, CTHR_MUTEX_INIT, CTHR_MUTEX_INIT, CTHR_MUTEX_INIT,
+  CTHR_MUTEX_INIT, CTHR_MUTEX_INIT, CTHR_MUTEX_INIT, CTHR_MUTEX_INIT
+};
 
 static rx_state rx_s[2] = {{CTHR_MUTEX_INIT,{0},0,0},{CTHR_MUTEX_INIT,{0},0,0}};
 
-static randomx_dataset *rx_dataset;
-static uint64_t rx_dataset_height;
+/* alt blocks get caches of their own, least recently used first out, so a
+ * few competing alt seeds neither thrash one shared cache nor evict the
+ * mainchain seeds (including the one rx_prepare_seed built) */
+#define RX_ALT_SEEDS	4
+
+static rx_state rx_alt_s[RX_ALT_SEEDS] = {
+  {CTHR_MUTEX_INIT,{0},0,0}, {CTHR_MUTEX_INIT,{0},0,0},
+  {CTHR_MUTEX_INIT,{0},0,0}, {CTHR_MUTEX_INIT,{0},0,0}
+};
+static uint64_t rx_alt_used[RX_ALT_SEEDS];
+static uint64_t rx_alt_clock;
+
+static randomx_dataset *rx_dataset[RX_MAX_NUMA_NODES];
+static uint64_t rx_dataset_height[RX_MAX_NUMA_NODES];
 static THREADV randomx_vm *rx_vm = NULL;
+static THREADV int rx_numa_node = 0;
+
+#ifdef __linux__
+/* cpus of each node, set by the miner; dataset init threads run there */
+static cpu_set_t rx_node_cpus[RX_MAX_NUMA_NODES];
+static int rx_node_cpu_count[RX_MAX_NUMA_NODES];
+#endif
 
 static void local_abort(const char *msg)
 {
@@ -116,15 +146,19 @@ static inline int enabled_flags(void) {
 #define SEEDHASH_EPOCH_LAG		64
 
 void rx_reorg(const uint64_t split_height) {
-  int i;
+  int i, j;
   CTHR_MUTEX_LOCK(rx_mutex);
   for (i=0; i<2; i++) {
     if (split_height <= rx_s[i].rs_height) {
-      if (rx_s[i].rs_height == rx_dataset_height)
-        rx_dataset_height = 1;
+      for (j=0; j<RX_MAX_NUMA_NODES; j++)
+        if (rx_s[i].rs_height == rx_dataset_height[j])
+          rx_dataset_height[j] = 1;
       rx_s[i].rs_height = 1;	/* set to an invalid seed height */
     }
   }
+  for (i=0; i<RX_ALT_SEEDS; i++)
+    if (split_height <= rx_alt_s[i].rs_height)
+      rx_alt_s[i].rs_height = 1;
   CTHR_MUTEX_UNLOCK(rx_mutex);
 }
 
@@ -141,17 +175,31 @@ void rx_seedheights(const uint64_t height, uint64_t *seedheight, uint64_t *nexth
 
 typedef struct seedinfo {
   randomx_cache *si_cache;
+  randomx_dataset *si_dataset;
+  int si_node;
   unsigned long si_start;
   unsigned long si_count;
 } seedinfo;
 
 static CTHR_THREAD_RTYPE rx_seedthread(void *arg) {
   seedinfo *si = arg;
-  randomx_init_dataset(rx_dataset, si->si_cache, si->si_start, si->si_count);
+#ifdef __linux__
+  /* the pages are placed on the node of the thread first touching them, and
+   * the spawning miner thread may be pinned to a single core of that node */
+  if (rx_node_cpu_count[si->si_node])
+    sched_setaffinity(0, sizeof(cpu_set_t), &rx_node_cpus[si->si_node]);
+#endif
+  randomx_init_dataset(si->si_dataset, si->si_cache, si->si_start, si->si_count);
   CTHR_THREAD_RETURN;
 }
 
-static void rx_initdata(randomx_cache *rs_cache, const int miners, const uint64_t seedheight) {
+/* caller must hold rx_dataset_mutex[node] */
+static void rx_initdata(const int node, randomx_cache *rs_cache, int miners, const uint64_t seedheight) {
+  randomx_dataset *dataset = rx_dataset[node];
+#ifdef __linux__
+  if (rx_node_cpu_count[node] && miners > rx_node_cpu_count[node])
+    miners = rx_node_cpu_count[node];
+#endif
   if (miners > 1) {
     unsigned long delta = randomx_dataset_item_count() / miners;
     unsigned long start = 0;
@@ -168,26 +216,153 @@ static void rx_initdata(randomx_cache *rs_cache, const int miners, const uint64_
     }
     for (i=0; i<miners-1; i++) {
       si[i].si_cache = rs_cache;
+      si[i].si_dataset = dataset;
+      si[i].si_node = node;
       si[i].si_start = start;
       si[i].si_count = delta;
       start += delta;
     }
     si[i].si_cache = rs_cache;
+    si[i].si_dataset = dataset;
+    si[i].si_node = node;
     si[i].si_start = start;
     si[i].si_count = randomx_dataset_item_count() - start;
     for (i=1; i<miners; i++) {
       CTHR_THREAD_CREATE(st[i], rx_seedthread, &si[i]);
     }
-    randomx_init_dataset(rx_dataset, rs_cache, 0, si[0].si_count);
+    randomx_init_dataset(dataset, rs_cache, 0, si[0].si_count);
     for (i=1; i<miners; i++) {
       CTHR_THREAD_JOIN(st[i]);
     }
     free(st);
     free(si);
   } else {
-    randomx_init_dataset(rx_dataset, rs_cache, 0, randomx_dataset_item_count());
+    randomx_init_dataset(dataset, rs_cache, 0, randomx_dataset_item_count());
+  }
+  rx_dataset_height[node] = seedheight;
+}
+
+/* caller must hold rx_dataset_mutex[node]. Large pages come in the kernel's
+ * default huge page size, so the dataset sits on 1G pages when hugepagesz=1G */
+static randomx_dataset *rx_alloc_dataset(const int node, randomx_cache *rs_cache, const int miners, const uint64_t seedheight) {
+  if (rx_dataset[node] == NULL) {
+    rx_dataset[node] = randomx_alloc_dataset(RANDOMX_FLAG_LARGE_PAGES);
+    if (rx_dataset[node] == NULL) {
+      mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX dataset");
+      rx_dataset[node] = randomx_alloc_dataset(RANDOMX_FLAG_DEFAULT);
+    }
+    if (rx_dataset[node] != NULL)
+      rx_initdata(node, rs_cache, miners, seedheight);
+  }
+  return rx_dataset[node];
+}
+
+void rx_set_miner_numa_node(int node, const int *cpus, size_t cpu_count) {
+  if (node < 0)
+    node = 0;
+  if (node >= RX_MAX_NUMA_NODES)
+    node = RX_MAX_NUMA_NODES - 1;
+  rx_numa_node = node;
+#ifdef __linux__
+  CTHR_MUTEX_LOCK(rx_dataset_mutex[node]);
+  if (!rx_node_cpu_count[node] && cpus && cpu_count) {
+    size_t i;
+    CPU_ZERO(&rx_node_cpus[node]);
+    for (i=0; i<cpu_count; i++)
+      if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+        CPU_SET(cpus[i], &rx_node_cpus[node]);
+    rx_node_cpu_count[node] = CPU_COUNT(&rx_node_cpus[node]);
+  }
+  CTHR_MUTEX_UNLOCK(rx_dataset_mutex[node]);
+#else
+  (void)cpus;
+  (void)cpu_count;
+#endif
+}
+
+/* caller must hold rx_sp->rs_mutex */
+static void rx_initcache(rx_state *rx_sp, randomx_flags flags, const uint64_t seedheight, const char *seedhash) {
+  randomx_cache *cache = rx_sp->rs_cache;
+  if (cache == NULL) {
+    cache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
+    if (cache == NULL) {
+      mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX cache");
+      cache = randomx_alloc_cache(flags);
+    }
+    if (cache == NULL)
+      local_abort("Couldn't allocate RandomX cache");
+  }
+  if (rx_sp->rs_height != seedheight || rx_sp->rs_cache == NULL || memcmp(seedhash, rx_sp->rs_hash, HASH_SIZE)) {
+    randomx_init_cache(cache, seedhash, HASH_SIZE);
+    rx_sp->rs_cache = cache;
+    rx_sp->rs_height = seedheight;
+    memcpy(rx_sp->rs_hash, seedhash, HASH_SIZE);
+  }
+}
+
+typedef struct seedprep {
+  uint64_t sp_height;
+  char sp_hash[HASH_SIZE];
+} seedprep;
+
+static CTHR_MUTEX_TYPE rx_prep_mutex = CTHR_MUTEX_INIT;
+static CTHR_THREAD_TYPE rx_prep_thread;
+static int rx_prep_started;
+static seedprep rx_prep_seed;
+
+static CTHR_THREAD_RTYPE rx_prepthread(void *arg) {
+  seedprep *sp = arg;
+  randomx_flags flags = enabled_flags() & ~disabled_flags();
+  /* same slot selection as rx_slow_hash uses for this seed on the mainchain */
+  rx_state *rx_sp = &rx_s[(sp->sp_height & SEEDHASH_EPOCH_BLOCKS) != 0];
+  CTHR_MUTEX_LOCK(rx_sp->rs_mutex);
+  rx_initcache(rx_sp, flags, sp->sp_height, sp->sp_hash);
+  CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
+  CTHR_THREAD_RETURN;
+}
+
+/* Build the cache for the upcoming seed in the background, so hashing does
+ * not stall on it when the mainchain reaches the epoch switch */
+void rx_prepare_seed(const uint64_t seedheight, const char *seedhash) {
+  CTHR_MUTEX_LOCK(rx_prep_mutex);
+  if (rx_prep_started) {
+    if (rx_prep_seed.sp_height == seedheight && !memcmp(rx_prep_seed.sp_hash, seedhash, HASH_SIZE)) {
+      CTHR_MUTEX_UNLOCK(rx_prep_mutex);
+      return;
+    }
+    CTHR_THREAD_JOIN(rx_prep_thread);
+    rx_prep_started = 0;
+  }
+  rx_prep_seed.sp_height = seedheight;
+  memcpy(rx_prep_seed.sp_hash, seedhash, HASH_SIZE);
+  CTHR_THREAD_CREATE(rx_prep_thread, rx_prepthread, &rx_prep_seed);
+  rx_prep_started = 1;
+  CTHR_MUTEX_UNLOCK(rx_prep_mutex);
+}
+
+/* Wait for a background cache build to finish, before shutting down */
+void rx_prepare_seed_join(void) {
+  CTHR_MUTEX_LOCK(rx_prep_mutex);
+  if (rx_prep_started) {
+    CTHR_THREAD_JOIN(rx_prep_thread);
+    rx_prep_started = 0;
   }
-  rx_dataset_height = seedheight;
+  CTHR_MUTEX_UNLOCK(rx_prep_mutex);
+}
+
+/* caller must hold rx_mutex */
+static rx_state *rx_alt_slot(const uint64_t seedheight, const char *seedhash) {
+  int i, slot = 0;
+  for (i=0; i<RX_ALT_SEEDS; i++) {
+    if (rx_alt_s[i].rs_cache != NULL && rx_alt_s[i].rs_height == seedheight && !memcmp(rx_alt_s[i].rs_hash, seedhash, HASH_SIZE)) {
+      slot = i;
+      break;
+    }
+    if (rx_alt_used[i] < rx_alt_used[slot])
+      slot = i;
+  }
+  rx_alt_used[slot] = ++rx_alt_clock;
+  return &rx_alt_s[slot];
 }
 
 void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length,
@@ -213,30 +388,12 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
       toggle ^= 1;
   }
 
-  toggle ^= (is_alt != 0);
-
-  rx_sp = &rx_s[toggle];
+  rx_sp = is_alt ? rx_alt_slot(seedheight, seedhash) : &rx_s[toggle];
   CTHR_MUTEX_LOCK(rx_sp->rs_mutex);
   CTHR_MUTEX_UNLOCK(rx_mutex);
 
+  rx_initcache(rx_sp, flags, seedheight, seedhash);
   cache = rx_sp->rs_cache;
-  if (cache == NULL) {
-    if (cache == NULL) {
-      cache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
-      if (cache == NULL) {
-        mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX cache");
-        cache = randomx_alloc_cache(flags);
-      }
-      if (cache == NULL)
-        local_abort("Couldn't allocate RandomX cache");
-    }
-  }
-  if (rx_sp->rs_height != seedheight || rx_sp->rs_cache == NULL || memcmp(seedhash, rx_sp->rs_hash, HASH_SIZE)) {
-    randomx_init_cache(cache, seedhash, HASH_SIZE);
-    rx_sp->rs_cache = cache;
-    rx_sp->rs_height = seedheight;
-    memcpy(rx_sp->rs_hash, seedhash, HASH_SIZE);
-  }
   if (rx_vm == NULL) {
     if ((flags & RANDOMX_FLAG_JIT) && !miners) {
         flags |= RANDOMX_FLAG_SECURE & ~disabled_flags();
@@ -245,40 +402,39 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
       miners = 0;
     }
     if (miners) {
-      CTHR_MUTEX_LOCK(rx_dataset_mutex);
-      if (rx_dataset == NULL) {
-        rx_dataset = randomx_alloc_dataset(RANDOMX_FLAG_LARGE_PAGES);
-        if (rx_dataset == NULL) {
-          mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX dataset");
-          rx_dataset = randomx_alloc_dataset(RANDOMX_FLAG_DEFAULT);
-        }
-        if (rx_dataset != NULL)
-          rx_initdata(rx_sp->rs_cache, miners, seedheight);
+      CTHR_MUTEX_LOCK(rx_dataset_mutex[rx_numa_node]);
+      if (rx_alloc_dataset(rx_numa_node, rx_sp->rs_cache, miners, seedheight) == NULL && rx_numa_node != 0) {
+        /* no room for another copy, share the first node's dataset */
+        mwarning(RX_LOGCAT, "Couldn't allocate RandomX dataset for NUMA node %d, sharing node 0's", rx_numa_node);
+        CTHR_MUTEX_UNLOCK(rx_dataset_mutex[rx_numa_node]);
+        rx_numa_node = 0;
+        CTHR_MUTEX_LOCK(rx_dataset_mutex[rx_numa_node]);
+        rx_alloc_dataset(rx_numa_node, rx_sp->rs_cache, miners, seedheight);
       }
-      if (rx_dataset != NULL)
+      if (rx_dataset[rx_numa_node] != NULL)
         flags |= RANDOMX_FLAG_FULL_MEM;
       else {
         miners = 0;
         mwarning(RX_LOGCAT, "Couldn't allocate RandomX dataset for miner");
       }
-      CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
+      CTHR_MUTEX_UNLOCK(rx_dataset_mutex[rx_numa_node]);
     }
-    rx_vm = randomx_create_vm(flags | RANDOMX_FLAG_LARGE_PAGES, rx_sp->rs_cache, rx_dataset);
+    rx_vm = randomx_create_vm(flags | RANDOMX_FLAG_LARGE_PAGES, rx_sp->rs_cache, rx_dataset[rx_numa_node]);
     if(rx_vm == NULL) { //large pages failed
       mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX VM");
-      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, rx_dataset);
+      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, rx_dataset[rx_numa_node]);
     }
     if(rx_vm == NULL) {//fallback if everything fails
       flags = RANDOMX_FLAG_DEFAULT | (miners ? RANDOMX_FLAG_FULL_MEM : 0);
-      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, rx_dataset);
+      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, rx_dataset[rx_numa_node]);
     }
     if (rx_vm == NULL)
       local_abort("Couldn't allocate RandomX VM");
   } else if (miners) {
-    CTHR_MUTEX_LOCK(rx_dataset_mutex);
-    if (rx_dataset != NULL && rx_dataset_height != seedheight)
-      rx_initdata(cache, miners, seedheight);
-    CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
+    CTHR_MUTEX_LOCK(rx_dataset_mutex[rx_numa_node]);
+    if (rx_dataset[rx_numa_node] != NULL && rx_dataset_height[rx_numa_node] != seedheight)
+      rx_initdata(rx_numa_node, cache, miners, seedheight);
+    CTHR_MUTEX_UNLOCK(rx_dataset_mutex[rx_numa_node]);
   } else {
     /* this is a no-op if the cache hasn't changed */
     randomx_vm_set_cache(rx_vm, rx_sp->rs_cache);
@@ -303,11 +459,14 @@ void rx_slow_hash_free_state(void) {
 }
 
 void rx_stop_mining(void) {
-  CTHR_MUTEX_LOCK(rx_dataset_mutex);
-  if (rx_dataset != NULL) {
-    randomx_dataset *rd = rx_dataset;
-    rx_dataset = NULL;
-    randomx_release_dataset(rd);
+  int i;
+  for (i=0; i<RX_MAX_NUMA_NODES; i++) {
+    CTHR_MUTEX_LOCK(rx_dataset_mutex[i]);
+    if (rx_dataset[i] != NULL) {
+      randomx_dataset *rd = rx_dataset[i];
+      rx_dataset[i] = NULL;
+      randomx_release_dataset(rd);
+    }
+    CTHR_MUTEX_UNLOCK(rx_dataset_mutex[i]);
   }
-  CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
 }
@@ -54,6 +54,124 @@
 extern void aesb_single_round(const uint8_t *in, uint8_t *out, const uint8_t *expandedKey);
 extern void aesb_pseudo_round(const uint8_t *in, uint8_t *out, const uint8_t *expandedKey);
 
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(_MSC_VER)
+#define THREADV __declspec(thread)
+#else
+#define THREADV __thread
+#endif
+
+/*
+ * All the CryptoNight implementations below share one scratchpad per thread.
+ * It is allocated on first use and kept until cn_slow_hash_free_state is
+ * called from that thread, so repeated hashing (wallet key derivation,
+ * historical block validation) does not map and touch 2MB for every hash.
+ */
+THREADV uint8_t *hp_state = NULL;
+THREADV int hp_allocated = 0;
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+BOOL SetLockPagesPrivilege(HANDLE hProcess, BOOL bEnable)
+{
+    struct
+    {
+        DWORD count;
+        LUID_AND_ATTRIBUTES privilege[1];
+    } info;
+
+    HANDLE token;
+    if(!OpenProcessToken(hProcess, TOKEN_ADJUST_PRIVILEGES, &token))
+        return FALSE;
+
+    info.count = 1;
+    info.privilege[0].Attributes = bEnable ? SE_PRIVILEGE_ENABLED : 0;
+
+    if(!LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &(info.privilege[0].Luid)))
+        return FALSE;
+
+    if(!AdjustTokenPrivileges(token, FALSE, (PTOKEN_PRIVILEGES) &info, 0, NULL, NULL))
+        return FALSE;
+
+    if (GetLastError() != ERROR_SUCCESS)
+        return FALSE;
+
+    CloseHandle(token);
+
+    return TRUE;
+
+}
+#endif
+
+/**
+ * @brief allocate the 2MB scratch buffer using OS support for huge pages, if available
+ *
+ * This function tries to allocate the 2MB scratch buffer using a single
+ * 2MB "huge page" (instead of the usual 4KB page sizes) to reduce TLB misses
+ * during the random accesses to the scratch buffer.  This is one of the
+ * important speed optimizations needed to make CryptoNight faster.
+ *
+ * No parameters.  Updates a thread-local pointer, hp_state, to point to
+ * the allocated buffer.
+ */
+
+static void slow_hash_allocate_scratchpad(void)
+{
+    if(hp_state != NULL)
+        return;
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
+    hp_state = (uint8_t *) VirtualAlloc(hp_state, MEMORY, MEM_LARGE_PAGES |
+                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+  defined(__DragonFly__) || defined(__NetBSD__)
+    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANON, -1, 0);
+#else
+    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if(hp_state == MAP_FAILED)
+        hp_state = NULL;
+#endif
+    hp_allocated = 1;
+    if(hp_state == NULL)
+    {
+        hp_allocated = 0;
+        hp_state = (uint8_t *) malloc(MEMORY);
+    }
+}
+
+/**
+ *@brief frees the scratch buffer allocated by slow_hash_allocate_scratchpad
+ */
+
+static void slow_hash_free_scratchpad(void)
+{
+    if(hp_state == NULL)
+        return;
+
+    if(!hp_allocated)
+        free(hp_state);
+    else
+    {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        VirtualFree(hp_state, 0, MEM_RELEASE);
+#else
+        munmap(hp_state, MEMORY);
+#endif
+    }
+
+    hp_state = NULL;
+    hp_allocated = 0;
+}
+
 static void local_abort(const char *msg)
 {
   fprintf(stderr, "%s\n", msg);
@@ -437,12 +555,6 @@ static inline int use_v4_jit(void)
   _b1 = _b; \
   _b = _c; \
 
-#if defined(_MSC_VER)
-#define THREADV __declspec(thread)
-#else
-#define THREADV __thread
-#endif
-
 #pragma pack(push, 1)
 union cn_slow_hash_state
 {
@@ -455,8 +567,6 @@ union cn_slow_hash_state
 };
 #pragma pack(pop)
 
-THREADV uint8_t *hp_state = NULL;
-THREADV int hp_allocated = 0;
 THREADV v4_random_math_JIT_func hp_jitfunc = NULL;
 THREADV uint8_t *hp_jitfunc_memory = NULL;
 THREADV int hp_jitfunc_allocated = 0;
@@ -698,48 +808,9 @@ STATIC INLINE void aes_pseudo_round_xor(const uint8_t *in, uint8_t *out,
     }
 }
 
-#if defined(_MSC_VER) || defined(__MINGW32__)
-BOOL SetLockPagesPrivilege(HANDLE hProcess, BOOL bEnable)
-{
-    struct
-    {
-        DWORD count;
-        LUID_AND_ATTRIBUTES privilege[1];
-    } info;
-
-    HANDLE token;
-    if(!OpenProcessToken(hProcess, TOKEN_ADJUST_PRIVILEGES, &token))
-        return FALSE;
-
-    info.count = 1;
-    info.privilege[0].Attributes = bEnable ? SE_PRIVILEGE_ENABLED : 0;
-
-    if(!LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &(info.privilege[0].Luid)))
-        return FALSE;
-
-    if(!AdjustTokenPrivileges(token, FALSE, (PTOKEN_PRIVILEGES) &info, 0, NULL, NULL))
-        return FALSE;
-
-    if (GetLastError() != ERROR_SUCCESS)
-        return FALSE;
-
-    CloseHandle(token);
-
-    return TRUE;
-
-}
-#endif
 
 /**
- * @brief allocate the 2MB scratch buffer using OS support for huge pages, if available
- *
- * This function tries to allocate the 2MB scratch buffer using a single
- * 2MB "huge page" (instead of the usual 4KB page sizes) to reduce TLB misses
- * during the random accesses to the scratch buffer.  This is one of the
- * important speed optimizations needed to make CryptoNight faster.
- *
- * No parameters.  Updates a thread-local pointer, hp_state, to point to
- * the allocated buffer.
+ * @brief allocate the scratch buffer and the CryptonightR JIT code page for this thread
  */
 
 void cn_slow_hash_allocate_state(void)
@@ -747,28 +818,7 @@ void cn_slow_hash_allocate_state(void)
     if(hp_state != NULL)
         return;
 
-#if defined(_MSC_VER) || defined(__MINGW32__)
-    SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
-    hp_state = (uint8_t *) VirtualAlloc(hp_state, MEMORY, MEM_LARGE_PAGES |
-                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-#else
-#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
-  defined(__DragonFly__) || defined(__NetBSD__)
-    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANON, -1, 0);
-#else
-    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
-#endif
-    if(hp_state == MAP_FAILED)
-        hp_state = NULL;
-#endif
-    hp_allocated = 1;
-    if(hp_state == NULL)
-    {
-        hp_allocated = 0;
-        hp_state = (uint8_t *) malloc(MEMORY);
-    }
+    slow_hash_allocate_scratchpad();
 
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -809,16 +859,7 @@ void cn_slow_hash_free_state(void)
     if(hp_state == NULL)
         return;
 
-    if(!hp_allocated)
-        free(hp_state);
-    else
-    {
-#if defined(_MSC_VER) || defined(__MINGW32__)
-        VirtualFree(hp_state, 0, MEM_RELEASE);
-#else
-        munmap(hp_state, MEMORY);
-#endif
-    }
+    slow_hash_free_scratchpad();
 
     if(!hp_jitfunc_allocated)
         free(hp_jitfunc_memory);
@@ -831,8 +872,6 @@ void cn_slow_hash_free_state(void)
 #endif
     }
 
-    hp_state = NULL;
-    hp_allocated = 0;
     hp_jitfunc = NULL;
     hp_jitfunc_memory = NULL;
     hp_jitfunc_allocated = 0;
@@ -1011,14 +1050,12 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
 #elif !defined NO_AES && (defined(__arm__) || defined(__aarch64__))
 void cn_slow_hash_allocate_state(void)
 {
-  // Do nothing, this is just to maintain compatibility with the upgraded slow-hash.c
-  return;
+  slow_hash_allocate_scratchpad();
 }
 
 void cn_slow_hash_free_state(void)
 {
-  // As above
-  return;
+  slow_hash_free_scratchpad();
 }
 
 #if defined(__GNUC__)
@@ -1222,37 +1259,13 @@ STATIC INLINE void aes_pseudo_round_xor(const uint8_t *in, uint8_t *out, const u
 	}
 }
 
-#ifdef FORCE_USE_HEAP
-STATIC INLINE void* aligned_malloc(size_t size, size_t align)
-{
-    void *result;
-#ifdef _MSC_VER
-    result = _aligned_malloc(size, align);
-#else
-    if (posix_memalign(&result, align, size)) result = NULL;
-#endif
-    return result;
-}
-
-STATIC INLINE void aligned_free(void *ptr)
-{
-#ifdef _MSC_VER
-    _aligned_free(ptr);
-#else
-    free(ptr);
-#endif
-}
-#endif /* FORCE_USE_HEAP */
-
 void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int prehashed, uint64_t height)
 {
     RDATA_ALIGN16 uint8_t expandedKey[240];
 
-#ifndef FORCE_USE_HEAP
-    RDATA_ALIGN16 uint8_t local_hp_state[MEMORY];
-#else
-    uint8_t *local_hp_state = (uint8_t *)aligned_malloc(MEMORY,16);
-#endif
+    if(hp_state == NULL)
+        cn_slow_hash_allocate_state();
+    uint8_t *local_hp_state = hp_state;
 
     uint8_t text[INIT_SIZE_BYTE];
     RDATA_ALIGN16 uint64_t a[2];
@@ -1339,10 +1352,6 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
     memcpy(state.init, text, INIT_SIZE_BYTE);
     hash_permutation(&state.hs);
     extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
-
-#ifdef FORCE_USE_HEAP
-    aligned_free(local_hp_state);
-#endif
 }
 #else /* aarch64 && crypto */
 
@@ -1482,11 +1491,9 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
         hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein
     };
 
-#ifndef FORCE_USE_HEAP
-    uint8_t long_state[MEMORY];
-#else
-    uint8_t *long_state = (uint8_t *)malloc(MEMORY);
-#endif
+    if(hp_state == NULL)
+        cn_slow_hash_allocate_state();
+    uint8_t *long_state = hp_state;
 
     if (prehashed) {
         memcpy(&state.hs, data, length);
@@ -1571,9 +1578,6 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
     memcpy(state.init, text, INIT_SIZE_BYTE);
     hash_permutation(&state.hs);
     extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
-#ifdef FORCE_USE_HEAP
-    free(long_state);
-#endif
 }
 #endif /* !aarch64 || !crypto */
 
@@ -1584,14 +1588,12 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
 
 void cn_slow_hash_allocate_state(void)
 {
-  // Do nothing, this is just to maintain compatibility with the upgraded slow-hash.c
-  return;
+  slow_hash_allocate_scratchpad();
 }
 
 void cn_slow_hash_free_state(void)
 {
-  // As above
-  return;
+  slow_hash_free_scratchpad();
 }
 
 static void (*const extra_hashes[4])(const void *, size_t, char *) = {
@@ -1666,11 +1668,9 @@ union cn_slow_hash_state {
 #pragma pack(pop)
 
 void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int prehashed, uint64_t height) {
-#ifndef FORCE_USE_HEAP
-  uint8_t long_state[MEMORY];
-#else
-  uint8_t *long_state = (uint8_t *)malloc(MEMORY);
-#endif
+  if(hp_state == NULL)
+    cn_slow_hash_allocate_state();
+  uint8_t *long_state = hp_state;
 
   union cn_slow_hash_state state;
   uint8_t text[INIT_SIZE_BYTE];
@@ -1758,10 +1758,6 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int
   /*memcpy(hash, &state, 32);*/
   extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
   oaes_free((OAES_CTX **) &aes_ctx);
-
-#ifdef FORCE_USE_HEAP
-  free(long_state);
-#endif
 }
 
 #endif
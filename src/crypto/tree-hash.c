@@ -87,8 +87,6 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   } else if (count == 2) {
     cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
   } else {
-    size_t i, j;
-
     size_t cnt = tree_hash_cnt( count );
 
     char (*ints)[HASH_SIZE];
@@ -97,16 +95,12 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints[j]);
-    }
-    assert(i == count);
+    // each level hashes adjacent pairs, which the batch hasher does in place
+    cn_fast_hash_many(hashes[2 * cnt - count], 64, count - cnt, ints[2 * cnt - count]);
 
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints[i], 64, ints[j]);
-      }
+      cn_fast_hash_many(ints[0], 64, cnt, ints[0]);
     }
 
     cn_fast_hash(ints[0], 64, root_hash);
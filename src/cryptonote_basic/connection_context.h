@@ -42,7 +42,8 @@ namespace cryptonote
   cryptonote_connection_context() :
       m_state(state_before_handshake), m_remote_blockchain_height(0), m_last_response_height(0),
       m_last_request_time(boost::date_time::not_a_date_time), m_callback_request_count(0),
-      m_last_known_hash(crypto::null_hash), m_pruning_seed(0), m_anchor(false) {}
+      m_last_known_hash(crypto::null_hash), m_pruning_seed(0), m_anchor(false),
+      m_uptime_proofs_requested(false), m_uptime_proofs_pending(false), m_uptime_proofs_sent(false) {}
   cryptonote_connection_context(const cryptonote_connection_context&) = default;
 
   enum state {
@@ -63,6 +64,9 @@ namespace cryptonote
   crypto::hash m_last_known_hash;
   uint32_t m_pruning_seed;
   bool m_anchor;
+  bool m_uptime_proofs_requested;
+  bool m_uptime_proofs_pending; // requested, and not answered yet
+  bool m_uptime_proofs_sent;
 };
 
 
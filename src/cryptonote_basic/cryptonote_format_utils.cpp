@@ -108,17 +108,25 @@ namespace cryptonote
       ge_p1p1_to_p3(&A2, &tmp3);
       ge_p3_tobytes(&AB, &A2);
   }
+
 }
 
 namespace cryptonote
 {
+  //---------------------------------------------------------------
+  blobdata &get_hashing_buffer()
+  {
+    static thread_local blobdata buffer;
+    buffer.clear();
+    return buffer;
+  }
   //---------------------------------------------------------------
   void get_transaction_prefix_hash(const transaction_prefix& tx, crypto::hash& h)
   {
-    std::ostringstream s;
-    binary_archive<true> a(s);
+    blobdata &blob = get_hashing_buffer();
+    binary_archive<true> a(blob);
     ::serialization::serialize(a, const_cast<transaction_prefix&>(tx));
-    crypto::cn_fast_hash(s.str().data(), s.str().size(), h);
+    crypto::cn_fast_hash(blob.data(), blob.size(), h);
   }
   //---------------------------------------------------------------
   crypto::hash get_transaction_prefix_hash(const transaction_prefix& tx)
@@ -182,9 +190,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::strspan<uint8_t>(tx_blob));
     bool r = ::serialization::serialize(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     CHECK_AND_ASSERT_MES(expand_transaction_1(tx, false), false, "Failed to expand transaction data");
@@ -195,9 +201,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_base_from_blob(const blobdata& tx_blob, transaction& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::strspan<uint8_t>(tx_blob));
     bool r = tx.serialize_base(ba);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     CHECK_AND_ASSERT_MES(expand_transaction_1(tx, true), false, "Failed to expand transaction data");
@@ -207,9 +211,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_prefix_from_blob(const blobdata& tx_blob, transaction_prefix& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::strspan<uint8_t>(tx_blob));
     bool r = ::serialization::serialize_noeof(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction prefix from blob");
     return true;
@@ -217,9 +219,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash)
   {
-    std::stringstream ss;
-    ss << tx_blob;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::strspan<uint8_t>(tx_blob));
     bool r = ::serialization::serialize(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     CHECK_AND_ASSERT_MES(expand_transaction_1(tx, false), false, "Failed to expand transaction data");
@@ -409,10 +409,7 @@ namespace cryptonote
     }
     else
     {
-      std::ostringstream s;
-      binary_archive<true> a(s);
-      ::serialization::serialize(a, const_cast<transaction&>(tx));
-      blob_size = s.str().size();
+      blob_size = get_object_blobsize(tx);
     }
     return get_transaction_weight(tx, blob_size);
   }
@@ -454,9 +451,7 @@ namespace cryptonote
     if(tx_extra.empty())
       return true;
 
-    std::string extra_str(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size());
-    std::istringstream iss(extra_str);
-    binary_archive<false> ar(iss);
+    binary_archive<false> ar(epee::to_span(tx_extra));
 
     bool eof = false;
     while (!eof)
@@ -466,9 +461,9 @@ namespace cryptonote
       CHECK_AND_NO_ASSERT_MES_L1(r, false, "failed to deserialize extra field. extra = " << string_tools::buff_to_hex_nodelimer(std::string(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size())));
       tx_extra_fields.push_back(field);
 
-      std::ios_base::iostate state = iss.rdstate();
-      eof = (EOF == iss.peek());
-      iss.clear(state);
+      std::ios_base::iostate state = ar.stream().rdstate();
+      eof = (EOF == ar.stream().peek());
+      ar.stream().clear(state);
     }
     CHECK_AND_NO_ASSERT_MES_L1(::serialization::check_stream_state(ar), false, "failed to deserialize extra field. extra = " << string_tools::buff_to_hex_nodelimer(std::string(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size())));
 
@@ -500,9 +495,7 @@ namespace cryptonote
       return true;
     }
 
-    std::string extra_str(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size());
-    std::istringstream iss(extra_str);
-    binary_archive<false> ar(iss);
+    binary_archive<false> ar(epee::to_span(tx_extra));
 
     bool eof = false;
     size_t processed = 0;
@@ -518,11 +511,11 @@ namespace cryptonote
         break;
       }
       tx_extra_fields.push_back(field);
-      processed = iss.tellg();
+      processed = ar.stream().tellg();
 
-      std::ios_base::iostate state = iss.rdstate();
-      eof = (EOF == iss.peek());
-      iss.clear(state);
+      std::ios_base::iostate state = ar.stream().rdstate();
+      eof = (EOF == ar.stream().peek());
+      ar.stream().clear(state);
     }
     if (!::serialization::check_stream_state(ar))
     {
@@ -532,8 +525,8 @@ namespace cryptonote
     }
     MTRACE("Sorted " << processed << "/" << tx_extra.size());
 
-    std::ostringstream oss;
-    binary_archive<true> nar(oss);
+    std::string oss_str;
+    binary_archive<true> nar(oss_str);
 
     // sort by:
     if (!pick<tx_extra_pub_key>(nar, tx_extra_fields, TX_EXTRA_TAG_PUBKEY)) return false;
@@ -560,7 +553,6 @@ namespace cryptonote
       return false;
     }
 
-    std::string oss_str = oss.str();
     if (allow_partial && processed < tx_extra.size())
     {
       MDEBUG("Appending unparsed data");
@@ -649,12 +641,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   //---------------------------------------------------------------
   static bool add_tx_extra_field_to_tx_extra(std::vector<uint8_t>& tx_extra, tx_extra_field &field)
   {
-    std::ostringstream oss;
-    binary_archive<true> ar(oss);
+    std::string tx_extra_str;
+    binary_archive<true> ar(tx_extra_str);
     if (!::do_serialize(ar, field))
       return false;
 
-    std::string tx_extra_str = oss.str();
     size_t pos = tx_extra.size();
     tx_extra.resize(tx_extra.size() + tx_extra_str.size());
     memcpy(&tx_extra[pos], tx_extra_str.data(), tx_extra_str.size());
@@ -690,11 +681,10 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     tx_extra_field field = tx_extra_full_node_deregister{deregistration.block_height, deregistration.full_node_index, deregistration.votes};
 
-    std::ostringstream oss;
-    binary_archive<true> ar(oss);
+    std::string tx_extra_str;
+    binary_archive<true> ar(tx_extra_str);
     bool r = ::do_serialize(ar, field);
     CHECK_AND_ASSERT_MES(r, false, "failed to serialize tx extra fullnode deregister");
-    std::string tx_extra_str = oss.str();
     size_t pos = tx_extra.size();
     tx_extra.resize(tx_extra.size() + tx_extra_str.size());
     memcpy(&tx_extra[pos], tx_extra_str.data(), tx_extra_str.size());
@@ -711,6 +701,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
+    return get_full_node_pubkey_from_tx_extra(tx_extra_fields, pubkey);
+  }
+  //---------------------------------------------------------------
+  bool get_full_node_pubkey_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, crypto::public_key& pubkey)
+  {
     tx_extra_full_node_pubkey full_node_pubkey;
     bool result = find_tx_extra_field_by_type(tx_extra_fields, full_node_pubkey);
     if (!result)
@@ -728,6 +723,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
+    return get_tx_secret_key_from_tx_extra(tx_extra_fields, key);
+  }
+  //---------------------------------------------------------------
+  bool get_tx_secret_key_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, crypto::secret_key& key)
+  {
     tx_extra_tx_secret_key seckey;
     bool result = find_tx_extra_field_by_type(tx_extra_fields, seckey);
     if (!result)
@@ -745,7 +745,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
-
+    return get_tx_key_image_proofs_from_tx_extra(tx_extra_fields, proofs);
+  }
+  //---------------------------------------------------------------
+  bool get_tx_key_image_proofs_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_tx_key_image_proofs &proofs)
+  {
     bool result = find_tx_extra_field_by_type(tx_extra_fields, proofs);
     return result;
   }
@@ -762,7 +766,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
-
+    return get_tx_key_image_unlock_from_tx_extra(tx_extra_fields, unlock);
+  }
+  //---------------------------------------------------------------
+  bool get_tx_key_image_unlock_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_tx_key_image_unlock &unlock)
+  {
     bool result = find_tx_extra_field_by_type(tx_extra_fields, unlock);
     return result;
   }
@@ -779,6 +787,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
+    return get_full_node_contributor_from_tx_extra(tx_extra_fields, address);
+  }
+  //---------------------------------------------------------------
+  bool get_full_node_contributor_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, cryptonote::account_public_address& address)
+  {
     tx_extra_full_node_contributor contributor;
     bool result = find_tx_extra_field_by_type(tx_extra_fields, contributor);
     if (!result)
@@ -792,10 +805,57 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
+    return get_full_node_register_from_tx_extra(tx_extra_fields, registration);
+  }
+  //---------------------------------------------------------------
+  bool get_full_node_register_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_full_node_register &registration)
+  {
     bool result = find_tx_extra_field_by_type(tx_extra_fields, registration);
     return result && registration.m_public_spend_keys.size() == registration.m_public_view_keys.size();
   }
   //---------------------------------------------------------------
+  bool parse_article_from_nonce(const blobdata& extra_nonce, tx_extra_article_info& article)
+  {
+    // "ARTC" (sometimes doubled), then u8 title length, title, big endian u16
+    // content length, content, u8 publisher length, publisher
+    size_t pos = 0;
+    if (extra_nonce.size() >= 8 && extra_nonce.compare(0, 4, "ARTC") == 0 && extra_nonce.compare(4, 4, "ARTC") == 0)
+      pos = 8;
+    else if (extra_nonce.size() >= 4 && extra_nonce.compare(0, 4, "ARTC") == 0)
+      pos = 4;
+    else
+      return false;
+
+    if (pos >= extra_nonce.size()) return false;
+    const size_t title_len = static_cast<uint8_t>(extra_nonce[pos++]);
+    if (pos + title_len > extra_nonce.size()) return false;
+    article.title = extra_nonce.substr(pos, title_len);
+    pos += title_len;
+
+    if (pos + 2 > extra_nonce.size()) return false;
+    const size_t content_len = (static_cast<uint8_t>(extra_nonce[pos]) << 8) | static_cast<uint8_t>(extra_nonce[pos + 1]);
+    pos += 2;
+    if (pos + content_len > extra_nonce.size()) return false;
+    article.content = extra_nonce.substr(pos, content_len);
+    pos += content_len;
+
+    if (pos >= extra_nonce.size()) return false;
+    const size_t publisher_len = static_cast<uint8_t>(extra_nonce[pos++]);
+    if (pos + publisher_len > extra_nonce.size()) return false;
+    article.publisher = extra_nonce.substr(pos, publisher_len);
+    return true;
+  }
+  //---------------------------------------------------------------
+  bool get_article_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_article_info& article)
+  {
+    std::vector<tx_extra_field> tx_extra_fields;
+    parse_tx_extra(tx_extra, tx_extra_fields);
+    if (find_tx_extra_field_by_type(tx_extra_fields, article))
+      return true;
+    tx_extra_nonce extra_nonce;
+    return find_tx_extra_field_by_type(tx_extra_fields, extra_nonce) && parse_article_from_nonce(extra_nonce.nonce, article);
+  }
+  //---------------------------------------------------------------
   bool add_full_node_register_to_tx_extra(
       std::vector<uint8_t>& tx_extra,
       const std::vector<cryptonote::account_public_address>& addresses,
@@ -841,6 +901,11 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     std::vector<tx_extra_field> tx_extra_fields;
     parse_tx_extra(tx_extra, tx_extra_fields);
+    return get_full_node_deregister_from_tx_extra(tx_extra_fields, deregistration);
+  }
+  //---------------------------------------------------------------
+  bool get_full_node_deregister_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_full_node_deregister &deregistration)
+  {
     bool result = find_tx_extra_field_by_type(tx_extra_fields, deregistration);
     return result;
   }
@@ -861,11 +926,9 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   {
     if (tx_extra.empty())
       return true;
-    std::string extra_str(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size());
-    std::istringstream iss(extra_str);
-    binary_archive<false> ar(iss);
-    std::ostringstream oss;
-    binary_archive<true> newar(oss);
+    binary_archive<false> ar(epee::to_span(tx_extra));
+    std::string s;
+    binary_archive<true> newar(s);
 
     bool eof = false;
     while (!eof)
@@ -876,15 +939,12 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
       if (field.type() != type)
         ::do_serialize(newar, field);
 
-      std::ios_base::iostate state = iss.rdstate();
-      eof = (EOF == iss.peek());
-      iss.clear(state);
+      std::ios_base::iostate state = ar.stream().rdstate();
+      eof = (EOF == ar.stream().peek());
+      ar.stream().clear(state);
     }
     CHECK_AND_NO_ASSERT_MES_L1(::serialization::check_stream_state(ar), false, "failed to deserialize extra field. extra = " << string_tools::buff_to_hex_nodelimer(std::string(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size())));
-    tx_extra.clear();
-    std::string s = oss.str();
-    tx_extra.reserve(s.size());
-    std::copy(s.begin(), s.end(), std::back_inserter(tx_extra));
+    tx_extra.assign(s.begin(), s.end());
     return true;
   }
   //---------------------------------------------------------------
@@ -1246,14 +1306,14 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
     if (t.version == 1)
       return false;
     transaction &tt = const_cast<transaction&>(t);
-    std::stringstream ss;
-    binary_archive<true> ba(ss);
+    blobdata &blob = get_hashing_buffer();
+    binary_archive<true> ba(blob);
     const size_t inputs = t.vin.size();
     const size_t outputs = t.vout.size();
     const size_t mixin = t.vin.empty() ? 0 : t.vin[0].type() == typeid(txin_to_key) ? boost::get<txin_to_key>(t.vin[0]).key_offsets.size() - 1 : 0;
     bool r = tt.rct_signatures.p.serialize_rctsig_prunable(ba, t.rct_signatures.type, inputs, outputs, mixin);
     CHECK_AND_ASSERT_MES(r, false, "Failed to serialize rct signatures prunable");
-    cryptonote::get_blob_hash(ss.str(), res);
+    cryptonote::get_blob_hash(blob, res);
     return true;
   }
   //---------------------------------------------------------------
@@ -1279,13 +1339,13 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
 
     // base rct
     {
-      std::stringstream ss;
-      binary_archive<true> ba(ss);
+      blobdata &blob = get_hashing_buffer();
+      binary_archive<true> ba(blob);
       const size_t inputs = t.vin.size();
       const size_t outputs = t.vout.size();
       bool r = tt.rct_signatures.serialize_rctsig_base(ba, inputs, outputs);
       CHECK_AND_ASSERT_THROW_MES(r, "Failed to serialize rct signatures base");
-      cryptonote::get_blob_hash(ss.str(), hashes[1]);
+      cryptonote::get_blob_hash(blob, hashes[1]);
     }
 
     // prunable rct
@@ -1315,13 +1375,13 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
 
     // base rct
     {
-      std::stringstream ss;
-      binary_archive<true> ba(ss);
+      blobdata &blob = get_hashing_buffer();
+      binary_archive<true> ba(blob);
       const size_t inputs = t.vin.size();
       const size_t outputs = t.vout.size();
       bool r = tt.rct_signatures.serialize_rctsig_base(ba, inputs, outputs);
       CHECK_AND_ASSERT_MES(r, false, "Failed to serialize rct signatures base");
-      cryptonote::get_blob_hash(ss.str(), hashes[1]);
+      cryptonote::get_blob_hash(blob, hashes[1]);
     }
 
     // prunable rct
@@ -1422,7 +1482,9 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   //---------------------------------------------------------------
   blobdata get_block_hashing_blob(const block& b)
   {
-    blobdata blob = t_serializable_object_to_blob(static_cast<block_header>(b));
+    blobdata blob;
+    binary_archive<true> ba(blob);
+    ::serialization::serialize(ba, const_cast<block_header&>(static_cast<const block_header&>(b)));
     crypto::hash tree_root_hash = get_tx_tree_hash(b);
     blob.append(reinterpret_cast<const char*>(&tree_root_hash), sizeof(tree_root_hash));
     blob.append(tools::get_varint_data(b.tx_hashes.size()+1));
@@ -1484,9 +1546,7 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
   //---------------------------------------------------------------
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b)
   {
-    std::stringstream ss;
-    ss << b_blob;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::strspan<uint8_t>(b_blob));
     bool r = ::serialization::serialize(ba, b);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse block from blob");
     b.invalidate_hashes();
@@ -1494,6 +1554,37 @@ void add_data_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::string& dat
     return true;
   }
   //---------------------------------------------------------------
+  bool parse_and_validate_block_from_blob(const epee::span<const uint8_t> &b_blob, block& b)
+  {
+    binary_archive<false> ba(b_blob);
+    bool r = ::serialization::serialize(ba, b);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to parse block from blob");
+    b.invalidate_hashes();
+    b.miner_tx.invalidate_hashes();
+    return true;
+  }
+  //---------------------------------------------------------------
+  bool parse_block_header_view_from_blob(const epee::span<const uint8_t> &b_blob, block_header_view& v, bool with_miner_tx)
+  {
+    binary_archive<false> ba(b_blob);
+    v.tx_count = 0;
+    bool r = ::serialization::serialize_noeof(ba, static_cast<block_header&>(v));
+    CHECK_AND_ASSERT_MES(r, false, "Failed to parse block header from blob");
+    if (!with_miner_tx)
+      return true;
+
+    r = ::serialization::serialize_noeof(ba, v.miner_tx);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to parse miner tx from block blob");
+    v.miner_tx.invalidate_hashes();
+
+    size_t tx_count = 0;
+    ba.begin_array(tx_count);
+    CHECK_AND_ASSERT_MES(ba.stream().good() && tx_count <= ba.remaining_bytes() / sizeof(crypto::hash) && ba.remaining_bytes() == tx_count * sizeof(crypto::hash),
+        false, "Failed to parse tx hash list from block blob");
+    v.tx_count = tx_count;
+    return true;
+  }
+  //---------------------------------------------------------------
   blobdata block_to_blob(const block& b)
   {
     return t_serializable_object_to_blob(b);
@@ -37,6 +37,7 @@
 #include "include_base_utils.h"
 #include "crypto/crypto.h"
 #include "crypto/hash.h"
+#include "span.h"
 #include <unordered_map>
 
 namespace epee
@@ -57,6 +58,7 @@ namespace cryptonote
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash);
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx);
   bool parse_and_validate_tx_base_from_blob(const blobdata& tx_blob, transaction& tx);
+  bool expand_transaction_1(transaction &tx, bool base_only);
   bool is_v1_tx(const blobdata_ref& tx_blob);
   bool is_v1_tx(const blobdata& tx_blob);
 
@@ -85,14 +87,24 @@ namespace cryptonote
   bool get_full_node_deregister_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_full_node_deregister& deregistration);
   bool get_full_node_pubkey_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::public_key& pubkey);
   bool get_full_node_contributor_from_tx_extra(const std::vector<uint8_t>& tx_extra, cryptonote::account_public_address& address);
+  // Same as above on an already parsed tx_extra, for callers that need several fields of one tx
+  bool get_full_node_register_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_full_node_register& registration);
+  bool get_full_node_deregister_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_full_node_deregister& deregistration);
+  bool get_full_node_pubkey_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, crypto::public_key& pubkey);
+  bool get_full_node_contributor_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, cryptonote::account_public_address& address);
   bool add_full_node_register_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::vector<cryptonote::account_public_address>& addresses, uint64_t portions_for_operator, const std::vector<uint64_t>& portions, uint64_t expiration_timestamp, const crypto::signature& signature);
 
   bool get_tx_secret_key_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::secret_key& key);
+  bool get_tx_secret_key_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, crypto::secret_key& key);
   void add_tx_secret_key_to_tx_extra(std::vector<uint8_t>& tx_extra, const crypto::secret_key& key);
   bool get_tx_key_image_proofs_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_tx_key_image_proofs &proofs);
+  bool get_tx_key_image_proofs_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_tx_key_image_proofs &proofs);
   bool add_tx_key_image_proofs_to_tx_extra  (std::vector<uint8_t>& tx_extra, const tx_extra_tx_key_image_proofs& proofs);
   bool get_tx_key_image_unlock_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_tx_key_image_unlock &unlock);
+  bool get_tx_key_image_unlock_from_tx_extra(const std::vector<tx_extra_field>& tx_extra_fields, tx_extra_tx_key_image_unlock &unlock);
   bool add_tx_key_image_unlock_to_tx_extra(std::vector<uint8_t>& tx_extra, const tx_extra_tx_key_image_unlock& unlock);
+  bool parse_article_from_nonce(const blobdata& extra_nonce, tx_extra_article_info& article);
+  bool get_article_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_article_info& article);
 
   void add_full_node_winner_to_tx_extra(std::vector<uint8_t>& tx_extra, const crypto::public_key& winner);
   void add_full_node_pubkey_to_tx_extra(std::vector<uint8_t>& tx_extra, const crypto::public_key& pubkey);
@@ -125,6 +137,9 @@ namespace cryptonote
   bool generate_key_image_helper_precomp(const account_keys& ack, const crypto::public_key& out_key, const crypto::key_derivation& recv_derivation, size_t real_output_index, const subaddress_index& received_index, keypair& in_ephemeral, crypto::key_image& ki, hw::device &hwdev);
   void get_blob_hash(const blobdata& blob, crypto::hash& res);
   crypto::hash get_blob_hash(const blobdata& blob);
+  // an emptied per thread scratch blob for data that is serialized only to be
+  // hashed; it is reused by the next call, so do not hold it across calls here
+  blobdata &get_hashing_buffer();
   std::string short_hash_str(const crypto::hash& h);
 
   bool get_registration_hash(const std::vector<cryptonote::account_public_address>& addresses, uint64_t operator_portions, const std::vector<uint64_t>& portions, uint64_t expiration_timestamp, crypto::hash& hash);
@@ -143,6 +158,16 @@ namespace cryptonote
   bool get_block_hash(const block& b, crypto::hash& res);
   crypto::hash get_block_hash(const block& b);
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b);
+  bool parse_and_validate_block_from_blob(const epee::span<const uint8_t> &b_blob, block& b);
+  // a block's header and, optionally, its miner tx, read off the front of the
+  // block blob; the tx hash list is only counted, never materialized, and
+  // tx_count is only set when the miner tx was read
+  struct block_header_view: public block_header
+  {
+    transaction miner_tx;
+    size_t tx_count = 0;
+  };
+  bool parse_block_header_view_from_blob(const epee::span<const uint8_t> &b_blob, block_header_view& v, bool with_miner_tx);
   bool get_inputs_money_amount(const transaction& tx, uint64_t& money);
   uint64_t get_outs_money_amount(const transaction& tx);
   bool check_inputs_types_supported(const transaction& tx);
@@ -168,11 +193,9 @@ namespace cryptonote
   template<class t_object>
   bool t_serializable_object_to_blob(const t_object& to, blobdata& b_blob)
   {
-    std::stringstream ss;
-    binary_archive<true> ba(ss);
-    bool r = ::serialization::serialize(ba, const_cast<t_object&>(to));
-    b_blob = ss.str();
-    return r;
+    b_blob.clear();
+    binary_archive<true> ba(b_blob);
+    return ::serialization::serialize(ba, const_cast<t_object&>(to));
   }
   //---------------------------------------------------------------
   template<class t_object>
@@ -186,21 +209,25 @@ namespace cryptonote
   template<class t_object>
   bool get_object_hash(const t_object& o, crypto::hash& res)
   {
-    get_blob_hash(t_serializable_object_to_blob(o), res);
+    blobdata &bl = get_hashing_buffer();
+    t_serializable_object_to_blob(o, bl);
+    get_blob_hash(bl, res);
     return true;
   }
   //---------------------------------------------------------------
   template<class t_object>
   size_t get_object_blobsize(const t_object& o)
   {
-    blobdata b = t_serializable_object_to_blob(o);
-    return b.size();
+    binary_archive<true> ba;
+    ::serialization::serialize(ba, const_cast<t_object&>(o));
+    return ba.bytes_written();
   }
   //---------------------------------------------------------------
   template<class t_object>
   bool get_object_hash(const t_object& o, crypto::hash& res, size_t& blob_size)
   {
-    blobdata bl = t_serializable_object_to_blob(o);
+    blobdata &bl = get_hashing_buffer();
+    t_serializable_object_to_blob(o, bl);
     blob_size = bl.size();
     get_blob_hash(bl, res);
     return true;
@@ -170,27 +170,34 @@ namespace cryptonote {
 
   const difficulty_type max64bit(std::numeric_limits<std::uint64_t>::max());
   const boost::multiprecision::uint256_t max128bit(std::numeric_limits<boost::multiprecision::uint128_t>::max());
-  const boost::multiprecision::uint512_t max256bit(std::numeric_limits<boost::multiprecision::uint256_t>::max());
 
-#define FORCE_FULL_128_BITS
+  // adds a 64 bit word into r at position i, carrying upwards
+  static inline void add_word(uint64_t *r, size_t n, size_t i, uint64_t w) {
+    for (; w && i < n; ++i) {
+      r[i] += w;
+      w = r[i] < w;
+    }
+  }
 
   bool check_hash_128(const crypto::hash &hash, difficulty_type difficulty) {
-#ifndef FORCE_FULL_128_BITS
-    // fast check
-    if (difficulty >= max64bit && ((const uint64_t *) &hash)[3] > 0)
-      return false;
-#endif
-    // usual slow check
-    boost::multiprecision::uint512_t hashVal = 0;
-#ifdef FORCE_FULL_128_BITS
-    for(int i = 0; i < 4; i++) { // highest word is zero
-#else
-    for(int i = 1; i < 4; i++) { // highest word is zero
-#endif
-      hashVal <<= 64;
-      hashVal |= swap64le(((const uint64_t *) &hash)[3 - i]);
+    // the 256 x 128 bit product on 64 bit words, rather than going through
+    // a 512 bit multiprecision integer: the hash passes if the top two
+    // words of the product are zero
+    const uint64_t d[2] = {
+      (difficulty & max64bit).convert_to<uint64_t>(),
+      (difficulty >> 64).convert_to<uint64_t>()
+    };
+    uint64_t r[6] = {0, 0, 0, 0, 0, 0};
+    for (size_t i = 0; i < 4; ++i) {
+      const uint64_t h = swap64le(((const uint64_t *) &hash)[i]);
+      for (size_t j = 0; j < 2; ++j) {
+        uint64_t low, high;
+        mul(h, d[j], low, high);
+        add_word(r, 6, i + j, low);
+        add_word(r, 6, i + j + 1, high);
+      }
     }
-    return hashVal * difficulty <= max256bit;
+    return r[4] == 0 && r[5] == 0;
   }
 
   bool check_hash(const crypto::hash &hash, difficulty_type difficulty) {
@@ -233,6 +240,16 @@ namespace cryptonote {
     }
     difficulty_type total_work = cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin];
     assert(total_work > 0);
+#if defined(__SIZEOF_INT128__)
+    // native 128 bit arithmetic unless the product would overflow, which
+    // takes a total work far beyond anything a real chain accumulates
+    typedef unsigned __int128 u128;
+    const u128 work = ((u128)(total_work >> 64).convert_to<uint64_t>() << 64) | (total_work & max64bit).convert_to<uint64_t>();
+    if (work <= (~(u128)0 - (time_span - 1)) / target_seconds) {
+      const u128 res = (work * target_seconds + time_span - 1) / time_span;
+      return (difficulty_type((uint64_t)(res >> 64)) << 64) | (uint64_t)res;
+    }
+#endif
     boost::multiprecision::uint256_t res =  (boost::multiprecision::uint256_t(total_work) * target_seconds + time_span - 1) / time_span;
     if(res > max128bit)
       return 0; // to behave like previous implementation, may be better return max128bit?
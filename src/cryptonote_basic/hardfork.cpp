@@ -68,6 +68,13 @@ HardFork::HardFork(cryptonote::BlockchainDB &db, uint8_t original_version, time_
     throw "window_size needs to be strictly positive";
   if (default_threshold_percent > 100)
     throw "default_threshold_percent needs to be between 0 and 100";
+  publish_schedule();
+}
+
+void HardFork::publish_schedule()
+{
+  schedules.emplace_back(new schedule_t(heights));
+  schedule.store(schedules.back().get(), std::memory_order_release);
 }
 
 bool HardFork::add_fork(uint8_t version, uint64_t height, uint8_t threshold, time_t time)
@@ -88,6 +95,7 @@ bool HardFork::add_fork(uint8_t version, uint64_t height, uint8_t threshold, tim
   if (threshold > 100)
     return false;
   heights.push_back(hardfork_t(version, height, threshold, time));
+  publish_schedule();
   return true;
 }
 
@@ -138,7 +146,9 @@ bool HardFork::add(uint8_t block_version, uint8_t voting_version, uint64_t heigh
   if (!do_check(block_version, voting_version))
     return false;
 
-  db.set_hard_fork_version(height, heights[current_fork_index].version);
+  // a read only DB is a replica's, whose writer stores the version itself
+  if (!db.is_read_only())
+    db.set_hard_fork_version(height, heights[current_fork_index].version);
 
   voting_version = get_effective_version(voting_version);
 
@@ -171,7 +181,10 @@ void HardFork::init()
 
   // add a placeholder for the default version, to avoid special cases
   if (heights.empty())
+  {
     heights.push_back(hardfork_t(original_version, 0, 0, 0));
+    publish_schedule();
+  }
 
   versions.clear();
   for (size_t n = 0; n < 256; ++n)
@@ -201,7 +214,7 @@ bool HardFork::reorganize_from_block_height(uint64_t height)
   if (height >= db.height())
     return false;
 
-  bool stop_batch = db.batch_start();
+  bool stop_batch = !db.is_read_only() && db.batch_start();
 
   versions.clear();
 
@@ -358,31 +371,35 @@ uint8_t HardFork::get(uint64_t height) const
 
 uint8_t HardFork::get_current_version() const
 {
-  CRITICAL_REGION_LOCAL(lock);
-  return heights[current_fork_index].version;
+  // the index only grows past the schedule's end if a reader raced a
+  // publish, and schedules only ever grow
+  const schedule_t &s = get_schedule();
+  const uint32_t index = current_fork_index.load(std::memory_order_acquire);
+  return index < s.size() ? s[index].version : original_version;
 }
 
 uint8_t HardFork::get_ideal_version() const
 {
-  CRITICAL_REGION_LOCAL(lock);
-  return heights.back().version;
+  const schedule_t &s = get_schedule();
+  return s.empty() ? original_version : s.back().version;
 }
 
 uint8_t HardFork::get_ideal_version(uint64_t height) const
 {
-  CRITICAL_REGION_LOCAL(lock);
-  for (unsigned int n = heights.size() - 1; n > 0; --n) {
-    if (height >= heights[n].height) {
-      return heights[n].version;
-    }
-  }
-  return original_version;
+  // the first fork with a height above the given one; the entry before it
+  // is in effect, and the first entry stands for the original version
+  const schedule_t &s = get_schedule();
+  const auto it = std::upper_bound(s.begin(), s.end(), height, [](uint64_t h, const hardfork_t &hf) { return h < hf.height; });
+  if (it == s.begin() || it - 1 == s.begin())
+    return original_version;
+  return (it - 1)->version;
 }
 
 uint64_t HardFork::get_earliest_ideal_height_for_version(uint8_t version) const
 {
+  const schedule_t &s = get_schedule();
   uint64_t height = std::numeric_limits<uint64_t>::max();
-  for (auto i = heights.rbegin(); i != heights.rend(); ++i) {
+  for (auto i = s.rbegin(); i != s.rend(); ++i) {
     if (i->version >= version) {
       height = i->height;
     } else {
@@ -394,11 +411,11 @@ uint64_t HardFork::get_earliest_ideal_height_for_version(uint8_t version) const
 
 uint8_t HardFork::get_next_version() const
 {
-  CRITICAL_REGION_LOCAL(lock);
+  const schedule_t &s = get_schedule();
   uint64_t height = db.height();
-  for (auto i = heights.rbegin(); i != heights.rend(); ++i) {
+  for (auto i = s.rbegin(); i != s.rend(); ++i) {
     if (height >= i->height) {
-      return (i == heights.rbegin() ? i : (i - 1))->version;
+      return (i == s.rbegin() ? i : (i - 1))->version;
     }
   }
   return original_version;
@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include "syncobj.h"
 #include "hardforks/hardforks.h"
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -243,6 +245,10 @@ namespace cryptonote
     bool rescan_from_block_height(uint64_t height);
     bool rescan_from_chain_height(uint64_t height);
 
+    typedef std::vector<hardfork_t> schedule_t;
+    const schedule_t &get_schedule() const { return *schedule.load(std::memory_order_acquire); }
+    void publish_schedule();
+
   private:
 
     BlockchainDB &db;
@@ -257,7 +263,13 @@ namespace cryptonote
 
     std::deque<uint8_t> versions; /* rolling window of the last N blocks' versions */
     unsigned int last_versions[256]; /* count of the block versions in the last N blocks */
-    uint32_t current_fork_index;
+    std::atomic<uint32_t> current_fork_index; /* written under lock, read without */
+
+    // Immutable copy of heights for the version queries, which take no
+    // lock. add_fork publishes a new one; the ones replaced stay alive
+    // until destruction as readers may still hold them (a few per run).
+    std::atomic<const schedule_t*> schedule;
+    std::vector<std::unique_ptr<const schedule_t>> schedules;
 
     mutable epee::critical_section lock;
   };
@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include "lazy_transaction.h"
+#include "cryptonote_format_utils.h"
+#include "serialization/binary_archive.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "cn"
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------
+  bool lazy_transaction::parse(blobdata blob)
+  {
+    m_blob = std::move(blob);
+    m_tx.set_null();
+    m_prunable_offset = 0;
+    m_prunable_loaded = false;
+
+    binary_archive<false> ba(epee::strspan<uint8_t>(m_blob));
+    bool r = m_tx.serialize_base(ba);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
+    CHECK_AND_ASSERT_MES(expand_transaction_1(m_tx, true), false, "Failed to expand transaction data");
+    m_tx.invalidate_hashes();
+    m_prunable_offset = ba.stream().tellg();
+
+    // nothing left to decode: v2 txes without inputs or signatures are whole already
+    if (m_tx.version >= 2 && (m_tx.vin.empty() || m_tx.rct_signatures.type == rct::RCTTypeNull))
+    {
+      m_tx.pruned = false;
+      m_tx.set_blob_size(m_blob.size());
+      m_prunable_loaded = m_prunable_offset == m_blob.size();
+      CHECK_AND_ASSERT_MES(m_prunable_loaded, false, "Trailing data after transaction");
+    }
+    return true;
+  }
+  //---------------------------------------------------------------
+  bool lazy_transaction::load_prunable()
+  {
+    if (m_prunable_loaded)
+      return true;
+
+    if (m_tx.version == 1)
+    {
+      // v1 signatures are interleaved with the input count only, and are
+      // small next to the prefix, so just redo the whole thing
+      CHECK_AND_ASSERT_MES(parse_and_validate_tx_from_blob(m_blob, m_tx), false, "Failed to parse transaction from blob");
+      m_prunable_loaded = true;
+      return true;
+    }
+
+    binary_archive<false> ba(prunable_blob());
+    const size_t n_inputs = m_tx.vin.size(), n_outputs = m_tx.vout.size();
+    const size_t mixin = m_tx.vin[0].type() == typeid(txin_to_key) ? boost::get<txin_to_key>(m_tx.vin[0]).key_offsets.size() - 1 : 0;
+    rct::rctSig &rv = m_tx.rct_signatures;
+    bool r = rv.p.serialize_rctsig_prunable(ba, rv.type, n_inputs, n_outputs, mixin);
+    CHECK_AND_ASSERT_MES(r && ::serialization::check_stream_state(ba), false, "Failed to parse transaction prunable data from blob");
+    CHECK_AND_ASSERT_MES(expand_transaction_1(m_tx, false), false, "Failed to expand transaction data");
+    m_tx.pruned = false;
+    m_tx.set_blob_size(m_blob.size());
+    m_prunable_loaded = true;
+    return true;
+  }
+}
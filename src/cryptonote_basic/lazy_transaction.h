@@ -0,0 +1,67 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#pragma once
+
+#include "cryptonote_basic.h"
+#include "blobdatatype.h"
+#include "span.h"
+
+namespace cryptonote
+{
+  /*! \brief a transaction whose prunable data is decoded on first use
+   *
+   * parse() only deserializes the prefix and the rct base, and remembers where
+   * the prunable part starts in the blob. Scanning and indexing code only ever
+   * looks at those, so the bulletproofs and ring signatures (or the v1
+   * signatures) are left undecoded until load_prunable() is called.
+   */
+  class lazy_transaction
+  {
+  public:
+    lazy_transaction(): m_prunable_offset(0), m_prunable_loaded(false) {}
+
+    bool parse(blobdata blob);
+    bool load_prunable();
+
+    bool prunable_loaded() const { return m_prunable_loaded; }
+    const transaction &tx() const { return m_tx; }
+    transaction &tx() { return m_tx; }
+    const blobdata &blob() const { return m_blob; }
+    //! the prefix and rct base, as they'd be stored for a pruned tx
+    epee::span<const uint8_t> pruned_blob() const { return {reinterpret_cast<const uint8_t*>(m_blob.data()), m_prunable_offset}; }
+    epee::span<const uint8_t> prunable_blob() const { return {reinterpret_cast<const uint8_t*>(m_blob.data()) + m_prunable_offset, m_blob.size() - m_prunable_offset}; }
+
+  private:
+    blobdata m_blob;
+    transaction m_tx;
+    size_t m_prunable_offset;
+    bool m_prunable_loaded;
+  };
+}
@@ -57,6 +57,8 @@
   #include <TargetConditionals.h>
 #elif defined(__linux__)
   #include <unistd.h>
+  #include <pthread.h>
+  #include <sched.h>
   #include <sys/resource.h>
   #include <sys/times.h>
   #include <time.h>
@@ -94,6 +96,8 @@ namespace cryptonote
     const command_line::arg_descriptor<uint64_t>    arg_bg_mining_min_idle_interval_seconds =  {"bg-mining-min-idle-interval", "Specify min lookback interval in seconds for determining idle state", miner::BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS, true};
     const command_line::arg_descriptor<uint16_t>     arg_bg_mining_idle_threshold_percentage =  {"bg-mining-idle-threshold", "Specify minimum avg idle percentage over lookback interval", miner::BACKGROUND_MINING_DEFAULT_IDLE_THRESHOLD_PERCENTAGE, true};
     const command_line::arg_descriptor<uint16_t>     arg_bg_mining_miner_target_percentage =  {"bg-mining-miner-target", "Specify maximum percentage cpu use by miner(s)", miner::BACKGROUND_MINING_DEFAULT_MINING_TARGET_PERCENTAGE, true};
+    const command_line::arg_descriptor<bool>        arg_mining_no_thread_affinity =  {"mining-no-thread-affinity", "Do not pin mining threads to cores", false};
+    const command_line::arg_descriptor<bool>        arg_mining_numa_datasets =  {"mining-numa-datasets", "Keep a RandomX dataset (over 2 GB each) per NUMA node instead of one shared dataset", false};
   }
 
 
@@ -117,7 +121,9 @@ namespace cryptonote
     m_min_idle_seconds(BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS),
     m_idle_threshold(BACKGROUND_MINING_DEFAULT_IDLE_THRESHOLD_PERCENTAGE),
     m_mining_target(BACKGROUND_MINING_DEFAULT_MINING_TARGET_PERCENTAGE),
-    m_miner_extra_sleep(BACKGROUND_MINING_DEFAULT_MINER_EXTRA_SLEEP_MILLIS)
+    m_miner_extra_sleep(BACKGROUND_MINING_DEFAULT_MINER_EXTRA_SLEEP_MILLIS),
+    m_thread_affinity(true),
+    m_numa_datasets(false)
   {
 
   }
@@ -193,8 +199,11 @@ namespace cryptonote
   {
     if(m_last_hr_merge_time && is_mining())
     {
-      m_current_hash_rate = m_hashes * 1000 / ((misc_utils::get_tick_count() - m_last_hr_merge_time + 1));
+      const uint64_t elapsed = misc_utils::get_tick_count() - m_last_hr_merge_time + 1;
+      m_current_hash_rate = m_hashes * 1000 / elapsed;
       CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+      for (size_t i = 0; i < m_thread_hash_rates.size(); ++i)
+        m_thread_hash_rates[i] = m_thread_hashes[i].exchange(0) * 1000 / elapsed;
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
         m_last_hash_rates.pop_front();
@@ -221,6 +230,8 @@ namespace cryptonote
     command_line::add_arg(desc, arg_bg_mining_min_idle_interval_seconds);
     command_line::add_arg(desc, arg_bg_mining_idle_threshold_percentage);
     command_line::add_arg(desc, arg_bg_mining_miner_target_percentage);
+    command_line::add_arg(desc, arg_mining_no_thread_affinity);
+    command_line::add_arg(desc, arg_mining_numa_datasets);
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::init(const boost::program_options::variables_map& vm, network_type nettype)
@@ -277,6 +288,8 @@ namespace cryptonote
       set_idle_threshold( command_line::get_arg(vm, arg_bg_mining_idle_threshold_percentage) );
     if(command_line::has_arg(vm, arg_bg_mining_miner_target_percentage))
       set_mining_target( command_line::get_arg(vm, arg_bg_mining_miner_target_percentage) );
+    m_thread_affinity = !command_line::get_arg(vm, arg_mining_no_thread_affinity);
+    m_numa_datasets = command_line::get_arg(vm, arg_mining_numa_datasets);
 
     return true;
   }
@@ -319,6 +332,15 @@ namespace cryptonote
     boost::interprocess::ipcdetail::atomic_write32(&m_thread_index, 0);
     set_is_background_mining_enabled(do_background);
     set_ignore_battery(ignore_battery);
+
+    {
+      CRITICAL_REGION_LOCAL1(m_last_hash_rates_lock);
+      m_thread_hashes.reset(new std::atomic<uint64_t>[threads_count]);
+      for (size_t i = 0; i < threads_count; ++i)
+        m_thread_hashes[i] = 0;
+      m_thread_hash_rates.assign(threads_count, 0);
+    }
+    place_threads(threads_count);
     
     for(size_t i = 0; i != threads_count; i++)
     {
@@ -351,11 +373,20 @@ namespace cryptonote
     }
   }
   //-----------------------------------------------------------------------------------------------------
+  std::vector<uint64_t> miner::get_thread_speeds() const
+  {
+    if(!is_mining())
+      return {};
+    CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+    return m_thread_hash_rates;
+  }
+  //-----------------------------------------------------------------------------------------------------
   void miner::send_stop_signal()
   {
     boost::interprocess::ipcdetail::atomic_write32(&m_stop, 1);
   }
   extern "C" void rx_stop_mining(void);
+  extern "C" void rx_set_miner_numa_node(int node, const int *cpus, size_t cpu_count);
   //-----------------------------------------------------------------------------------------------------
   bool miner::stop()
   {
@@ -444,6 +475,20 @@ namespace cryptonote
     uint32_t th_local_index = boost::interprocess::ipcdetail::atomic_inc32(&m_thread_index);
     MLOG_SET_THREAD_NAME(std::string("[miner ") + std::to_string(th_local_index) + "]");
     MGINFO("Miner thread was started ["<< th_local_index << "]");
+    if (th_local_index < m_thread_placements.size())
+    {
+      const thread_placement &placement = m_thread_placements[th_local_index];
+      const std::vector<int> &node_cpus = m_numa_nodes[placement.numa_node];
+#if defined(__linux__)
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(placement.cpu, &cpus);
+      if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        MWARNING("Failed to pin miner thread " << th_local_index << " to cpu " << placement.cpu);
+#endif
+      rx_set_miner_numa_node(placement.numa_node, node_cpus.data(), node_cpus.size());
+      MDEBUG("Miner thread " << th_local_index << " runs on cpu " << placement.cpu << ", NUMA node " << placement.numa_node);
+    }
     uint32_t nonce = m_starter_nonce + th_local_index;
     uint64_t height = 0;
     difficulty_type local_diff = 0;
@@ -509,11 +554,122 @@ namespace cryptonote
       }
       nonce+=m_threads_total;
       ++m_hashes;
+      ++m_thread_hashes[th_local_index];
     }
     MGINFO("Miner thread stopped ["<< th_local_index << "]");
     return true;
   }
   //-----------------------------------------------------------------------------------------------------
+  void miner::place_threads(size_t threads_count)
+  {
+    m_numa_nodes.clear();
+    m_thread_placements.clear();
+    if (!m_thread_affinity || !get_numa_nodes(m_numa_nodes))
+      return;
+
+    m_thread_placements = plan_thread_placements(m_numa_nodes, threads_count, m_numa_datasets);
+    if (!m_numa_datasets && m_numa_nodes.size() > 1)
+    {
+      // a single dataset, built by threads on every node
+      std::vector<int> all_cpus;
+      for (const thread_placement &placement: interleave_numa_nodes(m_numa_nodes))
+        all_cpus.push_back(placement.cpu);
+      m_numa_nodes.assign(1, all_cpus);
+    }
+    MINFO("Placing " << threads_count << " mining threads, " << m_numa_nodes.size() << " RandomX dataset(s)");
+  }
+  //-----------------------------------------------------------------------------------------------------
+  std::vector<miner::thread_placement> miner::interleave_numa_nodes(const std::vector<std::vector<int>>& nodes)
+  {
+    // deal cpus out round robin across nodes, so that every node's memory
+    // bandwidth gets used before any node runs two threads per cpu
+    size_t max_node_cpus = 0;
+    for (const auto &node: nodes)
+      max_node_cpus = std::max(max_node_cpus, node.size());
+    std::vector<thread_placement> order;
+    for (size_t i = 0; i < max_node_cpus; ++i)
+      for (size_t node = 0; node < nodes.size(); ++node)
+        if (i < nodes[node].size())
+          order.push_back({nodes[node][i], node});
+    return order;
+  }
+  //-----------------------------------------------------------------------------------------------------
+  std::vector<miner::thread_placement> miner::plan_thread_placements(const std::vector<std::vector<int>>& nodes, size_t threads_count, bool numa_datasets)
+  {
+    std::vector<thread_placement> placements;
+    const std::vector<thread_placement> order = interleave_numa_nodes(nodes);
+    if (order.empty())
+      return placements;
+    for (size_t i = 0; i < threads_count; ++i)
+    {
+      placements.push_back(order[i % order.size()]);
+      // without per node datasets every thread hashes against node 0's
+      if (!numa_datasets)
+        placements.back().numa_node = 0;
+    }
+    return placements;
+  }
+  //-----------------------------------------------------------------------------------------------------
+  bool miner::get_numa_nodes(std::vector<std::vector<int>>& nodes)
+  {
+    nodes.clear();
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+      return false;
+
+    // node directories are not necessarily contiguous (memory only nodes, offline nodes)
+    std::map<int, std::vector<int>> node_cpus;
+    const std::string node_class_path = "/sys/devices/system/node";
+    if (boost::filesystem::is_directory(node_class_path))
+    {
+      const boost::filesystem::directory_iterator end_itr;
+      for (boost::filesystem::directory_iterator iter(node_class_path); iter != end_itr; ++iter)
+      {
+        const std::string name = iter->path().filename().string();
+        if (!boost::starts_with(name, "node") || name.size() == 4 || name.find_first_not_of("0123456789", 4) != std::string::npos)
+          continue;
+        std::ifstream cpulist_stream((iter->path() / "cpulist").string());
+        std::string cpulist;
+        if (cpulist_stream.fail() || !std::getline(cpulist_stream, cpulist))
+          continue;
+
+        // e.g. "0-7,16-23"
+        std::vector<std::string> ranges;
+        boost::split(ranges, cpulist, boost::is_any_of(","));
+        std::vector<int> &cpus = node_cpus[std::stoi(name.substr(4))];
+        for (const std::string &range: ranges)
+        {
+          int first, last;
+          const int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+          if (fields < 1)
+            continue;
+          if (fields == 1)
+            last = first;
+          for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            if (cpu >= 0 && CPU_ISSET(cpu, &allowed))
+              cpus.push_back(cpu);
+        }
+      }
+    }
+    for (auto &e: node_cpus)
+      if (!e.second.empty())
+        nodes.push_back(std::move(e.second));
+
+    if (nodes.empty())
+    {
+      nodes.emplace_back();
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &allowed))
+          nodes.back().push_back(cpu);
+    }
+    return !nodes.back().empty();
+#else
+    return false;
+#endif
+  }
+  //-----------------------------------------------------------------------------------------------------
   bool miner::get_is_background_mining_enabled() const
   {
     return m_is_background_mining_enabled;
@@ -33,6 +33,7 @@
 #include <boost/program_options.hpp>
 #include <boost/logic/tribool_fwd.hpp>
 #include <atomic>
+#include <memory>
 #include "cryptonote_basic.h"
 #include "difficulty.h"
 #include "math_helper.h"
@@ -67,6 +68,7 @@ namespace cryptonote
     bool on_block_chain_update();
     bool start(const account_public_address& adr, size_t threads_count, const boost::thread::attributes& attrs, bool do_background = false, bool ignore_battery = false);
     uint64_t get_speed() const;
+    std::vector<uint64_t> get_thread_speeds() const;
     uint32_t get_threads_count() const;
     void send_stop_signal();
     bool stop();
@@ -101,10 +103,22 @@ namespace cryptonote
     static constexpr uint64_t BACKGROUND_MINING_DEFAULT_MINER_EXTRA_SLEEP_MILLIS        = 400; // ramp up 
     static constexpr uint64_t BACKGROUND_MINING_MIN_MINER_EXTRA_SLEEP_MILLIS            = 5;
 
+    struct thread_placement
+    {
+      int cpu;
+      size_t numa_node;
+    };
+    // cpus of all nodes dealt out round robin, first cpu of each node first
+    static std::vector<thread_placement> interleave_numa_nodes(const std::vector<std::vector<int>>& nodes);
+    static std::vector<thread_placement> plan_thread_placements(const std::vector<std::vector<int>>& nodes, size_t threads_count, bool numa_datasets);
+
   private:
     bool worker_thread();
     bool request_block_template();
     void  merge_hr();
+
+    void place_threads(size_t threads_count);
+    static bool get_numa_nodes(std::vector<std::vector<int>>& nodes);
     
     struct miner_config
     {
@@ -141,8 +155,14 @@ namespace cryptonote
     std::atomic<uint64_t> m_last_hr_merge_time;
     std::atomic<uint64_t> m_hashes;
     std::atomic<uint64_t> m_current_hash_rate;
-    epee::critical_section m_last_hash_rates_lock;
+    mutable epee::critical_section m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_thread_hashes;
+    std::vector<uint64_t> m_thread_hash_rates;
+    bool m_thread_affinity;
+    bool m_numa_datasets;
+    std::vector<std::vector<int>> m_numa_nodes;
+    std::vector<thread_placement> m_thread_placements;
     bool m_do_print_hashrate;
     bool m_do_mining;
 
@@ -59,6 +59,7 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "common/alloc_profiler.h"
 #include "common/notify.h"
 #include "full_node_deregister.h"
 #include "full_node_list.h"
@@ -90,19 +91,47 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+// pools ask for a template per payout address, these share everything but the miner tx
+#define BLOCK_TEMPLATE_CACHE_SIZE 16
 
+// how deep a reorg by a replica's primary can be followed block by block,
+// deeper ones make the replica reinitialize its hooks
+#define REPLICA_BLOCK_HASHES_KEPT 720
+
+// bounds for the auto sync threshold, in bytes written between syncs
+#define DB_SYNC_AUTO_MIN_BYTES (16 * 1024 * 1024)
+#define DB_SYNC_AUTO_MAX_BYTES (2048ull * 1024 * 1024)
+
+
+//------------------------------------------------------------------
+struct Blockchain::longhash_prefetch
+{
+  uint64_t                  height;
+  uint64_t                  main_height;
+  std::vector<block>        blocks;
+  std::vector<crypto::hash> ids;
+  std::vector<uint64_t>     seed_heights;
+  std::vector<crypto::hash> seed_hashes;
+  std::vector<uint8_t>      hashable; // NOTE: Not std::vector<bool>, written to concurrently
+  std::vector<uint8_t>      have_pow;
+  std::vector<crypto::hash> pow;
+  tools::threadpool::waiter waiter; // last, so it is destroyed (and waited on) first
+};
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool, full_nodes::full_node_list& full_node_list, full_nodes::deregister_vote_pool& deregister_vote_pool):
   m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
-  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false),
+  m_scan_table(scan_table_t::allocator_type(m_scan_arena)),
+  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_auto(false), m_db_sync_auto_last(0), m_db_sync_max_latency(0), m_last_db_sync(0), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false), m_pruning_in_progress(true),
   m_long_term_block_weights_window(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_long_term_effective_median_block_weight(0),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
   m_full_node_list(full_node_list),
   m_deregister_vote_pool(deregister_vote_pool),
-  m_btc_valid(false),
-  m_prepare_height(0)
+  m_alternative_tips_seq(0),
+  m_prepare_height(0),
+  m_control_reward_sums_height(0),
+  m_replica_height(0)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -153,7 +182,9 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
   // #1 plus relative offset #2.
   // TODO: Investigate if this is necessary / why this is done.
   std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.key_offsets);
-  std::vector<output_data_t> outputs;
+  // outputs found in the scan table are used in place, fetched ones are kept here
+  std::vector<output_data_t> fetched;
+  epee::span<const output_data_t> outputs;
 
   bool found = false;
   auto it = m_scan_table.find(tx_prefix_hash);
@@ -162,7 +193,7 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
     auto its = it->second.find(tx_in_to_key.k_image);
     if (its != it->second.end())
     {
-      outputs = its->second;
+      outputs = epee::span<const output_data_t>(its->second.data(), its->second.size());
       found = true;
     }
   }
@@ -171,8 +202,8 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
   {
     try
     {
-      m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), absolute_offsets, outputs, true);
-      if (absolute_offsets.size() != outputs.size())
+      m_output_key_cache.get_output_keys(*m_db, tx_in_to_key.amount, absolute_offsets, fetched, true);
+      if (absolute_offsets.size() != fetched.size())
       {
         MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
         return false;
@@ -183,6 +214,7 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
       MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
       return false;
     }
+    outputs = epee::to_span(fetched);
   }
   else
   {
@@ -197,7 +229,7 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
         add_offsets.push_back(absolute_offsets[i]);
       try
       {
-        m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), add_offsets, add_outputs, true);
+        m_output_key_cache.get_output_keys(*m_db, tx_in_to_key.amount, add_offsets, add_outputs, true);
         if (add_offsets.size() != add_outputs.size())
         {
           MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
@@ -209,7 +241,10 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
         MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
         return false;
       }
-      outputs.insert(outputs.end(), add_outputs.begin(), add_outputs.end());
+      fetched.reserve(absolute_offsets.size());
+      fetched.assign(outputs.begin(), outputs.end());
+      fetched.insert(fetched.end(), add_outputs.begin(), add_outputs.end());
+      outputs = epee::to_span(fetched);
     }
   }
 
@@ -223,7 +258,7 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
       {
         // get tx hash and output index for output
         if (count < outputs.size())
-          output_index = outputs.at(count);
+          output_index = outputs[count];
         else
           output_index = m_db->get_output_key(tx_in_to_key.amount, i);
 
@@ -355,6 +390,11 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   //       taking testnet into account
   if(!m_db->height())
   {
+    if (m_db->is_read_only())
+    {
+      LOG_ERROR("Blockchain not loaded, and can't generate the genesis block in a read only DB");
+      return false;
+    }
     MINFO("Blockchain not loaded, generating genesis block.");
     block bl;
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
@@ -446,6 +486,10 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
 
   if (test_options && test_options->long_term_block_weight_window)
     m_long_term_block_weights_window = test_options->long_term_block_weight_window;
+  m_block_weights_median = block_weights_median();
+  m_block_weights_median.median.reset(CRYPTONOTE_REWARD_BLOCKS_WINDOW);
+  m_long_term_block_weights_median = block_weights_median();
+  m_long_term_block_weights_median.median.reset(m_long_term_block_weights_window);
 
   bool difficulty_ok;
   uint64_t difficulty_recalc_height;
@@ -453,7 +497,8 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   if (!difficulty_ok)
   {
     MERROR("Difficulty drift detected!");
-    recalculate_difficulties(difficulty_recalc_height);
+    if (!m_db->is_read_only())
+      recalculate_difficulties(difficulty_recalc_height);
   }
 
   if (!update_next_cumulative_weight_limit())
@@ -462,6 +507,14 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   for (InitHook* hook : m_init_hooks)
     hook->init();
 
+  if (m_db->is_read_only())
+  {
+    m_replica_height = m_db->height();
+    m_replica_hashes.clear();
+    for (uint64_t h = m_replica_height - std::min<uint64_t>(m_replica_height, REPLICA_BLOCK_HASHES_KEPT); h < m_replica_height; ++h)
+      m_replica_hashes.push_back(m_db->get_block_hash_from_height(h));
+  }
+
   return true;
 }
 //------------------------------------------------------------------
@@ -475,6 +528,114 @@ bool Blockchain::init(BlockchainDB* db, HardFork*& hf, const network_type nettyp
   return res;
 }
 //------------------------------------------------------------------
+bool Blockchain::sync_from_db()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+  CHECK_AND_ASSERT_MES(m_db->is_read_only(), false, "Only a replica's DB changes without going through the Blockchain");
+
+  try
+  {
+    const uint64_t height = m_db->height();
+
+    // the highest height below which the DB still has the blocks we passed to the hooks
+    const uint64_t oldest = m_replica_height - m_replica_hashes.size();
+    uint64_t common = m_replica_height;
+    while (common > oldest && (common > height || m_db->get_block_hash_from_height(common - 1) != m_replica_hashes[common - 1 - oldest]))
+      --common;
+
+    if (common == m_replica_height && height == m_replica_height)
+      return true;
+
+    const bool detached = common < m_replica_height;
+    if (detached)
+    {
+      // as in pop_block_from_blockchain, the popped blocks' outputs are gone
+      // and their global indices get reused by the primary's new blocks
+      m_output_key_cache.clear();
+      if (m_cumulative_rct_outputs.size() > common)
+        m_cumulative_rct_outputs.resize(common);
+    }
+    if (detached && common == oldest && oldest > 0)
+    {
+      MGINFO("Primary reorganized deeper than " << m_replica_hashes.size() << " blocks, reinitializing from height " << height);
+      m_db->invalidate_cache_from_height(0);
+      m_hardfork->init();
+      for (InitHook* hook : m_init_hooks)
+        hook->init();
+      m_replica_hashes.clear();
+      for (uint64_t h = height - std::min<uint64_t>(height, REPLICA_BLOCK_HASHES_KEPT); h < height; ++h)
+        m_replica_hashes.push_back(m_db->get_block_hash_from_height(h));
+      m_replica_height = height;
+    }
+    else
+    {
+      if (detached)
+      {
+        MGINFO("Primary popped blocks, rolling back from height " << m_replica_height << " to " << common);
+        m_db->invalidate_cache_from_height(common);
+        m_replica_hashes.resize(common - oldest);
+        m_replica_height = common;
+        m_control_reward_sums.clear();
+        for (BlockchainDetachedHook* hook : m_blockchain_detached_hooks)
+          hook->blockchain_detached(common);
+      }
+
+      std::vector<std::pair<cryptonote::blobdata, block>> blocks;
+      std::vector<transaction> txs;
+      std::vector<crypto::hash> missed_txs;
+      while (m_replica_height < height)
+      {
+        blocks.clear();
+        if (!get_blocks(m_replica_height, std::min<uint64_t>(height - m_replica_height, 100), blocks) || blocks.empty())
+        {
+          MERROR("Failed to read the blocks from height " << m_replica_height << " written by the primary");
+          return false;
+        }
+        for (const auto &b: blocks)
+        {
+          const block &bl = b.second;
+          txs.clear();
+          missed_txs.clear();
+          if (!get_transactions(bl.tx_hashes, txs, missed_txs, true /*pruned*/) || !missed_txs.empty())
+          {
+            MERROR("Failed to read the txs of block " << get_block_hash(bl) << " written by the primary");
+            return false;
+          }
+          // after a pop, the hard fork window is rebuilt below in one go
+          if (!detached)
+            m_hardfork->add(bl, m_replica_height);
+          add_block_control_reward(bl, m_replica_height);
+          for (BlockAddedHook* hook : m_block_added_hooks)
+            hook->block_added(bl, txs);
+
+          m_replica_hashes.push_back(get_block_hash(bl));
+          if (m_replica_hashes.size() > REPLICA_BLOCK_HASHES_KEPT)
+            m_replica_hashes.pop_front();
+          ++m_replica_height;
+        }
+      }
+
+      if (detached)
+        m_hardfork->reorganize_from_chain_height(common);
+    }
+
+    m_timestamps_and_difficulties_height = 0;
+    invalidate_block_template_cache();
+    if (detached)
+      m_tx_pool.on_blockchain_dec(height - 1, get_tail_id());
+    else
+      m_tx_pool.on_blockchain_inc(height, get_tail_id());
+    return update_next_cumulative_weight_limit();
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to follow the blocks written by the primary: " << e.what());
+    return false;
+  }
+}
+//------------------------------------------------------------------
 bool Blockchain::store_blockchain()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -486,6 +647,7 @@ bool Blockchain::store_blockchain()
   // up the call stack
   try
   {
+    m_last_db_sync = time(NULL);
     m_db->sync();
   }
   catch (const std::exception& e)
@@ -502,15 +664,49 @@ bool Blockchain::store_blockchain()
   TIME_MEASURE_FINISH(save);
   if(m_show_time_stats)
     MINFO("Blockchain stored OK, took: " << save << " ms");
+  if (m_db_sync_auto)
+    tune_db_sync_threshold(save);
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::tune_db_sync_threshold(uint64_t sync_ms)
+{
+  // caller holds m_db->m_synchronization_lock
+  // Keep syncs between 2% and 10% of the time between them: a disk with slow
+  // fsyncs gets bigger batches, a fast one keeps the unsynced window small.
+  // Only the threshold moves, the sync mode chosen by the user is kept.
+  const uint64_t now = epee::misc_utils::get_tick_count();
+  const uint64_t last = m_db_sync_auto_last;
+  m_db_sync_auto_last = now;
+  if (last == 0 || now <= last)
+    return;
+  const uint64_t interval = now - last;
+
+  uint64_t threshold = m_db_sync_threshold;
+  if (sync_ms * 10 > interval)
+    threshold = std::min<uint64_t>(threshold * 2, DB_SYNC_AUTO_MAX_BYTES);
+  else if (sync_ms * 50 < interval)
+    threshold = std::max<uint64_t>(threshold / 2, DB_SYNC_AUTO_MIN_BYTES);
+  if (threshold != m_db_sync_threshold)
+  {
+    MDEBUG("DB sync took " << sync_ms << " ms of " << interval << " ms, sync threshold now " << threshold << " bytes");
+    m_db_sync_threshold = threshold;
+  }
+}
+//------------------------------------------------------------------
 bool Blockchain::deinit()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
   MTRACE("Stopping blockchain read/write activity");
 
+  if (m_longhash_prefetch)
+  {
+    m_longhash_prefetch->waiter.wait(&tools::threadpool::getInstance());
+    m_longhash_prefetch.reset();
+  }
+  get_block_longhash_prepare_seed_join();
+
  // stop async service
   m_async_work_idle.reset();
   m_async_pool.join_all();
@@ -584,6 +780,8 @@ block Blockchain::pop_block_from_blockchain()
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   m_timestamps_and_difficulties_height = 0;
+  // the popped block's outputs go away, and their global indices get reused
+  m_output_key_cache.clear();
 
   block popped_block;
   std::vector<transaction> popped_txs;
@@ -607,6 +805,9 @@ block Blockchain::pop_block_from_blockchain()
 
   // make sure the hard fork object updates its current version
   m_hardfork->on_block_popped(1);
+  pop_block_control_reward(m_db->height());
+  if (m_cumulative_rct_outputs.size() > m_db->height())
+    m_cumulative_rct_outputs.resize(m_db->height());
 
   // return transactions from popped block to the tx_pool
   size_t pruned = 0;
@@ -642,7 +843,7 @@ block Blockchain::pop_block_from_blockchain()
     MWARNING(pruned << " pruned txes could not be added back to the txpool");
 
   m_blocks_longhash_table.clear();
-  m_scan_table.clear();
+  reset_scan_table();
   m_blocks_txs_check.clear();
   m_check_txin_table.clear();
 
@@ -660,6 +861,9 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_timestamps_and_difficulties_height = 0;
   m_alternative_chains.clear();
+  m_alternative_tips.clear();
+  m_cumulative_rct_outputs.clear();
+  m_output_key_cache.clear();
   invalidate_block_template_cache();
   m_db->reset();
   m_hardfork->init();
@@ -863,13 +1067,13 @@ difficulty_type Blockchain::get_difficulty_for_next_block()
     m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
 
     while (m_timestamps.size() > difficulty_blocks_count)
-      m_timestamps.erase(m_timestamps.begin());
+      m_timestamps.pop_front();
     while (m_difficulties.size() > difficulty_blocks_count)
-      m_difficulties.erase(m_difficulties.begin());
+      m_difficulties.pop_front();
 
     m_timestamps_and_difficulties_height = height;
-    timestamps = m_timestamps;
-    difficulties = m_difficulties;
+    timestamps.assign(m_timestamps.begin(), m_timestamps.end());
+    difficulties.assign(m_difficulties.begin(), m_difficulties.end());
   }
   else
   {
@@ -881,18 +1085,13 @@ difficulty_type Blockchain::get_difficulty_for_next_block()
     difficulties.clear();
     if (height > offset)
     {
-      timestamps.reserve(height - offset);
-      difficulties.reserve(height - offset);
-    }
-    for (; offset < height; offset++)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(offset));
-      difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
+      timestamps = m_db->get_block_timestamps(offset, height - offset);
+      difficulties = m_db->get_block_cumulative_difficulties(offset, height - offset);
     }
 
     m_timestamps_and_difficulties_height = height;
-    m_timestamps = timestamps;
-    m_difficulties = difficulties;
+    m_timestamps.assign(timestamps.begin(), timestamps.end());
+    m_difficulties.assign(difficulties.begin(), difficulties.end());
   }
   size_t target = get_difficulty_target();
   difficulty_type diff = next_difficulty(timestamps, difficulties, target);
@@ -903,6 +1102,20 @@ difficulty_type Blockchain::get_difficulty_for_next_block()
   return diff;
 }
 //------------------------------------------------------------------
+bool Blockchain::get_cached_difficulty_window(uint64_t start_height, uint64_t stop_height, std::vector<uint64_t>& timestamps, std::vector<difficulty_type>& cumulative_difficulties) const
+{
+  const uint64_t cache_stop = m_timestamps_and_difficulties_height;
+  if (cache_stop == 0 || cache_stop > m_db->height() || m_timestamps.size() != m_difficulties.size())
+    return false;
+  const uint64_t cache_start = cache_stop - m_timestamps.size();
+  if (start_height < cache_start || stop_height > cache_stop || start_height > stop_height)
+    return false;
+
+  timestamps.insert(timestamps.end(), m_timestamps.begin() + (start_height - cache_start), m_timestamps.begin() + (stop_height - cache_start));
+  cumulative_difficulties.insert(cumulative_difficulties.end(), m_difficulties.begin() + (start_height - cache_start), m_difficulties.begin() + (stop_height - cache_start));
+  return true;
+}
+//------------------------------------------------------------------
 std::pair<bool, uint64_t> Blockchain::check_difficulty_checkpoints() const
 {
   uint64_t res = 0;
@@ -948,8 +1161,39 @@ size_t Blockchain::recalculate_difficulties(boost::optional<uint64_t> start_heig
   difficulty_type last_cum_diff = start_height <= 1 ? start_height : difficulties.back();
   uint64_t drift_start_height = 0;
   std::vector<difficulty_type> new_cumulative_difficulties;
+
+  // The recalculation itself is sequential, but the DB reads it needs are
+  // not: fetch the timestamps and stored cumulative difficulties of each
+  // chunk of heights on the threadpool before walking it.
+  static const uint64_t RECALC_CHUNK_SIZE = 10000;
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const uint64_t threads = std::max<uint64_t>(1, tpool.get_max_concurrency());
+  std::vector<uint64_t> chunk_timestamps;
+  std::vector<difficulty_type> chunk_cum_diffs;
+  uint64_t chunk_start = start_height, chunk_end = start_height;
   for (uint64_t height = start_height; height <= top_height; ++height)
   {
+    if (height == chunk_end)
+    {
+      chunk_start = height;
+      chunk_end = std::min(top_height + 1, chunk_start + RECALC_CHUNK_SIZE);
+      const uint64_t n = chunk_end - chunk_start;
+      const bool want_cum_diffs = drift_start_height == 0;
+      chunk_timestamps.assign(n, 0);
+      chunk_cum_diffs.assign(want_cum_diffs ? n : 0, 0);
+      const auto load = [&, want_cum_diffs](size_t begin, size_t end) {
+        for (uint64_t i = begin; i < end; ++i)
+        {
+          chunk_timestamps[i] = m_db->get_block_timestamp(chunk_start + i);
+          if (want_cum_diffs)
+            chunk_cum_diffs[i] = m_db->get_block_cumulative_difficulty(chunk_start + i);
+        }
+      };
+      tools::threadpool::waiter waiter;
+      tpool.submit_range(&waiter, n, (n + threads - 1) / threads, load, true);
+      waiter.wait(&tpool);
+    }
+
     size_t target = DIFFICULTY_TARGET_V2;
     difficulty_type recalculated_diff = next_difficulty(timestamps, difficulties, target);
 
@@ -959,7 +1203,7 @@ size_t Blockchain::recalculate_difficulties(boost::optional<uint64_t> start_heig
 
     if (drift_start_height == 0)
     {
-      difficulty_type existing_cum_diff = m_db->get_block_cumulative_difficulty(height);
+      difficulty_type existing_cum_diff = chunk_cum_diffs[height - chunk_start];
       if (recalculated_cum_diff != existing_cum_diff)
       {
         drift_start_height = height;
@@ -976,7 +1220,7 @@ size_t Blockchain::recalculate_difficulties(boost::optional<uint64_t> start_heig
 
     if (height > 0)
     {
-      timestamps.push_back(m_db->get_block_timestamp(height));
+      timestamps.push_back(chunk_timestamps[height - chunk_start]);
       difficulties.push_back(recalculated_cum_diff);
     }
     if (timestamps.size() > DIFFICULTY_BLOCKS_COUNT_V2)
@@ -1048,7 +1292,10 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
   // make sure the hard fork object updates its current version
   m_hardfork->reorganize_from_chain_height(rollback_height);
 
-  //return back original chain
+  //return back original chain, without validating it all over again
+  for (const auto& bl : original_chain)
+    m_prevalidated_blocks.insert(get_block_hash(bl));
+  auto prevalidated_clearer = epee::misc_utils::create_scope_leave_handler([this]() { m_prevalidated_blocks.clear(); });
   for (auto& bl : original_chain)
   {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
@@ -1099,6 +1346,19 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   for (BlockchainDetachedHook* hook : m_blockchain_detached_hooks)
     hook->blockchain_detached(split_height);
 
+  // the alt blocks' PoW was checked when they were added as alternatives,
+  // and is the same on the main chain, so it is not hashed again
+  std::vector<crypto::hash> alt_pow_ids;
+  for (const auto &ch_ent: alt_chain)
+  {
+    if (ch_ent->second.pow != crypto::null_hash && m_blocks_longhash_table.emplace(ch_ent->first, ch_ent->second.pow).second)
+      alt_pow_ids.push_back(ch_ent->first);
+  }
+  auto alt_pow_clearer = epee::misc_utils::create_scope_leave_handler([this, &alt_pow_ids]() {
+    for (const crypto::hash &id: alt_pow_ids)
+      m_blocks_longhash_table.erase(id);
+  });
+
   //connecting new alternative chain
   for(auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++)
   {
@@ -1130,6 +1390,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
         add_block_as_invalid((*alt_ch_to_orph_iter)->second, (*alt_ch_to_orph_iter)->first);
         m_alternative_chains.erase(*alt_ch_to_orph_iter++);
       }
+      rebuild_alternative_tips();
       return false;
     }
   }
@@ -1156,6 +1417,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   {
     m_alternative_chains.erase(ch_ent);
   }
+  rebuild_alternative_tips();
 
   m_hardfork->reorganize_from_chain_height(split_height);
   get_block_longhash_reorg(split_height);
@@ -1198,7 +1460,10 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
     if(!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
 
-    // get difficulties and timestamps from relevant main chain blocks
+    // get difficulties and timestamps from relevant main chain blocks, from
+    // the next block difficulty window when the fork point is recent enough
+    if (main_chain_start_offset < main_chain_stop_offset && get_cached_difficulty_window(main_chain_start_offset, main_chain_stop_offset, timestamps, cumulative_difficulties))
+      main_chain_start_offset = main_chain_stop_offset;
     for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
     {
       timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
@@ -1365,11 +1630,8 @@ void Blockchain::get_last_n_blocks_weights(std::vector<uint64_t>& weights, size_
   m_db->block_txn_start(true);
   // add weight of last <count> blocks to vector <weights> (or less, if blockchain size < count)
   size_t start_offset = h - std::min<size_t>(h, count);
-  weights.reserve(weights.size() + h - start_offset);
-  for(size_t i = start_offset; i < h; i++)
-  {
-    weights.push_back(m_db->get_block_weight(i));
-  }
+  const std::vector<uint64_t> last_weights = m_db->get_block_weights(start_offset, h - start_offset);
+  weights.insert(weights.end(), last_weights.begin(), last_weights.end());
   m_db->block_txn_stop();
 }
 //------------------------------------------------------------------
@@ -1408,26 +1670,40 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   height = m_db->height();
-  if (m_btc_valid) {
-    // The pool cookie is atomic. The lack of locking is OK, as if it changes
-    // just as we compare it, we'll just use a slightly old template, but
-    // this would be the case anyway if we'd lock, and the change happened
-    // just after the block template was created
-    if (!memcmp(&miner_address, &m_btc_address, sizeof(cryptonote::account_public_address)) && m_btc_nonce == ex_nonce && m_btc_pool_cookie == m_tx_pool.cookie()) {
+  const crypto::hash prev_id = get_tail_id();
+  if (!m_btc.empty() && m_btc.front().b.prev_id != prev_id)
+    invalidate_block_template_cache();
+
+  // The pool cookie is atomic. The lack of locking is OK, as if it changes
+  // just as we compare it, we'll just use a slightly old template, but
+  // this would be the case anyway if we'd lock, and the change happened
+  // just after the block template was created
+  const uint64_t current_cookie = m_tx_pool.cookie();
+  const block_template_cache *same_txs = nullptr; // another miner, same pool contents
+  const block_template_cache *same_miner = nullptr; // same miner, older pool contents
+  for (auto it = m_btc.begin(); it != m_btc.end(); ++it)
+  {
+    const bool same_request = !memcmp(&miner_address, &it->address, sizeof(cryptonote::account_public_address)) && it->nonce == ex_nonce;
+    if (same_request && it->pool_cookie == current_cookie)
+    {
       MDEBUG("Using cached template");
-      m_btc.timestamp = time(NULL); // update timestamp unconditionally
-      b = m_btc;
-      diffic = m_btc_difficulty;
-      expected_reward = m_btc_expected_reward;
+      m_btc.splice(m_btc.begin(), m_btc, it);
+      it->b.timestamp = time(NULL); // update timestamp unconditionally
+      b = it->b;
+      diffic = it->difficulty;
+      expected_reward = it->expected_reward;
       return true;
     }
-    MDEBUG("Not using cached template: address " << (!memcmp(&miner_address, &m_btc_address, sizeof(cryptonote::account_public_address))) << ", nonce " << (m_btc_nonce == ex_nonce) << ", cookie " << (m_btc_pool_cookie == m_tx_pool.cookie()));
-    invalidate_block_template_cache();
+    if (!same_txs && it->pool_cookie == current_cookie)
+      same_txs = &*it;
+    if (!same_miner && same_request)
+      same_miner = &*it;
   }
+  MDEBUG("Not using cached template: " << m_btc.size() << " cached, tx selection " << (same_txs ? "reused" : "rebuilt") << ", miner " << (same_miner ? "seen" : "new"));
 
   b.major_version = m_hardfork->get_current_version();
   b.minor_version = m_hardfork->get_ideal_version();
-  b.prev_id = get_tail_id();
+  b.prev_id = prev_id;
   b.timestamp = time(NULL);
 
   uint64_t median_ts;
@@ -1436,19 +1712,34 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
     b.timestamp = median_ts;
   }
 
-  diffic = get_difficulty_for_next_block();
+  // all cached templates are for this tip, so they share the difficulty
+  diffic = m_btc.empty() ? get_difficulty_for_next_block() : m_btc.front().difficulty;
   CHECK_AND_ASSERT_MES(diffic, false, "difficulty overhead.");
 
-  median_weight = m_current_block_cumul_weight_limit / 2;
-  already_generated_coins = m_db->get_block_already_generated_coins(height - 1);
-
   size_t txs_weight;
   uint64_t fee;
-  if (!m_tx_pool.fill_block_template(b, median_weight, already_generated_coins, txs_weight, fee, expected_reward, m_hardfork->get_current_version(), height))
+  if (same_txs)
   {
-    return false;
+    // only the miner tx depends on the address and extra nonce
+    b.tx_hashes = same_txs->b.tx_hashes;
+    median_weight = same_txs->median_weight;
+    already_generated_coins = same_txs->already_generated_coins;
+    txs_weight = same_txs->txs_weight;
+    fee = same_txs->fee;
+    expected_reward = same_txs->expected_reward;
+    pool_cookie = same_txs->pool_cookie;
+  }
+  else
+  {
+    median_weight = m_current_block_cumul_weight_limit / 2;
+    already_generated_coins = m_db->get_block_already_generated_coins(height - 1);
+
+    if (!m_tx_pool.fill_block_template(b, median_weight, already_generated_coins, txs_weight, fee, expected_reward, m_hardfork->get_current_version(), height))
+    {
+      return false;
+    }
+    pool_cookie = m_tx_pool.cookie();
   }
-  pool_cookie = m_tx_pool.cookie();
 #if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
   size_t real_txs_weight = 0;
   uint64_t real_fee = 0;
@@ -1502,6 +1793,45 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
       ", fee " << fee);
 #endif
 
+  block_template_cache btc;
+  btc.address = miner_address;
+  btc.nonce = ex_nonce;
+  btc.difficulty = diffic;
+  btc.pool_cookie = pool_cookie;
+  btc.expected_reward = expected_reward;
+  btc.median_weight = median_weight;
+  btc.already_generated_coins = already_generated_coins;
+  btc.txs_weight = txs_weight;
+  btc.fee = fee;
+
+  // Same parent as the cached templates: the full node winner and control
+  // reward are the same. For the same miner and nonce with only the pool
+  // changed, if the selected txs add up to the same fee and weight so is
+  // the miner tx.
+  if (!m_btc.empty())
+  {
+    btc.miner_context = m_btc.front().miner_context;
+    if (same_miner && same_miner->median_weight == median_weight && same_miner->already_generated_coins == already_generated_coins && same_miner->txs_weight == txs_weight && same_miner->fee == fee)
+    {
+      MDEBUG("Reusing the cached miner tx for the new pool contents");
+      b.miner_tx = same_miner->b.miner_tx;
+      btc.b = b;
+      cache_block_template(btc);
+      return true;
+    }
+  }
+  else
+  {
+    btc.miner_context = antd_miner_tx_context(m_nettype,
+                                              m_full_node_list.select_winner(),
+                                              m_full_node_list.get_winner_addresses_and_portions());
+    if (!calc_batched_control_reward(height, btc.miner_context.batched_control))
+    {
+      LOG_ERROR("Failed to calculate batched control reward");
+      return false;
+    }
+  }
+
   /*
    two-phase miner transaction generation: we don't know exact block weight until we prepare block, but we don't know reward until we know
    block weight, so first miner transaction generated with fake amount of money, and with phase we know think we know expected block weight
@@ -1509,15 +1839,7 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
   //make blocks coin-base tx looks close to real coinbase tx to get truthful blob weight
   uint8_t hf_version = m_hardfork->get_current_version();
 
-  antd_miner_tx_context miner_tx_context(m_nettype,
-                                         m_full_node_list.select_winner(),
-                                         m_full_node_list.get_winner_addresses_and_portions());
-
-  if (!calc_batched_control_reward(height, miner_tx_context.batched_control))
-  {
-    LOG_ERROR("Failed to calculate batched control reward");
-    return false;
-  }
+  const antd_miner_tx_context &miner_tx_context = btc.miner_context;
 
   bool r = construct_miner_tx(height, median_weight, already_generated_coins, txs_weight, fee, miner_address, b.miner_tx, ex_nonce, hf_version, miner_tx_context);
 
@@ -1573,7 +1895,8 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
         ", cumulative weight " << cumulative_weight << " is now good");
 #endif
 
-    cache_block_template(b, miner_address, ex_nonce, diffic, expected_reward, pool_cookie);
+    btc.b = b;
+    cache_block_template(btc);
     return true;
   }
   LOG_ERROR("Failed to create_block_template with " << 10 << " tries");
@@ -1610,9 +1933,9 @@ bool Blockchain::complete_timestamps_vector(uint64_t start_top_height, std::vect
 // a long forked chain eventually.
 bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id, block_verification_context& bvc)
 {
+  PERF_TIMER(handle_alternative_block);
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
   uint64_t block_height = get_block_height(b);
   if(0 == block_height)
   {
@@ -1710,6 +2033,15 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
       return false;
     }
 
+    // sanity check the miner tx before spending a PoW hash (and possibly a
+    // cache init for an alt seed) on the block
+    if(!prevalidate_miner_transaction(b, bei.height))
+    {
+      MERROR_VER("Block with id: " << epee::string_tools::pod_to_hex(id) << " (as alternative) has incorrect miner transaction.");
+      bvc.m_verifivation_failed = true;
+      return false;
+    }
+
     // Check the block's hash against the difficulty target for its alt chain
     difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     CHECK_AND_ASSERT_MES(current_diff, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
@@ -1751,13 +2083,6 @@ else
       return false;
     }
 
-    if(!prevalidate_miner_transaction(b, bei.height))
-    {
-      MERROR_VER("Block with id: " << epee::string_tools::pod_to_hex(id) << " (as alternative) has incorrect miner transaction.");
-      bvc.m_verifivation_failed = true;
-      return false;
-    }
-
     // FIXME:
     // this brings up an interesting point: consider allowing to get block
     // difficulty both by height OR by hash, not just height.
@@ -1772,12 +2097,15 @@ else
       bei.cumulative_difficulty = m_db->get_block_cumulative_difficulty(m_db->get_block_height(b.prev_id));
     }
     bei.cumulative_difficulty += current_diff;
+    bei.pow = proof_of_work;
 
     // add block to alternate blocks storage,
     // as well as the current "alt chain" container
     auto i_res = m_alternative_chains.insert(blocks_ext_by_hash::value_type(id, bei));
     CHECK_AND_ASSERT_MES(i_res.second, false, "insertion of new alternative block returned as it already exist");
     alt_chain.push_back(i_res.first);
+    m_alternative_tips.erase(b.prev_id);
+    m_alternative_tips[id] = ++m_alternative_tips_seq;
 
     // FIXME: is it even possible for a checkpoint to show up not on the main chain?
     if(is_a_checkpoint)
@@ -1865,6 +2193,31 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::get_block_header_view_by_height(uint64_t height, block_header_view &v, bool with_miner_tx) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if (height >= m_db->height())
+    return false;
+
+  epee::span<const uint8_t> view;
+  bool parsed;
+  if (m_db->get_block_blob_view_from_height(height, view))
+  {
+    parsed = parse_block_header_view_from_blob(view, v, with_miner_tx);
+  }
+  else
+  {
+    const cryptonote::blobdata blob = m_db->get_block_blob_from_height(height);
+    parsed = parse_block_header_view_from_blob(epee::strspan<uint8_t>(blob), v, with_miner_tx);
+  }
+  if (!parsed)
+  {
+    LOG_ERROR("Invalid block at height " << height);
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------
 //TODO: This function *looks* like it won't need to be rewritten
 //      to use BlockchainDB, as it calls other functions that were,
 //      but it warrants some looking into later.
@@ -1875,45 +2228,79 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std
 bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_db->block_txn_start(true);
-  rsp.current_blockchain_height = get_current_blockchain_height();
-  std::vector<std::pair<cryptonote::blobdata,block>> blocks;
-  get_blocks(arg.blocks, blocks, rsp.missed_ids);
-
-  for (auto& bl: blocks)
+  // no m_blockchain_lock here: the read session pins one snapshot of the db,
+  // so several peers can be served at once, and while blocks are being added
+  db_read_session read_session(*m_db);
+  try
   {
-    std::vector<crypto::hash> missed_tx_ids;
+    rsp.current_blockchain_height = m_db->height();
+    rsp.blocks.reserve(arg.blocks.size());
+    for (const crypto::hash& block_hash: arg.blocks)
+    {
+      uint64_t height = 0;
+      if (!m_db->block_exists(block_hash, &height))
+      {
+        rsp.missed_ids.push_back(block_hash);
+        continue;
+      }
 
-    rsp.blocks.push_back(block_complete_entry());
-    block_complete_entry& e = rsp.blocks.back();
+      // the blob is copied once, straight from the db's storage into the
+      // response, and only parsed for its tx hashes
+      rsp.blocks.push_back(block_complete_entry());
+      block_complete_entry& e = rsp.blocks.back();
+      epee::span<const uint8_t> view;
+      block b;
+      bool parsed;
+      if (m_db->get_block_blob_view_from_height(height, view))
+      {
+        e.block.assign(reinterpret_cast<const char*>(view.data()), view.size());
+        parsed = parse_and_validate_block_from_blob(view, b);
+      }
+      else
+      {
+        e.block = m_db->get_block_blob_from_height(height);
+        parsed = parse_and_validate_block_from_blob(e.block, b);
+      }
+      if (!parsed)
+      {
+        LOG_ERROR("Invalid block: " << block_hash);
+        rsp.blocks.pop_back();
+        rsp.missed_ids.push_back(block_hash);
+        continue;
+      }
 
-    // FIXME: s/rsp.missed_ids/missed_tx_id/ ?  Seems like rsp.missed_ids
-    //        is for missed blocks, not missed transactions as well.
-    get_transactions_blobs(bl.second.tx_hashes, e.txs, missed_tx_ids);
+      e.txs.resize(b.tx_hashes.size());
+      for (size_t i = 0; i < b.tx_hashes.size(); ++i)
+      {
+        if (!m_db->get_tx_blob(b.tx_hashes[i], e.txs[i]))
+        {
+          // FIXME: s/rsp.missed_ids/missed_tx_id/ ?  Seems like rsp.missed_ids
+          //        is for missed blocks, not missed transactions as well.
+          LOG_ERROR("Error retrieving blocks, missed transaction " << b.tx_hashes[i] << " for block with hash: " << block_hash);
+          rsp.missed_ids.push_back(b.tx_hashes[i]);
+          return false;
+        }
+      }
+    }
 
-    if (missed_tx_ids.size() != 0)
+    //get and pack other transactions, if needed
+    rsp.txs.reserve(arg.txs.size());
+    for (const crypto::hash& tx_hash: arg.txs)
     {
-      LOG_ERROR("Error retrieving blocks, missed " << missed_tx_ids.size()
-          << " transactions for block with hash: " << get_block_hash(bl.second)
-          << std::endl
-      );
-
-      // append missed transaction hashes to response missed_ids field,
-      // as done below if any standalone transactions were requested
-      // and missed.
-      rsp.missed_ids.insert(rsp.missed_ids.end(), missed_tx_ids.begin(), missed_tx_ids.end());
-      m_db->block_txn_stop();
-      return false;
+      rsp.txs.push_back(cryptonote::blobdata());
+      if (!m_db->get_tx_blob(tx_hash, rsp.txs.back()))
+      {
+        rsp.txs.pop_back();
+        rsp.missed_ids.push_back(tx_hash);
+      }
     }
-
-    //pack block
-    e.block = std::move(bl.first);
   }
-  //get and pack other transactions, if needed
-  get_transactions_blobs(arg.txs, rsp.txs, rsp.missed_ids);
+  catch (const std::exception& e)
+  {
+    MERROR("Failed to serve objects: " << e.what());
+    return false;
+  }
 
-  m_db->block_txn_stop();
   return true;
 }
 //------------------------------------------------------------------
@@ -2037,17 +2424,27 @@ bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height,
 
   if (amount == 0)
   {
-    std::vector<uint64_t> heights;
-    heights.reserve(to_height + 1 - start_height);
-    uint64_t real_start_height = start_height > 0 ? start_height-1 : start_height;
-    for (uint64_t h = real_start_height; h <= to_height; ++h)
-      heights.push_back(h);
-    distribution = m_db->get_block_cumulative_rct_outputs(heights);
-    if (start_height > 0)
+    // every wallet asks for this one on every transfer: serve it from memory,
+    // only reading the heights added since the last request from the DB
+    CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    db_height = m_db->height();
+    if (to_height >= db_height)
+      return false;
+    if (m_cumulative_rct_outputs.size() < db_height)
     {
-      base = distribution[0];
-      distribution.erase(distribution.begin());
+      std::vector<uint64_t> heights;
+      heights.reserve(db_height - m_cumulative_rct_outputs.size());
+      for (uint64_t h = m_cumulative_rct_outputs.size(); h < db_height; ++h)
+        heights.push_back(h);
+      const std::vector<uint64_t> outputs = m_db->get_block_cumulative_rct_outputs(heights);
+      CHECK_AND_ASSERT_MES(outputs.size() == heights.size(), false, "Unexpected number of cumulative rct outputs");
+      m_cumulative_rct_outputs.insert(m_cumulative_rct_outputs.end(), outputs.begin(), outputs.end());
     }
+
+    if (start_height > 0)
+      base = m_cumulative_rct_outputs[start_height - 1];
+    if (to_height >= start_height)
+      distribution.assign(m_cumulative_rct_outputs.begin() + start_height, m_cumulative_rct_outputs.begin() + to_height + 1);
     return true;
   }
   else
@@ -2158,8 +2555,21 @@ bool Blockchain::get_blocks(const t_ids_container& block_ids, t_blocks_container
       uint64_t height = 0;
       if (m_db->block_exists(block_hash, &height))
       {
-        blocks.push_back(std::make_pair(m_db->get_block_blob_from_height(height), block()));
-        if (!parse_and_validate_block_from_blob(blocks.back().first, blocks.back().second))
+        // parse straight from the db's storage when we can, which saves
+        // the copy into the parse stream
+        epee::span<const uint8_t> view;
+        bool parsed;
+        if (m_db->get_block_blob_view_from_height(height, view))
+        {
+          blocks.push_back(std::make_pair(cryptonote::blobdata(reinterpret_cast<const char*>(view.data()), view.size()), block()));
+          parsed = parse_and_validate_block_from_blob(view, blocks.back().second);
+        }
+        else
+        {
+          blocks.push_back(std::make_pair(m_db->get_block_blob_from_height(height), block()));
+          parsed = parse_and_validate_block_from_blob(blocks.back().first, blocks.back().second);
+        }
+        if (!parsed)
         {
           LOG_ERROR("Invalid block: " << block_hash);
           blocks.pop_back();
@@ -2252,7 +2662,7 @@ bool Blockchain::get_split_transactions_blobs(const t_ids_container& txs_ids, t_
 }
 //------------------------------------------------------------------
 template<class t_ids_container, class t_tx_container, class t_missed_container>
-bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const
+bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -2263,7 +2673,18 @@ bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container
     try
     {
       cryptonote::blobdata tx;
-      if (m_db->get_tx_blob(tx_hash, tx))
+      if (pruned && m_db->get_pruned_tx_blob(tx_hash, tx))
+      {
+        txs.push_back(transaction());
+        if (!parse_and_validate_tx_base_from_blob(tx, txs.back()))
+        {
+          LOG_ERROR("Invalid transaction");
+          return false;
+        }
+        // a pruned tx can't hash itself, and we already know its hash
+        txs.back().set_hash(tx_hash);
+      }
+      else if (!pruned && m_db->get_tx_blob(tx_hash, tx))
       {
         txs.push_back(transaction());
         if (!parse_and_validate_tx_from_blob(tx, txs.back()))
@@ -2338,52 +2759,90 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  // if a specific start height has been requested
-  if(req_start_block > 0)
-  {
-    // if requested height is higher than our chain, return false -- we can't help
-    if (req_start_block >= m_db->height())
-    {
-      return false;
-    }
-    start_height = req_start_block;
-  }
-  else
-  {
-    if(!find_blockchain_supplement(qblock_ids, start_height))
-    {
-      return false;
-    }
-  }
+  if (!find_supplement_start_height(req_start_block, qblock_ids, start_height))
+    return false;
 
-  m_db->block_txn_start(true);
+  db_read_session read_session(*m_db);
   total_height = get_current_blockchain_height();
   size_t count = 0, size = 0;
   blocks.reserve(std::min(std::min(max_count, (size_t)10000), (size_t)(total_height - start_height)));
   for(uint64_t i = start_height; i < total_height && count < max_count && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || count < 3); i++, count++)
   {
     blocks.resize(blocks.size()+1);
-    blocks.back().first.first = m_db->get_block_blob_from_height(i);
-    block b;
-    CHECK_AND_ASSERT_MES(parse_and_validate_block_from_blob(blocks.back().first.first, b), false, "internal error, invalid block");
-    blocks.back().first.second = get_miner_tx_hash ? cryptonote::get_transaction_hash(b.miner_tx) : crypto::null_hash;
-    std::vector<crypto::hash> mis;
-    std::vector<cryptonote::blobdata> txs;
-    get_transactions_blobs(b.tx_hashes, txs, mis, pruned);
-    CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
-    size += blocks.back().first.first.size();
-    for (const auto &t: txs)
-      size += t.size();
+    if (!get_blockchain_supplement_block(i, pruned, get_miner_tx_hash, blocks.back(), size))
+      return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::get_blockchain_supplement_range(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, size_t max_count, uint64_t& start_height, uint64_t& count, uint64_t& total_height) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  if (!find_supplement_start_height(req_start_block, qblock_ids, start_height))
+    return false;
+
+  db_read_session read_session(*m_db);
+  total_height = get_current_blockchain_height();
+  // a block's weight is never below its blob size plus its txes' blob
+  // sizes, so this stays within the same cap find_blockchain_supplement uses
+  size_t size = 0;
+  for (count = 0; start_height + count < total_height && count < max_count && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || count < 3); ++count)
+    size += m_db->get_block_weight(start_height + count);
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::get_blockchain_supplement_block(uint64_t height, bool pruned, bool get_miner_tx_hash, std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > >& entry, size_t& size) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  block b;
+  epee::span<const uint8_t> view;
+  if (m_db->get_block_blob_view_from_height(height, view))
+  {
+    entry.first.first.assign(reinterpret_cast<const char*>(view.data()), view.size());
+    CHECK_AND_ASSERT_MES(parse_and_validate_block_from_blob(view, b), false, "internal error, invalid block");
+  }
+  else
+  {
+    entry.first.first = m_db->get_block_blob_from_height(height);
+    CHECK_AND_ASSERT_MES(parse_and_validate_block_from_blob(entry.first.first, b), false, "internal error, invalid block");
+  }
+  entry.first.second = get_miner_tx_hash ? cryptonote::get_transaction_hash(b.miner_tx) : crypto::null_hash;
+  std::vector<crypto::hash> mis;
+  std::vector<cryptonote::blobdata> txs;
+  get_transactions_blobs(b.tx_hashes, txs, mis, pruned);
+  CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
+  size += entry.first.first.size();
+  for (const auto &t: txs)
+    size += t.size();
 
-    CHECK_AND_ASSERT_MES(txs.size() == b.tx_hashes.size(), false, "mismatched sizes of b.tx_hashes and txs");
-    blocks.back().second.reserve(txs.size());
-    for (size_t i = 0; i < txs.size(); ++i)
+  CHECK_AND_ASSERT_MES(txs.size() == b.tx_hashes.size(), false, "mismatched sizes of b.tx_hashes and txs");
+  entry.second.clear();
+  entry.second.reserve(txs.size());
+  for (size_t i = 0; i < txs.size(); ++i)
+  {
+    entry.second.push_back(std::make_pair(b.tx_hashes[i], std::move(txs[i])));
+  }
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::find_supplement_start_height(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& start_height) const
+{
+  // if a specific start height has been requested
+  if(req_start_block > 0)
+  {
+    // if requested height is higher than our chain, return false -- we can't help
+    if (req_start_block >= m_db->height())
     {
-      blocks.back().second.push_back(std::make_pair(b.tx_hashes[i], std::move(txs[i])));
+      return false;
     }
+    start_height = req_start_block;
+    return true;
   }
-  m_db->block_txn_stop();
-  return true;
+  return find_blockchain_supplement(qblock_ids, start_height);
 }
 //------------------------------------------------------------------
 bool Blockchain::add_block_as_invalid(const block& bl, const crypto::hash& h)
@@ -2545,6 +3004,18 @@ bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<u
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::unhook_block_added(BlockAddedHook& hook)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_block_added_hooks.erase(std::remove(m_block_added_hooks.begin(), m_block_added_hooks.end(), &hook), m_block_added_hooks.end());
+}
+//------------------------------------------------------------------
+void Blockchain::unhook_blockchain_detached(BlockchainDetachedHook& hook)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_blockchain_detached_hooks.erase(std::remove(m_blockchain_detached_hooks.begin(), m_blockchain_detached_hooks.end(), &hook), m_blockchain_detached_hooks.end());
+}
+//------------------------------------------------------------------
 void Blockchain::on_new_tx_from_block(const cryptonote::transaction &tx)
 {
 #if defined(PER_BLOCK_CHECKPOINT)
@@ -2801,7 +3272,7 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height)
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, std::vector<const rct::rctSig*> *deferred_sigs)
 {
   PERF_TIMER(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2903,15 +3374,11 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
       //
       if (hf_version >= cryptonote::network_version_11_infinite_staking)
       {
-        const std::vector<full_nodes::key_image_blacklist_entry> &blacklist = m_full_node_list.get_blacklisted_key_images();
-        for (const auto &entry : blacklist)
+        if (m_full_node_list.is_key_image_blacklisted(in_to_key.k_image))
         {
-          if (in_to_key.k_image == entry.key_image) // Check if key image is on the blacklist
-          {
-            MERROR_VER("Key image: " << epee::string_tools::pod_to_hex(entry.key_image) << " is blacklisted by the fullnode network");
-            tvc.m_key_image_blacklisted = true;
-            return false;
-          }
+          MERROR_VER("Key image: " << epee::string_tools::pod_to_hex(in_to_key.k_image) << " is blacklisted by the fullnode network");
+          tvc.m_key_image_blacklisted = true;
+          return false;
         }
 
         uint64_t unlock_height = 0;
@@ -3000,7 +3467,11 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimple(rv))
+      if (deferred_sigs)
+      {
+        deferred_sigs->push_back(&rv);
+      }
+      else if (!rct::verRctNonSemanticsSimple(rv))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
@@ -3161,8 +3632,8 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 
       for (blobdata const &blob : txs)
       {
-        transaction existing_tx;
-        if (!parse_and_validate_tx_from_blob(blob, existing_tx))
+        transaction_prefix existing_tx;
+        if (!parse_and_validate_tx_prefix_from_blob(blob, existing_tx))
         {
           MERROR_VER("tx could not be validated from blob, possibly corrupt blockchain");
           continue;
@@ -3463,6 +3934,14 @@ bool Blockchain::check_tx_input(size_t tx_version, const txin_to_key& txin, cons
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::reset_scan_table()
+{
+  // swap the table out rather than clear it, clear() would keep its
+  // bucket array, which lives in the arena
+  scan_table_t(scan_table_t::allocator_type(m_scan_arena)).swap(m_scan_table);
+  m_scan_arena.reset();
+}
+//------------------------------------------------------------------
 //TODO: Is this intended to do something else?  Need to look into the todo there.
 uint64_t Blockchain::get_adjusted_time() const
 {
@@ -3567,6 +4046,7 @@ bool Blockchain::flush_txes_from_pool(const std::vector<crypto::hash> &txids)
 //      m_db->add_block()
 bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc)
 {
+  PERF_TIMER(handle_block_to_main_chain);
   LOG_PRINT_L3("Blockchain::" << __func__);
 
   TIME_MEASURE_START(block_processing_time);
@@ -3633,6 +4113,7 @@ leave:
   TIME_MEASURE_FINISH(target_calculating_time);
 
   TIME_MEASURE_START(longhash_calculating_time);
+  PERF_TIMER_START(block_pow);
 
   crypto::hash proof_of_work = null_hash;
 
@@ -3647,8 +4128,9 @@ leave:
   // validate proof_of_work versus difficulty target
   bool precomputed = false;
   bool fast_check = false;
+  const bool prevalidated = m_prevalidated_blocks.find(id) != m_prevalidated_blocks.end();
 #if defined(PER_BLOCK_CHECKPOINT)
-  if (m_db->height() < m_blocks_hash_check.size())
+  if (!prevalidated && m_db->height() < m_blocks_hash_check.size())
   {
     auto hash = get_block_hash(bl);
     const auto &expected_hash = m_blocks_hash_check[m_db->height()];
@@ -3669,6 +4151,7 @@ leave:
   }
   else
 #endif
+  if (!prevalidated)
   {
     auto it = m_blocks_longhash_table.find(id);
     if (it != m_blocks_longhash_table.end())
@@ -3701,6 +4184,7 @@ leave:
     }
   }
 
+  PERF_TIMER_STOP(block_pow);
   TIME_MEASURE_FINISH(longhash_calculating_time);
   if (precomputed)
     longhash_calculating_time += m_fake_pow_calc_time;
@@ -3721,12 +4205,18 @@ leave:
   std::vector<transaction> txs;
   key_images_container keys;
 
+  // ring signatures of the block's txs are verified together once every
+  // other input check has passed; txs is reserved so the pointers stay valid
+  std::vector<const rct::rctSig*> deferred_sigs;
+  std::vector<crypto::hash> deferred_sig_txids;
+
   uint64_t fee_summary = 0;
   uint64_t t_checktx = 0;
   uint64_t t_exists = 0;
   uint64_t t_pool = 0;
   uint64_t t_dblspnd = 0;
   TIME_MEASURE_FINISH(t3);
+  PERF_TIMER_START(block_tx_checks);
 
 // XXX old code adds miner tx here
 
@@ -3790,13 +4280,17 @@ leave:
     t_dblspnd += dd;
     TIME_MEASURE_START(cc);
 
+    // a prevalidated block's inputs were checked against this same chain state already
 #if defined(PER_BLOCK_CHECKPOINT)
-    if (!fast_check)
+    if (!prevalidated && !fast_check)
+#else
+    if (!prevalidated)
 #endif
     {
       // validate that transaction inputs and the keys spending them are correct.
       tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-      if(!check_tx_inputs(tx, tvc))
+      const size_t n_deferred = deferred_sigs.size();
+      if(!check_tx_inputs(txs.back(), tvc, NULL, &deferred_sigs))
       {
         MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -3807,9 +4301,11 @@ leave:
         return_tx_to_pool(txs);
         goto leave;
       }
+      if (deferred_sigs.size() != n_deferred)
+        deferred_sig_txids.push_back(tx_id);
     }
 #if defined(PER_BLOCK_CHECKPOINT)
-    else
+    else if (!prevalidated)
     {
       // ND: if fast_check is enabled for blocks, there is no need to check
       // the transaction inputs, but do some sanity checks anyway.
@@ -3833,6 +4329,33 @@ leave:
 
   m_blocks_txs_check.clear();
 
+  if (!deferred_sigs.empty())
+  {
+    TIME_MEASURE_START(sigs);
+    if (!rct::verRctNonSemanticsSimple(deferred_sigs))
+    {
+      // the batch only says that something failed; fall back to verifying
+      // each tx on its own so the offending one can be reported
+      for (size_t i = 0; i < deferred_sigs.size(); ++i)
+      {
+        if (!rct::verRctNonSemanticsSimple(*deferred_sigs[i]))
+        {
+          MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << deferred_sig_txids[i] << ") with wrong inputs.");
+          break;
+        }
+      }
+      MERROR_VER("Failed to check ringct signatures!");
+      add_block_as_invalid(bl, id);
+      MERROR_VER("Block with id " << id << " added as invalid because of wrong inputs in transactions");
+      bvc.m_verifivation_failed = true;
+      return_tx_to_pool(txs);
+      goto leave;
+    }
+    TIME_MEASURE_FINISH(sigs);
+    t_checktx += sigs;
+  }
+  PERF_TIMER_STOP(block_tx_checks);
+
   TIME_MEASURE_START(vmt);
   uint64_t base_reward = 0;
   uint64_t already_generated_coins = m_db->height() ? m_db->get_block_already_generated_coins(m_db->height() - 1) : 0;
@@ -3868,10 +4391,22 @@ leave:
   uint64_t new_height = 0;
   if (!bvc.m_verifivation_failed)
   {
+    PERF_TIMER(block_db_add);
     try
     {
       uint64_t long_term_block_weight = get_next_long_term_block_weight(block_weight);
       new_height = m_db->add_block(bl, block_weight, long_term_block_weight, cumulative_difficulty, already_generated_coins, txs);
+      add_block_control_reward(bl, new_height - 1);
+
+      // Once the next RandomX seed is known, get its cache ready before the
+      // chain switches over to it
+      if (bl.major_version >= RX_BLOCK_VERSION)
+      {
+        uint64_t seed_height, next_seed_height;
+        rx_seedheights(new_height, &seed_height, &next_seed_height);
+        if (next_seed_height != seed_height)
+          get_block_longhash_prepare_seed(next_seed_height, m_db->get_block_hash_from_height(next_seed_height));
+      }
     }
     catch (const KEY_IMAGE_EXISTS& e)
     {
@@ -3894,8 +4429,11 @@ leave:
     LOG_ERROR("Blocks that failed verification should not reach here");
   }
 
-  for (BlockAddedHook* hook : m_block_added_hooks)
-    hook->block_added(bl, txs);
+  {
+    PERF_TIMER(block_added_hooks);
+    for (BlockAddedHook* hook : m_block_added_hooks)
+      hook->block_added(bl, txs);
+  }
 
   TIME_MEASURE_FINISH(addblock);
 
@@ -3952,6 +4490,37 @@ bool Blockchain::prune_blockchain(uint32_t pruning_seed)
   return m_db->prune_blockchain(pruning_seed);
 }
 //------------------------------------------------------------------
+bool Blockchain::start_incremental_pruning(uint32_t pruning_seed)
+{
+  uint8_t hf_version = m_hardfork->get_current_version();
+  if (hf_version < cryptonote::network_version_11_infinite_staking)
+  {
+    MERROR("Most of the network will only be ready for pruned blockchains from v11, not pruning");
+    return false;
+  }
+  if (!m_db->start_incremental_pruning(pruning_seed))
+    return false;
+  m_pruning_in_progress = true;
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::incremental_pruning_step()
+{
+  if (!m_pruning_in_progress)
+    return true;
+
+  m_tx_pool.lock();
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  bool done = false;
+  if (!m_db->prune_step(CRYPTONOTE_PRUNING_STEP_RECORDS, done))
+    return false;
+  if (done)
+    m_pruning_in_progress = false;
+  return true;
+}
+//------------------------------------------------------------------
 bool Blockchain::update_blockchain_pruning()
 {
   m_tx_pool.lock();
@@ -3974,18 +4543,15 @@ uint64_t Blockchain::get_next_long_term_block_weight(uint64_t block_weight) cons
 {
   PERF_TIMER(get_next_long_term_block_weight);
 
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
   const uint64_t db_height = m_db->height();
-  const uint64_t nblocks = std::min<uint64_t>(m_long_term_block_weights_window, db_height);
 
   const uint8_t hf_version = get_current_hard_fork_version();
   if (hf_version < HF_VERSION_LONG_TERM_BLOCK_WEIGHT)
     return block_weight;
 
-  std::vector<uint64_t> weights;
-  weights.resize(nblocks);
-  for (uint64_t h = 0; h < nblocks; ++h)
-    weights[h] = m_db->get_block_long_term_weight(db_height - nblocks + h);
-  uint64_t long_term_median = epee::misc_utils::median(weights);
+  sync_block_weights_median(m_long_term_block_weights_median, db_height, true);
+  uint64_t long_term_median = m_long_term_block_weights_median.median.median();
   uint64_t long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
 
   uint64_t short_term_constraint = long_term_effective_median_block_weight + long_term_effective_median_block_weight * 2 / 5;
@@ -3994,11 +4560,35 @@ uint64_t Blockchain::get_next_long_term_block_weight(uint64_t block_weight) cons
   return long_term_block_weight;
 }
 //------------------------------------------------------------------
+void Blockchain::sync_block_weights_median(block_weights_median &m, uint64_t height, bool long_term) const
+{
+  const crypto::hash top_hash = height ? m_db->get_block_hash_from_height(height - 1) : crypto::null_hash;
+  if (m.height == height && m.top_hash == top_hash)
+    return;
+
+  if (height > 0 && m.height + 1 == height && (m.height == 0 || m_db->get_block_hash_from_height(m.height - 1) == m.top_hash))
+  {
+    m.median.insert(long_term ? m_db->get_block_long_term_weight(height - 1) : m_db->get_block_weight(height - 1));
+  }
+  else
+  {
+    m.median.clear();
+    const uint64_t nblocks = std::min<uint64_t>(m.median.capacity(), height);
+    const std::vector<uint64_t> weights = long_term ?
+        m_db->get_block_long_term_weights(height - nblocks, nblocks) : m_db->get_block_weights(height - nblocks, nblocks);
+    for (uint64_t weight: weights)
+      m.median.insert(weight);
+  }
+  m.height = height;
+  m.top_hash = top_hash;
+}
+//------------------------------------------------------------------
 bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effective_median_block_weight)
 {
   PERF_TIMER(update_next_cumulative_weight_limit);
 
   LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // when we reach this, the last hf version is not yet written to the db
   const uint64_t db_height = m_db->height();
@@ -4008,16 +4598,14 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
 
   if (hf_version < HF_VERSION_LONG_TERM_BLOCK_WEIGHT)
   {
-    std::vector<uint64_t> weights;
-    get_last_n_blocks_weights(weights, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
-    m_current_block_cumul_weight_median = epee::misc_utils::median(weights);
-    long_term_block_weight = weights.back();
+    sync_block_weights_median(m_block_weights_median, db_height, false);
+    m_current_block_cumul_weight_median = m_block_weights_median.median.median();
+    long_term_block_weight = m_db->get_block_weight(db_height - 1);
   }
   else
   {
     const uint64_t block_weight = m_db->get_block_weight(db_height - 1);
 
-    std::vector<uint64_t> weights, new_weights;
     uint64_t long_term_median;
     if (db_height == 1)
     {
@@ -4025,14 +4613,8 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
     }
     else
     {
-      uint64_t nblocks = std::min<uint64_t>(m_long_term_block_weights_window, db_height);
-      if (nblocks == db_height)
-        --nblocks;
-      weights.resize(nblocks);
-      for (uint64_t h = 0; h < nblocks; ++h)
-        weights[h] = m_db->get_block_long_term_weight(db_height - nblocks + h - 1);
-      new_weights = weights;
-      long_term_median = epee::misc_utils::median(weights);
+      sync_block_weights_median(m_long_term_block_weights_median, db_height - 1, true);
+      long_term_median = m_long_term_block_weights_median.median.median();
     }
 
     m_long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
@@ -4040,17 +4622,26 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
     uint64_t short_term_constraint = m_long_term_effective_median_block_weight + m_long_term_effective_median_block_weight * 2 / 5;
     long_term_block_weight = std::min<uint64_t>(block_weight, short_term_constraint);
 
-    if (new_weights.empty())
-      new_weights.resize(1);
-    new_weights[0] = long_term_block_weight;
-    long_term_median = epee::misc_utils::median(new_weights);
+    // the same window with its oldest weight replaced by the top block's,
+    // which is what rolling it forward gives once it is full and the top
+    // block was stored with this long term weight
+    if (db_height > 1 && m_long_term_block_weights_median.median.full() && m_db->get_block_long_term_weight(db_height - 1) == long_term_block_weight)
+    {
+      sync_block_weights_median(m_long_term_block_weights_median, db_height, true);
+      long_term_median = m_long_term_block_weights_median.median.median();
+    }
+    else
+    {
+      const uint64_t nblocks = db_height == 1 ? 1 : m_long_term_block_weights_median.median.size();
+      std::vector<uint64_t> new_weights = m_db->get_block_long_term_weights(db_height - nblocks, nblocks - 1);
+      new_weights.push_back(long_term_block_weight);
+      long_term_median = epee::misc_utils::median(new_weights);
+    }
     m_long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
     short_term_constraint = m_long_term_effective_median_block_weight + m_long_term_effective_median_block_weight * 2 / 5;
 
-    weights.clear();
-    get_last_n_blocks_weights(weights, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
-
-    uint64_t short_term_median = epee::misc_utils::median(weights);
+    sync_block_weights_median(m_block_weights_median, db_height, false);
+    uint64_t short_term_median = m_block_weights_median.median.median();
     uint64_t effective_median_block_weight = std::min<uint64_t>(std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, short_term_median), CRYPTONOTE_SHORT_TERM_BLOCK_WEIGHT_SURGE_FACTOR * m_long_term_effective_median_block_weight);
 
     m_current_block_cumul_weight_median = effective_median_block_weight;
@@ -4069,6 +4660,8 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
 //------------------------------------------------------------------
 bool Blockchain::add_new_block(const block& bl_, block_verification_context& bvc)
 {
+  PERF_TIMER(add_new_block);
+  ALLOC_SCOPE(block_validation);
   LOG_PRINT_L3("Blockchain::" << __func__);
   //copy block here to let modify block.target
   block bl = bl_;
@@ -4093,6 +4686,10 @@ bool Blockchain::add_new_block(const block& bl_, block_verification_context& bvc
     m_db->block_txn_stop();
     bool r = handle_alternative_block(bl, id, bvc);
     m_blocks_txs_check.clear();
+    // not from handle_alternative_block itself: it is reentered while
+    // switching chains, with iterators into m_alternative_chains held
+    if (m_alternative_chains.size() > BLOCKCHAIN_MAX_ALT_BLOCKS)
+      evict_stale_alternative_blocks(id);
     return r;
     //never relay alternative blocks
   }
@@ -4197,9 +4794,124 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
   TIME_MEASURE_FINISH(t);
 }
 
+//------------------------------------------------------------------
+void Blockchain::prefetch_incoming_blocks_longhash(const std::vector<block_complete_entry> &blocks_entry, uint64_t start_height)
+{
+  MTRACE("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+
+  if (m_longhash_prefetch)
+  {
+    m_longhash_prefetch->waiter.wait(&tpool);
+    m_longhash_prefetch.reset();
+  }
+
+  if (blocks_entry.empty() || m_cancel)
+    return;
+
+  std::unique_ptr<longhash_prefetch> prefetch(new longhash_prefetch());
+  size_t const nblocks    = blocks_entry.size();
+  prefetch->height        = start_height;
+  prefetch->main_height   = m_db->height();
+  prefetch->blocks.resize(nblocks);
+  prefetch->ids.resize(nblocks);
+  prefetch->seed_heights.resize(nblocks);
+  prefetch->seed_hashes.resize(nblocks);
+  prefetch->hashable.assign(nblocks, 0);
+  prefetch->have_pow.assign(nblocks, 0);
+  prefetch->pow.resize(nblocks);
+
+  for (size_t i = 0; i < nblocks; i++)
+  {
+    block &b = prefetch->blocks[i];
+    if (!parse_and_validate_block_from_blob(blocks_entry[i].block, b))
+      return;
+
+    prefetch->ids[i] = get_block_hash(b);
+    if (b.major_version >= RX_BLOCK_VERSION)
+    {
+      // The seed block may still be in the span being added, those blocks
+      // get hashed as usual in prepare_handle_incoming_blocks
+      prefetch->seed_heights[i] = rx_seedheight(start_height + i);
+      if (prefetch->seed_heights[i] >= prefetch->main_height)
+        continue;
+      prefetch->seed_hashes[i] = m_db->get_block_hash_from_height(prefetch->seed_heights[i]);
+    }
+    prefetch->hashable[i] = 1;
+  }
+
+  unsigned threads = std::min(tpool.get_max_concurrency(), static_cast<unsigned>(m_max_prepare_blocks_threads));
+  threads          = std::max(threads, 1u);
+  size_t const chunk_size = (nblocks + threads - 1) / threads;
+  longhash_prefetch *p    = prefetch.get();
+  for (size_t begin = 0; begin < nblocks; begin += chunk_size)
+  {
+    size_t const end = std::min(nblocks, begin + chunk_size);
+    tpool.submit(&p->waiter, [this, p, begin, end]() {
+      for (size_t i = begin; i < end && !m_cancel; i++)
+      {
+        if (!p->hashable[i])
+          continue;
+
+        block const &b = p->blocks[i];
+        if (b.major_version >= RX_BLOCK_VERSION)
+          get_altblock_longhash(b, p->pow[i], p->main_height, p->height + i, p->seed_heights[i], p->seed_hashes[i]);
+        else
+          p->pow[i] = get_block_longhash(NULL, b, p->height + i, 0);
+        p->have_pow[i] = 1;
+      }
+    }, true);
+  }
+
+  m_longhash_prefetch = std::move(prefetch);
+}
+//------------------------------------------------------------------
+bool Blockchain::take_prefetched_longhashes(uint64_t height, const std::vector<block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map)
+{
+  if (!m_longhash_prefetch)
+    return false;
+
+  std::unique_ptr<longhash_prefetch> prefetch = std::move(m_longhash_prefetch);
+  prefetch->waiter.wait(&tools::threadpool::getInstance());
+  if (m_cancel)
+    return false;
+
+  // Prefetched hashes are only used for the same block at the same height,
+  // computed with the seed block that is on the main chain now. A failed span
+  // or a reorg in between just means they go unused.
+  map.clear();
+  for (size_t i = 0; i < blocks.size(); i++)
+  {
+    uint64_t const block_height = height + i;
+    if (block_height < prefetch->height || block_height - prefetch->height >= prefetch->ids.size())
+      return false;
+
+    size_t const index    = block_height - prefetch->height;
+    crypto::hash const id = get_block_hash(blocks[i]);
+    if (!prefetch->have_pow[index] || prefetch->ids[index] != id)
+      return false;
+
+    if (blocks[i].major_version >= RX_BLOCK_VERSION)
+    {
+      uint64_t const seed_height = prefetch->seed_heights[index];
+      if (seed_height >= m_db->height() || m_db->get_block_hash_from_height(seed_height) != prefetch->seed_hashes[index])
+      {
+        MDEBUG("RandomX seed block at height " << seed_height << " changed since the PoW prefetch, dropping it");
+        map.clear();
+        return false;
+      }
+    }
+
+    map.emplace(id, prefetch->pow[index]);
+  }
+
+  return true;
+}
 //------------------------------------------------------------------
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 {
+  PERF_TIMER(cleanup_handle_incoming_blocks);
   bool success = false;
 
   MTRACE("Blockchain::" << __func__);
@@ -4224,7 +4936,8 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
         store_blockchain();
       m_sync_counter = 0;
     }
-    else if (m_db_sync_threshold && ((m_db_sync_on_blocks && m_sync_counter >= m_db_sync_threshold) || (!m_db_sync_on_blocks && m_bytes_to_sync >= m_db_sync_threshold)))
+    else if ((m_db_sync_threshold && ((m_db_sync_on_blocks && m_sync_counter >= m_db_sync_threshold) || (!m_db_sync_on_blocks && m_bytes_to_sync >= m_db_sync_threshold))) ||
+             (m_db_sync_max_latency && time(NULL) - m_last_db_sync >= (time_t)m_db_sync_max_latency))
     {
       MDEBUG("Sync threshold met, syncing");
       if(m_db_sync_mode == db_async)
@@ -4246,7 +4959,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 
   TIME_MEASURE_FINISH(t1);
   m_blocks_longhash_table.clear();
-  m_scan_table.clear();
+  reset_scan_table();
   m_blocks_txs_check.clear();
   m_check_txin_table.clear();
 
@@ -4271,7 +4984,7 @@ void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uin
 {
   try
   {
-    m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, outputs, true);
+    m_output_key_cache.get_output_keys(*m_db, amount, offsets, outputs, true);
   }
   catch (const std::exception& e)
   {
@@ -4336,6 +5049,11 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
       data.push_back(h);
   }
 
+  // hash all the complete spans we have at once, they're all the same size
+  size_t spans = std::min<size_t>(data.size() / HASH_OF_HASHES_STEP, m_blocks_hash_of_hashes.size() > first_index ? m_blocks_hash_of_hashes.size() - first_index : 0);
+  std::vector<crypto::hash> span_hashes(spans);
+  crypto::cn_fast_hash_many(data.data(), HASH_OF_HASHES_STEP * sizeof(crypto::hash), spans, span_hashes.data());
+
   // hash and check
   uint64_t usable = first_index * HASH_OF_HASHES_STEP - height; // may start negative, but unsigned under/overflow is not UB
   for (size_t n = first_index; n <= last_index; ++n)
@@ -4346,9 +5064,7 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
       if (data.size() < (n - first_index) * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP)
         break;
 
-      crypto::hash hash;
-      cn_fast_hash(data.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
-      bool valid = hash == m_blocks_hash_of_hashes[n];
+      bool valid = span_hashes[n - first_index] == m_blocks_hash_of_hashes[n];
 
       // add to the known hashes array
       if (!valid)
@@ -4408,22 +5124,85 @@ bool Blockchain::calc_batched_control_reward(uint64_t height, uint64_t &reward)
     num_blocks   = height;
   }
 
-  std::vector<std::pair<cryptonote::blobdata, cryptonote::block>> blocks;
-  if (!get_blocks(start_height, num_blocks, blocks))
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  uint64_t const end_height = start_height + num_blocks;
+  if (m_control_reward_sums.size() && m_control_reward_sums_height <= start_height &&
+      m_control_reward_sums_height + m_control_reward_sums.size() - 1 == m_db->height() && end_height <= m_db->height())
+  {
+    reward = m_control_reward_sums[end_height - m_control_reward_sums_height] - m_control_reward_sums[start_height - m_control_reward_sums_height];
+    return true;
+  }
+
+  if (start_height >= m_db->height())
   {
     LOG_ERROR("Unable to get historical blocks to calculated batched control payment");
     return false;
   }
 
-  for (const auto &it : blocks)
+  // Reseed the running totals from the blocks we just read so later payouts
+  // (and block templates for this height) don't have to hit the DB again.
+  bool const reseed = (end_height == m_db->height());
+  if (reseed)
   {
-    cryptonote::block const &block = it.second;
+    m_control_reward_sums_height = start_height;
+    m_control_reward_sums.assign(1, 0);
+  }
+
+  // only the header and miner tx are needed, not the tx hash list
+  db_read_session read_session(*m_db);
+  block_header_view block;
+  for (uint64_t h = start_height; h < end_height && h < m_db->height(); ++h)
+  {
+    if (!get_block_header_view_by_height(h, block, true))
+    {
+      LOG_ERROR("Unable to get historical blocks to calculated batched control payment");
+      m_control_reward_sums.clear();
+      return false;
+    }
+    uint64_t block_control = 0;
     if (block.major_version >= network_version_10_bulletproofs)
-      reward += derive_control_from_block_reward(nettype(), block);
+      block_control = derive_control_from_block_reward(nettype(), block, block.miner_tx);
+
+    reward += block_control;
+    if (reseed)
+      m_control_reward_sums.push_back(m_control_reward_sums.back() + block_control);
   }
 
   return true;
 }
+//------------------------------------------------------------------
+void Blockchain::add_block_control_reward(const block &bl, uint64_t height) const
+{
+  if (m_control_reward_sums.empty() || m_control_reward_sums_height + m_control_reward_sums.size() - 1 != height)
+  {
+    // Not tracking the tail of the chain, calc_batched_control_reward reseeds
+    m_control_reward_sums.clear();
+    return;
+  }
+
+  uint64_t block_control = 0;
+  if (bl.major_version >= network_version_10_bulletproofs)
+    block_control = derive_control_from_block_reward(nettype(), bl);
+  m_control_reward_sums.push_back(m_control_reward_sums.back() + block_control);
+
+  const cryptonote::config_t &network = cryptonote::get_config(nettype(), bl.major_version);
+  while (m_control_reward_sums.size() > network.CONTROL_REWARD_INTERVAL_IN_BLOCKS + 1)
+  {
+    m_control_reward_sums.pop_front();
+    m_control_reward_sums_height++;
+  }
+}
+//------------------------------------------------------------------
+void Blockchain::pop_block_control_reward(uint64_t height)
+{
+  if (m_control_reward_sums.size() < 2 || m_control_reward_sums_height + m_control_reward_sums.size() - 1 != height + 1)
+  {
+    m_control_reward_sums.clear();
+    return;
+  }
+
+  m_control_reward_sums.pop_back();
+}
 
 //------------------------------------------------------------------
 // ND: Speedups:
@@ -4432,8 +5211,43 @@ bool Blockchain::calc_batched_control_reward(uint64_t height, uint64_t &reward)
 //    vs [k_image, output_keys] (m_scan_table). This is faster because it takes advantage of bulk queries
 //    and is threaded if possible. The table (m_scan_table) will be used later when querying output
 //    keys.
-bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry)
+bool Blockchain::prevalidate_checkpointed_blocks(const std::vector<block_complete_entry> &blocks_entry, uint64_t height, std::vector<block> &blocks)
+{
+  PERF_TIMER(prevalidate_checkpointed_blocks);
+  blocks.resize(blocks_entry.size());
+  std::atomic<bool> valid(true);
+  tools::threadpool::getInstance().parallel_for(blocks_entry.size(), [&](size_t i) {
+    if (!valid)
+      return;
+    try
+    {
+      const crypto::hash &expected_hash = m_blocks_hash_check[height + i];
+      if (expected_hash == crypto::null_hash || !parse_and_validate_block_from_blob(blocks_entry[i].block, blocks[i]) ||
+          get_block_hash(blocks[i]) != expected_hash)
+        valid = false;
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Exception prevalidating block at height " << height + i << ": " << e.what());
+      valid = false;
+    }
+  }, true, 16);
+
+  // the blocks will go through the usual checks one at a time, which
+  // will report whichever one is wrong
+  if (!valid || blocks.front().prev_id != m_db->top_block_hash())
+  {
+    MDEBUG("Span at height " << height << " does not match the compiled in block hashes, not prevalidated");
+    blocks.clear();
+    return false;
+  }
+  MDEBUG("Prevalidated " << blocks.size() << " blocks at height " << height << " against the compiled in block hashes");
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &parsed_blocks)
 {
+  PERF_TIMER(prepare_handle_incoming_blocks);
   MTRACE("Blockchain::" << __func__);
   TIME_MEASURE_START(prepare);
   bool stop_batch;
@@ -4478,9 +5292,15 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
     m_blockchain_lock.lock();
   }
 
+  parsed_blocks.clear();
   const uint64_t height = m_db->height();
   if ((height + blocks_entry.size()) < m_blocks_hash_check.size())
+  {
+    // PoW and tx inputs are not checked below the compiled in hashes, so the
+    // scan table and PoW hashes are not needed, only the block hashes
+    prevalidate_checkpointed_blocks(blocks_entry, height, parsed_blocks);
     return true;
+  }
 
   bool blocks_exist = false;
   tools::threadpool& tpool = tools::threadpool::getInstance();
@@ -4546,7 +5366,11 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       std::advance(it, 1);
     }
 
-    if (!blocks_exist)
+    if (!blocks_exist && take_prefetched_longhashes(height, blocks, m_blocks_longhash_table))
+    {
+      MDEBUG("PoW of all " << blocks.size() << " blocks was prefetched");
+    }
+    else if (!blocks_exist)
     {
       m_blocks_longhash_table.clear();
       uint64_t thread_height = height;
@@ -4588,7 +5412,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   m_fake_scan_time = 0;
   m_fake_pow_calc_time = 0;
 
-  m_scan_table.clear();
+  reset_scan_table();
   m_check_txin_table.clear();
 
   TIME_MEASURE_FINISH(prepare);
@@ -4610,7 +5434,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
 #define SCAN_TABLE_QUIT(m) \
         do { \
             MERROR_VER(m) ;\
-            m_scan_table.clear(); \
+            reset_scan_table(); \
             return false; \
         } while(0); \
 
@@ -4637,7 +5461,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       if (its != m_scan_table.end())
         SCAN_TABLE_QUIT("Duplicate tx found from incoming blocks.");
 
-      m_scan_table.emplace(tx_prefix_hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>());
+      m_scan_table.emplace(tx_prefix_hash, scan_key_images_t(scan_key_images_t::allocator_type(m_scan_arena)));
       its = m_scan_table.find(tx_prefix_hash);
       assert(its != m_scan_table.end());
 
@@ -4763,7 +5587,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
             break;
         }
 
-        its->second.emplace(in_to_key.k_image, outputs);
+        its->second.emplace(in_to_key.k_image, scan_outputs_t(outputs.begin(), outputs.end(), scan_outputs_t::allocator_type(m_scan_arena)));
       }
     }
   }
@@ -4819,7 +5643,7 @@ bool Blockchain::for_all_txpool_txes(std::function<bool(const crypto::hash&, con
   return m_db->for_all_txpool_txes(f, include_blob, include_unrelayed_txes);
 }
 
-void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold, blockchain_db_sync_mode sync_mode, bool fast_sync)
+void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold, blockchain_db_sync_mode sync_mode, bool fast_sync, uint64_t sync_max_latency, bool sync_auto)
 {
   if (sync_mode == db_defaultsync)
   {
@@ -4830,9 +5654,28 @@ void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint
   m_fast_sync = fast_sync;
   m_db_sync_on_blocks = sync_on_blocks;
   m_db_sync_threshold = sync_threshold;
+  m_db_sync_auto = sync_auto && !sync_on_blocks;
+  m_db_sync_max_latency = sync_max_latency;
+  m_last_db_sync = time(NULL);
   m_max_prepare_blocks_threads = maxthreads;
 }
 
+void Blockchain::on_idle()
+{
+  if (!m_db_sync_max_latency || time(NULL) - m_last_db_sync < (time_t)m_db_sync_max_latency)
+    return;
+  if (m_db_sync_mode == db_async)
+  {
+    // claim this period now, so later idle calls don't queue more syncs
+    m_last_db_sync = time(NULL);
+    m_async_service.dispatch(boost::bind(&Blockchain::store_blockchain, this));
+  }
+  else if (m_db_sync_mode == db_sync)
+  {
+    store_blockchain();
+  }
+}
+
 void Blockchain::safesyncmode(const bool onoff)
 {
   /* all of this is no-op'd if the user set a specific
@@ -4869,33 +5712,77 @@ std::list<std::pair<Blockchain::block_extended_info,std::vector<crypto::hash>>>
 {
   std::list<std::pair<Blockchain::block_extended_info,std::vector<crypto::hash>>> chains;
 
-  for (const auto &i: m_alternative_chains)
+  for (const auto &tip: m_alternative_tips)
   {
-    const crypto::hash &top = i.first;
-    bool found = false;
-    for (const auto &j: m_alternative_chains)
+    const crypto::hash &top = tip.first;
+    blocks_ext_by_hash::const_iterator i = m_alternative_chains.find(top);
+    CHECK_AND_ASSERT_THROW_MES(i != m_alternative_chains.end(), "Alternative chain tip " << top << " not found");
+    std::vector<crypto::hash> chain;
+    auto h = i->second.bl.prev_id;
+    chain.push_back(top);
+    blocks_ext_by_hash::const_iterator prev;
+    while ((prev = m_alternative_chains.find(h)) != m_alternative_chains.end())
     {
-      if (j.second.bl.prev_id == top)
-      {
-        found = true;
-        break;
-      }
+      chain.push_back(h);
+      h = prev->second.bl.prev_id;
     }
-    if (!found)
+    chains.push_back(std::make_pair(i->second, chain));
+  }
+  return chains;
+}
+
+void Blockchain::rebuild_alternative_tips()
+{
+  std::unordered_set<crypto::hash> parents;
+  for (const auto &i: m_alternative_chains)
+    parents.insert(i.second.bl.prev_id);
+
+  std::unordered_map<crypto::hash, uint64_t> tips;
+  for (const auto &i: m_alternative_chains)
+  {
+    if (parents.count(i.first))
+      continue;
+    auto old = m_alternative_tips.find(i.first);
+    tips[i.first] = old == m_alternative_tips.end() ? 0 : old->second;
+  }
+  m_alternative_tips = std::move(tips);
+}
+
+void Blockchain::evict_stale_alternative_blocks(const crypto::hash &keep)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  std::unordered_map<crypto::hash, size_t> children;
+  for (const auto &i: m_alternative_chains)
+    ++children[i.second.bl.prev_id];
+
+  size_t evicted = 0;
+  while (m_alternative_chains.size() > BLOCKCHAIN_MAX_ALT_BLOCKS)
+  {
+    auto lru = m_alternative_tips.end();
+    for (auto it = m_alternative_tips.begin(); it != m_alternative_tips.end(); ++it)
+      if (it->first != keep && (lru == m_alternative_tips.end() || it->second < lru->second))
+        lru = it;
+    if (lru == m_alternative_tips.end())
+      break;
+
+    crypto::hash h = lru->first;
+    m_alternative_tips.erase(lru);
+    blocks_ext_by_hash::iterator it;
+    while ((it = m_alternative_chains.find(h)) != m_alternative_chains.end())
     {
-      std::vector<crypto::hash> chain;
-      auto h = i.second.bl.prev_id;
-      chain.push_back(top);
-      blocks_ext_by_hash::const_iterator prev;
-      while ((prev = m_alternative_chains.find(h)) != m_alternative_chains.end())
-      {
-        chain.push_back(h);
-        h = prev->second.bl.prev_id;
-      }
-      chains.push_back(std::make_pair(i.second, chain));
+      const crypto::hash parent = it->second.bl.prev_id;
+      m_alternative_chains.erase(it);
+      ++evicted;
+      auto c = children.find(parent);
+      if (c == children.end() || --c->second > 0)
+        break; // the parent is shared with another branch, or is on the main chain
+      children.erase(c);
+      h = parent;
     }
   }
-  return chains;
+  if (evicted)
+    MINFO("Dropped " << evicted << " stale alternative blocks, " << m_alternative_chains.size() << " left in " << m_alternative_tips.size() << " chains");
 }
 
 void Blockchain::cancel()
@@ -5035,23 +5922,28 @@ bool Blockchain::for_all_outputs(uint64_t amount, std::function<bool(uint64_t he
 void Blockchain::invalidate_block_template_cache()
 {
   MDEBUG("Invalidating block template cache");
-  m_btc_valid = false;
+  m_btc.clear();
 }
 
-void Blockchain::cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t expected_reward, uint64_t pool_cookie)
+void Blockchain::cache_block_template(const block_template_cache &btc)
 {
   MDEBUG("Setting block template cache");
-  m_btc = b;
-  m_btc_address = address;
-  m_btc_nonce = nonce;
-  m_btc_difficulty = diff;
-  m_btc_expected_reward = expected_reward;
-  m_btc_pool_cookie = pool_cookie;
-  m_btc_valid = true;
+  // a template for the same miner and nonce replaces the older one
+  for (auto it = m_btc.begin(); it != m_btc.end(); ++it)
+  {
+    if (!memcmp(&btc.address, &it->address, sizeof(cryptonote::account_public_address)) && it->nonce == btc.nonce)
+    {
+      m_btc.erase(it);
+      break;
+    }
+  }
+  m_btc.push_front(btc);
+  if (m_btc.size() > BLOCK_TEMPLATE_CACHE_SIZE)
+    m_btc.pop_back();
 }
 
 namespace cryptonote {
-template bool Blockchain::get_transactions(const std::vector<crypto::hash>&, std::vector<transaction>&, std::vector<crypto::hash>&) const;
+template bool Blockchain::get_transactions(const std::vector<crypto::hash>&, std::vector<transaction>&, std::vector<crypto::hash>&, bool) const;
 template bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>&, std::vector<cryptonote::blobdata>&, std::vector<crypto::hash>&, bool) const;
 template bool Blockchain::get_split_transactions_blobs(const std::vector<crypto::hash>&, std::vector<std::tuple<crypto::hash, cryptonote::blobdata, crypto::hash, cryptonote::blobdata>>&, std::vector<crypto::hash>&) const;
 }
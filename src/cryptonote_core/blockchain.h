@@ -39,8 +39,11 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/circular_buffer.hpp>
 #include <atomic>
+#include <deque>
+#include <memory>
 #include <functional>
 #include <unordered_map>
+#include <list>
 #include <unordered_set>
 
 #include "span.h"
@@ -48,6 +51,9 @@
 #include "string_tools.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "common/util.h"
+#include "common/arena.h"
+#include "common/rolling_median.h"
+#include "cryptonote_core/output_key_cache.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/difficulty.h"
@@ -113,6 +119,7 @@ namespace cryptonote
       size_t block_cumulative_weight; //!< the weight of the block
       difficulty_type cumulative_difficulty; //!< the accumulated difficulty after that block
       uint64_t already_generated_coins; //!< the total coins minted after that block
+      crypto::hash pow; //!< the block's proof of work hash, checked when it was added as alternative
     };
 
     class BlockAddedHook
@@ -177,6 +184,19 @@ namespace cryptonote
      */
     bool init(BlockchainDB* db, HardFork*& hf, const network_type nettype = MAINNET, bool offline = false);
 
+    /**
+     * @brief catch up with blocks another process added to or popped from the DB
+     *
+     * For a replica, whose read only DB is written by a primary daemon: the
+     * blocks the primary added or popped since the last call are passed to
+     * the block added and detached hooks as if they had been handled here,
+     * and the cached chain state (hard fork window, weight limits,
+     * difficulty) is brought up to date.
+     *
+     * @return true on success, false if the DB could not be read
+     */
+    bool sync_from_db();
+
     /**
      * @brief Uninitializes the blockchain state
      *
@@ -216,6 +236,21 @@ namespace cryptonote
      */
     bool get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata,block>>& blocks) const;
 
+    /**
+     * @brief decodes only the header, and optionally the miner tx, of the block at a height
+     *
+     * For walkers that need a header field or the miner tx outputs and not
+     * the tx hash list; the blob is read in place when a db read session
+     * is active.
+     *
+     * @param height the height of the block
+     * @param v return-by-reference the decoded header view
+     * @param with_miner_tx whether to also decode the miner tx and count the txes
+     *
+     * @return false if the block does not exist or fails to parse, else true
+     */
+    bool get_block_header_view_by_height(uint64_t height, block_header_view &v, bool with_miner_tx) const;
+
     /**
      * @brief compiles a list of all blocks stored as alternative chains
      *
@@ -267,11 +302,28 @@ namespace cryptonote
     /**
      * @brief performs some preprocessing on a group of incoming blocks to speed up verification
      *
-     * @param blocks a list of incoming blocks
+     * Spans entirely below the compiled in block hashes are parsed and hashed
+     * in parallel and checked against those hashes as a whole; the parsed
+     * blocks are then handed back so they need not be parsed again.
+     *
+     * @param blocks_entry a list of incoming blocks
+     * @param parsed_blocks return-by-reference the parsed blocks, if prevalidated, else empty
      *
      * @return false on erroneous blocks, else true
      */
-    bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks);
+    bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks_entry, std::vector<block> &parsed_blocks);
+
+    /**
+     * @brief starts hashing the PoW of the span that follows the one being handled
+     *
+     * The hashes are computed on the threadpool while the current span is
+     * validated and committed, prepare_handle_incoming_blocks picks them up
+     * if the span is the next one to be added.
+     *
+     * @param blocks the blocks of the next span
+     * @param start_height the height the first block will be added at
+     */
+    void prefetch_incoming_blocks_longhash(const std::vector<block_complete_entry> &blocks, uint64_t start_height);
 
     /**
      * @brief incoming blocks post-processing, cleanup, and disk sync
@@ -496,12 +548,45 @@ namespace cryptonote
      */
     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_count) const;
 
+    /**
+     * @brief works out which blocks find_blockchain_supplement would return, without reading them
+     *
+     * The response size cap is applied to block weights rather than blob
+     * sizes, which can only make the range shorter.  Meant for callers that
+     * stream the blocks out one at a time via get_blockchain_supplement_block.
+     *
+     * @param req_start_block if non-zero, specifies a start point (otherwise find most recent commonality)
+     * @param qblock_ids the foreign chain's "short history" (see get_short_chain_history)
+     * @param max_count the max number of blocks to get
+     * @param start_height return-by-reference the height of the first block
+     * @param count return-by-reference the number of blocks
+     * @param total_height return-by-reference our current blockchain height
+     *
+     * @return true if a block found in common or req_start_block specified, else false
+     */
+    bool get_blockchain_supplement_range(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, size_t max_count, uint64_t& start_height, uint64_t& count, uint64_t& total_height) const;
+
+    /**
+     * @brief gets one block of a supplement: its blob, miner tx hash and tx blobs
+     *
+     * @param height the block's height
+     * @param pruned whether to return full or pruned tx blobs
+     * @param get_miner_tx_hash whether to fill in the miner tx hash (null hash otherwise)
+     * @param entry return-by-reference the block and its transactions
+     * @param size incremented by the size of the blobs returned
+     *
+     * @return false if the block or one of its transactions could not be read
+     */
+    bool get_blockchain_supplement_block(uint64_t height, bool pruned, bool get_miner_tx_hash, std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > >& entry, size_t& size) const;
+
     /**
      * @brief retrieves a set of blocks and their transactions, and possibly other transactions
      *
      * the request object encapsulates a list of block hashes and a (possibly empty) list of
      * transaction hashes.  for each block hash, the block is fetched along with all of that
      * block's transactions.  Any transactions requested separately are fetched afterwards.
+     * All the lookups share one db read session and the blockchain lock is not taken, so
+     * several requests may be served at once from other threads.
      *
      * @param arg the request
      * @param rsp return-by-reference the response to fill in
@@ -599,6 +684,13 @@ namespace cryptonote
      */
     bool store_blockchain();
 
+    /**
+     * @brief adjusts the sync threshold after a sync when it is set to auto
+     *
+     * @param sync_ms how long the sync took
+     */
+    void tune_db_sync_threshold(uint64_t sync_ms);
+
     /**
      * @brief validates a transaction's inputs
      *
@@ -747,7 +839,7 @@ namespace cryptonote
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     bool get_split_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const;
     template<class t_ids_container, class t_tx_container, class t_missed_container>
-    bool get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const;
+    bool get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool pruned = false) const;
 
     //debug functions
 
@@ -792,9 +884,21 @@ namespace cryptonote
      * @param sync_threshold number of blocks/bytes to cache before syncing to database
      * @param sync_mode the ::blockchain_db_sync_mode to use
      * @param fast_sync sync using built-in block hashes as trusted
+     * @param sync_max_latency if non zero, sync whenever that many seconds
+     *        passed since the last sync instead of using sync_threshold
+     * @param sync_auto if true, sync_threshold is only the starting point and
+     *        is retuned after every sync from how long the sync took
      */
     void set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold,
-        blockchain_db_sync_mode sync_mode, bool fast_sync);
+        blockchain_db_sync_mode sync_mode, bool fast_sync, uint64_t sync_max_latency = 0, bool sync_auto = false);
+
+    /**
+     * @brief syncs the db if the configured max sync latency has passed
+     *
+     * Called periodically so that writes on a quiet node (pool changes,
+     * or a last block) do not stay unsynced longer than configured.
+     */
+    void on_idle();
 
     /**
      * @brief sets a block notify object to call for every new block
@@ -1034,6 +1138,8 @@ namespace cryptonote
     uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes);
     uint32_t get_blockchain_pruning_seed() const { return m_db->get_blockchain_pruning_seed(); }
     bool prune_blockchain(uint32_t pruning_seed = 0);
+    bool start_incremental_pruning(uint32_t pruning_seed = 0);
+    bool incremental_pruning_step();
     bool update_blockchain_pruning();
     bool check_blockchain_pruning();
 
@@ -1054,11 +1160,19 @@ namespace cryptonote
     /**
      * @brief add a hook for processing new blocks and rollbacks for reorgs
      */
-    void hook_block_added        (BlockAddedHook& hook)         { m_block_added_hooks.push_back(&hook); }
-    void hook_blockchain_detached(BlockchainDetachedHook& hook) { m_blockchain_detached_hooks.push_back(&hook); }
+    void hook_block_added        (BlockAddedHook& hook)         { CRITICAL_REGION_LOCAL(m_blockchain_lock); m_block_added_hooks.push_back(&hook); }
+    void hook_blockchain_detached(BlockchainDetachedHook& hook) { CRITICAL_REGION_LOCAL(m_blockchain_lock); m_blockchain_detached_hooks.push_back(&hook); }
     void hook_init               (InitHook& hook)               { m_init_hooks.push_back(&hook); }
     void hook_validate_miner_tx  (ValidateMinerTxHook& hook)    { m_validate_miner_tx_hooks.push_back(&hook); }
 
+    /**
+     * @brief remove a hook added with hook_block_added/hook_blockchain_detached
+     *
+     * For hooks that do not live as long as the Blockchain.
+     */
+    void unhook_block_added        (BlockAddedHook& hook);
+    void unhook_blockchain_detached(BlockchainDetachedHook& hook);
+
     /**
      * @brief returns the timestamps of the last N blocks
      */
@@ -1106,8 +1220,22 @@ namespace cryptonote
     size_t m_current_block_cumul_weight_median;
 
     // metadata containers
-    std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
+    // the scan table only lives for one batch of incoming blocks, so it is
+    // allocated from an arena that is reset along with it
+    template<typename T> using scan_allocator = tools::arena_allocator<T>;
+    typedef std::vector<output_data_t, scan_allocator<output_data_t>> scan_outputs_t;
+    typedef std::unordered_map<crypto::key_image, scan_outputs_t, std::hash<crypto::key_image>, std::equal_to<crypto::key_image>,
+        scan_allocator<std::pair<const crypto::key_image, scan_outputs_t>>> scan_key_images_t;
+    typedef std::unordered_map<crypto::hash, scan_key_images_t, std::hash<crypto::hash>, std::equal_to<crypto::hash>,
+        scan_allocator<std::pair<const crypto::hash, scan_key_images_t>>> scan_table_t;
+    tools::arena m_scan_arena;
+    scan_table_t m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
+    // blocks being put back by a failed chain switch, already validated
+    // against the very chain state they are re-added on
+    std::unordered_set<crypto::hash> m_prevalidated_blocks;
+    // ring members resolved for the scan table or for pool txes, kept across batches
+    mutable output_key_cache m_output_key_cache;
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, bool>> m_check_txin_table;
 
     // SHA-3 hashes for each block and for fast pow checking
@@ -1120,18 +1248,36 @@ namespace cryptonote
     bool m_show_time_stats;
     bool m_db_default_sync;
     bool m_db_sync_on_blocks;
-    uint64_t m_db_sync_threshold;
+    std::atomic<uint64_t> m_db_sync_threshold; //!< retuned by the async sync thread when m_db_sync_auto is set
+    bool m_db_sync_auto;
+    uint64_t m_db_sync_auto_last; //!< tick count at the end of the last sync, for m_db_sync_auto
+    uint64_t m_db_sync_max_latency; //!< seconds, 0 when syncing on m_db_sync_threshold
+    std::atomic<time_t> m_last_db_sync;
     uint64_t m_max_prepare_blocks_threads;
     uint64_t m_fake_pow_calc_time;
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
     uint64_t m_bytes_to_sync;
-    std::vector<uint64_t> m_timestamps;
-    std::vector<difficulty_type> m_difficulties;
+    // timestamps and cumulative difficulties of the main chain blocks
+    // [m_timestamps_and_difficulties_height - m_timestamps.size(), m_timestamps_and_difficulties_height),
+    // only meaningful while m_timestamps_and_difficulties_height is non zero
+    std::deque<uint64_t> m_timestamps;
+    std::deque<difficulty_type> m_difficulties;
     uint64_t m_timestamps_and_difficulties_height;
     uint64_t m_long_term_block_weights_window;
     uint64_t m_long_term_effective_median_block_weight;
 
+    // rolling median of the last blocks below height, whose top block is
+    // top_hash, so every new block costs O(log window) instead of a reload
+    struct block_weights_median
+    {
+      tools::rolling_median<uint64_t> median;
+      uint64_t height = 0;
+      crypto::hash top_hash = crypto::null_hash;
+    };
+    mutable block_weights_median m_block_weights_median;
+    mutable block_weights_median m_long_term_block_weights_median;
+
     epee::critical_section m_difficulty_lock;
     crypto::hash m_difficulty_for_next_block_top_hash;
     difficulty_type m_difficulty_for_next_block;
@@ -1142,6 +1288,8 @@ namespace cryptonote
 
     // all alternative chains
     blocks_ext_by_hash m_alternative_chains; // crypto::hash -> block_extended_info
+    std::unordered_map<crypto::hash, uint64_t> m_alternative_tips; // tip of each alternative chain -> m_alternative_tips_seq when it was last extended
+    uint64_t m_alternative_tips_seq;
 
     // some invalid blocks
     blocks_ext_by_hash m_invalid_blocks;     // crypto::hash -> block_extended_info
@@ -1161,15 +1309,28 @@ namespace cryptonote
     difficulty_type m_fixed_difficulty;
 
     std::atomic<bool> m_cancel;
+    std::atomic<bool> m_pruning_in_progress; // an incremental pruning may still have work left
 
     // block template cache
-    block m_btc;
-    account_public_address m_btc_address;
-    blobdata m_btc_nonce;
-    difficulty_type m_btc_difficulty;
-    uint64_t m_btc_pool_cookie;
-    uint64_t m_btc_expected_reward;
-    bool m_btc_valid;
+    struct block_template_cache
+    {
+      block b;
+      account_public_address address;
+      blobdata nonce;
+      difficulty_type difficulty;
+      uint64_t pool_cookie;
+      uint64_t expected_reward;
+
+      // what the miner tx was built from: while none of these change, a
+      // template for new pool contents can keep the same miner tx
+      size_t median_weight;
+      uint64_t already_generated_coins;
+      size_t txs_weight;
+      uint64_t fee;
+      antd_miner_tx_context miner_context;
+    };
+    //! templates for the current tip, most recently used first
+    std::list<block_template_cache> m_btc;
 
     std::shared_ptr<tools::Notify> m_block_notify;
     std::shared_ptr<tools::Notify> m_reorg_notify;
@@ -1177,6 +1338,25 @@ namespace cryptonote
     uint64_t m_prepare_height;
     uint64_t m_prepare_nblocks;
     std::vector<block> *m_prepare_blocks;
+
+    // Running totals of derive_control_from_block_reward over the tail of the
+    // main chain: m_control_reward_sums[i] is the control reward of the blocks
+    // in [m_control_reward_sums_height, m_control_reward_sums_height + i).
+    mutable uint64_t             m_control_reward_sums_height;
+    mutable std::deque<uint64_t> m_control_reward_sums;
+
+    // replica only: hashes of the latest blocks passed to the hooks, below
+    // m_replica_height, to find where the primary's chain forked from them
+    std::deque<crypto::hash> m_replica_hashes;
+    uint64_t                 m_replica_height;
+
+    // m_cumulative_rct_outputs[h] is the number of rct outputs in blocks
+    // [0, h]; filled lazily by get_output_distribution, truncated on pop
+    mutable std::vector<uint64_t> m_cumulative_rct_outputs;
+
+    // PoW hashes being computed ahead for the next incoming span
+    struct longhash_prefetch;
+    std::unique_ptr<longhash_prefetch> m_longhash_prefetch;
     /**
      * @brief collects the keys for all outputs being "spent" as an input
      *
@@ -1221,6 +1401,11 @@ namespace cryptonote
      */
     bool check_tx_input(size_t tx_version,const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, const rct::rctSig &rct_signatures, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height);
 
+    /**
+     * @brief drops the scan table and everything allocated for it
+     */
+    void reset_scan_table();
+
     /**
      * @brief validate a transaction's inputs and their keys
      *
@@ -1238,10 +1423,19 @@ namespace cryptonote
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param deferred_sigs if not NULL, simple ringct signatures are appended here for the caller
+     *        to verify in one batch instead of being verified immediately; the pointers refer into tx
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL);
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, std::vector<const rct::rctSig*> *deferred_sigs = NULL);
+
+    /**
+     * @brief picks the first height of a supplement: req_start_block if set, else the split point from qblock_ids
+     *
+     * @return false if req_start_block is past our chain or no common block was found
+     */
+    bool find_supplement_start_height(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& start_height) const;
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
@@ -1318,6 +1512,19 @@ namespace cryptonote
      */
     difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei) const;
 
+    /**
+     * @brief copies main chain timestamps and cumulative difficulties out of the
+     * next-block difficulty window cache
+     *
+     * @param start_height the first height wanted
+     * @param stop_height one past the last height wanted
+     * @param timestamps the timestamps are appended here
+     * @param cumulative_difficulties the cumulative difficulties are appended here
+     *
+     * @return false if the cache does not cover the whole range, in which case nothing is appended
+     */
+    bool get_cached_difficulty_window(uint64_t start_height, uint64_t stop_height, std::vector<uint64_t>& timestamps, std::vector<difficulty_type>& cumulative_difficulties) const;
+
     /**
      * @brief sanity checks a miner transaction before validating an entire block
      *
@@ -1475,8 +1682,56 @@ namespace cryptonote
      * @return true
      */
     bool update_next_cumulative_weight_limit(uint64_t *long_term_effective_median_block_weight = NULL);
+
+    /**
+     * @brief brings a rolling median of block weights up to the main chain blocks below a height
+     *
+     * The median is extended by one block when it ends right below the new
+     * top block, and rebuilt from the db otherwise, e.g. after blocks were
+     * popped or on first use.
+     *
+     * @param m the rolling median to update
+     * @param height the height of the first block past the window
+     * @param long_term whether the window holds long term block weights
+     */
+    void sync_block_weights_median(block_weights_median &m, uint64_t height, bool long_term) const;
     void return_tx_to_pool(std::vector<transaction> &txs);
 
+    /**
+     * @brief append a main chain block to the batched control reward totals
+     *
+     * @param bl the block that was added
+     * @param height the height it was added at
+     */
+    void add_block_control_reward(const block &bl, uint64_t height) const;
+
+    /**
+     * @brief remove the top block popped at height from the batched control reward totals
+     */
+    void pop_block_control_reward(uint64_t height);
+
+    /**
+     * @brief parses and hashes a span below the compiled in block hashes in parallel
+     *
+     * @param blocks_entry the incoming blocks
+     * @param height the height the first block will be added at
+     * @param blocks return-by-reference the parsed blocks, with their hashes cached
+     *
+     * @return true if every block parsed and matched its compiled in hash
+     */
+    bool prevalidate_checkpointed_blocks(const std::vector<block_complete_entry> &blocks_entry, uint64_t height, std::vector<block> &blocks);
+
+    /**
+     * @brief waits for any prefetched PoW hashes and hands them over
+     *
+     * @param height the height of the first block in blocks
+     * @param blocks the blocks being prepared
+     * @param map return-by-reference block hash to PoW hash for the prefetched blocks
+     *
+     * @return true if every block in blocks had its PoW prefetched
+     */
+    bool take_prefetched_longhashes(uint64_t height, const std::vector<block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map);
+
     /**
      * @brief make sure a transaction isn't attempting a double-spend
      *
@@ -1525,10 +1780,27 @@ namespace cryptonote
     void invalidate_block_template_cache();
 
     /**
-     * @brief stores a new cached block template
+     * @brief stores a new cached block template, evicting the least
+     * recently used one past BLOCK_TEMPLATE_CACHE_SIZE
      *
      * At some point, may be used to push an update to miners
      */
-    void cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t expected_reward, uint64_t pool_cookie);
+    void cache_block_template(const block_template_cache &btc);
+
+    /**
+     * @brief recomputes m_alternative_tips after blocks were removed from m_alternative_chains
+     */
+    void rebuild_alternative_tips();
+
+    /**
+     * @brief drops the least recently extended alternative branches until at most
+     * BLOCKCHAIN_MAX_ALT_BLOCKS alternative blocks are left
+     *
+     * A branch is dropped from its tip down to the block it shares with
+     * another branch, or to the main chain.
+     *
+     * @param keep a tip which must not be dropped
+     */
+    void evict_stale_alternative_blocks(const crypto::hash &keep);
   };
 }  // namespace cryptonote
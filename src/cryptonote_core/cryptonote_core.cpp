@@ -36,6 +36,7 @@ using namespace epee;
 
 #include <unordered_set>
 #include <iomanip>
+#include <future>
 
 #include "cryptonote_core.h"
 #include "common/util.h"
@@ -110,6 +111,12 @@ namespace cryptonote
     "offline"
   , "Do not listen for peers, nor connect to any"
   };
+  const command_line::arg_descriptor<std::string> arg_replica_of = {
+    "replica-of"
+  , "Serve RPC as a read replica of the daemon whose --data-dir this is, opening its DB read only; "
+    "the address is that daemon's ZMQ publisher (--zmq-pub-bind-port), e.g. tcp://127.0.0.1:18084"
+  , ""
+  };
   const command_line::arg_descriptor<bool> arg_disable_dns_checkpoints = {
     "disable-dns-checkpoints"
   , "Do not retrieve checkpoints from DNS"
@@ -159,6 +166,11 @@ namespace cryptonote
   , "How many blocks to sync at once during chain synchronization (0 = adaptive)."
   , 0
   };
+  static const command_line::arg_descriptor<size_t> arg_sync_bulletproof_batch  = {
+    "sync-bulletproof-batch"
+  , "Max number of bulletproofs to verify in one batch across the blocks being synced (0 = verify per block)."
+  , 1024
+  };
   static const command_line::arg_descriptor<std::string> arg_check_updates = {
     "check-updates"
   , "Check for new versions of antd: [disabled|notify|download|update]"
@@ -218,6 +230,12 @@ namespace cryptonote
   , ""
   };
 
+  static const command_line::arg_descriptor<size_t> arg_light_wallet_accounts  = {
+    "light-wallet-accounts"
+  , "Scan new blocks for up to this many light wallet view keys and serve them over the light wallet RPC calls, 0 to disable"
+  , 0
+  };
+
   const command_line::arg_descriptor<uint64_t> arg_recalculate_difficulty = {
     "recalculate-difficulty",
     "Recalculate per-block difficulty starting from the height specified",
@@ -229,6 +247,7 @@ namespace cryptonote
               m_full_node_list(m_blockchain_storage),
               m_blockchain_storage(m_mempool, m_full_node_list, m_deregister_vote_pool),
               m_quorum_cop(*this),
+              m_light_wallet_scanner(m_blockchain_storage),
               m_miner(this, &m_blockchain_storage),
               m_miner_address(boost::value_initialized<account_public_address>()),
               m_starter_message_showed(false),
@@ -237,9 +256,12 @@ namespace cryptonote
               m_last_dns_checkpoints_update(0),
               m_last_json_checkpoints_update(0),
               m_disable_dns_checkpoints(false),
+              m_sync_bulletproof_batch(0),
+              m_prepared_block_index(0),
               m_update_download(0),
               m_nettype(UNDEFINED),
               m_update_available(false),
+              m_replica(false),
               m_pad_transactions(false)
   {
     m_checkpoints_updating.clear();
@@ -328,11 +350,13 @@ namespace cryptonote
     command_line::add_arg(desc, arg_fast_block_sync);
     command_line::add_arg(desc, arg_show_time_stats);
     command_line::add_arg(desc, arg_block_sync_size);
+    command_line::add_arg(desc, arg_sync_bulletproof_batch);
     command_line::add_arg(desc, arg_check_updates);
     command_line::add_arg(desc, arg_fluffy_blocks);
     command_line::add_arg(desc, arg_no_fluffy_blocks);
     command_line::add_arg(desc, arg_test_dbg_lock_sleep);
     command_line::add_arg(desc, arg_offline);
+    command_line::add_arg(desc, arg_replica_of);
     command_line::add_arg(desc, arg_disable_dns_checkpoints);
     command_line::add_arg(desc, arg_block_download_max_size);
     command_line::add_arg(desc, arg_max_txpool_weight);
@@ -342,6 +366,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_prune_blockchain);
     command_line::add_arg(desc, arg_reorg_notify);
     command_line::add_arg(desc, arg_block_rate_notify);
+    command_line::add_arg(desc, arg_light_wallet_accounts);
 
     command_line::add_arg(desc, arg_recalculate_difficulty);
 #if defined(ANTD_ENABLE_INTEGRATION_TEST_HOOKS)
@@ -387,7 +412,8 @@ namespace cryptonote
     test_drop_download_height(command_line::get_arg(vm, arg_test_drop_download_height));
     m_fluffy_blocks_enabled = !get_arg(vm, arg_no_fluffy_blocks);
     m_pad_transactions = get_arg(vm, arg_pad_transactions);
-    m_offline = get_arg(vm, arg_offline);
+    m_replica = !command_line::is_arg_defaulted(vm, arg_replica_of);
+    m_offline = get_arg(vm, arg_offline) || m_replica;
     m_disable_dns_checkpoints = get_arg(vm, arg_disable_dns_checkpoints);
     if (!command_line::is_arg_defaulted(vm, arg_fluffy_blocks))
       MWARNING(arg_fluffy_blocks.name << " is obsolete, it is now default");
@@ -396,6 +422,11 @@ namespace cryptonote
       test_drop_download();
 
     m_full_node = command_line::get_arg(vm, arg_full_node);
+    if (m_full_node && m_replica)
+    {
+      MERROR("--" << arg_full_node.name << " and --" << arg_replica_of.name << " cannot be used together");
+      return false;
+    }
 
     epee::debug::g_test_dbg_lock_sleep() = command_line::get_arg(vm, arg_test_dbg_lock_sleep);
 
@@ -512,18 +543,21 @@ namespace cryptonote
     std::string db_type = command_line::get_arg(vm, cryptonote::arg_db_type);
     std::string db_sync_mode = command_line::get_arg(vm, cryptonote::arg_db_sync_mode);
     bool db_salvage = command_line::get_arg(vm, cryptonote::arg_db_salvage) != 0;
+    bool db_compress = command_line::get_arg(vm, cryptonote::arg_db_compress) != 0;
     bool fast_sync = command_line::get_arg(vm, arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, arg_prep_blocks_threads);
     std::string check_updates_string = command_line::get_arg(vm, arg_check_updates);
     size_t max_txpool_weight = command_line::get_arg(vm, arg_max_txpool_weight);
     bool prune_blockchain = command_line::get_arg(vm, arg_prune_blockchain);
 
+    // Steps that do not need the database run alongside opening and loading it:
+    //  - the full node key is needed before the full node list hooks into Blockchain::init
+    //  - the miner only needs to be ready by the end of init
+    // std::async futures join in their destructors, so early returns below are safe
+    std::future<bool> full_node_key_ready, miner_ready;
     if (m_full_node)
-    {
-      r = init_full_node_key();
-      CHECK_AND_ASSERT_MES(r, false, "Failed to create or load fullnode key");
-      m_full_node_list.set_my_full_node_keys(&m_full_node_pubkey);
-    }
+      full_node_key_ready = std::async(std::launch::async, [this]() { return init_full_node_key(); });
+    miner_ready = std::async(std::launch::async, [this, &vm]() { return m_miner.init(vm, m_nettype); });
 
     boost::filesystem::path folder(m_config_folder);
     if (m_nettype == FAKECHAIN)
@@ -564,8 +598,10 @@ namespace cryptonote
     blockchain_db_sync_mode sync_mode = db_defaultsync;
     bool sync_on_blocks = true;
     uint64_t sync_threshold = 1;
+    uint64_t sync_max_latency = 0;
+    bool sync_auto = false;
 
-    if (m_nettype == FAKECHAIN)
+    if (m_nettype == FAKECHAIN && !m_replica)
     {
 #if !defined(ANTD_ENABLE_INTEGRATION_TEST_HOOKS) // In integration mode, don't delete the DB. This should be explicitly done in the tests. Otherwise the more likely behaviour is persisting the DB across multiple daemons in the same test.
       // reset the db by removing the database file before opening it
@@ -630,7 +666,16 @@ namespace cryptonote
           sync_mode = db_sync_mode_is_default ? db_defaultsync : db_async;
       }
 
-      if(options.size() >= 3 && !safemode)
+      if(options.size() >= 3 && !safemode && options[2] == "auto")
+      {
+        // bytes per sync, retuned from the measured sync time; rotational
+        // disks start with bigger batches
+        const boost::optional<bool> hdd = tools::is_hdd(filename.c_str());
+        sync_on_blocks = false;
+        sync_threshold = (hdd && *hdd ? 512 : 128) * 1024 * 1024;
+        sync_auto = true;
+      }
+      else if(options.size() >= 3 && !safemode)
       {
         char *endptr;
         uint64_t threshold = strtoull(options[2].c_str(), &endptr, 0);
@@ -644,6 +689,13 @@ namespace cryptonote
           sync_on_blocks = false;
           sync_threshold = threshold;
         }
+        else if (!strcmp(endptr, "seconds"))
+        {
+          // group commit: every commit is left unsynced, and all of those
+          // made in the last <threshold> seconds are synced at once
+          sync_threshold = 0;
+          sync_max_latency = threshold;
+        }
         else
         {
           LOG_ERROR("Invalid db sync mode: " << options[2]);
@@ -653,6 +705,11 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_compress)
+        db_flags |= DBF_COMPRESS;
+      // the primary owns the environment; we only read it and follow along
+      if (m_replica)
+        db_flags = DBF_RDONLY | DBF_REPLICA;
 
       db->open(filename, db_flags);
       if(!db->m_open)
@@ -665,7 +722,7 @@ namespace cryptonote
     }
 
     m_blockchain_storage.set_user_options(blocks_threads,
-        sync_on_blocks, sync_threshold, sync_mode, fast_sync);
+        sync_on_blocks, sync_threshold, sync_mode, fast_sync, sync_max_latency, sync_auto);
 
     try
     {
@@ -705,6 +762,13 @@ namespace cryptonote
 
     const difficulty_type fixed_difficulty = command_line::get_arg(vm, arg_fixed_difficulty);
 
+    if (m_full_node)
+    {
+      r = full_node_key_ready.get();
+      CHECK_AND_ASSERT_MES(r, false, "Failed to create or load fullnode key");
+      m_full_node_list.set_my_full_node_keys(&m_full_node_pubkey);
+    }
+
     BlockchainDB *initialized_db = db.release();
     m_full_node_list.set_db_pointer(initialized_db);
     m_full_node_list.register_hooks(m_quorum_cop);
@@ -719,12 +783,14 @@ namespace cryptonote
       initialized_db->fixup(context);
     }
 
-    r = m_mempool.init(max_txpool_weight);
+    // the pool snapshot belongs to the primary, a replica rebuilds its indexes from the DB
+    r = m_mempool.init(max_txpool_weight, m_replica ? std::string() : (folder / CRYPTONOTE_POOL_SNAPSHOT_FILENAME).string());
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
     // now that we have a valid m_blockchain_storage, we can clean out any
     // transactions in the pool that do not conform to the current fork
-    m_mempool.validate(m_blockchain_storage.get_current_hard_fork_version());
+    if (!m_replica)
+      m_mempool.validate(m_blockchain_storage.get_current_hard_fork_version());
 
     bool show_time_stats = command_line::get_arg(vm, arg_show_time_stats) != 0;
     m_blockchain_storage.set_show_time_stats(show_time_stats);
@@ -733,12 +799,15 @@ namespace cryptonote
     block_sync_size = command_line::get_arg(vm, arg_block_sync_size);
     if (block_sync_size > BLOCKS_SYNCHRONIZING_MAX_COUNT)
       MERROR("Error --block-sync-size cannot be greater than " << BLOCKS_SYNCHRONIZING_MAX_COUNT);
+    m_sync_bulletproof_batch = command_line::get_arg(vm, arg_sync_bulletproof_batch);
 
     MGINFO("Loading checkpoints");
 
     // load json & DNS checkpoints, and verify them
-    // with respect to what blocks we already have
-    CHECK_AND_ASSERT_MES(update_checkpoints(), false, "One or more checkpoints loaded from json or dns conflicted with existing checkpoints.");
+    // with respect to what blocks we already have; a replica takes whatever
+    // the primary accepted
+    if (!m_replica)
+      CHECK_AND_ASSERT_MES(update_checkpoints(), false, "One or more checkpoints loaded from json or dns conflicted with existing checkpoints.");
 
    // DNS versions checking
     if (check_updates_string == "disabled")
@@ -754,17 +823,26 @@ namespace cryptonote
       return false;
     }
 
-    r = m_miner.init(vm, m_nettype);
+    r = miner_ready.get();
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize miner instance");
 
-    if (prune_blockchain)
+    if (prune_blockchain && m_replica)
+      MWARNING("--" << arg_prune_blockchain.name << " is ignored on a replica, prune the primary instead");
+    else if (prune_blockchain)
     {
       // display a message if the blockchain is not pruned yet
-      if (m_blockchain_storage.get_current_blockchain_height() > 1 && !m_blockchain_storage.get_blockchain_pruning_seed())
-        MGINFO("Pruning blockchain...");
-      CHECK_AND_ASSERT_MES(m_blockchain_storage.prune_blockchain(), false, "Failed to prune blockchain");
+      // existing txes get pruned in the background, a step at a time, so the
+      // node is usable right away; a restart carries on where it stopped
+      if (!m_blockchain_storage.get_blockchain_pruning_seed())
+      {
+        if (m_blockchain_storage.get_current_blockchain_height() > 1)
+          MGINFO("Pruning blockchain in the background...");
+        CHECK_AND_ASSERT_MES(m_blockchain_storage.start_incremental_pruning(), false, "Failed to prune blockchain");
+      }
     }
 
+    m_light_wallet_scanner.start(command_line::get_arg(vm, arg_light_wallet_accounts));
+
     return load_state_data();
   }
   //-----------------------------------------------------------------------------------------------
@@ -815,6 +893,7 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::deinit()
   {
+    m_light_wallet_scanner.stop();
     m_full_node_list.store();
     m_full_node_list.set_db_pointer(nullptr);
     m_miner.stop();
@@ -944,6 +1023,8 @@ namespace cryptonote
 
       if (tx_info[n].tx->get_type() != transaction::type_standard)
         continue;
+      if (keeped_by_block && m_span_verified_semantics.count(tx_info[n].tx_hash))
+        continue; // already batch verified with the rest of its span
       const rct::rctSig &rv = tx_info[n].tx->rct_signatures;
       switch (rv.type) {
         case rct::RCTTypeNull:
@@ -1020,7 +1101,26 @@ namespace cryptonote
   bool core::handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay)
   {
     TRY_ENTRY();
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+
+    if (m_replica)
+    {
+      MERROR("Refusing incoming txes: this daemon is a read replica");
+      tvc.resize(tx_blobs.size());
+      for (auto &ctx : tvc)
+        ctx.m_verifivation_failed = true;
+      return false;
+    }
+
+    // Parsing and semantics checks run without m_incoming_tx_lock, so a large
+    // tx batch does not hold up block handling while it is being verified.
+    // Only txes kept by block consult m_span_verified_semantics, and those
+    // come from block handling, which holds the lock for the whole span.
+    if (keeped_by_block)
+      m_incoming_tx_lock.lock();
+    auto incoming_tx_unlocker = epee::misc_utils::create_scope_leave_handler([&]() {
+      if (keeped_by_block)
+        m_incoming_tx_lock.unlock();
+    });
 
     struct result { bool res; cryptonote::transaction tx; crypto::hash hash; crypto::hash prefix_hash; };
     std::vector<result> results(tx_blobs.size());
@@ -1085,6 +1185,16 @@ namespace cryptonote
     if (!tx_info.empty())
       handle_incoming_tx_accumulated_batch(tx_info, keeped_by_block);
 
+    // Admit the whole message under one db write txn instead of one per tx,
+    // since per tx commits and their syncs dominate at high tx rates. The
+    // pool and blockchain locks are held for the duration, taken in the same
+    // order as the pool takes them, so no other thread writes in between.
+    // add_new_tx checks again for txes which arrived while we were verifying.
+    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    epee::critical_region_t<tx_memory_pool> pool_lock(m_mempool);
+    epee::critical_region_t<Blockchain> blockchain_lock(m_blockchain_storage);
+    db_write_batch batch(m_blockchain_storage.get_db(), tx_info.size() > 1);
+
     bool ok = true;
     it = tx_blobs.begin();
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
@@ -1246,11 +1356,11 @@ namespace cryptonote
     return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT_PRE_V4;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
+  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_sensitive_data) const
   {
     spent.clear();
 
-    return m_mempool.check_for_key_images(key_im, spent);
+    return m_mempool.check_for_key_images(key_im, spent, include_sensitive_data);
   }
   //-----------------------------------------------------------------------------------------------
   std::pair<uint64_t, uint64_t> core::get_coinbase_tx_sum(const uint64_t start_offset, const size_t count)
@@ -1377,12 +1487,11 @@ namespace cryptonote
   {
     if (m_full_node)
     {
-      cryptonote_connection_context fake_context {};
       NOTIFY_UPTIME_PROOF::request r;
       m_quorum_cop.generate_uptime_proof_request(r);
-      bool relayed = get_protocol()->relay_uptime_proof(r, fake_context);
 
-      if (relayed)
+      // goes out with the next batch of verified proofs
+      if (m_quorum_cop.handle_uptime_proof(r))
         MGINFO("Submitted uptime-proof for fullnode (yours): " << m_full_node_pubkey);
     }
     return true;
@@ -1394,9 +1503,14 @@ namespace cryptonote
     return result;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::handle_uptime_proof(const NOTIFY_UPTIME_PROOF::request &proof)
+  bool core::handle_uptime_proof(const NOTIFY_UPTIME_PROOF::request &proof, bool from_sync, const boost::uuids::uuid &source)
   {
-    return m_quorum_cop.handle_uptime_proof(proof);
+    return m_quorum_cop.handle_uptime_proof(proof, from_sync, source);
+  }
+  //-----------------------------------------------------------------------------------------------
+  std::vector<NOTIFY_UPTIME_PROOF::request> core::get_uptime_proofs() const
+  {
+    return m_quorum_cop.get_uptime_proofs();
   }
   //-----------------------------------------------------------------------------------------------
   void core::on_transaction_relayed(const cryptonote::blobdata& tx_blob)
@@ -1427,6 +1541,16 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::relay_uptime_proofs()
+  {
+    std::vector<boost::uuids::uuid> sources;
+    std::vector<NOTIFY_UPTIME_PROOF::request> proofs = m_quorum_cop.verify_queued_uptime_proofs(sources);
+    if (!proofs.empty())
+      get_protocol()->relay_uptime_proofs(proofs, sources);
+
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
   {
     return m_blockchain_storage.create_block_template(b, adr, diffic, height, expected_reward, ex_nonce);
@@ -1493,6 +1617,11 @@ namespace cryptonote
   bool core::handle_block_found(block& b)
   {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    if (m_replica)
+    {
+      MERROR("Refusing found block: this daemon is a read replica");
+      return false;
+    }
     m_miner.pause();
     std::vector<block_complete_entry> blocks;
     try
@@ -1558,10 +1687,107 @@ namespace cryptonote
   bool core::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks)
   {
     m_incoming_tx_lock.lock();
-    m_blockchain_storage.prepare_handle_incoming_blocks(blocks);
+    m_blockchain_storage.prepare_handle_incoming_blocks(blocks, m_prepared_blocks);
+    m_prepared_block_blobs.clear();
+    m_prepared_block_index = 0;
+    if (!m_prepared_blocks.empty())
+    {
+      m_prepared_block_blobs.reserve(blocks.size());
+      for (const block_complete_entry &entry: blocks)
+        m_prepared_block_blobs.push_back(entry.block);
+    }
+    prevalidate_incoming_blocks_semantics(blocks);
     return true;
   }
 
+  //-----------------------------------------------------------------------------------------------
+  void core::prevalidate_incoming_blocks_semantics(const std::vector<block_complete_entry> &blocks)
+  {
+    m_span_verified_semantics.clear();
+    if (m_sync_bulletproof_batch == 0 || get_blockchain_storage().is_within_compiled_block_hash_area())
+      return;
+
+    struct span_tx { cryptonote::transaction tx; crypto::hash hash; bool usable; };
+    std::vector<span_tx> txs;
+    for (const block_complete_entry &entry: blocks)
+      txs.resize(txs.size() + entry.txs.size());
+    if (txs.empty())
+      return;
+
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    size_t i = 0;
+    for (const block_complete_entry &entry: blocks)
+    {
+      for (const blobdata &blob: entry.txs)
+      {
+        tpool.submit(&waiter, [&, i] {
+          span_tx &stx = txs[i];
+          stx.usable = false;
+          crypto::hash prefix_hash;
+          if (blob.size() > get_max_tx_size() || !parse_tx_from_blob(stx.tx, stx.hash, prefix_hash, blob))
+            return;
+          if (stx.tx.get_type() != transaction::type_standard)
+            return;
+          const rct::rctSig &rv = stx.tx.rct_signatures;
+          if (rv.type != rct::RCTTypeBulletproof && rv.type != rct::RCTTypeBulletproof2 && rv.type != rct::RCTTypeCLSAG)
+            return;
+          stx.usable = is_canonical_bulletproof_layout(rv.p.bulletproofs);
+        });
+        ++i;
+      }
+    }
+    waiter.wait(&tpool);
+
+    std::vector<const rct::rctSig*> rvv;
+    std::vector<const crypto::hash*> hashes;
+    for (const span_tx &stx: txs)
+    {
+      if (!stx.usable)
+        continue;
+      rvv.push_back(&stx.tx.rct_signatures);
+      hashes.push_back(&stx.hash);
+    }
+
+    std::vector<bool> verified;
+    const size_t n_failed = verify_rct_semantics_in_batches(rvv, m_sync_bulletproof_batch, verified);
+    for (size_t n = 0; n < hashes.size(); ++n)
+      if (verified[n])
+        m_span_verified_semantics.insert(*hashes[n]);
+
+    MDEBUG("Batch verified rct semantics of " << m_span_verified_semantics.size() << "/" << txs.size() << " span txs, "
+        << n_failed << " batches failed");
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  size_t core::verify_rct_semantics_in_batches(const std::vector<const rct::rctSig*> &rvv, size_t max_proofs, std::vector<bool> &verified)
+  {
+    verified.assign(rvv.size(), false);
+    size_t n_failed = 0;
+    size_t begin = 0;
+    while (begin < rvv.size())
+    {
+      size_t end = begin, n_proofs = 0;
+      do
+        n_proofs += rvv[end++]->p.bulletproofs.size();
+      while (end < rvv.size() && n_proofs + rvv[end]->p.bulletproofs.size() <= max_proofs);
+
+      const std::vector<const rct::rctSig*> batch(rvv.begin() + begin, rvv.begin() + end);
+      if (rct::verRctSemanticsSimple(batch))
+        std::fill(verified.begin() + begin, verified.begin() + end, true);
+      else
+        ++n_failed;
+      begin = end;
+    }
+    return n_failed;
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void core::prefetch_incoming_blocks_longhash(const std::vector<block_complete_entry> &blocks, uint64_t start_height)
+  {
+    m_blockchain_storage.prefetch_incoming_blocks_longhash(blocks, start_height);
+  }
+
   //-----------------------------------------------------------------------------------------------
   bool core::cleanup_handle_incoming_blocks(bool force_sync)
   {
@@ -1570,15 +1796,35 @@ namespace cryptonote
       success = m_blockchain_storage.cleanup_handle_incoming_blocks(force_sync);
     }
     catch (...) {}
+    m_span_verified_semantics.clear();
+    m_prepared_blocks.clear();
+    m_prepared_block_blobs.clear();
     m_incoming_tx_lock.unlock();
     return success;
   }
 
+  //-----------------------------------------------------------------------------------------------
+  bool core::take_prepared_block(const blobdata& block_blob, block &b)
+  {
+    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    if (m_prepared_block_index >= m_prepared_blocks.size() || m_prepared_block_blobs[m_prepared_block_index] != block_blob)
+      return false;
+    b = m_prepared_blocks[m_prepared_block_index++];
+    return true;
+  }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate)
   {
     TRY_ENTRY();
 
+    if (m_replica)
+    {
+      bvc = boost::value_initialized<block_verification_context>();
+      bvc.m_verifivation_failed = true;
+      MERROR("Refusing incoming block: this daemon is a read replica");
+      return false;
+    }
+
     // load json & DNS checkpoints every 10min/hour respectively,
     // and verify them with respect to what blocks we already have
     CHECK_AND_ASSERT_MES(update_checkpoints(), false, "One or more checkpoints loaded from json or dns conflicted with existing checkpoints.");
@@ -1592,7 +1838,7 @@ namespace cryptonote
     }
 
     block b = AUTO_VAL_INIT(b);
-    if(!parse_and_validate_block_from_blob(block_blob, b))
+    if(!take_prepared_block(block_blob, b) && !parse_and_validate_block_from_blob(block_blob, b))
     {
       LOG_PRINT_L1("Failed to parse and validate new block");
       bvc.m_verifivation_failed = true;
@@ -1744,7 +1990,9 @@ namespace cryptonote
     if(!m_starter_message_showed)
     {
       std::string main_message;
-      if (m_offline)
+      if (m_replica)
+        main_message = "The daemon is a read replica and follows the primary daemon's database.";
+      else if (m_offline)
         main_message = "The daemon is running offline and will not attempt to sync to the Antd network.";
       else
         main_message = "The daemon will start synchronizing with the network. This may take a long time to complete.";
@@ -1761,12 +2009,16 @@ namespace cryptonote
     }
 
     m_fork_moaner.do_call(boost::bind(&core::check_fork_time, this));
+    // everything below either writes to the DB or talks to peers, which the primary does
+    if (m_replica)
+      return true;
     m_txpool_auto_relayer.do_call(boost::bind(&core::relay_txpool_transactions, this));
     m_deregisters_auto_relayer.do_call(boost::bind(&core::relay_deregister_votes, this));
     // m_check_updates_interval.do_call(boost::bind(&core::check_updates, this));
     m_check_disk_space_interval.do_call(boost::bind(&core::check_disk_space, this));
     m_block_rate_interval.do_call(boost::bind(&core::check_block_rate, this));
     m_diff_recalc_interval.do_call(boost::bind(&core::recalculate_difficulties, this));
+    m_blockchain_storage.on_idle();
 
     time_t const lifetime = time(nullptr) - get_start_time();
     if (m_full_node && lifetime > DIFFICULTY_TARGET_V2) // Give us some time to connect to peers before sending uptimes
@@ -1774,9 +2026,11 @@ namespace cryptonote
       do_uptime_proof_call();
     }
 
+    m_uptime_proof_relayer.do_call(boost::bind(&core::relay_uptime_proofs, this));
     m_uptime_proof_pruner.do_call(boost::bind(&full_nodes::quorum_cop::prune_uptime_proof, &m_quorum_cop));
 
     m_blockchain_pruning_interval.do_call(boost::bind(&core::update_blockchain_pruning, this));
+    m_pruning_step_interval.do_call(boost::bind(&Blockchain::incremental_pruning_step, &m_blockchain_storage));
     m_miner.on_idle();
     m_mempool.on_idle();
 
@@ -1787,6 +2041,18 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::sync_from_primary(bool chain, bool pool)
+  {
+    CHECK_AND_ASSERT_MES(m_replica, false, "Only a replica syncs from a primary");
+    bool r = true;
+    // the chain goes first, the pool drops txes that it just mined
+    if (chain)
+      r &= m_blockchain_storage.sync_from_db();
+    if (pool)
+      r &= m_mempool.sync_from_db();
+    return r;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::check_fork_time()
   {
     HardFork::State state = m_blockchain_storage.get_hard_fork_state();
@@ -2070,7 +2336,18 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   const std::shared_ptr<const full_nodes::quorum_state> core::get_quorum_state(uint64_t height) const
   {
-    return m_full_node_list.get_quorum_state(height);
+    std::shared_ptr<const full_nodes::quorum_state> result = m_full_node_list.get_quorum_state(height);
+    if (!result)
+      result = m_full_node_list.get_archived_quorum_state(height);
+    return result;
+  }
+  //-----------------------------------------------------------------------------------------------
+  const std::shared_ptr<const full_nodes::quorum_state> core::get_quorum_state_snapshot(uint64_t height) const
+  {
+    std::shared_ptr<const full_nodes::quorum_state> result = m_full_node_list.get_snapshot()->get_quorum_state(height);
+    if (!result)
+      result = m_full_node_list.get_archived_quorum_state(height);
+    return result;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::is_full_node(const crypto::public_key& pubkey) const
@@ -2078,10 +2355,9 @@ namespace cryptonote
     return m_full_node_list.is_full_node(pubkey);
   }
   //-----------------------------------------------------------------------------------------------
-  const std::vector<full_nodes::key_image_blacklist_entry> &core::get_full_node_blacklisted_key_images() const
+  std::vector<full_nodes::key_image_blacklist_entry> core::get_full_node_blacklisted_key_images() const
   {
-    const auto &result = m_full_node_list.get_blacklisted_key_images();
-    return result;
+    return m_full_node_list.get_blacklisted_key_images_snapshot();
   }
   //-----------------------------------------------------------------------------------------------
   std::vector<full_nodes::full_node_pubkey_info> core::get_full_node_list_state(const std::vector<crypto::public_key> &full_node_pubkeys) const
@@ -2167,9 +2443,19 @@ namespace cryptonote
     return get_blockchain_storage().prune_blockchain(pruning_seed);
   }
   //-----------------------------------------------------------------------------------------------
-  void core::get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only) const
+  bool core::start_incremental_pruning(uint32_t pruning_seed)
+  {
+    return get_blockchain_storage().start_incremental_pruning(pruning_seed);
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only, crypto::hash *keys_hash) const
+  {
+    m_full_node_list.get_all_full_nodes_public_keys(keys, fully_funded_nodes_only, keys_hash);
+  }
+  //-----------------------------------------------------------------------------------------------
+  crypto::hash core::get_all_full_nodes_public_keys_hash(bool fully_funded_nodes_only) const
   {
-    m_full_node_list.get_all_full_nodes_public_keys(keys, fully_funded_nodes_only);
+    return m_full_node_list.get_all_full_nodes_public_keys_hash(fully_funded_nodes_only);
   }
   //-----------------------------------------------------------------------------------------------
   std::time_t core::get_start_time() const
@@ -43,6 +43,7 @@
 #include "blockchain.h"
 #include "full_node_deregister.h"
 #include "full_node_list.h"
+#include "light_wallet_scanner.h"
 #include "full_node_quorum_cop.h"
 #include "constants.h"
 #include "cryptonote_basic/miner.h"
@@ -67,6 +68,7 @@ namespace cryptonote
   extern const command_line::arg_descriptor<bool, false> arg_regtest_on;
   extern const command_line::arg_descriptor<difficulty_type> arg_fixed_difficulty;
   extern const command_line::arg_descriptor<bool> arg_offline;
+  extern const command_line::arg_descriptor<std::string> arg_replica_of;
   extern const command_line::arg_descriptor<size_t> arg_block_download_max_size;
   extern const command_line::arg_descriptor<uint64_t> arg_recalculate_difficulty;
 
@@ -114,11 +116,24 @@ namespace cryptonote
      /**
       * @brief handles an incoming uptime proof
       *
-      * Parses an incoming uptime proof
+      * Parses an incoming uptime proof and queues it for verification, the
+      * proof is relayed by relay_uptime_proofs once its signature checks out.
       *
-      * @return true if we haven't seen it before and thus need to relay.
+      * @param proof the uptime proof
+      * @param from_sync true if a peer sent it in answer to our request for
+      *        its proofs: it may be older and is not relayed
+      * @param source the connection it came in on, it is not relayed back there
+      *
+      * @return true if we haven't seen it before and it was queued.
+      */
+     bool handle_uptime_proof(const NOTIFY_UPTIME_PROOF::request &proof, bool from_sync = false, const boost::uuids::uuid &source = boost::uuids::nil_uuid());
+
+     /**
+      * @brief get the latest uptime proof of each full node we know of
+      *
+      * @return the proofs, to send to a peer asking for them
       */
-     bool handle_uptime_proof(const NOTIFY_UPTIME_PROOF::request &proof);
+     std::vector<NOTIFY_UPTIME_PROOF::request> get_uptime_proofs() const;
 
      /**
       * @brief handles an incoming transaction
@@ -169,12 +184,27 @@ namespace cryptonote
      bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate = true);
 
      /**
-      * @copydoc Blockchain::prepare_handle_incoming_blocks
+      * @brief performs some preprocessing on a group of incoming blocks to speed up verification
+      *
+      * Blocks parsed while prevalidating the span are kept until
+      * cleanup_handle_incoming_blocks, handle_incoming_block uses them
+      * instead of parsing the same blobs again.
+      *
+      * @param blocks a list of incoming blocks
+      *
+      * @return true
       *
       * @note see Blockchain::prepare_handle_incoming_blocks
       */
      bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks);
 
+     /**
+      * @copydoc Blockchain::prefetch_incoming_blocks_longhash
+      *
+      * @note see Blockchain::prefetch_incoming_blocks_longhash
+      */
+     void prefetch_incoming_blocks_longhash(const std::vector<block_complete_entry> &blocks, uint64_t start_height);
+
      /**
       * @copydoc Blockchain::cleanup_handle_incoming_blocks
       *
@@ -249,6 +279,19 @@ namespace cryptonote
       */
      static void init_options(boost::program_options::options_description& desc);
 
+     /**
+      * @brief verifies rct semantics in consecutive batches of up to max_proofs bulletproofs
+      *
+      * A signature carrying more than max_proofs bulletproofs gets a batch of its own.
+      *
+      * @param rvv the signatures to verify, in order
+      * @param max_proofs the max number of bulletproofs per batch
+      * @param verified return-by-reference whether the batch of each signature passed
+      *
+      * @return the number of batches that failed
+      */
+     static size_t verify_rct_semantics_in_batches(const std::vector<const rct::rctSig*> &rvv, size_t max_proofs, std::vector<bool> &verified);
+
      /**
       * @brief initializes the core as needed
       *
@@ -506,6 +549,13 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count() const;
 
+     /**
+      * @copydoc tx_memory_pool::cookie
+      *
+      * @note see tx_memory_pool::cookie
+      */
+     uint64_t get_pool_cookie() const { return m_mempool.cookie(); }
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -616,6 +666,27 @@ namespace cryptonote
       */
      const Blockchain& get_blockchain_storage()const{return m_blockchain_storage;}
 
+     /**
+      * @brief gets the tx_memory_pool instance
+      *
+      * @return a reference to the tx_memory_pool instance
+      */
+     tx_memory_pool& get_pool(){return m_mempool;}
+
+     /**
+      * @brief gets the full node list (const)
+      *
+      * @return a const reference to the full node list
+      */
+     const full_nodes::full_node_list& get_full_node_list()const{return m_full_node_list;}
+
+     /**
+      * @brief gets the light wallet scanner
+      *
+      * @return a reference to the light wallet scanner, disabled unless --light-wallet-accounts is set
+      */
+     light_wallet_scanner& get_light_wallet_scanner(){return m_light_wallet_scanner;}
+
      /**
       * @copydoc tx_memory_pool::print_pool
       *
@@ -736,10 +807,11 @@ namespace cryptonote
       *
       * @param key_im list of key images to check
       * @param spent return-by-reference result for each image checked
+      * @param include_sensitive_data whether to count spends by txes which are not to be relayed
       *
       * @return true
       */
-     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const;
+     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_sensitive_data = true) const;
 
      /**
       * @brief get the number of blocks to sync in one go
@@ -807,6 +879,28 @@ namespace cryptonote
       */
      bool offline() const { return m_offline; }
 
+     /**
+      * @brief get whether the core is a read replica of another daemon
+      *
+      * A replica opens the primary's DB read only and follows it instead of
+      * syncing, so it can't take txs or blocks itself.
+      *
+      * @return whether the core is a replica
+      */
+     bool is_replica() const { return m_replica; }
+
+     /**
+      * @brief catch up with the chain and pool the primary wrote to the DB
+      *
+      * Only for a replica.
+      *
+      * @param chain whether the primary's chain may have changed
+      * @param pool whether the primary's pool may have changed
+      *
+      * @return true on success
+      */
+     bool sync_from_primary(bool chain, bool pool);
+
      /**
       * @brief Get the deterministic list of fullnode's public keys for quorum testing
       *
@@ -817,9 +911,16 @@ namespace cryptonote
      const std::shared_ptr<const full_nodes::quorum_state> get_quorum_state(uint64_t height) const;
 
      /**
-      * @brief Get a non owning reference to the list of blacklisted key images
+      * @brief Same as get_quorum_state, but read from the published snapshot
+      * of the fullnode list without waiting for block processing, so it may
+      * be behind. For RPC readers only, votes must use get_quorum_state.
+      */
+     const std::shared_ptr<const full_nodes::quorum_state> get_quorum_state_snapshot(uint64_t height) const;
+
+     /**
+      * @brief Get a copy of the blacklisted key images as of the last processed block
       */
-     const std::vector<full_nodes::key_image_blacklist_entry> &get_full_node_blacklisted_key_images() const;
+     std::vector<full_nodes::key_image_blacklist_entry> get_full_node_blacklisted_key_images() const;
 
      /**
       * @brief get a snapshot of the fullnode list state at the time of the call.
@@ -863,8 +964,18 @@ namespace cryptonote
       *
       * @param keys The container in which to return the keys
       * @param fully_funded_nodes_only Only return nodes that are funded and hence working on the network
+      * @param keys_hash If given, set to the hash of the returned list
+      *
+      * The keys are sorted by pubkey.
+      */
+     void get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only, crypto::hash *keys_hash = nullptr) const;
+
+     /**
+      * @brief Get the hash of the list get_all_full_nodes_public_keys would return, without copying it
+      *
+      * @param fully_funded_nodes_only Only hash nodes that are funded and hence working on the network
       */
-     void get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only) const;
+     crypto::hash get_all_full_nodes_public_keys_hash(bool fully_funded_nodes_only) const;
 
      /**
       * @brief attempts to submit an uptime proof to the network, if this is running in fullnode mode
@@ -898,6 +1009,15 @@ namespace cryptonote
       */
      bool prune_blockchain(uint32_t pruning_seed = 0);
 
+     /**
+      * @brief start pruning the blockchain in place, a little at a time from on_idle
+      *
+      * @param pruning_seed the seed to use to prune the chain (0 for default, highly recommended)
+      *
+      * @return true iff success
+      */
+     bool start_incremental_pruning(uint32_t pruning_seed = 0);
+
      /**
       * @brief incrementally prunes blockchain
       *
@@ -1003,6 +1123,28 @@ namespace cryptonote
      struct tx_verification_batch_info { const cryptonote::transaction *tx; crypto::hash tx_hash; tx_verification_context &tvc; bool &result; };
      bool handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block);
 
+     /**
+      * @brief verifies the rct semantics of every tx of a span of incoming blocks in
+      * batches of up to m_sync_bulletproof_batch bulletproofs
+      *
+      * Txs whose batch passes are remembered until cleanup_handle_incoming_blocks so
+      * handle_incoming_txs does not verify them again one block at a time.  A batch
+      * that fails is simply not remembered, and its txs are checked per block as usual.
+      *
+      * @param blocks the span of incoming blocks
+      */
+     void prevalidate_incoming_blocks_semantics(const std::vector<block_complete_entry> &blocks);
+
+     /**
+      * @brief hands over the next block parsed by prepare_handle_incoming_blocks
+      *
+      * @param block_blob the blob of the block being handled
+      * @param b return-by-reference the parsed block
+      *
+      * @return true if block_blob is the next prepared block, false if it still needs parsing
+      */
+     bool take_prepared_block(const blobdata& block_blob, block &b);
+
      /**
       * @copydoc miner::on_block_chain_update
       *
@@ -1075,6 +1217,13 @@ namespace cryptonote
       */
      bool relay_deregister_votes();
 
+     /**
+      * @brief verify the queued uptime proofs in a batch and relay the valid ones
+      *
+      * @return true, necessary for binding this function to a periodic invoker
+      */
+     bool relay_uptime_proofs();
+
      /**
       * @brief checks DNS versions
       *
@@ -1125,10 +1274,11 @@ namespace cryptonote
      full_nodes::deregister_vote_pool m_deregister_vote_pool;
      full_nodes::full_node_list    m_full_node_list;
      full_nodes::quorum_cop           m_quorum_cop;
+     light_wallet_scanner             m_light_wallet_scanner; //!< view key scanning for light wallets
 
      i_cryptonote_protocol* m_pprotocol; //!< cryptonote protocol instance
 
-     epee::critical_section m_incoming_tx_lock; //!< incoming transaction lock
+     epee::critical_section m_incoming_tx_lock; //!< serializes incoming tx admission against block handling
 
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner; //!< miner instance
@@ -1147,8 +1297,10 @@ namespace cryptonote
      epee::math_helper::once_a_time_seconds<60*10, true> m_check_disk_space_interval; //!< interval for checking for disk space
      epee::math_helper::once_a_time_seconds<UPTIME_PROOF_BUFFER_IN_SECONDS, true> m_check_uptime_proof_interval; //!< interval for checking our own uptime proof
      epee::math_helper::once_a_time_seconds<30, true> m_uptime_proof_pruner;
+     epee::math_helper::once_a_time_seconds<5, false> m_uptime_proof_relayer; //!< interval for verifying and relaying batches of uptime proofs
      epee::math_helper::once_a_time_seconds<90, false> m_block_rate_interval; //!< interval for checking block rate
      epee::math_helper::once_a_time_seconds<60*60*5, true> m_blockchain_pruning_interval; //!< interval for incremental blockchain pruning
+     epee::math_helper::once_a_time_seconds<1, false> m_pruning_step_interval; //!< interval for background pruning steps
 
      std::atomic<bool> m_starter_message_showed; //!< has the "daemon will sync now" message been shown?
 
@@ -1170,6 +1322,12 @@ namespace cryptonote
      crypto::public_key m_full_node_pubkey;
 
      size_t block_sync_size;
+     size_t m_sync_bulletproof_batch; //!< max number of bulletproofs verified in one batch while syncing
+
+     std::unordered_set<crypto::hash> m_span_verified_semantics; //!< txs of the current incoming span with verified rct semantics, guarded by m_incoming_tx_lock
+     std::vector<block> m_prepared_blocks; //!< blocks of the current incoming span parsed by prepare_handle_incoming_blocks, guarded by m_incoming_tx_lock
+     std::vector<blobdata> m_prepared_block_blobs; //!< the blobs m_prepared_blocks were parsed from
+     size_t m_prepared_block_index; //!< next entry of m_prepared_blocks handle_incoming_block expects
 
      time_t start_time;
 
@@ -1189,6 +1347,7 @@ namespace cryptonote
 
      bool m_fluffy_blocks_enabled;
      bool m_offline;
+     bool m_replica;
      bool m_pad_transactions;
 
      std::shared_ptr<tools::Notify> m_block_rate_notify;
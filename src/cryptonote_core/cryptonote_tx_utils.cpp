@@ -165,17 +165,25 @@ namespace cryptonote
   }
 
   uint64_t derive_control_from_block_reward(network_type nettype, const cryptonote::block &block)
+  {
+    return derive_control_from_block_reward(nettype, block, block.miner_tx);
+  }
+
+  uint64_t derive_control_from_block_reward(network_type nettype, const cryptonote::block_header &header, const cryptonote::transaction &miner_tx)
   {
     uint64_t result       = 0;
     uint64_t snode_reward = 0;
-    uint64_t vout_end     = block.miner_tx.vout.size();
+    uint64_t vout_end     = miner_tx.vout.size();
 
-    if (block_has_control_output(nettype, block))
+    uint64_t height = 0;
+    if (miner_tx.vin.size() == 1 && miner_tx.vin[0].type() == typeid(txin_gen))
+      height = boost::get<txin_gen>(miner_tx.vin[0]).height;
+    if (height_has_control_output(nettype, header.major_version, height))
       --vout_end; // skip the control output, the control may be the batched amount. we want the original base reward
 
     for (size_t vout_index = 1; vout_index < vout_end; ++vout_index)
     {
-      tx_out const &output = block.miner_tx.vout[vout_index];
+      tx_out const &output = miner_tx.vout[vout_index];
       snode_reward += output.amount;
     }
 
@@ -192,7 +200,7 @@ namespace cryptonote
     uint64_t block_reward = base_reward - control;
 
     uint64_t actual_reward = 0; // sanity check
-    for (tx_out const &output : block.miner_tx.vout) actual_reward += output.amount;
+    for (tx_out const &output : miner_tx.vout) actual_reward += output.amount;
 
     CHECK_AND_ASSERT_MES(block_reward <= actual_reward, false,
         "Rederiving the base block reward from the fullnode reward "
@@ -1054,4 +1062,14 @@ namespace cryptonote
     rx_reorg(split_height);
   }
 
+  void get_block_longhash_prepare_seed(const uint64_t seed_height, const crypto::hash& seed_hash)
+  {
+    rx_prepare_seed(seed_height, seed_hash.data);
+  }
+
+  void get_block_longhash_prepare_seed_join()
+  {
+    rx_prepare_seed_join();
+  }
+
 }
@@ -45,6 +45,7 @@ namespace cryptonote
   bool     block_has_control_output          (network_type nettype, cryptonote::block const &block);
   bool     height_has_control_output         (network_type nettype, int hard_fork_version, uint64_t height);
   uint64_t derive_control_from_block_reward  (network_type nettype, const cryptonote::block &block);
+  uint64_t derive_control_from_block_reward  (network_type nettype, const cryptonote::block_header &header, const cryptonote::transaction &miner_tx);
 
   uint64_t get_portion_of_reward                (uint64_t portions, uint64_t total_full_node_reward);
   uint64_t full_node_reward_formula          (uint64_t base_reward, int hard_fork_version);
@@ -216,6 +217,8 @@ namespace cryptonote
     const uint64_t seed_height, const crypto::hash& seed_hash);
   crypto::hash get_block_longhash(const Blockchain *pb, const block& b, const uint64_t height, const int miners);
   void get_block_longhash_reorg(const uint64_t split_height);
+  void get_block_longhash_prepare_seed(const uint64_t seed_height, const crypto::hash& seed_hash);
+  void get_block_longhash_prepare_seed_join();
 }
 
 BOOST_CLASS_VERSION(cryptonote::tx_source_entry, 1)
@@ -158,6 +158,8 @@ namespace full_nodes
     return verify_votes_helper(nettype, deregister, vvc, quorum_state);
   }
 
+  static_assert(full_nodes::QUORUM_SIZE <= 64, "Deregister voter bitmap does not fit the quorum size");
+
   void deregister_vote_pool::set_relayed(const std::vector<deregister_vote>& votes)
   {
     CRITICAL_REGION_LOCAL(m_lock);
@@ -170,16 +172,19 @@ namespace full_nodes
       desired_group.full_node_index = find_vote.full_node_index;
 
       auto deregister_entry = m_deregisters.find(desired_group);
-      if (deregister_entry != m_deregisters.end())
+      if (deregister_entry == m_deregisters.end())
+        continue;
+
+      deregister_group_votes &group_votes = deregister_entry->second;
+      if ((group_votes.voters & (uint64_t(1) << find_vote.voters_quorum_index)) == 0)
+        continue;
+
+      for (auto &deregister : group_votes.votes)
       {
-        std::vector<deregister_pool_entry> &deregister_vector = deregister_entry->second;
-        for (auto &deregister : deregister_vector)
+        if (deregister.m_vote.voters_quorum_index == find_vote.voters_quorum_index)
         {
-          if (deregister.m_vote.voters_quorum_index == find_vote.voters_quorum_index)
-          {
-            deregister.m_time_last_sent_p2p = now;
-            break;
-          }
+          deregister.m_time_last_sent_p2p = now;
+          break;
         }
       }
     }
@@ -188,7 +193,6 @@ namespace full_nodes
   std::vector<deregister_vote> deregister_vote_pool::get_relayable_votes() const
   {
     CRITICAL_REGION_LOCAL(m_lock);
-    const cryptonote::cryptonote_connection_context fake_context = AUTO_VAL_INIT(fake_context);
 
     // TODO(doyle): Rate-limiting: A better threshold value that follows suite with transaction relay time back-off
     const time_t now       = time(NULL);
@@ -197,8 +201,7 @@ namespace full_nodes
     std::vector<deregister_vote> result;
     for (const auto &deregister_entry : m_deregisters)
     {
-      const std::vector<deregister_pool_entry>& deregister_vector = deregister_entry.second;
-      for (const deregister_pool_entry &entry : deregister_vector)
+      for (const deregister_pool_entry &entry : deregister_entry.second.votes)
       {
         const time_t last_sent = now - entry.m_time_last_sent_p2p;
         if (last_sent > THRESHOLD)
@@ -216,6 +219,26 @@ namespace full_nodes
                                       const full_nodes::quorum_state &quorum_state,
                                       cryptonote::transaction &tx)
   {
+    deregister_group desired_group   = {};
+    desired_group.block_height       = new_vote.block_height;
+    desired_group.full_node_index = new_vote.full_node_index;
+    uint64_t const voter_bit         = (new_vote.voters_quorum_index < 64) ? (uint64_t(1) << new_vote.voters_quorum_index) : 0;
+
+    // An exact copy of a vote already in the pool was verified when it was
+    // added, skip the signature check so vote storms stay cheap.
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      auto it = m_deregisters.find(desired_group);
+      if (voter_bit && it != m_deregisters.end() && (it->second.voters & voter_bit))
+      {
+        for (const auto &entry : it->second.votes)
+        {
+          if (entry.m_vote.voters_quorum_index == new_vote.voters_quorum_index && entry.m_vote.signature == new_vote.signature)
+            return true;
+        }
+      }
+    }
+
     if (!deregister_vote::verify_vote(m_nettype, new_vote, vvc, quorum_state))
     {
       LOG_PRINT_L1("Signature verification failed for deregister vote");
@@ -223,38 +246,28 @@ namespace full_nodes
     }
 
     CRITICAL_REGION_LOCAL(m_lock);
-    time_t const now = time(NULL);
-    std::vector<deregister_pool_entry> *deregister_votes;
+    auto it = m_deregisters.find(desired_group);
+    if (it == m_deregisters.end())
     {
-      deregister_group desired_group   = {};
-      desired_group.block_height       = new_vote.block_height;
-      desired_group.full_node_index = new_vote.full_node_index;
-      deregister_votes                 = &m_deregisters[desired_group];
+      it = m_deregisters.emplace(desired_group, deregister_group_votes()).first;
+      m_groups_by_height[desired_group.block_height].push_back(desired_group.full_node_index);
     }
 
-    bool new_deregister_is_unique = true;
-    for (const auto &entry : *deregister_votes)
-    {
-      if (entry.m_vote.voters_quorum_index == new_vote.voters_quorum_index)
-      {
-        new_deregister_is_unique = false;
-        break;
-      }
-    }
-
-    if (new_deregister_is_unique)
+    deregister_group_votes &group_votes = it->second;
+    if ((group_votes.voters & voter_bit) == 0)
     {
       vvc.m_added_to_pool = true;
-      deregister_votes->emplace_back(deregister_pool_entry(0 /*time_last_sent_p2p*/, new_vote));
+      group_votes.voters |= voter_bit;
+      group_votes.votes.emplace_back(deregister_pool_entry(0 /*time_last_sent_p2p*/, new_vote));
 
-      if (deregister_votes->size() >= full_nodes::MIN_VOTES_TO_KICK_FULL_NODE)
+      if (group_votes.votes.size() >= full_nodes::MIN_VOTES_TO_KICK_FULL_NODE)
       {
         cryptonote::tx_extra_full_node_deregister deregister;
         deregister.block_height       = new_vote.block_height;
         deregister.full_node_index = new_vote.full_node_index;
-        deregister.votes.reserve(deregister_votes->size());
+        deregister.votes.reserve(group_votes.votes.size());
 
-        for (const auto& entry : *deregister_votes)
+        for (const auto& entry : group_votes.votes)
         {
           cryptonote::tx_extra_full_node_deregister::vote tx_vote = {};
           tx_vote.signature           = entry.m_vote.signature;
@@ -281,6 +294,9 @@ namespace full_nodes
   void deregister_vote_pool::remove_used_votes(std::vector<cryptonote::transaction> const &txs)
   {
     CRITICAL_REGION_LOCAL(m_lock);
+    if (m_deregisters.empty())
+      return;
+
     for (const cryptonote::transaction &tx : txs)
     {
       if (tx.get_type() != cryptonote::transaction::type_deregister)
@@ -309,17 +325,16 @@ namespace full_nodes
 
     CRITICAL_REGION_LOCAL(m_lock);
     uint64_t minimum_height = height - deregister_vote::VOTE_LIFETIME_BY_HEIGHT;
-    for (auto it = m_deregisters.begin(); it != m_deregisters.end();)
+    while (!m_groups_by_height.empty() && m_groups_by_height.begin()->first < minimum_height)
     {
-      const deregister_group &deregister_for = it->first;
-      if (deregister_for.block_height < minimum_height)
-      {
-        it = m_deregisters.erase(it);
-      }
-      else
+      deregister_group group = {};
+      group.block_height     = m_groups_by_height.begin()->first;
+      for (uint32_t full_node_index : m_groups_by_height.begin()->second)
       {
-        it++;
+        group.full_node_index = full_node_index;
+        m_deregisters.erase(group);
       }
+      m_groups_by_height.erase(m_groups_by_height.begin());
     }
   }
 }; // namespace full_nodes
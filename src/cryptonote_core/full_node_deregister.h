@@ -28,6 +28,7 @@
 
 #pragma once
 
+#include <map>
 #include <vector>
 #include <unordered_map>
 #include <utility>
@@ -98,11 +99,18 @@ namespace full_nodes
         deregister_vote m_vote;
       };
 
+      // Votes received for one deregister_group, voters is a bitmap indexed
+      // by the voter's quorum index so duplicates are caught without a scan.
+      struct deregister_group_votes
+      {
+        uint64_t                           voters = 0;
+        std::vector<deregister_pool_entry> votes;
+      };
+
       struct deregister_group
       {
         uint64_t block_height;
         uint32_t full_node_index;
-        time_t   time_group_created;
 
         bool operator==(const deregister_group &other) const
         {
@@ -118,12 +126,12 @@ namespace full_nodes
           size_t res = 17;
           res = res * 31 + std::hash<uint64_t>()(deregister.block_height);
           res = res * 31 + std::hash<uint32_t>()(deregister.full_node_index);
-          res = res * 31 + std::hash<uint32_t>()(deregister.time_group_created);
           return res;
         }
       };
 
-      std::unordered_map<deregister_group, std::vector<deregister_pool_entry>, deregister_group_hasher> m_deregisters;
+      std::unordered_map<deregister_group, deregister_group_votes, deregister_group_hasher> m_deregisters;
+      std::map<uint64_t, std::vector<uint32_t>> m_groups_by_height; // block_height -> full_node_index of groups, may hold groups already removed
       mutable epee::critical_section m_lock;
   };
 }; // namespace full_nodes
@@ -38,6 +38,7 @@
 #include "constants.h"
 #include "common/scoped_message_writer.h"
 #include "common/i18n.h"
+#include "common/threadpool.h"
 #include "full_node_quorum_cop.h"
 
 #include "full_node_list.h"
@@ -48,6 +49,19 @@
 
 namespace full_nodes
 {
+  static constexpr size_t ROLLBACK_EVENT_EXPIRATION_BLOCKS = 30;
+
+  // Number of journal deltas appended before store() compacts the list back
+  // into a single checkpoint, bounding the amount of replay work in load().
+  static constexpr size_t FULL_NODE_JOURNAL_COMPACTION_INTERVAL = 100;
+
+  static constexpr size_t QUORUM_ARCHIVE_CACHE_SIZE = 256;
+
+  // While rebuilding the list from the blockchain the state is stored every
+  // this many blocks, so an interrupted rescan resumes from the last stored
+  // checkpoint instead of starting again from the hard fork height.
+  static constexpr uint64_t FULL_NODE_RESCAN_CHECKPOINT_INTERVAL = 10000;
+
   static int get_min_full_node_info_version_for_hf(int hf_version)
   {
     if (hf_version >= cryptonote::network_version_7 && hf_version <= cryptonote::network_version_9_full_nodes)
@@ -67,10 +81,25 @@ namespace full_nodes
     return  x / (secureMax / n);
   }
 
+  // All rollback event alternatives derive from rollback_event, so the common
+  // header (type and height) can be read without knowing the alternative.
+  struct rollback_event_base_visitor : public boost::static_visitor<const full_node_list::rollback_event &>
+  {
+    template <typename T>
+    const full_node_list::rollback_event &operator()(const T &event) const { return event; }
+  };
+
+  static const full_node_list::rollback_event &get_rollback_event(const full_node_list::rollback_event_variant &event)
+  {
+    return boost::apply_visitor(rollback_event_base_visitor(), event);
+  }
+
   full_node_list::full_node_list(cryptonote::Blockchain& blockchain)
-    : m_blockchain(blockchain), m_hooks_registered(false), m_db(nullptr), m_full_node_pubkey(nullptr)
+    : m_blockchain(blockchain), m_hooks_registered(false), m_db(nullptr), m_full_node_pubkey(nullptr), m_funded_keys_version(0), m_snapshot_stale(false)
   {
     m_transient_state = {};
+    m_journal = {};
+    m_snapshot = std::make_shared<state_snapshot>();
   }
 
   void full_node_list::register_hooks(full_nodes::quorum_cop &quorum_cop)
@@ -94,6 +123,7 @@ namespace full_nodes
   void full_node_list::init()
   {
     std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+    auto publish = epee::misc_utils::create_scope_leave_handler([this]() { publish_snapshot(); });
     if (m_blockchain.get_current_hard_fork_version() < 9)
     {
       clear(true);
@@ -104,17 +134,33 @@ namespace full_nodes
     bool loaded = load();
     if (loaded && m_transient_state.height == current_height) return;
 
+    if (loaded && m_transient_state.height > current_height && can_rollback_to(current_height))
+    {
+      // The chain was popped while we weren't running, the stored rollback
+      // events cover the difference so undo them instead of rescanning.
+      MGINFO("Fullnode data is ahead of the blockchain, rolling back from height " << m_transient_state.height << " to " << current_height);
+      blockchain_detached(current_height);
+      return;
+    }
+
     if (!loaded || m_transient_state.height > current_height) clear(true);
 
     LOG_PRINT_L0("Recalculating fullnodes list, scanning blockchain from height " << m_transient_state.height);
     LOG_PRINT_L0("This may take some time...");
 
+    uint64_t next_checkpoint_height = m_transient_state.height + FULL_NODE_RESCAN_CHECKPOINT_INTERVAL;
     std::vector<std::pair<cryptonote::blobdata, cryptonote::block>> blocks;
     for (uint64_t i = 0; m_transient_state.height < current_height; i++)
     {
       if (i > 0 && i % 10 == 0)
           LOG_PRINT_L0("... scanning height " << m_transient_state.height);
 
+      if (m_transient_state.height >= next_checkpoint_height)
+      {
+        store();
+        next_checkpoint_height = m_transient_state.height + FULL_NODE_RESCAN_CHECKPOINT_INTERVAL;
+      }
+
       blocks.clear();
       if (!m_blockchain.get_blocks(m_transient_state.height, 1000, blocks))
       {
@@ -132,7 +178,7 @@ namespace full_nodes
         const cryptonote::block& block = block_pair.second;
         std::vector<cryptonote::transaction> txs;
         std::vector<crypto::hash> missed_txs;
-        if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs))
+        if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs, true /*pruned*/))
         {
           MERROR("Unable to get transactions for block " << block.hash);
           return;
@@ -140,24 +186,12 @@ namespace full_nodes
 
         block_added_generic(block, txs);
       }
+
+      flush_quorum_archive();
     }
     LOG_PRINT_L0("Done recalculating fullnodes list");
   }
 
-  std::vector<crypto::public_key> full_node_list::get_full_nodes_pubkeys() const
-  {
-    std::vector<crypto::public_key> result;
-    for (const auto& iter : m_transient_state.full_nodes_infos)
-      if (iter.second.is_fully_funded())
-        result.push_back(iter.first);
-
-    std::sort(result.begin(), result.end(),
-      [](const crypto::public_key &a, const crypto::public_key &b) {
-        return memcmp(reinterpret_cast<const void*>(&a), reinterpret_cast<const void*>(&b), sizeof(a)) < 0;
-      });
-    return result;
-  }
-
   const std::shared_ptr<const quorum_state> full_node_list::get_quorum_state(uint64_t height) const
   {
     std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
@@ -170,16 +204,120 @@ namespace full_nodes
     return nullptr;
   }
 
+  std::shared_ptr<const quorum_state> full_node_list::state_snapshot::get_quorum_state(uint64_t height) const
+  {
+    const auto it = quorum_states.find(height);
+    if (it != quorum_states.end())
+      return it->second;
+    return nullptr;
+  }
+
+  std::shared_ptr<const quorum_state> full_node_list::get_archived_quorum_state(uint64_t height) const
+  {
+    std::lock_guard<boost::mutex> lock(m_quorum_archive_mutex);
+    const auto it = m_quorum_archive_cache.find(height);
+    if (it != m_quorum_archive_cache.end())
+    {
+      m_quorum_archive_lru.splice(m_quorum_archive_lru.begin(), m_quorum_archive_lru, it->second.second);
+      return it->second.first;
+    }
+
+    std::string blob;
+    if (!m_db || !m_db->get_full_node_quorum_state(height, blob))
+      return nullptr;
+
+    binary_archive<false> ba(epee::strspan<uint8_t>(blob));
+
+    quorum_state_for_serialization archived;
+    if (!::serialization::serialize(ba, archived) || archived.height != height)
+    {
+      MERROR("Failed to parse archived quorum state for height: " << height);
+      return nullptr;
+    }
+
+    auto result = std::make_shared<const quorum_state>(std::move(archived.state));
+    m_quorum_archive_lru.push_front(height);
+    m_quorum_archive_cache[height] = std::make_pair(result, m_quorum_archive_lru.begin());
+    if (m_quorum_archive_lru.size() > QUORUM_ARCHIVE_CACHE_SIZE)
+    {
+      m_quorum_archive_cache.erase(m_quorum_archive_lru.back());
+      m_quorum_archive_lru.pop_back();
+    }
+
+    return result;
+  }
+
+  void full_node_list::flush_quorum_archive()
+  {
+    if (m_quorum_archive_pending.empty() || !m_db)
+      return;
+    if (m_db->is_read_only())
+    {
+      // a replica's DB, the writing process archives the same states
+      m_quorum_archive_pending.clear();
+      return;
+    }
+
+    m_db->block_txn_start(false/*readonly*/);
+    for (const quorum_state_for_serialization& archived : m_quorum_archive_pending)
+    {
+      std::stringstream ss;
+      binary_archive<true> ba(ss);
+      quorum_state_for_serialization copy = archived;
+      if (!::serialization::serialize(ba, copy))
+      {
+        MERROR("Failed to serialize quorum state for height: " << archived.height << " for the archive");
+        continue;
+      }
+      m_db->set_full_node_quorum_state(archived.height, ss.str());
+    }
+    m_db->block_txn_stop();
+    m_quorum_archive_pending.clear();
+  }
+
+  std::shared_ptr<const full_node_list::state_snapshot> full_node_list::get_snapshot() const
+  {
+    if (m_snapshot_stale.load(std::memory_order_acquire))
+    {
+      std::unique_lock<boost::recursive_mutex> lock(m_sn_mutex, std::try_to_lock);
+      if (lock.owns_lock() && m_snapshot_stale.load(std::memory_order_relaxed))
+        publish_snapshot();
+    }
+    return std::atomic_load(&m_snapshot);
+  }
+
+  void full_node_list::publish_snapshot() const
+  {
+    auto snapshot                 = std::make_shared<state_snapshot>();
+    snapshot->full_nodes_infos    = m_transient_state.full_nodes_infos;
+    snapshot->key_image_blacklist = m_transient_state.key_image_blacklist;
+    snapshot->quorum_states       = m_transient_state.quorum_states;
+    snapshot->height              = m_transient_state.height;
+
+    snapshot->sorted_funded_keys  = m_funded_keys;
+
+    snapshot->sorted_keys.reserve(snapshot->full_nodes_infos.size());
+    for (const auto &it : snapshot->full_nodes_infos)
+      snapshot->sorted_keys.push_back(it.first);
+    auto const pubkey_less = [](crypto::public_key const &a, crypto::public_key const &b) { return memcmp(a.data, b.data, sizeof(a.data)) < 0; };
+    std::sort(snapshot->sorted_keys.begin(), snapshot->sorted_keys.end(), pubkey_less);
+    snapshot->keys_hash        = crypto::cn_fast_hash(snapshot->sorted_keys.data(), snapshot->sorted_keys.size() * sizeof(crypto::public_key));
+    snapshot->funded_keys_hash = crypto::cn_fast_hash(snapshot->sorted_funded_keys.data(), snapshot->sorted_funded_keys.size() * sizeof(crypto::public_key));
+
+    std::atomic_store(&m_snapshot, std::shared_ptr<const state_snapshot>(std::move(snapshot)));
+    m_snapshot_stale.store(false, std::memory_order_release);
+  }
+
   std::vector<full_node_pubkey_info> full_node_list::get_full_node_list_state(const std::vector<crypto::public_key> &full_node_pubkeys) const
   {
-    std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+    const std::shared_ptr<const state_snapshot> snapshot = get_snapshot();
     std::vector<full_node_pubkey_info> result;
 
     if (full_node_pubkeys.empty())
     {
-      result.reserve(m_transient_state.full_nodes_infos.size());
+      result.reserve(snapshot->full_nodes_infos.size());
 
-      for (const auto &it : m_transient_state.full_nodes_infos)
+      for (const auto &it : snapshot->full_nodes_infos)
       {
         full_node_pubkey_info entry = {};
         entry.pubkey                   = it.first;
@@ -192,8 +330,8 @@ namespace full_nodes
       result.reserve(full_node_pubkeys.size());
       for (const auto &it : full_node_pubkeys)
       {
-        const auto &find_it = m_transient_state.full_nodes_infos.find(it);
-        if (find_it == m_transient_state.full_nodes_infos.end())
+        const auto &find_it = snapshot->full_nodes_infos.find(it);
+        if (find_it == snapshot->full_nodes_infos.end())
           continue;
 
         full_node_pubkey_info entry = {};
@@ -224,11 +362,23 @@ namespace full_nodes
     return m_transient_state.full_nodes_infos.find(pubkey) != m_transient_state.full_nodes_infos.end();
   }
 
+  bool full_node_list::is_key_image_blacklisted(crypto::key_image const &check_image) const
+  {
+    std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+    return m_blacklisted_key_images.find(check_image) != m_blacklisted_key_images.end();
+  }
+
   bool full_node_list::is_key_image_locked(crypto::key_image const &check_image, uint64_t *unlock_height, full_node_info::contribution_t *the_locked_contribution) const
   {
-    for (const auto& pubkey_info : m_transient_state.full_nodes_infos)
+    std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+    const auto locked_it = m_locked_key_images.find(check_image);
+    if (locked_it == m_locked_key_images.end())
+      return false;
+
+    const auto info_it = m_transient_state.full_nodes_infos.find(locked_it->second);
+    if (info_it != m_transient_state.full_nodes_infos.end())
     {
-      const full_node_info &info = pubkey_info.second;
+      const full_node_info &info = info_it->second;
       for (const full_node_info::contributor_t &contributor : info.contributors)
       {
         for (const full_node_info::contribution_t &contribution : contributor.locked_contributions)
@@ -246,11 +396,18 @@ namespace full_nodes
   }
 
   bool reg_tx_extract_fields(const cryptonote::transaction& tx, std::vector<cryptonote::account_public_address>& addresses, uint64_t& portions_for_operator, std::vector<uint64_t>& portions, uint64_t& expiration_timestamp, crypto::public_key& full_node_key, crypto::signature& signature)
+  {
+    std::vector<cryptonote::tx_extra_field> extra_fields;
+    cryptonote::parse_tx_extra(tx.extra, extra_fields);
+    return reg_tx_extract_fields(extra_fields, addresses, portions_for_operator, portions, expiration_timestamp, full_node_key, signature);
+  }
+
+  bool reg_tx_extract_fields(const std::vector<cryptonote::tx_extra_field>& extra_fields, std::vector<cryptonote::account_public_address>& addresses, uint64_t& portions_for_operator, std::vector<uint64_t>& portions, uint64_t& expiration_timestamp, crypto::public_key& full_node_key, crypto::signature& signature)
   {
     cryptonote::tx_extra_full_node_register registration;
-    if (!get_full_node_register_from_tx_extra(tx.extra, registration))
+    if (!cryptonote::get_full_node_register_from_tx_extra(extra_fields, registration))
       return false;
-    if (!cryptonote::get_full_node_pubkey_from_tx_extra(tx.extra, full_node_key))
+    if (!cryptonote::get_full_node_pubkey_from_tx_extra(extra_fields, full_node_key))
       return false;
 
     addresses.clear();
@@ -312,13 +469,13 @@ namespace full_nodes
     return money_transferred;
   }
 
-  bool full_node_list::process_deregistration_tx(const cryptonote::transaction& tx, uint64_t block_height)
+  bool full_node_list::process_deregistration_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_height)
   {
     if (tx.get_type() != cryptonote::transaction::type_deregister)
       return false;
 
     cryptonote::tx_extra_full_node_deregister deregister;
-    if (!cryptonote::get_full_node_deregister_from_tx_extra(tx.extra, deregister))
+    if (!cryptonote::get_full_node_deregister_from_tx_extra(extra_fields, deregister))
     {
       MERROR("Transaction deregister did not have deregister data in tx extra, possibly corrupt tx in blockchain");
       return false;
@@ -354,7 +511,7 @@ namespace full_nodes
       LOG_PRINT_L1("Deregistration for fullnode: " << key);
     }
 
-    m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_change(block_height, key, iter->second)));
+    m_transient_state.rollback_events.push_back(rollback_change(block_height, key, iter->second));
 
     int hard_fork_version = m_blockchain.get_hard_fork_version(block_height);
     if (hard_fork_version >= cryptonote::network_version_11_infinite_staking)
@@ -367,9 +524,10 @@ namespace full_nodes
           entry.key_image                 = contribution.key_image;
           entry.unlock_height             = block_height + staking_num_lock_blocks(m_blockchain.nettype());
           m_transient_state.key_image_blacklist.push_back(entry);
+          m_blacklisted_key_images[entry.key_image]++;
 
           const bool adding_to_blacklist = true;
-          m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_key_image_blacklist(block_height, entry, adding_to_blacklist)));
+          m_transient_state.rollback_events.push_back(rollback_key_image_blacklist(block_height, entry, adding_to_blacklist));
         }
       }
     }
@@ -410,9 +568,10 @@ namespace full_nodes
   }
 
 
-  static void calc_swarm_changes(std::map<swarm_id_t, std::vector<crypto::public_key>>& swarm_to_snodes, uint64_t seed)
+  std::set<swarm_id_t> calc_swarm_changes(std::map<swarm_id_t, std::vector<crypto::public_key>>& swarm_to_snodes, uint64_t seed)
   {
     std::mt19937_64 mersenne_twister(seed);
+    std::set<swarm_id_t> modified_swarms;
 
     std::vector<crypto::public_key> swarm_buffer = swarm_to_snodes[QUEUE_SWARM_ID];
     swarm_to_snodes.erase(QUEUE_SWARM_ID);
@@ -442,6 +601,7 @@ namespace full_nodes
         for (auto j = 0u; j < needed && !swarm_buffer.empty(); ++j) {
           const auto sn_pk = pop_random_snode(mersenne_twister, swarm_buffer);
           swarm_to_snodes.at(swarm_id).push_back(sn_pk);
+          modified_swarms.insert(swarm_id);
         }
 
         if (swarm_buffer.empty()) break;
@@ -469,6 +629,7 @@ namespace full_nodes
 
             const crypto::public_key sn_pk = pop_random_snode(mersenne_twister, swarm_to_snodes.at(large_swarm));
             swarm_to_snodes.at(swarm_id).push_back(sn_pk);
+            modified_swarms.insert(swarm_id);
         }
 
         if (!can_continue) break;
@@ -488,6 +649,7 @@ namespace full_nodes
 
         const auto sn_pk = pop_random_snode(mersenne_twister, swarm_buffer);
         swarm.push_back(sn_pk);
+        modified_swarms.insert(smallest_swarm);
       }
     }
 
@@ -521,6 +683,7 @@ namespace full_nodes
           /// c. Swap that node with a node in the queue, the old node will form a new swarm
           selected_snodes.push_back(snode);
           selected_swarm.push_back(fresh_snode);
+          modified_swarms.insert(it->first);
         } else {
           /// If there are no existing swarms, create the first swarm directly from the queue
           selected_snodes.push_back(fresh_snode);
@@ -528,10 +691,11 @@ namespace full_nodes
       }
 
       swarm_to_snodes.insert({new_swarm_id, std::move(selected_snodes)});
+      modified_swarms.insert(new_swarm_id);
     }
 
     /// 5. If there is a swarm with less than MIN_SWARM_SIZE, decommission that swarm (should almost never happen due to the safety buffer).
-    for (auto entry : swarm_to_snodes) {
+    for (const auto& entry : swarm_to_snodes) {
       if (entry.second.size() < MIN_SWARM_SIZE) {
         LOG_PRINT_L1("swarm " << entry.first << " is DECOMMISSIONED");
         /// TODO: move data to other swarms, then put snodes back in the queue
@@ -539,7 +703,9 @@ namespace full_nodes
     }
 
     /// 6. Put nodes from the buffer back to the "buffer agnostic" data structure
+    /// (only nodes that were already queued can be left in it, so it is never modified)
     swarm_to_snodes.insert({QUEUE_SWARM_ID, std::move(swarm_buffer)});
+    return modified_swarms;
   }
 
   void full_node_list::update_swarms(uint64_t height) {
@@ -556,33 +722,32 @@ namespace full_nodes
       existing_swarms[id].push_back(entry.first);
     }
 
-    calc_swarm_changes(existing_swarms, seed);
+    const std::set<swarm_id_t> modified_swarms = calc_swarm_changes(existing_swarms, seed);
 
-    /// Apply changes
-    for (const auto entry : existing_swarms) {
+    /// Apply changes, a node can only have moved into a swarm that received nodes
+    for (const swarm_id_t swarm_id : modified_swarms) {
 
-      const swarm_id_t swarm_id = entry.first;
-      const std::vector<crypto::public_key>& snodes = entry.second;
+      const std::vector<crypto::public_key>& snodes = existing_swarms.at(swarm_id);
 
-      for (const auto snode : snodes) {
+      for (const crypto::public_key& snode : snodes) {
 
         auto& sn_info = m_transient_state.full_nodes_infos.at(snode);
         if (sn_info.swarm_id == swarm_id) continue; /// nothing changed for this snode
 
         /// modify info and record the change
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_change(height, snode, sn_info)));
+        m_transient_state.rollback_events.push_back(rollback_change(height, snode, sn_info));
         sn_info.swarm_id = swarm_id;
       }
 
     }
   }
 
-  static bool get_contribution(cryptonote::network_type nettype, int hard_fork_version, const cryptonote::transaction& tx, uint64_t block_height, parsed_tx_contribution &parsed_contribution)
+  static bool get_contribution(cryptonote::network_type nettype, int hard_fork_version, const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_height, parsed_tx_contribution &parsed_contribution)
   {
-    if (!cryptonote::get_full_node_contributor_from_tx_extra(tx.extra, parsed_contribution.address))
+    if (!cryptonote::get_full_node_contributor_from_tx_extra(extra_fields, parsed_contribution.address))
       return false;
 
-    if (!cryptonote::get_tx_secret_key_from_tx_extra(tx.extra, parsed_contribution.tx_key))
+    if (!cryptonote::get_tx_secret_key_from_tx_extra(extra_fields, parsed_contribution.tx_key))
     {
       LOG_PRINT_L1("Contribution TX: There was a fullnode contributor but no secret key in the tx extra on height: " << block_height << " for tx: " << get_transaction_hash(tx));
       return false;
@@ -601,7 +766,7 @@ namespace full_nodes
     if (hard_fork_version >= cryptonote::network_version_11_infinite_staking)
     {
       cryptonote::tx_extra_tx_key_image_proofs key_image_proofs;
-      if (!get_tx_key_image_proofs_from_tx_extra(tx.extra, key_image_proofs))
+      if (!get_tx_key_image_proofs_from_tx_extra(extra_fields, key_image_proofs))
       {
         LOG_PRINT_L1("Contribution TX: Didn't have key image proofs in the tx_extra, rejected on height: " << block_height << " for tx: " << get_transaction_hash(tx));
         return false;
@@ -670,6 +835,13 @@ namespace full_nodes
   }
 
   bool full_node_list::is_registration_tx(const cryptonote::transaction& tx, uint64_t block_timestamp, uint64_t block_height, uint32_t index, crypto::public_key& key, full_node_info& info) const
+  {
+    std::vector<cryptonote::tx_extra_field> extra_fields;
+    cryptonote::parse_tx_extra(tx.extra, extra_fields);
+    return is_registration_tx(tx, extra_fields, block_timestamp, block_height, index, key, info);
+  }
+
+  bool full_node_list::is_registration_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_timestamp, uint64_t block_height, uint32_t index, crypto::public_key& key, full_node_info& info) const
   {
     crypto::public_key full_node_key;
     std::vector<cryptonote::account_public_address> full_node_addresses;
@@ -678,7 +850,7 @@ namespace full_nodes
     uint64_t expiration_timestamp;
     crypto::signature signature;
 
-    if (!reg_tx_extract_fields(tx, full_node_addresses, portions_for_operator, full_node_portions, expiration_timestamp, full_node_key, signature))
+    if (!reg_tx_extract_fields(extra_fields, full_node_addresses, portions_for_operator, full_node_portions, expiration_timestamp, full_node_key, signature))
       return false;
 
     if (full_node_portions.size() != full_node_addresses.size() || full_node_portions.empty())
@@ -734,7 +906,7 @@ namespace full_nodes
     cryptonote::account_public_address address;
 
     parsed_tx_contribution parsed_contribution = {};
-    if (!get_contribution(m_blockchain.nettype(), hf_version, tx, block_height, parsed_contribution))
+    if (!get_contribution(m_blockchain.nettype(), hf_version, tx, extra_fields, block_height, parsed_contribution))
     {
       LOG_PRINT_L1("Register TX: Had fullnode registration fields, but could not decode contribution on height: " << block_height << " for tx: " << cryptonote::get_transaction_hash(tx));
       return false;
@@ -803,11 +975,11 @@ namespace full_nodes
     return true;
   }
 
-  bool full_node_list::process_registration_tx(const cryptonote::transaction& tx, uint64_t block_timestamp, uint64_t block_height, uint32_t index)
+  bool full_node_list::process_registration_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_timestamp, uint64_t block_height, uint32_t index)
   {
     crypto::public_key key;
     full_node_info info = {};
-    if (!is_registration_tx(tx, block_timestamp, block_height, index, key, info))
+    if (!is_registration_tx(tx, extra_fields, block_timestamp, block_height, index, key, info))
       return false;
 
     int hard_fork_version = m_blockchain.get_hard_fork_version(block_height);
@@ -864,21 +1036,21 @@ namespace full_nodes
       }
     }
 
-    m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_new(block_height, key)));
+    m_transient_state.rollback_events.push_back(rollback_new(block_height, key));
     m_transient_state.full_nodes_infos[key] = info;
     return true;
   }
 
-  void full_node_list::process_contribution_tx(const cryptonote::transaction& tx, uint64_t block_height, uint32_t index)
+  void full_node_list::process_contribution_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_height, uint32_t index)
   {
     crypto::public_key pubkey;
 
-    if (!cryptonote::get_full_node_pubkey_from_tx_extra(tx.extra, pubkey))
+    if (!cryptonote::get_full_node_pubkey_from_tx_extra(extra_fields, pubkey))
       return; // Is not a contribution TX don't need to check it.
 
     parsed_tx_contribution parsed_contribution = {};
     const int hf_version = m_blockchain.get_hard_fork_version(block_height);
-    if (!get_contribution(m_blockchain.nettype(), hf_version, tx, block_height, parsed_contribution))
+    if (!get_contribution(m_blockchain.nettype(), hf_version, tx, extra_fields, block_height, parsed_contribution))
     {
       LOG_PRINT_L1("Contribution TX: Could not decode contribution for fullnode: " << pubkey << " on height: " << block_height << " for tx: " << cryptonote::get_transaction_hash(tx));
       return;
@@ -904,7 +1076,7 @@ namespace full_nodes
       return;
     }
 
-    if (!cryptonote::get_tx_secret_key_from_tx_extra(tx.extra, parsed_contribution.tx_key))
+    if (!cryptonote::get_tx_secret_key_from_tx_extra(extra_fields, parsed_contribution.tx_key))
     {
       LOG_PRINT_L1("Contribution TX: Failed to get tx secret key from contribution received on height: "  << block_height << " for tx: " << cryptonote::get_transaction_hash(tx));
       return;
@@ -945,7 +1117,7 @@ namespace full_nodes
     // Successfully Validated
     //
 
-    m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_change(block_height, pubkey, info)));
+    m_transient_state.rollback_events.push_back(rollback_change(block_height, pubkey, info));
     if (new_contributor)
     {
       full_node_info::contributor_t new_contributor = {};
@@ -1003,6 +1175,7 @@ namespace full_nodes
     std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
     block_added_generic(block, txs);
     store();
+    m_snapshot_stale.store(true, std::memory_order_release);
   }
 
 
@@ -1015,20 +1188,34 @@ namespace full_nodes
     if (hard_fork_version < 9)
       return;
 
+    //
+    // Start on this block's quorum from the funded list as it stands before the
+    // block is applied. Most blocks don't change that list, in which case the
+    // result is kept, otherwise it is discarded and rebuilt below.
+    //
+    const crypto::hash block_hash                 = cryptonote::get_block_hash(block);
+    const uint64_t speculative_version            = m_funded_keys_version;
+    const std::vector<crypto::public_key> speculative_keys = m_funded_keys;
+    std::shared_ptr<const quorum_state> speculative_quorum;
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter quorum_waiter;
+    tpool.submit(&quorum_waiter, [&speculative_quorum, &speculative_keys, &block_hash]() {
+      speculative_quorum = generate_quorum_state(speculative_keys, block_hash);
+    }, true);
+
     //
     // Remove old rollback events
     //
     {
       assert(m_transient_state.height == block_height);
       ++m_transient_state.height;
-      const size_t ROLLBACK_EVENT_EXPIRATION_BLOCKS = 30;
       uint64_t cull_height = (block_height < ROLLBACK_EVENT_EXPIRATION_BLOCKS) ? block_height : block_height - ROLLBACK_EVENT_EXPIRATION_BLOCKS;
 
-      while (!m_transient_state.rollback_events.empty() && m_transient_state.rollback_events.front()->m_block_height < cull_height)
+      while (!m_transient_state.rollback_events.empty() && get_rollback_event(m_transient_state.rollback_events.front()).m_block_height < cull_height)
       {
         m_transient_state.rollback_events.pop_front();
       }
-      m_transient_state.rollback_events.push_front(std::unique_ptr<rollback_event>(new prevent_rollback(cull_height)));
+      m_transient_state.rollback_events.push_front(prevent_rollback(cull_height));
     }
 
     //
@@ -1039,7 +1226,8 @@ namespace full_nodes
       if (block_height >= entry->unlock_height)
       {
         const bool adding_to_blacklist = false;
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_key_image_blacklist(block_height, (*entry), adding_to_blacklist)));
+        m_transient_state.rollback_events.push_back(rollback_key_image_blacklist(block_height, (*entry), adding_to_blacklist));
+        unindex_blacklisted_key_image(entry->key_image);
         entry = m_transient_state.key_image_blacklist.erase(entry);
       }
       else
@@ -1064,7 +1252,7 @@ namespace full_nodes
           LOG_PRINT_L1("Fullnode expired: " << pubkey << " at block height: " << block_height);
         }
 
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_change(block_height, pubkey, i->second)));
+        m_transient_state.rollback_events.push_back(rollback_change(block_height, pubkey, i->second));
 
         expired_count++;
         m_transient_state.full_nodes_infos.erase(i);
@@ -1078,11 +1266,7 @@ namespace full_nodes
       crypto::public_key winner_pubkey = cryptonote::get_full_node_winner_from_tx_extra(block.miner_tx.extra);
       if (m_transient_state.full_nodes_infos.count(winner_pubkey) == 1)
       {
-        m_transient_state.rollback_events.push_back(
-          std::unique_ptr<rollback_event>(
-            new rollback_change(block_height, winner_pubkey, m_transient_state.full_nodes_infos[winner_pubkey])
-          )
-        );
+        m_transient_state.rollback_events.push_back(rollback_change(block_height, winner_pubkey, m_transient_state.full_nodes_infos[winner_pubkey]));
         // set the winner as though it was re-registering at transaction index=UINT32_MAX for this block
         m_transient_state.full_nodes_infos[winner_pubkey].last_reward_block_height = block_height;
         m_transient_state.full_nodes_infos[winner_pubkey].last_reward_transaction_index = UINT32_MAX;
@@ -1094,26 +1278,32 @@ namespace full_nodes
     //
     size_t registrations = 0;
     size_t deregistrations = 0;
+    std::vector<cryptonote::tx_extra_field> extra_fields;
     for (uint32_t index = 0; index < txs.size(); ++index)
     {
       const cryptonote::transaction& tx             = txs[index];
       const cryptonote::transaction::type_t tx_type = tx.get_type();
+
+      // NOTE: Parsed once here, every tx_extra lookup below works off the same fields
+      extra_fields.clear();
+      cryptonote::parse_tx_extra(tx.extra, extra_fields);
+
       if (tx_type == cryptonote::transaction::type_standard)
       {
-        if (process_registration_tx(tx, block.timestamp, block_height, index))
+        if (process_registration_tx(tx, extra_fields, block.timestamp, block_height, index))
           registrations++;
 
-        process_contribution_tx(tx, block_height, index);
+        process_contribution_tx(tx, extra_fields, block_height, index);
       }
       else if (tx_type == cryptonote::transaction::type_deregister)
       {
-        if (process_deregistration_tx(tx, block_height))
+        if (process_deregistration_tx(tx, extra_fields, block_height))
           deregistrations++;
       }
       else if (tx_type == cryptonote::transaction::type_key_image_unlock)
       {
         crypto::public_key snode_key;
-        if (!cryptonote::get_full_node_pubkey_from_tx_extra(tx.extra, snode_key))
+        if (!cryptonote::get_full_node_pubkey_from_tx_extra(extra_fields, snode_key))
           continue;
 
         auto it = m_transient_state.full_nodes_infos.find(snode_key);
@@ -1128,7 +1318,7 @@ namespace full_nodes
         }
 
         cryptonote::tx_extra_tx_key_image_unlock unlock;
-        if (!cryptonote::get_tx_key_image_unlock_from_tx_extra(tx.extra, unlock))
+        if (!cryptonote::get_tx_key_image_unlock_from_tx_extra(extra_fields, unlock))
         {
           LOG_PRINT_L1("Unlock TX: Didn't have key image unlock in the tx_extra, rejected on height: " << block_height << " for tx: " << get_transaction_hash(tx));
           continue;
@@ -1157,7 +1347,7 @@ namespace full_nodes
               break;
             }
 
-            m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(new rollback_key_image_unlock(block_height, snode_key)));
+            m_transient_state.rollback_events.push_back(rollback_key_image_unlock(block_height, snode_key));
             node_info.requested_unlock_height = unlock_height;
             early_exit = true;
           }
@@ -1169,36 +1359,77 @@ namespace full_nodes
       update_swarms(block_height);
     }
 
+    //
+    // Keep the reward queue in sync with every node touched by this block
+    //
+    for (auto it = m_transient_state.rollback_events.rbegin();
+         it != m_transient_state.rollback_events.rend() && get_rollback_event(*it).m_block_height == block_height;
+         it++)
+    {
+      if (const auto *rollback = boost::get<rollback_change>(&(*it)))
+        update_node_indexes(rollback->m_key);
+      else if (const auto *rollback = boost::get<rollback_new>(&(*it)))
+        update_node_indexes(rollback->m_key);
+    }
+
     //
     // Update Quorum
     //
     const size_t cache_state_from_height = (block_height < QUORUM_LIFETIME) ? 0 : block_height - QUORUM_LIFETIME;
-    store_quorum_state_from_rewards_list(block_height);
+    quorum_waiter.wait(&tpool);
+    if (m_funded_keys_version == speculative_version && speculative_quorum)
+      m_transient_state.quorum_states[block_height] = std::move(speculative_quorum);
+    else
+      store_quorum_state_from_rewards_list(block_height);
     while (!m_transient_state.quorum_states.empty() && m_transient_state.quorum_states.begin()->first < cache_state_from_height)
     {
+      quorum_state_for_serialization archived;
+      archived.version = 0;
+      archived.height  = m_transient_state.quorum_states.begin()->first;
+      archived.state   = *m_transient_state.quorum_states.begin()->second;
+      m_quorum_archive_pending.push_back(std::move(archived));
       m_transient_state.quorum_states.erase(m_transient_state.quorum_states.begin());
     }
   }
 
+  bool full_node_list::can_rollback_to(uint64_t height) const
+  {
+    // Events older than the rollback horizon are culled, and a prevent_rollback
+    // at or above the target makes blockchain_detached fall back to init().
+    if (m_transient_state.height - height >= ROLLBACK_EVENT_EXPIRATION_BLOCKS)
+      return false;
+
+    for (const auto& event : m_transient_state.rollback_events)
+    {
+      const rollback_event& base = get_rollback_event(event);
+      if (base.m_block_height >= height && base.type == rollback_event::prevent_type)
+        return false;
+    }
+    return true;
+  }
+
   void full_node_list::blockchain_detached(uint64_t height)
   {
     std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
-    while (!m_transient_state.rollback_events.empty() && m_transient_state.rollback_events.back()->m_block_height >= height)
+    while (!m_transient_state.rollback_events.empty() && get_rollback_event(m_transient_state.rollback_events.back()).m_block_height >= height)
     {
-      rollback_event *event = &(*m_transient_state.rollback_events.back());
+      rollback_event_variant &event = m_transient_state.rollback_events.back();
       bool rollback_applied = true;
-      switch(event->type)
+      switch(get_rollback_event(event).type)
       {
         case rollback_event::change_type:
         {
-          auto *rollback = reinterpret_cast<rollback_change *>(event);
+          auto *rollback = &boost::get<rollback_change>(event);
           m_transient_state.full_nodes_infos[rollback->m_key] = rollback->m_info;
+          m_journal.dirty_keys.insert(rollback->m_key);
+          update_node_indexes(rollback->m_key);
         }
         break;
 
         case rollback_event::new_type:
         {
-          auto *rollback = reinterpret_cast<rollback_new *>(event);
+          auto *rollback = &boost::get<rollback_new>(event);
+          m_journal.dirty_keys.insert(rollback->m_key);
 
           auto iter = m_transient_state.full_nodes_infos.find(rollback->m_key);
           if (iter == m_transient_state.full_nodes_infos.end())
@@ -1209,6 +1440,7 @@ namespace full_nodes
           }
 
           m_transient_state.full_nodes_infos.erase(iter);
+          update_node_indexes(rollback->m_key);
         }
         break;
 
@@ -1216,7 +1448,8 @@ namespace full_nodes
 
         case rollback_event::key_image_blacklist_type:
         {
-          auto *rollback = reinterpret_cast<rollback_key_image_blacklist *>(event);
+          auto *rollback = &boost::get<rollback_key_image_blacklist>(event);
+          m_journal.key_image_blacklist_dirty = true;
           if (rollback->m_was_adding_to_blacklist)
           {
             auto it = std::find_if(m_transient_state.key_image_blacklist.begin(), m_transient_state.key_image_blacklist.end(),
@@ -1231,18 +1464,20 @@ namespace full_nodes
               break;
             }
 
+            unindex_blacklisted_key_image(it->key_image);
             m_transient_state.key_image_blacklist.erase(it);
           }
           else
           {
             m_transient_state.key_image_blacklist.push_back(rollback->m_entry);
+            m_blacklisted_key_images[rollback->m_entry.key_image]++;
           }
         }
         break;
 
         case rollback_event::key_image_unlock:
         {
-          auto *rollback = reinterpret_cast<rollback_key_image_unlock *>(event);
+          auto *rollback = &boost::get<rollback_key_image_unlock>(event);
           auto iter = m_transient_state.full_nodes_infos.find(rollback->m_key);
           if (iter == m_transient_state.full_nodes_infos.end())
           {
@@ -1251,6 +1486,7 @@ namespace full_nodes
             break;
           }
           iter->second.requested_unlock_height = KEY_IMAGE_AWAITING_UNLOCK_HEIGHT;
+          m_journal.dirty_keys.insert(rollback->m_key);
         }
         break;
 
@@ -1271,11 +1507,41 @@ namespace full_nodes
       m_transient_state.rollback_events.pop_back();
     }
 
+    // Only heights below the oldest resident quorum state get archived, so
+    // the archive is only touched by reorgs deeper than QUORUM_LIFETIME
+    const bool archive_detached = m_transient_state.quorum_states.empty() || m_transient_state.quorum_states.begin()->first > height;
+
     while (!m_transient_state.quorum_states.empty() && (--m_transient_state.quorum_states.end())->first >= height)
       m_transient_state.quorum_states.erase(--m_transient_state.quorum_states.end());
 
+    if (archive_detached)
+    {
+      while (!m_quorum_archive_pending.empty() && m_quorum_archive_pending.back().height >= height)
+        m_quorum_archive_pending.pop_back();
+
+      if (m_db && !m_db->is_read_only())
+      {
+        m_db->block_txn_start(false/*readonly*/);
+        m_db->remove_full_node_quorum_states_from(height);
+        m_db->block_txn_stop();
+      }
+
+      std::lock_guard<boost::mutex> archive_lock(m_quorum_archive_mutex);
+      for (auto it = m_quorum_archive_cache.begin(); it != m_quorum_archive_cache.end();)
+      {
+        if (it->first >= height)
+        {
+          m_quorum_archive_lru.erase(it->second.second);
+          it = m_quorum_archive_cache.erase(it);
+        }
+        else
+          it++;
+      }
+    }
+
     m_transient_state.height = height;
     store();
+    m_snapshot_stale.store(true, std::memory_order_release);
   }
 
   std::vector<crypto::public_key> full_node_list::update_and_get_expired_nodes(const std::vector<cryptonote::transaction> &txs, uint64_t block_height)
@@ -1301,7 +1567,7 @@ namespace full_nodes
       const cryptonote::block& block = blocks.begin()->second;
       std::vector<cryptonote::transaction> txs;
       std::vector<crypto::hash> missed_txs;
-      if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs))
+      if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs, true /*pruned*/))
       {
         LOG_ERROR("Unable to get transactions for block " << block.hash);
         return expired_nodes;
@@ -1379,19 +1645,133 @@ namespace full_nodes
   crypto::public_key full_node_list::select_winner() const
   {
     std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
-    auto oldest_waiting = std::pair<uint64_t, uint32_t>(std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint32_t>::max());
-    crypto::public_key key = crypto::null_pkey;
-    for (const auto& info : m_transient_state.full_nodes_infos)
-      if (info.second.is_fully_funded())
+    return m_reward_queue.front();
+  }
+
+  std::vector<crypto::public_key> full_node_list::get_next_winners(size_t count) const
+  {
+    std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+    return m_reward_queue.front(count);
+  }
+
+  void full_node_list::update_node_indexes(const crypto::public_key& key)
+  {
+    const auto it = m_transient_state.full_nodes_infos.find(key);
+    const full_node_info *info = (it == m_transient_state.full_nodes_infos.end()) ? nullptr : &it->second;
+    m_reward_queue.update(key, info);
+
+    {
+      auto const pubkey_less = [](crypto::public_key const &a, crypto::public_key const &b) { return memcmp(a.data, b.data, sizeof(a.data)) < 0; };
+      auto funded_it = std::lower_bound(m_funded_keys.begin(), m_funded_keys.end(), key, pubkey_less);
+      const bool listed = funded_it != m_funded_keys.end() && *funded_it == key;
+      const bool funded = info && info->is_fully_funded();
+      if (funded && !listed)
       {
-        auto waiting_since = std::make_pair(info.second.last_reward_block_height, info.second.last_reward_transaction_index);
-        if (waiting_since < oldest_waiting)
-        {
-          oldest_waiting = waiting_since;
-          key = info.first;
-        }
+        m_funded_keys.insert(funded_it, key);
+        m_funded_keys_version++;
+      }
+      else if (!funded && listed)
+      {
+        m_funded_keys.erase(funded_it);
+        m_funded_keys_version++;
+      }
+    }
+
+    auto locked_it = m_locked_key_images_by_node.find(key);
+    if (locked_it != m_locked_key_images_by_node.end())
+    {
+      for (const crypto::key_image& key_image : locked_it->second)
+      {
+        auto node_it = m_locked_key_images.find(key_image);
+        if (node_it != m_locked_key_images.end() && node_it->second == key)
+          m_locked_key_images.erase(node_it);
       }
-    return key;
+      m_locked_key_images_by_node.erase(locked_it);
+    }
+
+    if (!info || info->total_num_locked_contributions() == 0)
+      return;
+
+    std::vector<crypto::key_image> &key_images = m_locked_key_images_by_node[key];
+    for (const full_node_info::contributor_t &contributor : info->contributors)
+    {
+      for (const full_node_info::contribution_t &contribution : contributor.locked_contributions)
+      {
+        key_images.push_back(contribution.key_image);
+        m_locked_key_images.insert(std::make_pair(contribution.key_image, key));
+      }
+    }
+  }
+
+  void full_node_list::rebuild_node_indexes()
+  {
+    m_reward_queue.clear();
+    m_funded_keys.clear();
+    m_funded_keys_version++;
+    m_locked_key_images.clear();
+    m_locked_key_images_by_node.clear();
+    for (const auto& info : m_transient_state.full_nodes_infos)
+      update_node_indexes(info.first);
+
+    m_blacklisted_key_images.clear();
+    for (const key_image_blacklist_entry& entry : m_transient_state.key_image_blacklist)
+      m_blacklisted_key_images[entry.key_image]++;
+  }
+
+  void full_node_list::unindex_blacklisted_key_image(const crypto::key_image& key_image)
+  {
+    auto it = m_blacklisted_key_images.find(key_image);
+    if (it != m_blacklisted_key_images.end() && --it->second == 0)
+      m_blacklisted_key_images.erase(it);
+  }
+
+  bool reward_queue::position::operator<(const position& other) const
+  {
+    if (block_height != other.block_height)
+      return block_height < other.block_height;
+    if (transaction_index != other.transaction_index)
+      return transaction_index < other.transaction_index;
+    return memcmp(reinterpret_cast<const void*>(&key), reinterpret_cast<const void*>(&other.key), sizeof(key)) < 0;
+  }
+
+  void reward_queue::update(const crypto::public_key& key, const full_node_info *info)
+  {
+    const auto it = m_positions.find(key);
+    if (it != m_positions.end())
+    {
+      m_queue.erase(it->second);
+      m_positions.erase(it);
+    }
+
+    if (!info || !info->is_fully_funded())
+      return;
+
+    position pos = {};
+    pos.block_height      = info->last_reward_block_height;
+    pos.transaction_index = info->last_reward_transaction_index;
+    pos.key               = key;
+    m_queue.insert(pos);
+    m_positions[key] = pos;
+  }
+
+  void reward_queue::clear()
+  {
+    m_queue.clear();
+    m_positions.clear();
+  }
+
+  crypto::public_key reward_queue::front() const
+  {
+    return m_queue.empty() ? crypto::null_pkey : m_queue.begin()->key;
+  }
+
+  std::vector<crypto::public_key> reward_queue::front(size_t count) const
+  {
+    std::vector<crypto::public_key> result;
+    result.reserve(std::min(count, m_queue.size()));
+    for (auto it = m_queue.begin(); it != m_queue.end() && result.size() < count; it++)
+      result.push_back(it->key);
+    return result;
   }
 
   bool full_node_list::validate_miner_tx(const crypto::hash& prev_id, const cryptonote::transaction& miner_tx, uint64_t height, int hard_fork_version, cryptonote::block_reward_parts const &reward_parts) const
@@ -1418,6 +1798,9 @@ namespace full_nodes
     if (miner_tx.vout.size() - 1 < addresses_and_portions.size())
       return false;
 
+    // the same for every output of the block, and a base point mult to derive
+    const cryptonote::keypair ctrl_key = cryptonote::get_deterministic_keypair_from_height(height);
+
     for (size_t i = 0; i < addresses_and_portions.size(); i++)
     {
       size_t vout_index = i + 1;
@@ -1437,7 +1820,6 @@ namespace full_nodes
 
       crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);;
       crypto::public_key out_eph_public_key = AUTO_VAL_INIT(out_eph_public_key);
-      cryptonote::keypair ctrl_key = cryptonote::get_deterministic_keypair_from_height(height);
 
       bool r = crypto::generate_key_derivation(addresses_and_portions[i].first.m_view_public_key, ctrl_key.sec, derivation);
       CHECK_AND_ASSERT_MES(r, false, "while creating outs: failed to generate_key_derivation(" << addresses_and_portions[i].first.m_view_public_key << ", " << ctrl_key.sec << ")");
@@ -1476,7 +1858,11 @@ namespace full_nodes
       return;
     }
 
-    std::vector<crypto::public_key> full_node_list = get_full_nodes_pubkeys();
+    m_transient_state.quorum_states[height] = generate_quorum_state(get_full_nodes_pubkeys(), block_hash);
+  }
+
+  std::shared_ptr<const quorum_state> full_node_list::generate_quorum_state(const std::vector<crypto::public_key>& full_node_list, const crypto::hash& block_hash)
+  {
     std::vector<size_t>                              pub_keys_indexes(full_node_list.size());
     {
       size_t index = 0;
@@ -1523,7 +1909,7 @@ namespace full_nodes
       }
     }
 
-    m_transient_state.quorum_states[height] = new_state;
+    return new_state;
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1554,16 +1940,72 @@ namespace full_nodes
   {
   }
 
+  bool full_node_list::get_rollback_events_for_serialization(std::vector<rollback_event_variant>& events) const
+  {
+    events.assign(m_transient_state.rollback_events.begin(), m_transient_state.rollback_events.end());
+    return true;
+  }
+
+  bool full_node_list::set_rollback_events_from_serialization(const std::vector<rollback_event_variant>& events)
+  {
+    m_transient_state.rollback_events.assign(events.begin(), events.end());
+    return true;
+  }
+
   bool full_node_list::store()
   {
     if (m_blockchain.get_current_hard_fork_version() < cryptonote::network_version_9_full_nodes)
       return true;
 
     CHECK_AND_ASSERT_MES(m_db != nullptr, false, "Failed to store fullnode info, m_db == nullptr");
-    data_members_for_serialization data_to_store;
+    if (m_db->is_read_only())
+      return true;
+    std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+
+    // Every change to full_nodes_infos and the blacklist is accompanied by a
+    // rollback event, so the events since the last store (plus whatever
+    // blockchain_detached undid) tell us exactly what the delta has to carry.
+    for (const auto& event : m_transient_state.rollback_events)
+    {
+      if (get_rollback_event(event).m_block_height < m_journal.height)
+        continue;
+
+      if (const auto *rollback = boost::get<rollback_change>(&event))
+        m_journal.dirty_keys.insert(rollback->m_key);
+      else if (const auto *rollback = boost::get<rollback_new>(&event))
+        m_journal.dirty_keys.insert(rollback->m_key);
+      else if (const auto *rollback = boost::get<rollback_key_image_unlock>(&event))
+        m_journal.dirty_keys.insert(rollback->m_key);
+      else if (boost::get<rollback_key_image_blacklist>(&event))
+        m_journal.key_image_blacklist_dirty = true;
+    }
+
+    // NOTE: Events older than the rollback horizon have been culled, if we
+    // haven't stored for that long the dirty set can't be trusted anymore.
+    bool compact = !m_journal.have_checkpoint ||
+                   m_journal.num_deltas >= FULL_NODE_JOURNAL_COMPACTION_INTERVAL ||
+                   m_transient_state.height < m_journal.height ||
+                   m_transient_state.height - m_journal.height >= ROLLBACK_EVENT_EXPIRATION_BLOCKS ||
+                   m_journal.dirty_keys.size() * 2 > m_transient_state.full_nodes_infos.size();
+
+    flush_quorum_archive();
+    bool result = compact ? store_checkpoint() : store_delta();
+    if (result)
     {
-      std::lock_guard<boost::recursive_mutex> lock(m_sn_mutex);
+      m_journal.have_checkpoint           = true;
+      m_journal.num_deltas                = compact ? 0 : m_journal.num_deltas + 1;
+      m_journal.height                    = m_transient_state.height;
+      m_journal.key_image_blacklist_dirty = false;
+      m_journal.dirty_keys.clear();
+    }
+
+    return result;
+  }
 
+  bool full_node_list::store_checkpoint()
+  {
+    data_members_for_serialization data_to_store;
+    {
       quorum_state_for_serialization quorum;
       for(const auto& kv_pair : m_transient_state.quorum_states)
       {
@@ -1580,20 +2022,8 @@ namespace full_nodes
         data_to_store.infos.push_back(info);
       }
 
-      for (const auto& event_ptr : m_transient_state.rollback_events)
-      {
-        switch (event_ptr->type)
-        {
-          case rollback_event::change_type:              data_to_store.events.push_back(*reinterpret_cast<rollback_change *>(event_ptr.get())); break;
-          case rollback_event::new_type:                 data_to_store.events.push_back(*reinterpret_cast<rollback_new *>(event_ptr.get())); break;
-          case rollback_event::prevent_type:             data_to_store.events.push_back(*reinterpret_cast<prevent_rollback *>(event_ptr.get())); break;
-          case rollback_event::key_image_blacklist_type: data_to_store.events.push_back(*reinterpret_cast<rollback_key_image_blacklist *>(event_ptr.get())); break;
-          case rollback_event::key_image_unlock:         data_to_store.events.push_back(*reinterpret_cast<rollback_key_image_unlock *>(event_ptr.get())); break;
-          default:
-            MERROR("On storing fullnode data, unknown rollback event type encountered");
-            return false;
-        }
-      }
+      if (!get_rollback_events_for_serialization(data_to_store.events))
+        return false;
 
       data_to_store.key_image_blacklist = m_transient_state.key_image_blacklist;
     }
@@ -1616,26 +2046,95 @@ namespace full_nodes
     return true;
   }
 
-  void full_node_list::get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only) const
+  bool full_node_list::store_delta()
   {
-    keys.clear();
-    keys.resize(m_transient_state.full_nodes_infos.size());
-
-    size_t i = 0;
-    if (fully_funded_nodes_only)
+    data_members_delta_for_serialization delta = {};
     {
-      for (const auto &it : m_transient_state.full_nodes_infos)
+      delta.quorum_states_from_height = m_transient_state.quorum_states.empty() ? m_transient_state.height : m_transient_state.quorum_states.begin()->first;
+
+      quorum_state_for_serialization quorum;
+      for (auto it = m_transient_state.quorum_states.lower_bound(m_journal.height); it != m_transient_state.quorum_states.end(); it++)
       {
-        full_node_info const &info = it.second;
-        if (info.is_fully_funded())
-          keys[i++] = it.first;
+        quorum.height = it->first;
+        quorum.state  = *it->second;
+        delta.quorum_states.push_back(quorum);
       }
+
+      for (const crypto::public_key& key : m_journal.dirty_keys)
+      {
+        const auto it = m_transient_state.full_nodes_infos.find(key);
+        if (it == m_transient_state.full_nodes_infos.end())
+        {
+          delta.removed_infos.push_back(key);
+          continue;
+        }
+
+        full_node_pubkey_info info;
+        info.pubkey = it->first;
+        info.info   = it->second;
+        delta.infos.push_back(info);
+      }
+
+      if (!get_rollback_events_for_serialization(delta.events))
+        return false;
+
+      delta.has_key_image_blacklist = m_journal.key_image_blacklist_dirty;
+      if (delta.has_key_image_blacklist)
+        delta.key_image_blacklist = m_transient_state.key_image_blacklist;
     }
-    else
-    {
-      for (const auto &it : m_transient_state.full_nodes_infos)
-        keys[i++] = it.first;
-    }
+
+    delta.height  = m_transient_state.height;
+    int hf_version = m_blockchain.get_hard_fork_version(m_transient_state.height - 1);
+    delta.version = get_min_full_node_info_version_for_hf(hf_version);
+
+    std::stringstream ss;
+    binary_archive<true> ba(ss);
+
+    bool r = ::serialization::serialize(ba, delta);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to store fullnode info: failed to serialize delta");
+
+    std::string blob = ss.str();
+    m_db->block_txn_start(false/*readonly*/);
+    m_db->add_full_node_data_delta(blob);
+    m_db->block_txn_stop();
+
+    return true;
+  }
+
+  bool full_node_list::apply_delta(const data_members_delta_for_serialization& delta)
+  {
+    m_transient_state.height = delta.height;
+
+    for (const auto& info : delta.infos)
+      m_transient_state.full_nodes_infos[info.pubkey] = info.info;
+
+    for (const auto& key : delta.removed_infos)
+      m_transient_state.full_nodes_infos.erase(key);
+
+    if (delta.has_key_image_blacklist)
+      m_transient_state.key_image_blacklist = delta.key_image_blacklist;
+
+    auto &quorum_states = m_transient_state.quorum_states;
+    quorum_states.erase(quorum_states.begin(), quorum_states.lower_bound(delta.quorum_states_from_height));
+    quorum_states.erase(quorum_states.lower_bound(delta.height), quorum_states.end());
+    for (const auto& quorum : delta.quorum_states)
+      quorum_states[quorum.height] = std::make_shared<quorum_state>(quorum.state);
+
+    return set_rollback_events_from_serialization(delta.events);
+  }
+
+  void full_node_list::get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only, crypto::hash *keys_hash) const
+  {
+    const std::shared_ptr<const state_snapshot> snapshot = get_snapshot();
+    keys = fully_funded_nodes_only ? snapshot->sorted_funded_keys : snapshot->sorted_keys;
+    if (keys_hash)
+      *keys_hash = fully_funded_nodes_only ? snapshot->funded_keys_hash : snapshot->keys_hash;
+  }
+
+  crypto::hash full_node_list::get_all_full_nodes_public_keys_hash(bool fully_funded_nodes_only) const
+  {
+    const std::shared_ptr<const state_snapshot> snapshot = get_snapshot();
+    return fully_funded_nodes_only ? snapshot->funded_keys_hash : snapshot->keys_hash;
   }
 
 
@@ -1647,10 +2146,9 @@ namespace full_nodes
     {
       return false;
     }
-    std::stringstream ss;
-
     data_members_for_serialization data_in;
     std::string blob;
+    std::vector<std::string> delta_blobs;
 
     m_db->block_txn_start(true/*readonly*/);
     if (!m_db->get_full_node_data(blob))
@@ -1658,10 +2156,10 @@ namespace full_nodes
       m_db->block_txn_stop();
       return false;
     }
+    m_db->get_full_node_data_deltas(delta_blobs);
     m_db->block_txn_stop();
 
-    ss << blob;
-    binary_archive<false> ba(ss);
+    binary_archive<false> ba(epee::strspan<uint8_t>(blob));
     bool r = ::serialization::serialize(ba, data_in);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse fullnode data from blob");
 
@@ -1678,52 +2176,29 @@ namespace full_nodes
       m_transient_state.full_nodes_infos[info.pubkey] = info.info;
     }
 
-    for (const auto& event : data_in.events)
+    if (!set_rollback_events_from_serialization(data_in.events))
+      return false;
+
+    for (const std::string& delta_blob : delta_blobs)
     {
-      if (event.type() == typeid(rollback_change))
-      {
-        const auto& from = boost::get<rollback_change>(event);
-        auto *i = new rollback_change();
-        *i = from;
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(i));
-      }
-      else if (event.type() == typeid(rollback_new))
-      {
-        const auto& from = boost::get<rollback_new>(event);
-        auto *i = new rollback_new();
-        *i = from;
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(i));
-      }
-      else if (event.type() == typeid(prevent_rollback))
-      {
-        const auto& from = boost::get<prevent_rollback>(event);
-        auto *i = new prevent_rollback();
-        *i = from;
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(i));
-      }
-      else if (event.type() == typeid(rollback_key_image_blacklist))
-      {
-        const auto& from = boost::get<rollback_key_image_blacklist>(event);
-        auto *i = new rollback_key_image_blacklist();
-        *i = from;
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(i));
-      }
-      else if (event.type() == typeid(rollback_key_image_unlock))
-      {
-        const auto& from = boost::get<rollback_key_image_unlock>(event);
-        auto *i = new rollback_key_image_unlock();
-        *i = from;
-        m_transient_state.rollback_events.push_back(std::unique_ptr<rollback_event>(i));
-      }
-      else
-      {
-        MERROR("Unhandled rollback event type in restoring data to fullnode list.");
+      binary_archive<false> delta_ba(epee::strspan<uint8_t>(delta_blob));
+
+      data_members_delta_for_serialization delta;
+      r = ::serialization::serialize(delta_ba, delta);
+      CHECK_AND_ASSERT_MES(r, false, "Failed to parse fullnode data delta from blob, unknown version or corrupt journal");
+
+      if (!apply_delta(delta))
         return false;
-      }
     }
 
+    m_journal.have_checkpoint = true;
+    m_journal.num_deltas      = delta_blobs.size();
+    m_journal.height          = m_transient_state.height;
+    rebuild_node_indexes();
+
     MGINFO("Fullnode data loaded successfully, height: " << m_transient_state.height);
-    MGINFO(m_transient_state.full_nodes_infos.size() << " nodes and " << m_transient_state.rollback_events.size() << " rollback events loaded.");
+    MGINFO(m_transient_state.full_nodes_infos.size() << " nodes and " << m_transient_state.rollback_events.size() << " rollback events loaded"
+           << " (" << delta_blobs.size() << " journal deltas replayed).");
 
     LOG_PRINT_L1("full_node_list::load() returning success");
     return true;
@@ -1732,11 +2207,24 @@ namespace full_nodes
   void full_node_list::clear(bool delete_db_entry)
   {
     m_transient_state = {};
-    if (m_db && delete_db_entry)
+    m_journal = {};
+    m_reward_queue.clear();
+    m_locked_key_images.clear();
+    m_locked_key_images_by_node.clear();
+    m_blacklisted_key_images.clear();
+    m_funded_keys.clear();
+    m_funded_keys_version++;
+    m_quorum_archive_pending.clear();
+    if (m_db && delete_db_entry && !m_db->is_read_only())
     {
       m_db->block_txn_start(false/*readonly*/);
       m_db->clear_full_node_data();
+      m_db->remove_full_node_quorum_states_from(0);
       m_db->block_txn_stop();
+
+      std::lock_guard<boost::mutex> archive_lock(m_quorum_archive_mutex);
+      m_quorum_archive_lru.clear();
+      m_quorum_archive_cache.clear();
     }
 
     uint64_t hardfork_9_from_height = 0;
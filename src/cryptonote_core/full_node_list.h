@@ -28,6 +28,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <set>
 #include "blockchain.h"
 #include <boost/variant.hpp>
 #include "serialization/serialization.h"
@@ -35,6 +39,8 @@
 #include "cryptonote_core/constants.h"
 #include "cryptonote_core/full_node_deregister.h"
 
+class full_node_list_access;
+
 namespace full_nodes
 {
   class quorum_cop;
@@ -169,12 +175,44 @@ namespace full_nodes
   template<typename T>
   void antd_shuffle(std::vector<T>& a, uint64_t seed);
 
+  /// Redistribute the nodes of QUEUE_SWARM_ID (and of oversized swarms) into
+  /// swarms, deterministically from `seed`. Returns the ids of the swarms that
+  /// received nodes; nodes in any other swarm are unchanged.
+  std::set<swarm_id_t> calc_swarm_changes(std::map<swarm_id_t, std::vector<crypto::public_key>>& swarm_to_snodes, uint64_t seed);
+
+  // Fully funded nodes ordered by the position they have been waiting for a
+  // reward from, (last_reward_block_height, last_reward_transaction_index).
+  // The front of the queue is the winner of the next block.
+  class reward_queue
+  {
+  public:
+    void update(const crypto::public_key& key, const full_node_info *info); // nullptr (or not fully funded) removes the key
+    void clear();
+    crypto::public_key front() const;
+    std::vector<crypto::public_key> front(size_t count) const;
+    size_t size() const { return m_queue.size(); }
+
+  private:
+    struct position
+    {
+      uint64_t           block_height;
+      uint32_t           transaction_index;
+      crypto::public_key key;
+      bool operator<(const position& other) const;
+    };
+
+    std::set<position>                                 m_queue;
+    std::unordered_map<crypto::public_key, position>   m_positions;
+  };
+
   class full_node_list
     : public cryptonote::Blockchain::BlockAddedHook,
       public cryptonote::Blockchain::BlockchainDetachedHook,
       public cryptonote::Blockchain::InitHook,
       public cryptonote::Blockchain::ValidateMinerTxHook
   {
+    friend class ::full_node_list_access;
+
   public:
     full_node_list(cryptonote::Blockchain& blockchain);
     void block_added(const cryptonote::block& block, const std::vector<cryptonote::transaction>& txs) override;
@@ -184,22 +222,51 @@ namespace full_nodes
     bool validate_miner_tx(const crypto::hash& prev_id, const cryptonote::transaction& miner_tx, uint64_t height, int hard_fork_version, cryptonote::block_reward_parts const &base_reward) const override;
     std::vector<std::pair<cryptonote::account_public_address, uint64_t>> get_winner_addresses_and_portions() const;
     crypto::public_key select_winner() const;
+    std::vector<crypto::public_key> get_next_winners(size_t count) const;
+
+    // Immutable copy of the list, for readers that can tolerate being behind
+    // (RPC, P2P) instead of taking m_sn_mutex. Blocks only mark it stale, the
+    // first reader afterwards copies the state if m_sn_mutex is free and gets
+    // the previous copy otherwise, so a syncing node copies no state per block.
+    struct state_snapshot
+    {
+      std::unordered_map<crypto::public_key, full_node_info>  full_nodes_infos;
+      std::vector<key_image_blacklist_entry>                  key_image_blacklist;
+      std::map<uint64_t, std::shared_ptr<const quorum_state>> quorum_states;
+      uint64_t                                                height;
+      // pubkey-sorted key lists and their hashes, built when the snapshot is published
+      std::vector<crypto::public_key>                         sorted_keys;
+      std::vector<crypto::public_key>                         sorted_funded_keys;
+      crypto::hash                                            keys_hash;
+      crypto::hash                                            funded_keys_hash;
+
+      std::shared_ptr<const quorum_state> get_quorum_state(uint64_t height) const;
+      bool is_full_node(const crypto::public_key& pubkey) const { return full_nodes_infos.find(pubkey) != full_nodes_infos.end(); }
+    };
+    std::shared_ptr<const state_snapshot> get_snapshot() const;
 
     bool is_full_node(const crypto::public_key& pubkey) const;
     bool is_key_image_locked(crypto::key_image const &check_image, uint64_t *unlock_height = nullptr, full_node_info::contribution_t *the_locked_contribution = nullptr) const;
+    bool is_key_image_blacklisted(crypto::key_image const &check_image) const;
 
     void update_swarms(uint64_t height);
 
     /// Note(maxim): this should not affect thread-safety as the returned object is const
     const std::shared_ptr<const quorum_state> get_quorum_state(uint64_t height) const;
+
+    /// Quorum states older than QUORUM_LIFETIME are moved out of the list into
+    /// the DB, this looks them up through a small in-memory LRU. Doesn't take m_sn_mutex.
+    std::shared_ptr<const quorum_state> get_archived_quorum_state(uint64_t height) const;
     std::vector<full_node_pubkey_info> get_full_node_list_state(const std::vector<crypto::public_key> &full_node_pubkeys) const;
     const std::vector<key_image_blacklist_entry> &get_blacklisted_key_images() const { return m_transient_state.key_image_blacklist; }
+    std::vector<key_image_blacklist_entry> get_blacklisted_key_images_snapshot() const { return get_snapshot()->key_image_blacklist; }
 
     void set_db_pointer(cryptonote::BlockchainDB* db);
     void set_my_full_node_keys(crypto::public_key const *pub_key);
     bool store();
 
-    void get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only) const;
+    void get_all_full_nodes_public_keys(std::vector<crypto::public_key>& keys, bool fully_funded_nodes_only, crypto::hash *keys_hash = nullptr) const;
+    crypto::hash get_all_full_nodes_public_keys_hash(bool fully_funded_nodes_only) const;
 
     struct rollback_event
     {
@@ -322,14 +389,45 @@ namespace full_nodes
       END_SERIALIZE()
     };
 
+    // One journal record, applied on top of the last data_members_for_serialization
+    // checkpoint. Only the node infos touched since the previous record are stored,
+    // the rollback events are bounded by the rollback horizon and stored whole.
+    struct data_members_delta_for_serialization
+    {
+      uint8_t version;
+      uint64_t height;
+      uint64_t quorum_states_from_height;
+      std::vector<quorum_state_for_serialization> quorum_states;
+      std::vector<full_node_pubkey_info> infos;
+      std::vector<crypto::public_key> removed_infos;
+      std::vector<rollback_event_variant> events;
+      bool has_key_image_blacklist;
+      std::vector<key_image_blacklist_entry> key_image_blacklist;
+
+      BEGIN_SERIALIZE()
+        VARINT_FIELD(version)
+        if (version > full_node_info::version_2_infinite_staking) return false;
+        VARINT_FIELD(height)
+        VARINT_FIELD(quorum_states_from_height)
+        FIELD(quorum_states)
+        FIELD(infos)
+        FIELD(removed_infos)
+        FIELD(events)
+        FIELD(has_key_image_blacklist)
+        if (has_key_image_blacklist)
+          FIELD(key_image_blacklist)
+      END_SERIALIZE()
+    };
+
   private:
 
     // Note(maxim): private methods don't have to be protected the mutex
-    bool process_registration_tx(const cryptonote::transaction& tx, uint64_t block_timestamp, uint64_t block_height, uint32_t index);
-    void process_contribution_tx(const cryptonote::transaction& tx, uint64_t block_height, uint32_t index);
-    bool process_deregistration_tx(const cryptonote::transaction& tx, uint64_t block_height);
+    bool process_registration_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_timestamp, uint64_t block_height, uint32_t index);
+    void process_contribution_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_height, uint32_t index);
+    bool process_deregistration_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_height);
 
-    std::vector<crypto::public_key> get_full_nodes_pubkeys() const;
+    const std::vector<crypto::public_key>& get_full_nodes_pubkeys() const { return m_funded_keys; }
+    bool can_rollback_to(uint64_t height) const;
 
     template<typename T>
     void block_added_generic(const cryptonote::block& block, const T& txs);
@@ -337,12 +435,24 @@ namespace full_nodes
     bool contribution_tx_output_has_correct_unlock_time(const cryptonote::transaction& tx, size_t i, uint64_t block_height) const;
 
     void store_quorum_state_from_rewards_list(uint64_t height);
+    static std::shared_ptr<const quorum_state> generate_quorum_state(const std::vector<crypto::public_key>& full_node_list, const crypto::hash& block_hash);
 
     bool is_registration_tx(const cryptonote::transaction& tx, uint64_t block_timestamp, uint64_t block_height, uint32_t index, crypto::public_key& key, full_node_info& info) const;
+    bool is_registration_tx(const cryptonote::transaction& tx, const std::vector<cryptonote::tx_extra_field>& extra_fields, uint64_t block_timestamp, uint64_t block_height, uint32_t index, crypto::public_key& key, full_node_info& info) const;
     std::vector<crypto::public_key> update_and_get_expired_nodes(const std::vector<cryptonote::transaction> &txs, uint64_t block_height);
 
     void clear(bool delete_db_entry = false);
     bool load();
+    void publish_snapshot() const;
+    void update_node_indexes(const crypto::public_key& key);
+    void unindex_blacklisted_key_image(const crypto::key_image& key_image);
+    void flush_quorum_archive();
+    void rebuild_node_indexes();
+    bool store_checkpoint();
+    bool store_delta();
+    bool apply_delta(const data_members_delta_for_serialization& delta);
+    bool get_rollback_events_for_serialization(std::vector<rollback_event_variant>& events) const;
+    bool set_rollback_events_from_serialization(const std::vector<rollback_event_variant>& events);
 
     mutable boost::recursive_mutex m_sn_mutex;
     cryptonote::Blockchain&        m_blockchain;
@@ -356,12 +466,45 @@ namespace full_nodes
       std::unordered_map<crypto::public_key, full_node_info>   full_nodes_infos;
       std::vector<key_image_blacklist_entry>                      key_image_blacklist;
       std::map<block_height, std::shared_ptr<const quorum_state>> quorum_states;
-      std::list<std::unique_ptr<rollback_event>>                  rollback_events;
+      std::deque<rollback_event_variant>                          rollback_events; // oldest first, contiguous runs per block height
       block_height                                                height;
     } m_transient_state;
+
+    // Bookkeeping for the delta journal in the DB, i.e. what has changed since
+    // the last time the list was persisted.
+    struct
+    {
+      bool                                   have_checkpoint;
+      size_t                                 num_deltas;
+      block_height                           height;
+      std::unordered_set<crypto::public_key> dirty_keys;
+      bool                                   key_image_blacklist_dirty;
+    } m_journal;
+
+    // Indexes over m_transient_state, kept in sync from the rollback events
+    // like the reward queue, so key image checks don't walk every stake.
+    reward_queue                                                     m_reward_queue;
+    std::unordered_map<crypto::key_image, crypto::public_key>        m_locked_key_images;
+    std::unordered_map<crypto::public_key, std::vector<crypto::key_image>> m_locked_key_images_by_node;
+    std::unordered_map<crypto::key_image, size_t>                    m_blacklisted_key_images; // number of blacklist entries per key image
+    std::vector<crypto::public_key>                                  m_funded_keys; // fully funded nodes, sorted by key bytes
+    uint64_t                                                         m_funded_keys_version; // bumped whenever m_funded_keys changes
+
+    // Quorum states evicted from m_transient_state.quorum_states that still
+    // have to be written to the DB, flushed on store()
+    std::vector<quorum_state_for_serialization> m_quorum_archive_pending;
+
+    mutable boost::mutex                                                   m_quorum_archive_mutex;
+    mutable std::list<uint64_t>                                            m_quorum_archive_lru; // most recently used at the front
+    mutable std::unordered_map<uint64_t, std::pair<std::shared_ptr<const quorum_state>, std::list<uint64_t>::iterator>> m_quorum_archive_cache;
+
+    // NOTE: Only ever accessed through std::atomic_load/std::atomic_store
+    mutable std::shared_ptr<const state_snapshot> m_snapshot;
+    mutable std::atomic<bool>                     m_snapshot_stale; // the state changed since m_snapshot was published
   };
 
-  bool reg_tx_extract_fields(const cryptonote::transaction& tx, std::vector<cryptonote::account_public_address>& addresses, uint64_t& portions_for_operator, std::vector<uint64_t>& portions, uint64_t& expiration_timestamp, crypto::public_key& full_node_key, crypto::signature& signature, crypto::public_key& tx_pub_key);
+  bool reg_tx_extract_fields(const cryptonote::transaction& tx, std::vector<cryptonote::account_public_address>& addresses, uint64_t& portions_for_operator, std::vector<uint64_t>& portions, uint64_t& expiration_timestamp, crypto::public_key& full_node_key, crypto::signature& signature);
+  bool reg_tx_extract_fields(const std::vector<cryptonote::tx_extra_field>& extra_fields, std::vector<cryptonote::account_public_address>& addresses, uint64_t& portions_for_operator, std::vector<uint64_t>& portions, uint64_t& expiration_timestamp, crypto::public_key& full_node_key, crypto::signature& signature);
 
   struct converted_registration_args
   {
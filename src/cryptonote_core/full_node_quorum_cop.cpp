@@ -32,6 +32,7 @@
 #include "cryptonote_config.h"
 #include "cryptonote_core.h"
 #include "version.h"
+#include "common/threadpool.h"
 
 #include "common/antd_integration_test_hooks.h"
 
@@ -49,7 +50,10 @@ namespace full_nodes
   void quorum_cop::init()
   {
     m_last_height = 0;
-    m_uptime_proof_seen.clear();
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_uptime_proofs.clear();
+    m_uptime_proof_queue.clear();
+    m_uptime_proof_queued.clear();
   }
 
   void quorum_cop::blockchain_detached(uint64_t height)
@@ -122,7 +126,7 @@ namespace full_nodes
         const crypto::public_key &node_key = state->nodes_to_test[node_index];
 
         CRITICAL_REGION_LOCAL(m_lock);
-        bool vote_off_node = (m_uptime_proof_seen.find(node_key) == m_uptime_proof_seen.end());
+        bool vote_off_node = (m_uptime_proofs.last_proof_time(node_key) == 0);
 
         if (!vote_off_node)
           continue;
@@ -142,7 +146,7 @@ namespace full_nodes
     }
   }
 
-  static crypto::hash make_hash(crypto::public_key const &pubkey, uint64_t timestamp)
+  crypto::hash make_uptime_proof_hash(crypto::public_key const &pubkey, uint64_t timestamp)
   {
     char buf[44] = "SUP"; // Meaningless magic bytes
     crypto::hash result;
@@ -153,7 +157,7 @@ namespace full_nodes
     return result;
   }
 
-  bool quorum_cop::handle_uptime_proof(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof)
+  bool quorum_cop::handle_uptime_proof(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof, bool from_sync, const boost::uuids::uuid &source)
   {
     uint64_t now = time(nullptr);
 
@@ -161,7 +165,8 @@ namespace full_nodes
     const crypto::public_key& pubkey = proof.pubkey;
     const crypto::signature& sig     = proof.sig;
 
-    if ((timestamp < now - UPTIME_PROOF_BUFFER_IN_SECONDS) || (timestamp > now + UPTIME_PROOF_BUFFER_IN_SECONDS))
+    const uint64_t max_age = from_sync ? UPTIME_PROOF_MAX_TIME_IN_SECONDS : UPTIME_PROOF_BUFFER_IN_SECONDS;
+    if ((timestamp < now - max_age) || (timestamp > now + UPTIME_PROOF_BUFFER_IN_SECONDS))
       return false;
 
     if (!m_core.is_full_node(pubkey))
@@ -177,17 +182,78 @@ namespace full_nodes
       return false;
 
     CRITICAL_REGION_LOCAL(m_lock);
-    if (m_uptime_proof_seen[pubkey] >= now - (UPTIME_PROOF_FREQUENCY_IN_SECONDS / 2))
-      return false; // already received one uptime proof for this node recently.
+    if (!m_uptime_proofs.wants(pubkey, timestamp, from_sync, now))
+      return false; // already have this proof or a newer one, or relayed one recently.
 
-    crypto::hash hash = make_hash(pubkey, timestamp);
-    if (!crypto::check_signature(hash, pubkey, sig))
-      return false;
+    if (!m_uptime_proof_queued.insert(pubkey).second)
+      return false; // already have a proof for this node waiting to be verified.
 
-    m_uptime_proof_seen[pubkey] = now;
+    m_uptime_proof_queue.push_back({proof, from_sync, source});
     return true;
   }
 
+  std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> quorum_cop::verify_queued_uptime_proofs(std::vector<boost::uuids::uuid> &sources)
+  {
+    sources.clear();
+    std::vector<queued_uptime_proof> batch;
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      batch.swap(m_uptime_proof_queue);
+      m_uptime_proof_queued.clear();
+    }
+
+    if (batch.empty())
+      return {};
+
+    // NOTE: Not std::vector<bool>, every worker writes its own slots concurrently
+    std::vector<uint8_t> valid(batch.size(), 0);
+    {
+      tools::threadpool& tpool = tools::threadpool::getInstance();
+      tools::threadpool::waiter waiter;
+      size_t const threads    = std::max<size_t>(1, tpool.get_max_concurrency());
+      size_t const chunk_size = (batch.size() + threads - 1) / threads;
+      for (size_t begin = 0; begin < batch.size(); begin += chunk_size)
+      {
+        size_t const end = std::min(batch.size(), begin + chunk_size);
+        tpool.submit(&waiter, [&batch, &valid, begin, end]() {
+          for (size_t i = begin; i < end; i++)
+          {
+            const cryptonote::NOTIFY_UPTIME_PROOF::request &proof = batch[i].proof;
+            crypto::hash hash = make_uptime_proof_hash(proof.pubkey, proof.timestamp);
+            valid[i]          = crypto::check_signature(hash, proof.pubkey, proof.sig);
+          }
+        }, true);
+      }
+      waiter.wait(&tpool);
+    }
+
+    uint64_t now = time(nullptr);
+    std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> result;
+    result.reserve(batch.size());
+
+    CRITICAL_REGION_LOCAL(m_lock);
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      if (!valid[i])
+        continue;
+
+      cryptonote::NOTIFY_UPTIME_PROOF::request &proof = batch[i].proof;
+      if (m_uptime_proofs.add(proof, batch[i].from_sync, now))
+      {
+        result.push_back(std::move(proof));
+        sources.push_back(batch[i].source);
+      }
+    }
+
+    return result;
+  }
+
+  std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> quorum_cop::get_uptime_proofs() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_uptime_proofs.get_all();
+  }
+
   void quorum_cop::generate_uptime_proof_request(cryptonote::NOTIFY_UPTIME_PROOF::request& req) const
   {
     req.snode_version_major = static_cast<uint16_t>(ANTD_VERSION_MAJOR);
@@ -212,24 +278,14 @@ namespace full_nodes
     req.timestamp           = time(nullptr);
     req.pubkey              = pubkey;
 
-    crypto::hash hash = make_hash(req.pubkey, req.timestamp);
+    crypto::hash hash = make_uptime_proof_hash(req.pubkey, req.timestamp);
     crypto::generate_signature(hash, pubkey, seckey, req.sig);
   }
 
   bool quorum_cop::prune_uptime_proof()
   {
-    uint64_t now = time(nullptr);
-    const uint64_t prune_from_timestamp = now - UPTIME_PROOF_MAX_TIME_IN_SECONDS;
     CRITICAL_REGION_LOCAL(m_lock);
-
-    for (auto it = m_uptime_proof_seen.begin(); it != m_uptime_proof_seen.end();)
-    {
-      if (it->second < prune_from_timestamp)
-        it = m_uptime_proof_seen.erase(it);
-      else
-        it++;
-    }
-
+    m_uptime_proofs.prune(time(nullptr));
     return true;
   }
 
@@ -237,12 +293,55 @@ namespace full_nodes
   {
 
     CRITICAL_REGION_LOCAL(m_lock);
-    const auto& it = m_uptime_proof_seen.find(pubkey);
-    if (it == m_uptime_proof_seen.end())
+    return m_uptime_proofs.last_proof_time(pubkey);
+  }
+
+  bool uptime_proof_store::wants(const crypto::public_key &pubkey, uint64_t timestamp, bool from_sync, uint64_t now) const
+  {
+    const auto it = m_proofs.find(pubkey);
+    if (it == m_proofs.end())
+      return true;
+    if (it->second.proof.timestamp >= timestamp)
+      return false;
+    return from_sync || it->second.received < now - (UPTIME_PROOF_FREQUENCY_IN_SECONDS / 2);
+  }
+
+  bool uptime_proof_store::add(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof, bool from_sync, uint64_t now)
+  {
+    if (!wants(proof.pubkey, proof.timestamp, from_sync, now))
+      return false;
+    entry &e = m_proofs[proof.pubkey];
+    e.proof = proof;
+    if (from_sync)
+      return false;
+    e.received = now;
+    return true;
+  }
+
+  void uptime_proof_store::prune(uint64_t now)
+  {
+    const uint64_t prune_from_timestamp = now - UPTIME_PROOF_MAX_TIME_IN_SECONDS;
+    for (auto it = m_proofs.begin(); it != m_proofs.end();)
     {
-      return 0;
+      if (it->second.proof.timestamp < prune_from_timestamp)
+        it = m_proofs.erase(it);
+      else
+        it++;
     }
+  }
 
-    return (*it).second;
+  uint64_t uptime_proof_store::last_proof_time(const crypto::public_key &pubkey) const
+  {
+    const auto it = m_proofs.find(pubkey);
+    return it == m_proofs.end() ? 0 : it->second.proof.timestamp;
+  }
+
+  std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> uptime_proof_store::get_all() const
+  {
+    std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> result;
+    result.reserve(m_proofs.size());
+    for (const auto &e : m_proofs)
+      result.push_back(e.second.proof);
+    return result;
   }
 }
@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <unordered_set>
+#include <boost/uuid/nil_generator.hpp>
 #include "blockchain.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler_common.h"
 
@@ -38,6 +40,42 @@ namespace cryptonote
 
 namespace full_nodes
 {
+  // The message an uptime proof signs, binds the full node key to the proof's timestamp.
+  crypto::hash make_uptime_proof_hash(crypto::public_key const &pubkey, uint64_t timestamp);
+
+  // The latest uptime proof we know of for each full node. Proofs are
+  // ordered by the time they were signed; a live proof is relayed at most
+  // once per half proof interval, counted from when we received it, while
+  // one from a bulk sync is never relayed.
+  class uptime_proof_store
+  {
+  public:
+    // Returns false if a proof for this node signed at this time would be
+    // ignored, so it need not be verified.
+    bool wants(const crypto::public_key &pubkey, uint64_t timestamp, bool from_sync, uint64_t now) const;
+
+    // Records a verified proof, returns true if it should be relayed.
+    bool add(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof, bool from_sync, uint64_t now);
+
+    // Drops proofs that no longer show their node as up.
+    void prune(uint64_t now);
+
+    void clear() { m_proofs.clear(); }
+
+    // When the node's latest proof was signed, or 0 if we have none.
+    uint64_t last_proof_time(const crypto::public_key &pubkey) const;
+
+    std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> get_all() const;
+
+  private:
+    struct entry
+    {
+      cryptonote::NOTIFY_UPTIME_PROOF::request proof;
+      uint64_t received = 0; // when we last got a live proof of this node, 0 if only synced
+    };
+    std::unordered_map<crypto::public_key, entry> m_proofs;
+  };
+
   class quorum_cop
     : public cryptonote::Blockchain::BlockAddedHook,
       public cryptonote::Blockchain::BlockchainDetachedHook,
@@ -50,7 +88,19 @@ namespace full_nodes
     void block_added(const cryptonote::block& block, const std::vector<cryptonote::transaction>& txs) override;
     void blockchain_detached(uint64_t height) override;
 
-    bool handle_uptime_proof(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof);
+    // Runs the cheap checks on an incoming proof and queues it for signature
+    // verification, returns true if the proof was queued. Proofs from a bulk
+    // sync may be as old as a proof stays valid, and are never relayed.
+    // source is the connection the proof came in on, nil for our own.
+    bool handle_uptime_proof(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof, bool from_sync = false, const boost::uuids::uuid &source = boost::uuids::nil_uuid());
+
+    // Verifies the signatures of all queued proofs on the threadpool and
+    // returns the proofs that were accepted, ready to be relayed, along with
+    // the connection each came in on in sources.
+    std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> verify_queued_uptime_proofs(std::vector<boost::uuids::uuid> &sources);
+
+    // The latest accepted proof of every full node, for peers syncing them.
+    std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> get_uptime_proofs() const;
 
     static const uint64_t REORG_SAFETY_BUFFER_IN_BLOCKS = 20;
     static_assert(REORG_SAFETY_BUFFER_IN_BLOCKS < deregister_vote::VOTE_LIFETIME_BY_HEIGHT,
@@ -66,8 +116,15 @@ namespace full_nodes
     cryptonote::core& m_core;
     uint64_t m_last_height;
 
-    using timestamp = uint64_t;
-    std::unordered_map<crypto::public_key, timestamp> m_uptime_proof_seen;
+    uptime_proof_store m_uptime_proofs;
+    struct queued_uptime_proof
+    {
+      cryptonote::NOTIFY_UPTIME_PROOF::request proof;
+      bool                                     from_sync;
+      boost::uuids::uuid                       source;
+    };
+    std::vector<queued_uptime_proof>                      m_uptime_proof_queue;
+    std::unordered_set<crypto::public_key>                m_uptime_proof_queued;
     mutable epee::critical_section m_lock;
   };
 }
@@ -0,0 +1,440 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "common/threadpool.h"
+#include "ringct/rctOps.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "light_wallet_scanner.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "light_wallet"
+
+namespace cryptonote
+{
+  // Blocks read and scanned per pass; a reorg drops at most one pass
+  static constexpr uint64_t LIGHT_WALLET_SCAN_BATCH_BLOCKS = 100;
+
+  static constexpr uint64_t NO_DETACH = (uint64_t)-1;
+
+  light_wallet_scanner::light_wallet_scanner(Blockchain& blockchain)
+    : m_blockchain(blockchain), m_max_accounts(0), m_detach_height(NO_DETACH),
+      m_detach_count(0), m_wake(false), m_stop(false), m_running(false)
+  {
+  }
+
+  light_wallet_scanner::~light_wallet_scanner()
+  {
+    stop();
+  }
+
+  void light_wallet_scanner::start(size_t max_accounts)
+  {
+    if (m_running || max_accounts == 0)
+      return;
+
+    m_max_accounts = max_accounts;
+    m_stop = false;
+    m_running = true;
+    m_thread = boost::thread(boost::bind(&light_wallet_scanner::scan_thread, this));
+
+    m_blockchain.hook_block_added(*this);
+    m_blockchain.hook_blockchain_detached(*this);
+    MGINFO("Scanning the chain for up to " << max_accounts << " light wallet accounts");
+  }
+
+  void light_wallet_scanner::stop()
+  {
+    if (!m_running)
+      return;
+
+    m_blockchain.unhook_blockchain_detached(*this);
+    m_blockchain.unhook_block_added(*this);
+
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    m_running = false;
+  }
+
+  light_wallet_scanner::login_result light_wallet_scanner::login(const account_public_address& address, const crypto::secret_key& view_key, bool create)
+  {
+    const uint64_t height = m_blockchain.get_current_blockchain_height();
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_accounts.find(address.m_spend_public_key);
+    if (it != m_accounts.end())
+      return it->second->address == address ? login_ok : login_unknown;
+    if (!create)
+      return login_unknown;
+    if (m_accounts.size() >= m_max_accounts)
+      return login_full;
+
+    m_accounts.emplace(address.m_spend_public_key, make_account(address, view_key, height));
+    return login_created;
+  }
+
+  light_wallet_scanner::login_result light_wallet_scanner::import(const account_public_address& address, const crypto::secret_key& view_key, uint64_t start_height)
+  {
+    const uint64_t height = m_blockchain.get_current_blockchain_height();
+
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      auto it = m_accounts.find(address.m_spend_public_key);
+      if (it != m_accounts.end())
+      {
+        if (!(it->second->address == address))
+          return login_unknown;
+        // a fresh account rather than a reset one: the scanning thread may be
+        // reading the old one, and drops its results once it is replaced
+        it->second = make_account(address, view_key, std::min(start_height, height));
+      }
+      else
+      {
+        if (m_accounts.size() >= m_max_accounts)
+          return login_full;
+        m_accounts.emplace(address.m_spend_public_key, make_account(address, view_key, std::min(start_height, height)));
+      }
+      m_wake = true;
+    }
+    m_cond.notify_one();
+    return login_ok;
+  }
+
+  std::shared_ptr<light_wallet_scanner::account> light_wallet_scanner::make_account(const account_public_address& address, const crypto::secret_key& view_key, uint64_t start_height)
+  {
+    std::shared_ptr<account> acc = std::make_shared<account>();
+    acc->address = address;
+    acc->view_key = view_key;
+    acc->start_height = start_height;
+    acc->scanned_height = start_height;
+    return acc;
+  }
+
+  bool light_wallet_scanner::get_account(const account_public_address& address, const crypto::secret_key& view_key, account_state& state) const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_accounts.find(address.m_spend_public_key);
+    // the caller checked view_key against the address, so matching the address is enough
+    if (it == m_accounts.end() || !(it->second->address == address))
+      return false;
+    const account& acc = *it->second;
+    state.start_height = acc.start_height;
+    state.scanned_height = acc.scanned_height;
+    state.outputs = acc.outputs;
+    state.spends = acc.spends;
+    return true;
+  }
+
+  void light_wallet_scanner::block_added(const block& block, const std::vector<transaction>& txs)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_wake = true;
+    }
+    m_cond.notify_one();
+  }
+
+  void light_wallet_scanner::blockchain_detached(uint64_t height)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_detach_height = std::min(m_detach_height, height);
+      ++m_detach_count;
+      m_wake = true;
+    }
+    m_cond.notify_one();
+  }
+
+  void light_wallet_scanner::rollback(uint64_t height)
+  {
+    for (auto& entry: m_accounts)
+    {
+      account& acc = *entry.second;
+      while (!acc.spends.empty() && acc.spends.back().height >= height)
+        acc.spends.pop_back();
+      while (!acc.outputs.empty() && acc.outputs.back().height >= height)
+      {
+        if (acc.outputs.back().ringct)
+          acc.outputs_by_index.erase(acc.outputs.back().global_index);
+        acc.outputs.pop_back();
+      }
+      // the new chain may have blocks below the login height too
+      acc.start_height = std::min(acc.start_height, height);
+      acc.scanned_height = std::min(acc.scanned_height, height);
+    }
+  }
+
+  bool light_wallet_scanner::load_blocks(uint64_t start, uint64_t end, std::vector<scanned_tx>& txs) const
+  {
+    txs.clear();
+    std::vector<std::pair<blobdata, block>> blocks;
+    if (!m_blockchain.get_blocks(start, end - start, blocks) || blocks.size() != end - start)
+      return false;
+
+    uint64_t height = start;
+    for (auto& entry: blocks)
+    {
+      block& b = entry.second;
+      // only the output keys, commitments and ecdh info are needed, none of which is pruned
+      std::vector<transaction> block_txs;
+      std::vector<crypto::hash> missed;
+      if (!m_blockchain.get_transactions(b.tx_hashes, block_txs, missed, true) || !missed.empty())
+        return false;
+
+      const auto add_tx = [&](transaction& tx, const crypto::hash& hash, bool coinbase) {
+        txs.emplace_back();
+        scanned_tx& stx = txs.back();
+        stx.hash = hash;
+        stx.pub_key = get_tx_pub_key_from_extra(tx);
+        stx.height = height;
+        stx.timestamp = b.timestamp;
+        stx.coinbase = coinbase;
+        stx.tx = std::move(tx);
+        return m_blockchain.get_tx_outputs_gindexs(hash, stx.global_indices) && stx.global_indices.size() == stx.tx.vout.size();
+      };
+
+      if (!add_tx(b.miner_tx, get_transaction_hash(b.miner_tx), true))
+        return false;
+      for (size_t n = 0; n < block_txs.size(); ++n)
+        if (!add_tx(block_txs[n], b.tx_hashes[n], false))
+          return false;
+      ++height;
+    }
+    return true;
+  }
+
+  void light_wallet_scanner::scan_account(const account& acc, const std::vector<scanned_tx>& txs, account_matches& matches)
+  {
+    // outputs found earlier in this batch, which later txes in it may spend
+    std::unordered_map<uint64_t, size_t> new_outputs_by_index;
+
+    // the batch's derivations in one go, so their point compressions share
+    // the field inversions
+    std::vector<crypto::public_key> pub_keys(txs.size());
+    std::vector<crypto::key_derivation> derivations(txs.size());
+    std::unique_ptr<bool[]> derived(new bool[txs.size()]);
+    for (size_t n = 0; n < txs.size(); ++n)
+      pub_keys[n] = txs[n].pub_key;
+    crypto::generate_key_derivations(pub_keys.data(), txs.size(), acc.view_key, derivations.data(), derived.get());
+
+    for (size_t t = 0; t < txs.size(); ++t)
+    {
+      const scanned_tx& stx = txs[t];
+      if (stx.height < acc.scanned_height)
+        continue;
+      const transaction& tx = stx.tx;
+
+      if (!stx.coinbase)
+      {
+        for (const txin_v& in: tx.vin)
+        {
+          if (in.type() != typeid(txin_to_key))
+            continue;
+          const txin_to_key& in_to_key = boost::get<txin_to_key>(in);
+          if (in_to_key.amount != 0 || in_to_key.key_offsets.empty())
+            continue;
+          for (uint64_t index: relative_output_offsets_to_absolute(in_to_key.key_offsets))
+          {
+            size_t output;
+            auto it = acc.outputs_by_index.find(index);
+            if (it != acc.outputs_by_index.end())
+              output = it->second;
+            else
+            {
+              auto new_it = new_outputs_by_index.find(index);
+              if (new_it == new_outputs_by_index.end())
+                continue;
+              output = new_it->second;
+            }
+            spent_output spend;
+            spend.tx_hash = stx.hash;
+            spend.key_image = in_to_key.k_image;
+            spend.height = stx.height;
+            spend.timestamp = stx.timestamp;
+            spend.unlock_time = tx.unlock_time;
+            spend.output = output;
+            spend.mixin = in_to_key.key_offsets.size() - 1;
+            matches.spends.push_back(spend);
+          }
+        }
+      }
+
+      if (stx.pub_key == crypto::null_pkey || !derived[t])
+        continue;
+      const crypto::key_derivation& derivation = derivations[t];
+
+      for (size_t i = 0; i < tx.vout.size(); ++i)
+      {
+        if (tx.vout[i].target.type() != typeid(txout_to_key))
+          continue;
+        const crypto::public_key& out_key = boost::get<txout_to_key>(tx.vout[i].target).key;
+        crypto::public_key derived_key;
+        if (!crypto::derive_public_key(derivation, i, acc.address.m_spend_public_key, derived_key) || derived_key != out_key)
+          continue;
+
+        received_output out;
+        out.amount = tx.vout[i].amount;
+        if (!stx.coinbase && tx.rct_signatures.type != rct::RCTTypeNull)
+        {
+          if (i >= tx.rct_signatures.ecdhInfo.size() || i >= tx.rct_signatures.outPk.size())
+            continue;
+          rct::key scalar;
+          crypto::derivation_to_scalar(derivation, i, (crypto::ec_scalar&)scalar);
+          rct::ecdhTuple ecdh_info = tx.rct_signatures.ecdhInfo[i];
+          const bool v2 = tx.rct_signatures.type == rct::RCTTypeBulletproof2 || tx.rct_signatures.type == rct::RCTTypeCLSAG;
+          rct::ecdhDecode(ecdh_info, scalar, v2);
+          out.amount = rct::h2d(ecdh_info.amount);
+          if (!rct::equalKeys(rct::commit(out.amount, ecdh_info.mask), tx.rct_signatures.outPk[i].mask))
+          {
+            MWARNING("Output " << i << " of tx " << stx.hash << " has a commitment that does not match its amount, skipped");
+            continue;
+          }
+          const rct::ecdhTuple& encrypted = tx.rct_signatures.ecdhInfo[i];
+          out.rct = epee::string_tools::pod_to_hex(tx.rct_signatures.outPk[i].mask)
+            + epee::string_tools::pod_to_hex(encrypted.mask)
+            + epee::string_tools::pod_to_hex(encrypted.amount);
+        }
+
+        out.tx_hash = stx.hash;
+        out.tx_prefix_hash = get_transaction_prefix_hash(tx);
+        out.tx_pub_key = stx.pub_key;
+        out.out_key = out_key;
+        out.height = stx.height;
+        out.timestamp = stx.timestamp;
+        out.unlock_time = tx.get_unlock_time(i);
+        out.global_index = stx.global_indices[i];
+        out.index = i;
+        out.coinbase = stx.coinbase;
+        out.ringct = tx.version >= transaction::version_2;
+        if (out.ringct)
+          new_outputs_by_index.emplace(out.global_index, acc.outputs.size() + matches.outputs.size());
+        matches.outputs.push_back(std::move(out));
+      }
+    }
+  }
+
+  void light_wallet_scanner::scan_thread()
+  {
+    std::vector<scanned_tx> txs;
+    std::vector<std::shared_ptr<account>> accounts;
+    std::vector<account_matches> matches;
+
+    while (true)
+    {
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if (m_stop)
+          return;
+        m_wake = false;
+      }
+
+      // read before deciding to wait, so a block added after this wakes us
+      const uint64_t chain_height = m_blockchain.get_current_blockchain_height();
+
+      uint64_t start, end, detach_count;
+      accounts.clear();
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        if (m_detach_height != NO_DETACH)
+        {
+          rollback(m_detach_height);
+          m_detach_height = NO_DETACH;
+        }
+
+        // the highest cursor first, so importing accounts do not hold up the
+        // ones following the tip; they catch up between blocks and merge in
+        bool behind = false;
+        start = 0;
+        for (const auto& entry: m_accounts)
+        {
+          if (entry.second->scanned_height < chain_height)
+          {
+            start = std::max(start, entry.second->scanned_height);
+            behind = true;
+          }
+        }
+
+        if (!behind)
+        {
+          while (!m_wake && !m_stop)
+            m_cond.wait(lock);
+          continue;
+        }
+
+        end = std::min(chain_height, start + LIGHT_WALLET_SCAN_BATCH_BLOCKS);
+        detach_count = m_detach_count;
+        for (const auto& entry: m_accounts)
+          if (entry.second->scanned_height == start)
+            accounts.push_back(entry.second);
+      }
+
+      if (!load_blocks(start, end, txs))
+      {
+        // most likely a reorg raced us, the detach hook will have fired
+        MDEBUG("Failed to load blocks " << start << "-" << end << " for light wallet scanning, retrying");
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        continue;
+      }
+
+      // one derivation per tx and account, spread over the accounts; only this
+      // thread writes to the accounts, and not until the pool is done
+      matches.clear();
+      matches.resize(accounts.size());
+      tools::threadpool::getInstance().parallel_for(accounts.size(), [&](size_t n) {
+        scan_account(*accounts[n], txs, matches[n]);
+      }, true);
+
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      if (m_detach_count != detach_count)
+        continue;
+      for (size_t n = 0; n < accounts.size(); ++n)
+      {
+        // an import replaced it while it was being scanned
+        auto it = m_accounts.find(accounts[n]->address.m_spend_public_key);
+        if (it == m_accounts.end() || it->second != accounts[n])
+          continue;
+        account& acc = *accounts[n];
+        for (received_output& out: matches[n].outputs)
+        {
+          if (out.ringct)
+            acc.outputs_by_index.emplace(out.global_index, acc.outputs.size());
+          acc.outputs.push_back(std::move(out));
+        }
+        acc.spends.insert(acc.spends.end(), matches[n].spends.begin(), matches[n].spends.end());
+        acc.scanned_height = end;
+      }
+      MDEBUG("Scanned blocks " << start << "-" << end << " for " << accounts.size() << " light wallet accounts");
+    }
+  }
+}
@@ -0,0 +1,203 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "blockchain.h"
+
+class light_wallet_scanner_access;
+
+namespace cryptonote
+{
+  /**
+   * @brief scans the chain for the outputs of view keys registered by light wallets
+   *
+   * Backs the /login, /get_address_info, /get_address_txs and /get_unspent_outs
+   * RPC calls. Each new block is scanned once for all registered accounts, the
+   * accounts being split across the threadpool, instead of every wallet pulling
+   * and scanning the blocks itself.
+   *
+   * Only main addresses are matched. Spends are candidates: an input is reported
+   * if any ring member is one of the account's outputs, and the wallet tells its
+   * own key images from decoys. The index is kept in memory, so accounts start
+   * scanning at the height they log in at, or the height an import asks for,
+   * and are lost on restart. Each account has its own scan cursor: accounts
+   * at the chain tip are served first, importing ones catch up in between.
+   *
+   * The blockchain hooks run with the blockchain lock held, so they only wake
+   * the scanning thread.
+   */
+  class light_wallet_scanner
+    : public Blockchain::BlockAddedHook,
+      public Blockchain::BlockchainDetachedHook
+  {
+    friend class ::light_wallet_scanner_access;
+
+  public:
+    struct received_output
+    {
+      crypto::hash tx_hash;
+      crypto::hash tx_prefix_hash;
+      crypto::public_key tx_pub_key;
+      crypto::public_key out_key;
+      std::string rct; //!< hex commitment, encrypted mask and amount, empty for coinbase
+      uint64_t height;
+      uint64_t timestamp;
+      uint64_t unlock_time;
+      uint64_t global_index;
+      uint64_t amount;
+      uint32_t index;
+      bool coinbase;
+      bool ringct; //!< global_index counts amount 0 outputs, so rings can reference it
+    };
+
+    struct spent_output
+    {
+      crypto::hash tx_hash;
+      crypto::key_image key_image;
+      uint64_t height;
+      uint64_t timestamp;
+      uint64_t unlock_time;
+      size_t output; //!< index in account::outputs of the ring member we own
+      uint32_t mixin;
+    };
+
+    //! what the RPC calls serve for an account
+    struct account_state
+    {
+      uint64_t start_height;
+      uint64_t scanned_height;              //!< blocks below this are scanned
+      std::vector<received_output> outputs; //!< in chain order
+      std::vector<spent_output> spends;     //!< in chain order
+    };
+
+    enum login_result
+    {
+      login_ok,
+      login_created,
+      login_unknown,
+      login_full,
+    };
+
+    light_wallet_scanner(Blockchain& blockchain);
+    ~light_wallet_scanner();
+
+    /**
+     * @brief starts the scanning thread and hooks the blockchain
+     *
+     * @param max_accounts the number of view keys that may be registered
+     */
+    void start(size_t max_accounts);
+    void stop();
+    bool enabled() const { return m_running; }
+
+    /**
+     * @brief looks up, and if asked registers, an account
+     *
+     * The caller must have checked that view_key is the address' view key.
+     */
+    login_result login(const account_public_address& address, const crypto::secret_key& view_key, bool create);
+
+    /**
+     * @brief registers an account, or resets a registered one, to be scanned from a height
+     *
+     * For restored wallets, whose outputs predate their login. The account's
+     * results are dropped and rebuilt from start_height (capped at the chain
+     * height) by the scanning thread.
+     *
+     * The caller must have checked that view_key is the address' view key.
+     */
+    login_result import(const account_public_address& address, const crypto::secret_key& view_key, uint64_t start_height);
+
+    /**
+     * @brief copies out the outputs, spends and heights of a registered account
+     *
+     * @return false if the address is not registered with that view key
+     */
+    bool get_account(const account_public_address& address, const crypto::secret_key& view_key, account_state& state) const;
+
+    void block_added(const block& block, const std::vector<transaction>& txs) override;
+    void blockchain_detached(uint64_t height) override;
+
+  private:
+    struct account
+    {
+      account_public_address address;
+      crypto::secret_key view_key;
+      uint64_t start_height;
+      uint64_t scanned_height; //!< blocks below this are scanned for this account
+      std::vector<received_output> outputs; //!< in chain order
+      std::vector<spent_output> spends;     //!< in chain order
+      std::unordered_map<uint64_t, size_t> outputs_by_index; //!< amount 0 global index -> outputs
+    };
+
+    struct scanned_tx
+    {
+      transaction tx;
+      crypto::hash hash;
+      crypto::public_key pub_key;
+      std::vector<uint64_t> global_indices;
+      uint64_t height;
+      uint64_t timestamp;
+      bool coinbase;
+    };
+
+    struct account_matches
+    {
+      std::vector<received_output> outputs;
+      std::vector<spent_output> spends;
+    };
+
+    void scan_thread();
+    bool load_blocks(uint64_t start, uint64_t end, std::vector<scanned_tx>& txs) const;
+    static void scan_account(const account& acc, const std::vector<scanned_tx>& txs, account_matches& matches);
+    static std::shared_ptr<account> make_account(const account_public_address& address, const crypto::secret_key& view_key, uint64_t start_height);
+    void rollback(uint64_t height);
+
+    Blockchain& m_blockchain;
+
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    std::unordered_map<crypto::public_key, std::shared_ptr<account>> m_accounts; //!< by spend public key
+    size_t m_max_accounts;
+    uint64_t m_detach_height;    //!< lowest pending detach, or -1
+    uint64_t m_detach_count;     //!< bumped on every detach so a batch in flight is dropped
+    bool m_wake;
+    bool m_stop;
+    bool m_running;
+
+    boost::thread m_thread;
+  };
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "blockchain_db/blockchain_db.h"
+
+namespace cryptonote
+{
+
+/**
+ * @brief bounded cache of output data by (amount, global index)
+ *
+ * Shared by the block scan table builder and by pool admission, so ring
+ * members referenced again and again come from memory. Outputs never
+ * change once in the db, they only go away with their block, so the owner
+ * clears the cache whenever blocks are popped.
+ *
+ * Entries live in two generations: lookups hit either and promote to the
+ * current one, and once the current one is half the capacity it becomes
+ * the previous one, dropping the old previous. This keeps recently used
+ * entries at a hash lookup each without LRU list upkeep.
+ */
+class output_key_cache
+{
+public:
+  // an entry takes a little over 100 bytes, so about 30 MB by default
+  explicit output_key_cache(size_t max_entries = 256 * 1024): m_max_entries(max_entries) {}
+
+  /**
+   * @brief fetches outputs of an amount, from the cache or else the db
+   *
+   * Same contract as BlockchainDB::get_output_key for a single amount:
+   * with allow_partial, outputs stops before the first one not in the db.
+   */
+  void get_output_keys(const BlockchainDB &db, uint64_t amount, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial)
+  {
+    outputs.clear();
+    outputs.resize(offsets.size());
+    std::vector<uint64_t> missing;
+    std::vector<size_t> missing_pos;
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      for (size_t i = 0; i < offsets.size(); ++i)
+      {
+        if (!find(key_t(amount, offsets[i]), outputs[i]))
+        {
+          missing.push_back(offsets[i]);
+          missing_pos.push_back(i);
+        }
+      }
+    }
+    if (missing.empty())
+      return;
+
+    std::vector<output_data_t> fetched;
+    db.get_output_key(epee::span<const uint64_t>(&amount, 1), missing, fetched, allow_partial);
+    if (fetched.size() < missing.size())
+      outputs.resize(missing_pos[fetched.size()]);
+
+    boost::lock_guard<boost::mutex> lock(m_lock);
+    for (size_t i = 0; i < fetched.size(); ++i)
+    {
+      if (missing_pos[i] < outputs.size())
+        outputs[missing_pos[i]] = fetched[i];
+      insert(key_t(amount, missing[i]), fetched[i]);
+    }
+  }
+
+  void clear()
+  {
+    boost::lock_guard<boost::mutex> lock(m_lock);
+    m_current.clear();
+    m_previous.clear();
+  }
+
+private:
+  typedef std::pair<uint64_t, uint64_t> key_t;
+  struct key_hash
+  {
+    size_t operator()(const key_t &k) const { return std::hash<uint64_t>()(k.first * 0x9e3779b97f4a7c15ull ^ k.second); }
+  };
+  typedef std::unordered_map<key_t, output_data_t, key_hash> map_t;
+
+  bool find(const key_t &key, output_data_t &data)
+  {
+    auto it = m_current.find(key);
+    if (it != m_current.end())
+    {
+      data = it->second;
+      return true;
+    }
+    it = m_previous.find(key);
+    if (it == m_previous.end())
+      return false;
+    data = it->second;
+    insert(key, data);
+    return true;
+  }
+
+  void insert(const key_t &key, const output_data_t &data)
+  {
+    if (m_max_entries < 2)
+      return;
+    if (m_current.size() >= m_max_entries / 2)
+    {
+      m_previous.swap(m_current);
+      m_current.clear();
+    }
+    m_current.emplace(key, data);
+  }
+
+  const size_t m_max_entries;
+  boost::mutex m_lock;
+  map_t m_current;
+  map_t m_previous;
+};
+
+}
@@ -30,6 +30,8 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <fstream>
+#include <limits>
 #include <boost/filesystem.hpp>
 #include <unordered_set>
 #include <vector>
@@ -37,6 +39,7 @@
 #include "tx_pool.h"
 #include "cryptonote_tx_utils.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
+#include "cryptonote_basic/lazy_transaction.h"
 #include "cryptonote_config.h"
 #include "blockchain.h"
 #include "blockchain_db/blockchain_db.h"
@@ -45,6 +48,8 @@
 #include "misc_language.h"
 #include "warnings.h"
 #include "common/perf_timer.h"
+#include "common/alloc_profiler.h"
+#include "common/threadpool.h"
 #include "crypto/hash.h"
 
 #undef ANTD_DEFAULT_LOG_CATEGORY
@@ -76,6 +81,33 @@ namespace cryptonote
       return d;
     }
 
+    // the first time at which a tx last relayed at last_relayed is due again
+    time_t get_relay_due(time_t last_relayed, time_t received)
+    {
+      time_t due = last_relayed + 1;
+      while (due - last_relayed <= (time_t)get_relay_delay(due, received))
+        due = last_relayed + get_relay_delay(due, received) + 1;
+      return due;
+    }
+
+    uint64_t get_max_age(const txpool_tx_meta_t &meta)
+    {
+      return meta.kept_by_block ? CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME : CRYPTONOTE_MEMPOOL_TX_LIVETIME;
+    }
+
+    void erase_deadline(std::multimap<time_t, crypto::hash> &schedule, time_t due, const crypto::hash &txid)
+    {
+      auto range = schedule.equal_range(due);
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        if (it->second == txid)
+        {
+          schedule.erase(it);
+          break;
+        }
+      }
+    }
+
     uint64_t template_accept_threshold(uint64_t amount)
     {
       // XXX: multiplying by ACCEPT_THRESHOLD here was removed because of a need
@@ -107,10 +139,39 @@ namespace cryptonote
       Blockchain &m_blockchain;
       bool m_batch;
     };
+
+    const uint64_t POOL_SNAPSHOT_MAGIC = 0x78647044544e41ULL; // "ANTDpdx"
+    const uint32_t POOL_SNAPSHOT_VERSION = 1;
+    const uint32_t POOL_SNAPSHOT_MAX_KEY_IMAGES = 1 << 16; // way more inputs than a tx within the weight limit can have
+
+    // The snapshot holds what init() would otherwise parse every blob for;
+    // weights, fees and times are taken from the db meta as usual.
+    struct pool_snapshot_header
+    {
+      uint64_t magic;
+      uint32_t version;
+      uint32_t reserved;
+      crypto::hash top_hash;
+      uint64_t n_txes;
+    };
+
+    struct pool_snapshot_tx
+    {
+      crypto::hash txid;
+      uint8_t non_standard;
+      uint8_t reserved[3];
+      uint32_t n_key_images; // followed by that many key images
+    };
+
+    struct pool_snapshot_entry
+    {
+      bool non_standard;
+      std::vector<crypto::key_image> key_images;
+    };
   }
   //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_cookie(0)
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_cookie(0), m_parsed_tx_bytes(0)
   {
 
   }
@@ -199,6 +260,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
     PERF_TIMER(add_tx);
+    ALLOC_SCOPE(tx_pool);
     if (tx.version == transaction::version_0)
     {
       // v0 never accepted
@@ -338,10 +400,10 @@ namespace cryptonote
         memset(meta.padding, 0, sizeof(meta.padding));
         try
         {
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
           CRITICAL_REGION_LOCAL1(m_blockchain);
           LockedTXN lock(m_blockchain);
           m_blockchain.add_txpool_tx(id, blob, meta);
+          index_tx(id, meta, &tx);
           if (!insert_key_images(tx, id, kept_by_block))
             return false;
           m_txs_by_fee_and_receive_time.emplace(std::tuple<bool, double, std::time_t>(non_standard_tx, fee / (double)tx_weight, receive_time), id);
@@ -380,12 +442,11 @@ namespace cryptonote
 
       try
       {
-        if (kept_by_block)
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
         CRITICAL_REGION_LOCAL1(m_blockchain);
         LockedTXN lock(m_blockchain);
         m_blockchain.remove_txpool_tx(id);
         m_blockchain.add_txpool_tx(id, blob, meta);
+        index_tx(id, meta, &tx);
         if (!insert_key_images(tx, id, kept_by_block))
           return false;
         m_txs_by_fee_and_receive_time.emplace(std::tuple<bool, double, std::time_t>(non_standard_tx, fee / (double)tx_weight, receive_time), id);
@@ -458,6 +519,7 @@ namespace cryptonote
       const uint64_t tx_fee = std::get<1>(it->first);
       MINFO("Pruning tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << tx_fee);
       m_blockchain.remove_txpool_tx(txid);
+      unindex_tx(txid);
       m_txpool_weight -= meta.weight;
       remove_transaction_keyimages(tx, txid);
       MINFO("Pruned tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << tx_fee);
@@ -560,6 +622,21 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::insert_key_images(const std::vector<crypto::key_image> &key_images, const crypto::hash &id, bool kept_by_block)
+  {
+    for(const auto& k_image: key_images)
+    {
+      std::unordered_set<crypto::hash>& kei_image_set = m_spent_key_images[k_image];
+      CHECK_AND_ASSERT_MES(kept_by_block || kei_image_set.size() == 0, false, "internal error: kept_by_block=" << kept_by_block
+                                          << ",  kei_image_set.size()=" << kei_image_set.size() << ENDL << "txin.k_image=" << k_image << ENDL
+                                          << "tx_id=" << id );
+      auto ins_res = kei_image_set.insert(id);
+      CHECK_AND_ASSERT_MES(ins_res.second, false, "internal error: try to insert duplicate iterator in key_image set");
+    }
+    ++m_cookie;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   //FIXME: Can return early before removal of all of the key images.
   //       At the least, need to make sure that a false return here
   //       is treated properly.  Should probably not return early, however.
@@ -609,13 +686,14 @@ namespace cryptonote
         MERROR("Failed to find tx in txpool");
         return false;
       }
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(id);
-      auto ci = m_parsed_tx_cache.find(id);
-      if (ci != m_parsed_tx_cache.end())
+      // a tx taken for a block is usually still in the parsed tx cache, in
+      // which case neither its blob nor a parse is needed
+      auto entry_it = m_tx_template_entries.find(id);
+      if (entry_it != m_tx_template_entries.end() && entry_it->second.tx)
       {
-        tx = ci->second;
+        tx = *entry_it->second.tx;
       }
-      else if (!parse_and_validate_tx_from_blob(txblob, tx))
+      else if (!parse_and_validate_tx_from_blob(m_blockchain.get_txpool_tx_blob(id), tx))
       {
         MERROR("Failed to parse tx from txpool");
         return false;
@@ -632,6 +710,7 @@ namespace cryptonote
 
       // remove first, in case this throws, so key images aren't removed
       m_blockchain.remove_txpool_tx(id);
+      unindex_tx(id);
       m_txpool_weight -= tx_weight;
       remove_transaction_keyimages(tx, id);
     }
@@ -667,27 +746,29 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     std::list<std::pair<crypto::hash, uint64_t>> remove;
-    m_blockchain.for_all_txpool_txes([this, &remove](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata*) {
-      uint64_t tx_age = time(nullptr) - meta.receive_time;
+    const time_t now = time(nullptr);
+    for (auto it = m_expiry_schedule.begin(); it != m_expiry_schedule.end() && it->first <= now; ++it)
+    {
+      const crypto::hash &txid = it->second;
+      const auto entry_it = m_tx_template_entries.find(txid);
+      if (entry_it == m_tx_template_entries.end())
+        continue;
+      const txpool_tx_meta_t &meta = entry_it->second.meta;
+      uint64_t tx_age = now - meta.receive_time;
 
-      if((tx_age > CRYPTONOTE_MEMPOOL_TX_LIVETIME && !meta.kept_by_block) ||
-         (tx_age > CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME && meta.kept_by_block) )
+      LOG_PRINT_L1("Tx " << txid << " removed from tx pool due to outdated, age: " << tx_age );
+      auto sorted_it = find_tx_in_sorted_container(txid);
+      if (sorted_it == m_txs_by_fee_and_receive_time.end())
       {
-        LOG_PRINT_L1("Tx " << txid << " removed from tx pool due to outdated, age: " << tx_age );
-        auto sorted_it = find_tx_in_sorted_container(txid);
-        if (sorted_it == m_txs_by_fee_and_receive_time.end())
-        {
-          LOG_PRINT_L1("Removing tx " << txid << " from tx pool, but it was not found in the sorted txs container!");
-        }
-        else
-        {
-          m_txs_by_fee_and_receive_time.erase(sorted_it);
-        }
-        m_timed_out_transactions.insert(txid);
-        remove.push_back(std::make_pair(txid, meta.weight));
+        LOG_PRINT_L1("Removing tx " << txid << " from tx pool, but it was not found in the sorted txs container!");
       }
-      return true;
-    }, false);
+      else
+      {
+        m_txs_by_fee_and_receive_time.erase(sorted_it);
+      }
+      m_timed_out_transactions.insert(txid);
+      remove.push_back(std::make_pair(txid, meta.weight));
+    }
 
     if (!remove.empty())
     {
@@ -708,6 +789,7 @@ namespace cryptonote
           {
             // remove first, so we only remove key images if the tx removal succeeds
             m_blockchain.remove_txpool_tx(txid);
+            unindex_tx(txid);
             m_txpool_weight -= entry.second;
             remove_transaction_keyimages(tx, txid);
           }
@@ -729,52 +811,64 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const uint64_t now = time(NULL);
-    txs.reserve(m_blockchain.get_txpool_tx_count());
-    m_blockchain.for_all_txpool_txes([this, now, &txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *){
-      if(!meta.do_not_relay && now - meta.last_relayed_time > get_relay_delay(now, meta.receive_time))
-      {
-        // if the tx is older than half the max lifetime, we don't re-relay it, to avoid a problem
-        // mentioned by smooth where nodes would flush txes at slightly different times, causing
-        // flushed txes to be re-added when received from a node which was just about to flush it
-        uint64_t max_age = meta.kept_by_block ? CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME : CRYPTONOTE_MEMPOOL_TX_LIVETIME;
-        if (now - meta.receive_time <= max_age / 2)
+    for (auto it = m_relay_schedule.begin(); it != m_relay_schedule.end() && (uint64_t)it->first <= now; ++it)
+    {
+      const crypto::hash &txid = it->second;
+      const auto entry_it = m_tx_template_entries.find(txid);
+      if (entry_it == m_tx_template_entries.end())
+        continue;
+      const txpool_tx_meta_t &meta = entry_it->second.meta;
+      if(meta.do_not_relay || now - meta.last_relayed_time <= get_relay_delay(now, meta.receive_time))
+        continue;
+
+      // if the tx is older than half the max lifetime, we don't re-relay it, to avoid a problem
+      // mentioned by smooth where nodes would flush txes at slightly different times, causing
+      // flushed txes to be re-added when received from a node which was just about to flush it
+      uint64_t max_age = get_max_age(meta);
+      if (now - meta.receive_time > max_age / 2)
+        continue;
+
+      try
+      {
+        cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid);
+        if (meta.fee == 0)
         {
-          try
+          // the type is in the prefix, so only deregisters get their signatures decoded
+          cryptonote::lazy_transaction ltx;
+          if (!ltx.parse(bd))
           {
-            cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid);
-            if (meta.fee == 0)
-            {
-              cryptonote::transaction tx;
-              if (!cryptonote::parse_and_validate_tx_from_blob(bd, tx))
-              {
-                LOG_PRINT_L1("TX in pool could not be parsed from blob, txid: " << txid);
-                return true;
-              }
-
-              if (tx.get_type() != transaction::type_deregister)
-                return true;
-
-              tx_verification_context tvc;
-              uint64_t max_used_block_height = 0;
-              crypto::hash max_used_block_id = null_hash;
-              if (!m_blockchain.check_tx_inputs(tx, max_used_block_height, max_used_block_id, tvc, /*kept_by_block*/ false))
-              {
-                LOG_PRINT_L1("TX type: " << transaction::type_to_string(tx.type) << " considered for relaying failed tx inputs check, txid: " << txid << ", reason: " << print_tx_verification_context(tvc, &tx));
-                return true;
-              }
-            }
+            LOG_PRINT_L1("TX in pool could not be parsed from blob, txid: " << txid);
+            continue;
+          }
 
-            txs.push_back(std::make_pair(txid, bd));
+          if (ltx.tx().get_type() != transaction::type_deregister)
+            continue;
+
+          if (!ltx.load_prunable())
+          {
+            LOG_PRINT_L1("TX in pool could not be parsed from blob, txid: " << txid);
+            continue;
           }
-          catch (const std::exception &e)
+
+          cryptonote::transaction &tx = ltx.tx();
+          tx_verification_context tvc;
+          uint64_t max_used_block_height = 0;
+          crypto::hash max_used_block_id = null_hash;
+          if (!m_blockchain.check_tx_inputs(tx, max_used_block_height, max_used_block_id, tvc, /*kept_by_block*/ false))
           {
-            MERROR("Failed to get transaction blob from db");
-            // ignore error
+            LOG_PRINT_L1("TX type: " << transaction::type_to_string(tx.type) << " considered for relaying failed tx inputs check, txid: " << txid << ", reason: " << print_tx_verification_context(tvc, &tx));
+            continue;
           }
         }
+
+        txs.push_back(std::make_pair(txid, bd));
       }
-      return true;
-    }, false);
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to get transaction blob from db");
+        // ignore error
+      }
+    }
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -794,6 +888,7 @@ namespace cryptonote
           meta.relayed = true;
           meta.last_relayed_time = now;
           m_blockchain.update_txpool_tx(it->first, meta);
+          index_tx(it->first, meta);
         }
       }
       catch (const std::exception &e)
@@ -832,60 +927,62 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-    txs.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
-    m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
-      txs.push_back(txid);
-      return true;
-    }, false, include_unrelayed_txes);
+    // each shard is locked on its own, so the result is not an atomic view
+    // of the whole pool, which callers only use as a hint anyway
+    for (tx_index_shard &shard: m_tx_index)
+    {
+      CRITICAL_REGION_LOCAL(shard.lock);
+      txs.reserve(txs.size() + shard.txs.size());
+      for (const auto &e: shard.txs)
+        if (include_unrelayed_txes || !e.second)
+          txs.push_back(e.first);
+    }
   }
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_backlog(std::vector<tx_backlog_entry>& backlog, bool include_unrelayed_txes) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     const uint64_t now = time(NULL);
-    backlog.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
-    m_blockchain.for_all_txpool_txes([&backlog, now](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
-      backlog.push_back({meta.weight, meta.fee, meta.receive_time - now});
-      return true;
-    }, false, include_unrelayed_txes);
+    backlog.reserve(m_tx_stats[include_unrelayed_txes ? 1 : 0].weights.size());
+    for (const auto &e: m_tx_template_entries)
+    {
+      const txpool_tx_meta_t &meta = e.second.meta;
+      if (include_unrelayed_txes || !meta.do_not_relay)
+        backlog.push_back({meta.weight, meta.fee, meta.receive_time - now});
+    }
   }
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct txpool_stats& stats, bool include_unrelayed_txes) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     const uint64_t now = time(NULL);
+    const tx_stats_aggregate &agg = m_tx_stats[include_unrelayed_txes ? 1 : 0];
+    stats.txs_total = agg.weights.size();
+    stats.bytes_total = agg.bytes_total;
+    stats.fee_total = agg.fee_total;
+    stats.num_not_relayed = agg.num_not_relayed;
+    stats.num_failing = agg.num_failing;
+    stats.num_double_spends = agg.num_double_spends;
+    if (stats.txs_total == 0)
+      return;
+    stats.bytes_min = *agg.weights.begin();
+    stats.bytes_max = *agg.weights.rbegin();
+    auto mid = agg.weights.begin();
+    std::advance(mid, stats.txs_total / 2);
+    if (stats.txs_total % 2)
+      stats.bytes_med = *mid;
+    else
+      stats.bytes_med = (*std::prev(mid) + (uint64_t)*mid) / 2;
+    stats.oldest = agg.receive_times.begin()->first;
     std::map<uint64_t, txpool_histo> agebytes;
-    stats.txs_total = m_blockchain.get_txpool_tx_count(include_unrelayed_txes);
-    std::vector<uint32_t> weights;
-    weights.reserve(stats.txs_total);
-    m_blockchain.for_all_txpool_txes([&stats, &weights, now, &agebytes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
-      weights.push_back(meta.weight);
-      stats.bytes_total += meta.weight;
-      if (!stats.bytes_min || meta.weight < stats.bytes_min)
-        stats.bytes_min = meta.weight;
-      if (meta.weight > stats.bytes_max)
-        stats.bytes_max = meta.weight;
-      if (!meta.relayed)
-        stats.num_not_relayed++;
-      stats.fee_total += meta.fee;
-      if (!stats.oldest || meta.receive_time < stats.oldest)
-        stats.oldest = meta.receive_time;
-      if (meta.receive_time < now - 600)
+    for (const auto &e: agg.receive_times)
+    {
+      if (e.first < now - 600)
         stats.num_10m++;
-      if (meta.last_failed_height)
-        stats.num_failing++;
-      uint64_t age = now - meta.receive_time + (now == meta.receive_time);
+      uint64_t age = now - e.first + (now == e.first);
       agebytes[age].txs++;
-      agebytes[age].bytes += meta.weight;
-      if (meta.double_spend_seen)
-        ++stats.num_double_spends;
-      return true;
-      }, false, include_unrelayed_txes);
-    stats.bytes_med = epee::misc_utils::median(weights);
+      agebytes[age].bytes += e.second;
+    }
     if (stats.txs_total > 1)
     {
       /* looking for 98th percentile */
@@ -932,24 +1029,59 @@ namespace cryptonote
   //------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::get_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<spent_key_image_info>& key_image_infos, bool include_sensitive_data) const
+  {
+    const size_t first_info = tx_infos.size();
+    std::vector<crypto::hash> txids;
+    if (!collect_transactions_and_spent_keys_info(tx_infos, txids, key_image_infos, include_sensitive_data))
+      return false;
+
+    // Parsing and JSON rendering need neither lock and dominate the cost of
+    // this call on a large pool, so they are done after the locks are released
+    // and spread over the thread pool; results stay in pool order.
+    std::vector<char> parsed(txids.size(), 0);
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    for (size_t n = 0; n < txids.size(); ++n)
+    {
+      tpool.submit(&waiter, [&tx_infos, &txids, &parsed, first_info, n]() {
+        tx_info& txi = tx_infos[first_info + n];
+        transaction tx;
+        if (!parse_and_validate_tx_from_blob(txi.tx_blob, tx))
+          return;
+        tx.set_hash(txids[n]);
+        txi.tx_json = obj_to_json_str(tx);
+        parsed[n] = 1;
+      });
+    }
+    waiter.wait(&tpool);
+
+    size_t kept = first_info;
+    for (size_t n = 0; n < txids.size(); ++n)
+    {
+      if (!parsed[n])
+      {
+        MERROR("Failed to parse tx from txpool");
+        continue;
+      }
+      if (kept != first_info + n)
+        tx_infos[kept] = std::move(tx_infos[first_info + n]);
+      ++kept;
+    }
+    tx_infos.resize(kept);
+    return true;
+  }
+  //------------------------------------------------------------------
+  bool tx_memory_pool::collect_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<crypto::hash>& txids, std::vector<spent_key_image_info>& key_image_infos, bool include_sensitive_data) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    tx_infos.reserve(m_blockchain.get_txpool_tx_count());
+    tx_infos.reserve(tx_infos.size() + m_blockchain.get_txpool_tx_count());
+    txids.reserve(m_blockchain.get_txpool_tx_count());
     key_image_infos.reserve(m_blockchain.get_txpool_tx_count());
-    m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos, include_sensitive_data](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
+    m_blockchain.for_all_txpool_txes([&tx_infos, &txids, include_sensitive_data](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       tx_info txi;
       txi.id_hash = epee::string_tools::pod_to_hex(txid);
       txi.tx_blob = *bd;
-      transaction tx;
-      if (!parse_and_validate_tx_from_blob(*bd, tx))
-      {
-        MERROR("Failed to parse tx from txpool");
-        // continue
-        return true;
-      }
-      tx.set_hash(txid);
-      txi.tx_json = obj_to_json_str(tx);
       txi.blob_size = bd->size();
       txi.weight = meta.weight;
       txi.fee = meta.fee;
@@ -966,6 +1098,7 @@ namespace cryptonote
       txi.do_not_relay = meta.do_not_relay;
       txi.double_spend_seen = meta.double_spend_seen;
       tx_infos.push_back(std::move(txi));
+      txids.push_back(txid);
       return true;
     }, true, include_sensitive_data);
 
@@ -1052,16 +1185,32 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool> spent) const
+  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_sensitive_data) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
 
     spent.clear();
+    spent.reserve(key_images.size());
 
     for (const auto& image : key_images)
     {
-      spent.push_back(m_spent_key_images.find(image) == m_spent_key_images.end() ? false : true);
+      const auto it = m_spent_key_images.find(image);
+      bool found = it != m_spent_key_images.end();
+      if (found && !include_sensitive_data)
+      {
+        // only count spends by txes which may be relayed
+        found = false;
+        for (const crypto::hash &txid: it->second)
+        {
+          const auto entry = m_tx_template_entries.find(txid);
+          if (entry != m_tx_template_entries.end() && !entry->second.meta.do_not_relay)
+          {
+            found = true;
+            break;
+          }
+        }
+      }
+      spent.push_back(found);
     }
 
     return true;
@@ -1081,11 +1230,57 @@ namespace cryptonote
     }
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::cache_parsed_tx(const crypto::hash &txid, tx_template_entry &entry, std::shared_ptr<transaction> tx)
+  {
+    drop_parsed_tx(entry);
+    entry.tx = std::move(tx);
+    m_parsed_tx_lru.push_front(txid);
+    entry.lru = m_parsed_tx_lru.begin();
+    // the pool weight of a tx is a fair proxy for the memory its parsed form takes
+    m_parsed_tx_bytes += entry.meta.weight;
+
+    // never evict the tx just added, a caller is about to use it
+    while (m_parsed_tx_bytes > TXPOOL_TX_CACHE_MAX_BYTES && m_parsed_tx_lru.size() > 1)
+    {
+      auto victim = m_tx_template_entries.find(m_parsed_tx_lru.back());
+      if (victim == m_tx_template_entries.end())
+      {
+        MERROR("Parsed tx cache out of sync with the pool");
+        m_parsed_tx_lru.pop_back();
+        continue;
+      }
+      drop_parsed_tx(victim->second);
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::drop_parsed_tx(tx_template_entry &entry)
+  {
+    if (!entry.tx)
+      return;
+    m_parsed_tx_lru.erase(entry.lru);
+    m_parsed_tx_bytes -= std::min<uint64_t>(m_parsed_tx_bytes, entry.meta.weight);
+    entry.tx.reset();
+  }
+  //---------------------------------------------------------------------------------
+  transaction &tx_memory_pool::get_parsed_tx(const crypto::hash &txid, tx_template_entry &entry)
+  {
+    if (entry.tx)
+    {
+      m_parsed_tx_lru.splice(m_parsed_tx_lru.begin(), m_parsed_tx_lru, entry.lru);
+      return *entry.tx;
+    }
+    std::shared_ptr<transaction> tx = std::make_shared<transaction>();
+    if (!parse_and_validate_tx_from_blob(m_blockchain.get_txpool_tx_blob(txid), *tx))
+      throw std::runtime_error("failed to parse transaction blob");
+    tx->set_hash(txid);
+    cache_parsed_tx(txid, entry, tx);
+    return *tx;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
-    m_parsed_tx_cache.clear();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1093,15 +1288,176 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
-    m_parsed_tx_cache.clear();
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx(const crypto::hash &id) const
+  {
+    tx_index_shard &shard = tx_index_shard_for(id);
+    CRITICAL_REGION_LOCAL(shard.lock);
+    return shard.txs.find(id) != shard.txs.end();
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::tx_index_shard &tx_memory_pool::tx_index_shard_for(const crypto::hash &txid) const
+  {
+    static_assert((TX_INDEX_SHARDS & (TX_INDEX_SHARDS - 1)) == 0, "TX_INDEX_SHARDS must be a power of two");
+    // tx hashes are uniformly distributed, so any byte picks a shard evenly
+    return m_tx_index[((const unsigned char*)txid.data)[0] & (TX_INDEX_SHARDS - 1)];
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::account_tx_stats(const txpool_tx_meta_t &meta, bool add)
+  {
+    for (size_t n = meta.do_not_relay ? 1 : 0; n < 2; ++n)
+    {
+      tx_stats_aggregate &agg = m_tx_stats[n];
+      if (add)
+      {
+        agg.bytes_total += meta.weight;
+        agg.fee_total += meta.fee;
+        agg.num_not_relayed += !meta.relayed;
+        agg.num_failing += !!meta.last_failed_height;
+        agg.num_double_spends += !!meta.double_spend_seen;
+        agg.weights.insert(meta.weight);
+        agg.receive_times.emplace(meta.receive_time, meta.weight);
+      }
+      else
+      {
+        agg.bytes_total -= meta.weight;
+        agg.fee_total -= meta.fee;
+        agg.num_not_relayed -= !meta.relayed;
+        agg.num_failing -= !!meta.last_failed_height;
+        agg.num_double_spends -= !!meta.double_spend_seen;
+        auto w = agg.weights.find(meta.weight);
+        if (w != agg.weights.end())
+          agg.weights.erase(w);
+        auto range = agg.receive_times.equal_range(meta.receive_time);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+          if (it->second == meta.weight)
+          {
+            agg.receive_times.erase(it);
+            break;
+          }
+        }
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::schedule_tx(const crypto::hash &txid, tx_template_entry &entry, bool add)
+  {
+    if (!add)
+    {
+      if (entry.relay_due)
+        erase_deadline(m_relay_schedule, entry.relay_due, txid);
+      erase_deadline(m_expiry_schedule, entry.expiry_due, txid);
+      entry.relay_due = 0;
+      return;
+    }
+
+    const txpool_tx_meta_t &meta = entry.meta;
+    const uint64_t max_age = get_max_age(meta);
+    entry.relay_due = 0;
+    if (!meta.do_not_relay)
+    {
+      // past half the max lifetime a tx is not relayed anymore, see get_relayable_transactions
+      const time_t due = get_relay_due(meta.last_relayed_time, meta.receive_time);
+      if ((uint64_t)(due - meta.receive_time) <= max_age / 2)
+      {
+        entry.relay_due = due;
+        m_relay_schedule.emplace(due, txid);
+      }
+    }
+    entry.expiry_due = meta.receive_time + max_age + 1;
+    m_expiry_schedule.emplace(entry.expiry_due, txid);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::index_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta, const transaction *tx)
+  {
+    auto entry_it = m_tx_template_entries.find(txid);
+    if (entry_it == m_tx_template_entries.end())
+      entry_it = m_tx_template_entries.emplace(txid, tx_template_entry()).first;
+    else
+    {
+      account_tx_stats(entry_it->second.meta, false);
+      schedule_tx(txid, entry_it->second, false);
+    }
+    tx_template_entry &entry = entry_it->second;
+    entry.meta = meta;
+    account_tx_stats(meta, true);
+    schedule_tx(txid, entry, true);
+    if (tx)
+    {
+      std::shared_ptr<transaction> parsed = std::make_shared<transaction>(*tx);
+      parsed->set_hash(txid);
+      cache_parsed_tx(txid, entry, std::move(parsed));
+    }
+
+    bool added;
+    {
+      tx_index_shard &shard = tx_index_shard_for(txid);
+      CRITICAL_REGION_LOCAL(shard.lock);
+      auto ins = shard.txs.emplace(txid, meta.do_not_relay);
+      added = ins.second;
+      if (!added)
+        ins.first->second = meta.do_not_relay;
+    }
+    if (added)
+      for (TxsChangedHook *hook: m_txs_changed_hooks)
+        hook->tx_added(txid);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::unindex_tx(const crypto::hash &txid)
+  {
+    auto entry_it = m_tx_template_entries.find(txid);
+    if (entry_it != m_tx_template_entries.end())
+    {
+      account_tx_stats(entry_it->second.meta, false);
+      schedule_tx(txid, entry_it->second, false);
+      drop_parsed_tx(entry_it->second);
+      m_tx_template_entries.erase(entry_it);
+    }
+
+    bool removed;
+    {
+      tx_index_shard &shard = tx_index_shard_for(txid);
+      CRITICAL_REGION_LOCAL(shard.lock);
+      removed = shard.txs.erase(txid) != 0;
+    }
+    if (removed)
+      for (TxsChangedHook *hook: m_txs_changed_hooks)
+        hook->tx_removed(txid);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::hook_txs_changed(TxsChangedHook &hook)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-    return m_blockchain.get_db().txpool_has_tx(id);
+    m_txs_changed_hooks.push_back(&hook);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::unhook_txs_changed(TxsChangedHook &hook)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_txs_changed_hooks.erase(std::remove(m_txs_changed_hooks.begin(), m_txs_changed_hooks.end(), &hook), m_txs_changed_hooks.end());
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::rebuild_tx_index()
+  {
+    m_tx_template_entries.clear();
+    m_relay_schedule.clear();
+    m_expiry_schedule.clear();
+    for (tx_stats_aggregate &agg: m_tx_stats)
+      agg = tx_stats_aggregate();
+    m_parsed_tx_lru.clear();
+    m_parsed_tx_bytes = 0;
+    for (tx_index_shard &shard: m_tx_index)
+    {
+      CRITICAL_REGION_LOCAL(shard.lock);
+      shard.txs.clear();
+    }
+    m_blockchain.for_all_txpool_txes([this](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
+      index_tx(txid, meta);
+      return true;
+    }, false, true);
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx) const
@@ -1147,6 +1503,11 @@ namespace cryptonote
       }
     }
     bool ret = m_blockchain.check_tx_inputs(get_tx(), max_used_block_height, max_used_block_id, tvc, kept_by_block);
+    // entries are fixed size, so a count bound is a byte bound; a sixteenth
+    // of the cache budget is plenty as the cache is emptied at each block
+    static const size_t max_input_cache_entries = TXPOOL_TX_CACHE_MAX_BYTES / 16 / (sizeof(crypto::hash) + sizeof(std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>));
+    if (m_input_cache.size() >= max_input_cache_entries)
+      m_input_cache.clear();
     if (!kept_by_block)
       m_input_cache.insert(std::make_pair(txid, std::make_tuple(ret, tvc, max_used_block_height, max_used_block_id)));
     return ret;
@@ -1174,6 +1535,11 @@ namespace cryptonote
       bool parsed;
     } lazy_tx(txblob, txid, tx);
 
+    return is_transaction_ready_to_go(txd, txid, [&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); });
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const std::function<cryptonote::transaction&(void)> &lazy_tx) const
+  {
     //not the best implementation at this time, sorry :(
     //check is ring_signature already checked ?
     if(txd.max_used_block_id == null_hash)
@@ -1183,7 +1549,7 @@ namespace cryptonote
         return false;//we already sure that this tx is broken for this height
 
       tx_verification_context tvc;
-      if(!check_tx_inputs([&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
+      if(!check_tx_inputs(lazy_tx, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
       {
         txd.last_failed_height = m_blockchain.get_current_blockchain_height()-1;
         txd.last_failed_id = m_blockchain.get_block_id_by_height(txd.last_failed_height);
@@ -1200,7 +1566,7 @@ namespace cryptonote
           return false;
         //check ring signature again, it is possible (with very small chance) that this transaction become again valid
         tx_verification_context tvc;
-        if(!check_tx_inputs([&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
+        if(!check_tx_inputs(lazy_tx, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
         {
           txd.last_failed_height = m_blockchain.get_current_blockchain_height()-1;
           txd.last_failed_id = m_blockchain.get_block_id_by_height(txd.last_failed_height);
@@ -1270,6 +1636,7 @@ namespace cryptonote
             try
             {
               m_blockchain.update_txpool_tx(txid, meta);
+              index_tx(txid, meta);
             }
             catch (const std::exception &e)
             {
@@ -1343,17 +1710,31 @@ namespace cryptonote
 
     LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
 
+    // once the room left drops below the lightest tx in the pool, nothing
+    // else can fit whatever its fee, so the walk can stop early
+    uint64_t min_tx_weight = std::numeric_limits<uint64_t>::max();
+    for (const auto &e: m_tx_template_entries)
+      min_tx_weight = std::min<uint64_t>(min_tx_weight, e.second.meta.weight);
+
     LockedTXN lock(m_blockchain);
 
     auto sorted_it = m_txs_by_fee_and_receive_time.begin();
     for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
     {
-      txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
+      if (max_total_weight - total_weight < min_tx_weight)
+      {
+        LOG_PRINT_L2("  no room left for any pool tx");
+        break;
+      }
+
+      auto entry_it = m_tx_template_entries.find(sorted_it->second);
+      if (entry_it == m_tx_template_entries.end())
       {
         MERROR("  failed to find tx meta");
         continue;
       }
+      tx_template_entry &entry = entry_it->second;
+      txpool_tx_meta_t meta = entry.meta;
       LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
 
       // Can not exceed maximum block weight
@@ -1393,8 +1774,18 @@ namespace cryptonote
         }
       }
 
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second);
-      cryptonote::transaction tx;
+      // the blob is only fetched and parsed when the tx is not in the
+      // parsed tx cache, later templates and take_tx reuse the parsed tx
+      const crypto::hash &txid = sorted_it->second;
+      std::shared_ptr<cryptonote::transaction> parsed;
+      auto get_tx = [this, &entry, &txid, &parsed]() -> cryptonote::transaction& {
+        if (!parsed)
+        {
+          get_parsed_tx(txid, entry);
+          parsed = entry.tx;
+        }
+        return *parsed;
+      };
 
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
@@ -1403,7 +1794,7 @@ namespace cryptonote
       bool ready = false;
       try
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
+        ready = is_transaction_ready_to_go(meta, txid, get_tx);
       }
       catch (const std::exception &e)
       {
@@ -1415,6 +1806,7 @@ namespace cryptonote
         try
 	{
 	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
+	  index_tx(sorted_it->second, meta);
 	}
         catch (const std::exception &e)
 	{
@@ -1427,6 +1819,7 @@ namespace cryptonote
         LOG_PRINT_L2("  not ready to go");
         continue;
       }
+      const cryptonote::transaction &tx = *parsed;
       if (have_key_images(k_images, tx))
       {
         LOG_PRINT_L2("  key images already seen");
@@ -1486,6 +1879,7 @@ namespace cryptonote
           }
           // remove tx from db first
           m_blockchain.remove_txpool_tx(txid);
+          unindex_tx(txid);
           m_txpool_weight -= get_transaction_weight(tx, txblob.size());
           remove_transaction_keyimages(tx, txid);
           auto sorted_it = find_tx_in_sorted_container(txid);
@@ -1511,15 +1905,27 @@ namespace cryptonote
     return n_removed;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::init(size_t max_txpool_weight)
+  bool tx_memory_pool::init(size_t max_txpool_weight, const std::string &snapshot_file)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
+    m_snapshot_file = snapshot_file;
+    m_txs_by_fee_and_receive_time.clear();
+    m_spent_key_images.clear();
+    m_txpool_weight = 0;
+
+    if (load_snapshot())
+    {
+      rebuild_tx_index();
+      m_cookie = 0;
+      return true;
+    }
     m_txs_by_fee_and_receive_time.clear();
     m_spent_key_images.clear();
     m_txpool_weight = 0;
+
     std::vector<crypto::hash> remove;
 
     // first add the not kept by block, then the kept by block,
@@ -1551,7 +1957,7 @@ namespace cryptonote
       if (!r)
         return false;
     }
-    if (!remove.empty())
+    if (!remove.empty() && !m_blockchain.get_db().is_read_only())
     {
       LockedTXN lock(m_blockchain);
       for (const auto &txid: remove)
@@ -1568,15 +1974,217 @@ namespace cryptonote
       }
     }
 
+    rebuild_tx_index();
     m_cookie = 0;
 
     // Ignore deserialization error
     return true;
   }
 
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::sync_from_db()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    std::unordered_map<crypto::hash, txpool_tx_meta_t> in_db;
+    bool r = m_blockchain.for_all_txpool_txes([&in_db](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata*) {
+      in_db.emplace(txid, meta);
+      return true;
+    }, false, true);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to read the txpool");
+
+    std::unordered_set<crypto::hash> removed;
+    for (const auto &entry: m_tx_template_entries)
+      if (in_db.find(entry.first) == in_db.end())
+        removed.insert(entry.first);
+    if (!removed.empty())
+    {
+      // the blobs are gone from the db, so drop the key images by tx id
+      for (auto it = m_txs_by_fee_and_receive_time.begin(); it != m_txs_by_fee_and_receive_time.end();)
+        it = removed.count(it->second) ? m_txs_by_fee_and_receive_time.erase(it) : std::next(it);
+      for (auto it = m_spent_key_images.begin(); it != m_spent_key_images.end();)
+      {
+        for (auto txid = it->second.begin(); txid != it->second.end();)
+          txid = removed.count(*txid) ? it->second.erase(txid) : std::next(txid);
+        it = it->second.empty() ? m_spent_key_images.erase(it) : std::next(it);
+      }
+      for (const crypto::hash &txid: removed)
+      {
+        m_txpool_weight -= m_tx_template_entries[txid].meta.weight;
+        unindex_tx(txid);
+      }
+    }
+
+    // not kept by block first, as in init()
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      const bool kept = pass == 1;
+      for (const auto &e: in_db)
+      {
+        const crypto::hash &txid = e.first;
+        const txpool_tx_meta_t &meta = e.second;
+        if (!!kept != !!meta.kept_by_block)
+          continue;
+
+        auto entry_it = m_tx_template_entries.find(txid);
+        if (entry_it != m_tx_template_entries.end())
+        {
+          // relayed, failing or double spend flags may have changed
+          if (memcmp(&entry_it->second.meta, &meta, sizeof(meta)))
+            index_tx(txid, meta);
+          continue;
+        }
+
+        cryptonote::blobdata bd;
+        cryptonote::transaction_prefix tx;
+        if (!m_blockchain.get_txpool_tx_blob(txid, bd) || !parse_and_validate_tx_prefix_from_blob(bd, tx))
+        {
+          MWARNING("Failed to read tx " << txid << " from the txpool, skipping it");
+          continue;
+        }
+        if (!insert_key_images(tx, txid, meta.kept_by_block))
+        {
+          MERROR("Failed to insert key images from txpool tx " << txid);
+          continue;
+        }
+
+        const bool non_standard_tx = (tx.get_type() != transaction::type_standard);
+        m_txs_by_fee_and_receive_time.emplace(std::tuple<bool, double, time_t>(non_standard_tx, meta.fee / (double)meta.weight, meta.receive_time), txid);
+        m_txpool_weight += meta.weight;
+        index_tx(txid, meta);
+      }
+    }
+
+    ++m_cookie;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::load_snapshot()
+  {
+    if (m_snapshot_file.empty())
+      return false;
+
+    std::unordered_map<crypto::hash, pool_snapshot_entry> entries;
+    {
+      std::ifstream in(m_snapshot_file, std::ios::binary);
+      if (!in)
+        return false;
+
+      pool_snapshot_header header;
+      bool good = in.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.magic == POOL_SNAPSHOT_MAGIC && header.version == POOL_SNAPSHOT_VERSION;
+      if (good && header.top_hash != m_blockchain.get_tail_id())
+      {
+        MINFO("Ignoring pool snapshot " << m_snapshot_file << ": it does not match the blockchain");
+        good = false;
+      }
+      for (uint64_t i = 0; good && i < header.n_txes; ++i)
+      {
+        pool_snapshot_tx tx;
+        if (!in.read(reinterpret_cast<char*>(&tx), sizeof(tx)) || tx.n_key_images > POOL_SNAPSHOT_MAX_KEY_IMAGES)
+        {
+          good = false;
+          break;
+        }
+        pool_snapshot_entry &entry = entries[tx.txid];
+        entry.non_standard = tx.non_standard;
+        entry.key_images.resize(tx.n_key_images);
+        if (tx.n_key_images && !in.read(reinterpret_cast<char*>(entry.key_images.data()), tx.n_key_images * sizeof(crypto::key_image)))
+          good = false;
+      }
+      if (!good)
+        entries.clear();
+    }
+
+    // the snapshot is only valid until the pool changes again, which it
+    // will as soon as we're running
+    boost::system::error_code ec;
+    boost::filesystem::remove(m_snapshot_file, ec);
+    if (entries.empty())
+      return false;
+
+    size_t used = 0;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      const bool kept = pass == 1;
+      bool r = m_blockchain.for_all_txpool_txes([this, &entries, &used, kept](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+        if (!!kept != !!meta.kept_by_block)
+          return true;
+        auto it = entries.find(txid);
+        if (it == entries.end())
+        {
+          MINFO("Pool tx " << txid << " is missing from the pool snapshot");
+          return false;
+        }
+        if (!insert_key_images(it->second.key_images, txid, meta.kept_by_block))
+          return false;
+        m_txs_by_fee_and_receive_time.emplace(std::tuple<bool, double, time_t>(it->second.non_standard, meta.fee / (double)meta.weight, meta.receive_time), txid);
+        m_txpool_weight += meta.weight;
+        ++used;
+        return true;
+      }, false);
+      if (!r)
+        return false;
+    }
+    if (used != entries.size())
+    {
+      MINFO("Pool snapshot has txes no longer in the pool");
+      return false;
+    }
+    MINFO("Restored " << used << " pool txes from " << m_snapshot_file);
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::store_snapshot() const
+  {
+    std::unordered_map<crypto::hash, std::vector<crypto::key_image>> key_images;
+    for (const auto &e: m_spent_key_images)
+      for (const crypto::hash &txid: e.second)
+        key_images[txid].push_back(e.first);
+
+    std::ofstream out(m_snapshot_file, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      MWARNING("Failed to open " << m_snapshot_file << " for writing");
+      return false;
+    }
+
+    pool_snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = POOL_SNAPSHOT_MAGIC;
+    header.version = POOL_SNAPSHOT_VERSION;
+    header.top_hash = m_blockchain.get_tail_id();
+    header.n_txes = m_txs_by_fee_and_receive_time.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto &e: m_txs_by_fee_and_receive_time)
+    {
+      const std::vector<crypto::key_image> &kis = key_images[e.second];
+      pool_snapshot_tx tx;
+      memset(&tx, 0, sizeof(tx));
+      tx.txid = e.second;
+      tx.non_standard = std::get<0>(e.first);
+      tx.n_key_images = kis.size();
+      out.write(reinterpret_cast<const char*>(&tx), sizeof(tx));
+      if (!kis.empty())
+        out.write(reinterpret_cast<const char*>(kis.data()), kis.size() * sizeof(crypto::key_image));
+    }
+    if (!out)
+    {
+      MWARNING("Failed to write pool snapshot to " << m_snapshot_file);
+      out.close();
+      boost::system::error_code ec;
+      boost::filesystem::remove(m_snapshot_file, ec);
+      return false;
+    }
+    return true;
+  }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    if (!m_snapshot_file.empty())
+      store_snapshot();
     return true;
   }
 }
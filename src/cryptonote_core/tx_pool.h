@@ -35,6 +35,9 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
+#include <list>
+#include <map>
+#include <memory>
 #include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
 
@@ -91,6 +94,20 @@ namespace cryptonote
   class tx_memory_pool: boost::noncopyable
   {
   public:
+    /**
+     * @brief notified as txs enter and leave the pool
+     *
+     * Called with the pool lock held (and often the blockchain lock too),
+     * so implementations must only queue the event and return.
+     */
+    class TxsChangedHook
+    {
+    public:
+      virtual ~TxsChangedHook() = default;
+      virtual void tx_added(const crypto::hash &txid) = 0;
+      virtual void tx_removed(const crypto::hash &txid) = 0;
+    };
+
     /**
      * @brief Constructor
      *
@@ -196,23 +213,37 @@ namespace cryptonote
     /**
      * @brief loads pool state (if any) from disk, and initializes pool
      *
+     * If a snapshot written by deinit() matches the pool in the db, the
+     * in-memory indices are rebuilt from it without parsing any tx blob.
+     *
      * @param max_txpool_weight the max weight in bytes
+     * @param snapshot_file where deinit() stores the pool index, empty for none
      *
      * @return true
      */
-    bool init(size_t max_txpool_weight = 0);
+    bool init(size_t max_txpool_weight = 0, const std::string &snapshot_file = std::string());
 
     /**
-     * @brief attempts to save the transaction pool state to disk
+     * @brief attempts to save the transaction pool index to disk
      *
-     * Currently fails (returns false) if the data directory from init()
-     * does not exist and cannot be created, but returns true even if
-     * saving to disk is unsuccessful.
+     * The pool itself lives in the db, this only stores what init() would
+     * otherwise have to parse every tx blob for. Failing to save is not an
+     * error, the next init() just takes the slow path.
      *
-     * @return true in most cases (see above)
+     * @return true
      */
     bool deinit();
 
+    /**
+     * @brief catches up with txs another process added to or removed from the db
+     *
+     * For a replica, whose read only db is written by a primary daemon:
+     * the in-memory indices are brought in line with the pool in the db.
+     *
+     * @return true on success, false if the pool could not be read
+     */
+    bool sync_from_db();
+
     /**
      * @brief Chooses transactions for a block to include
      *
@@ -294,10 +325,11 @@ namespace cryptonote
      *
      * @param key_images [in] vector of key images to check
      * @param spent [out] vector of bool to return
+     * @param include_sensitive_data whether to count spends by txes which are not to be relayed
      *
      * @return true
      */
-    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool> spent) const;
+    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_sensitive_data = true) const;
 
     /**
      * @brief get a specific transaction from the pool
@@ -367,6 +399,12 @@ namespace cryptonote
       */
     uint64_t cookie() const { return m_cookie; }
 
+    /**
+     * @brief add/remove a hook notified of pool additions and removals
+     */
+    void hook_txs_changed(TxsChangedHook &hook);
+    void unhook_txs_changed(TxsChangedHook &hook);
+
     /**
      * @brief get the cumulative txpool weight in bytes
      *
@@ -425,7 +463,9 @@ namespace cryptonote
       bool double_spend_seen; //!< true iff another tx was seen double spending this one
     };
 
+#ifndef IN_UNIT_TESTS
   private:
+#endif
 
     /**
      * @brief insert key images into m_spent_key_images
@@ -434,6 +474,53 @@ namespace cryptonote
      */
     bool insert_key_images(const transaction_prefix &tx, const crypto::hash &txid, bool kept_by_block);
 
+    /**
+     * @brief insert key images into m_spent_key_images
+     *
+     * @return true on success, false on error
+     */
+    bool insert_key_images(const std::vector<crypto::key_image> &key_images, const crypto::hash &txid, bool kept_by_block);
+
+    /**
+     * @brief rebuilds the sorted container and key image index from the
+     * snapshot file written at the last clean shutdown
+     *
+     * @return true if the snapshot matched the db and was used
+     */
+    bool load_snapshot();
+
+    /**
+     * @brief writes the sorted container keys and key images to the snapshot file
+     *
+     * @return true on success
+     */
+    bool store_snapshot() const;
+
+    /**
+     * @brief records a tx (or its new meta) in the in-memory pool indices
+     *
+     * Must be called next to every add_txpool_tx/update_txpool_tx so that
+     * have_tx and get_transaction_hashes can answer without the pool lock,
+     * and so that fill_block_template never has to go back to the db.
+     *
+     * @param txid the tx hash
+     * @param meta the tx's meta, as just written to the db
+     * @param tx the parsed tx if at hand, otherwise any cached one is kept
+     */
+    void index_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta, const transaction *tx = nullptr);
+
+    /**
+     * @brief drops a tx from the in-memory pool indices
+     *
+     * @param txid the tx hash
+     */
+    void unindex_tx(const crypto::hash &txid);
+
+    /**
+     * @brief rebuilds the in-memory pool indices from the db
+     */
+    void rebuild_tx_index();
+
     /**
      * @brief remove old transactions from the pool
      *
@@ -445,6 +532,16 @@ namespace cryptonote
      */
     bool remove_stuck_transactions();
 
+    /**
+     * @brief locked half of get_transactions_and_spent_keys_info
+     *
+     * Appends the pool metadata and blobs to tx_infos (leaving tx_json empty)
+     * along with the matching txids, and fills key_image_infos.
+     *
+     * @return false if a key image's tx metadata could not be read
+     */
+    bool collect_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<crypto::hash>& txids, std::vector<spent_key_image_info>& key_image_infos, bool include_sensitive_data) const;
+
     /**
      * @brief check if a transaction in the pool has a given spent key image
      *
@@ -522,6 +619,17 @@ namespace cryptonote
      */
     bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction&tx) const;
 
+    /**
+     * @brief check if an already parsed transaction is a valid candidate for inclusion in a block
+     *
+     * @param txd the transaction to check (and info about it)
+     * @param txid the txid of the transaction to check
+     * @param get_tx returns the parsed transaction, only called if needed
+     *
+     * @return true if the transaction is good to go, otherwise false
+     */
+    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const std::function<cryptonote::transaction&(void)> &get_tx) const;
+
     /**
      * @brief mark all transactions double spending the one passed
      */
@@ -553,6 +661,124 @@ public:
 private:
 #endif
 
+    //! number of shards in the pool hash index, must be a power of two
+    static constexpr size_t TX_INDEX_SHARDS = 16;
+
+    /**
+     * @brief one shard of the pool hash index
+     *
+     * Readers only take the shard's own lock, so membership checks from the
+     * p2p and rpc threads never wait on m_transactions_lock or the
+     * blockchain lock while a block or a large tx batch is being processed.
+     */
+    struct tx_index_shard
+    {
+      epee::critical_section lock;
+      std::unordered_map<crypto::hash, bool> txs; //!< txid -> do_not_relay
+    };
+    mutable tx_index_shard m_tx_index[TX_INDEX_SHARDS];
+
+    /**
+     * @brief what fill_block_template needs to know about a pool tx
+     *
+     * A copy of the db meta, kept in sync by index_tx, plus the parsed tx
+     * when it is held in the parsed tx cache.
+     */
+    struct tx_template_entry
+    {
+      txpool_tx_meta_t meta;
+      std::shared_ptr<transaction> tx;
+      std::list<crypto::hash>::iterator lru; //!< position in m_parsed_tx_lru, valid iff tx is set
+      time_t relay_due = 0; //!< key in m_relay_schedule, 0 if the tx is not due for relaying again
+      time_t expiry_due = 0; //!< key in m_expiry_schedule
+    };
+
+    //! in-memory view of the pool for block templates, guarded by m_transactions_lock
+    std::unordered_map<crypto::hash, tx_template_entry> m_tx_template_entries;
+
+    /**
+     * @brief running totals behind get_transaction_stats
+     *
+     * Maintained by index_tx and unindex_tx from the same meta copies as
+     * m_tx_template_entries, so stats never have to walk the db.
+     */
+    struct tx_stats_aggregate
+    {
+      uint64_t bytes_total = 0;
+      uint64_t fee_total = 0;
+      uint32_t num_not_relayed = 0;
+      uint32_t num_failing = 0;
+      uint32_t num_double_spends = 0;
+      std::multiset<uint32_t> weights;
+      std::multimap<uint64_t, uint32_t> receive_times; //!< receive time -> weight
+    };
+
+    //! [0] txes which may be relayed, [1] all txes, guarded by m_transactions_lock
+    tx_stats_aggregate m_tx_stats[2];
+
+    /**
+     * @brief adds a tx's meta to, or removes it from, the running stats
+     *
+     * @param meta the tx's meta
+     * @param add true to account for the tx, false to take it back out
+     */
+    void account_tx_stats(const txpool_tx_meta_t &meta, bool add);
+
+    //! parsed txes held by m_tx_template_entries, most recently used first
+    std::list<crypto::hash> m_parsed_tx_lru;
+    //! approximate memory held by the parsed txes in m_parsed_tx_lru
+    uint64_t m_parsed_tx_bytes;
+
+    /**
+     * @brief attaches a parsed tx to a pool entry, evicting the least
+     * recently used parsed txes past TXPOOL_TX_CACHE_MAX_BYTES
+     *
+     * @param txid the tx hash
+     * @param entry the tx's pool entry
+     * @param tx the parsed tx
+     */
+    void cache_parsed_tx(const crypto::hash &txid, tx_template_entry &entry, std::shared_ptr<transaction> tx);
+
+    /**
+     * @brief detaches the parsed tx, if any, from a pool entry
+     *
+     * @param entry the tx's pool entry
+     */
+    void drop_parsed_tx(tx_template_entry &entry);
+
+    /**
+     * @brief returns the parsed tx of a pool entry, parsing its blob on a miss
+     *
+     * @param txid the tx hash
+     * @param entry the tx's pool entry
+     *
+     * @return the parsed tx, throws if the blob cannot be found or parsed
+     */
+    transaction &get_parsed_tx(const crypto::hash &txid, tx_template_entry &entry);
+
+    tx_index_shard &tx_index_shard_for(const crypto::hash &txid) const;
+
+    /**
+     * @brief when pool txes are next due for relaying and for removal
+     *
+     * Maintained by index_tx and unindex_tx from the meta copies in
+     * m_tx_template_entries, so get_relayable_transactions and
+     * remove_stuck_transactions only visit txes whose deadline has passed
+     * instead of walking the whole pool in the db.  Guarded by
+     * m_transactions_lock.
+     */
+    std::multimap<time_t, crypto::hash> m_relay_schedule;
+    std::multimap<time_t, crypto::hash> m_expiry_schedule;
+
+    /**
+     * @brief adds a pool entry's deadlines to, or removes them from, the schedules
+     *
+     * @param txid the tx hash
+     * @param entry the tx's pool entry
+     * @param add true to schedule the tx from its meta, false to unschedule it
+     */
+    void schedule_tx(const crypto::hash &txid, tx_template_entry &entry, bool add);
+
     //! container for spent key images from the transactions in the pool
     key_images_container m_spent_key_images;  
 
@@ -566,6 +792,8 @@ private:
 
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
+    std::vector<TxsChangedHook*> m_txs_changed_hooks; //!< guarded by m_transactions_lock
+
     /**
      * @brief get an iterator to a transaction in the sorted container
      *
@@ -589,9 +817,10 @@ private:
     size_t m_txpool_max_weight;
     size_t m_txpool_weight;
 
-    mutable std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> m_input_cache;
+    std::string m_snapshot_file; //!< pool index snapshot, see init()
 
-    std::unordered_map<crypto::hash, transaction> m_parsed_tx_cache;
+    //! check_tx_inputs results, bounded to a share of TXPOOL_TX_CACHE_MAX_BYTES
+    mutable std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> m_input_cache;
   };
 }
 
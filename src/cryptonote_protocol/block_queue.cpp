@@ -29,6 +29,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <cmath>
 #include <vector>
 #include <unordered_map>
 #include <boost/uuid/nil_generator.hpp>
@@ -50,6 +51,14 @@ namespace std {
   };
 }
 
+namespace
+{
+  // weight of the latest span in the per peer averages
+  constexpr float PEER_MODEL_EWMA_ALPHA = 0.3f;
+  // a span for the slowest peer is never cut below this fraction of the full size
+  constexpr uint64_t MIN_SPAN_SIZE_DIVISOR = 8;
+}
+
 namespace cryptonote
 {
 
@@ -89,6 +98,8 @@ void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
       erase_block(j);
     }
   }
+  if (all)
+    peer_models.erase(connection_id);
 }
 
 void block_queue::erase_block(block_map::iterator j)
@@ -114,6 +125,13 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
       erase_block(j);
     }
   }
+  for (auto i = peer_models.begin(); i != peer_models.end(); )
+  {
+    if (live_connections.find(i->first) == live_connections.end())
+      i = peer_models.erase(i);
+    else
+      ++i;
+  }
 }
 
 bool block_queue::remove_span(uint64_t start_block_height, std::vector<crypto::hash> *hashes)
@@ -519,6 +537,105 @@ float block_queue::get_download_rate(const boost::uuids::uuid &connection_id) co
   return conn_rate;
 }
 
+void block_queue::update_peer_model(const boost::uuids::uuid &connection_id, uint64_t nblocks, size_t size, float seconds)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  if (nblocks == 0 || size == 0)
+    return;
+  seconds = std::max(seconds, 1e-6f);
+  const float block_size = size / (float)nblocks;
+  block_size_ewma = block_size_ewma > 0.0f ? block_size_ewma + PEER_MODEL_EWMA_ALPHA * (block_size - block_size_ewma) : block_size;
+
+  auto i = peer_models.find(connection_id);
+  if (i == peer_models.end())
+  {
+    peer_models.insert(std::make_pair(connection_id, peer_model{size / seconds, 0.0f, 1, (double)size, seconds, (double)size * size, (double)size * seconds}));
+    return;
+  }
+  peer_model &model = i->second;
+  const double alpha = PEER_MODEL_EWMA_ALPHA;
+  model.mean_size += alpha * (size - model.mean_size);
+  model.mean_seconds += alpha * (seconds - model.mean_seconds);
+  model.mean_size2 += alpha * ((double)size * size - model.mean_size2);
+  model.mean_size_seconds += alpha * ((double)size * seconds - model.mean_size_seconds);
+  ++model.samples;
+
+  // with spans of varied sizes, the fit tells transfer time from fixed
+  // latency; without, all we can say is the average rate
+  const double var = model.mean_size2 - model.mean_size * model.mean_size;
+  const double cov = model.mean_size_seconds - model.mean_size * model.mean_seconds;
+  double slope = 0.0, latency = 0.0;
+  if (var > 1e-4 * model.mean_size * model.mean_size && cov > 0.0)
+  {
+    slope = cov / var;
+    latency = model.mean_seconds - slope * model.mean_size;
+  }
+  if (slope <= 0.0 || latency < 0.0)
+  {
+    slope = model.mean_seconds / model.mean_size;
+    latency = 0.0;
+  }
+  model.rate = 1.0 / slope;
+  model.latency = latency;
+  MTRACE("Peer model for " << connection_id << ": " << model.rate / 1024 << " kB/s, " << model.latency << " s latency after " << model.samples << " spans");
+}
+
+bool block_queue::get_peer_model(const boost::uuids::uuid &connection_id, peer_model &model) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  auto i = peer_models.find(connection_id);
+  if (i == peer_models.end())
+    return false;
+  model = i->second;
+  return true;
+}
+
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t max_blocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  auto i = peer_models.find(connection_id);
+  if (i == peer_models.end())
+    return max_blocks; // not measured yet, give it a full span to measure
+  float best_rate = 0.0f;
+  for (const auto &m: peer_models)
+    best_rate = std::max(best_rate, m.second.rate);
+  if (best_rate <= 0.0f)
+    return max_blocks;
+  const uint64_t min_blocks = std::max<uint64_t>(1, max_blocks / MIN_SPAN_SIZE_DIVISOR);
+  const uint64_t nblocks = std::ceil(max_blocks * i->second.rate / best_rate);
+  return std::min(max_blocks, std::max(min_blocks, nblocks));
+}
+
+float block_queue::get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  auto i = peer_models.find(connection_id);
+  if (i == peer_models.end() || i->second.rate <= 0.0f || block_size_ewma <= 0.0f)
+    return -1.0f;
+  return i->second.latency + nblocks * block_size_ewma / i->second.rate;
+}
+
+size_t block_queue::get_out_of_order_data_size(uint64_t blockchain_height) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  size_t size = 0;
+  uint64_t expected = blockchain_height;
+  bool in_order = true;
+  for (const auto &span: blocks)
+  {
+    if (span.start_block_height + span.nblocks <= blockchain_height)
+      continue;
+    if (in_order && span.start_block_height <= expected && !span.blocks.empty())
+    {
+      expected = std::max(expected, span.start_block_height + span.nblocks);
+      continue;
+    }
+    in_order = false;
+    size += span.size;
+  }
+  return size;
+}
+
 bool block_queue::foreach(std::function<bool(const span&)> f) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
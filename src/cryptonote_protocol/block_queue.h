@@ -33,6 +33,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <set>
 #include <unordered_set>
 #include <boost/thread/recursive_mutex.hpp>
@@ -68,6 +69,17 @@ namespace cryptonote
     };
     typedef std::set<span> block_map;
 
+    // what we have measured of a peer's span downloads
+    struct peer_model
+    {
+      float rate; // bytes per second
+      float latency; // seconds, the part of a response time that does not depend on its size
+      uint64_t samples;
+      // EWMAs of span size, response time and their products, rate and
+      // latency are the least squares fit of time against size over them
+      double mean_size, mean_seconds, mean_size2, mean_size_seconds;
+    };
+
   public:
     void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
     void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time = boost::date_time::min_date_time);
@@ -97,6 +109,11 @@ namespace cryptonote
     bool foreach(std::function<bool(const span&)> f) const;
     bool requested(const crypto::hash &hash) const;
     bool have(const crypto::hash &hash) const;
+    void update_peer_model(const boost::uuids::uuid &connection_id, uint64_t nblocks, size_t size, float seconds);
+    bool get_peer_model(const boost::uuids::uuid &connection_id, peer_model &model) const;
+    uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t max_blocks) const;
+    float get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const;
+    size_t get_out_of_order_data_size(uint64_t blockchain_height) const;
 
   private:
     void erase_block(block_map::iterator j);
@@ -107,5 +124,7 @@ namespace cryptonote
     mutable boost::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+    std::map<boost::uuids::uuid, peer_model> peer_models;
+    float block_size_ewma = 0.0f;
   };
 }
@@ -0,0 +1,130 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <unordered_map>
+#include "int-util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "compact_block.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "cn.compact_block"
+
+namespace cryptonote
+{
+
+uint64_t compact_block_short_id(uint64_t salt, const crypto::hash &block_hash, const crypto::hash &tx_hash)
+{
+  char data[sizeof(salt) + sizeof(block_hash) + sizeof(tx_hash)];
+  salt = SWAP64LE(salt);
+  memcpy(data, &salt, sizeof(salt));
+  memcpy(data + sizeof(salt), &block_hash, sizeof(block_hash));
+  memcpy(data + sizeof(salt) + sizeof(block_hash), &tx_hash, sizeof(tx_hash));
+  const crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+  uint64_t id = 0;
+  for (size_t n = 0; n < COMPACT_BLOCK_SHORT_ID_SIZE; ++n)
+    id |= (uint64_t)(uint8_t)h.data[n] << (8 * n);
+  return id;
+}
+
+bool make_compact_block(const block &b, const std::vector<blobdata> &txs, const std::set<size_t> &prefill, uint64_t salt, NOTIFY_NEW_COMPACT_BLOCK::request &req)
+{
+  CHECK_AND_ASSERT_MES(prefill.empty() || *prefill.rbegin() < b.tx_hashes.size(), false, "Prefill index out of range");
+  req.block_hash = get_block_hash(b);
+  block header = b;
+  header.tx_hashes.clear();
+  req.header = block_to_blob(header);
+  req.short_id_salt = salt;
+  req.short_ids.clear();
+  req.short_ids.reserve((b.tx_hashes.size() - std::min(b.tx_hashes.size(), prefill.size())) * COMPACT_BLOCK_SHORT_ID_SIZE);
+  req.prefilled.clear();
+  for (size_t n = 0; n < b.tx_hashes.size(); ++n)
+  {
+    if (prefill.find(n) != prefill.end())
+    {
+      CHECK_AND_ASSERT_MES(n < txs.size(), false, "Prefilled tx " << n << " not given");
+      req.prefilled.push_back({n, txs[n]});
+      continue;
+    }
+    const uint64_t id = compact_block_short_id(salt, req.block_hash, b.tx_hashes[n]);
+    for (size_t i = 0; i < COMPACT_BLOCK_SHORT_ID_SIZE; ++i)
+      req.short_ids.push_back((char)(id >> (8 * i)));
+  }
+  return true;
+}
+
+bool reconstruct_compact_block(const NOTIFY_NEW_COMPACT_BLOCK::request &req, const std::vector<crypto::hash> &candidates, block &b, std::vector<uint64_t> &missing)
+{
+  CHECK_AND_ASSERT_MES(req.short_ids.size() % COMPACT_BLOCK_SHORT_ID_SIZE == 0, false, "Short ids are not a whole number of ids");
+  CHECK_AND_ASSERT_MES(parse_and_validate_block_from_blob(req.header, b), false, "Failed to parse compact block header");
+  CHECK_AND_ASSERT_MES(b.tx_hashes.empty(), false, "Compact block header has tx hashes");
+
+  const size_t n_txes = req.short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE + req.prefilled.size();
+  b.tx_hashes.assign(n_txes, crypto::null_hash);
+  std::vector<bool> prefilled(n_txes, false);
+  for (size_t n = 0; n < req.prefilled.size(); ++n)
+  {
+    const uint64_t index = req.prefilled[n].index;
+    CHECK_AND_ASSERT_MES(index < n_txes && (n == 0 || index > req.prefilled[n - 1].index), false, "Bad prefilled tx index " << index);
+    transaction tx;
+    crypto::hash prefix_hash;
+    CHECK_AND_ASSERT_MES(parse_and_validate_tx_from_blob(req.prefilled[n].blob, tx, b.tx_hashes[index], prefix_hash), false, "Failed to parse prefilled tx");
+    prefilled[index] = true;
+  }
+
+  // short id -> candidate, null hash for ids shared by several candidates
+  std::unordered_map<uint64_t, crypto::hash> index;
+  index.reserve(candidates.size());
+  for (const crypto::hash &h: candidates)
+  {
+    auto r = index.insert(std::make_pair(compact_block_short_id(req.short_id_salt, req.block_hash, h), h));
+    if (!r.second && r.first->second != h)
+      r.first->second = crypto::null_hash;
+  }
+
+  missing.clear();
+  const uint8_t *ids = reinterpret_cast<const uint8_t*>(req.short_ids.data());
+  for (size_t n = 0; n < n_txes; ++n)
+  {
+    if (prefilled[n])
+      continue;
+    uint64_t id = 0;
+    for (size_t i = 0; i < COMPACT_BLOCK_SHORT_ID_SIZE; ++i)
+      id |= (uint64_t)ids[i] << (8 * i);
+    ids += COMPACT_BLOCK_SHORT_ID_SIZE;
+    auto i = index.find(id);
+    if (i == index.end() || i->second == crypto::null_hash)
+      missing.push_back(n);
+    else
+      b.tx_hashes[n] = i->second;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <set>
+#include <vector>
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_protocol_defs.h"
+
+namespace cryptonote
+{
+  //! bytes of a tx's short id in NOTIFY_NEW_COMPACT_BLOCK
+  constexpr size_t COMPACT_BLOCK_SHORT_ID_SIZE = 6;
+
+  /**
+   * @brief gets the short id of a tx relayed in a compact block
+   *
+   * The low COMPACT_BLOCK_SHORT_ID_SIZE bytes of H(salt || block hash || tx hash).
+   * The salt is picked per relay, so txes cannot be ground in advance to
+   * collide with ones likely to be in the block.
+   */
+  uint64_t compact_block_short_id(uint64_t salt, const crypto::hash &block_hash, const crypto::hash &tx_hash);
+
+  /**
+   * @brief builds a compact block announcement
+   *
+   * @param b the block
+   * @param txs the block's tx blobs, in block order; only those listed in prefill are read
+   * @param prefill indices of the txes to send in full
+   * @param salt short id salt
+   * @param req return-by-reference the message, current_blockchain_height is left to the caller
+   *
+   * @return false if a prefill index is out of range
+   */
+  bool make_compact_block(const block &b, const std::vector<blobdata> &txs, const std::set<size_t> &prefill, uint64_t salt, NOTIFY_NEW_COMPACT_BLOCK::request &req);
+
+  /**
+   * @brief rebuilds a block from a compact block announcement
+   *
+   * Prefilled txes are hashed, and short ids are looked up among the given
+   * candidate tx hashes.  A short id matching no candidate, or more than
+   * one, leaves a null hash at its index and the index in missing.
+   *
+   * @param req the message
+   * @param candidates tx hashes the block's txes might be among, typically the pool's
+   * @param b return-by-reference the block
+   * @param missing return-by-reference indices of the txes not resolved
+   *
+   * @return false if the message is malformed
+   */
+  bool reconstruct_compact_block(const NOTIFY_NEW_COMPACT_BLOCK::request &req, const std::vector<crypto::hash> &candidates, block &b, std::vector<uint64_t> &missing);
+}
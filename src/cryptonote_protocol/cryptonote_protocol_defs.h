@@ -347,4 +347,109 @@ struct request
       END_KV_SERIALIZE_MAP()
     };
   };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct prefilled_tx
+    {
+      uint64_t index;
+      blobdata blob;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(index)
+        KV_SERIALIZE(blob)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request
+    {
+      crypto::hash block_hash;
+      blobdata header; // the block, miner tx included, with an empty tx hash list
+      uint64_t short_id_salt;
+      std::string short_ids; // COMPACT_BLOCK_SHORT_ID_SIZE bytes for each tx not prefilled, in block order
+      std::vector<prefilled_tx> prefilled; // by ascending index
+      uint64_t current_blockchain_height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+        KV_SERIALIZE(header)
+        KV_SERIALIZE(short_id_salt)
+        KV_SERIALIZE(short_ids)
+        KV_SERIALIZE(prefilled)
+        KV_SERIALIZE(current_blockchain_height)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_TX_ANNOUNCE
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+
+    struct request
+    {
+      std::vector<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 14;
+
+    struct request
+    {
+      std::vector<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_UPTIME_PROOFS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 15;
+
+    struct request
+    {
+      std::vector<NOTIFY_UPTIME_PROOF::request> proofs;
+      bool sync; // answers NOTIFY_REQUEST_UPTIME_PROOFS: may be older, not to be relayed
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(proofs)
+        KV_SERIALIZE(sync)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_UPTIME_PROOFS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 16;
+
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+  };
 }
@@ -35,6 +35,9 @@
 #pragma once
 
 #include <boost/program_options/variables_map.hpp>
+#include <deque>
+#include <map>
+#include <set>
 #include <string>
 #include <unordered_map>
 
@@ -44,7 +47,9 @@
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
 #include "block_queue.h"
+#include "rolling_bloom_filter.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_basic/cryptonote_stat_info.h"
 #include <boost/circular_buffer.hpp>
@@ -66,7 +71,6 @@ namespace cryptonote
       cryptonote_protocol_handler_base();
       virtual ~cryptonote_protocol_handler_base();
       void handler_request_blocks_history(std::list<crypto::hash>& ids); // before asking for list of objects, we can change the list still
-      void handler_response_blocks_now(size_t packet_size);
 
       virtual double get_avg_block_size() = 0;
       virtual double estimate_one_block_size() noexcept; // for estimating size of blocks to download
@@ -94,6 +98,11 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_DEREGISTER_VOTE, &cryptonote_protocol_handler::handle_notify_new_deregister_vote)
       HANDLE_NOTIFY_T2(NOTIFY_UPTIME_PROOF, &cryptonote_protocol_handler::handle_uptime_proof)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_ANNOUNCE, &cryptonote_protocol_handler::handle_notify_tx_announce)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TX, &cryptonote_protocol_handler::handle_request_tx)
+      HANDLE_NOTIFY_T2(NOTIFY_UPTIME_PROOFS, &cryptonote_protocol_handler::handle_uptime_proofs)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_UPTIME_PROOFS, &cryptonote_protocol_handler::handle_request_uptime_proofs)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -129,13 +138,18 @@ namespace cryptonote
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_deregister_vote(int command, NOTIFY_NEW_DEREGISTER_VOTE::request& arg, cryptonote_connection_context& context);
     int handle_uptime_proof(int command, NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_notify_tx_announce(int command, NOTIFY_TX_ANNOUNCE::request& arg, cryptonote_connection_context& context);
+    int handle_request_tx(int command, NOTIFY_REQUEST_TX::request& arg, cryptonote_connection_context& context);
+    int handle_uptime_proofs(int command, NOTIFY_UPTIME_PROOFS::request& arg, cryptonote_connection_context& context);
+    int handle_request_uptime_proofs(int command, NOTIFY_REQUEST_UPTIME_PROOFS::request& arg, cryptonote_connection_context& context);
 
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context);
     virtual bool relay_deregister_votes(NOTIFY_NEW_DEREGISTER_VOTE::request& arg, cryptonote_connection_context& exclude_context);
     //----------------- uptime proof ---------------------------------------
-    virtual bool relay_uptime_proof(NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& exclude_context);
+    virtual bool relay_uptime_proofs(std::vector<NOTIFY_UPTIME_PROOF::request>& proofs, const std::vector<boost::uuids::uuid>& sources);
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
     bool should_drop_connection(cryptonote_connection_context& context, uint32_t next_stripe);
@@ -150,6 +164,11 @@ namespace cryptonote
     int try_add_next_blocks(cryptonote_connection_context &context);
     void notify_new_stripe(cryptonote_connection_context &context, uint32_t stripe);
     void skip_unneeded_hashes(cryptonote_connection_context& context, bool check_block_queue) const;
+    void remember_missing_txs(const crypto::hash &block_hash, const std::vector<uint64_t> &indices);
+    void flush_tx_announcements();
+    void request_uptime_proofs();
+    void serve_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context);
+    void serve_queued_objects(const boost::uuids::uuid &connection_id);
 
     t_core& m_core;
 
@@ -169,6 +188,51 @@ namespace cryptonote
     uint64_t m_sync_download_chain_size, m_sync_download_objects_size;
     size_t m_block_download_max_size;
 
+    // indices of the txes we had to fetch for recent blocks: our peers
+    // likely lack them too, so they go in full when we relay the block
+    boost::mutex m_compact_prefill_mutex;
+    std::deque<std::pair<crypto::hash, std::set<size_t>>> m_compact_prefill;
+
+    // announce-then-fetch tx relay: which txes each peer is known to have,
+    // which we announced to it (and so will serve it), the hashes waiting
+    // for its next trickle, and the txes we asked for
+    struct peer_tx_relay
+    {
+      peer_tx_relay(size_t known_capacity, double known_false_positive_rate): known(known_capacity, known_false_positive_rate), announced(known_capacity, known_false_positive_rate), requested(0), inbound(false) {}
+
+      rolling_bloom_filter known;
+      rolling_bloom_filter announced;
+      std::vector<crypto::hash> pending;
+      boost::posix_time::ptime next_trickle;
+      size_t requested; // entries of m_tx_requests waiting on this peer
+      bool inbound;
+    };
+    struct tx_request
+    {
+      boost::uuids::uuid peer;
+      boost::posix_time::ptime time;
+      std::vector<boost::uuids::uuid> alternates; // other announcers, asked in turn on timeout
+    };
+    peer_tx_relay &get_peer_tx_relay(const boost::uuids::uuid &id, bool inbound);
+    void schedule_tx_trickle(peer_tx_relay &relay, const boost::posix_time::ptime &now);
+    void release_tx_request(const tx_request &r);
+    boost::mutex m_tx_relay_mutex;
+    std::map<boost::uuids::uuid, peer_tx_relay> m_tx_relay;
+    std::unordered_map<crypto::hash, tx_request> m_tx_requests;
+
+    // uptime proofs and deregister votes each peer is known to have, so
+    // batches only carry what it hasn't seen; keyed by signature hash
+    rolling_bloom_filter &get_peer_known_votes(const boost::uuids::uuid &id);
+    boost::mutex m_vote_relay_mutex;
+    std::map<boost::uuids::uuid, rolling_bloom_filter> m_vote_relay;
+    std::atomic<unsigned int> m_uptime_proof_syncs;
+
+    // NOTIFY_REQUEST_GET_OBJECTS waiting to be served on the threadpool, per
+    // peer; a peer has an entry while a job works through its requests in order
+    boost::mutex m_objects_serving_mutex;
+    std::map<boost::uuids::uuid, std::deque<NOTIFY_REQUEST_GET_OBJECTS::request>> m_objects_serving;
+    tools::threadpool::waiter m_objects_serving_waiter;
+
     boost::mutex m_buffer_mutex;
     double get_avg_block_size();
     boost::circular_buffer<size_t> m_avg_buffer = boost::circular_buffer<size_t>(10);
@@ -179,7 +243,6 @@ namespace cryptonote
         LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(context) << "] post " << typeid(t_parameter).name() << " -->");
         std::string blob;
         epee::serialization::store_t_to_binary(arg, blob);
-        //handler_response_blocks_now(blob.size()); // XXX
         return m_p2p->invoke_notify_to_peer(t_parameter::ID, epee::strspan<uint8_t>(blob), context);
       }
 
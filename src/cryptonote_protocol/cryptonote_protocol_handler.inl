@@ -39,11 +39,14 @@
 #include <boost/interprocess/detail/atomic.hpp>
 #include <list>
 #include <ctime>
+#include <cmath>
+#include <tuple>
 
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "profile_tools.h"
 #include "net/network_throttle-detail.hpp"
 #include "common/pruning.h"
+#include "compact_block.h"
 
 #undef ANTD_DEFAULT_LOG_CATEGORY
 #define ANTD_DEFAULT_LOG_CATEGORY "net.cn"
@@ -61,6 +64,25 @@
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000) // microseconds
 #define DROP_ON_SYNC_WEDGE_THRESHOLD (30 * 1000000000ull) // nanoseconds
 #define LAST_ACTIVITY_STALL_THRESHOLD (2.0f) // seconds
+#define BLOCK_QUEUE_OUT_OF_ORDER_SIZE_DIVISOR 2 // share of the block queue size threshold that may sit behind a gap
+#define RACE_NEXT_SPAN_OVERDUE_FACTOR (2.0f) // holder took this many times its expected time
+#define RACE_NEXT_SPAN_SPEEDUP_FACTOR (2.0f) // or we would finish this many times sooner than it
+#define COMPACT_PREFILL_BLOCKS 16 // recent blocks we remember fetched txes for
+#define COMPACT_BLOCK_MAX_BEHIND 10 // blocks below our top a compact block may sit before we ignore it
+#define TX_TRICKLE_OUTBOUND_MEAN (2 * 1000000) // microseconds
+#define TX_TRICKLE_INBOUND_MEAN (5 * 1000000) // microseconds
+#define TX_ANNOUNCE_BATCH_MAX 1000 // hashes per announce or request message
+#define TX_REQUEST_TIMEOUT (30 * 1000000) // microseconds
+#define TX_REQUEST_ALTERNATES_MAX 4
+#define TX_REQUESTS_IN_FLIGHT_MAX 50000
+#define TX_REQUESTS_IN_FLIGHT_PER_PEER_MAX 2000 // so one peer can't take up all of the above
+#define PEER_KNOWN_TXES 10000
+#define PEER_KNOWN_TXES_FALSE_POSITIVE_RATE (0.00001)
+#define PEER_KNOWN_VOTES 20000 // uptime proofs and deregister votes
+#define PEER_KNOWN_VOTES_FALSE_POSITIVE_RATE (0.00001)
+#define UPTIME_PROOF_BATCH_MAX 10000 // proofs per NOTIFY_UPTIME_PROOFS message
+#define UPTIME_PROOF_SYNC_PEERS 2 // peers we ask for their proofs once synced
+#define OBJECTS_QUEUED_PER_PEER_MAX 8 // requests from one peer waiting to be served off its network thread
 
 namespace cryptonote
 {
@@ -73,7 +95,8 @@ namespace cryptonote
                                                                                                               m_p2p(p_net_layout),
                                                                                                               m_syncronized_connections_count(0),
                                                                                                               m_synchronized(offline),
-                                                                                                              m_stopping(false)
+                                                                                                              m_stopping(false),
+                                                                                                              m_uptime_proof_syncs(0)
 
   {
     if(!m_p2p)
@@ -96,12 +119,17 @@ namespace cryptonote
 
     m_block_download_max_size = command_line::get_arg(vm, cryptonote::arg_block_download_max_size);
 
+    // under an upload limit, tx and uptime proof gossip yields to blocks
+    for (int command: {NOTIFY_NEW_TRANSACTIONS::ID, NOTIFY_TX_ANNOUNCE::ID, NOTIFY_REQUEST_TX::ID, NOTIFY_UPTIME_PROOF::ID, NOTIFY_UPTIME_PROOFS::ID})
+      epee::net_utils::set_command_traffic_class(command, epee::net_utils::traffic_class::gossip);
+
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::deinit()
   {
+    m_objects_serving_waiter.wait(NULL);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -419,6 +447,7 @@ namespace cryptonote
     template<class t_core>
     int t_cryptonote_protocol_handler<t_core>::handle_notify_new_block(int command, NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_notify_new_block);
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_BLOCK (" << arg.b.txs.size() << " txes)");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
@@ -482,6 +511,7 @@ namespace cryptonote
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_notify_new_fluffy_block);
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_FLUFFY_BLOCK (height " << arg.current_blockchain_height << ", " << arg.b.txs.size() << " txes)");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
@@ -693,6 +723,7 @@ namespace cryptonote
         NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
         missing_tx_req.block_hash = get_block_hash(new_block);
         missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+        remember_missing_txs(missing_tx_req.block_hash, need_tx_indices);
         missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
         
         m_core.resume_mine();
@@ -765,21 +796,229 @@ namespace cryptonote
         
     return 1;
   }  
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    PERF_TIMER(handle_notify_new_compact_block);
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK (height " << arg.current_blockchain_height << ", " << arg.short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE
+        << " short ids, " << arg.prefilled.size() << " prefilled txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received new compact block while syncing, ignored");
+      return 1;
+    }
+
+    // cheap checks first: hashing the pool and matching short ids is the
+    // expensive part, and is wasted on a block we have or can't attach
+    if (m_core.have_block(arg.block_hash))
+    {
+      LOG_DEBUG_CC(context, "Received compact block " << arg.block_hash << " we already have, ignored");
+      return 1;
+    }
+    const uint64_t our_height = m_core.get_current_blockchain_height();
+    if (arg.current_blockchain_height + COMPACT_BLOCK_MAX_BEHIND < our_height)
+    {
+      LOG_DEBUG_CC(context, "Received stale compact block at height " << arg.current_blockchain_height << ", ours " << our_height << ", ignored");
+      return 1;
+    }
+    if (arg.current_blockchain_height > our_height + 1)
+    {
+      // it would only be an orphan: catch up with the sender instead
+      context.m_needed_objects.clear();
+      context.m_state = cryptonote_connection_context::state_synchronizing;
+      NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+      m_core.get_short_chain_history(r.block_ids);
+      handler_request_blocks_history( r.block_ids );
+      MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+      MLOG_PEER_STATE("requesting chain");
+      return 1;
+    }
+
+    std::vector<crypto::hash> pool_txids;
+    m_core.get_pool_transaction_hashes(pool_txids);
+    block b;
+    std::vector<uint64_t> missing;
+    if (!reconstruct_compact_block(arg, pool_txids, b, missing))
+    {
+      LOG_ERROR_CCONTEXT("sent bad NOTIFY_NEW_COMPACT_BLOCK, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    if (missing.empty() && get_block_hash(b) != arg.block_hash)
+    {
+      // a short id matched the wrong pool tx, no telling which one
+      MDEBUG(context << " compact block " << arg.block_hash << " reconstructed with the wrong txes, asking for all of them");
+      size_t prefilled = 0;
+      for (size_t n = 0; n < b.tx_hashes.size(); ++n)
+      {
+        if (prefilled < arg.prefilled.size() && arg.prefilled[prefilled].index == n)
+          ++prefilled;
+        else
+          missing.push_back(n);
+      }
+    }
+
+    // what the sender thought we'd lack, our own peers probably lack too
+    std::vector<uint64_t> prefilled_indices;
+    NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
+    fluffy_arg.current_blockchain_height = arg.current_blockchain_height;
+    fluffy_arg.b.txs.reserve(arg.prefilled.size());
+    for (auto &tx: arg.prefilled)
+    {
+      prefilled_indices.push_back(tx.index);
+      fluffy_arg.b.txs.push_back(std::move(tx.blob));
+    }
+    if (!prefilled_indices.empty())
+      remember_missing_txs(arg.block_hash, prefilled_indices);
+
+    // all there: carry on as a fluffy block with the prefilled txes attached
+    if (missing.empty())
+    {
+      fluffy_arg.b.block = block_to_blob(b);
+      return handle_notify_new_fluffy_block(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy_arg, context);
+    }
+
+    // otherwise pool the prefilled txes now, and ask for the rest: the
+    // answer is a fluffy block with just those
+    for (const auto &tx_blob: fluffy_arg.b.txs)
+    {
+      cryptonote::transaction tx;
+      crypto::hash tx_hash, tx_prefix_hash;
+      if (!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash) || m_core.pool_has_tx(tx_hash))
+        continue;
+      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if(!m_core.handle_incoming_tx(tx_blob, tvc, true, true, false) || tvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L1("Compact block tx verification failed, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+    }
+
+    MDEBUG("We are missing " << missing.size() << " txes for compact block " << arg.block_hash);
+    remember_missing_txs(arg.block_hash, missing);
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(missing);
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size() );
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::remember_missing_txs(const crypto::hash &block_hash, const std::vector<uint64_t> &indices)
+  {
+    boost::unique_lock<boost::mutex> lock(m_compact_prefill_mutex);
+    for (auto &e: m_compact_prefill)
+    {
+      if (e.first == block_hash)
+      {
+        e.second.insert(indices.begin(), indices.end());
+        return;
+      }
+    }
+    m_compact_prefill.emplace_back(block_hash, std::set<size_t>(indices.begin(), indices.end()));
+    while (m_compact_prefill.size() > COMPACT_PREFILL_BLOCKS)
+      m_compact_prefill.pop_front();
+  }
   //------------------------------------------------------------------------------------------------------------------------  
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_uptime_proof(int command, NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_uptime_proof);
     MLOG_P2P_MESSAGE("Received NOTIFY_UPTIME_PROOF");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
-    if (m_core.handle_uptime_proof(arg))
-      relay_uptime_proof(arg, context);
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      get_peer_known_votes(context.m_connection_id).insert(crypto::cn_fast_hash(&arg.sig, sizeof(arg.sig)));
+    }
+    // NOTE: Verified in batches by the core, which relays the proof afterwards
+    m_core.handle_uptime_proof(arg, false, context.m_connection_id);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_uptime_proofs(int command, NOTIFY_UPTIME_PROOFS::request& arg, cryptonote_connection_context& context)
+  {
+    PERF_TIMER(handle_uptime_proofs);
+    MLOG_P2P_MESSAGE("Received NOTIFY_UPTIME_PROOFS (" << arg.proofs.size() << " proofs" << (arg.sync ? ", sync" : "") << ")");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if (arg.proofs.size() > UPTIME_PROOF_BATCH_MAX)
+    {
+      LOG_ERROR_CCONTEXT("Too many uptime proofs in NOTIFY_UPTIME_PROOFS (" << arg.proofs.size() << "), dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    if (arg.sync)
+    {
+      if (!context.m_uptime_proofs_pending)
+      {
+        LOG_DEBUG_CC(context, "Received uptime proofs we did not ask for, ignored");
+        return 1;
+      }
+      context.m_uptime_proofs_pending = false;
+    }
+
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      rolling_bloom_filter &known = get_peer_known_votes(context.m_connection_id);
+      for (const NOTIFY_UPTIME_PROOF::request &proof: arg.proofs)
+        known.insert(crypto::cn_fast_hash(&proof.sig, sizeof(proof.sig)));
+    }
+
+    // NOTE: Verified in batches by the core, which relays the fresh ones afterwards
+    for (const NOTIFY_UPTIME_PROOF::request &proof: arg.proofs)
+      m_core.handle_uptime_proof(proof, arg.sync, context.m_connection_id);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_uptime_proofs(int command, NOTIFY_REQUEST_UPTIME_PROOFS::request& arg, cryptonote_connection_context& context)
+  {
+    PERF_TIMER(handle_request_uptime_proofs);
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_UPTIME_PROOFS");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if (context.m_uptime_proofs_sent)
+    {
+      LOG_DEBUG_CC(context, "Peer asked for our uptime proofs again, ignored");
+      return 1;
+    }
+    context.m_uptime_proofs_sent = true;
+
+    NOTIFY_UPTIME_PROOFS::request rsp;
+    rsp.proofs = m_core.get_uptime_proofs();
+    rsp.sync = true;
+    if (rsp.proofs.size() > UPTIME_PROOF_BATCH_MAX)
+      rsp.proofs.resize(UPTIME_PROOF_BATCH_MAX);
+
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      rolling_bloom_filter &known = get_peer_known_votes(context.m_connection_id);
+      for (const NOTIFY_UPTIME_PROOF::request &proof: rsp.proofs)
+        known.insert(crypto::cn_fast_hash(&proof.sig, sizeof(proof.sig)));
+    }
+
+    MLOG_P2P_MESSAGE("-->>NOTIFY_UPTIME_PROOFS: proofs.size()=" << rsp.proofs.size());
+    post_notify<NOTIFY_UPTIME_PROOFS>(rsp, context);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------  
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_request_fluffy_missing_tx);
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_FLUFFY_MISSING_TX (" << arg.missing_tx_indices.size() << " txes), block hash " << arg.block_hash);
     
     std::vector<std::pair<cryptonote::blobdata, block>> local_blocks;
@@ -856,6 +1095,7 @@ namespace cryptonote
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_deregister_vote(int command, NOTIFY_NEW_DEREGISTER_VOTE::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_notify_new_deregister_vote);
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_DEREGISTER_VOTE (" << arg.votes.size() << " txes)");
 
     if(context.m_state != cryptonote_connection_context::state_normal)
@@ -867,6 +1107,13 @@ namespace cryptonote
       return 1;
     }
 
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      rolling_bloom_filter &known = get_peer_known_votes(context.m_connection_id);
+      for (const full_nodes::deregister_vote &vote: arg.votes)
+        known.insert(crypto::cn_fast_hash(&vote, sizeof(vote)));
+    }
+
     for(auto it = arg.votes.begin(); it != arg.votes.end();)
     {
       cryptonote::vote_verification_context vvc = {};
@@ -900,6 +1147,7 @@ namespace cryptonote
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_notify_new_transactions);
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
@@ -932,7 +1180,6 @@ namespace cryptonote
 
     if(arg.txs.size())
     {
-      //TODO: add announce usage here
       relay_transactions(arg, context);
     }
 
@@ -940,22 +1187,202 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_tx_announce(int command, NOTIFY_TX_ANNOUNCE::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_ANNOUNCE (" << arg.txs.size() << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    // same as for full txes, we don't need them while syncing
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received tx announce while syncing, ignored");
+      return 1;
+    }
+
+    if (arg.txs.size() > TX_ANNOUNCE_BATCH_MAX)
+    {
+      LOG_ERROR_CCONTEXT("Too many txes announced: " << arg.txs.size() << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::vector<crypto::hash> wanted;
+    wanted.reserve(arg.txs.size());
+    for (const crypto::hash &tx_hash: arg.txs)
+      if (!m_core.pool_has_tx(tx_hash))
+        wanted.push_back(tx_hash);
+
+    NOTIFY_REQUEST_TX::request req;
+    {
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+      peer_tx_relay &relay = get_peer_tx_relay(context.m_connection_id, context.m_is_income);
+      for (const crypto::hash &tx_hash: arg.txs)
+        relay.known.insert(tx_hash);
+      for (const crypto::hash &tx_hash: wanted)
+      {
+        auto i = m_tx_requests.find(tx_hash);
+        if (i != m_tx_requests.end())
+        {
+          if (i->second.peer != context.m_connection_id && i->second.alternates.size() < TX_REQUEST_ALTERNATES_MAX &&
+              std::find(i->second.alternates.begin(), i->second.alternates.end(), context.m_connection_id) == i->second.alternates.end())
+            i->second.alternates.push_back(context.m_connection_id);
+          continue;
+        }
+        if (m_tx_requests.size() >= TX_REQUESTS_IN_FLIGHT_MAX || relay.requested >= TX_REQUESTS_IN_FLIGHT_PER_PEER_MAX)
+        {
+          MDEBUG("Too many txes requested already, ignoring the rest of this announce");
+          break;
+        }
+        tx_request &r = m_tx_requests[tx_hash];
+        r.peer = context.m_connection_id;
+        r.time = now;
+        ++relay.requested;
+        req.txs.push_back(tx_hash);
+      }
+    }
+
+    if (!req.txs.empty())
+    {
+      MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_TX: txs.size()=" << req.txs.size());
+      post_notify<NOTIFY_REQUEST_TX>(req, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx(int command, NOTIFY_REQUEST_TX::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX (" << arg.txs.size() << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if (arg.txs.size() > TX_ANNOUNCE_BATCH_MAX)
+    {
+      LOG_ERROR_CCONTEXT("Too many txes requested: " << arg.txs.size() << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // only serve what we announced to this peer, so peers can't probe our
+    // pool for txes we haven't relayed (yet) or never will; hashes the peer
+    // announced to us only say it has them, and are not enough
+    std::vector<crypto::hash> announced;
+    announced.reserve(arg.txs.size());
+    {
+      boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+      auto i = m_tx_relay.find(context.m_connection_id);
+      if (i != m_tx_relay.end())
+        for (const crypto::hash &tx_hash: arg.txs)
+          if (i->second.announced.contains(tx_hash))
+            announced.push_back(tx_hash);
+    }
+
+    NOTIFY_NEW_TRANSACTIONS::request rsp;
+    for (const crypto::hash &tx_hash: announced)
+    {
+      cryptonote::blobdata tx_blob;
+      if (m_core.get_pool_transaction(tx_hash, tx_blob))
+        rsp.txs.push_back(std::move(tx_blob));
+    }
+
+    if (arg.txs.size() != rsp.txs.size())
+      LOG_DEBUG_CC(context, "Serving " << rsp.txs.size() << "/" << arg.txs.size() << " requested txes");
+    if (!rsp.txs.empty())
+    {
+      MLOG_P2P_MESSAGE("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << rsp.txs.size());
+      post_notify<NOTIFY_NEW_TRANSACTIONS>(rsp, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_GET_OBJECTS (" << arg.blocks.size() << " blocks, " << arg.txs.size() << " txes)");
+
+    // the lookups for a full span take a while, so they are done on the threadpool
+    // and leave the network thread to other peers; one job per peer serves its
+    // requests one after the other, so the responses keep the order they were asked in.
+    // A pool of one has no thread to spare, so they are served here instead
+    const bool inline_serving = tools::threadpool::getInstance().get_max_concurrency() < 2;
+    {
+      boost::unique_lock<boost::mutex> lock(m_objects_serving_mutex);
+      if (inline_serving && m_objects_serving.find(context.m_connection_id) == m_objects_serving.end())
+      {
+        lock.unlock();
+        serve_objects(arg, context);
+        return 1;
+      }
+      auto queue = m_objects_serving.emplace(context.m_connection_id, std::deque<NOTIFY_REQUEST_GET_OBJECTS::request>());
+      if (queue.first->second.size() >= OBJECTS_QUEUED_PER_PEER_MAX)
+      {
+        lock.unlock();
+        LOG_ERROR_CCONTEXT("too many NOTIFY_REQUEST_GET_OBJECTS waiting, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      queue.first->second.push_back(std::move(arg));
+      if (!queue.second)
+        return 1; // the job serving this peer gets to it
+    }
+
+    const boost::uuids::uuid connection_id = context.m_connection_id;
+    tools::threadpool::getInstance().submit(&m_objects_serving_waiter, [this, connection_id]() {
+      serve_queued_objects(connection_id);
+    });
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::serve_queued_objects(const boost::uuids::uuid &connection_id)
+  {
+    while (true)
+    {
+      NOTIFY_REQUEST_GET_OBJECTS::request arg;
+      {
+        boost::unique_lock<boost::mutex> lock(m_objects_serving_mutex);
+        auto queue = m_objects_serving.find(connection_id);
+        if (queue == m_objects_serving.end())
+          return;
+        if (queue->second.empty() || m_stopping)
+        {
+          m_objects_serving.erase(queue);
+          return;
+        }
+        arg = std::move(queue->second.front());
+        queue->second.pop_front();
+      }
+
+      // serve it through the live connection, not a copy of its context
+      const bool found = m_p2p->for_connection(connection_id, [&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+        serve_objects(arg, context);
+        return true;
+      });
+      if (!found)
+      {
+        boost::unique_lock<boost::mutex> lock(m_objects_serving_mutex);
+        m_objects_serving.erase(connection_id);
+        return;
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::serve_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
+  {
+    PERF_TIMER(handle_request_get_objects);
     NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
     if(!m_core.handle_get_objects(arg, rsp, context))
     {
       LOG_ERROR_CCONTEXT("failed to handle request NOTIFY_REQUEST_GET_OBJECTS, dropping connection");
       drop_connection(context, false, false);
-      return 1;
+      return;
     }
     MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()=" << rsp.blocks.size() << ", txs.size()=" << rsp.txs.size()
                             << ", rsp.m_current_blockchain_height=" << rsp.current_blockchain_height << ", missed_ids.size()=" << rsp.missed_ids.size());
     post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
-    //handler_response_blocks_now(sizeof(rsp)); // XXX
-    //handler_response_blocks_now(200);
-    return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
 
@@ -976,6 +1403,7 @@ namespace cryptonote
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_response_get_objects);
     MLOG_P2P_MESSAGE("Received NOTIFY_RESPONSE_GET_OBJECTS (" << arg.blocks.size() << " blocks, " << arg.txs.size() << " txes)");
     MLOG_PEER_STATE("received objects");
 
@@ -1099,6 +1527,8 @@ namespace cryptonote
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
       m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      if (!request_time.is_special())
+        m_block_queue.update_peer_model(context.m_connection_id, arg.blocks.size(), size, dt.total_microseconds() / 1e6f);
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
       context.m_last_known_hash = last_block_hash;
@@ -1243,6 +1673,21 @@ namespace cryptonote
 
           m_core.prepare_handle_incoming_blocks(blocks);
 
+          // Hash the PoW of the following span, if we have it already, while
+          // this one is validated and committed
+          {
+            const uint64_t next_height = start_height + blocks.size();
+            std::vector<cryptonote::block_complete_entry> next_blocks;
+            m_block_queue.foreach([next_height, &next_blocks](const cryptonote::block_queue::span &span) {
+              if (span.start_block_height != next_height || span.blocks.empty())
+                return true;
+              next_blocks = span.blocks;
+              return false;
+            });
+            if (!next_blocks.empty())
+              m_core.prefetch_incoming_blocks_longhash(next_blocks, next_height);
+          }
+
           uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
           size_t num_txs = 0;
           for(const block_complete_entry& block_entry: blocks)
@@ -1439,10 +1884,166 @@ skip:
   {
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
     m_standby_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::check_standby_peers, this));
+    flush_tx_announcements();
+    request_uptime_proofs();
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  rolling_bloom_filter &t_cryptonote_protocol_handler<t_core>::get_peer_known_votes(const boost::uuids::uuid &id)
+  {
+    // m_vote_relay_mutex must be held
+    auto i = m_vote_relay.find(id);
+    if (i == m_vote_relay.end())
+      i = m_vote_relay.emplace(std::piecewise_construct, std::forward_as_tuple(id),
+          std::forward_as_tuple(PEER_KNOWN_VOTES, PEER_KNOWN_VOTES_FALSE_POSITIVE_RATE)).first;
+    return i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::request_uptime_proofs()
+  {
+    // once synced, fetch the current proof set from a few outgoing peers
+    // rather than waiting up to an hour for every node to send its next one
+    if (m_uptime_proof_syncs >= UPTIME_PROOF_SYNC_PEERS || !is_synchronized())
+      return;
+
+    std::list<boost::uuids::uuid> peers;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool
+    {
+      if (m_uptime_proof_syncs >= UPTIME_PROOF_SYNC_PEERS)
+        return false;
+      if (!peer_id || context.m_is_income || context.m_uptime_proofs_requested || context.m_state != cryptonote_connection_context::state_normal)
+        return true;
+      if (!(support_flags & P2P_SUPPORT_FLAG_UPTIME_PROOF_BATCHES))
+        return true;
+      context.m_uptime_proofs_requested = true;
+      context.m_uptime_proofs_pending = true;
+      peers.push_back(context.m_connection_id);
+      ++m_uptime_proof_syncs;
+      return true;
+    });
+    if (peers.empty())
+      return;
+
+    MDEBUG("Requesting uptime proofs from " << peers.size() << " peers");
+    NOTIFY_REQUEST_UPTIME_PROOFS::request req;
+    std::string blob;
+    epee::serialization::store_t_to_binary(req, blob);
+    m_p2p->relay_notify_to_list(NOTIFY_REQUEST_UPTIME_PROOFS::ID, epee::strspan<uint8_t>(blob), peers);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  typename t_cryptonote_protocol_handler<t_core>::peer_tx_relay &t_cryptonote_protocol_handler<t_core>::get_peer_tx_relay(const boost::uuids::uuid &id, bool inbound)
+  {
+    // m_tx_relay_mutex must be held
+    auto i = m_tx_relay.find(id);
+    if (i == m_tx_relay.end())
+    {
+      i = m_tx_relay.emplace(std::piecewise_construct, std::forward_as_tuple(id),
+          std::forward_as_tuple(PEER_KNOWN_TXES, PEER_KNOWN_TXES_FALSE_POSITIVE_RATE)).first;
+      i->second.inbound = inbound;
+    }
+    return i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::schedule_tx_trickle(peer_tx_relay &relay, const boost::posix_time::ptime &now)
+  {
+    // poisson timer, so the time a tx reaches each peer does not give away
+    // who had it first; inbound peers wait longer, as they're cheaper to spawn
+    const double mean = relay.inbound ? TX_TRICKLE_INBOUND_MEAN : TX_TRICKLE_OUTBOUND_MEAN;
+    const double u = (crypto::rand<uint64_t>() >> 11) * (1.0 / (1ull << 53));
+    const double delay = std::min(-std::log1p(-u) * mean, 8 * mean);
+    relay.next_trickle = now + boost::posix_time::microseconds((int64_t)delay);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::release_tx_request(const tx_request &r)
+  {
+    // m_tx_relay_mutex must be held
+    auto i = m_tx_relay.find(r.peer);
+    if (i != m_tx_relay.end() && i->second.requested)
+      --i->second.requested;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::flush_tx_announcements()
+  {
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    std::vector<std::pair<boost::uuids::uuid, std::vector<crypto::hash>>> announces, requests;
+    std::vector<crypto::hash> expired;
+
+    {
+      boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+      for (auto &e: m_tx_relay)
+      {
+        peer_tx_relay &relay = e.second;
+        if (relay.pending.empty() || now < relay.next_trickle)
+          continue;
+        for (const crypto::hash &tx_hash: relay.pending)
+          relay.announced.insert(tx_hash);
+        announces.emplace_back(e.first, std::move(relay.pending));
+        relay.pending.clear();
+        schedule_tx_trickle(relay, now);
+      }
+      for (const auto &e: m_tx_requests)
+        if ((now - e.second.time).total_microseconds() > TX_REQUEST_TIMEOUT)
+          expired.push_back(e.first);
+    }
+
+    // don't call into core with our lock held
+    std::vector<bool> received(expired.size());
+    for (size_t n = 0; n < expired.size(); ++n)
+      received[n] = m_core.pool_has_tx(expired[n]);
+
+    if (!expired.empty())
+    {
+      boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+      std::map<boost::uuids::uuid, std::vector<crypto::hash>> retries;
+      for (size_t n = 0; n < expired.size(); ++n)
+      {
+        auto i = m_tx_requests.find(expired[n]);
+        if (i == m_tx_requests.end())
+          continue;
+        tx_request &r = i->second;
+        while (!r.alternates.empty() && !m_tx_relay.count(r.alternates.back()))
+          r.alternates.pop_back();
+        release_tx_request(r);
+        if (received[n] || r.alternates.empty())
+        {
+          m_tx_requests.erase(i);
+          continue;
+        }
+        MDEBUG("Request for tx " << expired[n] << " timed out, asking another peer");
+        r.peer = r.alternates.back();
+        r.alternates.pop_back();
+        r.time = now;
+        ++m_tx_relay.find(r.peer)->second.requested;
+        retries[r.peer].push_back(expired[n]);
+      }
+      for (auto &e: retries)
+        requests.emplace_back(e.first, std::move(e.second));
+    }
+
+    const auto send = [this](int command, const boost::uuids::uuid &peer, const std::vector<crypto::hash> &txs) {
+      for (size_t start = 0; start < txs.size(); start += TX_ANNOUNCE_BATCH_MAX)
+      {
+        NOTIFY_TX_ANNOUNCE::request msg;
+        msg.txs.assign(txs.begin() + start, txs.begin() + std::min<size_t>(txs.size(), start + TX_ANNOUNCE_BATCH_MAX));
+        std::string blob;
+        epee::serialization::store_t_to_binary(msg, blob);
+        m_p2p->relay_notify_to_list(command, epee::strspan<uint8_t>(blob), std::list<boost::uuids::uuid>{peer});
+      }
+    };
+    // NOTIFY_REQUEST_TX has the same layout as NOTIFY_TX_ANNOUNCE
+    for (const auto &e: announces)
+      send(NOTIFY_TX_ANNOUNCE::ID, e.first, e.second);
+    for (const auto &e: requests)
+      send(NOTIFY_REQUEST_TX::ID, e.first, e.second);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::kick_idle_peers()
   {
     MTRACE("Checking for idle peers...");
@@ -1486,6 +2087,7 @@ skip:
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_request_chain);
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_CHAIN (" << arg.block_ids.size() << " blocks");
     NOTIFY_RESPONSE_CHAIN_ENTRY::request r;
     if(!m_core.find_blockchain_supplement(arg.block_ids, r))
@@ -1530,6 +2132,26 @@ skip:
           return true;
         }
 
+        // race the span everyone is waiting on when the peer models say we'd
+        // get it well before its holder does
+        if (standby && connection_id != context.m_connection_id)
+        {
+          std::vector<crypto::hash> next_hashes;
+          boost::uuids::uuid next_connection_id;
+          boost::posix_time::ptime next_time;
+          const uint64_t nblocks = m_block_queue.get_next_span_if_scheduled(next_hashes, next_connection_id, next_time).second;
+          const float holder_time = m_block_queue.get_expected_span_time(connection_id, nblocks);
+          const float our_time = m_block_queue.get_expected_span_time(context.m_connection_id, nblocks);
+          const float elapsed = dt / 1e6f;
+          if (nblocks > 0 && holder_time > 0 && our_time > 0 &&
+              (elapsed > holder_time * RACE_NEXT_SPAN_OVERDUE_FACTOR || holder_time - elapsed > our_time * RACE_NEXT_SPAN_SPEEDUP_FACTOR))
+          {
+            MDEBUG(context << " we should race the next span: held for " << elapsed << " seconds, expected " << holder_time
+                << " from its peer, " << our_time << " from us");
+            return true;
+          }
+        }
+
         // in standby, be ready to double download early since we're idling anyway
         // let the fastest peer trigger first
         long threshold;
@@ -1686,6 +2308,9 @@ skip:
         const uint32_t peer_stripe = tools::get_pruning_stripe(context.m_pruning_seed);
         const size_t block_queue_size_threshold = m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD;
         bool queue_proceed = nspans < BLOCK_QUEUE_NSPANS_THRESHOLD || size < block_queue_size_threshold;
+        // spans past the first gap can't be added yet, only the peer filling the gap may add to them once they're over budget
+        const size_t out_of_order_size = m_block_queue.get_out_of_order_data_size(bc_height);
+        const bool out_of_order_full = out_of_order_size >= block_queue_size_threshold / BLOCK_QUEUE_OUT_OF_ORDER_SIZE_DIVISOR;
         // get rid of blocks we already requested, or already have
         skip_unneeded_hashes(context, true);
         uint64_t next_needed_height = m_block_queue.get_next_needed_height(bc_height);
@@ -1696,7 +2321,8 @@ skip:
           next_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         bool stripe_proceed_main = (add_stripe == 0 || peer_stripe == 0 || add_stripe == peer_stripe) && (next_block_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS || next_needed_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS);
         bool stripe_proceed_secondary = tools::has_unpruned_block(next_block_height, context.m_remote_blockchain_height, context.m_pruning_seed);
-        bool proceed = stripe_proceed_main || (queue_proceed && stripe_proceed_secondary);
+        const bool out_of_order_proceed = !out_of_order_full || next_block_height <= next_needed_height;
+        bool proceed = (stripe_proceed_main || (queue_proceed && stripe_proceed_secondary)) && out_of_order_proceed;
         if (!stripe_proceed_main && !stripe_proceed_secondary && should_drop_connection(context, tools::get_pruning_stripe(next_block_height, context.m_remote_blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES)))
         {
           if (!context.m_is_income)
@@ -1704,7 +2330,7 @@ skip:
           return false; // drop outgoing connections
         }
 
-        MDEBUG(context << "proceed " << proceed << " (queue " << queue_proceed << ", stripe " << stripe_proceed_main << "/" <<
+        MDEBUG(context << "proceed " << proceed << " (queue " << queue_proceed << ", out of order " << out_of_order_size << ", stripe " << stripe_proceed_main << "/" <<
           stripe_proceed_secondary << "), " << next_needed_pruning_stripe.first << "-" << next_needed_pruning_stripe.second <<
           " needed, bc add stripe " << add_stripe << ", we have " << peer_stripe << "), bc_height " << bc_height);
         MDEBUG(context << "  - next_block_height " << next_block_height << ", seed " << epee::string_tools::to_string_hex(context.m_pruning_seed) <<
@@ -1768,7 +2394,9 @@ skip:
 
         if (context.m_state != cryptonote_connection_context::state_standby)
         {
-          if (!queue_proceed)
+          if (!out_of_order_proceed)
+            LOG_DEBUG_CC(context, "Block queue has " << out_of_order_size << " bytes waiting on earlier spans, pausing");
+          else if (!queue_proceed)
             LOG_DEBUG_CC(context, "Block queue is " << nspans << " and " << size << ", pausing");
           else if (!stripe_proceed_main && !stripe_proceed_secondary)
             LOG_DEBUG_CC(context, "We do not have the stripe required to download another block, pausing");
@@ -1790,7 +2418,9 @@ skip:
       NOTIFY_REQUEST_GET_OBJECTS::request req;
       bool is_next = false;
       size_t count = 0;
-      const size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      // spans sized to the peer's measured rate, so slow peers get short
+      // spans and cannot hold up the chain for long
+      const size_t count_limit = m_block_queue.get_span_size(context.m_connection_id, m_core.get_block_sync_size(m_core.get_current_blockchain_height()));
       std::pair<uint64_t, uint64_t> span = std::make_pair(0, 0);
       if (force_next_span)
       {
@@ -2053,6 +2683,7 @@ skip:
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context)
   {
+    PERF_TIMER(handle_response_chain_entry);
     MLOG_P2P_MESSAGE("Received NOTIFY_RESPONSE_CHAIN_ENTRY: m_block_ids.size()=" << arg.m_block_ids.size()
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
     MLOG_PEER_STATE("received chain");
@@ -2132,13 +2763,18 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::list<boost::uuids::uuid> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy and others
+    std::list<boost::uuids::uuid> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT TX IDS");
+          compactConnections.push_back(context.m_connection_id);
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back(context.m_connection_id);
@@ -2152,6 +2788,36 @@ skip:
       return true;
     });
 
+    if (!compactConnections.empty())
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      block b;
+      std::set<size_t> prefill;
+      bool ok = parse_and_validate_block_from_blob(arg.b.block, b);
+      if (ok && arg.b.txs.size() == b.tx_hashes.size())
+      {
+        const crypto::hash block_hash = get_block_hash(b);
+        boost::unique_lock<boost::mutex> lock(m_compact_prefill_mutex);
+        for (const auto &e: m_compact_prefill)
+          if (e.first == block_hash)
+            prefill = e.second;
+      }
+      ok = ok && make_compact_block(b, arg.b.txs, prefill, crypto::rand<uint64_t>(), compact_arg);
+      if (ok)
+      {
+        compact_arg.current_blockchain_height = arg.current_blockchain_height;
+        MDEBUG("Relaying block " << compact_arg.block_hash << " compactly with " << prefill.size() << "/" << b.tx_hashes.size() << " txes prefilled");
+        std::string compactBlob;
+        epee::serialization::store_t_to_binary(compact_arg, compactBlob);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, epee::strspan<uint8_t>(compactBlob), compactConnections);
+      }
+      else
+      {
+        MERROR("Failed to make compact block, relaying it fluffy");
+        fluffyConnections.splice(fluffyConnections.end(), compactConnections);
+      }
+    }
+
     // send fluffy ones first, we want to encourage people to run that
     if (!fluffyConnections.empty())
     {
@@ -2172,23 +2838,127 @@ skip:
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_deregister_votes(NOTIFY_NEW_DEREGISTER_VOTE::request& arg, cryptonote_connection_context& exclude_context)
   {
-    bool result = relay_post_notify<NOTIFY_NEW_DEREGISTER_VOTE>(arg, exclude_context);
-    return result;
+    std::vector<crypto::hash> ids;
+    ids.reserve(arg.votes.size());
+    for (const full_nodes::deregister_vote &vote: arg.votes)
+      ids.push_back(crypto::cn_fast_hash(&vote, sizeof(vote)));
+
+    std::list<boost::uuids::uuid> peers;
+    m_p2p->for_each_connection([&](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
+        peers.push_back(context.m_connection_id);
+      return true;
+    });
+
+    // each peer only gets the votes it isn't known to have, peers wanting
+    // the same set share one message
+    std::map<std::vector<size_t>, std::list<boost::uuids::uuid>> sends;
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      for (const boost::uuids::uuid &peer: peers)
+      {
+        rolling_bloom_filter &known = get_peer_known_votes(peer);
+        std::vector<size_t> wanted;
+        for (size_t n = 0; n < ids.size(); ++n)
+        {
+          if (known.contains(ids[n]))
+            continue;
+          known.insert(ids[n]);
+          wanted.push_back(n);
+        }
+        if (!wanted.empty())
+          sends[std::move(wanted)].push_back(peer);
+      }
+    }
+
+    for (const auto &e: sends)
+    {
+      NOTIFY_NEW_DEREGISTER_VOTE::request msg;
+      msg.votes.reserve(e.first.size());
+      for (size_t n: e.first)
+        msg.votes.push_back(arg.votes[n]);
+      std::string blob;
+      epee::serialization::store_t_to_binary(msg, blob);
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_DEREGISTER_VOTE::ID, epee::strspan<uint8_t>(blob), e.second);
+    }
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
   {
     // no check for success, so tell core they're relayed unconditionally
-    const bool pad_transactions = m_core.pad_transactions();
-    size_t bytes = pad_transactions ? 9 /* header */ + 4 /* 1 + 'txs' */ + tools::get_varint_data(arg.txs.size()).size() : 0;
-    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tx_blob_it)
+    std::vector<crypto::hash> tx_hashes;
+    tx_hashes.reserve(arg.txs.size());
+    for (const cryptonote::blobdata &tx_blob: arg.txs)
+    {
+      m_core.on_transaction_relayed(tx_blob);
+      cryptonote::transaction tx;
+      crypto::hash tx_hash, tx_prefix_hash;
+      if (parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash))
+        tx_hashes.push_back(tx_hash);
+    }
+
+    // peers taking announces get the hashes on their next trickle and fetch
+    // what they lack, others get the full txes right away
+    std::vector<std::pair<boost::uuids::uuid, bool>> announce_connections;
+    std::list<boost::uuids::uuid> full_connections;
+    bool exclude_announces = false;
+    m_p2p->for_each_connection([&](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (!peer_id)
+        return true;
+      if (exclude_context.m_connection_id == context.m_connection_id)
+        exclude_announces = support_flags & P2P_SUPPORT_FLAG_TX_ANNOUNCE;
+      else if (support_flags & P2P_SUPPORT_FLAG_TX_ANNOUNCE)
+        announce_connections.emplace_back(context.m_connection_id, context.m_is_income);
+      else
+        full_connections.push_back(context.m_connection_id);
+      return true;
+    });
+
     {
-      m_core.on_transaction_relayed(*tx_blob_it);
-      if (pad_transactions)
-        bytes += tools::get_varint_data(tx_blob_it->size()).size() + tx_blob_it->size();
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+      for (const crypto::hash &tx_hash: tx_hashes)
+      {
+        auto i = m_tx_requests.find(tx_hash);
+        if (i == m_tx_requests.end())
+          continue;
+        release_tx_request(i->second);
+        m_tx_requests.erase(i);
+      }
+      if (exclude_announces)
+      {
+        peer_tx_relay &relay = get_peer_tx_relay(exclude_context.m_connection_id, exclude_context.m_is_income);
+        for (const crypto::hash &tx_hash: tx_hashes)
+          relay.known.insert(tx_hash);
+      }
+      for (const auto &c: announce_connections)
+      {
+        peer_tx_relay &relay = get_peer_tx_relay(c.first, c.second);
+        for (const crypto::hash &tx_hash: tx_hashes)
+        {
+          if (relay.known.contains(tx_hash))
+            continue;
+          relay.known.insert(tx_hash);
+          if (relay.pending.empty() && relay.next_trickle <= now)
+            schedule_tx_trickle(relay, now);
+          relay.pending.push_back(tx_hash);
+        }
+      }
     }
 
+    if (full_connections.empty())
+      return true;
+
+    const bool pad_transactions = m_core.pad_transactions();
+    size_t bytes = pad_transactions ? 9 /* header */ + 4 /* 1 + 'txs' */ + tools::get_varint_data(arg.txs.size()).size() : 0;
+    if (pad_transactions)
+      for (const cryptonote::blobdata &tx_blob: arg.txs)
+        bytes += tools::get_varint_data(tx_blob.size()).size() + tx_blob.size();
+
     if (pad_transactions)
     {
       // stuff some dummy bytes in to stay safe from traffic volume analysis
@@ -2213,13 +2983,74 @@ skip:
       // if the size of _ moved enough, we might lose byte in size encoding, we don't care
     }
 
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+    std::string arg_buff;
+    epee::serialization::store_t_to_binary(arg, arg_buff);
+    return m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<uint8_t>(arg_buff), full_connections);
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
-  bool t_cryptonote_protocol_handler<t_core>::relay_uptime_proof(NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& exclude_context)
+  bool t_cryptonote_protocol_handler<t_core>::relay_uptime_proofs(std::vector<NOTIFY_UPTIME_PROOF::request>& proofs, const std::vector<boost::uuids::uuid>& sources)
   {
-    return relay_post_notify<NOTIFY_UPTIME_PROOF>(arg, exclude_context);
+    std::vector<crypto::hash> ids;
+    ids.reserve(proofs.size());
+    for (const NOTIFY_UPTIME_PROOF::request &proof: proofs)
+      ids.push_back(crypto::cn_fast_hash(&proof.sig, sizeof(proof.sig)));
+
+    std::vector<std::pair<boost::uuids::uuid, bool>> peers; // peer, takes batches
+    m_p2p->for_each_connection([&](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (peer_id)
+        peers.emplace_back(context.m_connection_id, support_flags & P2P_SUPPORT_FLAG_UPTIME_PROOF_BATCHES);
+      return true;
+    });
+
+    // peers taking batches get one message with the proofs they aren't known
+    // to have, peers wanting the same set share it; others get them one by one
+    std::map<std::vector<size_t>, std::list<boost::uuids::uuid>> batches;
+    std::vector<std::list<boost::uuids::uuid>> singles(proofs.size());
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      for (const auto &peer: peers)
+      {
+        rolling_bloom_filter &known = get_peer_known_votes(peer.first);
+        std::vector<size_t> wanted;
+        for (size_t n = 0; n < ids.size(); ++n)
+        {
+          if ((n < sources.size() && sources[n] == peer.first) || known.contains(ids[n]))
+            continue;
+          known.insert(ids[n]);
+          if (peer.second)
+            wanted.push_back(n);
+          else
+            singles[n].push_back(peer.first);
+        }
+        if (!wanted.empty())
+          batches[std::move(wanted)].push_back(peer.first);
+      }
+    }
+
+    for (const auto &e: batches)
+    {
+      for (size_t start = 0; start < e.first.size(); start += UPTIME_PROOF_BATCH_MAX)
+      {
+        NOTIFY_UPTIME_PROOFS::request msg;
+        msg.sync = false;
+        for (size_t n = start; n < std::min<size_t>(e.first.size(), start + UPTIME_PROOF_BATCH_MAX); ++n)
+          msg.proofs.push_back(proofs[e.first[n]]);
+        std::string blob;
+        epee::serialization::store_t_to_binary(msg, blob);
+        m_p2p->relay_notify_to_list(NOTIFY_UPTIME_PROOFS::ID, epee::strspan<uint8_t>(blob), e.second);
+      }
+    }
+    for (size_t n = 0; n < proofs.size(); ++n)
+    {
+      if (singles[n].empty())
+        continue;
+      std::string blob;
+      epee::serialization::store_t_to_binary(proofs[n], blob);
+      m_p2p->relay_notify_to_list(NOTIFY_UPTIME_PROOF::ID, epee::strspan<uint8_t>(blob), singles[n]);
+    }
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
@@ -2334,6 +3165,25 @@ skip:
     }
 
     m_block_queue.flush_spans(context.m_connection_id, false);
+
+    {
+      boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+      m_tx_relay.erase(context.m_connection_id);
+    }
+    {
+      boost::unique_lock<boost::mutex> lock(m_vote_relay_mutex);
+      m_vote_relay.erase(context.m_connection_id);
+    }
+    // gone before it answered: let another peer take its place
+    if (context.m_uptime_proofs_pending)
+      --m_uptime_proof_syncs;
+    {
+      // a job still serving it stops at its next request
+      boost::unique_lock<boost::mutex> lock(m_objects_serving_mutex);
+      auto queue = m_objects_serving.find(context.m_connection_id);
+      if (queue != m_objects_serving.end())
+        queue->second.clear();
+    }
     MLOG_PEER_STATE("closed");
   }
 
@@ -42,7 +42,8 @@ namespace cryptonote
   {
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)=0;
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)=0;
-    virtual bool relay_uptime_proof(NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& exclude_context)=0;
+    // sources[n] is the connection proofs[n] came in on, it is not sent back there
+    virtual bool relay_uptime_proofs(std::vector<NOTIFY_UPTIME_PROOF::request>& proofs, const std::vector<boost::uuids::uuid>& sources)=0;
     //virtual bool request_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)=0;
     virtual bool relay_deregister_votes(NOTIFY_NEW_DEREGISTER_VOTE::request& arg, cryptonote_connection_context& exclude_context)=0;
   };
@@ -64,7 +65,7 @@ namespace cryptonote
     {
       return false;
     }
-    virtual bool relay_uptime_proof(NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& exclude_context)
+    virtual bool relay_uptime_proofs(std::vector<NOTIFY_UPTIME_PROOF::request>& proofs, const std::vector<boost::uuids::uuid>& sources)
     {
       return false;
     }
@@ -0,0 +1,111 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "crypto/crypto.h"
+#include "rolling_bloom_filter.h"
+
+namespace cryptonote
+{
+
+rolling_bloom_filter::rolling_bloom_filter(size_t capacity, double false_positive_rate):
+  m_generation_capacity(std::max<size_t>(1, capacity / 2))
+{
+  // the two generations are tested together, so each gets half the rate
+  const double p = std::min(0.5, std::max(1e-12, false_positive_rate / 2));
+  const double ln2 = std::log(2.0);
+  m_nbits = std::max<size_t>(64, std::ceil(-(double)m_generation_capacity * std::log(p) / (ln2 * ln2)));
+  m_nbits = (m_nbits + 63) / 64 * 64;
+  m_nhashes = std::min<size_t>(32, std::max<size_t>(1, std::round((double)m_nbits / m_generation_capacity * ln2)));
+  reset(m_current);
+  reset(m_previous);
+}
+
+void rolling_bloom_filter::reset(generation &g)
+{
+  g.bits.assign(m_nbits / 64, 0);
+  g.tweak = crypto::rand<uint64_t>();
+  g.count = 0;
+}
+
+void rolling_bloom_filter::clear()
+{
+  reset(m_current);
+  reset(m_previous);
+}
+
+void rolling_bloom_filter::positions(const generation &g, const crypto::hash &h, std::vector<size_t> &out) const
+{
+  // hashes are uniform already, double hashing over two of their words
+  uint64_t a, b;
+  memcpy(&a, h.data, sizeof(a));
+  memcpy(&b, h.data + sizeof(a), sizeof(b));
+  a ^= g.tweak;
+  b = (b ^ (g.tweak * 0x9e3779b97f4a7c15ull)) | 1;
+  out.resize(m_nhashes);
+  for (size_t i = 0; i < m_nhashes; ++i)
+    out[i] = (a + i * b) % m_nbits;
+}
+
+bool rolling_bloom_filter::test(const generation &g, const crypto::hash &h) const
+{
+  if (g.count == 0)
+    return false;
+  std::vector<size_t> pos;
+  positions(g, h, pos);
+  for (size_t p: pos)
+    if (!(g.bits[p / 64] & (1ull << (p % 64))))
+      return false;
+  return true;
+}
+
+void rolling_bloom_filter::insert(const crypto::hash &h)
+{
+  if (test(m_current, h))
+    return;
+  if (m_current.count >= m_generation_capacity)
+  {
+    std::swap(m_previous, m_current);
+    reset(m_current);
+  }
+  std::vector<size_t> pos;
+  positions(m_current, h, pos);
+  for (size_t p: pos)
+    m_current.bits[p / 64] |= 1ull << (p % 64);
+  ++m_current.count;
+}
+
+bool rolling_bloom_filter::contains(const crypto::hash &h) const
+{
+  return test(m_current, h) || test(m_previous, h);
+}
+
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief approximate set of the most recently inserted hashes
+   *
+   * Two bloom filters of half the capacity each: when the newer one is
+   * full, the older one is dropped and a fresh one started.  Any of the
+   * last capacity / 2 hashes always tests positive, anything before the
+   * last capacity hashes has faded out, and a hash never inserted tests
+   * positive with about the given probability.
+   *
+   * Inserted items must be hashes, their bytes index the filter directly.
+   */
+  class rolling_bloom_filter
+  {
+  public:
+    rolling_bloom_filter(size_t capacity, double false_positive_rate);
+
+    void insert(const crypto::hash &h);
+    bool contains(const crypto::hash &h) const;
+    void clear();
+
+  private:
+    struct generation
+    {
+      std::vector<uint64_t> bits;
+      uint64_t tweak;
+      size_t count;
+    };
+
+    void reset(generation &g);
+    void positions(const generation &g, const crypto::hash &h, std::vector<size_t> &out) const;
+    bool test(const generation &g, const crypto::hash &h) const;
+
+    size_t m_generation_capacity;
+    size_t m_nbits;
+    size_t m_nhashes;
+    generation m_current, m_previous;
+  };
+}
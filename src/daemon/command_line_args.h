@@ -77,6 +77,11 @@ namespace daemon_args
   , "Specify maximum number of rotated log files to be saved (no limit by setting to 0)"
   , MAX_LOG_FILES
   };
+  const command_line::arg_descriptor<bool> arg_log_async = {
+    "log-async"
+  , "Write the log file from a background thread, dropping lines if it falls behind"
+  , false
+  };
   const command_line::arg_descriptor<std::string> arg_log_level = {
     "log-level"
   , ""
@@ -116,6 +121,18 @@ namespace daemon_args
     }
   };
 
+  const command_line::arg_descriptor<size_t> arg_zmq_rpc_threads = {
+    "zmq-rpc-threads"
+  , "Number of threads serving ZMQ RPC requests concurrently"
+  , 2
+  };
+
+  const command_line::arg_descriptor<std::string> arg_zmq_pub_bind_port = {
+    "zmq-pub-bind-port"
+  , "Port for the ZMQ PUB socket publishing chain, pool and full node events, on --zmq-rpc-bind-ip; disabled if empty"
+  , ""
+  };
+
 }  // namespace daemon_args
 
 #endif // DAEMON_COMMAND_LINE_ARGS_H
@@ -242,6 +242,28 @@ bool t_command_parser_executor::set_log_level(const std::vector<std::string>& ar
   }
 }
 
+bool t_command_parser_executor::perf_trace(const std::vector<std::string>& args)
+{
+  uint64_t events_per_thread = 0;
+  if (args.size() == 1 && (args[0] == "start" || args[0] == "stop"))
+    return m_executor.perf_trace(args[0], 0, "");
+  if (args.size() == 2 && args[0] == "start" && epee::string_tools::get_xtype_from_string(events_per_thread, args[1]) && events_per_thread > 0)
+    return m_executor.perf_trace(args[0], events_per_thread, "");
+  if (args.size() == 2 && args[0] == "dump")
+    return m_executor.perf_trace(args[0], 0, args[1]);
+  if (args.empty())
+    return m_executor.perf_trace("", 0, "");
+  std::cout << "use: perf_trace [start [<events_per_thread>] | stop | dump <filename>]" << std::endl;
+  return true;
+}
+
+bool t_command_parser_executor::alloc_stats(const std::vector<std::string>& args)
+{
+  if (!args.empty()) return false;
+
+  return m_executor.alloc_stats();
+}
+
 bool t_command_parser_executor::print_height(const std::vector<std::string>& args) 
 {
   if (!args.empty()) return false;
@@ -826,18 +848,19 @@ bool t_command_parser_executor::prune_blockchain(const std::vector<std::string>&
 {
   if (args.size() > 1) return false;
 
-  if (args.empty() || args[0] != "confirm")
+  if (args.empty() || (args[0] != "confirm" && args[0] != "background"))
   {
     std::cout << "Warning: pruning from within antdd will not shrink the database file size." << std::endl;
     std::cout << "Instead, parts of the file will be marked as free, so the file will not grow" << std::endl;
     std::cout << "until that newly free space is used up. If you want a smaller file size now," << std::endl;
     std::cout << "exit antdd and run antd-blockchain-prune (you will temporarily need more" << std::endl;
     std::cout << "disk space for the database conversion though). If you are OK with the database" << std::endl;
-    std::cout << "file keeping the same size, re-run this command with the \"confirm\" parameter." << std::endl;
+    std::cout << "file keeping the same size, re-run this command with the \"confirm\" parameter," << std::endl;
+    std::cout << "or with \"background\" to prune a little at a time while the daemon keeps running." << std::endl;
     return true;
   }
 
-  return m_executor.prune_blockchain();
+  return m_executor.prune_blockchain(args[0] == "background");
 }
 
 bool t_command_parser_executor::check_blockchain_pruning(const std::vector<std::string>& args)
@@ -93,6 +93,10 @@ public:
 
   bool set_log_categories(const std::vector<std::string>& args);
 
+  bool perf_trace(const std::vector<std::string>& args);
+
+  bool alloc_stats(const std::vector<std::string>& args);
+
   bool print_height(const std::vector<std::string>& args);
 
   bool print_block(const std::vector<std::string>& args);
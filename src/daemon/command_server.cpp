@@ -194,6 +194,17 @@ t_command_server::t_command_server(
     , "set_log <level>|<{+,-,}categories>"
     , "Change the current log level/categories where <level> is a number 0-4."
     );
+  m_command_lookup.set_handler(
+      "perf_trace"
+    , std::bind(&t_command_parser_executor::perf_trace, &m_parser, p::_1)
+    , "perf_trace [start [<events_per_thread>] | stop | dump <filename>]"
+    , "Record timed scopes (block handling, tx checks, db commits, RPC handlers) per thread, and dump them as a Chrome/Perfetto trace."
+    );
+  m_command_lookup.set_handler(
+      "alloc_stats"
+    , std::bind(&t_command_parser_executor::alloc_stats, &m_parser, p::_1)
+    , "Print heap allocation counts and bytes per subsystem, in builds made with ALLOC_PROFILING."
+    );
   m_command_lookup.set_handler(
       "diff"
     , std::bind(&t_command_parser_executor::show_difficulty, &m_parser, p::_1)
@@ -342,7 +353,8 @@ t_command_server::t_command_server(
     m_command_lookup.set_handler(
       "prune_blockchain"
     , std::bind(&t_command_parser_executor::prune_blockchain, &m_parser, p::_1)
-    , "Prune the blockchain."
+    , "prune_blockchain [confirm|background]"
+    , "Prune the blockchain, all at once or a little at a time in the background."
     );
     m_command_lookup.set_handler(
       "check_blockchain_pruning"
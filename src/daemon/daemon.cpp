@@ -36,6 +36,8 @@
 #include "daemon/daemon.h"
 #include "rpc/daemon_handler.h"
 #include "rpc/zmq_server.h"
+#include "rpc/zmq_pub.h"
+#include "rpc/zmq_replica.h"
 
 #include "common/password.h"
 #include "common/util.h"
@@ -69,7 +71,7 @@ public:
       boost::program_options::variables_map const & vm
     )
     : core{vm}
-    , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline)}
+    , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline) || !command_line::is_arg_defaulted(vm, cryptonote::arg_replica_of)}
     , p2p{vm, protocol}
   {
     // Handle circular dependencies
@@ -103,6 +105,9 @@ t_daemon::t_daemon(
 {
   zmq_rpc_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_port);
   zmq_rpc_bind_address = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_ip);
+  zmq_rpc_threads = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_threads);
+  zmq_pub_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_pub_bind_port);
+  replica_of = command_line::get_arg(vm, cryptonote::arg_replica_of);
 }
 
 t_daemon::~t_daemon() = default;
@@ -165,7 +170,7 @@ bool t_daemon::run(bool interactive)
     }
 
     cryptonote::rpc::DaemonHandler rpc_daemon_handler(mp_internals->core.get(), mp_internals->p2p.get());
-    cryptonote::rpc::ZmqServer zmq_server(rpc_daemon_handler);
+    cryptonote::rpc::ZmqServer zmq_server(rpc_daemon_handler, zmq_rpc_threads);
 
     if (!zmq_server.addTCPSocket(zmq_rpc_bind_address, zmq_rpc_bind_port))
     {
@@ -185,13 +190,49 @@ bool t_daemon::run(bool interactive)
     zmq_server.run();
 
     MINFO(std::string("ZMQ server started at ") + zmq_rpc_bind_address
-          + ":" + zmq_rpc_bind_port + ".");
+          + ":" + zmq_rpc_bind_port + " with " + std::to_string(zmq_rpc_threads) + " worker threads.");
+
+    cryptonote::rpc::ZmqPublisher zmq_publisher(mp_internals->core.get());
+    if (!zmq_pub_bind_port.empty())
+    {
+      if (zmq_publisher.addTCPSocket(zmq_rpc_bind_address, zmq_pub_bind_port))
+      {
+        zmq_publisher.run();
+        MINFO(std::string("ZMQ publisher started at ") + zmq_rpc_bind_address
+              + ":" + zmq_pub_bind_port + ".");
+      }
+      else
+      {
+        LOG_ERROR(std::string("Failed to add ZMQ PUB Socket (") + zmq_rpc_bind_address
+            + ":" + zmq_pub_bind_port + "), not publishing events");
+      }
+    }
+
+    cryptonote::rpc::ZmqReplica zmq_replica(mp_internals->core.get());
+    if (!replica_of.empty())
+    {
+      if (!zmq_replica.connect(replica_of))
+      {
+        LOG_ERROR("Failed to subscribe to the primary daemon at " << replica_of);
+        zmq_publisher.stop();
+        zmq_server.stop();
+        if (rpc_commands)
+          rpc_commands->stop_handling();
+        for(auto& rpc : mp_internals->rpcs)
+          rpc->stop();
+        return false;
+      }
+      zmq_replica.run();
+      MGINFO("Following the primary daemon at " << replica_of);
+    }
 
     mp_internals->p2p.run(); // blocks until p2p goes down
 
     if (rpc_commands)
       rpc_commands->stop_handling();
 
+    zmq_replica.stop();
+    zmq_publisher.stop();
     zmq_server.stop();
 
     for(auto& rpc : mp_internals->rpcs)
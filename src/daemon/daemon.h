@@ -46,6 +46,9 @@ private:
   std::unique_ptr<t_internals> mp_internals;
   std::string zmq_rpc_bind_address;
   std::string zmq_rpc_bind_port;
+  size_t zmq_rpc_threads;
+  std::string zmq_pub_bind_port;
+  std::string replica_of;
 public:
   t_daemon(
       boost::program_options::variables_map const & vm
@@ -30,6 +30,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include "string_tools.h"
+#include "file_io_utils.h"
 #include "common/password.h"
 #include "common/scoped_message_writer.h"
 #include "common/pruning.h"
@@ -772,6 +773,79 @@ bool t_rpc_command_executor::set_log_categories(const std::string &categories) {
   return true;
 }
 
+bool t_rpc_command_executor::perf_trace(const std::string &action, uint64_t events_per_thread, const std::string &filename) {
+  cryptonote::COMMAND_RPC_PERF_TRACE::request req;
+  cryptonote::COMMAND_RPC_PERF_TRACE::response res;
+  req.action = action;
+  req.events_per_thread = events_per_thread;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/perf_trace", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_perf_trace(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  if (action == "dump")
+  {
+    if (!epee::file_io_utils::save_string_to_file(filename, res.trace))
+    {
+      tools::fail_msg_writer() << "Failed to write trace to " << filename;
+      return true;
+    }
+    tools::success_msg_writer() << "Trace written to " << filename << ", open it in chrome://tracing or ui.perfetto.dev";
+  }
+  tools::success_msg_writer() << "Tracing is " << (res.enabled ? "on" : "off");
+
+  return true;
+}
+
+bool t_rpc_command_executor::alloc_stats() {
+  cryptonote::COMMAND_RPC_GET_ALLOC_STATS::request req;
+  cryptonote::COMMAND_RPC_GET_ALLOC_STATS::response res;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/get_alloc_stats", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_alloc_stats(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  if (!res.enabled)
+  {
+    tools::msg_writer() << "Allocation profiling is not built in, rebuild with -DALLOC_PROFILING=ON";
+    return true;
+  }
+
+  tools::msg_writer() << boost::format("%-20s %16s %20s") % "scope" % "allocations" % "bytes";
+  for (const auto &s: res.scopes)
+    tools::msg_writer() << boost::format("%-20s %16u %20u") % s.scope % s.allocations % s.bytes;
+
+  return true;
+}
+
 bool t_rpc_command_executor::print_height() {
   cryptonote::COMMAND_RPC_GET_HEIGHT::request req;
   cryptonote::COMMAND_RPC_GET_HEIGHT::response res;
@@ -3530,7 +3604,7 @@ bool t_rpc_command_executor::prepare_registration()
   return true;
 }
 
-bool t_rpc_command_executor::prune_blockchain()
+bool t_rpc_command_executor::prune_blockchain(bool background)
 {
     cryptonote::COMMAND_RPC_PRUNE_BLOCKCHAIN::request req;
     cryptonote::COMMAND_RPC_PRUNE_BLOCKCHAIN::response res;
@@ -3538,6 +3612,7 @@ bool t_rpc_command_executor::prune_blockchain()
     epee::json_rpc::error error_resp;
 
     req.check = false;
+    req.background = background;
 
     if (m_is_rpc)
     {
@@ -3555,7 +3630,10 @@ bool t_rpc_command_executor::prune_blockchain()
         }
     }
 
-    tools::success_msg_writer() << "Blockchain pruned: seed " << epee::string_tools::to_string_hex(res.pruning_seed);
+    if (background)
+      tools::success_msg_writer() << "Blockchain pruning started in the background: seed " << epee::string_tools::to_string_hex(res.pruning_seed);
+    else
+      tools::success_msg_writer() << "Blockchain pruned: seed " << epee::string_tools::to_string_hex(res.pruning_seed);
     return true;
 }
 
@@ -3567,6 +3645,7 @@ bool t_rpc_command_executor::check_blockchain_pruning()
     epee::json_rpc::error error_resp;
 
     req.check = true;
+    req.background = false;
 
     if (m_is_rpc)
     {
@@ -92,6 +92,10 @@ public:
 
   bool set_log_categories(const std::string &categories);
 
+  bool perf_trace(const std::string &action, uint64_t events_per_thread, const std::string &filename);
+
+  bool alloc_stats();
+
   bool print_height();
 
   bool print_block_by_hash(crypto::hash block_hash, bool include_hex);
@@ -170,7 +174,7 @@ public:
 
   bool print_sn(const std::vector<std::string> &args);
 
-  bool prune_blockchain();
+  bool prune_blockchain(bool background);
 
   bool check_blockchain_pruning();
 };
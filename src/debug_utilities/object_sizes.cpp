@@ -28,10 +28,14 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <map>
+#include <iomanip>
+#include <boost/program_options.hpp>
+#include "common/command_line.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/tx_extra.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/full_node_list.h"
 #include "p2p/p2p_protocol_defs.h"
 #include "net/connection_basic.hpp"
 #include "p2p/net_peerlist.h"
@@ -62,14 +66,164 @@ private:
 };
 #define SL(type) sl.add(#type, sizeof(type))
 
+namespace po = boost::program_options;
+
+// reports, for the types kept in large numbers, how much of each instance
+// is padding, what a typical instance holds on the heap, and what a given
+// number of them costs; container node overhead is not included
+class layout_logger
+{
+public:
+  ~layout_logger()
+  {
+    uint64_t grand_total = 0;
+    std::cout << std::endl << std::left << std::setw(44) << "type" << std::right << std::setw(8) << "size" << std::setw(9) << "members"
+        << std::setw(9) << "padding" << std::setw(8) << "heap" << std::setw(10) << "count" << std::setw(12) << "total MB" << std::endl;
+    for (const auto &e: entries)
+    {
+      const uint64_t total = (e.size + e.heap) * e.count;
+      grand_total += total;
+      std::cout << std::left << std::setw(44) << e.name << std::right << std::setw(8) << e.size << std::setw(9) << e.members
+          << std::setw(9) << e.size - e.members << std::setw(8) << e.heap << std::setw(10) << e.count
+          << std::setw(12) << std::fixed << std::setprecision(1) << total / 1048576.0 << std::endl;
+    }
+    std::cout << std::left << std::setw(88) << "total" << std::right << std::setw(12) << std::fixed << std::setprecision(1) << grand_total / 1048576.0 << std::endl;
+  }
+  void add(const char *type, size_t size, size_t members, size_t heap, uint64_t count) { entries.push_back({type, size, members, heap, count}); }
+private:
+  struct entry { std::string name; size_t size; size_t members; size_t heap; uint64_t count; };
+  std::vector<entry> entries;
+};
+#define MS(type, member) sizeof(((type*)nullptr)->member)
+
+template<typename T> static size_t heap_bytes(const std::vector<T> &v) { return v.capacity() * sizeof(T); }
+
+static size_t heap_bytes(const cryptonote::transaction_prefix &tx)
+{
+  size_t bytes = heap_bytes(tx.vin) + heap_bytes(tx.vout) + heap_bytes(tx.extra) + heap_bytes(tx.output_unlock_times);
+  for (const auto &in: tx.vin)
+    if (in.type() == typeid(cryptonote::txin_to_key))
+      bytes += heap_bytes(boost::get<cryptonote::txin_to_key>(in).key_offsets);
+  return bytes;
+}
+
+// a 2 input, 2 output tx with 11 member rings and a tx pubkey plus payment id in extra
+static cryptonote::transaction_prefix typical_tx_prefix()
+{
+  cryptonote::transaction_prefix tx;
+  cryptonote::txin_to_key in;
+  in.key_offsets.resize(11);
+  tx.vin.resize(2, in);
+  tx.vout.resize(2);
+  tx.output_unlock_times.resize(2);
+  tx.extra.resize(44);
+  return tx;
+}
+
+static size_t typical_full_node_heap()
+{
+  // a full node with four contributors, each with one locked contribution
+  full_nodes::full_node_info info;
+  info.contributors.resize(4);
+  size_t bytes = heap_bytes(info.contributors);
+  for (auto &contributor: info.contributors)
+  {
+    contributor.locked_contributions.resize(1);
+    bytes += heap_bytes(contributor.locked_contributions);
+  }
+  return bytes;
+}
+
+static size_t typical_transfer_heap()
+{
+  tools::wallet2::transfer_details td;
+  td.m_tx = typical_tx_prefix();
+  td.m_uses.resize(1);
+  return heap_bytes(td.m_tx) + heap_bytes(td.m_uses);
+}
+
+static size_t typical_block_heap()
+{
+  // an alt block with 10 txes and a 1 output miner tx
+  cryptonote::Blockchain::block_extended_info bei;
+  bei.bl.tx_hashes.resize(10);
+  bei.bl.miner_tx.vin.resize(1);
+  bei.bl.miner_tx.vout.resize(1);
+  bei.bl.miner_tx.output_unlock_times.resize(1);
+  bei.bl.miner_tx.extra.resize(40);
+  return heap_bytes(bei.bl.tx_hashes) + heap_bytes(bei.bl.miner_tx);
+}
+
+// network_address holds its concrete address in a make_shared'd implementation with a vtable
+static const size_t network_address_heap = sizeof(void*) + sizeof(epee::net_utils::ipv4_network_address) + 2 * sizeof(long);
+
 int main(int argc, char* argv[])
 {
   size_logger sl;
+  layout_logger ll;
 
   tools::on_startup();
 
+  po::options_description desc_options("Allowed options");
+  const command_line::arg_descriptor<uint64_t> arg_full_nodes = {"full-nodes", "Number of full nodes to size for", 2000};
+  const command_line::arg_descriptor<uint64_t> arg_transfers = {"transfers", "Number of wallet transfers to size for", 100000};
+  const command_line::arg_descriptor<uint64_t> arg_pool_txes = {"pool-txes", "Number of pool txes to size for", 5000};
+  const command_line::arg_descriptor<uint64_t> arg_alt_blocks = {"alt-blocks", "Number of alternative blocks to size for", 100};
+  const command_line::arg_descriptor<uint64_t> arg_peers = {"peers", "Number of peerlist entries to size for", P2P_LOCAL_WHITE_PEERLIST_LIMIT + P2P_LOCAL_GRAY_PEERLIST_LIMIT};
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_full_nodes);
+  command_line::add_arg(desc_options, arg_transfers);
+  command_line::add_arg(desc_options, arg_pool_txes);
+  command_line::add_arg(desc_options, arg_alt_blocks);
+  command_line::add_arg(desc_options, arg_peers);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
   mlog_configure("", true);
 
+  typedef full_nodes::full_node_info fni;
+  ll.add("full_nodes::full_node_info", sizeof(fni),
+      MS(fni, version) + MS(fni, registration_height) + MS(fni, requested_unlock_height) + MS(fni, last_reward_block_height) +
+      MS(fni, last_reward_transaction_index) + MS(fni, contributors) + MS(fni, total_contributed) + MS(fni, total_reserved) +
+      MS(fni, staking_requirement) + MS(fni, portions_for_operator) + MS(fni, swarm_id) + MS(fni, operator_address) + MS(fni, dummy),
+      typical_full_node_heap(), command_line::get_arg(vm, arg_full_nodes));
+
+  typedef tools::wallet2::transfer_details td;
+  ll.add("tools::wallet2::transfer_details", sizeof(td),
+      MS(td, m_block_height) + MS(td, m_tx) + MS(td, m_txid) + MS(td, m_internal_output_index) + MS(td, m_global_output_index) +
+      MS(td, m_spent) + MS(td, m_spent_height) + MS(td, m_key_image) + MS(td, m_mask) + MS(td, m_amount) + MS(td, m_rct) +
+      MS(td, m_key_image_known) + MS(td, m_key_image_request) + MS(td, m_pk_index) + MS(td, m_subaddr_index) +
+      MS(td, m_key_image_partial) + MS(td, m_multisig_k) + MS(td, m_multisig_info) + MS(td, m_uses),
+      typical_transfer_heap(), command_line::get_arg(vm, arg_transfers));
+
+  // the reserved tail of the db record shows up as padding
+  ll.add("cryptonote::txpool_tx_meta_t", sizeof(cryptonote::txpool_tx_meta_t),
+      offsetof(cryptonote::txpool_tx_meta_t, padding), 0, command_line::get_arg(vm, arg_pool_txes));
+
+  typedef cryptonote::Blockchain::block_extended_info bei;
+  ll.add("cryptonote::Blockchain::block_extended_info", sizeof(bei),
+      MS(bei, bl) + MS(bei, height) + MS(bei, block_cumulative_weight) + MS(bei, cumulative_difficulty) +
+      MS(bei, already_generated_coins) + MS(bei, pow),
+      typical_block_heap(), command_line::get_arg(vm, arg_alt_blocks));
+
+  typedef nodetool::peerlist_entry pe;
+  ll.add("nodetool::peerlist_entry", sizeof(pe),
+      MS(pe, adr) + MS(pe, id) + MS(pe, last_seen) + MS(pe, pruning_seed),
+      network_address_heap, command_line::get_arg(vm, arg_peers));
+
   SL(boost::thread);
   SL(boost::asio::io_service);
   SL(boost::asio::io_service::work);
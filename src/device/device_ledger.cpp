@@ -99,6 +99,42 @@ namespace hw {
       hmacs.clear();
     }
 
+    /* ===================================================================== */
+    /* ===                     DerivationCache                          ==== */
+    /* ===================================================================== */
+
+    std::string DerivationCache::make_key(unsigned char ins, const void *a, const void *b, uint32_t index) {
+      std::string key(1 + 32 + 32 + 4, '\0');
+      key[0] = ins;
+      memcpy(&key[1], a, 32);
+      memcpy(&key[33], b, 32);
+      key[65] = index>>24;
+      key[66] = index>>16;
+      key[67] = index>>8;
+      key[68] = index>>0;
+      return key;
+    }
+
+    bool DerivationCache::find(unsigned char ins, const void *a, const void *b, uint32_t index, uint8_t res[32]) const {
+      const auto it = entries.find(make_key(ins, a, b, index));
+      if (it == entries.end())
+        return false;
+      memcpy(res, it->second.data(), 32);
+      return true;
+    }
+
+    void DerivationCache::add(unsigned char ins, const void *a, const void *b, uint32_t index, const uint8_t res[32]) {
+      if (entries.size() >= MAX_ENTRIES)
+        entries.clear();
+      std::array<uint8_t, 32> value;
+      memcpy(value.data(), res, 32);
+      entries[make_key(ins, a, b, index)] = value;
+    }
+
+    void DerivationCache::clear() {
+      entries.clear();
+    }
+
     /* ===================================================================== */
     /* ===                        Keymap                                ==== */
     /* ===================================================================== */
@@ -376,6 +412,7 @@ namespace hw {
 
     bool device_ledger::reset() {
       reset_buffer();
+      derivation_cache.clear();
       int offset = set_command_header_noopt(INS_RESET);
       const size_t verlen = strlen(ANTD_VERSION);
       ASSERT_X(offset + verlen <= BUFFER_SEND_SIZE, "ANTD_VERSION is too long")
@@ -489,6 +526,7 @@ namespace hw {
 
     bool device_ledger::disconnect() {
       hw_device.disconnect();
+      derivation_cache.clear();
       return true;
     }
 
@@ -623,7 +661,7 @@ namespace hw {
         //of the device), so continue that way.
         MDEBUG( "derive_subaddress_public_key  : PARSE mode with known viewkey");     
         crypto::derive_subaddress_public_key(pub, derivation, output_index,derived_pub);
-      } else {
+      } else if (!this->derivation_cache.find(INS_DERIVE_SUBADDRESS_PUBLIC_KEY, pub.data, derivation.data, output_index, (uint8_t*)derived_pub.data)) {
        
         int offset = set_command_header_noopt(INS_DERIVE_SUBADDRESS_PUBLIC_KEY);
         //pub
@@ -644,6 +682,7 @@ namespace hw {
 
         //pub key
         memmove(derived_pub.data, &this->buffer_recv[0], 32);
+        this->derivation_cache.add(INS_DERIVE_SUBADDRESS_PUBLIC_KEY, pub.data, derivation.data, output_index, (uint8_t*)derived_pub.data);
       }
       #ifdef DEBUG_HWDEVICE
       hw::ledger::check32("derive_subaddress_public_key", "derived_pub", derived_pub_x.data, derived_pub.data);
@@ -972,6 +1011,10 @@ namespace hw {
         //Note derivation in PARSE mode can only happen with viewkey, so assert it!
         assert(is_fake_view_key(sec));
         r = crypto::generate_key_derivation(pub, this->viewkey, derivation);
+      } else if (!this->tx_in_progress && this->derivation_cache.find(INS_GEN_KEY_DERIVATION, pub.data, sec.data, 0, (uint8_t*)derivation.data)) {
+        //Outside a transaction the device hands back the same encrypted
+        //derivation for the same inputs, so scanning can skip the round trip.
+        r = true;
       } else {
         int offset = set_command_header_noopt(INS_GEN_KEY_DERIVATION);
         //pub
@@ -987,6 +1030,9 @@ namespace hw {
         offset = 0;
         //derivattion data
         this->receive_secret((unsigned char*)derivation.data, offset);
+        if (!this->tx_in_progress) {
+          this->derivation_cache.add(INS_GEN_KEY_DERIVATION, pub.data, sec.data, 0, (uint8_t*)derivation.data);
+        }
 
         r = true;
       }
@@ -1119,6 +1165,13 @@ namespace hw {
         log_hexbuffer("derive_public_key: [[OUT]] derived_pub ", derived_pub_x.data, 32);
         #endif
 
+        if (this->derivation_cache.find(INS_DERIVE_PUBLIC_KEY, derivation.data, pub.data, output_index, (uint8_t*)derived_pub.data)) {
+          #ifdef DEBUG_HWDEVICE
+          hw::ledger::check32("derive_public_key", "derived_pub", derived_pub_x.data, derived_pub.data);
+          #endif
+          return true;
+        }
+
         int offset = set_command_header_noopt(INS_DERIVE_PUBLIC_KEY);
         //derivation
         this->send_secret((unsigned char*)derivation.data, offset);
@@ -1138,6 +1191,7 @@ namespace hw {
 
         //pub key
         memmove(derived_pub.data, &this->buffer_recv[0], 32);
+        this->derivation_cache.add(INS_DERIVE_PUBLIC_KEY, derivation.data, pub.data, output_index, (uint8_t*)derived_pub.data);
 
         #ifdef DEBUG_HWDEVICE
         hw::ledger::check32("derive_public_key", "derived_pub", derived_pub_x.data, derived_pub.data);
@@ -1289,6 +1343,7 @@ namespace hw {
         this->lock();
         key_map.clear();
         hmac_map.clear();
+        derivation_cache.clear();
         this->tx_in_progress = true;
         int offset = set_command_header_noopt(INS_OPEN_TX, 0x01);
 
@@ -2235,6 +2290,7 @@ namespace hw {
         send_simple(INS_CLOSE_TX);
         key_map.clear();
         hmac_map.clear();
+        derivation_cache.clear();
         this->tx_in_progress = false;
         this->unlock();
         return true;
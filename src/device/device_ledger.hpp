@@ -30,8 +30,10 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <string>
+#include <unordered_map>
 #include "device.hpp"
 #include "log.hpp"
 #include "device_io_hid.hpp"
@@ -108,6 +110,23 @@ namespace hw {
         void clear() ;
     };
 
+    // Host side memo of device derivation results, keyed on the instruction
+    // and its exact (possibly encrypted) inputs. Secrets handed out by the
+    // device are only meaningful for the current session, so the cache must
+    // be cleared whenever the device session or tx key changes.
+    class DerivationCache {
+    public:
+        static const size_t MAX_ENTRIES = 1 << 16;
+
+        bool find(unsigned char ins, const void *a, const void *b, uint32_t index, uint8_t res[32]) const;
+        void add(unsigned char ins, const void *a, const void *b, uint32_t index, const uint8_t res[32]);
+        void clear();
+
+    private:
+        static std::string make_key(unsigned char ins, const void *a, const void *b, uint32_t index);
+        std::unordered_map<std::string, std::array<uint8_t, 32>> entries;
+    };
+
 
     #define BUFFER_SEND_SIZE 262
     #define BUFFER_RECV_SIZE 262
@@ -149,6 +168,9 @@ namespace hw {
         //hmac for some encrypted value
         HMACmap hmac_map;
 
+        // derivations already computed by the device in this session
+        DerivationCache derivation_cache;
+
         // To speed up blockchain parsing the view key maybe handle here.
         crypto::secret_key viewkey;
         bool has_view_key;
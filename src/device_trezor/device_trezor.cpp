@@ -56,7 +56,10 @@ namespace trezor {
       hw::register_device(HW_TREZOR_NAME, ensure_trezor_device());
     }
 
-    device_trezor::device_trezor() {
+    const size_t device_trezor::KI_SYNC_BATCH_SIZE;
+    const size_t device_trezor::KI_SYNC_BULK_BATCH_SIZE;
+
+    device_trezor::device_trezor(): m_ki_sync_batch_size(KI_SYNC_BULK_BATCH_SIZE) {
 
     }
 
@@ -121,7 +124,7 @@ namespace trezor {
         const boost::optional<cryptonote::network_type> & network_type){
       AUTO_LOCK_CMD();
       require_connected();
-      device_state_reset_unsafe();
+      device_state_initialize_unsafe();
       require_initialized();
 
       auto req = std::make_shared<messages::monero::MoneroGetAddress>();
@@ -129,6 +132,7 @@ namespace trezor {
 
       auto response = this->client_exchange<messages::monero::MoneroAddress>(req);
       MTRACE("Get address response received");
+      device_state_idle_unsafe();
       return response;
     }
 
@@ -137,7 +141,7 @@ namespace trezor {
         const boost::optional<cryptonote::network_type> & network_type){
       AUTO_LOCK_CMD();
       require_connected();
-      device_state_reset_unsafe();
+      device_state_initialize_unsafe();
       require_initialized();
 
       auto req = std::make_shared<messages::monero::MoneroGetWatchKey>();
@@ -145,6 +149,7 @@ namespace trezor {
 
       auto response = this->client_exchange<messages::monero::MoneroWatchKey>(req);
       MTRACE("Get watch key response received");
+      device_state_idle_unsafe();
       return response;
     }
 
@@ -154,20 +159,46 @@ namespace trezor {
     {
       AUTO_LOCK_CMD();
       require_connected();
-      device_state_reset_unsafe();
+
+      std::vector<protocol::ki::MoneroTransferDetails> mtds;
+      protocol::ki::key_image_data(wallet, transfers, mtds);
+
+      if (m_ki_sync_batch_size > KI_SYNC_BATCH_SIZE){
+        try {
+          ki_sync_unsafe(transfers, mtds, ski, m_ki_sync_batch_size);
+          return;
+
+        } catch(const exc::proto::CancelledException &){
+          throw;
+        } catch(const exc::proto::PinExpectedException &){
+          throw;
+        } catch(const exc::proto::InvalidPinException &){
+          throw;
+        } catch(const exc::proto::FailureException & e){
+          MWARNING("Key image sync with " << m_ki_sync_batch_size << " outputs per message failed ("
+                   << e.what() << "), retrying with " << KI_SYNC_BATCH_SIZE);
+          m_ki_sync_batch_size = KI_SYNC_BATCH_SIZE;
+        }
+      }
+
+      ki_sync_unsafe(transfers, mtds, ski, KI_SYNC_BATCH_SIZE);
+    }
+
+    void device_trezor::ki_sync_unsafe(const std::vector<tools::wallet2::transfer_details> & transfers,
+                                       const std::vector<protocol::ki::MoneroTransferDetails> & mtds,
+                                       hw::device_cold::exported_key_image & ski,
+                                       size_t batch_size)
+    {
+      device_state_initialize_unsafe();
       require_initialized();
 
       std::shared_ptr<messages::monero::MoneroKeyImageExportInitRequest> req;
-
-      std::vector<protocol::ki::MoneroTransferDetails> mtds;
       std::vector<protocol::ki::MoneroExportedKeyImage> kis;
-      protocol::ki::key_image_data(wallet, transfers, mtds);
       protocol::ki::generate_commitment(mtds, transfers, req);
 
       this->set_msg_addr<messages::monero::MoneroKeyImageExportInitRequest>(req.get());
       auto ack1 = this->client_exchange<messages::monero::MoneroKeyImageExportInitAck>(req);
 
-      const auto batch_size = 10;
       const auto num_batches = (mtds.size() + batch_size - 1) / batch_size;
       for(uint64_t cur = 0; cur < num_batches; ++cur){
         auto step_req = std::make_shared<messages::monero::MoneroKeyImageSyncStepRequest>();
@@ -191,6 +222,7 @@ namespace trezor {
 
       auto final_req = std::make_shared<messages::monero::MoneroKeyImageSyncFinalRequest>();
       auto final_ack = this->client_exchange<messages::monero::MoneroKeyImageSyncFinalAck>(final_req);
+      device_state_idle_unsafe();
       ski.reserve(kis.size());
 
       for(auto & sub : kis){
@@ -285,7 +317,7 @@ namespace trezor {
     {
       AUTO_LOCK_CMD();
       require_connected();
-      device_state_reset_unsafe();
+      device_state_initialize_unsafe();
       require_initialized();
 
       CHECK_AND_ASSERT_THROW_MES(idx < unsigned_tx.txes.size(), "Invalid transaction index");
@@ -353,6 +385,7 @@ namespace trezor {
       auto final_msg = signer->step_final();
       auto ack_final = this->client_exchange<messages::monero::MoneroTransactionFinalAck>(final_msg);
       signer->step_final_ack(ack_final);
+      device_state_idle_unsafe();
     }
 
     void device_trezor::transaction_pre_check(std::shared_ptr<messages::monero::MoneroTransactionInitRequest> init_msg)
@@ -57,6 +57,16 @@ namespace trezor {
    */
   class device_trezor : public hw::trezor::device_trezor_base, public hw::device_cold {
     protected:
+      // Transfer details per key image sync step. The bulk size is tried first
+      // and ki_sync falls back to the conservative one if the device rejects it.
+      static const size_t KI_SYNC_BATCH_SIZE = 10;
+      static const size_t KI_SYNC_BULK_BATCH_SIZE = 64;
+      size_t m_ki_sync_batch_size;
+
+      void ki_sync_unsafe(const std::vector<::tools::wallet2::transfer_details> & transfers,
+                          const std::vector<protocol::ki::MoneroTransferDetails> & mtds,
+                          hw::device_cold::exported_key_image & ski,
+                          size_t batch_size);
       void transaction_pre_check(std::shared_ptr<messages::monero::MoneroTransactionInitRequest> init_msg);
       void transaction_check(const protocol::tx::TData & tdata, const hw::tx_aux_data & aux_data);
 
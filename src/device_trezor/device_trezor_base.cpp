@@ -43,7 +43,7 @@ namespace trezor {
 
     const uint32_t device_trezor_base::DEFAULT_BIP44_PATH[] = {0x8000002c, 0x80000080};
 
-    device_trezor_base::device_trezor_base(): m_callback(nullptr) {
+    device_trezor_base::device_trezor_base(): m_callback(nullptr), m_session_dirty(true) {
 
     }
 
@@ -141,6 +141,7 @@ namespace trezor {
     bool device_trezor_base::disconnect() {
       m_device_state.clear();
       m_features.reset();
+      m_session_dirty = true;
 
       if (m_transport){
         try {
@@ -349,10 +350,27 @@ namespace trezor {
       initMsg->release_state();
     }
 
+    void device_trezor_base::device_state_initialize_unsafe()
+    {
+      // The transport session is held for the whole connection. If the previous
+      // workflow finished cleanly the device is already idle in our session and
+      // another Initialize round trip would only cost time.
+      if (m_session_dirty || !m_features){
+        device_state_reset_unsafe();
+      } else {
+        MTRACE("Device session idle, skipping Initialize");
+      }
+
+      // Until the caller marks the workflow finished, a failure leaves the
+      // device in an unknown state and forces a reset on the next call.
+      m_session_dirty = true;
+    }
+
     void device_trezor_base::device_state_reset()
     {
       AUTO_LOCK_CMD();
       device_state_reset_unsafe();
+      device_state_idle_unsafe();
     }
 
     void device_trezor_base::on_button_request(GenericMessage & resp, const messages::common::ButtonRequest * msg)
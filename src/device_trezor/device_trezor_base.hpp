@@ -74,6 +74,7 @@ namespace trezor {
       std::vector<unsigned int> m_wallet_deriv_path;
       std::string m_device_state;  // returned after passphrase entry, session
       std::shared_ptr<messages::management::Features> m_features;  // features from the last device reset
+      bool m_session_dirty;  // a workflow is running or was aborted, Initialize is needed before the next one
 
       cryptonote::network_type network_type;
 
@@ -86,6 +87,8 @@ namespace trezor {
       void call_ping_unsafe();
       void test_ping();
       void device_state_reset_unsafe();
+      void device_state_initialize_unsafe();
+      void device_state_idle_unsafe() { m_session_dirty = false; }
       void ensure_derivation_path() noexcept;
 
       // Communication methods
@@ -34,6 +34,7 @@
  * 
  * \brief Generates a set of multisig wallets
  */
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <boost/program_options.hpp>
@@ -45,6 +46,7 @@
 #include "common/command_line.h"
 #include "common/util.h"
 #include "common/scoped_message_writer.h"
+#include "common/threadpool.h"
 #include "wallet/wallet_args.h"
 #include "wallet/wallet2.h"
 
@@ -75,11 +77,35 @@ namespace
   const command_line::arg_descriptor<bool, false> arg_testnet = {"testnet", genms::tr("Create testnet multisig wallets"), false};
   const command_line::arg_descriptor<bool, false> arg_stagenet = {"stagenet", genms::tr("Create stagenet multisig wallets"), false};
   const command_line::arg_descriptor<bool, false> arg_create_address_file = {"create-address-file", genms::tr("Create an address file for new wallets"), false};
+  const command_line::arg_descriptor<bool, false> arg_parallel = {"parallel", genms::tr("Create the participants and compute each key exchange round concurrently"), false};
 
   const command_line::arg_descriptor< std::vector<std::string> > arg_command = {"command", ""};
 }
 
-static bool generate_multisig(uint32_t threshold, uint32_t total, const std::string &basename, network_type nettype, bool create_address_file)
+// Runs f(0) ... f(count - 1), on the threadpool if parallel is set. Each
+// participant only touches its own wallet and its own slot in the shared
+// vectors, so the calls are independent; the first exception is rethrown
+// once all of them have finished.
+template<typename F>
+static void for_each_participant(size_t count, bool parallel, const F &f)
+{
+  if (!parallel)
+  {
+    for (size_t n = 0; n < count; ++n)
+      f(n);
+    return;
+  }
+  std::vector<std::string> errors(count);
+  tools::threadpool::getInstance().parallel_for(count, [&](size_t n) {
+    try { f(n); }
+    catch (const std::exception &e) { errors[n] = e.what(); if (errors[n].empty()) errors[n] = "unknown error"; }
+  });
+  for (const auto &error: errors)
+    if (!error.empty())
+      throw std::runtime_error(error);
+}
+
+static bool generate_multisig(uint32_t threshold, uint32_t total, const std::string &basename, network_type nettype, bool create_address_file, bool parallel)
 {
   tools::msg_writer() << (boost::format(genms::tr("Generating %u %u/%u multisig wallets")) % total % threshold % total).str();
 
@@ -88,35 +114,40 @@ static bool generate_multisig(uint32_t threshold, uint32_t total, const std::str
   try
   {
     // create M wallets first
+    // wallet files are written by each participant's own job, so in parallel
+    // mode the disk writes overlap with the other participants' key work
     std::vector<boost::shared_ptr<tools::wallet2>> wallets(total);
-    for (size_t n = 0; n < total; ++n)
+    for_each_participant(total, parallel, [&](size_t n)
     {
       std::string name = basename + "-" + std::to_string(n + 1);
       wallets[n].reset(new tools::wallet2(nettype, 1, false));
       wallets[n]->init("");
       wallets[n]->generate(name, pwd_container->password(), rct::rct2sk(rct::skGen()), false, false, create_address_file);
-    }
+    });
 
     // gather the keys
     std::vector<crypto::secret_key> sk(total);
     std::vector<crypto::public_key> pk(total);
-    for (size_t n = 0; n < total; ++n)
+    std::vector<char> verified(total, 0);
+    for_each_participant(total, parallel, [&](size_t n)
     {
       wallets[n]->decrypt_keys(pwd_container->password());
-      if (!tools::wallet2::verify_multisig_info(wallets[n]->get_multisig_info(), sk[n], pk[n]))
-      {
-        tools::fail_msg_writer() << genms::tr("Failed to verify multisig info");
-        return false;
-      }
+      verified[n] = tools::wallet2::verify_multisig_info(wallets[n]->get_multisig_info(), sk[n], pk[n]);
       wallets[n]->encrypt_keys(pwd_container->password());
+    });
+    if (std::find(verified.begin(), verified.end(), 0) != verified.end())
+    {
+      tools::fail_msg_writer() << genms::tr("Failed to verify multisig info");
+      return false;
     }
 
     // make the wallets multisig
     std::vector<std::string> extra_info(total);
     std::stringstream ss;
     for (size_t n = 0; n < total; ++n)
+      ss << "  " << basename << "-" << (n + 1) << std::endl;
+    for_each_participant(total, parallel, [&](size_t n)
     {
-      std::string name = basename + "-" + std::to_string(n + 1);
       std::vector<crypto::secret_key> skn;
       std::vector<crypto::public_key> pkn;
       for (size_t k = 0; k < total; ++k)
@@ -128,8 +159,7 @@ static bool generate_multisig(uint32_t threshold, uint32_t total, const std::str
         }
       }
       extra_info[n] = wallets[n]->make_multisig(pwd_container->password(), skn, pkn, threshold);
-      ss << "  " << name << std::endl;
-    }
+    });
 
     //exchange keys unless exchange_multisig_keys returns no extra info
     while (!extra_info[0].empty())
@@ -144,10 +174,10 @@ static bool generate_multisig(uint32_t threshold, uint32_t total, const std::str
           return false;
         }
       }
-      for (size_t n = 0; n < total; ++n)
+      for_each_participant(total, parallel, [&](size_t n)
       {
-          extra_info[n] = wallets[n]->exchange_multisig_keys(pwd_container->password(), pkeys, signers);
-      }
+        extra_info[n] = wallets[n]->exchange_multisig_keys(pwd_container->password(), pkeys, signers);
+      });
     }
 
     std::string address = wallets[0]->get_account().get_public_address_str(wallets[0]->nettype());
@@ -174,12 +204,13 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_params, arg_testnet);
   command_line::add_arg(desc_params, arg_stagenet);
   command_line::add_arg(desc_params, arg_create_address_file);
+  command_line::add_arg(desc_params, arg_parallel);
 
   boost::optional<po::variables_map> vm;
   bool should_terminate = false;
   std::tie(vm, should_terminate) = wallet_args::main(
    argc, argv,
-   "antd-gen-multisig [(--testnet|--stagenet)] [--filename-base=<filename>] [--scheme=M/N] [--threshold=M] [--participants=N]",
+   "antd-gen-multisig [(--testnet|--stagenet)] [--filename-base=<filename>] [--scheme=M/N] [--threshold=M] [--participants=N] [--parallel]",
     genms::tr("This program generates a set of multisig wallets - use this simpler scheme only if all the participants trust each other"),
     desc_params,
     boost::program_options::positional_options_description(),
@@ -244,7 +275,8 @@ int main(int argc, char* argv[])
   }
 
   bool create_address_file = command_line::get_arg(*vm, arg_create_address_file);
-  if (!generate_multisig(threshold, total, basename, testnet ? TESTNET : stagenet ? STAGENET : MAINNET, create_address_file))
+  bool parallel = command_line::get_arg(*vm, arg_parallel);
+  if (!generate_multisig(threshold, total, basename, testnet ? TESTNET : stagenet ? STAGENET : MAINNET, create_address_file, parallel))
     return 1;
 
   return 0;
@@ -76,11 +76,14 @@ namespace nodetool
     const command_line::arg_descriptor<bool>        arg_p2p_use_ipv6  = {"p2p-use-ipv6", "Enable IPv6 for p2p", false};
     const command_line::arg_descriptor<int64_t>     arg_out_peers = {"out-peers", "set max number of out peers", -1};
     const command_line::arg_descriptor<int64_t>     arg_in_peers = {"in-peers", "set max number of in peers", -1};
+    const command_line::arg_descriptor<uint32_t>    arg_max_concurrent_connects = {"max-concurrent-connects", "set max number of outgoing connection attempts in flight at once", P2P_DEFAULT_CONCURRENT_CONNECTS};
     const command_line::arg_descriptor<int> arg_tos_flag = {"tos-flag", "set TOS flag", -1};
 
     const command_line::arg_descriptor<int64_t> arg_limit_rate_up = {"limit-rate-up", "set limit-rate-up [kB/s]", P2P_DEFAULT_LIMIT_RATE_UP};
     const command_line::arg_descriptor<int64_t> arg_limit_rate_down = {"limit-rate-down", "set limit-rate-down [kB/s]", P2P_DEFAULT_LIMIT_RATE_DOWN};
     const command_line::arg_descriptor<int64_t> arg_limit_rate = {"limit-rate", "set limit-rate [kB/s]", -1};
+    const command_line::arg_descriptor<int64_t> arg_limit_rate_up_per_peer = {"limit-rate-up-per-peer", "set limit-rate-up for each peer, 0 for none [kB/s]", 0};
+    const command_line::arg_descriptor<int64_t> arg_limit_rate_down_per_peer = {"limit-rate-down-per-peer", "set limit-rate-down for each peer, 0 for none [kB/s]", 0};
 
     const command_line::arg_descriptor<bool> arg_save_graph = {"save-graph", "Save data for dr monero", false};
 }
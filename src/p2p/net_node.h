@@ -30,6 +30,7 @@
 
 #pragma once
 #include <array>
+#include <atomic>
 #include <boost/thread.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -48,6 +49,7 @@
 #include "math_helper.h"
 #include "net_node_common.h"
 #include "common/command_line.h"
+#include "common/alloc_profiler.h"
 
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4355)
@@ -64,6 +66,53 @@ namespace nodetool
     bool m_in_timedsync;
   };
 
+  // Hands out the candidates of one round of outgoing connection attempts
+  // to the threads making them. At most `wanted` attempts are in flight,
+  // and an attempt only gives its slot back if it failed, so the round can
+  // not make more connections than wanted. No candidate is handed out past
+  // the deadline.
+  class connect_scheduler
+  {
+  public:
+    connect_scheduler(size_t candidates, size_t wanted, uint64_t deadline):
+      m_candidates(candidates), m_deadline(deadline), m_next(0), m_slots(wanted), m_connected(0) {}
+
+    // false once the slots are taken, the candidates run out or now is past the deadline
+    bool next(size_t &index, uint64_t now)
+    {
+      if (now >= m_deadline)
+        return false;
+      size_t free_slots = m_slots.load();
+      do
+      {
+        if (free_slots == 0)
+          return false;
+      } while (!m_slots.compare_exchange_weak(free_slots, free_slots - 1));
+      index = m_next++;
+      if (index < m_candidates)
+        return true;
+      ++m_slots;
+      return false;
+    }
+
+    void done(bool connected)
+    {
+      if (connected)
+        ++m_connected;
+      else
+        ++m_slots;
+    }
+
+    size_t connected() const { return m_connected; }
+
+  private:
+    const size_t m_candidates;
+    const uint64_t m_deadline;
+    std::atomic<size_t> m_next;
+    std::atomic<size_t> m_slots;
+    std::atomic<size_t> m_connected;
+  };
+
   template<class t_payload_net_handler>
   class node_server: public epee::levin::levin_commands_handler<p2p_connection_context_t<typename t_payload_net_handler::connection_context> >,
                      public i_p2p_endpoint<typename t_payload_net_handler::connection_context>,
@@ -89,6 +138,8 @@ namespace nodetool
     m_hide_my_port(false),
     m_no_igd(false),
     m_offline(false),
+    m_replica(false),
+    m_max_concurrent_connects(P2P_DEFAULT_CONCURRENT_CONNECTS),
     m_save_graph(false),
     is_closing(false),
     m_net_server( epee::net_utils::e_connection_type_P2P ) // this is a P2P connection of the main p2p node server, because this is class node_server<>
@@ -144,8 +195,19 @@ namespace nodetool
 
     typedef COMMAND_REQUEST_STAT_INFO_T<typename t_payload_net_handler::stat_info> COMMAND_REQUEST_STAT_INFO;
 
-    CHAIN_LEVIN_INVOKE_MAP2(p2p_connection_context); //move levin_commands_handler interface invoke(...) callbacks into invoke map
-    CHAIN_LEVIN_NOTIFY_MAP2(p2p_connection_context); //move levin_commands_handler interface notify(...) callbacks into nothing
+    //move levin_commands_handler interface invoke(...) and notify(...) callbacks into invoke map, counting their allocations toward p2p
+    int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, p2p_connection_context& context)
+    {
+      ALLOC_SCOPE(p2p);
+      bool handled = false;
+      return handle_invoke_map(false, command, in_buff, buff_out, context, handled);
+    }
+    int notify(int command, const epee::span<const uint8_t> in_buff, p2p_connection_context& context)
+    {
+      ALLOC_SCOPE(p2p);
+      bool handled = false; std::string fake_str;
+      return handle_invoke_map(true, command, in_buff, fake_str, context, handled);
+    }
 
     BEGIN_INVOKE_MAP2(node_server)
       HANDLE_INVOKE_T2(COMMAND_HANDSHAKE, &node_server::handle_handshake)
@@ -176,6 +238,8 @@ namespace nodetool
     bool make_default_peer_id();
     bool make_default_config();
     bool store_config();
+    bool load_blocked_hosts(const std::string &path);
+    bool store_blocked_hosts(const std::string &path);
     bool check_trust(const proof_of_trust& tr);
 
 
@@ -213,8 +277,20 @@ namespace nodetool
     bool do_handshake_with_peer(peerid_type& pi, p2p_connection_context& context, bool just_take_peerlist = false);
     bool do_peer_timed_sync(const epee::net_utils::connection_context_base& context, peerid_type peer_id);
 
-    bool make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist);
-    bool make_new_connection_from_peerlist(bool use_white_list);
+    // a peer picked for an outgoing connection attempt
+    struct connect_candidate
+    {
+      epee::net_utils::network_address adr;
+      uint64_t last_seen;
+      uint64_t first_seen;
+      PeerType peer_type;
+    };
+
+    void collect_anchor_candidates(const std::vector<anchor_peerlist_entry>& anchor_peerlist, std::vector<connect_candidate>& candidates);
+    bool collect_peerlist_candidates(bool use_white_list, size_t count, std::vector<connect_candidate>& candidates);
+    void rank_candidates_by_latency(std::vector<connect_candidate>& candidates);
+    size_t connect_to_candidates(const std::vector<connect_candidate>& candidates, size_t wanted);
+    void record_connect_latency(const epee::net_utils::network_address& addr, bool success, uint64_t latency_ms);
     bool try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, PeerType peer_type = white, uint64_t first_seen_stamp = 0);
     size_t get_random_index_with_fixed_probability(size_t max_index);
     bool is_peer_used(const peerlist_entry& peer);
@@ -254,10 +330,12 @@ namespace nodetool
     bool set_rate_up_limit(const boost::program_options::variables_map& vm, int64_t limit);
     bool set_rate_down_limit(const boost::program_options::variables_map& vm, int64_t limit);
     bool set_rate_limit(const boost::program_options::variables_map& vm, int64_t limit);
+    bool set_peer_rate_limits(const boost::program_options::variables_map& vm, int64_t limit_up, int64_t limit_down);
 
     bool has_too_many_connections(const epee::net_utils::network_address &address);
 
     bool check_connection_and_handshake_with_peer(const epee::net_utils::network_address& na, uint64_t last_seen_stamp);
+    void probe_gray_peer(const peerlist_entry& pe);
     bool gray_peerlist_housekeeping();
     bool check_incoming_connections();
 
@@ -311,6 +389,8 @@ namespace nodetool
     bool m_hide_my_port;
     bool m_no_igd;
     bool m_offline;
+    bool m_replica; // the data dir is a primary daemon's, leave its p2p state alone
+    uint32_t m_max_concurrent_connects;
     bool m_use_ipv6;
     std::atomic<bool> m_save_graph;
     std::atomic<bool> is_closing;
@@ -347,6 +427,11 @@ namespace nodetool
     std::map<epee::net_utils::network_address, time_t> m_conn_fails_cache;
     epee::critical_section m_conn_fails_cache_lock;
 
+    // how long the last successful connect and handshake took, so the
+    // fastest known peers are tried first
+    std::map<epee::net_utils::network_address, uint64_t> m_connect_latency;
+    epee::critical_section m_connect_latency_lock;
+
     epee::critical_section m_blocked_hosts_lock;
     std::map<std::string, time_t> m_blocked_hosts;
 
@@ -378,11 +463,14 @@ namespace nodetool
     extern const command_line::arg_descriptor<bool>        arg_offline;
     extern const command_line::arg_descriptor<int64_t>     arg_out_peers;
     extern const command_line::arg_descriptor<int64_t>     arg_in_peers;
+    extern const command_line::arg_descriptor<uint32_t>    arg_max_concurrent_connects;
     extern const command_line::arg_descriptor<int> arg_tos_flag;
 
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate_up;
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate_down;
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate;
+    extern const command_line::arg_descriptor<int64_t> arg_limit_rate_up_per_peer;
+    extern const command_line::arg_descriptor<int64_t> arg_limit_rate_down_per_peer;
 
     extern const command_line::arg_descriptor<bool> arg_save_graph;
 }
@@ -32,6 +32,7 @@
 // IP blocking adapted from Boolberry
 
 #include <algorithm>
+#include <limits>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -85,10 +86,13 @@ namespace nodetool
     command_line::add_arg(desc, arg_no_igd);
     command_line::add_arg(desc, arg_out_peers);
     command_line::add_arg(desc, arg_in_peers);
+    command_line::add_arg(desc, arg_max_concurrent_connects);
     command_line::add_arg(desc, arg_tos_flag);
     command_line::add_arg(desc, arg_limit_rate_up);
     command_line::add_arg(desc, arg_limit_rate_down);
     command_line::add_arg(desc, arg_limit_rate);
+    command_line::add_arg(desc, arg_limit_rate_up_per_peer);
+    command_line::add_arg(desc, arg_limit_rate_down_per_peer);
     command_line::add_arg(desc, arg_save_graph);
   }
   //-----------------------------------------------------------------------------------
@@ -98,10 +102,17 @@ namespace nodetool
     //
     TRY_ENTRY();
     std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
+    const bool loaded = m_peerlist.load(state_file_path);
     std::ifstream p2p_data;
-    p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::in);
-    if(!p2p_data.fail())
+    if (!loaded)
+      p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::in);
+    if (loaded)
     {
+      MDEBUG("Loaded peerlist from " << state_file_path);
+    }
+    else if(!p2p_data.fail())
+    {
+      // a peerlist saved before the journaled format
       try
       {
         // first try reading in portable mode
@@ -160,6 +171,8 @@ namespace nodetool
       m_peerlist.append_with_peer_gray(e);
 #endif
 
+    load_blocked_hosts(m_config_folder + "/" + P2P_NET_BANS_FILENAME);
+
     // always recreate a new peer id
     make_default_peer_id();
 
@@ -295,8 +308,10 @@ namespace nodetool
     m_external_port = command_line::get_arg(vm, arg_p2p_external_port);
     m_allow_local_ip = command_line::get_arg(vm, arg_p2p_allow_local_ip);
     m_no_igd = command_line::get_arg(vm, arg_no_igd);
-    m_offline = command_line::get_arg(vm, cryptonote::arg_offline);
+    m_replica = !command_line::is_arg_defaulted(vm, cryptonote::arg_replica_of);
+    m_offline = command_line::get_arg(vm, cryptonote::arg_offline) || m_replica;
     m_use_ipv6 = command_line::get_arg(vm, arg_p2p_use_ipv6);
+    m_max_concurrent_connects = std::max<uint32_t>(command_line::get_arg(vm, arg_max_concurrent_connects), 1);
 
     if (command_line::has_arg(vm, arg_p2p_add_peer))
     {
@@ -368,9 +383,26 @@ namespace nodetool
     if ( !set_rate_limit(vm, command_line::get_arg(vm, arg_limit_rate) ) )
       return false;
 
+    if ( !set_peer_rate_limits(vm, command_line::get_arg(vm, arg_limit_rate_up_per_peer), command_line::get_arg(vm, arg_limit_rate_down_per_peer) ) )
+      return false;
+
     return true;
   }
   //-----------------------------------------------------------------------------------
+  // runs f on count threads, one of them the calling thread, and waits for all
+  template<typename F>
+  inline void run_concurrently(size_t count, const F &f)
+  {
+    std::vector<boost::thread> threads;
+    threads.reserve(count > 1 ? count - 1 : 0);
+    for (size_t n = 1; n < count; ++n)
+      threads.emplace_back(f);
+    if (count > 0)
+      f();
+    for (auto &t: threads)
+      t.join();
+  }
+  //-----------------------------------------------------------------------------------
   inline bool append_net_address(
       std::vector<epee::net_utils::network_address> & seed_nodes
     , std::string const & addr
@@ -711,6 +743,8 @@ namespace nodetool
       if(!m_no_igd)
         delete_upnp_port_mapping(m_listening_port);
     }
+    if (m_replica)
+      return true;
     return store_config();
   }
   //-----------------------------------------------------------------------------------
@@ -726,16 +760,12 @@ namespace nodetool
     }
 
     std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
-    std::ofstream p2p_data;
-    p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
-    if(p2p_data.fail())
+    if (!m_peerlist.store(state_file_path))
     {
       MWARNING("Failed to save config to file " << state_file_path);
       return false;
-    };
-
-    boost::archive::portable_binary_oarchive a(p2p_data);
-    a << *this;
+    }
+    store_blocked_hosts(m_config_folder + "/" + P2P_NET_BANS_FILENAME);
     return true;
     CATCH_ENTRY_L0("p2p_data::save", false);
 
@@ -743,6 +773,75 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::load_blocked_hosts(const std::string &path)
+  {
+    std::string data;
+    if (!epee::file_io_utils::load_file_to_string(path, data))
+      return false;
+
+    const size_t magic_size = sizeof(BLOCKED_HOSTS_STORAGE_MAGIC) - 1;
+    if (data.compare(0, magic_size, BLOCKED_HOSTS_STORAGE_MAGIC) != 0)
+      return false;
+    peerlist_storage::reader r{data.data() + magic_size, data.data() + data.size()};
+    uint32_t version;
+    if (!r.read_int(version) || version > CURRENT_BLOCKED_HOSTS_STORAGE_VER)
+    {
+      MWARNING("Unsupported ban list format in " << path);
+      return false;
+    }
+
+    const time_t now = time(nullptr);
+    CRITICAL_REGION_LOCAL(m_blocked_hosts_lock);
+    while (!r.empty())
+    {
+      uint8_t size;
+      std::string host;
+      uint64_t until;
+      if (!r.read_int(size) || !r.read_string(host, size) || !r.read_int(until))
+      {
+        MWARNING("Ban list in " << path << " is truncated");
+        break;
+      }
+      if ((time_t)until > now)
+        m_blocked_hosts[host] = until;
+    }
+    MDEBUG("Loaded " << m_blocked_hosts.size() << " blocked hosts from " << path);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::store_blocked_hosts(const std::string &path)
+  {
+    const std::map<std::string, time_t> blocked_hosts = get_blocked_hosts();
+    std::string data(BLOCKED_HOSTS_STORAGE_MAGIC);
+    peerlist_storage::write_int(data, (uint32_t)CURRENT_BLOCKED_HOSTS_STORAGE_VER);
+    const time_t now = time(nullptr);
+    for (const auto &e: blocked_hosts)
+    {
+      if (e.second <= now || e.first.size() > 255)
+        continue;
+      peerlist_storage::write_int(data, (uint8_t)e.first.size());
+      data += e.first;
+      peerlist_storage::write_int(data, (uint64_t)e.second);
+    }
+
+    const std::string new_path = path + ".new";
+    if (!epee::file_io_utils::save_string_to_file(new_path, data))
+    {
+      MWARNING("Failed to save ban list to " << new_path);
+      return false;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::rename(new_path, path, ec);
+    if (ec)
+    {
+      MWARNING("Failed to rename " << new_path << " to " << path << ": " << ec.message());
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::send_stop_signal()
   {
     MDEBUG("[node] sending stop signal");
@@ -983,6 +1082,7 @@ namespace nodetool
         << (last_seen_stamp ? epee::misc_utils::get_time_interval_string(time(NULL) - last_seen_stamp):"never")
         << ")...");
 
+    const uint64_t connect_start = epee::misc_utils::get_tick_count();
     typename net_server::t_connection_context con = AUTO_VAL_INIT(con);
     bool res;
     con.m_anchor = peer_type == anchor;
@@ -1011,6 +1111,7 @@ namespace nodetool
       LOG_PRINT_CC_PRIORITY_NODE(is_priority, con, "Connect failed to " << na.str()
         /*<< ", try " << try_count*/);
       //m_peerlist.set_peer_unreachable(pe);
+      record_connect_latency(na, false, 0);
       return false;
     }
 
@@ -1023,8 +1124,10 @@ namespace nodetool
       LOG_PRINT_CC_PRIORITY_NODE(is_priority, con, "Failed to HANDSHAKE with peer "
         << na.str()
         /*<< ", try " << try_count*/);
+      record_connect_latency(na, false, 0);
       return false;
     }
+    record_connect_latency(na, true, epee::misc_utils::get_tick_count() - connect_start);
 
     if(just_take_peerlist)
     {
@@ -1065,6 +1168,7 @@ namespace nodetool
         "Only IPv4 addresses are supported here");
     const epee::net_utils::ipv4_network_address &ipv4 = na.as<epee::net_utils::ipv4_network_address>();
 
+    const uint64_t connect_start = epee::misc_utils::get_tick_count();
     typename net_server::t_connection_context con = AUTO_VAL_INIT(con);
     con.m_anchor = false;
     bool res = m_net_server.connect(epee::string_tools::get_ip_string_from_int32(ipv4.ip()),
@@ -1092,6 +1196,7 @@ namespace nodetool
     }
 
     m_net_server.get_config_object().close(con.m_connection_id);
+    record_connect_latency(na, true, epee::misc_utils::get_tick_count() - connect_start);
 
     LOG_DEBUG_CC(con, "CONNECTION HANDSHAKED OK AND CLOSED.");
 
@@ -1116,7 +1221,7 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist)
+  void node_server<t_payload_net_handler>::collect_anchor_candidates(const std::vector<anchor_peerlist_entry>& anchor_peerlist, std::vector<connect_candidate>& candidates)
   {
     for (const auto& pe: anchor_peerlist) {
       _note("Considering connecting (out) to anchor peer: " << peerid_type(pe.id) << " " << pe.adr.str());
@@ -1138,52 +1243,48 @@ namespace nodetool
                                << "[peer_type=" << anchor
                                << "] first_seen: " << epee::misc_utils::get_time_interval_string(time(NULL) - pe.first_seen));
 
-      if(!try_to_connect_and_handshake_with_new_peer(pe.adr, false, 0, anchor, pe.first_seen)) {
-        _note("Handshake failed");
-        continue;
-      }
-
-      return true;
+      candidates.push_back({pe.adr, 0, static_cast<uint64_t>(pe.first_seen), anchor});
     }
-
-    return false;
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::make_new_connection_from_peerlist(bool use_white_list)
+  bool node_server<t_payload_net_handler>::collect_peerlist_candidates(bool use_white_list, size_t count, std::vector<connect_candidate>& candidates)
   {
-    size_t max_random_index = 0;
-
-    std::set<size_t> tried_peers;
+    std::set<epee::net_utils::network_address> tried_peers;
+    for (const auto &c: candidates)
+      tried_peers.insert(c.adr);
 
+    const size_t wanted = candidates.size() + count;
     size_t try_count = 0;
     size_t rand_count = 0;
-    while(rand_count < (max_random_index+1)*3 &&  try_count < 10 && !m_net_server.is_stop_signal_sent())
+    while(candidates.size() < wanted && rand_count < count*3 && try_count < count + 10 && !m_net_server.is_stop_signal_sent())
     {
       ++rand_count;
-      size_t random_index;
       const uint32_t next_needed_pruning_stripe = m_payload_handler.get_next_needed_pruning_stripe().second;
+      peerlist_entry pe = AUTO_VAL_INIT(pe);
 
-      std::deque<size_t> filtered;
-      const size_t limit = use_white_list ? 20 : std::numeric_limits<size_t>::max();
-      size_t idx = 0;
-      m_peerlist.foreach (use_white_list, [&filtered, &idx, limit, next_needed_pruning_stripe](const peerlist_entry &pe){
-        if (filtered.size() >= limit)
-          return false;
-        if (next_needed_pruning_stripe == 0 || pe.pruning_seed == 0)
-          filtered.push_back(idx);
-        else if (next_needed_pruning_stripe == tools::get_pruning_stripe(pe.pruning_seed))
-          filtered.push_front(idx);
-        ++idx;
-        return true;
-      });
-      if (filtered.empty())
-      {
-        MDEBUG("No available peer in " << (use_white_list ? "white" : "gray") << " list filtered by " << next_needed_pruning_stripe);
-        return false;
-      }
       if (use_white_list)
       {
+        size_t random_index;
+        std::deque<size_t> filtered;
+        const size_t limit = 20;
+        size_t idx = 0;
+        m_peerlist.foreach (use_white_list, [&filtered, &idx, limit, next_needed_pruning_stripe](const peerlist_entry &pe){
+          if (filtered.size() >= limit)
+            return false;
+          if (next_needed_pruning_stripe == 0 || pe.pruning_seed == 0)
+            filtered.push_back(idx);
+          else if (next_needed_pruning_stripe == tools::get_pruning_stripe(pe.pruning_seed))
+            filtered.push_front(idx);
+          ++idx;
+          return true;
+        });
+        if (filtered.empty())
+        {
+          MDEBUG("No available peer in white list filtered by " << next_needed_pruning_stripe);
+          break;
+        }
+
         // if using the white list, we first pick in the set of peers we've already been using earlier
         random_index = get_random_index_with_fixed_probability(std::min<uint64_t>(filtered.size() - 1, 20));
         CRITICAL_REGION_LOCAL(m_used_stripe_peers_mutex);
@@ -1202,23 +1303,33 @@ namespace nodetool
             }
           }
         }
+
+        CHECK_AND_ASSERT_MES(random_index < filtered.size(), false, "random_index < filtered.size() failed!!");
+        random_index = filtered[random_index];
+        CHECK_AND_ASSERT_MES(random_index < m_peerlist.get_white_peers_count(), false, "random_index < peers size failed!!");
+        bool r = m_peerlist.get_white_peer_by_index(pe, random_index);
+        CHECK_AND_ASSERT_MES(r, false, "Failed to get random peer from peerlist(white:" << use_white_list << ")");
       }
       else
-        random_index = crypto::rand<size_t>() % filtered.size();
-
-      CHECK_AND_ASSERT_MES(random_index < filtered.size(), false, "random_index < filtered.size() failed!!");
-      random_index = filtered[random_index];
-      CHECK_AND_ASSERT_MES(random_index < (use_white_list ? m_peerlist.get_white_peers_count() : m_peerlist.get_gray_peers_count()),
-          false, "random_index < peers size failed!!");
+      {
+        // the gray list is drawn from by subnet, skipping peers which do not have the stripe we need
+        bool found = false;
+        for (size_t draws = 0; draws < 16 && !found; ++draws)
+        {
+          if (!m_peerlist.get_random_gray_peer(pe))
+            break;
+          found = next_needed_pruning_stripe == 0 || pe.pruning_seed == 0 || next_needed_pruning_stripe == tools::get_pruning_stripe(pe.pruning_seed);
+        }
+        if (!found)
+        {
+          MDEBUG("No available peer in gray list filtered by " << next_needed_pruning_stripe);
+          break;
+        }
+      }
 
-      if(tried_peers.count(random_index))
+      if(!tried_peers.insert(pe.adr).second)
         continue;
 
-      tried_peers.insert(random_index);
-      peerlist_entry pe = AUTO_VAL_INIT(pe);
-      bool r = use_white_list ? m_peerlist.get_white_peer_by_index(pe, random_index):m_peerlist.get_gray_peer_by_index(pe, random_index);
-      CHECK_AND_ASSERT_MES(r, false, "Failed to get random peer from peerlist(white:" << use_white_list << ")");
-
       ++try_count;
 
       _note("Considering connecting (out) to " << (use_white_list ? "white" : "gray") << " list peer: " <<
@@ -1241,14 +1352,72 @@ namespace nodetool
                     << "[peer_list=" << (use_white_list ? white : gray)
                     << "] last_seen: " << (pe.last_seen ? epee::misc_utils::get_time_interval_string(time(NULL) - pe.last_seen) : "never"));
 
-      if(!try_to_connect_and_handshake_with_new_peer(pe.adr, false, pe.last_seen, use_white_list ? white : gray)) {
-        _note("Handshake failed");
-        continue;
+      candidates.push_back({pe.adr, static_cast<uint64_t>(pe.last_seen), 0, use_white_list ? white : gray});
+    }
+    return !candidates.empty();
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::record_connect_latency(const epee::net_utils::network_address& addr, bool success, uint64_t latency_ms)
+  {
+    CRITICAL_REGION_LOCAL(m_connect_latency_lock);
+    if (!success)
+    {
+      m_connect_latency.erase(addr);
+      return;
+    }
+    if (m_connect_latency.size() >= P2P_LOCAL_WHITE_PEERLIST_LIMIT && m_connect_latency.find(addr) == m_connect_latency.end())
+      m_connect_latency.erase(m_connect_latency.begin());
+    m_connect_latency[addr] = latency_ms;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::rank_candidates_by_latency(std::vector<connect_candidate>& candidates)
+  {
+    // peers we have timed go first, fastest first; the others keep the
+    // order they were picked in
+    std::vector<std::pair<uint64_t, size_t>> rank;
+    rank.reserve(candidates.size());
+    {
+      CRITICAL_REGION_LOCAL(m_connect_latency_lock);
+      for (const auto &c: candidates)
+      {
+        const auto it = m_connect_latency.find(c.adr);
+        rank.emplace_back(it == m_connect_latency.end() ? std::numeric_limits<uint64_t>::max() : it->second, rank.size());
       }
-
-      return true;
     }
-    return false;
+    std::stable_sort(rank.begin(), rank.end(), [](const std::pair<uint64_t, size_t> &a, const std::pair<uint64_t, size_t> &b) { return a.first < b.first; });
+    std::vector<connect_candidate> ranked;
+    ranked.reserve(candidates.size());
+    for (const auto &r: rank)
+      ranked.push_back(candidates[r.second]);
+    candidates.swap(ranked);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  size_t node_server<t_payload_net_handler>::connect_to_candidates(const std::vector<connect_candidate>& candidates, size_t wanted)
+  {
+    if (candidates.empty() || wanted == 0)
+      return 0;
+
+    // Up to m_max_concurrent_connects threads share the round's slots. Each
+    // attempt is bounded by the connect and handshake timeouts.
+    const uint64_t deadline = epee::misc_utils::get_tick_count() + 2 * (m_config.m_net_config.connection_timeout + P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT);
+    connect_scheduler scheduler(candidates.size(), wanted, deadline);
+    const auto worker = [&]() {
+      size_t i;
+      while (!m_net_server.is_stop_signal_sent() && scheduler.next(i, epee::misc_utils::get_tick_count()))
+      {
+        const connect_candidate &c = candidates[i];
+        const bool connected = !is_addr_connected(c.adr) && try_to_connect_and_handshake_with_new_peer(c.adr, false, c.last_seen, c.peer_type, c.first_seen);
+        if (!connected)
+          _note("Handshake failed");
+        scheduler.done(connected);
+      }
+    };
+
+    run_concurrently(std::min<size_t>(std::min<size_t>(wanted, candidates.size()), m_max_concurrent_connects), worker);
+    return scheduler.connected();
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -1376,17 +1545,17 @@ namespace nodetool
 
       MDEBUG("Making expected connection, type " << peer_type << ", " << conn_count << "/" << expected_connections << " connections");
 
-      if (peer_type == anchor && !make_new_connection_from_anchor_peerlist(apl)) {
-        return false;
-      }
-
-      if (peer_type == white && !make_new_connection_from_peerlist(true)) {
+      // pick a few more candidates than needed, so failed attempts have stand-ins
+      const size_t wanted = expected_connections - conn_count;
+      std::vector<connect_candidate> candidates;
+      if (peer_type == anchor)
+        collect_anchor_candidates(apl, candidates);
+      else if (!collect_peerlist_candidates(peer_type == white, wanted + m_max_concurrent_connects, candidates))
         return false;
-      }
+      rank_candidates_by_latency(candidates);
 
-      if (peer_type == gray && !make_new_connection_from_peerlist(false)) {
+      if (connect_to_candidates(candidates, wanted) == 0)
         return false;
-      }
     }
     return true;
   }
@@ -1621,9 +1790,11 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, const std::list<boost::uuids::uuid> &connections)
   {
+    // built once, every connection queues a reference to the same buffers
+    const std::vector<epee::net_utils::shared_buffer> message = epee::levin::make_notify_message(command, data_buff);
     for(const auto& c_id: connections)
     {
-      m_net_server.get_config_object().notify(command, data_buff, c_id);
+      m_net_server.get_config_object().notify(message, c_id);
     }
     return true;
   }
@@ -2109,6 +2280,23 @@ namespace nodetool
     return true;
   }
 
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::set_peer_rate_limits(const boost::program_options::variables_map& vm, int64_t limit_up, int64_t limit_down)
+  {
+    if (limit_up < 0 || limit_down < 0)
+    {
+      MERROR("Per peer rate limits can't be negative");
+      return false;
+    }
+    epee::net_utils::connection<epee::levin::async_protocol_handler<p2p_connection_context> >::set_connection_rate_up_limit(limit_up);
+    epee::net_utils::connection<epee::levin::async_protocol_handler<p2p_connection_context> >::set_connection_rate_down_limit(limit_down);
+    if (limit_up)
+      MINFO("Set limit-up per peer to " << limit_up << " kB/s");
+    if (limit_down)
+      MINFO("Set limit-down per peer to " << limit_down << " kB/s");
+    return true;
+  }
+
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::has_too_many_connections(const epee::net_utils::network_address &address)
   {
@@ -2138,15 +2326,31 @@ namespace nodetool
     if (!m_exclusive_peers.empty()) return true;
     if (m_payload_handler.needs_new_sync_connections()) return true;
 
-    peerlist_entry pe = AUTO_VAL_INIT(pe);
-
     if (m_net_server.is_stop_signal_sent())
       return false;
 
-    if (!m_peerlist.get_random_gray_peer(pe)) {
-        return true;
+    // probe a few random gray peers at once rather than one per round
+    std::vector<peerlist_entry> probes;
+    std::set<epee::net_utils::network_address> picked;
+    const size_t count = std::min<size_t>(P2P_GRAY_PEERLIST_PROBES, m_max_concurrent_connects);
+    for (size_t n = 0; n < count; ++n)
+    {
+      peerlist_entry pe = AUTO_VAL_INIT(pe);
+      if (!m_peerlist.get_random_gray_peer(pe))
+        break;
+      if (picked.insert(pe.adr).second)
+        probes.push_back(pe);
     }
 
+    std::atomic<size_t> next(0);
+    run_concurrently(probes.size(), [this, &probes, &next]() { probe_gray_peer(probes[next++]); });
+
+    return true;
+  }
+
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::probe_gray_peer(const peerlist_entry& pe)
+  {
     bool success = check_connection_and_handshake_with_peer(pe.adr, pe.last_seen);
 
     if (!success) {
@@ -2154,14 +2358,12 @@ namespace nodetool
 
       LOG_PRINT_L2("PEER EVICTED FROM GRAY PEER LIST IP address: " << pe.adr.host_str() << " Peer ID: " << peerid_type(pe.id));
 
-      return true;
+      return;
     }
 
     m_peerlist.set_peer_just_seen(pe.id, pe.adr, pe.pruning_seed);
 
     LOG_PRINT_L2("PEER PROMOTED TO WHITE PEER LIST IP address: " << pe.adr.host_str() << " Peer ID: " << peerid_type(pe.id));
-
-    return true;
   }
 
   template<class t_payload_net_handler>
@@ -33,19 +33,28 @@
 #include <list>
 #include <set>
 #include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/portable_binary_oarchive.hpp>
 #include <boost/archive/portable_binary_iarchive.hpp>
 #include <boost/serialization/version.hpp>
+#include <boost/asio/ip/address_v6.hpp>
+#include <boost/filesystem/operations.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/global_fun.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 
 
 #include "syncobj.h"
+#include "file_io_utils.h"
 #include "net/local_ip.h"
 #include "p2p_protocol_defs.h"
 #include "cryptonote_config.h"
@@ -54,9 +63,209 @@
 
 #define CURRENT_PEERLIST_STORAGE_ARCHIVE_VER    6
 
+#define PEERLIST_STORAGE_MAGIC                  "antdpeer"
+#define CURRENT_PEERLIST_STORAGE_VER            1
+#define BLOCKED_HOSTS_STORAGE_MAGIC             "antdbans"
+#define CURRENT_BLOCKED_HOSTS_STORAGE_VER       1
+#define PEERLIST_STORAGE_MIN_COMPACT_SIZE       (64 * 1024) // journal bytes we let pile up before rewriting the file
+
 namespace nodetool
 {
+  // peers are bucketed by /16 (ipv4) or /32 (ipv6), and random draws pick a
+  // bucket first, so a range of addresses flooding the peerlist does not get
+  // picked more often than a single peer elsewhere
+  inline uint64_t get_address_subnet(const epee::net_utils::network_address &address)
+  {
+    switch (address.get_type_id())
+    {
+      case epee::net_utils::ipv4_network_address::ID:
+        // in network byte order, the low two bytes are the leading octets
+        return (uint64_t(epee::net_utils::ipv4_network_address::ID) << 56) | (address.as<epee::net_utils::ipv4_network_address>().ip() & 0xffff);
+      case epee::net_utils::ipv6_network_address::ID:
+      {
+        boost::system::error_code ec;
+        const boost::asio::ip::address_v6 ip = boost::asio::ip::address_v6::from_string(address.as<epee::net_utils::ipv6_network_address>().ip(), ec);
+        if (ec)
+          break;
+        const boost::asio::ip::address_v6::bytes_type bytes = ip.to_bytes();
+        return (uint64_t(epee::net_utils::ipv6_network_address::ID) << 56) | (uint64_t(bytes[0]) << 24) | (uint64_t(bytes[1]) << 16) | (uint64_t(bytes[2]) << 8) | bytes[3];
+      }
+      default:
+        break;
+    }
+    return std::hash<std::string>()(address.host_str());
+  }
+
+  inline uint64_t get_peer_subnet(const peerlist_entry &ple)
+  {
+    return get_address_subnet(ple.adr);
+  }
+
+  struct network_address_hash
+  {
+    size_t operator()(const epee::net_utils::network_address &address) const
+    {
+      switch (address.get_type_id())
+      {
+        case epee::net_utils::ipv4_network_address::ID:
+        {
+          const epee::net_utils::ipv4_network_address &ipv4 = address.as<epee::net_utils::ipv4_network_address>();
+          return std::hash<uint64_t>()((uint64_t(ipv4.ip()) << 16) | ipv4.port());
+        }
+        case epee::net_utils::ipv6_network_address::ID:
+        {
+          const epee::net_utils::ipv6_network_address &ipv6 = address.as<epee::net_utils::ipv6_network_address>();
+          return std::hash<std::string>()(ipv6.ip()) ^ ipv6.port();
+        }
+        default:
+          return std::hash<std::string>()(address.str());
+      }
+    }
+  };
+
+  /************************************************************************/
+  /* On disk, the peerlist is a snapshot followed by a journal of changes */
+  /* appended on each save, all as the same little endian records         */
+  /************************************************************************/
+  namespace peerlist_storage
+  {
+    enum record_type : uint8_t
+    {
+      put_white = 1,
+      put_gray,
+      erase_white,
+      erase_gray,
+      put_anchor,
+      erase_anchor,
+    };
+
+    template<typename T>
+    inline void write_int(std::string &s, T v)
+    {
+      for (size_t i = 0; i < sizeof(T); ++i)
+        s.push_back((char)(uint8_t)(v >> (8 * i)));
+    }
+
+    struct reader
+    {
+      const char *p;
+      const char *end;
+
+      bool empty() const { return p == end; }
+
+      template<typename T>
+      bool read_int(T &v)
+      {
+        if ((size_t)(end - p) < sizeof(T))
+          return false;
+        v = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+          v |= T((uint8_t)p[i]) << (8 * i);
+        p += sizeof(T);
+        return true;
+      }
+
+      bool read_string(std::string &s, size_t size)
+      {
+        if ((size_t)(end - p) < size)
+          return false;
+        s.assign(p, size);
+        p += size;
+        return true;
+      }
+    };
+
+    inline bool write_address(std::string &s, const epee::net_utils::network_address &address)
+    {
+      write_int(s, address.get_type_id());
+      switch (address.get_type_id())
+      {
+        case epee::net_utils::ipv4_network_address::ID:
+        {
+          const epee::net_utils::ipv4_network_address &ipv4 = address.as<epee::net_utils::ipv4_network_address>();
+          write_int(s, ipv4.ip());
+          write_int(s, ipv4.port());
+          return true;
+        }
+        case epee::net_utils::ipv6_network_address::ID:
+        {
+          const epee::net_utils::ipv6_network_address &ipv6 = address.as<epee::net_utils::ipv6_network_address>();
+          const std::string ip = ipv6.ip();
+          if (ip.size() > 255)
+            return false;
+          write_int(s, (uint8_t)ip.size());
+          s += ip;
+          write_int(s, ipv6.port());
+          return true;
+        }
+        default:
+          return false;
+      }
+    }
+
+    inline bool read_address(reader &r, epee::net_utils::network_address &address)
+    {
+      uint8_t type;
+      if (!r.read_int(type))
+        return false;
+      switch (type)
+      {
+        case epee::net_utils::ipv4_network_address::ID:
+        {
+          uint32_t ip;
+          uint16_t port;
+          if (!r.read_int(ip) || !r.read_int(port))
+            return false;
+          address = epee::net_utils::ipv4_network_address{ip, port};
+          return true;
+        }
+        case epee::net_utils::ipv6_network_address::ID:
+        {
+          uint8_t size;
+          std::string ip;
+          uint16_t port;
+          if (!r.read_int(size) || !r.read_string(ip, size) || !r.read_int(port))
+            return false;
+          address = epee::net_utils::ipv6_network_address{ip, port};
+          return true;
+        }
+        default:
+          return false;
+      }
+    }
+
+    inline void write_peer(std::string &s, record_type type, const peerlist_entry &ple)
+    {
+      std::string record;
+      write_int(record, (uint8_t)type);
+      if (!write_address(record, ple.adr))
+        return;
+      write_int(record, ple.id);
+      write_int(record, (uint64_t)ple.last_seen);
+      write_int(record, ple.pruning_seed);
+      s += record;
+    }
 
+    inline void write_anchor(std::string &s, const anchor_peerlist_entry &ape)
+    {
+      std::string record;
+      write_int(record, (uint8_t)put_anchor);
+      if (!write_address(record, ape.adr))
+        return;
+      write_int(record, ape.id);
+      write_int(record, (uint64_t)ape.first_seen);
+      s += record;
+    }
+
+    inline void write_erase(std::string &s, record_type type, const epee::net_utils::network_address &address)
+    {
+      std::string record;
+      write_int(record, (uint8_t)type);
+      if (!write_address(record, address))
+        return;
+      s += record;
+    }
+  }
 
   /************************************************************************/
   /*                                                                      */
@@ -64,8 +273,11 @@ namespace nodetool
   class peerlist_manager
   {
   public: 
+    peerlist_manager(): m_allow_local_ip(false), m_store_snapshot(true), m_snapshot_size(0), m_journal_size(0) {}
     bool init(bool allow_local_ip);
     bool deinit();
+    bool load(const std::string &path); ///< false if there is no peerlist stored in this format at path
+    bool store(const std::string &path); ///< appends the changes since the last store, or rewrites the file when they pile up
     size_t get_white_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_white.size();}
     size_t get_gray_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_gray.size();}
     bool merge_peerlist(const std::vector<peerlist_entry>& outer_bs);
@@ -90,63 +302,20 @@ namespace nodetool
     struct by_time{};
     struct by_id{};
     struct by_addr{};
-
-    struct modify_all_but_id
-    {
-      modify_all_but_id(const peerlist_entry& ple):m_ple(ple){}
-      void operator()(peerlist_entry& e)
-      {
-        e.id = m_ple.id;
-      }
-    private:
-      const peerlist_entry& m_ple;
-    };
-
-    struct modify_all
-    {
-      modify_all(const peerlist_entry& ple):m_ple(ple){}
-      void operator()(peerlist_entry& e)
-      {
-        e = m_ple;
-      }
-    private:
-      const peerlist_entry& m_ple;
-    };
-
-    struct modify_last_seen
-    {
-      modify_last_seen(time_t last_seen):m_last_seen(last_seen){}
-      void operator()(peerlist_entry& e)
-      {
-        e.last_seen = m_last_seen;
-      }
-    private:
-      time_t m_last_seen;
-    };
-
+    struct by_subnet{};
 
     typedef boost::multi_index_container<
       peerlist_entry,
       boost::multi_index::indexed_by<
       // access by peerlist_entry::net_adress
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
+      boost::multi_index::hashed_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr>, network_address_hash >,
       // sort by peerlist_entry::last_seen<
-      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
+      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >,
+      // group by subnet of peerlist_entry::net_adress
+      boost::multi_index::hashed_non_unique<boost::multi_index::tag<by_subnet>, boost::multi_index::global_fun<const peerlist_entry&,uint64_t,&get_peer_subnet> >
       > 
     > peers_indexed;
 
-    typedef boost::multi_index_container<
-      peerlist_entry,
-      boost::multi_index::indexed_by<
-      // access by peerlist_entry::id<
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_id>, boost::multi_index::member<peerlist_entry,uint64_t,&peerlist_entry::id> >,
-      // access by peerlist_entry::net_adress
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
-      // sort by peerlist_entry::last_seen<
-      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
-      > 
-    > peers_indexed_old;
-
     typedef boost::multi_index_container<
       anchor_peerlist_entry,
       boost::multi_index::indexed_by<
@@ -156,6 +325,87 @@ namespace nodetool
       boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<anchor_peerlist_entry,int64_t,&anchor_peerlist_entry::first_seen> >
       >
     > anchor_peers_indexed;
+
+    // the peers of one list, with the subnets they are in kept in a vector
+    // so a random one can be picked in constant time
+    class peer_table
+    {
+    public:
+      typedef peers_indexed::index<by_time>::type time_index_type;
+      typedef peers_indexed::const_iterator const_iterator;
+
+      size_t size() const { return m_peers.size(); }
+      bool empty() const { return m_peers.empty(); }
+      const_iterator begin() const { return m_peers.begin(); }
+      const_iterator end() const { return m_peers.end(); }
+      const time_index_type &time_index() const { return m_peers.get<by_time>(); }
+
+      const peerlist_entry *find(const epee::net_utils::network_address &address) const
+      {
+        const auto it = m_peers.get<by_addr>().find(address);
+        return it == m_peers.get<by_addr>().end() ? nullptr : &*it;
+      }
+
+      void insert(const peerlist_entry &ple) // or update the entry with that address
+      {
+        auto &index = m_peers.get<by_addr>();
+        const auto it = index.find(ple.adr);
+        if (it != index.end())
+        {
+          index.replace(it, ple);
+          return;
+        }
+        const uint64_t subnet = get_peer_subnet(ple);
+        if (m_subnet_pos.emplace(subnet, m_subnets.size()).second)
+          m_subnets.push_back(subnet);
+        m_peers.insert(ple);
+      }
+
+      bool erase(const epee::net_utils::network_address &address)
+      {
+        auto &index = m_peers.get<by_addr>();
+        const auto it = index.find(address);
+        if (it == index.end())
+          return false;
+        const uint64_t subnet = get_peer_subnet(*it);
+        index.erase(it);
+        if (m_peers.get<by_subnet>().find(subnet) == m_peers.get<by_subnet>().end())
+        {
+          // last peer in that subnet, move the last subnet in its slot
+          const size_t pos = m_subnet_pos[subnet];
+          m_subnets[pos] = m_subnets.back();
+          m_subnet_pos[m_subnets[pos]] = pos;
+          m_subnets.pop_back();
+          m_subnet_pos.erase(subnet);
+        }
+        return true;
+      }
+
+      void clear()
+      {
+        m_peers.clear();
+        m_subnets.clear();
+        m_subnet_pos.clear();
+      }
+
+      bool get_random(peerlist_entry &pe) const
+      {
+        if (m_subnets.empty())
+          return false;
+        const uint64_t subnet = m_subnets[crypto::rand<size_t>() % m_subnets.size()];
+        const auto range = m_peers.get<by_subnet>().equal_range(subnet);
+        const size_t count = std::distance(range.first, range.second);
+        CHECK_AND_ASSERT_MES(count > 0, false, "Empty peerlist subnet");
+        pe = *std::next(range.first, crypto::rand<size_t>() % count);
+        return true;
+      }
+
+    private:
+      peers_indexed m_peers;
+      std::vector<uint64_t> m_subnets;
+      std::unordered_map<uint64_t, size_t> m_subnet_pos;
+    };
+
   public:    
     
     template <class Archive, class List, class Element, class t_version_type>
@@ -183,6 +433,7 @@ namespace nodetool
       }
     }
 
+    // peerlists from before the journaled format are still loaded this way
     template <class Archive, class t_version_type>
     void serialize(Archive &a,  const t_version_type ver)
     {
@@ -205,19 +456,27 @@ namespace nodetool
     }
 
   private: 
-    bool peers_indexed_from_old(const peers_indexed_old& pio, peers_indexed& pi);
+    void put_peer(bool white, const peerlist_entry& ple);
+    void erase_peer(bool white, const epee::net_utils::network_address& addr);
+    bool read_record(peerlist_storage::reader &r);
     void trim_white_peerlist();
     void trim_gray_peerlist();
 
     friend class boost::serialization::access;
     epee::critical_section m_peerlist_lock;
+    epee::critical_section m_store_lock;
     std::string m_config_folder;
     bool m_allow_local_ip;
 
 
-    peers_indexed m_peers_gray;
-    peers_indexed m_peers_white;
+    peer_table m_peers_gray;
+    peer_table m_peers_white;
     anchor_peers_indexed m_peers_anchor;
+
+    std::string m_journal; // records not stored yet
+    bool m_store_snapshot; // the next store rewrites the whole file
+    uint64_t m_snapshot_size;
+    uint64_t m_journal_size; // appended to the file since the snapshot
   };
   //--------------------------------------------------------------------------------------------------
   inline
@@ -233,27 +492,25 @@ namespace nodetool
     return true;
   }
   //--------------------------------------------------------------------------------------------------
-  inline 
-  bool peerlist_manager::peers_indexed_from_old(const peers_indexed_old& pio, peers_indexed& pi)
+  inline void peerlist_manager::put_peer(bool white, const peerlist_entry& ple)
   {
-    for(auto x: pio)
-    {
-      auto by_addr_it = pi.get<by_addr>().find(x.adr);
-      if(by_addr_it == pi.get<by_addr>().end())
-      {
-        pi.insert(x);
-      }
-    }
-
-    return true;
+    (white ? m_peers_white : m_peers_gray).insert(ple);
+    if (!m_store_snapshot)
+      peerlist_storage::write_peer(m_journal, white ? peerlist_storage::put_white : peerlist_storage::put_gray, ple);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline void peerlist_manager::erase_peer(bool white, const epee::net_utils::network_address& addr)
+  {
+    if ((white ? m_peers_white : m_peers_gray).erase(addr) && !m_store_snapshot)
+      peerlist_storage::write_erase(m_journal, white ? peerlist_storage::erase_white : peerlist_storage::erase_gray, addr);
   }
   //--------------------------------------------------------------------------------------------------
   inline void peerlist_manager::trim_gray_peerlist()
   {
     while(m_peers_gray.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT)
     {
-      peers_indexed::index<by_time>::type& sorted_index=m_peers_gray.get<by_time>();
-      sorted_index.erase(sorted_index.begin());
+      const epee::net_utils::network_address addr = m_peers_gray.time_index().begin()->adr;
+      erase_peer(false, addr);
     }
   }
   //--------------------------------------------------------------------------------------------------
@@ -261,9 +518,193 @@ namespace nodetool
   {
     while(m_peers_white.size() > P2P_LOCAL_WHITE_PEERLIST_LIMIT)
     {
-      peers_indexed::index<by_time>::type& sorted_index=m_peers_white.get<by_time>();
-      sorted_index.erase(sorted_index.begin());
+      const epee::net_utils::network_address addr = m_peers_white.time_index().begin()->adr;
+      erase_peer(true, addr);
+    }
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::read_record(peerlist_storage::reader &r)
+  {
+    uint8_t type;
+    epee::net_utils::network_address addr;
+    if (!r.read_int(type) || !peerlist_storage::read_address(r, addr))
+      return false;
+
+    switch (type)
+    {
+      case peerlist_storage::put_white:
+      case peerlist_storage::put_gray:
+      {
+        peerlist_entry ple;
+        uint64_t last_seen;
+        ple.adr = addr;
+        if (!r.read_int(ple.id) || !r.read_int(last_seen) || !r.read_int(ple.pruning_seed))
+          return false;
+        ple.last_seen = last_seen;
+        (type == peerlist_storage::put_white ? m_peers_white : m_peers_gray).insert(ple);
+        return true;
+      }
+      case peerlist_storage::erase_white:
+        m_peers_white.erase(addr);
+        return true;
+      case peerlist_storage::erase_gray:
+        m_peers_gray.erase(addr);
+        return true;
+      case peerlist_storage::put_anchor:
+      {
+        anchor_peerlist_entry ape;
+        uint64_t first_seen;
+        ape.adr = addr;
+        if (!r.read_int(ape.id) || !r.read_int(first_seen))
+          return false;
+        ape.first_seen = first_seen;
+        if (m_peers_anchor.get<by_addr>().find(addr) == m_peers_anchor.get<by_addr>().end())
+          m_peers_anchor.insert(ape);
+        return true;
+      }
+      case peerlist_storage::erase_anchor:
+        m_peers_anchor.get<by_addr>().erase(addr);
+        return true;
+      default:
+        return false;
+    }
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::load(const std::string &path)
+  {
+    TRY_ENTRY();
+    std::string data;
+    if (!epee::file_io_utils::load_file_to_string(path, data))
+      return false;
+
+    const size_t magic_size = sizeof(PEERLIST_STORAGE_MAGIC) - 1;
+    if (data.compare(0, magic_size, PEERLIST_STORAGE_MAGIC) != 0)
+      return false;
+    peerlist_storage::reader r{data.data() + magic_size, data.data() + data.size()};
+    uint32_t version;
+    if (!r.read_int(version) || version > CURRENT_PEERLIST_STORAGE_VER)
+    {
+      MWARNING("Unsupported peerlist format in " << path);
+      return false;
+    }
+
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    m_peers_white.clear();
+    m_peers_gray.clear();
+    m_peers_anchor.clear();
+    size_t records = 0;
+    bool complete = true;
+    while (!r.empty())
+    {
+      if (!read_record(r))
+      {
+        // most likely a save cut short, what came before is still good
+        MWARNING("Peerlist in " << path << " is truncated after " << records << " records");
+        complete = false;
+        break;
+      }
+      ++records;
+    }
+
+    m_journal.clear();
+    m_store_snapshot = true;
+    trim_white_peerlist();
+    trim_gray_peerlist();
+
+    // compact on the next store if there is more history than peers
+    const size_t live = m_peers_white.size() + m_peers_gray.size() + m_peers_anchor.size();
+    m_store_snapshot = !complete || records > 2 * live;
+    m_snapshot_size = data.size();
+    m_journal_size = 0;
+    return true;
+    CATCH_ENTRY_L0("peerlist_manager::load()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::store(const std::string &path)
+  {
+    TRY_ENTRY();
+    // stores run one at a time, but the file is written without holding
+    // m_peerlist_lock so peers keep coming and going meanwhile
+    CRITICAL_REGION_LOCAL(m_store_lock);
+
+    std::string data;
+    bool snapshot;
+    {
+      CRITICAL_REGION_LOCAL1(m_peerlist_lock);
+      if (m_journal_size + m_journal.size() > std::max<uint64_t>(m_snapshot_size, PEERLIST_STORAGE_MIN_COMPACT_SIZE))
+        m_store_snapshot = true;
+
+      snapshot = m_store_snapshot;
+      if (snapshot)
+      {
+        data = PEERLIST_STORAGE_MAGIC;
+        peerlist_storage::write_int(data, (uint32_t)CURRENT_PEERLIST_STORAGE_VER);
+        for (const peerlist_entry &ple: m_peers_white.time_index())
+          peerlist_storage::write_peer(data, peerlist_storage::put_white, ple);
+        for (const peerlist_entry &ple: m_peers_gray.time_index())
+          peerlist_storage::write_peer(data, peerlist_storage::put_gray, ple);
+        for (const anchor_peerlist_entry &ape: m_peers_anchor.get<by_time>())
+          peerlist_storage::write_anchor(data, ape);
+        // changes from here on are journaled on top of this snapshot
+        m_journal.clear();
+        m_store_snapshot = false;
+      }
+      else
+      {
+        if (m_journal.empty())
+          return true;
+        data.swap(m_journal);
+      }
+    }
+
+    if (snapshot)
+    {
+      // written aside and renamed, so a crash leaves either the old or the new file
+      const std::string new_path = path + ".new";
+      bool saved = epee::file_io_utils::save_string_to_file(new_path, data);
+      if (!saved)
+      {
+        MWARNING("Failed to save peerlist to " << new_path);
+      }
+      else
+      {
+        boost::system::error_code ec;
+        boost::filesystem::rename(new_path, path, ec);
+        if (ec)
+        {
+          MWARNING("Failed to rename " << new_path << " to " << path << ": " << ec.message());
+          saved = false;
+        }
+      }
+
+      CRITICAL_REGION_LOCAL1(m_peerlist_lock);
+      if (!saved)
+      {
+        m_store_snapshot = true;
+        return false;
+      }
+      m_snapshot_size = data.size();
+      m_journal_size = 0;
+      return true;
+    }
+
+    std::ofstream file;
+    file.open(path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+    file.write(data.data(), data.size());
+    file.close();
+    CRITICAL_REGION_LOCAL1(m_peerlist_lock);
+    if (file.fail())
+    {
+      MWARNING("Failed to append peerlist changes to " << path);
+      m_store_snapshot = true; // the tail may be partly written, start over next time
+      return false;
     }
+    m_journal_size += data.size();
+    return true;
+    CATCH_ENTRY_L0("peerlist_manager::store()", false);
   }
   //--------------------------------------------------------------------------------------------------
   inline 
@@ -286,7 +727,7 @@ namespace nodetool
     if(i >= m_peers_white.size())
       return false;
 
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_white.get<by_time>();
+    const peer_table::time_index_type& by_time_index = m_peers_white.time_index();
     p = *epee::misc_utils::move_it_backward(--by_time_index.end(), i);    
     return true;
   }
@@ -298,7 +739,7 @@ namespace nodetool
     if(i >= m_peers_gray.size())
       return false;
 
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
+    const peer_table::time_index_type& by_time_index = m_peers_gray.time_index();
     p = *epee::misc_utils::move_it_backward(--by_time_index.end(), i);    
     return true;
   }
@@ -321,10 +762,10 @@ namespace nodetool
   {
     
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index=m_peers_white.get<by_time>();
+    const peer_table::time_index_type& by_time_index=m_peers_white.time_index();
     uint32_t cnt = 0;
     bs_head.reserve(depth);
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index))
+    for(const peerlist_entry& vl: boost::adaptors::reverse(by_time_index))
     {
       if(!vl.last_seen)
         continue;
@@ -341,16 +782,16 @@ namespace nodetool
   bool peerlist_manager::get_peerlist_full(std::vector<peerlist_entry>& pl_gray, std::vector<peerlist_entry>& pl_white)
   {    
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index_gr=m_peers_gray.get<by_time>();
-    pl_gray.resize(pl_gray.size() + by_time_index_gr.size());
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index_gr))
+    const peer_table::time_index_type& by_time_index_gr=m_peers_gray.time_index();
+    pl_gray.reserve(pl_gray.size() + by_time_index_gr.size());
+    for(const peerlist_entry& vl: boost::adaptors::reverse(by_time_index_gr))
     {
       pl_gray.push_back(vl);      
     }
 
-    peers_indexed::index<by_time>::type& by_time_index_wt=m_peers_white.get<by_time>();
-    pl_white.resize(pl_white.size() + by_time_index_wt.size());
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index_wt))
+    const peer_table::time_index_type& by_time_index_wt=m_peers_white.time_index();
+    pl_white.reserve(pl_white.size() + by_time_index_wt.size());
+    for(const peerlist_entry& vl: boost::adaptors::reverse(by_time_index_wt))
     {
       pl_white.push_back(vl);      
     }
@@ -362,8 +803,8 @@ namespace nodetool
   bool peerlist_manager::foreach(bool white, const F &f)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index = white ? m_peers_white.get<by_time>() : m_peers_gray.get<by_time>();
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index))
+    const peer_table::time_index_type& by_time_index = white ? m_peers_white.time_index() : m_peers_gray.time_index();
+    for(const peerlist_entry& vl: boost::adaptors::reverse(by_time_index))
       if (!f(vl))
         return false;
     return true;
@@ -392,24 +833,11 @@ namespace nodetool
       return true;
 
      CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt == m_peers_white.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_white.insert(ple);
-      trim_white_peerlist();
-    }else
-    {
-      //update record in white list 
-      m_peers_white.replace(by_addr_it_wt, ple);      
-    }
+    //put new record into white list, or update it
+    put_peer(true, ple);
+    trim_white_peerlist();
     //remove from gray list, if need
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr != m_peers_gray.get<by_addr>().end())
-    {
-      m_peers_gray.erase(by_addr_it_gr);
-    }
+    erase_peer(false, ple.adr);
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_white()", false);
   }
@@ -423,22 +851,18 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
     //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt != m_peers_white.get<by_addr>().end())
+    if(m_peers_white.find(ple.adr))
+      return true;
+
+    //peers are mostly told about again unchanged, leave those alone
+    const peerlist_entry *existing = m_peers_gray.find(ple.adr);
+    if(existing && existing->id == ple.id && existing->last_seen == ple.last_seen && existing->pruning_seed == ple.pruning_seed)
       return true;
 
     //update gray list
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr == m_peers_gray.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_gray.insert(ple);
-      trim_gray_peerlist();    
-    }else
-    {
-      //update record in white list 
-      m_peers_gray.replace(by_addr_it_gr, ple);      
-    }
+    put_peer(false, ple);
+    if(!existing)
+      trim_gray_peerlist();
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_gray()", false);
   }
@@ -454,6 +878,8 @@ namespace nodetool
 
     if(by_addr_it_anchor == m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.insert(ple);
+      if (!m_store_snapshot)
+        peerlist_storage::write_anchor(m_journal, ple);
     }
 
     return true;
@@ -468,16 +894,7 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
 
-    if (m_peers_gray.empty()) {
-      return false;
-    }
-
-    size_t random_index = crypto::rand<size_t>() % m_peers_gray.size();
-
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-    pe = *epee::misc_utils::move_it_backward(--by_time_index.end(), random_index);
-
-    return true;
+    return m_peers_gray.get_random(pe);
 
     CATCH_ENTRY_L0("peerlist_manager::get_random_gray_peer()", false);
   }
@@ -489,11 +906,7 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
 
-    peers_indexed::index_iterator<by_addr>::type iterator = m_peers_white.get<by_addr>().find(pe.adr);
-
-    if (iterator != m_peers_white.get<by_addr>().end()) {
-      m_peers_white.erase(iterator);
-    }
+    erase_peer(true, pe.adr);
 
     return true;
 
@@ -507,11 +920,7 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
 
-    peers_indexed::index_iterator<by_addr>::type iterator = m_peers_gray.get<by_addr>().find(pe.adr);
-
-    if (iterator != m_peers_gray.get<by_addr>().end()) {
-      m_peers_gray.erase(iterator);
-    }
+    erase_peer(false, pe.adr);
 
     return true;
 
@@ -528,8 +937,10 @@ namespace nodetool
     auto begin = m_peers_anchor.get<by_time>().begin();
     auto end = m_peers_anchor.get<by_time>().end();
 
-    std::for_each(begin, end, [&apl](const anchor_peerlist_entry &a) {
+    std::for_each(begin, end, [this, &apl](const anchor_peerlist_entry &a) {
       apl.push_back(a);
+      if (!m_store_snapshot)
+        peerlist_storage::write_erase(m_journal, peerlist_storage::erase_anchor, a.adr);
     });
 
     m_peers_anchor.get<by_time>().clear();
@@ -550,6 +961,8 @@ namespace nodetool
 
     if (iterator != m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.erase(iterator);
+      if (!m_store_snapshot)
+        peerlist_storage::write_erase(m_journal, peerlist_storage::erase_anchor, addr);
     }
 
     return true;
@@ -34,6 +34,7 @@
 #include "misc_log_ex.h"
 #include "span.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "cryptonote_config.h"
 extern "C"
 {
@@ -59,6 +60,10 @@ extern "C"
 #define STRAUS_SIZE_LIMIT 232
 #define PIPPENGER_SIZE_LIMIT 0
 
+// below these sizes, the prover's folding rounds are not worth farming out to the threadpool
+#define PARALLEL_FOLD_MIN_CHUNK 16
+#define PARALLEL_LR_MIN_SIZE 32
+
 namespace rct
 {
 
@@ -89,7 +94,7 @@ static inline rct::key multiexp(const std::vector<MultiexpData> &data, size_t Hi
     return HiGi_size <= 232 && data.size() == HiGi_size ? straus(data, straus_HiGi_cache, 0) : pippenger(data, pippenger_HiGi_cache, HiGi_size, get_pippenger_c(data.size()));
   }
   else
-    return data.size() <= 95 ? straus(data, NULL, 0) : pippenger(data, NULL, 0, get_pippenger_c(data.size()));
+    return data.size() <= get_straus_limit() ? straus(data, NULL, 0) : pippenger(data, NULL, 0, get_pippenger_c(data.size()));
 }
 
 static inline bool is_reduced(const rct::key &scalar)
@@ -248,20 +253,59 @@ static rct::keyV hadamard(const rct::keyV &a, const rct::keyV &b)
   return res;
 }
 
+/* runs f(start, stop) over [0, size), split over the threadpool if large enough; f must not throw */
+template<typename F>
+static void run_chunked(size_t size, size_t min_chunk, const F &f)
+{
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  const size_t threads = tpool.get_max_concurrency();
+  if (threads <= 1 || size < 2 * min_chunk)
+  {
+    f(0, size);
+    return;
+  }
+  const size_t chunks = std::min<size_t>(threads, size / min_chunk);
+  const size_t chunk_size = (size + chunks - 1) / chunks;
+  tools::threadpool::waiter waiter;
+  for (size_t start = chunk_size; start < size; start += chunk_size)
+  {
+    const size_t stop = std::min(start + chunk_size, size);
+    tpool.submit(&waiter, [&f, start, stop](){ f(start, stop); }, true);
+  }
+  f(0, chunk_size);
+  waiter.wait(&tpool);
+}
+
 /* folds a curvepoint array using a two way scaled Hadamard product */
 static void hadamard_fold(std::vector<ge_p3> &v, const rct::keyV *scale, const rct::key &a, const rct::key &b)
+{
+  CHECK_AND_ASSERT_THROW_MES((v.size() & 1) == 0, "Vector size should be even");
+  const size_t sz = v.size() / 2;
+  run_chunked(sz, PARALLEL_FOLD_MIN_CHUNK, [&](size_t start, size_t stop) {
+    for (size_t n = start; n < stop; ++n)
+    {
+      ge_dsmp c[2];
+      ge_dsm_precomp(c[0], &v[n]);
+      ge_dsm_precomp(c[1], &v[sz + n]);
+      rct::key sa, sb;
+      if (scale) sc_mul(sa.bytes, a.bytes, (*scale)[n].bytes); else sa = a;
+      if (scale) sc_mul(sb.bytes, b.bytes, (*scale)[sz + n].bytes); else sb = b;
+      ge_double_scalarmult_precomp_vartime2_p3(&v[n], sa.bytes, c[0], sb.bytes, c[1]);
+    }
+  });
+  v.resize(sz);
+}
+
+/* folds a scalar array in place: v[n] = v[n] * a + v[sz + n] * b */
+static void scalar_fold(rct::keyV &v, const rct::key &a, const rct::key &b)
 {
   CHECK_AND_ASSERT_THROW_MES((v.size() & 1) == 0, "Vector size should be even");
   const size_t sz = v.size() / 2;
   for (size_t n = 0; n < sz; ++n)
   {
-    ge_dsmp c[2];
-    ge_dsm_precomp(c[0], &v[n]);
-    ge_dsm_precomp(c[1], &v[sz + n]);
-    rct::key sa, sb;
-    if (scale) sc_mul(sa.bytes, a.bytes, (*scale)[n].bytes); else sa = a;
-    if (scale) sc_mul(sb.bytes, b.bytes, (*scale)[sz + n].bytes); else sb = b;
-    ge_double_scalarmult_precomp_vartime2_p3(&v[n], sa.bytes, c[0], sb.bytes, c[1]);
+    rct::key tmp;
+    sc_mul(tmp.bytes, v[sz + n].bytes, b.bytes);
+    sc_muladd(v[n].bytes, v[n].bytes, a.bytes, tmp.bytes);
   }
   v.resize(sz);
 }
@@ -721,10 +765,29 @@ try_again:
 
     // PAPER LINES 18-19
     PERF_TIMER_START_BP(PROVE_LR);
-    sc_mul(tmp.bytes, cL.bytes, x_ip.bytes);
-    L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmp);
-    sc_mul(tmp.bytes, cR.bytes, x_ip.bytes);
-    R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmp);
+    rct::key tmpL, tmpR;
+    sc_mul(tmpL.bytes, cL.bytes, x_ip.bytes);
+    sc_mul(tmpR.bytes, cR.bytes, x_ip.bytes);
+    if (nprime >= PARALLEL_LR_MIN_SIZE && tools::threadpool::getInstance().get_max_concurrency() > 1)
+    {
+      // L and R are independent multiexps of the same size
+      tools::threadpool &tpool = tools::threadpool::getInstance();
+      tools::threadpool::waiter waiter;
+      bool R_failed = false;
+      tpool.submit(&waiter, [&](){
+        try { R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmpR); }
+        catch (...) { R_failed = true; }
+      }, true);
+      try { L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmpL); }
+      catch (...) { waiter.wait(&tpool); throw; }
+      waiter.wait(&tpool);
+      CHECK_AND_ASSERT_THROW_MES(!R_failed, "Failed to compute R");
+    }
+    else
+    {
+      L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmpL);
+      R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmpR);
+    }
     PERF_TIMER_STOP_BP(PROVE_LR);
 
     // PAPER LINES 21-22
@@ -748,8 +811,8 @@ try_again:
 
     // PAPER LINES 28-29
     PERF_TIMER_START_BP(PROVE_prime);
-    aprime = vector_add(vector_scalar(slice(aprime, 0, nprime), w[round]), vector_scalar(slice(aprime, nprime, aprime.size()), winv));
-    bprime = vector_add(vector_scalar(slice(bprime, 0, nprime), winv), vector_scalar(slice(bprime, nprime, bprime.size()), w[round]));
+    scalar_fold(aprime, w[round], winv);
+    scalar_fold(bprime, winv, w[round]);
     PERF_TIMER_STOP_BP(PROVE_prime);
 
     scale = NULL;
@@ -28,6 +28,9 @@
 //
 // Adapted from Python code by Sarang Noether
 
+#include <fstream>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include "misc_log_ex.h"
 #include "common/perf_timer.h"
 extern "C"
@@ -561,16 +564,106 @@ skipfirst:
   return res;
 }
 
+multiexp_tuning::multiexp_tuning(): straus_limit(95), pippenger_c_limit{13, 29, 83, 185, 465, 1180, 2295}
+{
+}
+
+bool multiexp_tuning::is_valid() const
+{
+  for (size_t i = 1; i < sizeof(pippenger_c_limit) / sizeof(pippenger_c_limit[0]); ++i)
+    if (pippenger_c_limit[i] < pippenger_c_limit[i - 1])
+      return false;
+  return true;
+}
+
+static boost::mutex tuning_mutex;
+
+static multiexp_tuning &get_tuning_instance()
+{
+  static multiexp_tuning tuning = []() {
+    multiexp_tuning t;
+    const char *env = getenv("ANTD_MULTIEXP_TUNING");
+    if (env && *env)
+    {
+      if (load_multiexp_tuning(env, t))
+        MINFO("Loaded multiexp tuning from " << env);
+      else
+        MWARNING("Failed to load multiexp tuning from " << env << ", using defaults");
+    }
+    return t;
+  }();
+  return tuning;
+}
+
+multiexp_tuning get_multiexp_tuning()
+{
+  boost::lock_guard<boost::mutex> lock(tuning_mutex);
+  return get_tuning_instance();
+}
+
+void set_multiexp_tuning(const multiexp_tuning &tuning)
+{
+  CHECK_AND_ASSERT_THROW_MES(tuning.is_valid(), "Invalid multiexp tuning");
+  boost::lock_guard<boost::mutex> lock(tuning_mutex);
+  get_tuning_instance() = tuning;
+}
+
+bool load_multiexp_tuning(const std::string &filename, multiexp_tuning &tuning)
+{
+  std::ifstream f(filename);
+  if (!f)
+    return false;
+  multiexp_tuning t;
+  std::string name;
+  while (f >> name)
+  {
+    if (name == "straus_limit")
+      f >> t.straus_limit;
+    else if (name == "pippenger_c_limits")
+      for (size_t &limit: t.pippenger_c_limit)
+        f >> limit;
+    else
+      return false;
+    if (!f)
+      return false;
+  }
+  if (!t.is_valid())
+    return false;
+  tuning = t;
+  return true;
+}
+
+bool save_multiexp_tuning(const std::string &filename, const multiexp_tuning &tuning)
+{
+  std::ofstream f(filename);
+  if (!f)
+    return false;
+  f << "straus_limit " << tuning.straus_limit << std::endl;
+  f << "pippenger_c_limits";
+  for (size_t limit: tuning.pippenger_c_limit)
+    f << " " << limit;
+  f << std::endl;
+  return !!f;
+}
+
+size_t get_straus_limit()
+{
+  boost::lock_guard<boost::mutex> lock(tuning_mutex);
+  return get_tuning_instance().straus_limit;
+}
+
 size_t get_pippenger_c(size_t N)
 {
-  if (N <= 13) return 2;
-  if (N <= 29) return 3;
-  if (N <= 83) return 4;
-  if (N <= 185) return 5;
-  if (N <= 465) return 6;
-  if (N <= 1180) return 7;
-  if (N <= 2295) return 8;
-  return 9;
+  boost::lock_guard<boost::mutex> lock(tuning_mutex);
+  const multiexp_tuning &tuning = get_tuning_instance();
+  size_t c = 2;
+  for (size_t limit: tuning.pippenger_c_limit)
+  {
+    if (N <= limit)
+      return c;
+    ++c;
+  }
+  return c;
 }
 
 struct pippenger_cached_data
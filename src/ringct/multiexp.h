@@ -33,6 +33,7 @@
 #ifndef MULTIEXP_H
 #define MULTIEXP_H
 
+#include <string>
 #include <vector>
 #include "crypto/crypto.h"
 #include "rctTypes.h"
@@ -56,6 +57,18 @@ struct MultiexpData {
 struct straus_cached_data;
 struct pippenger_cached_data;
 
+// Size thresholds used to choose a multiexp algorithm. The defaults were measured
+// on one desktop CPU; performance_tests --calibrate-multiexp measures them on the
+// host and writes a file that ANTD_MULTIEXP_TUNING can point at.
+struct multiexp_tuning
+{
+  size_t straus_limit; // uncached straus is used up to this many points, pippenger above
+  size_t pippenger_c_limit[7]; // pippenger uses c = i + 2 up to pippenger_c_limit[i] points, c = 9 above
+
+  multiexp_tuning();
+  bool is_valid() const;
+};
+
 rct::key bos_coster_heap_conv(std::vector<MultiexpData> data);
 rct::key bos_coster_heap_conv_robust(std::vector<MultiexpData> data);
 std::shared_ptr<straus_cached_data> straus_init_cache(const std::vector<MultiexpData> &data, size_t N =0);
@@ -64,6 +77,11 @@ rct::key straus(const std::vector<MultiexpData> &data, const std::shared_ptr<str
 std::shared_ptr<pippenger_cached_data> pippenger_init_cache(const std::vector<MultiexpData> &data, size_t start_offset = 0, size_t N =0);
 size_t pippenger_get_cache_size(const std::shared_ptr<pippenger_cached_data> &cache);
 size_t get_pippenger_c(size_t N);
+size_t get_straus_limit();
+multiexp_tuning get_multiexp_tuning();
+void set_multiexp_tuning(const multiexp_tuning &tuning);
+bool load_multiexp_tuning(const std::string &filename, multiexp_tuning &tuning);
+bool save_multiexp_tuning(const std::string &filename, const multiexp_tuning &tuning);
 rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<pippenger_cached_data> &cache = NULL, size_t cache_size = 0, size_t c = 0);
 
 }
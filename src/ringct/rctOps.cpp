@@ -219,6 +219,22 @@ static const zero_commitment zero_commitments[] = {
   { (uint64_t)10000000000000000000ull, {{0x65, 0x8d, 0x1, 0x37, 0x6d, 0x18, 0x63, 0xe7, 0x7b, 0x9, 0x6f, 0x98, 0xe6, 0xe5, 0x13, 0xc2, 0x4, 0x10, 0xf5, 0xc7, 0xfb, 0x18, 0xa6, 0xe5, 0x9a, 0x52, 0x66, 0x84, 0x5c, 0xd9, 0xb1, 0xe3}} },
 };
 
+namespace
+{
+    // Fixed-base table for H, laid out like ge_base is for G, built on first use
+    struct H_precomp_table
+    {
+        ge_precomp table[32][8];
+        H_precomp_table() { ge_precomp_table_init(table, &ge_p3_H); }
+    };
+
+    const H_precomp_table &get_H_precomp_table()
+    {
+        static const H_precomp_table table;
+        return table;
+    }
+}
+
 namespace rct {
 
     //Various key initialization functions
@@ -389,9 +405,15 @@ namespace rct {
 
     //Computes aH where H= toPoint(cn_fast_hash(G)), G the basepoint
     key scalarmultH(const key & a) {
+        key aP;
+        if (a.bytes[31] <= 127) {
+            ge_p3 R;
+            ge_scalarmult_base_precomp(&R, a.bytes, get_H_precomp_table().table);
+            ge_p3_tobytes(aP.bytes, &R);
+            return aP;
+        }
         ge_p2 R;
         ge_scalarmult(&R, a.bytes, &ge_p3_H);
-        key aP;
         ge_tobytes(aP.bytes, &R);
         return aP;
     }
@@ -467,6 +489,19 @@ namespace rct {
     //aGbB = aG + bB where a, b are scalars, G is the basepoint and B is a point
     void addKeys2(key &aGbB, const key &a, const key &b, const key & B) {
         ge_p2 rv;
+        if (B == H && a.bytes[31] <= 127 && b.bytes[31] <= 127) {
+            // commitments: both bases have fixed-base tables
+            ge_p3 aG, bH;
+            ge_cached bHc;
+            ge_p1p1 sum;
+            ge_scalarmult_base(&aG, a.bytes);
+            ge_scalarmult_base_precomp(&bH, b.bytes, get_H_precomp_table().table);
+            ge_p3_to_cached(&bHc, &bH);
+            ge_add(&sum, &aG, &bHc);
+            ge_p1p1_to_p2(&rv, &sum);
+            ge_tobytes(aGbB.bytes, &rv);
+            return;
+        }
         ge_p3 B2;
         CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&B2, B.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
         ge_double_scalarmult_base_vartime(&rv, b.bytes, &B2, a.bytes);
@@ -28,6 +28,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <deque>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include "misc_log_ex.h"
 #include "common/perf_timer.h"
 #include "common/threadpool.h"
@@ -78,6 +82,78 @@ namespace
 
         return rct::Bulletproof{rct::keyV(n_outs, I), I, I, I, I, I, I, rct::keyV(nrl, I), rct::keyV(nrl, I), I, I, I};
     }
+
+    // Popular outputs show up as ring members in many transactions, so CLSAG
+    // verification keeps the precomputed forms of P and Hp(P) for recently seen
+    // members. Bounded at SHARDS * SHARD_SIZE entries (about 2.5 kB each), evicted
+    // oldest first; shards keep verifier threads from contending on one lock.
+    struct ring_member_precomp
+    {
+        rct::geDsmp P;
+        rct::geDsmp Hp;
+    };
+
+    class ring_member_cache
+    {
+    public:
+        bool get(const rct::key &P, ring_member_precomp &precomp)
+        {
+            shard_t &shard = get_shard(P);
+            boost::lock_guard<boost::mutex> lock(shard.mutex);
+            const auto i = shard.entries.find(P);
+            if (i == shard.entries.end())
+                return false;
+            precomp = i->second;
+            return true;
+        }
+
+        void add(const rct::key &P, const ring_member_precomp &precomp)
+        {
+            shard_t &shard = get_shard(P);
+            boost::lock_guard<boost::mutex> lock(shard.mutex);
+            if (!shard.entries.emplace(P, precomp).second)
+                return;
+            shard.order.push_back(P);
+            if (shard.order.size() > SHARD_SIZE)
+            {
+                shard.entries.erase(shard.order.front());
+                shard.order.pop_front();
+            }
+        }
+
+    private:
+        static constexpr size_t SHARDS = 16;
+        static constexpr size_t SHARD_SIZE = 512;
+
+        struct shard_t
+        {
+            boost::mutex mutex;
+            std::unordered_map<rct::key, ring_member_precomp> entries;
+            std::deque<rct::key> order;
+        };
+
+        shard_t &get_shard(const rct::key &P) { return shards[P.bytes[0] % SHARDS]; }
+
+        shard_t shards[SHARDS];
+    };
+
+    ring_member_cache &get_ring_member_cache()
+    {
+        static ring_member_cache cache;
+        return cache;
+    }
+
+    void get_ring_member_precomp(const rct::key &P, ring_member_precomp &precomp)
+    {
+        ring_member_cache &cache = get_ring_member_cache();
+        if (cache.get(P, precomp))
+            return;
+        ge_p3 Hp_p3;
+        rct::precomp(precomp.P.k, P);
+        rct::hash_to_p3(Hp_p3, P);
+        ge_dsm_precomp(precomp.Hp.k, &Hp_p3);
+        cache.add(P, precomp);
+    }
 }
 
 namespace rct {
@@ -570,15 +646,15 @@ namespace rct {
       hashes.push_back(rv.message);
       crypto::hash h;
 
-      std::stringstream ss;
-      binary_archive<true> ba(ss);
+      cryptonote::blobdata &blob = cryptonote::get_hashing_buffer();
+      binary_archive<true> ba(blob);
       CHECK_AND_ASSERT_THROW_MES(!rv.mixRing.empty(), "Empty mixRing");
       const size_t inputs = is_rct_simple(rv.type) ? rv.mixRing.size() : rv.mixRing[0].size();
       const size_t outputs = rv.ecdhInfo.size();
       key prehash;
       CHECK_AND_ASSERT_THROW_MES(const_cast<rctSig&>(rv).serialize_rctsig_base(ba, inputs, outputs),
           "Failed to serialize rctSigBase");
-      cryptonote::get_blob_hash(ss.str(), h);
+      cryptonote::get_blob_hash(blob, h);
       hashes.push_back(hash2rct(h));
 
       keyV kv;
@@ -619,7 +695,7 @@ namespace rct {
         }
       }
       hashes.push_back(cn_fast_hash(kv));
-      hwdev.mlsag_prehash(ss.str(), inputs, outputs, hashes, rv.outPk, prehash);
+      hwdev.mlsag_prehash(blob, inputs, outputs, hashes, rv.outPk, prehash);
       return  prehash;
     }
 
@@ -891,12 +967,9 @@ namespace rct {
             key c_new;
             key L;
             key R;
-            geDsmp P_precomp;
+            ring_member_precomp member;
             geDsmp C_precomp;
-            geDsmp H_precomp;
             size_t i = 0;
-            ge_p3 hash8_p3;
-            geDsmp hash_precomp;
             ge_p3 temp_p3;
             ge_p1p1 temp_p1;
 
@@ -906,7 +979,7 @@ namespace rct {
                 sc_mul(c_c.bytes,mu_C.bytes,c.bytes);
 
                 // Precompute points for L/R
-                precomp(P_precomp.k,pubs[i].dest);
+                get_ring_member_precomp(pubs[i].dest, member);
 
                 CHECK_AND_ASSERT_MES(ge_frombytes_vartime(&temp_p3, pubs[i].mask.bytes) == 0, false, "point conv failed");
                 ge_sub(&temp_p1,&temp_p3,&C_offset_cached);
@@ -914,12 +987,10 @@ namespace rct {
                 ge_dsm_precomp(C_precomp.k,&temp_p3);
 
                 // Compute L
-                addKeys_aGbBcC(L,sig.s[i],c_p,P_precomp.k,c_c,C_precomp.k);
+                addKeys_aGbBcC(L,sig.s[i],c_p,member.P.k,c_c,C_precomp.k);
 
                 // Compute R
-                hash_to_p3(hash8_p3,pubs[i].dest);
-                ge_dsm_precomp(hash_precomp.k, &hash8_p3);
-                addKeys_aAbBcC(R,sig.s[i],hash_precomp.k,c_p,I_precomp.k,c_c,D_precomp.k);
+                addKeys_aAbBcC(R,sig.s[i],member.Hp.k,c_p,I_precomp.k,c_c,D_precomp.k);
 
                 c_to_hash[2*n+3] = L;
                 c_to_hash[2*n+4] = R;
@@ -1214,16 +1285,38 @@ namespace rct {
             msout->c.resize(inamounts.size());
             msout->mu_p.resize(rv.type == RCTTypeCLSAG ? inamounts.size() : 0);
         }
-        for (i = 0 ; i < inamounts.size(); i++)
+        const auto sign_input = [&](size_t n)
         {
             if (rv.type == RCTTypeCLSAG)
             {
-                rv.p.CLSAGs[i] = proveRctCLSAGSimple(full_message, rv.mixRing[i], inSk[i], a[i], pseudoOuts[i], kLRki ? &(*kLRki)[i]: NULL, msout ? &msout->c[i] : NULL, msout ? &msout->mu_p[i] : NULL, index[i], hwdev);
+                rv.p.CLSAGs[n] = proveRctCLSAGSimple(full_message, rv.mixRing[n], inSk[n], a[n], pseudoOuts[n], kLRki ? &(*kLRki)[n]: NULL, msout ? &msout->c[n] : NULL, msout ? &msout->mu_p[n] : NULL, index[n], hwdev);
             }
             else
             {
-                rv.p.MGs[i] = proveRctMGSimple(full_message, rv.mixRing[i], inSk[i], a[i], pseudoOuts[i], kLRki ? &(*kLRki)[i]: NULL, msout ? &msout->c[i] : NULL, index[i], hwdev);
+                rv.p.MGs[n] = proveRctMGSimple(full_message, rv.mixRing[n], inSk[n], a[n], pseudoOuts[n], kLRki ? &(*kLRki)[n]: NULL, msout ? &msout->c[n] : NULL, index[n], hwdev);
             }
+        };
+        // each input's ring signature only writes its own slots, so they can be
+        // made in parallel; hardware devices sign through one session, in order
+        if (hwdev.get_type() != hw::device::SOFTWARE || inamounts.size() < 2)
+        {
+            for (i = 0 ; i < inamounts.size(); i++)
+                sign_input(i);
+        }
+        else
+        {
+            tools::threadpool& tpool = tools::threadpool::getInstance();
+            tools::threadpool::waiter waiter;
+            std::vector<std::exception_ptr> errors(inamounts.size());
+            for (i = 0 ; i < inamounts.size(); i++)
+                tpool.submit(&waiter, [&sign_input, &errors, i]() {
+                    try { sign_input(i); }
+                    catch (...) { errors[i] = std::current_exception(); }
+                }, true);
+            waiter.wait(&tpool);
+            for (const std::exception_ptr &e: errors)
+                if (e)
+                    std::rethrow_exception(e);
         }
         return rv;
     }
@@ -1432,48 +1525,71 @@ namespace rct {
 
     //ver RingCT simple
     //assumes only post-rct style inputs (at least for max anonymity)
-    bool verRctNonSemanticsSimple(const rctSig & rv) {
+    //the inputs of every rctSig given are verified in a single threadpool pass,
+    //so a block full of small transactions keeps all threads busy
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rvv) {
       try
       {
         PERF_TIMER(verRctNonSemanticsSimple);
 
-        CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeCLSAG,
-            false, "verRctNonSemanticsSimple called on non simple rctSig");
-        const bool bulletproof = is_rct_bulletproof(rv.type);
-        // semantics check is early, and mixRing/MGs aren't resolved yet
-        if (bulletproof)
-          CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
-        else
-          CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
-
-        const size_t threads = std::max(rv.outPk.size(), rv.mixRing.size());
+        size_t n_inputs = 0;
+        for (const rctSig *rvp: rvv)
+        {
+          CHECK_AND_ASSERT_MES(rvp, false, "rctSig pointer is NULL");
+          const rctSig &rv = *rvp;
+          CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeCLSAG,
+              false, "verRctNonSemanticsSimple called on non simple rctSig");
+          const bool bulletproof = is_rct_bulletproof(rv.type);
+          // semantics check is early, and mixRing/MGs aren't resolved yet
+          if (bulletproof)
+            CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
+          else
+            CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
+          if (rv.type == RCTTypeCLSAG)
+            CHECK_AND_ASSERT_MES(rv.p.CLSAGs.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.CLSAGs and mixRing");
+          else
+            CHECK_AND_ASSERT_MES(rv.p.MGs.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.MGs and mixRing");
+          n_inputs += rv.mixRing.size();
+        }
 
-        std::deque<bool> results(threads);
+        // The tasks below never use the threadpool themselves, so they are
+        // submitted as leaves: a non leaf submit from inside a pool task (eg,
+        // when a caller already fans txes out) runs inline, which would verify
+        // every input of a large tx on that one thread. Leaves are always
+        // queued, and wait() runs any that no idle thread picked up.
         tools::threadpool& tpool = tools::threadpool::getInstance();
         tools::threadpool::waiter waiter;
 
-        const keyV &pseudoOuts = bulletproof ? rv.p.pseudoOuts : rv.pseudoOuts;
-
-        const key message = get_pre_mlsag_hash(rv, hw::get_device("default"));
+        std::vector<key> messages(rvv.size());
+        for (size_t n = 0; n < rvv.size(); ++n)
+          tpool.submit(&waiter, [&, n] { messages[n] = get_pre_mlsag_hash(*rvv[n], hw::get_device("default")); }, true);
+        waiter.wait(&tpool);
 
-        results.clear();
-        results.resize(rv.mixRing.size());
-        for (size_t i = 0 ; i < rv.mixRing.size() ; i++) {
-          tpool.submit(&waiter, [&, i] {
-              if (rv.type == RCTTypeCLSAG)
-              {
-                  results[i] = verRctCLSAGSimple(message, rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
-              }
-              else
-                  results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
-          });
+        std::deque<bool> results(n_inputs);
+        for (size_t n = 0, r = 0; n < rvv.size(); ++n)
+        {
+          const rctSig &rv = *rvv[n];
+          const keyV &pseudoOuts = is_rct_bulletproof(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
+          const key &message = messages[n];
+          for (size_t i = 0 ; i < rv.mixRing.size() ; i++, r++) {
+            tpool.submit(&waiter, [&, i, r] {
+                if (rv.type == RCTTypeCLSAG)
+                {
+                    results[r] = verRctCLSAGSimple(message, rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
+                }
+                else
+                    results[r] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
+            }, true);
+          }
         }
         waiter.wait(&tpool);
 
-        for (size_t i = 0; i < results.size(); ++i) {
-          if (!results[i]) {
-            LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << i);
-            return false;
+        for (size_t n = 0, r = 0; n < rvv.size(); ++n) {
+          for (size_t i = 0; i < rvv[n]->mixRing.size(); ++i, ++r) {
+            if (!results[r]) {
+              LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << i << " of rctSig " << n);
+              return false;
+            }
           }
         }
 
@@ -1492,6 +1608,11 @@ namespace rct {
       }
     }
 
+    bool verRctNonSemanticsSimple(const rctSig & rv)
+    {
+      return verRctNonSemanticsSimple(std::vector<const rctSig*>(1, &rv));
+    }
+
     //RingCT protocol
     //genRct: 
     //   creates an rctSig with all data necessary to verify the rangeProofs and that the signer owns one of the
@@ -286,12 +286,8 @@ namespace rct {
             PREPARE_CUSTOM_VECTOR_SERIALIZATION(inputs, pseudoOuts);
             if (pseudoOuts.size() != inputs)
               return false;
-            for (size_t i = 0; i < inputs; ++i)
-            {
-              FIELDS(pseudoOuts[i])
-              if (inputs - i > 1)
-                ar.delimit_array();
-            }
+            if (!::serialization::serialize_blob_array(ar, pseudoOuts.data(), inputs))
+              return false;
             ar.end_array();
           }
 
@@ -405,12 +401,8 @@ namespace rct {
               PREPARE_CUSTOM_VECTOR_SERIALIZATION(mixin + 1, CLSAGs[i].s);
               if (CLSAGs[i].s.size() != mixin + 1)
                 return false;
-              for (size_t j = 0; j <= mixin; ++j)
-              {
-                FIELDS(CLSAGs[i].s[j])
-                if (mixin + 1 - j > 1)
-                  ar.delimit_array();
-              }
+              if (!::serialization::serialize_blob_array(ar, CLSAGs[i].s.data(), mixin + 1))
+                return false;
               ar.end_array();
 
               ar.tag("c1");
@@ -455,12 +447,8 @@ namespace rct {
                 PREPARE_CUSTOM_VECTOR_SERIALIZATION(mg_ss2_elements, MGs[i].ss[j]);
                 if (MGs[i].ss[j].size() != mg_ss2_elements)
                   return false;
-                for (size_t k = 0; k < mg_ss2_elements; ++k)
-                {
-                  FIELDS(MGs[i].ss[j][k])
-                  if (mg_ss2_elements - k > 1)
-                    ar.delimit_array();
-                }
+                if (!::serialization::serialize_blob_array(ar, MGs[i].ss[j].data(), mg_ss2_elements))
+                  return false;
                 ar.end_array();
 
                 if (mixin + 1 - j > 1)
@@ -485,12 +473,8 @@ namespace rct {
             PREPARE_CUSTOM_VECTOR_SERIALIZATION(inputs, pseudoOuts);
             if (pseudoOuts.size() != inputs)
               return false;
-            for (size_t i = 0; i < inputs; ++i)
-            {
-              FIELDS(pseudoOuts[i])
-              if (inputs - i > 1)
-                ar.delimit_array();
-            }
+            if (!::serialization::serialize_blob_array(ar, pseudoOuts.data(), inputs))
+              return false;
             ar.end_array();
           }
           return true;
@@ -0,0 +1,208 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "bootstrap_daemon.h"
+
+#include <algorithm>
+#include "common/threadpool.h"
+#include "storages/http_abstract_invoke.h"
+#include "core_rpc_server_commands_defs.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "daemon.rpc.bootstrap"
+
+namespace cryptonote
+{
+  bootstrap_daemon::bootstrap_daemon(const std::vector<std::string>& addresses, const boost::optional<epee::net_utils::http::login>& login)
+    : m_login(login)
+    , m_height(0)
+  {
+    for (const std::string& address : addresses)
+    {
+      node n;
+      n.address = address;
+      n.latency = std::chrono::steady_clock::duration::max();
+      n.height = 0;
+      n.reachable = true;
+      m_order.push_back(m_nodes.size());
+      m_nodes.push_back(std::move(n));
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool bootstrap_daemon::refresh()
+  {
+    struct probe
+    {
+      std::chrono::steady_clock::duration latency;
+      uint64_t height;
+      bool ok;
+    };
+    std::vector<probe> probes(m_nodes.size());
+
+    // all at once, so a dead daemon costs one timeout rather than one each
+    tools::threadpool::getInstance().parallel_for(m_nodes.size(), [this, &probes](size_t i) {
+      std::unique_ptr<http_client> client = acquire(i);
+      COMMAND_RPC_GET_HEIGHT::request req;
+      COMMAND_RPC_GET_HEIGHT::response res;
+      const auto start = std::chrono::steady_clock::now();
+      bool ok = epee::net_utils::invoke_http_json("/getheight", req, res, *client, std::chrono::seconds(BOOTSTRAP_DAEMON_PROBE_TIMEOUT_SECONDS));
+      probes[i].latency = std::chrono::steady_clock::now() - start;
+      probes[i].ok = ok && res.status == CORE_RPC_STATUS_OK;
+      probes[i].height = probes[i].ok ? res.height : 0;
+      if (ok)
+        release(i, std::move(client));
+    }, true);
+
+    uint64_t height = 0;
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      for (size_t i = 0; i < m_nodes.size(); ++i)
+      {
+        m_nodes[i].reachable = probes[i].ok;
+        m_nodes[i].height = probes[i].height;
+        m_nodes[i].latency = probes[i].ok ? probes[i].latency : std::chrono::steady_clock::duration::max();
+        height = std::max(height, probes[i].height);
+        MDEBUG("Bootstrap daemon " << m_nodes[i].address << ": " << (probes[i].ok ? "height " + std::to_string(probes[i].height) + ", "
+            + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(probes[i].latency).count()) + " ms" : std::string("unreachable")));
+      }
+
+      // a daemon that is behind would answer with stale data, so it only
+      // comes after every daemon at the best height
+      std::sort(m_order.begin(), m_order.end(), [this, height](size_t a, size_t b) {
+        const bool a_top = m_nodes[a].reachable && m_nodes[a].height == height;
+        const bool b_top = m_nodes[b].reachable && m_nodes[b].height == height;
+        if (a_top != b_top)
+          return a_top;
+        return m_nodes[a].latency < m_nodes[b].latency;
+      });
+
+      if (height != m_height)
+      {
+        m_height = height;
+        clear_cache();
+      }
+    }
+    return height > 0;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  uint64_t bootstrap_daemon::height() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_height;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string bootstrap_daemon::address() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_order.empty() ? std::string() : m_nodes[m_order.front()].address;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool bootstrap_daemon::invoke(const std::function<bool(http_client&)>& f)
+  {
+    std::vector<size_t> order;
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      order = m_order;
+    }
+    for (size_t i : order)
+    {
+      std::unique_ptr<http_client> client = acquire(i);
+      if (f(*client))
+      {
+        release(i, std::move(client));
+        return true;
+      }
+      // the connection may be in any state after a failure, so it is not reused
+      MDEBUG("Bootstrap daemon " << m_nodes[i].address << " failed, trying the next one");
+    }
+    return false;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<bootstrap_daemon::http_client> bootstrap_daemon::acquire(size_t index)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      std::vector<std::unique_ptr<http_client>>& idle = m_nodes[index].idle;
+      if (!idle.empty())
+      {
+        std::unique_ptr<http_client> client = std::move(idle.back());
+        idle.pop_back();
+        return client;
+      }
+    }
+    std::unique_ptr<http_client> client(new http_client());
+    client->set_server(m_nodes[index].address, m_login, false);
+    return client;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void bootstrap_daemon::release(size_t index, std::unique_ptr<http_client> client)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::vector<std::unique_ptr<http_client>>& idle = m_nodes[index].idle;
+    if (idle.size() < BOOTSTRAP_DAEMON_MAX_IDLE_CONNECTIONS)
+      idle.push_back(std::move(client));
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool bootstrap_daemon::get_cached(const std::string& key, std::string& value)
+  {
+    boost::lock_guard<boost::mutex> lock(m_cache_mutex);
+    auto it = m_cache.find(key);
+    if (it == m_cache.end())
+      return false;
+    m_cache_lru.splice(m_cache_lru.begin(), m_cache_lru, it->second);
+    value = it->second->second;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void bootstrap_daemon::set_cached(const std::string& key, std::string value)
+  {
+    boost::lock_guard<boost::mutex> lock(m_cache_mutex);
+    auto it = m_cache.find(key);
+    if (it != m_cache.end())
+    {
+      it->second->second = std::move(value);
+      m_cache_lru.splice(m_cache_lru.begin(), m_cache_lru, it->second);
+      return;
+    }
+    m_cache_lru.emplace_front(key, std::move(value));
+    m_cache[key] = m_cache_lru.begin();
+    if (m_cache_lru.size() > BOOTSTRAP_DAEMON_CACHE_ENTRIES)
+    {
+      m_cache.erase(m_cache_lru.back().first);
+      m_cache_lru.pop_back();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void bootstrap_daemon::clear_cache()
+  {
+    boost::lock_guard<boost::mutex> lock(m_cache_mutex);
+    m_cache.clear();
+    m_cache_lru.clear();
+  }
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/optional/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "net/http_client.h"
+
+namespace cryptonote
+{
+  //! idle connections kept open to each bootstrap daemon
+  static constexpr size_t BOOTSTRAP_DAEMON_MAX_IDLE_CONNECTIONS = 8;
+  //! cached bootstrap responses; the cache is dropped whenever the bootstrap height moves
+  static constexpr size_t BOOTSTRAP_DAEMON_CACHE_ENTRIES = 1024;
+  //! how long a height probe may take before the daemon counts as unreachable
+  static constexpr int BOOTSTRAP_DAEMON_PROBE_TIMEOUT_SECONDS = 5;
+
+  /**
+   * @brief the bootstrap daemons a syncing node forwards wallet requests to
+   *
+   * Each daemon keeps a pool of persistent HTTP clients, so concurrent
+   * requests don't queue behind a single connection. refresh() probes every
+   * daemon's height and latency at once; requests go to the fastest daemon
+   * at the best height and fall back to the others, fastest first, when it
+   * can't be reached. Responses to idempotent calls can be cached until the
+   * bootstrap height changes.
+   */
+  class bootstrap_daemon
+  {
+  public:
+    typedef epee::net_utils::http::http_simple_client http_client;
+
+    bootstrap_daemon(const std::vector<std::string>& addresses, const boost::optional<epee::net_utils::http::login>& login);
+
+    /**
+     * @brief probe every daemon's height and latency, and reorder them
+     *
+     * @return false if none of them answered
+     */
+    bool refresh();
+
+    //! the best height seen by the last refresh
+    uint64_t height() const;
+
+    //! the daemon requests go to first
+    std::string address() const;
+
+    /**
+     * @brief call f with a client connected to the preferred daemon, then
+     * to the next one while f fails
+     *
+     * @return whether one of the calls succeeded
+     */
+    bool invoke(const std::function<bool(http_client&)>& f);
+
+    bool get_cached(const std::string& key, std::string& value);
+    void set_cached(const std::string& key, std::string value);
+
+  private:
+    struct node
+    {
+      std::string address;
+      std::chrono::steady_clock::duration latency;
+      uint64_t height;
+      bool reachable;
+      std::vector<std::unique_ptr<http_client>> idle;
+    };
+
+    std::unique_ptr<http_client> acquire(size_t index);
+    void release(size_t index, std::unique_ptr<http_client> client);
+    void clear_cache();
+
+    boost::optional<epee::net_utils::http::login> m_login;
+
+    mutable boost::mutex m_mutex;
+    std::vector<node> m_nodes;
+    std::vector<size_t> m_order; // into m_nodes: at the best height fastest first, then the rest
+    uint64_t m_height;
+
+    boost::mutex m_cache_mutex;
+    std::list<std::pair<std::string, std::string>> m_cache_lru; // most recently used first
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> m_cache;
+  };
+}
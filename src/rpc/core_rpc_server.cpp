@@ -29,6 +29,8 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
 #include "include_base_utils.h"
 #include "string_tools.h"
 using namespace epee;
@@ -40,11 +42,15 @@ using namespace epee;
 #include "common/antd.h"
 #include "common/util.h"
 #include "common/perf_timer.h"
+#include "common/alloc_profiler.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/lazy_transaction.h"
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "misc_language.h"
 #include "storages/http_abstract_invoke.h"
+#include "storages/portable_storage_bin_stream.h"
 #include "crypto/hash.h"
 #include "rpc/rpc_args.h"
 #include "rpc/rpc_handler.h"
@@ -57,6 +63,7 @@ using namespace epee;
 
 #define MAX_RESTRICTED_FAKE_OUTS_COUNT 40
 #define MAX_RESTRICTED_GLOBAL_FAKE_OUTS_COUNT 5000
+#define MAX_ARTICLES_COUNT 100
 
 namespace
 {
@@ -67,6 +74,274 @@ namespace
     swdiff = difficulty.convert_to<std::string>();
     stop64 = (difficulty >> 64).convert_to<uint64_t>();
   }
+
+  // json_rpc methods that only read chain/pool state, and so can run
+  // concurrently with each other within a batch
+  const std::unordered_set<std::string> parallel_json_rpc_methods = {
+    "get_block_count", "getblockcount", "on_get_block_hash", "on_getblockhash",
+    "get_last_block_header", "getlastblockheader",
+    "get_block_header_by_hash", "getblockheaderbyhash",
+    "get_block_header_by_height", "getblockheaderbyheight",
+    "get_block_headers_range", "getblockheadersrange",
+    "get_block", "getblock", "get_info", "hard_fork_info",
+    "get_output_histogram", "get_version", "get_fee_estimate",
+    "get_txpool_backlog", "get_output_distribution",
+    "get_quorum_state", "get_quorum_state_batched",
+    "get_full_node_blacklisted_key_images", "get_full_nodes", "get_all_full_nodes",
+    "get_all_full_nodes_keys", "get_staking_requirement",
+    "get_show_article", "list_articles", "search_articles",
+  };
+
+  // URIs and json_rpc methods that scan the chain or move bulk data, capped
+  // together so they cannot tie up every RPC thread
+  const std::unordered_set<std::string> heavy_uris = {
+    "/get_blocks.bin", "/getblocks.bin", "/get_blocks_by_height.bin", "/getblocks_by_height.bin",
+    "/get_hashes.bin", "/gethashes.bin", "/get_outs.bin", "/get_outs",
+    "/get_transactions", "/gettransactions", "/get_transaction_pool",
+    "/get_output_distribution.bin",
+  };
+  const std::unordered_set<std::string> heavy_json_rpc_methods = {
+    "get_output_histogram", "get_output_distribution", "get_coinbase_tx_sum",
+    "get_block_headers_range", "getblockheadersrange", "get_quorum_state_batched",
+    "get_alternate_chains", "search_articles",
+  };
+  // json_rpc methods given their own lane so miners are served while the
+  // other lanes are full
+  // credits a request costs against its client's rate limit on a restricted
+  // RPC port, by URI or json_rpc method; anything not listed costs 1
+  const std::unordered_map<std::string, unsigned> request_costs = {
+    {"/get_blocks.bin", 20}, {"/getblocks.bin", 20},
+    {"/get_blocks_by_height.bin", 20}, {"/getblocks_by_height.bin", 20},
+    {"/get_hashes.bin", 10}, {"/gethashes.bin", 10},
+    {"/get_outs.bin", 20}, {"/get_outs", 20},
+    {"/get_transactions", 10}, {"/gettransactions", 10},
+    {"/get_transaction_pool", 10}, {"/get_output_distribution.bin", 50},
+    {"/send_raw_transaction", 5}, {"/sendrawtransaction", 5},
+    {"get_output_histogram", 50}, {"get_output_distribution", 50},
+    {"get_block_headers_range", 10}, {"getblockheadersrange", 10},
+    {"get_quorum_state_batched", 10}, {"get_all_full_nodes", 5},
+    {"get_txpool_backlog", 5}, {"search_articles", 20},
+  };
+  // a batch may hold anything, so it is charged like the costliest call
+  constexpr unsigned RPC_BATCH_COST = 50;
+
+  // bootstrap daemon calls whose answer only changes with the bootstrap
+  // daemon's height, so it can be cached until that moves; pool queries and
+  // anything that writes always go through
+  const std::unordered_set<std::string> bootstrap_cacheable_commands = {
+    "/getheight", "/getinfo", "get_info", "/getblocks.bin", "/getblocks_by_height.bin",
+    "/gethashes.bin", "/get_o_indexes.bin", "/get_outs.bin", "/get_outs",
+    "/get_alt_blocks_hashes", "/get_output_blacklist.bin",
+    "getlastblockheader", "getblockheaderbyhash", "getblockheadersrange",
+    "getblockheaderbyheight", "getblock",
+  };
+  const std::unordered_set<std::string> mining_json_rpc_methods = {
+    "get_block_template", "getblocktemplate", "submit_block", "submitblock",
+  };
+  // finds the "method" value of a single json_rpc request without parsing
+  // the body; a miss only affects which lane the request is counted in
+  std::string peek_json_rpc_method(const std::string& body)
+  {
+    static const std::string key = "\"method\"";
+    size_t pos = body.find(key);
+    if (pos == std::string::npos)
+      return std::string();
+    pos = body.find_first_not_of(" \t\r\n", pos + key.size());
+    if (pos == std::string::npos || body[pos] != ':')
+      return std::string();
+    pos = body.find_first_not_of(" \t\r\n", pos + 1);
+    if (pos == std::string::npos || body[pos] != '"')
+      return std::string();
+    const size_t end = body.find('"', pos + 1);
+    if (end == std::string::npos)
+      return std::string();
+    return body.substr(pos + 1, end - pos - 1);
+  }
+
+  // runs f(0) ... f(count - 1) on the threadpool and waits for all of them;
+  // the calls must touch disjoint state and must not use the blockchain db,
+  // whose read transactions are per thread
+  template<typename F>
+  void parallel_for(size_t count, const F& f)
+  {
+    tools::threadpool::getInstance().parallel_for(count, f);
+  }
+
+  // the part of a tx a wallet scans, see COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest
+  bool get_tx_scan_digest(const cryptonote::blobdata& blob, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest& digest)
+  {
+    cryptonote::transaction tx;
+    if (!cryptonote::parse_and_validate_tx_base_from_blob(blob, tx))
+      return false;
+    digest.standard = tx.get_type() == cryptonote::transaction::type_standard;
+    if (!digest.standard)
+      return true;
+
+    // the wallet takes whatever pubkeys parse, even when the rest of the extra doesn't
+    std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+    cryptonote::parse_tx_extra(tx.extra, tx_extra_fields);
+    if (!tx.vout.empty())
+    {
+      cryptonote::tx_extra_pub_key pub_key_field;
+      size_t pk_index = 0;
+      while (cryptonote::find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, pk_index++))
+        digest.pub_keys.push_back(pub_key_field.pub_key);
+      cryptonote::tx_extra_additional_pub_keys additional_tx_pub_keys;
+      if (cryptonote::find_tx_extra_field_by_type(tx_extra_fields, additional_tx_pub_keys))
+        digest.additional_pub_keys = std::move(additional_tx_pub_keys.data);
+    }
+
+    digest.output_keys.reserve(tx.vout.size());
+    for (const auto& o: tx.vout)
+      digest.output_keys.push_back(o.target.type() == typeid(cryptonote::txout_to_key) ? boost::get<cryptonote::txout_to_key>(o.target).key : crypto::null_pkey);
+    for (const auto& in: tx.vin)
+      if (in.type() == typeid(cryptonote::txin_to_key))
+        digest.key_images.push_back(boost::get<cryptonote::txin_to_key>(in).k_image);
+    return true;
+  }
+
+  // a get_blocks.bin or get_blocks_by_height.bin response, serialized a few
+  // blocks at a time so only one piece of it is in memory.  Everything is
+  // read from the snapshot taken before the block list was picked; the db
+  // read txn belongs to the creating thread, which the http server's
+  // chunked send runs on until the body ends.
+  struct blocks_stream
+  {
+    static constexpr size_t PIECE_SIZE = 64 * 1024;
+
+    explicit blocks_stream(cryptonote::core& core): core(core), read_session(core.get_blockchain_storage().get_db()) {}
+
+    cryptonote::core& core;
+    cryptonote::db_read_session read_session;
+    std::vector<uint64_t> heights;
+    size_t next = 0;
+    bool started = false;
+    bool done = false;
+    bool pruned = false;
+    bool no_miner_tx = false;
+    // get_blocks.bin layout, else get_blocks_by_height.bin
+    bool with_output_indices = false;
+    bool scan_digest = false;
+    uint64_t start_height = 0;
+    uint64_t current_height = 0;
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> output_indices;
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest> scan_digests;
+
+    bool operator()(std::string& piece)
+    {
+      if (done)
+        return true;
+      epee::serialization::bin_stream_writer out(piece);
+      if (!started)
+      {
+        out.begin(with_output_indices ? (scan_digest ? 7 : 6) : 3);
+        out.begin_object_array("blocks", heights.size());
+        started = true;
+      }
+      const bool get_miner_tx_hash = with_output_indices && !no_miner_tx;
+      while (next < heights.size() && piece.size() < PIECE_SIZE)
+      {
+        std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>> bd;
+        size_t size = 0;
+        if (!core.get_blockchain_storage().get_blockchain_supplement_block(heights[next], pruned || scan_digest, get_miner_tx_hash, bd, size))
+          return false;
+        if (with_output_indices && !add_output_indices(bd))
+          return false;
+        cryptonote::block_complete_entry entry;
+        entry.block = std::move(bd.first.first);
+        if (scan_digest)
+        {
+          scan_digests.push_back(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest());
+          auto& digests = scan_digests.back().txs;
+          digests.resize(bd.second.size());
+          for (size_t n = 0; n < bd.second.size(); ++n)
+            if (!get_tx_scan_digest(bd.second[n].second, digests[n]))
+              return false;
+        }
+        else
+        {
+          entry.txs.reserve(bd.second.size());
+          for (auto& tx: bd.second)
+            entry.txs.push_back(std::move(tx.second));
+        }
+        if (!out.object(entry))
+          return false;
+        ++next;
+      }
+      if (next == heights.size())
+      {
+        if (with_output_indices)
+        {
+          out.begin_object_array("output_indices", output_indices.size());
+          for (const auto& oi: output_indices)
+            if (!out.object(oi))
+              return false;
+          out.value("start_height", start_height);
+          out.value("current_height", current_height);
+          if (scan_digest)
+          {
+            out.begin_object_array("scan_digests", scan_digests.size());
+            for (const auto& digest: scan_digests)
+              if (!out.object(digest))
+                return false;
+          }
+        }
+        out.value("status", std::string(CORE_RPC_STATUS_OK));
+        out.value("untrusted", false);
+        done = true;
+      }
+      return true;
+    }
+
+    // same lookup as core_rpc_server::on_get_blocks
+    bool add_output_indices(const std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>& bd)
+    {
+      output_indices.push_back(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
+      auto& indices_out = output_indices.back().indices;
+      indices_out.reserve(1 + bd.second.size());
+      if (no_miner_tx)
+        indices_out.push_back(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
+      const size_t n_txes_to_lookup = bd.second.size() + (no_miner_tx ? 0 : 1);
+      if (n_txes_to_lookup == 0)
+        return true;
+      std::vector<std::vector<uint64_t>> indices;
+      if (!core.get_tx_outputs_gindexs(no_miner_tx ? bd.second.front().first : bd.first.second, n_txes_to_lookup, indices))
+        return false;
+      if (indices.size() != n_txes_to_lookup)
+        return false;
+      for (size_t i = 0; i < indices.size(); ++i)
+        indices_out.push_back({std::move(indices[i])});
+      return true;
+    }
+  };
+
+  // MyMonero sends no status, OpenMonero sends this one and wallet2 accepts both
+  const char* const LIGHT_WALLET_STATUS_OK = "success";
+  // fee estimates for light wallets hold for as long as wallet2's own
+  constexpr uint64_t LIGHT_WALLET_FEE_GRACE_BLOCKS = 10;
+
+  bool is_light_wallet_output_locked(const cryptonote::light_wallet_scanner::received_output& out, uint64_t height)
+  {
+    const uint64_t spendable_age = out.coinbase ? CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW : CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+    if (height < out.height + spendable_age)
+      return true;
+    if (out.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER)
+      return out.unlock_time > height;
+    return out.unlock_time > (uint64_t)time(NULL);
+  }
+
+  template<typename T>
+  T make_light_wallet_spent_output(const cryptonote::light_wallet_scanner::account_state& acc, const cryptonote::light_wallet_scanner::spent_output& spend)
+  {
+    const cryptonote::light_wallet_scanner::received_output& out = acc.outputs[spend.output];
+    T result;
+    result.amount = out.amount;
+    result.key_image = epee::string_tools::pod_to_hex(spend.key_image);
+    result.tx_pub_key = epee::string_tools::pod_to_hex(out.tx_pub_key);
+    result.out_index = out.index;
+    result.mixin = spend.mixin;
+    return result;
+  }
 }
 namespace cryptonote
 {
@@ -79,6 +354,10 @@ namespace cryptonote
     command_line::add_arg(desc, arg_restricted_rpc);
     command_line::add_arg(desc, arg_bootstrap_daemon_address);
     command_line::add_arg(desc, arg_bootstrap_daemon_login);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_max_heavy_requests);
+    command_line::add_arg(desc, arg_rpc_rate_limit);
+    command_line::add_arg(desc, arg_rpc_rate_limit_subnet);
     cryptonote::rpc_args::init_options(desc);
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -88,6 +367,8 @@ namespace cryptonote
     )
     : m_core(cr)
     , m_p2p(p2p)
+    , m_threads_count(2)
+    , m_pool_cookie_salt(crypto::rand<uint64_t>())
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::init(
@@ -108,17 +389,17 @@ namespace cryptonote
     {
       const std::string &bootstrap_daemon_login = command_line::get_arg(vm, arg_bootstrap_daemon_login);
       const auto loc = bootstrap_daemon_login.find(':');
+      boost::optional<epee::net_utils::http::login> login;
       if (!bootstrap_daemon_login.empty() && loc != std::string::npos)
       {
-        epee::net_utils::http::login login;
-        login.username = bootstrap_daemon_login.substr(0, loc);
-        login.password = bootstrap_daemon_login.substr(loc + 1);
-        m_http_client.set_server(m_bootstrap_daemon_address, login, false);
-      }
-      else
-      {
-        m_http_client.set_server(m_bootstrap_daemon_address, boost::none, false);
+        login = epee::net_utils::http::login{};
+        login->username = bootstrap_daemon_login.substr(0, loc);
+        login->password = bootstrap_daemon_login.substr(loc + 1);
       }
+      std::vector<std::string> addresses;
+      boost::split(addresses, m_bootstrap_daemon_address, boost::is_any_of(","));
+      addresses.erase(std::remove(addresses.begin(), addresses.end(), std::string()), addresses.end());
+      m_bootstrap_daemon.reset(new bootstrap_daemon(addresses, login));
       m_should_use_bootstrap_daemon = true;
     }
     else
@@ -127,11 +408,26 @@ namespace cryptonote
     }
     m_was_bootstrap_ever_used = false;
 
+    m_threads_count = std::max<size_t>(1, command_line::get_arg(vm, arg_rpc_threads));
+    m_lanes.configure(m_threads_count, rpc::RESERVED_MINING_THREADS, command_line::get_arg(vm, arg_rpc_max_heavy_requests));
+    MINFO("RPC lanes: " << m_threads_count << " threads, light " << m_lanes.limit(rpc::cost_class::light)
+        << ", heavy " << m_lanes.limit(rpc::cost_class::heavy) << ", mining unlimited");
+
+    if (m_restricted)
+    {
+      m_rate_limiter.set_rates(command_line::get_arg(vm, arg_rpc_rate_limit), command_line::get_arg(vm, arg_rpc_rate_limit_subnet));
+      MINFO("RPC rate limit: " << command_line::get_arg(vm, arg_rpc_rate_limit) << " credits/s per host, "
+          << command_line::get_arg(vm, arg_rpc_rate_limit_subnet) << " per subnet");
+    }
+
     boost::optional<epee::net_utils::http::login> http_login{};
 
     if (rpc_config->login)
       http_login.emplace(std::move(rpc_config->login->username), std::move(rpc_config->login->password).password());
 
+    // public chain data, and the cached RPC responses come out byte identical
+    m_net_server.get_config_object().m_cache_encoded_bodies = true;
+
     auto rng = [](size_t len, uint8_t *ptr){ return crypto::rand(len, ptr); };
     return epee::http_server_impl_base<core_rpc_server, connection_context>::init(
       rng, std::move(port), std::move(rpc_config->bind_ip),
@@ -140,6 +436,104 @@ namespace cryptonote
     );
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  rpc::cost_class core_rpc_server::classify_request(const epee::net_utils::http::http_request_info& query_info) const
+  {
+    if (query_info.m_URI == "/json_rpc")
+    {
+      // batches may mix anything, so they are treated as heavy as a whole
+      if (epee::json_rpc::is_batch(query_info.m_body))
+        return rpc::cost_class::heavy;
+      const std::string method = peek_json_rpc_method(query_info.m_body);
+      if (mining_json_rpc_methods.count(method))
+        return rpc::cost_class::mining;
+      if (heavy_json_rpc_methods.count(method))
+        return rpc::cost_class::heavy;
+      return rpc::cost_class::light;
+    }
+    return heavy_uris.count(query_info.m_URI) ? rpc::cost_class::heavy : rpc::cost_class::light;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  unsigned core_rpc_server::request_cost(const epee::net_utils::http::http_request_info& query_info) const
+  {
+    std::string key = query_info.m_URI;
+    if (query_info.m_URI == "/json_rpc")
+    {
+      if (epee::json_rpc::is_batch(query_info.m_body))
+        return RPC_BATCH_COST;
+      key = peek_json_rpc_method(query_info.m_body);
+    }
+    const auto it = request_costs.find(key);
+    return it == request_costs.end() ? 1 : it->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info,
+                                            epee::net_utils::http::http_response_info& response,
+                                            connection_context& m_conn_context)
+  {
+    ALLOC_SCOPE(rpc);
+    MINFO("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    // before any parsing or DB work, so a throttled client costs next to nothing
+    unsigned retry_after;
+    if (m_restricted && !m_rate_limiter.try_charge(m_conn_context.m_remote_address, request_cost(query_info), retry_after))
+    {
+      MDEBUG("Rate limiting " << query_info.m_URI << " from " << m_conn_context.m_remote_address.host_str() << ", retry in " << retry_after << "s");
+      response.m_response_code = 429;
+      response.m_response_comment = "Too Many Requests";
+      response.m_additional_fields.push_back(std::make_pair("Retry-After", std::to_string(std::max(1u, retry_after))));
+      return true;
+    }
+    const rpc::cost_class cost = classify_request(query_info);
+    rpc::request_lanes::slot slot = m_lanes.try_acquire(cost);
+    if (!slot)
+    {
+      MDEBUG("Rejecting " << query_info.m_URI << " from " << m_conn_context.m_remote_address.host_str() << ": "
+          << rpc::cost_class_name(cost) << " lane full (" << m_lanes.rejected(cost) << " rejected so far)");
+      response.m_response_code = 503;
+      response.m_response_comment = "Service Unavailable";
+      response.m_additional_fields.push_back(std::make_pair("Retry-After", "1"));
+      return true;
+    }
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+    if (!handle_http_request_map(query_info, response, m_conn_context))
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+    }
+    else if (response.m_body_producer)
+    {
+      // a streamed body is still being produced after we return, keep
+      // its lane slot until the last piece is out
+      std::shared_ptr<rpc::request_lanes::slot> held = std::make_shared<rpc::request_lanes::slot>(std::move(slot));
+      std::function<bool(std::string&)> producer = std::move(response.m_body_producer);
+      response.m_body_producer = [held, producer](std::string& piece) { return producer(piece); };
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    if (query_info.m_URI != "/metrics" || (m_restricted && ctx))
+      return false;
+    std::string& out = response_info.m_body;
+    out = tools::get_perf_metrics_prometheus("antd");
+    out += tools::get_alloc_metrics_prometheus("antd");
+    out += "# HELP antd_rpc_lane_in_flight RPC requests being handled per cost class\n# TYPE antd_rpc_lane_in_flight gauge\n";
+    for (size_t c = 0; c < rpc::COST_CLASS_COUNT; ++c)
+      out += std::string("antd_rpc_lane_in_flight{lane=\"") + rpc::cost_class_name(static_cast<rpc::cost_class>(c)) + "\"} " + std::to_string(m_lanes.in_flight(static_cast<rpc::cost_class>(c))) + "\n";
+    out += "# HELP antd_rpc_lane_rejected_total RPC requests answered 503 because their cost class was full\n# TYPE antd_rpc_lane_rejected_total counter\n";
+    for (size_t c = 0; c < rpc::COST_CLASS_COUNT; ++c)
+      out += std::string("antd_rpc_lane_rejected_total{lane=\"") + rpc::cost_class_name(static_cast<rpc::cost_class>(c)) + "\"} " + std::to_string(m_lanes.rejected(static_cast<rpc::cost_class>(c))) + "\n";
+    out += "# HELP antd_rpc_rate_limited_total RPC requests answered 429 because the client's host or subnet was out of credits\n# TYPE antd_rpc_rate_limited_total counter\n";
+    out += "antd_rpc_rate_limited_total{scope=\"host\"} " + std::to_string(m_rate_limiter.throttled_hosts()) + "\n";
+    out += "antd_rpc_rate_limited_total{scope=\"subnet\"} " + std::to_string(m_rate_limiter.throttled_subnets()) + "\n";
+    out += "# HELP antd_rpc_rate_limit_tracked Hosts and subnets with a partly spent rate limit budget\n# TYPE antd_rpc_rate_limit_tracked gauge\n";
+    out += "antd_rpc_rate_limit_tracked " + std::to_string(m_rate_limiter.tracked()) + "\n";
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::check_core_ready()
   {
     if(!m_p2p.get_payload_object().is_synchronized())
@@ -167,6 +561,8 @@ namespace cryptonote
   }
 
 #define CHECK_CORE_READY() do { if(!check_core_ready()){res.status =  CORE_RPC_STATUS_BUSY;return true;} } while(0)
+// a read replica can't write to the DB, so anything that would change the chain or pool goes to the primary
+#define CHECK_NOT_REPLICA() do { if(m_core.is_replica()){res.status = "Not available on a read replica, use the primary daemon";return true;} } while(0)
 
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, const connection_context *ctx)
@@ -181,13 +577,74 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  template <typename COMMAND_TYPE>
+  bool core_rpc_server::get_cached_response(const cached_response<COMMAND_TYPE> &cache, const crypto::hash &top_hash, uint64_t pool_cookie, uint64_t param, typename COMMAND_TYPE::response &res)
+  {
+    boost::shared_lock<boost::shared_mutex> lock(m_response_cache_mutex);
+    if (!cache.valid || cache.top_hash != top_hash || cache.pool_cookie != pool_cookie || cache.param != param)
+      return false;
+    res = cache.response;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  template <typename COMMAND_TYPE>
+  void core_rpc_server::set_cached_response(cached_response<COMMAND_TYPE> &cache, const crypto::hash &top_hash, uint64_t pool_cookie, uint64_t param, const typename COMMAND_TYPE::response &res)
+  {
+    boost::unique_lock<boost::shared_mutex> lock(m_response_cache_mutex);
+    cache.valid = true;
+    cache.top_hash = top_hash;
+    cache.pool_cookie = pool_cookie;
+    cache.param = param;
+    cache.response = res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::fill_chain_info(COMMAND_RPC_GET_INFO::response& res)
+  {
+    // the cookie is read first: a pool change racing with us can only make
+    // the entry look older than it is, not newer
+    const uint64_t pool_cookie = m_core.get_pool_cookie();
+    uint64_t top_height;
+    crypto::hash top_hash;
+    m_core.get_blockchain_top(top_height, top_hash);
+
+    COMMAND_RPC_GET_INFO::response info;
+    if (!get_cached_response(m_info_cache, top_hash, pool_cookie, 0, info))
+    {
+      info.height = top_height + 1; // turn top block height into blockchain height
+      info.top_block_hash = string_tools::pod_to_hex(top_hash);
+      store_difficulty(m_core.get_blockchain_storage().get_difficulty_for_next_block(), info.difficulty, info.wide_difficulty, info.difficulty_top64);
+      info.tx_count = m_core.get_blockchain_storage().get_total_transactions() - info.height; //without coinbase
+      info.tx_pool_size = m_core.get_pool_transactions_count();
+      store_difficulty(m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(top_height),
+          info.cumulative_difficulty, info.wide_cumulative_difficulty, info.cumulative_difficulty_top64);
+      info.block_size_limit = info.block_weight_limit = m_core.get_blockchain_storage().get_current_cumulative_block_weight_limit();
+      info.block_size_median = info.block_weight_median = m_core.get_blockchain_storage().get_current_cumulative_block_weight_median();
+      set_cached_response(m_info_cache, top_hash, pool_cookie, 0, info);
+    }
+
+    res.height = info.height;
+    res.top_block_hash = std::move(info.top_block_hash);
+    res.difficulty = info.difficulty;
+    res.wide_difficulty = std::move(info.wide_difficulty);
+    res.difficulty_top64 = info.difficulty_top64;
+    res.tx_count = info.tx_count;
+    res.tx_pool_size = info.tx_pool_size;
+    res.cumulative_difficulty = info.cumulative_difficulty;
+    res.wide_cumulative_difficulty = std::move(info.wide_cumulative_difficulty);
+    res.cumulative_difficulty_top64 = info.cumulative_difficulty_top64;
+    res.block_size_limit = info.block_size_limit;
+    res.block_weight_limit = info.block_weight_limit;
+    res.block_size_median = info.block_size_median;
+    res.block_weight_median = info.block_weight_median;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res, const connection_context *ctx)
   {
     PERF_TIMER(on_get_info);
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_INFO>(invoke_http_mode::JON, "/getinfo", req, res, r))
     {
-      res.bootstrap_daemon_address = m_bootstrap_daemon_address;
+      res.bootstrap_daemon_address = m_bootstrap_daemon->address();
       crypto::hash top_hash;
       m_core.get_blockchain_top(res.height_without_bootstrap, top_hash);
       ++res.height_without_bootstrap; // turn top block height into blockchain height
@@ -197,16 +654,9 @@ namespace cryptonote
 
     const bool restricted = m_restricted && ctx;
 
-    crypto::hash top_hash;
-    m_core.get_blockchain_top(res.height, top_hash);
-    ++res.height; // turn top block height into blockchain height
-    res.top_block_hash = string_tools::pod_to_hex(top_hash);
+    fill_chain_info(res);
     res.target_height = m_core.get_target_blockchain_height();
-    //res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block();
-    store_difficulty(m_core.get_blockchain_storage().get_difficulty_for_next_block(), res.difficulty, res.wide_difficulty, res.difficulty_top64);
     res.target = m_core.get_blockchain_storage().get_difficulty_target();
-    res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
-    res.tx_pool_size = m_core.get_pool_transactions_count();
     res.alt_blocks_count = restricted ? 0 : m_core.get_blockchain_storage().get_alternative_blocks_count();
     uint64_t total_conn = restricted ? 0 : m_p2p.get_connections_count();
     res.outgoing_connections_count = restricted ? 0 : m_p2p.get_outgoing_connections_count();
@@ -221,11 +671,6 @@ namespace cryptonote
     res.stagenet = nettype == STAGENET;
     res.nettype = nettype == MAINNET ? "mainnet" : nettype == TESTNET ? "testnet" : nettype == STAGENET ? "stagenet" : "fakechain";
 
-    //res.cumulative_difficulty = m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(res.height - 1);
-    store_difficulty(m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(res.height - 1),
-        res.cumulative_difficulty, res.wide_cumulative_difficulty, res.cumulative_difficulty_top64);
-    res.block_size_limit = res.block_weight_limit = m_core.get_blockchain_storage().get_current_cumulative_block_weight_limit();
-    res.block_size_median = res.block_weight_median = m_core.get_blockchain_storage().get_current_cumulative_block_weight_median();
     res.status = CORE_RPC_STATUS_OK;
     res.start_time = restricted ? 0 : (uint64_t)m_core.get_start_time();
     res.free_space = restricted ? std::numeric_limits<uint64_t>::max() : m_core.get_free_space();
@@ -245,6 +690,87 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_blocks_bin(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    if (query_info.m_URI != "/get_blocks.bin" && query_info.m_URI != "/getblocks.bin")
+      return false;
+    PERF_TIMER(on_get_blocks_bin);
+    COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
+    CHECK_AND_ASSERT_MES(epee::serialization::load_t_from_binary(req, epee::strspan<uint8_t>(query_info.m_body)), false,
+        "Failed to parse bin body data, body size=" << query_info.m_body.size());
+    response_info.m_mime_tipe = " application/octet-stream";
+    response_info.m_header_info.m_content_type = " application/octet-stream";
+
+    if (m_bootstrap_daemon_address.empty())
+    {
+      std::shared_ptr<blocks_stream> stream = std::make_shared<blocks_stream>(m_core);
+      uint64_t count = 0;
+      if (m_core.get_blockchain_storage().get_blockchain_supplement_range(req.start_height, req.block_ids, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, stream->start_height, count, stream->current_height))
+      {
+        stream->heights.reserve(count);
+        for (uint64_t h = stream->start_height; h < stream->start_height + count; ++h)
+          stream->heights.push_back(h);
+        stream->output_indices.reserve(count);
+        stream->pruned = req.prune;
+        stream->no_miner_tx = req.no_miner_tx;
+        stream->with_output_indices = true;
+        stream->scan_digest = req.scan_digest;
+        if (req.scan_digest)
+          stream->scan_digests.reserve(count);
+        MDEBUG("on_get_blocks_bin: streaming " << count << " blocks from height " << stream->start_height);
+        response_info.m_body_producer = [stream](std::string& piece) { return (*stream)(piece); };
+        return true;
+      }
+    }
+
+    // bootstrap daemon, or no common block: on_get_blocks has the answer
+    COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+    if (!on_get_blocks(req, res, ctx))
+    {
+      response_info.m_response_code = 500;
+      response_info.m_response_comment = "Internal Server Error";
+      return true;
+    }
+    epee::serialization::store_t_to_binary(res, response_info.m_body);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_blocks_by_height_bin(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    if (query_info.m_URI != "/get_blocks_by_height.bin" && query_info.m_URI != "/getblocks_by_height.bin")
+      return false;
+    PERF_TIMER(on_get_blocks_by_height_bin);
+    COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request req = AUTO_VAL_INIT(req);
+    CHECK_AND_ASSERT_MES(epee::serialization::load_t_from_binary(req, epee::strspan<uint8_t>(query_info.m_body)), false,
+        "Failed to parse bin body data, body size=" << query_info.m_body.size());
+    response_info.m_mime_tipe = " application/octet-stream";
+    response_info.m_header_info.m_content_type = " application/octet-stream";
+
+    if (m_bootstrap_daemon_address.empty())
+    {
+      std::shared_ptr<blocks_stream> stream = std::make_shared<blocks_stream>(m_core);
+      const uint64_t height = m_core.get_blockchain_storage().get_db().height();
+      // the block count goes out first, so a bad height has to be caught now
+      if (std::all_of(req.heights.begin(), req.heights.end(), [height](uint64_t h) { return h < height; }))
+      {
+        stream->heights = std::move(req.heights);
+        MDEBUG("on_get_blocks_by_height_bin: streaming " << stream->heights.size() << " blocks");
+        response_info.m_body_producer = [stream](std::string& piece) { return (*stream)(piece); };
+        return true;
+      }
+    }
+
+    COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response res = AUTO_VAL_INIT(res);
+    if (!on_get_blocks_by_height(req, res, ctx))
+    {
+      response_info.m_response_code = 500;
+      response_info.m_response_comment = "Internal Server Error";
+      return true;
+    }
+    epee::serialization::store_t_to_binary(res, response_info.m_body);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   class pruned_transaction {
     transaction& tx;
   public:
@@ -262,9 +788,12 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
       return r;
 
+    // one db snapshot for all the lookups below
+    db_read_session read_session(m_core.get_blockchain_storage().get_db());
+
     std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
 
-    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune, !req.no_miner_tx, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
+    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune || req.scan_digest, !req.no_miner_tx, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
     {
       res.status = "Failed";
       return false;
@@ -276,22 +805,40 @@ namespace cryptonote
     for(auto& bd: bs)
     {
       res.blocks.resize(res.blocks.size()+1);
-      res.blocks.back().block = bd.first.first;
       pruned_size += bd.first.first.size();
       unpruned_size += bd.first.first.size();
+      res.blocks.back().block = std::move(bd.first.first);
       res.output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
       ntxes += bd.second.size();
       res.output_indices.back().indices.reserve(1 + bd.second.size());
       if (req.no_miner_tx)
         res.output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
-      res.blocks.back().txs.reserve(bd.second.size());
-      for (std::vector<std::pair<crypto::hash, cryptonote::blobdata>>::iterator i = bd.second.begin(); i != bd.second.end(); ++i)
+      if (req.scan_digest)
+      {
+        res.scan_digests.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest());
+        auto& digests = res.scan_digests.back().txs;
+        digests.resize(bd.second.size());
+        for (size_t n = 0; n < bd.second.size(); ++n)
+        {
+          unpruned_size += bd.second[n].second.size();
+          if (!get_tx_scan_digest(bd.second[n].second, digests[n]))
+          {
+            res.status = "Failed";
+            return false;
+          }
+        }
+      }
+      else
       {
-        unpruned_size += i->second.size();
-        res.blocks.back().txs.push_back(std::move(i->second));
-        i->second.clear();
-        i->second.shrink_to_fit();
-        pruned_size += res.blocks.back().txs.back().size();
+        res.blocks.back().txs.reserve(bd.second.size());
+        for (std::vector<std::pair<crypto::hash, cryptonote::blobdata>>::iterator i = bd.second.begin(); i != bd.second.end(); ++i)
+        {
+          unpruned_size += i->second.size();
+          res.blocks.back().txs.push_back(std::move(i->second));
+          i->second.clear();
+          i->second.shrink_to_fit();
+          pruned_size += res.blocks.back().txs.back().size();
+        }
       }
 
       const size_t n_txes_to_lookup = bd.second.size() + (req.no_miner_tx ? 0 : 1);
@@ -352,6 +899,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_BY_HEIGHT>(invoke_http_mode::BIN, "/getblocks_by_height.bin", req, res, r))
       return r;
 
+    db_read_session read_session(m_core.get_blockchain_storage().get_db());
+
     res.status = "Failed";
     res.blocks.clear();
     res.blocks.reserve(req.heights.size());
@@ -409,6 +958,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUTS_BIN>(invoke_http_mode::BIN, "/get_outs.bin", req, res, r))
       return r;
 
+    db_read_session read_session(m_core.get_blockchain_storage().get_db());
+
     res.status = "Failed";
 
     const bool restricted = m_restricted && ctx;
@@ -426,6 +977,18 @@ namespace cryptonote
       return true;
     }
 
+    if (req.packed)
+    {
+      res.pack();
+      if (req.get_txid)
+      {
+        res.txids.reserve(res.outs.size());
+        for (const auto &o: res.outs)
+          res.txids.push_back(o.txid);
+      }
+      res.outs.clear();
+    }
+
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -437,6 +1000,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUTS>(invoke_http_mode::JON, "/get_outs", req, res, r))
       return r;
 
+    db_read_session read_session(m_core.get_blockchain_storage().get_db());
+
     res.status = "Failed";
 
     const bool restricted = m_restricted && ctx;
@@ -498,6 +1063,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTIONS>(invoke_http_mode::JON, "/gettransactions", req, res, ok))
       return ok;
 
+    db_read_session read_session(m_core.get_blockchain_storage().get_db());
+
     std::vector<crypto::hash> vh;
     for(const auto& tx_hex_str: req.txs_hashes)
     {
@@ -559,22 +1126,18 @@ namespace cryptonote
           }
           else if ((i = std::find_if(pool_tx_info.begin(), pool_tx_info.end(), [h](const tx_info &txi) { return epee::string_tools::pod_to_hex(h) == txi.id_hash; })) != pool_tx_info.end())
           {
-            cryptonote::transaction tx;
-            if (!cryptonote::parse_and_validate_tx_from_blob(i->tx_blob, tx))
+            // the pruned part is a prefix of the blob, so it is sliced off where
+            // the base parse stopped rather than serialized again
+            cryptonote::lazy_transaction ltx;
+            if (!ltx.parse(i->tx_blob) || !ltx.load_prunable())
             {
               res.status = "Failed to parse and validate tx from blob";
               return true;
             }
-            std::stringstream ss;
-            binary_archive<true> ba(ss);
-            bool r = const_cast<cryptonote::transaction&>(tx).serialize_base(ba);
-            if (!r)
-            {
-              res.status = "Failed to serialize transaction base";
-              return true;
-            }
-            const cryptonote::blobdata pruned = ss.str();
-            sorted_txs.push_back(std::make_tuple(h, pruned, get_transaction_prunable_hash(tx), std::string(i->tx_blob, pruned.size())));
+            const epee::span<const uint8_t> pruned = ltx.pruned_blob();
+            const epee::span<const uint8_t> prunable = ltx.prunable_blob();
+            sorted_txs.push_back(std::make_tuple(h, cryptonote::blobdata(reinterpret_cast<const char*>(pruned.data()), pruned.size()),
+                get_transaction_prunable_hash(ltx.tx()), cryptonote::blobdata(reinterpret_cast<const char*>(prunable.data()), prunable.size())));
             missed_txs.erase(std::find(missed_txs.begin(), missed_txs.end(), h));
             pool_tx_hashes.insert(h);
             const std::string hash_string = epee::string_tools::pod_to_hex(h);
@@ -594,15 +1157,14 @@ namespace cryptonote
       LOG_PRINT_L2("Found " << found_in_pool << "/" << vh.size() << " transactions in the pool");
     }
 
-    std::vector<std::string>::const_iterator txhi = req.txs_hashes.begin();
-    std::vector<crypto::hash>::const_iterator vhi = vh.begin();
-    for(auto& tx: txs)
-    {
-      res.txs.push_back(COMMAND_RPC_GET_TRANSACTIONS::entry());
-      COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs.back();
+    // hex encoding and JSON rendering are pure per-tx work, so they are
+    // spread over the threadpool; everything touching the db stays below
+    const size_t first_tx = res.txs.size();
+    res.txs.resize(first_tx + txs.size());
+    parallel_for(txs.size(), [&](size_t n) {
+      const auto &tx = txs[n];
+      COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs[first_tx + n];
 
-      crypto::hash tx_hash = *vhi++;
-      e.tx_hash = *txhi++;
       e.prunable_hash = epee::string_tools::pod_to_hex(std::get<2>(tx));
       if (req.split || req.prune || std::get<3>(tx).empty())
       {
@@ -633,6 +1195,16 @@ namespace cryptonote
           }
         }
       }
+    });
+
+    std::vector<std::string>::const_iterator txhi = req.txs_hashes.begin();
+    std::vector<crypto::hash>::const_iterator vhi = vh.begin();
+    for (size_t n = 0; n < txs.size(); ++n)
+    {
+      COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs[first_tx + n];
+
+      crypto::hash tx_hash = *vhi++;
+      e.tx_hash = *txhi++;
       e.in_pool = pool_tx_hashes.find(tx_hash) != pool_tx_hashes.end();
       if (e.in_pool)
       {
@@ -688,9 +1260,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_IS_KEY_IMAGE_SPENT>(invoke_http_mode::JON, "/is_key_image_spent", req, res, ok))
       return ok;
 
-    const bool restricted = m_restricted && ctx;
-    const bool request_has_rpc_origin = ctx != NULL;
     std::vector<crypto::key_image> key_images;
+    key_images.reserve(req.key_images.size());
     for(const auto& ki_hex_str: req.key_images)
     {
       blobdata b;
@@ -702,57 +1273,65 @@ namespace cryptonote
       if(b.size() != sizeof(crypto::key_image))
       {
         res.status = "Failed, size of data mismatch";
+        return true;
       }
       key_images.push_back(*reinterpret_cast<const crypto::key_image*>(b.data()));
     }
-    std::vector<bool> spent_status;
-    bool r = m_core.are_key_images_spent(key_images, spent_status);
-    if(!r)
+    std::vector<uint8_t> spent_status;
+    if (!get_key_images_spent_status(key_images, spent_status, ctx))
     {
       res.status = "Failed";
       return true;
     }
-    res.spent_status.clear();
-    for (size_t n = 0; n < spent_status.size(); ++n)
-      res.spent_status.push_back(spent_status[n] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN : COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
+    res.spent_status.assign(spent_status.begin(), spent_status.end());
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_is_key_image_spent_bin(const COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request& req, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_is_key_image_spent_bin);
+    bool ok;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN>(invoke_http_mode::BIN, "/is_key_image_spent.bin", req, res, ok))
+      return ok;
 
-    // check the pool too
-    std::vector<cryptonote::tx_info> txs;
-    std::vector<cryptonote::spent_key_image_info> ki;
-    r = m_core.get_pool_transactions_and_spent_keys_info(txs, ki, !request_has_rpc_origin || !restricted);
-    if(!r)
+    if (!get_key_images_spent_status(req.key_images, res.spent_status, ctx))
     {
       res.status = "Failed";
       return true;
     }
-    for (std::vector<cryptonote::spent_key_image_info>::const_iterator i = ki.begin(); i != ki.end(); ++i)
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_key_images_spent_status(const std::vector<crypto::key_image>& key_images, std::vector<uint8_t>& spent_status, const connection_context *ctx)
+  {
+    const bool restricted = m_restricted && ctx;
+    const bool request_has_rpc_origin = ctx != NULL;
+    std::vector<bool> chain_spent, pool_spent;
     {
-      crypto::hash hash;
-      crypto::key_image spent_key_image;
-      if (parse_hash256(i->id_hash, hash))
-      {
-        memcpy(&spent_key_image, &hash, sizeof(hash)); // a bit dodgy, should be other parse functions somewhere
-        for (size_t n = 0; n < res.spent_status.size(); ++n)
-        {
-          if (res.spent_status[n] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT)
-          {
-            if (key_images[n] == spent_key_image)
-            {
-              res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
-              break;
-            }
-          }
-        }
-      }
+      // one read txn for all the chain lookups
+      db_read_session read_session(m_core.get_blockchain_storage().get_db());
+      if (!m_core.are_key_images_spent(key_images, chain_spent))
+        return false;
     }
-
-    res.status = CORE_RPC_STATUS_OK;
+    // the pool keeps its key images indexed, so this is one lookup per key
+    // image rather than a walk over every pool tx
+    if (!m_core.are_key_images_spent_in_pool(key_images, pool_spent, !request_has_rpc_origin || !restricted))
+      return false;
+    if (chain_spent.size() != key_images.size() || pool_spent.size() != key_images.size())
+      return false;
+    spent_status.resize(key_images.size());
+    for (size_t n = 0; n < key_images.size(); ++n)
+      spent_status[n] = chain_spent[n] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN :
+          pool_spent[n] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL : COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMMAND_RPC_SEND_RAW_TX::response& res, const connection_context *ctx)
   {
     PERF_TIMER(on_send_raw_tx);
+    CHECK_NOT_REPLICA();
     bool ok;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_SEND_RAW_TX>(invoke_http_mode::JON, "/sendrawtransaction", req, res, ok))
       return ok;
@@ -809,6 +1388,7 @@ namespace cryptonote
   bool core_rpc_server::on_start_mining(const COMMAND_RPC_START_MINING::request& req, COMMAND_RPC_START_MINING::response& res, const connection_context *ctx)
   {
     PERF_TIMER(on_start_mining);
+    CHECK_NOT_REPLICA();
     CHECK_CORE_READY();
     cryptonote::address_parse_info info;
     if(!get_account_address_from_str(info, m_core.get_nettype(), req.miner_address))
@@ -891,6 +1471,7 @@ namespace cryptonote
     if ( lMiner.is_mining() ) {
       res.speed = lMiner.get_speed();
       res.threads_count = lMiner.get_threads_count();
+      res.thread_speeds = lMiner.get_thread_speeds();
       const account_public_address& lMiningAdr = lMiner.get_mining_address();
       res.address = get_account_address_as_str(m_core.get_nettype(), false, lMiningAdr);
     }
@@ -979,6 +1560,40 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_perf_trace(const COMMAND_RPC_PERF_TRACE::request& req, COMMAND_RPC_PERF_TRACE::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_perf_trace);
+    if (req.action == "start")
+    {
+      if (req.events_per_thread)
+        tools::set_perf_trace(true, req.events_per_thread);
+      else
+        tools::set_perf_trace(true);
+    }
+    else if (req.action == "stop")
+      tools::set_perf_trace(false);
+    else if (req.action == "dump")
+      res.trace = tools::get_perf_trace_json();
+    else if (!req.action.empty())
+    {
+      res.status = "Error: unknown action, expected start, stop or dump";
+      return true;
+    }
+    res.enabled = tools::is_perf_trace_enabled();
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_alloc_stats(const COMMAND_RPC_GET_ALLOC_STATS::request& req, COMMAND_RPC_GET_ALLOC_STATS::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_get_alloc_stats);
+    res.enabled = tools::is_alloc_profiling_enabled();
+    for (const auto &s: tools::get_alloc_stats())
+      res.scopes.push_back({s.scope, s.allocations, s.bytes});
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transaction_pool(const COMMAND_RPC_GET_TRANSACTION_POOL::request& req, COMMAND_RPC_GET_TRANSACTION_POOL::response& res, const connection_context *ctx)
   {
     PERF_TIMER(on_get_transaction_pool);
@@ -989,8 +1604,10 @@ namespace cryptonote
     const bool restricted = m_restricted && ctx;
     const bool request_has_rpc_origin = ctx != NULL;
     m_core.get_pool_transactions_and_spent_keys_info(res.transactions, res.spent_key_images, !request_has_rpc_origin || !restricted);
-    for (tx_info& txi : res.transactions)
+    parallel_for(res.transactions.size(), [&res](size_t n) {
+      tx_info& txi = res.transactions[n];
       txi.tx_blob = epee::string_tools::buff_to_hex_nodelimer(txi.tx_blob);
+    });
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -1002,10 +1619,17 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN>(invoke_http_mode::JON, "/get_transaction_pool_hashes.bin", req, res, r))
       return r;
 
+    // read before the hashes, so a change racing with us makes the next
+    // request fetch them again rather than be told nothing changed
+    res.pool_cookie = m_core.get_pool_cookie() ^ m_pool_cookie_salt;
+    res.unchanged = req.pool_cookie != 0 && req.pool_cookie == res.pool_cookie;
+    res.status = CORE_RPC_STATUS_OK;
+    if (res.unchanged)
+      return true;
+
     const bool restricted = m_restricted && ctx;
     const bool request_has_rpc_origin = ctx != NULL;
     m_core.get_pool_transaction_hashes(res.tx_hashes, !request_has_rpc_origin || !restricted);
-    res.status = CORE_RPC_STATUS_OK;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -1141,6 +1765,7 @@ namespace cryptonote
   bool core_rpc_server::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request& req, COMMAND_RPC_GETBLOCKTEMPLATE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_getblocktemplate);
+    CHECK_NOT_REPLICA();
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GETBLOCKTEMPLATE>(invoke_http_mode::JON_RPC, "getblocktemplate", req, res, r))
       return r;
@@ -1235,6 +1860,7 @@ namespace cryptonote
   bool core_rpc_server::on_submitblock(const COMMAND_RPC_SUBMITBLOCK::request& req, COMMAND_RPC_SUBMITBLOCK::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_submitblock);
+    CHECK_NOT_REPLICA();
     {
       boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
       if (m_should_use_bootstrap_daemon)
@@ -1349,10 +1975,10 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  uint64_t core_rpc_server::get_block_reward(const block& blk)
+  uint64_t core_rpc_server::get_block_reward(const transaction& miner_tx)
   {
     uint64_t reward = 0;
-    for(const tx_out& out: blk.miner_tx.vout)
+    for(const tx_out& out: miner_tx.vout)
     {
       reward += out.amount;
     }
@@ -1360,13 +1986,21 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::fill_block_header_response(const block& blk, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_response& response, bool fill_pow_hash)
+  {
+    if (!fill_block_header_response(blk, blk.miner_tx, blk.tx_hashes.size(), orphan_status, height, hash, response))
+      return false;
+    response.pow_hash = fill_pow_hash ? string_tools::pod_to_hex(get_block_longhash(&(m_core.get_blockchain_storage()), blk, height, 0)) : "";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::fill_block_header_response(const block_header& hdr, const transaction& miner_tx, size_t tx_count, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_response& response)
   {
     PERF_TIMER(fill_block_header_response);
-    response.major_version = blk.major_version;
-    response.minor_version = blk.minor_version;
-    response.timestamp = blk.timestamp;
-    response.prev_hash = string_tools::pod_to_hex(blk.prev_id);
-    response.nonce = blk.nonce;
+    response.major_version = hdr.major_version;
+    response.minor_version = hdr.minor_version;
+    response.timestamp = hdr.timestamp;
+    response.prev_hash = string_tools::pod_to_hex(hdr.prev_id);
+    response.nonce = hdr.nonce;
     response.orphan_status = orphan_status;
     response.height = height;
     response.depth = m_core.get_current_blockchain_height() - height - 1;
@@ -1377,11 +2011,11 @@ namespace cryptonote
         response.cumulative_difficulty, response.wide_cumulative_difficulty, response.cumulative_difficulty_top64);
    // response.difficulty = m_core.get_blockchain_storage().block_difficulty(height);
     //response.cumulative_difficulty = response.block_weight = m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(height);
-    response.reward = get_block_reward(blk);
-    response.miner_reward = blk.miner_tx.vout[0].amount;
+    response.reward = get_block_reward(miner_tx);
+    response.miner_reward = miner_tx.vout[0].amount;
     response.block_size = response.block_weight = m_core.get_blockchain_storage().get_db().get_block_weight(height);
-    response.num_txes = blk.tx_hashes.size();
-    response.pow_hash = fill_pow_hash ? string_tools::pod_to_hex(get_block_longhash(&(m_core.get_blockchain_storage()), blk, height, 0)) : "";
+    response.num_txes = tx_count;
+    response.pow_hash = "";
     response.long_term_weight = m_core.get_blockchain_storage().get_db().get_block_long_term_weight(height);
     return true;
   }
@@ -1390,65 +2024,88 @@ namespace cryptonote
   bool core_rpc_server::use_bootstrap_daemon_if_necessary(const invoke_http_mode &mode, const std::string &command_name, const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res, bool &r)
   {
     res.untrusted = false;
-    if (m_bootstrap_daemon_address.empty())
+    if (!m_bootstrap_daemon)
       return false;
 
-    boost::unique_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
-    if (!m_should_use_bootstrap_daemon)
+    // the lock only guards the switch; requests to the bootstrap daemons run
+    // concurrently on their own pooled connections
+    bool check_height;
     {
-      MINFO("The local daemon is fully synced. Not switching back to the bootstrap daemon");
-      return false;
+      boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
+      if (!m_should_use_bootstrap_daemon)
+      {
+        MINFO("The local daemon is fully synced. Not switching back to the bootstrap daemon");
+        return false;
+      }
+      check_height = std::chrono::system_clock::now() - m_bootstrap_height_check_time > std::chrono::seconds(30); // update every 30s
     }
-
-    auto current_time = std::chrono::system_clock::now();
-    if (current_time - m_bootstrap_height_check_time > std::chrono::seconds(30))  // update every 30s
+    if (check_height)
     {
-      m_bootstrap_height_check_time = current_time;
+      boost::unique_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
+      auto current_time = std::chrono::system_clock::now();
+      // another request may have done it while we waited for the lock
+      if (m_should_use_bootstrap_daemon && current_time - m_bootstrap_height_check_time > std::chrono::seconds(30))
+      {
+        m_bootstrap_height_check_time = current_time;
 
-      uint64_t top_height;
-      crypto::hash top_hash;
-      m_core.get_blockchain_top(top_height, top_hash);
-      ++top_height; // turn top block height into blockchain height
+        uint64_t top_height;
+        crypto::hash top_hash;
+        m_core.get_blockchain_top(top_height, top_hash);
+        ++top_height; // turn top block height into blockchain height
 
-      // query bootstrap daemon's height
-      cryptonote::COMMAND_RPC_GET_HEIGHT::request getheight_req;
-      cryptonote::COMMAND_RPC_GET_HEIGHT::response getheight_res;
-      bool ok = epee::net_utils::invoke_http_json("/getheight", getheight_req, getheight_res, m_http_client);
-      ok = ok && getheight_res.status == CORE_RPC_STATUS_OK;
+        // query the bootstrap daemons' heights, which also picks the fastest
+        bool ok = m_bootstrap_daemon->refresh();
+        const uint64_t bootstrap_height = m_bootstrap_daemon->height();
 
-      m_should_use_bootstrap_daemon = ok && top_height + 10 < getheight_res.height;
-      MINFO((m_should_use_bootstrap_daemon ? "Using" : "Not using") << " the bootstrap daemon (our height: " << top_height << ", bootstrap daemon's height: " << getheight_res.height << ")");
+        m_should_use_bootstrap_daemon = ok && top_height + 10 < bootstrap_height;
+        MINFO((m_should_use_bootstrap_daemon ? "Using" : "Not using") << " the bootstrap daemon " << m_bootstrap_daemon->address() << " (our height: " << top_height << ", bootstrap daemon's height: " << bootstrap_height << ")");
+      }
+      if (!m_should_use_bootstrap_daemon)
+        return false;
     }
-    if (!m_should_use_bootstrap_daemon)
-      return false;
 
-    if (mode == invoke_http_mode::JON)
+    if (mode != invoke_http_mode::JON && mode != invoke_http_mode::BIN && mode != invoke_http_mode::JON_RPC)
     {
-      r = epee::net_utils::invoke_http_json(command_name, req, res, m_http_client);
+      MERROR("Unknown invoke_http_mode: " << mode);
+      return false;
     }
-    else if (mode == invoke_http_mode::BIN)
+    m_was_bootstrap_ever_used = true;
+
+    std::string cache_key;
+    if (bootstrap_cacheable_commands.count(command_name) && epee::serialization::store_t_to_binary(req, cache_key))
     {
-      r = epee::net_utils::invoke_http_bin(command_name, req, res, m_http_client);
+      cache_key.insert(0, command_name + '\0');
+      std::string cached;
+      if (m_bootstrap_daemon->get_cached(cache_key, cached) && epee::serialization::load_t_from_binary(res, epee::strspan<uint8_t>(cached)))
+      {
+        r = res.status == CORE_RPC_STATUS_OK;
+        res.untrusted = true;
+        return true;
+      }
     }
-    else if (mode == invoke_http_mode::JON_RPC)
-    {
+
+    r = m_bootstrap_daemon->invoke([&](bootstrap_daemon::http_client &client) -> bool {
+      if (mode == invoke_http_mode::JON)
+        return epee::net_utils::invoke_http_json(command_name, req, res, client);
+      if (mode == invoke_http_mode::BIN)
+        return epee::net_utils::invoke_http_bin(command_name, req, res, client);
       epee::json_rpc::request<typename COMMAND_TYPE::request> json_req = AUTO_VAL_INIT(json_req);
       epee::json_rpc::response<typename COMMAND_TYPE::response, std::string> json_resp = AUTO_VAL_INIT(json_resp);
       json_req.jsonrpc = "2.0";
       json_req.id = epee::serialization::storage_entry(0);
       json_req.method = command_name;
       json_req.params = req;
-      r = net_utils::invoke_http_json("/json_rpc", json_req, json_resp, m_http_client);
-      if (r)
-        res = json_resp.result;
-    }
-    else
-    {
-      MERROR("Unknown invoke_http_mode: " << mode);
-      return false;
-    }
-    m_was_bootstrap_ever_used = true;
+      if (!net_utils::invoke_http_json("/json_rpc", json_req, json_resp, client))
+        return false;
+      res = json_resp.result;
+      return true;
+    });
     r = r && res.status == CORE_RPC_STATUS_OK;
+
+    std::string blob;
+    if (r && !cache_key.empty() && epee::serialization::store_t_to_binary(res, blob))
+      m_bootstrap_daemon->set_cached(cache_key, std::move(blob));
+
     res.untrusted = true;
     return true;
   }
@@ -1464,6 +2121,8 @@ namespace cryptonote
     uint64_t last_block_height;
     crypto::hash last_block_hash;
     m_core.get_blockchain_top(last_block_height, last_block_hash);
+    if (get_cached_response(m_last_block_header_cache, last_block_hash, 0, req.fill_pow_hash, res))
+      return true;
     block last_block;
     bool have_last_block = m_core.get_block_by_hash(last_block_hash, last_block);
     if (!have_last_block)
@@ -1480,6 +2139,7 @@ namespace cryptonote
       return false;
     }
     res.status = CORE_RPC_STATUS_OK;
+    set_cached_response(m_last_block_header_cache, last_block_hash, 0, req.fill_pow_hash, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -1539,24 +2199,28 @@ namespace cryptonote
       error_resp.message = "Invalid start/end heights.";
       return false;
     }
+    // the pow hash needs the whole block, the rest only its header and miner tx
+    db_read_session read_session(m_core.get_blockchain_storage().get_db());
+    block blk;
+    block_header_view hdr;
     for (uint64_t h = req.start_height; h <= req.end_height; ++h)
     {
       crypto::hash block_hash = m_core.get_block_id_by_height(h);
-      block blk;
-      bool have_block = m_core.get_block_by_hash(block_hash, blk);
+      bool have_block = req.fill_pow_hash ? m_core.get_block_by_hash(block_hash, blk) : m_core.get_blockchain_storage().get_block_header_view_by_height(h, hdr, true);
+      const transaction &miner_tx = req.fill_pow_hash ? blk.miner_tx : hdr.miner_tx;
       if (!have_block)
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
         error_resp.message = "Internal error: can't get block by height. Height = " + boost::lexical_cast<std::string>(h) + ". Hash = " + epee::string_tools::pod_to_hex(block_hash) + '.';
         return false;
       }
-      if (blk.miner_tx.vin.size() != 1 || blk.miner_tx.vin.front().type() != typeid(txin_gen))
+      if (miner_tx.vin.size() != 1 || miner_tx.vin.front().type() != typeid(txin_gen))
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
         error_resp.message = "Internal error: coinbase transaction in the block has the wrong type";
         return false;
       }
-      uint64_t block_height = boost::get<txin_gen>(blk.miner_tx.vin.front()).height;
+      uint64_t block_height = boost::get<txin_gen>(miner_tx.vin.front()).height;
       if (block_height != h)
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
@@ -1564,7 +2228,9 @@ namespace cryptonote
         return false;
       }
       res.headers.push_back(block_header_response());
-      bool response_filled = fill_block_header_response(blk, false, block_height, block_hash, res.headers.back(), req.fill_pow_hash);
+      bool response_filled = req.fill_pow_hash ?
+          fill_block_header_response(blk, false, block_height, block_hash, res.headers.back(), true) :
+          fill_block_header_response(hdr, hdr.miner_tx, hdr.tx_count, false, block_height, block_hash, res.headers.back());
       if (!response_filled)
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
@@ -1665,8 +2331,13 @@ namespace cryptonote
     {
       res.tx_hashes.push_back(epee::string_tools::pod_to_hex(blk.tx_hashes[n]));
     }
-    res.blob = string_tools::buff_to_hex_nodelimer(t_serializable_object_to_blob(blk));
-    res.json = obj_to_json_str(blk);
+    // saving serializers only read blk, so both renderings can run at once
+    parallel_for(2, [&res, &blk](size_t n) {
+      if (n == 0)
+        res.blob = string_tools::buff_to_hex_nodelimer(t_serializable_object_to_blob(blk));
+      else
+        res.json = obj_to_json_str(blk);
+    });
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -1688,7 +2359,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_INFO>(invoke_http_mode::JON_RPC, "get_info", req, res, r))
     {
-      res.bootstrap_daemon_address = m_bootstrap_daemon_address;
+      res.bootstrap_daemon_address = m_bootstrap_daemon->address();
       crypto::hash top_hash;
       m_core.get_blockchain_top(res.height_without_bootstrap, top_hash);
       ++res.height_without_bootstrap; // turn top block height into blockchain height
@@ -1698,17 +2369,9 @@ namespace cryptonote
 
     const bool restricted = m_restricted && ctx;
 
-    crypto::hash top_hash;
-    m_core.get_blockchain_top(res.height, top_hash);
-    ++res.height; // turn top block height into blockchain height
-    res.top_block_hash = string_tools::pod_to_hex(top_hash);
+    fill_chain_info(res);
     res.target_height = m_core.get_target_blockchain_height();
-    //res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block();
-    store_difficulty(m_core.get_blockchain_storage().get_difficulty_for_next_block(),
-        res.difficulty, res.wide_difficulty, res.difficulty_top64);
     res.target = DIFFICULTY_TARGET_V2;
-    res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
-    res.tx_pool_size = m_core.get_pool_transactions_count();
     res.alt_blocks_count = restricted ? 0 : m_core.get_blockchain_storage().get_alternative_blocks_count();
     uint64_t total_conn = restricted ? 0 : m_p2p.get_connections_count();
     res.outgoing_connections_count = restricted ? 0 : m_p2p.get_outgoing_connections_count();
@@ -1723,10 +2386,6 @@ namespace cryptonote
     res.stagenet = net_type == STAGENET;
     res.nettype = net_type == MAINNET ? "mainnet" : net_type == TESTNET ? "testnet" : net_type == STAGENET ? "stagenet" : "fakechain";
 
-    store_difficulty(m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(res.height - 1),
-        res.cumulative_difficulty, res.wide_cumulative_difficulty, res.cumulative_difficulty_top64);
-    res.block_size_limit = res.block_weight_limit = m_core.get_blockchain_storage().get_current_cumulative_block_weight_limit();
-    res.block_size_median = res.block_weight_median = m_core.get_blockchain_storage().get_current_cumulative_block_weight_median();
     res.status = CORE_RPC_STATUS_OK;
     res.start_time = restricted ? 0 : (uint64_t)m_core.get_start_time();
     res.free_space = restricted ? std::numeric_limits<uint64_t>::max() : m_core.get_free_space();
@@ -1754,11 +2413,18 @@ namespace cryptonote
       return r;
 
     const Blockchain &blockchain = m_core.get_blockchain_storage();
+    const crypto::hash top_hash = blockchain.get_tail_id();
+    if (get_cached_response(m_hard_fork_info_cache, top_hash, 0, req.version, res))
+    {
+      res.state = blockchain.get_hard_fork_state(); // depends on the time too
+      return true;
+    }
     uint8_t version = req.version > 0 ? req.version : blockchain.get_next_hard_fork_version();
     res.version = blockchain.get_current_hard_fork_version();
     res.enabled = blockchain.get_hard_fork_voting_info(version, res.window, res.votes, res.threshold, res.earliest_height, res.voting);
     res.state = blockchain.get_hard_fork_state();
     res.status = CORE_RPC_STATUS_OK;
+    set_cached_response(m_hard_fork_info_cache, top_hash, 0, req.version, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -1819,6 +2485,7 @@ namespace cryptonote
   bool core_rpc_server::on_flush_txpool(const COMMAND_RPC_FLUSH_TRANSACTION_POOL::request& req, COMMAND_RPC_FLUSH_TRANSACTION_POOL::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_flush_txpool);
+    CHECK_NOT_REPLICA();
 
     bool failed = false;
     std::vector<crypto::hash> txids;
@@ -1930,9 +2597,13 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BASE_FEE_ESTIMATE>(invoke_http_mode::JON_RPC, "get_fee_estimate", req, res, r))
       return r;
 
+    const crypto::hash top_hash = m_core.get_blockchain_storage().get_tail_id();
+    if (get_cached_response(m_fee_estimate_cache, top_hash, 0, req.grace_blocks, res))
+      return true;
     res.fee = m_core.get_blockchain_storage().get_dynamic_base_fee_estimate(req.grace_blocks);
     res.quantization_mask = Blockchain::get_fee_quantization_mask();
     res.status = CORE_RPC_STATUS_OK;
+    set_cached_response(m_fee_estimate_cache, top_hash, 0, req.grace_blocks, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2160,6 +2831,7 @@ namespace cryptonote
   bool core_rpc_server::on_pop_blocks(const COMMAND_RPC_POP_BLOCKS::request& req, COMMAND_RPC_POP_BLOCKS::response& res, const connection_context *ctx)
   {
     PERF_TIMER(on_pop_blocks);
+    CHECK_NOT_REPLICA();
 
     m_core.get_blockchain_storage().pop_blocks(req.nblocks);
 
@@ -2172,6 +2844,7 @@ namespace cryptonote
   bool core_rpc_server::on_relay_tx(const COMMAND_RPC_RELAY_TX::request& req, COMMAND_RPC_RELAY_TX::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_relay_tx);
+    CHECK_NOT_REPLICA();
 
     bool failed = false;
     res.status = "";
@@ -2340,9 +3013,10 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_prune_blockchain(const COMMAND_RPC_PRUNE_BLOCKCHAIN::request& req, COMMAND_RPC_PRUNE_BLOCKCHAIN::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
+    CHECK_NOT_REPLICA();
     try
     {
-      if (!(req.check ? m_core.check_blockchain_pruning() : m_core.prune_blockchain()))
+      if (!(req.check ? m_core.check_blockchain_pruning() : req.background ? m_core.start_incremental_pruning() : m_core.prune_blockchain()))
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
         error_resp.message = req.check ? "Failed to check blockchain pruning" : "Failed to prune blockchain";
@@ -2381,6 +3055,30 @@ namespace cryptonote
     , ""
     };
 
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_threads = {
+      "rpc-threads"
+    , "Number of threads serving each RPC port"
+    , 4
+    };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_max_heavy_requests = {
+      "rpc-max-heavy-requests"
+    , "Max concurrent expensive RPC requests (block sync, output distributions, ...) per RPC port, further ones get HTTP 503; 0 for half the RPC threads"
+    , 0
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_rate_limit = {
+      "rpc-rate-limit"
+    , "Credits per second each client host gets on a restricted RPC port, a plain call costs 1 and a bulk one up to 50; 0 for no limit"
+    , 100
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_rate_limit_subnet = {
+      "rpc-rate-limit-subnet"
+    , "Credits per second shared by each /24 (IPv4) or /64 (IPv6) subnet on a restricted RPC port; 0 for no limit"
+    , 400
+    };
+
   const command_line::arg_descriptor<std::string> core_rpc_server::arg_rpc_restricted_bind_port = {
       "rpc-restricted-bind-port"
     , "Port for restricted RPC server"
@@ -2395,7 +3093,8 @@ namespace cryptonote
 
   const command_line::arg_descriptor<std::string> core_rpc_server::arg_bootstrap_daemon_address = {
       "bootstrap-daemon-address"
-    , "URL of a 'bootstrap' remote daemon that the connected wallets can use while this daemon is still not fully synced"
+    , "URL of a 'bootstrap' remote daemon that the connected wallets can use while this daemon is still not fully synced; "
+      "several comma separated URLs spread the load, requests go to the fastest one at the best height"
     , ""
     };
 
@@ -2407,7 +3106,7 @@ namespace cryptonote
     PERF_TIMER(on_get_quorum_state);
     bool r;
 
-    const auto quorum_state = m_core.get_quorum_state(req.height);
+    const auto quorum_state = m_core.get_quorum_state_snapshot(req.height);
     r = (quorum_state != nullptr);
     if (r)
     {
@@ -2438,8 +3137,12 @@ namespace cryptonote
 
     const uint64_t cur_height = m_core.get_current_blockchain_height();
 
-    const uint64_t height_begin = std::max(req.height_begin, cur_height - full_nodes::QUORUM_LIFETIME);
-    const uint64_t height_end = std::min(req.height_end, cur_height);
+    // NOTE: Quorums older than the fullnode list's lifetime are served from the
+    // archive, so only bound the size of the response.
+    const uint64_t height_begin = req.height_begin;
+    const uint64_t height_limit = height_begin > std::numeric_limits<uint64_t>::max() - full_nodes::QUORUM_LIFETIME
+                                ? std::numeric_limits<uint64_t>::max() : height_begin + full_nodes::QUORUM_LIFETIME;
+    const uint64_t height_end = std::min(std::min(req.height_end, cur_height), height_limit);
 
     if (height_begin > height_end)
     {
@@ -2453,7 +3156,7 @@ namespace cryptonote
     res.quorum_entries.reserve(height_end - height_begin + 1);
     for (auto h = height_begin; h <= height_end; ++h)
     {
-      const auto quorum_state = m_core.get_quorum_state(h);
+      const auto quorum_state = m_core.get_quorum_state_snapshot(h);
 
       if (!quorum_state) {
         failed_height = h;
@@ -2605,8 +3308,24 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_all_full_nodes_keys(const COMMAND_RPC_GET_ALL_FULL_NODES_KEYS::request& req, COMMAND_RPC_GET_ALL_FULL_NODES_KEYS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
+    PERF_TIMER(on_get_all_full_nodes_keys);
+
+    // pollers send back the hash they last saw and only get keys when it changed
+    const crypto::hash current_hash = m_core.get_all_full_nodes_public_keys_hash(req.fully_funded_nodes_only);
+    res.keys_hash = string_tools::pod_to_hex(current_hash);
+    if (req.keys_hash == res.keys_hash)
+    {
+      res.keys.clear();
+      res.unchanged = true;
+      return true;
+    }
+
+    if (get_cached_response(m_full_nodes_keys_cache[req.fully_funded_nodes_only], current_hash, 0, 0, res))
+      return true;
+
     std::vector<crypto::public_key> keys;
-    m_core.get_all_full_nodes_public_keys(keys, req.fully_funded_nodes_only);
+    crypto::hash keys_hash;
+    m_core.get_all_full_nodes_public_keys(keys, req.fully_funded_nodes_only, &keys_hash);
 
     res.keys.clear();
     res.keys.resize(keys.size());
@@ -2616,6 +3335,9 @@ namespace cryptonote
       std::string const hex64 = string_tools::pod_to_hex(key);
       res.keys[i++]           = antd::hex64_to_base32z(hex64);
     }
+    res.keys_hash = string_tools::pod_to_hex(keys_hash);
+    res.unchanged = false;
+    set_cached_response(m_full_nodes_keys_cache[req.fully_funded_nodes_only], keys_hash, 0, 0, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2637,6 +3359,73 @@ namespace cryptonote
       }
     }
 
+    using field = COMMAND_RPC_GET_FULL_NODES::response::field;
+    uint32_t fields = field::field_all;
+    if (req.fields.size())
+    {
+      static const std::pair<char const *, field> FIELD_NAMES[] = {
+        {"registration_height",           field::field_registration_height},
+        {"requested_unlock_height",       field::field_requested_unlock_height},
+        {"last_reward_block_height",      field::field_last_reward_block_height},
+        {"last_reward_transaction_index", field::field_last_reward_transaction_index},
+        {"last_uptime_proof",             field::field_last_uptime_proof},
+        {"contributors",                  field::field_contributors},
+        {"total_contributed",             field::field_total_contributed},
+        {"total_reserved",                field::field_total_reserved},
+        {"staking_requirement",           field::field_staking_requirement},
+        {"portions_for_operator",         field::field_portions_for_operator},
+        {"operator_address",              field::field_operator_address},
+      };
+
+      fields = 0;
+      for (std::string const &name : req.fields)
+      {
+        if (name == "full_node_pubkey")
+          continue;
+
+        auto it = std::find_if(std::begin(FIELD_NAMES), std::end(FIELD_NAMES), [&name](std::pair<char const *, field> const &entry) { return name == entry.first; });
+        if (it == std::end(FIELD_NAMES))
+        {
+          error_resp.code    = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+          error_resp.message = "Unknown fullnode field: " + name;
+          return false;
+        }
+        fields |= it->second;
+      }
+    }
+
+    // Paging walks the nodes in pubkey order, only the requested page gets
+    // materialised.
+    if (req.limit || req.cursor.size())
+    {
+      crypto::public_key cursor = crypto::null_pkey;
+      if (req.cursor.size() && !string_tools::hex_to_pod(req.cursor, cursor))
+      {
+        error_resp.code    = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+        error_resp.message = "Could not convert cursor to a public key: " + req.cursor;
+        return false;
+      }
+
+      if (pubkeys.empty())
+        m_core.get_all_full_nodes_public_keys(pubkeys, false /*fully_funded_nodes_only*/);
+
+      auto const pubkey_less = [](crypto::public_key const &a, crypto::public_key const &b) { return memcmp(a.data, b.data, sizeof(a.data)) < 0; };
+      std::sort(pubkeys.begin(), pubkeys.end(), pubkey_less);
+      pubkeys.erase(std::unique(pubkeys.begin(), pubkeys.end()), pubkeys.end());
+
+      auto begin = req.cursor.size() ? std::upper_bound(pubkeys.begin(), pubkeys.end(), cursor, pubkey_less) : pubkeys.begin();
+      auto end   = (req.limit && static_cast<size_t>(pubkeys.end() - begin) > req.limit) ? begin + req.limit : pubkeys.end();
+      if (end != pubkeys.end() && end != begin)
+        res.next_cursor = string_tools::pod_to_hex(*(end - 1));
+
+      pubkeys = std::vector<crypto::public_key>(begin, end);
+      if (pubkeys.empty())
+      {
+        res.status = CORE_RPC_STATUS_OK;
+        return true;
+      }
+    }
+
     std::vector<full_nodes::full_node_pubkey_info> pubkey_info_list = m_core.get_full_node_list_state(pubkeys);
 
     res.status = CORE_RPC_STATUS_OK;
@@ -2654,111 +3443,334 @@ namespace cryptonote
     {
       COMMAND_RPC_GET_FULL_NODES::response::entry entry = {};
 
+      entry.fields                        = fields;
       entry.full_node_pubkey           = string_tools::pod_to_hex(pubkey_info.pubkey);
       entry.registration_height           = pubkey_info.info.registration_height;
       entry.requested_unlock_height       = pubkey_info.info.requested_unlock_height;
       entry.last_reward_block_height      = pubkey_info.info.last_reward_block_height;
       entry.last_reward_transaction_index = pubkey_info.info.last_reward_transaction_index;
-      entry.last_uptime_proof             = m_core.get_uptime_proof(pubkey_info.pubkey);
-
-      entry.contributors.reserve(pubkey_info.info.contributors.size());
+      if (fields & field::field_last_uptime_proof)
+        entry.last_uptime_proof           = m_core.get_uptime_proof(pubkey_info.pubkey);
 
       using namespace full_nodes;
-      for (full_node_info::contributor_t const &contributor : pubkey_info.info.contributors)
+      if (fields & field::field_contributors)
       {
-        COMMAND_RPC_GET_FULL_NODES::response::contributor new_contributor = {};
-        new_contributor.amount   = contributor.amount;
-        new_contributor.reserved = contributor.reserved;
-        new_contributor.address  = cryptonote::get_account_address_as_str(m_core.get_nettype(), false/*is_subaddress*/, contributor.address);
-
-        new_contributor.locked_contributions.reserve(contributor.locked_contributions.size());
-        for (full_node_info::contribution_t const &src : contributor.locked_contributions)
+        entry.contributors.reserve(pubkey_info.info.contributors.size());
+        for (full_node_info::contributor_t const &contributor : pubkey_info.info.contributors)
         {
-          COMMAND_RPC_GET_FULL_NODES::response::contribution dest = {};
-          dest.amount                                                = src.amount;
-          dest.key_image                                             = string_tools::pod_to_hex(src.key_image);
-          dest.key_image_pub_key                                     = string_tools::pod_to_hex(src.key_image_pub_key);
-          new_contributor.locked_contributions.push_back(dest);
-        }
+          COMMAND_RPC_GET_FULL_NODES::response::contributor new_contributor = {};
+          new_contributor.amount   = contributor.amount;
+          new_contributor.reserved = contributor.reserved;
+          new_contributor.address  = cryptonote::get_account_address_as_str(m_core.get_nettype(), false/*is_subaddress*/, contributor.address);
+
+          new_contributor.locked_contributions.reserve(contributor.locked_contributions.size());
+          for (full_node_info::contribution_t const &src : contributor.locked_contributions)
+          {
+            COMMAND_RPC_GET_FULL_NODES::response::contribution dest = {};
+            dest.amount                                                = src.amount;
+            dest.key_image                                             = string_tools::pod_to_hex(src.key_image);
+            dest.key_image_pub_key                                     = string_tools::pod_to_hex(src.key_image_pub_key);
+            new_contributor.locked_contributions.push_back(dest);
+          }
 
-        entry.contributors.push_back(new_contributor);
+          entry.contributors.push_back(new_contributor);
+        }
       }
 
       entry.total_contributed             = pubkey_info.info.total_contributed;
       entry.total_reserved                = pubkey_info.info.total_reserved;
       entry.staking_requirement           = pubkey_info.info.staking_requirement;
       entry.portions_for_operator         = pubkey_info.info.portions_for_operator;
-      entry.operator_address              = cryptonote::get_account_address_as_str(m_core.get_nettype(), false/*is_subaddress*/, pubkey_info.info.operator_address);
+      if (fields & field::field_operator_address)
+        entry.operator_address            = cryptonote::get_account_address_as_str(m_core.get_nettype(), false/*is_subaddress*/, pubkey_info.info.operator_address);
 
-      res.full_node_states.push_back(entry);
+      res.full_node_states.push_back(std::move(entry));
     }
 
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  bool core_rpc_server::on_get_all_full_nodes(const COMMAND_RPC_GET_FULL_NODES::request& req, COMMAND_RPC_GET_FULL_NODES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  bool core_rpc_server::on_get_full_nodes_bin(const COMMAND_RPC_GET_FULL_NODES::request& req, COMMAND_RPC_GET_FULL_NODES::response& res, const connection_context *ctx)
   {
-    auto req_all = req;
-    req_all.full_node_pubkeys.clear();
-    return on_get_full_nodes(req_all, res, error_resp);
+    PERF_TIMER(on_get_full_nodes_bin);
+
+    if (req.include_json)
+    {
+      res.status = "include_json is not supported by the binary call";
+      return false;
+    }
+
+    epee::json_rpc::error error_resp;
+    if (!on_get_full_nodes(req, res, error_resp, ctx))
+    {
+      res.status = error_resp.message;
+      return false;
+    }
+
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  bool core_rpc_server::on_get_staking_requirement(const COMMAND_RPC_GET_STAKING_REQUIREMENT::request& req, COMMAND_RPC_GET_STAKING_REQUIREMENT::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  bool core_rpc_server::get_light_wallet_keys(const std::string& address, const std::string& view_key, account_public_address& addr, crypto::secret_key& key)
   {
-    PERF_TIMER(on_get_staking_requirement);
-    res.staking_requirement = full_nodes::get_staking_requirement(m_core.get_nettype(), req.height, m_core.get_hard_fork_version(req.height));
-    res.status = CORE_RPC_STATUS_OK;
+    address_parse_info info;
+    if (!get_account_address_from_str(info, m_core.get_nettype(), address) || info.is_subaddress)
+      return false;
+    crypto::public_key view_public_key;
+    if (!epee::string_tools::hex_to_pod(view_key, key) || !crypto::secret_key_to_public_key(key, view_public_key))
+      return false;
+    if (view_public_key != info.address.m_view_public_key)
+      return false;
+    addr = info.address;
     return true;
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_light_wallet_account(const std::string& address, const std::string& view_key, light_wallet_scanner::account_state& acc)
+  {
+    account_public_address addr;
+    crypto::secret_key key;
+    if (!get_light_wallet_keys(address, view_key, addr, key))
+      return false;
+    return m_core.get_light_wallet_scanner().get_account(addr, key, acc);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_login(const COMMAND_RPC_LOGIN::request& req, COMMAND_RPC_LOGIN::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_login);
+    res.new_address = false;
 
-  bool parse_article_from_nonce(const std::vector<uint8_t>& nonce, tx_extra_article_info& article_info, std::string& content_hash, std::string& nonce_hex)
+    account_public_address address;
+    crypto::secret_key view_key;
+    if (!get_light_wallet_keys(req.address, req.view_key, address, view_key))
+    {
+      res.status = "error";
+      res.reason = "Invalid address or view key";
+      return true;
+    }
+
+    switch (m_core.get_light_wallet_scanner().login(address, view_key, req.create_account))
+    {
+      case light_wallet_scanner::login_ok:
+        res.status = LIGHT_WALLET_STATUS_OK;
+        break;
+      case light_wallet_scanner::login_created:
+        res.status = LIGHT_WALLET_STATUS_OK;
+        res.new_address = true;
+        break;
+      case light_wallet_scanner::login_unknown:
+        res.status = "error";
+        res.reason = "Account not registered";
+        break;
+      case light_wallet_scanner::login_full:
+        res.status = "error";
+        res.reason = "No more accounts can be registered on this daemon";
+        break;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_import_wallet_request(const COMMAND_RPC_IMPORT_WALLET_REQUEST::request& req, COMMAND_RPC_IMPORT_WALLET_REQUEST::response& res, const connection_context *ctx)
   {
-    nonce_hex = epee::to_hex::string(epee::span<const uint8_t>(nonce.data(), nonce.size()));
-    std::string extra_str(nonce.begin(), nonce.end());
-    size_t pos = 0;
+    PERF_TIMER(on_import_wallet_request);
+    // imports are free here, the rescan is done as soon as the scanning thread gets to it
+    res.import_fee = 0;
+    res.new_request = false;
+    res.request_fulfilled = false;
 
-    if (extra_str.size() >= 8 && extra_str.substr(0, 4) == "ARTC" && extra_str.substr(4, 4) == "ARTC")
+    account_public_address address;
+    crypto::secret_key view_key;
+    if (!get_light_wallet_keys(req.address, req.view_key, address, view_key))
     {
-      pos = 8; // Skip double ARTC prefix
+      res.status = "Invalid address or view key";
+      return true;
     }
-    else if (extra_str.size() >= 4 && extra_str.substr(0, 4) == "ARTC")
+
+    switch (m_core.get_light_wallet_scanner().import(address, view_key, req.from_height))
     {
-      pos = 4; // Skip single ARTC prefix
+      case light_wallet_scanner::login_full:
+        res.status = "No more accounts can be registered on this daemon";
+        break;
+      case light_wallet_scanner::login_unknown:
+        res.status = "Account not registered";
+        break;
+      default:
+        res.status = LIGHT_WALLET_STATUS_OK;
+        res.new_request = true;
+        res.request_fulfilled = true;
+        break;
     }
-    else
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_address_info(const COMMAND_RPC_GET_ADDRESS_INFO::request& req, COMMAND_RPC_GET_ADDRESS_INFO::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_get_address_info);
+    light_wallet_scanner::account_state acc;
+    if (!get_light_wallet_account(req.address, req.view_key, acc))
+      return false;
+
+    const uint64_t height = m_core.get_current_blockchain_height();
+    res.locked_funds = 0;
+    res.total_received = 0;
+    res.total_sent = 0;
+    for (const auto& out: acc.outputs)
     {
+      res.total_received += out.amount;
+      if (is_light_wallet_output_locked(out, height))
+        res.locked_funds += out.amount;
+    }
+    // spends are candidates, the wallet drops those whose key image is not its own
+    for (const auto& spend: acc.spends)
+    {
+      res.total_sent += acc.outputs[spend.output].amount;
+      res.spent_outputs.push_back(make_light_wallet_spent_output<COMMAND_RPC_GET_ADDRESS_INFO::spent_output>(acc, spend));
+    }
+    res.scanned_height = acc.scanned_height;
+    res.scanned_block_height = acc.scanned_height;
+    res.start_height = acc.start_height;
+    res.transaction_height = height;
+    res.blockchain_height = height;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_address_txs(const COMMAND_RPC_GET_ADDRESS_TXS::request& req, COMMAND_RPC_GET_ADDRESS_TXS::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_get_address_txs);
+    light_wallet_scanner::account_state acc;
+    if (!get_light_wallet_account(req.address, req.view_key, acc))
       return false;
+
+    const uint64_t height = m_core.get_current_blockchain_height();
+    std::unordered_map<crypto::hash, size_t> tx_positions;
+    const auto get_tx = [&](const crypto::hash& hash, uint64_t tx_height, uint64_t timestamp, uint64_t unlock_time) -> COMMAND_RPC_GET_ADDRESS_TXS::transaction& {
+      auto ins = tx_positions.emplace(hash, res.transactions.size());
+      if (ins.second)
+      {
+        res.transactions.emplace_back();
+        COMMAND_RPC_GET_ADDRESS_TXS::transaction& tx = res.transactions.back();
+        tx.hash = epee::string_tools::pod_to_hex(hash);
+        tx.timestamp = timestamp;
+        tx.total_received = 0;
+        tx.total_sent = 0;
+        tx.unlock_time = unlock_time;
+        tx.height = tx_height;
+        tx.coinbase = false;
+        tx.mempool = false;
+        tx.mixin = 0;
+      }
+      return res.transactions[ins.first->second];
+    };
+
+    res.total_received = 0;
+    for (const auto& out: acc.outputs)
+    {
+      COMMAND_RPC_GET_ADDRESS_TXS::transaction& tx = get_tx(out.tx_hash, out.height, out.timestamp, out.unlock_time);
+      tx.total_received += out.amount;
+      tx.coinbase = out.coinbase;
+      res.total_received += out.amount;
+      if (!is_light_wallet_output_locked(out, height))
+        res.total_received_unlocked += out.amount;
+    }
+    for (const auto& spend: acc.spends)
+    {
+      COMMAND_RPC_GET_ADDRESS_TXS::transaction& tx = get_tx(spend.tx_hash, spend.height, spend.timestamp, spend.unlock_time);
+      tx.total_sent += acc.outputs[spend.output].amount;
+      tx.mixin = spend.mixin;
+      tx.spent_outputs.push_back(make_light_wallet_spent_output<COMMAND_RPC_GET_ADDRESS_TXS::spent_output>(acc, spend));
     }
 
-    try
+    // outputs and spends are each in chain order, merge them
+    std::stable_sort(res.transactions.begin(), res.transactions.end(),
+        [](const COMMAND_RPC_GET_ADDRESS_TXS::transaction& a, const COMMAND_RPC_GET_ADDRESS_TXS::transaction& b) { return a.height < b.height; });
+    for (size_t n = 0; n < res.transactions.size(); ++n)
+      res.transactions[n].id = n;
+
+    res.scanned_height = acc.scanned_height;
+    res.scanned_block_height = acc.scanned_height;
+    res.blockchain_height = height;
+    res.status = LIGHT_WALLET_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_unspent_outs(const COMMAND_RPC_GET_UNSPENT_OUTS::request& req, COMMAND_RPC_GET_UNSPENT_OUTS::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_get_unspent_outs);
+    light_wallet_scanner::account_state acc;
+    if (!get_light_wallet_account(req.address, req.view_key, acc))
     {
-      if (pos >= extra_str.size()) return false;
-      uint8_t title_len = static_cast<uint8_t>(extra_str[pos++]);
-      if (pos + title_len > extra_str.size()) return false;
-      article_info.title = extra_str.substr(pos, title_len);
-      pos += title_len;
-
-      if (pos + 2 > extra_str.size()) return false;
-      uint16_t content_len = (static_cast<uint8_t>(extra_str[pos]) << 8) | static_cast<uint8_t>(extra_str[pos + 1]);
-      pos += 2;
-      if (pos + content_len > extra_str.size()) return false;
-      article_info.content = extra_str.substr(pos, content_len);
-      pos += content_len;
-
-      if (pos >= extra_str.size()) return false;
-      uint8_t publisher_len = static_cast<uint8_t>(extra_str[pos++]);
-      if (pos + publisher_len > extra_str.size()) return false;
-      article_info.publisher = extra_str.substr(pos, publisher_len);
-
-      crypto::hash hash;
-      crypto::cn_fast_hash(article_info.content.data(), article_info.content.size(), hash);
-      content_hash = epee::string_tools::pod_to_hex(hash);
+      res.status = "error";
+      res.reason = "Invalid address or view key, or account not registered";
       return true;
     }
-    catch (const std::exception&)
-    {
+
+    // every output is listed with the key images that may spend it, and the
+    // wallet, which can compute its own key images, decides which are spent
+    std::vector<std::vector<std::string>> spend_key_images(acc.outputs.size());
+    for (const auto& spend: acc.spends)
+      spend_key_images[spend.output].push_back(epee::string_tools::pod_to_hex(spend.key_image));
+
+    res.amount = 0;
+    for (size_t n = 0; n < acc.outputs.size(); ++n)
+    {
+      const light_wallet_scanner::received_output& out = acc.outputs[n];
+      COMMAND_RPC_GET_UNSPENT_OUTS::output o;
+      o.amount = out.amount;
+      o.public_key = epee::string_tools::pod_to_hex(out.out_key);
+      o.index = out.index;
+      o.global_index = out.global_index;
+      o.rct = out.rct;
+      o.tx_hash = epee::string_tools::pod_to_hex(out.tx_hash);
+      o.tx_pub_key = epee::string_tools::pod_to_hex(out.tx_pub_key);
+      o.tx_prefix_hash = epee::string_tools::pod_to_hex(out.tx_prefix_hash);
+      o.spend_key_images = std::move(spend_key_images[n]);
+      o.timestamp = out.timestamp;
+      o.height = out.height;
+      res.outputs.push_back(std::move(o));
+      res.amount += out.amount;
+    }
+    res.per_kb_fee = m_core.get_blockchain_storage().get_dynamic_base_fee_estimate(LIGHT_WALLET_FEE_GRACE_BLOCKS) * 1024;
+    res.status = LIGHT_WALLET_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_submit_raw_tx(const COMMAND_RPC_SUBMIT_RAW_TX::request& req, COMMAND_RPC_SUBMIT_RAW_TX::response& res, const connection_context *ctx)
+  {
+    PERF_TIMER(on_submit_raw_tx);
+    COMMAND_RPC_SEND_RAW_TX::request send_req;
+    COMMAND_RPC_SEND_RAW_TX::response send_res;
+    send_req.tx_as_hex = req.tx;
+    send_req.do_not_relay = false;
+    if (!on_send_raw_tx(send_req, send_res, ctx))
       return false;
-    }
+    res.status = send_res.status;
+    res.error = send_res.reason;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_all_full_nodes(const COMMAND_RPC_GET_FULL_NODES::request& req, COMMAND_RPC_GET_FULL_NODES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    auto req_all = req;
+    req_all.full_node_pubkeys.clear();
+    return on_get_full_nodes(req_all, res, error_resp);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_staking_requirement(const COMMAND_RPC_GET_STAKING_REQUIREMENT::request& req, COMMAND_RPC_GET_STAKING_REQUIREMENT::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    PERF_TIMER(on_get_staking_requirement);
+    res.staking_requirement = full_nodes::get_staking_requirement(m_core.get_nettype(), req.height, m_core.get_hard_fork_version(req.height));
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+
+  bool parse_article_from_nonce(const std::vector<uint8_t>& nonce, tx_extra_article_info& article_info, std::string& content_hash, std::string& nonce_hex)
+  {
+    nonce_hex = epee::to_hex::string(epee::span<const uint8_t>(nonce.data(), nonce.size()));
+    if (!parse_article_from_nonce(blobdata(nonce.begin(), nonce.end()), article_info))
+      return false;
+
+    crypto::hash hash;
+    crypto::cn_fast_hash(article_info.content.data(), article_info.content.size(), hash);
+    content_hash = epee::string_tools::pod_to_hex(hash);
+    return true;
   }
 
 bool core_rpc_server::on_show_article(const COMMAND_RPC_SHOW_ARTICLE::request& req,
@@ -2862,4 +3874,122 @@ bool core_rpc_server::on_show_article(const COMMAND_RPC_SHOW_ARTICLE::request& r
   return true;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------
+void core_rpc_server::run_json_rpc_batch(const std::vector<std::string>& methods, std::vector<std::function<void()>>& jobs)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  size_t i = 0;
+  while (i < jobs.size())
+  {
+    size_t end = i;
+    while (end < jobs.size() && parallel_json_rpc_methods.count(methods[end]))
+      ++end;
+    if (end - i < 2)
+    {
+      // anything that may change state runs alone, in batch order
+      jobs[i]();
+      ++i;
+      continue;
+    }
+    tools::threadpool::waiter waiter;
+    for (size_t j = i; j < end; ++j)
+      tpool.submit(&waiter, jobs[j]);
+    waiter.wait(&tpool);
+    i = end;
+  }
+}
+//------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::fill_articles_response(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, uint32_t limit, bool include_content, COMMAND_RPC_LIST_ARTICLES::response& res, epee::json_rpc::error& error_resp)
+{
+  if (limit > MAX_ARTICLES_COUNT)
+  {
+    error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+    error_resp.message = "Too many articles requested, the limit is " + std::to_string(MAX_ARTICLES_COUNT);
+    return false;
+  }
+  const uint64_t top_height = m_core.get_current_blockchain_height() - 1;
+  if (end_height == 0 || end_height > top_height)
+    end_height = top_height;
+
+  const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+  db_read_session read_session(db);
+
+  std::vector<article_index_t> index;
+  std::vector<crypto::hash> txids;
+  std::vector<transaction> txs;
+  std::vector<crypto::hash> missed_txs;
+  try
+  {
+    res.more = db.get_articles(start_height, end_height, publisher_hash, content_hash, offset, limit, index);
+    txids.reserve(index.size());
+    for (const article_index_t &ai: index)
+      txids.push_back(ai.txid);
+    if (!m_core.get_transactions(txids, txs, missed_txs) || !missed_txs.empty())
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Indexed article transaction not found";
+      return false;
+    }
+  }
+  catch (const std::exception &e)
+  {
+    error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+    error_resp.message = std::string("Failed to get articles: ") + e.what();
+    return false;
+  }
+
+  res.articles.reserve(index.size());
+  for (size_t i = 0; i < index.size(); ++i)
+  {
+    tx_extra_article_info article;
+    if (!get_article_from_tx_extra(txs[i].extra, article))
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Failed to parse indexed article";
+      return false;
+    }
+    res.articles.emplace_back();
+    article_entry &entry = res.articles.back();
+    entry.txid = epee::string_tools::pod_to_hex(index[i].txid);
+    entry.block_height = index[i].height;
+    entry.title = std::move(article.title);
+    entry.publisher = std::move(article.publisher);
+    entry.content_hash = epee::string_tools::pod_to_hex(index[i].content_hash);
+    if (include_content)
+      entry.content = std::move(article.content);
+  }
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_list_articles(const COMMAND_RPC_LIST_ARTICLES::request& req, COMMAND_RPC_LIST_ARTICLES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+{
+  PERF_TIMER(on_list_articles);
+  return fill_articles_response(req.start_height, req.end_height, nullptr, nullptr, req.offset, req.limit, req.include_content, res, error_resp);
+}
+//------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_search_articles(const COMMAND_RPC_SEARCH_ARTICLES::request& req, COMMAND_RPC_SEARCH_ARTICLES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+{
+  PERF_TIMER(on_search_articles);
+  crypto::hash publisher_hash, content_hash;
+  if (!req.publisher.empty())
+    crypto::cn_fast_hash(req.publisher.data(), req.publisher.size(), publisher_hash);
+  if (!req.content_hash.empty() && !epee::string_tools::hex_to_pod(req.content_hash, content_hash))
+  {
+    error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+    error_resp.message = "Invalid content hash";
+    return false;
+  }
+  if (req.publisher.empty() && req.content_hash.empty())
+  {
+    error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+    error_resp.message = "Need a publisher or a content hash to search for";
+    return false;
+  }
+  return fill_articles_response(req.start_height, req.end_height,
+      req.publisher.empty() ? nullptr : &publisher_hash,
+      req.content_hash.empty() ? nullptr : &content_hash,
+      req.offset, req.limit, req.include_content, res, error_resp);
+}
+
 }  // namespace cryptonote
@@ -36,6 +36,9 @@
 #include "net/http_server_impl_base.h"
 #include "net/http_client.h"
 #include "core_rpc_server_commands_defs.h"
+#include "bootstrap_daemon.h"
+#include "rate_limiter.h"
+#include "request_lanes.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
@@ -58,6 +61,10 @@ namespace cryptonote
     static const command_line::arg_descriptor<bool> arg_restricted_rpc;
     static const command_line::arg_descriptor<std::string> arg_bootstrap_daemon_address;
     static const command_line::arg_descriptor<std::string> arg_bootstrap_daemon_login;
+    static const command_line::arg_descriptor<size_t> arg_rpc_threads;
+    static const command_line::arg_descriptor<size_t> arg_rpc_max_heavy_requests;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_rate_limit;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_rate_limit_subnet;
 
     typedef epee::net_utils::connection_context_base connection_context;
 
@@ -74,16 +81,22 @@ namespace cryptonote
       );
 
     network_type nettype() const { return m_core.get_nettype(); }
+    size_t get_threads_count() const { return m_threads_count; }
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    // forwards http requests to the uri map once the client is within its
+    // rate limit (restricted ports only, 429 otherwise) and the request's
+    // cost class has a free slot (503 otherwise)
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info,
+                             epee::net_utils::http::http_response_info& response,
+                             connection_context& m_conn_context);
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/get_height", on_get_height, COMMAND_RPC_GET_HEIGHT)
       MAP_URI_AUTO_JON2("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
-      MAP_URI_AUTO_BIN2("/get_blocks.bin", on_get_blocks, COMMAND_RPC_GET_BLOCKS_FAST)
-      MAP_URI_AUTO_BIN2("/getblocks.bin", on_get_blocks, COMMAND_RPC_GET_BLOCKS_FAST)
-      MAP_URI_AUTO_BIN2("/get_blocks_by_height.bin", on_get_blocks_by_height, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT)
-      MAP_URI_AUTO_BIN2("/getblocks_by_height.bin", on_get_blocks_by_height, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT)
+      MAP_URI2("/get_blocks.bin", on_get_blocks_bin)
+      MAP_URI2("/getblocks.bin", on_get_blocks_bin)
+      MAP_URI2("/get_blocks_by_height.bin", on_get_blocks_by_height_bin)
+      MAP_URI2("/getblocks_by_height.bin", on_get_blocks_by_height_bin)
       MAP_URI_AUTO_BIN2("/get_hashes.bin", on_get_hashes, COMMAND_RPC_GET_HASHES_FAST)
       MAP_URI_AUTO_BIN2("/gethashes.bin", on_get_hashes, COMMAND_RPC_GET_HASHES_FAST)
       MAP_URI_AUTO_BIN2("/get_o_indexes.bin", on_get_indexes, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES)      
@@ -92,6 +105,7 @@ namespace cryptonote
       MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/get_alt_blocks_hashes", on_get_alt_blocks_hashes, COMMAND_RPC_GET_ALT_BLOCKS_HASHES)
       MAP_URI_AUTO_JON2("/is_key_image_spent", on_is_key_image_spent, COMMAND_RPC_IS_KEY_IMAGE_SPENT)
+      MAP_URI_AUTO_BIN2("/is_key_image_spent.bin", on_is_key_image_spent_bin, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN)
       MAP_URI_AUTO_JON2("/send_raw_transaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
       MAP_URI_AUTO_JON2("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
       MAP_URI_AUTO_JON2_IF("/start_mining", on_start_mining, COMMAND_RPC_START_MINING, !m_restricted)
@@ -102,6 +116,8 @@ namespace cryptonote
       MAP_URI_AUTO_JON2_IF("/set_log_hash_rate", on_set_log_hash_rate, COMMAND_RPC_SET_LOG_HASH_RATE, !m_restricted)
       MAP_URI_AUTO_JON2_IF("/set_log_level", on_set_log_level, COMMAND_RPC_SET_LOG_LEVEL, !m_restricted)
       MAP_URI_AUTO_JON2_IF("/set_log_categories", on_set_log_categories, COMMAND_RPC_SET_LOG_CATEGORIES, !m_restricted)
+      MAP_URI_AUTO_JON2_IF("/perf_trace", on_perf_trace, COMMAND_RPC_PERF_TRACE, !m_restricted)
+      MAP_URI_AUTO_JON2_IF("/get_alloc_stats", on_get_alloc_stats, COMMAND_RPC_GET_ALLOC_STATS, !m_restricted)
       MAP_URI_AUTO_JON2("/get_transaction_pool", on_get_transaction_pool, COMMAND_RPC_GET_TRANSACTION_POOL)
       MAP_URI_AUTO_JON2("/get_transaction_pool_hashes.bin", on_get_transaction_pool_hashes_bin, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN)
       MAP_URI_AUTO_JON2("/get_transaction_pool_hashes", on_get_transaction_pool_hashes, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES)
@@ -119,7 +135,15 @@ namespace cryptonote
       MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
       MAP_URI_AUTO_BIN2("/get_output_distribution.bin", on_get_output_distribution_bin, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
       MAP_URI_AUTO_BIN2("/get_output_blacklist.bin", on_get_output_blacklist_bin, COMMAND_RPC_GET_OUTPUT_BLACKLIST)
+      MAP_URI_AUTO_BIN2("/get_full_nodes.bin", on_get_full_nodes_bin, COMMAND_RPC_GET_FULL_NODES)
+      MAP_URI_AUTO_JON2_IF("/login", on_login, COMMAND_RPC_LOGIN, m_core.get_light_wallet_scanner().enabled())
+      MAP_URI_AUTO_JON2_IF("/import_wallet_request", on_import_wallet_request, COMMAND_RPC_IMPORT_WALLET_REQUEST, m_core.get_light_wallet_scanner().enabled())
+      MAP_URI_AUTO_JON2_IF("/get_address_info", on_get_address_info, COMMAND_RPC_GET_ADDRESS_INFO, m_core.get_light_wallet_scanner().enabled())
+      MAP_URI_AUTO_JON2_IF("/get_address_txs", on_get_address_txs, COMMAND_RPC_GET_ADDRESS_TXS, m_core.get_light_wallet_scanner().enabled())
+      MAP_URI_AUTO_JON2_IF("/get_unspent_outs", on_get_unspent_outs, COMMAND_RPC_GET_UNSPENT_OUTS, m_core.get_light_wallet_scanner().enabled())
+      MAP_URI_AUTO_JON2_IF("/submit_raw_tx", on_submit_raw_tx, COMMAND_RPC_SUBMIT_RAW_TX, m_core.get_light_wallet_scanner().enabled())
       MAP_URI_AUTO_JON2_IF("/pop_blocks", on_pop_blocks, COMMAND_RPC_POP_BLOCKS, !m_restricted)
+      MAP_URI2("/metrics", on_metrics)
       BEGIN_JSON_RPC_MAP("/json_rpc")
         MAP_JON_RPC("get_block_count",           on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
         MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
@@ -170,20 +194,30 @@ namespace cryptonote
         MAP_JON_RPC_WE("get_all_full_nodes_keys",             on_get_all_full_nodes_keys, COMMAND_RPC_GET_ALL_FULL_NODES_KEYS)
         MAP_JON_RPC_WE("get_staking_requirement",                on_get_staking_requirement, COMMAND_RPC_GET_STAKING_REQUIREMENT)
         MAP_JON_RPC_WE("get_show_article",                         on_show_article, COMMAND_RPC_SHOW_ARTICLE)
-      END_JSON_RPC_MAP()
+        MAP_JON_RPC_WE("list_articles",                            on_list_articles, COMMAND_RPC_LIST_ARTICLES)
+        MAP_JON_RPC_WE("search_articles",                          on_search_articles, COMMAND_RPC_SEARCH_ARTICLES)
+      END_JSON_RPC_MAP_BATCH(run_json_rpc_batch)
     END_URI_MAP2()
 
      bool on_show_article(const COMMAND_RPC_SHOW_ARTICLE::request& req,
                                       COMMAND_RPC_SHOW_ARTICLE::response& res, epee::json_rpc::error& error_resp,
                                       const connection_context* ctx = NULL);
+    bool on_list_articles(const COMMAND_RPC_LIST_ARTICLES::request& req, COMMAND_RPC_LIST_ARTICLES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_search_articles(const COMMAND_RPC_SEARCH_ARTICLES::request& req, COMMAND_RPC_SEARCH_ARTICLES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     //bool on_show_article(const COMMAND_RPC_SHOW_ARTICLE::request& req, COMMAND_RPC_SHOW_ARTICLE::response& res,  const connection_context *ctx = NULL);
     bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, const connection_context *ctx = NULL);
+    // Prometheus text exposition of the perf timers and RPC lanes
+    bool on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx = NULL);
+    // streamed with chunked transfer encoding, falling back to on_get_blocks/on_get_blocks_by_height
+    bool on_get_blocks_bin(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx = NULL);
+    bool on_get_blocks_by_height_bin(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx = NULL);
     bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, const connection_context *ctx = NULL);
     bool on_get_alt_blocks_hashes(const COMMAND_RPC_GET_ALT_BLOCKS_HASHES::request& req, COMMAND_RPC_GET_ALT_BLOCKS_HASHES::response& res, const connection_context *ctx = NULL);
     bool on_get_blocks_by_height(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response& res, const connection_context *ctx = NULL);
     bool on_get_hashes(const COMMAND_RPC_GET_HASHES_FAST::request& req, COMMAND_RPC_GET_HASHES_FAST::response& res, const connection_context *ctx = NULL);
     bool on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request& req, COMMAND_RPC_GET_TRANSACTIONS::response& res, const connection_context *ctx = NULL);
     bool on_is_key_image_spent(const COMMAND_RPC_IS_KEY_IMAGE_SPENT::request& req, COMMAND_RPC_IS_KEY_IMAGE_SPENT::response& res, const connection_context *ctx = NULL);
+    bool on_is_key_image_spent_bin(const COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request& req, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response& res, const connection_context *ctx = NULL);
     bool on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res, const connection_context *ctx = NULL);
     bool on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMMAND_RPC_SEND_RAW_TX::response& res, const connection_context *ctx = NULL);
     bool on_start_mining(const COMMAND_RPC_START_MINING::request& req, COMMAND_RPC_START_MINING::response& res, const connection_context *ctx = NULL);
@@ -197,6 +231,8 @@ namespace cryptonote
     bool on_set_log_hash_rate(const COMMAND_RPC_SET_LOG_HASH_RATE::request& req, COMMAND_RPC_SET_LOG_HASH_RATE::response& res, const connection_context *ctx = NULL);
     bool on_set_log_level(const COMMAND_RPC_SET_LOG_LEVEL::request& req, COMMAND_RPC_SET_LOG_LEVEL::response& res, const connection_context *ctx = NULL);
     bool on_set_log_categories(const COMMAND_RPC_SET_LOG_CATEGORIES::request& req, COMMAND_RPC_SET_LOG_CATEGORIES::response& res, const connection_context *ctx = NULL);
+    bool on_perf_trace(const COMMAND_RPC_PERF_TRACE::request& req, COMMAND_RPC_PERF_TRACE::response& res, const connection_context *ctx = NULL);
+    bool on_get_alloc_stats(const COMMAND_RPC_GET_ALLOC_STATS::request& req, COMMAND_RPC_GET_ALLOC_STATS::response& res, const connection_context *ctx = NULL);
     bool on_get_transaction_pool(const COMMAND_RPC_GET_TRANSACTION_POOL::request& req, COMMAND_RPC_GET_TRANSACTION_POOL::response& res, const connection_context *ctx = NULL);
     bool on_get_transaction_pool_hashes_bin(const COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response& res, const connection_context *ctx = NULL);
     bool on_get_transaction_pool_hashes(const COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::response& res, const connection_context *ctx = NULL);
@@ -216,6 +252,15 @@ namespace cryptonote
     // Antd
     //
     bool on_get_output_blacklist_bin(const COMMAND_RPC_GET_OUTPUT_BLACKLIST::request& req, COMMAND_RPC_GET_OUTPUT_BLACKLIST::response& res, const connection_context *ctx = NULL);
+    bool on_get_full_nodes_bin(const COMMAND_RPC_GET_FULL_NODES::request& req, COMMAND_RPC_GET_FULL_NODES::response& res, const connection_context *ctx = NULL);
+
+    // light wallet, served from core's light_wallet_scanner
+    bool on_login(const COMMAND_RPC_LOGIN::request& req, COMMAND_RPC_LOGIN::response& res, const connection_context *ctx = NULL);
+    bool on_import_wallet_request(const COMMAND_RPC_IMPORT_WALLET_REQUEST::request& req, COMMAND_RPC_IMPORT_WALLET_REQUEST::response& res, const connection_context *ctx = NULL);
+    bool on_get_address_info(const COMMAND_RPC_GET_ADDRESS_INFO::request& req, COMMAND_RPC_GET_ADDRESS_INFO::response& res, const connection_context *ctx = NULL);
+    bool on_get_address_txs(const COMMAND_RPC_GET_ADDRESS_TXS::request& req, COMMAND_RPC_GET_ADDRESS_TXS::response& res, const connection_context *ctx = NULL);
+    bool on_get_unspent_outs(const COMMAND_RPC_GET_UNSPENT_OUTS::request& req, COMMAND_RPC_GET_UNSPENT_OUTS::response& res, const connection_context *ctx = NULL);
+    bool on_submit_raw_tx(const COMMAND_RPC_SUBMIT_RAW_TX::request& req, COMMAND_RPC_SUBMIT_RAW_TX::response& res, const connection_context *ctx = NULL);
 
     //json_rpc
     bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res, const connection_context *ctx = NULL);
@@ -265,10 +310,37 @@ private:
     bool check_core_busy();
     bool check_core_ready();
     bool add_host_fail(const connection_context *ctx, unsigned int score = 1);
+    bool get_light_wallet_keys(const std::string& address, const std::string& view_key, account_public_address& addr, crypto::secret_key& key);
+    bool get_light_wallet_account(const std::string& address, const std::string& view_key, light_wallet_scanner::account_state& acc);
 
     //utils
-    uint64_t get_block_reward(const block& blk);
+    uint64_t get_block_reward(const transaction& miner_tx);
     bool fill_block_header_response(const block& blk, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_response& response, bool fill_pow_hash);
+    bool fill_block_header_response(const block_header& hdr, const transaction& miner_tx, size_t tx_count, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_response& response);
+    bool get_key_images_spent_status(const std::vector<crypto::key_image>& key_images, std::vector<uint8_t>& spent_status, const connection_context *ctx);
+    // Responses that only change when a block is added or the pool changes,
+    // reused for as long as the top block hash, pool cookie and request
+    // parameter they were computed for are current
+    template <typename COMMAND_TYPE>
+    struct cached_response
+    {
+      bool valid = false;
+      crypto::hash top_hash = crypto::null_hash;
+      uint64_t pool_cookie = 0;
+      uint64_t param = 0;
+      typename COMMAND_TYPE::response response;
+    };
+    template <typename COMMAND_TYPE>
+    bool get_cached_response(const cached_response<COMMAND_TYPE> &cache, const crypto::hash &top_hash, uint64_t pool_cookie, uint64_t param, typename COMMAND_TYPE::response &res);
+    template <typename COMMAND_TYPE>
+    void set_cached_response(cached_response<COMMAND_TYPE> &cache, const crypto::hash &top_hash, uint64_t pool_cookie, uint64_t param, const typename COMMAND_TYPE::response &res);
+    void fill_chain_info(COMMAND_RPC_GET_INFO::response& res);
+    bool fill_articles_response(uint64_t start_height, uint64_t end_height, const crypto::hash *publisher_hash, const crypto::hash *content_hash, uint64_t offset, uint32_t limit, bool include_content, COMMAND_RPC_LIST_ARTICLES::response& res, epee::json_rpc::error& error_resp);
+    // runs a JSON-RPC batch in order, with each run of consecutive read-only
+    // methods spread over the thread pool
+    void run_json_rpc_batch(const std::vector<std::string>& methods, std::vector<std::function<void()>>& jobs);
+    rpc::cost_class classify_request(const epee::net_utils::http::http_request_info& query_info) const;
+    unsigned request_cost(const epee::net_utils::http::http_request_info& query_info) const;
     enum invoke_http_mode { JON, BIN, JON_RPC };
     template <typename COMMAND_TYPE>
     bool use_bootstrap_daemon_if_necessary(const invoke_http_mode &mode, const std::string &command_name, const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res, bool &r);
@@ -276,15 +348,27 @@ private:
     core& m_core;
     nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& m_p2p;
     std::string m_bootstrap_daemon_address;
-    epee::net_utils::http::http_simple_client m_http_client;
+    std::unique_ptr<bootstrap_daemon> m_bootstrap_daemon;
     boost::shared_mutex m_bootstrap_daemon_mutex;
     bool m_should_use_bootstrap_daemon;
     std::chrono::system_clock::time_point m_bootstrap_height_check_time;
-    bool m_was_bootstrap_ever_used;
+    std::atomic<bool> m_was_bootstrap_ever_used;
     network_type m_nettype;
     bool m_restricted;
     epee::critical_section m_host_fails_score_lock;
     std::map<std::string, uint64_t> m_host_fails_score;
+    size_t m_threads_count;
+    rpc::request_lanes m_lanes;
+    rpc::rate_limiter m_rate_limiter;
+
+    boost::shared_mutex m_response_cache_mutex;
+    cached_response<COMMAND_RPC_GET_INFO> m_info_cache; // only the chain fields, see fill_chain_info
+    cached_response<COMMAND_RPC_GET_LAST_BLOCK_HEADER> m_last_block_header_cache;
+    cached_response<COMMAND_RPC_GET_BASE_FEE_ESTIMATE> m_fee_estimate_cache;
+    cached_response<COMMAND_RPC_HARD_FORK_INFO> m_hard_fork_info_cache;
+    cached_response<COMMAND_RPC_GET_ALL_FULL_NODES_KEYS> m_full_nodes_keys_cache[2]; // by fully_funded_nodes_only, keyed by the key list hash rather than the top block
+
+    const uint64_t m_pool_cookie_salt; // keeps pool cookies from matching across restarts
   };
 }
 
@@ -87,7 +87,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 2
-#define CORE_RPC_VERSION_MINOR 3
+#define CORE_RPC_VERSION_MINOR 14
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -122,11 +122,13 @@ namespace cryptonote
       uint64_t    start_height;
       bool        prune;
       bool        no_miner_tx;
+      bool        scan_digest; // send a tx_scan_digest per tx instead of the txs themselves
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
         KV_SERIALIZE(start_height)
         KV_SERIALIZE(prune)
         KV_SERIALIZE_OPT(no_miner_tx, false)
+        KV_SERIALIZE_OPT(scan_digest, false)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -148,6 +150,34 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
 
+    // what a wallet needs to tell whether a tx concerns it: the keys to
+    // derive from, the output keys to match and the key images to look up
+    struct tx_scan_digest
+    {
+      bool standard; // other types are never scanned, the lists are empty
+      std::vector<crypto::public_key> pub_keys;
+      std::vector<crypto::public_key> additional_pub_keys;
+      std::vector<crypto::public_key> output_keys; // null_pkey for outputs not to a key
+      std::vector<crypto::key_image> key_images;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(standard)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(pub_keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(additional_pub_keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(output_keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct block_scan_digest
+    {
+      std::vector<tx_scan_digest> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response
     {
       std::vector<block_complete_entry> blocks;
@@ -156,6 +186,7 @@ namespace cryptonote
       std::string status;
       std::vector<block_output_indices> output_indices;
       bool untrusted;
+      std::vector<block_scan_digest> scan_digests; // if requested, one per block, and the blocks come without txs
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(blocks)
@@ -164,6 +195,7 @@ namespace cryptonote
         KV_SERIALIZE(status)
         KV_SERIALIZE(output_indices)
         KV_SERIALIZE(untrusted)
+        KV_SERIALIZE(scan_digests)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -569,10 +601,12 @@ namespace cryptonote
       {
         std::string address;
         std::string view_key;
+        uint64_t from_height; // where the scan restarts, the whole chain if not given
 
         BEGIN_KV_SERIALIZE_MAP()
           KV_SERIALIZE(address)
           KV_SERIALIZE(view_key)
+          KV_SERIALIZE_OPT(from_height, (uint64_t)0)
         END_KV_SERIALIZE_MAP()
       };
 
@@ -701,6 +735,33 @@ namespace cryptonote
     };
   };
 
+  //-----------------------------------------------
+  // as COMMAND_RPC_IS_KEY_IMAGE_SPENT, with key images and statuses packed in blobs
+  struct COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN
+  {
+    struct request
+    {
+      std::vector<crypto::key_image> key_images;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::vector<uint8_t> spent_status; // COMMAND_RPC_IS_KEY_IMAGE_SPENT::STATUS, one byte per key image
+      std::string status;
+      bool untrusted;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(spent_status)
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(untrusted)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   //-----------------------------------------------
   struct COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES
   {
@@ -743,10 +804,12 @@ namespace cryptonote
     {
       std::vector<get_outputs_out> outputs;
       bool get_txid;
+      bool packed; // ask for the packed arrays below rather than outs, older daemons ignore it
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(outputs)
         KV_SERIALIZE_OPT(get_txid, true)
+        KV_SERIALIZE_OPT(packed, false)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -773,10 +836,52 @@ namespace cryptonote
       std::string status;
       bool untrusted;
 
+      // packed form of outs, one entry per output, txids only if asked for
+      std::vector<crypto::public_key> keys;
+      std::vector<rct::key> masks;
+      std::vector<uint64_t> heights;
+      std::vector<crypto::hash> txids;
+      std::string unlocked; // bitmap, lowest bit of the first byte for the first output
+
+      void pack()
+      {
+        keys.resize(outs.size());
+        masks.resize(outs.size());
+        heights.resize(outs.size());
+        txids.clear();
+        unlocked.assign((outs.size() + 7) / 8, 0);
+        for (size_t i = 0; i < outs.size(); ++i)
+        {
+          keys[i] = outs[i].key;
+          masks[i] = outs[i].mask;
+          heights[i] = outs[i].height;
+          if (outs[i].unlocked)
+            unlocked[i / 8] |= 1 << (i % 8);
+        }
+      }
+
+      // rebuilds outs from the packed form, if the daemon sent that
+      bool unpack(bool get_txid)
+      {
+        if (!outs.empty() || keys.empty())
+          return true;
+        if (masks.size() != keys.size() || heights.size() != keys.size() || unlocked.size() != (keys.size() + 7) / 8 || (get_txid && txids.size() != keys.size()))
+          return false;
+        outs.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+          outs[i] = {keys[i], masks[i], !!(unlocked[i / 8] & (1 << (i % 8))), heights[i], get_txid ? txids[i] : crypto::null_hash};
+        return true;
+      }
+
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(outs)
         KV_SERIALIZE(status)
         KV_SERIALIZE(untrusted)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(masks)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(heights)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txids)
+        KV_SERIALIZE(unlocked)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -980,16 +1085,22 @@ namespace cryptonote
     struct request
     {
       bool fully_funded_nodes_only; // Return keys for fullnodes if they are funded and working on the network
+      std::string keys_hash; // from a previous response, empty for none
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_OPT(fully_funded_nodes_only, (bool)true)
+        KV_SERIALIZE_OPT(keys_hash, std::string())
       END_KV_SERIALIZE_MAP()
     };
 
     struct response
     {
-      std::vector<std::string> keys; // NOTE: Returns as base32z of the hex key, for Antdnet internal usage
+      std::vector<std::string> keys; // NOTE: Returns as base32z of the hex key, for Antdnet internal usage, sorted by key
+      std::string keys_hash; // hash of the key list, changes whenever the list does
+      bool unchanged; // the list still hashes to the request's keys_hash, keys is left empty
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(keys)
+        KV_SERIALIZE_OPT(keys_hash, std::string())
+        KV_SERIALIZE_OPT(unchanged, false)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -1035,6 +1146,7 @@ namespace cryptonote
       uint32_t threads_count;
       std::string address;
       bool is_background_mining_enabled;
+      std::vector<uint64_t> thread_speeds;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -1043,6 +1155,7 @@ namespace cryptonote
         KV_SERIALIZE(threads_count)
         KV_SERIALIZE(address)
         KV_SERIALIZE(is_background_mining_enabled)
+        KV_SERIALIZE(thread_speeds)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -1440,6 +1553,68 @@ namespace cryptonote
     };
   };
 
+  struct COMMAND_RPC_PERF_TRACE
+  {
+    struct request
+    {
+      std::string action; // "start", "stop", "dump", or empty to only get the state
+      uint64_t events_per_thread; // ring buffer size for "start", 0 for the default
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(action)
+        KV_SERIALIZE_OPT(events_per_thread, (uint64_t)0)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      bool enabled;
+      std::string trace; // Chrome trace event JSON, for "dump"
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(enabled)
+        KV_SERIALIZE(trace)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_ALLOC_STATS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct entry
+    {
+      std::string scope;
+      uint64_t allocations;
+      uint64_t bytes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(scope)
+        KV_SERIALIZE(allocations)
+        KV_SERIALIZE(bytes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      bool enabled; // false unless the daemon was built with ALLOC_PROFILING
+      std::vector<entry> scopes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(enabled)
+        KV_SERIALIZE(scopes)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_SET_LOG_CATEGORIES
   {
     struct request
@@ -1541,7 +1716,10 @@ namespace cryptonote
   {
     struct request
     {
+      uint64_t pool_cookie; // from a previous response, 0 for none
+
       BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_OPT(pool_cookie, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -1550,11 +1728,15 @@ namespace cryptonote
       std::string status;
       std::vector<crypto::hash> tx_hashes;
       bool untrusted;
+      uint64_t pool_cookie;
+      bool unchanged; // the pool is as it was at the request's pool_cookie, tx_hashes is left empty
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
         KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tx_hashes)
         KV_SERIALIZE(untrusted)
+        KV_SERIALIZE_OPT(pool_cookie, (uint64_t)0)
+        KV_SERIALIZE_OPT(unchanged, false)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -2412,9 +2594,11 @@ namespace cryptonote
     struct request
     {
       bool check;
+      bool background; // prune a step at a time from the daemon's idle loop instead of all at once
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_OPT(check, false)
+        KV_SERIALIZE_OPT(background, false)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2587,15 +2771,37 @@ namespace cryptonote
     {
       std::vector<std::string> full_node_pubkeys; // pass empty vector to get all the fullnodes
       bool include_json;
-      
+      std::vector<std::string> fields;            // names of the entry fields to return, empty for all of them. full_node_pubkey is always returned
+      std::string              cursor;            // when paging, return the nodes ordered after this pubkey, pass next_cursor from the previous page
+      uint32_t                 limit;             // maximum number of nodes to return ordered by pubkey, 0 for no paging
+
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(full_node_pubkeys);
         KV_SERIALIZE(include_json);
+        KV_SERIALIZE(fields);
+        KV_SERIALIZE(cursor);
+        KV_SERIALIZE_OPT(limit, (uint32_t)0);
       END_KV_SERIALIZE_MAP()
     };
 
     struct response
     {
+      enum field : uint32_t
+      {
+        field_registration_height           = 1 << 0,
+        field_requested_unlock_height       = 1 << 1,
+        field_last_reward_block_height      = 1 << 2,
+        field_last_reward_transaction_index = 1 << 3,
+        field_last_uptime_proof             = 1 << 4,
+        field_contributors                  = 1 << 5,
+        field_total_contributed             = 1 << 6,
+        field_total_reserved                = 1 << 7,
+        field_staking_requirement           = 1 << 8,
+        field_portions_for_operator         = 1 << 9,
+        field_operator_address              = 1 << 10,
+        field_all                           = (1 << 11) - 1,
+      };
+
       struct contribution
       {
         std::string key_image;
@@ -2639,30 +2845,36 @@ namespace cryptonote
         uint64_t                  portions_for_operator;
         std::string               operator_address;
 
+        uint32_t                  fields = field_all; // not serialized, the fields that get stored
+
+#define KV_SERIALIZE_FULL_NODE_FIELD(name) if (this_ref.fields & field_##name) KV_SERIALIZE(name)
         BEGIN_KV_SERIALIZE_MAP()
             KV_SERIALIZE(full_node_pubkey)
-            KV_SERIALIZE(registration_height)
-            KV_SERIALIZE(requested_unlock_height)
-            KV_SERIALIZE(last_reward_block_height)
-            KV_SERIALIZE(last_reward_transaction_index)
-            KV_SERIALIZE(last_uptime_proof)
-            KV_SERIALIZE(contributors)
-            KV_SERIALIZE(total_contributed)
-            KV_SERIALIZE(total_reserved)
-            KV_SERIALIZE(staking_requirement)
-            KV_SERIALIZE(portions_for_operator)
-            KV_SERIALIZE(operator_address)
+            KV_SERIALIZE_FULL_NODE_FIELD(registration_height)
+            KV_SERIALIZE_FULL_NODE_FIELD(requested_unlock_height)
+            KV_SERIALIZE_FULL_NODE_FIELD(last_reward_block_height)
+            KV_SERIALIZE_FULL_NODE_FIELD(last_reward_transaction_index)
+            KV_SERIALIZE_FULL_NODE_FIELD(last_uptime_proof)
+            KV_SERIALIZE_FULL_NODE_FIELD(contributors)
+            KV_SERIALIZE_FULL_NODE_FIELD(total_contributed)
+            KV_SERIALIZE_FULL_NODE_FIELD(total_reserved)
+            KV_SERIALIZE_FULL_NODE_FIELD(staking_requirement)
+            KV_SERIALIZE_FULL_NODE_FIELD(portions_for_operator)
+            KV_SERIALIZE_FULL_NODE_FIELD(operator_address)
         END_KV_SERIALIZE_MAP()
+#undef KV_SERIALIZE_FULL_NODE_FIELD
       };
 
       std::vector<entry> full_node_states;
       std::string        status;
       std::string        as_json;
+      std::string        next_cursor; // pubkey to pass as the cursor for the next page, empty on the last page
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(full_node_states)
         KV_SERIALIZE(status)
         KV_SERIALIZE(as_json)
+        KV_SERIALIZE(next_cursor)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -2769,5 +2981,83 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
   };
+  struct article_entry
+  {
+    std::string txid;
+    uint64_t block_height;
+    std::string title;
+    std::string publisher;
+    std::string content_hash;
+    std::string content; // Only set when the request asked for it
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(txid)
+      KV_SERIALIZE(block_height)
+      KV_SERIALIZE(title)
+      KV_SERIALIZE(publisher)
+      KV_SERIALIZE(content_hash)
+      KV_SERIALIZE(content)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_LIST_ARTICLES
+  {
+    struct request
+    {
+      uint64_t start_height;
+      uint64_t end_height;    // Inclusive, 0 for the top of the chain
+      uint64_t offset;        // Number of matching articles to skip
+      uint32_t limit;         // Maximum number of articles to return
+      bool include_content;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_OPT(start_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(end_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(offset, (uint64_t)0)
+        KV_SERIALIZE_OPT(limit, (uint32_t)20)
+        KV_SERIALIZE_OPT(include_content, false)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      std::vector<article_entry> articles;
+      bool more;              // More articles match, ask again with offset + articles.size()
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(articles)
+        KV_SERIALIZE(more)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_SEARCH_ARTICLES
+  {
+    struct request
+    {
+      std::string publisher;    // Articles by this publisher
+      std::string content_hash; // Articles with this content hash, as hex
+      uint64_t start_height;
+      uint64_t end_height;      // Inclusive, 0 for the top of the chain
+      uint64_t offset;
+      uint32_t limit;
+      bool include_content;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(publisher)
+        KV_SERIALIZE(content_hash)
+        KV_SERIALIZE_OPT(start_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(end_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(offset, (uint64_t)0)
+        KV_SERIALIZE_OPT(limit, (uint32_t)20)
+        KV_SERIALIZE_OPT(include_content, false)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    typedef COMMAND_RPC_LIST_ARTICLES::response response;
+  };
+
 
 }
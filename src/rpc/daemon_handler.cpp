@@ -880,9 +880,7 @@ namespace rpc
         return BAD_REQUEST(request_type, req_full.getID());
       }
 
-      FullMessage resp_full = FullMessage::responseMessage(resp_message, req_full.getID());
-
-      const std::string response = resp_full.getJson();
+      const std::string response = FullMessage::responseJson(resp_message, req_full.getID());
       delete resp_message;
       resp_message = NULL;
 
@@ -125,6 +125,19 @@ rapidjson::Value GetBlocksFast::Response::toJson(rapidjson::Document& doc) const
   return val;
 }
 
+void GetBlocksFast::Response::toJson(json::writer& dest) const
+{
+  dest.StartObject();
+
+  writeBaseMembers(dest);
+  INSERT_INTO_JSON_WRITER(dest, blocks, blocks);
+  INSERT_INTO_JSON_WRITER(dest, start_height, start_height);
+  INSERT_INTO_JSON_WRITER(dest, current_height, current_height);
+  INSERT_INTO_JSON_WRITER(dest, output_indices, output_indices);
+
+  dest.EndObject();
+}
+
 void GetBlocksFast::Response::fromJson(rapidjson::Value& val)
 {
   GET_FROM_JSON_OBJECT(val, blocks, blocks);
@@ -165,6 +178,18 @@ rapidjson::Value GetHashesFast::Response::toJson(rapidjson::Document& doc) const
   return val;
 }
 
+void GetHashesFast::Response::toJson(json::writer& dest) const
+{
+  dest.StartObject();
+
+  writeBaseMembers(dest);
+  INSERT_INTO_JSON_WRITER(dest, hashes, hashes);
+  INSERT_INTO_JSON_WRITER(dest, start_height, start_height);
+  INSERT_INTO_JSON_WRITER(dest, current_height, current_height);
+
+  dest.EndObject();
+}
+
 void GetHashesFast::Response::fromJson(rapidjson::Value& val)
 {
   GET_FROM_JSON_OBJECT(val, hashes, hashes);
@@ -197,6 +222,16 @@ rapidjson::Value GetTransactions::Response::toJson(rapidjson::Document& doc) con
   return val;
 }
 
+void GetTransactions::Response::toJson(json::writer& dest) const
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, txs, txs);
+  INSERT_INTO_JSON_WRITER(dest, missed_hashes, missed_hashes);
+
+  dest.EndObject();
+}
+
 void GetTransactions::Response::fromJson(rapidjson::Value& val)
 {
   GET_FROM_JSON_OBJECT(val, txs, txs);
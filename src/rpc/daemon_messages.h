@@ -61,6 +61,17 @@ class classname \
         rapidjson::Value toJson(rapidjson::Document& doc) const; \
         void fromJson(rapidjson::Value& val);
 
+// for responses large enough that building them as a DOM first is a cost
+#define BEGIN_RPC_MESSAGE_STREAMED_RESPONSE \
+    class Response : public Message \
+    { \
+      public: \
+        Response() { *this = {}; } \
+        ~Response() { } \
+        rapidjson::Value toJson(rapidjson::Document& doc) const; \
+        void toJson(json::writer& dest) const override; \
+        void fromJson(rapidjson::Value& val);
+
 #define END_RPC_MESSAGE_REQUEST };
 #define END_RPC_MESSAGE_RESPONSE };
 #define END_RPC_MESSAGE_CLASS };
@@ -86,7 +97,7 @@ BEGIN_RPC_MESSAGE_CLASS(GetBlocksFast);
     uint64_t start_height;
     bool prune;
   END_RPC_MESSAGE_REQUEST;
-  BEGIN_RPC_MESSAGE_RESPONSE;
+  BEGIN_RPC_MESSAGE_STREAMED_RESPONSE;
     std::vector<cryptonote::rpc::block_with_transactions> blocks;
     uint64_t start_height;
     uint64_t current_height;
@@ -100,7 +111,7 @@ BEGIN_RPC_MESSAGE_CLASS(GetHashesFast);
     std::list<crypto::hash> known_hashes;
     uint64_t start_height;
   END_RPC_MESSAGE_REQUEST;
-  BEGIN_RPC_MESSAGE_RESPONSE;
+  BEGIN_RPC_MESSAGE_STREAMED_RESPONSE;
     std::vector<crypto::hash> hashes;
     uint64_t start_height;
     uint64_t current_height;
@@ -112,7 +123,7 @@ BEGIN_RPC_MESSAGE_CLASS(GetTransactions);
   BEGIN_RPC_MESSAGE_REQUEST;
     std::vector<crypto::hash> tx_hashes;
   END_RPC_MESSAGE_REQUEST;
-  BEGIN_RPC_MESSAGE_RESPONSE;
+  BEGIN_RPC_MESSAGE_STREAMED_RESPONSE;
     using txes_map = std::unordered_map<crypto::hash, transaction_info>;
     txes_map txs;
     std::vector<crypto::hash> missed_hashes;
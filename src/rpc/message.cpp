@@ -67,6 +67,19 @@ rapidjson::Value Message::toJson(rapidjson::Document& doc) const
   return val;
 }
 
+void Message::toJson(json::writer& dest) const
+{
+  rapidjson::Document doc;
+  toJson(doc).Accept(dest);
+}
+
+void Message::writeBaseMembers(json::writer& dest) const
+{
+  INSERT_INTO_JSON_WRITER(dest, status, status);
+  INSERT_INTO_JSON_WRITER(dest, error_details, error_details);
+  INSERT_INTO_JSON_WRITER(dest, rpc_version, DAEMON_RPC_VERSION_ZMQ);
+}
+
 void Message::fromJson(rapidjson::Value& val)
 {
   GET_FROM_JSON_OBJECT(val, status, status);
@@ -235,6 +248,33 @@ FullMessage FullMessage::responseMessage(Message* message, rapidjson::Value& id)
   return mes;
 }
 
+std::string FullMessage::responseJson(Message* message, rapidjson::Value& id)
+{
+  if (message->status != Message::STATUS_OK)
+  {
+    return responseMessage(message, id).getJson();
+  }
+
+  rapidjson::StringBuffer buf;
+  json::writer dest(buf);
+
+  dest.StartObject();
+
+  // required by JSON-RPC 2.0 spec
+  dest.Key("jsonrpc");
+  dest.String("2.0");
+
+  dest.Key(result_field);
+  message->toJson(dest);
+
+  dest.Key(id_field);
+  id.Accept(dest);
+
+  dest.EndObject();
+
+  return std::string(buf.GetString(), buf.GetSize());
+}
+
 FullMessage* FullMessage::timeoutMessage()
 {
   auto *full_message = new FullMessage();
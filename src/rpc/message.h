@@ -30,6 +30,7 @@
 
 #include "rapidjson/document.h"
 #include "rpc/message_data_structs.h"
+#include "serialization/json_object.h"
 #include <string>
 
 /* I normally hate using macros, but in this case it would be untenably
@@ -71,11 +72,19 @@ namespace rpc
 
       virtual rapidjson::Value toJson(rapidjson::Document& doc) const;
 
+      // Streams the message as a json object. Messages that don't override
+      // this build their rapidjson::Value and replay it into dest.
+      virtual void toJson(json::writer& dest) const;
+
       virtual void fromJson(rapidjson::Value& val);
 
       std::string status;
       std::string error_details;
       uint32_t rpc_version;
+
+    protected:
+      // writes the members above, for overrides of toJson(json::writer&)
+      void writeBaseMembers(json::writer& dest) const;
   };
 
   class FullMessage
@@ -107,6 +116,10 @@ namespace rpc
       static FullMessage responseMessage(Message* message);
       static FullMessage responseMessage(Message* message, rapidjson::Value& id);
 
+      // same json as responseMessage(message, id).getJson(), but the result
+      // is streamed instead of being copied into a document first
+      static std::string responseJson(Message* message, rapidjson::Value& id);
+
       static FullMessage* timeoutMessage();
     private:
 
@@ -0,0 +1,176 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <boost/asio/ip/address_v6.hpp>
+#include "int-util.h"
+#include "string_tools.h"
+
+namespace cryptonote
+{
+namespace rpc
+{
+  rate_limiter::rate_limiter()
+    : m_host_rate(0)
+    , m_subnet_rate(0)
+    , m_throttled_hosts(0)
+    , m_throttled_subnets(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rate_limiter::set_rates(uint64_t per_host, uint64_t per_subnet)
+  {
+    m_host_rate = per_host;
+    m_subnet_rate = per_subnet;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string rate_limiter::subnet_of(const epee::net_utils::network_address& address)
+  {
+    if (address.get_type_id() == epee::net_utils::ipv4_network_address::ID)
+    {
+      // ip() is in network byte order, keep the first three octets
+      const uint32_t ip = address.as<const epee::net_utils::ipv4_network_address>().ip();
+      return epee::string_tools::get_ip_string_from_int32(ip & SWAP32LE(0x00ffffff)) + "/24";
+    }
+    if (address.get_type_id() == epee::net_utils::ipv6_network_address::ID)
+    {
+      boost::system::error_code ec;
+      const boost::asio::ip::address_v6 ip = boost::asio::ip::make_address_v6(address.as<const epee::net_utils::ipv6_network_address>().ip(), ec);
+      if (ec)
+        return std::string();
+      boost::asio::ip::address_v6::bytes_type bytes = ip.to_bytes();
+      std::fill(bytes.begin() + 8, bytes.end(), 0);
+      return boost::asio::ip::address_v6(bytes).to_string() + "/64";
+    }
+    return std::string();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rate_limiter::bucket* rate_limiter::bucket_map::find(const std::string& key)
+  {
+    auto it = m_index.find(key);
+    return it == m_index.end() ? nullptr : &it->second->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rate_limiter::bucket& rate_limiter::bucket_map::touch(const std::string& key, const bucket& init)
+  {
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+    {
+      m_lru.emplace_back(key, init);
+      it = m_index.emplace(key, std::prev(m_lru.end())).first;
+    }
+    else
+    {
+      m_lru.splice(m_lru.end(), m_lru, it->second);
+    }
+    return it->second->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rate_limiter::bucket_map::evict(size_t max)
+  {
+    // the oldest buckets are the ones most likely to have refilled, and
+    // dropping one that has not only forgives that client its debt
+    while (m_index.size() > max)
+    {
+      m_index.erase(m_lru.front().first);
+      m_lru.pop_front();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  double rate_limiter::credits_at(const bucket& b, double rate, std::chrono::steady_clock::time_point now)
+  {
+    const double elapsed = std::chrono::duration<double>(now - b.updated).count();
+    return std::min(rate * RATE_LIMIT_BURST_SECONDS, b.credits + std::max(0.0, elapsed) * rate);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rate_limiter::try_charge(const epee::net_utils::network_address& address, unsigned cost, unsigned& retry_after, std::chrono::steady_clock::time_point now)
+  {
+    retry_after = 0;
+    if (!enabled())
+      return true;
+
+    const std::string host = address.host_str();
+    const std::string subnet = m_subnet_rate > 0 ? subnet_of(address) : std::string();
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    // a request costing more than a whole burst could never go through, so
+    // it may drain a full bucket instead. A host without a bucket has a full
+    // one, which is only created once the subnet lets the request through,
+    // so clients spraying addresses over a throttled subnet add no state
+    double host_credits = 0;
+    if (m_host_rate > 0)
+    {
+      const bucket* h = m_hosts.find(host);
+      host_credits = h ? credits_at(*h, m_host_rate, now) : m_host_rate * RATE_LIMIT_BURST_SECONDS;
+      const double needed = std::min<double>(cost, m_host_rate * RATE_LIMIT_BURST_SECONDS);
+      if (host_credits < needed)
+      {
+        retry_after = std::ceil((needed - host_credits) / m_host_rate);
+        m_throttled_hosts.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+    if (!subnet.empty())
+    {
+      bucket& s = m_subnets.touch(subnet, bucket{m_subnet_rate * RATE_LIMIT_BURST_SECONDS, now});
+      s.credits = credits_at(s, m_subnet_rate, now);
+      s.updated = now;
+      const double needed = std::min<double>(cost, m_subnet_rate * RATE_LIMIT_BURST_SECONDS);
+      if (s.credits < needed)
+      {
+        retry_after = std::ceil((needed - s.credits) / m_subnet_rate);
+        m_throttled_subnets.fetch_add(1, std::memory_order_relaxed);
+        m_subnets.evict(RATE_LIMIT_MAX_TRACKED);
+        return false;
+      }
+      s.credits = std::max(0.0, s.credits - cost);
+      m_subnets.evict(RATE_LIMIT_MAX_TRACKED);
+    }
+    if (m_host_rate > 0)
+    {
+      bucket& h = m_hosts.touch(host, bucket{0, now});
+      h.credits = std::max(0.0, host_credits - cost);
+      h.updated = now;
+      m_hosts.evict(RATE_LIMIT_MAX_TRACKED);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t rate_limiter::tracked() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_hosts.size() + m_subnets.size();
+  }
+}
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "net/net_utils_base.h"
+
+namespace cryptonote
+{
+namespace rpc
+{
+  //! how many seconds of credits a client may spend in one burst
+  static constexpr unsigned RATE_LIMIT_BURST_SECONDS = 10;
+  //! hosts, and separately subnets, tracked before the least recently charged are dropped
+  static constexpr size_t RATE_LIMIT_MAX_TRACKED = 65536;
+
+  /**
+   * @brief token bucket rate limiting of RPC clients by host and subnet
+   *
+   * Every request costs some credits; a host and its subnet (/24 for IPv4,
+   * /64 for IPv6) each have a bucket refilling at a fixed rate, holding at
+   * most RATE_LIMIT_BURST_SECONDS worth. A request is let through only if
+   * both buckets can pay for it, so a client spreading over many addresses
+   * of one subnet still shares the subnet's budget.
+   */
+  class rate_limiter
+  {
+  public:
+    rate_limiter();
+
+    //! credits per second per host and per subnet, 0 for no limit; set before the server starts
+    void set_rates(uint64_t per_host, uint64_t per_subnet);
+    bool enabled() const { return m_host_rate > 0 || m_subnet_rate > 0; }
+
+    /**
+     * @brief charge a request's cost to its host and subnet
+     *
+     * @param address the client
+     * @param cost the request's cost in credits
+     * @param retry_after set to the seconds until the request would go through, when it is refused
+     *
+     * @return false if the host or its subnet is out of credits
+     */
+    bool try_charge(const epee::net_utils::network_address& address, unsigned cost, unsigned& retry_after)
+    {
+      return try_charge(address, cost, retry_after, std::chrono::steady_clock::now());
+    }
+    //! as above, charging at the given time
+    bool try_charge(const epee::net_utils::network_address& address, unsigned cost, unsigned& retry_after, std::chrono::steady_clock::time_point now);
+
+    uint64_t throttled_hosts() const { return m_throttled_hosts.load(std::memory_order_relaxed); }
+    uint64_t throttled_subnets() const { return m_throttled_subnets.load(std::memory_order_relaxed); }
+    size_t tracked() const;
+
+    //! the subnet an address is charged to, empty for addresses without one (eg. tor)
+    static std::string subnet_of(const epee::net_utils::network_address& address);
+
+  private:
+    struct bucket
+    {
+      double credits;
+      std::chrono::steady_clock::time_point updated;
+    };
+
+    //! buckets by key, in the order they were last charged
+    class bucket_map
+    {
+    public:
+      bucket* find(const std::string& key);
+      //! the key's bucket, added with init if missing, made the most recent one
+      bucket& touch(const std::string& key, const bucket& init);
+      //! drops the least recently charged buckets beyond max
+      void evict(size_t max);
+      size_t size() const { return m_index.size(); }
+
+    private:
+      typedef std::list<std::pair<std::string, bucket>> lru_list;
+      lru_list m_lru; // least recent first
+      std::unordered_map<std::string, lru_list::iterator> m_index;
+    };
+
+    //! the credits a bucket has refilled to by now
+    static double credits_at(const bucket& b, double rate, std::chrono::steady_clock::time_point now);
+
+    double m_host_rate;
+    double m_subnet_rate;
+
+    mutable boost::mutex m_mutex;
+    bucket_map m_hosts;
+    bucket_map m_subnets;
+
+    std::atomic<uint64_t> m_throttled_hosts;
+    std::atomic<uint64_t> m_throttled_subnets;
+  };
+}
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+
+namespace cryptonote
+{
+namespace rpc
+{
+  //! how expensive an RPC call is, each class gets its own concurrency cap
+  enum class cost_class : uint8_t
+  {
+    light,  //!< cheap lookups: heights, headers, info
+    heavy,  //!< scans and bulk transfers: block sync, output histograms/distributions
+    mining, //!< latency sensitive block template/submission, never shares a cap
+  };
+
+  static constexpr size_t COST_CLASS_COUNT = 3;
+
+  //! the other lanes leave at least this many server threads to the mining lane
+  static constexpr size_t RESERVED_MINING_THREADS = 1;
+
+  //! the light lane gets at least this many slots however few threads there are
+  static constexpr size_t MIN_LIGHT_REQUESTS = 2;
+
+  inline const char* cost_class_name(cost_class c)
+  {
+    switch (c)
+    {
+      case cost_class::light: return "light";
+      case cost_class::heavy: return "heavy";
+      case cost_class::mining: return "mining";
+    }
+    return "unknown";
+  }
+
+  /**
+   * @brief per cost class admission control for RPC server threads
+   *
+   * Handlers run synchronously on the server's threads, so a request that
+   * cannot get a slot is rejected at once: waiting for one would hold a
+   * thread just the same.  Keeping the heavy and light caps below the thread
+   * count leaves threads free for the mining lane.
+   */
+  class request_lanes
+  {
+    struct lane_state
+    {
+      std::atomic<size_t> in_flight{0};
+      std::atomic<uint64_t> rejected{0};
+      size_t limit = std::numeric_limits<size_t>::max(); // set before the server starts
+
+      bool try_increment()
+      {
+        size_t current = in_flight.load(std::memory_order_relaxed);
+        do
+        {
+          if (current >= limit)
+            return false;
+        } while (!in_flight.compare_exchange_weak(current, current + 1));
+        return true;
+      }
+
+      void release()
+      {
+        in_flight.fetch_sub(1);
+      }
+    };
+
+  public:
+    //! RAII hold on one in-flight slot of a lane; false if the lane was full
+    class slot
+    {
+    public:
+      slot() : m_lane(nullptr) {}
+      explicit slot(lane_state* lane) : m_lane(lane) {}
+      slot(slot&& o) : m_lane(o.m_lane) { o.m_lane = nullptr; }
+      slot(const slot&) = delete;
+      slot& operator=(const slot&) = delete;
+      slot& operator=(slot&&) = delete;
+      ~slot() { if (m_lane) m_lane->release(); }
+
+      explicit operator bool() const { return m_lane != nullptr; }
+
+    private:
+      lane_state* m_lane;
+    };
+
+    //! 0 means unlimited
+    void set_limit(cost_class c, size_t max_in_flight)
+    {
+      lane(c).limit = max_in_flight ? max_in_flight : std::numeric_limits<size_t>::max();
+    }
+
+    /**
+     * @brief splits a server's threads between the lanes
+     *
+     * The light lane gets the threads left after the heavy and mining ones,
+     * but never fewer than MIN_LIGHT_REQUESTS.
+     *
+     * @param threads the number of threads serving the port
+     * @param reserved threads kept for the mining lane
+     * @param max_heavy cap on heavy requests, 0 for half of the unreserved threads
+     */
+    void configure(size_t threads, size_t reserved, size_t max_heavy)
+    {
+      const size_t unreserved = threads > reserved ? threads - reserved : 1;
+      const size_t heavy = max_heavy ? std::min(max_heavy, unreserved) : std::max<size_t>(1, unreserved / 2);
+      set_limit(cost_class::heavy, heavy);
+      set_limit(cost_class::light, std::max(MIN_LIGHT_REQUESTS, unreserved > heavy ? unreserved - heavy : 0));
+      set_limit(cost_class::mining, 0);
+    }
+
+    //! a full lane counts a rejection and gives an empty slot
+    slot try_acquire(cost_class c)
+    {
+      lane_state& l = lane(c);
+      if (l.try_increment())
+        return slot(&l);
+      l.rejected.fetch_add(1, std::memory_order_relaxed);
+      return slot();
+    }
+
+    size_t in_flight(cost_class c) const { return lane(c).in_flight.load(std::memory_order_relaxed); }
+    size_t limit(cost_class c) const { return lane(c).limit; }
+    uint64_t rejected(cost_class c) const { return lane(c).rejected.load(std::memory_order_relaxed); }
+
+  private:
+    lane_state& lane(cost_class c) { return m_lanes[static_cast<size_t>(c)]; }
+    const lane_state& lane(cost_class c) const { return m_lanes[static_cast<size_t>(c)]; }
+
+    std::array<lane_state, COST_CLASS_COUNT> m_lanes;
+  };
+}
+}
@@ -0,0 +1,291 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "zmq_pub.h"
+
+#include "int-util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "net.zmq"
+
+namespace cryptonote
+{
+
+namespace rpc
+{
+
+namespace
+{
+  void append_u32(std::string& s, uint32_t v)
+  {
+    v = SWAP32LE(v);
+    s.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  void append_u64(std::string& s, uint64_t v)
+  {
+    v = SWAP64LE(v);
+    s.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  template<typename T>
+  void append_pod(std::string& s, const T& v)
+  {
+    s.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  const char TOPIC_CHAIN_TIP[] = "chain_tip";
+  const char TOPIC_BLOCK[] = "block";
+  const char TOPIC_CHAIN_DETACHED[] = "chain_detached";
+  const char TOPIC_TXPOOL_ADD[] = "txpool_add";
+  const char TOPIC_TXPOOL_REMOVE[] = "txpool_remove";
+  const char TOPIC_FULL_NODES[] = "full_nodes";
+}
+
+ZmqPublisher::ZmqPublisher(cryptonote::core& core) :
+    m_core(core),
+    context(DEFAULT_NUM_ZMQ_THREADS),
+    m_dropped(0),
+    m_stop(false),
+    running(false)
+{
+}
+
+ZmqPublisher::~ZmqPublisher()
+{
+  stop();
+}
+
+bool ZmqPublisher::addTCPSocket(std::string address, std::string port)
+{
+  try
+  {
+    std::string addr_prefix("tcp://");
+
+    pub_socket.reset(new zmq::socket_t(context, ZMQ_PUB));
+
+    int linger = 0;
+    pub_socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+    if (address.empty())
+      address = "*";
+    if (port.empty())
+      port = "*";
+    std::string bind_address = addr_prefix + address + std::string(":") + port;
+    pub_socket->bind(bind_address.c_str());
+  }
+  catch (const std::exception& e)
+  {
+    MERROR(std::string("Error creating ZMQ PUB Socket: ") + e.what());
+    pub_socket.reset();
+    return false;
+  }
+  return true;
+}
+
+void ZmqPublisher::run()
+{
+  if (running || !pub_socket) return;
+
+  for (const auto& info: m_core.get_full_node_list().get_snapshot()->full_nodes_infos)
+    m_full_nodes.insert(info.first);
+
+  m_stop = false;
+  running = true;
+  run_thread = boost::thread(boost::bind(&ZmqPublisher::serve, this));
+
+  m_core.get_blockchain_storage().hook_block_added(*this);
+  m_core.get_blockchain_storage().hook_blockchain_detached(*this);
+  m_core.get_pool().hook_txs_changed(*this);
+}
+
+void ZmqPublisher::stop()
+{
+  if (!running) return;
+
+  // once these return no hook can still be running or be called again
+  m_core.get_pool().unhook_txs_changed(*this);
+  m_core.get_blockchain_storage().unhook_blockchain_detached(*this);
+  m_core.get_blockchain_storage().unhook_block_added(*this);
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_queue_mutex);
+    m_stop = true;
+  }
+  m_queue_cond.notify_one();
+  run_thread.join();
+
+  running = false;
+}
+
+void ZmqPublisher::block_added(const cryptonote::block& block, const std::vector<cryptonote::transaction>& txs)
+{
+  const uint64_t height = cryptonote::get_block_height(block);
+  const crypto::hash hash = cryptonote::get_block_hash(block);
+
+  std::string prefix;
+  append_u64(prefix, height);
+  append_pod(prefix, hash);
+
+  enqueue(TOPIC_CHAIN_TIP, prefix + t_serializable_object_to_blob(static_cast<const cryptonote::block_header&>(block)));
+  enqueue(TOPIC_BLOCK, prefix + cryptonote::block_to_blob(block));
+  enqueue(TOPIC_FULL_NODES, std::string());
+}
+
+void ZmqPublisher::blockchain_detached(uint64_t height)
+{
+  std::string payload;
+  append_u64(payload, height);
+  enqueue(TOPIC_CHAIN_DETACHED, std::move(payload));
+  enqueue(TOPIC_FULL_NODES, std::string());
+}
+
+void ZmqPublisher::tx_added(const crypto::hash& txid)
+{
+  enqueue_tx(TOPIC_TXPOOL_ADD, txid);
+}
+
+void ZmqPublisher::tx_removed(const crypto::hash& txid)
+{
+  enqueue_tx(TOPIC_TXPOOL_REMOVE, txid);
+}
+
+void ZmqPublisher::enqueue(const char* topic, std::string payload)
+{
+  {
+    boost::lock_guard<boost::mutex> lock(m_queue_mutex);
+    // the full node diff is computed when sent, so one pending is enough
+    if (payload.empty() && !m_queue.empty() && m_queue.back().topic == topic)
+      return;
+    if (m_queue.size() >= MAX_ZMQ_PUB_QUEUED_EVENTS)
+    {
+      m_queue.pop_front();
+      ++m_dropped;
+    }
+    m_queue.push_back(event{topic, std::move(payload)});
+  }
+  m_queue_cond.notify_one();
+}
+
+void ZmqPublisher::enqueue_tx(const char* topic, const crypto::hash& txid)
+{
+  {
+    boost::lock_guard<boost::mutex> lock(m_queue_mutex);
+    // coalesce runs of pool events (a block removing its txs, a batch of
+    // relayed txs) into one message
+    if (!m_queue.empty() && m_queue.back().topic == topic
+        && m_queue.back().payload.size() < MAX_ZMQ_PUB_TXS_PER_EVENT * sizeof(crypto::hash))
+    {
+      append_pod(m_queue.back().payload, txid);
+      return;
+    }
+  }
+  std::string payload;
+  append_pod(payload, txid);
+  enqueue(topic, std::move(payload));
+}
+
+bool ZmqPublisher::full_nodes_changed(std::string& payload)
+{
+  const auto snapshot = m_core.get_full_node_list().get_snapshot();
+
+  std::vector<crypto::public_key> added, removed;
+  for (const auto& info: snapshot->full_nodes_infos)
+    if (m_full_nodes.find(info.first) == m_full_nodes.end())
+      added.push_back(info.first);
+  for (const crypto::public_key& key: m_full_nodes)
+    if (snapshot->full_nodes_infos.find(key) == snapshot->full_nodes_infos.end())
+      removed.push_back(key);
+
+  if (added.empty() && removed.empty())
+    return false;
+
+  payload.clear();
+  payload.reserve(8 + 4 + 4 + (added.size() + removed.size()) * sizeof(crypto::public_key));
+  append_u64(payload, snapshot->height);
+  append_u32(payload, added.size());
+  for (const crypto::public_key& key: added)
+  {
+    append_pod(payload, key);
+    m_full_nodes.insert(key);
+  }
+  append_u32(payload, removed.size());
+  for (const crypto::public_key& key: removed)
+  {
+    append_pod(payload, key);
+    m_full_nodes.erase(key);
+  }
+  return true;
+}
+
+void ZmqPublisher::serve()
+{
+  while (true)
+  {
+    event ev;
+    size_t dropped;
+    {
+      boost::unique_lock<boost::mutex> lock(m_queue_mutex);
+      while (m_queue.empty() && !m_stop)
+        m_queue_cond.wait(lock);
+      if (m_stop)
+        break;
+      ev = std::move(m_queue.front());
+      m_queue.pop_front();
+      dropped = m_dropped;
+      m_dropped = 0;
+    }
+
+    if (dropped)
+      MWARNING("ZMQ publisher fell behind, dropped " << dropped << " events");
+
+    if (ev.topic == TOPIC_FULL_NODES && !full_nodes_changed(ev.payload))
+      continue;
+
+    try
+    {
+      zmq::message_t topic(ev.topic.size());
+      memcpy(topic.data(), ev.topic.data(), ev.topic.size());
+      zmq::message_t payload(ev.payload.size());
+      memcpy(payload.data(), ev.payload.data(), ev.payload.size());
+      pub_socket->send(topic, ZMQ_SNDMORE);
+      pub_socket->send(payload);
+    }
+    catch (const zmq::error_t& e)
+    {
+      MERROR(std::string("ZMQ publish error: ") + e.what());
+    }
+  }
+}
+
+
+}  // namespace rpc
+
+}  // namespace cryptonote
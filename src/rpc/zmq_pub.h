@@ -0,0 +1,128 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <zmq.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "cryptonote_core/cryptonote_core.h"
+#include "zmq_server.h"
+
+namespace cryptonote
+{
+
+namespace rpc
+{
+
+//! max events waiting for the publisher thread before the oldest are dropped
+static constexpr size_t MAX_ZMQ_PUB_QUEUED_EVENTS = 4096;
+//! max tx hashes coalesced into one txpool_add/txpool_remove message
+static constexpr size_t MAX_ZMQ_PUB_TXS_PER_EVENT = 1024;
+
+/**
+ * @brief publishes chain, pool and full node events on a zmq PUB socket
+ *
+ * Every message is two frames: the topic ("chain_tip", "block",
+ * "chain_detached", "txpool_add", "txpool_remove" or "full_nodes") and a
+ * binary payload, integers little endian:
+ *
+ *   chain_tip:      u64 height, 32 byte hash, block header blob
+ *   block:          u64 height, 32 byte hash, block blob
+ *   chain_detached: u64 new height
+ *   txpool_add:     one or more 32 byte tx hashes
+ *   txpool_remove:  one or more 32 byte tx hashes
+ *   full_nodes:     u64 height, u32 count + 32 byte keys added,
+ *                   u32 count + 32 byte keys removed
+ *
+ * The hooks run with the blockchain and/or pool locks held, so they only
+ * queue the event; a single thread owns the socket and drains the queue.
+ */
+class ZmqPublisher : public cryptonote::Blockchain::BlockAddedHook,
+                     public cryptonote::Blockchain::BlockchainDetachedHook,
+                     public cryptonote::tx_memory_pool::TxsChangedHook
+{
+  public:
+
+    ZmqPublisher(cryptonote::core& core);
+
+    ~ZmqPublisher();
+
+    bool addTCPSocket(std::string address, std::string port);
+
+    void run();
+    void stop();
+
+    void block_added(const cryptonote::block& block, const std::vector<cryptonote::transaction>& txs) override;
+    void blockchain_detached(uint64_t height) override;
+    void tx_added(const crypto::hash& txid) override;
+    void tx_removed(const crypto::hash& txid) override;
+
+#ifndef IN_UNIT_TESTS
+  private:
+#endif
+    struct event
+    {
+      std::string topic;
+      std::string payload;
+    };
+
+    void enqueue(const char* topic, std::string payload);
+    void enqueue_tx(const char* topic, const crypto::hash& txid);
+    bool full_nodes_changed(std::string& payload);
+    void serve();
+
+    cryptonote::core& m_core;
+
+    zmq::context_t context;
+    std::unique_ptr<zmq::socket_t> pub_socket;
+
+    boost::mutex m_queue_mutex;
+    boost::condition_variable m_queue_cond;
+    std::deque<event> m_queue;
+    size_t m_dropped;
+    bool m_stop;
+    bool running;
+
+    //! keys in the last published full_nodes event, only touched by the publisher thread
+    std::unordered_set<crypto::public_key> m_full_nodes;
+
+    boost::thread run_thread;
+};
+
+
+}  // namespace rpc
+
+}  // namespace cryptonote
@@ -0,0 +1,164 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "zmq_replica.h"
+
+#include <cstring>
+#include <ctime>
+
+#undef ANTD_DEFAULT_LOG_CATEGORY
+#define ANTD_DEFAULT_LOG_CATEGORY "net.zmq"
+
+namespace cryptonote
+{
+
+namespace rpc
+{
+
+namespace
+{
+  const char* const CHAIN_TOPICS[] = { "chain_tip", "chain_detached" };
+  const char* const POOL_TOPICS[] = { "txpool_add", "txpool_remove" };
+
+  bool is_topic(const zmq::message_t& msg, const char* topic)
+  {
+    return msg.size() == strlen(topic) && !memcmp(msg.data(), topic, msg.size());
+  }
+}
+
+ZmqReplica::ZmqReplica(cryptonote::core& core) :
+    m_core(core),
+    context(DEFAULT_NUM_ZMQ_THREADS),
+    m_stop(false),
+    running(false)
+{
+}
+
+ZmqReplica::~ZmqReplica()
+{
+  stop();
+}
+
+bool ZmqReplica::connect(const std::string& address)
+{
+  try
+  {
+    sub_socket.reset(new zmq::socket_t(context, ZMQ_SUB));
+
+    int linger = 0;
+    sub_socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+    for (const char* topic: CHAIN_TOPICS)
+      sub_socket->setsockopt(ZMQ_SUBSCRIBE, topic, strlen(topic));
+    for (const char* topic: POOL_TOPICS)
+      sub_socket->setsockopt(ZMQ_SUBSCRIBE, topic, strlen(topic));
+
+    sub_socket->connect(address.c_str());
+  }
+  catch (const std::exception& e)
+  {
+    MERROR(std::string("Error creating ZMQ SUB Socket: ") + e.what());
+    sub_socket.reset();
+    return false;
+  }
+  return true;
+}
+
+void ZmqReplica::run()
+{
+  if (running || !sub_socket) return;
+
+  m_stop = false;
+  running = true;
+  run_thread = boost::thread(boost::bind(&ZmqReplica::follow, this));
+}
+
+void ZmqReplica::stop()
+{
+  if (!running) return;
+
+  m_stop = true;
+  run_thread.join();
+
+  running = false;
+}
+
+void ZmqReplica::follow()
+{
+  // catch up with whatever the primary did before we subscribed
+  m_core.sync_from_primary(true, true);
+  time_t last_resync = time(NULL);
+
+  while (!m_stop)
+  {
+    bool chain = false, pool = false;
+    try
+    {
+      zmq::pollitem_t item = { static_cast<void*>(*sub_socket), 0, ZMQ_POLLIN, 0 };
+      zmq::poll(&item, 1, ZMQ_REPLICA_POLL_MS);
+
+      // drain everything queued so a burst of events costs one sync
+      zmq::message_t topic, payload;
+      while (sub_socket->recv(&topic, ZMQ_DONTWAIT))
+      {
+        if (topic.more())
+          sub_socket->recv(&payload);
+        for (const char* t: CHAIN_TOPICS)
+          chain |= is_topic(topic, t);
+        for (const char* t: POOL_TOPICS)
+          pool |= is_topic(topic, t);
+      }
+    }
+    catch (const zmq::error_t& e)
+    {
+      if (m_stop)
+        break;
+      MERROR(std::string("ZMQ replica error: ") + e.what());
+    }
+
+    const time_t now = time(NULL);
+    if (now - last_resync >= ZMQ_REPLICA_RESYNC_SECONDS)
+    {
+      chain = pool = true;
+      last_resync = now;
+    }
+
+    // mined txes leave the pool with the block, so a new tip means a pool pass too
+    if (chain || pool)
+    {
+      if (!m_core.sync_from_primary(chain, chain || pool))
+        MWARNING("Failed to sync from the primary daemon, retrying on the next event");
+    }
+  }
+}
+
+
+}  // namespace rpc
+
+}  // namespace cryptonote
@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/thread.hpp>
+#include <zmq.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "cryptonote_core/cryptonote_core.h"
+#include "zmq_server.h"
+
+namespace cryptonote
+{
+
+namespace rpc
+{
+
+//! how long the replica waits for an event before checking whether to stop
+static constexpr int ZMQ_REPLICA_POLL_MS = 1000;
+//! a full resync runs this often even without events, to make up for dropped ones
+static constexpr int ZMQ_REPLICA_RESYNC_SECONDS = 10;
+
+/**
+ * @brief keeps a read replica's core in step with its primary daemon
+ *
+ * Subscribes to the primary's ZmqPublisher and, on chain or pool events,
+ * has the core re-read the shared DB. Events only say that something
+ * changed; what changed is always taken from the DB, so a dropped or
+ * coalesced message just delays the replica until the next one or the
+ * periodic resync.
+ */
+class ZmqReplica
+{
+  public:
+
+    ZmqReplica(cryptonote::core& core);
+
+    ~ZmqReplica();
+
+    bool connect(const std::string& address);
+
+    void run();
+    void stop();
+
+  private:
+    void follow();
+
+    cryptonote::core& m_core;
+
+    zmq::context_t context;
+    std::unique_ptr<zmq::socket_t> sub_socket;
+
+    std::atomic<bool> m_stop;
+    bool running;
+
+    boost::thread run_thread;
+};
+
+
+}  // namespace rpc
+
+}  // namespace cryptonote
@@ -34,11 +34,35 @@ namespace cryptonote
 namespace rpc
 {
 
-ZmqServer::ZmqServer(RpcHandler& h) :
+namespace
+{
+
+const char WORKERS_ENDPOINT[] = "inproc://zmq-rpc-workers";
+
+// moves one multipart message, routing envelope included, between the proxy sockets
+void forward_message(zmq::socket_t& from, zmq::socket_t& to)
+{
+  while (1)
+  {
+    zmq::message_t message;
+    from.recv(&message);
+    int more = 0;
+    size_t more_size = sizeof(more);
+    from.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+    to.send(message, more ? ZMQ_SNDMORE : 0);
+    if (!more)
+      break;
+  }
+}
+
+}
+
+ZmqServer::ZmqServer(RpcHandler& h, size_t num_workers) :
     handler(h),
     stop_signal(false),
     running(false),
-    context(DEFAULT_NUM_ZMQ_THREADS) // TODO: make this configurable
+    context(DEFAULT_NUM_ZMQ_THREADS), // TODO: make this configurable
+    num_workers(num_workers ? num_workers : 1)
 {
 }
 
@@ -49,17 +73,62 @@ ZmqServer::~ZmqServer()
 void ZmqServer::serve()
 {
 
-  while (1)
+  while (!stop_signal)
   {
     try
     {
-      zmq::message_t message;
-
-      if (!rep_socket)
+      if (!frontend_socket || !backend_socket)
+      {
+        throw std::runtime_error("ZMQ RPC server socket is null");
+      }
+      zmq::pollitem_t items[] = {
+        { static_cast<void*>(*frontend_socket), 0, ZMQ_POLLIN, 0 },
+        { static_cast<void*>(*backend_socket), 0, ZMQ_POLLIN, 0 },
+      };
+      while (!stop_signal && zmq::poll(items, 2, DEFAULT_RPC_RECV_TIMEOUT_MS) >= 0)
       {
-        throw std::runtime_error("ZMQ RPC server reply socket is null");
+        if (items[0].revents & ZMQ_POLLIN)
+          forward_message(*frontend_socket, *backend_socket);
+        if (items[1].revents & ZMQ_POLLIN)
+          forward_message(*backend_socket, *frontend_socket);
+        boost::this_thread::interruption_point();
       }
-      while (rep_socket->recv(&message))
+    }
+    catch (const boost::thread_interrupted& e)
+    {
+      MDEBUG("ZMQ Server thread interrupted.");
+      break;
+    }
+    catch (const zmq::error_t& e)
+    {
+      MERROR(std::string("ZMQ error: ") + e.what());
+    }
+    boost::this_thread::interruption_point();
+  }
+}
+
+void ZmqServer::serve_worker()
+{
+  std::unique_ptr<zmq::socket_t> rep_socket;
+  try
+  {
+    rep_socket.reset(new zmq::socket_t(context, ZMQ_REP));
+    rep_socket->setsockopt(ZMQ_RCVTIMEO, &DEFAULT_RPC_RECV_TIMEOUT_MS, sizeof(DEFAULT_RPC_RECV_TIMEOUT_MS));
+    rep_socket->connect(WORKERS_ENDPOINT);
+  }
+  catch (const zmq::error_t& e)
+  {
+    MERROR(std::string("Error creating ZMQ RPC worker socket: ") + e.what());
+    return;
+  }
+
+  while (!stop_signal)
+  {
+    try
+    {
+      zmq::message_t message;
+
+      while (!stop_signal && rep_socket->recv(&message))
       {
         std::string message_string(reinterpret_cast<const char *>(message.data()), message.size());
 
@@ -77,7 +146,8 @@ void ZmqServer::serve()
     }
     catch (const boost::thread_interrupted& e)
     {
-      MDEBUG("ZMQ Server thread interrupted.");
+      MDEBUG("ZMQ RPC worker thread interrupted.");
+      break;
     }
     catch (const zmq::error_t& e)
     {
@@ -85,6 +155,9 @@ void ZmqServer::serve()
     }
     boost::this_thread::interruption_point();
   }
+
+  int linger = 0;
+  rep_socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
 }
 
 bool ZmqServer::addIPCSocket(std::string address, std::string port)
@@ -99,16 +172,16 @@ bool ZmqServer::addTCPSocket(std::string address, std::string port)
   {
     std::string addr_prefix("tcp://");
 
-    rep_socket.reset(new zmq::socket_t(context, ZMQ_REP));
-
-    rep_socket->setsockopt(ZMQ_RCVTIMEO, &DEFAULT_RPC_RECV_TIMEOUT_MS, sizeof(DEFAULT_RPC_RECV_TIMEOUT_MS));
+    frontend_socket.reset(new zmq::socket_t(context, ZMQ_ROUTER));
+    backend_socket.reset(new zmq::socket_t(context, ZMQ_DEALER));
 
     if (address.empty())
       address = "*";
     if (port.empty())
       port = "*";
     std::string bind_address = addr_prefix + address + std::string(":") + port;
-    rep_socket->bind(bind_address.c_str());
+    frontend_socket->bind(bind_address.c_str());
+    backend_socket->bind(WORKERS_ENDPOINT);
   }
   catch (const std::exception& e)
   {
@@ -121,6 +194,8 @@ bool ZmqServer::addTCPSocket(std::string address, std::string port)
 void ZmqServer::run()
 {
   running = true;
+  for (size_t i = 0; i < num_workers; ++i)
+    worker_threads.push_back(boost::thread(boost::bind(&ZmqServer::serve_worker, this)));
   run_thread = boost::thread(boost::bind(&ZmqServer::serve, this));
 }
 
@@ -132,6 +207,12 @@ void ZmqServer::stop()
 
   run_thread.interrupt();
   run_thread.join();
+  for (boost::thread& worker: worker_threads)
+  {
+    worker.interrupt();
+    worker.join();
+  }
+  worker_threads.clear();
 
   running = false;
 
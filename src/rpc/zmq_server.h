@@ -32,6 +32,7 @@
 #include <zmq.hpp>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "common/command_line.h"
 
@@ -45,12 +46,22 @@ namespace rpc
 
 static constexpr int DEFAULT_NUM_ZMQ_THREADS = 1;
 static constexpr int DEFAULT_RPC_RECV_TIMEOUT_MS = 1000;
-
+static constexpr size_t DEFAULT_NUM_ZMQ_WORKERS = 2;
+
+/**
+ * @brief serves RPC requests from a ROUTER socket on a pool of workers
+ *
+ * The run thread shuttles requests from the ROUTER frontend to an inproc
+ * DEALER backend, which hands each one to an idle worker's REP socket,
+ * and the replies back the same way.  A slow request, like a large
+ * GetBlocksFast, only holds up its own worker.  Clients keep talking to
+ * the server with REQ sockets as before.
+ */
 class ZmqServer
 {
   public:
 
-    ZmqServer(RpcHandler& h);
+    ZmqServer(RpcHandler& h, size_t num_workers = DEFAULT_NUM_ZMQ_WORKERS);
 
     ~ZmqServer();
 
@@ -65,6 +76,8 @@ class ZmqServer
     void stop();
 
   private:
+    void serve_worker();
+
     RpcHandler& handler;
 
     volatile bool stop_signal;
@@ -73,8 +86,11 @@ class ZmqServer
     zmq::context_t context;
 
     boost::thread run_thread;
+    std::vector<boost::thread> worker_threads;
+    size_t num_workers;
 
-    std::unique_ptr<zmq::socket_t> rep_socket;
+    std::unique_ptr<zmq::socket_t> frontend_socket;
+    std::unique_ptr<zmq::socket_t> backend_socket;
 };
 
 
@@ -34,11 +34,15 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <iterator>
+#include <string>
+#include <boost/type_traits/integral_constant.hpp>
 #include <boost/type_traits/make_unsigned.hpp>
 
 #include "common/varint.h"
+#include "span.h"
 #include "warnings.h"
 
 /* I have no clue what these lines means */
@@ -80,6 +84,132 @@ protected:
   stream_type &stream_;
 };
 
+/*! \class binary_span_istream
+ *
+ * \brief a read cursor over a blob in memory
+ *
+ * \detailed The reading archive used to pull every byte through a
+ * std::istream. This keeps the cursor inline and only mimics the part
+ * of the istream state API the serializers call through ar.stream():
+ * good(), rdstate(), setstate(), clear(), peek() and tellg() behave as
+ * their std::istream counterparts do.
+ */
+class binary_span_istream
+{
+public:
+  explicit binary_span_istream(const epee::span<const uint8_t> &blob)
+    : begin_(blob.data()), cur_(blob.data()), end_(blob.data() + blob.size()), state_(std::ios_base::goodbit) { }
+
+  bool good() const { return state_ == std::ios_base::goodbit; }
+  bool eof() const { return state_ & std::ios_base::eofbit; }
+  bool fail() const { return state_ & (std::ios_base::failbit | std::ios_base::badbit); }
+  std::ios_base::iostate rdstate() const { return state_; }
+  void setstate(std::ios_base::iostate state) { state_ |= state; }
+  void clear(std::ios_base::iostate state = std::ios_base::goodbit) { state_ = state; }
+
+  int peek()
+  {
+    if (!good())
+    {
+      setstate(std::ios_base::failbit);
+      return EOF;
+    }
+    if (cur_ == end_)
+    {
+      setstate(std::ios_base::eofbit);
+      return EOF;
+    }
+    return *cur_;
+  }
+
+  std::streampos tellg() const { return fail() ? std::streampos(-1) : std::streampos(cur_ - begin_); }
+  size_t remaining() const { return end_ - cur_; }
+
+  /*! \brief copies len bytes out, failing with eof set if fewer are left */
+  bool read(void *buf, size_t len)
+  {
+    if (!good())
+    {
+      setstate(std::ios_base::failbit);
+      return false;
+    }
+    if (len > remaining())
+    {
+      len = remaining();
+      setstate(std::ios_base::eofbit | std::ios_base::failbit);
+    }
+    if (len)
+      memcpy(buf, cur_, len);
+    cur_ += len;
+    return good();
+  }
+
+  /*! \brief reads a varint the way the old istreambuf_iterator did: a
+   * truncated or malformed one stops where it stopped and the state
+   * is left alone */
+  template <class T>
+  void read_varint(T &v)
+  {
+    tools::read_varint(cur_, end_, v); // XXX handle failure
+  }
+
+private:
+  const uint8_t *begin_;
+  const uint8_t *cur_;
+  const uint8_t *end_;
+  std::ios_base::iostate state_;
+};
+
+/*! \class binary_buffer_ostream
+ *
+ * \brief the writing side of binary_span_istream
+ *
+ * \detailed Appends straight to a std::string the caller owns, so a
+ * buffer kept around between calls stops allocating once it has grown
+ * to fit. With no buffer it only counts bytes, which gives the exact
+ * size of an object without building its blob. A std::ostream target
+ * is still accepted for callers that want one.
+ */
+class binary_buffer_ostream
+{
+public:
+  binary_buffer_ostream() : buf_(NULL), out_(NULL), size_(0), state_(std::ios_base::goodbit) { }
+  explicit binary_buffer_ostream(std::string &buf) : buf_(&buf), out_(NULL), size_(0), state_(std::ios_base::goodbit) { }
+  explicit binary_buffer_ostream(std::ostream &out) : buf_(NULL), out_(&out), size_(0), state_(std::ios_base::goodbit) { }
+
+  bool good() const { return rdstate() == std::ios_base::goodbit; }
+  std::ios_base::iostate rdstate() const { return out_ ? state_ | out_->rdstate() : state_; }
+  void setstate(std::ios_base::iostate state) { state_ |= state; }
+  void clear(std::ios_base::iostate state = std::ios_base::goodbit) { state_ = state; if (out_) out_->clear(state); }
+
+  void write(const void *data, size_t len)
+  {
+    if (buf_)
+      buf_->append((const char*)data, len);
+    else if (out_)
+      out_->write((const char*)data, len);
+    size_ += len;
+  }
+
+  void put(char c)
+  {
+    if (buf_)
+      buf_->push_back(c);
+    else if (out_)
+      out_->put(c);
+    ++size_;
+  }
+
+  /*! \brief the number of bytes written so far */
+  size_t size() const { return size_; }
+
+private:
+  std::string *buf_;
+  std::ostream *out_;
+  size_t size_;
+  std::ios_base::iostate state_;
+};
+
 /* \struct binary_archive
  *
  * \brief the actually binary archive type
@@ -93,17 +223,28 @@ protected:
 template <bool W>
 struct binary_archive;
 
+template <class Archive>
+struct is_raw_blob_archive;
+
+template <bool W>
+struct is_raw_blob_archive<binary_archive<W>> { typedef boost::true_type type; };
+
 
 template <>
-struct binary_archive<false> : public binary_archive_base<std::istream, false>
+struct binary_archive<false> : public binary_archive_base<binary_span_istream, false>
 {
 
-  explicit binary_archive(stream_type &s) : base_type(s) {
-   std::streampos pos = stream_.tellg();
-    stream_.seekg(0, std::ios_base::end);
-    eof_pos_ = stream_.tellg();
-    stream_.seekg(pos);
-  }
+  explicit binary_archive(const epee::span<const uint8_t> &blob) : base_type(span_), span_(blob) { }
+
+  /*! \brief reads whatever is left in \a s, for callers still holding a
+   * std::istream. The stream is left at its end. */
+  explicit binary_archive(std::istream &s)
+    : base_type(span_),
+      owned_(std::istreambuf_iterator<char>(s), std::istreambuf_iterator<char>()),
+      span_(epee::strspan<uint8_t>(owned_)) { }
+
+  binary_archive(const binary_archive &) = delete;
+  binary_archive &operator=(const binary_archive &) = delete;
 
   template <class T>
   void serialize_int(T &v)
@@ -118,22 +259,18 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   template <class T>
   void serialize_uint(T &v, size_t width = sizeof(T))
   {
+    uint8_t bytes[sizeof(T)] = {0};
+    assert(width <= sizeof(T));
+    stream_.read(bytes, width);
     T ret = 0;
-    unsigned shift = 0;
-    for (size_t i = 0; i < width; i++) {
-      //std::cerr << "tell: " << stream_.tellg() << " value: " << ret << std::endl;
-      char c;
-      stream_.get(c);
-      T b = (unsigned char)c;
-      ret += (b << shift);	// can this be changed to OR, i think it can.
-      shift += 8;
-    }
+    for (size_t i = 0; i < width; i++)
+      ret |= (T)bytes[i] << (8 * i);
     v = ret;
   }
   
   void serialize_blob(void *buf, size_t len, const char *delimiter="")
   {
-    stream_.read((char *)buf, len);
+    stream_.read(buf, len);
   }
   
   template <class T>
@@ -145,8 +282,7 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   template <class T>
   void serialize_uvarint(T &v)
   {
-    typedef std::istreambuf_iterator<char> it;
-    tools::read_varint(it(stream_), it(), v); // XXX handle failure
+    stream_.read_varint(v);
   }
 
   void begin_array(size_t &s)
@@ -168,18 +304,28 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   size_t remaining_bytes() {
     if (!stream_.good())
       return 0;
-    //std::cerr << "tell: " << stream_.tellg() << std::endl;
-    assert(stream_.tellg() <= eof_pos_);
-    return eof_pos_ - stream_.tellg();
+    return stream_.remaining();
   }
 protected:
-  std::streamoff eof_pos_;
+  std::string owned_;
+  binary_span_istream span_;
 };
 
 template <>
-struct binary_archive<true> : public binary_archive_base<std::ostream, true>
+struct binary_archive<true> : public binary_archive_base<binary_buffer_ostream, true>
 {
-  explicit binary_archive(stream_type &s) : base_type(s) { }
+  /*! \brief writes nothing, only counts the bytes (see bytes_written) */
+  binary_archive() : base_type(sink_) { }
+
+  /*! \brief appends to \a buf */
+  explicit binary_archive(std::string &buf) : base_type(sink_), sink_(buf) { }
+
+  explicit binary_archive(std::ostream &s) : base_type(sink_), sink_(s) { }
+
+  binary_archive(const binary_archive &) = delete;
+  binary_archive &operator=(const binary_archive &) = delete;
+
+  size_t bytes_written() const { return sink_.size(); }
 
   template <class T>
   void serialize_int(T v)
@@ -189,15 +335,17 @@ struct binary_archive<true> : public binary_archive_base<std::ostream, true>
   template <class T>
   void serialize_uint(T v)
   {
+    char bytes[sizeof(T)];
     for (size_t i = 0; i < sizeof(T); i++) {
-      stream_.put((char)(v & 0xff));
+      bytes[i] = (char)(v & 0xff);
       if (1 < sizeof(T)) v >>= 8;
     }
+    stream_.write(bytes, sizeof(T));
   }
 
   void serialize_blob(void *buf, size_t len, const char *delimiter="")
   {
-    stream_.write((char *)buf, len);
+    stream_.write(buf, len);
   }
 
   template <class T>
@@ -209,8 +357,10 @@ struct binary_archive<true> : public binary_archive_base<std::ostream, true>
   template <class T>
   void serialize_uvarint(T &v)
   {
-    typedef std::ostreambuf_iterator<char> it;
-    tools::write_varint(it(stream_), v);
+    char bytes[(sizeof(T) * 8 + 6) / 7];
+    char *end = bytes;
+    tools::write_varint(end, v);
+    stream_.write(bytes, end - bytes);
   }
   void begin_array(size_t s)
   {
@@ -226,6 +376,8 @@ struct binary_archive<true> : public binary_archive_base<std::ostream, true>
   void write_variant_tag(variant_tag_type t) {
     serialize_int(t);
   }
+protected:
+  binary_buffer_ostream sink_;
 };
 
 POP_WARNINGS
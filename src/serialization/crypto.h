@@ -51,14 +51,8 @@ bool do_serialize(Archive<false> &ar, std::vector<crypto::signature> &v)
     return false;
   }
 
-  v.reserve(cnt);
-  for (size_t i = 0; i < cnt; i++) {
-    v.resize(i+1);
-    ar.serialize_blob(&(v[i]), sizeof(crypto::signature), "");
-    if (!ar.stream().good())
-      return false;
-  }
-  return true;
+  v.resize(cnt);
+  return ::serialization::serialize_blob_array(ar, v.data(), cnt);
 }
 
 // write
@@ -68,10 +62,16 @@ bool do_serialize(Archive<true> &ar, std::vector<crypto::signature> &v)
   if (0 == v.size()) return true;
   ar.begin_string();
   size_t cnt = v.size();
-  for (size_t i = 0; i < cnt; i++) {
-    ar.serialize_blob(&(v[i]), sizeof(crypto::signature), "");
+  if (is_blob_array<Archive<true>, crypto::signature>::type::value) {
+    ar.serialize_blob(v.data(), cnt * sizeof(crypto::signature), "");
     if (!ar.stream().good())
       return false;
+  } else {
+    for (size_t i = 0; i < cnt; i++) {
+      ar.serialize_blob(&(v[i]), sizeof(crypto::signature), "");
+      if (!ar.stream().good())
+        return false;
+    }
   }
   ar.end_string();
   return true;
@@ -109,11 +109,29 @@ namespace
   }
 }
 
+namespace detail
+{
+  void write_hex(char* out, const epee::span<const std::uint8_t> src) noexcept
+  {
+    static constexpr const char digits[] = "0123456789abcdef";
+    for (const std::uint8_t byte : src)
+    {
+      *out++ = digits[byte >> 4];
+      *out++ = digits[byte & 0xf];
+    }
+  }
+}
+
 void toJsonValue(rapidjson::Document& doc, const std::string& i, rapidjson::Value& val)
 {
   val = rapidjson::Value(i.c_str(), doc.GetAllocator());
 }
 
+void toJsonValue(writer& dest, const std::string& i)
+{
+  dest.String(i.data(), i.size());
+}
+
 void fromJsonValue(const rapidjson::Value& val, std::string& str)
 {
   if (!val.IsString())
@@ -121,7 +139,7 @@ void fromJsonValue(const rapidjson::Value& val, std::string& str)
     throw WRONG_TYPE("string");
   }
 
-  str = val.GetString();
+  str.assign(val.GetString(), val.GetStringLength());
 }
 
 void toJsonValue(rapidjson::Document& doc, bool i, rapidjson::Value& val)
@@ -129,6 +147,11 @@ void toJsonValue(rapidjson::Document& doc, bool i, rapidjson::Value& val)
   val.SetBool(i);
 }
 
+void toJsonValue(writer& dest, bool i)
+{
+  dest.Bool(i);
+}
+
 void fromJsonValue(const rapidjson::Value& val, bool& b)
 {
   if (!val.IsBool())
@@ -168,6 +191,11 @@ void toJsonValue(rapidjson::Document& doc, const unsigned int i, rapidjson::Valu
   val = rapidjson::Value(i);
 }
 
+void toJsonValue(writer& dest, const unsigned int i)
+{
+  dest.Uint(i);
+}
+
 void fromJsonValue(const rapidjson::Value& val, unsigned int& i)
 {
   to_uint(val, i);
@@ -178,6 +206,11 @@ void toJsonValue(rapidjson::Document& doc, const int i, rapidjson::Value& val)
   val = rapidjson::Value(i);
 }
 
+void toJsonValue(writer& dest, const int i)
+{
+  dest.Int(i);
+}
+
 void fromJsonValue(const rapidjson::Value& val, int& i)
 {
   to_int(val, i);
@@ -189,6 +222,11 @@ void toJsonValue(rapidjson::Document& doc, const unsigned long long i, rapidjson
   val = rapidjson::Value(std::uint64_t(i));
 }
 
+void toJsonValue(writer& dest, const unsigned long long i)
+{
+  dest.Uint64(std::uint64_t(i));
+}
+
 void fromJsonValue(const rapidjson::Value& val, unsigned long long& i)
 {
   to_uint64(val, i);
@@ -200,6 +238,11 @@ void toJsonValue(rapidjson::Document& doc, const long long i, rapidjson::Value&
   val = rapidjson::Value(std::int64_t(i));
 }
 
+void toJsonValue(writer& dest, const long long i)
+{
+  dest.Int64(std::int64_t(i));
+}
+
 void fromJsonValue(const rapidjson::Value& val, long long& i)
 {
   to_int64(val, i);
@@ -230,6 +273,23 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::transaction& tx, ra
   INSERT_INTO_JSON_OBJECT(val, doc, ringct, tx.rct_signatures);
 }
 
+void toJsonValue(writer& dest, const cryptonote::transaction& tx)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, version, tx.version);
+  INSERT_INTO_JSON_WRITER(dest, unlock_time, tx.unlock_time);
+  INSERT_INTO_JSON_WRITER(dest, output_unlock_times, tx.output_unlock_times);
+  INSERT_INTO_JSON_WRITER(dest, type, tx.type);
+  INSERT_INTO_JSON_WRITER(dest, inputs, tx.vin);
+  INSERT_INTO_JSON_WRITER(dest, outputs, tx.vout);
+  INSERT_INTO_JSON_WRITER(dest, extra, tx.extra);
+  INSERT_INTO_JSON_WRITER(dest, signatures, tx.signatures);
+  INSERT_INTO_JSON_WRITER(dest, ringct, tx.rct_signatures);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::transaction& tx)
 {
@@ -262,6 +322,21 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::block& b, rapidjson
   INSERT_INTO_JSON_OBJECT(val, doc, tx_hashes, b.tx_hashes);
 }
 
+void toJsonValue(writer& dest, const cryptonote::block& b)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, major_version, b.major_version);
+  INSERT_INTO_JSON_WRITER(dest, minor_version, b.minor_version);
+  INSERT_INTO_JSON_WRITER(dest, timestamp, b.timestamp);
+  INSERT_INTO_JSON_WRITER(dest, prev_id, b.prev_id);
+  INSERT_INTO_JSON_WRITER(dest, nonce, b.nonce);
+  INSERT_INTO_JSON_WRITER(dest, miner_tx, b.miner_tx);
+  INSERT_INTO_JSON_WRITER(dest, tx_hashes, b.tx_hashes);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::block& b)
 {
@@ -310,6 +385,38 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_v& txin, rapid
   boost::apply_visitor(add_input{doc, val}, txin);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txin_v& txin)
+{
+  dest.StartObject();
+
+  struct add_input
+  {
+    using result_type = void;
+
+    writer& dest;
+
+    void operator()(cryptonote::txin_to_key const& input) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, to_key, input);
+    }
+    void operator()(cryptonote::txin_gen const& input) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, gen, input);
+    }
+    void operator()(cryptonote::txin_to_script const& input) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, to_script, input);
+    }
+    void operator()(cryptonote::txin_to_scripthash const& input) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, to_scripthash, input);
+    }
+  };
+  boost::apply_visitor(add_input{dest}, txin);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_v& txin)
 {
@@ -359,6 +466,13 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_gen& txin, rap
   INSERT_INTO_JSON_OBJECT(val, doc, height, txin.height);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txin_gen& txin)
+{
+  dest.StartObject();
+  INSERT_INTO_JSON_WRITER(dest, height, txin.height);
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_gen& txin)
 {
@@ -379,6 +493,17 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_to_script& txi
   INSERT_INTO_JSON_OBJECT(val, doc, sigset, txin.sigset);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txin_to_script& txin)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, prev, txin.prev);
+  INSERT_INTO_JSON_WRITER(dest, prevout, txin.prevout);
+  INSERT_INTO_JSON_WRITER(dest, sigset, txin.sigset);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_to_script& txin)
 {
@@ -402,6 +527,18 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_to_scripthash&
   INSERT_INTO_JSON_OBJECT(val, doc, sigset, txin.sigset);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txin_to_scripthash& txin)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, prev, txin.prev);
+  INSERT_INTO_JSON_WRITER(dest, prevout, txin.prevout);
+  INSERT_INTO_JSON_WRITER(dest, script, txin.script);
+  INSERT_INTO_JSON_WRITER(dest, sigset, txin.sigset);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_to_scripthash& txin)
 {
@@ -425,6 +562,17 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_to_key& txin,
   INSERT_INTO_JSON_OBJECT(val, doc, key_image, txin.k_image);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txin_to_key& txin)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, amount, txin.amount);
+  INSERT_INTO_JSON_WRITER(dest, key_offsets, txin.key_offsets);
+  INSERT_INTO_JSON_WRITER(dest, key_image, txin.k_image);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_to_key& txin)
 {
@@ -446,6 +594,16 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_to_script& tx
   INSERT_INTO_JSON_OBJECT(val, doc, script, txout.script);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txout_to_script& txout)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, keys, txout.keys);
+  INSERT_INTO_JSON_WRITER(dest, script, txout.script);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_to_script& txout)
 {
@@ -465,6 +623,13 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_to_scripthash
   INSERT_INTO_JSON_OBJECT(val, doc, hash, txout.hash);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txout_to_scripthash& txout)
+{
+  dest.StartObject();
+  INSERT_INTO_JSON_WRITER(dest, hash, txout.hash);
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_to_scripthash& txout)
 {
@@ -483,6 +648,13 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_to_key& txout
   INSERT_INTO_JSON_OBJECT(val, doc, key, txout.key);
 }
 
+void toJsonValue(writer& dest, const cryptonote::txout_to_key& txout)
+{
+  dest.StartObject();
+  INSERT_INTO_JSON_WRITER(dest, key, txout.key);
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_to_key& txout)
 {
@@ -523,6 +695,36 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::tx_out& txout, rapi
   boost::apply_visitor(add_output{doc, val}, txout.target);
 }
 
+void toJsonValue(writer& dest, const cryptonote::tx_out& txout)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, amount, txout.amount);
+
+  struct add_output
+  {
+    using result_type = void;
+
+    writer& dest;
+
+    void operator()(cryptonote::txout_to_key const& output) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, to_key, output);
+    }
+    void operator()(cryptonote::txout_to_script const& output) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, to_script, output);
+    }
+    void operator()(cryptonote::txout_to_scripthash const& output) const
+    {
+      INSERT_INTO_JSON_WRITER(dest, to_scripthash, output);
+    }
+  };
+  boost::apply_visitor(add_output{dest}, txout.target);
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, cryptonote::tx_out& txout)
 {
   if (!val.IsObject())
@@ -656,6 +858,16 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::block_with_tra
   INSERT_INTO_JSON_OBJECT(val, doc, transactions, blk.transactions);
 }
 
+void toJsonValue(writer& dest, const cryptonote::rpc::block_with_transactions& blk)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, block, blk.block);
+  INSERT_INTO_JSON_WRITER(dest, transactions, blk.transactions);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::block_with_transactions& blk)
 {
@@ -677,6 +889,17 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::transaction_in
   INSERT_INTO_JSON_OBJECT(val, doc, transaction, tx_info.transaction);
 }
 
+void toJsonValue(writer& dest, const cryptonote::rpc::transaction_info& tx_info)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, height, tx_info.height);
+  INSERT_INTO_JSON_WRITER(dest, in_pool, tx_info.in_pool);
+  INSERT_INTO_JSON_WRITER(dest, transaction, tx_info.transaction);
+
+  dest.EndObject();
+}
+
 
 void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::transaction_info& tx_info)
 {
@@ -984,6 +1207,37 @@ void toJsonValue(rapidjson::Document& doc, const rct::rctSig& sig, rapidjson::Va
   }
 }
 
+void toJsonValue(writer& dest, const rct::rctSig& sig)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, type, sig.type);
+  INSERT_INTO_JSON_WRITER(dest, encrypted, sig.ecdhInfo);
+
+  dest.Key("commitments");
+  dest.StartArray();
+  for (const rct::ctkey& key : sig.outPk)
+    toJsonValue(dest, key.mask);
+  dest.EndArray();
+
+  INSERT_INTO_JSON_WRITER(dest, fee, sig.txnFee);
+
+  // prunable
+  {
+    dest.Key("prunable");
+    dest.StartObject();
+
+    INSERT_INTO_JSON_WRITER(dest, range_proofs, sig.p.rangeSigs);
+    INSERT_INTO_JSON_WRITER(dest, bulletproofs, sig.p.bulletproofs);
+    INSERT_INTO_JSON_WRITER(dest, mlsags, sig.p.MGs);
+    INSERT_INTO_JSON_WRITER(dest, pseudo_outs, sig.get_pseudo_outs());
+
+    dest.EndObject();
+  }
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, rct::rctSig& sig)
 {
   using boost::adaptors::transform;
@@ -1030,6 +1284,16 @@ void toJsonValue(rapidjson::Document& doc, const rct::ecdhTuple& tuple, rapidjso
   INSERT_INTO_JSON_OBJECT(val, doc, amount, tuple.amount);
 }
 
+void toJsonValue(writer& dest, const rct::ecdhTuple& tuple)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, mask, tuple.mask);
+  INSERT_INTO_JSON_WRITER(dest, amount, tuple.amount);
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, rct::ecdhTuple& tuple)
 {
   if (!val.IsObject())
@@ -1051,6 +1315,21 @@ void toJsonValue(rapidjson::Document& doc, const rct::rangeSig& sig, rapidjson::
   INSERT_INTO_JSON_OBJECT(val, doc, Ci, keyVector);
 }
 
+void toJsonValue(writer& dest, const rct::rangeSig& sig)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, asig, sig.asig);
+
+  dest.Key("Ci");
+  dest.StartArray();
+  for (const rct::key& key : sig.Ci)
+    toJsonValue(dest, key);
+  dest.EndArray();
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, rct::rangeSig& sig)
 {
   if (!val.IsObject())
@@ -1096,6 +1375,26 @@ void toJsonValue(rapidjson::Document& doc, const rct::Bulletproof& p, rapidjson:
   INSERT_INTO_JSON_OBJECT(val, doc, t, p.t);
 }
 
+void toJsonValue(writer& dest, const rct::Bulletproof& p)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, V, p.V);
+  INSERT_INTO_JSON_WRITER(dest, A, p.A);
+  INSERT_INTO_JSON_WRITER(dest, S, p.S);
+  INSERT_INTO_JSON_WRITER(dest, T1, p.T1);
+  INSERT_INTO_JSON_WRITER(dest, T2, p.T2);
+  INSERT_INTO_JSON_WRITER(dest, taux, p.taux);
+  INSERT_INTO_JSON_WRITER(dest, mu, p.mu);
+  INSERT_INTO_JSON_WRITER(dest, L, p.L);
+  INSERT_INTO_JSON_WRITER(dest, R, p.R);
+  INSERT_INTO_JSON_WRITER(dest, a, p.a);
+  INSERT_INTO_JSON_WRITER(dest, b, p.b);
+  INSERT_INTO_JSON_WRITER(dest, t, p.t);
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, rct::Bulletproof& p)
 {
   if (!val.IsObject())
@@ -1130,6 +1429,27 @@ void toJsonValue(rapidjson::Document& doc, const rct::boroSig& sig, rapidjson::V
   INSERT_INTO_JSON_OBJECT(val, doc, ee, sig.ee);
 }
 
+void toJsonValue(writer& dest, const rct::boroSig& sig)
+{
+  dest.StartObject();
+
+  dest.Key("s0");
+  dest.StartArray();
+  for (const rct::key& key : sig.s0)
+    toJsonValue(dest, key);
+  dest.EndArray();
+
+  dest.Key("s1");
+  dest.StartArray();
+  for (const rct::key& key : sig.s1)
+    toJsonValue(dest, key);
+  dest.EndArray();
+
+  INSERT_INTO_JSON_WRITER(dest, ee, sig.ee);
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, rct::boroSig& sig)
 {
   if (!val.IsObject())
@@ -1172,6 +1492,16 @@ void toJsonValue(rapidjson::Document& doc, const rct::mgSig& sig, rapidjson::Val
   INSERT_INTO_JSON_OBJECT(val, doc, cc, sig.cc);
 }
 
+void toJsonValue(writer& dest, const rct::mgSig& sig)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_WRITER(dest, ss, sig.ss);
+  INSERT_INTO_JSON_WRITER(dest, cc, sig.cc);
+
+  dest.EndObject();
+}
+
 void fromJsonValue(const rapidjson::Value& val, rct::mgSig& sig)
 {
   if (!val.IsObject())
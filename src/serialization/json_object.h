@@ -29,7 +29,10 @@
 #pragma once
 
 #include "string_tools.h"
+#include "span.h"
 #include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "rpc/message_data_structs.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
@@ -49,11 +52,15 @@
     cryptonote::json::toJsonValue(doc, source, key##Val); \
     jsonVal.AddMember(#key, key##Val, doc.GetAllocator());
 
+#define INSERT_INTO_JSON_WRITER(dest, key, source) \
+    dest.Key(#key, sizeof(#key) - 1); \
+    cryptonote::json::toJsonValue(dest, source);
+
 #define GET_FROM_JSON_OBJECT(source, dst, key) \
     OBJECT_HAS_MEMBER_OR_THROW(source, #key) \
     decltype(dst) dstVal##key; \
     cryptonote::json::fromJsonValue(source[#key], dstVal##key); \
-    dst = dstVal##key;
+    dst = std::move(dstVal##key);
 
 namespace cryptonote
 {
@@ -61,6 +68,10 @@ namespace cryptonote
 namespace json
 {
 
+// SAX writer for replies that are streamed straight to the output buffer
+// instead of being built up as a rapidjson::Value tree first
+typedef rapidjson::Writer<rapidjson::StringBuffer> writer;
+
 struct JSON_ERROR : public std::exception
 {
   protected:
@@ -114,12 +125,28 @@ inline constexpr bool is_to_hex()
   return std::is_pod<Type>() && !std::is_integral<Type>();
 }
 
+namespace detail
+{
+  // out must have room for 2 * src.size() chars
+  void write_hex(char* out, const epee::span<const std::uint8_t> src) noexcept;
+}
 
-// POD to json value
+
+// POD to json value, hex encoded on the stack rather than through a std::string
 template <class Type>
 typename std::enable_if<is_to_hex<Type>()>::type toJsonValue(rapidjson::Document& doc, const Type& pod, rapidjson::Value& value)
 {
-  value = rapidjson::Value(epee::string_tools::pod_to_hex(pod).c_str(), doc.GetAllocator());
+  char hex[sizeof(Type) * 2];
+  detail::write_hex(hex, epee::as_byte_span(pod));
+  value = rapidjson::Value(hex, sizeof(hex), doc.GetAllocator());
+}
+
+template <class Type>
+typename std::enable_if<is_to_hex<Type>()>::type toJsonValue(writer& dest, const Type& pod)
+{
+  char hex[sizeof(Type) * 2];
+  detail::write_hex(hex, epee::as_byte_span(pod));
+  dest.String(hex, sizeof(hex));
 }
 
 template <class Type>
@@ -130,19 +157,20 @@ typename std::enable_if<is_to_hex<Type>()>::type fromJsonValue(const rapidjson::
     throw WRONG_TYPE("string");
   }
 
-  //TODO: handle failure to convert hex string to POD type
-  bool success = epee::string_tools::hex_to_pod(val.GetString(), t);
-
-  if (!success)
+  // decoded straight into t, the length check is done by the parser
+  epee::span<char> out(reinterpret_cast<char*>(&t), sizeof(t));
+  if (!epee::string_tools::parse_hexstr_to_binbuff(epee::span<const char>(val.GetString(), val.GetStringLength()), out))
   {
     throw BAD_INPUT();
   }
 }
 
 void toJsonValue(rapidjson::Document& doc, const std::string& i, rapidjson::Value& val);
+void toJsonValue(writer& dest, const std::string& i);
 void fromJsonValue(const rapidjson::Value& val, std::string& str);
 
 void toJsonValue(rapidjson::Document& doc, bool i, rapidjson::Value& val);
+void toJsonValue(writer& dest, bool i);
 void fromJsonValue(const rapidjson::Value& val, bool& b);
 
 // integers overloads for toJsonValue are not needed for standard promotions
@@ -158,64 +186,85 @@ void fromJsonValue(const rapidjson::Value& val, unsigned short& i);
 void fromJsonValue(const rapidjson::Value& val, short& i);
 
 void toJsonValue(rapidjson::Document& doc, const unsigned i, rapidjson::Value& val);
+void toJsonValue(writer& dest, const unsigned i);
 void fromJsonValue(const rapidjson::Value& val, unsigned& i);
 
 void toJsonValue(rapidjson::Document& doc, const int, rapidjson::Value& val);
+void toJsonValue(writer& dest, const int i);
 void fromJsonValue(const rapidjson::Value& val, int& i);
 
 
 void toJsonValue(rapidjson::Document& doc, const unsigned long long i, rapidjson::Value& val);
+void toJsonValue(writer& dest, const unsigned long long i);
 void fromJsonValue(const rapidjson::Value& val, unsigned long long& i);
 
 void toJsonValue(rapidjson::Document& doc, const long long i, rapidjson::Value& val);
+void toJsonValue(writer& dest, const long long i);
 void fromJsonValue(const rapidjson::Value& val, long long& i);
 
 inline void toJsonValue(rapidjson::Document& doc, const unsigned long i, rapidjson::Value& val) {
     toJsonValue(doc, static_cast<unsigned long long>(i), val);
 }
+inline void toJsonValue(writer& dest, const unsigned long i) {
+    toJsonValue(dest, static_cast<unsigned long long>(i));
+}
 void fromJsonValue(const rapidjson::Value& val, unsigned long& i);
 
 inline void toJsonValue(rapidjson::Document& doc, const long i, rapidjson::Value& val) {
     toJsonValue(doc, static_cast<long long>(i), val);
 }
+inline void toJsonValue(writer& dest, const long i) {
+    toJsonValue(dest, static_cast<long long>(i));
+}
 void fromJsonValue(const rapidjson::Value& val, long& i);
 
 // end integers
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::transaction& tx, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::transaction& tx);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::transaction& tx);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::block& b, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::block& b);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::block& b);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_v& txin, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txin_v& txin);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_v& txin);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_gen& txin, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txin_gen& txin);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_gen& txin);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_to_script& txin, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txin_to_script& txin);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_to_script& txin);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_to_scripthash& txin, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txin_to_scripthash& txin);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_to_scripthash& txin);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txin_to_key& txin, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txin_to_key& txin);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txin_to_key& txin);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_target_v& txout, rapidjson::Value& val);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_target_v& txout);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_to_script& txout, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txout_to_script& txout);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_to_script& txout);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_to_scripthash& txout, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txout_to_scripthash& txout);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_to_scripthash& txout);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::txout_to_key& txout, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::txout_to_key& txout);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::txout_to_key& txout);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::tx_out& txout, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::tx_out& txout);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::tx_out& txout);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::connection_info& info, rapidjson::Value& val);
@@ -225,9 +274,11 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::block_complete_entr
 void fromJsonValue(const rapidjson::Value& val, cryptonote::block_complete_entry& blk);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::block_with_transactions& blk, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::rpc::block_with_transactions& blk);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::block_with_transactions& blk);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::transaction_info& tx_info, rapidjson::Value& val);
+void toJsonValue(writer& dest, const cryptonote::rpc::transaction_info& tx_info);
 void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::transaction_info& tx_info);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::output_key_and_amount_index& out, rapidjson::Value& val);
@@ -261,21 +312,27 @@ void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::BlockHeaderRes
 void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::BlockHeaderResponse& response);
 
 void toJsonValue(rapidjson::Document& doc, const rct::rctSig& i, rapidjson::Value& val);
+void toJsonValue(writer& dest, const rct::rctSig& i);
 void fromJsonValue(const rapidjson::Value& i, rct::rctSig& sig);
 
 void toJsonValue(rapidjson::Document& doc, const rct::ecdhTuple& tuple, rapidjson::Value& val);
+void toJsonValue(writer& dest, const rct::ecdhTuple& tuple);
 void fromJsonValue(const rapidjson::Value& val, rct::ecdhTuple& tuple);
 
 void toJsonValue(rapidjson::Document& doc, const rct::rangeSig& sig, rapidjson::Value& val);
+void toJsonValue(writer& dest, const rct::rangeSig& sig);
 void fromJsonValue(const rapidjson::Value& val, rct::rangeSig& sig);
 
 void toJsonValue(rapidjson::Document& doc, const rct::Bulletproof& p, rapidjson::Value& val);
+void toJsonValue(writer& dest, const rct::Bulletproof& p);
 void fromJsonValue(const rapidjson::Value& val, rct::Bulletproof& p);
 
 void toJsonValue(rapidjson::Document& doc, const rct::boroSig& sig, rapidjson::Value& val);
+void toJsonValue(writer& dest, const rct::boroSig& sig);
 void fromJsonValue(const rapidjson::Value& val, rct::boroSig& sig);
 
 void toJsonValue(rapidjson::Document& doc, const rct::mgSig& sig, rapidjson::Value& val);
+void toJsonValue(writer& dest, const rct::mgSig& sig);
 void fromJsonValue(const rapidjson::Value& val, rct::mgSig& sig);
 
 void toJsonValue(rapidjson::Document& doc, const cryptonote::rpc::DaemonInfo& info, rapidjson::Value& val);
@@ -287,12 +344,18 @@ void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::output_distribu
 template <typename Map>
 typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type toJsonValue(rapidjson::Document& doc, const Map& map, rapidjson::Value& val);
 
+template <typename Map>
+typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type toJsonValue(writer& dest, const Map& map);
+
 template <typename Map>
 typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type fromJsonValue(const rapidjson::Value& val, Map& map);
 
 template <typename Vec>
 typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type toJsonValue(rapidjson::Document& doc, const Vec &vec, rapidjson::Value& val);
 
+template <typename Vec>
+typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type toJsonValue(writer& dest, const Vec &vec);
+
 template <typename Vec>
 typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type fromJsonValue(const rapidjson::Value& val, Vec& vec);
 
@@ -317,6 +380,18 @@ typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type toJsonValue
   }
 }
 
+template <typename Map>
+typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type toJsonValue(writer& dest, const Map& map)
+{
+  dest.StartObject();
+  for (const auto& i : map)
+  {
+    toJsonValue(dest, i.first);
+    toJsonValue(dest, i.second);
+  }
+  dest.EndObject();
+}
+
 template <typename Map>
 typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type fromJsonValue(const rapidjson::Value& val, Map& map)
 {
@@ -333,7 +408,7 @@ typename std::enable_if<sfinae::is_map_like<Map>::value, void>::type fromJsonVal
     typename Map::mapped_type m;
     fromJsonValue(itr->name, k);
     fromJsonValue(itr->value, m);
-    map.emplace(k, m);
+    map.emplace(std::move(k), std::move(m));
     ++itr;
   }
 }
@@ -351,6 +426,15 @@ typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type toJsonVa
   }
 }
 
+template <typename Vec>
+typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type toJsonValue(writer& dest, const Vec &vec)
+{
+  dest.StartArray();
+  for (const auto& t : vec)
+    toJsonValue(dest, t);
+  dest.EndArray();
+}
+
 template <typename Vec>
 typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type fromJsonValue(const rapidjson::Value& val, Vec& vec)
 {
@@ -363,7 +447,7 @@ typename std::enable_if<sfinae::is_vector_like<Vec>::value, void>::type fromJson
   {
     typename Vec::value_type v;
     fromJsonValue(val[i], v);
-    vec.push_back(v);
+    vec.push_back(std::move(v));
   }
 }
 
@@ -76,6 +76,25 @@ struct is_basic_type<std::pair<F,S>> { typedef boost::true_type type; };
 template<>
 struct is_basic_type<std::string> { typedef boost::true_type type; };
 
+/*! \struct is_raw_blob_archive
+ *
+ * \brief set for archives that store blobs back to back, with no
+ * delimiters or per-element framing
+ */
+template <class Archive>
+struct is_raw_blob_archive { typedef boost::false_type type; };
+
+/*! \struct is_blob_array
+ *
+ * \brief true when a contiguous run of \a T can go through \a Archive
+ * as one blob, byte for byte the same as element by element
+ */
+template <class Archive, class T>
+struct is_blob_array
+{
+  typedef boost::integral_constant<bool, is_raw_blob_archive<Archive>::type::value && is_blob_type<T>::type::value> type;
+};
+
 /*! \struct serializer
  *
  * \brief ... wouldn't a class be better?
@@ -355,6 +374,43 @@ namespace serialization {
     return detail::do_check_stream_state(ar.stream(), typename Archive::is_saving(), noeof);
   }
 
+  namespace detail
+  {
+    template <class Archive, class T>
+    bool do_serialize_blob_array(Archive &ar, T *v, size_t n, boost::true_type)
+    {
+      ar.serialize_blob(v, n * sizeof(T));
+      return ar.stream().good();
+    }
+
+    template <class Archive, class T>
+    bool do_serialize_blob_array(Archive &ar, T *v, size_t n, boost::false_type)
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        if (i > 0)
+          ar.delimit_array();
+        if (!::do_serialize(ar, v[i]) || !ar.stream().good())
+          return false;
+      }
+      return true;
+    }
+  }
+
+  /*! \fn serialize_blob_array
+   *
+   * \brief serializes the \a n elements at \a v, without a size prefix
+   *
+   * \detailed Blob types in a raw blob archive are moved in a single
+   * serialize_blob call, anything else element by element with array
+   * delimiters. The caller sizes \a v beforehand when loading.
+   */
+  template <class Archive, class T>
+  inline bool serialize_blob_array(Archive &ar, T *v, size_t n)
+  {
+    return detail::do_serialize_blob_array(ar, v, n, typename is_blob_array<Archive, T>::type());
+  }
+
   /*! \fn serialize
    *
    * \brief serializes \a v into \a ar
@@ -58,8 +58,59 @@ namespace serialization
 
 #include "container.h"
 
+namespace serialization
+{
+  namespace detail
+  {
+    template <template <bool> class Archive, class T>
+    bool do_serialize_vector(Archive<false> &ar, std::vector<T> &v, boost::false_type)
+    {
+      return ::do_serialize_container(ar, v);
+    }
+
+    template <template <bool> class Archive, class T>
+    bool do_serialize_vector(Archive<true> &ar, std::vector<T> &v, boost::false_type)
+    {
+      return ::do_serialize_container(ar, v);
+    }
+
+    // contiguous blobs: one copy for the whole vector after the count
+    template <template <bool> class Archive, class T>
+    bool do_serialize_vector(Archive<false> &ar, std::vector<T> &v, boost::true_type)
+    {
+      size_t cnt;
+      ar.begin_array(cnt);
+      if (!ar.stream().good())
+        return false;
+      v.clear();
+
+      if (ar.remaining_bytes() / sizeof(T) < cnt) {
+        ar.stream().setstate(std::ios::failbit);
+        return false;
+      }
+
+      v.resize(cnt);
+      if (!::serialization::serialize_blob_array(ar, v.data(), cnt))
+        return false;
+      ar.end_array();
+      return true;
+    }
+
+    template <template <bool> class Archive, class T>
+    bool do_serialize_vector(Archive<true> &ar, std::vector<T> &v, boost::true_type)
+    {
+      size_t cnt = v.size();
+      ar.begin_array(cnt);
+      if (!::serialization::serialize_blob_array(ar, v.data(), cnt))
+        return false;
+      ar.end_array();
+      return true;
+    }
+  }
+}
+
 template <template <bool> class Archive, class T>
-bool do_serialize(Archive<false> &ar, std::vector<T> &v) { return do_serialize_container(ar, v); }
+bool do_serialize(Archive<false> &ar, std::vector<T> &v) { return ::serialization::detail::do_serialize_vector(ar, v, typename is_blob_array<Archive<false>, T>::type()); }
 template <template <bool> class Archive, class T>
-bool do_serialize(Archive<true> &ar, std::vector<T> &v) { return do_serialize_container(ar, v); }
+bool do_serialize(Archive<true> &ar, std::vector<T> &v) { return ::serialization::detail::do_serialize_vector(ar, v, typename is_blob_array<Archive<true>, T>::type()); }
 
@@ -2439,6 +2439,23 @@ bool simple_wallet::set_subaddress_lookahead(const std::vector<std::string> &arg
   return true;
 }
 
+bool simple_wallet::set_account_range(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  auto range = tools::parse_subaddress_lookahead(args[1]);
+  if (!range || range->first >= range->second)
+  {
+    fail_msg_writer() << tr("invalid format for account range; must be <first>:<end> with first < end");
+    return true;
+  }
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    m_wallet->set_account_range(range->first, range->second);
+    m_wallet->rewrite(m_wallet_file, pwd_container->password());
+  }
+  return true;
+}
+
 bool simple_wallet::set_segregation_height(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
   const auto pwd_container = get_and_verify_password();
@@ -2691,6 +2708,8 @@ simple_wallet::simple_wallet()
                                   "  Set this if you are not sure whether you will spend on a key reusing Antd fork later.\n"
                                   "subaddress-lookahead <major>:<minor>\n "
                                   "  Set the lookahead sizes for the subaddress hash table.\n "
+                                  "account-range <first>:<end>\n "
+                                  "  Only scan for outputs received by accounts first to end-1, to split a large wallet across processes.\n "
                                   "  Set this if you are not sure whether you will spend on a key reusing Antd fork later.\n "
                                   "segregation-height <n>\n "
                                   "  Set to the height of a key reusing fork you want to use, 0 to use default."));
@@ -3050,6 +3069,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "key-reuse-mitigation2 = " << m_wallet->key_reuse_mitigation2();
     const std::pair<size_t, size_t> lookahead = m_wallet->get_subaddress_lookahead();
     success_msg_writer() << "subaddress-lookahead = " << lookahead.first << ":" << lookahead.second;
+    const std::pair<uint32_t, uint32_t> account_range = m_wallet->get_account_range();
+    success_msg_writer() << "account-range = " << account_range.first << ":" << account_range.second;
     success_msg_writer() << "segregation-height = " << m_wallet->segregation_height();
     success_msg_writer() << "ignore-fractional-outputs = " << m_wallet->ignore_fractional_outputs();
     success_msg_writer() << "track-uses = " << m_wallet->track_uses();
@@ -3106,6 +3127,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("segregate-pre-fork-outputs", set_segregate_pre_fork_outputs, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("key-reuse-mitigation2", set_key_reuse_mitigation2, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("subaddress-lookahead", set_subaddress_lookahead, tr("<major>:<minor>"));
+    CHECK_SIMPLE_VARIABLE("account-range", set_account_range, tr("<first>:<end>"));
     CHECK_SIMPLE_VARIABLE("segregation-height", set_segregation_height, tr("unsigned integer"));
     CHECK_SIMPLE_VARIABLE("ignore-fractional-outputs", set_ignore_fractional_outputs, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("track-uses", set_track_uses, tr("0 or 1"));
@@ -49,14 +49,30 @@ TransactionHistory::~TransactionHistory() {}
 
 TransactionHistoryImpl::TransactionHistoryImpl(WalletImpl *wallet)
     : m_wallet(wallet)
+    , m_scannedHeight(0)
+    , m_historyGeneration(0)
+    , m_built(false)
 {
 
 }
 
 TransactionHistoryImpl::~TransactionHistoryImpl()
 {
-    for (auto t : m_history)
+    clear();
+}
+
+void TransactionHistoryImpl::clear()
+{
+    for (auto t : m_confirmed)
         delete t;
+    for (auto t : m_pending)
+        delete t;
+    m_confirmed.clear();
+    m_pending.clear();
+    m_confirmedKeys.clear();
+    m_history.clear();
+    m_scannedHeight = 0;
+    m_built = false;
 }
 
 int TransactionHistoryImpl::count() const
@@ -108,14 +124,33 @@ void TransactionHistoryImpl::refresh()
     boost::unique_lock<boost::shared_mutex> lock(m_historyMutex);
 
     // TODO: configurable values;
-    uint64_t min_height = 0;
     uint64_t max_height = (uint64_t)-1;
     uint64_t wallet_height = m_wallet->blockChainHeight();
 
-    // delete old transactions;
-    for (auto t : m_history)
+    // anything removed from wallet2 since last time (reorg, rescan, reload) means
+    // starting over, light wallets rebuild their payments wholesale
+    const uint64_t generation = m_wallet->m_wallet->get_history_generation();
+    if (!m_built || generation != m_historyGeneration || m_wallet->m_wallet->light_wallet())
+        clear();
+    m_built = true;
+    m_historyGeneration = generation;
+
+    // the last scanned height is fetched again, the wallet may have been halfway
+    // through it; entries already held are skipped by key
+    uint64_t min_height = m_scannedHeight > 1 ? m_scannedHeight - 2 : 0;
+    m_scannedHeight = wallet_height;
+
+    for (auto ti : m_confirmed)
+    {
+        ti->m_confirmations = (wallet_height > ti->m_blockheight) ? wallet_height - ti->m_blockheight : 0;
+        if (ti->m_subaddrIndex.size() == 1)
+            ti->m_label = m_wallet->m_wallet->get_subaddress_label({ti->m_subaddrAccount, *ti->m_subaddrIndex.begin()});
+    }
+
+    // pending entries are few and change state freely
+    for (auto t : m_pending)
         delete t;
-    m_history.clear();
+    m_pending.clear();
 
     // transactions are stored in wallet2:
     // - confirmed_transfer_details   - out transfers
@@ -129,6 +164,12 @@ void TransactionHistoryImpl::refresh()
     m_wallet->m_wallet->get_payments(in_payments, min_height, max_height);
     for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = in_payments.begin(); i != in_payments.end(); ++i) {
         const tools::wallet2::payment_details &pd = i->second;
+        std::string key = "i";
+        key.append(reinterpret_cast<const char*>(&pd.m_tx_hash), sizeof(pd.m_tx_hash));
+        key.append(reinterpret_cast<const char*>(&pd.m_subaddr_index), sizeof(pd.m_subaddr_index));
+        key.append(reinterpret_cast<const char*>(&i->first), sizeof(i->first));
+        if (!m_confirmedKeys.insert(std::move(key)).second)
+            continue;
         std::string payment_id = string_tools::pod_to_hex(i->first);
         if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
             payment_id = payment_id.substr(0,16);
@@ -145,7 +186,7 @@ void TransactionHistoryImpl::refresh()
         ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
         ti->m_unlock_time = pd.m_unlock_time;
         ti->m_reward_type = from_pay_type(pd.m_type);
-        m_history.push_back(ti);
+        m_confirmed.push_back(ti);
 
     }
 
@@ -165,6 +206,8 @@ void TransactionHistoryImpl::refresh()
         
         const crypto::hash &hash = i->first;
         const tools::wallet2::confirmed_transfer_details &pd = i->second;
+        if (!m_confirmedKeys.insert("o" + std::string(reinterpret_cast<const char*>(&hash), sizeof(hash))).second)
+            continue;
         
         uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
         uint64_t fee = pd.m_amount_in - pd.m_amount_out;
@@ -192,7 +235,7 @@ void TransactionHistoryImpl::refresh()
         for (const auto &d: pd.m_dests) {
             ti->m_transfers.push_back({d.amount, get_account_address_as_str(m_wallet->m_wallet->nettype(), d.is_subaddress, d.addr)});
         }
-        m_history.push_back(ti);
+        m_confirmed.push_back(ti);
     }
 
     // unconfirmed output transactions
@@ -221,7 +264,7 @@ void TransactionHistoryImpl::refresh()
         ti->m_label = pd.m_subaddr_indices.size() == 1 ? m_wallet->m_wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
         ti->m_timestamp = pd.m_timestamp;
         ti->m_confirmations = 0;
-        m_history.push_back(ti);
+        m_pending.push_back(ti);
     }
     
     
@@ -246,11 +289,15 @@ void TransactionHistoryImpl::refresh()
         ti->m_timestamp = pd.m_timestamp;
         ti->m_confirmations = 0;
         ti->m_reward_type = from_pay_type(pd.m_type);
-        m_history.push_back(ti);
+        m_pending.push_back(ti);
         
         LOG_PRINT_L1(__FUNCTION__ << ": Unconfirmed payment found " << pd.m_amount);
     }
-     
+
+    m_history.clear();
+    m_history.reserve(m_confirmed.size() + m_pending.size());
+    m_history.insert(m_history.end(), m_confirmed.begin(), m_confirmed.end());
+    m_history.insert(m_history.end(), m_pending.begin(), m_pending.end());
 }
 
 } // namespace
@@ -30,10 +30,12 @@
 
 #include "wallet/api/wallet2_api.h"
 #include <boost/thread/shared_mutex.hpp>
+#include <set>
 
 namespace Monero {
 
 class WalletImpl;
+class TransactionInfoImpl;
 
 class TransactionHistoryImpl : public TransactionHistory
 {
@@ -47,11 +49,22 @@ public:
     virtual void refresh();
 
 private:
+    void clear();
 
     // TransactionHistory is responsible of memory management
     std::vector<TransactionInfo*> m_history;
     WalletImpl *m_wallet;
     mutable boost::shared_mutex   m_historyMutex;
+
+    // Confirmed entries only ever get added at new heights until wallet2 bumps its
+    // history generation, so they are kept across refreshes and only the heights
+    // from m_scannedHeight on are fetched. Pending ones are rebuilt every time.
+    std::vector<TransactionInfoImpl*> m_confirmed;
+    std::vector<TransactionInfoImpl*> m_pending;
+    std::set<std::string> m_confirmedKeys;
+    uint64_t m_scannedHeight;
+    uint64_t m_historyGeneration;
+    bool m_built;
 };
 
 }
@@ -49,6 +49,7 @@
 #include "mnemonics/english.h"
 #include <boost/format.hpp>
 #include <sstream>
+#include <chrono>
 #include <unordered_map>
 
 #ifdef WIN32
@@ -74,6 +75,14 @@ namespace {
     static const int    DEFAULT_REMOTE_NODE_REFRESH_INTERVAL_MILLIS = 1000 * 10;
     // Connection timeout 30 sec
     static const int    DEFAULT_CONNECTION_TIMEOUT_MILLIS = 1000 * 30;
+    // adaptive refresh never sleeps longer than this, low power waits this many times longer
+    static const int    MAX_ADAPTIVE_REFRESH_INTERVAL_MILLIS = 1000 * 60 * 5;
+    static const int    LOW_POWER_REFRESH_FACTOR = 3;
+
+    int64_t steady_millis()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 
     std::string get_default_ringdb_path(cryptonote::network_type nettype)
     {
@@ -394,6 +403,9 @@ WalletImpl::WalletImpl(NetworkType nettype, uint64_t kdf_rounds)
     , m_rebuildWalletCache(false)
     , m_is_connected(false)
     , m_refreshShouldRescan(false)
+    , m_refreshMode(RefreshMode_Adaptive)
+    , m_blockSeen(false)
+    , m_lastBlockSeenMillis(0)
 {
     m_wallet.reset(new tools::wallet2(static_cast<cryptonote::network_type>(nettype), kdf_rounds, true));
     m_history.reset(new TransactionHistoryImpl(this));
@@ -1060,6 +1072,17 @@ int WalletImpl::autoRefreshInterval() const
     return m_refreshIntervalMillis;
 }
 
+void WalletImpl::setRefreshMode(RefreshMode mode)
+{
+    m_refreshMode = mode;
+    m_refreshCV.notify_one();
+}
+
+Wallet::RefreshMode WalletImpl::refreshMode() const
+{
+    return m_refreshMode;
+}
+
 UnsignedTransaction *WalletImpl::loadUnsignedTx(const std::string &unsigned_filename) {
   clearStatus();
   UnsignedTransactionImpl * transaction = new UnsignedTransactionImpl(*this);
@@ -2010,7 +2033,7 @@ void WalletImpl::refreshThreadFunc()
         // if auto refresh enabled, we wait for the "m_refreshIntervalSeconds" interval.
         // if not - we wait forever
         if (m_refreshIntervalMillis > 0) {
-            boost::posix_time::milliseconds wait_for_ms(m_refreshIntervalMillis.load());
+            boost::posix_time::milliseconds wait_for_ms(nextRefreshWaitMillis());
             m_refreshCV.timed_wait(lock, wait_for_ms);
         } else {
             m_refreshCV.wait(lock);
@@ -2028,6 +2051,28 @@ void WalletImpl::refreshThreadFunc()
     LOG_PRINT_L3(__FUNCTION__ << ": refresh thread stopped");
 }
 
+int WalletImpl::nextRefreshWaitMillis() const
+{
+    const int base = m_refreshIntervalMillis;
+    const RefreshMode mode = m_refreshMode;
+    if (mode == RefreshMode_FullSync || base <= 0 || !m_blockSeen || !m_synchronized)
+        return base;
+
+    // blocks come every DIFFICULTY_TARGET_V2 on average: right after one there is
+    // little point in polling, then poll at the base interval until the next one
+    // is in, backing off while it is late
+    const int64_t target = DIFFICULTY_TARGET_V2 * 1000;
+    const int64_t since = steady_millis() - m_lastBlockSeenMillis;
+    int64_t wait;
+    if (since + base < target)
+        wait = target - since - base;
+    else
+        wait = (int64_t)base << std::min<int64_t>((since - target) / target, 3);
+    if (mode == RefreshMode_LowPower)
+        wait *= LOW_POWER_REFRESH_FACTOR;
+    return (int)std::max<int64_t>(base, std::min<int64_t>(wait, MAX_ADAPTIVE_REFRESH_INTERVAL_MILLIS));
+}
+
 void WalletImpl::doRefresh()
 {
     bool rescan = m_refreshShouldRescan.exchange(false);
@@ -2040,7 +2085,12 @@ void WalletImpl::doRefresh()
         if (m_wallet->light_wallet() || daemonSynced()) {
             if(rescan)
                 m_wallet->rescan_blockchain(false);
+            const uint64_t height_before = m_wallet->get_blockchain_current_height();
             m_wallet->refresh(trustedDaemon());
+            if (m_wallet->get_blockchain_current_height() != height_before || !m_blockSeen) {
+                m_lastBlockSeenMillis = steady_millis();
+                m_blockSeen = true;
+            }
             if (!m_synchronized) {
                 m_synchronized = true;
             }
@@ -119,6 +119,8 @@ public:
     void rescanBlockchainAsync() override;    
     void setAutoRefreshInterval(int millis) override;
     int autoRefreshInterval() const override;
+    void setRefreshMode(RefreshMode mode) override;
+    RefreshMode refreshMode() const override;
     void setRefreshFromBlockHeight(uint64_t refresh_from_block_height) override;
     uint64_t getRefreshFromBlockHeight() const override { return m_wallet->get_refresh_from_block_height(); };
     void setRecoveringFromSeed(bool recoveringFromSeed) override;
@@ -208,6 +210,7 @@ private:
     void setStatus(int status, const std::string& message) const;
     void refreshThreadFunc();
     void doRefresh();
+    int nextRefreshWaitMillis() const;
     bool daemonSynced() const;
     void stopRefresh();
     bool isNewWallet() const;
@@ -237,6 +240,10 @@ private:
     std::atomic<bool> m_refreshEnabled;
     std::atomic<bool> m_refreshThreadDone;
     std::atomic<int>  m_refreshIntervalMillis;
+    std::atomic<RefreshMode> m_refreshMode;
+    // when the wallet last saw the chain grow, paces the adaptive modes
+    std::atomic<bool> m_blockSeen;
+    std::atomic<int64_t> m_lastBlockSeenMillis;
     std::atomic<bool> m_refreshShouldRescan;
     // synchronizing  refresh loop;
     boost::mutex        m_refreshMutex;
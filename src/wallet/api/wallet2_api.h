@@ -386,6 +386,12 @@ struct Wallet
         Status_Critical
     };
 
+    enum RefreshMode {
+        RefreshMode_FullSync, // refresh on every auto refresh interval
+        RefreshMode_Adaptive, // sleep through most of the time until the next block is due
+        RefreshMode_LowPower  // as adaptive, with longer waits
+    };
+
     enum ConnectionStatus {
         ConnectionStatus_Disconnected,
         ConnectionStatus_Connected,
@@ -676,6 +682,20 @@ struct Wallet
      */
     virtual int autoRefreshInterval() const = 0;
 
+    /**
+     * @brief setRefreshMode - chooses how the automatic refresh is scheduled
+     * @param mode - RefreshMode_FullSync refreshes on every interval, RefreshMode_Adaptive
+     *               (the default) waits longer right after a block and backs off while
+     *               blocks are late, RefreshMode_LowPower does the same with longer waits
+     */
+    virtual void setRefreshMode(RefreshMode mode) = 0;
+
+    /**
+     * @brief refreshMode - returns the automatic refresh scheduling mode
+     * @return
+     */
+    virtual RefreshMode refreshMode() const = 0;
+
     /**
      * @brief addSubaddressAccount - appends a new subaddress account at the end of the last major index of existing subaddress accounts
      * @param label - the label for the new account (which is the as the label of the primary address (accountIndex,0))
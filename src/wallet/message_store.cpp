@@ -57,6 +57,7 @@ message_store::message_store()
   m_num_required_signers = 0;
   m_nettype = cryptonote::network_type::UNDEFINED;
   m_run = true;
+  m_file_key_valid = false;
 }
 
 namespace
@@ -556,6 +557,16 @@ size_t message_store::add_message(const multisig_wallet_state &state,
 // Get the index of the message with id "id", return false if not found
 bool message_store::get_message_index_by_id(uint32_t id, size_t &index) const
 {
+  // Ids are handed out in increasing order and messages are only ever appended or erased,
+  // so the vector is sorted by id; the linear scan below only runs for an unknown id or a store
+  // from elsewhere that is not sorted
+  const auto it = std::lower_bound(m_messages.begin(), m_messages.end(), id,
+                                   [](const message &m, uint32_t id) { return m.id < id; });
+  if (it != m_messages.end() && it->id == id)
+  {
+    index = it - m_messages.begin();
+    return true;
+  }
   for (size_t i = 0; i < m_messages.size(); ++i)
   {
     if (m_messages[i].id == id)
@@ -697,6 +708,17 @@ void message_store::get_sanitized_message_text(const message &m, std::string &sa
   }
 }
 
+const crypto::chacha_key &message_store::get_file_key(const multisig_wallet_state &state)
+{
+  if (!m_file_key_valid || m_file_key_source != state.view_secret_key)
+  {
+    crypto::generate_chacha_key(&state.view_secret_key, sizeof(crypto::secret_key), m_file_key, 1);
+    m_file_key_source = state.view_secret_key;
+    m_file_key_valid = true;
+  }
+  return m_file_key;
+}
+
 void message_store::write_to_file(const multisig_wallet_state &state, const std::string &filename)
 {
   std::stringstream oss;
@@ -704,8 +726,7 @@ void message_store::write_to_file(const multisig_wallet_state &state, const std:
   ar << *this;
   std::string buf = oss.str();
 
-  crypto::chacha_key key;
-  crypto::generate_chacha_key(&state.view_secret_key, sizeof(crypto::secret_key), key, 1);
+  const crypto::chacha_key &key = get_file_key(state);
 
   file_data write_file_data = boost::value_initialized<file_data>();
   write_file_data.magic_string = "MMS";
@@ -754,8 +775,7 @@ void message_store::read_from_file(const multisig_wallet_state &state, const std
     THROW_WALLET_EXCEPTION_IF(true, tools::error::file_read_error, filename);
   }
 
-  crypto::chacha_key key;
-  crypto::generate_chacha_key(&state.view_secret_key, sizeof(crypto::secret_key), key, 1);
+  const crypto::chacha_key &key = get_file_key(state);
   std::string decrypted_data;
   decrypted_data.resize(read_file_data.encrypted_data.size());
   crypto::chacha20(read_file_data.encrypted_data.data(), read_file_data.encrypted_data.size(), key, read_file_data.iv, &decrypted_data[0]);
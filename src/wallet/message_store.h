@@ -315,6 +315,13 @@ namespace mms
     std::string m_filename;
     message_transporter m_transporter;
     std::atomic<bool> m_run;
+    // file encryption key derived from m_file_key_source, kept so that saving
+    // after every change does not rerun the key derivation each time
+    bool m_file_key_valid;
+    crypto::secret_key m_file_key_source;
+    crypto::chacha_key m_file_key;
+
+    const crypto::chacha_key &get_file_key(const multisig_wallet_state &state);
 
     bool get_message_index_by_id(uint32_t id, size_t &index) const;
     size_t get_message_index_by_id(uint32_t id) const;
@@ -46,6 +46,7 @@ NodeRPCProxy::NodeRPCProxy(epee::net_utils::http::http_simple_client &http_clien
 
 void NodeRPCProxy::invalidate()
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   m_full_node_blacklisted_key_images_cached_height = 0;
   m_full_node_blacklisted_key_images.clear();
 
@@ -71,6 +72,7 @@ void NodeRPCProxy::invalidate()
 
 boost::optional<std::string> NodeRPCProxy::get_rpc_version(uint32_t &rpc_version) const
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   if (m_rpc_version == 0)
   {
     cryptonote::COMMAND_RPC_GET_VERSION::request req_t = AUTO_VAL_INIT(req_t);
@@ -89,9 +91,11 @@ boost::optional<std::string> NodeRPCProxy::get_rpc_version(uint32_t &rpc_version
 
 void NodeRPCProxy::set_height(uint64_t h)
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   m_height = h;
 }
 
+// m_cache_mutex must be held
 boost::optional<std::string> NodeRPCProxy::get_info() const
 {
   const time_t now = time(NULL);
@@ -117,6 +121,7 @@ boost::optional<std::string> NodeRPCProxy::get_info() const
 
 boost::optional<std::string> NodeRPCProxy::get_height(uint64_t &height) const
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   auto res = get_info();
   if (res)
     return res;
@@ -126,6 +131,7 @@ boost::optional<std::string> NodeRPCProxy::get_height(uint64_t &height) const
 
 boost::optional<std::string> NodeRPCProxy::get_target_height(uint64_t &height) const
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   auto res = get_info();
   if (res)
     return res;
@@ -135,6 +141,7 @@ boost::optional<std::string> NodeRPCProxy::get_target_height(uint64_t &height) c
 
 boost::optional<std::string> NodeRPCProxy::get_block_weight_limit(uint64_t &block_weight_limit) const
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   auto res = get_info();
   if (res)
     return res;
@@ -144,6 +151,7 @@ boost::optional<std::string> NodeRPCProxy::get_block_weight_limit(uint64_t &bloc
 
 boost::optional<std::string> NodeRPCProxy::get_earliest_height(uint8_t version, uint64_t &earliest_height) const
 {
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
   if (m_earliest_height[version] == 0)
   {
     cryptonote::COMMAND_RPC_HARD_FORK_INFO::request req_t = AUTO_VAL_INIT(req_t);
@@ -180,11 +188,11 @@ boost::optional<uint8_t> NodeRPCProxy::get_hardfork_version() const
 
 boost::optional<std::string> NodeRPCProxy::get_dynamic_base_fee_estimate(uint64_t grace_blocks, uint64_t &fee) const
 {
-  uint64_t height;
-
-  boost::optional<std::string> result = get_height(height);
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
+  boost::optional<std::string> result = get_info();
   if (result)
     return result;
+  const uint64_t height = m_height;
 
   if (m_dynamic_base_fee_estimate_cached_height != height || m_dynamic_base_fee_estimate_grace_blocks != grace_blocks)
   {
@@ -210,11 +218,11 @@ boost::optional<std::string> NodeRPCProxy::get_dynamic_base_fee_estimate(uint64_
 
 boost::optional<std::string> NodeRPCProxy::get_fee_quantization_mask(uint64_t &fee_quantization_mask) const
 {
-  uint64_t height;
-
-  boost::optional<std::string> result = get_height(height);
+  boost::lock_guard<boost::mutex> cache_lock(m_cache_mutex);
+  boost::optional<std::string> result = get_info();
   if (result)
     return result;
+  const uint64_t height = m_height;
 
   if (m_dynamic_base_fee_estimate_cached_height != height)
   {
@@ -65,6 +65,12 @@ private:
   epee::net_utils::http::http_simple_client &m_http_client;
   boost::mutex &m_daemon_rpc_mutex;
 
+  // Guards the height/fee/version caches below. It is held across the
+  // refresh, so threads that miss the same entry wait for the one request in
+  // flight and share its result instead of queueing up duplicates behind
+  // m_daemon_rpc_mutex. Always taken before m_daemon_rpc_mutex.
+  mutable boost::mutex m_cache_mutex;
+
   mutable uint64_t m_full_node_blacklisted_key_images_cached_height;
   mutable std::vector<cryptonote::COMMAND_RPC_GET_FULL_NODE_BLACKLISTED_KEY_IMAGES::entry> m_full_node_blacklisted_key_images;
 
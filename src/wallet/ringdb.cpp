@@ -43,6 +43,8 @@
 
 #define V1TAG ((uint64_t)798237759845202)
 
+#define RING_CACHE_MAX_SIZE 65536
+
 static const char zerokey[8] = {0};
 static const MDB_val zerokeyval = { sizeof(zerokey), (void *)zerokey };
 
@@ -79,12 +81,12 @@ static std::string compress_ring(const std::vector<uint64_t> &ring, uint64_t tag
 static std::vector<uint64_t> decompress_ring(const std::string &s, uint64_t tag)
 {
   std::vector<uint64_t> ring;
-  int read = 0;
-  for (std::string::const_iterator i = s.begin(); i != s.cend(); std::advance(i, read))
+  ring.reserve(s.size());
+  std::string::const_iterator end = s.cend();
+  for (std::string::const_iterator i = s.begin(); i != end; )
   {
     uint64_t out;
-    std::string tmp(i, s.cend());
-    read = tools::read_varint(tmp.begin(), tmp.end(), out);
+    const int read = tools::read_varint(i, end, out);
     THROW_WALLET_EXCEPTION_IF(read <= 0 || read > 256, tools::error::wallet_internal_error, "Internal error decompressing ring");
     if (tag)
     {
@@ -215,6 +217,7 @@ ringdb::ringdb(std::string filename, const std::string &genesis):
   filename(filename),
   env(NULL)
 {
+  memset(&ring_cache_key, 0, sizeof(ring_cache_key));
   MDB_txn *txn;
   bool tx_active = false;
   int dbr;
@@ -265,28 +268,40 @@ void ringdb::close()
 }
 
 bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx)
+{
+  return add_rings(chacha_key, std::vector<cryptonote::transaction_prefix>(1, tx));
+}
+
+bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const std::vector<cryptonote::transaction_prefix> &txs)
 {
   MDB_txn *txn;
   int dbr;
   bool tx_active = false;
 
-  dbr = resize_env(env, filename.c_str(), get_ring_data_size(tx.vin.size()));
+  size_t n_inputs = 0;
+  for (const auto &tx: txs)
+    n_inputs += tx.vin.size();
+  dbr = resize_env(env, filename.c_str(), get_ring_data_size(n_inputs));
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size");
   dbr = mdb_txn_begin(env, NULL, 0, &txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
   epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
   tx_active = true;
 
-  for (const auto &in: tx.vin)
+  for (const auto &tx: txs)
   {
-    if (in.type() != typeid(cryptonote::txin_to_key))
-      continue;
-    const auto &txin = boost::get<cryptonote::txin_to_key>(in);
-    const uint32_t ring_size = txin.key_offsets.size();
-    if (ring_size == 1)
-      continue;
-
-    store_relative_ring(txn, dbi_rings, txin.k_image, txin.key_offsets, chacha_key);
+    for (const auto &in: tx.vin)
+    {
+      if (in.type() != typeid(cryptonote::txin_to_key))
+        continue;
+      const auto &txin = boost::get<cryptonote::txin_to_key>(in);
+      const uint32_t ring_size = txin.key_offsets.size();
+      if (ring_size == 1)
+        continue;
+
+      store_relative_ring(txn, dbi_rings, txin.k_image, txin.key_offsets, chacha_key);
+      uncache_ring(txin.k_image);
+    }
   }
 
   dbr = mdb_txn_commit(txn);
@@ -331,6 +346,7 @@ bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const cryptonote
     MDEBUG("Removing ring data for key image " << txin.k_image);
     dbr = mdb_del(txn, dbi_rings, &key, NULL);
     THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to remove ring to database: " + std::string(mdb_strerror(dbr)));
+    uncache_ring(txin.k_image);
   }
 
   dbr = mdb_txn_commit(txn);
@@ -345,6 +361,16 @@ bool ringdb::get_ring(const crypto::chacha_key &chacha_key, const crypto::key_im
   int dbr;
   bool tx_active = false;
 
+  if (!ring_cache.empty() && !memcmp(&ring_cache_key, &chacha_key, sizeof(chacha_key)))
+  {
+    const auto i = ring_cache.find(key_image);
+    if (i != ring_cache.end())
+    {
+      outs = i->second;
+      return true;
+    }
+  }
+
   dbr = resize_env(env, filename.c_str(), 0);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
   dbr = mdb_txn_begin(env, NULL, 0, &txn);
@@ -379,6 +405,7 @@ bool ringdb::get_ring(const crypto::chacha_key &chacha_key, const crypto::key_im
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn getting ring from database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
+  cache_ring(chacha_key, key_image, outs);
   return true;
 }
 
@@ -396,6 +423,7 @@ bool ringdb::set_ring(const crypto::chacha_key &chacha_key, const crypto::key_im
   tx_active = true;
 
   store_relative_ring(txn, dbi_rings, key_image, relative ? outs : cryptonote::absolute_output_offsets_to_relative(outs), chacha_key);
+  uncache_ring(key_image);
 
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn setting ring to database: " + std::string(mdb_strerror(dbr)));
@@ -413,6 +441,16 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
 
   THROW_WALLET_EXCEPTION_IF(outputs.size() > 1 && op == BLACKBALL_QUERY, tools::error::wallet_internal_error, "Blackball query only makes sense for a single output");
 
+  // large lists are written in key order, so each btree page is touched once
+  std::vector<std::pair<uint64_t, uint64_t>> sorted_outputs;
+  const std::vector<std::pair<uint64_t, uint64_t>> *ordered_outputs = &outputs;
+  if (op == BLACKBALL_BLACKBALL && !std::is_sorted(outputs.begin(), outputs.end()))
+  {
+    sorted_outputs = outputs;
+    std::sort(sorted_outputs.begin(), sorted_outputs.end());
+    ordered_outputs = &sorted_outputs;
+  }
+
   dbr = resize_env(env, filename.c_str(), 32 * 2 * outputs.size()); // a pubkey, and some slack
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
   dbr = mdb_txn_begin(env, NULL, 0, &txn);
@@ -424,7 +462,7 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create cursor for blackballs table: " + std::string(mdb_strerror(dbr)));
 
   MDB_val key, data;
-  for (const std::pair<uint64_t, uint64_t> &output: outputs)
+  for (const std::pair<uint64_t, uint64_t> &output: *ordered_outputs)
   {
     key.mv_data = (void*)&output.first;
     key.mv_size = sizeof(output.first);
@@ -435,7 +473,7 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
     {
       case BLACKBALL_BLACKBALL:
         MDEBUG("Marking output " << output.first << "/" << output.second << " as spent");
-        dbr = mdb_cursor_put(cursor, &key, &data, MDB_APPENDDUP);
+        dbr = mdb_cursor_put(cursor, &key, &data, MDB_NODUPDATA);
         if (dbr == MDB_KEYEXIST)
           dbr = 0;
         break;
@@ -474,6 +512,21 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
   return ret;
 }
 
+void ringdb::cache_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, const std::vector<uint64_t> &outs)
+{
+  if (memcmp(&ring_cache_key, &chacha_key, sizeof(chacha_key)) || ring_cache.size() >= RING_CACHE_MAX_SIZE)
+  {
+    ring_cache.clear();
+    ring_cache_key = chacha_key;
+  }
+  ring_cache[key_image] = outs;
+}
+
+void ringdb::uncache_ring(const crypto::key_image &key_image)
+{
+  ring_cache.erase(key_image);
+}
+
 bool ringdb::blackball(const std::vector<std::pair<uint64_t, uint64_t>> &outputs)
 {
   return blackball_worker(outputs, BLACKBALL_BLACKBALL);
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <lmdb.h>
 #include "wipeable_string.h"
 #include "crypto/crypto.h"
@@ -45,6 +46,7 @@ namespace tools
     ~ringdb();
 
     bool add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx);
+    bool add_rings(const crypto::chacha_key &chacha_key, const std::vector<cryptonote::transaction_prefix> &txs);
     bool remove_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx);
     bool get_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, std::vector<uint64_t> &outs);
     bool set_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, const std::vector<uint64_t> &outs, bool relative);
@@ -57,11 +59,17 @@ namespace tools
 
   private:
     bool blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &outputs, int op);
+    void cache_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, const std::vector<uint64_t> &outs);
+    void uncache_ring(const crypto::key_image &key_image);
 
   private:
     std::string filename;
     MDB_env *env;
     MDB_dbi dbi_rings;
     MDB_dbi dbi_blackballs;
+
+    // absolute rings already decrypted under ring_cache_key, by key image
+    std::unordered_map<crypto::key_image, std::vector<uint64_t>> ring_cache;
+    crypto::chacha_key ring_cache_key;
   };
 }
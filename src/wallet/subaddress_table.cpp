@@ -0,0 +1,141 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <string.h>
+#include "subaddress_table.h"
+
+namespace
+{
+  // keep at most 3/4 of the slots used, so probe sequences stay short
+  size_t min_capacity(size_t n)
+  {
+    size_t capacity = 16;
+    while (capacity - capacity / 4 < n)
+      capacity *= 2;
+    return capacity;
+  }
+
+  uint64_t key_tag(const crypto::public_key &key)
+  {
+    uint64_t tag;
+    memcpy(&tag, key.data, sizeof(tag));
+    return tag;
+  }
+}
+
+namespace tools
+{
+
+subaddress_table::subaddress_table():
+  m_size(0)
+{
+}
+
+void subaddress_table::clear()
+{
+  m_slots.clear();
+  m_size = 0;
+}
+
+void subaddress_table::reserve(size_t n)
+{
+  const size_t capacity = min_capacity(n);
+  if (capacity > m_slots.size())
+    rehash(capacity);
+}
+
+size_t subaddress_table::probe(const crypto::public_key &key) const
+{
+  const size_t mask = m_slots.size() - 1;
+  const uint64_t tag = key_tag(key);
+  size_t n = tag & mask;
+  while (true)
+  {
+    const slot &s = m_slots[n];
+    const uint64_t t = key_tag(s.key);
+    if (t == tag && s.key == key)
+      return n;
+    if (t == 0 && s.key == crypto::null_pkey)
+      return n;
+    n = (n + 1) & mask;
+  }
+}
+
+void subaddress_table::rehash(size_t capacity)
+{
+  std::vector<slot> slots(capacity, slot{crypto::null_pkey, cryptonote::subaddress_index{0, 0}});
+  std::swap(slots, m_slots);
+  for (const slot &s: slots)
+    if (s.key != crypto::null_pkey)
+      m_slots[probe(s.key)] = s;
+}
+
+void subaddress_table::insert(const crypto::public_key &key, const cryptonote::subaddress_index &index)
+{
+  if (key == crypto::null_pkey)
+    return;
+  if (m_slots.size() - m_slots.size() / 4 <= m_size)
+    rehash(min_capacity(m_size + 1));
+  slot &s = m_slots[probe(key)];
+  if (s.key == crypto::null_pkey)
+  {
+    s.key = key;
+    ++m_size;
+  }
+  s.index = index;
+}
+
+void subaddress_table::insert(const std::vector<crypto::public_key> &keys, const cryptonote::subaddress_index &first)
+{
+  reserve(m_size + keys.size());
+  cryptonote::subaddress_index index = first;
+  for (const crypto::public_key &key: keys)
+  {
+    insert(key, index);
+    ++index.minor;
+  }
+}
+
+void subaddress_table::assign(const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses)
+{
+  m_slots.assign(min_capacity(subaddresses.size()), slot{crypto::null_pkey, cryptonote::subaddress_index{0, 0}});
+  m_size = 0;
+  for (const auto &e: subaddresses)
+    insert(e.first, e.second);
+}
+
+const cryptonote::subaddress_index *subaddress_table::find(const crypto::public_key &key) const
+{
+  if (m_slots.empty() || key == crypto::null_pkey)
+    return NULL;
+  const slot &s = m_slots[probe(key)];
+  return s.key == crypto::null_pkey ? NULL : &s.index;
+}
+
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+
+namespace tools
+{
+  // Flat open addressing table from subaddress spend public key to subaddress index.
+  // The first 8 bytes of the key pick the slot and are compared before the full key,
+  // which is enough since curve points are uniformly distributed. An empty slot holds
+  // the null key, which no subaddress can have.
+  class subaddress_table
+  {
+  public:
+    subaddress_table();
+
+    void clear();
+    void reserve(size_t n);
+    void insert(const crypto::public_key &key, const cryptonote::subaddress_index &index);
+    void insert(const std::vector<crypto::public_key> &keys, const cryptonote::subaddress_index &first);
+    void assign(const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses);
+    const cryptonote::subaddress_index *find(const crypto::public_key &key) const;
+    size_t size() const { return m_size; }
+
+  private:
+    struct slot
+    {
+      crypto::public_key key;
+      cryptonote::subaddress_index index;
+    };
+
+    size_t probe(const crypto::public_key &key) const;
+    void rehash(size_t capacity);
+
+  private:
+    std::vector<slot> m_slots;
+    size_t m_size;
+  };
+}
@@ -29,6 +29,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <fstream>
 #include <numeric>
 #include <random>
 #include <tuple>
@@ -63,6 +64,7 @@ using namespace epee;
 #include "mnemonics/electrum-words.h"
 #include "common/i18n.h"
 #include "common/util.h"
+#include "common/varint.h"
 #include "common/apply_permutation.h"
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
@@ -74,6 +76,7 @@ using namespace epee;
 #include "common/dns_utils.h"
 #include "common/notify.h"
 #include "common/perf_timer.h"
+#include "common/alloc_profiler.h"
 #include "ringct/rctSigs.h"
 #include "ringdb.h"
 #include "device/device_cold.hpp"
@@ -129,6 +132,13 @@ using namespace cryptonote;
 
 #define GAMMA_PICK_HALF_WINDOW 5
 
+#define CACHE_JOURNAL_SUFFIX ".journal"
+#define CACHE_JOURNAL_MAX_RECORDS 256 // compact after that many stores, even if they were small
+
+#define REFRESH_PIPELINE_DEPTH 3 // batches each refresh stage may run ahead of the next one
+
+#define CACHE_LOAD_CHUNK_SIZE (1024 * 1024) // a multiple of the 64 byte chacha block
+
 static const std::string MULTISIG_SIGNATURE_MAGIC = "SigMultisigPkV1";
 static const std::string MULTISIG_EXTRA_INFO_MAGIC = "MultisigxV1";
 
@@ -199,6 +209,46 @@ namespace
       reason             += print_vote_verification_context(res.tvc.m_vote_ctx);
       return reason;
   }
+
+  // decrypts length bytes of chacha20 ciphertext as they are read from in, a chunk at a time
+  class chacha20_istreambuf: public std::streambuf
+  {
+  public:
+    chacha20_istreambuf(std::istream &in, uint64_t length, const crypto::chacha_key &key, const crypto::chacha_iv &iv):
+      m_in(in), m_left(length), m_key(key), m_iv(iv), m_block(0), m_cipher(CACHE_LOAD_CHUNK_SIZE), m_plain(CACHE_LOAD_CHUNK_SIZE)
+    {
+      static_assert(CACHE_LOAD_CHUNK_SIZE % 64 == 0, "chunks must be whole chacha blocks");
+    }
+
+    ~chacha20_istreambuf()
+    {
+      memwipe(m_plain.data(), m_plain.size());
+    }
+
+  protected:
+    int_type underflow() override
+    {
+      if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+      const size_t n = std::min<uint64_t>(m_left, m_cipher.size());
+      if (n == 0 || !m_in.read(m_cipher.data(), n))
+        return traits_type::eof();
+      crypto::chacha20_from_block(m_cipher.data(), n, m_key, m_iv, m_block, m_plain.data());
+      m_block += n / 64;
+      m_left -= n;
+      setg(m_plain.data(), m_plain.data(), m_plain.data() + n);
+      return traits_type::to_int_type(*gptr());
+    }
+
+  private:
+    std::istream &m_in;
+    uint64_t m_left;
+    const crypto::chacha_key &m_key;
+    const crypto::chacha_iv &m_iv;
+    uint64_t m_block;
+    std::vector<char> m_cipher;
+    std::vector<char> m_plain;
+  };
 }
 
   size_t get_num_outputs(const std::vector<cryptonote::tx_destination_entry> &dsts, const std::vector<tools::wallet2::transfer_details> &transfers, const std::vector<size_t> &selected_transfers)
@@ -934,6 +984,10 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended):
   m_multisig_rescan_info(NULL),
   m_multisig_rescan_k(NULL),
   m_upper_transaction_weight_limit(0),
+  m_unspent_indexed(0),
+  m_history_indexed(false),
+  m_history_generation(0),
+  m_cache_base_id(0),
   m_run(true),
   m_callback(0),
   m_trusted_daemon(false),
@@ -971,9 +1025,13 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended):
   m_multisig(false),
   m_multisig_threshold(0),
   m_node_rpc_proxy(m_http_client, m_daemon_rpc_mutex),
+  m_rct_distribution_height(0),
+  m_pool_cookie(0),
   m_account_public_address{crypto::null_pkey, crypto::null_pkey},
   m_subaddress_lookahead_major(SUBADDRESS_LOOKAHEAD_MAJOR),
   m_subaddress_lookahead_minor(SUBADDRESS_LOOKAHEAD_MINOR),
+  m_account_range_first(0),
+  m_account_range_end(std::numeric_limits<uint32_t>::max()),
   m_light_wallet(false),
   m_light_wallet_scanned_block_height(0),
   m_light_wallet_blockchain_height(0),
@@ -1241,10 +1299,10 @@ cryptonote::account_public_address wallet2::get_subaddress(const cryptonote::sub
 //----------------------------------------------------------------------------------------------------
 boost::optional<cryptonote::subaddress_index> wallet2::get_subaddress_index(const cryptonote::account_public_address& address) const
 {
-  auto index = m_subaddresses.find(address.m_spend_public_key);
-  if (index == m_subaddresses.end())
+  const cryptonote::subaddress_index *index = m_subaddress_table.find(address.m_spend_public_key);
+  if (!index)
     return boost::none;
-  return index->second;
+  return *index;
 }
 //----------------------------------------------------------------------------------------------------
 crypto::public_key wallet2::get_subaddress_spend_public_key(const cryptonote::subaddress_index& index) const
@@ -1279,6 +1337,39 @@ void wallet2::add_subaddress(uint32_t index_major, const std::string& label)
   m_subaddress_labels[index_major][index_minor] = label;
 }
 //----------------------------------------------------------------------------------------------------
+// large lookahead windows are generated in chunks across the threadpool; hardware
+// devices are asked in one go since they serialize requests anyway
+static std::vector<crypto::public_key> generate_subaddress_spend_public_keys(hw::device &hwdev, const cryptonote::account_keys &keys, uint32_t major, uint32_t begin, uint32_t end)
+{
+  static const uint32_t chunk_size = 1024;
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  if (hwdev.get_type() != hw::device::SOFTWARE || tpool.get_max_concurrency() <= 1 || end - begin <= chunk_size)
+    return hwdev.get_subaddress_spend_public_keys(keys, major, begin, end);
+
+  const size_t n_chunks = (end - begin + chunk_size - 1) / chunk_size;
+  std::vector<std::vector<crypto::public_key>> chunks(n_chunks);
+  std::unique_ptr<bool[]> failed(new bool[n_chunks]());
+  tools::threadpool::waiter waiter;
+  for (size_t c = 0; c < n_chunks; ++c)
+  {
+    const uint32_t b = begin + c * chunk_size, e = std::min<uint32_t>(end, b + chunk_size);
+    tpool.submit(&waiter, [&, c, b, e](){
+      try { chunks[c] = hwdev.get_subaddress_spend_public_keys(keys, major, b, e); }
+      catch (const std::exception &ex) { MERROR("Failed to generate subaddress spend keys: " << ex.what()); failed[c] = true; }
+    }, true);
+  }
+  waiter.wait(&tpool);
+
+  std::vector<crypto::public_key> pkeys;
+  pkeys.reserve(end - begin);
+  for (size_t c = 0; c < n_chunks; ++c)
+  {
+    THROW_WALLET_EXCEPTION_IF(failed[c], error::wallet_internal_error, "Failed to generate subaddress spend keys");
+    pkeys.insert(pkeys.end(), chunks[c].begin(), chunks[c].end());
+  }
+  return pkeys;
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
 {
   hw::device &hwdev = m_account.get_device();
@@ -1289,30 +1380,38 @@ void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
     const uint32_t major_end = get_subaddress_clamped_sum(index.major, m_subaddress_lookahead_major);
     for (index2.major = m_subaddress_labels.size(); index2.major < major_end; ++index2.major)
     {
+      if (!in_account_range(index2.major))
+        continue;
       const uint32_t end = get_subaddress_clamped_sum((index2.major == index.major ? index.minor : 0), m_subaddress_lookahead_minor);
-      const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, 0, end);
+      const std::vector<crypto::public_key> pkeys = generate_subaddress_spend_public_keys(hwdev, m_account.get_keys(), index2.major, 0, end);
       for (index2.minor = 0; index2.minor < end; ++index2.minor)
       {
          const crypto::public_key &D = pkeys[index2.minor];
          m_subaddresses[D] = index2;
       }
+      m_subaddress_table.insert(pkeys, {index2.major, 0});
     }
     m_subaddress_labels.resize(index.major + 1, {"Untitled account"});
     m_subaddress_labels[index.major].resize(index.minor + 1);
     get_account_tags();
   }
+  else if (m_subaddress_labels[index.major].size() <= index.minor && !in_account_range(index.major))
+  {
+    m_subaddress_labels[index.major].resize(index.minor + 1);
+  }
   else if (m_subaddress_labels[index.major].size() <= index.minor)
   {
     // add new subaddresses
     const uint32_t end = get_subaddress_clamped_sum(index.minor, m_subaddress_lookahead_minor);
     const uint32_t begin = m_subaddress_labels[index.major].size();
     cryptonote::subaddress_index index2 = {index.major, begin};
-    const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, index2.minor, end);
+    const std::vector<crypto::public_key> pkeys = generate_subaddress_spend_public_keys(hwdev, m_account.get_keys(), index2.major, index2.minor, end);
     for (; index2.minor < end; ++index2.minor)
     {
        const crypto::public_key &D = pkeys[index2.minor - begin];
        m_subaddresses[D] = index2;
     }
+    m_subaddress_table.insert(pkeys, {index.major, begin});
     m_subaddress_labels[index.major].resize(index.minor + 1);
   }
 }
@@ -1342,6 +1441,40 @@ void wallet2::set_subaddress_lookahead(size_t major, size_t minor)
   m_subaddress_lookahead_minor = minor;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::set_account_range(uint32_t first, uint32_t end)
+{
+  THROW_WALLET_EXCEPTION_IF(first >= end, error::wallet_internal_error, "Account range is empty");
+  m_account_range_first = first;
+  m_account_range_end = end;
+  apply_account_range();
+}
+//----------------------------------------------------------------------------------------------------
+// drops subaddress keys of accounts outside the range, and regenerates the keys of in range
+// accounts which were left out when the wallet was last used with a narrower range
+void wallet2::apply_account_range()
+{
+  for (auto i = m_subaddresses.begin(); i != m_subaddresses.end(); )
+  {
+    if (in_account_range(i->second.major))
+      ++i;
+    else
+      i = m_subaddresses.erase(i);
+  }
+
+  hw::device &hwdev = m_account.get_device();
+  const uint32_t accounts = m_subaddress_labels.size();
+  for (uint32_t major = m_account_range_first; major < accounts && major < m_account_range_end; ++major)
+  {
+    if (m_subaddresses.find(hwdev.get_subaddress_spend_public_key(m_account.get_keys(), {major, 0})) != m_subaddresses.end())
+      continue;
+    const uint32_t end = get_subaddress_clamped_sum(m_subaddress_labels[major].size() - 1, m_subaddress_lookahead_minor);
+    const std::vector<crypto::public_key> pkeys = generate_subaddress_spend_public_keys(hwdev, m_account.get_keys(), major, 0, end);
+    for (uint32_t minor = 0; minor < end; ++minor)
+      m_subaddresses[pkeys[minor]] = {major, minor};
+  }
+  m_subaddress_table.assign(m_subaddresses);
+}
+//----------------------------------------------------------------------------------------------------
 /*!
  * \brief Tells if the wallet file is deprecated.
  */
@@ -1354,6 +1487,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
 {
   transfer_details &td = m_transfers[idx];
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
+  unspent_index_remove(idx);
   td.m_spent = true;
   td.m_spent_height = height;
 }
@@ -1364,6 +1498,118 @@ void wallet2::set_unspent(size_t idx)
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = false;
   td.m_spent_height = 0;
+  unspent_index_add(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unspent_index_add(size_t idx) const
+{
+  if (idx >= m_unspent_indexed)
+    return;
+  const transfer_details &td = m_transfers[idx];
+  if (!td.m_spent)
+    m_unspent_index[td.m_subaddr_index.major][td.m_subaddr_index.minor].insert(std::make_pair(td.amount(), idx));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unspent_index_remove(size_t idx) const
+{
+  if (idx >= m_unspent_indexed)
+    return;
+  const transfer_details &td = m_transfers[idx];
+  auto major = m_unspent_index.find(td.m_subaddr_index.major);
+  if (major == m_unspent_index.end())
+    return;
+  auto minor = major->second.find(td.m_subaddr_index.minor);
+  if (minor != major->second.end())
+    minor->second.erase(std::make_pair(td.amount(), idx));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::invalidate_unspent_index()
+{
+  m_unspent_index.clear();
+  m_unspent_indexed = 0;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_history() const
+{
+  if (m_history_indexed)
+    return;
+  m_history_indexed = true;
+  for (const auto &p: m_payments)
+    history_index_add(p);
+  for (const auto &c: m_confirmed_txs)
+    history_index_add(c);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::history_index_add(const payment_container::value_type &payment) const
+{
+  if (m_history_indexed)
+    m_payments_index[payment.second.m_subaddr_index.major].emplace(payment.second.m_block_height, &payment);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::history_index_add(const std::pair<const crypto::hash, confirmed_transfer_details> &confirmed_tx) const
+{
+  if (m_history_indexed)
+    m_confirmed_txs_index[confirmed_tx.second.m_subaddr_account].emplace(confirmed_tx.second.m_block_height, &confirmed_tx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::history_index_remove(const std::pair<const crypto::hash, confirmed_transfer_details> &confirmed_tx) const
+{
+  if (!m_history_indexed)
+    return;
+  const auto account = m_confirmed_txs_index.find(confirmed_tx.second.m_subaddr_account);
+  if (account == m_confirmed_txs_index.end())
+    return;
+  const auto range = account->second.equal_range(confirmed_tx.second.m_block_height);
+  for (auto i = range.first; i != range.second; ++i)
+  {
+    if (i->second == &confirmed_tx)
+    {
+      account->second.erase(i);
+      break;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::invalidate_history_index()
+{
+  m_payments_index.clear();
+  m_confirmed_txs_index.clear();
+  m_history_indexed = false;
+  ++m_history_generation;
+}
+//----------------------------------------------------------------------------------------------------
+const std::map<uint32_t, wallet2::unspent_outputs> &wallet2::get_unspent_outputs(uint32_t subaddr_account) const
+{
+  static const std::map<uint32_t, unspent_outputs> none;
+  if (m_unspent_indexed > m_transfers.size())
+  {
+    MERROR("Unspent output index is ahead of the transfers, rebuilding it");
+    m_unspent_index.clear();
+    m_unspent_indexed = 0;
+  }
+  while (m_unspent_indexed < m_transfers.size())
+    unspent_index_add(m_unspent_indexed++);
+  const auto i = m_unspent_index.find(subaddr_account);
+  return i == m_unspent_index.end() ? none : i->second;
+}
+//----------------------------------------------------------------------------------------------------
+// is_out_to_acc_precomp, against the flat subaddress table
+static boost::optional<cryptonote::subaddress_receive_info> is_out_to_subaddress(const tools::subaddress_table &subaddresses, const crypto::public_key &out_key, const crypto::key_derivation &derivation, const std::vector<crypto::key_derivation> &additional_derivations, size_t output_index, hw::device &hwdev)
+{
+  crypto::public_key subaddress_spendkey;
+  hwdev.derive_subaddress_public_key(out_key, derivation, output_index, subaddress_spendkey);
+  const cryptonote::subaddress_index *found = subaddresses.find(subaddress_spendkey);
+  if (found)
+    return cryptonote::subaddress_receive_info{ *found, derivation };
+  if (!additional_derivations.empty())
+  {
+    CHECK_AND_ASSERT_MES(output_index < additional_derivations.size(), boost::none, "wrong number of additional derivations");
+    hwdev.derive_subaddress_public_key(out_key, additional_derivations[output_index], output_index, subaddress_spendkey);
+    found = subaddresses.find(subaddress_spendkey);
+    if (found)
+      return cryptonote::subaddress_receive_info{ *found, additional_derivations[output_index] };
+  }
+  return boost::none;
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::check_acc_out_precomp(const tx_out &o, const crypto::key_derivation &derivation, const std::vector<crypto::key_derivation> &additional_derivations, size_t i, tx_scan_info_t &tx_scan_info) const
@@ -1377,7 +1623,7 @@ void wallet2::check_acc_out_precomp(const tx_out &o, const crypto::key_derivatio
      LOG_ERROR("wrong type id in transaction out");
      return;
   }
-  tx_scan_info.received = is_out_to_acc_precomp(m_subaddresses, boost::get<txout_to_key>(o.target).key, derivation, additional_derivations, i, hwdev);
+  tx_scan_info.received = is_out_to_subaddress(m_subaddress_table, boost::get<txout_to_key>(o.target).key, derivation, additional_derivations, i, hwdev);
   if(tx_scan_info.received)
   {
     tx_scan_info.money_transfered = o.amount; // may be 0 for ringct outputs
@@ -1900,6 +2146,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           if (!pool)
           {
             transfer_details &td = m_transfers[kit->second];
+            unspent_index_remove(kit->second);
             td.m_block_height = height;
             td.m_internal_output_index = o;
             td.m_global_output_index = o_indices[o];
@@ -1924,6 +2171,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
               td.m_mask = rct::identity();
               td.m_rct = false;
             }
+            unspent_index_add(kit->second);
             if (output_tracker_cache)
               (*output_tracker_cache)[std::make_pair(tx.vout[o].amount, td.m_global_output_index)] = kit->second;
             if (m_multisig)
@@ -1973,7 +2221,9 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           //   1) the same output pub key was used as destination multiple times,
           //   2) the wallet set the highest amount among them to transfer_details::m_amount, and
           //   3) the wallet somehow spent that output with an amount smaller than the above amount, causing inconsistency
+          unspent_index_remove(it->second);
           td.m_amount = amount;
+          unspent_index_add(it->second);
         }
       }
       else
@@ -2130,7 +2380,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
-        m_payments.emplace(payment_id, payment);
+        history_index_add(*m_payments.emplace(payment_id, payment));
       LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
 
@@ -2156,7 +2406,12 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
   if(unconf_it != m_unconfirmed_txs.end()) {
     if (store_tx_info()) {
       try {
-        m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        const auto entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        if (entry.second)
+        {
+          history_index_add(*entry.first);
+          confirmed_tx_changed(txid);
+        }
       }
       catch (...) {
         // can fail if the tx has unexpected input types
@@ -2170,6 +2425,12 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::transaction &tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices)
 {
   std::pair<std::unordered_map<crypto::hash, confirmed_transfer_details>::iterator, bool> entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details()));
+  // its height and account may change below
+  if (!entry.second)
+  {
+    history_index_remove(*entry.first);
+    ++m_history_generation;
+  }
   // fill with the info we know, some info might already be there
   if (entry.second)
   {
@@ -2207,14 +2468,16 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
   entry.first->second.m_timestamp = ts;
   entry.first->second.m_unlock_time = tx.unlock_time;
   entry.first->second.m_unlock_times = tx.output_unlock_times;
+  history_index_add(*entry.first);
+  confirmed_tx_changed(txid);
 
   add_rings(tx);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const parsed_block &parsed_block, const crypto::hash& bl_id, uint64_t height, const std::vector<tx_cache_data> &tx_cache_data, size_t tx_cache_data_offset, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, parsed_block &parsed_block, const crypto::hash& bl_id, uint64_t height, std::vector<tx_cache_data> &tx_cache_data, size_t tx_cache_data_offset, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
-  THROW_WALLET_EXCEPTION_IF(bche.txs.size() + 1 != parsed_block.o_indices.indices.size(), error::wallet_internal_error,
-      "block transactions=" + std::to_string(bche.txs.size()) +
+  THROW_WALLET_EXCEPTION_IF(parsed_block.txes.size() + 1 != parsed_block.o_indices.indices.size(), error::wallet_internal_error,
+      "block transactions=" + std::to_string(parsed_block.txes.size()) +
       " not match with daemon response size=" + std::to_string(parsed_block.o_indices.indices.size()));
 
   //handle transactions from new block
@@ -2229,10 +2492,23 @@ void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cry
     TIME_MEASURE_FINISH(miner_tx_handle_time);
 
     TIME_MEASURE_START(txs_handle_time);
-    THROW_WALLET_EXCEPTION_IF(bche.txs.size() != b.tx_hashes.size(), error::wallet_internal_error, "Wrong amount of transactions for block");
-    THROW_WALLET_EXCEPTION_IF(bche.txs.size() != parsed_block.txes.size(), error::wallet_internal_error, "Wrong amount of transactions for block");
+    THROW_WALLET_EXCEPTION_IF(parsed_block.txes.size() != b.tx_hashes.size(), error::wallet_internal_error, "Wrong amount of transactions for block");
+    THROW_WALLET_EXCEPTION_IF(parsed_block.txes_missing.size() != (parsed_block.scan_digests.empty() ? 0 : parsed_block.txes.size()), error::wallet_internal_error, "Wrong amount of scan digests for block");
     for (size_t idx = 0; idx < b.tx_hashes.size(); ++idx)
     {
+      if (!parsed_block.txes_missing.empty() && parsed_block.txes_missing[idx])
+      {
+        // the earlier txes of this batch may have made this one ours since it was filtered out
+        if (!scan_digest_matches(b.tx_hashes[idx], parsed_block.scan_digests[idx], tx_cache_data[tx_cache_data_offset]))
+        {
+          ++tx_cache_data_offset;
+          continue;
+        }
+        std::vector<cryptonote::transaction> txes;
+        pull_filtered_txes({b.tx_hashes[idx]}, txes);
+        parsed_block.txes[idx] = std::move(txes.front());
+        parsed_block.txes_missing[idx] = false;
+      }
       process_new_transaction(b.tx_hashes[idx], parsed_block.txes[idx], parsed_block.o_indices.indices[idx+1].indices, height, b.timestamp, false, false, false, tx_cache_data[tx_cache_data_offset++], output_tracker_cache);
     }
     TIME_MEASURE_FINISH(txs_handle_time);
@@ -2282,6 +2558,9 @@ void wallet2::get_short_chain_history(std::list<crypto::hash>& ids, uint64_t gra
   }
   if(!base_included)
     ids.push_back(m_blockchain[m_blockchain.offset()]);
+  const std::map<size_t, crypto::hash> &sparse = m_blockchain.sparse();
+  for (auto it = sparse.rbegin(); it != sparse.rend(); ++it)
+    ids.push_back(it->second);
   if(m_blockchain.offset())
     ids.push_back(m_blockchain.genesis());
 }
@@ -2293,7 +2572,7 @@ void wallet2::parse_block_round(const cryptonote::blobdata &blob, cryptonote::bl
     bl_id = get_block_hash(bl);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices)
+void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest> &scan_digests, uint64_t &current_height)
 {
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
@@ -2302,6 +2581,7 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   req.prune = true;
   req.start_height = start_height;
   req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
+  req.scan_digest = use_scan_digests();
   m_daemon_rpc_mutex.lock();
   bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, m_http_client, rpc_timeout);
   m_daemon_rpc_mutex.unlock();
@@ -2312,9 +2592,51 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
       "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + ") and output_indices (" +
       boost::lexical_cast<std::string>(res.output_indices.size()) + ") sizes from daemon");
 
+  // daemons that don't know about scan digests send the txes instead
+  THROW_WALLET_EXCEPTION_IF(!res.scan_digests.empty() && res.scan_digests.size() != res.blocks.size(), error::wallet_internal_error,
+      "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + ") and scan_digests (" +
+      boost::lexical_cast<std::string>(res.scan_digests.size()) + ") sizes from daemon");
+
   blocks_start_height = res.start_height;
+  current_height = res.current_height;
   blocks = std::move(res.blocks);
   o_indices = std::move(res.output_indices);
+  scan_digests = std::move(res.scan_digests);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::use_scan_digests() const
+{
+  // only the txes that turn out to be ours are downloaded afterwards, which tells the
+  // daemon which txes those are, so this is limited to trusted daemons; tracking
+  // output uses needs every input's ring, and hardware devices scan in-line
+  return m_trusted_daemon && !m_track_uses && m_account.get_device().get_type() == hw::device::SOFTWARE;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_filtered_txes(const std::vector<crypto::hash> &txids, std::vector<cryptonote::transaction> &txes)
+{
+  cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request req = AUTO_VAL_INIT(req);
+  cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response res = AUTO_VAL_INIT(res);
+  for (const auto &txid: txids)
+    req.txs_hashes.push_back(epee::string_tools::pod_to_hex(txid));
+  req.decode_as_json = false;
+  req.prune = true;
+  m_daemon_rpc_mutex.lock();
+  bool r = epee::net_utils::invoke_http_json("/gettransactions", req, res, m_http_client, rpc_timeout);
+  m_daemon_rpc_mutex.unlock();
+  THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "gettransactions");
+  THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "gettransactions");
+  THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::wallet_internal_error, "gettransactions");
+  THROW_WALLET_EXCEPTION_IF(res.txs.size() != txids.size(), error::wallet_internal_error,
+    "daemon returned wrong response for gettransactions, wrong txs count = " +
+    std::to_string(res.txs.size()) + ", expected " + std::to_string(txids.size()));
+
+  txes.resize(txids.size());
+  for (size_t n = 0; n < txids.size(); ++n)
+  {
+    crypto::hash tx_hash;
+    THROW_WALLET_EXCEPTION_IF(!get_pruned_tx(res.txs[n], txes[n], tx_hash), error::wallet_internal_error, "Failed to parse transaction from daemon");
+    THROW_WALLET_EXCEPTION_IF(tx_hash != txids[n], error::wallet_internal_error, "Daemon sent " + string_tools::pod_to_hex(tx_hash) + " instead of " + string_tools::pod_to_hex(txids[n]));
+  }
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes)
@@ -2335,138 +2657,402 @@ void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height,
   hashes = std::move(res.m_block_ids);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+// same layout as cache_tx_data gives for the whole tx, minus the extra fields,
+// which process_new_transaction parses if the tx gets downloaded
+static void cache_tx_scan_digest(const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest, wallet2::tx_cache_data &tx_cache_data)
+{
+  if (!digest.standard || digest.output_keys.empty())
+    return;
+  const std::vector<boost::optional<cryptonote::subaddress_receive_info>> rec(digest.output_keys.size(), boost::none);
+  for (const auto &pkey: digest.pub_keys)
+    tx_cache_data.primary.push_back({pkey, {}, rec});
+  for (const auto &pkey: digest.additional_pub_keys)
+    tx_cache_data.additional.push_back({pkey, {}, {}});
+}
+//----------------------------------------------------------------------------------------------------
+// the first n_vouts output keys of the tx, null_pkey for outputs not to a key
+static std::vector<crypto::public_key> get_output_keys(const cryptonote::transaction &tx, size_t n_vouts)
+{
+  std::vector<crypto::public_key> output_keys(std::min(n_vouts, tx.vout.size()), crypto::null_pkey);
+  for (size_t k = 0; k < output_keys.size(); ++k)
+    if (tx.vout[k].target.type() == typeid(cryptonote::txout_to_key))
+      output_keys[k] = boost::get<cryptonote::txout_to_key>(tx.vout[k].target).key;
+  return output_keys;
+}
+// same, for a block's tx which may only have its scan digest
+static std::vector<crypto::public_key> get_output_keys(const wallet2::parsed_block &parsed_block, size_t idx)
+{
+  if (!parsed_block.txes_missing.empty() && parsed_block.txes_missing[idx])
+    return parsed_block.scan_digests[idx].output_keys;
+  return get_output_keys(parsed_block.txes[idx], parsed_block.txes[idx].vout.size());
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::cache_tx_data(const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data) const
 {
-  size_t current_index = start_height;
-  blocks_added = 0;
-
-  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
-
   tools::threadpool& tpool = tools::threadpool::getInstance();
   tools::threadpool::waiter waiter;
 
   size_t num_txes = 0;
-  std::vector<tx_cache_data> tx_cache_data;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
     num_txes += 1 + parsed_blocks[i].txes.size();
+  tx_cache_data.clear();
   tx_cache_data.resize(num_txes);
   size_t txidx = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
   {
     THROW_WALLET_EXCEPTION_IF(parsed_blocks[i].txes.size() != parsed_blocks[i].block.tx_hashes.size(),
         error::wallet_internal_error, "Mismatched parsed_blocks[i].txes.size() and parsed_blocks[i].block.tx_hashes.size()");
     if (m_refresh_type != RefreshNoCoinbase)
-      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); });
+      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); }, true);
     ++txidx;
     for (size_t idx = 0; idx < parsed_blocks[i].txes.size(); ++idx)
     {
-      tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); });
+      if (!parsed_blocks[i].txes_missing.empty() && parsed_blocks[i].txes_missing[idx])
+        cache_tx_scan_digest(parsed_blocks[i].scan_digests[idx], tx_cache_data[txidx]);
+      else
+        tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); }, true);
       ++txidx;
     }
   }
   THROW_WALLET_EXCEPTION_IF(txidx != num_txes, error::wallet_internal_error, "txidx does not match tx_cache_data size");
   waiter.wait(&tpool);
-
-  hw::device &hwdev =  m_account.get_device();
-  hw::reset_mode rst(hwdev);
-  hwdev.set_mode(hw::device::TRANSACTION_PARSE);
-  const cryptonote::account_keys &keys = m_account.get_keys();
-
-  auto gender = [&](wallet2::is_out_data &iod) {
-    if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
+}
+//----------------------------------------------------------------------------------------------------
+// derives, in one batch, the spend key every output of the tx would have if it were sent to one of
+// our subaddresses; matching them against m_subaddresses is left to match_subaddress_spend_keys
+static void derive_subaddress_spend_keys(const std::vector<crypto::public_key> &output_keys, wallet2::tx_cache_data &slot)
+{
+  const size_t n_vouts = output_keys.size();
+  std::vector<crypto::public_key> out_keys;
+  std::vector<crypto::key_derivation> derivations;
+  std::vector<size_t> output_indices;
+  std::vector<boost::optional<crypto::public_key>*> targets;
+  for (auto &iod: slot.primary)
+    iod.spend_keys.assign(n_vouts, boost::none);
+  for (auto &iod: slot.additional)
+    iod.spend_keys.assign(1, boost::none);
+  for (size_t k = 0; k < n_vouts; ++k)
+  {
+    const auto &key = output_keys[k];
+    if (key == crypto::null_pkey)
+      continue;
+    for (size_t l = 0; l < slot.primary.size(); ++l)
     {
-      MWARNING("Failed to generate key derivation from tx pubkey, skipping");
-      static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
-      memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
+      THROW_WALLET_EXCEPTION_IF(slot.primary[l].received.size() != n_vouts,
+          error::wallet_internal_error, "Unexpected received array size");
+      out_keys.push_back(key);
+      derivations.push_back(slot.primary[l].derivation);
+      output_indices.push_back(k);
+      targets.push_back(&slot.primary[l].spend_keys[k]);
+      if (l == 0 && k < slot.additional.size())
+      {
+        out_keys.push_back(key);
+        derivations.push_back(slot.additional[k].derivation);
+        output_indices.push_back(k);
+        targets.push_back(&slot.additional[k].spend_keys[0]);
+      }
     }
-  };
-
-  for (size_t i = 0; i < tx_cache_data.size(); ++i)
-  {
-    tpool.submit(&waiter, [&hwdev, &gender, &tx_cache_data, i]() {
-      auto &slot = tx_cache_data[i];
-      boost::unique_lock<hw::device> hwdev_lock(hwdev);
-      for (auto &iod: slot.primary)
-        gender(iod);
-      for (auto &iod: slot.additional)
-        gender(iod);
-    }, true);
   }
-  waiter.wait(&tpool);
+  if (out_keys.empty())
+    return;
 
-  auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
-    for (size_t k = 0; k < n_vouts; ++k)
+  std::vector<crypto::public_key> spend_keys(out_keys.size());
+  std::unique_ptr<bool[]> ok(new bool[out_keys.size()]);
+  crypto::derive_subaddress_public_keys(out_keys.data(), derivations.data(), output_indices.data(), out_keys.size(), spend_keys.data(), ok.get());
+  for (size_t n = 0; n < out_keys.size(); ++n)
+    if (ok[n])
+      *targets[n] = spend_keys[n];
+}
+//----------------------------------------------------------------------------------------------------
+static void match_subaddress_spend_keys(const tools::subaddress_table &subaddresses, const std::vector<crypto::public_key> &output_keys, wallet2::tx_cache_data &slot)
+{
+  auto lookup = [&](const wallet2::is_out_data &iod, size_t n) -> boost::optional<cryptonote::subaddress_receive_info> {
+    if (n >= iod.spend_keys.size() || !iod.spend_keys[n])
+      return boost::none;
+    const cryptonote::subaddress_index *found = subaddresses.find(*iod.spend_keys[n]);
+    if (!found)
+      return boost::none;
+    return cryptonote::subaddress_receive_info{ *found, iod.derivation };
+  };
+  for (size_t k = 0; k < output_keys.size(); ++k)
+  {
+    if (output_keys[k] == crypto::null_pkey)
+      continue;
+    for (size_t l = 0; l < slot.primary.size(); ++l)
     {
-      const auto &o = tx.vout[k];
-      if (o.target.type() == typeid(cryptonote::txout_to_key))
+      auto &received = slot.primary[l].received[k];
+      received = lookup(slot.primary[l], k);
+      if (l == 0 && !slot.additional.empty() && !received)
       {
-        std::vector<crypto::key_derivation> additional_derivations;
-        for (const auto &iod: tx_cache_data[txidx].additional)
-          additional_derivations.push_back(iod.derivation);
-        const auto &key = boost::get<txout_to_key>(o.target).key;
-        for (size_t l = 0; l < tx_cache_data[txidx].primary.size(); ++l)
+        if (k < slot.additional.size())
+          received = lookup(slot.additional[k], 0);
+        else
+          MERROR("wrong number of additional derivations");
+      }
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+// whether a tx that was only seen through its scan digest has to be downloaded:
+// it pays us (tx_cache_data gets the matches), spends one of our outputs, or is one we sent
+bool wallet2::scan_digest_matches(const crypto::hash &txid, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest, tx_cache_data &tx_cache_data) const
+{
+  if (!digest.standard)
+    return false;
+  if (m_unconfirmed_txs.find(txid) != m_unconfirmed_txs.end())
+    return true;
+  for (const crypto::key_image &ki: digest.key_images)
+    if (m_key_images.find(ki) != m_key_images.end())
+      return true;
+  match_subaddress_spend_keys(m_subaddress_table, digest.output_keys, tx_cache_data);
+  for (const auto &iod: tx_cache_data.primary)
+    for (const auto &received: iod.received)
+      if (received)
+        return true;
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::scan_parsed_blocks(const std::vector<parsed_block> &parsed_blocks, const crypto::secret_key &view_secret_key, std::vector<tx_cache_data> &tx_cache_data) const
+{
+  // Software device only: this does not touch the wallet state beyond the refresh settings, so it
+  // may run on the refresh pipeline's scan thread while the previous blocks are being applied
+  cache_tx_data(parsed_blocks, tx_cache_data);
+  derive_tx_cache_data(parsed_blocks, view_secret_key, tx_cache_data);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::derive_tx_cache_data(const std::vector<parsed_block> &parsed_blocks, const crypto::secret_key &view_secret_key, std::vector<tx_cache_data> &tx_cache_data) const
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+
+  // derivations are computed in batches across txes so that the final point
+  // compressions share one field inversion per batch
+  std::vector<wallet2::is_out_data*> iods;
+  for (auto &slot: tx_cache_data)
+  {
+    for (auto &iod: slot.primary)
+      iods.push_back(&iod);
+    for (auto &iod: slot.additional)
+      iods.push_back(&iod);
+  }
+  static const size_t derivation_batch_size = 256;
+  for (size_t start = 0; start < iods.size(); start += derivation_batch_size)
+  {
+    const size_t count = std::min(derivation_batch_size, iods.size() - start);
+    tpool.submit(&waiter, [&view_secret_key, &iods, start, count]() {
+      std::vector<crypto::public_key> pkeys(count);
+      std::vector<crypto::key_derivation> derivations(count);
+      std::unique_ptr<bool[]> ok(new bool[count]);
+      for (size_t n = 0; n < count; ++n)
+        pkeys[n] = iods[start + n]->pkey;
+      crypto::generate_key_derivations(pkeys.data(), count, view_secret_key, derivations.data(), ok.get());
+      for (size_t n = 0; n < count; ++n)
+      {
+        if (ok[n])
+          iods[start + n]->derivation = derivations[n];
+        else
         {
-          THROW_WALLET_EXCEPTION_IF(tx_cache_data[txidx].primary[l].received.size() != n_vouts,
-              error::wallet_internal_error, "Unexpected received array size");
-          tx_cache_data[txidx].primary[l].received[k] = is_out_to_acc_precomp(m_subaddresses, key, tx_cache_data[txidx].primary[l].derivation, additional_derivations, k, hwdev);
-          additional_derivations.clear();
+          MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+          memcpy(&iods[start + n]->derivation, rct::identity().bytes, sizeof(iods[start + n]->derivation));
         }
       }
-    }
-  };
+    }, true);
+  }
+  waiter.wait(&tpool);
 
-  txidx = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  size_t txidx = 0;
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
   {
     if (m_refresh_type != RefreshType::RefreshNoCoinbase)
     {
-      THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
       const size_t n_vouts = m_refresh_type == RefreshType::RefreshOptimizeCoinbase ? 1 : parsed_blocks[i].block.miner_tx.vout.size();
-      tpool.submit(&waiter, [&, i, n_vouts, txidx](){ geniod(parsed_blocks[i].block.miner_tx, n_vouts, txidx); }, true);
+      tpool.submit(&waiter, [&, i, n_vouts, txidx](){ derive_subaddress_spend_keys(get_output_keys(parsed_blocks[i].block.miner_tx, n_vouts), tx_cache_data[txidx]); }, true);
     }
     ++txidx;
     for (size_t j = 0; j < parsed_blocks[i].txes.size(); ++j)
     {
-      THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
-      tpool.submit(&waiter, [&, i, j, txidx](){ geniod(parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx); }, true);
+      tpool.submit(&waiter, [&, i, j, txidx](){ derive_subaddress_spend_keys(get_output_keys(parsed_blocks[i], j), tx_cache_data[txidx]); }, true);
       ++txidx;
     }
   }
   THROW_WALLET_EXCEPTION_IF(txidx != tx_cache_data.size(), error::wallet_internal_error, "txidx did not reach expected value");
   waiter.wait(&tpool);
-  hwdev.set_mode(hw::device::NONE);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache, std::vector<tx_cache_data> *scanned_tx_cache_data)
+{
+  ALLOC_SCOPE(wallet_scan);
+  size_t current_index = start_height;
+  blocks_added = 0;
 
-  size_t tx_cache_data_offset = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
+  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
+
+  hw::device &hwdev =  m_account.get_device();
+  const cryptonote::account_keys &keys = m_account.get_keys();
+  const bool batch_crypto = hwdev.get_type() == hw::device::SOFTWARE;
+  THROW_WALLET_EXCEPTION_IF(scanned_tx_cache_data && !batch_crypto, error::wallet_internal_error, "Blocks were scanned ahead for a hardware device");
+
+  std::vector<tx_cache_data> local_tx_cache_data;
+  std::vector<tx_cache_data> &tx_cache_data = scanned_tx_cache_data ? *scanned_tx_cache_data : local_tx_cache_data;
+  if (batch_crypto)
   {
-    const crypto::hash &bl_id = parsed_blocks[i].hash;
-    const cryptonote::block &bl = parsed_blocks[i].block;
+    if (!scanned_tx_cache_data)
+      scan_parsed_blocks(parsed_blocks, keys.m_view_secret_key, tx_cache_data);
+  }
+  else
+  {
+    cache_tx_data(parsed_blocks, tx_cache_data);
 
-    if(current_index >= m_blockchain.size())
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+
+    hw::reset_mode rst(hwdev);
+    hwdev.set_mode(hw::device::TRANSACTION_PARSE);
+
+    auto gender = [&](wallet2::is_out_data &iod) {
+      if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
+      {
+        MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+        static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
+        memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
+      }
+    };
+
+    for (size_t i = 0; i < tx_cache_data.size(); ++i)
     {
-      process_new_blockchain_entry(bl, blocks[i], parsed_blocks[i], bl_id, current_index, tx_cache_data, tx_cache_data_offset, output_tracker_cache);
-      ++blocks_added;
+      tpool.submit(&waiter, [&hwdev, &gender, &tx_cache_data, i]() {
+        auto &slot = tx_cache_data[i];
+        boost::unique_lock<hw::device> hwdev_lock(hwdev);
+        for (auto &iod: slot.primary)
+          gender(iod);
+        for (auto &iod: slot.additional)
+          gender(iod);
+      }, true);
     }
-    else if(bl_id != m_blockchain[current_index])
-    {
-      //split detected here !!!
-      THROW_WALLET_EXCEPTION_IF(current_index == start_height, error::wallet_internal_error,
-        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(bl_id) +
-        " (height " + std::to_string(start_height) + "), local block id at this height: " +
-        string_tools::pod_to_hex(m_blockchain[current_index]));
+    waiter.wait(&tpool);
 
-      detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, blocks[i], parsed_blocks[i], bl_id, current_index, tx_cache_data, tx_cache_data_offset, output_tracker_cache);
-    }
-    else
+    auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
+      for (size_t k = 0; k < n_vouts; ++k)
+      {
+        const auto &o = tx.vout[k];
+        if (o.target.type() == typeid(cryptonote::txout_to_key))
+        {
+          std::vector<crypto::key_derivation> additional_derivations;
+          for (const auto &iod: tx_cache_data[txidx].additional)
+            additional_derivations.push_back(iod.derivation);
+          const auto &key = boost::get<txout_to_key>(o.target).key;
+          for (size_t l = 0; l < tx_cache_data[txidx].primary.size(); ++l)
+          {
+            THROW_WALLET_EXCEPTION_IF(tx_cache_data[txidx].primary[l].received.size() != n_vouts,
+                error::wallet_internal_error, "Unexpected received array size");
+            tx_cache_data[txidx].primary[l].received[k] = is_out_to_subaddress(m_subaddress_table, key, tx_cache_data[txidx].primary[l].derivation, additional_derivations, k, hwdev);
+            additional_derivations.clear();
+          }
+        }
+      }
+    };
+
+    size_t txidx = 0;
+    for (size_t i = 0; i < blocks.size(); ++i)
     {
-      LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(bl_id));
+      if (m_refresh_type != RefreshType::RefreshNoCoinbase)
+      {
+        THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
+        const size_t n_vouts = m_refresh_type == RefreshType::RefreshOptimizeCoinbase ? 1 : parsed_blocks[i].block.miner_tx.vout.size();
+        tpool.submit(&waiter, [&, i, n_vouts, txidx](){ geniod(parsed_blocks[i].block.miner_tx, n_vouts, txidx); }, true);
+      }
+      ++txidx;
+      for (size_t j = 0; j < parsed_blocks[i].txes.size(); ++j)
+      {
+        THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
+        tpool.submit(&waiter, [&, i, j, txidx](){ geniod(parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx); }, true);
+        ++txidx;
+      }
     }
-    ++current_index;
-    tx_cache_data_offset += 1 + parsed_blocks[i].txes.size();
+    THROW_WALLET_EXCEPTION_IF(txidx != tx_cache_data.size(), error::wallet_internal_error, "txidx did not reach expected value");
+    waiter.wait(&tpool);
+    hwdev.set_mode(hw::device::NONE);
   }
-}
+
+  size_t num_txes = 0;
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
+    num_txes += 1 + parsed_blocks[i].txes.size();
+  THROW_WALLET_EXCEPTION_IF(tx_cache_data.size() != num_txes, error::wallet_internal_error, "tx_cache_data does not match parsed blocks");
+
+  if (batch_crypto)
+  {
+    // the subaddress spend keys may have been derived ahead of time, but are matched
+    // against the current subaddress table, which grows as outputs are received
+    std::vector<std::pair<size_t, size_t>> needed_txes;
+    size_t txidx = 0;
+    for (size_t i = 0; i < parsed_blocks.size(); ++i)
+    {
+      if (m_refresh_type != RefreshType::RefreshNoCoinbase)
+      {
+        const size_t n_vouts = m_refresh_type == RefreshType::RefreshOptimizeCoinbase ? 1 : parsed_blocks[i].block.miner_tx.vout.size();
+        match_subaddress_spend_keys(m_subaddress_table, get_output_keys(parsed_blocks[i].block.miner_tx, n_vouts), tx_cache_data[txidx]);
+      }
+      ++txidx;
+      for (size_t j = 0; j < parsed_blocks[i].txes.size(); ++j)
+      {
+        if (parsed_blocks[i].txes_missing.empty() || !parsed_blocks[i].txes_missing[j])
+          match_subaddress_spend_keys(m_subaddress_table, get_output_keys(parsed_blocks[i], j), tx_cache_data[txidx]);
+        else if (scan_digest_matches(parsed_blocks[i].block.tx_hashes[j], parsed_blocks[i].scan_digests[j], tx_cache_data[txidx]))
+          needed_txes.push_back(std::make_pair(i, j));
+        ++txidx;
+      }
+    }
+
+    // download what we already know to be ours in one go, the txes that only become ours
+    // as this batch gets applied are picked up by process_new_blockchain_entry
+    if (!needed_txes.empty())
+    {
+      std::vector<crypto::hash> txids;
+      std::vector<cryptonote::transaction> txes;
+      for (const auto &e: needed_txes)
+        txids.push_back(parsed_blocks[e.first].block.tx_hashes[e.second]);
+      MDEBUG("Downloading " << txids.size() << " of the txes filtered by scan digest");
+      pull_filtered_txes(txids, txes);
+      for (size_t n = 0; n < needed_txes.size(); ++n)
+      {
+        parsed_block &pb = parsed_blocks[needed_txes[n].first];
+        pb.txes[needed_txes[n].second] = std::move(txes[n]);
+        pb.txes_missing[needed_txes[n].second] = false;
+      }
+    }
+  }
+
+  size_t tx_cache_data_offset = 0;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    const crypto::hash &bl_id = parsed_blocks[i].hash;
+    const cryptonote::block &bl = parsed_blocks[i].block;
+
+    if(current_index >= m_blockchain.size())
+    {
+      process_new_blockchain_entry(bl, blocks[i], parsed_blocks[i], bl_id, current_index, tx_cache_data, tx_cache_data_offset, output_tracker_cache);
+      ++blocks_added;
+    }
+    else if(bl_id != m_blockchain[current_index])
+    {
+      //split detected here !!!
+      THROW_WALLET_EXCEPTION_IF(current_index == start_height, error::wallet_internal_error,
+        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(bl_id) +
+        " (height " + std::to_string(start_height) + "), local block id at this height: " +
+        string_tools::pod_to_hex(m_blockchain[current_index]));
+
+      detach_blockchain(current_index);
+      process_new_blockchain_entry(bl, blocks[i], parsed_blocks[i], bl_id, current_index, tx_cache_data, tx_cache_data_offset, output_tracker_cache);
+    }
+    else
+    {
+      LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(bl_id));
+    }
+    ++current_index;
+    tx_cache_data_offset += 1 + parsed_blocks[i].txes.size();
+  }
+}
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh(bool trusted_daemon)
 {
@@ -2480,68 +3066,152 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   refresh(trusted_daemon, start_height, blocks_fetched, received_money);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &error)
+bool wallet2::block_cache::get(const key &k, uint64_t &blocks_start_height, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks) const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  for (const entry &e: m_entries)
+  {
+    if (e.k == k)
+    {
+      blocks_start_height = e.blocks_start_height;
+      blocks = e.blocks;
+      parsed_blocks = e.parsed_blocks;
+      return true;
+    }
+  }
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::block_cache::add(const key &k, uint64_t blocks_start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks)
+{
+  if (blocks.empty() || m_max_entries == 0)
+    return;
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  for (const entry &e: m_entries)
+    if (e.k == k)
+      return;
+  if (m_entries.size() >= m_max_entries)
+    m_entries.pop_front();
+  m_entries.push_back({k, blocks_start_height, blocks, parsed_blocks});
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::decoy_cache::set_height(uint64_t h)
+{
+  if (h == height)
+    return;
+  *this = decoy_cache();
+  height = h;
+}
+//----------------------------------------------------------------------------------------------------
+std::vector<uint64_t> wallet2::decoy_cache::missing_segregation_amounts(std::vector<uint64_t> amounts) const
+{
+  amounts.erase(std::remove_if(amounts.begin(), amounts.end(), [this](uint64_t amount) { return segregation_limit.find(amount) != segregation_limit.end(); }), amounts.end());
+  std::sort(amounts.begin(), amounts.end());
+  amounts.erase(std::unique(amounts.begin(), amounts.end()), amounts.end());
+  return amounts;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<crypto::hash> &prev_block_hashes, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &error)
 {
+  ALLOC_SCOPE(wallet_scan);
   error = false;
 
   try
   {
     drop_from_short_history(short_chain_history, 3);
 
-    THROW_WALLET_EXCEPTION_IF(prev_blocks.size() != prev_parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-
     // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
-    auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
-    for (; s != prev_parsed_blocks.end(); ++s)
+    auto s = std::next(prev_block_hashes.rbegin(), std::min((size_t)3, prev_block_hashes.size())).base();
+    for (; s != prev_block_hashes.end(); ++s)
+    {
+      short_chain_history.push_front(*s);
+    }
+
+    // another wallet sharing the cache may have pulled these already
+    block_cache::key cache_key;
+    if (m_block_cache)
     {
-      short_chain_history.push_front(s->hash);
+      cache_key = {m_daemon_address, short_chain_history, start_height, m_refresh_type == RefreshNoCoinbase, use_scan_digests()};
+      if (m_block_cache->get(cache_key, blocks_start_height, blocks, parsed_blocks))
+      {
+        MDEBUG("Got " << blocks.size() << " blocks from " << blocks_start_height << " from the shared block cache");
+        return;
+      }
     }
+    uint64_t current_height = 0;
+    const auto add_to_cache = [&](){
+      // a range reaching the top would be stale as soon as a block is added
+      if (m_block_cache && !error && blocks_start_height + blocks.size() < current_height)
+        m_block_cache->add(cache_key, blocks_start_height, blocks, parsed_blocks);
+    };
 
     // pull the new blocks
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
-    pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices);
-    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest> scan_digests;
+    pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, scan_digests, current_height);
+    parse_blocks(blocks, o_indices, scan_digests, parsed_blocks, error);
+    add_to_cache();
+  }
+  catch(...)
+  {
+    error = true;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::parse_blocks(const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest> &scan_digests, std::vector<parsed_block> &parsed_blocks, bool &error) const
+{
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
 
-    tools::threadpool& tpool = tools::threadpool::getInstance();
-    tools::threadpool::waiter waiter;
-    parsed_blocks.resize(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-      tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
-        std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
-    }
-    waiter.wait(&tpool);
-    for (size_t i = 0; i < blocks.size(); ++i)
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  parsed_blocks.resize(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
+      std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+  }
+  waiter.wait(&tpool);
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    if (parsed_blocks[i].error)
     {
-      if (parsed_blocks[i].error)
-      {
-        error = true;
-        break;
-      }
-      parsed_blocks[i].o_indices = std::move(o_indices[i]);
+      error = true;
+      break;
     }
+    parsed_blocks[i].o_indices = std::move(o_indices[i]);
+  }
 
-    boost::mutex error_lock;
-    for (size_t i = 0; i < blocks.size(); ++i)
+  if (!scan_digests.empty())
+  {
+    // the txes themselves are only downloaded if process_parsed_blocks finds they are ours
+    for (size_t i = 0; i < blocks.size() && !error; ++i)
     {
-      parsed_blocks[i].txes.resize(blocks[i].txs.size());
-      for (size_t j = 0; j < blocks[i].txs.size(); ++j)
-      {
-        tpool.submit(&waiter, [&, i, j](){
-          if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j], parsed_blocks[i].txes[j]))
-          {
-            boost::unique_lock<boost::mutex> lock(error_lock);
-            error = true;
-          }
-        }, true);
-      }
+      const size_t n_txes = parsed_blocks[i].block.tx_hashes.size();
+      THROW_WALLET_EXCEPTION_IF(scan_digests[i].txs.size() != n_txes || !blocks[i].txs.empty(),
+          error::wallet_internal_error, "Mismatched scan digests for block " + string_tools::pod_to_hex(parsed_blocks[i].hash));
+      parsed_blocks[i].txes.resize(n_txes);
+      parsed_blocks[i].scan_digests = std::move(scan_digests[i].txs);
+      parsed_blocks[i].txes_missing.assign(n_txes, true);
     }
-    waiter.wait(&tpool);
+    return;
   }
-  catch(...)
+
+  boost::mutex error_lock;
+  for (size_t i = 0; i < blocks.size(); ++i)
   {
-    error = true;
+    parsed_blocks[i].txes.resize(blocks[i].txs.size());
+    for (size_t j = 0; j < blocks[i].txs.size(); ++j)
+    {
+      tpool.submit(&waiter, [&, i, j](){
+        if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j], parsed_blocks[i].txes[j]))
+        {
+          boost::unique_lock<boost::mutex> lock(error_lock);
+          error = true;
+        }
+      }, true);
+    }
   }
+  waiter.wait(&tpool);
 }
 
 void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashes)
@@ -2584,31 +3254,36 @@ void wallet2::update_pool_state(bool refreshed)
     }
   });
 
-  // get the pool state
+  // get the pool state, the daemon only sends the hashes if the pool changed
+  // since the cookie we got them at
   cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request req;
   cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response res;
+  req.pool_cookie = m_pool_cookie;
   m_daemon_rpc_mutex.lock();
   bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, m_http_client, rpc_timeout);
   m_daemon_rpc_mutex.unlock();
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_transaction_pool_hashes.bin");
   THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_transaction_pool_hashes.bin");
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_tx_pool_error);
+  if (res.unchanged && m_pool_cookie != 0)
+  {
+    res.tx_hashes = m_pool_tx_hashes;
+  }
+  else
+  {
+    m_pool_cookie = res.pool_cookie;
+    m_pool_tx_hashes = res.tx_hashes;
+  }
   MTRACE("update_pool_state got pool");
 
+  const std::unordered_set<crypto::hash> pool_hashes(res.tx_hashes.begin(), res.tx_hashes.end());
+
   // remove any pending tx that's not in the pool
   std::unordered_map<crypto::hash, wallet2::unconfirmed_transfer_details>::iterator it = m_unconfirmed_txs.begin();
   while (it != m_unconfirmed_txs.end())
   {
     const crypto::hash &txid = it->first;
-    bool found = false;
-    for (const auto &it2: res.tx_hashes)
-    {
-      if (it2 == txid)
-      {
-        found = true;
-        break;
-      }
-    }
+    bool found = pool_hashes.find(txid) != pool_hashes.end();
     auto pit = it++;
     if (!found)
     {
@@ -2662,18 +3337,13 @@ void wallet2::update_pool_state(bool refreshed)
   MTRACE("update_pool_state done second loop");
 
   // gather txids of new pool txes to us
+  std::unordered_set<crypto::hash> unconfirmed_payment_txids;
+  for (const auto &up: m_unconfirmed_payments)
+    unconfirmed_payment_txids.insert(up.second.m_pd.m_tx_hash);
   std::vector<std::pair<crypto::hash, bool>> txids;
   for (const auto &txid: res.tx_hashes)
   {
-    bool txid_found_in_up = false;
-    for (const auto &up: m_unconfirmed_payments)
-    {
-      if (up.second.m_pd.m_tx_hash == txid)
-      {
-        txid_found_in_up = true;
-        break;
-      }
-    }
+    const bool txid_found_in_up = unconfirmed_payment_txids.find(txid) != unconfirmed_payment_txids.end();
     if (m_scanned_pool_txs[0].find(txid) != m_scanned_pool_txs[0].end() || m_scanned_pool_txs[1].find(txid) != m_scanned_pool_txs[1].end())
     {
       // if it's for us, we want to keep track of whether we saw a double spend, so don't bail out
@@ -2687,24 +3357,21 @@ void wallet2::update_pool_state(bool refreshed)
     {
       LOG_PRINT_L1("Found new pool tx: " << txid);
       bool found = false;
-      for (const auto &i: m_unconfirmed_txs)
+      const auto i = m_unconfirmed_txs.find(txid);
+      if (i != m_unconfirmed_txs.end())
       {
-        if (i.first == txid)
+        found = true;
+        // if this is a payment to yourself at a different subaddress account, don't skip it
+        // so that you can see the incoming pool tx with 'show_transfers' on that receiving subaddress account
+        const unconfirmed_transfer_details& utd = i->second;
+        for (const auto& dst : utd.m_dests)
         {
-          found = true;
-          // if this is a payment to yourself at a different subaddress account, don't skip it
-          // so that you can see the incoming pool tx with 'show_transfers' on that receiving subaddress account
-          const unconfirmed_transfer_details& utd = i.second;
-          for (const auto& dst : utd.m_dests)
+          auto subaddr_index = m_subaddresses.find(dst.addr.m_spend_public_key);
+          if (subaddr_index != m_subaddresses.end() && subaddr_index->second.major != utd.m_subaddr_account)
           {
-            auto subaddr_index = m_subaddresses.find(dst.addr.m_spend_public_key);
-            if (subaddr_index != m_subaddresses.end() && subaddr_index->second.major != utd.m_subaddr_account)
-            {
-              found = false;
-              break;
-            }
+            found = false;
+            break;
           }
-          break;
         }
       }
       if (!found)
@@ -2894,6 +3561,71 @@ std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> wallet2::create
   return cache;
 }
 //----------------------------------------------------------------------------------------------------
+namespace
+{
+  // bounded queue between two stages of the refresh pipeline
+  template<typename T>
+  class refresh_queue
+  {
+  public:
+    refresh_queue(size_t max_size): m_max_size(max_size), m_finished(false), m_closed(false) {}
+
+    // blocks while the queue is full, fails once the queue is closed
+    bool push(T &&t)
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while (!m_closed && m_queue.size() >= m_max_size)
+        m_not_full.wait(lock);
+      if (m_closed)
+        return false;
+      m_queue.push_back(std::move(t));
+      m_not_empty.notify_one();
+      return true;
+    }
+
+    // blocks while the queue is empty, fails once it is closed, or drained after finish()
+    bool pop(T &t)
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while (!m_closed && !m_finished && m_queue.empty())
+        m_not_empty.wait(lock);
+      if (m_closed || m_queue.empty())
+        return false;
+      t = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_not_full.notify_one();
+      return true;
+    }
+
+    // the producer is done
+    void finish()
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      m_finished = true;
+      m_not_empty.notify_all();
+    }
+
+    // the pipeline is being torn down, drop whatever is queued
+    void close()
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      m_closed = true;
+      m_queue.clear();
+      m_not_empty.notify_all();
+      m_not_full.notify_all();
+    }
+
+  private:
+    const size_t m_max_size;
+    std::deque<T> m_queue;
+    boost::mutex m_mutex;
+    boost::condition_variable m_not_empty;
+    boost::condition_variable m_not_full;
+    bool m_finished;
+    bool m_closed;
+  };
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blocks_fetched, bool& received_money, bool check_pool)
 {
   if(m_light_wallet) {
@@ -2934,11 +3666,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   size_t try_count = 0;
   crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
   std::list<crypto::hash> short_chain_history;
-  tools::threadpool& tpool = tools::threadpool::getInstance();
-  tools::threadpool::waiter waiter;
   uint64_t blocks_start_height;
-  std::vector<cryptonote::block_complete_entry> blocks;
-  std::vector<parsed_block> parsed_blocks;
   bool refreshed = false;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
 
@@ -2972,36 +3700,114 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
     }
   });
 
-  bool first = true;
+  // Blocks go through a three stage pipeline: the fetch thread pulls and parses batches of blocks,
+  // the scan thread derives what it can for them without touching the wallet state, and this thread
+  // applies them in order. Each getblocks.bin request builds on the hashes of the previous batch, so
+  // fetches are still issued one after the other, but up to REFRESH_PIPELINE_DEPTH batches ahead.
+  const bool scan_ahead = m_account.get_device().get_type() == hw::device::SOFTWARE;
+  const crypto::secret_key view_secret_key = m_account.get_keys().m_view_secret_key;
+  boost::thread::attributes attrs;
+  attrs.set_stack_size(THREAD_STACK_SIZE);
+
   while(m_run.load(std::memory_order_relaxed))
   {
-    uint64_t next_blocks_start_height;
-    std::vector<cryptonote::block_complete_entry> next_blocks;
-    std::vector<parsed_block> next_parsed_blocks;
-    bool error;
+    refresh_queue<refresh_batch> fetched(REFRESH_PIPELINE_DEPTH);
+    refresh_queue<refresh_batch> scanned(REFRESH_PIPELINE_DEPTH);
+    boost::thread fetch_thread, scan_thread;
+    auto stop_pipeline = [&]() {
+      fetched.close();
+      scanned.close();
+      if (fetch_thread.joinable())
+        fetch_thread.join();
+      if (scan_thread.joinable())
+        scan_thread.join();
+    };
     try
     {
-      // pull the next set of blocks while we're processing the current one
-      error = false;
-      next_blocks.clear();
-      next_parsed_blocks.clear();
-      added_blocks = 0;
-      if (!first && blocks.empty())
-      {
-        refreshed = false;
-        break;
-      }
-      tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, error);});
+      auto pipeline_stopper = epee::misc_utils::create_scope_leave_handler(stop_pipeline);
+
+      fetch_thread = boost::thread(attrs, [&]() {
+        std::vector<crypto::hash> prev_block_hashes;
+        bool first = true;
+        uint64_t prev_start_height = 0;
+        while (m_run.load(std::memory_order_relaxed))
+        {
+          refresh_batch batch;
+          batch.scanned = false;
+          pull_and_parse_next_blocks(start_height, batch.start_height, short_chain_history, prev_block_hashes, batch.blocks, batch.parsed_blocks, batch.error);
+          // stop after an error, an empty batch, or getting the same batch again, which means we're synced
+          const bool last = batch.error || batch.blocks.empty() || (!first && batch.start_height == prev_start_height);
+          first = false;
+          prev_start_height = batch.start_height;
+          prev_block_hashes.clear();
+          for (size_t i = batch.parsed_blocks.size() - std::min((size_t)3, batch.parsed_blocks.size()); i < batch.parsed_blocks.size(); ++i)
+            prev_block_hashes.push_back(batch.parsed_blocks[i].hash);
+          if (!fetched.push(std::move(batch)) || last)
+            break;
+        }
+        fetched.finish();
+      });
+
+      scan_thread = boost::thread(attrs, [&]() {
+        refresh_batch batch;
+        while (fetched.pop(batch))
+        {
+          if (scan_ahead && !batch.error)
+          {
+            try
+            {
+              scan_parsed_blocks(batch.parsed_blocks, view_secret_key, batch.txes_cache_data);
+              batch.scanned = true;
+            }
+            catch (const std::exception &e)
+            {
+              // leave it to process_parsed_blocks, which will report the error in order
+              MDEBUG("Failed to scan blocks ahead: " << e.what());
+              batch.txes_cache_data.clear();
+            }
+          }
+          if (!scanned.push(std::move(batch)))
+            break;
+        }
+        scanned.finish();
+      });
 
-      if (!first)
+      bool first = true;
+      uint64_t prev_start_height = 0;
+      refresh_batch batch;
+      while (m_run.load(std::memory_order_relaxed) && scanned.pop(batch))
       {
+        // handle error from the fetch thread
+        if (batch.error)
+          throw std::runtime_error("proxy exception in refresh thread");
+        if (!first && batch.start_height == prev_start_height)
+        {
+          m_node_rpc_proxy.set_height(m_blockchain.size());
+          refreshed = true;
+          break;
+        }
+        if (batch.blocks.empty())
+        {
+          refreshed = false;
+          break;
+        }
+        first = false;
+        prev_start_height = batch.start_height;
+
+        // if we've got at least 10 blocks to refresh, assume we're starting
+        // a long refresh, and setup a tracking output cache if we need to
+        if (m_track_uses && !output_tracker_cache && batch.blocks.size() >= 10)
+          output_tracker_cache = create_output_tracker_cache();
+
+        added_blocks = 0;
         try
         {
-          process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
+          process_parsed_blocks(batch.start_height, batch.blocks, batch.parsed_blocks, added_blocks, output_tracker_cache.get(), batch.scanned ? &batch.txes_cache_data : NULL);
         }
         catch (const tools::error::out_of_hashchain_bounds_error&)
         {
           MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
+          stop_pipeline();
           uint64_t stop_height = m_blockchain.offset();
           std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
           for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
@@ -3025,53 +3831,25 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         catch (const std::exception &e)
         {
           MERROR("Error parsing blocks: " << e.what());
-          error = true;
+          blocks_fetched += added_blocks;
+          throw std::runtime_error("proxy exception in refresh thread");
         }
         blocks_fetched += added_blocks;
+        if (0 != m_callback && added_blocks > 0)
+          m_callback->on_blocks_applied(m_blockchain.size());
       }
-      waiter.wait(&tpool);
-      if(!first && blocks_start_height == next_blocks_start_height)
-      {
-        m_node_rpc_proxy.set_height(m_blockchain.size());
-        refreshed = true;
-        break;
-      }
-
-      first = false;
-
-      // handle error from async fetching thread
-      if (error)
-      {
-        throw std::runtime_error("proxy exception in refresh thread");
-      }
-
-      // if we've got at least 10 blocks to refresh, assume we're starting
-      // a long refresh, and setup a tracking output cache if we need to
-      if (m_track_uses && !output_tracker_cache && next_blocks.size() >= 10)
-        output_tracker_cache = create_output_tracker_cache();
-
-      // switch to the new blocks from the daemon
-      blocks_start_height = next_blocks_start_height;
-      blocks = std::move(next_blocks);
-      parsed_blocks = std::move(next_parsed_blocks);
+      break;
     }
     catch (const tools::error::password_needed&)
     {
-      blocks_fetched += added_blocks;
-      waiter.wait(&tpool);
       throw;
     }
     catch (const std::exception&)
     {
-      blocks_fetched += added_blocks;
-      waiter.wait(&tpool);
       if(try_count < 3)
       {
         LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
-        first = true;
         start_height = 0;
-        blocks.clear();
-        parsed_blocks.clear();
         short_chain_history.clear();
         get_short_chain_history(short_chain_history, 1);
         ++try_count;
@@ -3145,10 +3923,25 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
     }
   }
 
+  // nothing to ask for if the chain did not move since the last call
+  uint64_t height = 0;
+  const bool have_height = !m_node_rpc_proxy.get_height(height);
+  if (have_height && !m_rct_distribution.empty() && height == m_rct_distribution_height)
+  {
+    start_height = 0;
+    distribution = m_rct_distribution;
+    return true;
+  }
+
+  // only ask for what was added since the last call, plus a few blocks in
+  // case they got reorged away
+  static const uint64_t RCT_DISTRIBUTION_REFETCH_BLOCKS = 30;
+  const uint64_t from_height = m_rct_distribution.size() > RCT_DISTRIBUTION_REFETCH_BLOCKS ? m_rct_distribution.size() - RCT_DISTRIBUTION_REFETCH_BLOCKS : 0;
+
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
   req.amounts.push_back(0);
-  req.from_height = 0;
+  req.from_height = from_height;
   req.cumulative = false;
   req.binary = true;
   req.compress = true;
@@ -3167,6 +3960,13 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
   }
   if (res.status != CORE_RPC_STATUS_OK)
   {
+    if (from_height > 0)
+    {
+      // the daemon may have fallen behind what we have cached
+      MDEBUG("Failed to request the tail of the output distribution, requesting all of it");
+      m_rct_distribution.clear();
+      return get_rct_distribution(start_height, distribution);
+    }
     MWARNING("Failed to request output distribution: " << res.status);
     return false;
   }
@@ -3180,10 +3980,36 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
     MWARNING("Failed to request output distribution: results are not for amount 0");
     return false;
   }
-  for (size_t i = 1; i < res.distributions[0].data.distribution.size(); ++i)
-    res.distributions[0].data.distribution[i] += res.distributions[0].data.distribution[i-1];
-  start_height = res.distributions[0].data.start_height;
-  distribution = std::move(res.distributions[0].data.distribution);
+  cryptonote::rpc::output_distribution_data &data = res.distributions[0].data;
+  if (from_height > 0 && (data.start_height != from_height || data.base != m_rct_distribution[from_height - 1]))
+  {
+    MDEBUG("Cached rct distribution does not match the daemon's, requesting all of it");
+    m_rct_distribution.clear();
+    return get_rct_distribution(start_height, distribution);
+  }
+  if (!data.distribution.empty())
+    data.distribution[0] += data.base;
+  for (size_t i = 1; i < data.distribution.size(); ++i)
+    data.distribution[i] += data.distribution[i-1];
+  if (from_height == 0)
+  {
+    if (data.start_height != 0)
+    {
+      // the cache is indexed by height, so don't keep a partial distribution
+      start_height = data.start_height;
+      distribution = std::move(data.distribution);
+      return true;
+    }
+    m_rct_distribution = std::move(data.distribution);
+  }
+  else
+  {
+    m_rct_distribution.resize(from_height);
+    m_rct_distribution.insert(m_rct_distribution.end(), data.distribution.begin(), data.distribution.end());
+  }
+  m_rct_distribution_height = have_height ? height : 0;
+  start_height = 0;
+  distribution = m_rct_distribution;
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -3272,6 +4098,9 @@ void wallet2::detach_blockchain(uint64_t height)
     m_pub_keys.erase(it_pk);
   }
   m_transfers.erase(it, m_transfers.end());
+  invalidate_unspent_index();
+  invalidate_history_index();
+  all_confirmed_txs_changed();
 
   size_t blocks_detached = m_blockchain.size() - height;
   m_blockchain.crop(height);
@@ -3307,6 +4136,7 @@ bool wallet2::clear()
 {
   m_blockchain.clear();
   m_transfers.clear();
+  invalidate_unspent_index();
   m_key_images.clear();
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
@@ -3314,11 +4144,14 @@ bool wallet2::clear()
   m_tx_keys.clear();
   m_additional_tx_keys.clear();
   m_confirmed_txs.clear();
+  invalidate_history_index();
+  all_confirmed_txs_changed();
   m_unconfirmed_payments.clear();
   m_scanned_pool_txs[0].clear();
   m_scanned_pool_txs[1].clear();
   m_address_book.clear();
   m_subaddresses.clear();
+  m_subaddress_table.clear();
   m_subaddress_labels.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
@@ -3480,6 +4313,12 @@ bool wallet2::store_keys(const std::string& keys_file_name, const epee::wipeable
   value2.SetUint(m_subaddress_lookahead_minor);
   json.AddMember("subaddress_lookahead_minor", value2, json.GetAllocator());
 
+  value2.SetUint(m_account_range_first);
+  json.AddMember("account_range_first", value2, json.GetAllocator());
+
+  value2.SetUint(m_account_range_end);
+  json.AddMember("account_range_end", value2, json.GetAllocator());
+
   value2.SetInt(m_original_keys_available ? 1 : 0);
   json.AddMember("original_keys_available", value2, json.GetAllocator());
 
@@ -3623,6 +4462,8 @@ bool wallet2::load_keys(const std::string& keys_file_name, const epee::wipeable_
     m_track_uses = false;
     m_subaddress_lookahead_major = SUBADDRESS_LOOKAHEAD_MAJOR;
     m_subaddress_lookahead_minor = SUBADDRESS_LOOKAHEAD_MINOR;
+    m_account_range_first = 0;
+    m_account_range_end = std::numeric_limits<uint32_t>::max();
     m_original_keys_available = false;
     m_device_name = "";
     m_device_derivation_path = "";
@@ -3779,6 +4620,10 @@ bool wallet2::load_keys(const std::string& keys_file_name, const epee::wipeable_
     m_subaddress_lookahead_major = field_subaddress_lookahead_major;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, subaddress_lookahead_minor, uint32_t, Uint, false, SUBADDRESS_LOOKAHEAD_MINOR);
     m_subaddress_lookahead_minor = field_subaddress_lookahead_minor;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, account_range_first, uint32_t, Uint, false, 0);
+    m_account_range_first = field_account_range_first;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, account_range_end, uint32_t, Uint, false, std::numeric_limits<uint32_t>::max());
+    m_account_range_end = field_account_range_end;
 
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, encrypted_secret_keys, uint32_t, Uint, false, false);
     encrypted_secret_keys = field_encrypted_secret_keys;
@@ -4606,6 +5451,7 @@ std::string wallet2::exchange_multisig_keys(const epee::wipeable_string &passwor
     }
 
     m_subaddresses.clear();
+    m_subaddress_table.clear();
     m_subaddress_labels.clear();
     add_subaddress_account(tr("Primary account"));
 
@@ -5012,6 +5858,9 @@ bool wallet2::check_connection(uint32_t *version, uint32_t timeout)
   if(!m_http_client.is_connected())
   {
     m_node_rpc_proxy.invalidate();
+    m_rct_distribution.clear();
+    m_decoy_cache = decoy_cache();
+    m_pool_cookie = 0;
     if (!m_http_client.connect(std::chrono::milliseconds(timeout)))
       return false;
   }
@@ -5048,6 +5897,8 @@ void wallet2::generate_chacha_key_from_password(const epee::wipeable_string &pas
 void wallet2::load(const std::string& wallet_, const epee::wipeable_string& password)
 {
   clear();
+  m_cache_base_id = 0;
+  m_cache_journal = cache_journal_state();
   prepare_file_names(wallet_);
 
   boost::system::error_code e;
@@ -5076,45 +5927,39 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
   }
   else
   {
-    wallet2::cache_file_data cache_file_data;
-    std::string buf;
-    bool r = epee::file_io_utils::load_file_to_string(m_wallet_file, buf, std::numeric_limits<size_t>::max());
-    THROW_WALLET_EXCEPTION_IF(!r, error::file_read_error, m_wallet_file);
-
-    // try to read it as an encrypted cache
-    try
+    // caches in the current scheme are decrypted as they are read, the older
+    // schemes and unencrypted caches are loaded whole
+    if (!load_cache_chunked())
     {
-      LOG_PRINT_L1("Trying to decrypt cache data");
+      wallet2::cache_file_data cache_file_data;
+      std::string buf;
+      bool r = epee::file_io_utils::load_file_to_string(m_wallet_file, buf, std::numeric_limits<size_t>::max());
+      THROW_WALLET_EXCEPTION_IF(!r, error::file_read_error, m_wallet_file);
 
-      r = ::serialization::parse_binary(buf, cache_file_data);
-      THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "internal error: failed to deserialize \"" + m_wallet_file + '\"');
-      std::string cache_data;
-      cache_data.resize(cache_file_data.cache_data.size());
-      crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
-
-      try {
-        std::stringstream iss;
-        iss << cache_data;
-        boost::archive::portable_binary_iarchive ar(iss);
-        ar >> *this;
-      }
-      catch(...)
+      // try to read it as an encrypted cache
+      try
       {
-        // try with previous scheme: direct from keys
-        crypto::chacha_key key;
-        generate_chacha_key_from_secret_keys(key);
-        crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cache_data[0]);
+        LOG_PRINT_L1("Trying to decrypt cache data");
+
+        r = ::serialization::parse_binary(buf, cache_file_data);
+        THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "internal error: failed to deserialize \"" + m_wallet_file + '\"');
+        std::string cache_data;
+        cache_data.resize(cache_file_data.cache_data.size());
+        crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
+
         try {
           std::stringstream iss;
           iss << cache_data;
           boost::archive::portable_binary_iarchive ar(iss);
           ar >> *this;
         }
-        catch (...)
+        catch(...)
         {
-          crypto::chacha8(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cache_data[0]);
-          try
-          {
+          // try with previous scheme: direct from keys
+          crypto::chacha_key key;
+          generate_chacha_key_from_secret_keys(key);
+          crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cache_data[0]);
+          try {
             std::stringstream iss;
             iss << cache_data;
             boost::archive::portable_binary_iarchive ar(iss);
@@ -5122,42 +5967,61 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
           }
           catch (...)
           {
-            LOG_PRINT_L0("Failed to open portable binary, trying unportable");
-            boost::filesystem::copy_file(m_wallet_file, m_wallet_file + ".unportable", boost::filesystem::copy_option::overwrite_if_exists);
-            std::stringstream iss;
-            iss.str("");
-            iss << cache_data;
-            boost::archive::binary_iarchive ar(iss);
-            ar >> *this;
+            crypto::chacha8(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cache_data[0]);
+            try
+            {
+              std::stringstream iss;
+              iss << cache_data;
+              boost::archive::portable_binary_iarchive ar(iss);
+              ar >> *this;
+            }
+            catch (...)
+            {
+              LOG_PRINT_L0("Failed to open portable binary, trying unportable");
+              boost::filesystem::copy_file(m_wallet_file, m_wallet_file + ".unportable", boost::filesystem::copy_option::overwrite_if_exists);
+              std::stringstream iss;
+              iss.str("");
+              iss << cache_data;
+              boost::archive::binary_iarchive ar(iss);
+              ar >> *this;
+            }
           }
         }
       }
-    }
-    catch (...)
-    {
-      LOG_PRINT_L1("Failed to load encrypted cache, trying unencrypted");
-      try {
-        std::stringstream iss;
-        iss << buf;
-        boost::archive::portable_binary_iarchive ar(iss);
-        ar >> *this;
-      }
       catch (...)
       {
-        LOG_PRINT_L0("Failed to open portable binary, trying unportable");
-        boost::filesystem::copy_file(m_wallet_file, m_wallet_file + ".unportable", boost::filesystem::copy_option::overwrite_if_exists);
-        std::stringstream iss;
-        iss.str("");
-        iss << buf;
-        boost::archive::binary_iarchive ar(iss);
-        ar >> *this;
+        LOG_PRINT_L1("Failed to load encrypted cache, trying unencrypted");
+        try {
+          std::stringstream iss;
+          iss << buf;
+          boost::archive::portable_binary_iarchive ar(iss);
+          ar >> *this;
+        }
+        catch (...)
+        {
+          LOG_PRINT_L0("Failed to open portable binary, trying unportable");
+          boost::filesystem::copy_file(m_wallet_file, m_wallet_file + ".unportable", boost::filesystem::copy_option::overwrite_if_exists);
+          std::stringstream iss;
+          iss.str("");
+          iss << buf;
+          boost::archive::binary_iarchive ar(iss);
+          ar >> *this;
+        }
       }
     }
     THROW_WALLET_EXCEPTION_IF(
       m_account_public_address.m_spend_public_key != m_account.get_keys().m_account_address.m_spend_public_key ||
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
       error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
+
+    load_cache_journal();
   }
+  invalidate_unspent_index();
+  invalidate_history_index();
+  if (m_account_range_first != 0 || m_account_range_end != std::numeric_limits<uint32_t>::max())
+    apply_account_range();
+  else
+    m_subaddress_table.assign(m_subaddresses);
 
   // Wallets used to wipe, but not erase, old unused multisig key info, which lead to huge memory leaks.
   // Here we erase these multisig keys if they're zero'd out to free up space.
@@ -5176,78 +6040,542 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
   generate_genesis(genesis);
   crypto::hash genesis_hash = get_block_hash(genesis);
 
-  if (m_blockchain.empty())
+  if (m_blockchain.empty())
+  {
+    m_blockchain.push_back(genesis_hash);
+    m_last_block_reward = cryptonote::get_outs_money_amount(genesis.miner_tx);
+  }
+  else
+  {
+    check_genesis(genesis_hash);
+  }
+
+  trim_hashchain();
+
+  if (get_num_subaddress_accounts() == 0)
+    add_subaddress_account(tr("Primary account"));
+
+  try
+  {
+    find_and_save_rings(false);
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to save rings, will try again next time");
+  }
+  
+  m_message_store.read_from_file(get_multisig_wallet_state(), m_mms_file);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::trim_hashchain()
+{
+  uint64_t height = m_checkpoints.get_max_height();
+
+  // reorgs cannot go below the last checkpoint, but importing multisig info
+  // detaches back to the earliest transfer, so multisig wallets keep those dense
+  if (m_multisig)
+  {
+    for (const transfer_details &td: m_transfers)
+      if (td.m_block_height < height)
+        height = td.m_block_height;
+  }
+
+  if (!m_blockchain.empty() && m_blockchain.size() == m_blockchain.offset())
+  {
+    MINFO("Fixing empty hashchain");
+    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request req = AUTO_VAL_INIT(req);
+    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response res = AUTO_VAL_INIT(res);
+    m_daemon_rpc_mutex.lock();
+    req.height = m_blockchain.size() - 1;
+    bool r = net_utils::invoke_http_json_rpc("/json_rpc", "getblockheaderbyheight", req, res, m_http_client, rpc_timeout);
+    m_daemon_rpc_mutex.unlock();
+    if (r && res.status == CORE_RPC_STATUS_OK)
+    {
+      crypto::hash hash;
+      epee::string_tools::hex_to_pod(res.block_header.hash, hash);
+      m_blockchain.refill(hash);
+    }
+    else
+    {
+      MERROR("Failed to request block header from daemon, hash chain may be unable to sync till the wallet is loaded with a usable daemon");
+    }
+  }
+  if (height > 0 && m_blockchain.size() > height)
+  {
+    --height;
+    MDEBUG("trimming to " << height << ", offset " << m_blockchain.offset());
+    m_blockchain.trim(height);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::check_genesis(const crypto::hash& genesis_hash) const {
+  std::string what("Genesis block mismatch. You probably use wallet without testnet (or stagenet) flag with blockchain from test (or stage) network or vice versa");
+
+  THROW_WALLET_EXCEPTION_IF(genesis_hash != m_blockchain.genesis(), error::wallet_internal_error, what);
+}
+//----------------------------------------------------------------------------------------------------
+std::string wallet2::path() const
+{
+  return m_wallet_file;
+}
+//----------------------------------------------------------------------------------------------------
+namespace
+{
+  // Cheap hashes of cache entries, to tell which ones changed since the last store
+  class fingerprint
+  {
+  public:
+    template<typename T> fingerprint &add(const T &t)
+    {
+      static_assert(std::is_trivially_copyable<T>::value, "fingerprint takes plain data only");
+      m_data.append(reinterpret_cast<const char*>(&t), sizeof(t));
+      return *this;
+    }
+    template<typename T> fingerprint &add_vector(const std::vector<T> &v)
+    {
+      add<uint64_t>(v.size());
+      for (const T &t: v)
+        add(t);
+      return *this;
+    }
+    crypto::hash get() const { return crypto::cn_fast_hash(m_data.data(), m_data.size()); }
+
+  private:
+    std::string m_data;
+  };
+
+  // m_tx is covered by m_txid, which is all that tells transfers apart when they are replaced
+  crypto::hash get_transfer_fingerprint(const tools::wallet2::transfer_details &td)
+  {
+    fingerprint f;
+    f.add(td.m_block_height).add(td.m_txid).add<uint64_t>(td.m_internal_output_index).add(td.m_global_output_index);
+    f.add(td.m_spent).add(td.m_spent_height).add(td.m_key_image).add(td.m_mask).add(td.m_amount).add(td.m_rct);
+    f.add(td.m_key_image_known).add(td.m_key_image_request).add<uint64_t>(td.m_pk_index).add(td.m_subaddr_index);
+    f.add(td.m_key_image_partial).add_vector(td.m_multisig_k);
+    f.add<uint64_t>(td.m_multisig_info.size());
+    for (const auto &info: td.m_multisig_info)
+      f.add(info.m_signer).add_vector(info.m_LR).add_vector(info.m_partial_key_images);
+    f.add<uint64_t>(td.m_uses.size());
+    for (const auto &use: td.m_uses)
+      f.add(use.first).add(use.second);
+    return f.get();
+  }
+
+  crypto::hash get_payment_fingerprint(const crypto::hash &payment_id, const tools::wallet2::payment_details &pd)
+  {
+    fingerprint f;
+    f.add(payment_id).add(pd.m_tx_hash).add(pd.m_amount).add(pd.m_fee).add(pd.m_block_height).add(pd.m_unlock_time);
+    f.add(pd.m_timestamp).add(pd.m_type).add(pd.m_subaddr_index);
+    return f.get();
+  }
+
+  crypto::hash get_confirmed_tx_fingerprint(const tools::wallet2::confirmed_transfer_details &ctd)
+  {
+    std::ostringstream oss;
+    {
+      boost::archive::portable_binary_oarchive ar(oss, boost::archive::no_header);
+      ar << ctd;
+    }
+    const std::string data = oss.str();
+    return crypto::cn_fast_hash(data.data(), data.size());
+  }
+
+  template<typename K, typename V, typename S>
+  void diff_map(const std::unordered_map<K, V> &current, const std::unordered_map<K, V> &stored, std::vector<K> &removed, std::vector<std::pair<K, S>> &set)
+  {
+    for (const auto &e: stored)
+      if (current.find(e.first) == current.end())
+        removed.push_back(e.first);
+    for (const auto &e: current)
+    {
+      const auto i = stored.find(e.first);
+      if (i == stored.end() || !(i->second == e.second))
+        set.emplace_back(e.first, e.second);
+    }
+  }
+
+  template<typename K, typename V, typename S>
+  void apply_map_delta(std::unordered_map<K, V> &map, const std::vector<K> &removed, const std::vector<std::pair<K, S>> &set)
+  {
+    for (const K &k: removed)
+      map.erase(k);
+    for (const auto &e: set)
+      map[e.first] = e.second;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+template <class t_archive>
+void wallet2::serialize_cache_state(t_archive &a)
+{
+  // everything serialize() writes that is not in cache_delta
+  a & m_account_public_address;
+  a & m_unconfirmed_txs;
+  a & m_tx_keys;
+  a & m_tx_notes;
+  a & m_address_book;
+  a & m_scanned_pool_txs[0];
+  a & m_scanned_pool_txs[1];
+  a & m_subaddress_labels;
+  a & m_additional_tx_keys;
+  a & m_attributes;
+  a & m_unconfirmed_payments;
+  a & m_account_tags;
+  a & m_ring_history_saved;
+  a & m_last_block_reward;
+  a & m_tx_device;
+  a & m_device_last_key_image_sync;
+  a & m_cold_key_images;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_cache_journal(uint64_t cache_size, uint64_t journal_size, uint64_t records)
+{
+  cache_journal_state &journal = m_cache_journal;
+  journal = cache_journal_state();
+  journal.file = m_wallet_file;
+  journal.records = records;
+  journal.cache_size = cache_size;
+  journal.journal_size = journal_size;
+  journal.blockchain_offset = m_blockchain.offset();
+  journal.transfers.reserve(m_transfers.size());
+  for (const transfer_details &td: m_transfers)
+    journal.transfers.push_back(get_transfer_fingerprint(td));
+  journal.key_images = m_key_images;
+  journal.pub_keys = m_pub_keys;
+  journal.subaddresses = m_subaddresses;
+  for (const auto &p: m_payments)
+    ++journal.payments[get_payment_fingerprint(p.first, p.second)];
+  for (const auto &c: m_confirmed_txs)
+    journal.confirmed_txs[c.first] = get_confirmed_tx_fingerprint(c.second);
+  journal.valid = true;
+  m_blockchain.mark_stable();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::confirmed_tx_changed(const crypto::hash &txid)
+{
+  if (m_cache_journal.valid && !m_cache_journal.all_confirmed_txs_changed)
+    m_cache_journal.confirmed_txs_changed.insert(txid);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::all_confirmed_txs_changed()
+{
+  m_cache_journal.all_confirmed_txs_changed = true;
+  m_cache_journal.confirmed_txs_changed.clear();
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::store_cache_journal()
+{
+#ifdef WIN32
+  // appending needs std::fstream, which does not work with UTF-8 filenames there, see store_to
+  return false;
+#else
+  cache_journal_state &journal = m_cache_journal;
+  if (!journal.valid || journal.file != m_wallet_file || journal.records >= CACHE_JOURNAL_MAX_RECORDS)
+    return false;
+  if (journal.blockchain_offset != m_blockchain.offset() || m_blockchain.stable_size() < m_blockchain.offset())
+    return false;
+
+  // the stored state is consumed below, if anything fails from here the cache gets rewritten
+  journal.valid = false;
+
+  cache_delta delta = boost::value_initialized<cache_delta>();
+  delta.base_id = m_cache_base_id;
+  delta.sequence = journal.records;
+
+  delta.blockchain_keep = m_blockchain.stable_size();
+  for (size_t i = delta.blockchain_keep; i < m_blockchain.size(); ++i)
+    delta.blockchain_new.push_back(m_blockchain[i]);
+
+  std::vector<crypto::hash> transfers;
+  transfers.reserve(m_transfers.size());
+  delta.transfers_keep = std::min(journal.transfers.size(), m_transfers.size());
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    transfers.push_back(get_transfer_fingerprint(m_transfers[i]));
+    if (i >= delta.transfers_keep)
+      delta.transfers_new.push_back(m_transfers[i]);
+    else if (transfers[i] != journal.transfers[i])
+      delta.transfers_updated.emplace_back(i, m_transfers[i]);
+  }
+
+  diff_map(m_key_images, journal.key_images, delta.key_images_removed, delta.key_images_set);
+  diff_map(m_pub_keys, journal.pub_keys, delta.pub_keys_removed, delta.pub_keys_set);
+  diff_map(m_subaddresses, journal.subaddresses, delta.subaddresses_removed, delta.subaddresses_set);
+
+  // payments are a multimap, with entries told apart by their fingerprint only
+  std::unordered_map<crypto::hash, size_t> payments;
+  for (const auto &p: m_payments)
+  {
+    const crypto::hash fp = get_payment_fingerprint(p.first, p.second);
+    ++payments[fp];
+    auto i = journal.payments.find(fp);
+    if (i != journal.payments.end() && i->second > 0)
+      --i->second;
+    else
+      delta.payments_added.push_back(p);
+  }
+  for (const auto &p: journal.payments)
+    for (size_t n = 0; n < p.second; ++n)
+      delta.payments_removed.push_back(p.first);
+
+  // outgoing txes are many and rarely change, only those we were told about are looked at again
+  std::unordered_map<crypto::hash, crypto::hash> confirmed_txs;
+  if (journal.all_confirmed_txs_changed)
+  {
+    for (const auto &c: m_confirmed_txs)
+    {
+      const crypto::hash fp = get_confirmed_tx_fingerprint(c.second);
+      confirmed_txs[c.first] = fp;
+      const auto i = journal.confirmed_txs.find(c.first);
+      if (i == journal.confirmed_txs.end() || i->second != fp)
+        delta.confirmed_txs_set.push_back(c);
+    }
+    for (const auto &c: journal.confirmed_txs)
+      if (confirmed_txs.find(c.first) == confirmed_txs.end())
+        delta.confirmed_txs_removed.push_back(c.first);
+  }
+  else
+  {
+    confirmed_txs = std::move(journal.confirmed_txs);
+    for (const crypto::hash &txid: journal.confirmed_txs_changed)
+    {
+      const auto c = m_confirmed_txs.find(txid);
+      const auto i = confirmed_txs.find(txid);
+      if (c == m_confirmed_txs.end())
+      {
+        if (i != confirmed_txs.end())
+        {
+          delta.confirmed_txs_removed.push_back(txid);
+          confirmed_txs.erase(i);
+        }
+        continue;
+      }
+      const crypto::hash fp = get_confirmed_tx_fingerprint(c->second);
+      if (i != confirmed_txs.end() && i->second == fp)
+        continue;
+      confirmed_txs[txid] = fp;
+      delta.confirmed_txs_set.push_back(*c);
+    }
+  }
+
+  std::stringstream oss;
+  {
+    boost::archive::portable_binary_oarchive ar(oss);
+    ar << delta;
+    serialize_cache_state(ar);
+  }
+
+  wallet2::cache_file_data cache_file_data = boost::value_initialized<wallet2::cache_file_data>();
+  cache_file_data.cache_data = oss.str();
+  std::string cipher;
+  cipher.resize(cache_file_data.cache_data.size());
+  cache_file_data.iv = crypto::rand<crypto::chacha_iv>();
+  crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cipher[0]);
+  cache_file_data.cache_data = cipher;
+
+  std::ostringstream record;
+  binary_archive<true> oar(record);
+  if (!::serialization::serialize(oar, cache_file_data))
+    return false;
+  const std::string data = record.str();
+
+  // once the journal would take longer to replay than the cache takes to read, compact
+  if (journal.journal_size + data.size() > journal.cache_size / 2)
+    return false;
+
+  // write over whatever a store that failed half way may have left after the last good record
+  const std::string journal_file = m_wallet_file + CACHE_JOURNAL_SUFFIX;
+  std::fstream ostr;
+  if (journal.journal_size == 0)
+    ostr.open(journal_file, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+  else
   {
-    m_blockchain.push_back(genesis_hash);
-    m_last_block_reward = cryptonote::get_outs_money_amount(genesis.miner_tx);
+    ostr.open(journal_file, std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+    ostr.seekp(journal.journal_size);
   }
-  else
+  ostr.write(data.data(), data.size());
+  ostr.close();
+  if (!ostr.good())
   {
-    check_genesis(genesis_hash);
+    MWARNING("Failed to append to " << journal_file << ", rewriting the cache instead");
+    return false;
   }
+  boost::system::error_code e;
+  if (boost::filesystem::file_size(journal_file, e) > journal.journal_size + data.size())
+    boost::filesystem::resize_file(journal_file, journal.journal_size + data.size(), e);
+
+  cache_journal_state next;
+  next.valid = true;
+  next.file = m_wallet_file;
+  next.records = journal.records + 1;
+  next.cache_size = journal.cache_size;
+  next.journal_size = journal.journal_size + data.size();
+  next.blockchain_offset = m_blockchain.offset();
+  next.transfers = std::move(transfers);
+  next.key_images = m_key_images;
+  next.pub_keys = m_pub_keys;
+  next.subaddresses = m_subaddresses;
+  next.payments = std::move(payments);
+  next.confirmed_txs = std::move(confirmed_txs);
+  journal = std::move(next);
+  m_blockchain.mark_stable();
+
+  MDEBUG("Appended " << data.size() << " bytes to " << journal_file << ": " << delta.blockchain_new.size() << " blocks, "
+      << delta.transfers_new.size() << " new and " << delta.transfers_updated.size() << " updated transfers");
+  return true;
+#endif
+}
+//----------------------------------------------------------------------------------------------------
+// Loads a cache encrypted with m_cache_key without ever holding the whole of it: the
+// cache_file_data header is parsed off the front of the file and the rest is decrypted
+// a chunk at a time as the archive reads it, so the peak memory stays close to the
+// size of what is deserialized. False if the file is not such a cache.
+bool wallet2::load_cache_chunked()
+{
+  boost::system::error_code e;
+  const uint64_t file_size = boost::filesystem::file_size(m_wallet_file, e);
+  if (e)
+    return false;
 
-  trim_hashchain();
-
-  if (get_num_subaddress_accounts() == 0)
-    add_subaddress_account(tr("Primary account"));
+  std::ifstream in(m_wallet_file, std::ios_base::binary);
+  char header[sizeof(crypto::chacha_iv) + (std::numeric_limits<uint64_t>::digits + 6) / 7];
+  if (!in || !in.read(header, sizeof(header)))
+    return false;
+  crypto::chacha_iv iv;
+  memcpy(&iv, header, sizeof(iv));
+  uint64_t length = 0;
+  const char *varint = header + sizeof(iv);
+  const int varint_size = tools::read_varint(varint, header + sizeof(header), length);
+  if (varint_size <= 0 || length != file_size - sizeof(iv) - varint_size)
+    return false;
+  if (!in.seekg(sizeof(iv) + varint_size))
+    return false;
 
+  LOG_PRINT_L1("Decrypting cache data as it is loaded");
   try
   {
-    find_and_save_rings(false);
+    chacha20_istreambuf plain(in, length, m_cache_key, iv);
+    std::istream iss(&plain);
+    boost::archive::portable_binary_iarchive ar(iss);
+    ar >> *this;
   }
-  catch (const std::exception &e)
+  catch (...)
   {
-    MERROR("Failed to save rings, will try again next time");
+    LOG_PRINT_L1("Failed to load the cache in chunks");
+    return false;
   }
-  
-  m_message_store.read_from_file(get_multisig_wallet_state(), m_mms_file);
+  return true;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::trim_hashchain()
+void wallet2::load_cache_journal()
 {
-  uint64_t height = m_checkpoints.get_max_height();
+  m_cache_journal = cache_journal_state();
 
-  for (const transfer_details &td: m_transfers)
-    if (td.m_block_height < height)
-      height = td.m_block_height;
+  // caches written before the journal existed have no id, the next store rewrites them
+  if (m_cache_base_id == 0)
+    return;
 
-  if (!m_blockchain.empty() && m_blockchain.size() == m_blockchain.offset())
+  boost::system::error_code e;
+  const uint64_t cache_size = boost::filesystem::file_size(m_wallet_file, e);
+  if (e)
+    return;
+
+  const std::string journal_file = m_wallet_file + CACHE_JOURNAL_SUFFIX;
+  std::string buf;
+  if (boost::filesystem::exists(journal_file, e) && !e)
   {
-    MINFO("Fixing empty hashchain");
-    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request req = AUTO_VAL_INIT(req);
-    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response res = AUTO_VAL_INIT(res);
-    m_daemon_rpc_mutex.lock();
-    req.height = m_blockchain.size() - 1;
-    bool r = net_utils::invoke_http_json_rpc("/json_rpc", "getblockheaderbyheight", req, res, m_http_client, rpc_timeout);
-    m_daemon_rpc_mutex.unlock();
-    if (r && res.status == CORE_RPC_STATUS_OK)
+    bool r = epee::file_io_utils::load_file_to_string(journal_file, buf, std::numeric_limits<size_t>::max());
+    THROW_WALLET_EXCEPTION_IF(!r, error::file_read_error, journal_file);
+  }
+
+  binary_archive<false> bar(epee::strspan<uint8_t>(buf));
+  uint64_t good_size = 0, records = 0;
+  while (good_size < buf.size())
+  {
+    wallet2::cache_file_data cache_file_data;
+    if (!::serialization::serialize_noeof(bar, cache_file_data) || !bar.stream().good())
     {
-      crypto::hash hash;
-      epee::string_tools::hex_to_pod(res.block_header.hash, hash);
-      m_blockchain.refill(hash);
+      MWARNING("Ignoring an incomplete record at the end of " << journal_file);
+      break;
     }
-    else
+
+    std::string cache_data;
+    cache_data.resize(cache_file_data.cache_data.size());
+    crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
+
+    try
     {
-      MERROR("Failed to request block header from daemon, hash chain may be unable to sync till the wallet is loaded with a usable daemon");
+      std::stringstream ss;
+      ss << cache_data;
+      boost::archive::portable_binary_iarchive ar(ss);
+      cache_delta delta;
+      ar >> delta;
+      if (delta.base_id != m_cache_base_id || delta.sequence != records)
+      {
+        // left behind by a store that rewrote the cache, but could not remove it
+        MWARNING("Ignoring " << journal_file << " from record " << records << ", it does not extend the cache");
+        break;
+      }
+
+      THROW_WALLET_EXCEPTION_IF(delta.blockchain_keep < m_blockchain.offset() || delta.blockchain_keep > m_blockchain.size(),
+          error::wallet_internal_error, "Invalid hashchain size in cache journal");
+      m_blockchain.crop(delta.blockchain_keep);
+      for (const crypto::hash &hash: delta.blockchain_new)
+        m_blockchain.push_back(hash);
+
+      THROW_WALLET_EXCEPTION_IF(delta.transfers_keep > m_transfers.size(), error::wallet_internal_error, "Invalid transfers size in cache journal");
+      m_transfers.erase(m_transfers.begin() + delta.transfers_keep, m_transfers.end());
+      for (auto &t: delta.transfers_updated)
+      {
+        THROW_WALLET_EXCEPTION_IF(t.first >= m_transfers.size(), error::wallet_internal_error, "Invalid transfer index in cache journal");
+        m_transfers[t.first] = std::move(t.second);
+      }
+      for (auto &t: delta.transfers_new)
+        m_transfers.push_back(std::move(t));
+
+      apply_map_delta(m_key_images, delta.key_images_removed, delta.key_images_set);
+      apply_map_delta(m_pub_keys, delta.pub_keys_removed, delta.pub_keys_set);
+      apply_map_delta(m_subaddresses, delta.subaddresses_removed, delta.subaddresses_set);
+
+      if (!delta.payments_removed.empty())
+      {
+        std::unordered_multimap<crypto::hash, payment_container::iterator> payments;
+        for (auto i = m_payments.begin(); i != m_payments.end(); ++i)
+          payments.emplace(get_payment_fingerprint(i->first, i->second), i);
+        for (const crypto::hash &fp: delta.payments_removed)
+        {
+          const auto i = payments.find(fp);
+          if (i == payments.end())
+            continue;
+          m_payments.erase(i->second);
+          payments.erase(i);
+        }
+      }
+      for (const auto &p: delta.payments_added)
+        m_payments.emplace(p);
+
+      for (const crypto::hash &txid: delta.confirmed_txs_removed)
+        m_confirmed_txs.erase(txid);
+      for (const auto &c: delta.confirmed_txs_set)
+        m_confirmed_txs[c.first] = c.second;
+
+      serialize_cache_state(ar);
     }
+    catch (const error::wallet_internal_error &)
+    {
+      throw;
+    }
+    catch (const std::exception &ex)
+    {
+      THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to read ") + journal_file + ": " + ex.what());
+    }
+
+    good_size = bar.stream().tellg();
+    ++records;
   }
-  if (height > 0 && m_blockchain.size() > height)
-  {
-    --height;
-    MDEBUG("trimming to " << height << ", offset " << m_blockchain.offset());
-    m_blockchain.trim(height);
-  }
-}
-//----------------------------------------------------------------------------------------------------
-void wallet2::check_genesis(const crypto::hash& genesis_hash) const {
-  std::string what("Genesis block mismatch. You probably use wallet without testnet (or stagenet) flag with blockchain from test (or stage) network or vice versa");
 
-  THROW_WALLET_EXCEPTION_IF(genesis_hash != m_blockchain.genesis(), error::wallet_internal_error, what);
-}
-//----------------------------------------------------------------------------------------------------
-std::string wallet2::path() const
-{
-  return m_wallet_file;
+  if (records > 0)
+    LOG_PRINT_L1("Replayed " << records << " records from " << journal_file);
+  reset_cache_journal(cache_size, good_size, records);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::store()
@@ -5289,6 +6617,18 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
       }
     }
   }
+
+  if (same_file && store_cache_journal())
+  {
+    if (m_message_store.get_active())
+      m_message_store.write_to_file(get_multisig_wallet_state(), m_mms_file);
+    return;
+  }
+
+  // the journal only extends the cache it was started with, a new cache starts a new journal
+  m_cache_journal.valid = false;
+  m_cache_base_id = crypto::rand<uint64_t>();
+
   // preparing wallet data
   std::stringstream oss;
   boost::archive::portable_binary_oarchive ar(oss);
@@ -5307,6 +6647,7 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
   const std::string old_keys_file = m_keys_file;
   const std::string old_address_file = m_wallet_file + ".address.txt";
   const std::string old_mms_file = m_mms_file;
+  const std::string old_journal_file = m_wallet_file + CACHE_JOURNAL_SUFFIX;
 
   // save keys to the new file
   // if we here, main wallet file is saved and we only need to save keys and address files
@@ -5344,6 +6685,14 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
         LOG_ERROR("error removing file: " << old_mms_file);
       }
     }
+    // remove old cache journal
+    if (boost::filesystem::exists(old_journal_file))
+    {
+      r = boost::filesystem::remove(old_journal_file);
+      if (!r) {
+        LOG_ERROR("error removing file: " << old_journal_file);
+      }
+    }
   } else {
     // save to new file
 #ifdef WIN32
@@ -5368,6 +6717,13 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     // here we have "*.new" file, we need to rename it to be without ".new"
     std::error_code e = tools::replace_file(new_file, m_wallet_file);
     THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+
+    // the old journal extends the old cache, a failure to remove it only leaves a file that is ignored on load
+    boost::system::error_code ec;
+    boost::filesystem::remove(old_journal_file, ec);
+    const uint64_t cache_size = boost::filesystem::file_size(m_wallet_file, ec);
+    if (!ec)
+      reset_cache_journal(cache_size, 0, 0);
   }
   
   if (m_message_store.get_active())
@@ -5479,31 +6835,47 @@ void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::pa
       });
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
+// entries above min_height up to max_height in one account or all of them, in height order
+template<typename T, typename F>
+static void query_history_index(const std::map<uint32_t, std::multimap<uint64_t, const std::pair<const crypto::hash, T>*>> &index,
+    uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, size_t offset, size_t limit,
+    const F &matches, std::list<std::pair<crypto::hash, T>> &entries)
 {
-  auto range = std::make_pair(m_payments.begin(), m_payments.end());
-  std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
-      if (min_height < x.second.m_block_height && max_height >= x.second.m_block_height &&
-          (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
-          (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
-      {
-      payments.push_back(x);
-      }
-      });
+  std::vector<std::pair<uint64_t, const std::pair<const crypto::hash, T>*>> found;
+  for (auto account = subaddr_account ? index.find(*subaddr_account) : index.begin(); account != index.end(); ++account)
+  {
+    for (auto i = account->second.upper_bound(min_height); i != account->second.end() && i->first <= max_height; ++i)
+    {
+      if (!matches(i->second->second))
+        continue;
+      found.push_back(*i);
+      if (subaddr_account && limit && found.size() >= offset + limit)
+        break;
+    }
+    if (subaddr_account)
+      break;
+  }
+  if (!subaddr_account)
+    std::stable_sort(found.begin(), found.end(), [](const std::pair<uint64_t, const std::pair<const crypto::hash, T>*> &a, const std::pair<uint64_t, const std::pair<const crypto::hash, T>*> &b) { return a.first < b.first; });
+  for (size_t n = offset; n < found.size() && (limit == 0 || n < offset + limit); ++n)
+    entries.push_back(*found[n].second);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, size_t offset, size_t limit) const
+{
+  index_history();
+  query_history_index(m_payments_index, min_height, max_height, subaddr_account, offset, limit, [&subaddr_indices](const payment_details &pd) {
+      return subaddr_indices.empty() || subaddr_indices.count(pd.m_subaddr_index.minor) == 1;
+    }, payments);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
-    uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
+    uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, size_t offset, size_t limit) const
 {
-  for (auto i = m_confirmed_txs.begin(); i != m_confirmed_txs.end(); ++i) {
-    if (i->second.m_block_height <= min_height || i->second.m_block_height > max_height)
-      continue;
-    if (subaddr_account && *subaddr_account != i->second.m_subaddr_account)
-      continue;
-    if (!subaddr_indices.empty() && std::count_if(i->second.m_subaddr_indices.begin(), i->second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
-      continue;
-    confirmed_payments.push_back(*i);
-  }
+  index_history();
+  query_history_index(m_confirmed_txs_index, min_height, max_height, subaddr_account, offset, limit, [&subaddr_indices](const confirmed_transfer_details &ctd) {
+      return subaddr_indices.empty() || std::count_if(ctd.m_subaddr_indices.begin(), ctd.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) != 0;
+    }, confirmed_payments);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
@@ -5528,39 +6900,80 @@ void wallet2::get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2:
 //----------------------------------------------------------------------------------------------------
 void wallet2::rescan_spent()
 {
+  // a view wallet may not know about key images, only those we know are checked
+  std::vector<size_t> indices;
+  std::vector<crypto::key_image> key_images;
+  indices.reserve(m_transfers.size());
+  key_images.reserve(m_transfers.size());
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    const transfer_details& td = m_transfers[i];
+    if (!td.m_key_image_known || td.m_key_image_partial)
+      continue;
+    indices.push_back(i);
+    key_images.push_back(td.m_key_image);
+  }
+
   // This is RPC call that can take a long time if there are many outputs,
-  // so we call it several times, in stripes, so we don't time out spuriously
-  std::vector<int> spent_status;
-  spent_status.reserve(m_transfers.size());
-  const size_t chunk_size = 1000;
-  for (size_t start_offset = 0; start_offset < m_transfers.size(); start_offset += chunk_size)
-  {
-    const size_t n_outputs = std::min<size_t>(chunk_size, m_transfers.size() - start_offset);
-    MDEBUG("Calling is_key_image_spent on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << m_transfers.size());
-    COMMAND_RPC_IS_KEY_IMAGE_SPENT::request req = AUTO_VAL_INIT(req);
-    COMMAND_RPC_IS_KEY_IMAGE_SPENT::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
-    for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
-      req.key_images.push_back(string_tools::pod_to_hex(m_transfers[n].m_key_image));
-    m_daemon_rpc_mutex.lock();
-    bool r = epee::net_utils::invoke_http_json("/is_key_image_spent", req, daemon_resp, m_http_client, rpc_timeout);
-    m_daemon_rpc_mutex.unlock();
-    THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != n_outputs, error::wallet_internal_error,
-        "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
-        std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(n_outputs));
-    std::copy(daemon_resp.spent_status.begin(), daemon_resp.spent_status.end(), std::back_inserter(spent_status));
+  // so we call it several times, in stripes, so we don't time out spuriously.
+  // The binary call packs key images and statuses, so it can take larger
+  // stripes; older daemons only have the json one.
+  std::vector<uint8_t> spent_status;
+  spent_status.reserve(key_images.size());
+  bool use_bin = true;
+  for (size_t start_offset = 0; start_offset < key_images.size(); )
+  {
+    const size_t chunk_size = use_bin ? 10000 : 1000;
+    const size_t n_outputs = std::min<size_t>(chunk_size, key_images.size() - start_offset);
+    MDEBUG("Calling is_key_image_spent on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << key_images.size());
+    if (use_bin)
+    {
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request req = AUTO_VAL_INIT(req);
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
+      req.key_images.assign(key_images.begin() + start_offset, key_images.begin() + start_offset + n_outputs);
+      m_daemon_rpc_mutex.lock();
+      bool r = epee::net_utils::invoke_http_bin("/is_key_image_spent.bin", req, daemon_resp, m_http_client, rpc_timeout);
+      m_daemon_rpc_mutex.unlock();
+      if (!r && start_offset == 0)
+      {
+        MDEBUG("is_key_image_spent.bin failed, falling back to is_key_image_spent");
+        use_bin = false;
+        continue;
+      }
+      THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent.bin");
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "is_key_image_spent.bin");
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != n_outputs, error::wallet_internal_error,
+          "daemon returned wrong response for is_key_image_spent.bin, wrong amounts count = " +
+          std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(n_outputs));
+      spent_status.insert(spent_status.end(), daemon_resp.spent_status.begin(), daemon_resp.spent_status.end());
+    }
+    else
+    {
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT::request req = AUTO_VAL_INIT(req);
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
+      for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
+        req.key_images.push_back(string_tools::pod_to_hex(key_images[n]));
+      m_daemon_rpc_mutex.lock();
+      bool r = epee::net_utils::invoke_http_json("/is_key_image_spent", req, daemon_resp, m_http_client, rpc_timeout);
+      m_daemon_rpc_mutex.unlock();
+      THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != n_outputs, error::wallet_internal_error,
+          "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
+          std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(n_outputs));
+      spent_status.insert(spent_status.end(), daemon_resp.spent_status.begin(), daemon_resp.spent_status.end());
+    }
+    start_offset += n_outputs;
   }
 
   // update spent status
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t k = 0; k < indices.size(); ++k)
   {
+    const size_t i = indices[k];
     transfer_details& td = m_transfers[i];
-    // a view wallet may not know about key images
-    if (!td.m_key_image_known || td.m_key_image_partial)
-      continue;
-    if (td.m_spent != (spent_status[i] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT))
+    if (td.m_spent != (spent_status[k] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT))
     {
       if (td.m_spent)
       {
@@ -5589,11 +7002,14 @@ void wallet2::rescan_blockchain(bool hard, bool refresh)
   {
     m_blockchain.clear();
     m_transfers.clear();
+    invalidate_unspent_index();
     m_key_images.clear();
     m_pub_keys.clear();
     m_unconfirmed_txs.clear();
     m_payments.clear();
     m_confirmed_txs.clear();
+    invalidate_history_index();
+    all_confirmed_txs_changed();
     m_unconfirmed_payments.clear();
     m_scanned_pool_txs[0].clear();
     m_scanned_pool_txs[1].clear();
@@ -6968,6 +8384,14 @@ bool wallet2::add_rings(const cryptonote::transaction_prefix &tx)
   catch (const std::exception &e) { return false; }
 }
 
+bool wallet2::add_rings(const crypto::chacha_key &key, const std::vector<cryptonote::transaction_prefix> &txs)
+{
+  if (!m_ringdb)
+    return false;
+  try { return m_ringdb->add_rings(key, txs); }
+  catch (const std::exception &e) { return false; }
+}
+
 bool wallet2::remove_rings(const cryptonote::transaction_prefix &tx)
 {
   if (!m_ringdb)
@@ -7071,6 +8495,8 @@ bool wallet2::find_and_save_rings(bool force)
 
     MDEBUG("Scanning " << res.txs.size() << " transactions");
     THROW_WALLET_EXCEPTION_IF(slice + res.txs.size() > txs_hashes.size(), error::wallet_internal_error, "Unexpected tx array size");
+    std::vector<cryptonote::transaction_prefix> txs;
+    txs.reserve(res.txs.size());
     for (size_t i = 0; i < res.txs.size(); ++i, ++it)
     {
     const auto &tx_info = res.txs[i];
@@ -7079,8 +8505,9 @@ bool wallet2::find_and_save_rings(bool force)
       THROW_WALLET_EXCEPTION_IF(!get_pruned_tx(tx_info, tx, tx_hash), error::wallet_internal_error,
           "Failed to get transaction from daemon");
       THROW_WALLET_EXCEPTION_IF(!(tx_hash == *it), error::wallet_internal_error, "Wrong txid received");
-      THROW_WALLET_EXCEPTION_IF(!add_rings(get_ringdb_key(), tx), error::wallet_internal_error, "Failed to save ring");
+      txs.push_back(std::move(tx));
     }
+    THROW_WALLET_EXCEPTION_IF(!add_rings(get_ringdb_key(), txs), error::wallet_internal_error, "Failed to save ring");
   }
 
   MINFO("Found and saved rings for " << txs_hashes.size() << " transactions");
@@ -7897,6 +9324,7 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     throw_on_rpc_response_error(result, "get_info");
     bool is_shortly_after_segregation_fork = height >= segregation_fork_height && height < segregation_fork_height + SEGREGATION_FORK_VICINITY;
     bool is_after_segregation_fork = height >= segregation_fork_height;
+    m_decoy_cache.set_height(height);
 
     // if we have at least one rct out, get the distribution, or fall back to the previous system
     uint64_t rct_start_height;
@@ -7920,11 +9348,14 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
           error::get_output_distribution, "Daemon reports suspicious number of rct outputs");
     }
 
-    std::vector<uint64_t> output_blacklist;
-    if (bool get_output_blacklist_failed = !get_output_blacklist(output_blacklist))
-      THROW_WALLET_EXCEPTION_IF(get_output_blacklist_failed, error::get_output_blacklist, "Couldn't retrive list of outputs that are to be exlcuded from selection");
-
-    std::sort(output_blacklist.begin(), output_blacklist.end());
+    if (!m_decoy_cache.has_output_blacklist)
+    {
+      if (bool get_output_blacklist_failed = !get_output_blacklist(m_decoy_cache.output_blacklist))
+        THROW_WALLET_EXCEPTION_IF(get_output_blacklist_failed, error::get_output_blacklist, "Couldn't retrive list of outputs that are to be exlcuded from selection");
+      std::sort(m_decoy_cache.output_blacklist.begin(), m_decoy_cache.output_blacklist.end());
+      m_decoy_cache.has_output_blacklist = true;
+    }
+    const std::vector<uint64_t> &output_blacklist = m_decoy_cache.output_blacklist;
     if (output_blacklist.size() * 0.05 > (double)rct_offsets.size())
     {
       MWARNING("More than 5% of outputs are blacklisted ("
@@ -7955,49 +9386,53 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     }
 
     // if we want to segregate fake outs pre or post fork, get distribution
+    // (a previous transaction at this height may have got it already)
     std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> segregation_limit;
     if (is_after_segregation_fork && (m_segregate_pre_fork_outputs || m_key_reuse_mitigation2))
     {
+      segregation_limit = m_decoy_cache.segregation_limit;
       cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req_t = AUTO_VAL_INIT(req_t);
       cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response resp_t = AUTO_VAL_INIT(resp_t);
+      std::vector<uint64_t> amounts;
       for(size_t idx: selected_transfers)
-        req_t.amounts.push_back(m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount());
-      std::sort(req_t.amounts.begin(), req_t.amounts.end());
-      auto end = std::unique(req_t.amounts.begin(), req_t.amounts.end());
-      req_t.amounts.resize(std::distance(req_t.amounts.begin(), end));
+        amounts.push_back(m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount());
+      req_t.amounts = m_decoy_cache.missing_segregation_amounts(std::move(amounts));
       req_t.from_height = std::max<uint64_t>(segregation_fork_height, RECENT_OUTPUT_BLOCKS) - RECENT_OUTPUT_BLOCKS;
       req_t.to_height = segregation_fork_height + 1;
       req_t.cumulative = true;
       req_t.binary = true;
-      m_daemon_rpc_mutex.lock();
-      bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req_t, resp_t, m_http_client, rpc_timeout * 1000);
-      m_daemon_rpc_mutex.unlock();
-      THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
-      THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_distribution");
-      THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_output_distribution, get_rpc_status(resp_t.status));
-
-      // check we got all data
-      for(size_t idx: selected_transfers)
+      if (!req_t.amounts.empty())
       {
-        const uint64_t amount = m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount();
-        bool found = false;
-        for (const auto &d: resp_t.distributions)
+        m_daemon_rpc_mutex.lock();
+        bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req_t, resp_t, m_http_client, rpc_timeout * 1000);
+        m_daemon_rpc_mutex.unlock();
+        THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
+        THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_distribution");
+        THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_output_distribution, get_rpc_status(resp_t.status));
+
+        // check we got all data
+        for(const uint64_t amount: req_t.amounts)
         {
-          if (d.amount == amount)
+          bool found = false;
+          for (const auto &d: resp_t.distributions)
           {
-            THROW_WALLET_EXCEPTION_IF(d.data.start_height > segregation_fork_height, error::get_output_distribution, "Distribution start_height too high");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height - d.data.start_height >= d.data.distribution.size(), error::get_output_distribution, "Distribution size too small");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS - d.data.start_height >= d.data.distribution.size(), error::get_output_distribution, "Distribution size too small");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height <= RECENT_OUTPUT_BLOCKS, error::wallet_internal_error, "Fork height too low");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS < d.data.start_height, error::get_output_distribution, "Bad start height");
-            uint64_t till_fork = d.data.distribution[segregation_fork_height - d.data.start_height];
-            uint64_t recent = till_fork - d.data.distribution[segregation_fork_height - RECENT_OUTPUT_BLOCKS - d.data.start_height];
-            segregation_limit[amount] = std::make_pair(till_fork, recent);
-            found = true;
-            break;
+            if (d.amount == amount)
+            {
+              THROW_WALLET_EXCEPTION_IF(d.data.start_height > segregation_fork_height, error::get_output_distribution, "Distribution start_height too high");
+              THROW_WALLET_EXCEPTION_IF(segregation_fork_height - d.data.start_height >= d.data.distribution.size(), error::get_output_distribution, "Distribution size too small");
+              THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS - d.data.start_height >= d.data.distribution.size(), error::get_output_distribution, "Distribution size too small");
+              THROW_WALLET_EXCEPTION_IF(segregation_fork_height <= RECENT_OUTPUT_BLOCKS, error::wallet_internal_error, "Fork height too low");
+              THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS < d.data.start_height, error::get_output_distribution, "Bad start height");
+              uint64_t till_fork = d.data.distribution[segregation_fork_height - d.data.start_height];
+              uint64_t recent = till_fork - d.data.distribution[segregation_fork_height - RECENT_OUTPUT_BLOCKS - d.data.start_height];
+              segregation_limit[amount] = std::make_pair(till_fork, recent);
+              m_decoy_cache.segregation_limit[amount] = segregation_limit[amount];
+              found = true;
+              break;
+            }
           }
+          THROW_WALLET_EXCEPTION_IF(!found, error::get_output_distribution, "Requested amount not found in response");
         }
-        THROW_WALLET_EXCEPTION_IF(!found, error::get_output_distribution, "Requested amount not found in response");
       }
     }
 
@@ -8372,12 +9807,14 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
 
     // get the keys for those
     req.get_txid = false;
+    req.packed = true;
     m_daemon_rpc_mutex.lock();
     bool r = epee::net_utils::invoke_http_bin("/get_outs.bin", req, daemon_resp, m_http_client, rpc_timeout);
     m_daemon_rpc_mutex.unlock();
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::get_outs_error, get_rpc_status(daemon_resp.status));
+    THROW_WALLET_EXCEPTION_IF(!daemon_resp.unpack(req.get_txid), error::wallet_internal_error, "daemon returned malformed packed outputs for get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.outs.size() != req.outputs.size(), error::wallet_internal_error,
       "daemon returned wrong response for get_outs.bin, wrong amounts count = " +
       std::to_string(daemon_resp.outs.size()) + ", expected " +  std::to_string(req.outputs.size()));
@@ -8988,52 +10425,83 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
 
   LOG_PRINT_L2("pick_preferred_rct_inputs: needed_money " << print_money(needed_money));
 
-  // try to find a rct input of enough size
-  for (size_t i = 0; i < m_transfers.size(); ++i)
-  {
-    const transfer_details& td = m_transfers[i];
+  const std::map<uint32_t, unspent_outputs> &unspent = get_unspent_outputs(subaddr_account);
 
-    if (!td.m_spent && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+  // try to find a rct input of enough size, the smallest one that will do
+  uint64_t best_amount = std::numeric_limits<uint64_t>::max();
+  for (uint32_t index_minor: subaddr_indices)
+  {
+    const auto outputs = unspent.find(index_minor);
+    if (outputs == unspent.end())
+      continue;
+    for (auto i = outputs->second.lower_bound(std::make_pair(needed_money, size_t(0))); i != outputs->second.end() && i->first < best_amount; ++i)
     {
-      LOG_PRINT_L2("We can use " << i << " alone: " << print_money(td.amount()));
-      picks.push_back(i);
-      return picks;
+      const transfer_details& td = m_transfers[i->second];
+      if (td.is_rct() && is_transfer_unlocked(td))
+      {
+        picks.assign(1, i->second);
+        best_amount = i->first;
+        break;
+      }
     }
   }
+  if (!picks.empty())
+  {
+    LOG_PRINT_L2("We can use " << picks[0] << " alone: " << print_money(best_amount));
+    return picks;
+  }
 
   // then try to find two outputs
   // this could be made better by picking one of the outputs to be a small one, since those
   // are less useful since often below the needed money, so if one can be used in a pair,
   // it gets rid of it for the future
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (uint32_t index_minor: subaddr_indices)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    const auto outputs = unspent.find(index_minor);
+    if (outputs == unspent.end())
+      continue;
+
+    // usable outputs by amount, and the same by age
+    std::vector<std::pair<uint64_t, size_t>> usable;
+    for (const auto &o: outputs->second)
+    {
+      const transfer_details& td = m_transfers[o.second];
+      if (!td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td))
+        usable.push_back(o);
+    }
+    std::vector<std::pair<uint64_t, size_t>> by_age = usable;
+    std::sort(by_age.begin(), by_age.end(), [](const std::pair<uint64_t, size_t> &x, const std::pair<uint64_t, size_t> &y) { return x.second < y.second; });
+
+    for (const auto &first: by_age)
     {
+      const size_t i = first.second;
+      const transfer_details& td = m_transfers[i];
       LOG_PRINT_L2("Considering input " << i << ", " << print_money(td.amount()));
-      for (size_t j = i + 1; j < m_transfers.size(); ++j)
+      const uint64_t rest = needed_money > first.first ? needed_money - first.first : 0;
+      for (auto second = std::lower_bound(usable.begin(), usable.end(), std::make_pair(rest, size_t(0))); second != usable.end(); ++second)
       {
+        // each pair is looked at once, from its oldest output
+        const size_t j = second->second;
+        if (j <= i)
+          continue;
         const transfer_details& td2 = m_transfers[j];
-        if (!td2.m_spent && !td.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
+        // update our picks if those outputs are less related than any we
+        // already found. If the same, don't update, and oldest suitable outputs
+        // will be used in preference.
+        float relatedness = get_output_relatedness(td, td2);
+        LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
+        if (relatedness < current_output_relatdness)
         {
-          // update our picks if those outputs are less related than any we
-          // already found. If the same, don't update, and oldest suitable outputs
-          // will be used in preference.
-          float relatedness = get_output_relatedness(td, td2);
-          LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
-          if (relatedness < current_output_relatdness)
-          {
-            // reset the current picks with those, and return them directly
-            // if they're unrelated. If they are related, we'll end up returning
-            // them if we find nothing better
-            picks.clear();
-            picks.push_back(i);
-            picks.push_back(j);
-            LOG_PRINT_L0("we could use " << i << " and " << j);
-            if (relatedness == 0.0f)
-              return picks;
-            current_output_relatdness = relatedness;
-          }
+          // reset the current picks with those, and return them directly
+          // if they're unrelated. If they are related, we'll end up returning
+          // them if we find nothing better
+          picks.clear();
+          picks.push_back(i);
+          picks.push_back(j);
+          LOG_PRINT_L0("we could use " << i << " and " << j);
+          if (relatedness == 0.0f)
+            return picks;
+          current_output_relatdness = relatedness;
         }
       }
     }
@@ -9131,6 +10599,7 @@ bool wallet2::light_wallet_import_wallet_request(cryptonote::COMMAND_RPC_IMPORT_
   cryptonote::COMMAND_RPC_IMPORT_WALLET_REQUEST::request oreq;
   oreq.address = get_account().get_public_address_str(m_nettype);
   oreq.view_key = string_tools::pod_to_hex(get_account().get_keys().m_view_secret_key);
+  oreq.from_height = m_refresh_from_block_height;
   m_daemon_rpc_mutex.lock();
   bool r = epee::net_utils::invoke_http_json("/import_wallet_request", oreq, response, m_http_client, rpc_timeout, "POST");
   m_daemon_rpc_mutex.unlock();
@@ -9177,6 +10646,7 @@ void wallet2::light_wallet_get_unspent_outs()
   
   // Clear old outputs
   m_transfers.clear();
+  invalidate_unspent_index();
   
   for (const auto &o: ores.outputs) {
     bool spent = false;
@@ -9417,7 +10887,7 @@ void wallet2::light_wallet_get_address_txs()
         }
       } else {
         if (std::find(payments_txs.begin(), payments_txs.end(), tx_hash) == payments_txs.end()) {
-          m_payments.emplace(tx_hash, payment);
+          history_index_add(*m_payments.emplace(tx_hash, payment));
           if (0 != m_callback) {
             m_callback->on_lw_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -9465,7 +10935,12 @@ void wallet2::light_wallet_get_address_txs()
             ctd.m_payment_id = payment_id;
             ctd.m_block_height = t.height;
             ctd.m_timestamp = t.timestamp;
-            m_confirmed_txs.emplace(tx_hash,ctd);
+            const auto entry = m_confirmed_txs.emplace(tx_hash,ctd);
+            if (entry.second)
+            {
+              history_index_add(*entry.first);
+              confirmed_tx_changed(tx_hash);
+            }
           }
           if (0 != m_callback)
           {
@@ -9482,6 +10957,7 @@ void wallet2::light_wallet_get_address_txs()
             confirmed_tx->second.m_amount_in = amount_sent;
             confirmed_tx->second.m_amount_out = amount_sent;
             confirmed_tx->second.m_change = 0;
+            confirmed_tx_changed(confirmed_tx->first);
           }
         }
       }
@@ -9710,45 +11186,42 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
   // gather all dust and non-dust outputs belonging to specified subaddresses
   size_t num_nondust_outputs = 0;
   size_t num_dust_outputs = 0;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  const std::map<uint32_t, unspent_outputs> &unspent = get_unspent_outputs(subaddr_account);
+  for (uint32_t index_minor: subaddr_indices)
   {
-    const transfer_details& td = m_transfers[i];
-    if (m_ignore_fractional_outputs && td.amount() < fractional_threshold)
-    {
-      MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is below threshold " << print_money(fractional_threshold));
+    const auto outputs = unspent.find(index_minor);
+    if (outputs == unspent.end())
       continue;
+    auto o = outputs->second.begin();
+    if (m_ignore_fractional_outputs)
+    {
+      o = outputs->second.lower_bound(std::make_pair(fractional_threshold, size_t(0)));
+      if (o != outputs->second.begin())
+        MDEBUG("Ignoring " << std::distance(outputs->second.begin(), o) << " outputs of subaddress " << subaddr_account << "," << index_minor
+            << " which are below threshold " << print_money(fractional_threshold));
     }
-    if (!td.m_spent && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    std::vector<size_t> transfers_indices, dust_indices;
+    for (; o != outputs->second.end(); ++o)
     {
-      const uint32_t index_minor = td.m_subaddr_index.minor;
-      auto find_predicate = [&index_minor](const std::pair<uint32_t, std::vector<size_t>>& x) { return x.first == index_minor; };
-      if ((td.is_rct()) || is_valid_decomposed_amount(td.amount()))
-      {
-        auto found = std::find_if(unused_transfers_indices_per_subaddr.begin(), unused_transfers_indices_per_subaddr.end(), find_predicate);
-        if (found == unused_transfers_indices_per_subaddr.end())
-        {
-          unused_transfers_indices_per_subaddr.push_back({index_minor, {i}});
-        }
-        else
-        {
-          found->second.push_back(i);
-        }
-        ++num_nondust_outputs;
-      }
-      else
+      const size_t i = o->second;
+      const transfer_details& td = m_transfers[i];
+      if (!td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td))
       {
-        auto found = std::find_if(unused_dust_indices_per_subaddr.begin(), unused_dust_indices_per_subaddr.end(), find_predicate);
-        if (found == unused_dust_indices_per_subaddr.end())
-        {
-          unused_dust_indices_per_subaddr.push_back({index_minor, {i}});
-        }
+        if ((td.is_rct()) || is_valid_decomposed_amount(td.amount()))
+          transfers_indices.push_back(i);
         else
-        {
-          found->second.push_back(i);
-        }
-        ++num_dust_outputs;
+          dust_indices.push_back(i);
       }
     }
+    // back in transfer order, as a scan of m_transfers would have found them
+    std::sort(transfers_indices.begin(), transfers_indices.end());
+    std::sort(dust_indices.begin(), dust_indices.end());
+    num_nondust_outputs += transfers_indices.size();
+    num_dust_outputs += dust_indices.size();
+    if (!transfers_indices.empty())
+      unused_transfers_indices_per_subaddr.push_back({index_minor, std::move(transfers_indices)});
+    if (!dust_indices.empty())
+      unused_dust_indices_per_subaddr.push_back({index_minor, std::move(dust_indices)});
   }
 
   // sort output indices
@@ -10506,18 +11979,25 @@ uint64_t wallet2::get_upper_transaction_weight_limit() const
 std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(const transfer_details &td)> &f) const
 {
   std::vector<size_t> outputs;
-  size_t n = 0;
-  for (transfer_container::const_iterator i = m_transfers.begin(); i != m_transfers.end(); ++i, ++n)
+  get_unspent_outputs(0); // brings the index up to date for all accounts
+  for (const auto &account: m_unspent_index)
   {
-    if (i->m_spent)
-      continue;
-    if (i->m_key_image_partial)
-      continue;
-    if (!is_transfer_unlocked(*i))
-      continue;
-    if (f(*i))
-      outputs.push_back(n);
+    for (const auto &minor: account.second)
+    {
+      for (const auto &o: minor.second)
+      {
+        const transfer_details &td = m_transfers[o.second];
+        if (td.m_key_image_partial)
+          continue;
+        if (!f(td))
+          continue;
+        if (!is_transfer_unlocked(td))
+          continue;
+        outputs.push_back(o.second);
+      }
+    }
   }
+  std::sort(outputs.begin(), outputs.end());
   return outputs;
 }
 //----------------------------------------------------------------------------------------------------
@@ -10654,6 +12134,7 @@ void wallet2::discard_unmixable_outputs()
   std::vector<size_t> unmixable_outputs = select_available_unmixable_outputs();
   for (size_t idx : unmixable_outputs)
   {
+    unspent_index_remove(idx);
     m_transfers[idx].m_spent = true;
   }
 }
@@ -10791,6 +12272,7 @@ std::string wallet2::get_spend_proof(const crypto::hash &txid, const std::string
       req.outputs[j].index = absolute_offsets[j];
     }
     COMMAND_RPC_GET_OUTPUTS_BIN::response res = AUTO_VAL_INIT(res);
+    req.packed = true;
     bool r;
     {
       const boost::lock_guard<boost::mutex> lock{m_daemon_rpc_mutex}; 
@@ -10799,6 +12281,7 @@ std::string wallet2::get_spend_proof(const crypto::hash &txid, const std::string
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::wallet_internal_error, "get_outs.bin");
+    THROW_WALLET_EXCEPTION_IF(!res.unpack(req.get_txid), error::wallet_internal_error, "daemon returned malformed packed outputs for get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(res.outs.size() != ring_size, error::wallet_internal_error,
       "daemon returned wrong response for get_outs.bin, wrong amounts count = " +
       std::to_string(res.outs.size()) + ", expected " +  std::to_string(ring_size));
@@ -10920,6 +12403,7 @@ bool wallet2::check_spend_proof(const crypto::hash &txid, const std::string &mes
       req.outputs[j].index = absolute_offsets[j];
     }
     COMMAND_RPC_GET_OUTPUTS_BIN::response res = AUTO_VAL_INIT(res);
+    req.packed = true;
     bool r;
     {
       const boost::lock_guard<boost::mutex> lock{m_daemon_rpc_mutex}; 
@@ -10928,6 +12412,7 @@ bool wallet2::check_spend_proof(const crypto::hash &txid, const std::string &mes
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::wallet_internal_error, "get_outs.bin");
+    THROW_WALLET_EXCEPTION_IF(!res.unpack(req.get_txid), error::wallet_internal_error, "daemon returned malformed packed outputs for get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(res.outs.size() != req.outputs.size(), error::wallet_internal_error,
       "daemon returned wrong response for get_outs.bin, wrong amounts count = " +
       std::to_string(res.outs.size()) + ", expected " +  std::to_string(req.outputs.size()));
@@ -11874,6 +13359,39 @@ bool wallet2::export_key_images(const std::string &filename, bool requested_only
   return epee::file_io_utils::save_string_to_file(filename, magic + ciphertext);    
 }
 
+//----------------------------------------------------------------------------------------------------
+// key image export and import verification are independent per output, so
+// large ranges are split across the threadpool; the first failure in index
+// order is rethrown so errors match the serial path
+template<typename F>
+static void for_each_transfer_chunk(hw::device &hwdev, size_t begin, size_t end, const F &f)
+{
+  static const size_t chunk_size = 256;
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  if (hwdev.get_type() != hw::device::SOFTWARE || tpool.get_max_concurrency() <= 1 || end - begin <= chunk_size)
+  {
+    for (size_t n = begin; n < end; ++n)
+      f(n);
+    return;
+  }
+
+  const size_t n_chunks = (end - begin + chunk_size - 1) / chunk_size;
+  std::vector<std::exception_ptr> errors(n_chunks);
+  tools::threadpool::waiter waiter;
+  for (size_t c = 0; c < n_chunks; ++c)
+  {
+    const size_t b = begin + c * chunk_size, e = std::min(end, b + chunk_size);
+    tpool.submit(&waiter, [&, c, b, e](){
+      try { for (size_t n = b; n < e; ++n) f(n); }
+      catch (...) { errors[c] = std::current_exception(); }
+    }, true);
+  }
+  waiter.wait(&tpool);
+
+  for (const std::exception_ptr &error: errors)
+    if (error)
+      std::rethrow_exception(error);
+}
 //----------------------------------------------------------------------------------------------------
 std::pair<size_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> wallet2::export_key_images(bool requested_only) const
 {
@@ -11888,8 +13406,8 @@ std::pair<size_t, std::vector<std::pair<crypto::key_image, crypto::signature>>>
       ++offset;
   }
 
-  ski.reserve(m_transfers.size() - offset);
-  for (size_t n = offset; n < m_transfers.size(); ++n)
+  ski.resize(m_transfers.size() - offset);
+  auto export_one = [&](size_t n)
   {
     const transfer_details &td = m_transfers[n];
 
@@ -11928,8 +13446,9 @@ std::pair<size_t, std::vector<std::pair<crypto::key_image, crypto::signature>>>
 
     crypto::generate_ring_signature((const crypto::hash&)td.m_key_image, td.m_key_image, key_ptrs, in_ephemeral.sec, 0, &signature);
 
-    ski.push_back(std::make_pair(td.m_key_image, signature));
-  }
+    ski[n - offset] = std::make_pair(td.m_key_image, signature);
+  };
+  for_each_transfer_chunk(m_account.get_device(), offset, m_transfers.size(), export_one);
   return std::make_pair(offset, ski);
 }
 
@@ -12005,10 +13524,10 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     return 0;
   }
 
-  req.key_images.reserve(signed_key_images.size());
+  req.key_images.resize(signed_key_images.size());
 
   PERF_TIMER_START(import_key_images_A);
-  for (size_t n = 0; n < signed_key_images.size(); ++n)
+  auto verify_one = [&](size_t n)
   {
     const transfer_details &td = m_transfers[n + offset];
     const crypto::key_image &key_image = signed_key_images[n].first;
@@ -12034,8 +13553,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
           + boost::lexical_cast<std::string>(signed_key_images.size()) + ", key image " + epee::string_tools::pod_to_hex(key_image)
           + ", signature " + epee::string_tools::pod_to_hex(signature) + ", pubkey " + epee::string_tools::pod_to_hex(*pkeys[0]));
     }
-    req.key_images.push_back(epee::string_tools::pod_to_hex(key_image));
-  }
+    req.key_images[n] = epee::string_tools::pod_to_hex(key_image);
+  };
+  for_each_transfer_chunk(m_account.get_device(), 0, signed_key_images.size(), verify_one);
   PERF_TIMER_STOP(import_key_images_A);
 
   PERF_TIMER_START(import_key_images_B);
@@ -12066,6 +13586,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       transfer_details &td = m_transfers[n + offset];
       td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
     }
+    invalidate_unspent_index();
   }
   spent = 0;
   unspent = 0;
@@ -12224,6 +13745,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       {
         if (j->second.m_tx_hash == *spent_txid)
         {
+          invalidate_history_index();
           m_payments.erase(j);
           break;
         }
@@ -12245,6 +13767,8 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
     }
     PERF_TIMER_STOP(import_key_images_G);
+    invalidate_history_index();
+    all_confirmed_txs_changed();
   }
 
   return m_transfers[signed_key_images.size() - 1].m_block_height;
@@ -12285,6 +13809,7 @@ wallet2::payment_container wallet2::export_payments() const
 void wallet2::import_payments(const payment_container &payments)
 {
   m_payments.clear();
+  invalidate_history_index();
   for (auto const &p : payments)
   {
     m_payments.emplace(p);
@@ -12293,6 +13818,8 @@ void wallet2::import_payments(const payment_container &payments)
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
   m_confirmed_txs.clear();
+  invalidate_history_index();
+  all_confirmed_txs_changed();
   for (auto const &p : confirmed_payments)
   {
     m_confirmed_txs.emplace(p);
@@ -12316,8 +13843,9 @@ void wallet2::import_blockchain(const std::tuple<size_t, crypto::hash, std::vect
   m_blockchain.clear();
   if (std::get<0>(bc))
   {
-    for (size_t n = std::get<0>(bc); n > 0; --n)
-      m_blockchain.push_back(std::get<1>(bc));
+    m_blockchain.push_back(std::get<1>(bc));
+    for (size_t n = std::get<0>(bc); n > 1; --n)
+      m_blockchain.push_back(crypto::null_hash);
     m_blockchain.trim(std::get<0>(bc));
   }
   for (auto const &b : std::get<2>(bc))
@@ -12380,6 +13908,7 @@ size_t wallet2::import_outputs(const std::pair<size_t, std::vector<tools::wallet
   const size_t offset = outputs.first;
   const size_t original_size = m_transfers.size();
   m_transfers.resize(offset + outputs.second.size());
+  invalidate_unspent_index();
   for (size_t i = 0; i < offset; ++i)
     m_transfers[i].m_key_image_request = false;
   for (size_t i = 0; i < outputs.second.size(); ++i)
@@ -12607,8 +14136,13 @@ cryptonote::blobdata wallet2::export_multisig()
 
   const crypto::public_key signer = get_multisig_signer_public_key();
 
+  // Wallet tries to create as many transactions as many signers combinations. We calculate the maximum number here as follows:
+  // if we have 2/4 wallet with signers: A, B, C, D and A is a transaction creator it will need to pick up 1 signer from 3 wallets left.
+  // That means counting combinations for excluding 2-of-3 wallets (k = total signers count - threshold, n = total signers count - 1).
+  const size_t nlr = tools::combinations_count(m_multisig_signers.size() - m_multisig_threshold, m_multisig_signers.size() - 1);
+
   info.resize(m_transfers.size());
-  for (size_t n = 0; n < m_transfers.size(); ++n)
+  for_each_transfer_chunk(m_account.get_device(), 0, m_transfers.size(), [&](size_t n)
   {
     transfer_details &td = m_transfers[n];
     crypto::key_image ki;
@@ -12628,10 +14162,6 @@ cryptonote::blobdata wallet2::export_multisig()
       info[n].m_partial_key_images.push_back(ki);
     }
 
-    // Wallet tries to create as many transactions as many signers combinations. We calculate the maximum number here as follows:
-    // if we have 2/4 wallet with signers: A, B, C, D and A is a transaction creator it will need to pick up 1 signer from 3 wallets left.
-    // That means counting combinations for excluding 2-of-3 wallets (k = total signers count - threshold, n = total signers count - 1).
-    size_t nlr = tools::combinations_count(m_multisig_signers.size() - m_multisig_threshold, m_multisig_signers.size() - 1);
     for (size_t m = 0; m < nlr; ++m)
     {
       td.m_multisig_k.push_back(rct::skGen());
@@ -12640,7 +14170,7 @@ cryptonote::blobdata wallet2::export_multisig()
     }
 
     info[n].m_signer = signer;
-  }
+  });
 
   std::stringstream oss;
   boost::archive::portable_binary_oarchive ar(oss);
@@ -12656,7 +14186,7 @@ cryptonote::blobdata wallet2::export_multisig()
   return MULTISIG_EXPORT_FILE_MAGIC + ciphertext;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n)
+void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n, const crypto::key_image *composite_ki)
 {
   CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad index in update_multisig_info");
   CHECK_AND_ASSERT_THROW_MES(multisig_k.size() >= m_transfers.size(), "Mismatched sizes of multisig_k and info");
@@ -12670,7 +14200,7 @@ void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key
     td.m_multisig_info.push_back(pi[n]);
   }
   m_key_images.erase(td.m_key_image);
-  td.m_key_image = get_multisig_composite_key_image(n);
+  td.m_key_image = composite_ki ? *composite_ki : get_multisig_composite_key_image(n);
   td.m_key_image_known = true;
   td.m_key_image_request = false;
   td.m_key_image_partial = false;
@@ -12768,9 +14298,21 @@ size_t wallet2::import_multisig(std::vector<cryptonote::blobdata> blobs)
     break;
   }
 
-  for (size_t n = 0; n < n_outputs && n < m_transfers.size(); ++n)
+  // composite key images depend only on each output's own info, so they are
+  // computed on the threadpool; the key image map is then updated serially
+  const size_t n_updates = std::min(n_outputs, m_transfers.size());
+  std::vector<crypto::key_image> composite_kis(n_updates);
+  for_each_transfer_chunk(m_account.get_device(), 0, n_updates, [&](size_t n)
+  {
+    transfer_details &td = m_transfers[n];
+    td.m_multisig_info.clear();
+    for (const auto &pi: info)
+      td.m_multisig_info.push_back(pi[n]);
+    composite_kis[n] = get_multisig_composite_key_image(n);
+  });
+  for (size_t n = 0; n < n_updates; ++n)
   {
-    update_multisig_rescan_info(k, info, n);
+    update_multisig_rescan_info(k, info, n, &composite_kis[n]);
   }
 
   m_multisig_rescan_k = &k;
@@ -38,6 +38,8 @@
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/deque.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/utility.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <atomic>
 
@@ -62,6 +64,7 @@
 #include "wallet_errors.h"
 #include "common/password.h"
 #include "node_rpc_proxy.h"
+#include "subaddress_table.h"
 #include "message_store.h"
 
 #include "common/antd_integration_test_hooks.h"
@@ -73,6 +76,9 @@
 #define SUBADDRESS_LOOKAHEAD_MINOR 200
 
 class Serialization_portability_wallet_Test;
+class wallet_scan_bench;
+class wallet_scan_digest;
+class wallet_cache_journal;
 
 namespace tools
 {
@@ -101,6 +107,7 @@ namespace tools
     virtual void on_unconfirmed_money_received(uint64_t height, const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t amount, const cryptonote::subaddress_index& subaddr_index) {}
     virtual void on_money_spent(uint64_t height, const crypto::hash &txid, const cryptonote::transaction& in_tx, uint64_t amount, const cryptonote::transaction& spend_tx, const cryptonote::subaddress_index& subaddr_index) {}
     virtual void on_skip_transaction(uint64_t height, const crypto::hash &txid, const cryptonote::transaction& tx) {}
+    virtual void on_blocks_applied(uint64_t height) {}
     virtual boost::optional<epee::wipeable_string> on_get_password(const char *reason) { return boost::none; }
     // Light wallet callbacks
     virtual void on_lw_new_block(uint64_t height) {}
@@ -178,7 +185,10 @@ namespace tools
   class hashchain
   {
   public:
-    hashchain(): m_genesis(crypto::null_hash), m_offset(0) {}
+    // below the dense part, about this many hashes are kept per doubling of the distance to it
+    static constexpr size_t SPARSE_DENSITY = 16;
+
+    hashchain(): m_genesis(crypto::null_hash), m_offset(0), m_stable(0) {}
 
     size_t size() const { return m_blockchain.size() + m_offset; }
     size_t offset() const { return m_offset; }
@@ -187,11 +197,29 @@ namespace tools
     bool is_in_bounds(size_t idx) const { return idx >= m_offset && idx < size(); }
     const crypto::hash &operator[](size_t idx) const { return m_blockchain[idx - m_offset]; }
     crypto::hash &operator[](size_t idx) { return m_blockchain[idx - m_offset]; }
-    void crop(size_t height) { m_blockchain.resize(height - m_offset); }
-    void clear() { m_offset = 0; m_blockchain.clear(); }
+    void crop(size_t height) { m_blockchain.resize(height - m_offset); m_stable = std::min(m_stable, height); }
+    void clear() { m_offset = 0; m_blockchain.clear(); m_sparse.clear(); m_stable = 0; }
     bool empty() const { return m_blockchain.empty() && m_offset == 0; }
-    void trim(size_t height) { while (height > m_offset && m_blockchain.size() > 1) { m_blockchain.pop_front(); ++m_offset; } m_blockchain.shrink_to_fit(); }
-    void refill(const crypto::hash &hash) { m_blockchain.push_back(hash); --m_offset; }
+    void trim(size_t height)
+    {
+      const size_t offset = std::min(height, m_offset + (m_blockchain.empty() ? 0 : m_blockchain.size() - 1));
+      for (; m_offset < offset; ++m_offset)
+      {
+        // null hashes are placeholders for blocks we never got the hash of
+        if (m_offset > 0 && m_blockchain.front() != crypto::null_hash && keep_sparse(m_offset, offset))
+          m_sparse[m_offset] = m_blockchain.front();
+        m_blockchain.pop_front();
+      }
+      for (auto it = m_sparse.begin(); it != m_sparse.end(); )
+        it = keep_sparse(it->first, m_offset) ? std::next(it) : m_sparse.erase(it);
+      m_blockchain.shrink_to_fit();
+    }
+    void refill(const crypto::hash &hash) { m_blockchain.push_back(hash); --m_offset; m_sparse.erase(m_offset); }
+    // hashes kept below offset(), denser towards it, genesis excluded
+    const std::map<size_t, crypto::hash> &sparse() const { return m_sparse; }
+    // the height below which nothing was cropped since the last mark_stable()
+    size_t stable_size() const { return std::min(m_stable, size()); }
+    void mark_stable() { m_stable = size(); }
 
     template <class t_archive>
     inline void serialize(t_archive &a, const unsigned int ver)
@@ -199,12 +227,29 @@ namespace tools
       a & m_offset;
       a & m_genesis;
       a & m_blockchain;
+      if (ver < 1)
+        return;
+      a & m_sparse;
     }
 
   private:
+    // a height is kept if it is a multiple of the largest power of two that
+    // leaves SPARSE_DENSITY of them between it and twice its distance to the
+    // dense part; as that part moves up, kept heights only ever get dropped
+    static bool keep_sparse(size_t height, size_t offset)
+    {
+      const size_t distance = offset - height;
+      size_t step = 1;
+      while (step * 2 * SPARSE_DENSITY <= distance)
+        step *= 2;
+      return height % step == 0;
+    }
+
     size_t m_offset;
     crypto::hash m_genesis;
     std::deque<crypto::hash> m_blockchain;
+    std::map<size_t, crypto::hash> m_sparse;
+    size_t m_stable;
   };
 
   enum class stake_check_result { allowed, not_allowed, try_later };
@@ -213,6 +258,9 @@ namespace tools
   class wallet2
   {
     friend class ::Serialization_portability_wallet_Test;
+    friend class ::wallet_scan_bench;
+    friend class ::wallet_scan_digest;
+    friend class ::wallet_cache_journal;
     friend class wallet_keys_unlocker;
     friend class wallet_device_callback;
   public:
@@ -535,6 +583,30 @@ namespace tools
         FIELD(cache_data)
       END_SERIALIZE()
     };
+
+    // What changed in the large containers of the cache since the previous
+    // store, one per record of the cache journal. Everything else is small
+    // and is written in full after it, see serialize_cache_state.
+    struct cache_delta
+    {
+      uint64_t base_id;   // m_cache_base_id of the cache file this extends
+      uint64_t sequence;  // index of this record in the journal
+      uint64_t blockchain_keep;
+      std::vector<crypto::hash> blockchain_new;
+      uint64_t transfers_keep;
+      std::vector<std::pair<uint64_t, transfer_details>> transfers_updated;
+      std::vector<transfer_details> transfers_new;
+      std::vector<crypto::key_image> key_images_removed;
+      std::vector<std::pair<crypto::key_image, uint64_t>> key_images_set;
+      std::vector<crypto::public_key> pub_keys_removed;
+      std::vector<std::pair<crypto::public_key, uint64_t>> pub_keys_set;
+      std::vector<crypto::public_key> subaddresses_removed;
+      std::vector<std::pair<crypto::public_key, cryptonote::subaddress_index>> subaddresses_set;
+      std::vector<crypto::hash> payments_removed; // by fingerprint
+      std::vector<std::pair<crypto::hash, payment_details>> payments_added;
+      std::vector<crypto::hash> confirmed_txs_removed;
+      std::vector<std::pair<crypto::hash, confirmed_transfer_details>> confirmed_txs_set;
+    };
     
     // GUI Address book
     struct address_book_row
@@ -564,6 +636,9 @@ namespace tools
       std::vector<cryptonote::transaction> txes;
       cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices o_indices;
       bool error;
+      // set when the daemon sent scan digests: txes_missing[i] until txes[i] is downloaded
+      std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest> scan_digests;
+      std::vector<bool> txes_missing;
     };
 
     struct is_out_data
@@ -571,6 +646,7 @@ namespace tools
       crypto::public_key pkey;
       crypto::key_derivation derivation;
       std::vector<boost::optional<cryptonote::subaddress_receive_info>> received;
+      std::vector<boost::optional<crypto::public_key>> spend_keys; // candidate subaddress spend key per output, if precomputed
     };
 
     struct tx_cache_data
@@ -580,6 +656,65 @@ namespace tools
       std::vector<is_out_data> additional;
     };
 
+    struct refresh_batch
+    {
+      uint64_t start_height;
+      std::vector<cryptonote::block_complete_entry> blocks;
+      std::vector<parsed_block> parsed_blocks;
+      std::vector<tx_cache_data> txes_cache_data;
+      bool scanned;
+      bool error;
+    };
+
+    // Blocks pulled and parsed by any of the wallets sharing this, so wallets
+    // hosted in the same process and refreshing over the same range fetch and
+    // parse it once. Entries are keyed by the daemon and everything the
+    // getblocks.bin request was made of, and handed out as copies.
+    class block_cache
+    {
+    public:
+      struct key
+      {
+        std::string daemon_address; // wallets may be pointed at daemons on different chains
+        std::list<crypto::hash> short_chain_history;
+        uint64_t start_height;
+        bool no_miner_tx;
+        bool scan_digest;
+        bool operator==(const key &k) const { return start_height == k.start_height && no_miner_tx == k.no_miner_tx && scan_digest == k.scan_digest && daemon_address == k.daemon_address && short_chain_history == k.short_chain_history; }
+      };
+
+      block_cache(size_t max_entries = 4): m_max_entries(max_entries) {}
+      bool get(const key &k, uint64_t &blocks_start_height, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks) const;
+      void add(const key &k, uint64_t blocks_start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks);
+
+    private:
+      struct entry
+      {
+        key k;
+        uint64_t blocks_start_height;
+        std::vector<cryptonote::block_complete_entry> blocks;
+        std::vector<parsed_block> parsed_blocks;
+      };
+      mutable boost::mutex m_mutex;
+      std::deque<entry> m_entries;
+      size_t m_max_entries;
+    };
+
+    // What get_outs asks the daemon for besides the outputs themselves, which
+    // does not change while the daemon stays at the same height.
+    struct decoy_cache
+    {
+      uint64_t height = 0;
+      bool has_output_blacklist = false;
+      std::vector<uint64_t> output_blacklist; // sorted
+      std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> segregation_limit; // amount -> outputs till the fork, recent ones
+
+      // drops everything fetched at another daemon height
+      void set_height(uint64_t h);
+      // the distinct amounts, sorted, that have no segregation limit yet
+      std::vector<uint64_t> missing_segregation_amounts(std::vector<uint64_t> amounts) const;
+    };
+
     /*!
      * \brief  Generates a wallet or restores one.
      * \param  wallet_              Name of wallet file
@@ -779,6 +914,10 @@ namespace tools
     void set_subaddress_label(const cryptonote::subaddress_index &index, const std::string &label);
     void set_subaddress_lookahead(size_t major, size_t minor);
     std::pair<size_t, size_t> get_subaddress_lookahead() const { return {m_subaddress_lookahead_major, m_subaddress_lookahead_minor}; }
+    // restricts subaddress matching to accounts [first, end), so a large wallet can be split across processes
+    void set_account_range(uint32_t first, uint32_t end);
+    std::pair<uint32_t, uint32_t> get_account_range() const { return {m_account_range_first, m_account_range_end}; }
+    bool in_account_range(uint32_t index_major) const { return index_major >= m_account_range_first && index_major < m_account_range_end; }
     bool contains_address(const cryptonote::account_public_address& address) const;
     bool contains_key_image(const crypto::key_image& key_image) const;
     bool generate_signature_for_request_stake_unlock(crypto::key_image const &key_image, crypto::signature &signature, uint32_t &nonce) const;
@@ -792,6 +931,7 @@ namespace tools
     bool refresh(bool trusted_daemon, uint64_t & blocks_fetched, bool& received_money, bool& ok);
 
     void set_refresh_type(RefreshType refresh_type) { m_refresh_type = refresh_type; }
+    void set_block_cache(const std::shared_ptr<block_cache> &cache) { m_block_cache = cache; }
     RefreshType get_refresh_type() const { return m_refresh_type; }
 
     cryptonote::network_type nettype() const { return m_nettype; }
@@ -860,9 +1000,10 @@ namespace tools
     bool check_connection(uint32_t *version = NULL, uint32_t timeout = 200000);
     void get_transfers(wallet2::transfer_container& incoming_transfers) const;
     void get_payments(const crypto::hash& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height = 0, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
-    void get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
+    // in block height order; offset and limit page through the matching entries, a limit of 0 being none
+    void get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}, size_t offset = 0, size_t limit = 0) const;
     void get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
-      uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
+      uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}, size_t offset = 0, size_t limit = 0) const;
     void get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
     void get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2::pool_payment_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
 
@@ -872,6 +1013,9 @@ namespace tools
     std::vector<cryptonote::COMMAND_RPC_GET_FULL_NODE_BLACKLISTED_KEY_IMAGES::entry> get_full_node_blacklisted_key_images(boost::optional<std::string> &failed)            const { return m_node_rpc_proxy.get_full_node_blacklisted_key_images(failed); }
 
     uint64_t get_blockchain_current_height() const { return m_light_wallet_blockchain_height ? m_light_wallet_blockchain_height : m_blockchain.size(); }
+    // bumped whenever payments or outgoing txes may have been removed, as opposed to
+    // only added at new heights; history mirrors have to be rebuilt when it changes
+    uint64_t get_history_generation() const { return m_history_generation; }
     void rescan_spent();
     void rescan_blockchain(bool hard, bool refresh = true);
     bool is_transfer_unlocked(const transfer_details &td) const;
@@ -993,6 +1137,9 @@ namespace tools
       if(ver < 28)
         return;
       a & m_cold_key_images;
+      if(ver < 29)
+        return;
+      a & m_cache_base_id;
     }
 
     /*!
@@ -1390,15 +1537,21 @@ namespace tools
      */
     bool load_keys(const std::string& keys_file_name, const epee::wipeable_string& password);
     void process_new_transaction(const crypto::hash &txid, const cryptonote::transaction& tx, const std::vector<uint64_t> &o_indices, uint64_t height, uint64_t ts, bool miner_tx, bool pool, bool double_spend_seen, const tx_cache_data &tx_cache_data, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
-    void process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const parsed_block &parsed_block, const crypto::hash& bl_id, uint64_t height, const std::vector<tx_cache_data> &tx_cache_data, size_t tx_cache_data_offset, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    void process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, parsed_block &parsed_block, const crypto::hash& bl_id, uint64_t height, std::vector<tx_cache_data> &tx_cache_data, size_t tx_cache_data_offset, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
     void detach_blockchain(uint64_t height);
     void get_short_chain_history(std::list<crypto::hash>& ids, uint64_t granularity = 1) const;
     bool clear();
-    void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices);
+    void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest> &scan_digests, uint64_t &current_height);
+    void pull_filtered_txes(const std::vector<crypto::hash> &txids, std::vector<cryptonote::transaction> &txes);
+    bool scan_digest_matches(const crypto::hash &txid, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest, tx_cache_data &tx_cache_data) const;
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
-    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &error);
-    void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    bool use_scan_digests() const;
+    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<crypto::hash> &prev_block_hashes, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &error);
+    void parse_blocks(const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest> &scan_digests, std::vector<parsed_block> &parsed_blocks, bool &error) const;
+    void scan_parsed_blocks(const std::vector<parsed_block> &parsed_blocks, const crypto::secret_key &view_secret_key, std::vector<tx_cache_data> &tx_cache_data) const;
+    void derive_tx_cache_data(const std::vector<parsed_block> &parsed_blocks, const crypto::secret_key &view_secret_key, std::vector<tx_cache_data> &tx_cache_data) const;
+    void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL, std::vector<tx_cache_data> *scanned_tx_cache_data = NULL);
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::vector<size_t>& selected_transfers) const;
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height);
@@ -1420,19 +1573,38 @@ namespace tools
     std::vector<size_t> pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices) const;
     void set_spent(size_t idx, uint64_t height);
     void set_unspent(size_t idx);
+    typedef std::set<std::pair<uint64_t, size_t>> unspent_outputs; // amount, transfer index
+    const std::map<uint32_t, unspent_outputs> &get_unspent_outputs(uint32_t subaddr_account) const;
+    void unspent_index_add(size_t idx) const;
+    void unspent_index_remove(size_t idx) const;
+    void invalidate_unspent_index();
+    void apply_account_range();
+    void index_history() const;
+    void history_index_add(const payment_container::value_type &payment) const;
+    void history_index_add(const std::pair<const crypto::hash, confirmed_transfer_details> &confirmed_tx) const;
+    void history_index_remove(const std::pair<const crypto::hash, confirmed_transfer_details> &confirmed_tx) const;
+    void invalidate_history_index();
     void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count);
     bool tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, uint64_t global_index, const crypto::public_key& tx_public_key, const rct::key& mask, uint64_t real_index, bool unlocked) const;
     bool should_pick_a_second_output(bool use_rct, size_t n_transfers, const std::vector<size_t> &unused_transfers_indices, const std::vector<size_t> &unused_dust_indices) const;
     std::vector<size_t> get_only_rct(const std::vector<size_t> &unused_dust_indices, const std::vector<size_t> &unused_transfers_indices) const;
     void scan_output(const cryptonote::transaction &tx, bool miner_tx, const crypto::public_key &tx_pub_key, size_t i, tx_scan_info_t &tx_scan_info, std::vector<tx_money_got_in_out> &tx_money_got_in_outs, std::vector<size_t> &outs, bool pool);
     void trim_hashchain();
+    template <class t_archive> void serialize_cache_state(t_archive &a);
+    bool store_cache_journal();
+    bool load_cache_chunked();
+    void load_cache_journal();
+    void reset_cache_journal(uint64_t cache_size, uint64_t journal_size, uint64_t records);
+    void confirmed_tx_changed(const crypto::hash &txid);
+    void all_confirmed_txs_changed();
     crypto::key_image get_multisig_composite_key_image(size_t n) const;
     rct::multisig_kLRki get_multisig_composite_kLRki(size_t n,  const std::unordered_set<crypto::public_key> &ignore_set, std::unordered_set<rct::key> &used_L, std::unordered_set<rct::key> &new_used_L) const;
     rct::multisig_kLRki get_multisig_kLRki(size_t n, const rct::key &k) const;
     rct::key get_multisig_k(size_t idx, const std::unordered_set<rct::key> &used_L) const;
-    void update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n);
+    void update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n, const crypto::key_image *composite_ki = NULL);
     bool add_rings(const crypto::chacha_key &key, const cryptonote::transaction_prefix &tx);
     bool add_rings(const cryptonote::transaction_prefix &tx);
+    bool add_rings(const crypto::chacha_key &key, const std::vector<cryptonote::transaction_prefix> &txs);
     bool remove_rings(const cryptonote::transaction_prefix &tx);
     bool get_ring(const crypto::chacha_key &key, const crypto::key_image &key_image, std::vector<uint64_t> &outs);
     crypto::chacha_key get_ringdb_key();
@@ -1453,6 +1625,7 @@ namespace tools
       std::unordered_set<crypto::public_key> &pkeys) const;
 
     void cache_tx_data(const cryptonote::transaction& tx, const crypto::hash &txid, tx_cache_data &tx_cache_data) const;
+    void cache_tx_data(const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data) const;
     std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> create_output_tracker_cache() const;
 
     void setup_new_blockchain();
@@ -1487,6 +1660,7 @@ namespace tools
     std::unordered_map<crypto::public_key, size_t> m_pub_keys;
     cryptonote::account_public_address m_account_public_address;
     std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+    tools::subaddress_table m_subaddress_table; // same content as m_subaddresses, for lookups while scanning
     std::vector<std::vector<std::string>> m_subaddress_labels;
     std::unordered_map<crypto::hash, std::string> m_tx_notes;
     std::unordered_map<std::string, std::string> m_attributes;
@@ -1497,6 +1671,47 @@ namespace tools
     const std::vector<std::vector<rct::key>> *m_multisig_rescan_k;
     std::unordered_map<crypto::public_key, crypto::key_image> m_cold_key_images;
 
+    // Unspent transfers by subaddress account and minor index, ordered by amount
+    // and then by index, which follows the block height. Transfers past
+    // m_unspent_indexed are added lazily by get_unspent_outputs, others are kept
+    // up to date by set_spent/set_unspent. Anything else changing m_transfers
+    // other than appending to it has to invalidate the index.
+    mutable std::map<uint32_t, std::map<uint32_t, unspent_outputs>> m_unspent_index;
+    mutable size_t m_unspent_indexed;
+
+    // m_payments and m_confirmed_txs by subaddress account and block height, so that
+    // history queries only visit the heights they ask for. The entries point into the
+    // two containers, whose elements stay put when they rehash. Built by index_history
+    // on first use and kept up to date as payments and outgoing txes are recorded,
+    // anything else erasing from either container has to invalidate it.
+    mutable std::map<uint32_t, std::multimap<uint64_t, const payment_container::value_type*>> m_payments_index;
+    mutable std::map<uint32_t, std::multimap<uint64_t, const std::pair<const crypto::hash, confirmed_transfer_details>*>> m_confirmed_txs_index;
+    mutable bool m_history_indexed;
+    uint64_t m_history_generation;
+
+    // The cache file is rewritten in full only now and then, other stores append
+    // a cache_delta to the journal next to it. This is what the two hold together,
+    // to tell what changed since.
+    struct cache_journal_state
+    {
+      bool valid = false; // if not, the next store rewrites the cache file
+      std::string file;
+      uint64_t records = 0;
+      uint64_t cache_size = 0;
+      uint64_t journal_size = 0;
+      size_t blockchain_offset = 0;
+      std::vector<crypto::hash> transfers; // fingerprint of each
+      std::unordered_map<crypto::key_image, size_t> key_images;
+      std::unordered_map<crypto::public_key, size_t> pub_keys;
+      std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+      std::unordered_map<crypto::hash, size_t> payments; // fingerprint -> count
+      std::unordered_map<crypto::hash, crypto::hash> confirmed_txs; // txid -> fingerprint
+      std::unordered_set<crypto::hash> confirmed_txs_changed; // txids to fingerprint again on the next store
+      bool all_confirmed_txs_changed = false;
+    };
+    uint64_t m_cache_base_id;
+    cache_journal_state m_cache_journal;
+
     std::atomic<bool> m_run;
 
     boost::mutex m_daemon_rpc_mutex;
@@ -1544,8 +1759,14 @@ namespace tools
     bool m_track_uses;
     bool m_is_initialized;
     NodeRPCProxy m_node_rpc_proxy;
+    std::vector<uint64_t> m_rct_distribution; // cumulative rct outputs per height from 0, as last fetched from the daemon
+    uint64_t m_rct_distribution_height; // daemon height m_rct_distribution was fetched at
+    uint64_t m_pool_cookie; // daemon's pool cookie m_pool_tx_hashes was fetched at, 0 for none
+    std::vector<crypto::hash> m_pool_tx_hashes;
+    decoy_cache m_decoy_cache;
     std::unordered_set<crypto::hash> m_scanned_pool_txs[2];
     size_t m_subaddress_lookahead_major, m_subaddress_lookahead_minor;
+    uint32_t m_account_range_first, m_account_range_end;
     std::string m_device_name;
     std::string m_device_derivation_path;
     uint64_t m_device_last_key_image_sync;
@@ -1572,6 +1793,8 @@ namespace tools
     std::unique_ptr<ringdb> m_ringdb;
     boost::optional<crypto::chacha_key> m_ringdb_key;
 
+    std::shared_ptr<block_cache> m_block_cache;
+
     uint64_t m_last_block_reward;
     std::unique_ptr<tools::file_locker> m_keys_file_locker;
     
@@ -1603,7 +1826,8 @@ namespace tools
   bool parse_priority          (const std::string& arg, uint32_t& priority);
 
 }
-BOOST_CLASS_VERSION(tools::wallet2, 28)
+BOOST_CLASS_VERSION(tools::wallet2, 29)
+BOOST_CLASS_VERSION(tools::hashchain, 1)
 BOOST_CLASS_VERSION(tools::wallet2::transfer_details, 11)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_info, 1)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_info::LR, 0)
@@ -1619,6 +1843,7 @@ BOOST_CLASS_VERSION(tools::wallet2::signed_tx_set, 0)
 BOOST_CLASS_VERSION(tools::wallet2::tx_construction_data, 5)
 BOOST_CLASS_VERSION(tools::wallet2::pending_tx, 3)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_sig, 0)
+BOOST_CLASS_VERSION(tools::wallet2::cache_delta, 0)
 
 namespace boost
 {
@@ -2015,6 +2240,28 @@ namespace boost
       a & x.msout;
     }
 
+    template <class Archive>
+    inline void serialize(Archive &a, tools::wallet2::cache_delta &x, const boost::serialization::version_type ver)
+    {
+      a & x.base_id;
+      a & x.sequence;
+      a & x.blockchain_keep;
+      a & x.blockchain_new;
+      a & x.transfers_keep;
+      a & x.transfers_updated;
+      a & x.transfers_new;
+      a & x.key_images_removed;
+      a & x.key_images_set;
+      a & x.pub_keys_removed;
+      a & x.pub_keys_set;
+      a & x.subaddresses_removed;
+      a & x.subaddresses_set;
+      a & x.payments_removed;
+      a & x.payments_added;
+      a & x.confirmed_txs_removed;
+      a & x.confirmed_txs_set;
+    }
+
     template <class Archive>
     inline void serialize(Archive &a, tools::wallet2::pending_tx &x, const boost::serialization::version_type ver)
     {
@@ -33,6 +33,7 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/algorithm/string.hpp>
 #include <cstdint>
+#include <zmq.hpp>
 #include "include_base_utils.h"
 using namespace epee;
 
@@ -53,6 +54,8 @@ using namespace epee;
 #include "rpc/rpc_args.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "daemonizer/daemonizer.h"
+#include "common/perf_timer.h"
+#include "common/alloc_profiler.h"
 
 #undef ANTD_DEFAULT_LOG_CATEGORY
 #define ANTD_DEFAULT_LOG_CATEGORY "wallet.rpc"
@@ -64,6 +67,9 @@ namespace
   const command_line::arg_descriptor<bool> arg_restricted = {"restricted-rpc", "Restricts to view-only commands", false};
   const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
   const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
+  const command_line::arg_descriptor<size_t> arg_max_wallets = {"max-wallets", "How many wallets from --wallet-dir can be open at once, each addressed as /wallet/<filename>/json_rpc", 1};
+  const command_line::arg_descriptor<std::string> arg_daemon_zmq_pub = {"daemon-zmq-pub", "Refresh when the daemon's ZMQ publisher (its --zmq-pub-bind-port, e.g. tcp://127.0.0.1:<port>) announces a new block or pool tx, polling only as a fallback", ""};
+  const command_line::arg_descriptor<size_t> arg_rpc_threads = {"rpc-threads", "Threads accepting RPC requests; get_balance and get_height are answered on them, anything else that uses a wallet is queued for the wallet thread", 2};
 
   constexpr const char default_rpc_username[] = "antd";
 
@@ -101,32 +107,370 @@ namespace tools
   }
 
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL)
+  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), m_refreshing(NULL), m_worker_stop(false), m_refresh_requested(false), m_rpc_threads(1), m_max_wallets(1), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL)
   {
   }
   //------------------------------------------------------------------------------------------------------------------------------
   wallet_rpc_server::~wallet_rpc_server()
   {
-    if (m_wallet)
-      delete m_wallet;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::set_wallet(wallet2 *cr)
   {
-    m_wallet = cr;
+    const std::string id = boost::filesystem::path(cr->get_wallet_file()).filename().string();
+    add_wallet(id, std::unique_ptr<wallet2>(cr));
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  bool wallet_rpc_server::run()
+  bool wallet_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
   {
-    m_stop = false;
-    m_net_server.add_idle_handler([this](){
+    ALLOC_SCOPE(rpc);
+    MINFO("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+
+    static const std::string wallet_prefix = "/wallet/";
+    bool handled = false;
+    if (query_info.m_URI == "/metrics")
+    {
+      handled = handle_http_request_map(query_info, response, m_conn_context);
+    }
+    else if (query_info.m_URI.compare(0, wallet_prefix.size(), wallet_prefix) != 0 || query_info.m_URI.find('/', wallet_prefix.size()) != std::string::npos)
+    {
+      epee::net_utils::http::http_request_info wallet_query_info;
+      const epee::net_utils::http::http_request_info *request = &query_info;
+      boost::optional<std::string> id;
+      if (query_info.m_URI.compare(0, wallet_prefix.size(), wallet_prefix) == 0)
+      {
+        const size_t id_end = query_info.m_URI.find('/', wallet_prefix.size());
+        id = query_info.m_URI.substr(wallet_prefix.size(), id_end - wallet_prefix.size());
+        wallet_query_info = query_info;
+        wallet_query_info.m_URI = query_info.m_URI.substr(id_end);
+        request = &wallet_query_info;
+      }
+
+      std::shared_ptr<const wallet_snapshot> snapshot;
+      {
+        boost::lock_guard<boost::mutex> lock(m_wallets_mutex);
+        const auto i = m_wallets.find(id ? *id : m_default_wallet);
+        if (i != m_wallets.end())
+          snapshot = i->second.snapshot;
+      }
+
+      bool done = false;
+      if (snapshot && is_snapshot_request(*request))
+      {
+        snapshot_request &sr = current_snapshot_request();
+        sr.snapshot = snapshot.get();
+        sr.missed = false;
+        handled = handle_http_request_map(*request, response, m_conn_context);
+        sr.snapshot = NULL;
+        done = !sr.missed;
+      }
+      if (!done)
+      {
+        run_on_worker([&]() {
+          // looked up again, it may have been closed while this was queued
+          const auto i = m_wallets.find(id ? *id : m_default_wallet);
+          if (id && i == m_wallets.end())
+          {
+            handled = false;
+            return;
+          }
+          m_wallet = i == m_wallets.end() ? NULL : i->second.wallet.get();
+          handled = handle_http_request_map(*request, response, m_conn_context);
+          // the handler may have opened or closed wallets
+          for (const auto &w: m_wallets)
+            if (w.second.wallet.get() == m_wallet)
+              publish_snapshot(w.first);
+          m_wallet = NULL;
+        });
+      }
+    }
+
+    if (!handled)
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::is_snapshot_request(const epee::net_utils::http::http_request_info& query_info) const
+  {
+    if (query_info.m_URI != "/json_rpc" || epee::json_rpc::is_batch(query_info.m_body))
+      return false;
+    epee::serialization::portable_storage ps;
+    std::string method;
+    if (!ps.load_from_json(query_info.m_body) || !ps.get_value("method", method, nullptr))
+      return false;
+    return method == "get_balance" || method == "getbalance" || method == "get_height" || method == "getheight";
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  wallet_rpc_server::snapshot_request &wallet_rpc_server::current_snapshot_request()
+  {
+    static thread_local snapshot_request request = {NULL, false};
+    return request;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::publish_snapshot(const std::string &id)
+  {
+    const auto i = m_wallets.find(id);
+    if (i == m_wallets.end())
+      return;
+    const wallet2 &w = *i->second.wallet;
+    const std::shared_ptr<const wallet_snapshot> prev = i->second.snapshot;
+    std::shared_ptr<wallet_snapshot> snapshot = std::make_shared<wallet_snapshot>();
+    try
+    {
+      snapshot->height = w.get_blockchain_current_height();
+      snapshot->multisig_import_needed = w.multisig() && w.has_multisig_partial_key_images();
+      snapshot->accounts.resize(w.get_num_subaddress_accounts());
+      for (uint32_t major = 0; major < snapshot->accounts.size(); ++major)
+      {
+        wallet_snapshot::account &account = snapshot->accounts[major];
+        account.balance = w.balance(major);
+        account.unlocked_balance = w.unlocked_balance(major);
+        account.balance_per_subaddress = w.balance_per_subaddress(major);
+        account.unlocked_balance_per_subaddress = w.unlocked_balance_per_subaddress(major);
+        const uint32_t n_subaddresses = w.get_num_subaddresses(major);
+        for (uint32_t minor = 0; minor < n_subaddresses; ++minor)
+          account.labels.push_back(w.get_subaddress_label({major, minor}));
+        // addresses only ever get added, so only the new ones are derived
+        const std::vector<std::string> *prev_addresses = prev && major < prev->accounts.size() ? prev->accounts[major].addresses.get() : NULL;
+        if (prev_addresses && prev_addresses->size() == n_subaddresses)
+        {
+          account.addresses = prev->accounts[major].addresses;
+        }
+        else
+        {
+          std::shared_ptr<std::vector<std::string>> addresses = std::make_shared<std::vector<std::string>>();
+          if (prev_addresses && prev_addresses->size() < n_subaddresses)
+            *addresses = *prev_addresses;
+          for (uint32_t minor = addresses->size(); minor < n_subaddresses; ++minor)
+            addresses->push_back(w.get_subaddress_as_str({major, minor}));
+          account.addresses = addresses;
+        }
+      }
+      for (size_t n = 0; n < w.get_num_transfer_details(); ++n)
+      {
+        const wallet2::transfer_details &td = w.get_transfer_details(n);
+        if (!td.m_spent && td.m_subaddr_index.major < snapshot->accounts.size())
+          ++snapshot->accounts[td.m_subaddr_index.major].unspent_outputs_per_subaddress[td.m_subaddr_index.minor];
+      }
+    }
+    catch (const std::exception &e)
+    {
+      // requests go to the wallet itself until the next snapshot
+      MERROR("Failed to snapshot wallet " << id << ": " << e.what());
+      snapshot.reset();
+    }
+    boost::lock_guard<boost::mutex> lock(m_wallets_mutex);
+    i->second.snapshot = snapshot;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::run_on_worker(const std::function<void()> &f)
+  {
+    std::exception_ptr error;
+    bool done = false;
+    boost::unique_lock<boost::mutex> lock(m_jobs_mutex);
+    m_jobs.push_back([&]() {
+      try { f(); }
+      catch (...) { error = std::current_exception(); }
+      boost::lock_guard<boost::mutex> lock(m_jobs_mutex);
+      done = true;
+      m_jobs_cond.notify_all();
+    });
+    // a refresh in progress gives way at the end of its current batch
+    if (m_refreshing)
+      m_refreshing->stop();
+    m_jobs_cond.notify_all();
+    while (!done)
+      m_jobs_cond.wait(lock);
+    if (error)
+      std::rethrow_exception(error);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::worker()
+  {
+    // with the daemon telling us when something changed the timer is only a
+    // safety net, for a dropped subscription or a daemon restart
+    const boost::chrono::seconds refresh_interval(m_daemon_zmq_pub.empty() ? 20 : 120);
+    boost::chrono::steady_clock::time_point next_refresh = boost::chrono::steady_clock::now() + refresh_interval;
+    boost::unique_lock<boost::mutex> lock(m_jobs_mutex);
+    while (true)
+    {
+      if (!m_jobs.empty())
+      {
+        std::function<void()> job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+        continue;
+      }
+      if (m_worker_stop)
+        break;
+      if (m_refresh_requested || boost::chrono::steady_clock::now() >= next_refresh)
+      {
+        m_refresh_requested = false;
+        lock.unlock();
+        const bool complete = refresh_wallets();
+        lock.lock();
+        // one cut short by requests carries on as soon as they are done
+        next_refresh = boost::chrono::steady_clock::now() + (complete ? refresh_interval : boost::chrono::seconds(0));
+        continue;
+      }
+      m_jobs_cond.wait_until(lock, next_refresh);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::notifier()
+  {
+    // any number of notifications between two refreshes collapse into one
+    static const char *const topics[] = {"chain_tip", "chain_detached", "txpool_add"};
+    static const int recv_timeout_ms = 500;
+    try
+    {
+      zmq::context_t context(1);
+      zmq::socket_t sub_socket(context, ZMQ_SUB);
+      const int linger = 0;
+      sub_socket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+      sub_socket.setsockopt(ZMQ_RCVTIMEO, &recv_timeout_ms, sizeof(recv_timeout_ms));
+      for (const char *topic: topics)
+        sub_socket.setsockopt(ZMQ_SUBSCRIBE, topic, strlen(topic));
+      sub_socket.connect(m_daemon_zmq_pub.c_str());
+      MINFO("Refreshing on notifications from " << m_daemon_zmq_pub);
+
+      zmq::message_t message;
+      while (true)
+      {
+        {
+          boost::lock_guard<boost::mutex> lock(m_jobs_mutex);
+          if (m_worker_stop)
+            break;
+        }
+        if (!sub_socket.recv(&message))
+          continue;
+
+        // only the topic frame matters, skip the payload
+        int more = 0;
+        size_t more_size = sizeof(more);
+        sub_socket.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+        while (more)
+        {
+          zmq::message_t payload;
+          sub_socket.recv(&payload);
+          sub_socket.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+        }
+
+        boost::lock_guard<boost::mutex> lock(m_jobs_mutex);
+        m_refresh_requested = true;
+        m_jobs_cond.notify_all();
+      }
+    }
+    catch (const zmq::error_t &e)
+    {
+      MERROR("ZMQ subscription to " << m_daemon_zmq_pub << " failed, falling back to polling: " << e.what());
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::refresh_wallets()
+  {
+    // wallets at the same height get the blocks the one before them pulled
+    // from the shared block cache
+    for (const auto &w: m_wallets)
+    {
+      {
+        boost::lock_guard<boost::mutex> lock(m_jobs_mutex);
+        if (!m_jobs.empty() || m_worker_stop)
+          return false;
+        m_refreshing = w.second.wallet.get();
+      }
       try {
-        if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
+        w.second.wallet->refresh(w.second.wallet->is_trusted_daemon());
       } catch (const std::exception& ex) {
-        LOG_ERROR("Exception at while refreshing, what=" << ex.what());
+        LOG_ERROR("Exception at while refreshing " << w.first << ", what=" << ex.what());
       }
-      return true;
-    }, 20000);
+      bool interrupted;
+      {
+        boost::lock_guard<boost::mutex> lock(m_jobs_mutex);
+        m_refreshing = NULL;
+        interrupted = !m_jobs.empty() || m_worker_stop;
+      }
+      publish_snapshot(w.first);
+      if (interrupted)
+        return false;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::add_wallet(const std::string &id, std::unique_ptr<wallet2> wal)
+  {
+    if (m_block_cache)
+      wal->set_block_cache(m_block_cache);
+    std::unique_ptr<snapshot_publisher> publisher(new snapshot_publisher(*this, id));
+    wal->callback(publisher.get());
+    {
+      boost::lock_guard<boost::mutex> lock(m_wallets_mutex);
+      hosted_wallet &hosted = m_wallets[id];
+      hosted.publisher = std::move(publisher);
+      hosted.wallet = std::move(wal);
+      hosted.snapshot.reset();
+      m_default_wallet = id;
+    }
+    publish_snapshot(id);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::host_wallet(const std::string &id, std::unique_ptr<wallet2> wal, epee::json_rpc::error& er)
+  {
+    // a single wallet server closes the open wallet for the new one, as it always did
+    std::vector<std::string> to_close;
+    for (const auto &w: m_wallets)
+      if (w.first == id || m_max_wallets <= 1)
+        to_close.push_back(w.first);
+    if (to_close.empty() && m_wallets.size() >= m_max_wallets)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_TOO_MANY_WALLETS;
+      er.message = "Too many open wallets, close one first";
+      return false;
+    }
+    for (const std::string &i: to_close)
+      if (!close_wallet(i, er))
+        return false;
+
+    m_wallet = wal.get();
+    add_wallet(id, std::move(wal));
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::close_wallet(const std::string &id, epee::json_rpc::error& er)
+  {
+    const auto i = m_wallets.find(id);
+    if (i == m_wallets.end())
+      return not_open(er);
+    try
+    {
+      i->second.wallet->store();
+    }
+    catch (const std::exception& e)
+    {
+      handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
+      return false;
+    }
+    if (m_wallet == i->second.wallet.get())
+      m_wallet = NULL;
+    boost::lock_guard<boost::mutex> lock(m_wallets_mutex);
+    m_wallets.erase(i);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::run()
+  {
+    m_stop = false;
+    m_worker_stop = false;
+    m_worker = boost::thread([this](){ worker(); });
+    if (!m_daemon_zmq_pub.empty())
+      m_notifier = boost::thread([this](){ notifier(); });
     m_net_server.add_idle_handler([this](){
       if (m_stop.load(std::memory_order_relaxed))
       {
@@ -136,18 +480,28 @@ namespace tools
       return true;
     }, 500);
 
-    //DO NOT START THIS SERVER IN MORE THEN 1 THREADS WITHOUT REFACTORING
-    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(1, true);
+    const bool r = epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(m_rpc_threads, true);
+
+    {
+      boost::lock_guard<boost::mutex> lock(m_jobs_mutex);
+      m_worker_stop = true;
+      if (m_refreshing)
+        m_refreshing->stop();
+      m_jobs_cond.notify_all();
+    }
+    m_worker.join();
+    if (m_notifier.joinable())
+      m_notifier.join();
+    return r;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::stop()
   {
-    if (m_wallet)
-    {
-      m_wallet->store();
-      delete m_wallet;
-      m_wallet = NULL;
-    }
+    for (const auto &w: m_wallets)
+      w.second.wallet->store();
+    boost::lock_guard<boost::mutex> lock(m_wallets_mutex);
+    m_wallets.clear();
+    m_wallet = NULL;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::init(const boost::program_options::variables_map *vm)
@@ -162,6 +516,9 @@ namespace tools
     std::string bind_port = command_line::get_arg(*m_vm, arg_rpc_bind_port);
     const bool disable_auth = command_line::get_arg(*m_vm, arg_disable_rpc_login);
     m_restricted = command_line::get_arg(*m_vm, arg_restricted);
+    m_max_wallets = command_line::get_arg(*m_vm, arg_max_wallets);
+    m_rpc_threads = std::max<size_t>(command_line::get_arg(*m_vm, arg_rpc_threads), 1);
+    m_daemon_zmq_pub = command_line::get_arg(*m_vm, arg_daemon_zmq_pub);
     if (!command_line::is_arg_defaulted(*m_vm, arg_wallet_dir))
     {
       if (!command_line::is_arg_defaulted(*m_vm, wallet_args::arg_wallet_file()))
@@ -170,6 +527,8 @@ namespace tools
         return false;
       }
       m_wallet_dir = command_line::get_arg(*m_vm, arg_wallet_dir);
+      if (m_max_wallets > 1)
+        m_block_cache = std::make_shared<wallet2::block_cache>();
 #ifdef _WIN32
 #define MKDIR(path, mode)    mkdir(path)
 #else
@@ -335,8 +694,25 @@ namespace tools
     set_confirmations(entry, m_wallet->get_blockchain_current_height(), m_wallet->get_last_block_reward());
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    if (query_info.m_URI != "/metrics")
+      return false;
+    response_info.m_body = tools::get_perf_metrics_prometheus("antd_wallet");
+    response_info.m_body += tools::get_alloc_metrics_prometheus("antd_wallet");
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getbalance(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    snapshot_request &sr = current_snapshot_request();
+    if (sr.snapshot)
+    {
+      sr.missed = !balance_from_snapshot(*sr.snapshot, req, res);
+      return true;
+    }
     if (!m_wallet) return not_open(er);
     try
     {
@@ -374,6 +750,39 @@ namespace tools
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::balance_from_snapshot(const wallet_snapshot &snapshot, const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res) const
+  {
+    // anything not in the snapshot is left to on_getbalance on the wallet thread
+    if (req.account_index >= snapshot.accounts.size())
+      return false;
+    const wallet_snapshot::account &account = snapshot.accounts[req.account_index];
+    res.balance = account.balance;
+    res.unlocked_balance = account.unlocked_balance;
+    res.multisig_import_needed = snapshot.multisig_import_needed;
+    std::set<uint32_t> address_indices = req.address_indices;
+    if (address_indices.empty())
+    {
+      for (const auto& i : account.balance_per_subaddress)
+        address_indices.insert(i.first);
+    }
+    const auto get = [](const std::map<uint32_t, uint64_t> &m, uint32_t i) { const auto e = m.find(i); return e == m.end() ? 0 : e->second; };
+    res.per_subaddress.clear();
+    for (uint32_t i : address_indices)
+    {
+      if (i >= account.labels.size() || i >= account.addresses->size())
+        return false;
+      wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info info;
+      info.address_index = i;
+      info.address = (*account.addresses)[i];
+      info.balance = get(account.balance_per_subaddress, i);
+      info.unlocked_balance = get(account.unlocked_balance_per_subaddress, i);
+      info.label = account.labels[i];
+      info.num_unspent_outputs = get(account.unspent_outputs_per_subaddress, i);
+      res.per_subaddress.push_back(info);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getaddress(const wallet_rpc::COMMAND_RPC_GET_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
     if (!m_wallet) return not_open(er);
@@ -604,6 +1013,12 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getheight(const wallet_rpc::COMMAND_RPC_GET_HEIGHT::request& req, wallet_rpc::COMMAND_RPC_GET_HEIGHT::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    const snapshot_request &sr = current_snapshot_request();
+    if (sr.snapshot)
+    {
+      res.height = sr.snapshot->height;
+      return true;
+    }
     if (!m_wallet) return not_open(er);
     try
     {
@@ -1708,21 +2123,21 @@ namespace tools
       available = false;
     }
 
-    wallet2::transfer_container transfers;
-    m_wallet->get_transfers(transfers);
-
-    bool transfers_found = false;
-    for (const auto& td : transfers)
+    uint64_t skipped = 0;
+    for (size_t n = 0; n < m_wallet->get_num_transfer_details(); ++n)
     {
+      const wallet2::transfer_details &td = m_wallet->get_transfer_details(n);
       if (!filter || available != td.m_spent)
       {
         if (req.account_index != td.m_subaddr_index.major || (!req.subaddr_indices.empty() && req.subaddr_indices.count(td.m_subaddr_index.minor) == 0))
           continue;
-        if (!transfers_found)
+        if (skipped < req.offset)
         {
-          transfers_found = true;
+          ++skipped;
+          continue;
         }
-        auto txBlob = t_serializable_object_to_blob(td.m_tx);
+        if (req.limit && res.transfers.size() >= req.limit)
+          break;
         wallet_rpc::transfer_details rpc_transfers;
         rpc_transfers.amount       = td.amount();
         rpc_transfers.spent        = td.m_spent;
@@ -2292,7 +2707,7 @@ namespace tools
     if (req.in)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-      m_wallet->get_payments(payments, min_height, max_height, req.account_index, req.subaddr_indices);
+      m_wallet->get_payments(payments, min_height, max_height, req.account_index, req.subaddr_indices, req.offset, req.limit);
       for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.in.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.in.back(), i->second.m_tx_hash, i->first, i->second);
@@ -2302,7 +2717,7 @@ namespace tools
     if (req.out)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-      m_wallet->get_payments_out(payments, min_height, max_height, req.account_index, req.subaddr_indices);
+      m_wallet->get_payments_out(payments, min_height, max_height, req.account_index, req.subaddr_indices, req.offset, req.limit);
       for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.out.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.out.back(), i->first, i->second);
@@ -2913,21 +3328,7 @@ namespace tools
       return false;
     }
 
-    if (m_wallet)
-    {
-      try
-      {
-        m_wallet->store();
-      }
-      catch (const std::exception& e)
-      {
-        handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
-        return false;
-      }
-      delete m_wallet;
-    }
-    m_wallet = wal.release();
-    return true;
+    return host_wallet(req.filename, std::move(wal), er);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_open_wallet(const wallet_rpc::COMMAND_RPC_OPEN_WALLET::request& req, wallet_rpc::COMMAND_RPC_OPEN_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
@@ -2983,39 +3384,17 @@ namespace tools
       return false;
     }
 
-    if (m_wallet)
-    {
-      try
-      {
-        m_wallet->store();
-      }
-      catch (const std::exception& e)
-      {
-        handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
-        return false;
-      }
-      delete m_wallet;
-    }
-    m_wallet = wal.release();
-    return true;
+    return host_wallet(req.filename, std::move(wal), er);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_close_wallet(const wallet_rpc::COMMAND_RPC_CLOSE_WALLET::request& req, wallet_rpc::COMMAND_RPC_CLOSE_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
     if (!m_wallet) return not_open(er);
 
-    try
-    {
-      m_wallet->store();
-    }
-    catch (const std::exception& e)
-    {
-      handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
-      return false;
-    }
-    delete m_wallet;
-    m_wallet = NULL;
-    return true;
+    for (const auto &w: m_wallets)
+      if (w.second.wallet.get() == m_wallet)
+        return close_wallet(w.first, er);
+    return not_open(er);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_change_wallet_password(const wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD::request& req, wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD::response& res, epee::json_rpc::error& er, const connection_context *ctx)
@@ -3306,20 +3685,8 @@ namespace tools
       return false;
     }
 
-    if (m_wallet)
-    {
-      try
-      {
-        m_wallet->store();
-      }
-      catch (const std::exception &e)
-      {
-        handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
-        return false;
-      }
-      delete m_wallet;
-    }
-    m_wallet = wal.release();
+    if (!host_wallet(req.filename, std::move(wal), er))
+      return false;
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     res.info = "Wallet has been restored successfully.";
     return true;
@@ -4129,6 +4496,9 @@ int main(int argc, char** argv) {
   command_line::add_arg(desc_params, arg_from_json);
   command_line::add_arg(desc_params, arg_wallet_dir);
   command_line::add_arg(desc_params, arg_prompt_for_password);
+  command_line::add_arg(desc_params, arg_max_wallets);
+  command_line::add_arg(desc_params, arg_rpc_threads);
+  command_line::add_arg(desc_params, arg_daemon_zmq_pub);
 
   daemonizer::init_options(hidden_options, desc_params);
   desc_params.add(hidden_options);
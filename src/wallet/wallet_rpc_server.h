@@ -33,6 +33,12 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <string>
 #include "common/util.h"
 #include "net/http_server_impl_base.h"
@@ -65,9 +71,55 @@ namespace tools
 
   private:
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    // balances and height as of the last refresh batch or wallet request, so that
+    // get_balance and get_height do not wait behind a refresh or a transfer
+    struct wallet_snapshot
+    {
+      struct account
+      {
+        uint64_t balance;
+        uint64_t unlocked_balance;
+        std::map<uint32_t, uint64_t> balance_per_subaddress;
+        std::map<uint32_t, uint64_t> unlocked_balance_per_subaddress;
+        std::map<uint32_t, uint64_t> unspent_outputs_per_subaddress;
+        std::vector<std::string> labels;
+        std::shared_ptr<const std::vector<std::string>> addresses; // shared with the previous snapshot
+      };
+      uint64_t height;
+      bool multisig_import_needed;
+      std::vector<account> accounts;
+    };
+
+    // the snapshot the request being handled on this thread is answered from, if any
+    struct snapshot_request
+    {
+      const wallet_snapshot *snapshot;
+      bool missed; // set by the handler if the snapshot can't answer it
+    };
+
+    class snapshot_publisher: public i_wallet2_callback
+    {
+    public:
+      snapshot_publisher(wallet_rpc_server &server, const std::string &id): m_server(server), m_id(id) {}
+      void on_blocks_applied(uint64_t height) override { m_server.publish_snapshot(m_id); }
+
+    private:
+      wallet_rpc_server &m_server;
+      std::string m_id;
+    };
+
+    struct hosted_wallet
+    {
+      std::unique_ptr<snapshot_publisher> publisher;
+      std::unique_ptr<wallet2> wallet;
+      std::shared_ptr<const wallet_snapshot> snapshot;
+    };
+
+    // forward http requests to uri map, /wallet/<id>/... to the hosted wallet <id>
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
 
     BEGIN_URI_MAP2()
+      MAP_URI2("/metrics", on_metrics)
       BEGIN_JSON_RPC_MAP("/json_rpc")
         MAP_JON_RPC_WE("get_balance",        on_getbalance,         wallet_rpc::COMMAND_RPC_GET_BALANCE)
         MAP_JON_RPC_WE("get_address",        on_getaddress,         wallet_rpc::COMMAND_RPC_GET_ADDRESS)
@@ -161,6 +213,9 @@ namespace tools
       END_JSON_RPC_MAP()
     END_URI_MAP2()
 
+      // Prometheus text exposition of the perf timers
+      bool on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx = NULL);
+
       //json_rpc
       bool on_getbalance(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_getaddress(const wallet_rpc::COMMAND_RPC_GET_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
@@ -252,6 +307,17 @@ namespace tools
       void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const tools::wallet2::unconfirmed_transfer_details &pd);
       void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &payment_id, const tools::wallet2::pool_payment_details &pd);
       bool not_open(epee::json_rpc::error& er);
+      bool host_wallet(const std::string &id, std::unique_ptr<wallet2> wal, epee::json_rpc::error& er);
+      void add_wallet(const std::string &id, std::unique_ptr<wallet2> wal);
+      bool close_wallet(const std::string &id, epee::json_rpc::error& er);
+      void publish_snapshot(const std::string &id);
+      bool balance_from_snapshot(const wallet_snapshot &snapshot, const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res) const;
+      bool is_snapshot_request(const epee::net_utils::http::http_request_info& query_info) const;
+      static snapshot_request &current_snapshot_request();
+      void run_on_worker(const std::function<void()> &f);
+      void worker();
+      void notifier();
+      bool refresh_wallets();
       void handle_rpc_exception(const std::exception_ptr& e, epee::json_rpc::error& er, int default_error_code);
 
       template<typename Ts, typename Tu>
@@ -261,7 +327,25 @@ namespace tools
 
       bool validate_transfer(const std::list<wallet_rpc::transfer_destination>& destinations, const std::string& payment_id, std::vector<cryptonote::tx_destination_entry>& dsts, std::vector<uint8_t>& extra, bool at_least_one_destination, epee::json_rpc::error& er);
 
-      wallet2 *m_wallet;
+      // Everything that uses a wallet runs on the worker thread, one request or refresh at a time.
+      // The http threads only look up snapshots, under m_wallets_mutex, which the worker holds
+      // when it changes m_wallets, m_default_wallet or a snapshot.
+      wallet2 *m_wallet; // the one the request being handled is for
+      std::map<std::string, hosted_wallet> m_wallets; // by file name
+      std::string m_default_wallet; // the one plain /json_rpc is for
+      boost::mutex m_wallets_mutex;
+      boost::thread m_worker;
+      boost::mutex m_jobs_mutex;
+      boost::condition_variable m_jobs_cond;
+      std::deque<std::function<void()>> m_jobs;
+      wallet2 *m_refreshing; // asked to stop when a request is queued
+      bool m_worker_stop;
+      boost::thread m_notifier;
+      std::string m_daemon_zmq_pub; // empty: poll the daemon on a timer only
+      bool m_refresh_requested; // set by the notifier, under m_jobs_mutex
+      size_t m_rpc_threads;
+      size_t m_max_wallets;
+      std::shared_ptr<wallet2::block_cache> m_block_cache;
       std::string m_wallet_dir;
       tools::private_file rpc_login_file;
       std::atomic<bool> m_stop;
@@ -74,3 +74,4 @@
 #define WALLET_RPC_ERROR_CODE_SIGNED_SUBMISSION      -41
 #define WALLET_RPC_ERROR_CODE_SIGN_UNSIGNED          -42
 #define WALLET_RPC_ERROR_CODE_NON_DETERMINISTIC      -43
+#define WALLET_RPC_ERROR_CODE_TOO_MANY_WALLETS       -44
@@ -32,6 +32,7 @@
 
 #include <vector>
 #include <iostream>
+#include <chrono>
 #include <stdint.h>
 
 #include <boost/archive/binary_oarchive.hpp>
@@ -784,6 +785,14 @@ struct get_test_options {
   };
 };
 
+//--------------------------------------------------------------------------
+// data directory the replaying cores keep their fake chain in, so that tests
+// running in parallel processes do not share a database; empty for the default
+inline std::string &replay_data_dir()
+{
+  static std::string dir;
+  return dir;
+}
 //--------------------------------------------------------------------------
 template<class t_test_class>
 inline bool do_replay_events(std::vector<test_event_entry>& events)
@@ -791,9 +800,15 @@ inline bool do_replay_events(std::vector<test_event_entry>& events)
   boost::program_options::options_description desc("Allowed options");
   cryptonote::core::init_options(desc);
   boost::program_options::variables_map vm;
+  std::vector<std::string> args;
+  if (!replay_data_dir().empty())
+  {
+    args.push_back("--data-dir");
+    args.push_back(replay_data_dir());
+  }
   bool r = command_line::handle_error_helper(desc, [&]()
   {
-    boost::program_options::store(boost::program_options::basic_parsed_options<char>(&desc), vm);
+    boost::program_options::store(boost::program_options::command_line_parser(args).options(desc).run(), vm);
     boost::program_options::notify(vm);
     return true;
   });
@@ -1011,6 +1026,13 @@ cryptonote::transaction make_deregistration_tx(const std::vector<test_event_entr
     std::cout << #genclass << std::endl;                                                                   \
   else if (filter.empty() || boost::regex_match(std::string(#genclass), match, boost::regex(filter)))      \
   {                                                                                                        \
+    if (schedule_tests)                                                                                    \
+    {                                                                                                      \
+      scheduled_tests.push_back(#genclass);                                                                \
+    }                                                                                                      \
+    else                                                                                                   \
+    {                                                                                                      \
+    const auto test_start = std::chrono::steady_clock::now();                                              \
     std::vector<test_event_entry> events;                                                                  \
     ++tests_count;                                                                                         \
     bool generated = false;                                                                                \
@@ -1036,6 +1058,9 @@ cryptonote::transaction make_deregistration_tx(const std::vector<test_event_entr
       MERROR("#TEST# Failed " << #genclass);                                                               \
       failed_tests.push_back(#genclass);                                                                   \
     }                                                                                                      \
+    test_timings.emplace_back(#genclass, std::chrono::duration_cast<std::chrono::milliseconds>(            \
+        std::chrono::steady_clock::now() - test_start).count());                                           \
+    }                                                                                                      \
   }
 
 #define CALL_TEST(test_name, function)                                                                     \
@@ -34,6 +34,12 @@
 #include "common/command_line.h"
 #include "transaction_tests.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <boost/filesystem.hpp>
+
 namespace po = boost::program_options;
 
 namespace
@@ -46,6 +52,45 @@ namespace
   const command_line::arg_descriptor<bool>        arg_test_transactions           = {"test_transactions", ""};
   const command_line::arg_descriptor<std::string> arg_filter                      = { "filter", "Regular expression filter for which tests to run" };
   const command_line::arg_descriptor<bool>        arg_list_tests                  = {"list_tests", ""};
+  const command_line::arg_descriptor<unsigned>    arg_jobs                        = {"jobs", "Run tests in this many parallel processes", 1};
+  const command_line::arg_descriptor<std::string> arg_replay_data_dir             = {"replay_data_dir", "Data directory for the core replaying the events", ""};
+
+  typedef std::vector<std::pair<std::string, uint64_t>> test_timings_t;
+
+  // runs each test in its own child process, with its own fake chain
+  // directory, at most jobs at a time
+  void run_tests_in_processes(const std::string &self, const std::vector<std::string> &tests, unsigned jobs, bool full_nodes,
+      std::vector<std::string> &failed_tests, test_timings_t &test_timings)
+  {
+    const boost::filesystem::path base = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("core_tests-%%%%-%%%%-%%%%");
+    std::atomic<size_t> next(0);
+    std::mutex results_lock;
+    std::vector<std::thread> workers;
+    for (unsigned n = 0; n < std::min<size_t>(jobs, tests.size()); ++n)
+    {
+      workers.emplace_back([&]() {
+        for (size_t i = next++; i < tests.size(); i = next++)
+        {
+          const std::string &test = tests[i];
+          std::string cmd = "\"" + self + "\" --filter=" + test + " --replay_data_dir=\"" + (base / test).string() + "\"";
+          if (full_nodes)
+            cmd += " --full_nodes";
+          const auto start = std::chrono::steady_clock::now();
+          const int ret = std::system(cmd.c_str());
+          const uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+          std::lock_guard<std::mutex> lock(results_lock);
+          if (ret != 0)
+            failed_tests.push_back(test);
+          test_timings.emplace_back(test, ms);
+        }
+      });
+    }
+    for (std::thread &worker: workers)
+      worker.join();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(base, ec);
+    std::sort(failed_tests.begin(), failed_tests.end());
+  }
 }
 
 int main(int argc, char* argv[])
@@ -68,6 +113,8 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_options, arg_test_transactions);
   command_line::add_arg(desc_options, arg_filter);
   command_line::add_arg(desc_options, arg_list_tests);
+  command_line::add_arg(desc_options, arg_jobs);
+  command_line::add_arg(desc_options, arg_replay_data_dir);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -92,6 +139,10 @@ int main(int argc, char* argv[])
   std::vector<std::string> failed_tests;
   std::string tests_folder = command_line::get_arg(vm, arg_test_data_path);
   bool list_tests = false;
+  bool schedule_tests = false;
+  std::vector<std::string> scheduled_tests;
+  test_timings_t test_timings;
+  replay_data_dir() = command_line::get_arg(vm, arg_replay_data_dir);
   if (command_line::get_arg(vm, arg_generate_test_data))
   {
     GENERATE("chain001.dat", gen_simple_chain_001);
@@ -107,6 +158,8 @@ int main(int argc, char* argv[])
   else
   {
     list_tests = command_line::get_arg(vm, arg_list_tests);
+    const unsigned jobs = command_line::get_arg(vm, arg_jobs);
+    schedule_tests = !list_tests && jobs > 1;
     const bool run_all = !command_line::get_arg(vm, arg_full_nodes);
 
     if (run_all) {
@@ -296,6 +349,12 @@ int main(int argc, char* argv[])
       GENERATE_AND_PLAY(gen_multisig_tx_valid_48_1_234_many_inputs);
 #endif
 
+    if (schedule_tests)
+    {
+      tests_count = scheduled_tests.size();
+      run_tests_in_processes(argv[0], scheduled_tests, jobs, command_line::get_arg(vm, arg_full_nodes), failed_tests, test_timings);
+    }
+
     el::Level level = (failed_tests.empty() ? el::Level::Info : el::Level::Error);
     if (!list_tests)
     {
@@ -303,6 +362,13 @@ int main(int argc, char* argv[])
       MLOG(level, "  Test run: " << tests_count);
       MLOG(level, "  Failures: " << failed_tests.size());
     }
+    if (test_timings.size() > 1)
+    {
+      std::sort(test_timings.begin(), test_timings.end(), [](const test_timings_t::value_type &a, const test_timings_t::value_type &b) { return a.second > b.second; });
+      MLOG(el::Level::Info, "SLOWEST TESTS:");
+      for (size_t n = 0; n < std::min<size_t>(test_timings.size(), 10); ++n)
+        MLOG(el::Level::Info, "  " << test_timings[n].second << " ms  " << test_timings[n].first);
+    }
     if (!failed_tests.empty())
     {
       MLOG(level, "FAILED TESTS:");
@@ -142,6 +142,18 @@ int main(int argc, char *argv[]) {
       if (expected1 != actual1 || (expected1 && expected2 != actual2)) {
         goto error;
       }
+      // the batched call (CPU path for a single key) and any registered
+      // accelerator must agree bit for bit with the single call
+      generate_key_derivations(&key1, 1, key2, &actual2, &actual1);
+      if (expected1 != actual1 || (expected1 && expected2 != actual2)) {
+        goto error;
+      }
+      if (batch_backend *backend = get_batch_backend()) {
+        if (backend->generate_key_derivations(&key1, 1, key2, &actual2, &actual1) &&
+            (expected1 != actual1 || (expected1 && expected2 != actual2))) {
+          goto error;
+        }
+      }
     } else if (cmd == "derive_public_key") {
       key_derivation derivation;
       size_t output_index;
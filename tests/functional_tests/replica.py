@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2018 The Monero Project
+# 
+# All rights reserved.
+# 
+# Redistribution and use in source and binary forms, with or without modification, are
+# permitted provided that the following conditions are met:
+# 
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+#    conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list
+#    of conditions and the following disclaimer in the documentation and/or other
+#    materials provided with the distribution.
+# 
+# 3. Neither the name of the copyright holder nor the names of its contributors may be
+#    used to endorse or promote products derived from this software without specific
+#    prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+# THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+# STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+# THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Test a read replica daemon
+
+Test the following:
+    - the replica follows blocks generated on the primary
+    - RPCs that would write to the DB, the pool or the network are refused
+
+"""
+
+import time
+import requests
+
+from test_framework.daemon import Daemon
+from test_framework.rpc import JSONRPC
+
+PRIMARY_PORT = 18081
+REPLICA_PORT = 18085
+ADDRESS = '42ey1afDFnn4886T7196doS9GPMzexD9gXpsZJDwVjeRVdFCSoHnv7KPbBeGpzJBzHRCAs9UxqeoyFQMYbqSWYTfJJQAWDm'
+REFUSED = 'Not available on a read replica, use the primary daemon'
+
+class ReplicaTest():
+    def run_test(self):
+        self._test_follows_primary()
+        self._test_write_rpcs_refused()
+
+    def _test_follows_primary(self):
+        print('Test replica follows the primary')
+
+        primary = Daemon(port=PRIMARY_PORT)
+        replica = Daemon(port=REPLICA_PORT)
+        res = primary.generateblocks(ADDRESS, 3)
+        height = res['height'] + 1
+
+        for i in range(30):
+            if replica.get_info()['height'] == height:
+                break
+            time.sleep(1)
+        assert replica.get_info()['height'] == height
+        assert replica.get_info()['top_block_hash'] == primary.get_info()['top_block_hash']
+
+    def _test_write_rpcs_refused(self):
+        print('Test write RPCs are refused on the replica')
+
+        json_rpc = JSONRPC('http://127.0.0.1:{port}/json_rpc'.format(port=REPLICA_PORT))
+        for method, params in [
+                ('getblocktemplate', {'wallet_address': ADDRESS, 'reserve_size': 1}),
+                ('submitblock', ['00']),
+                ('relay_tx', {'txids': ['00' * 32]}),
+                ('flush_txpool', {}),
+                ('prune_blockchain', {'check': False}),
+            ]:
+            res = json_rpc.send_request({'method': method, 'params': params, 'jsonrpc': '2.0', 'id': '0'})
+            assert res['status'] == REFUSED, (method, res)
+
+        for path, params in [
+                ('/send_raw_transaction', {'tx_as_hex': '00'}),
+                ('/start_mining', {'miner_address': ADDRESS, 'threads_count': 1}),
+                ('/pop_blocks', {'nblocks': 1}),
+            ]:
+            res = requests.post('http://127.0.0.1:{port}{path}'.format(port=REPLICA_PORT, path=path), json=params).json()
+            assert res['status'] == REFUSED, (path, res)
+
+
+if __name__ == '__main__':
+    ReplicaTest().run_test()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2018 The Monero Project
+# 
+# All rights reserved.
+# 
+# Redistribution and use in source and binary forms, with or without modification, are
+# permitted provided that the following conditions are met:
+# 
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+#    conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list
+#    of conditions and the following disclaimer in the documentation and/or other
+#    materials provided with the distribution.
+# 
+# 3. Neither the name of the copyright holder nor the names of its contributors may be
+#    used to endorse or promote products derived from this software without specific
+#    prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+# THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+# STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+# THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Test the RPC response cache
+
+Test the following:
+    - get_info, get_last_block_header, get_fee_estimate and hard_fork_info
+      answer the same while the chain does not move
+    - a new block replaces every cached response
+    - responses cached for one request parameter are not served for another
+
+"""
+
+from test_framework.daemon import Daemon
+
+ADDRESS = '42ey1afDFnn4886T7196doS9GPMzexD9gXpsZJDwVjeRVdFCSoHnv7KPbBeGpzJBzHRCAs9UxqeoyFQMYbqSWYTfJJQAWDm'
+CHAIN_FIELDS = ['height', 'top_block_hash', 'difficulty', 'cumulative_difficulty', 'tx_count', 'tx_pool_size', 'block_weight_limit', 'block_weight_median']
+
+class RPCCacheTest():
+    def run_test(self):
+        self._test_cached_until_new_block()
+        self._test_keyed_on_parameters()
+
+    def _chain_info(self, daemon):
+        res = daemon.get_info()
+        return {field: res[field] for field in CHAIN_FIELDS}
+
+    def _test_cached_until_new_block(self):
+        print('Test cached responses follow the chain top')
+
+        daemon = Daemon()
+        info = self._chain_info(daemon)
+        header = daemon.get_last_block_header()['block_header']
+        assert info == self._chain_info(daemon)
+        assert header == daemon.get_last_block_header()['block_header']
+        assert daemon.get_fee_estimate() == daemon.get_fee_estimate()
+        assert daemon.hard_fork_info()['version'] == daemon.hard_fork_info()['version']
+
+        daemon.generateblocks(ADDRESS, 1)
+        new_info = self._chain_info(daemon)
+        assert new_info['height'] == info['height'] + 1
+        assert new_info['top_block_hash'] != info['top_block_hash']
+        assert new_info['cumulative_difficulty'] == info['cumulative_difficulty'] + 1
+
+        new_header = daemon.get_last_block_header()['block_header']
+        assert new_header['height'] == header['height'] + 1
+        assert new_header['hash'] == new_info['top_block_hash']
+        assert new_header['prev_hash'] == header['hash']
+
+    def _test_keyed_on_parameters(self):
+        print('Test cached responses are keyed on the request')
+
+        daemon = Daemon()
+        header = daemon.get_last_block_header(fill_pow_hash=False)['block_header']
+        assert header['pow_hash'] == ''
+        pow_header = daemon.get_last_block_header(fill_pow_hash=True)['block_header']
+        assert pow_header['hash'] == header['hash']
+        assert len(pow_header['pow_hash']) == 64
+        assert daemon.get_last_block_header(fill_pow_hash=False)['block_header']['pow_hash'] == ''
+        assert daemon.get_last_block_header(fill_pow_hash=True)['block_header']['pow_hash'] == pow_header['pow_hash']
+
+        fee = daemon.get_fee_estimate(grace_blocks=0)['fee']
+        grace_fee = daemon.get_fee_estimate(grace_blocks=10)['fee']
+        assert daemon.get_fee_estimate(grace_blocks=0)['fee'] == fee
+        assert daemon.get_fee_estimate(grace_blocks=10)['fee'] == grace_fee
+
+
+if __name__ == '__main__':
+    RPCCacheTest().run_test()
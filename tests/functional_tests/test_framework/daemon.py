@@ -83,6 +83,28 @@ class Daemon(object):
         }    
         return self.rpc.send_request(get_info)    
 
+    def get_last_block_header(self, fill_pow_hash=False):
+        get_last_block_header = {
+                'method': 'get_last_block_header',
+                'params': {
+                    'fill_pow_hash': fill_pow_hash
+                },
+                'jsonrpc': '2.0', 
+                'id': '0'
+        }    
+        return self.rpc.send_request(get_last_block_header)    
+
+    def get_fee_estimate(self, grace_blocks=0):
+        get_fee_estimate = {
+                'method': 'get_fee_estimate',
+                'params': {
+                    'grace_blocks': grace_blocks
+                },
+                'jsonrpc': '2.0', 
+                'id': '0'
+        }    
+        return self.rpc.send_request(get_fee_estimate)    
+
     def hard_fork_info(self):
         hard_fork_info = {
                 'method': 'hard_fork_info',
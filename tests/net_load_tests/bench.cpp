@@ -0,0 +1,835 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+// Reproducible levin relay/sync benchmark.
+//
+// A hub node and N peer connections run in one process over loopback. All
+// payloads are real cryptonote protocol messages so that the serialized sizes
+// match what a daemon puts on the wire. Scenarios:
+//
+//   relay   - hub fans a fluffy block out to every peer (shared send buffers)
+//   gossip  - peers flood transactions, hub relays each one to all other peers
+//   fluffy  - hub announces fluffy blocks, peers request the txs they miss
+//   sync    - every peer downloads a chain segment span by span
+//
+// The sync segment is read from a blockchain export file when given, and is
+// generated from the seed otherwise.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "include_base_utils.h"
+#include "misc_log_ex.h"
+#include "storages/portable_storage_template_helper.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "blockchain_utilities/bootstrap_serialization.h"
+#include "serialization/binary_utils.h"
+#include "net_load_tests.h"
+
+namespace po = boost::program_options;
+
+using namespace net_load_tests;
+
+namespace
+{
+  const char hub_port[] = "36232";
+  const char peer_port[] = "36233";
+  const uint32_t blockchain_raw_magic = 0x28721586;
+  const size_t connection_timeout = 5000;
+
+  enum scenario_t
+  {
+    scenario_relay,
+    scenario_gossip,
+    scenario_fluffy,
+    scenario_sync,
+  };
+
+  const char *scenario_name(scenario_t scenario)
+  {
+    switch (scenario)
+    {
+      case scenario_relay: return "relay";
+      case scenario_gossip: return "gossip";
+      case scenario_fluffy: return "fluffy";
+      case scenario_sync: return "sync";
+    }
+    return "unknown";
+  }
+
+  uint64_t now_us()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  size_t wire_size(size_t payload)
+  {
+    return payload + sizeof(epee::levin::bucket_head2);
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  class bench_stats
+  {
+  public:
+    void reset(size_t slots)
+    {
+      m_sent_at.reset(new std::atomic<uint64_t>[slots]);
+      for (size_t i = 0; i < slots; ++i)
+        m_sent_at[i] = 0;
+      m_slots = slots;
+      m_messages = 0;
+      m_bytes = 0;
+      m_delivered = 0;
+      m_errors = 0;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_latencies.clear();
+    }
+
+    void mark_sent(uint64_t seq)
+    {
+      if (seq < m_slots)
+        m_sent_at[seq] = now_us();
+    }
+
+    void sent(size_t payload, size_t copies = 1)
+    {
+      m_messages += copies;
+      m_bytes += wire_size(payload) * copies;
+    }
+
+    void delivered(uint64_t seq)
+    {
+      const uint64_t now = now_us();
+      if (seq < m_slots && m_sent_at[seq])
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latencies.push_back(now - m_sent_at[seq]);
+      }
+      ++m_delivered;
+    }
+
+    void error() { ++m_errors; }
+
+    uint64_t messages() const { return m_messages; }
+    uint64_t bytes() const { return m_bytes; }
+    uint64_t delivered_count() const { return m_delivered; }
+    uint64_t errors() const { return m_errors; }
+
+    std::vector<uint64_t> latencies()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::vector<uint64_t> sorted = m_latencies;
+      std::sort(sorted.begin(), sorted.end());
+      return sorted;
+    }
+
+  private:
+    std::unique_ptr<std::atomic<uint64_t>[]> m_sent_at;
+    size_t m_slots = 0;
+    std::atomic<uint64_t> m_messages{0};
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_delivered{0};
+    std::atomic<uint64_t> m_errors{0};
+    std::mutex m_mutex;
+    std::vector<uint64_t> m_latencies;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  struct bench_options
+  {
+    size_t peers;
+    size_t messages;
+    size_t tx_size;
+    size_t block_txs;
+    unsigned known_percent;
+    size_t span_blocks;
+    size_t segment_blocks;
+    uint64_t seed;
+    size_t timeout_ms;
+  };
+
+  struct segment_entry
+  {
+    crypto::hash id;
+    cryptonote::block_complete_entry entry;
+  };
+
+  struct bench_context
+  {
+    bench_options options;
+    std::atomic<int> scenario{scenario_relay};
+    bench_stats stats;
+
+    // fluffy: txs every announced block refers to, known to the hub
+    std::vector<cryptonote::blobdata> pool;
+    std::vector<crypto::hash> pool_hashes;
+
+    // sync: the chain segment served by the hub
+    std::vector<segment_entry> segment;
+    std::unordered_map<crypto::hash, size_t> segment_index;
+
+    // peer side connection id -> peer index, filled before any scenario runs
+    std::map<boost::uuids::uuid, size_t> peer_index;
+
+    size_t spans() const { return (segment.size() + options.span_blocks - 1) / options.span_blocks; }
+
+    std::vector<uint64_t> missing_txs(size_t peer, uint64_t seq) const
+    {
+      std::mt19937_64 rng(options.seed ^ (seq * 0x9e3779b97f4a7c15ull) ^ (peer + 1));
+      std::vector<uint64_t> missing;
+      for (size_t i = 0; i < pool.size(); ++i)
+        if (rng() % 100 >= options.known_percent)
+          missing.push_back(i);
+      return missing;
+    }
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  cryptonote::blobdata make_tx_blob(uint64_t seq, size_t size, std::mt19937_64 &rng)
+  {
+    cryptonote::blobdata blob(std::max<size_t>(size, sizeof(seq)), '\0');
+    for (size_t i = 0; i < blob.size(); ++i)
+      blob[i] = static_cast<char>(rng());
+    for (size_t i = 0; i < sizeof(seq); ++i)
+      blob[i] = static_cast<char>(seq >> (8 * i));
+    return blob;
+  }
+
+  uint64_t read_tx_seq(const cryptonote::blobdata &blob)
+  {
+    uint64_t seq = 0;
+    for (size_t i = 0; i < sizeof(seq) && i < blob.size(); ++i)
+      seq |= static_cast<uint64_t>(static_cast<uint8_t>(blob[i])) << (8 * i);
+    return seq;
+  }
+
+  cryptonote::block make_block(uint64_t height, const crypto::hash &prev_id, const std::vector<crypto::hash> &tx_hashes)
+  {
+    cryptonote::block b;
+    b.timestamp = 1500000000 + height * DIFFICULTY_TARGET_V2;
+    b.prev_id = prev_id;
+    b.nonce = static_cast<uint32_t>(height);
+    b.miner_tx.version = cryptonote::transaction::version_1;
+    cryptonote::txin_gen in;
+    in.height = height;
+    b.miner_tx.vin.push_back(in);
+    cryptonote::txout_to_key out;
+    const crypto::hash key = crypto::cn_fast_hash(&height, sizeof(height));
+    memcpy(&out.key, &key, sizeof(out.key));
+    b.miner_tx.vout.push_back(cryptonote::tx_out{1000000000000ull, out});
+    b.tx_hashes = tx_hashes;
+    return b;
+  }
+
+  void make_synthetic_segment(bench_context &ctx)
+  {
+    std::mt19937_64 rng(ctx.options.seed);
+    crypto::hash prev_id = crypto::null_hash;
+    uint64_t tx_seq = 0;
+    for (size_t height = 0; height < ctx.options.segment_blocks; ++height)
+    {
+      segment_entry e;
+      std::vector<crypto::hash> tx_hashes;
+      const size_t n_txs = rng() % (2 * ctx.options.block_txs + 1);
+      for (size_t i = 0; i < n_txs; ++i)
+      {
+        e.entry.txs.push_back(make_tx_blob(tx_seq++, ctx.options.tx_size, rng));
+        tx_hashes.push_back(cryptonote::get_blob_hash(e.entry.txs.back()));
+      }
+      const cryptonote::block b = make_block(height, prev_id, tx_hashes);
+      e.entry.block = cryptonote::block_to_blob(b);
+      e.id = prev_id = cryptonote::get_block_hash(b);
+      ctx.segment.push_back(std::move(e));
+    }
+  }
+
+  bool read_exact(std::ifstream &file, std::string &buf, size_t size)
+  {
+    buf.resize(size);
+    file.read(&buf[0], size);
+    return static_cast<bool>(file);
+  }
+
+  // reads the first blocks of a blockchain export (see blockchain_export)
+  bool load_segment(bench_context &ctx, const std::string &path)
+  {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+    {
+      MERROR("Failed to open " << path);
+      return false;
+    }
+
+    std::string buf;
+    uint32_t magic, header_length, chunk_size;
+    cryptonote::bootstrap::file_info bfi;
+    if (!read_exact(file, buf, sizeof(magic)) || !::serialization::parse_binary(buf, magic) || magic != blockchain_raw_magic)
+    {
+      MERROR(path << " is not a blockchain export file");
+      return false;
+    }
+    if (!read_exact(file, buf, sizeof(header_length)) || !::serialization::parse_binary(buf, header_length) ||
+        !read_exact(file, buf, header_length) || !::serialization::parse_binary(buf, bfi))
+    {
+      MERROR("Failed to read the header of " << path);
+      return false;
+    }
+    file.seekg(sizeof(magic) + bfi.header_size);
+
+    while (ctx.segment.size() < ctx.options.segment_blocks)
+    {
+      if (!read_exact(file, buf, sizeof(chunk_size)) || !::serialization::parse_binary(buf, chunk_size))
+        break;
+      if (!read_exact(file, buf, chunk_size))
+        break;
+
+      cryptonote::bootstrap::block_package bp;
+      if (bfi.major_version == 0)
+      {
+        cryptonote::bootstrap::block_package_1 bp1;
+        if (!::serialization::parse_binary(buf, bp1))
+          break;
+        bp.block = std::move(bp1.block);
+        bp.txs = std::move(bp1.txs);
+      }
+      else if (!::serialization::parse_binary(buf, bp))
+        break;
+
+      segment_entry e;
+      e.entry.block = cryptonote::block_to_blob(bp.block);
+      for (const auto &tx: bp.txs)
+        e.entry.txs.push_back(cryptonote::tx_to_blob(tx));
+      e.id = cryptonote::get_block_hash(bp.block);
+      ctx.segment.push_back(std::move(e));
+    }
+
+    if (ctx.segment.empty())
+    {
+      MERROR("No blocks could be read from " << path);
+      return false;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  template<typename t_request>
+  size_t send(test_levin_protocol_handler_config &config, const t_request &req, int command, const boost::uuids::uuid &conn_id, bench_stats &stats)
+  {
+    std::string blob;
+    epee::serialization::store_t_to_binary(const_cast<t_request&>(req), blob);
+    if (config.notify(command, epee::strspan<uint8_t>(blob), conn_id) <= 0)
+      stats.error();
+    stats.sent(blob.size());
+    return blob.size();
+  }
+
+  class hub_commands_handler : public test_levin_commands_handler
+  {
+  public:
+    hub_commands_handler(bench_context &ctx, test_tcp_server &tcp_server)
+      : m_ctx(ctx)
+      , m_tcp_server(tcp_server)
+    {
+    }
+
+    virtual int notify(int command, const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      switch (command)
+      {
+        case cryptonote::NOTIFY_NEW_TRANSACTIONS::ID:
+          relay(command, in_buff, context.m_connection_id);
+          break;
+        case cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID:
+          handle_fluffy_missing_tx(in_buff, context);
+          break;
+        case cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID:
+          handle_get_objects(in_buff, context);
+          break;
+        default:
+          m_ctx.stats.error();
+          break;
+      }
+      return 1;
+    }
+
+    virtual void on_connection_new(test_connection_context& context)
+    {
+      test_levin_commands_handler::on_connection_new(context);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_connections.push_back(context.m_connection_id);
+    }
+
+    std::vector<boost::uuids::uuid> connections()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_connections;
+    }
+
+    // send the same message to every peer but one, serializing it only once
+    void relay(int command, const epee::span<const uint8_t> payload, const boost::uuids::uuid &exclude)
+    {
+      const std::vector<epee::net_utils::shared_buffer> message = epee::levin::make_notify_message(command, payload);
+      size_t copies = 0;
+      for (const auto &conn_id: connections())
+      {
+        if (conn_id == exclude)
+          continue;
+        if (m_tcp_server.get_config_object().notify(message, conn_id) <= 0)
+          m_ctx.stats.error();
+        ++copies;
+      }
+      m_ctx.stats.sent(payload.size(), copies);
+    }
+
+  private:
+    void handle_fluffy_missing_tx(const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::request req;
+      if (!epee::serialization::load_t_from_binary(req, in_buff))
+      {
+        m_ctx.stats.error();
+        return;
+      }
+
+      cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::request res;
+      res.current_blockchain_height = req.current_blockchain_height;
+      res.b.block = cryptonote::block_to_blob(make_block(req.current_blockchain_height, crypto::null_hash, m_ctx.pool_hashes));
+      for (uint64_t idx: req.missing_tx_indices)
+        if (idx < m_ctx.pool.size())
+          res.b.txs.push_back(m_ctx.pool[idx]);
+      send(m_tcp_server.get_config_object(), res, cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::ID, context.m_connection_id, m_ctx.stats);
+    }
+
+    void handle_get_objects(const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request req;
+      if (!epee::serialization::load_t_from_binary(req, in_buff))
+      {
+        m_ctx.stats.error();
+        return;
+      }
+
+      cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request res;
+      res.current_blockchain_height = 0;
+      for (const crypto::hash &id: req.blocks)
+      {
+        const auto it = m_ctx.segment_index.find(id);
+        if (it == m_ctx.segment_index.end())
+        {
+          res.missed_ids.push_back(id);
+          continue;
+        }
+        // the peer derives which span this answers from the first block's height
+        if (res.blocks.empty())
+          res.current_blockchain_height = it->second;
+        res.blocks.push_back(m_ctx.segment[it->second].entry);
+      }
+      send(m_tcp_server.get_config_object(), res, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::ID, context.m_connection_id, m_ctx.stats);
+    }
+
+    bench_context &m_ctx;
+    test_tcp_server &m_tcp_server;
+    std::mutex m_mutex;
+    std::vector<boost::uuids::uuid> m_connections;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  class peer_commands_handler : public test_levin_commands_handler
+  {
+  public:
+    peer_commands_handler(bench_context &ctx, test_tcp_server &tcp_server)
+      : m_ctx(ctx)
+      , m_tcp_server(tcp_server)
+    {
+    }
+
+    virtual int notify(int command, const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      switch (command)
+      {
+        case cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::ID:
+          handle_fluffy_block(in_buff, context);
+          break;
+        case cryptonote::NOTIFY_NEW_TRANSACTIONS::ID:
+          handle_transactions(in_buff);
+          break;
+        case cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::ID:
+          handle_objects(in_buff, context);
+          break;
+        default:
+          m_ctx.stats.error();
+          break;
+      }
+      return 1;
+    }
+
+    void request_span(size_t peer, size_t span, const boost::uuids::uuid &conn_id)
+    {
+      cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request req;
+      const size_t start = span * m_ctx.options.span_blocks;
+      const size_t end = std::min(start + m_ctx.options.span_blocks, m_ctx.segment.size());
+      for (size_t height = start; height < end; ++height)
+        req.blocks.push_back(m_ctx.segment[height].id);
+      m_ctx.stats.mark_sent(peer * m_ctx.spans() + span);
+      send(m_tcp_server.get_config_object(), req, cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID, conn_id, m_ctx.stats);
+    }
+
+  private:
+    size_t peer_index(const test_connection_context& context) const
+    {
+      const auto it = m_ctx.peer_index.find(context.m_connection_id);
+      return it == m_ctx.peer_index.end() ? 0 : it->second;
+    }
+
+    void handle_fluffy_block(const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::request req;
+      if (!epee::serialization::load_t_from_binary(req, in_buff))
+      {
+        m_ctx.stats.error();
+        return;
+      }
+
+      if (m_ctx.scenario == scenario_fluffy && req.b.txs.empty())
+      {
+        cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing;
+        missing.missing_tx_indices = m_ctx.missing_txs(peer_index(context), req.current_blockchain_height);
+        if (!missing.missing_tx_indices.empty())
+        {
+          missing.block_hash = cryptonote::get_blob_hash(req.b.block);
+          missing.current_blockchain_height = req.current_blockchain_height;
+          send(m_tcp_server.get_config_object(), missing, cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID, context.m_connection_id, m_ctx.stats);
+          return;
+        }
+      }
+      m_ctx.stats.delivered(req.current_blockchain_height);
+    }
+
+    void handle_transactions(const epee::span<const uint8_t> in_buff)
+    {
+      cryptonote::NOTIFY_NEW_TRANSACTIONS::request req;
+      if (!epee::serialization::load_t_from_binary(req, in_buff))
+      {
+        m_ctx.stats.error();
+        return;
+      }
+      for (const auto &tx: req.txs)
+        m_ctx.stats.delivered(read_tx_seq(tx));
+    }
+
+    void handle_objects(const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request res;
+      if (!epee::serialization::load_t_from_binary(res, in_buff) || res.blocks.empty() || !res.missed_ids.empty())
+      {
+        m_ctx.stats.error();
+        return;
+      }
+
+      const size_t peer = peer_index(context);
+      const size_t span = res.current_blockchain_height / m_ctx.options.span_blocks;
+      m_ctx.stats.delivered(peer * m_ctx.spans() + span);
+      if (span + 1 < m_ctx.spans())
+        request_span(peer, span + 1, context.m_connection_id);
+    }
+
+    bench_context &m_ctx;
+    test_tcp_server &m_tcp_server;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  void print_result(scenario_t scenario, bench_stats &stats, uint64_t expected, uint64_t elapsed_us)
+  {
+    const std::vector<uint64_t> latencies = stats.latencies();
+    const auto percentile = [&latencies](double p) -> double {
+      if (latencies.empty())
+        return 0.0;
+      const size_t idx = std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+      return latencies[idx] / 1000.0;
+    };
+    const double seconds = std::max<uint64_t>(elapsed_us, 1) / 1e6;
+
+    std::cout << std::left << std::setw(8) << scenario_name(scenario) << std::right << std::fixed
+      << " delivered " << stats.delivered_count() << "/" << expected
+      << ", errors " << stats.errors()
+      << ", " << std::setprecision(3) << seconds << " s"
+      << ", " << std::setprecision(0) << stats.delivered_count() / seconds << " msg/s"
+      << ", wire " << stats.messages() << " msgs / " << std::setprecision(2) << stats.bytes() / 1048576.0 << " MB"
+      << " (" << stats.bytes() / 1048576.0 / seconds << " MB/s)"
+      << ", latency ms p50 " << std::setprecision(3) << percentile(0.50)
+      << " p90 " << percentile(0.90)
+      << " p99 " << percentile(0.99)
+      << " max " << (latencies.empty() ? 0.0 : latencies.back() / 1000.0)
+      << std::endl;
+  }
+
+  bool run_scenario(scenario_t scenario, bench_context &ctx, hub_commands_handler &hub, peer_commands_handler &peer, test_tcp_server &peer_server, const std::vector<boost::uuids::uuid> &peer_connections)
+  {
+    const bench_options &opt = ctx.options;
+    const std::vector<boost::uuids::uuid> hub_connections = hub.connections();
+    uint64_t expected = 0;
+
+    ctx.scenario = scenario;
+    switch (scenario)
+    {
+      case scenario_relay:
+      case scenario_fluffy:
+        expected = opt.messages * peer_connections.size();
+        ctx.stats.reset(opt.messages);
+        break;
+      case scenario_gossip:
+        expected = opt.messages * (peer_connections.size() - 1);
+        ctx.stats.reset(opt.messages);
+        break;
+      case scenario_sync:
+        expected = ctx.spans() * peer_connections.size();
+        ctx.stats.reset(expected);
+        break;
+    }
+
+    const uint64_t start = now_us();
+    switch (scenario)
+    {
+      case scenario_relay:
+      case scenario_fluffy:
+        for (uint64_t seq = 0; seq < opt.messages; ++seq)
+        {
+          cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::request req;
+          req.b.block = cryptonote::block_to_blob(make_block(seq, crypto::null_hash, ctx.pool_hashes));
+          req.current_blockchain_height = seq;
+          std::string blob;
+          epee::serialization::store_t_to_binary(req, blob);
+          ctx.stats.mark_sent(seq);
+          hub.relay(cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::ID, epee::strspan<uint8_t>(blob), boost::uuids::nil_uuid());
+        }
+        break;
+      case scenario_gossip:
+      {
+        std::mt19937_64 rng(opt.seed);
+        for (uint64_t seq = 0; seq < opt.messages; ++seq)
+        {
+          cryptonote::NOTIFY_NEW_TRANSACTIONS::request req;
+          req.txs.push_back(make_tx_blob(seq, opt.tx_size, rng));
+          ctx.stats.mark_sent(seq);
+          send(peer_server.get_config_object(), req, cryptonote::NOTIFY_NEW_TRANSACTIONS::ID, peer_connections[seq % peer_connections.size()], ctx.stats);
+        }
+        break;
+      }
+      case scenario_sync:
+        for (size_t i = 0; i < peer_connections.size(); ++i)
+          peer.request_span(i, 0, peer_connections[i]);
+        break;
+    }
+
+    const uint64_t deadline = start + opt.timeout_ms * 1000;
+    while (ctx.stats.delivered_count() + ctx.stats.errors() < expected && now_us() < deadline)
+      epee::misc_utils::sleep_no_w(1);
+    const uint64_t elapsed = now_us() - start;
+
+    print_result(scenario, ctx.stats, expected, elapsed);
+    return ctx.stats.delivered_count() == expected && ctx.stats.errors() == 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  mlog_configure(mlog_get_default_log_path("net_load_tests_bench.log"), true);
+
+  po::options_description desc_options("Command line options");
+  const command_line::arg_descriptor<std::string> arg_scenarios = { "scenarios", "Comma separated scenarios to run: relay, gossip, fluffy, sync", "relay,gossip,fluffy,sync" };
+  const command_line::arg_descriptor<size_t> arg_peers = { "peers", "Number of peer connections to the hub", 32 };
+  const command_line::arg_descriptor<size_t> arg_messages = { "messages", "Blocks (relay, fluffy) or txs (gossip) to send", 1000 };
+  const command_line::arg_descriptor<size_t> arg_tx_size = { "tx-size", "Size of synthetic txs in bytes", 2000 };
+  const command_line::arg_descriptor<size_t> arg_block_txs = { "block-txs", "Txs per fluffy block, average txs per synthetic segment block", 20 };
+  const command_line::arg_descriptor<unsigned> arg_known_percent = { "known-percent", "Percentage of a fluffy block's txs each peer already has", 90 };
+  const command_line::arg_descriptor<size_t> arg_span_blocks = { "span-blocks", "Blocks requested per span while syncing", 20 };
+  const command_line::arg_descriptor<size_t> arg_segment_blocks = { "segment-blocks", "Blocks in the sync segment", 2000 };
+  const command_line::arg_descriptor<std::string> arg_segment_file = { "segment-file", "Blockchain export file to take the sync segment from, synthetic segment if empty" };
+  const command_line::arg_descriptor<uint64_t> arg_seed = { "seed", "Seed for the synthetic data", 0 };
+  const command_line::arg_descriptor<size_t> arg_threads = { "threads", "Threads per tcp server", 0 };
+  const command_line::arg_descriptor<size_t> arg_timeout = { "timeout", "Per scenario timeout in ms", 60000 };
+  const command_line::arg_descriptor<uint64_t> arg_limit_rate_up = { "limit-rate-up", "Global upload limit in kB/s (shared by hub and peers), 0 for none", 0 };
+  const command_line::arg_descriptor<uint64_t> arg_limit_rate_down = { "limit-rate-down", "Global download limit in kB/s (shared by hub and peers), 0 for none", 0 };
+  const command_line::arg_descriptor<uint64_t> arg_limit_rate_up_per_peer = { "limit-rate-up-per-peer", "Per connection upload limit in kB/s, 0 for none", 0 };
+  const command_line::arg_descriptor<uint64_t> arg_limit_rate_down_per_peer = { "limit-rate-down-per-peer", "Per connection download limit in kB/s, 0 for none", 0 };
+  command_line::add_arg(desc_options, arg_scenarios);
+  command_line::add_arg(desc_options, arg_peers);
+  command_line::add_arg(desc_options, arg_messages);
+  command_line::add_arg(desc_options, arg_tx_size);
+  command_line::add_arg(desc_options, arg_block_txs);
+  command_line::add_arg(desc_options, arg_known_percent);
+  command_line::add_arg(desc_options, arg_span_blocks);
+  command_line::add_arg(desc_options, arg_segment_blocks);
+  command_line::add_arg(desc_options, arg_segment_file);
+  command_line::add_arg(desc_options, arg_seed);
+  command_line::add_arg(desc_options, arg_threads);
+  command_line::add_arg(desc_options, arg_timeout);
+  command_line::add_arg(desc_options, arg_limit_rate_up);
+  command_line::add_arg(desc_options, arg_limit_rate_down);
+  command_line::add_arg(desc_options, arg_limit_rate_up_per_peer);
+  command_line::add_arg(desc_options, arg_limit_rate_down_per_peer);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  bench_context ctx;
+  ctx.options.peers = std::max<size_t>(command_line::get_arg(vm, arg_peers), 2);
+  ctx.options.messages = command_line::get_arg(vm, arg_messages);
+  ctx.options.tx_size = command_line::get_arg(vm, arg_tx_size);
+  ctx.options.block_txs = command_line::get_arg(vm, arg_block_txs);
+  ctx.options.known_percent = std::min(command_line::get_arg(vm, arg_known_percent), 100u);
+  ctx.options.span_blocks = std::max<size_t>(command_line::get_arg(vm, arg_span_blocks), 1);
+  ctx.options.segment_blocks = command_line::get_arg(vm, arg_segment_blocks);
+  ctx.options.seed = command_line::get_arg(vm, arg_seed);
+  ctx.options.timeout_ms = command_line::get_arg(vm, arg_timeout);
+
+  std::vector<scenario_t> scenarios;
+  std::vector<std::string> names;
+  boost::split(names, command_line::get_arg(vm, arg_scenarios), boost::is_any_of(","));
+  for (const std::string &name: names)
+  {
+    if (name == "relay") scenarios.push_back(scenario_relay);
+    else if (name == "gossip") scenarios.push_back(scenario_gossip);
+    else if (name == "fluffy") scenarios.push_back(scenario_fluffy);
+    else if (name == "sync") scenarios.push_back(scenario_sync);
+    else
+    {
+      std::cerr << "Unknown scenario: " << name << std::endl;
+      return 1;
+    }
+  }
+
+  std::mt19937_64 rng(ctx.options.seed);
+  for (size_t i = 0; i < ctx.options.block_txs; ++i)
+  {
+    ctx.pool.push_back(make_tx_blob(i, ctx.options.tx_size, rng));
+    ctx.pool_hashes.push_back(cryptonote::get_blob_hash(ctx.pool.back()));
+  }
+
+  const std::string segment_file = command_line::get_arg(vm, arg_segment_file);
+  if (!segment_file.empty())
+  {
+    if (!load_segment(ctx, segment_file))
+      return 1;
+  }
+  else
+  {
+    make_synthetic_segment(ctx);
+  }
+  for (size_t i = 0; i < ctx.segment.size(); ++i)
+    ctx.segment_index[ctx.segment[i].id] = i;
+
+  // RPC connections are not throttled, so switch to P2P only when limits are asked for
+  const uint64_t limit_up = command_line::get_arg(vm, arg_limit_rate_up);
+  const uint64_t limit_down = command_line::get_arg(vm, arg_limit_rate_down);
+  const uint64_t limit_up_per_peer = command_line::get_arg(vm, arg_limit_rate_up_per_peer);
+  const uint64_t limit_down_per_peer = command_line::get_arg(vm, arg_limit_rate_down_per_peer);
+  const bool throttled = limit_up || limit_down || limit_up_per_peer || limit_down_per_peer;
+  const epee::net_utils::t_connection_type connection_type = throttled ? epee::net_utils::e_connection_type_P2P : epee::net_utils::e_connection_type_RPC;
+  if (throttled)
+  {
+    test_connection::set_rate_up_limit(limit_up);
+    test_connection::set_rate_down_limit(limit_down);
+    test_connection::set_connection_rate_up_limit(limit_up_per_peer);
+    test_connection::set_connection_rate_down_limit(limit_down_per_peer);
+  }
+
+  size_t thread_count = command_line::get_arg(vm, arg_threads);
+  if (!thread_count)
+    thread_count = std::max<size_t>(2, boost::thread::hardware_concurrency() / 2);
+
+  test_tcp_server hub_server(connection_type);
+  test_tcp_server peer_server(connection_type);
+  if (!hub_server.init_server(hub_port, "127.0.0.1") || !peer_server.init_server(peer_port, "127.0.0.1"))
+    return 1;
+
+  hub_commands_handler *hub = new hub_commands_handler(ctx, hub_server);
+  peer_commands_handler *peer = new peer_commands_handler(ctx, peer_server);
+  const auto deleter = [](epee::levin::levin_commands_handler<test_connection_context> *handler) { delete handler; };
+  hub_server.get_config_object().set_handler(hub, deleter);
+  peer_server.get_config_object().set_handler(peer, deleter);
+  hub_server.get_config_object().m_max_packet_size = 100 * 1024 * 1024;
+  peer_server.get_config_object().m_max_packet_size = 100 * 1024 * 1024;
+
+  if (!hub_server.run_server(thread_count, false) || !peer_server.run_server(thread_count, false))
+    return 2;
+
+  std::vector<boost::uuids::uuid> peer_connections;
+  for (size_t i = 0; i < ctx.options.peers; ++i)
+  {
+    test_connection_context context;
+    if (!peer_server.connect("127.0.0.1", hub_port, connection_timeout, context))
+    {
+      MERROR("Failed to connect peer " << i);
+      return 3;
+    }
+    ctx.peer_index[context.m_connection_id] = i;
+    peer_connections.push_back(context.m_connection_id);
+  }
+  while (hub->connections().size() < peer_connections.size())
+    epee::misc_utils::sleep_no_w(1);
+
+  std::cout << "peers " << ctx.options.peers << ", threads " << thread_count << ", seed " << ctx.options.seed
+    << ", segment " << ctx.segment.size() << " blocks (" << (segment_file.empty() ? "synthetic" : segment_file) << ")" << std::endl;
+
+  bool ok = true;
+  for (scenario_t scenario: scenarios)
+    ok &= run_scenario(scenario, ctx, *hub, *peer, peer_server, peer_connections);
+
+  peer_server.send_stop_signal();
+  hub_server.send_stop_signal();
+  peer_server.timed_wait_server_stop(connection_timeout);
+  hub_server.timed_wait_server_stop(connection_timeout);
+  return ok ? 0 : 4;
+  CATCH_ENTRY_L0("main", 1);
+}
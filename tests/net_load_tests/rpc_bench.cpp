@@ -0,0 +1,537 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// RPC load generator replaying wallet and explorer traffic mixes.
+//
+// Worker threads, each with its own persistent connection, pick scenarios by
+// weight and run them against a live daemon until the duration is up:
+//
+//   refresh    - wallet refresh: height, hashes from a random point, a block
+//                span, pool hashes
+//   transfer   - transfer construction: fee estimate, the rct output
+//                distribution, a ring's worth of outputs
+//   explorer   - info, last and random block headers, a header range, a block,
+//                pool stats
+//   full_nodes - full node list polling: key list (with its hash) and a page
+//                of full nodes
+//
+// Every call is timed and reported per endpoint with throughput and latency
+// percentiles; throttled (429) and overloaded (503) answers are counted apart
+// from other failures.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "include_base_utils.h"
+#include "misc_log_ex.h"
+#include "net/http_client.h"
+#include "storages/http_abstract_invoke.h"
+#include "storages/portable_storage_template_helper.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const size_t ring_size = 11;
+  const size_t outs_per_transfer = 2 * ring_size;
+  const size_t header_range = 10;
+
+  enum scenario_t
+  {
+    scenario_refresh,
+    scenario_transfer,
+    scenario_explorer,
+    scenario_full_nodes,
+    scenario_count
+  };
+
+  const char *scenario_name(scenario_t scenario)
+  {
+    switch (scenario)
+    {
+      case scenario_refresh: return "refresh";
+      case scenario_transfer: return "transfer";
+      case scenario_explorer: return "explorer";
+      case scenario_full_nodes: return "full_nodes";
+      default: break;
+    }
+    return "unknown";
+  }
+
+  uint64_t now_us()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  struct endpoint_stats
+  {
+    std::vector<uint64_t> latencies; // successful calls, us
+    uint64_t errors = 0;
+    uint64_t throttled = 0;  // 429
+    uint64_t overloaded = 0; // 503
+
+    void merge(const endpoint_stats &o)
+    {
+      latencies.insert(latencies.end(), o.latencies.begin(), o.latencies.end());
+      errors += o.errors;
+      throttled += o.throttled;
+      overloaded += o.overloaded;
+    }
+  };
+
+  typedef std::map<std::string, endpoint_stats> stats_map;
+
+  // what the scenarios need to know about the chain, read once before the run
+  struct chain_info
+  {
+    uint64_t height;
+    crypto::hash genesis;
+    uint64_t rct_outputs;
+  };
+
+  struct bench_options
+  {
+    std::string address;
+    boost::optional<epee::net_utils::http::login> login;
+    size_t concurrency;
+    uint64_t duration_ms;
+    size_t timeout_ms;
+    uint64_t seed;
+    bool prune;
+    std::vector<double> weights;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  class worker
+  {
+  public:
+    worker(const bench_options &options, const chain_info &chain, size_t index)
+      : m_options(options)
+      , m_chain(chain)
+      , m_rng(options.seed ^ (index * 0x9e3779b97f4a7c15ull))
+      , m_keys_hash()
+    {
+      m_client.set_server(options.address, options.login, false);
+    }
+
+    void run(uint64_t deadline_us)
+    {
+      std::discrete_distribution<size_t> pick(m_options.weights.begin(), m_options.weights.end());
+      while (now_us() < deadline_us)
+      {
+        switch (static_cast<scenario_t>(pick(m_rng)))
+        {
+          case scenario_refresh: refresh(); break;
+          case scenario_transfer: transfer(); break;
+          case scenario_explorer: explorer(); break;
+          case scenario_full_nodes: full_nodes(); break;
+          default: break;
+        }
+      }
+    }
+
+    const stats_map &stats() const { return m_stats; }
+
+  private:
+    enum mode_t { mode_json, mode_bin, mode_json_rpc };
+
+    // times one call; the endpoint name is the URI, or the json_rpc method
+    template<typename t_request, typename t_response>
+    bool call(mode_t mode, const std::string &name, const t_request &req, t_response &res)
+    {
+      std::string body;
+      if (mode == mode_json_rpc)
+      {
+        epee::json_rpc::request<t_request> json_req = AUTO_VAL_INIT(json_req);
+        json_req.jsonrpc = "2.0";
+        json_req.id = epee::serialization::storage_entry(0);
+        json_req.method = name;
+        json_req.params = req;
+        epee::serialization::store_t_to_json(json_req, body);
+      }
+      else if (mode == mode_json)
+        epee::serialization::store_t_to_json(req, body);
+      else
+        epee::serialization::store_t_to_binary(req, body);
+
+      endpoint_stats &stats = m_stats[name];
+      const epee::net_utils::http::http_response_info *info = NULL;
+      const uint64_t start = now_us();
+      const bool sent = m_client.invoke(mode == mode_json_rpc ? "/json_rpc" : name, "POST", body, std::chrono::milliseconds(m_options.timeout_ms), &info);
+      const uint64_t elapsed = now_us() - start;
+
+      bool ok = sent && info && info->m_response_code == 200;
+      if (ok)
+      {
+        if (mode == mode_json_rpc)
+        {
+          epee::json_rpc::response<t_response, epee::json_rpc::error> json_res = AUTO_VAL_INIT(json_res);
+          ok = epee::serialization::load_t_from_json(json_res, info->m_body) && !json_res.error.code;
+          res = std::move(json_res.result);
+        }
+        else if (mode == mode_json)
+          ok = epee::serialization::load_t_from_json(res, info->m_body);
+        else
+          ok = epee::serialization::load_t_from_binary(res, epee::strspan<uint8_t>(info->m_body));
+      }
+
+      if (ok)
+        stats.latencies.push_back(elapsed);
+      else if (sent && info && info->m_response_code == 429)
+        ++stats.throttled;
+      else if (sent && info && info->m_response_code == 503)
+        ++stats.overloaded;
+      else
+        ++stats.errors;
+      return ok;
+    }
+
+    uint64_t random_height(uint64_t below)
+    {
+      return below ? m_rng() % below : 0;
+    }
+
+    void refresh()
+    {
+      cryptonote::COMMAND_RPC_GET_HEIGHT::request height_req;
+      cryptonote::COMMAND_RPC_GET_HEIGHT::response height_res;
+      call(mode_json, "/getheight", height_req, height_res);
+
+      // a wallet some way behind the tip, as after being offline for a while
+      const uint64_t start = random_height(m_chain.height);
+
+      cryptonote::COMMAND_RPC_GET_HASHES_FAST::request hashes_req;
+      cryptonote::COMMAND_RPC_GET_HASHES_FAST::response hashes_res;
+      hashes_req.block_ids.push_back(m_chain.genesis);
+      hashes_req.start_height = start;
+      call(mode_bin, "/gethashes.bin", hashes_req, hashes_res);
+
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request blocks_req;
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response blocks_res;
+      blocks_req.block_ids.push_back(m_chain.genesis);
+      blocks_req.start_height = start;
+      blocks_req.prune = m_options.prune;
+      blocks_req.no_miner_tx = false;
+      blocks_req.scan_digest = false;
+      call(mode_bin, "/getblocks.bin", blocks_req, blocks_res);
+
+      cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request pool_req;
+      cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response pool_res;
+      pool_req.pool_cookie = 0;
+      call(mode_json, "/get_transaction_pool_hashes.bin", pool_req, pool_res);
+    }
+
+    void transfer()
+    {
+      cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::request fee_req;
+      cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::response fee_res;
+      fee_req.grace_blocks = 10;
+      call(mode_json_rpc, "get_fee_estimate", fee_req, fee_res);
+
+      cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request dist_req;
+      cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response dist_res;
+      dist_req.amounts.push_back(0);
+      dist_req.from_height = 0;
+      dist_req.to_height = 0;
+      dist_req.cumulative = true;
+      dist_req.binary = true;
+      dist_req.compress = false;
+      call(mode_bin, "/get_output_distribution.bin", dist_req, dist_res);
+
+      if (!m_chain.rct_outputs)
+        return;
+      cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request outs_req;
+      cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::response outs_res;
+      // recent outputs are picked more often, as the wallet's decoy selection does
+      std::gamma_distribution<double> age(19.28, 1 / 1.61);
+      for (size_t i = 0; i < outs_per_transfer; ++i)
+      {
+        const uint64_t back = std::min<uint64_t>(m_chain.rct_outputs - 1, static_cast<uint64_t>(std::exp(age(m_rng))) % m_chain.rct_outputs);
+        outs_req.outputs.push_back(cryptonote::get_outputs_out{0, m_chain.rct_outputs - 1 - back});
+      }
+      outs_req.get_txid = false;
+      outs_req.packed = false;
+      call(mode_bin, "/get_outs.bin", outs_req, outs_res);
+    }
+
+    void explorer()
+    {
+      cryptonote::COMMAND_RPC_GET_INFO::request info_req;
+      cryptonote::COMMAND_RPC_GET_INFO::response info_res;
+      call(mode_json, "/getinfo", info_req, info_res);
+
+      cryptonote::COMMAND_RPC_GET_LAST_BLOCK_HEADER::request last_req;
+      cryptonote::COMMAND_RPC_GET_LAST_BLOCK_HEADER::response last_res;
+      last_req.fill_pow_hash = false;
+      call(mode_json_rpc, "get_last_block_header", last_req, last_res);
+
+      const uint64_t height = random_height(m_chain.height);
+      cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request header_req;
+      cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response header_res;
+      header_req.height = height;
+      header_req.fill_pow_hash = false;
+      call(mode_json_rpc, "get_block_header_by_height", header_req, header_res);
+
+      cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request range_req;
+      cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response range_res;
+      range_req.end_height = std::max<uint64_t>(height, header_range - 1);
+      range_req.start_height = range_req.end_height - (header_range - 1);
+      range_req.fill_pow_hash = false;
+      if (range_req.end_height < m_chain.height)
+        call(mode_json_rpc, "get_block_headers_range", range_req, range_res);
+
+      cryptonote::COMMAND_RPC_GET_BLOCK::request block_req;
+      cryptonote::COMMAND_RPC_GET_BLOCK::response block_res;
+      block_req.height = height;
+      block_req.fill_pow_hash = false;
+      call(mode_json_rpc, "get_block", block_req, block_res);
+
+      cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_STATS::request pool_req;
+      cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_STATS::response pool_res;
+      call(mode_json, "/get_transaction_pool_stats", pool_req, pool_res);
+    }
+
+    void full_nodes()
+    {
+      cryptonote::COMMAND_RPC_GET_ALL_FULL_NODES_KEYS::request keys_req;
+      cryptonote::COMMAND_RPC_GET_ALL_FULL_NODES_KEYS::response keys_res;
+      keys_req.fully_funded_nodes_only = true;
+      keys_req.keys_hash = m_keys_hash;
+      if (call(mode_json_rpc, "get_all_full_nodes_keys", keys_req, keys_res))
+        m_keys_hash = keys_res.keys_hash;
+
+      cryptonote::COMMAND_RPC_GET_FULL_NODES::request nodes_req;
+      cryptonote::COMMAND_RPC_GET_FULL_NODES::response nodes_res;
+      nodes_req.include_json = false;
+      nodes_req.limit = 100;
+      call(mode_json_rpc, "get_full_nodes", nodes_req, nodes_res);
+    }
+
+    const bench_options &m_options;
+    const chain_info &m_chain;
+    std::mt19937_64 m_rng;
+    epee::net_utils::http::http_simple_client m_client;
+    std::string m_keys_hash; // pollers send the hash of the list they have
+    stats_map m_stats;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+  bool read_chain_info(const bench_options &options, chain_info &chain)
+  {
+    epee::net_utils::http::http_simple_client client;
+    client.set_server(options.address, options.login, false);
+    const std::chrono::milliseconds timeout(options.timeout_ms);
+
+    cryptonote::COMMAND_RPC_GET_HEIGHT::request height_req;
+    cryptonote::COMMAND_RPC_GET_HEIGHT::response height_res;
+    if (!epee::net_utils::invoke_http_json("/getheight", height_req, height_res, client, timeout) || height_res.status != CORE_RPC_STATUS_OK)
+    {
+      MERROR("Failed to get the height from " << options.address);
+      return false;
+    }
+    chain.height = height_res.height;
+
+    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request header_req;
+    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response header_res;
+    header_req.height = 0;
+    header_req.fill_pow_hash = false;
+    if (!epee::net_utils::invoke_http_json_rpc("/json_rpc", "get_block_header_by_height", header_req, header_res, client, timeout)
+        || !epee::string_tools::hex_to_pod(header_res.block_header.hash, chain.genesis))
+    {
+      MERROR("Failed to get the genesis block hash from " << options.address);
+      return false;
+    }
+
+    cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request dist_req;
+    cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response dist_res;
+    dist_req.amounts.push_back(0);
+    dist_req.from_height = 0;
+    dist_req.to_height = 0;
+    dist_req.cumulative = true;
+    dist_req.binary = true;
+    dist_req.compress = false;
+    chain.rct_outputs = 0;
+    if (epee::net_utils::invoke_http_bin("/get_output_distribution.bin", dist_req, dist_res, client, timeout)
+        && dist_res.distributions.size() == 1 && !dist_res.distributions[0].data.distribution.empty())
+      chain.rct_outputs = dist_res.distributions[0].data.distribution.back();
+    else
+      MWARNING("Failed to get the rct output distribution, transfers will not fetch outputs");
+    return true;
+  }
+
+  void print_stats(const stats_map &stats, uint64_t elapsed_us)
+  {
+    const double seconds = std::max<uint64_t>(elapsed_us, 1) / 1e6;
+    uint64_t total = 0;
+    for (const auto &e: stats)
+    {
+      std::vector<uint64_t> latencies = e.second.latencies;
+      std::sort(latencies.begin(), latencies.end());
+      const auto percentile = [&latencies](double p) -> double {
+        if (latencies.empty())
+          return 0.0;
+        const size_t idx = std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+        return latencies[idx] / 1000.0;
+      };
+      total += latencies.size();
+
+      std::cout << std::left << std::setw(34) << e.first << std::right << std::fixed
+        << " ok " << latencies.size()
+        << ", errors " << e.second.errors
+        << ", 429 " << e.second.throttled
+        << ", 503 " << e.second.overloaded
+        << ", " << std::setprecision(1) << latencies.size() / seconds << " req/s"
+        << ", latency ms p50 " << std::setprecision(3) << percentile(0.50)
+        << " p90 " << percentile(0.90)
+        << " p99 " << percentile(0.99)
+        << " max " << (latencies.empty() ? 0.0 : latencies.back() / 1000.0)
+        << std::endl;
+    }
+    std::cout << "total " << total << " calls in " << std::setprecision(3) << seconds << " s, "
+      << std::setprecision(1) << total / seconds << " req/s" << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  mlog_configure(mlog_get_default_log_path("net_load_tests_rpc_bench.log"), true);
+
+  po::options_description desc_options("Command line options");
+  const command_line::arg_descriptor<std::string> arg_daemon_address = { "daemon-address", "RPC address of the daemon to load", "http://127.0.0.1:18081" };
+  const command_line::arg_descriptor<std::string> arg_login = { "login", "username:password for the daemon's RPC", "" };
+  const command_line::arg_descriptor<std::string> arg_mix = { "mix", "Comma separated scenario=weight pairs of refresh, transfer, explorer, full_nodes", "refresh=50,transfer=20,explorer=20,full_nodes=10" };
+  const command_line::arg_descriptor<size_t> arg_concurrency = { "concurrency", "Clients running scenarios at once, each with its own connection", 16 };
+  const command_line::arg_descriptor<uint64_t> arg_duration = { "duration", "How long to run, in seconds", 30 };
+  const command_line::arg_descriptor<size_t> arg_timeout = { "timeout", "Per call timeout in ms", 30000 };
+  const command_line::arg_descriptor<uint64_t> arg_seed = { "seed", "Seed for the scenario choices and heights", 0 };
+  const command_line::arg_descriptor<bool> arg_prune = { "prune", "Ask for pruned blocks when refreshing, as pruned wallets do", true };
+  command_line::add_arg(desc_options, arg_daemon_address);
+  command_line::add_arg(desc_options, arg_login);
+  command_line::add_arg(desc_options, arg_mix);
+  command_line::add_arg(desc_options, arg_concurrency);
+  command_line::add_arg(desc_options, arg_duration);
+  command_line::add_arg(desc_options, arg_timeout);
+  command_line::add_arg(desc_options, arg_seed);
+  command_line::add_arg(desc_options, arg_prune);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  bench_options options;
+  options.address = command_line::get_arg(vm, arg_daemon_address);
+  options.concurrency = std::max<size_t>(command_line::get_arg(vm, arg_concurrency), 1);
+  options.duration_ms = command_line::get_arg(vm, arg_duration) * 1000;
+  options.timeout_ms = command_line::get_arg(vm, arg_timeout);
+  options.seed = command_line::get_arg(vm, arg_seed);
+  options.prune = command_line::get_arg(vm, arg_prune);
+
+  const std::string login = command_line::get_arg(vm, arg_login);
+  const size_t colon = login.find(':');
+  if (!login.empty() && colon != std::string::npos)
+  {
+    options.login = epee::net_utils::http::login{};
+    options.login->username = login.substr(0, colon);
+    options.login->password = login.substr(colon + 1);
+  }
+
+  options.weights.assign(scenario_count, 0.0);
+  std::vector<std::string> pairs;
+  boost::split(pairs, command_line::get_arg(vm, arg_mix), boost::is_any_of(","));
+  for (const std::string &pair: pairs)
+  {
+    const size_t eq = pair.find('=');
+    const std::string name = pair.substr(0, eq);
+    size_t scenario = 0;
+    while (scenario < scenario_count && name != scenario_name(static_cast<scenario_t>(scenario)))
+      ++scenario;
+    if (scenario == scenario_count || eq == std::string::npos)
+    {
+      std::cerr << "Invalid mix entry: " << pair << std::endl;
+      return 1;
+    }
+    options.weights[scenario] = std::max(0.0, atof(pair.c_str() + eq + 1));
+  }
+  if (std::all_of(options.weights.begin(), options.weights.end(), [](double w) { return w <= 0.0; }))
+  {
+    std::cerr << "The mix has no scenario with a positive weight" << std::endl;
+    return 1;
+  }
+
+  chain_info chain;
+  if (!read_chain_info(options, chain))
+    return 2;
+
+  std::cout << "daemon " << options.address << ", height " << chain.height << ", rct outputs " << chain.rct_outputs
+    << ", concurrency " << options.concurrency << ", duration " << options.duration_ms / 1000 << " s, seed " << options.seed << std::endl;
+
+  std::vector<std::unique_ptr<worker>> workers;
+  for (size_t i = 0; i < options.concurrency; ++i)
+    workers.emplace_back(new worker(options, chain, i));
+
+  const uint64_t start = now_us();
+  const uint64_t deadline = start + options.duration_ms * 1000;
+  boost::thread_group threads;
+  for (auto &w: workers)
+    threads.create_thread([&w, deadline]() { w->run(deadline); });
+  threads.join_all();
+  const uint64_t elapsed = now_us() - start;
+
+  stats_map stats;
+  uint64_t failures = 0;
+  for (const auto &w: workers)
+    for (const auto &e: w->stats())
+    {
+      stats[e.first].merge(e.second);
+      failures += e.second.errors;
+    }
+  print_stats(stats, elapsed);
+  return failures ? 3 : 0;
+  CATCH_ENTRY_L0("main", 1);
+}
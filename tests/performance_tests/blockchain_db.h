@@ -0,0 +1,364 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <sstream>
+#include <boost/filesystem.hpp>
+
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/hardfork.h"
+#include "cryptonote_core/full_node_list.h"
+#include "serialization/binary_utils.h"
+
+#include "multi_tx_test_base.h"
+
+// A BlockchainLMDB in a temporary directory. Blocks are filled with copies of
+// one real 1 in, 2 out bulletproof tx, given fresh key images so the
+// database takes them, and a coinbase tx like the daemon's.
+//
+// The map starts at DEFAULT_MAPSIZE and only grows once that is mostly used,
+// so the effect of a growing database is measured by filling it first.
+class lmdb_test_base : private multi_tx_test_base<11>
+{
+public:
+  ~lmdb_test_base()
+  {
+    if (m_db)
+    {
+      if (m_db->is_open())
+        m_db->close();
+      m_hardfork.reset();
+      m_db.reset();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_path, ec);
+    }
+  }
+
+protected:
+  typedef multi_tx_test_base<11> base_class;
+
+  bool open(int db_flags)
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    account_base alice;
+    alice.generate();
+    std::vector<tx_destination_entry> destinations(2, tx_destination_entry(this->m_source_amount / 2, alice.get_keys().m_account_address, false));
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+    rct::RCTConfig rct_config{rct::RangeProofPaddedBulletproof, 2};
+    antd_construct_tx_params tx_params(network_version_9_full_nodes);
+    if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, tx_destination_entry{}, std::vector<uint8_t>(), m_tx, 0, tx_key, additional_tx_keys, rct_config, nullptr, tx_params))
+      return false;
+
+    m_path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("antd-perf-lmdb-%%%%-%%%%-%%%%");
+    m_db.reset(new BlockchainLMDB());
+    m_db->open(m_path.string(), db_flags);
+    m_hardfork.reset(new HardFork(*m_db, 1, 0));
+    m_hardfork->init();
+    m_db->set_hard_fork(m_hardfork.get());
+    m_top = crypto::null_hash;
+    m_rand = 0;
+    return add_block(0);
+  }
+
+  cryptonote::transaction make_tx()
+  {
+    cryptonote::transaction tx = m_tx;
+    for (auto &in: tx.vin)
+      boost::get<cryptonote::txin_to_key>(in).k_image = crypto::rand<crypto::key_image>();
+    tx.invalidate_hashes();
+    return tx;
+  }
+
+  bool add_block(size_t n_txs)
+  {
+    using namespace cryptonote;
+
+    const uint64_t height = m_db->height();
+    block b;
+    b.major_version = 1;
+    b.minor_version = 0;
+    b.timestamp = height;
+    b.prev_id = m_top;
+    b.miner_tx = this->m_miner_txs[0];
+    boost::get<txin_gen>(b.miner_tx.vin[0]).height = height;
+    b.miner_tx.invalidate_hashes();
+
+    std::vector<transaction> txs;
+    txs.reserve(n_txs);
+    for (size_t i = 0; i < n_txs; ++i)
+    {
+      txs.push_back(make_tx());
+      b.tx_hashes.push_back(get_transaction_hash(txs.back()));
+      for (const auto &in: txs.back().vin)
+        m_key_images.push_back(boost::get<txin_to_key>(in).k_image);
+    }
+
+    const size_t weight = 1000 + n_txs * 2000;
+    m_db->add_block(b, weight, weight, height + 1, height * 1000, txs);
+    m_top = get_block_hash(b);
+    return true;
+  }
+
+  // adds blocks in batches, as the import does
+  bool fill(uint64_t blocks, size_t n_txs)
+  {
+    m_db->set_batch_transactions(true);
+    while (blocks)
+    {
+      const uint64_t batch = std::min<uint64_t>(blocks, 1000);
+      m_db->batch_start(batch);
+      for (uint64_t i = 0; i < batch; ++i)
+        if (!add_block(n_txs))
+          return false;
+      m_db->batch_stop();
+      blocks -= batch;
+    }
+    m_db->set_batch_transactions(false);
+    return true;
+  }
+
+  // cheap enough not to weigh on reads taking a microsecond or so
+  uint64_t next_rand(uint64_t n)
+  {
+    m_rand = m_rand * 6364136223846793005ull + 1442695040888963407ull;
+    return (m_rand >> 17) % n;
+  }
+
+  std::unique_ptr<cryptonote::BlockchainDB> m_db;
+  std::unique_ptr<cryptonote::HardFork> m_hardfork;
+  cryptonote::transaction m_tx;
+  std::vector<crypto::key_image> m_key_images;
+
+private:
+  boost::filesystem::path m_path;
+  crypto::hash m_top;
+  uint64_t m_rand;
+};
+
+// Adding one block with its txs, committed on its own as when synced one by one
+template<int db_flags, size_t txs, uint64_t prefill>
+class test_lmdb_add_block : private lmdb_test_base
+{
+public:
+  static const size_t loop_count = db_flags == DBF_SAFE ? 100 : 1000;
+
+  bool init()
+  {
+    return open(db_flags) && fill(prefill, 10);
+  }
+
+  bool test()
+  {
+    return add_block(txs);
+  }
+};
+
+// Random access to the rct outputs, as done for each ring member
+template<uint64_t blocks>
+class test_lmdb_get_output_key : private lmdb_test_base
+{
+public:
+  static const size_t loop_count = 100000;
+
+  bool init()
+  {
+    if (!open(DBF_FAST) || !fill(blocks, 10))
+      return false;
+    m_outputs = m_db->get_num_outputs(0);
+    return m_outputs > 0;
+  }
+
+  bool test()
+  {
+    const cryptonote::output_data_t data = m_db->get_output_key((uint64_t)0, next_rand(m_outputs));
+    return data.height < m_db->height();
+  }
+
+private:
+  uint64_t m_outputs;
+};
+
+// Looking up spent key images, which is mostly misses when checking new txs
+template<uint64_t blocks, bool hit>
+class test_lmdb_has_key_image : private lmdb_test_base
+{
+public:
+  static const size_t loop_count = 100000;
+
+  bool init()
+  {
+    if (!open(DBF_FAST) || !fill(blocks, 10))
+      return false;
+    m_misses.resize(4096);
+    for (auto &k: m_misses)
+      k = crypto::rand<crypto::key_image>();
+    return true;
+  }
+
+  bool test()
+  {
+    if (hit)
+      return m_db->has_key_image(m_key_images[next_rand(m_key_images.size())]);
+    return !m_db->has_key_image(m_misses[next_rand(m_misses.size())]);
+  }
+
+private:
+  std::vector<crypto::key_image> m_misses;
+};
+
+// Reading a span of blocks, as served to syncing peers
+template<uint64_t count>
+class test_lmdb_get_blocks_range : private lmdb_test_base
+{
+public:
+  static const size_t loop_count = count < 100 ? 10000 : 1000;
+
+  bool init()
+  {
+    return open(DBF_FAST) && fill(std::max<uint64_t>(10000, count), 10);
+  }
+
+  bool test()
+  {
+    const uint64_t start = next_rand(m_db->height() - count);
+    return m_db->get_blocks_range(start, start + count - 1).size() == count;
+  }
+};
+
+// Adding a tx to a pool of pool_txs and removing it again, each in its own write txn
+template<int db_flags, size_t pool_txs>
+class test_lmdb_txpool : private lmdb_test_base
+{
+public:
+  static const size_t loop_count = db_flags == DBF_SAFE ? 100 : 1000;
+
+  bool init()
+  {
+    if (!open(db_flags))
+      return false;
+    m_blob = cryptonote::tx_to_blob(m_tx);
+    memset(&m_meta, 0, sizeof(m_meta));
+    m_meta.weight = m_blob.size();
+    m_meta.fee = 1000000;
+    m_meta.receive_time = time(nullptr);
+    m_db->block_txn_start(false);
+    for (size_t i = 0; i < pool_txs; ++i)
+      m_db->add_txpool_tx(crypto::rand<crypto::hash>(), m_blob, m_meta);
+    m_db->block_txn_stop();
+    return true;
+  }
+
+  bool test()
+  {
+    const crypto::hash txid = crypto::rand<crypto::hash>();
+    m_db->block_txn_start(false);
+    m_db->add_txpool_tx(txid, m_blob, m_meta);
+    m_db->block_txn_stop();
+    m_db->block_txn_start(false);
+    m_db->remove_txpool_tx(txid);
+    m_db->block_txn_stop();
+    return true;
+  }
+
+private:
+  cryptonote::blobdata m_blob;
+  cryptonote::txpool_tx_meta_t m_meta;
+};
+
+// Storing a full node list checkpoint of that many nodes, each with one
+// contributor and one locked contribution, as store_checkpoint does
+template<int db_flags, size_t nodes>
+class test_lmdb_full_node_data : private lmdb_test_base
+{
+public:
+  static const size_t loop_count = nodes < 5000 ? 100 : 20;
+
+  bool init()
+  {
+    if (!open(db_flags))
+      return false;
+
+    full_nodes::full_node_list::data_members_for_serialization data;
+    data.version = full_nodes::full_node_info::version_2_infinite_staking;
+    data.height = 100000;
+    data.infos.resize(nodes);
+    for (auto &entry: data.infos)
+    {
+      full_nodes::full_node_info &info = entry.info;
+      entry.pubkey = crypto::rand<crypto::public_key>();
+      info.version = full_nodes::full_node_info::version_2_infinite_staking;
+      info.registration_height = crypto::rand<uint32_t>() % data.height;
+      info.requested_unlock_height = 0;
+      info.last_reward_block_height = info.registration_height;
+      info.last_reward_transaction_index = 0;
+      info.total_contributed = info.total_reserved = info.staking_requirement = 1000000000000;
+      info.portions_for_operator = 0;
+      info.swarm_id = crypto::rand<full_nodes::swarm_id_t>();
+      info.operator_address.m_spend_public_key = crypto::rand<crypto::public_key>();
+      info.operator_address.m_view_public_key = crypto::rand<crypto::public_key>();
+      full_nodes::full_node_info::contributor_t contributor(info.staking_requirement, info.operator_address);
+      contributor.version = full_nodes::full_node_info::version_2_infinite_staking;
+      contributor.amount = info.staking_requirement;
+      full_nodes::full_node_info::contribution_t contribution;
+      contribution.key_image_pub_key = crypto::rand<crypto::public_key>();
+      contribution.key_image = crypto::rand<crypto::key_image>();
+      contribution.amount = info.staking_requirement;
+      contributor.locked_contributions.push_back(contribution);
+      info.contributors.push_back(contributor);
+    }
+
+    std::stringstream ss;
+    binary_archive<true> ba(ss);
+    if (!::serialization::serialize(ba, data))
+      return false;
+    m_blob = ss.str();
+    return true;
+  }
+
+  bool test()
+  {
+    m_db->block_txn_start(false);
+    m_db->set_full_node_data(m_blob);
+    m_db->block_txn_stop();
+    return true;
+  }
+
+private:
+  std::string m_blob;
+};
@@ -0,0 +1,219 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <unordered_map>
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/full_node_deregister.h"
+#include "cryptonote_core/full_node_list.h"
+#include "cryptonote_core/full_node_quorum_cop.h"
+
+// The quorum's signatures on one deregister, as checked by verify_deregister
+template<size_t votes>
+class test_deregister_votes_signature
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    m_block_height = 123456;
+    m_full_node_index = 3;
+    m_keys_and_sigs.resize(votes);
+    for (auto &key_and_sig : m_keys_and_sigs)
+    {
+      crypto::secret_key sec;
+      crypto::generate_keys(key_and_sig.first, sec);
+      key_and_sig.second = full_nodes::deregister_vote::sign_vote(m_block_height, m_full_node_index, key_and_sig.first, sec);
+    }
+    return full_nodes::deregister_vote::verify_votes_signature(m_block_height, m_full_node_index, m_keys_and_sigs);
+  }
+
+  bool test()
+  {
+    return full_nodes::deregister_vote::verify_votes_signature(m_block_height, m_full_node_index, m_keys_and_sigs);
+  }
+
+private:
+  uint64_t m_block_height;
+  uint32_t m_full_node_index;
+  std::vector<std::pair<crypto::public_key, crypto::signature>> m_keys_and_sigs;
+};
+
+// What verify_queued_uptime_proofs spends per proof
+class test_uptime_proof_signature
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init()
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(m_pubkey, sec);
+    m_timestamp = time(nullptr);
+    crypto::generate_signature(full_nodes::make_uptime_proof_hash(m_pubkey, m_timestamp), m_pubkey, sec, m_signature);
+    return true;
+  }
+
+  bool test()
+  {
+    const crypto::hash hash = full_nodes::make_uptime_proof_hash(m_pubkey, m_timestamp);
+    return crypto::check_signature(hash, m_pubkey, m_signature);
+  }
+
+private:
+  crypto::public_key m_pubkey;
+  uint64_t m_timestamp;
+  crypto::signature m_signature;
+};
+
+// Parsing the registration fields out of a staking tx's extra
+template<size_t contributors>
+class test_reg_tx_extract_fields
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init()
+  {
+    std::vector<cryptonote::account_public_address> addresses(contributors);
+    std::vector<uint64_t> portions(contributors, STAKING_PORTIONS / contributors);
+    for (auto &address : addresses)
+    {
+      address.m_spend_public_key = crypto::rand<crypto::public_key>();
+      address.m_view_public_key = crypto::rand<crypto::public_key>();
+    }
+    const crypto::signature signature = crypto::rand<crypto::signature>();
+    cryptonote::add_tx_pub_key_to_extra(m_tx, crypto::rand<crypto::public_key>());
+    cryptonote::add_full_node_pubkey_to_tx_extra(m_tx.extra, crypto::rand<crypto::public_key>());
+    return cryptonote::add_full_node_register_to_tx_extra(m_tx.extra, addresses, STAKING_PORTIONS / 2, portions, time(nullptr) + 1000, signature);
+  }
+
+  bool test()
+  {
+    std::vector<cryptonote::account_public_address> addresses;
+    uint64_t portions_for_operator;
+    std::vector<uint64_t> portions;
+    uint64_t expiration_timestamp;
+    crypto::public_key full_node_key;
+    crypto::signature signature;
+    return full_nodes::reg_tx_extract_fields(m_tx, addresses, portions_for_operator, portions, expiration_timestamp, full_node_key, signature) &&
+        addresses.size() == contributors;
+  }
+
+private:
+  cryptonote::transaction m_tx;
+};
+
+template<size_t content_bytes>
+class test_parse_article_from_nonce
+{
+public:
+  static const size_t loop_count = 100000;
+
+  bool init()
+  {
+    static_assert(content_bytes <= 0xffff, "Article content length is a 16 bit field");
+    const std::string title(64, 't'), publisher(32, 'p');
+    m_nonce = "ARTC";
+    m_nonce += (char)title.size();
+    m_nonce += title;
+    m_nonce += (char)(content_bytes >> 8);
+    m_nonce += (char)(content_bytes & 0xff);
+    m_nonce += std::string(content_bytes, 'c');
+    m_nonce += (char)publisher.size();
+    m_nonce += publisher;
+    return true;
+  }
+
+  bool test()
+  {
+    cryptonote::tx_extra_article_info article;
+    return cryptonote::parse_article_from_nonce(m_nonce, article) && article.content.size() == content_bytes;
+  }
+
+private:
+  cryptonote::blobdata m_nonce;
+};
+
+// Picks the next block's winner from a synthetic list of fully funded nodes
+// and moves it to the back of the queue as block_added would, or rebuilds
+// the whole queue, as done on init and rollback
+template<size_t nodes, bool rebuild>
+class test_full_node_winner
+{
+public:
+  static const size_t loop_count = !rebuild ? 10000 : nodes < 5000 ? 100 : 10;
+
+  bool init()
+  {
+    m_height = nodes;
+    for (size_t i = 0; i < nodes; ++i)
+    {
+      full_nodes::full_node_info &info = m_infos[crypto::rand<crypto::public_key>()];
+      info.staking_requirement = 1;
+      info.total_contributed = 1;
+      info.last_reward_block_height = crypto::rand<uint64_t>() % nodes;
+      info.last_reward_transaction_index = crypto::rand<uint32_t>();
+    }
+    for (const auto &i : m_infos)
+      m_queue.update(i.first, &i.second);
+    return m_queue.size() == m_infos.size();
+  }
+
+  bool test()
+  {
+    if (rebuild)
+    {
+      m_queue.clear();
+      for (const auto &i : m_infos)
+        m_queue.update(i.first, &i.second);
+      return m_queue.size() == m_infos.size();
+    }
+
+    const crypto::public_key winner = m_queue.front();
+    const auto it = m_infos.find(winner);
+    if (it == m_infos.end())
+      return false;
+    it->second.last_reward_block_height = ++m_height;
+    it->second.last_reward_transaction_index = 0;
+    m_queue.update(winner, &it->second);
+    return true;
+  }
+
+private:
+  uint64_t m_height;
+  std::unordered_map<crypto::public_key, full_nodes::full_node_info> m_infos;
+  full_nodes::reward_queue m_queue;
+};
@@ -61,6 +61,9 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "full_nodes.h"
+#include "blockchain_db.h"
+#include "serialization.h"
 
 namespace po = boost::program_options;
 
@@ -79,11 +82,13 @@ int main(int argc, char** argv)
   const command_line::arg_descriptor<bool> arg_stats = { "stats", "Including statistics (min/median)", false };
   const command_line::arg_descriptor<unsigned> arg_loop_multiplier = { "loop-multiplier", "Run for that many times more loops", 1 };
   const command_line::arg_descriptor<std::string> arg_timings_database = { "timings-database", "Keep timings history in a file" };
+  const command_line::arg_descriptor<std::string> arg_calibrate_multiexp = { "calibrate-multiexp", "Measure multiexp thresholds on this CPU, save them to a file for ANTD_MULTIEXP_TUNING, and exit" };
   command_line::add_arg(desc_options, arg_filter);
   command_line::add_arg(desc_options, arg_verbose);
   command_line::add_arg(desc_options, arg_stats);
   command_line::add_arg(desc_options, arg_loop_multiplier);
   command_line::add_arg(desc_options, arg_timings_database);
+  command_line::add_arg(desc_options, arg_calibrate_multiexp);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -95,6 +100,21 @@ int main(int argc, char** argv)
   if (!r)
     return 1;
 
+  const std::string calibrate_multiexp_file = command_line::get_arg(vm, arg_calibrate_multiexp);
+  if (!calibrate_multiexp_file.empty())
+  {
+    const rct::multiexp_tuning tuning = calibrate_multiexp();
+    std::cout << "straus up to " << tuning.straus_limit << " points" << std::endl;
+    for (size_t i = 0; i < sizeof(tuning.pippenger_c_limit) / sizeof(tuning.pippenger_c_limit[0]); ++i)
+      std::cout << "pippenger c=" << i + 2 << " up to " << tuning.pippenger_c_limit[i] << " points" << std::endl;
+    if (!rct::save_multiexp_tuning(calibrate_multiexp_file, tuning))
+    {
+      std::cerr << "Failed to save multiexp tuning to " << calibrate_multiexp_file << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
   const std::string filter = tools::glob_to_regex(command_line::get_arg(vm, arg_filter));
   const std::string timings_database = command_line::get_arg(vm, arg_timings_database);
   Params p;
@@ -281,6 +301,65 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_zeroCommitUncached);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_zeroCommitCached);
 
+  TEST_PERFORMANCE1(filter, p, test_deregister_votes_signature, 7); // MIN_VOTES_TO_KICK_FULL_NODE
+  TEST_PERFORMANCE1(filter, p, test_deregister_votes_signature, 10);
+  TEST_PERFORMANCE0(filter, p, test_uptime_proof_signature);
+  TEST_PERFORMANCE1(filter, p, test_reg_tx_extract_fields, 1);
+  TEST_PERFORMANCE1(filter, p, test_reg_tx_extract_fields, 4);
+  TEST_PERFORMANCE1(filter, p, test_parse_article_from_nonce, 256);
+  TEST_PERFORMANCE1(filter, p, test_parse_article_from_nonce, 16384);
+  TEST_PERFORMANCE2(filter, p, test_full_node_winner, 1000, false);
+  TEST_PERFORMANCE2(filter, p, test_full_node_winner, 5000, false);
+  TEST_PERFORMANCE2(filter, p, test_full_node_winner, 20000, false);
+  TEST_PERFORMANCE2(filter, p, test_full_node_winner, 1000, true);
+  TEST_PERFORMANCE2(filter, p, test_full_node_winner, 5000, true);
+  TEST_PERFORMANCE2(filter, p, test_full_node_winner, 20000, true);
+
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_SAFE, 10, 0);
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_FAST, 10, 0);
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_FASTEST, 10, 0);
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_FAST, 0, 0);
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_FAST, 100, 0);
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_FAST, 10, 20000);
+  TEST_PERFORMANCE3(filter, p, test_lmdb_add_block, DBF_FASTEST, 10, 20000);
+  TEST_PERFORMANCE1(filter, p, test_lmdb_get_output_key, 1000);
+  TEST_PERFORMANCE1(filter, p, test_lmdb_get_output_key, 20000);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_has_key_image, 1000, true);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_has_key_image, 1000, false);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_has_key_image, 20000, true);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_has_key_image, 20000, false);
+  TEST_PERFORMANCE1(filter, p, test_lmdb_get_blocks_range, 20);
+  TEST_PERFORMANCE1(filter, p, test_lmdb_get_blocks_range, 1000);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_txpool, DBF_SAFE, 0);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_txpool, DBF_FAST, 0);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_txpool, DBF_FAST, 5000);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_full_node_data, DBF_SAFE, 1000);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_full_node_data, DBF_FAST, 1000);
+  TEST_PERFORMANCE2(filter, p, test_lmdb_full_node_data, DBF_FAST, 10000);
+
+  TEST_PERFORMANCE1(filter, p, test_parse_tx_from_blob, 2);
+  TEST_PERFORMANCE1(filter, p, test_parse_tx_from_blob, 16);
+  TEST_PERFORMANCE1(filter, p, test_parse_block_from_blob, 0);
+  TEST_PERFORMANCE1(filter, p, test_parse_block_from_blob, 100);
+  TEST_PERFORMANCE1(filter, p, test_get_transaction_hash, 2);
+  TEST_PERFORMANCE1(filter, p, test_get_transaction_hash, 16);
+  TEST_PERFORMANCE1(filter, p, test_tx_to_blob, 2);
+  TEST_PERFORMANCE1(filter, p, test_tx_to_blob, 16);
+  TEST_PERFORMANCE4(filter, p, test_get_blocks_fast_response, 100, 10, ps_binary, false);
+  TEST_PERFORMANCE4(filter, p, test_get_blocks_fast_response, 100, 10, ps_binary, true);
+  TEST_PERFORMANCE4(filter, p, test_get_blocks_fast_response, 100, 10, ps_json, false);
+  TEST_PERFORMANCE4(filter, p, test_get_blocks_fast_response, 100, 10, ps_json, true);
+  TEST_PERFORMANCE4(filter, p, test_get_blocks_fast_response, 1000, 0, ps_binary, false);
+  TEST_PERFORMANCE4(filter, p, test_get_blocks_fast_response, 1000, 0, ps_binary, true);
+  TEST_PERFORMANCE2(filter, p, test_json_object_tx, 2, json_to_document);
+  TEST_PERFORMANCE2(filter, p, test_json_object_tx, 2, json_to_writer);
+  TEST_PERFORMANCE2(filter, p, test_json_object_tx, 2, json_from_document);
+  TEST_PERFORMANCE2(filter, p, test_json_object_tx, 16, json_to_document);
+  TEST_PERFORMANCE2(filter, p, test_json_object_tx, 16, json_to_writer);
+  TEST_PERFORMANCE2(filter, p, test_json_object_tx, 16, json_from_document);
+  TEST_PERFORMANCE2(filter, p, test_parse_tx_extra, 2, false);
+  TEST_PERFORMANCE2(filter, p, test_parse_tx_extra, 16, true);
+
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 2);
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 4);
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 8);
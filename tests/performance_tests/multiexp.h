@@ -30,7 +30,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
+#include <boost/chrono.hpp>
 #include "ringct/rctOps.h"
 #include "ringct/multiexp.h"
 
@@ -92,3 +94,66 @@ private:
   std::shared_ptr<rct::pippenger_cached_data> pippenger_cache;
   rct::key res;
 };
+
+// Measures the straus/pippenger crossover and the best pippenger window size
+// on this CPU, for sizes up to max_points
+inline rct::multiexp_tuning calibrate_multiexp(size_t max_points = 4096)
+{
+  typedef boost::chrono::high_resolution_clock clock;
+
+  std::vector<rct::MultiexpData> points(max_points);
+  for (auto &point: points)
+  {
+    point.scalar = rct::skGen();
+    const rct::key P = rct::scalarmultBase(rct::skGen());
+    ge_frombytes_vartime(&point.point, P.bytes);
+  }
+
+  // four sizes per doubling
+  std::vector<size_t> sizes;
+  for (double n = 2; n <= max_points; n *= 1.19)
+    if (sizes.empty() || (size_t)n != sizes.back())
+      sizes.push_back(n);
+
+  const auto time_ns = [](const std::vector<rct::MultiexpData> &data, size_t c) {
+    const size_t loops = std::max<size_t>(2, 8192 / data.size());
+    const clock::time_point start = clock::now();
+    for (size_t i = 0; i < loops; ++i)
+      c ? rct::pippenger(data, NULL, 0, c) : rct::straus(data);
+    return boost::chrono::duration_cast<boost::chrono::nanoseconds>(clock::now() - start).count() / loops;
+  };
+
+  rct::multiexp_tuning tuning;
+  tuning.straus_limit = 0;
+  bool straus_best = true;
+  size_t best_c = 2;
+  for (size_t &limit: tuning.pippenger_c_limit)
+    limit = 0;
+
+  for (size_t n: sizes)
+  {
+    const std::vector<rct::MultiexpData> data(points.begin(), points.begin() + n);
+
+    // the best window only grows with size, so only look at the neighbours
+    size_t c = best_c;
+    int64_t best_ns = time_ns(data, c);
+    for (size_t next = best_c + 1; next <= 9; ++next)
+    {
+      const int64_t ns = time_ns(data, next);
+      if (ns >= best_ns)
+        break;
+      best_ns = ns;
+      c = next;
+    }
+    best_c = c;
+    for (size_t i = best_c - 2; i < sizeof(tuning.pippenger_c_limit) / sizeof(tuning.pippenger_c_limit[0]); ++i)
+      tuning.pippenger_c_limit[i] = n;
+
+    if (straus_best && time_ns(data, 0) < best_ns)
+      tuning.straus_limit = n;
+    else
+      straus_best = false;
+  }
+
+  return tuning;
+}
@@ -38,6 +38,7 @@
 
 #include "misc_language.h"
 #include "stats.h"
+#include "common/alloc_profiler.h"
 #include "common/perf_timer.h"
 #include "common/timings.h"
 
@@ -67,6 +68,18 @@ private:
   clock::time_point m_start;
 };
 
+// operator new calls and bytes so far, all scopes together, zero when not built with ALLOC_PROFILING
+inline std::pair<uint64_t, uint64_t> get_total_allocations()
+{
+  std::pair<uint64_t, uint64_t> total(0, 0);
+  for (const auto &s: tools::get_alloc_stats())
+  {
+    total.first += s.allocations;
+    total.second += s.bytes;
+  }
+  return total;
+}
+
 struct Params
 {
   TimingsDatabase td;
@@ -81,6 +94,8 @@ class test_runner
 public:
   test_runner(const Params &params)
     : m_elapsed(0)
+    , m_allocations(0)
+    , m_allocated_bytes(0)
     , m_params(params)
     , m_per_call_timers(T::loop_count * params.loop_multiplier, {true})
   {
@@ -100,6 +115,7 @@ public:
     if (m_params.verbose)
       std::cout << "Warm up: " << timer.elapsed_ms() << " ms" << std::endl;
 
+    const std::pair<uint64_t, uint64_t> allocations = get_total_allocations();
     timer.start();
     for (size_t i = 0; i < T::loop_count * m_params.loop_multiplier; ++i)
     {
@@ -111,12 +127,16 @@ public:
         m_per_call_timers[i].pause();
     }
     m_elapsed = timer.elapsed_ms();
+    m_allocations = get_total_allocations().first - allocations.first;
+    m_allocated_bytes = get_total_allocations().second - allocations.second;
     m_stats.reset(new Stats<tools::PerformanceTimer, uint64_t>(m_per_call_timers));
 
     return true;
   }
 
   int elapsed_time() const { return m_elapsed; }
+  double allocations_per_call() const { return (double)m_allocations / (T::loop_count * m_params.loop_multiplier); }
+  double allocated_bytes_per_call() const { return (double)m_allocated_bytes / (T::loop_count * m_params.loop_multiplier); }
   size_t get_size() const { return m_stats->get_size(); }
 
   int time_per_call(int scale = 1) const
@@ -156,6 +176,8 @@ private:
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
   int m_elapsed;
+  uint64_t m_allocations;
+  uint64_t m_allocated_bytes;
   Params m_params;
   std::vector<tools::PerformanceTimer> m_per_call_timers;
   std::unique_ptr<Stats<tools::PerformanceTimer, uint64_t>> m_stats;
@@ -212,6 +234,11 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
     params.td.add(test_name, {time(NULL), runner.get_size(), min, max, mean, med, stddev, npskew, quantiles});
 
     std::cout << (params.verbose ? "  time per call: " : " ") << time_per_call << " " << unit << "/call" << (params.verbose ? "\n" : "");
+    if (tools::is_alloc_profiling_enabled())
+    {
+      std::cout << (params.verbose ? "  allocations:   " : ", ") << runner.allocations_per_call() << " allocs/call, "
+        << (uint64_t)runner.allocated_bytes_per_call() << " bytes/call" << (params.verbose ? "\n" : "");
+    }
     if (params.stats)
     {
       uint64_t mins = min / scale;
@@ -0,0 +1,288 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "serialization/json_object.h"
+#include "storages/portable_storage_template_helper.h"
+
+#include "multi_tx_test_base.h"
+
+// A 1 in bulletproof tx with a ring of 11 and a_outputs outputs, as found in
+// blocks and the pool, and a block naming a_txes copies of it, the blobs
+// parse heavy paths like block sync and wallet refresh go through
+template<size_t a_outputs, size_t a_txes = 0>
+class serialization_test_base : private multi_tx_test_base<11>
+{
+protected:
+  typedef multi_tx_test_base<11> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    account_base alice;
+    alice.generate();
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount - a_outputs + 1, alice.get_keys().m_account_address, false));
+    for (size_t n = 1; n < a_outputs; ++n)
+      destinations.push_back(tx_destination_entry(1, alice.get_keys().m_account_address, false));
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+    rct::RCTConfig rct_config{rct::RangeProofPaddedBulletproof, 2};
+    antd_construct_tx_params tx_params(network_version_9_full_nodes);
+    if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, tx_destination_entry{}, std::vector<uint8_t>(), m_tx, 0, tx_key, additional_tx_keys, rct_config, nullptr, tx_params))
+      return false;
+    m_tx_blob = tx_to_blob(m_tx);
+
+    m_block.major_version = network_version_9_full_nodes;
+    m_block.minor_version = network_version_9_full_nodes;
+    m_block.timestamp = time(nullptr);
+    m_block.prev_id = crypto::rand<crypto::hash>();
+    m_block.miner_tx = this->m_miner_txs[0];
+    m_block.tx_hashes.assign(a_txes, get_transaction_hash(m_tx));
+    m_block_blob = block_to_blob(m_block);
+    return !m_tx_blob.empty() && !m_block_blob.empty();
+  }
+
+  cryptonote::transaction m_tx;
+  cryptonote::blobdata m_tx_blob;
+  cryptonote::block m_block;
+  cryptonote::blobdata m_block_blob;
+};
+
+template<size_t outputs>
+class test_parse_tx_from_blob : private serialization_test_base<outputs>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init() { return serialization_test_base<outputs>::init(); }
+
+  bool test()
+  {
+    cryptonote::transaction tx;
+    return cryptonote::parse_and_validate_tx_from_blob(this->m_tx_blob, tx);
+  }
+};
+
+template<size_t txes>
+class test_parse_block_from_blob : private serialization_test_base<2, txes>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init() { return serialization_test_base<2, txes>::init(); }
+
+  bool test()
+  {
+    cryptonote::block b;
+    return cryptonote::parse_and_validate_block_from_blob(this->m_block_blob, b) && b.tx_hashes.size() == txes;
+  }
+};
+
+// the tx caches its hash, so that is dropped first, as for a tx just parsed
+template<size_t outputs>
+class test_get_transaction_hash : private serialization_test_base<outputs>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init() { return serialization_test_base<outputs>::init(); }
+
+  bool test()
+  {
+    this->m_tx.invalidate_hashes();
+    crypto::hash hash;
+    return cryptonote::get_transaction_hash(this->m_tx, hash);
+  }
+};
+
+template<size_t outputs>
+class test_tx_to_blob : private serialization_test_base<outputs>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init() { return serialization_test_base<outputs>::init(); }
+
+  bool test()
+  {
+    cryptonote::blobdata blob;
+    return cryptonote::t_serializable_object_to_blob(this->m_tx, blob) && blob.size() == this->m_tx_blob.size();
+  }
+};
+
+enum portable_storage_format { ps_binary, ps_json };
+
+// A getblocks.bin response of as many blocks, each carrying txes 2 output
+// txes, stored to or loaded from the epee portable storage it is sent in
+template<size_t blocks, size_t txes, portable_storage_format format, bool load>
+class test_get_blocks_fast_response : private serialization_test_base<2, txes>
+{
+public:
+  static const size_t loop_count = blocks * (txes + 1) > 1000 ? 20 : 200;
+
+  bool init()
+  {
+    if (!serialization_test_base<2, txes>::init())
+      return false;
+    m_res.blocks.resize(blocks);
+    m_res.output_indices.resize(blocks);
+    for (size_t i = 0; i < blocks; ++i)
+    {
+      m_res.blocks[i].block = this->m_block_blob;
+      m_res.blocks[i].txs.assign(txes, this->m_tx_blob);
+      m_res.output_indices[i].indices.resize(txes + 1);
+      for (auto &tx_indices: m_res.output_indices[i].indices)
+        tx_indices.indices = { crypto::rand<uint64_t>(), crypto::rand<uint64_t>() };
+    }
+    m_res.start_height = 1000000;
+    m_res.current_height = m_res.start_height + blocks;
+    m_res.status = CORE_RPC_STATUS_OK;
+    m_res.untrusted = false;
+    return store(m_stored);
+  }
+
+  bool test()
+  {
+    if (!load)
+    {
+      std::string stored;
+      return store(stored) && stored.size() == m_stored.size();
+    }
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res;
+    const bool r = format == ps_binary ? epee::serialization::load_t_from_binary(res, m_stored) : epee::serialization::load_t_from_json(res, m_stored);
+    return r && res.blocks.size() == blocks;
+  }
+
+private:
+  bool store(std::string &stored)
+  {
+    return format == ps_binary ? epee::serialization::store_t_to_binary(m_res, stored) : epee::serialization::store_t_to_json(m_res, stored);
+  }
+
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response m_res;
+  std::string m_stored;
+};
+
+enum json_object_op { json_to_document, json_to_writer, json_from_document };
+
+// cryptonote::json conversions of a tx, as done by the ZMQ RPC: building a
+// rapidjson document and writing it out, streaming straight to a writer, or
+// parsing the text back into a tx
+template<size_t outputs, json_object_op op>
+class test_json_object_tx : private serialization_test_base<outputs>
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    if (!serialization_test_base<outputs>::init())
+      return false;
+    rapidjson::StringBuffer buf;
+    cryptonote::json::writer writer{buf};
+    cryptonote::json::toJsonValue(writer, this->m_tx);
+    m_json.assign(buf.GetString(), buf.GetSize());
+    return !m_json.empty();
+  }
+
+  bool test()
+  {
+    if (op == json_from_document)
+    {
+      rapidjson::Document doc;
+      doc.Parse(m_json.c_str());
+      if (doc.HasParseError())
+        return false;
+      cryptonote::transaction tx;
+      cryptonote::json::fromJsonValue(doc, tx);
+      return tx.vout.size() == outputs;
+    }
+    rapidjson::StringBuffer buf;
+    cryptonote::json::writer writer{buf};
+    if (op == json_to_document)
+    {
+      rapidjson::Document doc;
+      cryptonote::json::toJsonValue(doc, this->m_tx, doc);
+      doc.Accept(writer);
+    }
+    else
+    {
+      cryptonote::json::toJsonValue(writer, this->m_tx);
+    }
+    return buf.GetSize() == m_json.size();
+  }
+
+private:
+  std::string m_json;
+};
+
+// A tx extra with the tx public key, one additional public key per output
+// when additional_keys, and an encrypted payment id, as a wallet scans it
+template<size_t outputs, bool additional_keys>
+class test_parse_tx_extra
+{
+public:
+  static const size_t loop_count = 100000;
+
+  bool init()
+  {
+    cryptonote::add_tx_pub_key_to_extra(m_extra, crypto::rand<crypto::public_key>());
+    if (additional_keys)
+    {
+      std::vector<crypto::public_key> keys(outputs);
+      for (auto &key: keys)
+        key = crypto::rand<crypto::public_key>();
+      if (!cryptonote::add_additional_tx_pub_keys_to_extra(m_extra, keys))
+        return false;
+    }
+    cryptonote::blobdata nonce;
+    cryptonote::set_encrypted_payment_id_to_tx_extra_nonce(nonce, crypto::rand<crypto::hash8>());
+    return cryptonote::add_extra_nonce_to_tx_extra(m_extra, nonce);
+  }
+
+  bool test()
+  {
+    std::vector<cryptonote::tx_extra_field> fields;
+    return cryptonote::parse_tx_extra(m_extra, fields) && fields.size() == (additional_keys ? 3 : 2);
+  }
+
+private:
+  std::vector<uint8_t> m_extra;
+};
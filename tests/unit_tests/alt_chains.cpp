@@ -0,0 +1,176 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+cryptonote::block make_block(uint64_t height, const crypto::hash &prev_id, uint32_t nonce)
+{
+  cryptonote::block b;
+  b.major_version = 7;
+  b.minor_version = 7;
+  b.timestamp = height;
+  b.prev_id = prev_id;
+  b.nonce = nonce;
+  b.miner_tx.version = cryptonote::transaction::version_1;
+  b.miner_tx.vin.push_back(cryptonote::txin_gen{height});
+  return b;
+}
+
+class ChainDB: public cryptonote::BaseTestDB
+{
+public:
+  ChainDB(size_t height)
+  {
+    m_open = true;
+    for (size_t i = 0; i < height; ++i)
+      blocks.push_back(make_block(i, blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()), 0));
+  }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { return blocks.at(h); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks.at(h)); }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()); }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back(); }
+
+  std::vector<cryptonote::block> blocks;
+};
+
+struct alt_chain_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  ChainDB *db;
+  uint32_t nonce;
+
+  alt_chain_test(): db(new ChainDB(10)), nonce(0)
+  {
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 1));
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+
+  // extends an alternative chain the way handle_alternative_block does,
+  // returning the hashes of the new blocks
+  std::vector<crypto::hash> extend(crypto::hash parent, uint64_t parent_height, size_t count)
+  {
+    std::vector<crypto::hash> hashes;
+    for (size_t i = 0; i < count; ++i)
+    {
+      cryptonote::Blockchain::block_extended_info bei = {};
+      bei.bl = make_block(parent_height + 1 + i, parent, ++nonce);
+      bei.height = parent_height + 1 + i;
+      const crypto::hash id = cryptonote::get_block_hash(bei.bl);
+      bc().m_alternative_chains.insert(std::make_pair(id, bei));
+      bc().m_alternative_tips.erase(parent);
+      bc().m_alternative_tips[id] = ++bc().m_alternative_tips_seq;
+      hashes.push_back(id);
+      parent = id;
+    }
+    return hashes;
+  }
+  crypto::hash main_hash(uint64_t height) const { return db->get_block_hash_from_height(height); }
+
+  // alternative chain tip -> length of the chain down to the main chain
+  std::unordered_map<crypto::hash, size_t> chains()
+  {
+    std::unordered_map<crypto::hash, size_t> result;
+    for (const auto &chain : bc().get_alternative_chains())
+      result[chain.second.front()] = chain.second.size();
+    return result;
+  }
+};
+
+}
+
+TEST(alt_chains, tips_follow_the_branches)
+{
+  alt_chain_test t;
+  const std::vector<crypto::hash> a = t.extend(t.main_hash(5), 5, 4);
+  const std::vector<crypto::hash> b = t.extend(t.main_hash(8), 8, 2);
+  const std::vector<crypto::hash> c = t.extend(a[1], 7, 3);
+
+  ASSERT_EQ(t.bc().m_alternative_tips.size(), 3);
+  ASSERT_EQ(t.chains(), (std::unordered_map<crypto::hash, size_t>{{a.back(), 4}, {b.back(), 2}, {c.back(), 5}}));
+
+  // dropping blocks in bulk recomputes the tips from the store
+  t.bc().m_alternative_chains.erase(c[2]);
+  t.bc().m_alternative_chains.erase(c[1]);
+  t.bc().m_alternative_chains.erase(b[1]);
+  t.bc().rebuild_alternative_tips();
+  ASSERT_EQ(t.chains(), (std::unordered_map<crypto::hash, size_t>{{a.back(), 4}, {b[0], 1}, {c[0], 3}}));
+}
+
+TEST(alt_chains, stale_branches_are_evicted_down_to_their_fork)
+{
+  alt_chain_test t;
+  const size_t fork_len = 1000, old_len = BLOCKCHAIN_MAX_ALT_BLOCKS - fork_len, other_len = 600, new_len = 200;
+  const std::vector<crypto::hash> old_branch = t.extend(t.main_hash(5), 5, fork_len + old_len);
+  const std::vector<crypto::hash> other_branch = t.extend(t.main_hash(9), 9, other_len);
+  const std::vector<crypto::hash> new_branch = t.extend(old_branch[fork_len - 1], 5 + fork_len, new_len);
+  ASSERT_GT(t.bc().m_alternative_chains.size(), BLOCKCHAIN_MAX_ALT_BLOCKS);
+
+  // the least recently extended branch goes, but not the blocks it shares
+  t.bc().evict_stale_alternative_blocks(new_branch.back());
+  ASSERT_EQ(t.bc().m_alternative_chains.size(), fork_len + other_len + new_len);
+  ASSERT_EQ(t.chains(), (std::unordered_map<crypto::hash, size_t>{{other_branch.back(), other_len}, {new_branch.back(), fork_len + new_len}}));
+  ASSERT_EQ(t.bc().m_alternative_chains.count(old_branch[fork_len - 1]), 1);
+  ASSERT_EQ(t.bc().m_alternative_chains.count(old_branch[fork_len]), 0);
+
+  // under the bound nothing is dropped
+  t.bc().evict_stale_alternative_blocks(new_branch.back());
+  ASSERT_EQ(t.bc().m_alternative_chains.size(), fork_len + other_len + new_len);
+}
+
+TEST(alt_chains, the_extended_branch_is_kept)
+{
+  alt_chain_test t;
+  const std::vector<crypto::hash> kept = t.extend(t.main_hash(5), 5, BLOCKCHAIN_MAX_ALT_BLOCKS - 100);
+  const std::vector<crypto::hash> newer = t.extend(t.main_hash(7), 7, 200);
+
+  // the kept branch is the least recently extended, so the newer one goes
+  t.bc().evict_stale_alternative_blocks(kept.back());
+  ASSERT_EQ(t.chains(), (std::unordered_map<crypto::hash, size_t>{{kept.back(), kept.size()}}));
+  ASSERT_EQ(t.bc().m_alternative_chains.count(newer.front()), 0);
+
+  // with only the kept branch left, it stays even over the bound
+  t.extend(kept.back(), 5 + kept.size(), 200);
+  const crypto::hash tip = t.bc().m_alternative_tips.begin()->first;
+  t.bc().evict_stale_alternative_blocks(tip);
+  ASSERT_EQ(t.bc().m_alternative_chains.size(), BLOCKCHAIN_MAX_ALT_BLOCKS + 100);
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <map>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "common/arena.h"
+
+TEST(arena, alignment)
+{
+  tools::arena a(256);
+  for (size_t align: {1, 2, 8, 16, 64})
+  {
+    a.allocate(1, 1);
+    void *ptr = a.allocate(3, align);
+    ASSERT_EQ((uintptr_t)ptr & (align - 1), 0);
+  }
+}
+
+TEST(arena, large_allocation)
+{
+  tools::arena a(64);
+  char *ptr = static_cast<char*>(a.allocate(1000, 8));
+  memset(ptr, 1, 1000);
+  ASSERT_GE(a.capacity(), 1000);
+}
+
+TEST(arena, oversized_allocation)
+{
+  tools::arena a(256);
+  a.allocate(8, 8);
+  EXPECT_THROW(a.allocate(SIZE_MAX - 8, 16), std::bad_alloc);
+  EXPECT_THROW(a.allocate(SIZE_MAX, 1), std::bad_alloc);
+
+  // n * sizeof(T) must not wrap around to a small allocation
+  tools::arena_allocator<uint64_t> allocator(a);
+  EXPECT_THROW(allocator.allocate(SIZE_MAX / sizeof(uint64_t) + 2), std::bad_alloc);
+
+  // the arena is still usable
+  void *p = a.allocate(16, 8);
+  ASSERT_NE(p, nullptr);
+  memset(p, 0, 16);
+}
+
+TEST(arena, reset_coalesces)
+{
+  tools::arena a(64);
+  for (int i = 0; i < 100; ++i)
+    a.allocate(40, 8);
+  const size_t capacity = a.capacity();
+  ASSERT_GE(capacity, 4000);
+  a.reset();
+  ASSERT_EQ(a.capacity(), capacity);
+  for (int i = 0; i < 100; ++i)
+    a.allocate(40, 8);
+  ASSERT_EQ(a.capacity(), capacity);
+}
+
+TEST(arena, containers)
+{
+  tools::arena a(1024);
+  for (int round = 0; round < 3; ++round)
+  {
+    {
+      typedef std::vector<int, tools::arena_allocator<int>> vector_t;
+      std::map<int, vector_t, std::less<int>, tools::arena_allocator<std::pair<const int, vector_t>>> m{tools::arena_allocator<int>(a)};
+      for (int i = 0; i < 100; ++i)
+      {
+        vector_t &v = m.emplace(i, vector_t(tools::arena_allocator<int>(a))).first->second;
+        for (int j = 0; j < i; ++j)
+          v.push_back(j);
+      }
+      for (int i = 0; i < 100; ++i)
+      {
+        ASSERT_EQ(m.at(i).size(), i);
+        for (int j = 0; j < i; ++j)
+          ASSERT_EQ(m.at(i)[j], j);
+      }
+    }
+    a.reset();
+  }
+}
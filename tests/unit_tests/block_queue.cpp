@@ -85,3 +85,61 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, span_size_follows_rate)
+{
+  cryptonote::block_queue bq;
+  ASSERT_EQ(bq.get_span_size(uuid1(), 100), 100);
+
+  // uuid1 does 1 MB/s, uuid2 a quarter of that
+  for (int i = 0; i < 10; ++i)
+  {
+    bq.update_peer_model(uuid1(), 100, 1000000, 1.0f);
+    bq.update_peer_model(uuid2(), 100, 1000000, 4.0f);
+  }
+  cryptonote::block_queue::peer_model model;
+  ASSERT_TRUE(bq.get_peer_model(uuid1(), model));
+  ASSERT_EQ(model.samples, 10);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 100), 100);
+  const uint64_t slow = bq.get_span_size(uuid2(), 100);
+  ASSERT_GE(slow, 20);
+  ASSERT_LE(slow, 30);
+  // never below an eighth of a span
+  ASSERT_EQ(bq.get_span_size(uuid2(), 16), 4);
+  ASSERT_LT(bq.get_expected_span_time(uuid1(), 100), bq.get_expected_span_time(uuid2(), 100));
+
+  bq.flush_spans(uuid2(), true);
+  ASSERT_FALSE(bq.get_peer_model(uuid2(), model));
+  ASSERT_LT(bq.get_expected_span_time(uuid2(), 100), 0.0f);
+}
+
+TEST(block_queue, peer_model_latency)
+{
+  cryptonote::block_queue bq;
+  // 1 MB/s with 0.5 seconds of latency, in large and small spans
+  for (int i = 0; i < 50; ++i)
+  {
+    bq.update_peer_model(uuid1(), 100, 1000000, 1.5f);
+    bq.update_peer_model(uuid1(), 10, 100000, 0.6f);
+  }
+  cryptonote::block_queue::peer_model model;
+  ASSERT_TRUE(bq.get_peer_model(uuid1(), model));
+  ASSERT_GT(model.rate, 700000.0f);
+  ASSERT_LT(model.rate, 1300000.0f);
+  ASSERT_GT(model.latency, 0.3f);
+  ASSERT_LT(model.latency, 0.7f);
+}
+
+TEST(block_queue, out_of_order_size)
+{
+  cryptonote::block_queue bq;
+  std::vector<cryptonote::block_complete_entry> bcel(10);
+  bq.add_blocks(100, bcel, uuid1(), 1000.0f, 1000);
+  bq.add_blocks(120, bcel, uuid1(), 1000.0f, 2000);
+  bq.add_blocks(110, 10, uuid2());
+  bq.add_blocks(130, bcel, uuid2(), 1000.0f, 4000);
+  ASSERT_EQ(bq.get_out_of_order_data_size(100), 6000);
+  ASSERT_EQ(bq.get_out_of_order_data_size(90), 7000);
+  bq.add_blocks(110, bcel, uuid2(), 1000.0f, 500);
+  ASSERT_EQ(bq.get_out_of_order_data_size(100), 0);
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+class ChainDB: public cryptonote::BaseTestDB
+{
+public:
+  ChainDB(size_t height)
+  {
+    m_open = true;
+    for (size_t i = 0; i < height; ++i)
+      add();
+  }
+
+  void add()
+  {
+    cryptonote::block b;
+    b.major_version = 7;
+    b.minor_version = 7;
+    b.timestamp = blocks.size();
+    b.miner_tx.version = cryptonote::transaction::version_1;
+    b.miner_tx.vin.push_back(cryptonote::txin_gen{blocks.size()});
+    blocks.push_back(b);
+  }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { return blocks.at(h); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks.at(h)); }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()); }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back(); }
+
+  std::vector<cryptonote::block> blocks;
+};
+
+struct template_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  ChainDB *db;
+
+  template_test(): db(new ChainDB(10))
+  {
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 1));
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+
+  crypto::hash miner_tx_hash(const cryptonote::account_base &miner, const cryptonote::blobdata &nonce = {})
+  {
+    cryptonote::block b;
+    cryptonote::difficulty_type diffic;
+    uint64_t height, expected_reward;
+    EXPECT_TRUE(bc().create_block_template(b, miner.get_keys().m_account_address, diffic, height, expected_reward, nonce));
+    EXPECT_EQ(height, db->height());
+    return cryptonote::get_transaction_hash(b.miner_tx);
+  }
+  // makes the cached templates look like they were built from older pool contents
+  void move_pool_cookie()
+  {
+    for (auto &btc : bc().m_btc)
+      btc.pool_cookie -= 1;
+  }
+};
+
+}
+
+TEST(block_template_cache, same_request_is_served_from_the_cache)
+{
+  template_test t;
+  cryptonote::account_base miner;
+  miner.generate();
+
+  const crypto::hash first = t.miner_tx_hash(miner);
+  ASSERT_EQ(t.miner_tx_hash(miner), first);
+  ASSERT_EQ(t.bc().m_btc.size(), 1);
+
+  // a miner tx is built from scratch with a fresh tx key
+  ASSERT_NE(t.miner_tx_hash(miner, "nonce"), first);
+  ASSERT_EQ(t.bc().m_btc.size(), 2);
+}
+
+TEST(block_template_cache, pool_change_keeps_the_miner_tx)
+{
+  template_test t;
+  cryptonote::account_base miner, other_miner;
+  miner.generate();
+  other_miner.generate();
+
+  const crypto::hash first = t.miner_tx_hash(miner);
+  const uint64_t cookie = t.bc().m_btc.front().pool_cookie;
+
+  // same selected fee and weight: the miner tx is reused
+  t.move_pool_cookie();
+  ASSERT_EQ(t.miner_tx_hash(miner), first);
+  ASSERT_EQ(t.bc().m_btc.size(), 1);
+  ASSERT_EQ(t.bc().m_btc.front().pool_cookie, cookie);
+
+  // a different fee needs a new miner tx, with the same winner context
+  t.move_pool_cookie();
+  t.bc().m_btc.front().fee += 1;
+  const crypto::hash rebuilt = t.miner_tx_hash(miner);
+  ASSERT_NE(rebuilt, first);
+  ASSERT_EQ(t.bc().m_btc.front().fee, 0);
+
+  // another miner gets its own miner tx
+  ASSERT_NE(t.miner_tx_hash(other_miner), rebuilt);
+  ASSERT_EQ(t.bc().m_btc.size(), 2);
+  ASSERT_EQ(t.miner_tx_hash(miner), rebuilt);
+}
+
+TEST(block_template_cache, new_tip_drops_the_cache)
+{
+  template_test t;
+  cryptonote::account_base miner;
+  miner.generate();
+
+  const crypto::hash first = t.miner_tx_hash(miner);
+  t.db->add();
+  ASSERT_NE(t.miner_tx_hash(miner), first);
+  ASSERT_EQ(t.bc().m_btc.size(), 1);
+  ASSERT_EQ(t.bc().m_btc.front().b.prev_id, t.db->top_block_hash());
+}
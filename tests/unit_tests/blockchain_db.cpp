@@ -258,6 +258,34 @@ TYPED_TEST(BlockchainDBTest, OpenAndClose)
   ASSERT_NO_THROW(this->m_db->close());
 }
 
+TYPED_TEST(BlockchainDBTest, OpenNewDBWithQuorumArchive)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // every table, the quorum archive included, has to fit in the env
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  this->m_db->set_batch_transactions(true);
+  {
+    db_write_batch batch(*this->m_db);
+    ASSERT_TRUE(batch.active());
+    ASSERT_NO_THROW(this->m_db->set_full_node_quorum_state(5, "quorum"));
+  }
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // and an existing db opens again with it
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  std::string data;
+  ASSERT_TRUE(this->m_db->get_full_node_quorum_state(5, data));
+  ASSERT_EQ(data, "quorum");
+  ASSERT_FALSE(this->m_db->get_full_node_quorum_state(6, data));
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
 TYPED_TEST(BlockchainDBTest, AddBlock)
 {
 
@@ -344,4 +372,162 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RetrieveBlockBlobView)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0],  t_diffs[0], t_coins[0], this->m_txs[0]));
+
+  // no view without a read session to keep it alive
+  epee::span<const uint8_t> view;
+  ASSERT_FALSE(this->m_db->get_block_blob_view_from_height(0, view));
+
+  {
+    db_read_session read_session(*this->m_db);
+    ASSERT_TRUE(this->m_db->get_block_blob_view_from_height(0, view));
+    const blobdata bd = this->m_db->get_block_blob_from_height(0);
+    ASSERT_EQ(bd, std::string(reinterpret_cast<const char*>(view.data()), view.size()));
+
+    block b;
+    ASSERT_TRUE(parse_and_validate_block_from_blob(view, b));
+    ASSERT_HASH_EQ(get_block_hash(this->m_blocks[0]), get_block_hash(b));
+
+    ASSERT_THROW(this->m_db->get_block_blob_view_from_height(1, view), BLOCK_DNE);
+  }
+}
+
+TYPED_TEST(BlockchainDBTest, WriteBatchCommitsOnce)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  this->m_db->set_batch_transactions(true);
+
+  // what another thread, e.g. an RPC handler, sees of the pool
+  auto committed_pool_txes = [this]() {
+    uint64_t count = 0;
+    std::thread reader([&]() { count = this->m_db->get_txpool_tx_count(); });
+    reader.join();
+    return count;
+  };
+
+  const blobdata blob = tx_to_blob(this->m_txs[0][0]);
+  txpool_tx_meta_t meta;
+  memset(&meta, 0, sizeof(meta));
+  std::vector<crypto::hash> txids(3, crypto::null_hash);
+  for (size_t i = 0; i < txids.size(); ++i)
+    txids[i].data[0] = i + 1;
+
+  {
+    db_write_batch batch(*this->m_db);
+    ASSERT_TRUE(batch.active());
+    for (const crypto::hash &txid: txids)
+    {
+      // as each tx's own LockedTXN does: it joins the open batch
+      db_write_batch tx_batch(*this->m_db);
+      ASSERT_FALSE(tx_batch.active());
+      ASSERT_NO_THROW(this->m_db->add_txpool_tx(txid, blob, meta));
+    }
+    ASSERT_EQ(this->m_db->get_txpool_tx_count(), txids.size());
+    ASSERT_EQ(committed_pool_txes(), 0);
+  }
+  ASSERT_EQ(committed_pool_txes(), txids.size());
+
+  // a disabled guard leaves the writes to commit on their own
+  {
+    db_write_batch batch(*this->m_db, false);
+    ASSERT_FALSE(batch.active());
+    db_write_batch tx_batch(*this->m_db);
+    ASSERT_TRUE(tx_batch.active());
+    ASSERT_NO_THROW(this->m_db->remove_txpool_tx(txids[0]));
+  }
+  ASSERT_EQ(committed_pool_txes(), txids.size() - 1);
+}
+
+TYPED_TEST(BlockchainDBTest, ReadSessionPinsOneSnapshot)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  this->m_db->set_batch_transactions(true);
+
+  const blobdata blob = tx_to_blob(this->m_txs[0][0]);
+  txpool_tx_meta_t meta;
+  memset(&meta, 0, sizeof(meta));
+  auto add_from_another_thread = [&](uint8_t n) {
+    std::thread writer([&]() {
+      crypto::hash txid = crypto::null_hash;
+      txid.data[0] = n;
+      db_write_batch batch(*this->m_db);
+      this->m_db->add_txpool_tx(txid, blob, meta);
+    });
+    writer.join();
+  };
+
+  {
+    db_read_session session(*this->m_db);
+    ASSERT_EQ(this->m_db->get_txpool_tx_count(), 0);
+    add_from_another_thread(1);
+    // still the snapshot the session started with, nested sessions included
+    ASSERT_EQ(this->m_db->get_txpool_tx_count(), 0);
+    {
+      db_read_session nested(*this->m_db);
+      ASSERT_EQ(this->m_db->get_txpool_tx_count(), 0);
+    }
+    ASSERT_EQ(this->m_db->get_txpool_tx_count(), 0);
+  }
+
+  // without a session, every lookup sees the latest commit
+  ASSERT_EQ(this->m_db->get_txpool_tx_count(), 1);
+  add_from_another_thread(2);
+  ASSERT_EQ(this->m_db->get_txpool_tx_count(), 2);
+}
+
+#ifdef HAVE_ZSTD
+TYPED_TEST(BlockchainDBTest, RetrieveCompressedTxData)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_COMPRESS));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0],  t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  for (const auto &txs: this->m_txs)
+  {
+    for (const auto &tx: txs)
+    {
+      const crypto::hash h = get_transaction_hash(tx);
+      blobdata bd;
+      ASSERT_TRUE(this->m_db->get_tx_blob(h, bd));
+      ASSERT_EQ(tx_to_blob(tx), bd);
+      ASSERT_TRUE(this->m_db->get_pruned_tx_blob(h, bd));
+      ASSERT_EQ(0, tx_to_blob(tx).compare(0, bd.size(), bd));
+    }
+  }
+}
+#endif
+
 }  // anonymous namespace
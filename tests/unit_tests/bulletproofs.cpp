@@ -36,6 +36,8 @@
 #include "ringct/bulletproofs.h"
 #include "cryptonote_basic/blobdatatype.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/lazy_transaction.h"
+#include "cryptonote_core/cryptonote_core.h"
 #include "device/device.hpp"
 #include "misc_log_ex.h"
 
@@ -143,6 +145,59 @@ TEST(bulletproofs, multi_splitting)
   }
 }
 
+static rct::rctSig make_bulletproof_rct_sig()
+{
+  rct::ctkeyV sc, pc;
+  rct::ctkey sctmp, pctmp;
+  std::tie(sctmp, pctmp) = rct::ctskpkGen(6000);
+  sc.push_back(sctmp);
+  pc.push_back(pctmp);
+
+  rct::keyV amount_keys, destinations;
+  rct::key Sk, Pk;
+  for (size_t i = 0; i < 2; ++i)
+  {
+    amount_keys.push_back(rct::hash_to_scalar(rct::zero()));
+    rct::skpkGen(Sk, Pk);
+    destinations.push_back(Pk);
+  }
+
+  const rct::RCTConfig rct_config { rct::RangeProofPaddedBulletproof, 0 };
+  return rct::genRctSimple(rct::zero(), sc, pc, destinations, {6000}, {2000, 3000}, amount_keys, NULL, NULL, 1000, 3, rct_config, hw::get_device("default"));
+}
+
+TEST(bulletproofs, span_batches)
+{
+  static const size_t N_SIGS = 5;
+  std::vector<rct::rctSig> s(N_SIGS);
+  std::vector<const rct::rctSig*> sp(N_SIGS);
+  for (size_t n = 0; n < N_SIGS; ++n)
+  {
+    s[n] = make_bulletproof_rct_sig();
+    ASSERT_EQ(s[n].p.bulletproofs.size(), 1);
+    sp[n] = &s[n];
+  }
+
+  std::vector<bool> verified;
+  ASSERT_EQ(cryptonote::core::verify_rct_semantics_in_batches(sp, 2, verified), 0);
+  ASSERT_EQ(verified, std::vector<bool>(N_SIGS, true));
+
+  // a bad proof fails only the batch it lands in
+  s[2].p.bulletproofs[0].taux = rct::skGen();
+  ASSERT_EQ(cryptonote::core::verify_rct_semantics_in_batches(sp, 2, verified), 1);
+  ASSERT_EQ(verified, std::vector<bool>({true, true, false, false, true}));
+
+  ASSERT_EQ(cryptonote::core::verify_rct_semantics_in_batches(sp, N_SIGS, verified), 1);
+  ASSERT_EQ(verified, std::vector<bool>(N_SIGS, false));
+
+  // a signature with more proofs than the bound is still verified, on its own
+  ASSERT_EQ(cryptonote::core::verify_rct_semantics_in_batches(sp, 0, verified), 1);
+  ASSERT_EQ(verified, std::vector<bool>({true, true, false, true, true}));
+
+  ASSERT_EQ(cryptonote::core::verify_rct_semantics_in_batches({}, 2, verified), 0);
+  ASSERT_TRUE(verified.empty());
+}
+
 TEST(bulletproofs, valid_aggregated)
 {
   static const size_t N_PROOFS = 8;
@@ -277,3 +332,35 @@ TEST(bulletproof, weight_more)
   const uint64_t tx_weight = cryptonote::get_transaction_weight(tx);
   ASSERT_TRUE(tx_weight > tx_size); // it has four outputs, > 2 makes weight > size
 }
+
+TEST(bulletproof, lazy_transaction)
+{
+  static const char *tx_hex = "02000102000b849b08f2b70b9891019707a8081bc7040d9f0b55d3019669afc83528a6e18454cf13ca392a581098c067df30e66dee8aaddf14c61a8f020002775faa070d3b3ab1d9de66deb402f635aca2580191bce277c26fef7c00cb3f3500025c9c10a978bfe085d42a7b73980f53eab4cbfde73d8023e21978ec8a467375e22101a340cd8bc95636a0ba6ffe5ebfda5eb637d44ad73c32150a469008cb870d22aa03d0cca632f376c5417327569d497d42f09386c5dd4b5efecd9dd20719861ef5aed810e70d824e8e77189c35e6d79993eeeea77b219106df29dd9e77370e7f2fb5ead175064ba8a59397a3ce6804bde23b4d90039c5ad4d1282bc23f791221bc185d70b30d84dda556348a3b9af09513946a03c190b9c53fbeb970a286b1ff8d462630ef0a2737ff40f238461e8ed3eedb8f2a01492abcb96e116ae9d51c4b35e9ba2f3bbe78228618f17a5708c0e30a47b7ed15d4a20ded508f9daddd92e07c6e74167cdf0100000099c4e562de6abd309b4cc26ab41aac39eb0eb252468f79bc5369eae8ba7f94ef2d795fb6b61a0e69e6a95dd3e257615188e80bc1c90c5f571028bb9d2b99c13d41a1e1a770e592ae7a9cda9014f6d4f3233d30f062b774a7241b6e0bb0b83b4a3e36200234a288fcf65cf8a35dfd7710dc5ece5d7abb5ec58451f1cbd41513b1bb6190c609c25e2a2b94eadfe22e8a9eb28ea3d16fa49cb1eb4d7f5c3706b50e7ae60cedf6af2c3e8dc8f96113c029749ae2b266090cc2e6650cf0a869f6c20b0792987702834ff278516dccbd3cff94a6ff36361178a302b37a62c9134b50739228430306ff2bc6a6d282d4cfa9bf6b92486f0e0dd594f2334296e248514c28436b3e86f9d527a8b1ed9f6ed09fa48514364df41d50cb3d376b71b3585cad9de30c465302ae91818ce42eb77e26a31242b4f1255f455df49409197a6d0e468f2c2d781684bb697a785ac77d41950901e9b67a2a4d6a3ec05fffec9e3a0313c972120ac3f5e01f1bc595438d7e07ff6de4ede96915a8696bcbaf449fae978565eceaebe2c3bd2f8315c535ff25fa8924fc2d49e0cb7ecc1c3fd72ce821513fa113078fda233e1588022c6267ba2f78a8a4f9ac8c7ea2dc4dca464902f46fb92702db8d26afa628f2aa182c2b34768a2b0581e7196ce041e73924af51d713db75093bf292e4263be8fc08a0b2f531e1a10ce79b95ab1fab726478cea8e79e0313ffc895069938ecf7ed14a037577f4f461ae6cde9bae6ade8a1d9e46040321b250d7ff9f3612b278757717596040dc58e7f68687b72c1ba71f36daeeb7ebdcbfd77d3518dff7d0fee252887ee38db33dffd714924d5823c539288d581eba17053beb273a13ca6f43132da705308bdc53c80c45e347bffb5c1fae7907369598660ce2c70d34083fec197b914c3b77f50e57ec54d89d0031df92a1241d40f9ea3ed14008ecc339323118ad22adca5c56687f854bc5fd47a3223016eee46e7d94b31a101df22d87b1404bbceaaaab2a8bde72aa318d3364e8926119d792cad21e51faf0cbd5ea0bbe939c5bcfbaa489dfda38aa124f3fc007b9e58f55ad8acd25d17a40bd4c1c17e03610fecb789702b0b8a4aa3a79028a7292212c550dec72f2c356f02bc0f2a0513ae07892143b8aa5ab30e9f6d71eeb3df2ea64a839b5b857000db043bf506a26953a909116b10cdce03a27d549db2f51f9a341c721bb0e442b5d0034038fbb0cd2ef27fb48f5acbd6b4104af18a98a1692d10d59884fcd2eb4641000ac32df57b5dcf387c4c097e5e7e702b2f07cdb18a69d5c69a5f7e135a9f8e020670758a1e4d955878de2f93181adfddd8cff4d20365c4663e870ff09d6b15065bbd81555d6aeb92e07ebbeae426cd0ab982a03ffeec31627ae140cd1e78f60ab6a55811d9d4051d50050c9e920e0b11c526530e613e0d3f925271f90ef0990e3df2c46170153e553a0035c0e8e87d957f40f072fd6b1ff30ee7aca3af88c40f1c255b3546dba9d23f352c729a0466729918336560df233843734e7dad57960f8d5592a299f6b762efdbd37aa0ff5310c940d03622023146a042079c8097fe01606594ab3578d0c0a90f8088d5c93504896ed80e809d22bf9483bf62398feb06099904cc23480b27709845ef1e26059d4730aeb5c2bb34c2ff34bff3c1a1c10a5898584fac078225bd435541fd2f4244e14118c8a08af7a3027d41b7af62420d12ba05466f905fe49882db44994180a1a549acfec42549254feda65aa6ee0c0e35e5a7525ae373ea0053fd536d4b6605ee833a0fa85e863807c30f02b46fde0305864da7d10f60b44ec1c2944a45de27912a39cebdc0ae18034397e4f5cfaf0ebe9ea5b225e80075f1bf6ac2211b7512870cc556e685a2464bf91100b36e5d0ea64af85d92d2aa1c2625e5bcbe93352a92dec8d735e54a2e6dfba6a91cc7c40e5c883d932769ce2d57b21ba898a2437ae6a39cfda1f3adefab0241548ad88104cbf113df4d1a243a5ae639b75169ae60b2c0dd1091a994e2a4d6d3536e3f4405a723c50ba4e9f822a2de189fd8158b0aa94c4b6255e5d4b504f789e4036d4206e8afd25693198f7bb3b04c23a6dc83f09260ae7c83726d4d524e7f9f851c39f5";
+  cryptonote::blobdata bd;
+  ASSERT_TRUE(epee::string_tools::parse_hexstr_to_binbuff(std::string(tx_hex), bd));
+  cryptonote::transaction tx;
+  ASSERT_TRUE(parse_and_validate_tx_from_blob(bd, tx));
+  cryptonote::blobdata pruned;
+  binary_archive<true> ba(pruned);
+  ASSERT_TRUE(tx.serialize_base(ba));
+
+  cryptonote::lazy_transaction ltx;
+  ASSERT_TRUE(ltx.parse(bd));
+  ASSERT_FALSE(ltx.prunable_loaded());
+  ASSERT_TRUE(ltx.tx().pruned);
+  ASSERT_TRUE(ltx.tx().rct_signatures.p.bulletproofs.empty());
+  ASSERT_EQ(cryptonote::get_transaction_prefix_hash(ltx.tx()), cryptonote::get_transaction_prefix_hash(tx));
+  ASSERT_EQ(std::string((const char*)ltx.pruned_blob().data(), ltx.pruned_blob().size()), pruned);
+  ASSERT_EQ(ltx.pruned_blob().size() + ltx.prunable_blob().size(), bd.size());
+
+  ASSERT_TRUE(ltx.load_prunable());
+  ASSERT_TRUE(ltx.prunable_loaded());
+  ASSERT_FALSE(ltx.tx().pruned);
+  ASSERT_EQ(ltx.tx().rct_signatures.p.bulletproofs.size(), 1);
+  ASSERT_EQ(cryptonote::get_transaction_hash(ltx.tx()), cryptonote::get_transaction_hash(tx));
+  ASSERT_EQ(cryptonote::get_transaction_weight(ltx.tx()), cryptonote::get_transaction_weight(tx));
+
+  // a truncated signature tail parses as far as the base, then fails to load
+  ASSERT_TRUE(ltx.parse(bd.substr(0, bd.size() - 1)));
+  ASSERT_FALSE(ltx.load_prunable());
+}
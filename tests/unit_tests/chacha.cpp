@@ -28,6 +28,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
 #include <string>
 
 #include "gtest/gtest.h"
@@ -108,3 +109,67 @@ TEST_CHACHA8(0)
 TEST_CHACHA8(1)
 TEST_CHACHA8(2)
 TEST_CHACHA8(3)
+
+namespace
+{
+  // chacha20 of a message, one 64 byte block at a time
+  std::string chacha20_by_block(const std::string &data, const uint8_t *key, const uint8_t *iv, uint64_t first_block)
+  {
+    std::string out(data.size(), '\0');
+    for (size_t offset = 0; offset < data.size(); offset += 64)
+      crypto::chacha20_from_block(data.data() + offset, std::min<size_t>(64, data.size() - offset), key, iv, first_block + offset / 64, &out[offset]);
+    return out;
+  }
+}
+
+TEST(chacha20, long_message_keystream)
+{
+  // the zero key and iv keystream, through the eight block path
+  static const uint8_t zero[CHACHA_KEY_SIZE] = {0};
+  static const uint8_t expected[] = {
+    0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+    0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7
+  };
+  const std::string data(1024, '\0');
+  std::string out(data.size(), '\0');
+  crypto::chacha20(data.data(), data.size(), zero, zero, &out[0]);
+  ASSERT_EQ(std::string((const char*)expected, sizeof(expected)), out.substr(0, sizeof(expected)));
+}
+
+TEST(chacha20, long_message_matches_blocks)
+{
+  uint8_t key[CHACHA_KEY_SIZE], iv[CHACHA_IV_SIZE];
+  for (size_t i = 0; i < sizeof(key); ++i)
+    key[i] = i * 13 + 1;
+  for (size_t i = 0; i < sizeof(iv); ++i)
+    iv[i] = i * 7 + 2;
+  std::string data(4099, '\0');
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i * 31 + 7;
+
+  for (size_t length: {0, 63, 64, 511, 512, 513, 1000, 4099})
+  {
+    const std::string message = data.substr(0, length);
+    std::string out(length, '\0');
+    crypto::chacha20(message.data(), length, key, iv, &out[0]);
+    ASSERT_EQ(chacha20_by_block(message, key, iv, 0), out);
+  }
+}
+
+TEST(chacha20, from_block)
+{
+  uint8_t key[CHACHA_KEY_SIZE] = {1, 2, 3}, iv[CHACHA_IV_SIZE] = {4, 5, 6};
+  const std::string data(2000, 'x');
+  std::string whole(data.size(), '\0');
+  crypto::chacha20(data.data(), data.size(), key, iv, &whole[0]);
+
+  // picking up a message half way
+  std::string rest(data.size() - 640, '\0');
+  crypto::chacha20_from_block(data.data() + 640, rest.size(), key, iv, 10, &rest[0]);
+  ASSERT_EQ(whole.substr(640), rest);
+
+  // the block counter carrying into its upper half within a run of blocks
+  std::string out(data.size(), '\0');
+  crypto::chacha20_from_block(data.data(), data.size(), key, iv, 0xfffffffcull, &out[0]);
+  ASSERT_EQ(chacha20_by_block(data, key, iv, 0xfffffffcull), out);
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_protocol/compact_block.h"
+
+namespace
+{
+  cryptonote::block make_block(size_t n_txes)
+  {
+    cryptonote::block b = AUTO_VAL_INIT(b);
+    b.major_version = 1;
+    b.timestamp = 1234;
+    for (size_t n = 0; n < n_txes; ++n)
+      b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+    return b;
+  }
+
+  std::vector<crypto::hash> with_noise(std::vector<crypto::hash> hashes)
+  {
+    for (size_t n = 0; n < 50; ++n)
+      hashes.push_back(crypto::rand<crypto::hash>());
+    return hashes;
+  }
+}
+
+TEST(compact_block, round_trip)
+{
+  const cryptonote::block b = make_block(20);
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request req;
+  ASSERT_TRUE(cryptonote::make_compact_block(b, {}, {}, 42, req));
+  ASSERT_EQ(req.short_ids.size(), 20 * cryptonote::COMPACT_BLOCK_SHORT_ID_SIZE);
+  ASSERT_TRUE(req.prefilled.empty());
+
+  cryptonote::block out;
+  std::vector<uint64_t> missing;
+  ASSERT_TRUE(cryptonote::reconstruct_compact_block(req, with_noise(b.tx_hashes), out, missing));
+  ASSERT_TRUE(missing.empty());
+  ASSERT_EQ(out.tx_hashes, b.tx_hashes);
+  ASSERT_EQ(cryptonote::get_block_hash(out), req.block_hash);
+}
+
+TEST(compact_block, missing)
+{
+  const cryptonote::block b = make_block(10);
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request req;
+  ASSERT_TRUE(cryptonote::make_compact_block(b, {}, {}, 7, req));
+
+  std::vector<crypto::hash> candidates = b.tx_hashes;
+  candidates.erase(candidates.begin() + 3);
+  candidates.erase(candidates.begin() + 7);
+  cryptonote::block out;
+  std::vector<uint64_t> missing;
+  ASSERT_TRUE(cryptonote::reconstruct_compact_block(req, candidates, out, missing));
+  ASSERT_EQ(missing, std::vector<uint64_t>({3, 8}));
+  ASSERT_EQ(out.tx_hashes[3], crypto::null_hash);
+  ASSERT_EQ(out.tx_hashes[4], b.tx_hashes[4]);
+}
+
+TEST(compact_block, salt)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>(), tx_hash = crypto::rand<crypto::hash>();
+  const uint64_t id = cryptonote::compact_block_short_id(1, block_hash, tx_hash);
+  ASSERT_LT(id, 1ull << (8 * cryptonote::COMPACT_BLOCK_SHORT_ID_SIZE));
+  ASSERT_EQ(id, cryptonote::compact_block_short_id(1, block_hash, tx_hash));
+  ASSERT_NE(id, cryptonote::compact_block_short_id(2, block_hash, tx_hash));
+}
+
+TEST(compact_block, malformed)
+{
+  const cryptonote::block b = make_block(4);
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request req;
+  ASSERT_FALSE(cryptonote::make_compact_block(b, {}, {4}, 0, req));
+  ASSERT_TRUE(cryptonote::make_compact_block(b, {}, {}, 0, req));
+
+  cryptonote::block out;
+  std::vector<uint64_t> missing;
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request bad = req;
+  bad.short_ids.pop_back();
+  ASSERT_FALSE(cryptonote::reconstruct_compact_block(bad, b.tx_hashes, out, missing));
+  bad = req;
+  bad.header = cryptonote::block_to_blob(b);
+  ASSERT_FALSE(cryptonote::reconstruct_compact_block(bad, b.tx_hashes, out, missing));
+  bad = req;
+  bad.prefilled.push_back({9, ""});
+  ASSERT_FALSE(cryptonote::reconstruct_compact_block(bad, b.tx_hashes, out, missing));
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/thread.hpp>
+#include "gtest/gtest.h"
+#include "p2p/net_node.h"
+
+TEST(connect_scheduler, failures_hand_their_slot_on)
+{
+  nodetool::connect_scheduler scheduler(5, 2, 1000);
+  size_t i;
+  ASSERT_TRUE(scheduler.next(i, 0));
+  ASSERT_EQ(0, i);
+  ASSERT_TRUE(scheduler.next(i, 0));
+  ASSERT_EQ(1, i);
+  // both slots are in flight
+  ASSERT_FALSE(scheduler.next(i, 0));
+
+  scheduler.done(false);
+  ASSERT_TRUE(scheduler.next(i, 0));
+  ASSERT_EQ(2, i);
+  scheduler.done(true);
+  scheduler.done(true);
+  ASSERT_EQ(2, scheduler.connected());
+  // the round made its connections, the rest are left alone
+  ASSERT_FALSE(scheduler.next(i, 0));
+}
+
+TEST(connect_scheduler, stops_when_candidates_run_out)
+{
+  nodetool::connect_scheduler scheduler(2, 5, 1000);
+  size_t i;
+  ASSERT_TRUE(scheduler.next(i, 0));
+  ASSERT_TRUE(scheduler.next(i, 0));
+  ASSERT_FALSE(scheduler.next(i, 0));
+  scheduler.done(false);
+  scheduler.done(true);
+  ASSERT_FALSE(scheduler.next(i, 0));
+  ASSERT_EQ(1, scheduler.connected());
+}
+
+TEST(connect_scheduler, nothing_starts_past_the_deadline)
+{
+  nodetool::connect_scheduler scheduler(5, 5, 1000);
+  size_t i;
+  ASSERT_TRUE(scheduler.next(i, 999));
+  ASSERT_EQ(0, i);
+  ASSERT_FALSE(scheduler.next(i, 1000));
+  ASSERT_FALSE(scheduler.next(i, 2000));
+  // the attempt in flight still counts
+  scheduler.done(true);
+  ASSERT_EQ(1, scheduler.connected());
+}
+
+TEST(connect_scheduler, concurrent_round_never_overshoots)
+{
+  static const size_t candidates = 200, wanted = 10, threads = 8;
+  nodetool::connect_scheduler scheduler(candidates, wanted, 1000);
+  std::vector<std::atomic<int>> tried(candidates);
+  std::atomic<size_t> in_flight(0), max_in_flight(0);
+
+  std::vector<boost::thread> workers;
+  for (size_t n = 0; n < threads; ++n)
+  {
+    workers.emplace_back([&]() {
+      size_t i;
+      while (scheduler.next(i, 0))
+      {
+        const size_t now = ++in_flight;
+        size_t seen = max_in_flight.load();
+        while (now > seen && !max_in_flight.compare_exchange_weak(seen, now));
+        ++tried[i];
+        boost::this_thread::yield();
+        --in_flight;
+        // one peer in three accepts
+        scheduler.done(i % 3 == 2);
+      }
+    });
+  }
+  for (auto &t: workers)
+    t.join();
+
+  ASSERT_EQ(wanted, scheduler.connected());
+  ASSERT_LE(max_in_flight, wanted);
+  size_t accepted = 0;
+  for (size_t i = 0; i < candidates; ++i)
+  {
+    ASSERT_LE(tried[i], 1);
+    accepted += tried[i] && i % 3 == 2;
+  }
+  ASSERT_EQ(wanted, accepted);
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+#define TEST_CONTROL_REWARD_INTERVAL 100 // CONTROL_REWARD_INTERVAL_IN_BLOCKS on FAKECHAIN
+
+namespace
+{
+
+class ControlDB: public cryptonote::BaseTestDB
+{
+public:
+  ControlDB(size_t height): block_reads(0)
+  {
+    m_open = true;
+    for (size_t i = 0; i < height; ++i)
+      blocks.push_back(make_block(i, 0));
+  }
+
+  // a block paying snode_reward + salt to a full node, and the rest of the
+  // base reward to the miner
+  static cryptonote::block make_block(uint64_t height, uint64_t salt)
+  {
+    cryptonote::block b;
+    b.major_version = cryptonote::network_version_10_bulletproofs;
+    b.minor_version = cryptonote::network_version_10_bulletproofs;
+    b.timestamp = height;
+    b.miner_tx.version = cryptonote::transaction::version_2;
+    b.miner_tx.vin.push_back(cryptonote::txin_gen{height});
+    const uint64_t snode_reward = 6000 + height * 12 + salt;
+    b.miner_tx.vout.resize(2);
+    b.miner_tx.vout[0].amount = snode_reward;
+    b.miner_tx.vout[1].amount = snode_reward;
+    if (cryptonote::height_has_control_output(cryptonote::FAKECHAIN, b.major_version, height))
+    {
+      b.miner_tx.vout.resize(3);
+      b.miner_tx.vout[2].amount = 1;
+    }
+    return b;
+  }
+
+  virtual void add_block(const cryptonote::block& blk, size_t block_weight, uint64_t long_term_block_weight, const cryptonote::difficulty_type& cumulative_difficulty, const uint64_t& coins_generated, uint64_t num_rct_outs, const crypto::hash& blk_hash) override
+  {
+    blocks.push_back(blk);
+  }
+  virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override
+  {
+    blk = blocks.back();
+    blocks.pop_back();
+  }
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { ++block_reads; return blocks.at(h); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks.at(h)); }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()); }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back(); }
+
+  std::vector<cryptonote::block> blocks;
+  mutable size_t block_reads;
+};
+
+struct control_reward_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)cryptonote::network_version_10_bulletproofs, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  ControlDB *db;
+
+  control_reward_test(size_t height): db(new ControlDB(height))
+  {
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 0));
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+
+  void add_block(uint64_t salt)
+  {
+    const cryptonote::block b = ControlDB::make_block(db->height(), salt);
+    db->blocks.push_back(b);
+    bc().add_block_control_reward(b, db->height() - 1);
+  }
+  void pop_block()
+  {
+    db->blocks.pop_back();
+    bc().pop_block_control_reward(db->height());
+  }
+  uint64_t expected(uint64_t height) const
+  {
+    uint64_t reward = 0;
+    for (uint64_t h = height - TEST_CONTROL_REWARD_INTERVAL; h < height; ++h)
+      reward += cryptonote::derive_control_from_block_reward(cryptonote::FAKECHAIN, db->blocks.at(h));
+    return reward;
+  }
+};
+
+}
+
+TEST(control_reward, batched_payout_matches_a_scan)
+{
+  control_reward_test t(2 * TEST_CONTROL_REWARD_INTERVAL + 50);
+  uint64_t reward = 0;
+
+  // an interval below the tip is always scanned
+  t.db->block_reads = 0;
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(2 * TEST_CONTROL_REWARD_INTERVAL, reward));
+  ASSERT_NE(reward, 0);
+  ASSERT_EQ(reward, t.expected(2 * TEST_CONTROL_REWARD_INTERVAL));
+  ASSERT_GE(t.db->block_reads, TEST_CONTROL_REWARD_INTERVAL);
+
+  // heights without a control output pay nothing
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(2 * TEST_CONTROL_REWARD_INTERVAL + 1, reward));
+  ASSERT_EQ(reward, 0);
+}
+
+TEST(control_reward, running_totals_follow_the_tip)
+{
+  control_reward_test t(2 * TEST_CONTROL_REWARD_INTERVAL);
+  uint64_t reward = 0;
+
+  // the scan at the tip seeds the running totals
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(2 * TEST_CONTROL_REWARD_INTERVAL, reward));
+  ASSERT_EQ(reward, t.expected(2 * TEST_CONTROL_REWARD_INTERVAL));
+
+  for (uint64_t i = 0; i < TEST_CONTROL_REWARD_INTERVAL; ++i)
+    t.add_block(0);
+  t.db->block_reads = 0;
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(3 * TEST_CONTROL_REWARD_INTERVAL, reward));
+  ASSERT_EQ(reward, t.expected(3 * TEST_CONTROL_REWARD_INTERVAL));
+  ASSERT_EQ(t.db->block_reads, 0);
+  ASSERT_EQ(t.bc().m_control_reward_sums.size(), TEST_CONTROL_REWARD_INTERVAL + 1);
+
+  // a reorg replacing the top blocks is unwound and re-added without a scan
+  t.pop_block();
+  t.pop_block();
+  t.add_block(1000);
+  t.add_block(2000);
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(3 * TEST_CONTROL_REWARD_INTERVAL, reward));
+  ASSERT_EQ(reward, t.expected(3 * TEST_CONTROL_REWARD_INTERVAL));
+  ASSERT_EQ(t.db->block_reads, 0);
+}
+
+TEST(control_reward, untracked_blocks_drop_the_totals)
+{
+  control_reward_test t(2 * TEST_CONTROL_REWARD_INTERVAL);
+  uint64_t reward = 0;
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(2 * TEST_CONTROL_REWARD_INTERVAL, reward));
+
+  // a block added at a height the totals don't end at
+  t.db->blocks.push_back(ControlDB::make_block(t.db->height(), 0));
+  t.add_block(0);
+  ASSERT_TRUE(t.bc().m_control_reward_sums.empty());
+
+  while (t.db->height() < 3 * TEST_CONTROL_REWARD_INTERVAL)
+    t.add_block(0);
+  t.db->block_reads = 0;
+  ASSERT_TRUE(t.bc().calc_batched_control_reward(3 * TEST_CONTROL_REWARD_INTERVAL, reward));
+  ASSERT_EQ(reward, t.expected(3 * TEST_CONTROL_REWARD_INTERVAL));
+  ASSERT_GE(t.db->block_reads, TEST_CONTROL_REWARD_INTERVAL);
+  ASSERT_FALSE(t.bc().m_control_reward_sums.empty());
+}
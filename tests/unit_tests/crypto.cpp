@@ -31,6 +31,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 
@@ -99,3 +100,44 @@ TEST(Crypto, verify_32)
     }
   }
 }
+
+TEST(Crypto, batch_key_derivations)
+{
+  // more keys than one ge_tobytes_batch chunk, with an invalid one in the middle
+  const size_t count = 150;
+  std::vector<crypto::public_key> pubs(count);
+  crypto::secret_key view_sec;
+  crypto::public_key view_pub;
+  crypto::generate_keys(view_pub, view_sec);
+  for (auto &pub: pubs)
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(pub, sec);
+  }
+  memset(&pubs[70], 0xff, sizeof(pubs[70]));
+
+  std::vector<crypto::key_derivation> derivations(count);
+  std::unique_ptr<bool[]> ok(new bool[count]);
+  crypto::generate_key_derivations(pubs.data(), count, view_sec, derivations.data(), ok.get());
+  for (size_t i = 0; i < count; ++i)
+  {
+    crypto::key_derivation derivation;
+    ASSERT_EQ(ok[i], crypto::generate_key_derivation(pubs[i], view_sec, derivation));
+    if (ok[i])
+      ASSERT_EQ(0, memcmp(&derivations[i], &derivation, sizeof(derivation)));
+  }
+  ASSERT_FALSE(ok[70]);
+
+  std::vector<size_t> indices(count);
+  for (size_t i = 0; i < count; ++i)
+    indices[i] = i % 3;
+  std::vector<crypto::public_key> spend_keys(count);
+  crypto::derive_subaddress_public_keys(pubs.data(), derivations.data(), indices.data(), count, spend_keys.data(), ok.get());
+  for (size_t i = 0; i < count; ++i)
+  {
+    crypto::public_key spend_key;
+    ASSERT_EQ(ok[i], crypto::derive_subaddress_public_key(pubs[i], derivations[i], indices[i], spend_key));
+    if (ok[i])
+      ASSERT_EQ(spend_keys[i], spend_key);
+  }
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include "gtest/gtest.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+class SyncDB: public cryptonote::BaseTestDB
+{
+public:
+  SyncDB(): syncs(0) { m_open = true; }
+  virtual uint64_t height() const override { return 1; }
+  virtual void sync() override { ++syncs; }
+
+  size_t syncs;
+};
+
+struct sync_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  SyncDB *db;
+
+  sync_test(uint64_t max_latency): db(new SyncDB())
+  {
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 0));
+    bc().set_user_options(1, true, 0, cryptonote::db_sync, true, max_latency);
+    db->syncs = 0;
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+
+  // what a block leaves to be synced after prepare_handle_incoming_blocks
+  bool cleanup_after_block()
+  {
+    ++bc().m_sync_counter;
+    bc_objects.m_mempool.lock();
+    return bc().cleanup_handle_incoming_blocks(false);
+  }
+};
+
+}
+
+TEST(db_sync, idle_syncs_once_the_latency_has_passed)
+{
+  sync_test t(30);
+  t.bc().on_idle();
+  ASSERT_EQ(t.db->syncs, 0);
+
+  t.bc().m_last_db_sync = time(NULL) - 30;
+  t.bc().on_idle();
+  ASSERT_EQ(t.db->syncs, 1);
+
+  // the sync starts a new period
+  t.bc().on_idle();
+  ASSERT_EQ(t.db->syncs, 1);
+}
+
+TEST(db_sync, blocks_are_synced_together)
+{
+  sync_test t(30);
+  for (int i = 0; i < 5; ++i)
+    ASSERT_TRUE(t.cleanup_after_block());
+  ASSERT_EQ(t.db->syncs, 0);
+
+  t.bc().m_last_db_sync = time(NULL) - 31;
+  ASSERT_TRUE(t.cleanup_after_block());
+  ASSERT_EQ(t.db->syncs, 1);
+  ASSERT_TRUE(t.cleanup_after_block());
+  ASSERT_EQ(t.db->syncs, 1);
+}
+
+TEST(db_sync, no_latency_leaves_idle_alone)
+{
+  sync_test t(0);
+  t.bc().m_last_db_sync = 0;
+  t.bc().on_idle();
+  ASSERT_EQ(t.db->syncs, 0);
+}
@@ -26,7 +26,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <random>
 #include "gtest/gtest.h"
+#include "int-util.h"
+#include "cryptonote_config.h"
 #include "cryptonote_basic/difficulty.h"
 
 static cryptonote::difficulty_type MKDIFF(uint64_t high, uint64_t low)
@@ -66,3 +69,94 @@ TEST(difficulty, check_hash)
   ASSERT_TRUE(cryptonote::check_hash(MKHASH(0xffffffffffffffff, 1), MKDIFF(0xffffffffffffffff, 1)));
   ASSERT_FALSE(cryptonote::check_hash(MKHASH(0xffffffffffffffff, 1), MKDIFF(0xffffffffffffffff, 2)));
 }
+
+// The multiprecision checks check_hash_128 and next_difficulty were written
+// with before they moved to 64 and 128 bit words
+static bool reference_check_hash_128(const crypto::hash &hash, cryptonote::difficulty_type difficulty)
+{
+  boost::multiprecision::uint512_t hash_value = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    hash_value <<= 64;
+    hash_value |= swap64le(((const uint64_t *) &hash)[3 - i]);
+  }
+  return hash_value * difficulty <= boost::multiprecision::uint512_t(std::numeric_limits<boost::multiprecision::uint256_t>::max());
+}
+
+static cryptonote::difficulty_type reference_next_difficulty(std::vector<uint64_t> timestamps, const std::vector<cryptonote::difficulty_type> &cumulative_difficulties, size_t target_seconds)
+{
+  const size_t length = timestamps.size();
+  std::sort(timestamps.begin(), timestamps.end());
+  size_t cut_begin = 0, cut_end = length;
+  if (length > DIFFICULTY_WINDOW_V2 - 2 * DIFFICULTY_CUT)
+  {
+    cut_begin = (length - (DIFFICULTY_WINDOW_V2 - 2 * DIFFICULTY_CUT) + 1) / 2;
+    cut_end = cut_begin + (DIFFICULTY_WINDOW_V2 - 2 * DIFFICULTY_CUT);
+  }
+  const uint64_t time_span = std::max<uint64_t>(1, timestamps[cut_end - 1] - timestamps[cut_begin]);
+  const cryptonote::difficulty_type total_work = cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin];
+  const boost::multiprecision::uint256_t res = (boost::multiprecision::uint256_t(total_work) * target_seconds + time_span - 1) / time_span;
+  if (res > boost::multiprecision::uint256_t(std::numeric_limits<boost::multiprecision::uint128_t>::max()))
+    return 0;
+  return res.convert_to<cryptonote::difficulty_type>();
+}
+
+// a value of up to the given number of bits, so every word width gets covered
+static cryptonote::difficulty_type random_bits(std::mt19937_64 &rng, unsigned bits)
+{
+  cryptonote::difficulty_type value = (cryptonote::difficulty_type(rng()) << 64) | rng();
+  return bits >= 128 ? value : value & ((cryptonote::difficulty_type(1) << bits) - 1);
+}
+
+TEST(difficulty, check_hash_128_matches_multiprecision)
+{
+  std::mt19937_64 rng(117);
+  for (size_t n = 0; n < 20000; ++n)
+  {
+    const cryptonote::difficulty_type difficulty = std::max<cryptonote::difficulty_type>(1, random_bits(rng, 1 + rng() % 128));
+
+    // hashes around the pass/fail boundary for this difficulty, and random ones
+    boost::multiprecision::uint256_t hash_value = std::numeric_limits<boost::multiprecision::uint256_t>::max() / difficulty;
+    switch (n % 3)
+    {
+      case 0: hash_value += rng() % 3; break;
+      case 1: hash_value -= rng() % 3; break;
+      default: hash_value >>= rng() % 256; break;
+    }
+    crypto::hash hash;
+    for (int i = 0; i < 4; ++i)
+    {
+      ((uint64_t*)&hash)[i] = swap64le((hash_value & std::numeric_limits<uint64_t>::max()).convert_to<uint64_t>());
+      hash_value >>= 64;
+    }
+
+    ASSERT_EQ(reference_check_hash_128(hash, difficulty), cryptonote::check_hash_128(hash, difficulty)) << "difficulty " << difficulty;
+  }
+}
+
+TEST(difficulty, next_difficulty_matches_multiprecision)
+{
+  std::mt19937_64 rng(117);
+  const unsigned block_bits[] = {20, 40, 64, 90, 118};
+  for (size_t n = 0; n < 5000; ++n)
+  {
+    // short windows skip the cut, full ones sort and cut
+    const size_t length = 2 + rng() % (DIFFICULTY_WINDOW_V2 - 1);
+    const unsigned bits = block_bits[n % 5];
+    std::vector<uint64_t> timestamps;
+    std::vector<cryptonote::difficulty_type> cumulative_difficulties;
+    uint64_t timestamp = rng() % 2000000000;
+    cryptonote::difficulty_type cumulative = random_bits(rng, bits);
+    for (size_t i = 0; i < length; ++i)
+    {
+      timestamp += rng() % (n % 7 == 0 ? 2 : 600); // including spans of 0
+      timestamps.push_back(n % 2 ? timestamp : timestamp - rng() % 300);
+      cumulative += std::max<cryptonote::difficulty_type>(1, random_bits(rng, bits));
+      cumulative_difficulties.push_back(cumulative);
+    }
+
+    const size_t target = n % 11 == 0 ? 1 + rng() % 100000 : DIFFICULTY_TARGET_V2;
+    ASSERT_EQ(reference_next_difficulty(timestamps, cumulative_difficulties, target),
+              cryptonote::next_difficulty(timestamps, cumulative_difficulties, target)) << "window " << n;
+  }
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include <atomic>
+#include "gtest/gtest.h"
+#include "cryptonote_basic/difficulty.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+using cryptonote::difficulty_type;
+
+namespace
+{
+
+class DifficultyDB: public cryptonote::BaseTestDB
+{
+public:
+  DifficultyDB(): reads(0) { m_open = true; }
+
+  // appends a block whose cumulative difficulty follows the difficulty
+  // algorithm from the blocks before it
+  void add(uint64_t timestamp)
+  {
+    const size_t height = timestamps.size();
+    const size_t offset = std::max<size_t>(1, height - std::min<size_t>(height, DIFFICULTY_BLOCKS_COUNT_V2));
+    std::vector<uint64_t> window_timestamps;
+    std::vector<difficulty_type> window_difficulties;
+    for (size_t h = offset; h < height; ++h)
+    {
+      window_timestamps.push_back(timestamps[h]);
+      window_difficulties.push_back(cumulative_difficulties[h]);
+    }
+    const difficulty_type diff = cryptonote::next_difficulty(window_timestamps, window_difficulties, DIFFICULTY_TARGET_V2);
+    timestamps.push_back(timestamp);
+    cumulative_difficulties.push_back((height ? cumulative_difficulties.back() : 0) + diff);
+  }
+
+  virtual uint64_t height() const override { return timestamps.size(); }
+  virtual uint64_t get_block_timestamp(const uint64_t& h) const override { ++reads; return timestamps.at(h); }
+  virtual difficulty_type get_block_cumulative_difficulty(const uint64_t& h) const override { ++reads; return cumulative_difficulties.at(h); }
+  virtual crypto::hash top_block_hash() const override
+  {
+    crypto::hash top = crypto::null_hash;
+    *(uint64_t*)&top = timestamps.size();
+    return top;
+  }
+  virtual void correct_block_cumulative_difficulties(const uint64_t& start_height, const std::vector<difficulty_type>& new_cumulative_difficulties) override
+  {
+    std::copy(new_cumulative_difficulties.begin(), new_cumulative_difficulties.end(), cumulative_difficulties.begin() + start_height);
+  }
+
+  std::vector<uint64_t> timestamps;
+  std::vector<difficulty_type> cumulative_difficulties;
+  mutable std::atomic<size_t> reads;
+};
+
+// timestamps that wander around the target so the difficulty moves
+uint64_t block_timestamp(uint64_t height)
+{
+  return height * DIFFICULTY_TARGET_V2 + (height * 7919) % 97;
+}
+
+struct difficulty_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  DifficultyDB *db;
+
+  difficulty_test(size_t height): db(new DifficultyDB())
+  {
+    for (size_t h = 0; h < height; ++h)
+      db->add(block_timestamp(h));
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 0));
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+
+  // the difficulty the next block gets, worked out from the DB
+  difficulty_type expected_next_difficulty()
+  {
+    DifficultyDB next;
+    next.timestamps = db->timestamps;
+    next.cumulative_difficulties = db->cumulative_difficulties;
+    next.add(0);
+    return next.cumulative_difficulties.back() - db->cumulative_difficulties.back();
+  }
+};
+
+}
+
+TEST(difficulty_window, next_block_difficulty_follows_the_chain)
+{
+  difficulty_test t(DIFFICULTY_BLOCKS_COUNT_V2 + 50);
+  ASSERT_EQ(t.bc().get_difficulty_for_next_block(), t.expected_next_difficulty());
+
+  for (int i = 0; i < 40; ++i)
+  {
+    t.db->add(block_timestamp(t.db->height()));
+    t.db->reads = 0;
+    ASSERT_EQ(t.bc().get_difficulty_for_next_block(), t.expected_next_difficulty());
+    // the window moves by one block: one timestamp and one difficulty read
+    ASSERT_EQ(t.db->reads, 2);
+  }
+
+  // a jump of several blocks reloads the window
+  for (int i = 0; i < 3; ++i)
+    t.db->add(block_timestamp(t.db->height()));
+  ASSERT_EQ(t.bc().get_difficulty_for_next_block(), t.expected_next_difficulty());
+  ASSERT_EQ(t.bc().m_timestamps.size(), DIFFICULTY_BLOCKS_COUNT_V2);
+}
+
+TEST(difficulty_window, cached_window_slices)
+{
+  difficulty_test t(DIFFICULTY_BLOCKS_COUNT_V2 + 50);
+  std::vector<uint64_t> timestamps;
+  std::vector<difficulty_type> difficulties;
+  const uint64_t height = t.db->height();
+
+  // nothing cached yet
+  ASSERT_FALSE(t.bc().get_cached_difficulty_window(height - 10, height, timestamps, difficulties));
+
+  t.bc().get_difficulty_for_next_block();
+  ASSERT_TRUE(t.bc().get_cached_difficulty_window(height - 10, height, timestamps, difficulties));
+  ASSERT_EQ(timestamps, std::vector<uint64_t>(t.db->timestamps.end() - 10, t.db->timestamps.end()));
+  ASSERT_EQ(difficulties, std::vector<difficulty_type>(t.db->cumulative_difficulties.end() - 10, t.db->cumulative_difficulties.end()));
+
+  // appends to what is already there
+  ASSERT_TRUE(t.bc().get_cached_difficulty_window(height - DIFFICULTY_BLOCKS_COUNT_V2, height - 10, timestamps, difficulties));
+  ASSERT_EQ(timestamps.size(), DIFFICULTY_BLOCKS_COUNT_V2 + 10);
+  ASSERT_EQ(timestamps.back(), t.db->timestamps[height - 11]);
+
+  // ranges outside the window leave the output alone
+  timestamps.clear();
+  difficulties.clear();
+  ASSERT_FALSE(t.bc().get_cached_difficulty_window(height - DIFFICULTY_BLOCKS_COUNT_V2 - 1, height, timestamps, difficulties));
+  ASSERT_FALSE(t.bc().get_cached_difficulty_window(height - 5, height + 1, timestamps, difficulties));
+  ASSERT_FALSE(t.bc().get_cached_difficulty_window(height - 5, height - 6, timestamps, difficulties));
+  ASSERT_TRUE(timestamps.empty());
+  ASSERT_TRUE(difficulties.empty());
+
+  // a popped block invalidates the cache
+  t.db->timestamps.pop_back();
+  t.db->cumulative_difficulties.pop_back();
+  ASSERT_FALSE(t.bc().get_cached_difficulty_window(height - 10, height - 1, timestamps, difficulties));
+}
+
+TEST(difficulty_window, recalculation_across_chunks)
+{
+  // more than one 10000 block chunk of the recalculation
+  difficulty_test t(10000 + DIFFICULTY_BLOCKS_COUNT_V2 + 100);
+  const std::vector<difficulty_type> expected = t.db->cumulative_difficulties;
+  ASSERT_EQ(t.bc().recalculate_difficulties(0), 0);
+
+  const uint64_t drift_height = 9990;
+  for (uint64_t h = drift_height; h < t.db->height(); ++h)
+    t.db->cumulative_difficulties[h] += 5;
+  t.bc().get_difficulty_for_next_block();
+  ASSERT_EQ(t.bc().recalculate_difficulties(0), t.db->height() - drift_height);
+  ASSERT_EQ(t.db->cumulative_difficulties, expected);
+  ASSERT_EQ(t.bc().m_timestamps_and_difficulties_height, 0);
+
+  // starting part way also works from the stored window before it
+  t.db->cumulative_difficulties.back() += 1;
+  ASSERT_EQ(t.bc().recalculate_difficulties(t.db->height() - 5), 1);
+  ASSERT_EQ(t.db->cumulative_difficulties, expected);
+}
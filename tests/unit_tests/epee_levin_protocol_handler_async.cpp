@@ -425,6 +425,57 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_EQ(3, m_commands_handler.callback_counter());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, shared_notify_can_be_sent_repeatedly)
+{
+  const int expected_command = 2617382;
+  const std::string in_data(1024, 'n');
+  const size_t message_size = sizeof(epee::levin::bucket_head2) + in_data.size();
+
+  test_connection_ptr conn = create_connection();
+
+  const std::vector<epee::net_utils::shared_buffer> message = epee::levin::make_notify_message(expected_command, epee::strspan<uint8_t>(in_data));
+  ASSERT_EQ(1, m_handler_config.notify(message, conn->m_protocol_handler.get_connection_id()));
+  ASSERT_EQ(1, m_handler_config.notify(message, conn->m_protocol_handler.get_connection_id()));
+
+  const std::string sent = conn->last_send_data();
+  ASSERT_EQ(2 * message_size, sent.size());
+  ASSERT_EQ(sent.substr(0, message_size), sent.substr(message_size));
+
+  // and the other end reads it back as the notification we sent
+  test_connection_ptr receiver = create_connection();
+  ASSERT_TRUE(receiver->m_protocol_handler.handle_recv(sent.data(), message_size));
+  ASSERT_EQ(1, m_commands_handler.notify_counter());
+  ASSERT_EQ(expected_command, m_commands_handler.last_command());
+  ASSERT_EQ(in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, foreach_connection_unpins_when_callback_throws)
+{
+  test_connection_ptr conn1 = create_connection();
+  test_connection_ptr conn2 = create_connection();
+
+  ASSERT_THROW(m_handler_config.foreach_connection([](test_levin_connection_context&) -> bool { throw std::runtime_error("test"); }), std::runtime_error);
+  ASSERT_EQ(0, conn1->m_protocol_handler.m_wait_count);
+  ASSERT_EQ(0, conn2->m_protocol_handler.m_wait_count);
+
+  size_t visited = 0;
+  ASSERT_FALSE(m_handler_config.foreach_connection([&visited](test_levin_connection_context&) { ++visited; return false; }));
+  ASSERT_EQ(1, visited);
+  ASSERT_EQ(0, conn1->m_protocol_handler.m_wait_count);
+  ASSERT_EQ(0, conn2->m_protocol_handler.m_wait_count);
+}
+
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, for_connection_unpins_when_callback_throws)
+{
+  test_connection_ptr conn = create_connection();
+  const boost::uuids::uuid id = conn->m_protocol_handler.get_connection_id();
+
+  ASSERT_THROW(m_handler_config.for_connection(id, [](test_levin_connection_context&) -> bool { throw std::runtime_error("test"); }), std::runtime_error);
+  ASSERT_EQ(0, conn->m_protocol_handler.m_wait_count);
+  ASSERT_TRUE(m_handler_config.for_connection(id, [](test_levin_connection_context&) { return true; }));
+  ASSERT_EQ(0, conn->m_protocol_handler.m_wait_count);
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_big_packet_1)
 {
   std::string buf("yyyyyy");
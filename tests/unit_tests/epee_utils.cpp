@@ -47,10 +47,14 @@
 #include "net/net_utils_base.h"
 #include "net/local_ip.h"
 #include "net/buffer.h"
+#include "net/http_encoding.h"
+#include "net/http_server_handlers_map2.h"
 #include "p2p/net_peerlist_boost_serialization.h"
 #include "span.h"
 #include "string_tools.h"
 #include "storages/parserse_base_utils.h"
+#include "storages/portable_storage_bin_stream.h"
+#include "storages/portable_storage_template_helper.h"
 
 namespace
 {
@@ -437,6 +441,58 @@ TEST(ToHex, Formatted)
   EXPECT_EQ(expected, out.str());
 }
 
+TEST(ToHex, Buffer)
+{
+  const std::vector<unsigned char> all_bytes = get_all_bytes();
+  std::string out(all_bytes.size() * 2, '\0');
+  EXPECT_TRUE(epee::to_hex::buffer({&out[0], out.size()}, epee::to_span(all_bytes)));
+  EXPECT_EQ(std_to_hex(all_bytes), out);
+
+  out.resize(all_bytes.size() * 2 - 1);
+  EXPECT_FALSE(epee::to_hex::buffer({&out[0], out.size()}, epee::to_span(all_bytes)));
+  out.resize(all_bytes.size() * 2 + 2);
+  EXPECT_FALSE(epee::to_hex::buffer({&out[0], out.size()}, epee::to_span(all_bytes)));
+}
+
+TEST(FromHex, ToBuffer)
+{
+  const std::vector<unsigned char> all_bytes = get_all_bytes();
+  std::string hex = std_to_hex(all_bytes);
+  std::vector<unsigned char> out(all_bytes.size());
+  EXPECT_TRUE(epee::from_hex::to_buffer(epee::to_mut_span(out), epee::to_span(hex)));
+  EXPECT_EQ(all_bytes, out);
+
+  for (char &c: hex)
+    if (c >= 'a' && c <= 'f')
+      c -= 'a' - 'A';
+  out.assign(out.size(), 0);
+  EXPECT_TRUE(epee::from_hex::to_buffer(epee::to_mut_span(out), epee::to_span(hex)));
+  EXPECT_EQ(all_bytes, out);
+
+  const std::string odd = hex.substr(1);
+  EXPECT_FALSE(epee::from_hex::to_buffer(epee::to_mut_span(out), epee::to_span(odd)));
+  out.pop_back();
+  EXPECT_FALSE(epee::from_hex::to_buffer(epee::to_mut_span(out), epee::to_span(hex)));
+}
+
+TEST(FromHex, NotHex)
+{
+  // long enough for the vector path, with the bad char at every position
+  const std::string hex = std_to_hex(get_all_bytes()).substr(0, 66);
+  std::vector<unsigned char> out(hex.size() / 2);
+  for (size_t i = 0; i < 256; ++i)
+  {
+    if ((i >= '0' && i <= '9') || (i >= 'A' && i <= 'F') || (i >= 'a' && i <= 'f'))
+      continue;
+    for (size_t pos = 0; pos < hex.size(); ++pos)
+    {
+      std::string bad = hex;
+      bad[pos] = static_cast<char>(i);
+      ASSERT_FALSE(epee::from_hex::to_buffer(epee::to_mut_span(out), epee::to_span(bad)));
+    }
+  }
+}
+
 TEST(StringTools, BuffToHex)
 {
   const std::vector<unsigned char> all_bytes = get_all_bytes();
@@ -834,6 +890,24 @@ TEST(net_buffer, move)
   ASSERT_TRUE(!memcmp(span.data() + 1, std::string(4000, '0').c_str(), 4000));
 }
 
+TEST(net_buffer, reserve)
+{
+  epee::net_utils::buffer buf;
+
+  buf.append(std::string(400, ' ').c_str(), 400);
+  buf.erase(399);
+  buf.reserve(10000);
+  ASSERT_EQ(buf.size(), 1);
+  const uint8_t *data = buf.span(1).data();
+  for (int i = 0; i < 9; ++i)
+    buf.append(std::string(1111, '0').c_str(), 1111);
+  ASSERT_EQ(buf.size(), 10000);
+  epee::span<const uint8_t> span = buf.span(10000);
+  ASSERT_EQ(span.data(), data);
+  ASSERT_TRUE(!memcmp(span.data(), std::string(1, ' ').c_str(), 1));
+  ASSERT_TRUE(!memcmp(span.data() + 1, std::string(9999, '0').c_str(), 9999));
+}
+
 TEST(parsing, isspace)
 {
   ASSERT_FALSE(epee::misc_utils::parse::isspace(0));
@@ -917,3 +991,288 @@ TEST(parsing, number)
   epee::misc_utils::parse::match_number(i, s.end(), val);
   ASSERT_EQ(val, "+9.34e+03");
 }
+
+TEST(json_rpc, split_batch)
+{
+  std::vector<std::string> items;
+  ASSERT_TRUE(epee::json_rpc::is_batch(" \n[{}]"));
+  ASSERT_FALSE(epee::json_rpc::is_batch("{\"method\":\"a\"}"));
+
+  ASSERT_TRUE(epee::json_rpc::split_batch(" [ {\"method\":\"a\",\"params\":{\"x\":[1,2]}} , {\"method\":\"b],\\\"\"} ] ", items));
+  ASSERT_EQ(items.size(), 2);
+  ASSERT_EQ(items[0], "{\"method\":\"a\",\"params\":{\"x\":[1,2]}}");
+  ASSERT_EQ(items[1], "{\"method\":\"b],\\\"\"}");
+
+  items.clear();
+  ASSERT_TRUE(epee::json_rpc::split_batch("[]", items));
+  ASSERT_TRUE(items.empty());
+
+  ASSERT_FALSE(epee::json_rpc::split_batch("[{},]", items));
+  items.clear();
+  ASSERT_FALSE(epee::json_rpc::split_batch("[,{}]", items));
+  items.clear();
+  ASSERT_FALSE(epee::json_rpc::split_batch("[{}", items));
+  items.clear();
+  ASSERT_FALSE(epee::json_rpc::split_batch("[{}] x", items));
+}
+
+TEST(http_encoding, negotiate)
+{
+  using namespace epee::net_utils::http;
+  const bool gzip = content_coding_supported(content_coding::gzip);
+  const bool zstd = content_coding_supported(content_coding::zstd);
+
+  EXPECT_EQ(negotiate_content_coding(""), content_coding::identity);
+  EXPECT_EQ(negotiate_content_coding("identity, br"), content_coding::identity);
+  EXPECT_EQ(negotiate_content_coding("gzip;q=0"), content_coding::identity);
+  EXPECT_EQ(negotiate_content_coding("gzip, deflate"), gzip ? content_coding::gzip : content_coding::identity);
+  EXPECT_EQ(negotiate_content_coding(" GZIP ; q=0.5 , zstd;q=0.4"), gzip ? content_coding::gzip : zstd ? content_coding::zstd : content_coding::identity);
+  EXPECT_EQ(negotiate_content_coding("gzip, zstd"), zstd ? content_coding::zstd : gzip ? content_coding::gzip : content_coding::identity);
+  EXPECT_EQ(negotiate_content_coding("zstd;q=0, *"), gzip ? content_coding::gzip : content_coding::identity);
+
+  std::string body, encoded;
+  for (int i = 0; i < 200; ++i)
+    body += "{\"height\": " + std::to_string(i) + "},";
+  EXPECT_FALSE(encode_body(content_coding::identity, body, encoded));
+  if (gzip)
+  {
+    encoded_body_cache cache;
+    std::string again;
+    ASSERT_TRUE(cache.get_or_encode(content_coding::gzip, body, encoded));
+    EXPECT_LT(encoded.size(), body.size());
+    ASSERT_TRUE(cache.get_or_encode(content_coding::gzip, body, again));
+    EXPECT_EQ(encoded, again);
+  }
+}
+
+namespace
+{
+  struct json_writer_inner
+  {
+    uint64_t a;
+    std::string b;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a)
+      KV_SERIALIZE(b)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct json_writer_empty
+  {
+    BEGIN_KV_SERIALIZE_MAP()
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // fields in name order, as portable_storage sorts them
+  struct json_writer_outer
+  {
+    bool a;
+    double b;
+    std::vector<uint32_t> c;
+    json_writer_inner d;
+    json_writer_empty e;
+    std::vector<json_writer_inner> f;
+    int8_t g;
+    std::vector<std::string> h;
+    epee::serialization::storage_entry i;
+    std::vector<uint64_t> j;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a)
+      KV_SERIALIZE(b)
+      KV_SERIALIZE(c)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(e)
+      KV_SERIALIZE(f)
+      KV_SERIALIZE(g)
+      KV_SERIALIZE(h)
+      KV_SERIALIZE(i)
+      KV_SERIALIZE(j)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
+TEST(json_writer, matches_portable_storage)
+{
+  json_writer_outer o;
+  o.a = true;
+  o.b = 1.5e-7;
+  o.c = {1, 2, 3};
+  o.d = {5, "x\"y\n"};
+  o.f = {{1, "a"}, {2, "b"}};
+  o.g = -3;
+  o.h = {"p", "q"};
+  o.i = epee::serialization::storage_entry(std::string("id"));
+
+  for (size_t indent = 0; indent < 2; ++indent)
+  {
+    for (bool newlines: {false, true})
+    {
+      std::string streamed, dom;
+      ASSERT_TRUE(epee::serialization::store_t_to_json(o, streamed, indent, newlines));
+      epee::serialization::portable_storage ps;
+      ASSERT_TRUE(o.store(ps));
+      ASSERT_TRUE(ps.dump_as_json(dom, indent, newlines));
+      EXPECT_EQ(streamed, dom);
+    }
+  }
+}
+
+namespace
+{
+  struct bin_view_inner
+  {
+    uint64_t a;
+    std::string b;
+    std::vector<std::string> txs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a)
+      KV_SERIALIZE(b)
+      KV_SERIALIZE(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct bin_view_outer
+  {
+    bool a;
+    std::vector<uint32_t> c;
+    bin_view_inner d;
+    std::vector<bin_view_inner> f;
+    int8_t g;
+    uint32_t k;
+    std::vector<uint64_t> blob;
+    epee::serialization::storage_entry se;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a)
+      KV_SERIALIZE(c)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(f)
+      KV_SERIALIZE(g)
+      KV_SERIALIZE(k)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(blob)
+      KV_SERIALIZE(se)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct bin_view_widened
+  {
+    uint64_t k;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(k)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
+TEST(portable_storage_bin_view, matches_portable_storage)
+{
+  bin_view_outer in;
+  in.a = true;
+  in.c = {1, 2, 3};
+  in.d = {5, std::string("x\0y", 3), {"t1", "t2"}};
+  in.f = {{1, "a", {}}, {2, "b", {"z"}}};
+  in.g = -3;
+  in.k = 77;
+  in.blob = {9, 8, 7};
+  in.se = epee::serialization::storage_entry(std::string("entry"));
+
+  std::string bin;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(in, bin));
+
+  bin_view_outer out;
+  epee::serialization::portable_storage_bin_view view;
+  ASSERT_TRUE(view.load_from_binary(bin));
+  ASSERT_TRUE(out.load(view));
+  EXPECT_EQ(out.a, in.a);
+  EXPECT_EQ(out.c, in.c);
+  EXPECT_EQ(out.d.a, in.d.a);
+  EXPECT_EQ(out.d.b, in.d.b);
+  EXPECT_EQ(out.d.txs, in.d.txs);
+  ASSERT_EQ(out.f.size(), 2);
+  EXPECT_EQ(out.f[0].b, "a");
+  EXPECT_TRUE(out.f[0].txs.empty());
+  EXPECT_EQ(out.f[1].txs, std::vector<std::string>{"z"});
+  EXPECT_EQ(out.g, in.g);
+  EXPECT_EQ(out.k, in.k);
+  EXPECT_EQ(out.blob, in.blob);
+  EXPECT_EQ(boost::get<std::string>(out.se), "entry");
+
+  // numbers convert to wider fields as with portable_storage
+  bin_view_widened widened;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(widened, bin));
+  EXPECT_EQ(widened.k, 77);
+
+  for (size_t size = 0; size < bin.size(); ++size)
+  {
+    epee::serialization::portable_storage_bin_view truncated;
+    EXPECT_FALSE(truncated.load_from_binary(bin.substr(0, size)));
+  }
+}
+
+namespace
+{
+  struct bin_stream_outer
+  {
+    std::vector<bin_view_inner> f;
+    uint64_t height;
+    std::string status;
+    bool untrusted;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(f)
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(status)
+      KV_SERIALIZE(untrusted)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
+TEST(portable_storage_bin_stream, matches_portable_storage)
+{
+  bin_stream_outer in;
+  in.f = {{1, "a", {}}, {2, std::string("b\0c", 3), {"z", "y"}}, {3, "", {"x"}}};
+  in.height = 123456789;
+  in.status = "OK";
+  in.untrusted = true;
+
+  std::string expected;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(in, expected));
+
+  // written in pieces, in the key order portable_storage uses
+  std::string first, second;
+  epee::serialization::bin_stream_writer w1(first);
+  w1.begin(4);
+  w1.begin_object_array("f", in.f.size());
+  ASSERT_TRUE(w1.object(in.f[0]));
+  epee::serialization::bin_stream_writer w2(second);
+  ASSERT_TRUE(w2.object(in.f[1]));
+  ASSERT_TRUE(w2.object(in.f[2]));
+  w2.value("height", in.height);
+  w2.value("status", in.status);
+  w2.value("untrusted", in.untrusted);
+  EXPECT_EQ(first + second, expected);
+
+  // readers do not care about key order
+  std::string reordered;
+  epee::serialization::bin_stream_writer w3(reordered);
+  w3.begin(4);
+  w3.value("untrusted", in.untrusted);
+  w3.value("status", in.status);
+  w3.begin_object_array("f", in.f.size());
+  for (const auto& f: in.f)
+    ASSERT_TRUE(w3.object(f));
+  w3.value("height", in.height);
+
+  bin_stream_outer out;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(out, reordered));
+  ASSERT_EQ(out.f.size(), 3);
+  EXPECT_EQ(out.f[1].b, in.f[1].b);
+  EXPECT_EQ(out.f[1].txs, in.f[1].txs);
+  EXPECT_EQ(out.f[2].a, 3);
+  EXPECT_EQ(out.height, in.height);
+  EXPECT_EQ(out.status, in.status);
+  EXPECT_TRUE(out.untrusted);
+}
@@ -0,0 +1,406 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/full_node_list.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+#include "serialization/binary_archive.h"
+
+class full_node_list_access
+{
+public:
+  static void set_height(full_nodes::full_node_list &list, uint64_t height) { list.m_transient_state.height = height; }
+  static boost::recursive_mutex &mutex(full_nodes::full_node_list &list) { return list.m_sn_mutex; }
+  static void add_quorum_state(full_nodes::full_node_list &list, uint64_t height)
+  {
+    list.m_transient_state.quorum_states[height] = std::make_shared<full_nodes::quorum_state>();
+  }
+  static void mark_stale(full_nodes::full_node_list &list) { list.m_snapshot_stale = true; }
+  static void archive_quorum_state(full_nodes::full_node_list &list, uint64_t height)
+  {
+    full_nodes::full_node_list::quorum_state_for_serialization archived = {};
+    archived.height = height;
+    archived.state.quorum_nodes.resize(1);
+    list.m_quorum_archive_pending.push_back(archived);
+    list.flush_quorum_archive();
+  }
+  static void set_node(full_nodes::full_node_list &list, uint64_t height, const crypto::public_key &key, const full_nodes::full_node_info &info)
+  {
+    auto &infos = list.m_transient_state.full_nodes_infos;
+    const auto it = infos.find(key);
+    if (it == infos.end())
+      list.m_transient_state.rollback_events.push_back(full_nodes::full_node_list::rollback_new(height, key));
+    else
+      list.m_transient_state.rollback_events.push_back(full_nodes::full_node_list::rollback_change(height, key, it->second));
+    infos[key] = info;
+    list.update_node_indexes(key);
+  }
+  static void blacklist_key_image(full_nodes::full_node_list &list, uint64_t height, const crypto::key_image &key_image)
+  {
+    full_nodes::key_image_blacklist_entry entry = {};
+    entry.key_image     = key_image;
+    entry.unlock_height = height + 100;
+    list.m_transient_state.key_image_blacklist.push_back(entry);
+    list.m_blacklisted_key_images[key_image]++;
+    list.m_transient_state.rollback_events.push_back(full_nodes::full_node_list::rollback_key_image_blacklist(height, entry, true));
+  }
+  // round trips the rollback events through their binary serialization
+  static bool reload_rollback_events(full_nodes::full_node_list &list, std::vector<uint64_t> &heights)
+  {
+    std::vector<full_nodes::full_node_list::rollback_event_variant> events;
+    if (!list.get_rollback_events_for_serialization(events))
+      return false;
+    std::stringstream ss;
+    binary_archive<true> oar(ss);
+    if (!::serialization::serialize(oar, events))
+      return false;
+
+    const std::string blob = ss.str();
+    binary_archive<false> iar(epee::strspan<uint8_t>(blob));
+    std::vector<full_nodes::full_node_list::rollback_event_variant> loaded;
+    if (!::serialization::serialize(iar, loaded))
+      return false;
+    heights.clear();
+    for (const auto &event : loaded)
+      heights.push_back(boost::apply_visitor(event_height(), event));
+    return list.set_rollback_events_from_serialization(loaded);
+  }
+
+private:
+  struct event_height : public boost::static_visitor<uint64_t>
+  {
+    template <typename T>
+    uint64_t operator()(const T &event) const { return event.m_block_height; }
+  };
+};
+
+namespace
+{
+
+class ChainDB: public cryptonote::BaseTestDB
+{
+public:
+  ChainDB(size_t height)
+  {
+    m_open = true;
+    for (size_t i = 0; i < height; ++i)
+      blocks.push_back(make_block(i));
+  }
+
+  static cryptonote::block make_block(uint64_t height)
+  {
+    cryptonote::block b;
+    b.major_version = 7;
+    b.minor_version = 7;
+    b.timestamp = height;
+    b.miner_tx.version = cryptonote::transaction::version_1;
+    b.miner_tx.vin.push_back(cryptonote::txin_gen{height});
+    return b;
+  }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { return blocks.at(h); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks.at(h)); }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()); }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back(); }
+
+  std::vector<cryptonote::block> blocks;
+};
+
+class ArchiveDB: public ChainDB
+{
+public:
+  ArchiveDB(size_t height): ChainDB(height) {}
+
+  virtual void set_full_node_quorum_state(uint64_t height, const std::string& data) override { quorums[height] = data; }
+  virtual bool get_full_node_quorum_state(uint64_t height, std::string& data) override
+  {
+    const auto it = quorums.find(height);
+    if (it == quorums.end())
+      return false;
+    data = it->second;
+    return true;
+  }
+  virtual void remove_full_node_quorum_states_from(uint64_t height) override
+  {
+    ++removals;
+    quorums.erase(quorums.lower_bound(height), quorums.end());
+  }
+
+  std::map<uint64_t, std::string> quorums;
+  size_t removals = 0;
+};
+
+full_nodes::full_node_info make_staked_node(const std::vector<crypto::key_image> &key_images)
+{
+  full_nodes::full_node_info info = {};
+  info.version                 = full_nodes::full_node_info::version_2_infinite_staking;
+  info.requested_unlock_height = 500;
+  full_nodes::full_node_info::contributor_t contributor = {};
+  contributor.version = full_nodes::full_node_info::version_2_infinite_staking;
+  for (const crypto::key_image &key_image : key_images)
+  {
+    full_nodes::full_node_info::contribution_t contribution = {};
+    contribution.key_image = key_image;
+    contribution.amount    = 100;
+    contributor.locked_contributions.push_back(contribution);
+  }
+  info.contributors.push_back(contributor);
+  return info;
+}
+
+struct snapshot_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+
+  snapshot_test(ChainDB *db = new ChainDB(10))
+  {
+    EXPECT_TRUE(bc_objects.m_blockchain.init(db, cryptonote::FAKECHAIN, true, &test_options, 0));
+  }
+  full_nodes::full_node_list &list() { return bc_objects.m_full_node_list; }
+};
+
+}
+
+TEST(full_node_snapshot, published_on_first_read_after_a_block)
+{
+  snapshot_test t;
+  const auto before = t.list().get_snapshot();
+  ASSERT_EQ(t.list().get_snapshot(), before);
+
+  full_node_list_access::set_height(t.list(), 11);
+  t.list().block_added(ChainDB::make_block(10), {});
+  t.list().block_added(ChainDB::make_block(10), {});
+  const auto after = t.list().get_snapshot();
+  ASSERT_NE(after, before);
+  ASSERT_EQ(after->height, 11);
+
+  // reading again copies nothing
+  ASSERT_EQ(t.list().get_snapshot(), after);
+}
+
+TEST(full_node_snapshot, readers_do_not_wait_for_the_list)
+{
+  snapshot_test t;
+  const auto before = t.list().get_snapshot();
+  full_node_list_access::set_height(t.list(), 11);
+  t.list().block_added(ChainDB::make_block(10), {});
+
+  // while a block is being processed, readers get the previous copy
+  std::mutex m;
+  std::condition_variable cv;
+  bool locked = false, release = false;
+  std::thread holder([&]() {
+    std::lock_guard<boost::recursive_mutex> list_lock(full_node_list_access::mutex(t.list()));
+    std::unique_lock<std::mutex> lock(m);
+    locked = true;
+    cv.notify_all();
+    cv.wait(lock, [&]() { return release; });
+  });
+  {
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [&]() { return locked; });
+  }
+  ASSERT_EQ(t.list().get_snapshot(), before);
+  {
+    std::lock_guard<std::mutex> lock(m);
+    release = true;
+  }
+  cv.notify_all();
+  holder.join();
+
+  const auto after = t.list().get_snapshot();
+  ASSERT_NE(after, before);
+  ASSERT_EQ(after->height, 11);
+}
+
+TEST(full_node_snapshot, votes_and_proofs_see_the_live_list)
+{
+  cryptonote::core core(nullptr);
+  full_nodes::full_node_list &list = const_cast<full_nodes::full_node_list&>(core.get_full_node_list());
+  const crypto::public_key node = crypto::rand<crypto::public_key>();
+
+  // a block registers a node and adds a quorum; the list is still locked
+  // for the rest of the block when the quorum cop and uptime proofs look
+  std::mutex m;
+  std::condition_variable cv;
+  bool added = false;
+  std::thread block([&]() {
+    std::lock_guard<boost::recursive_mutex> list_lock(full_node_list_access::mutex(list));
+    full_node_list_access::set_node(list, 11, node, make_staked_node({}));
+    full_node_list_access::add_quorum_state(list, 11);
+    full_node_list_access::mark_stale(list);
+    {
+      std::lock_guard<std::mutex> lock(m);
+      added = true;
+    }
+    cv.notify_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  });
+  {
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [&]() { return added; });
+  }
+
+  // RPC readers do not wait, and get the copy from before the block
+  ASSERT_EQ(core.get_quorum_state_snapshot(11), nullptr);
+  ASSERT_FALSE(list.get_snapshot()->is_full_node(node));
+
+  // consensus readers wait for the block and see what it did
+  ASSERT_NE(core.get_quorum_state(11), nullptr);
+  ASSERT_TRUE(core.is_full_node(node));
+  block.join();
+
+  ASSERT_NE(core.get_quorum_state_snapshot(11), nullptr);
+}
+
+TEST(full_node_snapshot, archived_quorum_states_are_read_back)
+{
+  snapshot_test t;
+  full_node_list_access::archive_quorum_state(t.list(), 5);
+  // the base test DB keeps nothing
+  ASSERT_EQ(t.list().get_archived_quorum_state(5), nullptr);
+
+  ArchiveDB *db = new ArchiveDB(40);
+  snapshot_test archiving(db);
+  full_node_list_access::archive_quorum_state(archiving.list(), 5);
+  ASSERT_EQ(db->quorums.size(), 1);
+  const auto state = archiving.list().get_archived_quorum_state(5);
+  ASSERT_NE(state, nullptr);
+  ASSERT_EQ(state->quorum_nodes.size(), 1);
+  ASSERT_EQ(archiving.list().get_archived_quorum_state(6), nullptr);
+
+  // served from the cache afterwards
+  db->quorums.clear();
+  ASSERT_EQ(archiving.list().get_archived_quorum_state(5), state);
+}
+
+TEST(full_node_snapshot, only_deep_reorgs_touch_the_quorum_archive)
+{
+  ArchiveDB *db = new ArchiveDB(40);
+  snapshot_test t(db);
+  full_node_list_access::set_height(t.list(), 30);
+  for (uint64_t height = 5; height < 20; ++height)
+    full_node_list_access::archive_quorum_state(t.list(), height);
+  for (uint64_t height = 20; height < 30; ++height)
+    full_node_list_access::add_quorum_state(t.list(), height);
+  ASSERT_NE(t.list().get_archived_quorum_state(15), nullptr);
+
+  // within the resident window: no write transaction on the archive
+  t.list().blockchain_detached(25);
+  ASSERT_EQ(db->removals, 0);
+  ASSERT_EQ(db->quorums.size(), 15);
+
+  t.list().blockchain_detached(20);
+  ASSERT_EQ(db->removals, 0);
+
+  t.list().blockchain_detached(15);
+  ASSERT_EQ(db->removals, 1);
+  ASSERT_EQ(db->quorums.size(), 10);
+  ASSERT_EQ(t.list().get_archived_quorum_state(15), nullptr);
+  ASSERT_NE(t.list().get_archived_quorum_state(14), nullptr);
+}
+
+TEST(full_node_snapshot, key_image_indexes_follow_rollbacks)
+{
+  snapshot_test t;
+  const crypto::public_key node_a = crypto::rand<crypto::public_key>(), node_b = crypto::rand<crypto::public_key>();
+  const crypto::key_image image_1 = crypto::rand<crypto::key_image>(), image_2 = crypto::rand<crypto::key_image>(), image_3 = crypto::rand<crypto::key_image>();
+
+  full_node_list_access::set_node(t.list(), 11, node_a, make_staked_node({image_1, image_2}));
+  full_node_list_access::set_node(t.list(), 11, node_b, make_staked_node({image_3}));
+  uint64_t unlock_height = 0;
+  full_nodes::full_node_info::contribution_t contribution = {};
+  ASSERT_TRUE(t.list().is_key_image_locked(image_2, &unlock_height, &contribution));
+  ASSERT_EQ(unlock_height, 500);
+  ASSERT_EQ(contribution.key_image, image_2);
+  ASSERT_TRUE(t.list().is_key_image_locked(image_3));
+  ASSERT_FALSE(t.list().is_key_image_locked(crypto::rand<crypto::key_image>()));
+
+  // node_a unlocks image_1, which gets blacklisted; the same image twice
+  // stays blacklisted until both entries are gone
+  full_node_list_access::set_node(t.list(), 12, node_a, make_staked_node({image_2}));
+  full_node_list_access::blacklist_key_image(t.list(), 12, image_1);
+  full_node_list_access::blacklist_key_image(t.list(), 13, image_1);
+  ASSERT_FALSE(t.list().is_key_image_locked(image_1));
+  ASSERT_TRUE(t.list().is_key_image_locked(image_2));
+  ASSERT_TRUE(t.list().is_key_image_blacklisted(image_1));
+  ASSERT_FALSE(t.list().is_key_image_blacklisted(image_2));
+
+  t.list().blockchain_detached(13);
+  ASSERT_TRUE(t.list().is_key_image_blacklisted(image_1));
+
+  t.list().blockchain_detached(12);
+  ASSERT_FALSE(t.list().is_key_image_blacklisted(image_1));
+  ASSERT_TRUE(t.list().is_key_image_locked(image_1));
+  ASSERT_TRUE(t.list().is_key_image_locked(image_2));
+
+  t.list().blockchain_detached(11);
+  ASSERT_FALSE(t.list().is_key_image_locked(image_1));
+  ASSERT_FALSE(t.list().is_key_image_locked(image_3));
+}
+
+TEST(full_node_snapshot, rollback_events_survive_serialization)
+{
+  snapshot_test t;
+  const crypto::public_key node_a = crypto::rand<crypto::public_key>(), node_b = crypto::rand<crypto::public_key>();
+  const crypto::key_image image_1 = crypto::rand<crypto::key_image>(), image_2 = crypto::rand<crypto::key_image>();
+
+  full_node_list_access::set_node(t.list(), 11, node_a, make_staked_node({image_1}));
+  full_node_list_access::set_node(t.list(), 12, node_a, make_staked_node({image_2}));
+  full_node_list_access::blacklist_key_image(t.list(), 12, image_1);
+  full_node_list_access::set_node(t.list(), 13, node_b, make_staked_node({}));
+
+  std::vector<uint64_t> heights;
+  ASSERT_TRUE(full_node_list_access::reload_rollback_events(t.list(), heights));
+  ASSERT_EQ(heights, std::vector<uint64_t>({11, 12, 12, 13}));
+
+  // the reloaded events undo exactly what the originals recorded
+  t.list().blockchain_detached(13);
+  ASSERT_FALSE(t.list().is_full_node(node_b));
+  ASSERT_TRUE(t.list().is_full_node(node_a));
+
+  t.list().blockchain_detached(12);
+  ASSERT_TRUE(t.list().is_key_image_locked(image_1));
+  ASSERT_FALSE(t.list().is_key_image_locked(image_2));
+  ASSERT_FALSE(t.list().is_key_image_blacklisted(image_1));
+
+  ASSERT_TRUE(full_node_list_access::reload_rollback_events(t.list(), heights));
+  ASSERT_EQ(heights, std::vector<uint64_t>({11}));
+}
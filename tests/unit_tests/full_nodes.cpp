@@ -280,6 +280,102 @@ TEST(full_nodes, tx_extra_deregister_validation)
   }
 }
 
+TEST(full_nodes, deregister_vote_pool)
+{
+  const size_t num_voters = 10;
+  cryptonote::keypair voters[num_voters] = {};
+
+  full_nodes::quorum_state state = {};
+  state.quorum_nodes.resize(num_voters);
+  state.nodes_to_test.resize(num_voters);
+  for (size_t i = 0; i < num_voters; ++i)
+  {
+    voters[i]              = cryptonote::keypair::generate(hw::get_device("default"));
+    state.quorum_nodes[i]  = voters[i].pub;
+    state.nodes_to_test[i] = cryptonote::keypair::generate(hw::get_device("default")).pub;
+  }
+
+  auto make_vote = [&](uint64_t block_height, uint32_t full_node_index, uint32_t voter) -> full_nodes::deregister_vote {
+    full_nodes::deregister_vote vote = {};
+    vote.block_height        = block_height;
+    vote.full_node_index     = full_node_index;
+    vote.voters_quorum_index = voter;
+    vote.signature           = full_nodes::deregister_vote::sign_vote(block_height, full_node_index, voters[voter].pub, voters[voter].sec);
+    return vote;
+  };
+
+  full_nodes::deregister_vote_pool pool;
+  pool.m_nettype = cryptonote::MAINNET;
+  const int hf_version = cryptonote::network_version_11_infinite_staking;
+
+  // Duplicate voters are not added twice and don't count towards the quorum
+  cryptonote::transaction tx;
+  for (uint32_t i = 0; i + 1 < full_nodes::MIN_VOTES_TO_KICK_FULL_NODE; ++i)
+  {
+    cryptonote::vote_verification_context vvc = {};
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(10, 1, i), vvc, state, tx));
+    ASSERT_TRUE(vvc.m_added_to_pool);
+
+    vvc = {};
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(10, 1, i), vvc, state, tx));
+    ASSERT_FALSE(vvc.m_added_to_pool);
+    ASSERT_FALSE(vvc.m_full_tx_deregister_made);
+  }
+  ASSERT_EQ(pool.get_relayable_votes().size(), full_nodes::MIN_VOTES_TO_KICK_FULL_NODE - 1);
+
+  // A vote that fails verification is never added
+  {
+    full_nodes::deregister_vote vote = make_vote(10, 1, full_nodes::MIN_VOTES_TO_KICK_FULL_NODE);
+    vote.signature = make_vote(10, 1, 0).signature;
+    cryptonote::vote_verification_context vvc = {};
+    ASSERT_FALSE(pool.add_vote(hf_version, vote, vvc, state, tx));
+  }
+
+  // The vote reaching the quorum makes the deregister tx
+  {
+    cryptonote::vote_verification_context vvc = {};
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(10, 1, full_nodes::MIN_VOTES_TO_KICK_FULL_NODE - 1), vvc, state, tx));
+    ASSERT_TRUE(vvc.m_full_tx_deregister_made);
+
+    cryptonote::tx_extra_full_node_deregister deregister;
+    ASSERT_TRUE(cryptonote::get_full_node_deregister_from_tx_extra(tx.extra, deregister));
+    ASSERT_EQ(deregister.votes.size(), full_nodes::MIN_VOTES_TO_KICK_FULL_NODE);
+  }
+
+  // Relayed votes are held back, other groups are unaffected
+  {
+    cryptonote::vote_verification_context vvc = {};
+    cryptonote::transaction other_tx;
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(20, 2, 0), vvc, state, other_tx));
+    pool.set_relayed(pool.get_relayable_votes());
+    ASSERT_TRUE(pool.get_relayable_votes().empty());
+  }
+
+  // Groups leave the pool once used in a block or expired
+  pool.remove_used_votes({tx});
+  {
+    cryptonote::vote_verification_context vvc = {};
+    cryptonote::transaction unused;
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(10, 1, 0), vvc, state, unused));
+    ASSERT_TRUE(vvc.m_added_to_pool);
+  }
+
+  pool.remove_expired_votes(20 + full_nodes::deregister_vote::VOTE_LIFETIME_BY_HEIGHT);
+  {
+    cryptonote::vote_verification_context vvc = {};
+    cryptonote::transaction unused;
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(20, 2, 0), vvc, state, unused));
+    ASSERT_FALSE(vvc.m_added_to_pool);
+  }
+  pool.remove_expired_votes(21 + full_nodes::deregister_vote::VOTE_LIFETIME_BY_HEIGHT);
+  {
+    cryptonote::vote_verification_context vvc = {};
+    cryptonote::transaction unused;
+    ASSERT_TRUE(pool.add_vote(hf_version, make_vote(20, 2, 0), vvc, state, unused));
+    ASSERT_TRUE(vvc.m_added_to_pool);
+  }
+}
+
 TEST(full_nodes, min_portions)
 {
 
@@ -503,3 +599,96 @@ TEST(full_nodes, full_node_get_locked_key_image_unlock_height)
     ASSERT_EQ(unlock_height, expected);
   }
 }
+
+// Nodes whose swarm changed must all have landed in one of the swarms reported
+// as modified, update_swarms relies on this to only walk those swarms.
+TEST(full_nodes, calc_swarm_changes_reports_every_moved_node)
+{
+  for (uint64_t seed = 0; seed < 32; seed++)
+  {
+    std::map<full_nodes::swarm_id_t, std::vector<crypto::public_key>> swarms;
+    std::unordered_map<crypto::public_key, full_nodes::swarm_id_t> before;
+
+    const size_t num_swarms = seed % 6;
+    const size_t num_queued = 3 + (seed * 7) % 40;
+    uint32_t next_key       = 0;
+    auto add_node = [&](full_nodes::swarm_id_t swarm_id) {
+      crypto::public_key key = crypto::null_pkey;
+      ++next_key;
+      memcpy(key.data, &next_key, sizeof(next_key));
+      swarms[swarm_id].push_back(key);
+      before[key] = swarm_id;
+    };
+
+    for (size_t i = 0; i < num_swarms; i++)
+      for (size_t j = 0; j < full_nodes::MIN_SWARM_SIZE - 2 + (i + seed) % 8; j++)
+        add_node(1000 + i);
+
+    for (size_t i = 0; i < num_queued; i++)
+      add_node(full_nodes::QUEUE_SWARM_ID);
+
+    const std::set<full_nodes::swarm_id_t> modified = full_nodes::calc_swarm_changes(swarms, seed);
+
+    size_t total = 0;
+    for (const auto &entry : swarms)
+    {
+      for (const crypto::public_key &key : entry.second)
+      {
+        total++;
+        if (before.at(key) != entry.first)
+          ASSERT_TRUE(modified.count(entry.first) == 1);
+      }
+    }
+    ASSERT_EQ(total, before.size());
+    ASSERT_EQ(modified.count(full_nodes::QUEUE_SWARM_ID), 0);
+  }
+}
+
+static bool parse_delta(const std::string &blob, full_nodes::full_node_list::data_members_delta_for_serialization &delta)
+{
+  binary_archive<false> ba(epee::strspan<uint8_t>(blob));
+  return ::serialization::serialize(ba, delta);
+}
+
+static std::string store_delta(full_nodes::full_node_list::data_members_delta_for_serialization &delta)
+{
+  std::stringstream ss;
+  binary_archive<true> ba(ss);
+  EXPECT_TRUE(::serialization::serialize(ba, delta));
+  return ss.str();
+}
+
+TEST(full_nodes, journal_delta_round_trip)
+{
+  full_nodes::full_node_list::data_members_delta_for_serialization delta = {};
+  delta.version                   = full_nodes::full_node_info::version_2_infinite_staking;
+  delta.height                    = 1234;
+  delta.quorum_states_from_height = 1200;
+  delta.removed_infos.push_back(crypto::public_key{});
+  delta.has_key_image_blacklist   = true;
+  delta.key_image_blacklist.resize(2);
+  delta.key_image_blacklist[1].unlock_height = 99;
+
+  full_nodes::full_node_list::data_members_delta_for_serialization loaded;
+  ASSERT_TRUE(parse_delta(store_delta(delta), loaded));
+  EXPECT_EQ(delta.version, loaded.version);
+  EXPECT_EQ(1234, loaded.height);
+  EXPECT_EQ(1200, loaded.quorum_states_from_height);
+  EXPECT_EQ(1, loaded.removed_infos.size());
+  ASSERT_TRUE(loaded.has_key_image_blacklist);
+  ASSERT_EQ(2, loaded.key_image_blacklist.size());
+  EXPECT_EQ(99, loaded.key_image_blacklist[1].unlock_height);
+}
+
+TEST(full_nodes, journal_delta_rejects_unknown_version)
+{
+  full_nodes::full_node_list::data_members_delta_for_serialization delta = {};
+  delta.version = full_nodes::full_node_info::version_2_infinite_staking;
+  std::string blob = store_delta(delta);
+
+  // the version is the leading varint, a newer writer's journal must not be
+  // replayed with this layout
+  blob[0] = full_nodes::full_node_info::version_2_infinite_staking + 1;
+  full_nodes::full_node_list::data_members_delta_for_serialization loaded;
+  EXPECT_FALSE(parse_delta(blob, loaded));
+}
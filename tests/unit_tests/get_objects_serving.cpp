@@ -0,0 +1,214 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include "gtest/gtest.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "p2p/net_node.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.inl"
+#include "test_core.h"
+
+namespace
+{
+  // holds the first request in the core until released
+  class gate
+  {
+  public:
+    gate(): entered(false), opened(false) {}
+    void enter()
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      if (entered)
+        return;
+      entered = true;
+      cond.notify_all();
+      while (!opened)
+        cond.wait(lock);
+    }
+    void wait_entered()
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while (!entered)
+        cond.wait(lock);
+    }
+    void open()
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      opened = true;
+      cond.notify_all();
+    }
+
+  private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool entered, opened;
+  };
+
+  class objects_p2p: public nodetool::p2p_endpoint_stub<cryptonote::cryptonote_connection_context>
+  {
+  public:
+    virtual bool invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context) override
+    {
+      if (command != cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::ID)
+        return true;
+      cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
+      EXPECT_TRUE(epee::serialization::load_t_from_binary(rsp, req_buff));
+      boost::unique_lock<boost::mutex> lock(mutex);
+      responses.push_back(rsp.current_blockchain_height);
+      return true;
+    }
+    virtual bool drop_connection(const epee::net_utils::connection_context_base& context) override
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      ++drops;
+      return true;
+    }
+    virtual bool for_connection(const boost::uuids::uuid& id, std::function<bool(cryptonote::cryptonote_connection_context&, nodetool::peerid_type, uint32_t)> f) override
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (closed || id != context.m_connection_id)
+          return false;
+      }
+      return f(context, 1, P2P_SUPPORT_FLAGS);
+    }
+    void close()
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      closed = true;
+    }
+
+    cryptonote::cryptonote_connection_context context;
+    boost::mutex mutex;
+    std::vector<uint64_t> responses;
+    unsigned int drops = 0;
+    bool closed = false;
+  };
+
+  class get_objects_serving: public ::testing::Test
+  {
+  protected:
+    get_objects_serving(): protocol(core, &p2p)
+    {
+      p2p.context.m_connection_id = boost::uuids::random_generator()();
+      p2p.context.m_state = cryptonote::cryptonote_connection_context::state_normal;
+      // answers with the number the request was tagged with, the first one waits at the gate
+      core.get_objects = [this](cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request &req, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request &rsp) {
+        first.enter();
+        rsp.current_blockchain_height = req.blocks[0].data[0];
+        return true;
+      };
+    }
+
+    void request(unsigned char tag)
+    {
+      cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request req;
+      req.blocks.push_back(crypto::null_hash);
+      req.blocks[0].data[0] = tag;
+      std::string blob;
+      ASSERT_TRUE(epee::serialization::store_t_to_binary(req, blob));
+      std::string out;
+      bool handled = false;
+      protocol.handle_invoke_map(true, cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID, epee::strspan<uint8_t>(blob), out, p2p.context, handled);
+      ASSERT_TRUE(handled);
+    }
+
+    gate first;
+    test_core core;
+    objects_p2p p2p;
+    cryptonote::t_cryptonote_protocol_handler<test_core> protocol;
+  };
+}
+
+TEST_F(get_objects_serving, answers_in_request_order)
+{
+  request(1);
+  first.wait_entered();
+  for (unsigned char tag = 2; tag <= 5; ++tag)
+    request(tag);
+  first.open();
+  protocol.deinit();
+
+  ASSERT_EQ(std::vector<uint64_t>({1, 2, 3, 4, 5}), p2p.responses);
+  ASSERT_EQ(0, p2p.drops);
+}
+
+TEST_F(get_objects_serving, drops_a_peer_with_too_many_waiting)
+{
+  request(1);
+  first.wait_entered();
+  for (unsigned char tag = 2; tag < 2 + OBJECTS_QUEUED_PER_PEER_MAX; ++tag)
+    request(tag);
+  ASSERT_EQ(0, p2p.drops);
+  request(100);
+  ASSERT_EQ(1, p2p.drops);
+  first.open();
+  protocol.deinit();
+
+  ASSERT_EQ(1 + OBJECTS_QUEUED_PER_PEER_MAX, p2p.responses.size());
+  ASSERT_EQ(2 + OBJECTS_QUEUED_PER_PEER_MAX - 1, p2p.responses.back());
+}
+
+TEST_F(get_objects_serving, stops_when_the_peer_is_gone)
+{
+  request(1);
+  first.wait_entered();
+  request(2);
+  request(3);
+  protocol.on_connection_close(p2p.context);
+  p2p.close();
+  first.open();
+  protocol.deinit();
+
+  // the one being served when it left still goes out
+  ASSERT_EQ(std::vector<uint64_t>({1}), p2p.responses);
+}
+
+TEST_F(get_objects_serving, serves_inline_with_one_thread)
+{
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  const unsigned int max = tpool.get_max_concurrency();
+  tpool.stop();
+  tpool.start(1);
+
+  first.open();
+  for (unsigned char tag = 1; tag <= 3; ++tag)
+    request(tag);
+  // answered before the handler returns, so there is nothing left to wait for
+  const std::vector<uint64_t> responses = p2p.responses;
+  protocol.deinit();
+
+  tpool.stop();
+  tpool.start(max);
+  ASSERT_EQ(std::vector<uint64_t>({1, 2, 3}), responses);
+  ASSERT_EQ(0, p2p.drops);
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "gtest/gtest.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+
+typedef cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::response response;
+
+response make_response(size_t n)
+{
+  response res = AUTO_VAL_INIT(res);
+  for (size_t i = 0; i < n; ++i)
+  {
+    cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey o;
+    memset(&o.key, i + 1, sizeof(o.key));
+    memset(&o.mask, i + 2, sizeof(o.mask));
+    o.unlocked = i % 3 != 0;
+    o.height = 1000 + i;
+    o.txid = crypto::null_hash;
+    o.txid.data[0] = i + 1;
+    res.outs.push_back(o);
+  }
+  res.status = CORE_RPC_STATUS_OK;
+  return res;
+}
+
+// what on_get_outs_bin does for a packed request
+response packed(const response &in, bool get_txid)
+{
+  response res = in;
+  res.pack();
+  if (get_txid)
+    for (const auto &o: res.outs)
+      res.txids.push_back(o.txid);
+  res.outs.clear();
+  return res;
+}
+
+response over_the_wire(const response &in)
+{
+  std::string blob;
+  EXPECT_TRUE(epee::serialization::store_t_to_binary(in, blob));
+  response out = AUTO_VAL_INIT(out);
+  EXPECT_TRUE(epee::serialization::load_t_from_binary(out, blob));
+  return out;
+}
+
+void expect_same_outs(const response &expected, const response &got, bool get_txid)
+{
+  ASSERT_EQ(expected.outs.size(), got.outs.size());
+  for (size_t i = 0; i < got.outs.size(); ++i)
+  {
+    ASSERT_EQ(expected.outs[i].key, got.outs[i].key);
+    ASSERT_EQ(expected.outs[i].mask, got.outs[i].mask);
+    ASSERT_EQ(expected.outs[i].unlocked, got.outs[i].unlocked);
+    ASSERT_EQ(expected.outs[i].height, got.outs[i].height);
+    ASSERT_EQ(get_txid ? expected.outs[i].txid : crypto::null_hash, got.outs[i].txid);
+  }
+}
+
+}
+
+TEST(get_outs_packed, round_trip)
+{
+  // sizes around the bitmap's byte boundaries
+  for (size_t n: {1, 7, 8, 9, 16, 100})
+  {
+    for (bool get_txid: {false, true})
+    {
+      const response original = make_response(n);
+      response res = over_the_wire(packed(original, get_txid));
+      ASSERT_TRUE(res.outs.empty());
+      ASSERT_EQ((n + 7) / 8, res.unlocked.size());
+      ASSERT_TRUE(res.unpack(get_txid));
+      expect_same_outs(original, res, get_txid);
+    }
+  }
+}
+
+TEST(get_outs_packed, unpacked_response_is_left_alone)
+{
+  // an older daemon ignores the flag and sends outs
+  const response original = make_response(10);
+  response res = over_the_wire(original);
+  ASSERT_TRUE(res.keys.empty());
+  ASSERT_TRUE(res.unpack(true));
+  expect_same_outs(original, res, true);
+
+  response empty = AUTO_VAL_INIT(empty);
+  ASSERT_TRUE(empty.unpack(false));
+  ASSERT_TRUE(empty.outs.empty());
+}
+
+TEST(get_outs_packed, mismatched_arrays_are_rejected)
+{
+  response res = packed(make_response(9), false);
+  res.heights.pop_back();
+  ASSERT_FALSE(res.unpack(false));
+
+  res = packed(make_response(9), false);
+  res.unlocked.resize(1);
+  ASSERT_FALSE(res.unpack(false));
+
+  // txids were asked for but not sent
+  res = packed(make_response(9), false);
+  ASSERT_FALSE(res.unpack(true));
+}
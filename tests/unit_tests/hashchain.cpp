@@ -127,3 +127,83 @@ TEST(hashchain, trim)
   ASSERT_FALSE(hashchain.empty());
   ASSERT_EQ(hashchain.genesis(), make_hash(1));
 }
+
+TEST(hashchain, stable_size)
+{
+  tools::hashchain hashchain;
+  ASSERT_EQ(hashchain.stable_size(), 0);
+  for (uint64_t n = 0; n < 10; ++n)
+    hashchain.push_back(make_hash(n));
+  ASSERT_EQ(hashchain.stable_size(), 0);
+  hashchain.mark_stable();
+  ASSERT_EQ(hashchain.stable_size(), 10);
+  hashchain.push_back(make_hash(10));
+  ASSERT_EQ(hashchain.stable_size(), 10);
+  hashchain.crop(7);
+  ASSERT_EQ(hashchain.stable_size(), 7);
+  hashchain.push_back(make_hash(70));
+  hashchain.push_back(make_hash(80));
+  ASSERT_EQ(hashchain.stable_size(), 7);
+  hashchain.crop(9);
+  ASSERT_EQ(hashchain.stable_size(), 7);
+  hashchain.mark_stable();
+  ASSERT_EQ(hashchain.stable_size(), 9);
+  hashchain.clear();
+  ASSERT_EQ(hashchain.stable_size(), 0);
+}
+
+TEST(hashchain, trim_sparse)
+{
+  tools::hashchain hashchain;
+  for (uint64_t n = 0; n < 10000; ++n)
+    hashchain.push_back(make_hash(n + 1));
+  hashchain.trim(9000);
+  ASSERT_EQ(hashchain.offset(), 9000);
+  ASSERT_EQ(hashchain.size(), 10000);
+  ASSERT_EQ(hashchain.genesis(), make_hash(1));
+
+  const std::map<size_t, crypto::hash> &sparse = hashchain.sparse();
+  ASSERT_FALSE(sparse.empty());
+  ASSERT_LE(sparse.size(), 12 * tools::hashchain::SPARSE_DENSITY);
+  ASSERT_EQ(sparse.count(0), 0);
+  for (size_t n = 9000 - tools::hashchain::SPARSE_DENSITY; n < 9000; ++n)
+    ASSERT_EQ(sparse.count(n), 1);
+  for (const auto &e: sparse)
+    ASSERT_EQ(e.second, make_hash(e.first + 1));
+
+  // moving up only drops heights, never needs ones dropped before
+  const std::map<size_t, crypto::hash> before = sparse;
+  hashchain.trim(9500);
+  ASSERT_EQ(hashchain.offset(), 9500);
+  for (const auto &e: sparse)
+    ASSERT_TRUE(e.first >= 9000 || before.count(e.first));
+  ASSERT_LE(sparse.size(), 12 * tools::hashchain::SPARSE_DENSITY);
+}
+
+TEST(hashchain, trim_sparse_skips_placeholders)
+{
+  tools::hashchain hashchain;
+  hashchain.push_back(make_hash(1));
+  for (uint64_t n = 1; n < 100; ++n)
+    hashchain.push_back(crypto::null_hash);
+  hashchain.push_back(make_hash(101));
+  hashchain.trim(100);
+  ASSERT_EQ(hashchain.offset(), 100);
+  ASSERT_TRUE(hashchain.sparse().empty());
+  ASSERT_EQ(hashchain.genesis(), make_hash(1));
+}
+
+TEST(hashchain, refill_sparse)
+{
+  tools::hashchain hashchain;
+  for (uint64_t n = 0; n < 100; ++n)
+    hashchain.push_back(make_hash(n + 1));
+  hashchain.trim(99);
+  ASSERT_EQ(hashchain.sparse().count(98), 1);
+  hashchain.crop(99);
+  hashchain.refill(make_hash(99));
+  ASSERT_EQ(hashchain.offset(), 98);
+  ASSERT_EQ(hashchain.sparse().count(98), 0);
+  hashchain.clear();
+  ASSERT_TRUE(hashchain.sparse().empty());
+}
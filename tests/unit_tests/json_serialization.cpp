@@ -3,6 +3,8 @@
 #include <boost/range/adaptor/indexed.hpp>
 #include <gtest/gtest.h>
 #include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 #include <vector>
 
 #include "crypto/hash.h"
@@ -267,3 +269,43 @@ TEST(JsonSerialization, Version3PerOutputUnlockTransaction)
     EXPECT_EQ(tx_bytes, tx_copy_bytes);
 }
 
+TEST(JsonSerialization, WriterMatchesDocument)
+{
+    cryptonote::account_base acct1;
+    acct1.generate();
+
+    cryptonote::account_base acct2;
+    acct2.generate();
+
+    const auto miner_tx = make_miner_transaction(acct1.get_keys().m_account_address);
+    const auto tx = make_transaction(
+        acct1.get_keys(), {miner_tx}, {acct2.get_keys().m_account_address}, true, true, false
+    );
+
+    rapidjson::Document doc;
+    cryptonote::json::toJsonValue(doc, tx, doc);
+
+    rapidjson::StringBuffer doc_buf;
+    cryptonote::json::writer doc_writer{doc_buf};
+    doc.Accept(doc_writer);
+
+    rapidjson::StringBuffer buf;
+    cryptonote::json::writer writer{buf};
+    cryptonote::json::toJsonValue(writer, tx);
+
+    const std::string streamed{buf.GetString(), buf.GetSize()};
+    EXPECT_EQ(std::string(doc_buf.GetString(), doc_buf.GetSize()), streamed);
+
+    rapidjson::Document parsed;
+    parsed.Parse(streamed.c_str());
+    ASSERT_FALSE(parsed.HasParseError());
+
+    cryptonote::transaction tx_copy;
+    cryptonote::json::fromJsonValue(parsed, tx_copy);
+
+    crypto::hash tx_hash{};
+    crypto::hash tx_copy_hash{};
+    ASSERT_TRUE(cryptonote::get_transaction_hash(tx, tx_hash));
+    ASSERT_TRUE(cryptonote::get_transaction_hash(tx_copy, tx_copy_hash));
+    EXPECT_EQ(tx_hash, tx_copy_hash);
+}
@@ -148,3 +148,41 @@ TEST(keccak, 137_and_1_136)
   TEST_KECCAK(137, chunks);
 }
 
+
+TEST(keccak, many)
+{
+  static const size_t sizes[] = {0, 1, 32, 64, 135, 136, 137, 300};
+  std::string data;
+  data.resize(9 * 300);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i * 17;
+  for (size_t sz: sizes)
+  {
+    for (size_t count = 0; count <= 9; ++count)
+    {
+      uint8_t md0[9 * 32], md1[32];
+      keccak_many((const uint8_t*)data.data(), sz, count, md0);
+      for (size_t i = 0; i < count; ++i)
+      {
+        keccak((const uint8_t*)data.data() + i * sz, sz, md1, 32);
+        ASSERT_EQ(memcmp(md0 + i * 32, md1, 32), 0);
+      }
+    }
+  }
+}
+
+TEST(keccak, many_in_place)
+{
+  uint8_t buf[9 * 64], md[32];
+  for (size_t i = 0; i < sizeof(buf); ++i)
+    buf[i] = i * 17;
+  keccak_many(buf, 64, 9, buf);
+  for (size_t i = 0; i < 9; ++i)
+  {
+    uint8_t in[64];
+    for (size_t j = 0; j < 64; ++j)
+      in[j] = (i * 64 + j) * 17;
+    keccak(in, 64, md, 32);
+    ASSERT_EQ(memcmp(buf + i * 32, md, 32), 0);
+  }
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "blockchain_db/key_image_filter.h"
+
+namespace
+{
+  crypto::key_image make_key_image()
+  {
+    crypto::key_image k_image;
+    crypto::generate_random_bytes_thread_safe(sizeof(k_image), (uint8_t*)&k_image);
+    return k_image;
+  }
+}
+
+TEST(key_image_filter, no_false_negatives)
+{
+  cryptonote::key_image_filter filter(1000);
+  std::vector<crypto::key_image> added;
+  for (size_t n = 0; n < 1000; ++n)
+  {
+    added.push_back(make_key_image());
+    filter.add(added.back());
+  }
+  ASSERT_EQ(filter.size(), 1000);
+  ASSERT_GE(filter.capacity(), 1000);
+  for (const crypto::key_image &k_image: added)
+    ASSERT_TRUE(filter.may_contain(k_image));
+}
+
+TEST(key_image_filter, mostly_negative)
+{
+  cryptonote::key_image_filter filter(10000);
+  for (size_t n = 0; n < 10000; ++n)
+    filter.add(make_key_image());
+
+  size_t false_positives = 0;
+  for (size_t n = 0; n < 10000; ++n)
+    false_positives += filter.may_contain(make_key_image());
+  ASSERT_LT(false_positives, 100);
+}
+
+TEST(key_image_filter, store_and_load)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  const std::string filename = path.string();
+
+  crypto::hash top_hash;
+  crypto::generate_random_bytes_thread_safe(sizeof(top_hash), (uint8_t*)&top_hash);
+
+  cryptonote::key_image_filter filter(100);
+  std::vector<crypto::key_image> added;
+  for (size_t n = 0; n < 100; ++n)
+  {
+    added.push_back(make_key_image());
+    filter.add(added.back());
+  }
+  ASSERT_TRUE(filter.store(filename, top_hash, added.size()));
+
+  // a file that doesn't match the DB state is rejected
+  ASSERT_TRUE(cryptonote::key_image_filter::load(filename, crypto::null_hash, added.size()) == NULL);
+  ASSERT_TRUE(cryptonote::key_image_filter::load(filename, top_hash, added.size() + 1) == NULL);
+
+  std::shared_ptr<cryptonote::key_image_filter> loaded = cryptonote::key_image_filter::load(filename, top_hash, added.size());
+  ASSERT_TRUE(loaded != NULL);
+  ASSERT_EQ(loaded->size(), filter.size());
+  ASSERT_EQ(loaded->capacity(), filter.capacity());
+  for (const crypto::key_image &k_image: added)
+    ASSERT_TRUE(loaded->may_contain(k_image));
+
+  boost::filesystem::remove(path);
+  ASSERT_TRUE(cryptonote::key_image_filter::load(filename, top_hash, added.size()) == NULL);
+}
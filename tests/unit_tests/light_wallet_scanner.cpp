@@ -0,0 +1,298 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/light_wallet_scanner.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+class light_wallet_scanner_access
+{
+public:
+  typedef cryptonote::light_wallet_scanner scanner;
+  typedef scanner::account account;
+  typedef scanner::scanned_tx scanned_tx;
+  typedef scanner::account_matches account_matches;
+
+  static void set_max_accounts(scanner& s, size_t n) { s.m_max_accounts = n; }
+  static std::shared_ptr<account> get(scanner& s, const cryptonote::account_public_address& address) { return s.m_accounts.at(address.m_spend_public_key); }
+  static void rollback(scanner& s, uint64_t height) { s.rollback(height); }
+  static void scan_account(const account& acc, const std::vector<scanned_tx>& txs, account_matches& matches) { scanner::scan_account(acc, txs, matches); }
+};
+
+namespace
+{
+
+class ChainDB: public cryptonote::BaseTestDB
+{
+public:
+  ChainDB(size_t height)
+  {
+    m_open = true;
+    for (size_t i = 0; i < height; ++i)
+    {
+      cryptonote::block b;
+      b.major_version = 7;
+      b.minor_version = 7;
+      b.timestamp = blocks.size();
+      b.prev_id = top_block_hash();
+      b.miner_tx.version = cryptonote::transaction::version_1;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{blocks.size()});
+      blocks.push_back(b);
+    }
+  }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { return blocks.at(h); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks.at(h)); }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()); }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back(); }
+
+  std::vector<cryptonote::block> blocks;
+};
+
+struct scanner_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  cryptonote::light_wallet_scanner scanner;
+  cryptonote::account_base wallet;
+
+  scanner_test(size_t height, size_t max_accounts): scanner(bc_objects.m_blockchain)
+  {
+    EXPECT_TRUE(bc_objects.m_blockchain.init(new ChainDB(height), cryptonote::FAKECHAIN, true, &test_options, 0));
+    light_wallet_scanner_access::set_max_accounts(scanner, max_accounts);
+    wallet.generate();
+  }
+
+  const cryptonote::account_public_address& address() const { return wallet.get_keys().m_account_address; }
+  const crypto::secret_key& view_key() const { return wallet.get_keys().m_view_secret_key; }
+};
+
+cryptonote::light_wallet_scanner::received_output make_output(uint64_t height, uint64_t global_index)
+{
+  cryptonote::light_wallet_scanner::received_output out{};
+  out.height = height;
+  out.global_index = global_index;
+  out.ringct = true;
+  return out;
+}
+
+// a ringct tx with a cleartext amount, paying one of its outputs to keys
+light_wallet_scanner_access::scanned_tx make_tx_to(const cryptonote::account_keys& keys, uint64_t height, size_t n_outputs, size_t ours, uint64_t first_global_index)
+{
+  light_wallet_scanner_access::scanned_tx stx;
+  const cryptonote::keypair tx_key = cryptonote::keypair::generate(hw::get_device("default"));
+  crypto::key_derivation derivation;
+  EXPECT_TRUE(crypto::generate_key_derivation(keys.m_account_address.m_view_public_key, tx_key.sec, derivation));
+  stx.tx.version = cryptonote::transaction::version_2;
+  stx.tx.rct_signatures.type = rct::RCTTypeNull;
+  for (size_t i = 0; i < n_outputs; ++i)
+  {
+    cryptonote::txout_to_key to_key;
+    if (i == ours)
+      EXPECT_TRUE(crypto::derive_public_key(derivation, i, keys.m_account_address.m_spend_public_key, to_key.key));
+    else
+      to_key.key = cryptonote::keypair::generate(hw::get_device("default")).pub;
+    stx.tx.vout.push_back(cryptonote::tx_out{1000 + i, to_key});
+    stx.global_indices.push_back(first_global_index + i);
+  }
+  stx.hash = crypto::rand<crypto::hash>();
+  stx.pub_key = tx_key.pub;
+  stx.height = height;
+  stx.timestamp = height;
+  stx.coinbase = false;
+  return stx;
+}
+
+// a tx without outputs whose single input has the given ring
+light_wallet_scanner_access::scanned_tx make_spend(uint64_t height, const std::vector<uint64_t>& ring)
+{
+  light_wallet_scanner_access::scanned_tx stx;
+  stx.tx.version = cryptonote::transaction::version_2;
+  stx.tx.rct_signatures.type = rct::RCTTypeNull;
+  cryptonote::txin_to_key in;
+  in.amount = 0;
+  in.key_offsets = cryptonote::absolute_output_offsets_to_relative(ring);
+  in.k_image = crypto::rand<crypto::key_image>();
+  stx.tx.vin.push_back(in);
+  stx.hash = crypto::rand<crypto::hash>();
+  stx.pub_key = crypto::null_pkey;
+  stx.height = height;
+  stx.timestamp = height;
+  stx.coinbase = false;
+  return stx;
+}
+
+}
+
+TEST(light_wallet_scanner, login_starts_at_chain_height)
+{
+  scanner_test t(10, 2);
+  ASSERT_EQ(t.scanner.login(t.address(), t.view_key(), false), cryptonote::light_wallet_scanner::login_unknown);
+  ASSERT_EQ(t.scanner.login(t.address(), t.view_key(), true), cryptonote::light_wallet_scanner::login_created);
+  ASSERT_EQ(t.scanner.login(t.address(), t.view_key(), true), cryptonote::light_wallet_scanner::login_ok);
+
+  cryptonote::light_wallet_scanner::account_state state;
+  ASSERT_TRUE(t.scanner.get_account(t.address(), t.view_key(), state));
+  ASSERT_EQ(state.start_height, 10);
+  ASSERT_EQ(state.scanned_height, 10);
+  ASSERT_TRUE(state.outputs.empty());
+  ASSERT_TRUE(state.spends.empty());
+
+  cryptonote::account_base other;
+  other.generate();
+  ASSERT_FALSE(t.scanner.get_account(other.get_keys().m_account_address, other.get_keys().m_view_secret_key, state));
+}
+
+TEST(light_wallet_scanner, full)
+{
+  scanner_test t(10, 1);
+  ASSERT_EQ(t.scanner.login(t.address(), t.view_key(), true), cryptonote::light_wallet_scanner::login_created);
+  cryptonote::account_base other;
+  other.generate();
+  ASSERT_EQ(t.scanner.login(other.get_keys().m_account_address, other.get_keys().m_view_secret_key, true), cryptonote::light_wallet_scanner::login_full);
+  ASSERT_EQ(t.scanner.import(other.get_keys().m_account_address, other.get_keys().m_view_secret_key, 0), cryptonote::light_wallet_scanner::login_full);
+  // re-importing a registered account takes no new slot
+  ASSERT_EQ(t.scanner.import(t.address(), t.view_key(), 0), cryptonote::light_wallet_scanner::login_ok);
+}
+
+TEST(light_wallet_scanner, import_rescans_from_height)
+{
+  scanner_test t(10, 2);
+  ASSERT_EQ(t.scanner.import(t.address(), t.view_key(), 3), cryptonote::light_wallet_scanner::login_ok);
+  cryptonote::light_wallet_scanner::account_state state;
+  ASSERT_TRUE(t.scanner.get_account(t.address(), t.view_key(), state));
+  ASSERT_EQ(state.start_height, 3);
+  ASSERT_EQ(state.scanned_height, 3);
+
+  // pretend it got scanned, then import again: the results are dropped
+  std::shared_ptr<light_wallet_scanner_access::account> acc = light_wallet_scanner_access::get(t.scanner, t.address());
+  acc->outputs.push_back(make_output(5, 42));
+  acc->scanned_height = 10;
+  ASSERT_EQ(t.scanner.import(t.address(), t.view_key(), 0), cryptonote::light_wallet_scanner::login_ok);
+  ASSERT_NE(light_wallet_scanner_access::get(t.scanner, t.address()), acc);
+  ASSERT_TRUE(t.scanner.get_account(t.address(), t.view_key(), state));
+  ASSERT_EQ(state.start_height, 0);
+  ASSERT_EQ(state.scanned_height, 0);
+  ASSERT_TRUE(state.outputs.empty());
+
+  // capped at the chain height
+  ASSERT_EQ(t.scanner.import(t.address(), t.view_key(), 1000), cryptonote::light_wallet_scanner::login_ok);
+  ASSERT_TRUE(t.scanner.get_account(t.address(), t.view_key(), state));
+  ASSERT_EQ(state.start_height, 10);
+}
+
+TEST(light_wallet_scanner, rollback)
+{
+  scanner_test t(10, 2);
+  ASSERT_EQ(t.scanner.login(t.address(), t.view_key(), true), cryptonote::light_wallet_scanner::login_created);
+  std::shared_ptr<light_wallet_scanner_access::account> acc = light_wallet_scanner_access::get(t.scanner, t.address());
+  acc->start_height = 2;
+  acc->scanned_height = 10;
+  acc->outputs.push_back(make_output(4, 40));
+  acc->outputs_by_index[40] = 0;
+  acc->outputs.push_back(make_output(8, 80));
+  acc->outputs_by_index[80] = 1;
+
+  light_wallet_scanner_access::rollback(t.scanner, 6);
+  ASSERT_EQ(acc->scanned_height, 6);
+  ASSERT_EQ(acc->start_height, 2);
+  ASSERT_EQ(acc->outputs.size(), 1);
+  ASSERT_EQ(acc->outputs_by_index.count(40), 1);
+  ASSERT_EQ(acc->outputs_by_index.count(80), 0);
+
+  light_wallet_scanner_access::rollback(t.scanner, 1);
+  ASSERT_EQ(acc->scanned_height, 1);
+  ASSERT_EQ(acc->start_height, 1);
+  ASSERT_TRUE(acc->outputs.empty());
+}
+
+TEST(light_wallet_scanner, scan_finds_outputs_and_spends)
+{
+  cryptonote::account_base wallet;
+  wallet.generate();
+  light_wallet_scanner_access::account acc;
+  acc.address = wallet.get_keys().m_account_address;
+  acc.view_key = wallet.get_keys().m_view_secret_key;
+  acc.start_height = 5;
+  acc.scanned_height = 5;
+
+  cryptonote::account_base other;
+  other.generate();
+  std::vector<light_wallet_scanner_access::scanned_tx> txs;
+  txs.push_back(make_tx_to(wallet.get_keys(), 4, 2, 0, 90));   // below the cursor
+  txs.push_back(make_tx_to(other.get_keys(), 5, 2, 0, 98));    // not ours
+  txs.push_back(make_tx_to(wallet.get_keys(), 5, 3, 1, 100));  // ours is global index 101
+  txs.push_back(make_spend(6, {50, 101}));                     // spends it, in the same batch
+  txs.push_back(make_spend(6, {50, 98}));
+
+  light_wallet_scanner_access::account_matches matches;
+  light_wallet_scanner_access::scan_account(acc, txs, matches);
+
+  ASSERT_EQ(matches.outputs.size(), 1);
+  ASSERT_EQ(matches.outputs[0].tx_hash, txs[2].hash);
+  ASSERT_EQ(matches.outputs[0].index, 1);
+  ASSERT_EQ(matches.outputs[0].global_index, 101);
+  ASSERT_EQ(matches.outputs[0].amount, 1001);
+  ASSERT_EQ(matches.outputs[0].height, 5);
+  ASSERT_TRUE(matches.outputs[0].ringct);
+
+  ASSERT_EQ(matches.spends.size(), 1);
+  ASSERT_EQ(matches.spends[0].tx_hash, txs[3].hash);
+  ASSERT_EQ(matches.spends[0].output, 0);
+  ASSERT_EQ(matches.spends[0].mixin, 1);
+}
+
+TEST(light_wallet_scanner, scan_matches_spends_of_earlier_outputs)
+{
+  cryptonote::account_base wallet;
+  wallet.generate();
+  light_wallet_scanner_access::account acc;
+  acc.address = wallet.get_keys().m_account_address;
+  acc.view_key = wallet.get_keys().m_view_secret_key;
+  acc.start_height = 0;
+  acc.scanned_height = 20;
+  acc.outputs.push_back(make_output(3, 7));
+  acc.outputs_by_index[7] = 0;
+
+  std::vector<light_wallet_scanner_access::scanned_tx> txs;
+  txs.push_back(make_spend(20, {7, 8, 9}));
+  light_wallet_scanner_access::account_matches matches;
+  light_wallet_scanner_access::scan_account(acc, txs, matches);
+  ASSERT_TRUE(matches.outputs.empty());
+  ASSERT_EQ(matches.spends.size(), 1);
+  ASSERT_EQ(matches.spends[0].output, 0);
+  ASSERT_EQ(matches.spends[0].mixin, 2);
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/miner.h"
+
+using cryptonote::miner;
+
+TEST(miner_placement, interleaves_cpus_across_nodes)
+{
+  const std::vector<std::vector<int>> nodes{{0, 1, 2}, {8}, {16, 17}};
+  const std::vector<miner::thread_placement> order = miner::interleave_numa_nodes(nodes);
+  const std::vector<int> cpus{0, 8, 16, 1, 17, 2};
+  const std::vector<size_t> node_of{0, 1, 2, 0, 2, 0};
+  ASSERT_EQ(cpus.size(), order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    EXPECT_EQ(cpus[i], order[i].cpu);
+    EXPECT_EQ(node_of[i], order[i].numa_node);
+  }
+}
+
+TEST(miner_placement, wraps_around_when_threads_outnumber_cpus)
+{
+  const std::vector<std::vector<int>> nodes{{0, 1}, {4, 5}};
+  const std::vector<miner::thread_placement> placements = miner::plan_thread_placements(nodes, 6, true);
+  const std::vector<int> cpus{0, 4, 1, 5, 0, 4};
+  ASSERT_EQ(cpus.size(), placements.size());
+  for (size_t i = 0; i < placements.size(); ++i)
+  {
+    EXPECT_EQ(cpus[i], placements[i].cpu);
+    EXPECT_EQ(i % 2, placements[i].numa_node);
+  }
+}
+
+TEST(miner_placement, shares_node_0_dataset_by_default)
+{
+  const std::vector<std::vector<int>> nodes{{0, 1}, {4, 5}};
+  const std::vector<miner::thread_placement> placements = miner::plan_thread_placements(nodes, 4, false);
+  const std::vector<int> cpus{0, 4, 1, 5};
+  ASSERT_EQ(cpus.size(), placements.size());
+  for (size_t i = 0; i < placements.size(); ++i)
+  {
+    // still spread over the nodes' cpus, but hashing against one dataset
+    EXPECT_EQ(cpus[i], placements[i].cpu);
+    EXPECT_EQ(0, placements[i].numa_node);
+  }
+}
+
+TEST(miner_placement, no_cpus)
+{
+  EXPECT_TRUE(miner::plan_thread_placements({}, 4, true).empty());
+  EXPECT_TRUE(miner::plan_thread_placements({{}}, 4, false).empty());
+}
@@ -26,6 +26,7 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <boost/filesystem.hpp>
 #include "gtest/gtest.h"
 
 #include "crypto/crypto.h"
@@ -252,3 +253,34 @@ TEST(multiexp, pippenger_cached)
     ASSERT_TRUE(basic(data) == pippenger(data, cache));
   }
 }
+
+TEST(multiexp, tuning)
+{
+  const rct::multiexp_tuning defaults;
+  ASSERT_TRUE(defaults.is_valid());
+  ASSERT_EQ(rct::get_pippenger_c(13), 2);
+  ASSERT_EQ(rct::get_pippenger_c(14), 3);
+  ASSERT_EQ(rct::get_pippenger_c(5000), 9);
+
+  rct::multiexp_tuning tuning;
+  tuning.straus_limit = 50;
+  for (size_t i = 0; i < sizeof(tuning.pippenger_c_limit) / sizeof(tuning.pippenger_c_limit[0]); ++i)
+    tuning.pippenger_c_limit[i] = 10 * (i + 1);
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(rct::save_multiexp_tuning(path.string(), tuning));
+  rct::multiexp_tuning loaded;
+  ASSERT_TRUE(rct::load_multiexp_tuning(path.string(), loaded));
+  boost::filesystem::remove(path);
+  ASSERT_EQ(loaded.straus_limit, 50);
+  ASSERT_EQ(loaded.pippenger_c_limit[6], 70);
+
+  rct::set_multiexp_tuning(loaded);
+  ASSERT_EQ(rct::get_straus_limit(), 50);
+  ASSERT_EQ(rct::get_pippenger_c(10), 2);
+  ASSERT_EQ(rct::get_pippenger_c(11), 3);
+  ASSERT_EQ(rct::get_pippenger_c(71), 9);
+  rct::set_multiexp_tuning(defaults);
+
+  tuning.pippenger_c_limit[3] = 1;
+  ASSERT_FALSE(tuning.is_valid());
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "net/network_throttle-detail.hpp"
+
+using namespace epee::net_utils;
+
+TEST(token_bucket, unlimited)
+{
+  token_bucket b;
+  b.consume(1000000, 0);
+  ASSERT_EQ(b.get_wait_time(0), 0);
+}
+
+TEST(token_bucket, starts_full)
+{
+  token_bucket b;
+  b.set_rate(1000, 1, 0);
+  ASSERT_EQ(b.get_tokens(0), 1000);
+  b.consume(1000, 0);
+  ASSERT_EQ(b.get_wait_time(0), 0);
+}
+
+TEST(token_bucket, debt)
+{
+  token_bucket b;
+  b.set_rate(1000, 1, 0);
+  b.consume(3000, 0);
+  ASSERT_DOUBLE_EQ(b.get_wait_time(0), 2);
+  ASSERT_DOUBLE_EQ(b.get_wait_time(1.5), 0.5);
+  ASSERT_EQ(b.get_wait_time(2), 0);
+}
+
+TEST(token_bucket, capped_refill)
+{
+  token_bucket b;
+  b.set_rate(1000, 1, 0);
+  b.consume(1000, 0);
+  ASSERT_EQ(b.get_tokens(100), 1000);
+  b.consume(1500, 100);
+  ASSERT_DOUBLE_EQ(b.get_wait_time(100), 0.5);
+}
+
+TEST(token_bucket, lower_rate)
+{
+  token_bucket b;
+  b.set_rate(1000, 1, 0);
+  b.set_rate(100, 1, 0);
+  ASSERT_EQ(b.get_tokens(0), 100);
+  b.set_rate(0, 1, 0);
+  ASSERT_EQ(b.get_wait_time(0), 0);
+}
+
+TEST(traffic_class, registry)
+{
+  ASSERT_EQ(get_command_traffic_class(999999), traffic_class::priority);
+  set_command_traffic_class(999999, traffic_class::gossip);
+  ASSERT_EQ(get_command_traffic_class(999999), traffic_class::gossip);
+  set_command_traffic_class(999999, traffic_class::priority);
+  ASSERT_EQ(get_command_traffic_class(999999), traffic_class::priority);
+}
@@ -26,6 +26,8 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#define IN_UNIT_TESTS
+
 #include "gtest/gtest.h"
 #include "misc_log_ex.h"
 #include "rpc/rpc_handler.h"
@@ -50,8 +52,8 @@ namespace
 class TestDB: public BaseTestDB
 {
 public:
-  TestDB(size_t bc_height = test_distribution_size): blockchain_height(bc_height) { m_open = true; }
-  virtual uint64_t height() const override { return blockchain_height; }
+  TestDB(size_t bc_height = test_distribution_size): block_outputs(test_distribution, test_distribution + bc_height), reads(0) { m_open = true; }
+  virtual uint64_t height() const override { return block_outputs.size(); }
 
   std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const override
   {
@@ -60,17 +62,45 @@ public:
     {
       uint64_t c = 0;
       for (uint64_t i = 0; i <= h; ++i)
-        c += test_distribution[i];
+        c += block_outputs.at(i);
       d.push_back(c);
     }
+    reads += heights.size();
     return d;
   }
 
+  virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override
+  {
+    block_outputs.pop_back();
+  }
+
   void correct_block_cumulative_difficulties(const uint64_t& /*start_height*/, const std::vector<cryptonote::difficulty_type>& /*new_cumulative_difficulties*/) override
   {
     // No-op for tests
   }
-  uint64_t blockchain_height;
+  std::vector<uint64_t> block_outputs;
+  mutable size_t reads;
+};
+
+struct distribution_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  TestDB *db;
+
+  distribution_test(): db(new TestDB())
+  {
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 0, NULL));
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+
+  boost::optional<cryptonote::rpc::output_distribution_data> get(uint64_t from, uint64_t to, bool cumulative)
+  {
+    return cryptonote::rpc::RpcHandler::get_output_distribution([this](uint64_t amount, uint64_t from, uint64_t to, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base) {
+      return bc().get_output_distribution(amount, from, to, start_height, distribution, base);
+    }, 0, from, to, cumulative);
+  }
 };
 
 }
@@ -175,3 +205,71 @@ TEST(output_distribution, part_noncumulative)
   ASSERT_EQ(res->distribution.size(), 5);
   ASSERT_EQ(res->distribution, std::vector<uint64_t>({0, 1, 5, 1, 4}));
 }
+
+TEST(output_distribution, tail_adds_up_to_the_full_distribution)
+{
+  distribution_test t;
+  const uint64_t top = test_distribution_size - 1;
+  boost::optional<cryptonote::rpc::output_distribution_data> full = t.get(0, top, true);
+  ASSERT_TRUE(full != boost::none);
+
+  // what a wallet does with a "since height" request: base plus the
+  // non cumulative tail gives the cumulative distribution from that height
+  for (uint64_t from = 1; from <= top; ++from)
+  {
+    boost::optional<cryptonote::rpc::output_distribution_data> tail = t.get(from, top, false);
+    ASSERT_TRUE(tail != boost::none);
+    ASSERT_EQ(tail->start_height, from);
+    ASSERT_EQ(tail->base, full->distribution[from - 1]);
+    ASSERT_EQ(tail->distribution.size(), top + 1 - from);
+    uint64_t c = tail->base;
+    for (size_t i = 0; i < tail->distribution.size(); ++i)
+    {
+      c += tail->distribution[i];
+      ASSERT_EQ(c, full->distribution[from + i]);
+    }
+  }
+
+  // nothing past the top
+  ASSERT_TRUE(t.get(top - 2, top + 1, false) == boost::none);
+}
+
+TEST(output_distribution, only_new_heights_are_read)
+{
+  distribution_test t;
+  ASSERT_TRUE(t.get(0, test_distribution_size - 1, false) != boost::none);
+  ASSERT_EQ(t.db->reads, test_distribution_size);
+
+  t.db->reads = 0;
+  ASSERT_TRUE(t.get(10, test_distribution_size - 1, false) != boost::none);
+  ASSERT_TRUE(t.get(0, 5, true) != boost::none);
+  ASSERT_EQ(t.db->reads, 0);
+
+  t.db->block_outputs.push_back(4);
+  t.db->block_outputs.push_back(6);
+  boost::optional<cryptonote::rpc::output_distribution_data> res = t.get(test_distribution_size - 1, test_distribution_size + 1, true);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution, std::vector<uint64_t>({60, 64, 70}));
+  ASSERT_EQ(t.db->reads, 2);
+}
+
+TEST(output_distribution, popped_blocks_are_dropped)
+{
+  distribution_test t;
+  const uint64_t top = test_distribution_size - 1;
+  ASSERT_TRUE(t.get(0, top, true) != boost::none);
+
+  // reorg the top two blocks away for ones with different outputs
+  t.bc().pop_block_from_blockchain();
+  t.bc().pop_block_from_blockchain();
+  ASSERT_TRUE(t.get(top - 1, top, false) == boost::none);
+  t.db->block_outputs.push_back(10);
+  t.db->block_outputs.push_back(20);
+
+  t.db->reads = 0;
+  boost::optional<cryptonote::rpc::output_distribution_data> res = t.get(top - 2, top, false);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution, std::vector<uint64_t>({0, 10, 20}));
+  ASSERT_EQ(res->base, 55);
+  ASSERT_EQ(t.db->reads, 2);
+}
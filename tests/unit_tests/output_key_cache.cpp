@@ -0,0 +1,123 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/output_key_cache.h"
+#include "testdb.h"
+
+namespace
+{
+
+// outputs 0..n_outputs-1 exist for every amount, their unlock time is
+// their index
+class TestDB: public BaseTestDB
+{
+public:
+  TestDB(uint64_t n_outputs): n_outputs(n_outputs), fetched(0) {}
+
+  virtual void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<cryptonote::output_data_t> &outputs, bool allow_partial) const override
+  {
+    outputs.clear();
+    for (uint64_t offset: offsets)
+    {
+      if (offset >= n_outputs)
+      {
+        if (allow_partial)
+          return;
+        throw cryptonote::OUTPUT_DNE("output not found");
+      }
+      cryptonote::output_data_t data = {};
+      data.unlock_time = offset;
+      outputs.push_back(data);
+      ++fetched;
+    }
+  }
+
+  void correct_block_cumulative_difficulties(const uint64_t& /*start_height*/, const std::vector<cryptonote::difficulty_type>& /*new_cumulative_difficulties*/) override {}
+
+  uint64_t n_outputs;
+  mutable size_t fetched;
+};
+
+}
+
+TEST(output_key_cache, hits_skip_the_db)
+{
+  TestDB db(100);
+  cryptonote::output_key_cache cache(1000);
+  std::vector<cryptonote::output_data_t> outputs;
+  cache.get_output_keys(db, 0, {1, 2, 3}, outputs, true);
+  ASSERT_EQ(db.fetched, 3);
+  cache.get_output_keys(db, 0, {3, 4, 1}, outputs, true);
+  ASSERT_EQ(db.fetched, 4);
+  ASSERT_EQ(outputs.size(), 3);
+  ASSERT_EQ(outputs[0].unlock_time, 3);
+  ASSERT_EQ(outputs[1].unlock_time, 4);
+  ASSERT_EQ(outputs[2].unlock_time, 1);
+  // other amounts are other outputs
+  cache.get_output_keys(db, 5, {1}, outputs, true);
+  ASSERT_EQ(db.fetched, 5);
+}
+
+TEST(output_key_cache, partial)
+{
+  TestDB db(10);
+  cryptonote::output_key_cache cache(1000);
+  std::vector<cryptonote::output_data_t> outputs;
+  cache.get_output_keys(db, 0, {8}, outputs, true);
+  cache.get_output_keys(db, 0, {7, 20, 8}, outputs, true);
+  ASSERT_EQ(outputs.size(), 1);
+  ASSERT_EQ(outputs[0].unlock_time, 7);
+  ASSERT_THROW(cache.get_output_keys(db, 0, {7, 20}, outputs, false), cryptonote::OUTPUT_DNE);
+}
+
+TEST(output_key_cache, bounded)
+{
+  TestDB db(1000);
+  cryptonote::output_key_cache cache(10);
+  std::vector<cryptonote::output_data_t> outputs;
+  for (uint64_t i = 0; i < 100; ++i)
+    cache.get_output_keys(db, 0, {i}, outputs, true);
+  db.fetched = 0;
+  cache.get_output_keys(db, 0, {0}, outputs, true);
+  ASSERT_EQ(db.fetched, 1);
+  cache.get_output_keys(db, 0, {99}, outputs, true);
+  ASSERT_EQ(db.fetched, 1);
+}
+
+TEST(output_key_cache, clear)
+{
+  TestDB db(10);
+  cryptonote::output_key_cache cache(1000);
+  std::vector<cryptonote::output_data_t> outputs;
+  cache.get_output_keys(db, 0, {1}, outputs, true);
+  cache.clear();
+  cache.get_output_keys(db, 0, {1}, outputs, true);
+  ASSERT_EQ(db.fetched, 2);
+}
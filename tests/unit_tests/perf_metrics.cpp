@@ -0,0 +1,113 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <limits>
+#include "gtest/gtest.h"
+
+#include "common/perf_timer.h"
+
+namespace
+{
+  std::string metric_line(const std::string &out, const std::string &prefix)
+  {
+    const size_t pos = out.find(prefix);
+    if (pos == std::string::npos)
+      return "";
+    return out.substr(pos, out.find('\n', pos) - pos);
+  }
+}
+
+TEST(perf_metrics, bucket_bounds)
+{
+  const size_t buckets = tools::perf_histo_bucket_count();
+  size_t prev = 0;
+  for (uint64_t ns = 0; ns < ((uint64_t)1 << 41); ns = ns < 64 ? ns + 1 : ns + ns / 7)
+  {
+    const size_t b = tools::perf_histo_bucket(ns);
+    ASSERT_LT(b, buckets);
+    ASSERT_GE(b, prev);
+    prev = b;
+    if (b == buckets - 1)
+      continue;
+    const uint64_t end = tools::perf_histo_bucket_end(b);
+    ASSERT_GT(end, ns);
+    ASSERT_LE(end - ns, end / 4 + 1);
+    if (b > 0)
+      ASSERT_LE(tools::perf_histo_bucket_end(b - 1), ns);
+  }
+}
+
+TEST(perf_metrics, bucket_ends_increase)
+{
+  for (size_t b = 1; b < tools::perf_histo_bucket_count(); ++b)
+  {
+    ASSERT_LT(tools::perf_histo_bucket_end(b - 1), tools::perf_histo_bucket_end(b));
+    ASSERT_EQ(tools::perf_histo_bucket(tools::perf_histo_bucket_end(b - 1)), b);
+  }
+}
+
+TEST(perf_metrics, bucket_overflow)
+{
+  const size_t last = tools::perf_histo_bucket_count() - 1;
+  ASSERT_EQ(tools::perf_histo_bucket((uint64_t)1 << 50), last);
+  ASSERT_EQ(tools::perf_histo_bucket(std::numeric_limits<uint64_t>::max()), last);
+}
+
+TEST(perf_metrics, prometheus_rendering)
+{
+  const size_t id = tools::register_perf_metric("unit_test_prometheus_rendering");
+  ASSERT_NE(id, tools::NO_PERF_METRIC);
+  ASSERT_EQ(tools::register_perf_metric("unit_test_prometheus_rendering"), id);
+
+  tools::record_perf_duration(id, 1500);
+  tools::record_perf_duration(id, 3000000);
+  tools::record_perf_duration(tools::NO_PERF_METRIC, 1500);
+
+  const std::string out = tools::get_perf_metrics_prometheus("test");
+  const std::string bucket = "test_perf_timer_seconds_bucket{timer=\"unit_test_prometheus_rendering\",le=";
+  ASSERT_EQ(metric_line(out, bucket + "\"1.024e-06\"}"), bucket + "\"1.024e-06\"} 0");
+  ASSERT_EQ(metric_line(out, bucket + "\"2.048e-06\"}"), bucket + "\"2.048e-06\"} 1");
+  ASSERT_EQ(metric_line(out, bucket + "\"0.002097152\"}"), bucket + "\"0.002097152\"} 1");
+  ASSERT_EQ(metric_line(out, bucket + "\"0.004194304\"}"), bucket + "\"0.004194304\"} 2");
+  ASSERT_EQ(metric_line(out, bucket + "\"+Inf\"}"), bucket + "\"+Inf\"} 2");
+  ASSERT_EQ(metric_line(out, "test_perf_timer_seconds_sum{timer=\"unit_test_prometheus_rendering\"}"),
+      "test_perf_timer_seconds_sum{timer=\"unit_test_prometheus_rendering\"} 0.0030015");
+  ASSERT_EQ(metric_line(out, "test_perf_timer_seconds_count{timer=\"unit_test_prometheus_rendering\"}"),
+      "test_perf_timer_seconds_count{timer=\"unit_test_prometheus_rendering\"} 2");
+  ASSERT_EQ(metric_line(out, "test_perf_timer_in_flight{timer=\"unit_test_prometheus_rendering\"}"),
+      "test_perf_timer_in_flight{timer=\"unit_test_prometheus_rendering\"} 0");
+
+  // quantiles report the upper bound of the bucket the rank falls in
+  ASSERT_EQ(metric_line(out, "test_perf_timer_quantile_seconds{timer=\"unit_test_prometheus_rendering\",quantile=\"0.5\"}"),
+      "test_perf_timer_quantile_seconds{timer=\"unit_test_prometheus_rendering\",quantile=\"0.5\"} 1.536e-06");
+  ASSERT_EQ(metric_line(out, "test_perf_timer_quantile_seconds{timer=\"unit_test_prometheus_rendering\",quantile=\"0.99\"}"),
+      "test_perf_timer_quantile_seconds{timer=\"unit_test_prometheus_rendering\",quantile=\"0.99\"} 0.003145728");
+
+  ASSERT_NE(out.find("# TYPE test_perf_timer_seconds histogram\n"), std::string::npos);
+  ASSERT_EQ(out.find("timer=\"unit_test_never_recorded\""), std::string::npos);
+}
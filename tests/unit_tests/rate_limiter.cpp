@@ -0,0 +1,172 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "net/net_utils_base.h"
+#include "rpc/rate_limiter.h"
+
+#define MAKE_IP( a1, a2, a3, a4 )	(a1|(a2<<8)|(a3<<16)|(((uint32_t)a4)<<24))
+
+namespace
+{
+  epee::net_utils::network_address ipv4(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+  {
+    return epee::net_utils::ipv4_network_address{MAKE_IP(a, b, c, d), 18081};
+  }
+
+  epee::net_utils::network_address ipv6(const std::string& ip)
+  {
+    return epee::net_utils::ipv6_network_address(ip, 18081);
+  }
+
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+}
+
+using cryptonote::rpc::rate_limiter;
+using cryptonote::rpc::RATE_LIMIT_BURST_SECONDS;
+
+TEST(rate_limiter, disabled)
+{
+  rate_limiter limiter;
+  unsigned retry_after;
+  ASSERT_FALSE(limiter.enabled());
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 50, retry_after, t0));
+  ASSERT_EQ(limiter.tracked(), 0);
+}
+
+TEST(rate_limiter, burst)
+{
+  rate_limiter limiter;
+  limiter.set_rates(10, 0);
+  unsigned retry_after;
+  for (unsigned i = 0; i < 10 * RATE_LIMIT_BURST_SECONDS; ++i)
+    ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 1, retry_after, t0));
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 1, retry_after, t0));
+  ASSERT_EQ(retry_after, 1);
+  ASSERT_EQ(limiter.throttled_hosts(), 1);
+
+  // other hosts have their own bucket
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 5), 1, retry_after, t0));
+}
+
+TEST(rate_limiter, refill)
+{
+  rate_limiter limiter;
+  limiter.set_rates(10, 0);
+  unsigned retry_after;
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 10 * RATE_LIMIT_BURST_SECONDS, retry_after, t0));
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 1, retry_after, t0));
+
+  const auto t1 = t0 + std::chrono::seconds(2);
+  for (int i = 0; i < 20; ++i)
+    ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 1, retry_after, t1));
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 1, retry_after, t1));
+
+  // never above a full burst, however long the client was idle
+  const auto t2 = t1 + std::chrono::hours(1);
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 10 * RATE_LIMIT_BURST_SECONDS, retry_after, t2));
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 1, retry_after, t2));
+}
+
+TEST(rate_limiter, retry_after)
+{
+  rate_limiter limiter;
+  limiter.set_rates(10, 0);
+  unsigned retry_after;
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 10 * RATE_LIMIT_BURST_SECONDS, retry_after, t0));
+  ASSERT_EQ(retry_after, 0);
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 50, retry_after, t0));
+  ASSERT_EQ(retry_after, 5);
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 50, retry_after, t0 + std::chrono::seconds(3)));
+  ASSERT_EQ(retry_after, 2);
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 50, retry_after, t0 + std::chrono::seconds(5)));
+
+  // a cost above a whole burst waits for a full bucket
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 4), 1000, retry_after, t0 + std::chrono::seconds(5)));
+  ASSERT_EQ(retry_after, RATE_LIMIT_BURST_SECONDS);
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 4), 1000, retry_after, t0 + std::chrono::seconds(5 + RATE_LIMIT_BURST_SECONDS)));
+}
+
+TEST(rate_limiter, subnet_is_shared)
+{
+  rate_limiter limiter;
+  limiter.set_rates(100, 10);
+  unsigned retry_after;
+  // each host is well within its own rate, the /24 is not
+  for (unsigned i = 0; i < 10 * RATE_LIMIT_BURST_SECONDS; ++i)
+    ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, i % 50), 1, retry_after, t0));
+  ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, 200), 1, retry_after, t0));
+  ASSERT_EQ(retry_after, 1);
+  ASSERT_EQ(limiter.throttled_subnets(), 1);
+  ASSERT_EQ(limiter.throttled_hosts(), 0);
+
+  // another /24 is not affected
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 4, 1), 1, retry_after, t0));
+}
+
+TEST(rate_limiter, ipv6_subnet)
+{
+  rate_limiter limiter;
+  limiter.set_rates(0, 1);
+  unsigned retry_after;
+  ASSERT_TRUE(limiter.try_charge(ipv6("2001:db8::1"), RATE_LIMIT_BURST_SECONDS, retry_after, t0));
+  ASSERT_FALSE(limiter.try_charge(ipv6("2001:db8::ffff:2"), 1, retry_after, t0));
+  ASSERT_TRUE(limiter.try_charge(ipv6("2001:db8:0:1::1"), 1, retry_after, t0));
+  ASSERT_EQ(rate_limiter::subnet_of(ipv6("2001:db8::ffff:2")), "2001:db8::/64");
+  ASSERT_EQ(rate_limiter::subnet_of(ipv4(1, 2, 3, 4)), "1.2.3.0/24");
+}
+
+TEST(rate_limiter, refused_by_subnet_adds_no_host)
+{
+  rate_limiter limiter;
+  limiter.set_rates(100, 1);
+  unsigned retry_after;
+  ASSERT_TRUE(limiter.try_charge(ipv4(1, 2, 3, 1), RATE_LIMIT_BURST_SECONDS, retry_after, t0));
+  ASSERT_EQ(limiter.tracked(), 2);
+  for (uint32_t i = 2; i < 200; ++i)
+    ASSERT_FALSE(limiter.try_charge(ipv4(1, 2, 3, i), 1, retry_after, t0));
+  ASSERT_EQ(limiter.tracked(), 2);
+}
+
+TEST(rate_limiter, tracked_is_bounded)
+{
+  rate_limiter limiter;
+  limiter.set_rates(10, 0);
+  unsigned retry_after;
+  const uint32_t hosts = cryptonote::rpc::RATE_LIMIT_MAX_TRACKED + 100;
+  for (uint32_t i = 0; i < hosts; ++i)
+    ASSERT_TRUE(limiter.try_charge(ipv4(10, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff), 1, retry_after, t0));
+  ASSERT_EQ(limiter.tracked(), cryptonote::rpc::RATE_LIMIT_MAX_TRACKED);
+
+  // the most recently charged hosts are kept, the oldest dropped
+  ASSERT_TRUE(limiter.try_charge(ipv4(10, 0, 0, 0), 10 * RATE_LIMIT_BURST_SECONDS, retry_after, t0));
+  const uint32_t last = hosts - 1;
+  ASSERT_FALSE(limiter.try_charge(ipv4(10, (last >> 16) & 0xff, (last >> 8) & 0xff, last & 0xff), 10 * RATE_LIMIT_BURST_SECONDS, retry_after, t0));
+}
@@ -0,0 +1,166 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+// a read only DB whose chain the test changes behind the Blockchain's back,
+// like a replica's primary does
+class ReplicaDB: public cryptonote::BaseTestDB
+{
+public:
+  ReplicaDB() { m_open = true; }
+
+  virtual bool is_read_only() const override { return true; }
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { return blocks.at(h); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks.at(h)); }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back()); }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back(); }
+  virtual void invalidate_cache_from_height(uint64_t height) override { invalidated.push_back(height); }
+
+  // what the primary does: pop n blocks, then add new ones tagged with salt
+  void pop(size_t n) { blocks.resize(blocks.size() - n); }
+  void push(size_t n, uint32_t salt)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      cryptonote::block b;
+      b.major_version = 7;
+      b.minor_version = 7;
+      b.timestamp = blocks.size();
+      b.nonce = salt;
+      b.prev_id = top_block_hash();
+      b.miner_tx.version = cryptonote::transaction::version_1;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{blocks.size()});
+      blocks.push_back(b);
+    }
+  }
+
+  std::vector<cryptonote::block> blocks;
+  std::vector<uint64_t> invalidated;
+};
+
+struct Hooks: public cryptonote::Blockchain::BlockAddedHook, public cryptonote::Blockchain::BlockchainDetachedHook
+{
+  virtual void block_added(const cryptonote::block &block, const std::vector<cryptonote::transaction> &txs) override { added.push_back(cryptonote::get_block_hash(block)); }
+  virtual void blockchain_detached(uint64_t height) override { detached.push_back(height); }
+
+  std::vector<crypto::hash> added;
+  std::vector<uint64_t> detached;
+};
+
+struct replica_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  ReplicaDB *db;
+  Hooks hooks;
+
+  replica_test(size_t height): db(new ReplicaDB())
+  {
+    db->push(height, 0);
+  }
+  bool init()
+  {
+    cryptonote::Blockchain &bc = bc_objects.m_blockchain;
+    if (!bc.init(db, cryptonote::FAKECHAIN, true, &test_options, 0))
+      return false;
+    bc.hook_block_added(hooks);
+    bc.hook_blockchain_detached(hooks);
+    return true;
+  }
+};
+
+}
+
+TEST(replica, sync_from_db_follows_added_blocks)
+{
+  replica_test t(10);
+  ASSERT_TRUE(t.init());
+  cryptonote::Blockchain &bc = t.bc_objects.m_blockchain;
+
+  ASSERT_TRUE(bc.sync_from_db());
+  ASSERT_TRUE(t.hooks.added.empty());
+
+  t.db->push(3, 0);
+  ASSERT_TRUE(bc.sync_from_db());
+  ASSERT_EQ(t.hooks.added.size(), 3);
+  for (size_t i = 0; i < 3; ++i)
+    ASSERT_EQ(t.hooks.added[i], cryptonote::get_block_hash(t.db->blocks[10 + i]));
+  ASSERT_TRUE(t.hooks.detached.empty());
+  ASSERT_EQ(bc.get_tail_id(), t.db->top_block_hash());
+}
+
+TEST(replica, sync_from_db_follows_reorg)
+{
+  replica_test t(10);
+  ASSERT_TRUE(t.init());
+  cryptonote::Blockchain &bc = t.bc_objects.m_blockchain;
+
+  // the primary switches to a longer chain forking off below its top 2 blocks
+  t.db->pop(2);
+  t.db->push(3, 1);
+  ASSERT_TRUE(bc.sync_from_db());
+
+  ASSERT_EQ(t.hooks.detached, std::vector<uint64_t>{8});
+  ASSERT_EQ(t.db->invalidated, std::vector<uint64_t>{8});
+  ASSERT_EQ(t.hooks.added.size(), 3);
+  for (size_t i = 0; i < 3; ++i)
+    ASSERT_EQ(t.hooks.added[i], cryptonote::get_block_hash(t.db->blocks[8 + i]));
+  ASSERT_EQ(bc.get_tail_id(), t.db->top_block_hash());
+
+  // nothing more to do until the primary changes again
+  t.hooks.added.clear();
+  t.hooks.detached.clear();
+  ASSERT_TRUE(bc.sync_from_db());
+  ASSERT_TRUE(t.hooks.added.empty());
+  ASSERT_TRUE(t.hooks.detached.empty());
+}
+
+TEST(replica, sync_from_db_follows_pop)
+{
+  replica_test t(10);
+  ASSERT_TRUE(t.init());
+  cryptonote::Blockchain &bc = t.bc_objects.m_blockchain;
+
+  t.db->pop(4);
+  ASSERT_TRUE(bc.sync_from_db());
+  ASSERT_EQ(t.hooks.detached, std::vector<uint64_t>{6});
+  ASSERT_TRUE(t.hooks.added.empty());
+  ASSERT_EQ(bc.get_tail_id(), t.db->top_block_hash());
+}
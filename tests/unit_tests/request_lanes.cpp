@@ -0,0 +1,125 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "rpc/core_rpc_server.h"
+#include "rpc/request_lanes.h"
+
+using cryptonote::rpc::cost_class;
+using cryptonote::rpc::request_lanes;
+
+TEST(request_lanes, configure_defaults_from_threads)
+{
+  request_lanes lanes;
+  lanes.configure(4, 1, 0);
+  ASSERT_EQ(lanes.limit(cost_class::heavy), 1);
+  ASSERT_EQ(lanes.limit(cost_class::light), 2);
+  ASSERT_EQ(lanes.limit(cost_class::mining), std::numeric_limits<size_t>::max());
+
+  lanes.configure(16, 1, 0);
+  ASSERT_EQ(lanes.limit(cost_class::heavy), 7);
+  ASSERT_EQ(lanes.limit(cost_class::light), 8);
+
+  // too few threads to go around, light still gets its floor
+  lanes.configure(1, 1, 0);
+  ASSERT_EQ(lanes.limit(cost_class::heavy), 1);
+  ASSERT_EQ(lanes.limit(cost_class::light), 2);
+}
+
+TEST(request_lanes, configure_default_rpc_options)
+{
+  const size_t threads = cryptonote::core_rpc_server::arg_rpc_threads.default_value;
+  request_lanes lanes;
+  lanes.configure(threads, cryptonote::rpc::RESERVED_MINING_THREADS, cryptonote::core_rpc_server::arg_rpc_max_heavy_requests.default_value);
+  ASSERT_EQ(threads, 4);
+  ASSERT_EQ(lanes.limit(cost_class::heavy), 1);
+  ASSERT_EQ(lanes.limit(cost_class::light), 2);
+  ASSERT_EQ(lanes.limit(cost_class::mining), std::numeric_limits<size_t>::max());
+  // light and heavy together still leave the mining thread free
+  ASSERT_LE(lanes.limit(cost_class::heavy) + lanes.limit(cost_class::light) + cryptonote::rpc::RESERVED_MINING_THREADS, threads);
+}
+
+TEST(request_lanes, configure_explicit_heavy)
+{
+  request_lanes lanes;
+  lanes.configure(8, 1, 3);
+  ASSERT_EQ(lanes.limit(cost_class::heavy), 3);
+  ASSERT_EQ(lanes.limit(cost_class::light), 4);
+
+  // capped by the unreserved threads
+  lanes.configure(4, 1, 10);
+  ASSERT_EQ(lanes.limit(cost_class::heavy), 3);
+  ASSERT_EQ(lanes.limit(cost_class::light), 2);
+}
+
+TEST(request_lanes, rejects_when_full)
+{
+  request_lanes lanes;
+  lanes.set_limit(cost_class::heavy, 2);
+  request_lanes::slot a = lanes.try_acquire(cost_class::heavy);
+  request_lanes::slot b = lanes.try_acquire(cost_class::heavy);
+  ASSERT_TRUE(a);
+  ASSERT_TRUE(b);
+  ASSERT_EQ(lanes.in_flight(cost_class::heavy), 2);
+  ASSERT_FALSE(lanes.try_acquire(cost_class::heavy));
+  ASSERT_EQ(lanes.rejected(cost_class::heavy), 1);
+
+  // other lanes are unaffected
+  ASSERT_TRUE(lanes.try_acquire(cost_class::light));
+  ASSERT_EQ(lanes.rejected(cost_class::light), 0);
+}
+
+TEST(request_lanes, slot_release)
+{
+  request_lanes lanes;
+  lanes.set_limit(cost_class::light, 1);
+  {
+    request_lanes::slot a = lanes.try_acquire(cost_class::light);
+    ASSERT_TRUE(a);
+    request_lanes::slot moved(std::move(a));
+    ASSERT_FALSE(a);
+    ASSERT_TRUE(moved);
+    ASSERT_EQ(lanes.in_flight(cost_class::light), 1);
+  }
+  ASSERT_EQ(lanes.in_flight(cost_class::light), 0);
+  ASSERT_TRUE(lanes.try_acquire(cost_class::light));
+}
+
+TEST(request_lanes, zero_is_unlimited)
+{
+  request_lanes lanes;
+  lanes.set_limit(cost_class::mining, 0);
+  std::vector<request_lanes::slot> slots;
+  for (int i = 0; i < 1000; ++i)
+  {
+    slots.emplace_back(lanes.try_acquire(cost_class::mining));
+    ASSERT_TRUE(slots.back());
+  }
+  ASSERT_EQ(lanes.in_flight(cost_class::mining), 1000);
+}
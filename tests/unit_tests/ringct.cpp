@@ -32,12 +32,14 @@
 
 #include <cstdint>
 #include <algorithm>
+#include <deque>
 #include <sstream>
 
 #include "ringct/rctTypes.h"
 #include "ringct/rctSigs.h"
 #include "ringct/rctOps.h"
 #include "device/device.hpp"
+#include "common/threadpool.h"
 
 using namespace std;
 using namespace crypto;
@@ -1093,7 +1095,23 @@ TEST(ringct, H)
 {
   ge_p3 p3;
   ASSERT_EQ(ge_frombytes_vartime(&p3, rct::H.bytes), 0);
-  ASSERT_EQ(memcmp(&p3, &ge_p3_H, sizeof(ge_p3)), 0);
+  // limbs are not unique (constants are stored unreduced), so compare encodings
+  rct::key decoded, constant;
+  ge_p3_tobytes(decoded.bytes, &p3);
+  ge_p3_tobytes(constant.bytes, &ge_p3_H);
+  ASSERT_EQ(decoded, rct::H);
+  ASSERT_EQ(constant, rct::H);
+}
+
+TEST(ringct, point_at_infinity)
+{
+  // a decoded identity does not have canonical limbs
+  ASSERT_TRUE(ge_p3_is_point_at_infinity(&ge_p3_identity));
+  ge_p3 p3;
+  ASSERT_EQ(ge_frombytes_vartime(&p3, rct::identity().bytes), 0);
+  ASSERT_TRUE(ge_p3_is_point_at_infinity(&p3));
+  ASSERT_EQ(ge_frombytes_vartime(&p3, rct::H.bytes), 0);
+  ASSERT_FALSE(ge_p3_is_point_at_infinity(&p3));
 }
 
 TEST(ringct, mul8)
@@ -1103,6 +1121,61 @@ TEST(ringct, mul8)
   ASSERT_EQ(rct::scalarmultKey(rct::scalarmultKey(rct::H, rct::INV_EIGHT), rct::EIGHT), rct::H);
 }
 
+TEST(ringct, H_precomp)
+{
+  // the fixed-base H table must agree with the generic paths
+  for (int n = 0; n < 64; ++n)
+  {
+    const rct::key a = rct::skGen(), b = rct::skGen();
+    ASSERT_EQ(rct::scalarmultH(a), rct::scalarmultKey(rct::H, a));
+    rct::key fast, slow;
+    rct::addKeys2(fast, a, b, rct::H);
+    rct::addKeys(slow, rct::scalarmultBase(a), rct::scalarmultKey(rct::H, b));
+    ASSERT_EQ(fast, slow);
+  }
+  ASSERT_EQ(rct::scalarmultH(rct::identity()), rct::H);
+  ASSERT_EQ(rct::scalarmultH(rct::zero()), rct::identity());
+}
+
+TEST(ringct, CLSAG_repeated_ring_members)
+{
+  // ring members are cached across verifications, results must not change
+  static const size_t N = 11, idx = 5;
+  const rct::key message = rct::identity();
+  rct::ctkeyV pubs;
+  for (size_t i = 0; i < N; ++i)
+  {
+    rct::key sk;
+    rct::ctkey tmp;
+    rct::skpkGen(sk, tmp.dest);
+    rct::skpkGen(sk, tmp.mask);
+    pubs.push_back(tmp);
+  }
+  rct::key p, t, t2, u, Cout;
+  rct::skpkGen(p, pubs[idx].dest);
+  t = rct::skGen();
+  u = rct::skGen();
+  rct::addKeys2(pubs[idx].mask, t, u, rct::H);
+  t2 = rct::skGen();
+  rct::addKeys2(Cout, t2, u, rct::H);
+  rct::ctkey insk;
+  insk.dest = p;
+  insk.mask = t;
+
+  const rct::clsag sig = rct::proveRctCLSAGSimple(message, pubs, insk, t2, Cout, NULL, NULL, NULL, idx, hw::get_device("default"));
+  ASSERT_TRUE(rct::verRctCLSAGSimple(message, sig, pubs, Cout));
+  ASSERT_TRUE(rct::verRctCLSAGSimple(message, sig, pubs, Cout));
+
+  rct::clsag bad = sig;
+  bad.s[0] = rct::skGen();
+  ASSERT_FALSE(rct::verRctCLSAGSimple(message, bad, pubs, Cout));
+
+  rct::ctkeyV swapped = pubs;
+  std::swap(swapped[0], swapped[1]);
+  ASSERT_FALSE(rct::verRctCLSAGSimple(message, sig, swapped, Cout));
+  ASSERT_TRUE(rct::verRctCLSAGSimple(message, sig, pubs, Cout));
+}
+
 TEST(ringct, aggregated)
 {
   static const size_t N_PROOFS = 16;
@@ -1119,3 +1192,49 @@ TEST(ringct, aggregated)
 
   ASSERT_TRUE(verRctSemanticsSimple(sp));
 }
+
+TEST(ringct, aggregated_non_semantics)
+{
+  static const size_t N_SIGS = 8;
+  std::vector<rctSig> s(N_SIGS);
+  std::vector<const rctSig*> sp(N_SIGS);
+
+  for (size_t n = 0; n < N_SIGS; ++n)
+  {
+    static const uint64_t inputs[] = {1000, 1000};
+    static const uint64_t outputs[] = {500, 1500};
+    s[n] = make_sample_simple_rct_sig(NELTS(inputs), inputs, NELTS(outputs), outputs, 0);
+    sp[n] = &s[n];
+  }
+
+  ASSERT_TRUE(verRctNonSemanticsSimple(sp));
+
+  // a single bad signature anywhere in the batch fails the whole batch
+  s[N_SIGS / 2].p.MGs[1].cc = skGen();
+  ASSERT_FALSE(verRctNonSemanticsSimple(sp));
+  ASSERT_FALSE(verRctNonSemanticsSimple(s[N_SIGS / 2]));
+  ASSERT_TRUE(verRctNonSemanticsSimple(s[0]));
+}
+
+TEST(ringct, non_semantics_from_threadpool)
+{
+  // txes verified from inside pool tasks fan their inputs out as nested leaves
+  static const size_t N_SIGS = 4;
+  static const uint64_t inputs[] = {1000, 1000, 1000, 1000};
+  static const uint64_t outputs[] = {2000, 2000};
+  std::vector<rctSig> s(N_SIGS);
+  for (size_t n = 0; n < N_SIGS; ++n)
+    s[n] = make_sample_simple_rct_sig(NELTS(inputs), inputs, NELTS(outputs), outputs, 0);
+  s[N_SIGS - 1].p.MGs[2].cc = skGen();
+
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  std::deque<bool> results(N_SIGS);
+  for (size_t n = 0; n < N_SIGS; ++n)
+    tpool.submit(&waiter, [&, n] { results[n] = verRctNonSemanticsSimple(s[n]); });
+  waiter.wait(&tpool);
+
+  for (size_t n = 0; n < N_SIGS - 1; ++n)
+    ASSERT_TRUE(results[n]);
+  ASSERT_FALSE(results[N_SIGS - 1]);
+}
@@ -127,6 +127,46 @@ TEST(ringdb, convert)
   ASSERT_EQ(outs2[2], 43+7320+8429);
 }
 
+TEST(ringdb, batch)
+{
+  RingDB ringdb;
+  std::vector<cryptonote::transaction_prefix> txs(2);
+  std::vector<crypto::key_image> key_images;
+  for (size_t n = 0; n < 4; ++n)
+  {
+    cryptonote::txin_to_key txin;
+    txin.k_image = generate_key_image();
+    txin.key_offsets = {5, n + 1, 9};
+    txs[n / 2].vin.push_back(txin);
+    key_images.push_back(txin.k_image);
+  }
+  ASSERT_TRUE(ringdb.add_rings(KEY_1, txs));
+  for (size_t n = 0; n < 4; ++n)
+  {
+    std::vector<uint64_t> outs;
+    ASSERT_TRUE(ringdb.get_ring(KEY_1, key_images[n], outs));
+    ASSERT_EQ(outs, std::vector<uint64_t>({5, 5 + n + 1, 5 + n + 1 + 9}));
+  }
+  ASSERT_TRUE(ringdb.remove_rings(KEY_1, txs[0]));
+  std::vector<uint64_t> outs;
+  ASSERT_FALSE(ringdb.get_ring(KEY_1, key_images[0], outs));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, key_images[2], outs));
+}
+
+TEST(ringdb, cached_ring_updated)
+{
+  RingDB ringdb;
+  std::vector<uint64_t> outs, outs2;
+  outs.push_back(43); outs.push_back(7320); outs.push_back(8429);
+  ASSERT_TRUE(ringdb.set_ring(KEY_1, KEY_IMAGE_1, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  outs[2] = 9000;
+  ASSERT_TRUE(ringdb.set_ring(KEY_1, KEY_IMAGE_1, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  ASSERT_EQ(outs, outs2);
+  ASSERT_FALSE(ringdb.get_ring(KEY_2, KEY_IMAGE_1, outs2));
+}
+
 TEST(ringdb, different_genesis)
 {
   RingDB ringdb;
@@ -174,6 +214,25 @@ TEST(spent_outputs, vector)
   ASSERT_TRUE(ringdb.blackballed(std::make_pair(30, 5)));
 }
 
+TEST(spent_outputs, unsorted_vector)
+{
+  RingDB ringdb;
+  ASSERT_TRUE(ringdb.blackball(std::make_pair(10, 9)));
+  std::vector<std::pair<uint64_t, uint64_t>> outputs;
+  outputs.push_back(std::make_pair(30, 5));
+  outputs.push_back(std::make_pair(10, 4));
+  outputs.push_back(std::make_pair(0, 1));
+  outputs.push_back(std::make_pair(10, 3));
+  outputs.push_back(std::make_pair(10, 4));
+  ASSERT_TRUE(ringdb.blackball(outputs));
+  ASSERT_TRUE(ringdb.blackballed(std::make_pair(0, 1)));
+  ASSERT_TRUE(ringdb.blackballed(std::make_pair(10, 3)));
+  ASSERT_TRUE(ringdb.blackballed(std::make_pair(10, 4)));
+  ASSERT_TRUE(ringdb.blackballed(std::make_pair(10, 9)));
+  ASSERT_TRUE(ringdb.blackballed(std::make_pair(30, 5)));
+  ASSERT_FALSE(ringdb.blackballed(std::make_pair(10, 5)));
+}
+
 TEST(spent_outputs, mark_as_unspent)
 {
   RingDB ringdb;
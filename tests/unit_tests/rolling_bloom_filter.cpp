@@ -0,0 +1,89 @@
+// Copyright (c) 2014-2025, The Monero Project
+// Copyright (c)      2018-2024, The Oxen Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/rolling_bloom_filter.h"
+
+TEST(rolling_bloom_filter, empty)
+{
+  cryptonote::rolling_bloom_filter filter(100, 0.001);
+  for (int n = 0; n < 100; ++n)
+    ASSERT_FALSE(filter.contains(crypto::rand<crypto::hash>()));
+}
+
+TEST(rolling_bloom_filter, remembers_recent)
+{
+  cryptonote::rolling_bloom_filter filter(1000, 0.001);
+  std::vector<crypto::hash> hashes;
+  for (int n = 0; n < 2000; ++n)
+  {
+    hashes.push_back(crypto::rand<crypto::hash>());
+    filter.insert(hashes.back());
+  }
+  // the last half capacity are always there
+  for (size_t n = hashes.size() - 500; n < hashes.size(); ++n)
+    ASSERT_TRUE(filter.contains(hashes[n]));
+}
+
+TEST(rolling_bloom_filter, forgets_old)
+{
+  cryptonote::rolling_bloom_filter filter(1000, 0.001);
+  std::vector<crypto::hash> hashes;
+  for (int n = 0; n < 5000; ++n)
+  {
+    hashes.push_back(crypto::rand<crypto::hash>());
+    filter.insert(hashes.back());
+  }
+  size_t found = 0;
+  for (size_t n = 0; n < 1000; ++n)
+    found += filter.contains(hashes[n]);
+  ASSERT_LT(found, 10);
+}
+
+TEST(rolling_bloom_filter, false_positive_rate)
+{
+  cryptonote::rolling_bloom_filter filter(1000, 0.01);
+  for (int n = 0; n < 1000; ++n)
+    filter.insert(crypto::rand<crypto::hash>());
+  size_t found = 0;
+  for (int n = 0; n < 10000; ++n)
+    found += filter.contains(crypto::rand<crypto::hash>());
+  ASSERT_LT(found, 300);
+}
+
+TEST(rolling_bloom_filter, clear)
+{
+  cryptonote::rolling_bloom_filter filter(100, 0.001);
+  const crypto::hash h = crypto::rand<crypto::hash>();
+  filter.insert(h);
+  ASSERT_TRUE(filter.contains(h));
+  filter.clear();
+  ASSERT_FALSE(filter.contains(h));
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "misc_language.h"
+#include "common/rolling_median.h"
+
+TEST(rolling_median, empty)
+{
+  tools::rolling_median<uint64_t> m(10);
+  ASSERT_EQ(m.size(), 0);
+  ASSERT_EQ(m.median(), 0);
+}
+
+TEST(rolling_median, partial_window)
+{
+  tools::rolling_median<uint64_t> m(10);
+  m.insert(5);
+  ASSERT_EQ(m.median(), 5);
+  m.insert(1);
+  ASSERT_EQ(m.median(), 3);
+  m.insert(9);
+  ASSERT_EQ(m.median(), 5);
+  ASSERT_FALSE(m.full());
+}
+
+TEST(rolling_median, evicts_oldest)
+{
+  tools::rolling_median<uint64_t> m(3);
+  for (uint64_t v: {100, 1, 2, 3})
+    m.insert(v);
+  ASSERT_TRUE(m.full());
+  ASSERT_EQ(m.size(), 3);
+  ASSERT_EQ(m.median(), 2);
+}
+
+TEST(rolling_median, matches_sorted_median)
+{
+  for (size_t window: {1, 2, 7, 64})
+  {
+    tools::rolling_median<uint64_t> m(window);
+    std::vector<uint64_t> values;
+    uint64_t x = 42;
+    for (int i = 0; i < 1000; ++i)
+    {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+      // few distinct values so duplicates straddle the two halves
+      values.push_back((x >> 33) % 20);
+      m.insert(values.back());
+      const size_t n = std::min(window, values.size());
+      std::vector<uint64_t> last(values.end() - n, values.end());
+      ASSERT_EQ(m.median(), epee::misc_utils::median(last));
+    }
+  }
+}
+
+TEST(rolling_median, reset)
+{
+  tools::rolling_median<uint64_t> m(2);
+  m.insert(4);
+  m.insert(6);
+  m.reset(3);
+  ASSERT_EQ(m.size(), 0);
+  ASSERT_EQ(m.capacity(), 3);
+  m.insert(7);
+  ASSERT_EQ(m.median(), 7);
+}
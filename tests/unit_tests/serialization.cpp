@@ -158,6 +158,47 @@ TEST(Serialization, BinaryArchiveVarInts) {
   ASSERT_EQ(x, x1);
 }
 
+TEST(Serialization, BinaryArchiveSpan) {
+  const std::string blob("\x80\x80\x80\x80\xF0\x1F\xff\0\0\0", 10);
+  uint64_t x;
+  uint32_t y;
+
+  binary_archive<false> iar(epee::strspan<uint8_t>(blob));
+  ASSERT_EQ(10, iar.remaining_bytes());
+  iar.serialize_varint(x);
+  ASSERT_EQ(0xff00000000, x);
+  ASSERT_EQ(6, iar.stream().tellg());
+  iar.serialize_int(y);
+  ASSERT_EQ(0xff, y);
+  ASSERT_TRUE(iar.stream().good());
+  ASSERT_TRUE(::serialization::check_stream_state(iar));
+
+  const std::string short_blob = blob.substr(6, 3);
+  binary_archive<false> short_iar(epee::strspan<uint8_t>(short_blob));
+  short_iar.serialize_int(y);
+  ASSERT_FALSE(short_iar.stream().good());
+  ASSERT_EQ(0, short_iar.remaining_bytes());
+  ASSERT_FALSE(::serialization::check_stream_state(short_iar));
+}
+
+TEST(Serialization, BinaryArchiveBuffer) {
+  uint64_t x = 0xff00000000;
+  uint32_t y = 0xff;
+
+  string buf("prefix");
+  binary_archive<true> oar(buf);
+  oar.serialize_varint(x);
+  oar.serialize_int(y);
+  ASSERT_TRUE(oar.stream().good());
+  ASSERT_EQ(string("prefix\x80\x80\x80\x80\xF0\x1F\xff\0\0\0", 16), buf);
+  ASSERT_EQ(10, oar.bytes_written());
+
+  binary_archive<true> counter;
+  counter.serialize_varint(x);
+  counter.serialize_int(y);
+  ASSERT_EQ(10, counter.bytes_written());
+}
+
 TEST(Serialization, Test1) {
   ostringstream str;
   binary_archive<true> ar(str);
@@ -290,6 +331,28 @@ TEST(Serialization, serializes_vector_int64_as_fixed_int)
   ASSERT_EQ(57, blob.size());
 }
 
+TEST(Serialization, serializes_vector_keys_as_contiguous_blob)
+{
+  std::vector<crypto::public_key> v(3), w;
+  string blob;
+
+  for (size_t i = 0; i < v.size(); ++i)
+    memset(&v[i], i + 1, sizeof(v[i]));
+  ASSERT_TRUE(serialization::dump_binary(v, blob));
+  ASSERT_EQ(1 + 3 * sizeof(crypto::public_key), blob.size());
+  ASSERT_EQ(3, blob[0]);
+  ASSERT_EQ(0, memcmp(blob.data() + 1, v.data(), 3 * sizeof(crypto::public_key)));
+
+  ASSERT_TRUE(serialization::parse_binary(blob, w));
+  ASSERT_EQ(v, w);
+
+  // a count larger than what is left must not allocate or read past the end
+  blob.resize(blob.size() - 1);
+  ASSERT_FALSE(serialization::parse_binary(blob, w));
+  blob = "\xff\xff\xff\xff\x0f";
+  ASSERT_FALSE(serialization::parse_binary(blob, w));
+}
+
 namespace
 {
   template<typename T>
@@ -36,6 +36,7 @@
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "wallet/api/subaddress.h"
+#include "ringct/rctOps.h"
 
 class WalletSubaddress : public ::testing::Test 
 {
@@ -101,3 +102,43 @@ TEST_F(WalletSubaddress, OutOfBoundsIndexes)
     EXPECT_STREQ("index.minor is out of bound", e.what());  
   }   
 }
+
+TEST_F(WalletSubaddress, LookaheadIndexes)
+{
+  w1.set_subaddress_lookahead(2, 3000);
+  w1.add_subaddress(0, "lookahead");
+  for (uint32_t minor: {0u, 1u, 1500u, 2999u})
+  {
+    const cryptonote::subaddress_index index = {0, minor};
+    const auto found = w1.get_subaddress_index(w1.get_subaddress(index));
+    ASSERT_TRUE(!!found);
+    EXPECT_EQ(index, *found);
+  }
+}
+
+TEST(subaddress_table, insert_find)
+{
+  tools::subaddress_table table;
+  EXPECT_EQ(nullptr, table.find(crypto::null_pkey));
+
+  std::vector<crypto::public_key> keys;
+  for (size_t n = 0; n < 1000; ++n)
+    keys.push_back(rct::rct2pk(rct::pkGen()));
+  table.insert(keys, {3, 7});
+  EXPECT_EQ(keys.size(), table.size());
+  for (size_t n = 0; n < keys.size(); ++n)
+  {
+    const cryptonote::subaddress_index *index = table.find(keys[n]);
+    ASSERT_NE(nullptr, index);
+    EXPECT_EQ(cryptonote::subaddress_index({3, (uint32_t)(7 + n)}), *index);
+  }
+  EXPECT_EQ(nullptr, table.find(rct::rct2pk(rct::pkGen())));
+
+  table.insert(keys[0], {4, 0});
+  EXPECT_EQ(keys.size(), table.size());
+  EXPECT_EQ(cryptonote::subaddress_index({4, 0}), *table.find(keys[0]));
+
+  table.clear();
+  EXPECT_EQ(0, table.size());
+  EXPECT_EQ(nullptr, table.find(keys[0]));
+}
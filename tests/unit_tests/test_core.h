@@ -0,0 +1,98 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace cryptonote {
+  class blockchain_storage;
+}
+
+// A core that does next to nothing, for driving the protocol handler in tests
+class test_core
+{
+public:
+  void on_synchronized(){}
+  void safesyncmode(const bool){}
+  uint64_t get_current_blockchain_height() const {return 1;}
+  void set_target_blockchain_height(uint64_t) {}
+  bool init(const boost::program_options::variables_map& vm) {return true ;}
+  bool deinit(){return true;}
+  bool get_short_chain_history(std::list<crypto::hash>& ids) const { return true; }
+  bool get_stat_info(cryptonote::core_stat_info& st_inf) const {return true;}
+  bool have_block(const crypto::hash& id) const {return true;}
+  void get_blockchain_top(uint64_t& height, crypto::hash& top_id)const{height=0;top_id=crypto::null_hash;}
+  bool handle_incoming_tx(const cryptonote::blobdata& tx_blob, cryptonote::tx_verification_context& tvc, bool keeped_by_block, bool relayed, bool do_not_relay) { return true; }
+  bool handle_incoming_txs(const std::vector<cryptonote::blobdata>& tx_blob, std::vector<cryptonote::tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay) { return true; }
+  bool handle_incoming_block(const cryptonote::blobdata& block_blob, cryptonote::block_verification_context& bvc, bool update_miner_blocktemplate = true) { return true; }
+  bool handle_uptime_proof(const cryptonote::NOTIFY_UPTIME_PROOF::request &proof, bool from_sync = false, const boost::uuids::uuid &source = boost::uuids::nil_uuid()) { uptime_proofs.emplace_back(proof, from_sync); uptime_proof_sources.push_back(source); return true; }
+  std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> get_uptime_proofs() const { return {}; }
+  void pause_mine(){}
+  void resume_mine(){}
+  bool on_idle(){return true;}
+  bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp){return true;}
+  bool handle_get_objects(cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote::cryptonote_connection_context& context){return get_objects ? get_objects(arg, rsp) : true;}
+  cryptonote::blockchain_storage &get_blockchain_storage() { throw std::runtime_error("Called invalid member function: please never call get_blockchain_storage on the TESTING class test_core."); }
+  bool get_test_drop_download() const {return true;}
+  bool get_test_drop_download_height() const {return true;}
+  bool prepare_handle_incoming_blocks(const std::vector<cryptonote::block_complete_entry>  &blocks) { return true; }
+  void prefetch_incoming_blocks_longhash(const std::vector<cryptonote::block_complete_entry> &blocks, uint64_t start_height) {}
+  bool cleanup_handle_incoming_blocks(bool force_sync = false) { return true; }
+  uint64_t get_target_blockchain_height() const { return 1; }
+  size_t get_block_sync_size(uint64_t height) const { return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; }
+  virtual void on_transaction_relayed(const cryptonote::blobdata& tx) {}
+  cryptonote::network_type get_nettype() const { return cryptonote::MAINNET; }
+  bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx_blob) const { return false; }
+  bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes = true) const { return false; }
+  bool pool_has_tx(const crypto::hash &txid) const { return false; }
+  bool get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata, cryptonote::block>>& blocks, std::vector<cryptonote::blobdata>& txs) const { return false; }
+  bool get_transactions(const std::vector<crypto::hash>& txs_ids, std::vector<cryptonote::transaction>& txs, std::vector<crypto::hash>& missed_txs) const { return false; }
+  bool get_block_by_hash(const crypto::hash &h, cryptonote::block &blk, bool *orphan = NULL) const { return false; }
+  uint8_t get_ideal_hard_fork_version() const { return 0; }
+  uint8_t get_ideal_hard_fork_version(uint64_t height) const { return 0; }
+  uint8_t get_hard_fork_version(uint64_t height) const { return 0; }
+  uint64_t get_earliest_ideal_height_for_version(uint8_t version) const { return 0; }
+  cryptonote::difficulty_type get_block_cumulative_difficulty(uint64_t height) const { return 0; }
+  bool fluffy_blocks_enabled() const { return false; }
+  uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes) { return 0; }
+  bool pad_transactions() { return false; }
+  uint32_t get_blockchain_pruning_seed() const { return 0; }
+  bool prune_blockchain(uint32_t pruning_seed = 0) { return true; }
+  void stop() {}
+
+  // TODO(antd): Write tests
+  bool add_deregister_vote(const full_nodes::deregister_vote& vote, cryptonote::vote_verification_context &vvc) { return true; }
+
+  std::function<bool(cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request&, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request&)> get_objects;
+  std::vector<std::pair<cryptonote::NOTIFY_UPTIME_PROOF::request, bool>> uptime_proofs; // handed to handle_uptime_proof, and whether from a sync
+  std::vector<boost::uuids::uuid> uptime_proof_sources;
+};
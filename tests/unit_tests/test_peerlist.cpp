@@ -28,6 +28,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <boost/filesystem.hpp>
 #include "gtest/gtest.h"
 
 #include "common/util.h"
@@ -83,3 +84,81 @@ TEST(peer_list, merge_peer_lists)
 
 
 }
+
+TEST(peer_list, random_gray_peer_by_subnet)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(false);
+  nodetool::peerlist_entry pe;
+  ASSERT_FALSE(plm.get_random_gray_peer(pe));
+
+  // a crowd in one /16 and a single peer elsewhere
+  for (int i = 1; i <= 100; ++i)
+    ADD_GRAY_NODE(MAKE_IPV4_ADDRESS(123,43,12,i, 8080), i, i);
+  ADD_GRAY_NODE(MAKE_IPV4_ADDRESS(98,7,6,5, 8080), 1000, 1000);
+  ASSERT_EQ(plm.get_gray_peers_count(), 101);
+
+  size_t lone = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    ASSERT_TRUE(plm.get_random_gray_peer(pe));
+    if (pe.id == 1000)
+      ++lone;
+  }
+  ASSERT_GT(lone, 300);
+  ASSERT_LT(lone, 700);
+
+  nodetool::peerlist_entry removed;
+  removed.adr = MAKE_IPV4_ADDRESS(98,7,6,5, 8080);
+  plm.remove_from_peer_gray(removed);
+  for (int i = 0; i < 100; ++i)
+  {
+    ASSERT_TRUE(plm.get_random_gray_peer(pe));
+    ASSERT_NE(pe.id, 1000);
+  }
+}
+
+TEST(peer_list, store_and_load)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  const std::string filename = path.string();
+
+  nodetool::peerlist_manager plm;
+  plm.init(false);
+  ADD_WHITE_NODE(MAKE_IPV4_ADDRESS(123,43,12,1, 8080), 1, 100);
+  ADD_GRAY_NODE(MAKE_IPV4_ADDRESS(123,43,12,2, 8080), 2, 200);
+  ADD_GRAY_NODE(epee::net_utils::ipv6_network_address("2001:db8::1", 8080), 3, 300);
+  ASSERT_TRUE(plm.store(filename));
+  const uint64_t snapshot_size = boost::filesystem::file_size(path);
+
+  // later changes are appended
+  ADD_WHITE_NODE(MAKE_IPV4_ADDRESS(123,43,12,2, 8080), 2, 400);
+  ADD_GRAY_NODE(MAKE_IPV4_ADDRESS(123,43,12,4, 8080), 4, 500);
+  ASSERT_TRUE(plm.store(filename));
+  ASSERT_GT(boost::filesystem::file_size(path), snapshot_size);
+
+  nodetool::peerlist_manager loaded;
+  loaded.init(false);
+  ASSERT_TRUE(loaded.load(filename));
+  std::vector<nodetool::peerlist_entry> gray, white;
+  ASSERT_TRUE(loaded.get_peerlist_full(gray, white));
+  ASSERT_EQ(white.size(), 2);
+  ASSERT_EQ(gray.size(), 2);
+  ASSERT_EQ(white[0].id, 2);
+  ASSERT_EQ(white[0].last_seen, 400);
+  ASSERT_EQ(white[1].id, 1);
+  ASSERT_EQ(gray[0].id, 4);
+  ASSERT_EQ(gray[1].id, 3);
+  ASSERT_EQ(gray[1].adr.str(), epee::net_utils::ipv6_network_address("2001:db8::1", 8080).str());
+
+  // a cut short append loses only the record it was writing
+  boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 3);
+  nodetool::peerlist_manager truncated;
+  truncated.init(false);
+  ASSERT_TRUE(truncated.load(filename));
+  ASSERT_EQ(truncated.get_white_peers_count(), 2);
+  ASSERT_EQ(truncated.get_gray_peers_count(), 1);
+
+  ASSERT_FALSE(loaded.load(filename + ".missing"));
+  boost::filesystem::remove(path);
+}
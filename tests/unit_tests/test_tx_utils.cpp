@@ -287,3 +287,67 @@ TEST(sort_tx_extra, invalid_suffix_partial)
   std::vector<uint8_t> expected(&expected_arr[0], &expected_arr[0] + sizeof(expected_arr));
   ASSERT_EQ(sorted, expected);
 }
+
+TEST(article_from_tx_extra, nonce)
+{
+  const std::string title = "title", content = "some content", publisher = "me";
+  std::string nonce = "ARTC";
+  nonce += (char)title.size();
+  nonce += title;
+  nonce += (char)(content.size() >> 8);
+  nonce += (char)(content.size() & 0xff);
+  nonce += content;
+  nonce += (char)publisher.size();
+  nonce += publisher;
+
+  std::vector<uint8_t> extra;
+  ASSERT_TRUE(cryptonote::add_extra_nonce_to_tx_extra(extra, nonce));
+  cryptonote::tx_extra_article_info article;
+  ASSERT_TRUE(cryptonote::get_article_from_tx_extra(extra, article));
+  ASSERT_EQ(title, article.title);
+  ASSERT_EQ(content, article.content);
+  ASSERT_EQ(publisher, article.publisher);
+
+  // truncated publisher
+  nonce.resize(nonce.size() - 1);
+  extra.clear();
+  ASSERT_TRUE(cryptonote::add_extra_nonce_to_tx_extra(extra, nonce));
+  ASSERT_FALSE(cryptonote::get_article_from_tx_extra(extra, article));
+}
+
+TEST(parse_block_header_view_from_blob, matches_full_parse)
+{
+  cryptonote::account_base acc;
+  acc.generate();
+  cryptonote::block b;
+  b.major_version = 10;
+  b.minor_version = 10;
+  b.timestamp = 1556000000;
+  b.nonce = 12345;
+  b.prev_id = crypto::cn_fast_hash("prev", 4);
+  ASSERT_TRUE(cryptonote::construct_miner_tx(100, 0, 10000000000000, 1000, TEST_FEE, acc.get_keys().m_account_address, b.miner_tx));
+  for (size_t i = 0; i < 3; ++i)
+    b.tx_hashes.push_back(crypto::cn_fast_hash(&i, sizeof(i)));
+  const cryptonote::blobdata blob = cryptonote::block_to_blob(b);
+
+  cryptonote::block_header_view v;
+  ASSERT_TRUE(cryptonote::parse_block_header_view_from_blob(epee::strspan<uint8_t>(blob), v, true));
+  ASSERT_EQ(b.major_version, v.major_version);
+  ASSERT_EQ(b.minor_version, v.minor_version);
+  ASSERT_EQ(b.timestamp, v.timestamp);
+  ASSERT_EQ(b.nonce, v.nonce);
+  ASSERT_EQ(b.prev_id, v.prev_id);
+  ASSERT_EQ(3u, v.tx_count);
+  ASSERT_EQ(cryptonote::get_transaction_hash(b.miner_tx), cryptonote::get_transaction_hash(v.miner_tx));
+
+  cryptonote::block_header_view h;
+  ASSERT_TRUE(cryptonote::parse_block_header_view_from_blob(epee::strspan<uint8_t>(blob), h, false));
+  ASSERT_EQ(b.timestamp, h.timestamp);
+  ASSERT_EQ(0u, h.tx_count);
+  ASSERT_TRUE(h.miner_tx.vout.empty());
+
+  // a cut short tx hash list is caught even though it is not read
+  const cryptonote::blobdata truncated = blob.substr(0, blob.size() - 1);
+  ASSERT_FALSE(cryptonote::parse_block_header_view_from_blob(epee::strspan<uint8_t>(truncated), v, true));
+  ASSERT_TRUE(cryptonote::parse_block_header_view_from_blob(epee::strspan<uint8_t>(truncated), h, false));
+}
@@ -144,3 +144,76 @@ TEST(threadpool, leaf_reentrancy)
   waiter.wait(tpool.get());
   ASSERT_EQ(counter, 500000);
 }
+
+TEST(threadpool, parallel_for)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+
+  std::vector<int> v(10000, 0);
+  tpool->parallel_for(v.size(), [&v](size_t n){ v[n] = n * 2; });
+  for (size_t n = 0; n < v.size(); ++n)
+    ASSERT_EQ(v[n], n * 2);
+
+  std::atomic<unsigned int> counter(0);
+  tpool->parallel_for(1, [&counter](size_t n){ ++counter; });
+  tpool->parallel_for(0, [&counter](size_t n){ ++counter; });
+  ASSERT_EQ(counter, 1);
+}
+
+TEST(threadpool, submit_range)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  tools::threadpool::waiter waiter;
+
+  std::vector<std::atomic<unsigned int>> seen(1001);
+  for (auto &s: seen)
+    s = 0;
+  std::atomic<unsigned int> chunks(0);
+  tpool->submit_range(&waiter, seen.size(), 100, [&](size_t begin, size_t end){
+    ASSERT_LT(begin, end);
+    ++chunks;
+    for (size_t n = begin; n < end; ++n)
+      ++seen[n];
+  });
+  waiter.wait(tpool.get());
+  for (const auto &s: seen)
+    ASSERT_EQ(s, 1);
+  ASSERT_LE(chunks, 11);
+}
+
+TEST(threadpool, nested_parallel_for)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+
+  std::atomic<unsigned int> counter(0);
+  tpool->parallel_for(64, [&](size_t){
+    tpool->parallel_for(64, [&](size_t){
+      tpool->parallel_for(16, [&](size_t){ ++counter; }, true);
+    });
+  });
+  ASSERT_EQ(counter, 64 * 64 * 16);
+}
+
+TEST(threadpool, one_thread_runs_jobs_nobody_waits_on)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(1));
+  ASSERT_EQ(tpool->get_max_concurrency(), 1);
+
+  // submitted from a thread that never waits, as the p2p thread does
+  std::atomic<unsigned int> counter(0);
+  boost::thread submitter([&tpool, &counter]() {
+    for (size_t n = 0; n < 16; ++n)
+      tpool->submit(NULL, [&counter](){ ++counter; });
+  });
+  submitter.join();
+  for (size_t n = 0; n < 500 && counter < 16; ++n)
+    epee::misc_utils::sleep_no_w(10);
+  ASSERT_EQ(counter, 16);
+
+  // and jobs for a waiter on another thread, which only waits without helping
+  tools::threadpool::waiter waiter;
+  boost::thread other([&tpool, &waiter, &counter]() { tpool->submit(&waiter, [&counter](){ ++counter; }); });
+  other.join();
+  waiter.wait(NULL);
+  ASSERT_EQ(counter, 17);
+}
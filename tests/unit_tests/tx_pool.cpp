@@ -0,0 +1,481 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_utilities/blockchain_objects.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+class PoolDB: public cryptonote::BaseTestDB
+{
+public:
+  PoolDB(): blob_reads(0), meta_reads(0), meta_writes(0) { m_open = true; }
+
+  virtual uint64_t height() const override { return 1; }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return top_block_hash(); }
+  virtual crypto::hash top_block_hash() const override
+  {
+    crypto::hash top = crypto::null_hash;
+    top.data[0] = 1;
+    return top;
+  }
+
+  virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const cryptonote::txpool_tx_meta_t& meta) override { txpool[txid] = std::make_pair(blob, meta); }
+  virtual void update_txpool_tx(const crypto::hash &txid, const cryptonote::txpool_tx_meta_t& meta) override { ++meta_writes; txpool.at(txid).second = meta; }
+  virtual void remove_txpool_tx(const crypto::hash& txid) override { txpool.erase(txid); }
+  virtual bool txpool_has_tx(const crypto::hash &txid) const override { return txpool.count(txid); }
+  virtual uint64_t get_txpool_tx_count(bool include_unrelayed_txes) const override
+  {
+    uint64_t count = 0;
+    for (const auto &e: txpool)
+      count += include_unrelayed_txes || !e.second.second.do_not_relay;
+    return count;
+  }
+  virtual bool get_txpool_tx_meta(const crypto::hash& txid, cryptonote::txpool_tx_meta_t &meta) const override
+  {
+    auto it = txpool.find(txid);
+    if (it == txpool.end())
+      return false;
+    ++meta_reads;
+    meta = it->second.second;
+    return true;
+  }
+  virtual bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd) const override
+  {
+    auto it = txpool.find(txid);
+    if (it == txpool.end())
+      return false;
+    ++blob_reads;
+    bd = it->second.first;
+    return true;
+  }
+  virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid) const override
+  {
+    cryptonote::blobdata bd;
+    get_txpool_tx_blob(txid, bd);
+    return bd;
+  }
+  virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const cryptonote::txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, bool include_unrelayed_txes) const override
+  {
+    for (const auto &e: txpool)
+    {
+      if (!include_unrelayed_txes && e.second.second.do_not_relay)
+        continue;
+      if (include_blob)
+        ++blob_reads;
+      if (!f(e.first, e.second.second, include_blob ? &e.second.first : NULL))
+        return false;
+    }
+    return true;
+  }
+
+  std::unordered_map<crypto::hash, std::pair<cryptonote::blobdata, cryptonote::txpool_tx_meta_t>> txpool;
+  mutable size_t blob_reads;
+  mutable size_t meta_reads;
+  size_t meta_writes;
+};
+
+// a tx spending one made up key image, which is all the pool looks at
+cryptonote::transaction make_tx(uint64_t seed)
+{
+  cryptonote::transaction tx;
+  tx.version = cryptonote::transaction::version_2;
+  cryptonote::txin_to_key in;
+  in.amount = 0;
+  in.key_offsets.push_back(seed + 1);
+  in.k_image = rct::rct2ki(rct::scalarmultBase(rct::d2h(seed + 1)));
+  tx.vin.push_back(in);
+  cryptonote::tx_out out;
+  out.amount = 0;
+  out.target = cryptonote::txout_to_key(rct::rct2pk(rct::scalarmultBase(rct::d2h(seed + 1000))));
+  tx.vout.push_back(out);
+  tx.rct_signatures.type = rct::RCTTypeNull;
+  return tx;
+}
+
+struct pool_test
+{
+  blockchain_objects_t bc_objects;
+  const std::vector<std::pair<uint8_t, uint64_t>> hard_forks{{(uint8_t)7, (uint64_t)0}, {(uint8_t)0, (uint64_t)0}};
+  const cryptonote::test_options test_options{hard_forks};
+  PoolDB *db;
+
+  pool_test(): db(new PoolDB())
+  {
+    EXPECT_TRUE(bc().init(db, cryptonote::FAKECHAIN, true, &test_options, 0));
+  }
+  cryptonote::Blockchain &bc() { return bc_objects.m_blockchain; }
+  cryptonote::tx_memory_pool &pool() { return bc_objects.m_mempool; }
+
+  // writes a tx to the db's pool tables, as a previous run would have
+  crypto::hash add_to_db(uint64_t seed, uint64_t fee, bool do_not_relay = false, uint64_t weight = 0)
+  {
+    const cryptonote::transaction tx = make_tx(seed);
+    const cryptonote::blobdata blob = cryptonote::tx_to_blob(tx);
+    cryptonote::txpool_tx_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.weight = weight ? weight : blob.size();
+    meta.fee = fee;
+    meta.receive_time = seed;
+    meta.do_not_relay = do_not_relay;
+    const crypto::hash txid = cryptonote::get_transaction_hash(tx);
+    db->add_txpool_tx(txid, blob, meta);
+    return txid;
+  }
+
+  // what admission leaves in the input check cache for a tx
+  void set_inputs_checked(const crypto::hash &txid, bool valid)
+  {
+    cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+    pool().m_input_cache[txid] = std::make_tuple(valid, tvc, (uint64_t)0, db->top_block_hash());
+  }
+
+  std::vector<crypto::hash> fill_template(size_t median_weight, uint64_t &fee)
+  {
+    cryptonote::block b;
+    size_t weight;
+    uint64_t expected_reward;
+    EXPECT_TRUE(pool().fill_block_template(b, median_weight, 1000000000, weight, fee, expected_reward, 7, 1));
+    EXPECT_LE(weight, 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE);
+    return b.tx_hashes;
+  }
+};
+
+std::vector<crypto::hash> sorted(std::vector<crypto::hash> hashes)
+{
+  std::sort(hashes.begin(), hashes.end(), [](const crypto::hash &a, const crypto::hash &b) { return memcmp(&a, &b, sizeof(a)) < 0; });
+  return hashes;
+}
+
+}
+
+TEST(tx_pool, hash_index_is_rebuilt_from_the_db)
+{
+  pool_test t;
+  std::vector<crypto::hash> all, relayable;
+  for (uint64_t i = 0; i < 40; ++i)
+  {
+    const bool do_not_relay = i % 4 == 0;
+    all.push_back(t.add_to_db(i, 1000 + i, do_not_relay));
+    if (!do_not_relay)
+      relayable.push_back(all.back());
+  }
+  ASSERT_TRUE(t.pool().init());
+
+  for (const crypto::hash &txid: all)
+    ASSERT_TRUE(t.pool().have_tx(txid));
+  ASSERT_FALSE(t.pool().have_tx(crypto::null_hash));
+
+  std::vector<crypto::hash> hashes;
+  t.pool().get_transaction_hashes(hashes, true);
+  ASSERT_EQ(sorted(hashes), sorted(all));
+  hashes.clear();
+  t.pool().get_transaction_hashes(hashes, false);
+  ASSERT_EQ(sorted(hashes), sorted(relayable));
+
+  // the index does not go back to the db once built
+  t.db->txpool.clear();
+  for (const crypto::hash &txid: all)
+    ASSERT_TRUE(t.pool().have_tx(txid));
+  ASSERT_TRUE(t.pool().init());
+  for (const crypto::hash &txid: all)
+    ASSERT_FALSE(t.pool().have_tx(txid));
+}
+
+TEST(tx_pool, hash_index_follows_removals)
+{
+  pool_test t;
+  std::vector<crypto::hash> all;
+  for (uint64_t i = 0; i < 20; ++i)
+    all.push_back(t.add_to_db(i, 1000 + i));
+  ASSERT_TRUE(t.pool().init());
+
+  cryptonote::transaction tx;
+  size_t weight;
+  uint64_t fee;
+  bool relayed, do_not_relay, double_spend_seen;
+  ASSERT_TRUE(t.pool().take_tx(all[3], tx, weight, fee, relayed, do_not_relay, double_spend_seen));
+  ASSERT_EQ(cryptonote::get_transaction_hash(tx), all[3]);
+  ASSERT_EQ(fee, 1003);
+  ASSERT_FALSE(t.pool().have_tx(all[3]));
+  ASSERT_FALSE(t.db->txpool_has_tx(all[3]));
+  ASSERT_FALSE(t.pool().take_tx(all[3], tx, weight, fee, relayed, do_not_relay, double_spend_seen));
+
+  std::vector<crypto::hash> hashes;
+  t.pool().get_transaction_hashes(hashes);
+  all.erase(all.begin() + 3);
+  ASSERT_EQ(sorted(hashes), sorted(all));
+
+  // every shard gets some of the txes
+  size_t used_shards = 0;
+  for (const auto &shard: t.pool().m_tx_index)
+    used_shards += !shard.txs.empty();
+  ASSERT_GT(used_shards, 1);
+}
+
+TEST(tx_pool, block_template_is_filled_from_memory)
+{
+  pool_test t;
+  std::vector<crypto::hash> by_fee;
+  for (uint64_t i = 0; i < 10; ++i)
+    by_fee.insert(by_fee.begin(), t.add_to_db(i, 1000000 * (i + 1)));
+  ASSERT_TRUE(t.pool().init());
+  for (const crypto::hash &txid: by_fee)
+    t.set_inputs_checked(txid, true);
+
+  uint64_t fee;
+  ASSERT_EQ(t.fill_template(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, fee), by_fee);
+  ASSERT_EQ(fee, 55000000);
+  ASSERT_EQ(t.db->meta_reads, 0);
+
+  // the checked inputs were written back, so the next template is served
+  // without the db
+  t.db->blob_reads = t.db->meta_writes = 0;
+  ASSERT_EQ(t.fill_template(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, fee), by_fee);
+  ASSERT_EQ(t.db->blob_reads, 0);
+  ASSERT_EQ(t.db->meta_reads, 0);
+  ASSERT_EQ(t.db->meta_writes, 0);
+}
+
+TEST(tx_pool, block_template_writes_failures_back)
+{
+  pool_test t;
+  const crypto::hash good = t.add_to_db(0, 1000000);
+  const crypto::hash bad = t.add_to_db(1, 2000000);
+  ASSERT_TRUE(t.pool().init());
+  t.set_inputs_checked(good, true);
+  t.set_inputs_checked(bad, false);
+
+  uint64_t fee;
+  ASSERT_EQ(t.fill_template(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, fee), std::vector<crypto::hash>{good});
+  ASSERT_EQ(fee, 1000000);
+
+  // both the db and the in-memory copy remember the failure
+  ASSERT_EQ(t.db->txpool.at(bad).second.last_failed_id, t.db->top_block_hash());
+  ASSERT_EQ(t.pool().m_tx_template_entries.at(bad).meta.last_failed_id, t.db->top_block_hash());
+  ASSERT_EQ(t.db->txpool.at(good).second.max_used_block_id, t.db->top_block_hash());
+  ASSERT_EQ(t.pool().m_tx_template_entries.at(good).meta.max_used_block_id, t.db->top_block_hash());
+}
+
+TEST(tx_pool, block_template_stops_when_full)
+{
+  pool_test t;
+  std::vector<crypto::hash> by_fee;
+  for (uint64_t i = 0; i < 10; ++i)
+    by_fee.insert(by_fee.begin(), t.add_to_db(i, 1000000 * (i + 1), false, 1000));
+  ASSERT_TRUE(t.pool().init());
+  for (const crypto::hash &txid: by_fee)
+    t.set_inputs_checked(txid, true);
+
+  // room for four 1000 byte txes, the best paying ones
+  uint64_t fee;
+  ASSERT_EQ(t.fill_template(2300, fee), std::vector<crypto::hash>(by_fee.begin(), by_fee.begin() + 4));
+  ASSERT_EQ(fee, (10 + 9 + 8 + 7) * 1000000);
+}
+
+TEST(tx_pool, parsed_tx_cache_is_bounded)
+{
+  pool_test t;
+  // each tx takes a quarter of the cache
+  std::vector<crypto::hash> txids;
+  for (uint64_t i = 0; i < 6; ++i)
+    txids.push_back(t.add_to_db(i, 1000000, false, TXPOOL_TX_CACHE_MAX_BYTES / 4));
+  ASSERT_TRUE(t.pool().init());
+  ASSERT_TRUE(t.pool().m_parsed_tx_lru.empty());
+
+  t.db->blob_reads = 0;
+  for (const crypto::hash &txid: txids)
+    ASSERT_EQ(cryptonote::get_transaction_hash(t.pool().get_parsed_tx(txid, t.pool().m_tx_template_entries.at(txid))), txid);
+  ASSERT_EQ(t.db->blob_reads, 6);
+  ASSERT_EQ(t.pool().m_parsed_tx_lru.size(), 4);
+  ASSERT_EQ(t.pool().m_parsed_tx_bytes, TXPOOL_TX_CACHE_MAX_BYTES);
+  ASSERT_FALSE(t.pool().m_tx_template_entries.at(txids[0]).tx);
+  ASSERT_FALSE(t.pool().m_tx_template_entries.at(txids[1]).tx);
+
+  // a hit moves the tx to the front, so the next miss evicts another one
+  t.pool().get_parsed_tx(txids[2], t.pool().m_tx_template_entries.at(txids[2]));
+  ASSERT_EQ(t.db->blob_reads, 6);
+  t.pool().get_parsed_tx(txids[0], t.pool().m_tx_template_entries.at(txids[0]));
+  ASSERT_EQ(t.db->blob_reads, 7);
+  ASSERT_TRUE(t.pool().m_tx_template_entries.at(txids[2]).tx);
+  ASSERT_FALSE(t.pool().m_tx_template_entries.at(txids[3]).tx);
+  ASSERT_EQ(t.pool().m_parsed_tx_lru.size(), 4);
+}
+
+TEST(tx_pool, parsed_txes_outlive_blocks_and_serve_take_tx)
+{
+  pool_test t;
+  std::vector<crypto::hash> txids;
+  for (uint64_t i = 0; i < 3; ++i)
+    txids.push_back(t.add_to_db(i, 1000000 * (i + 1)));
+  ASSERT_TRUE(t.pool().init());
+  for (const crypto::hash &txid: txids)
+    t.set_inputs_checked(txid, true);
+
+  uint64_t fee;
+  ASSERT_EQ(t.fill_template(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, fee).size(), 3);
+  ASSERT_EQ(t.pool().m_parsed_tx_lru.size(), 3);
+
+  t.pool().on_blockchain_inc(2, crypto::null_hash);
+  ASSERT_EQ(t.pool().m_parsed_tx_lru.size(), 3);
+
+  // a block made of pool txes takes them without fetching or parsing a blob
+  t.db->blob_reads = 0;
+  cryptonote::transaction tx;
+  size_t weight;
+  bool relayed, do_not_relay, double_spend_seen;
+  ASSERT_TRUE(t.pool().take_tx(txids[1], tx, weight, fee, relayed, do_not_relay, double_spend_seen));
+  ASSERT_EQ(cryptonote::get_transaction_hash(tx), txids[1]);
+  ASSERT_EQ(t.db->blob_reads, 0);
+
+  // and the parsed tx goes with its pool entry
+  ASSERT_EQ(t.pool().m_parsed_tx_lru.size(), 2);
+  ASSERT_EQ(t.pool().m_parsed_tx_bytes, t.db->txpool.at(txids[0]).second.weight + t.db->txpool.at(txids[2]).second.weight);
+}
+
+TEST(tx_pool, index_snapshot_round_trip)
+{
+  pool_test t;
+  const std::string snapshot = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  std::vector<crypto::hash> txids;
+  for (uint64_t i = 0; i < 8; ++i)
+    txids.push_back(t.add_to_db(i, 1000000 * (i + 1)));
+  ASSERT_TRUE(t.pool().init(0, snapshot));
+  const uint64_t weight = t.pool().get_txpool_weight();
+  ASSERT_TRUE(t.pool().deinit());
+  ASSERT_TRUE(boost::filesystem::exists(snapshot));
+
+  // restarting reads the key images from the snapshot, not from the blobs
+  t.db->blob_reads = 0;
+  ASSERT_TRUE(t.pool().init(0, snapshot));
+  ASSERT_EQ(t.db->blob_reads, 0);
+  ASSERT_FALSE(boost::filesystem::exists(snapshot));
+  ASSERT_EQ(t.pool().get_txpool_weight(), weight);
+  ASSERT_EQ(t.pool().m_txs_by_fee_and_receive_time.size(), txids.size());
+  for (uint64_t i = 0; i < txids.size(); ++i)
+  {
+    ASSERT_TRUE(t.pool().have_tx(txids[i]));
+    ASSERT_TRUE(t.pool().have_tx_keyimg_as_spent(boost::get<cryptonote::txin_to_key>(make_tx(i).vin[0]).k_image));
+  }
+
+  // and the txes are parsed when first needed
+  for (const crypto::hash &txid: txids)
+    t.set_inputs_checked(txid, true);
+  uint64_t fee;
+  std::vector<crypto::hash> by_fee(txids.rbegin(), txids.rend());
+  ASSERT_EQ(t.fill_template(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, fee), by_fee);
+  ASSERT_EQ(t.db->blob_reads, txids.size());
+}
+
+TEST(tx_pool, stale_index_snapshot_is_ignored)
+{
+  pool_test t;
+  const std::string snapshot = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  for (uint64_t i = 0; i < 4; ++i)
+    t.add_to_db(i, 1000000);
+  ASSERT_TRUE(t.pool().init(0, snapshot));
+  ASSERT_TRUE(t.pool().deinit());
+
+  // a tx the snapshot does not know about: everything is parsed again
+  const crypto::hash extra = t.add_to_db(4, 1000000);
+  t.db->blob_reads = 0;
+  ASSERT_TRUE(t.pool().init(0, snapshot));
+  ASSERT_EQ(t.db->blob_reads, 5);
+  ASSERT_FALSE(boost::filesystem::exists(snapshot));
+  ASSERT_TRUE(t.pool().have_tx(extra));
+  ASSERT_EQ(t.pool().m_txs_by_fee_and_receive_time.size(), 5);
+  for (uint64_t i = 0; i < 5; ++i)
+    ASSERT_TRUE(t.pool().have_tx_keyimg_as_spent(boost::get<cryptonote::txin_to_key>(make_tx(i).vin[0]).k_image));
+
+  // a tx gone from the pool since: same
+  ASSERT_TRUE(t.pool().deinit());
+  t.db->remove_txpool_tx(extra);
+  t.db->blob_reads = 0;
+  ASSERT_TRUE(t.pool().init(0, snapshot));
+  ASSERT_EQ(t.db->blob_reads, 4);
+  ASSERT_FALSE(t.pool().have_tx(extra));
+  ASSERT_FALSE(t.pool().have_tx_keyimg_as_spent(boost::get<cryptonote::txin_to_key>(make_tx(4).vin[0]).k_image));
+
+  // and so does a truncated file
+  ASSERT_TRUE(t.pool().deinit());
+  boost::filesystem::resize_file(snapshot, boost::filesystem::file_size(snapshot) - 1);
+  t.db->blob_reads = 0;
+  ASSERT_TRUE(t.pool().init(0, snapshot));
+  ASSERT_EQ(t.db->blob_reads, 4);
+  ASSERT_EQ(t.pool().m_txs_by_fee_and_receive_time.size(), 4);
+  ASSERT_TRUE(t.pool().deinit());
+  boost::filesystem::remove(snapshot);
+}
+
+TEST(tx_pool, pool_info_is_rendered_in_pool_order)
+{
+  pool_test t;
+  for (uint64_t i = 0; i < 30; ++i)
+    t.add_to_db(i, 1000 + i);
+  ASSERT_TRUE(t.pool().init());
+
+  // a blob that does not parse is left out, without disturbing the others
+  crypto::hash bad = crypto::null_hash;
+  bad.data[0] = 0xff;
+  cryptonote::txpool_tx_meta_t meta;
+  memset(&meta, 0, sizeof(meta));
+  t.db->add_txpool_tx(bad, "not a tx", meta);
+
+  std::vector<std::string> expected;
+  t.db->for_all_txpool_txes([&expected, &bad](const crypto::hash &txid, const cryptonote::txpool_tx_meta_t&, const cryptonote::blobdata*) {
+    if (txid != bad)
+      expected.push_back(epee::string_tools::pod_to_hex(txid));
+    return true;
+  }, false, true);
+
+  std::vector<cryptonote::tx_info> tx_infos(1);
+  tx_infos[0].id_hash = "already there";
+  std::vector<cryptonote::spent_key_image_info> key_image_infos;
+  ASSERT_TRUE(t.pool().get_transactions_and_spent_keys_info(tx_infos, key_image_infos));
+  ASSERT_EQ(tx_infos.size(), expected.size() + 1);
+  ASSERT_EQ(tx_infos[0].id_hash, "already there");
+  for (size_t n = 0; n < expected.size(); ++n)
+  {
+    const cryptonote::tx_info &txi = tx_infos[n + 1];
+    ASSERT_EQ(txi.id_hash, expected[n]);
+    cryptonote::transaction tx;
+    ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(txi.tx_blob, tx));
+    ASSERT_EQ(txi.tx_json, cryptonote::obj_to_json_str(tx));
+    ASSERT_EQ(txi.blob_size, txi.tx_blob.size());
+  }
+}
@@ -0,0 +1,250 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/full_node_quorum_cop.h"
+#include "p2p/net_node.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.inl"
+#include "test_core.h"
+
+namespace
+{
+  const uint64_t NOW = 1500000000;
+
+  cryptonote::NOTIFY_UPTIME_PROOF::request make_proof(unsigned char key, uint64_t timestamp)
+  {
+    cryptonote::NOTIFY_UPTIME_PROOF::request proof = AUTO_VAL_INIT(proof);
+    memset(&proof.pubkey, key, sizeof(proof.pubkey));
+    memset(&proof.sig, key, sizeof(proof.sig)); // relays tell proofs apart by signature
+    proof.timestamp = timestamp;
+    return proof;
+  }
+
+  class proof_sync_p2p: public nodetool::p2p_endpoint_stub<cryptonote::cryptonote_connection_context>
+  {
+  public:
+    virtual bool relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, const std::list<boost::uuids::uuid>& connections) override
+    {
+      if (command == cryptonote::NOTIFY_REQUEST_UPTIME_PROOFS::ID)
+        asked.insert(asked.end(), connections.begin(), connections.end());
+      else if (command == cryptonote::NOTIFY_UPTIME_PROOFS::ID || command == cryptonote::NOTIFY_UPTIME_PROOF::ID)
+        relayed.insert(relayed.end(), connections.begin(), connections.end());
+      return true;
+    }
+    virtual void for_each_connection(std::function<bool(cryptonote::cryptonote_connection_context&, nodetool::peerid_type, uint32_t)> f) override
+    {
+      for (auto &context: contexts)
+        if (!f(context, 1, P2P_SUPPORT_FLAGS))
+          break;
+    }
+
+    std::vector<cryptonote::cryptonote_connection_context> contexts;
+    std::list<boost::uuids::uuid> asked;
+    std::list<boost::uuids::uuid> relayed;
+  };
+
+  class uptime_proof_sync: public ::testing::Test
+  {
+  protected:
+    uptime_proof_sync(): protocol(core, &p2p)
+    {
+      for (size_t n = 0; n < 4; ++n)
+      {
+        cryptonote::cryptonote_connection_context context;
+        context.m_connection_id = boost::uuids::random_generator()();
+        p2p.contexts.push_back(context);
+      }
+      // the test core has every block, so the first handshake leaves us synced
+      cryptonote::CORE_SYNC_DATA hshd = AUTO_VAL_INIT(hshd);
+      for (auto &context: p2p.contexts)
+        protocol.process_payload_sync_data(hshd, context, true);
+    }
+
+    void answer(cryptonote::cryptonote_connection_context &context)
+    {
+      cryptonote::NOTIFY_UPTIME_PROOFS::request req = AUTO_VAL_INIT(req);
+      req.sync = true;
+      req.proofs.push_back(make_proof(1, NOW));
+      std::string blob;
+      ASSERT_TRUE(epee::serialization::store_t_to_binary(req, blob));
+      std::string out;
+      bool handled = false;
+      protocol.handle_invoke_map(true, cryptonote::NOTIFY_UPTIME_PROOFS::ID, epee::strspan<uint8_t>(blob), out, context, handled);
+      ASSERT_TRUE(handled);
+    }
+
+    // the relay calls are only public through the interface the core uses
+    cryptonote::i_cryptonote_protocol &relay() { return protocol; }
+
+    test_core core;
+    proof_sync_p2p p2p;
+    cryptonote::t_cryptonote_protocol_handler<test_core> protocol;
+  };
+}
+
+TEST(uptime_proof_store, orders_by_signing_time)
+{
+  full_nodes::uptime_proof_store store;
+  const auto proof = make_proof(1, NOW - 600);
+  ASSERT_TRUE(store.wants(proof.pubkey, proof.timestamp, true, NOW));
+  ASSERT_FALSE(store.add(proof, true, NOW)); // synced proofs are never relayed
+  ASSERT_EQ(NOW - 600, store.last_proof_time(proof.pubkey));
+
+  // the same proof, or an older one, is not wanted whichever way it comes
+  ASSERT_FALSE(store.wants(proof.pubkey, NOW - 600, true, NOW));
+  ASSERT_FALSE(store.wants(proof.pubkey, NOW - 900, true, NOW));
+  ASSERT_FALSE(store.wants(proof.pubkey, NOW - 900, false, NOW));
+
+  // receiving a synced proof late does not make it any younger
+  ASSERT_FALSE(store.add(make_proof(1, NOW - 900), true, NOW + 3000));
+  ASSERT_EQ(NOW - 600, store.last_proof_time(proof.pubkey));
+}
+
+TEST(uptime_proof_store, relays_live_proofs_once_per_half_interval)
+{
+  full_nodes::uptime_proof_store store;
+  const auto first = make_proof(2, NOW);
+  ASSERT_TRUE(store.add(first, false, NOW));
+  ASSERT_EQ(NOW, store.last_proof_time(first.pubkey));
+
+  // a newer proof too soon after the last one we relayed is dropped
+  const uint64_t soon = NOW + UPTIME_PROOF_FREQUENCY_IN_SECONDS / 4;
+  ASSERT_FALSE(store.wants(first.pubkey, soon, false, soon));
+  ASSERT_FALSE(store.add(make_proof(2, soon), false, soon));
+  ASSERT_EQ(NOW, store.last_proof_time(first.pubkey));
+
+  // but a synced one still moves the node's proof time forward
+  ASSERT_FALSE(store.add(make_proof(2, soon), true, soon));
+  ASSERT_EQ(soon, store.last_proof_time(first.pubkey));
+
+  // the relay limit counts from when we received the live proof
+  const uint64_t later = NOW + UPTIME_PROOF_FREQUENCY_IN_SECONDS;
+  ASSERT_TRUE(store.add(make_proof(2, later), false, later));
+  ASSERT_EQ(later, store.last_proof_time(first.pubkey));
+}
+
+TEST(uptime_proof_store, synced_proof_does_not_hold_back_live_relay)
+{
+  full_nodes::uptime_proof_store store;
+  ASSERT_FALSE(store.add(make_proof(3, NOW - 60), true, NOW));
+  ASSERT_TRUE(store.wants(make_proof(3, 0).pubkey, NOW, false, NOW));
+  ASSERT_TRUE(store.add(make_proof(3, NOW), false, NOW));
+}
+
+TEST(uptime_proof_store, prunes_by_signing_time)
+{
+  full_nodes::uptime_proof_store store;
+  const auto old_proof = make_proof(4, NOW - UPTIME_PROOF_MAX_TIME_IN_SECONDS + 60);
+  const auto new_proof = make_proof(5, NOW);
+  store.add(old_proof, true, NOW);
+  store.add(new_proof, false, NOW);
+  ASSERT_EQ(2, store.get_all().size());
+
+  store.prune(NOW + 120);
+  ASSERT_EQ(0, store.last_proof_time(old_proof.pubkey));
+  ASSERT_EQ(NOW, store.last_proof_time(new_proof.pubkey));
+  const auto all = store.get_all();
+  ASSERT_EQ(1, all.size());
+  ASSERT_EQ(new_proof.pubkey, all[0].pubkey);
+}
+
+TEST_F(uptime_proof_sync, asks_a_limited_number_of_peers_once)
+{
+  protocol.on_idle();
+  ASSERT_EQ(2, p2p.asked.size());
+  ASSERT_EQ(p2p.contexts[0].m_connection_id, p2p.asked.front());
+  ASSERT_EQ(p2p.contexts[1].m_connection_id, p2p.asked.back());
+
+  // answers complete the syncs, they are not repeated
+  answer(p2p.contexts[0]);
+  answer(p2p.contexts[1]);
+  ASSERT_EQ(2, core.uptime_proofs.size());
+  ASSERT_TRUE(core.uptime_proofs[0].second);
+  protocol.on_idle();
+  ASSERT_EQ(2, p2p.asked.size());
+
+  // closing a peer that already answered frees nothing
+  protocol.on_connection_close(p2p.contexts[0]);
+  protocol.on_idle();
+  ASSERT_EQ(2, p2p.asked.size());
+}
+
+TEST_F(uptime_proof_sync, replaces_a_peer_gone_before_answering)
+{
+  protocol.on_idle();
+  ASSERT_EQ(2, p2p.asked.size());
+
+  answer(p2p.contexts[0]);
+  protocol.on_connection_close(p2p.contexts[1]);
+  p2p.contexts.erase(p2p.contexts.begin() + 1);
+  p2p.asked.clear();
+
+  // one sync was lost: only the one free slot gets refilled, by a peer not yet asked
+  protocol.on_idle();
+  ASSERT_EQ(1, p2p.asked.size());
+  ASSERT_EQ(p2p.contexts[1].m_connection_id, p2p.asked.front());
+}
+
+TEST_F(uptime_proof_sync, ignores_unrequested_answers)
+{
+  answer(p2p.contexts[3]);
+  ASSERT_TRUE(core.uptime_proofs.empty());
+
+  protocol.on_idle();
+  answer(p2p.contexts[0]);
+  answer(p2p.contexts[0]);
+  ASSERT_EQ(1, core.uptime_proofs.size());
+}
+
+TEST_F(uptime_proof_sync, relays_a_proof_to_everyone_but_its_source)
+{
+  protocol.on_idle();
+  answer(p2p.contexts[0]);
+  ASSERT_EQ(1, core.uptime_proof_sources.size());
+  ASSERT_EQ(p2p.contexts[0].m_connection_id, core.uptime_proof_sources[0]);
+
+  std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> proofs{make_proof(2, NOW)};
+  const std::vector<boost::uuids::uuid> sources{p2p.contexts[2].m_connection_id};
+  ASSERT_TRUE(relay().relay_uptime_proofs(proofs, sources));
+  ASSERT_EQ(3, p2p.relayed.size());
+  for (const auto &context: p2p.contexts)
+    ASSERT_EQ(context.m_connection_id != sources[0], std::find(p2p.relayed.begin(), p2p.relayed.end(), context.m_connection_id) != p2p.relayed.end());
+
+  // our own proofs have no source and go to every peer, once
+  p2p.relayed.clear();
+  std::vector<cryptonote::NOTIFY_UPTIME_PROOF::request> own{make_proof(3, NOW)};
+  ASSERT_TRUE(relay().relay_uptime_proofs(own, {boost::uuids::nil_uuid()}));
+  ASSERT_EQ(4, p2p.relayed.size());
+  p2p.relayed.clear();
+  ASSERT_TRUE(relay().relay_uptime_proofs(own, {boost::uuids::nil_uuid()}));
+  ASSERT_TRUE(p2p.relayed.empty());
+}
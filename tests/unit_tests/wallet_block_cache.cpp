@@ -0,0 +1,87 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+
+namespace
+{
+  tools::wallet2::block_cache::key make_key(const std::string &daemon_address, uint64_t start_height)
+  {
+    tools::wallet2::block_cache::key k;
+    k.daemon_address = daemon_address;
+    k.short_chain_history.push_back(crypto::null_hash);
+    k.start_height = start_height;
+    k.no_miner_tx = false;
+    k.scan_digest = false;
+    return k;
+  }
+}
+
+TEST(wallet_block_cache, keyed_by_daemon)
+{
+  tools::wallet2::block_cache cache;
+  std::vector<cryptonote::block_complete_entry> blocks(2);
+  blocks[0].block = "mainnet";
+  cache.add(make_key("127.0.0.1:18081", 100), 100, blocks, {});
+
+  uint64_t start_height = 0;
+  std::vector<cryptonote::block_complete_entry> got;
+  std::vector<tools::wallet2::parsed_block> parsed;
+  ASSERT_TRUE(cache.get(make_key("127.0.0.1:18081", 100), start_height, got, parsed));
+  ASSERT_EQ(100, start_height);
+  ASSERT_EQ(2, got.size());
+  ASSERT_EQ("mainnet", got[0].block);
+
+  // the same request to another daemon, possibly on another chain, misses
+  ASSERT_FALSE(cache.get(make_key("127.0.0.1:38081", 100), start_height, got, parsed));
+  ASSERT_FALSE(cache.get(make_key("127.0.0.1:18081", 101), start_height, got, parsed));
+
+  blocks[0].block = "stagenet";
+  cache.add(make_key("127.0.0.1:38081", 100), 100, blocks, {});
+  ASSERT_TRUE(cache.get(make_key("127.0.0.1:38081", 100), start_height, got, parsed));
+  ASSERT_EQ("stagenet", got[0].block);
+  ASSERT_TRUE(cache.get(make_key("127.0.0.1:18081", 100), start_height, got, parsed));
+  ASSERT_EQ("mainnet", got[0].block);
+}
+
+TEST(wallet_block_cache, drops_the_oldest_entry)
+{
+  tools::wallet2::block_cache cache(2);
+  std::vector<cryptonote::block_complete_entry> blocks(1);
+  for (uint64_t height = 0; height < 3; ++height)
+    cache.add(make_key("node", height), height, blocks, {});
+
+  uint64_t start_height;
+  std::vector<cryptonote::block_complete_entry> got;
+  std::vector<tools::wallet2::parsed_block> parsed;
+  ASSERT_FALSE(cache.get(make_key("node", 0), start_height, got, parsed));
+  ASSERT_TRUE(cache.get(make_key("node", 1), start_height, got, parsed));
+  ASSERT_TRUE(cache.get(make_key("node", 2), start_height, got, parsed));
+}
@@ -0,0 +1,159 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+#include "wallet/wallet2.h"
+#include "crypto/crypto.h"
+
+class wallet_cache_journal
+{
+public:
+  static uint64_t records(const tools::wallet2 &w) { return w.m_cache_journal.records; }
+
+  static void add_blocks(tools::wallet2 &w, size_t n)
+  {
+    for (size_t i = 0; i < n; ++i)
+      w.m_blockchain.push_back(crypto::rand<crypto::hash>());
+  }
+
+  static void set_outgoing(tools::wallet2 &w, const crypto::hash &txid, uint64_t height, uint64_t amount)
+  {
+    tools::wallet2::confirmed_transfer_details &ctd = w.m_confirmed_txs[txid];
+    ctd.m_block_height = height;
+    ctd.m_amount_in = ctd.m_amount_out = amount;
+    w.confirmed_tx_changed(txid);
+  }
+
+  static void remove_outgoing(tools::wallet2 &w, const crypto::hash &txid)
+  {
+    w.m_confirmed_txs.erase(txid);
+    w.confirmed_tx_changed(txid);
+  }
+
+  static void expect_same(const tools::wallet2 &stored, const tools::wallet2 &loaded)
+  {
+    ASSERT_EQ(stored.m_blockchain.size(), loaded.m_blockchain.size());
+    for (size_t i = loaded.m_blockchain.offset(); i < loaded.m_blockchain.size(); ++i)
+      ASSERT_EQ(stored.m_blockchain[i], loaded.m_blockchain[i]);
+
+    ASSERT_EQ(stored.m_confirmed_txs.size(), loaded.m_confirmed_txs.size());
+    for (const auto &c: stored.m_confirmed_txs)
+    {
+      const auto i = loaded.m_confirmed_txs.find(c.first);
+      ASSERT_TRUE(i != loaded.m_confirmed_txs.end());
+      ASSERT_EQ(c.second.m_block_height, i->second.m_block_height);
+      ASSERT_EQ(c.second.m_amount_in, i->second.m_amount_in);
+      ASSERT_EQ(c.second.m_amount_out, i->second.m_amount_out);
+    }
+  }
+};
+
+namespace
+{
+  class temp_wallet_dir
+  {
+  public:
+    temp_wallet_dir(): dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    {
+      boost::filesystem::create_directories(dir);
+    }
+    ~temp_wallet_dir()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(dir, ec);
+    }
+    std::string wallet() const { return (dir / "wallet").string(); }
+    bool has_journal() const { return boost::filesystem::exists(wallet() + ".journal"); }
+
+  private:
+    boost::filesystem::path dir;
+  };
+}
+
+TEST(wallet_cache_journal, stores_are_replayed_on_load)
+{
+  temp_wallet_dir dir;
+  const crypto::hash a = crypto::rand<crypto::hash>(), b = crypto::rand<crypto::hash>(), c = crypto::rand<crypto::hash>();
+
+  tools::wallet2 w;
+  w.generate(dir.wallet(), "test"); // writes the cache in full
+  ASSERT_FALSE(dir.has_journal());
+
+  // the next store goes in the journal
+  wallet_cache_journal::add_blocks(w, 3);
+  wallet_cache_journal::set_outgoing(w, a, 1, 100);
+  wallet_cache_journal::set_outgoing(w, b, 2, 200);
+  w.store();
+  ASSERT_TRUE(dir.has_journal());
+  ASSERT_EQ(1, wallet_cache_journal::records(w));
+
+  // updates and removals of what an earlier record added
+  wallet_cache_journal::add_blocks(w, 2);
+  wallet_cache_journal::set_outgoing(w, a, 1, 150);
+  wallet_cache_journal::remove_outgoing(w, b);
+  wallet_cache_journal::set_outgoing(w, c, 4, 300);
+  w.store();
+  ASSERT_EQ(2, wallet_cache_journal::records(w));
+
+  // a store with no changes still appends its record
+  w.store();
+  ASSERT_EQ(3, wallet_cache_journal::records(w));
+
+  tools::wallet2 loaded;
+  loaded.load(dir.wallet(), "test");
+  ASSERT_EQ(3, wallet_cache_journal::records(loaded));
+  wallet_cache_journal::expect_same(w, loaded);
+}
+
+TEST(wallet_cache_journal, bulk_changes_diff_every_outgoing_tx)
+{
+  temp_wallet_dir dir;
+  tools::wallet2 w;
+  w.generate(dir.wallet(), "test");
+  wallet_cache_journal::set_outgoing(w, crypto::rand<crypto::hash>(), 1, 100);
+  w.store();
+
+  // import_payments_out replaces them all without naming each one
+  std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> imported;
+  for (uint64_t n = 1; n <= 3; ++n)
+  {
+    tools::wallet2::confirmed_transfer_details ctd;
+    ctd.m_block_height = n;
+    ctd.m_amount_in = ctd.m_amount_out = n * 1000;
+    imported.emplace_back(crypto::rand<crypto::hash>(), ctd);
+  }
+  w.import_payments_out(imported);
+  w.store();
+  ASSERT_EQ(2, wallet_cache_journal::records(w));
+
+  tools::wallet2 loaded;
+  loaded.load(dir.wallet(), "test");
+  wallet_cache_journal::expect_same(w, loaded);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+
+TEST(wallet_decoy_cache, kept_while_the_height_stands)
+{
+  tools::wallet2::decoy_cache cache;
+  cache.set_height(100);
+  cache.output_blacklist = {3, 7};
+  cache.has_output_blacklist = true;
+  cache.segregation_limit[0] = std::make_pair(50, 5);
+
+  cache.set_height(100);
+  ASSERT_EQ(100, cache.height);
+  ASSERT_TRUE(cache.has_output_blacklist);
+  ASSERT_EQ(std::vector<uint64_t>({3, 7}), cache.output_blacklist);
+  ASSERT_EQ(1, cache.segregation_limit.size());
+
+  // a new block (or a reorg to a lower one) can change all of it
+  cache.set_height(99);
+  ASSERT_EQ(99, cache.height);
+  ASSERT_FALSE(cache.has_output_blacklist);
+  ASSERT_TRUE(cache.output_blacklist.empty());
+  ASSERT_TRUE(cache.segregation_limit.empty());
+}
+
+TEST(wallet_decoy_cache, only_unseen_amounts_are_requested)
+{
+  tools::wallet2::decoy_cache cache;
+  cache.set_height(100);
+  ASSERT_EQ(std::vector<uint64_t>({0, 5, 20}), cache.missing_segregation_amounts({20, 0, 5, 0, 20}));
+
+  cache.segregation_limit[0] = std::make_pair(50, 5);
+  cache.segregation_limit[20] = std::make_pair(10, 1);
+  ASSERT_EQ(std::vector<uint64_t>({5}), cache.missing_segregation_amounts({20, 0, 5, 0, 20}));
+  ASSERT_TRUE(cache.missing_segregation_amounts({0, 20}).empty());
+
+  cache.set_height(101);
+  ASSERT_EQ(std::vector<uint64_t>({0, 20}), cache.missing_segregation_amounts({0, 20}));
+}
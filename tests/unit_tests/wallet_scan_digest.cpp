@@ -0,0 +1,156 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+#include "crypto/crypto.h"
+#include "cryptonote_basic/account.h"
+
+class wallet_scan_digest
+{
+public:
+  wallet_scan_digest()
+  {
+    w.generate("", "", crypto::secret_key(), true, false);
+  }
+
+  bool uses_digests() const { return w.use_scan_digests(); }
+
+  bool matches(const crypto::hash &txid, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest, tools::wallet2::tx_cache_data &slot) const
+  {
+    return w.scan_digest_matches(txid, digest, slot);
+  }
+
+  void add_unconfirmed(const crypto::hash &txid) { w.m_unconfirmed_txs[txid] = tools::wallet2::unconfirmed_transfer_details(); }
+  void add_key_image(const crypto::key_image &ki) { w.m_key_images[ki] = 0; }
+
+  tools::wallet2 w;
+};
+
+namespace
+{
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest make_digest(size_t n_outputs)
+  {
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest digest;
+    digest.standard = true;
+    digest.pub_keys.push_back(cryptonote::keypair::generate(hw::get_device("default")).pub);
+    for (size_t n = 0; n < n_outputs; ++n)
+      digest.output_keys.push_back(cryptonote::keypair::generate(hw::get_device("default")).pub);
+    digest.key_images.push_back(crypto::key_image());
+    return digest;
+  }
+
+  // what derive_tx_cache_data and derive_subaddress_spend_keys leave for the digest's tx pub key
+  tools::wallet2::tx_cache_data make_slot(const cryptonote::account_keys &keys, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest)
+  {
+    tools::wallet2::tx_cache_data slot;
+    slot.primary.resize(1);
+    tools::wallet2::is_out_data &iod = slot.primary[0];
+    iod.pkey = digest.pub_keys[0];
+    EXPECT_TRUE(crypto::generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation));
+    iod.received.resize(digest.output_keys.size());
+    iod.spend_keys.resize(digest.output_keys.size());
+    for (size_t n = 0; n < digest.output_keys.size(); ++n)
+    {
+      crypto::public_key spend_key;
+      EXPECT_TRUE(crypto::derive_subaddress_public_key(digest.output_keys[n], iod.derivation, n, spend_key));
+      iod.spend_keys[n] = spend_key;
+    }
+    return slot;
+  }
+}
+
+TEST(wallet_scan_digest, only_with_trusted_daemon)
+{
+  wallet_scan_digest t;
+  t.w.set_trusted_daemon(false);
+  ASSERT_FALSE(t.uses_digests());
+  t.w.set_trusted_daemon(true);
+  ASSERT_TRUE(t.uses_digests());
+  t.w.track_uses(true);
+  ASSERT_FALSE(t.uses_digests());
+}
+
+TEST(wallet_scan_digest, no_match)
+{
+  wallet_scan_digest t;
+  const auto digest = make_digest(2);
+  auto slot = make_slot(t.w.get_account().get_keys(), digest);
+  ASSERT_FALSE(t.matches(crypto::rand<crypto::hash>(), digest, slot));
+}
+
+TEST(wallet_scan_digest, matches_output_to_us)
+{
+  wallet_scan_digest t;
+  const cryptonote::account_keys &keys = t.w.get_account().get_keys();
+  auto digest = make_digest(2);
+  crypto::key_derivation derivation;
+  ASSERT_TRUE(crypto::generate_key_derivation(digest.pub_keys[0], keys.m_view_secret_key, derivation));
+  ASSERT_TRUE(crypto::derive_public_key(derivation, 1, keys.m_account_address.m_spend_public_key, digest.output_keys[1]));
+
+  auto slot = make_slot(keys, digest);
+  ASSERT_TRUE(t.matches(crypto::rand<crypto::hash>(), digest, slot));
+  ASSERT_FALSE(slot.primary[0].received[0]);
+  ASSERT_TRUE(slot.primary[0].received[1]);
+  ASSERT_EQ(slot.primary[0].received[1]->index.major, 0);
+  ASSERT_EQ(slot.primary[0].received[1]->index.minor, 0);
+}
+
+TEST(wallet_scan_digest, matches_spent_key_image)
+{
+  wallet_scan_digest t;
+  auto digest = make_digest(1);
+  digest.key_images.back() = crypto::rand<crypto::key_image>();
+  auto slot = make_slot(t.w.get_account().get_keys(), digest);
+  ASSERT_FALSE(t.matches(crypto::rand<crypto::hash>(), digest, slot));
+  t.add_key_image(digest.key_images.back());
+  ASSERT_TRUE(t.matches(crypto::rand<crypto::hash>(), digest, slot));
+}
+
+TEST(wallet_scan_digest, matches_own_unconfirmed_tx)
+{
+  wallet_scan_digest t;
+  const auto digest = make_digest(1);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  auto slot = make_slot(t.w.get_account().get_keys(), digest);
+  ASSERT_FALSE(t.matches(txid, digest, slot));
+  t.add_unconfirmed(txid);
+  ASSERT_TRUE(t.matches(txid, digest, slot));
+}
+
+TEST(wallet_scan_digest, non_standard_never_matches)
+{
+  wallet_scan_digest t;
+  auto digest = make_digest(1);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  t.add_unconfirmed(txid);
+  auto slot = make_slot(t.w.get_account().get_keys(), digest);
+  digest.standard = false;
+  ASSERT_FALSE(t.matches(txid, digest, slot));
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2014-2025, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#define IN_UNIT_TESTS
+
+#include <cstring>
+#include "gtest/gtest.h"
+#include "int-util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/zmq_pub.h"
+
+namespace
+{
+
+crypto::hash make_hash(uint8_t seed)
+{
+  crypto::hash h = crypto::null_hash;
+  h.data[0] = seed;
+  return h;
+}
+
+uint64_t read_u64(const std::string& s, size_t offset = 0)
+{
+  uint64_t v;
+  memcpy(&v, s.data() + offset, sizeof(v));
+  return SWAP64LE(v);
+}
+
+struct pub_test
+{
+  cryptonote::core core;
+  cryptonote::rpc::ZmqPublisher pub;
+
+  // never run, so no hook is installed and the queue is only filled by hand
+  pub_test(): core(nullptr), pub(core) {}
+  const std::deque<cryptonote::rpc::ZmqPublisher::event>& queue() const { return pub.m_queue; }
+};
+
+}
+
+TEST(zmq_pub, block_added_queues_tip_block_and_full_nodes)
+{
+  pub_test t;
+  cryptonote::block b = AUTO_VAL_INIT(b);
+  b.miner_tx.vin.push_back(cryptonote::txin_gen{5});
+  const crypto::hash hash = cryptonote::get_block_hash(b);
+
+  t.pub.block_added(b, {});
+  ASSERT_EQ(3, t.queue().size());
+  EXPECT_EQ("chain_tip", t.queue()[0].topic);
+  EXPECT_EQ("block", t.queue()[1].topic);
+  EXPECT_EQ("full_nodes", t.queue()[2].topic);
+
+  for (size_t i = 0; i < 2; ++i)
+  {
+    const std::string& payload = t.queue()[i].payload;
+    ASSERT_GT(payload.size(), 8 + sizeof(crypto::hash));
+    EXPECT_EQ(5, read_u64(payload));
+    EXPECT_EQ(0, memcmp(payload.data() + 8, hash.data, sizeof(hash)));
+  }
+  EXPECT_EQ(cryptonote::block_to_blob(b), t.queue()[1].payload.substr(8 + sizeof(crypto::hash)));
+}
+
+TEST(zmq_pub, one_full_nodes_event_stays_pending)
+{
+  pub_test t;
+  t.pub.blockchain_detached(7);
+  t.pub.blockchain_detached(6);
+  ASSERT_EQ(4, t.queue().size());
+  EXPECT_EQ("chain_detached", t.queue()[0].topic);
+  EXPECT_EQ(7, read_u64(t.queue()[0].payload));
+  EXPECT_EQ("full_nodes", t.queue()[1].topic);
+  EXPECT_EQ(6, read_u64(t.queue()[2].payload));
+
+  t.pub.enqueue("full_nodes", std::string());
+  EXPECT_EQ(4, t.queue().size());
+}
+
+TEST(zmq_pub, pool_events_are_coalesced)
+{
+  pub_test t;
+  t.pub.tx_added(make_hash(1));
+  t.pub.tx_added(make_hash(2));
+  t.pub.tx_removed(make_hash(3));
+  t.pub.tx_removed(make_hash(4));
+  t.pub.tx_added(make_hash(5));
+
+  ASSERT_EQ(3, t.queue().size());
+  EXPECT_EQ("txpool_add", t.queue()[0].topic);
+  ASSERT_EQ(2 * sizeof(crypto::hash), t.queue()[0].payload.size());
+  EXPECT_EQ(1, t.queue()[0].payload[0]);
+  EXPECT_EQ(2, t.queue()[0].payload[sizeof(crypto::hash)]);
+  EXPECT_EQ("txpool_remove", t.queue()[1].topic);
+  EXPECT_EQ(2 * sizeof(crypto::hash), t.queue()[1].payload.size());
+  EXPECT_EQ("txpool_add", t.queue()[2].topic);
+  EXPECT_EQ(sizeof(crypto::hash), t.queue()[2].payload.size());
+}
+
+TEST(zmq_pub, pool_events_are_split_when_full)
+{
+  pub_test t;
+  for (size_t i = 0; i < cryptonote::rpc::MAX_ZMQ_PUB_TXS_PER_EVENT + 1; ++i)
+    t.pub.tx_added(make_hash(i));
+  ASSERT_EQ(2, t.queue().size());
+  EXPECT_EQ(cryptonote::rpc::MAX_ZMQ_PUB_TXS_PER_EVENT * sizeof(crypto::hash), t.queue()[0].payload.size());
+  EXPECT_EQ(sizeof(crypto::hash), t.queue()[1].payload.size());
+}
+
+TEST(zmq_pub, full_queue_drops_the_oldest)
+{
+  pub_test t;
+  for (uint64_t i = 0; i < cryptonote::rpc::MAX_ZMQ_PUB_QUEUED_EVENTS + 10; ++i)
+    t.pub.enqueue(i % 2 ? "txpool_add" : "txpool_remove", std::to_string(i));
+  EXPECT_EQ(cryptonote::rpc::MAX_ZMQ_PUB_QUEUED_EVENTS, t.queue().size());
+  EXPECT_EQ(10, t.pub.m_dropped);
+  EXPECT_EQ("10", t.queue().front().payload);
+  EXPECT_EQ(std::to_string(cryptonote::rpc::MAX_ZMQ_PUB_QUEUED_EVENTS + 9), t.queue().back().payload);
+}
@@ -0,0 +1,367 @@
+// Copyright (c) 2014-2025, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Wallet refresh benchmark over a recorded chain.
+//
+// --record pulls /getblocks.bin responses from a daemon the way a wallet
+// refresh does and writes them to a file; replaying that file needs no daemon
+// and feeds every response through the stages of wallet2's refresh, timing
+// each one:
+//
+//   parse       - block and tx blobs to parsed_blocks
+//   cache       - cache_tx_data: tx extra parsing, tx public keys
+//   derivation  - key derivations and candidate subaddress spend keys
+//   apply       - process_parsed_blocks: subaddress matching, transfers,
+//                 the wallet's hashchain
+//
+// The stages run back to back here, whereas refresh overlaps the scan of a
+// batch with the apply of the previous one, so the sum is an upper bound of
+// what refresh itself takes over the same range.
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "misc_log_ex.h"
+#include "net/http_client.h"
+#include "storages/http_abstract_invoke.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_tools.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "wallet/wallet2.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const char recording_magic[] = "antd getblocks.bin recording 1\n";
+
+  uint64_t now_us()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  bool write_response(std::ofstream &out, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response &res)
+  {
+    std::string blob;
+    if (!epee::serialization::store_t_to_binary(res, blob))
+      return false;
+    const uint64_t size = SWAP64LE((uint64_t)blob.size());
+    out.write((const char*)&size, sizeof(size));
+    out.write(blob.data(), blob.size());
+    return out.good();
+  }
+
+  // false at the end of the recording, throws if it is truncated or garbled
+  bool read_response(std::ifstream &in, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response &res)
+  {
+    uint64_t size;
+    if (!in.read((char*)&size, sizeof(size)))
+      return false;
+    std::string blob(SWAP64LE(size), '\0');
+    if (!in.read(&blob[0], blob.size()))
+      throw std::runtime_error("Truncated recording");
+    res = cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response();
+    if (!epee::serialization::load_t_from_binary(res, blob))
+      throw std::runtime_error("Failed to parse a recorded response");
+    return true;
+  }
+
+  int record(const std::string &path, const std::string &address, const boost::optional<epee::net_utils::http::login> &login, cryptonote::network_type nettype, uint64_t max_blocks)
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      std::cerr << "Failed to open " << path << std::endl;
+      return 1;
+    }
+    out.write(recording_magic, sizeof(recording_magic) - 1);
+
+    epee::net_utils::http::http_simple_client client;
+    client.set_server(address, login, false);
+
+    // start from the genesis block like a new wallet; every next request names the last block
+    // received, so the responses overlap by one block as they do during a refresh
+    cryptonote::block genesis;
+    cryptonote::generate_genesis_block(genesis, cryptonote::get_config(nettype).GENESIS_TX, cryptonote::get_config(nettype).GENESIS_NONCE);
+    const crypto::hash genesis_hash = cryptonote::get_block_hash(genesis);
+    crypto::hash last_hash = genesis_hash;
+    uint64_t start_height = 0, recorded = 0;
+    while (true)
+    {
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+      if (last_hash != genesis_hash)
+        req.block_ids.push_back(last_hash);
+      req.block_ids.push_back(genesis_hash);
+      req.start_height = start_height;
+      req.prune = true;
+      if (!epee::net_utils::invoke_http_bin("/getblocks.bin", req, res, client, tools::wallet2::rpc_timeout) || res.status != CORE_RPC_STATUS_OK)
+      {
+        std::cerr << "getblocks.bin failed at height " << start_height << (res.status.empty() ? "" : ": " + res.status) << std::endl;
+        return 2;
+      }
+      if (res.blocks.empty() || res.blocks.size() != res.output_indices.size())
+      {
+        std::cerr << "Unexpected getblocks.bin response at height " << start_height << std::endl;
+        return 2;
+      }
+      if (start_height == 0)
+      {
+        cryptonote::block b;
+        if (!cryptonote::parse_and_validate_block_from_blob(res.blocks.front().block, b) || cryptonote::get_block_hash(b) != genesis_hash)
+        {
+          std::cerr << "The daemon is not on " << (nettype == cryptonote::TESTNET ? "testnet" : nettype == cryptonote::STAGENET ? "stagenet" : "mainnet") << std::endl;
+          return 2;
+        }
+      }
+
+      const uint64_t next_height = res.start_height + res.blocks.size();
+      cryptonote::block last;
+      if (!cryptonote::parse_and_validate_block_from_blob(res.blocks.back().block, last))
+      {
+        std::cerr << "Failed to parse block " << next_height - 1 << std::endl;
+        return 2;
+      }
+      const bool done = next_height >= res.current_height || (max_blocks && next_height >= max_blocks);
+      if (!write_response(out, res))
+      {
+        std::cerr << "Failed to write to " << path << std::endl;
+        return 1;
+      }
+      recorded += res.blocks.size();
+      std::cout << "\rrecorded up to height " << next_height - 1 << " of " << res.current_height - 1 << std::flush;
+      if (done || next_height <= start_height)
+        break;
+      last_hash = cryptonote::get_block_hash(last);
+      start_height = next_height - 1;
+    }
+    std::cout << std::endl << recorded << " blocks written to " << path << std::endl;
+    return 0;
+  }
+}
+
+// drives wallet2's refresh stages one at a time, which needs its internals
+class wallet_scan_bench
+{
+public:
+  struct stats
+  {
+    uint64_t responses = 0;
+    uint64_t blocks = 0;
+    uint64_t txes = 0;
+    uint64_t outputs = 0;
+    uint64_t parse_us = 0;
+    uint64_t cache_us = 0;
+    uint64_t derivation_us = 0;
+    uint64_t apply_us = 0;
+  };
+
+  static void replay(tools::wallet2 &wallet, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response &res, std::map<std::pair<uint64_t, uint64_t>, size_t> &output_tracker_cache, stats &s)
+  {
+    std::vector<cryptonote::block_complete_entry> blocks = std::move(res.blocks);
+    std::vector<tools::wallet2::parsed_block> parsed_blocks;
+    std::vector<tools::wallet2::tx_cache_data> tx_cache_data;
+    bool error = false;
+
+    const uint64_t t0 = now_us();
+    wallet.parse_blocks(blocks, res.output_indices, res.scan_digests, parsed_blocks, error);
+    if (error)
+      throw std::runtime_error("Failed to parse the blocks from height " + std::to_string(res.start_height));
+    const uint64_t t1 = now_us();
+    wallet.cache_tx_data(parsed_blocks, tx_cache_data);
+    const uint64_t t2 = now_us();
+    wallet.derive_tx_cache_data(parsed_blocks, wallet.get_account().get_keys().m_view_secret_key, tx_cache_data);
+    const uint64_t t3 = now_us();
+    uint64_t blocks_added = 0;
+    wallet.process_parsed_blocks(res.start_height, blocks, parsed_blocks, blocks_added, &output_tracker_cache, &tx_cache_data);
+    const uint64_t t4 = now_us();
+
+    ++s.responses;
+    s.blocks += parsed_blocks.size();
+    for (const auto &pb: parsed_blocks)
+    {
+      s.txes += 1 + pb.txes.size();
+      s.outputs += pb.block.miner_tx.vout.size();
+      for (const auto &tx: pb.txes)
+        s.outputs += tx.vout.size();
+    }
+    s.parse_us += t1 - t0;
+    s.cache_us += t2 - t1;
+    s.derivation_us += t3 - t2;
+    s.apply_us += t4 - t3;
+  }
+
+  static bool is_recording_of(const tools::wallet2 &wallet, const crypto::hash &first_block)
+  {
+    return wallet.m_blockchain[0] == first_block;
+  }
+};
+
+namespace
+{
+  void print_stage(const char *name, uint64_t us, uint64_t total_us, uint64_t blocks)
+  {
+    std::cout << std::left << std::setw(12) << name << std::right
+      << std::setw(10) << std::fixed << std::setprecision(3) << us / 1e6 << " s"
+      << std::setw(8) << std::setprecision(1) << (total_us ? 100.0 * us / total_us : 0.0) << " %"
+      << std::setw(10) << std::setprecision(1) << (blocks ? (double)us / blocks : 0.0) << " us/block" << std::endl;
+  }
+
+  int replay(const std::string &path, cryptonote::network_type nettype, size_t subaddresses, const std::string &spend_key)
+  {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic(sizeof(recording_magic) - 1, '\0');
+    if (!in || !in.read(&magic[0], magic.size()) || magic != recording_magic)
+    {
+      std::cerr << path << " is not a getblocks.bin recording" << std::endl;
+      return 1;
+    }
+
+    crypto::secret_key recovery_key = crypto::secret_key();
+    if (!spend_key.empty() && !epee::string_tools::hex_to_pod(spend_key, recovery_key))
+    {
+      std::cerr << "Invalid spend key" << std::endl;
+      return 1;
+    }
+
+    tools::wallet2 wallet(nettype, 1, true);
+    wallet.set_subaddress_lookahead(1, subaddresses);
+    wallet.generate("", "", recovery_key, !spend_key.empty());
+
+    wallet_scan_bench::stats s;
+    std::map<std::pair<uint64_t, uint64_t>, size_t> output_tracker_cache;
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res;
+    const uint64_t start = now_us();
+    while (read_response(in, res))
+    {
+      if (s.responses == 0)
+      {
+        cryptonote::block b;
+        if (res.start_height != 0 || res.blocks.empty() || !cryptonote::parse_and_validate_block_from_blob(res.blocks.front().block, b)
+            || !wallet_scan_bench::is_recording_of(wallet, cryptonote::get_block_hash(b)))
+        {
+          std::cerr << path << " was not recorded from the start of this network's chain" << std::endl;
+          return 1;
+        }
+      }
+      wallet_scan_bench::replay(wallet, res, output_tracker_cache, s);
+    }
+    const uint64_t elapsed = now_us() - start;
+
+    const uint64_t staged = s.parse_us + s.cache_us + s.derivation_us + s.apply_us;
+    std::cout << s.responses << " responses, " << s.blocks << " blocks, " << s.txes << " txes, " << s.outputs << " outputs, "
+      << subaddresses << " subaddresses, " << tools::get_max_concurrency() << " threads" << std::endl;
+    std::cout << "wallet balance " << cryptonote::print_money(wallet.balance_all()) << " in " << wallet.get_num_transfer_details() << " outputs" << std::endl;
+    print_stage("parse", s.parse_us, staged, s.blocks);
+    print_stage("cache", s.cache_us, staged, s.blocks);
+    print_stage("derivation", s.derivation_us, staged, s.blocks);
+    print_stage("apply", s.apply_us, staged, s.blocks);
+    print_stage("total", elapsed, staged, s.blocks);
+    const double seconds = elapsed / 1e6;
+    std::cout << std::fixed << std::setprecision(1)
+      << (seconds > 0 ? s.blocks / seconds : 0.0) << " blocks/s, "
+      << (seconds > 0 ? s.outputs / seconds : 0.0) << " outputs/s" << std::endl;
+    return 0;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  mlog_configure(mlog_get_default_log_path("wallet_scan_bench.log"), true);
+
+  po::options_description desc_options("Command line options");
+  const command_line::arg_descriptor<std::string> arg_input = { "input", "Recording to replay", "" };
+  const command_line::arg_descriptor<std::string> arg_record = { "record", "Record getblocks.bin responses from the daemon to this file instead of replaying", "" };
+  const command_line::arg_descriptor<std::string> arg_daemon_address = { "daemon-address", "RPC address of the daemon to record from", "http://127.0.0.1:18081" };
+  const command_line::arg_descriptor<std::string> arg_login = { "login", "username:password for the daemon's RPC", "" };
+  const command_line::arg_descriptor<uint64_t> arg_blocks = { "blocks", "Stop recording at this height, 0 for the top of the chain", 0 };
+  const command_line::arg_descriptor<bool> arg_testnet = { "testnet", "The recording is of testnet", false };
+  const command_line::arg_descriptor<bool> arg_stagenet = { "stagenet", "The recording is of stagenet", false };
+  const command_line::arg_descriptor<size_t> arg_subaddresses = { "subaddresses", "Subaddresses the wallet looks for", SUBADDRESS_LOOKAHEAD_MINOR };
+  const command_line::arg_descriptor<std::string> arg_spend_key = { "spend-key", "Hex spend secret key of the wallet to restore, a new one if empty", "" };
+  const command_line::arg_descriptor<unsigned> arg_max_concurrency = { "max-concurrency", "Threads to scan with, 0 for the number of cores", 0 };
+  command_line::add_arg(desc_options, arg_input);
+  command_line::add_arg(desc_options, arg_record);
+  command_line::add_arg(desc_options, arg_daemon_address);
+  command_line::add_arg(desc_options, arg_login);
+  command_line::add_arg(desc_options, arg_blocks);
+  command_line::add_arg(desc_options, arg_testnet);
+  command_line::add_arg(desc_options, arg_stagenet);
+  command_line::add_arg(desc_options, arg_subaddresses);
+  command_line::add_arg(desc_options, arg_spend_key);
+  command_line::add_arg(desc_options, arg_max_concurrency);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  const cryptonote::network_type nettype = command_line::get_arg(vm, arg_testnet) ? cryptonote::TESTNET :
+      command_line::get_arg(vm, arg_stagenet) ? cryptonote::STAGENET : cryptonote::MAINNET;
+  if (command_line::get_arg(vm, arg_max_concurrency))
+    tools::set_max_concurrency(command_line::get_arg(vm, arg_max_concurrency));
+
+  const std::string record_path = command_line::get_arg(vm, arg_record);
+  if (!record_path.empty())
+  {
+    boost::optional<epee::net_utils::http::login> login;
+    const std::string login_arg = command_line::get_arg(vm, arg_login);
+    const size_t colon = login_arg.find(':');
+    if (!login_arg.empty() && colon != std::string::npos)
+    {
+      login = epee::net_utils::http::login{};
+      login->username = login_arg.substr(0, colon);
+      login->password = login_arg.substr(colon + 1);
+    }
+    return record(record_path, command_line::get_arg(vm, arg_daemon_address), login, nettype, command_line::get_arg(vm, arg_blocks));
+  }
+
+  const std::string input = command_line::get_arg(vm, arg_input);
+  if (input.empty())
+  {
+    std::cerr << "Either --input or --record is needed" << std::endl << desc_options << std::endl;
+    return 1;
+  }
+  const size_t subaddresses = std::max<size_t>(command_line::get_arg(vm, arg_subaddresses), 1);
+  return replay(input, nettype, subaddresses, command_line::get_arg(vm, arg_spend_key));
+  CATCH_ENTRY_L0("main", 1);
+}